@@ -0,0 +1,111 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "KernelGenerator.h"
+
+#include <sstream>
+
+static const char* OPERATIONS[] = {"add", "xor", "sub", "or"};
+
+static std::string getType(const GeneratorParameters& params)
+{
+	return params.vectorWidth == 1 ? "i32" : "<" + std::to_string(params.vectorWidth) + " x i32>";
+}
+
+static std::string getConstant(const GeneratorParameters& params, const std::size_t value)
+{
+	if(params.vectorWidth == 1)
+		return std::to_string(value);
+	std::string result = "<";
+	for(std::size_t i = 0; i < params.vectorWidth; ++i)
+		result.append(i == 0 ? "" : ", ").append("i32 ").append(std::to_string(value));
+	return result + ">";
+}
+
+static std::string getLoopLabel(const std::size_t depth, const std::string& part)
+{
+	return "loop" + std::to_string(depth) + "." + part;
+}
+
+std::string generateKernel(const GeneratorParameters& params)
+{
+	const std::string type = getType(params);
+	const std::string typeName = params.vectorWidth == 1 ? "int" : "int" + std::to_string(params.vectorWidth);
+	const std::size_t numLocals = params.numLocals == 0 ? 1 : params.numLocals;
+	std::ostringstream s;
+	s << "; ModuleID = 'stress'" << std::endl;
+	s << "; blocks " << params.numBlocks << ", block length " << params.blockLength << ", locals " << numLocals << ", loop depth " << params.loopDepth
+			<< ", vector width " << params.vectorWidth << std::endl << std::endl;
+	s << "define spir_kernel void @stress(" << type << "* nocapture readonly %in, " << type << "* nocapture %out, i32 %count) #0 "
+			<< "!kernel_arg_addr_space !0 !kernel_arg_access_qual !1 !kernel_arg_type !2 !kernel_arg_base_type !2 !kernel_arg_type_qual !3 {" << std::endl;
+	s << "entry:" << std::endl;
+	s << "  %gid = tail call i32 @get_global_id(i32 0) #1" << std::endl;
+	s << "  %in.ptr = getelementptr inbounds " << type << ", " << type << "* %in, i32 %gid" << std::endl;
+	s << "  %out.ptr = getelementptr inbounds " << type << ", " << type << "* %out, i32 %gid" << std::endl;
+	s << "  %seed = load " << type << ", " << type << "* %in.ptr, align 4" << std::endl;
+	for(std::size_t i = 0; i < numLocals; ++i)
+		s << "  %local." << i << " = add " << type << " %seed, " << getConstant(params, i + 1) << std::endl;
+	const std::string firstBlock = params.numBlocks == 0 ? "body.end" : "block0";
+	s << "  br label %" << (params.loopDepth > 0 ? getLoopLabel(0, "header") : firstBlock) << std::endl;
+
+	//loop headers, from the outermost to the innermost loop
+	for(std::size_t depth = 0; depth < params.loopDepth; ++depth)
+	{
+		s << std::endl << getLoopLabel(depth, "header") << ":" << std::endl;
+		s << "  %" << getLoopLabel(depth, "i") << " = phi i32 [ 0, %" << (depth == 0 ? "entry" : getLoopLabel(depth - 1, "header")) << " ], [ %"
+				<< getLoopLabel(depth, "next") << ", %" << getLoopLabel(depth, "latch") << " ]" << std::endl;
+		s << "  %" << getLoopLabel(depth, "cond") << " = icmp slt i32 %" << getLoopLabel(depth, "i") << ", %count" << std::endl;
+		s << "  br i1 %" << getLoopLabel(depth, "cond") << ", label %" << (depth + 1 < params.loopDepth ? getLoopLabel(depth + 1, "header") : firstBlock)
+				<< ", label %" << (depth == 0 ? "exit" : getLoopLabel(depth - 1, "latch")) << std::endl;
+	}
+
+	//the loop body, a chain of dependent instructions split into basic blocks
+	std::string previous = "%seed";
+	std::size_t index = 0;
+	for(std::size_t block = 0; block < params.numBlocks; ++block)
+	{
+		s << std::endl << "block" << block << ":" << std::endl;
+		for(std::size_t i = 0; i < params.blockLength; ++i, ++index)
+		{
+			const std::string value = "%chain." + std::to_string(index);
+			s << "  " << value << " = " << OPERATIONS[index % 4] << " " << type << " " << previous << ", %local." << (index % numLocals) << std::endl;
+			previous = value;
+		}
+		s << "  br label %" << (block + 1 < params.numBlocks ? "block" + std::to_string(block + 1) : std::string("body.end")) << std::endl;
+	}
+	s << std::endl << "body.end:" << std::endl;
+	s << "  store " << type << " " << previous << ", " << type << "* %out.ptr, align 4" << std::endl;
+	s << "  br label %" << (params.loopDepth > 0 ? getLoopLabel(params.loopDepth - 1, "latch") : "exit") << std::endl;
+
+	//loop latches, from the innermost to the outermost loop
+	for(std::size_t depth = params.loopDepth; depth > 0; --depth)
+	{
+		s << std::endl << getLoopLabel(depth - 1, "latch") << ":" << std::endl;
+		s << "  %" << getLoopLabel(depth - 1, "next") << " = add nsw i32 %" << getLoopLabel(depth - 1, "i") << ", 1" << std::endl;
+		s << "  br label %" << getLoopLabel(depth - 1, "header") << std::endl;
+	}
+
+	//all long-living values are used at the end of the kernel
+	s << std::endl << "exit:" << std::endl;
+	previous = "%seed";
+	for(std::size_t i = 0; i < numLocals; ++i)
+	{
+		s << "  %sum." << i << " = xor " << type << " " << previous << ", %local." << i << std::endl;
+		previous = "%sum." + std::to_string(i);
+	}
+	s << "  store " << type << " " << previous << ", " << type << "* %out.ptr, align 4" << std::endl;
+	s << "  ret void" << std::endl;
+	s << "}" << std::endl << std::endl;
+
+	s << "declare i32 @get_global_id(i32) #1" << std::endl << std::endl;
+	s << "attributes #0 = { nounwind }" << std::endl;
+	s << "attributes #1 = { nounwind readnone }" << std::endl << std::endl;
+	s << "!0 = !{i32 1, i32 1, i32 0}" << std::endl;
+	s << "!1 = !{!\"none\", !\"none\", !\"none\"}" << std::endl;
+	s << "!2 = !{!\"" << typeName << "*\", !\"" << typeName << "*\", !\"int\"}" << std::endl;
+	s << "!3 = !{!\"const\", !\"\", !\"\"}" << std::endl;
+	return s.str();
+}
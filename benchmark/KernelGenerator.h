@@ -0,0 +1,38 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef KERNELGENERATOR_H
+#define KERNELGENERATOR_H
+
+#include <cstddef>
+#include <string>
+
+/*
+ * The shape of a synthetic kernel
+ */
+struct GeneratorParameters
+{
+	//the number of arithmetic instructions per basic block
+	std::size_t blockLength = 16;
+	//the number of consecutive basic blocks in the (innermost) loop body
+	std::size_t numBlocks = 4;
+	//the number of values live over the whole kernel
+	std::size_t numLocals = 8;
+	//the number of nested loops around the basic blocks
+	std::size_t loopDepth = 1;
+	//the number of elements of the vectors calculated with
+	std::size_t vectorWidth = 4;
+};
+
+/*
+ * Generates the LLVM IR (in text format) of a kernel with the given shape.
+ *
+ * Every instruction of the basic blocks combines the result of the previous instruction with one of the long-living values,
+ * so the basic blocks consist of a single long dependency chain, while the long-living values stress the register allocation.
+ */
+std::string generateKernel(const GeneratorParameters& params);
+
+#endif /* KERNELGENERATOR_H */
@@ -0,0 +1,214 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "MicroBenchmarks.h"
+
+#include "Module.h"
+#include "InstructionWalker.h"
+#include "asm/GraphColoring.h"
+#include "intermediate/IntermediateInstruction.h"
+#include "llvm/Scanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using namespace vc4c;
+
+using Clock = std::chrono::steady_clock;
+using Duration = std::chrono::nanoseconds;
+
+//the fastest of these runs is reported, to reduce the influence of other processes
+static constexpr std::size_t NUM_REPETITIONS = 3;
+//the number of instructions per basic block of the synthetic kernels
+static constexpr std::size_t BLOCK_SIZE = 64;
+
+struct MicroBenchmark
+{
+	std::string name;
+	std::vector<std::size_t> sizes;
+	//sets up the input of the given size and returns the time of the measured part only
+	std::function<Duration(std::size_t)> run;
+};
+
+//prevents the compiler from optimizing the benchmarked code away
+static volatile std::size_t sink = 0;
+
+static Duration measure(const std::function<void()>& func)
+{
+	const auto start = Clock::now();
+	func();
+	return std::chrono::duration_cast<Duration>(Clock::now() - start);
+}
+
+/*
+ * Fills the method with a chain of the given number of additions, each using the results of the two previous ones, split into basic blocks
+ */
+static void createInstructions(Method& method, const std::size_t numInstructions)
+{
+	Value previous = method.addNewLocal(TYPE_INT32, "%bench");
+	Value current = method.addNewLocal(TYPE_INT32, "%bench");
+	method.appendToEnd(new intermediate::MoveOperation(previous, INT_ONE));
+	method.appendToEnd(new intermediate::MoveOperation(current, INT_ONE));
+	for(std::size_t i = 0; i < numInstructions; ++i)
+	{
+		if(i % BLOCK_SIZE == 0)
+			method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, "%bench_block." + std::to_string(i))));
+		const Value next = method.addNewLocal(TYPE_INT32, "%bench");
+		method.appendToEnd(new intermediate::Operation("add", next, previous, current));
+		previous = current;
+		current = next;
+	}
+}
+
+static Duration benchmarkAddNewLocal(const std::size_t size)
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	return measure([&]()
+	{
+		for(std::size_t i = 0; i < size; ++i)
+			method.addNewLocal(TYPE_INT32, "%bench");
+	});
+}
+
+static Duration benchmarkFindLocal(const std::size_t size)
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	std::vector<std::string> names;
+	names.reserve(size);
+	for(std::size_t i = 0; i < size; ++i)
+		names.push_back(method.addNewLocal(TYPE_INT32, "%bench").local->name);
+	std::reverse(names.begin(), names.end());
+	return measure([&]()
+	{
+		for(const std::string& name : names)
+			sink += method.findLocal(name) != nullptr;
+	});
+}
+
+static Duration benchmarkInstructionWalker(const std::size_t size)
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	createInstructions(method, size);
+	return measure([&]()
+	{
+		std::size_t count = 0;
+		InstructionWalker it = method.walkAllInstructions();
+		while(!it.isEndOfMethod())
+		{
+			count += it.get() != nullptr;
+			it.nextInMethod();
+		}
+		sink += count;
+	});
+}
+
+static Duration benchmarkHashValue(const std::size_t size)
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	std::vector<Value> values;
+	values.reserve(size);
+	for(std::size_t i = 0; i < size; ++i)
+		values.push_back(i % 2 == 0 ? method.addNewLocal(TYPE_INT32, "%bench") : Value(Literal(static_cast<long>(i)), TYPE_INT32));
+	return measure([&]()
+	{
+		std::size_t result = 0;
+		for(const Value& val : values)
+			result ^= vc4c::hash<Value>{}(val);
+		sink += result;
+	});
+}
+
+static Duration benchmarkLocalUsers(const std::size_t size)
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	Local* local = method.addNewLocal(TYPE_INT32, "%bench").local;
+	std::vector<std::unique_ptr<intermediate::IntermediateInstruction>> users;
+	users.reserve(size);
+	for(std::size_t i = 0; i < size; ++i)
+		users.emplace_back(new intermediate::MoveOperation(NOP_REGISTER, INT_ONE));
+	return measure([&]()
+	{
+		for(const auto& user : users)
+			local->addUser(*user, LocalUser::Type::READER);
+		for(const auto& user : users)
+			local->removeUser(*user, LocalUser::Type::READER);
+	});
+}
+
+static Duration benchmarkGraphColoring(const std::size_t size)
+{
+	Configuration config;
+	Module module(config);
+	Method method(module);
+	createInstructions(method, size);
+	return measure([&]()
+	{
+		qpu_asm::GraphColoring coloring(method, method.walkAllInstructions());
+		sink += coloring.colorGraph();
+	});
+}
+
+static Duration benchmarkScanner(const std::size_t size)
+{
+	std::ostringstream text;
+	for(std::size_t i = 0; i < size; ++i)
+		text << "%tmp." << i << " = add nsw i32 %a." << i << ", 17\n";
+	const std::string input = text.str();
+	return measure([&]()
+	{
+		std::istringstream stream(input);
+		llvm2qasm::Scanner scanner(stream);
+		std::size_t count = 0;
+		while(scanner.pop().type != llvm2qasm::TokenType::EMPTY)
+			++count;
+		sink += count;
+	});
+}
+
+void runMicroBenchmarks(std::ostream& stream, const std::string& filter)
+{
+	//the SPIR-V callbacks are not covered, since they are internal to the SPIR-V front-end and require a valid module
+	const std::vector<MicroBenchmark> benchmarks = {
+			{"Method::addNewLocal", {1000, 10000, 100000}, benchmarkAddNewLocal},
+			{"Method::findLocal", {1000, 10000, 100000}, benchmarkFindLocal},
+			{"InstructionWalker::nextInMethod", {1000, 10000, 100000}, benchmarkInstructionWalker},
+			{"hash<Value>", {1000, 10000, 100000}, benchmarkHashValue},
+			{"Local::addUser/removeUser", {100, 1000, 10000}, benchmarkLocalUsers},
+			{"GraphColoring::colorGraph", {100, 1000, 10000}, benchmarkGraphColoring},
+			{"Scanner::pop", {1000, 10000, 100000}, benchmarkScanner}
+	};
+	stream << "{\"micro_benchmarks\": [" << std::endl;
+	bool isFirst = true;
+	for(const MicroBenchmark& benchmark : benchmarks)
+	{
+		if(benchmark.name.find(filter) == std::string::npos)
+			continue;
+		for(const std::size_t size : benchmark.sizes)
+		{
+			Duration fastest = Duration::max();
+			for(std::size_t i = 0; i < NUM_REPETITIONS; ++i)
+				fastest = std::min(fastest, benchmark.run(size));
+			stream << (isFirst ? "" : ",\n") << "{\"name\": \"" << benchmark.name << "\", \"size\": " << size << ", \"time_us\": " << fastest.count() / 1000
+					<< ", \"ns_per_element\": " << static_cast<double>(fastest.count()) / static_cast<double>(size) << "}";
+			isFirst = false;
+		}
+	}
+	stream << std::endl << "]}" << std::endl;
+}
@@ -0,0 +1,21 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef MICROBENCHMARKS_H
+#define MICROBENCHMARKS_H
+
+#include <ostream>
+#include <string>
+
+/*
+ * Runs the micro-benchmarks of the core data-structures and helpers (with the name containing the filter) on synthetic inputs of growing size.
+ *
+ * For every benchmark and input size, the fastest of several runs is written as a line of JSON with the time per element,
+ * so the scaling with the size of the kernel can be seen directly.
+ */
+void runMicroBenchmarks(std::ostream& stream, const std::string& filter);
+
+#endif /* MICROBENCHMARKS_H */
@@ -0,0 +1,312 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "ThreadScaling.h"
+
+#include "Compiler.h"
+#include "RegressionKernels.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace vc4c;
+
+static const std::vector<std::string> CORPUS_DIRECTORIES = {"./testing/OpenCV", "./testing/ViennaCL", "./testing/MIOpen"};
+
+struct ScalingProgram
+{
+	std::string file;
+	std::string options;
+};
+
+struct LockSample
+{
+	uint64_t numAcquisitions = 0;
+	uint64_t numContended = 0;
+	//per compilation, in microseconds
+	double waitTime = 0.0;
+};
+
+/*
+ * The results of all programs compiled with a single thread count
+ */
+struct ScalingSample
+{
+	//the median compilation time of every program in microseconds, negative if the program failed to compile
+	std::vector<double> times;
+	std::map<std::string, LockSample> locks;
+};
+
+#ifdef MULTI_THREADED
+/*
+ * Only programs with multiple kernels can be compiled in parallel
+ */
+static std::vector<ScalingProgram> findPrograms(const std::string& filter)
+{
+	std::vector<ScalingProgram> programs;
+	for(const std::string& directory : CORPUS_DIRECTORIES)
+	{
+		DIR* dir = opendir(directory.data());
+		if(dir == nullptr)
+			continue;
+		while(const dirent* entry = readdir(dir))
+		{
+			const std::string name = entry->d_name;
+			if(name.size() < 3 || name.compare(name.size() - 3, 3, ".cl") != 0)
+				continue;
+			const std::string file = directory + "/" + name;
+			if(file.find(filter) == std::string::npos)
+				continue;
+			std::ifstream in(file);
+			std::stringstream source;
+			source << in.rdbuf();
+			const std::string content = source.str();
+			std::size_t numKernels = 0;
+			for(std::size_t pos = content.find("__kernel"); pos != std::string::npos; pos = content.find("__kernel", pos + 1))
+				++numKernels;
+			if(numKernels < 2)
+				continue;
+			//the options (e.g. defines) required to compile the program are taken from the regression tests
+			std::string options;
+			for(const auto& tuple : allKernels)
+			{
+				if(std::get<2>(tuple) == file)
+					options = std::get<3>(tuple);
+			}
+			programs.push_back(ScalingProgram{file, options});
+		}
+		closedir(dir);
+	}
+	std::sort(programs.begin(), programs.end(), [](const ScalingProgram& first, const ScalingProgram& second) -> bool { return first.file < second.file;});
+	return programs;
+}
+
+static double getMedian(std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+/*
+ * Runs in the child process: compiles all programs and writes the times and the lock statistics, one per line
+ */
+static std::string measurePrograms(const std::vector<ScalingProgram>& programs, const std::size_t numRuns)
+{
+	std::ostringstream result;
+	for(std::size_t i = 0; i < programs.size(); ++i)
+	{
+		std::vector<double> samples;
+		for(std::size_t run = 0; run < numRuns; ++run)
+		{
+			std::ifstream in(programs[i].file);
+			std::ostringstream out;
+			const auto start = std::chrono::steady_clock::now();
+			try
+			{
+				Compiler::compile(in, out, Configuration{}, programs[i].options, programs[i].file);
+			}
+			catch(const CompilationError&)
+			{
+				samples.clear();
+				break;
+			}
+			const auto end = std::chrono::steady_clock::now();
+			samples.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()));
+		}
+		result << "program " << i << " " << (samples.empty() ? -1.0 : getMedian(samples)) << std::endl;
+	}
+	for(const threading::LockStatistics* lock : threading::getLockStatistics())
+		result << "lock " << lock->numAcquisitions << " " << lock->numContended << " " << lock->waitTime << " " << lock->name << std::endl;
+	return result.str();
+}
+
+static bool measureInChild(const std::vector<ScalingProgram>& programs, const std::size_t numThreads, const std::size_t numRuns, ScalingSample& sample)
+{
+	int fds[2];
+	if(pipe(fds) != 0)
+		return false;
+	const pid_t pid = fork();
+	if(pid < 0)
+		return false;
+	if(pid == 0)
+	{
+		close(fds[0]);
+		setenv("VC4C_THREADS", std::to_string(numThreads).data(), 1);
+		const std::string result = measurePrograms(programs, numRuns);
+		std::size_t written = 0;
+		while(written < result.size())
+		{
+			const ssize_t count = write(fds[1], result.data() + written, result.size() - written);
+			if(count <= 0)
+				break;
+			written += static_cast<std::size_t>(count);
+		}
+		close(fds[1]);
+		//skips the static destructors, e.g. joining the worker threads of the pool
+		_exit(0);
+	}
+	close(fds[1]);
+	std::string output;
+	char buffer[4096];
+	ssize_t count = 0;
+	while((count = read(fds[0], buffer, sizeof(buffer))) > 0)
+		output.append(buffer, static_cast<std::size_t>(count));
+	close(fds[0]);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return false;
+
+	sample.times.assign(programs.size(), -1.0);
+	std::istringstream lines(output);
+	std::string type;
+	while(lines >> type)
+	{
+		if(type == "program")
+		{
+			std::size_t index = 0;
+			double time = 0.0;
+			lines >> index >> time;
+			if(index < sample.times.size())
+				sample.times[index] = time;
+		}
+		else if(type == "lock")
+		{
+			LockSample lock;
+			uint64_t waitTime = 0;
+			std::string name;
+			lines >> lock.numAcquisitions >> lock.numContended >> waitTime;
+			std::getline(lines >> std::ws, name);
+			lock.waitTime = static_cast<double>(waitTime) / 1000.0 / static_cast<double>(numRuns);
+			sample.locks[name] = lock;
+		}
+	}
+	return true;
+}
+
+static void writeArray(std::ostream& stream, const std::vector<double>& values)
+{
+	stream << "[";
+	for(std::size_t i = 0; i < values.size(); ++i)
+		stream << (i == 0 ? "" : ", ") << values[i];
+	stream << "]";
+}
+#endif
+
+bool runThreadScaling(std::ostream& stream, const std::string& filter, const std::size_t numRuns)
+{
+#ifndef MULTI_THREADED
+	std::cerr << "The compiler was built without MULTI_THREADED, nothing to scale" << std::endl;
+	return false;
+#else
+	const std::vector<ScalingProgram> programs = findPrograms(filter);
+	if(programs.empty())
+	{
+		std::cerr << "No programs with multiple kernels found, needs to run from the project root" << std::endl;
+		return false;
+	}
+	std::vector<std::size_t> threadCounts = {1, 2, 4, std::max(std::thread::hardware_concurrency(), 1u)};
+	std::sort(threadCounts.begin(), threadCounts.end());
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	std::vector<ScalingSample> samples;
+	for(const std::size_t numThreads : threadCounts)
+	{
+		std::cerr << "Compiling " << programs.size() << " programs with " << numThreads << " threads" << std::endl;
+		ScalingSample sample;
+		if(!measureInChild(programs, numThreads, numRuns, sample))
+		{
+			std::cerr << "Failed to measure with " << numThreads << " threads" << std::endl;
+			return false;
+		}
+		samples.push_back(sample);
+	}
+
+	//one program per line, like the other benchmarks
+	stream << "{\"runs\": " << numRuns << ", \"threads\": [";
+	for(std::size_t i = 0; i < threadCounts.size(); ++i)
+		stream << (i == 0 ? "" : ", ") << threadCounts[i];
+	stream << "], \"programs\": [" << std::endl;
+	std::vector<double> totalTimes(threadCounts.size(), 0.0);
+	for(std::size_t p = 0; p < programs.size(); ++p)
+	{
+		const bool success = std::all_of(samples.begin(), samples.end(), [p](const ScalingSample& sample) -> bool { return sample.times[p] >= 0.0;});
+		std::vector<double> times;
+		std::vector<double> speedups;
+		std::vector<double> efficiencies;
+		for(std::size_t t = 0; t < threadCounts.size(); ++t)
+		{
+			const double time = std::max(samples[t].times[p], 0.0);
+			const double speedup = success && time > 0.0 ? samples[0].times[p] / time : 0.0;
+			times.push_back(time);
+			speedups.push_back(speedup);
+			efficiencies.push_back(speedup / static_cast<double>(threadCounts[t]));
+			if(success)
+				totalTimes[t] += time;
+		}
+		stream << "{\"file\": \"" << programs[p].file << "\", \"options\": \"" << programs[p].options << "\", \"success\": " << (success ? "true" : "false") << ", \"time\": ";
+		writeArray(stream, times);
+		stream << ", \"speedup\": ";
+		writeArray(stream, speedups);
+		stream << ", \"efficiency\": ";
+		writeArray(stream, efficiencies);
+		stream << "}," << std::endl;
+	}
+	//the programs which failed with any thread count are not part of the total
+	std::vector<double> totalSpeedups;
+	std::vector<double> totalEfficiencies;
+	for(std::size_t t = 0; t < threadCounts.size(); ++t)
+	{
+		totalSpeedups.push_back(totalTimes[t] > 0.0 ? totalTimes[0] / totalTimes[t] : 0.0);
+		totalEfficiencies.push_back(totalSpeedups.back() / static_cast<double>(threadCounts[t]));
+	}
+	stream << "{\"file\": \"total\", \"options\": \"\", \"success\": true, \"time\": ";
+	writeArray(stream, totalTimes);
+	stream << ", \"speedup\": ";
+	writeArray(stream, totalSpeedups);
+	stream << ", \"efficiency\": ";
+	writeArray(stream, totalEfficiencies);
+	stream << "}" << std::endl << "], \"locks\": [" << std::endl;
+	//the wait-time is given per compilation of the whole corpus in microseconds
+	const std::map<std::string, LockSample>& locks = samples.back().locks;
+	for(auto it = locks.begin(); it != locks.end(); ++it)
+	{
+		std::vector<double> acquisitions;
+		std::vector<double> contended;
+		std::vector<double> waitTimes;
+		for(const ScalingSample& sample : samples)
+		{
+			const auto lockIt = sample.locks.find(it->first);
+			const LockSample lock = lockIt == sample.locks.end() ? LockSample{} : lockIt->second;
+			acquisitions.push_back(static_cast<double>(lock.numAcquisitions));
+			contended.push_back(static_cast<double>(lock.numContended));
+			waitTimes.push_back(lock.waitTime);
+		}
+		stream << "{\"name\": \"" << it->first << "\", \"acquisitions\": ";
+		writeArray(stream, acquisitions);
+		stream << ", \"contended\": ";
+		writeArray(stream, contended);
+		stream << ", \"wait_time\": ";
+		writeArray(stream, waitTimes);
+		stream << "}" << (std::next(it) != locks.end() ? "," : "") << std::endl;
+	}
+	stream << "]}" << std::endl;
+	return true;
+#endif
+}
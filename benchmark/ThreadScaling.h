@@ -0,0 +1,24 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef THREADSCALING_H
+#define THREADSCALING_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+/*
+ * Compiles the programs with multiple kernels of the OpenCV, ViennaCL and MIOpen corpora (with the file name containing the filter)
+ * with 1, 2, 4 and the hardware concurrency of worker threads and writes the median compilation times, the speedup and parallel efficiency
+ * compared to a single thread and the time waited for the contended locks as JSON.
+ *
+ * Since the global thread-pool is sized once per process, every thread count is measured in a child process.
+ * This needs to be called before anything is compiled in this process.
+ */
+bool runThreadScaling(std::ostream& stream, const std::string& filter, std::size_t numRuns);
+
+#endif /* THREADSCALING_H */
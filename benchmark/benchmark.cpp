@@ -0,0 +1,499 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Compiler.h"
+#include "CompilationBudget.h"
+#include "KernelGenerator.h"
+#include "MicroBenchmarks.h"
+#include "RegressionKernels.h"
+#include "ThreadScaling.h"
+
+#include "../lib/cpplog/include/logger.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace vc4c;
+
+/*
+ * Compiles every passing kernel of the regression-test corpus several times and reports the median and 95th percentile of the compilation times
+ * per phase, the peak memory usage and the quality of the generated code (summed over all kernels of the program) as JSON.
+ *
+ * If a baseline (in the format written by this program) is given, the results are compared to it and the program fails,
+ * if the median of any phase, the peak memory or any code metric of any program regressed by more than the threshold.
+ */
+
+static constexpr std::size_t NUM_PHASES = 7;
+static const std::array<std::string, NUM_PHASES> PHASE_NAMES = {"precompilation", "parsing", "preparation", "optimization", "code_generation", "output", "total"};
+//differences in compilation time below this are considered noise
+static constexpr double MIN_TIME_DIFFERENCE_US = 1000.0;
+
+struct PhaseStatistics
+{
+	double median = 0.0;
+	double p95 = 0.0;
+};
+
+struct BenchmarkResult
+{
+	std::string file;
+	std::string options;
+	bool success = false;
+	std::array<PhaseStatistics, NUM_PHASES> phases;
+	//the peak resident memory of the process after compiling the kernel, since the compilations run in-process this only grows over the corpus
+	std::size_t peakMemory = 0;
+	//the metrics of the generated code, e.g. the number of instructions or the estimated cycles. Smaller values are better, except for the dual-issue ratio
+	std::map<std::string, double> code;
+};
+
+static const std::string DUAL_ISSUE_RATIO = "dual_issue_ratio";
+
+static void printHelp()
+{
+	std::cout << "Usage: BenchmarkVC4C [options]" << std::endl;
+	std::cout << "Runs from the project root and compiles the regression-test corpus, writing the statistics as JSON" << std::endl;
+	std::cout << "\t--runs <n>\t\tcompiles every kernel n times (default 5)" << std::endl;
+	std::cout << "\t--filter <text>\t\tonly compiles kernels with the text in the file name" << std::endl;
+	std::cout << "\t--output <file>\t\twrites the results into the file instead of the standard output" << std::endl;
+	std::cout << "\t--baseline <file>\tcompares the results to the given baseline and fails on regressions" << std::endl;
+	std::cout << "\t--threshold <percent>\tthe regression allowed before failing (default 10)" << std::endl;
+	std::cout << "\t--micro\t\t\truns the micro-benchmarks of the core data-structures (filtered by name) instead of compiling the corpus" << std::endl;
+	std::cout << "\t--stress <parameter>\tcompiles generated kernels with growing values of the parameter (one of blocks, length, locals, loops, width)" << std::endl;
+	std::cout << "\t\t\t\tinstead of the corpus and writes the median time per phase and the peak memory as table, e.g. for gnuplot:" << std::endl;
+	std::cout << "\t\t\t\tplot 'stress.dat' using 1:5 with lines title 'optimization'" << std::endl;
+	std::cout << "\t--stress-limit <n>\tthe largest value of the stressed parameter (default 1024, 16 for width)" << std::endl;
+	std::cout << "\t--scaling\t\tcompiles the programs with multiple kernels of the OpenCV, ViennaCL and MIOpen corpora (filtered by file name) with 1, 2, 4 and all" << std::endl;
+	std::cout << "\t\t\t\thardware threads and writes the speedup, parallel efficiency and the time waited for locks instead of compiling the corpus" << std::endl;
+}
+
+static double getPercentile(std::vector<double> samples, const double percentile)
+{
+	if(samples.empty())
+		return 0.0;
+	std::sort(samples.begin(), samples.end());
+	//nearest-rank method
+	const std::size_t rank = static_cast<std::size_t>(std::ceil(percentile * static_cast<double>(samples.size())));
+	return samples[std::max(rank, std::size_t{1}) - 1];
+}
+
+static std::string escapeJSON(const std::string& text)
+{
+	std::string result;
+	for(const char c : text)
+	{
+		if(c == '"' || c == '\\')
+			result.push_back('\\');
+		result.push_back(c);
+	}
+	return result;
+}
+
+static std::map<std::string, double> getCodeMetrics(const CompilationMetrics& metrics)
+{
+	std::map<std::string, double> code;
+	std::size_t numALUInstructions = 0;
+	double numDualIssued = 0.0;
+	for(const KernelMetrics& kernel : metrics.kernels)
+	{
+		code["machine_instructions"] += static_cast<double>(kernel.machineInstructions);
+		code["nops"] += static_cast<double>(kernel.numNops);
+		for(const auto& pair : kernel.nopsByReason)
+			code["nops_" + pair.first] += static_cast<double>(pair.second);
+		code["dma_loads"] += static_cast<double>(kernel.numDMALoads);
+		code["dma_stores"] += static_cast<double>(kernel.numDMAStores);
+		code["mutex_acquisitions"] += static_cast<double>(kernel.numMutexAcquisitions);
+		code["estimated_cycles"] += static_cast<double>(kernel.estimatedCycles);
+		code["registers"] = std::max(code["registers"], static_cast<double>(kernel.numRegisters));
+		code["spilled_locals"] += static_cast<double>(kernel.numSpilledLocals);
+		//weighted by the number of ALU instructions of the kernel
+		const std::size_t aluInstructions = kernel.machineInstructions - kernel.numNops;
+		numALUInstructions += aluInstructions;
+		numDualIssued += kernel.dualIssueRatio * static_cast<double>(aluInstructions);
+	}
+	code[DUAL_ISSUE_RATIO] = numALUInstructions == 0 ? 0.0 : numDualIssued / static_cast<double>(numALUInstructions);
+	return code;
+}
+
+/*
+ * Compiles the given file (or the source code, if given, named by the file) the given number of times
+ */
+static BenchmarkResult runBenchmark(const std::string& file, const std::string& options, const std::size_t numRuns, const std::string* source = nullptr)
+{
+	BenchmarkResult result;
+	result.file = file;
+	result.options = options;
+	std::array<std::vector<double>, NUM_PHASES> samples;
+	for(std::size_t run = 0; run < numRuns; ++run)
+	{
+		std::ifstream in;
+		std::istringstream sourceIn;
+		if(source != nullptr)
+			sourceIn.str(*source);
+		else
+			in.open(file);
+		std::ostringstream out;
+		CompilationMetrics metrics;
+		const auto start = std::chrono::steady_clock::now();
+		try
+		{
+			if(source != nullptr)
+				Compiler::compile(sourceIn, out, Configuration{}, options, {}, &metrics);
+			else
+				Compiler::compile(in, out, Configuration{}, options, file, &metrics);
+		}
+		catch(const CompilationError& e)
+		{
+			std::cerr << "Failed to compile '" << file << "': " << e.what() << std::endl;
+			return result;
+		}
+		const auto end = std::chrono::steady_clock::now();
+		std::chrono::microseconds optimizationTime{0};
+		std::chrono::microseconds codeGenerationTime{0};
+		for(const KernelMetrics& kernel : metrics.kernels)
+		{
+			optimizationTime += kernel.optimizationTime;
+			codeGenerationTime += kernel.codeGenerationTime;
+		}
+		const std::array<std::chrono::microseconds, NUM_PHASES> times = {metrics.precompilationTime, metrics.parsingTime, metrics.preparationTime, optimizationTime,
+				codeGenerationTime, metrics.outputTime, std::chrono::duration_cast<std::chrono::microseconds>(end - start)};
+		for(std::size_t i = 0; i < NUM_PHASES; ++i)
+			samples[i].push_back(static_cast<double>(times[i].count()));
+		//the generated code is the same for every run
+		result.code = getCodeMetrics(metrics);
+	}
+	for(std::size_t i = 0; i < NUM_PHASES; ++i)
+	{
+		result.phases[i].median = getPercentile(samples[i], 0.5);
+		result.phases[i].p95 = getPercentile(samples[i], 0.95);
+	}
+	result.peakMemory = getPeakMemoryUsage();
+	result.success = true;
+	return result;
+}
+
+static void writeResults(std::ostream& stream, const std::vector<BenchmarkResult>& results, const std::size_t numRuns)
+{
+	//one kernel per line, so the baseline can be read back without a JSON parser
+	stream << "{\"runs\": " << numRuns << ", \"kernels\": [" << std::endl;
+	for(std::size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		stream << "{\"file\": \"" << escapeJSON(result.file) << "\", \"options\": \"" << escapeJSON(result.options) << "\", \"success\": " << (result.success ? "true" : "false")
+				<< ", \"peak_memory\": " << result.peakMemory;
+		for(std::size_t p = 0; p < NUM_PHASES; ++p)
+			stream << ", \"" << PHASE_NAMES[p] << "\": [" << result.phases[p].median << ", " << result.phases[p].p95 << "]";
+		stream << ", \"code\": {";
+		for(auto it = result.code.begin(); it != result.code.end(); ++it)
+			stream << (it == result.code.begin() ? "" : ", ") << "\"" << it->first << "\": " << it->second;
+		stream << "}}" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	stream << "]}" << std::endl;
+}
+
+/*
+ * Compiles kernels generated with the stressed parameter doubled from run to run (loop depth is increased by one),
+ * to find the phases growing super-linearly with the size of the kernel
+ */
+static bool runStressTest(std::ostream& stream, const std::string& parameter, std::size_t limit, const std::size_t numRuns)
+{
+	static const std::map<std::string, std::size_t GeneratorParameters::*> PARAMETERS = {
+			{"blocks", &GeneratorParameters::numBlocks},
+			{"length", &GeneratorParameters::blockLength},
+			{"locals", &GeneratorParameters::numLocals},
+			{"loops", &GeneratorParameters::loopDepth},
+			{"width", &GeneratorParameters::vectorWidth}
+	};
+	const auto it = PARAMETERS.find(parameter);
+	if(it == PARAMETERS.end())
+	{
+		std::cerr << "Unknown parameter to stress: " << parameter << std::endl;
+		return false;
+	}
+	//the vector-width is limited by the hardware
+	if(parameter == "width")
+		limit = std::min(limit, std::size_t{16});
+	stream << "# " << parameter;
+	for(const std::string& phase : PHASE_NAMES)
+		stream << " " << phase;
+	stream << " peak_memory" << std::endl;
+	for(std::size_t size = 1; size <= limit; size = parameter == "loops" ? size + 1 : size * 2)
+	{
+		GeneratorParameters params;
+		params.*(it->second) = size;
+		const std::string source = generateKernel(params);
+		const std::string name = "stress_" + parameter + "_" + std::to_string(size);
+		std::cerr << "Benchmarking " << name << std::endl;
+		const BenchmarkResult result = runBenchmark(name, "", numRuns, &source);
+		if(!result.success)
+			return false;
+		stream << size;
+		for(const PhaseStatistics& phase : result.phases)
+			stream << " " << phase.median;
+		stream << " " << result.peakMemory << std::endl;
+	}
+	return true;
+}
+
+static Optional<std::string> readString(const std::string& line, const std::string& key)
+{
+	const std::string prefix = "\"" + key + "\": \"";
+	std::size_t pos = line.find(prefix);
+	if(pos == std::string::npos)
+		return {};
+	std::string value;
+	for(pos += prefix.size(); pos < line.size() && line[pos] != '"'; ++pos)
+	{
+		if(line[pos] == '\\')
+			++pos;
+		if(pos < line.size())
+			value.push_back(line[pos]);
+	}
+	return value;
+}
+
+static Optional<double> readNumber(const std::string& line, const std::string& key, const std::size_t index = 0)
+{
+	const std::string prefix = "\"" + key + "\": ";
+	std::size_t pos = line.find(prefix);
+	if(pos == std::string::npos)
+		return {};
+	pos += prefix.size();
+	if(line[pos] == '[')
+	{
+		++pos;
+		for(std::size_t i = 0; i < index; ++i)
+			pos = line.find(',', pos) + 1;
+	}
+	return std::strtod(line.data() + pos, nullptr);
+}
+
+static std::map<std::string, double> readCodeMetrics(const std::string& line)
+{
+	std::map<std::string, double> code;
+	const std::string prefix = "\"code\": {";
+	std::size_t pos = line.find(prefix);
+	if(pos == std::string::npos)
+		return code;
+	pos += prefix.size();
+	while(pos < line.size() && line[pos] == '"')
+	{
+		const std::size_t end = line.find('"', pos + 1);
+		const std::string key = line.substr(pos + 1, end - pos - 1);
+		char* next = nullptr;
+		code[key] = std::strtod(line.data() + end + 2, &next);
+		pos = static_cast<std::size_t>(next - line.data());
+		if(line.compare(pos, 2, ", ") == 0)
+			pos += 2;
+	}
+	return code;
+}
+
+static std::map<std::pair<std::string, std::string>, BenchmarkResult> readBaseline(std::istream& stream)
+{
+	std::map<std::pair<std::string, std::string>, BenchmarkResult> baseline;
+	std::string line;
+	while(std::getline(stream, line))
+	{
+		const Optional<std::string> file = readString(line, "file");
+		const Optional<std::string> options = readString(line, "options");
+		if(!file || !options)
+			continue;
+		BenchmarkResult result;
+		result.file = file.get();
+		result.options = options.get();
+		result.success = line.find("\"success\": true") != std::string::npos;
+		result.peakMemory = static_cast<std::size_t>(readNumber(line, "peak_memory").orElse(0.0));
+		for(std::size_t p = 0; p < NUM_PHASES; ++p)
+		{
+			result.phases[p].median = readNumber(line, PHASE_NAMES[p], 0).orElse(0.0);
+			result.phases[p].p95 = readNumber(line, PHASE_NAMES[p], 1).orElse(0.0);
+		}
+		result.code = readCodeMetrics(line);
+		baseline.emplace(std::make_pair(result.file, result.options), result);
+	}
+	return baseline;
+}
+
+/*
+ * Returns the number of regressions of the results compared to the baseline
+ */
+static std::size_t compareToBaseline(const std::vector<BenchmarkResult>& results, const std::map<std::pair<std::string, std::string>, BenchmarkResult>& baseline, const double threshold)
+{
+	std::size_t numRegressions = 0;
+	for(const BenchmarkResult& result : results)
+	{
+		const auto it = baseline.find(std::make_pair(result.file, result.options));
+		if(it == baseline.end())
+		{
+			std::cerr << "No baseline for '" << result.file << "', skipping comparison" << std::endl;
+			continue;
+		}
+		const BenchmarkResult& base = it->second;
+		if(base.success && !result.success)
+		{
+			std::cerr << "REGRESSION: '" << result.file << "' no longer compiles" << std::endl;
+			++numRegressions;
+			continue;
+		}
+		if(!base.success || !result.success)
+			continue;
+		for(std::size_t p = 0; p < NUM_PHASES; ++p)
+		{
+			const double difference = result.phases[p].median - base.phases[p].median;
+			if(difference > MIN_TIME_DIFFERENCE_US && difference > base.phases[p].median * threshold)
+			{
+				std::cerr << "REGRESSION: '" << result.file << "' " << PHASE_NAMES[p] << " median " << base.phases[p].median << "us -> " << result.phases[p].median << "us" << std::endl;
+				++numRegressions;
+			}
+		}
+		if(static_cast<double>(result.peakMemory) > static_cast<double>(base.peakMemory) * (1.0 + threshold))
+		{
+			std::cerr << "REGRESSION: '" << result.file << "' peak memory " << base.peakMemory << " -> " << result.peakMemory << " bytes" << std::endl;
+			++numRegressions;
+		}
+		for(const auto& pair : result.code)
+		{
+			const auto baseIt = base.code.find(pair.first);
+			const double baseValue = baseIt == base.code.end() ? 0.0 : baseIt->second;
+			const bool isRegression = pair.first == DUAL_ISSUE_RATIO ? pair.second < baseValue * (1.0 - threshold) :
+					(pair.second - baseValue >= 1.0 && pair.second > baseValue * (1.0 + threshold));
+			if(isRegression)
+			{
+				std::cerr << "REGRESSION: '" << result.file << "' " << pair.first << " " << baseValue << " -> " << pair.second << std::endl;
+				++numRegressions;
+			}
+			else if(pair.second != baseValue)
+				std::cerr << "Changed: '" << result.file << "' " << pair.first << " " << baseValue << " -> " << pair.second << std::endl;
+		}
+	}
+	return numRegressions;
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t numRuns = 5;
+	double threshold = 0.1;
+	std::string filter;
+	std::string outputFile;
+	std::string baselineFile;
+	bool runMicro = false;
+	bool runScaling = false;
+	std::string stressParameter;
+	std::size_t stressLimit = 1024;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp("--help", argv[i]) == 0 || strcmp("-h", argv[i]) == 0)
+		{
+			printHelp();
+			return 0;
+		}
+		else if(strcmp("--micro", argv[i]) == 0)
+			runMicro = true;
+		else if(strcmp("--scaling", argv[i]) == 0)
+			runScaling = true;
+		else if(i + 1 >= argc)
+		{
+			std::cerr << "Missing value for option: " << argv[i] << std::endl;
+			printHelp();
+			return 1;
+		}
+		else if(strcmp("--runs", argv[i]) == 0)
+			numRuns = std::max(std::strtoul(argv[++i], nullptr, 10), 1ul);
+		else if(strcmp("--filter", argv[i]) == 0)
+			filter = argv[++i];
+		else if(strcmp("--output", argv[i]) == 0)
+			outputFile = argv[++i];
+		else if(strcmp("--baseline", argv[i]) == 0)
+			baselineFile = argv[++i];
+		else if(strcmp("--threshold", argv[i]) == 0)
+			threshold = std::strtod(argv[++i], nullptr) / 100.0;
+		else if(strcmp("--stress", argv[i]) == 0)
+			stressParameter = argv[++i];
+		else if(strcmp("--stress-limit", argv[i]) == 0)
+			stressLimit = std::max(std::strtoul(argv[++i], nullptr, 10), 1ul);
+		else
+		{
+			std::cerr << "Unknown option: " << argv[i] << std::endl;
+			printHelp();
+			return 1;
+		}
+	}
+
+	//only output errors
+	logging::LOGGER.reset(new logging::ConsoleLogger(logging::Level::WARNING));
+	//every run needs to actually compile the kernel
+	setenv("VC4C_CACHE_DIR", "", 1);
+
+	if(runScaling)
+	{
+		if(outputFile.empty())
+			return runThreadScaling(std::cout, filter, numRuns) ? 0 : 1;
+		std::ofstream out(outputFile);
+		return runThreadScaling(out, filter, numRuns) ? 0 : 1;
+	}
+
+	if(runMicro)
+	{
+		if(outputFile.empty())
+			runMicroBenchmarks(std::cout, filter);
+		else
+		{
+			std::ofstream out(outputFile);
+			runMicroBenchmarks(out, filter);
+		}
+		return 0;
+	}
+
+	if(!stressParameter.empty())
+	{
+		if(outputFile.empty())
+			return runStressTest(std::cout, stressParameter, stressLimit, numRuns) ? 0 : 1;
+		std::ofstream out(outputFile);
+		return runStressTest(out, stressParameter, stressLimit, numRuns) ? 0 : 1;
+	}
+
+	std::vector<BenchmarkResult> results;
+	for(const auto& tuple : allKernels)
+	{
+		if(std::get<0>(tuple) != PASSED || std::get<2>(tuple).find(filter) == std::string::npos)
+			continue;
+		std::cerr << "Benchmarking " << std::get<2>(tuple) << std::endl;
+		results.push_back(runBenchmark(std::get<2>(tuple), std::get<3>(tuple), numRuns));
+	}
+
+	if(outputFile.empty())
+		writeResults(std::cout, results, numRuns);
+	else
+	{
+		std::ofstream out(outputFile);
+		writeResults(out, results, numRuns);
+	}
+
+	if(!baselineFile.empty())
+	{
+		std::ifstream in(baselineFile);
+		if(!in)
+		{
+			std::cerr << "Failed to open baseline: " << baselineFile << std::endl;
+			return 1;
+		}
+		const std::size_t numRegressions = compareToBaseline(results, readBaseline(in), threshold);
+		if(numRegressions > 0)
+		{
+			std::cerr << numRegressions << " regressions compared to the baseline" << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,470 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Compiler.h"
+
+#include "../lib/cpplog/include/logger.h"
+
+#define CL_TARGET_OPENCL_VERSION 120
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+#include <CL/cl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace vc4c;
+
+/*
+ * Compiles the peak-performance kernels of clpeak and mixbench (from testing/) with every selected optimization level and runs them
+ * on the device via the OpenCL run-time (e.g. VC4CL), reporting the achieved compute throughput, memory bandwidth and launch latency as JSON.
+ *
+ * In contrast to the compile-time benchmark, this measures the effect of compiler changes on the actual execution of the generated code.
+ */
+
+enum class KernelType
+{
+	//clpeak compute kernels, parameters (output buffer, scalar)
+	COMPUTE_FLOAT,
+	COMPUTE_INTEGER,
+	//clpeak global bandwidth kernels, parameters (input buffer, output buffer)
+	BANDWIDTH,
+	//mixbench kernel, parameters (scalar seed, buffer)
+	MIXED
+};
+
+struct DeviceKernel
+{
+	std::string name;
+	KernelType type;
+	//the number of elements of the vector type of the kernel (clpeak) or the memory ratio (mixbench)
+	unsigned width;
+	//the arithmetic operations and the bytes read/written from/to memory by a single work-item
+	double opsPerItem;
+	double bytesPerItem;
+};
+
+struct DeviceProgram
+{
+	std::string file;
+	std::string options;
+	std::vector<DeviceKernel> kernels;
+};
+
+struct DeviceResult
+{
+	std::string file;
+	std::string options;
+	std::string kernel;
+	std::string level;
+	bool success = false;
+	std::size_t machineInstructions = 0;
+	//the median and the 95th percentile of the execution time of all work-groups, in microseconds
+	double median = 0.0;
+	double p95 = 0.0;
+	//the median time of executing a single work-group (including enqueuing and waiting for the kernel), in microseconds
+	double launchLatency = 0.0;
+	//in giga operations (floating-point or integer) per second and giga bytes per second
+	double gops = 0.0;
+	double bandwidth = 0.0;
+	bool isFloat = false;
+};
+
+//clpeak executes the same number of operations per work-item for every vector width
+static constexpr double CLPEAK_OPS_PER_ITEM = 4096.0;
+//the number of elements read per work-item by the clpeak bandwidth kernels
+static constexpr unsigned CLPEAK_FETCH_PER_ITEM = 16;
+//the iterations of the mixbench kernel (COMP_ITERATIONS / UNROLL_ITERATIONS) and the operations unrolled per iteration
+static constexpr double MIXBENCH_ITERATIONS = 8192.0 / 32.0;
+static constexpr unsigned MIXBENCH_UNROLL = 32;
+//the number of elements (UNROLLED_MEMORY_ACCESSES) of the mixbench buffer per work-item and half of the buffer
+static constexpr unsigned MIXBENCH_ELEMENTS_PER_ITEM = 16;
+
+static const std::vector<std::pair<std::string, OptimizationLevel>> LEVELS = {
+		{"basic", OptimizationLevel::BASIC}, {"medium", OptimizationLevel::MEDIUM}, {"full", OptimizationLevel::FULL}, {"size", OptimizationLevel::SIZE}
+};
+
+static void printHelp()
+{
+	std::cout << "Usage: DeviceBenchmarkVC4C [options]" << std::endl;
+	std::cout << "Runs from the project root on the device, compiles the clpeak and mixbench kernels and executes them via OpenCL, writing the results as JSON" << std::endl;
+	std::cout << "\t--runs <n>\t\texecutes every kernel n times (default 10)" << std::endl;
+	std::cout << "\t--filter <text>\t\tonly runs kernels with the text in the kernel name" << std::endl;
+	std::cout << "\t--level <level>\t\tonly compiles with the given optimization level (one of basic, medium, full, size), can be given multiple times" << std::endl;
+	std::cout << "\t--groups <n>\t\tthe number of work-groups per execution (default 1024)" << std::endl;
+	std::cout << "\t--local-size <n>\tthe number of work-items per work-group (default 12)" << std::endl;
+	std::cout << "\t--platform <n>\t\tthe index of the OpenCL platform to use (default 0)" << std::endl;
+	std::cout << "\t--output <file>\t\twrites the results into the file instead of the standard output" << std::endl;
+}
+
+static std::vector<DeviceProgram> getPrograms(const unsigned localSize)
+{
+	std::vector<DeviceProgram> programs;
+	const std::vector<unsigned> widths = {1, 2, 4, 8, 16};
+	DeviceProgram computeFloat{"./testing/clpeak/compute_sp_kernels.cl", "", {}};
+	DeviceProgram computeInteger{"./testing/clpeak/compute_integer_kernels.cl", "", {}};
+	DeviceProgram bandwidth{"./testing/clpeak/global_bandwidth_kernels.cl", "", {}};
+	for(const unsigned width : widths)
+	{
+		computeFloat.kernels.push_back(DeviceKernel{"compute_sp_v" + std::to_string(width), KernelType::COMPUTE_FLOAT, width, CLPEAK_OPS_PER_ITEM, sizeof(float)});
+		computeInteger.kernels.push_back(DeviceKernel{"compute_integer_v" + std::to_string(width), KernelType::COMPUTE_INTEGER, width, CLPEAK_OPS_PER_ITEM, sizeof(int32_t)});
+		bandwidth.kernels.push_back(DeviceKernel{"global_bandwidth_v" + std::to_string(width) + "_local_offset", KernelType::BANDWIDTH, width, 0.0,
+			static_cast<double>((CLPEAK_FETCH_PER_ITEM * width + 1) * sizeof(float))});
+		bandwidth.kernels.push_back(DeviceKernel{"global_bandwidth_v" + std::to_string(width) + "_global_offset", KernelType::BANDWIDTH, width, 0.0,
+			static_cast<double>((CLPEAK_FETCH_PER_ITEM * width + 1) * sizeof(float))});
+	}
+	programs.push_back(computeFloat);
+	programs.push_back(computeInteger);
+	programs.push_back(bandwidth);
+	//mixbench is compiled for several ratios of memory accesses to computations, every memory access replaces an unrolled computation
+	for(const unsigned memoryRatio : {0u, 8u, 16u})
+	{
+		const double opsPerItem = MIXBENCH_ITERATIONS * (MIXBENCH_UNROLL - memoryRatio) * 8 * 2;
+		const double bytesPerItem = MIXBENCH_ITERATIONS * memoryRatio * sizeof(float);
+		programs.push_back(DeviceProgram{"./testing/mixbench/mix_kernels.cl",
+			"-Dclass_T=float -Dblockdim=" + std::to_string(localSize) + " -Dmemory_ratio=" + std::to_string(memoryRatio),
+			{DeviceKernel{"benchmark_func", KernelType::MIXED, memoryRatio, opsPerItem, bytesPerItem}}});
+	}
+	return programs;
+}
+
+static void checkError(const cl_int error, const std::string& function)
+{
+	if(error != CL_SUCCESS)
+		throw std::runtime_error(function + " failed with error " + std::to_string(error));
+}
+
+static double getPercentile(std::vector<double> samples, const double percentile)
+{
+	if(samples.empty())
+		return 0.0;
+	std::sort(samples.begin(), samples.end());
+	//nearest-rank method
+	const std::size_t rank = static_cast<std::size_t>(std::ceil(percentile * static_cast<double>(samples.size())));
+	return samples[std::max(rank, std::size_t{1}) - 1];
+}
+
+static std::string escapeJSON(const std::string& text)
+{
+	std::string result;
+	for(const char c : text)
+	{
+		if(c == '"' || c == '\\')
+			result.push_back('\\');
+		result.push_back(c);
+	}
+	return result;
+}
+
+/*
+ * The OpenCL objects shared by all kernels, released on destruction
+ */
+struct DeviceContext
+{
+	cl_device_id device = nullptr;
+	cl_context context = nullptr;
+	cl_command_queue queue = nullptr;
+	std::string deviceName;
+
+	~DeviceContext()
+	{
+		if(queue != nullptr)
+			clReleaseCommandQueue(queue);
+		if(context != nullptr)
+			clReleaseContext(context);
+	}
+};
+
+static void createContext(DeviceContext& ctx, const unsigned platformIndex)
+{
+	cl_uint numPlatforms = 0;
+	checkError(clGetPlatformIDs(0, nullptr, &numPlatforms), "clGetPlatformIDs");
+	if(platformIndex >= numPlatforms)
+		throw std::runtime_error("No OpenCL platform with index " + std::to_string(platformIndex));
+	std::vector<cl_platform_id> platforms(numPlatforms);
+	checkError(clGetPlatformIDs(numPlatforms, platforms.data(), nullptr), "clGetPlatformIDs");
+	checkError(clGetDeviceIDs(platforms[platformIndex], CL_DEVICE_TYPE_ALL, 1, &ctx.device, nullptr), "clGetDeviceIDs");
+	char name[256] = {0};
+	checkError(clGetDeviceInfo(ctx.device, CL_DEVICE_NAME, sizeof(name) - 1, name, nullptr), "clGetDeviceInfo");
+	ctx.deviceName = name;
+	cl_int error = CL_SUCCESS;
+	ctx.context = clCreateContext(nullptr, 1, &ctx.device, nullptr, nullptr, &error);
+	checkError(error, "clCreateContext");
+	ctx.queue = clCreateCommandQueue(ctx.context, ctx.device, 0, &error);
+	checkError(error, "clCreateCommandQueue");
+}
+
+/*
+ * Executes the kernel with the given number of work-groups and returns the wall-time in microseconds
+ */
+static double executeKernel(const DeviceContext& ctx, cl_kernel kernel, const std::size_t numGroups, const std::size_t localSize)
+{
+	const std::size_t globalSize = numGroups * localSize;
+	const auto start = std::chrono::steady_clock::now();
+	checkError(clEnqueueNDRangeKernel(ctx.queue, kernel, 1, nullptr, &globalSize, &localSize, 0, nullptr, nullptr), "clEnqueueNDRangeKernel");
+	checkError(clFinish(ctx.queue), "clFinish");
+	const auto end = std::chrono::steady_clock::now();
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+}
+
+static void runKernel(const DeviceContext& ctx, cl_program program, const DeviceKernel& kernelInfo, DeviceResult& result, const std::size_t numRuns,
+		const std::size_t numGroups, const std::size_t localSize)
+{
+	cl_int error = CL_SUCCESS;
+	cl_kernel kernel = clCreateKernel(program, kernelInfo.name.data(), &error);
+	checkError(error, "clCreateKernel");
+	const std::size_t numItems = numGroups * localSize;
+	std::size_t inputSize = 0;
+	std::size_t outputSize = numItems * sizeof(float);
+	if(kernelInfo.type == KernelType::BANDWIDTH)
+		inputSize = numItems * CLPEAK_FETCH_PER_ITEM * kernelInfo.width * sizeof(float);
+	else if(kernelInfo.type == KernelType::MIXED)
+		outputSize = 2 * numItems * MIXBENCH_ELEMENTS_PER_ITEM * sizeof(float);
+	std::vector<cl_mem> buffers;
+	try
+	{
+		buffers.push_back(clCreateBuffer(ctx.context, CL_MEM_READ_WRITE, outputSize, nullptr, &error));
+		checkError(error, "clCreateBuffer");
+		const float floatValue = 1.3f;
+		const int32_t intValue = 4;
+		switch(kernelInfo.type)
+		{
+			case KernelType::COMPUTE_FLOAT:
+				checkError(clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffers[0]), "clSetKernelArg");
+				checkError(clSetKernelArg(kernel, 1, sizeof(floatValue), &floatValue), "clSetKernelArg");
+				break;
+			case KernelType::COMPUTE_INTEGER:
+				checkError(clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffers[0]), "clSetKernelArg");
+				checkError(clSetKernelArg(kernel, 1, sizeof(intValue), &intValue), "clSetKernelArg");
+				break;
+			case KernelType::BANDWIDTH:
+			{
+				buffers.push_back(clCreateBuffer(ctx.context, CL_MEM_READ_ONLY, inputSize, nullptr, &error));
+				checkError(error, "clCreateBuffer");
+				const float zero = 0.0f;
+				checkError(clEnqueueFillBuffer(ctx.queue, buffers[1], &zero, sizeof(zero), 0, inputSize, 0, nullptr, nullptr), "clEnqueueFillBuffer");
+				checkError(clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffers[1]), "clSetKernelArg");
+				checkError(clSetKernelArg(kernel, 1, sizeof(cl_mem), &buffers[0]), "clSetKernelArg");
+				break;
+			}
+			case KernelType::MIXED:
+				checkError(clSetKernelArg(kernel, 0, sizeof(floatValue), &floatValue), "clSetKernelArg");
+				checkError(clSetKernelArg(kernel, 1, sizeof(cl_mem), &buffers[0]), "clSetKernelArg");
+				break;
+		}
+		checkError(clFinish(ctx.queue), "clFinish");
+
+		//the first execution is not measured, since it may include uploading the code
+		executeKernel(ctx, kernel, numGroups, localSize);
+		std::vector<double> samples;
+		std::vector<double> latencies;
+		for(std::size_t run = 0; run < numRuns; ++run)
+		{
+			samples.push_back(executeKernel(ctx, kernel, numGroups, localSize));
+			latencies.push_back(executeKernel(ctx, kernel, 1, localSize));
+		}
+		result.median = getPercentile(samples, 0.5);
+		result.p95 = getPercentile(samples, 0.95);
+		result.launchLatency = getPercentile(latencies, 0.5);
+		//operations per microsecond are mega operations per second
+		if(result.median > 0.0)
+		{
+			result.gops = kernelInfo.opsPerItem * static_cast<double>(numItems) / result.median / 1000.0;
+			result.bandwidth = kernelInfo.bytesPerItem * static_cast<double>(numItems) / result.median / 1000.0;
+		}
+		result.success = true;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "Failed to run '" << kernelInfo.name << "': " << e.what() << std::endl;
+	}
+	for(cl_mem buffer : buffers)
+	{
+		if(buffer != nullptr)
+			clReleaseMemObject(buffer);
+	}
+	clReleaseKernel(kernel);
+}
+
+static void runProgram(const DeviceContext& ctx, const DeviceProgram& program, const std::string& level, const OptimizationLevel optimizationLevel,
+		const std::string& filter, const std::size_t numRuns, const std::size_t numGroups, const std::size_t localSize, std::vector<DeviceResult>& results)
+{
+	std::vector<const DeviceKernel*> kernels;
+	for(const DeviceKernel& kernel : program.kernels)
+	{
+		if(kernel.name.find(filter) != std::string::npos)
+			kernels.push_back(&kernel);
+	}
+	if(kernels.empty())
+		return;
+	std::cerr << "Benchmarking " << program.file << " " << program.options << " (" << level << ")" << std::endl;
+	std::vector<DeviceResult> programResults;
+	for(const DeviceKernel* kernel : kernels)
+	{
+		DeviceResult result;
+		result.file = program.file;
+		result.options = program.options;
+		result.kernel = kernel->name;
+		result.level = level;
+		result.isFloat = kernel->type != KernelType::COMPUTE_INTEGER;
+		programResults.push_back(result);
+	}
+
+	Configuration config;
+	config.setOptimizationLevel(optimizationLevel);
+	config.outputMode = OutputMode::BINARY;
+	std::ifstream in(program.file);
+	std::ostringstream out;
+	CompilationMetrics metrics;
+	try
+	{
+		Compiler::compile(in, out, config, program.options, program.file, &metrics);
+	}
+	catch(const CompilationError& e)
+	{
+		std::cerr << "Failed to compile '" << program.file << "': " << e.what() << std::endl;
+		results.insert(results.end(), programResults.begin(), programResults.end());
+		return;
+	}
+	for(DeviceResult& result : programResults)
+	{
+		for(const KernelMetrics& kernel : metrics.kernels)
+		{
+			if(kernel.name == result.kernel)
+				result.machineInstructions = kernel.machineInstructions;
+		}
+	}
+
+	const std::string binary = out.str();
+	const std::size_t binarySize = binary.size();
+	const unsigned char* binaryData = reinterpret_cast<const unsigned char*>(binary.data());
+	cl_int error = CL_SUCCESS;
+	cl_program clProgram = clCreateProgramWithBinary(ctx.context, 1, &ctx.device, &binarySize, &binaryData, nullptr, &error);
+	if(error == CL_SUCCESS)
+		error = clBuildProgram(clProgram, 1, &ctx.device, "", nullptr, nullptr);
+	if(error != CL_SUCCESS)
+		std::cerr << "Failed to load the program '" << program.file << "' with error " << error << std::endl;
+	else
+	{
+		for(std::size_t i = 0; i < kernels.size(); ++i)
+			runKernel(ctx, clProgram, *kernels[i], programResults[i], numRuns, numGroups, localSize);
+	}
+	if(clProgram != nullptr)
+		clReleaseProgram(clProgram);
+	results.insert(results.end(), programResults.begin(), programResults.end());
+}
+
+static void writeResults(std::ostream& stream, const std::vector<DeviceResult>& results, const std::string& deviceName, const std::size_t numRuns,
+		const std::size_t numGroups, const std::size_t localSize)
+{
+	//one kernel per line, like the compile-time benchmark
+	stream << "{\"device\": \"" << escapeJSON(deviceName) << "\", \"runs\": " << numRuns << ", \"groups\": " << numGroups << ", \"local_size\": " << localSize
+			<< ", \"kernels\": [" << std::endl;
+	for(std::size_t i = 0; i < results.size(); ++i)
+	{
+		const DeviceResult& result = results[i];
+		stream << "{\"file\": \"" << escapeJSON(result.file) << "\", \"options\": \"" << escapeJSON(result.options) << "\", \"kernel\": \"" << escapeJSON(result.kernel)
+				<< "\", \"level\": \"" << result.level << "\", \"success\": " << (result.success ? "true" : "false") << ", \"machine_instructions\": " << result.machineInstructions
+				<< ", \"time\": [" << result.median << ", " << result.p95 << "], \"launch_latency\": " << result.launchLatency
+				<< ", \"" << (result.isFloat ? "gflops" : "giops") << "\": " << result.gops << ", \"bandwidth\": " << result.bandwidth << "}"
+				<< (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	stream << "]}" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t numRuns = 10;
+	std::size_t numGroups = 1024;
+	std::size_t localSize = 12;
+	unsigned platformIndex = 0;
+	std::string filter;
+	std::string outputFile;
+	std::vector<std::pair<std::string, OptimizationLevel>> levels;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp("--help", argv[i]) == 0 || strcmp("-h", argv[i]) == 0)
+		{
+			printHelp();
+			return 0;
+		}
+		else if(i + 1 >= argc)
+		{
+			std::cerr << "Missing value for option: " << argv[i] << std::endl;
+			printHelp();
+			return 1;
+		}
+		else if(strcmp("--runs", argv[i]) == 0)
+			numRuns = std::max(std::strtoul(argv[++i], nullptr, 10), 1ul);
+		else if(strcmp("--filter", argv[i]) == 0)
+			filter = argv[++i];
+		else if(strcmp("--groups", argv[i]) == 0)
+			numGroups = std::max(std::strtoul(argv[++i], nullptr, 10), 1ul);
+		else if(strcmp("--local-size", argv[i]) == 0)
+			localSize = std::max(std::strtoul(argv[++i], nullptr, 10), 1ul);
+		else if(strcmp("--platform", argv[i]) == 0)
+			platformIndex = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if(strcmp("--output", argv[i]) == 0)
+			outputFile = argv[++i];
+		else if(strcmp("--level", argv[i]) == 0)
+		{
+			const std::string name = argv[++i];
+			const auto it = std::find_if(LEVELS.begin(), LEVELS.end(), [&name](const std::pair<std::string, OptimizationLevel>& level) -> bool { return level.first == name;});
+			if(it == LEVELS.end())
+			{
+				std::cerr << "Unknown optimization level: " << name << std::endl;
+				return 1;
+			}
+			levels.push_back(*it);
+		}
+		else
+		{
+			std::cerr << "Unknown option: " << argv[i] << std::endl;
+			printHelp();
+			return 1;
+		}
+	}
+	if(levels.empty())
+		levels = LEVELS;
+
+	//only output errors
+	logging::LOGGER.reset(new logging::ConsoleLogger(logging::Level::WARNING));
+	//the metrics of the generated code are only collected when actually compiling the kernels
+	setenv("VC4C_CACHE_DIR", "", 1);
+
+	DeviceContext ctx;
+	try
+	{
+		createContext(ctx, platformIndex);
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "Failed to set up the OpenCL device: " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::vector<DeviceResult> results;
+	for(const DeviceProgram& program : getPrograms(static_cast<unsigned>(localSize)))
+	{
+		for(const auto& level : levels)
+			runProgram(ctx, program, level.first, level.second, filter, numRuns, numGroups, localSize, results);
+	}
+
+	if(outputFile.empty())
+		writeResults(std::cout, results, ctx.deviceName, numRuns, numGroups, localSize);
+	else
+	{
+		std::ofstream out(outputFile);
+		writeResults(out, results, ctx.deviceName, numRuns, numGroups, localSize);
+	}
+	return std::all_of(results.begin(), results.end(), [](const DeviceResult& result) -> bool { return result.success;}) ? 0 : 1;
+}
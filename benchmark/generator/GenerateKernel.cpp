@@ -0,0 +1,80 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "../KernelGenerator.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+/*
+ * Writes a synthetic kernel of the given shape as LLVM IR, e.g. to reproduce the scaling of a compilation phase with VC4C directly
+ */
+
+static void printHelp()
+{
+	std::cout << "Usage: GenerateKernelVC4C [options]" << std::endl;
+	std::cout << "Writes the LLVM IR of a synthetic kernel with the given shape" << std::endl;
+	std::cout << "\t--blocks <n>\t\tthe number of basic blocks (default 4)" << std::endl;
+	std::cout << "\t--length <n>\t\tthe number of instructions per basic block (default 16)" << std::endl;
+	std::cout << "\t--locals <n>\t\tthe number of values live over the whole kernel (default 8)" << std::endl;
+	std::cout << "\t--loops <n>\t\tthe number of nested loops (default 1)" << std::endl;
+	std::cout << "\t--width <n>\t\tthe vector-width, one of 1, 2, 3, 4, 8 or 16 (default 4)" << std::endl;
+	std::cout << "\t--output <file>\t\twrites the kernel into the file instead of the standard output" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	GeneratorParameters params;
+	std::string outputFile;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp("--help", argv[i]) == 0 || strcmp("-h", argv[i]) == 0)
+		{
+			printHelp();
+			return 0;
+		}
+		else if(i + 1 >= argc)
+		{
+			std::cerr << "Missing value for option: " << argv[i] << std::endl;
+			printHelp();
+			return 1;
+		}
+		else if(strcmp("--output", argv[i]) == 0)
+			outputFile = argv[++i];
+		else if(strcmp("--blocks", argv[i]) == 0)
+			params.numBlocks = std::strtoul(argv[++i], nullptr, 10);
+		else if(strcmp("--length", argv[i]) == 0)
+			params.blockLength = std::strtoul(argv[++i], nullptr, 10);
+		else if(strcmp("--locals", argv[i]) == 0)
+			params.numLocals = std::strtoul(argv[++i], nullptr, 10);
+		else if(strcmp("--loops", argv[i]) == 0)
+			params.loopDepth = std::strtoul(argv[++i], nullptr, 10);
+		else if(strcmp("--width", argv[i]) == 0)
+			params.vectorWidth = std::strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			std::cerr << "Unknown option: " << argv[i] << std::endl;
+			printHelp();
+			return 1;
+		}
+	}
+	if(params.vectorWidth != 1 && params.vectorWidth != 2 && params.vectorWidth != 3 && params.vectorWidth != 4 && params.vectorWidth != 8 && params.vectorWidth != 16)
+	{
+		std::cerr << "Unsupported vector-width: " << params.vectorWidth << std::endl;
+		return 1;
+	}
+
+	if(outputFile.empty())
+		std::cout << generateKernel(params);
+	else
+	{
+		std::ofstream out(outputFile);
+		out << generateKernel(params);
+	}
+	return 0;
+}
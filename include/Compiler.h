@@ -10,9 +10,11 @@
 #define COMPILER_H
 
 #include "./config.h"
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <map>
+#include <vector>
 
 #include "Precompiler.h"
 
@@ -34,6 +36,118 @@ namespace vc4c
 		SEVERE = 'S'
 	};
 
+	/*
+	 * The statistics of compiling a single kernel, e.g. to track the quality of the generated code across compiler versions
+	 */
+	struct KernelMetrics
+	{
+		std::string name;
+		std::chrono::microseconds optimizationTime{0};
+		std::chrono::microseconds codeGenerationTime{0};
+		//the number of intermediate instructions before and after the kernel-specific optimizations
+		std::size_t instructionsBefore = 0;
+		std::size_t instructionsAfter = 0;
+		//the number of generated machine-code instructions, including the NOPs
+		std::size_t machineInstructions = 0;
+		std::size_t numNops = 0;
+		//the ratio of ALU instructions utilizing both ALUs
+		double dualIssueRatio = 0.0;
+		//the number of physical registers (excluding the accumulators) used
+		unsigned numRegisters = 0;
+		//the number of locals spilled into the VPM by the register allocator
+		std::size_t numSpilledLocals = 0;
+		//the number of bytes of VPM reserved by the kernel
+		std::size_t vpmBytes = 0;
+		//the number of rounds of the graph-coloring register allocator (see REGISTER_RESOLVER_MAX_ROUNDS), zero for the linear-scan allocator
+		std::size_t registerAllocationRounds = 0;
+		//the number of NOPs inserted for every reason (e.g. "wait_register", "branch_delay"), which could not be replaced by the instruction scheduler
+		std::map<std::string, std::size_t> nopsByReason;
+		//the number of DMA transfers started from/to memory and the number of instructions acquiring the hardware mutex
+		std::size_t numDMALoads = 0;
+		std::size_t numDMAStores = 0;
+		std::size_t numMutexAcquisitions = 0;
+		//the cycles of a single execution of every instruction, as estimated by the static cycle estimator
+		std::size_t estimatedCycles = 0;
+	};
+
+	/*
+	 * The statistics of compiling a single program
+	 */
+	struct CompilationMetrics
+	{
+		//whether the code was taken from the compilation cache (or generated by the compilation server), then no other metrics are available
+		bool fromCache = false;
+		std::chrono::microseconds precompilationTime{0};
+		std::chrono::microseconds parsingTime{0};
+		//the time of the target-independent preparation of the whole module
+		std::chrono::microseconds preparationTime{0};
+		std::chrono::microseconds outputTime{0};
+		std::vector<KernelMetrics> kernels;
+	};
+
+	/*
+	 * A single program to be compiled by Compiler#compileAll
+	 */
+	struct CompilationJob
+	{
+		std::istream* input;
+		std::ostream* output;
+		Configuration config;
+		std::string options;
+		Optional<std::string> inputFile;
+	};
+
+	/*
+	 * The outcome of a single program compiled by Compiler#compileAll
+	 */
+	struct CompilationResult
+	{
+		bool success = false;
+		std::size_t bytesWritten = 0;
+		//the error message, if the compilation failed
+		std::string error;
+		CompilationMetrics metrics;
+	};
+
+	/*
+	 * The storage of the compilation cache entries (see Compiler#setCacheBackend), e.g. a local directory or a cache shared by many devices.
+	 *
+	 * The keys are calculated from the contents of the input, the options, the configuration and the compiler version,
+	 * so the entries can be shared between all devices running the same compiler version.
+	 * The entries are validated when read, so a backend does not need to check the contents of the entries it returns.
+	 */
+	class CompilationCacheBackend
+	{
+	public:
+		virtual ~CompilationCacheBackend();
+
+		/*
+		 * Returns the entry stored for the key, if any
+		 */
+		virtual Optional<std::string> read(const std::string& key) = 0;
+		/*
+		 * Stores the entry for the key, errors are only logged
+		 */
+		virtual void write(const std::string& key, const std::string& entry) = 0;
+	};
+
+	/*
+	 * Creates a cache backend storing the entries as files in the given directory, which can also be located on a file-system shared by multiple devices
+	 */
+	std::shared_ptr<CompilationCacheBackend> createDirectoryCacheBackend(const std::string& directory);
+	/*
+	 * Creates a cache backend reading the entries from "<url>/<key>" via HTTP(S) GET requests and storing them via HTTP PUT requests.
+	 * The requests are executed by the curl executable
+	 */
+	std::shared_ptr<CompilationCacheBackend> createHTTPCacheBackend(const std::string& url);
+	/*
+	 * Creates a cache backend looking up the entries in the local backend (if any) first and then in the remote backend,
+	 * entries found in the remote backend are stored in the local one.
+	 * New entries are written to the local backend and, if enabled, to the remote backend (e.g. by a build server populating the cache for a fleet of devices)
+	 */
+	std::shared_ptr<CompilationCacheBackend> createLayeredCacheBackend(const std::shared_ptr<CompilationCacheBackend>& local,
+			const std::shared_ptr<CompilationCacheBackend>& remote, bool writeRemote);
+
 	class Compiler
 	{
 	public:
@@ -43,13 +157,91 @@ namespace vc4c
 
 	    Configuration& getConfiguration();
 	    const Configuration& getConfiguration() const;
+	    /*
+	     * Returns the metrics of the last call to #convert()
+	     */
+	    const CompilationMetrics& getMetrics() const;
+
+	    /*
+	     * Compiles the input into the output and returns the number of bytes written. If metrics is given, the statistics of the compilation are written into it
+	     */
+	    static std::size_t compile(std::istream& input, std::ostream& output, const Configuration config = {}, const std::string& options = "", const Optional<std::string>& inputFile = {},
+	    		CompilationMetrics* metrics = nullptr);
 
-	    static std::size_t compile(std::istream& input, std::ostream& output, const Configuration config = {}, const std::string& options = "", const Optional<std::string>& inputFile = {});
+	    /*
+	     * Compiles all given programs, scheduled in parallel on the global thread-pool.
+	     *
+	     * The programs share the worker-threads and the compilation caches. An error compiling one program does not abort the others,
+	     * instead the result of every program is reported in the order of the jobs.
+	     */
+	    static std::vector<CompilationResult> compileAll(const std::vector<CompilationJob>& jobs);
+
+	    /*
+	     * Compiles the same program with every given configuration, writing the code for the configuration into the output with the same index.
+	     *
+	     * The program is pre-compiled and parsed only once, every variant is then optimized and generated in parallel in its own copy of the parsed module.
+	     * An error in one variant does not abort the others. Throws a CompilationError, if the shared pre-compilation or parsing fails.
+	     */
+	    static std::vector<CompilationResult> compileVariants(std::istream& input, const std::vector<std::ostream*>& outputs, const std::vector<Configuration>& configs,
+	    		const std::string& options = "", const Optional<std::string>& inputFile = {});
+
+	    /*
+	     * Sets the storage of the compilation cache used by all compilations, nullptr disables the cache.
+	     *
+	     * Defaults to the backend configured via the environment-variables VC4C_CACHE_DIR and VC4C_REMOTE_CACHE (see CompilationCache.h)
+	     */
+	    static void setCacheBackend(const std::shared_ptr<CompilationCacheBackend>& backend);
+	    static std::shared_ptr<CompilationCacheBackend> getCacheBackend();
 
 	private:
 	    std::istream& input;
 	    std::ostream& output;
 	    Configuration config;
+	    CompilationMetrics metrics;
+	};
+
+	/*
+	 * A program whose kernels are only optimized and converted to machine code when they are requested for the first time.
+	 *
+	 * The input is pre-compiled, parsed and prepared (the module-wide optimizations) on construction,
+	 * so the cost of building a program with many kernels is reduced to the kernels actually used.
+	 * The calls to the member functions are serialized, so the object can be shared between threads.
+	 */
+	class LazyCompilation
+	{
+	public:
+		/*
+		 * Throws a CompilationError, if the pre-compilation, parsing or preparation fails
+		 */
+		LazyCompilation(std::istream& input, const Configuration& config = {}, const std::string& options = "", const Optional<std::string>& inputFile = {});
+		LazyCompilation(const LazyCompilation&) = delete;
+		~LazyCompilation();
+
+		LazyCompilation& operator=(const LazyCompilation&) = delete;
+
+		/*
+		 * Returns the names of all kernels of the program
+		 */
+		std::vector<std::string> getKernelNames() const;
+		/*
+		 * Whether the kernel was already optimized and converted to machine code
+		 */
+		bool isCompiled(const std::string& kernelName) const;
+		/*
+		 * Optimizes the kernel and converts it to machine code, if this was not yet done, and returns the statistics of its compilation.
+		 * Throws a CompilationError, if the program has no kernel with the given name or the compilation of the kernel fails
+		 */
+		KernelMetrics compileKernel(const std::string& kernelName);
+		/*
+		 * Writes the program containing all kernels compiled so far and returns the number of bytes written.
+		 *
+		 * The program is also stored in the compilation cache, as compiled for the configuration with only these kernels selected (see Configuration#selectedKernels)
+		 */
+		std::size_t writeOutput(std::ostream& output);
+
+	private:
+		struct State;
+		std::unique_ptr<State> state;
 	};
 
 	/*
@@ -57,6 +249,26 @@ namespace vc4c
 	 * This defaults to logging to the console
 	 */
 	void setLogger(std::wostream& outputStream, const bool coloredOutput, const LogLevel level = LogLevel::WARNING);
+
+	/*
+	 * Sets the minimum level of the messages written for the compilations run by the current thread while this object exists,
+	 * including the parts of these compilations run in the background.
+	 * Thus, concurrent compilations can use different log-levels without replacing the global logger.
+	 *
+	 * NOTE: The global logger still discards all messages below its own level (see setLogger)
+	 */
+	class LogLevelScope
+	{
+	public:
+		explicit LogLevelScope(LogLevel level);
+		LogLevelScope(const LogLevelScope&) = delete;
+		~LogLevelScope();
+
+		LogLevelScope& operator=(const LogLevelScope&) = delete;
+
+	private:
+		unsigned previousSeverity;
+	};
 }
 
 #endif /* COMPILER_H */
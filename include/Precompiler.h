@@ -45,7 +45,19 @@ namespace vc4c
 
 		static SourceType getSourceType(std::istream& stream);
 
-		static void linkSourceCode(const std::unordered_map<std::istream*, Optional<std::string>>& inputs, std::ostream& output);
+		/*
+		 * Links the modules into a single SPIR-V module. The modules not already in SPIR-V binary (e.g. objects created by #compileObject) are pre-compiled with the given options first.
+		 *
+		 * If createLibrary is set, not all symbols need to be resolved and the result can be used as object for further linking.
+		 * The functions called across modules are inlined when the linked module is compiled
+		 */
+		static void linkSourceCode(const std::unordered_map<std::istream*, Optional<std::string>>& inputs, std::ostream& output, const std::string& options = "", bool createLibrary = false);
+		/*
+		 * Separately compiles a single module into a linkable object (a SPIR-V binary exporting its functions), which can be linked with other objects via #linkSourceCode.
+		 *
+		 * This allows to compile e.g. a library of helper-functions once and only re-compile the modules changed
+		 */
+		static void compileObject(std::istream& input, std::ostream& output, const std::string& options = "", const Optional<std::string>& inputFile = {});
 
 	private:
 		std::istream& input;
@@ -25,6 +25,11 @@ extern "C"
         unsigned math_type;
         unsigned output_mode;
         char log_level;
+        unsigned optimization_level;
+        /* the file containing the measured execution counts of the basic blocks (as written by an instrumented compilation with the counts filled in) to guide the optimizations, NULL for none */
+        const char* block_profile_file;
+        /* the generated code of every n-th compilation is checked by the verifier (if built with it), 0 to disable the verification */
+        unsigned verification_interval;
     } configuration;
     
     #define MATH_TYPE_FAST 1
@@ -35,6 +40,11 @@ extern "C"
     #define OUTPUT_HEX 1
     #define OUTPUT_ASSEMBLER 2
 
+    #define OPTIMIZATION_LEVEL_NONE 0
+    #define OPTIMIZATION_LEVEL_BASIC 1
+    #define OPTIMIZATION_LEVEL_MEDIUM 2
+    #define OPTIMIZATION_LEVEL_FULL 3
+
     extern const configuration DEFAULT_CONFIG;
     
     typedef struct _data_storage
@@ -44,11 +54,198 @@ extern "C"
             char* data;
             char* file_name;
         };
+        /*
+         * For an output buffer, the size of the (malloc'ed) buffer. The compiled code is written directly into the buffer,
+         * which is enlarged with realloc() (and this length updated) if it is too small. The output is terminated with a zero byte.
+         */
         unsigned long data_length;
     } storage;
 
     int convert(const storage* in, storage* out, const configuration config, const char* options);
 
+    /*
+     * Compiles the code specialized for the given launch configuration (e.g. the work-item setup is folded into constants).
+     *
+     * The local and global sizes are given for the first num_dimensions dimensions, the global sizes can be NULL.
+     * The resulting code can only be executed with exactly this work-group size (and global size, if given).
+     * Specialized code is cached separately from the generic code of the same program.
+     */
+    int convertSpecialized(const storage* in, storage* out, const configuration config, const char* options, const unsigned num_dimensions, const unsigned* local_sizes, const unsigned* global_sizes);
+
+    /*
+     * Compiles the code with the given scalar parameters of the kernel bound to constant values, the uses of the parameters are folded into the code.
+     *
+     * The values are given as passed by the run-time in the UNIFORMs (e.g. the IEEE 754 bits for float parameters).
+     * The resulting code can only be executed with exactly these parameter values. Specialized code is cached per set of values.
+     */
+    int convertWithParameters(const storage* in, storage* out, const configuration config, const char* options, const char* kernel_name, const unsigned num_parameters, const unsigned* parameter_indices, const unsigned* parameter_values);
+
+    /*
+     * Compiles the SPIR-V code with the given values for its specialization constants (identified by their SpecId decorations), all other constants keep their default values.
+     *
+     * The values are given as the bits in the type of the constant (e.g. the IEEE 754 bits for floating-point constants, zero or non-zero for booleans).
+     * This allows to specialize a SPIR-V binary without running the pre-compiler again. Specialized code is cached per set of values.
+     */
+    int convertWithSpecializationConstants(const storage* in, storage* out, const configuration config, const char* options, const unsigned num_constants, const unsigned* spec_ids,
+            const unsigned long long* values);
+
+    /*
+     * Compiles the code with an additional kernel executing the given kernels after each other, the values passed between the kernels are kept in registers where possible.
+     *
+     * For every kernel, num_parameters contains its number of parameters and parameter_bindings (the parameters of all kernels in a row) the index of the parameter
+     * of the fused kernel passed to each of them. This is only valid, if every work-item only reads the values written by itself in the previous kernels (e.g. element-wise kernels).
+     */
+    int convertWithFusedKernels(const storage* in, storage* out, const configuration config, const char* options, const char* fused_kernel_name, const unsigned num_kernels, const char* const* kernel_names,
+            const unsigned* num_parameters, const unsigned* parameter_bindings);
+
+    /*
+     * The statistics of compiling a single kernel, see convertWithMetrics()
+     */
+    typedef struct _kernel_metrics
+    {
+        char* name;
+        unsigned long optimization_time_us;
+        unsigned long code_generation_time_us;
+        /* the number of intermediate instructions before and after the kernel-specific optimizations */
+        unsigned long instructions_before;
+        unsigned long instructions_after;
+        /* the number of generated machine-code instructions, including the NOPs */
+        unsigned long machine_instructions;
+        unsigned long nop_count;
+        /* the ratio of ALU instructions utilizing both ALUs */
+        double dual_issue_ratio;
+        unsigned registers_used;
+        unsigned long spilled_locals;
+        unsigned long vpm_bytes;
+        /* the number of rounds of the graph-coloring register allocator, zero for the linear-scan allocator */
+        unsigned long register_allocation_rounds;
+        /* the number of DMA transfers from/to memory and of the hardware mutex acquisitions in the generated code */
+        unsigned long dma_loads;
+        unsigned long dma_stores;
+        unsigned long mutex_acquisitions;
+        /* the cycles of a single execution of every instruction, as estimated by the static cycle estimator */
+        unsigned long estimated_cycles;
+    } kernel_metrics;
+
+    /*
+     * The statistics of compiling a single program, see convertWithMetrics()
+     */
+    typedef struct _compilation_metrics
+    {
+        /* whether the code was taken from the compilation cache, then no other metrics are available */
+        unsigned from_cache;
+        unsigned long precompilation_time_us;
+        unsigned long parsing_time_us;
+        unsigned long preparation_time_us;
+        unsigned long output_time_us;
+        unsigned num_kernels;
+        kernel_metrics* kernels;
+    } compilation_metrics;
+
+    /*
+     * Compiles the program like convert() and writes the statistics of the compilation into the metrics.
+     *
+     * The program is always compiled in this process (not via the compilation server), so the metrics are available.
+     * The kernels and their names are allocated by this function and need to be freed with releaseMetrics()
+     */
+    int convertWithMetrics(const storage* in, storage* out, const configuration config, const char* options, compilation_metrics* metrics);
+    /*
+     * Frees the memory allocated for the metrics by convertWithMetrics()
+     */
+    void releaseMetrics(compilation_metrics* metrics);
+
+    /*
+     * Compiles all num_programs inputs into the corresponding outputs in parallel.
+     *
+     * The configurations and options are given per program, options can be NULL.
+     * The result (as returned by convert()) of every program is written into results, a failing program does not abort the others.
+     * Returns 0 (CL_SUCCESS) if all programs were compiled successfully.
+     */
+    int convertAll(const unsigned num_programs, const storage* in, storage* out, const configuration* configs, const char** options, int* results);
+
+    /*
+     * Handle to a compilation running in the background, see convertAsync()
+     */
+    typedef struct _compilation* compilation_handle;
+    /*
+     * Called from the background thread with the result (as returned by convert()) after the compilation has finished or was cancelled.
+     * The handle must not be released from within the callback.
+     */
+    typedef void(*CompilationCallback)(compilation_handle handle, int result, void* user_data);
+
+    /*
+     * Starts the compilation in the background and returns immediately, the callback can be NULL.
+     *
+     * The output storage needs to stay valid until the compilation has finished, the input storage and options are copied.
+     * The returned handle needs to be released with releaseCompilation().
+     */
+    compilation_handle convertAsync(const storage* in, storage* out, const configuration config, const char* options, CompilationCallback callback, void* user_data);
+    /*
+     * Blocks until the compilation has finished and returns its result
+     */
+    int waitForCompilation(compilation_handle handle);
+    /*
+     * Returns 1 if the compilation has finished (or was cancelled), 0 otherwise
+     */
+    int isCompilationFinished(compilation_handle handle);
+    /*
+     * Cancels the compilation. A running compilation is aborted at the next check (e.g. between optimization passes) and fails.
+     * Returns 0 if the compilation is cancelled, -1 if it has already finished
+     */
+    int cancelCompilation(compilation_handle handle);
+    /*
+     * Waits for the compilation to finish and frees the handle
+     */
+    void releaseCompilation(compilation_handle handle);
+
+    /*
+     * Handle to a kernel bundle (as written by "vc4c --bundle") opened by openKernelBundle()
+     */
+    typedef struct _kernel_bundle* bundle_handle;
+    /*
+     * Memory-maps the kernel bundle containing ahead-of-time compiled programs, returns NULL if the file can't be read or is no valid kernel bundle
+     */
+    bundle_handle openKernelBundle(const char* file_name);
+    /*
+     * Calculates the hash of the configuration the programs of a kernel bundle are looked up by.
+     *
+     * For code specialized for a launch configuration (see convertSpecialized()), the local and global sizes are given for the first num_dimensions dimensions,
+     * otherwise (and for the global sizes) NULL can be passed
+     */
+    unsigned long long getConfigurationHash(const configuration config, const unsigned num_dimensions, const unsigned* local_sizes, const unsigned* global_sizes);
+    /*
+     * Looks up the program (including the kernel-infos) containing the kernel compiled for the configuration with the given hash
+     * and writes the pointer to the program into data and its size into length.
+     *
+     * Uncompressed programs are read directly from the mapped bundle. The program stays valid until the bundle is closed.
+     * Returns 0 (CL_SUCCESS) on success and -46 (CL_INVALID_KERNEL_NAME) if the bundle does not contain the kernel for this configuration
+     */
+    int findBundledProgram(bundle_handle bundle, const char* kernel_name, unsigned long long configuration_hash, const char** data, unsigned long* length);
+    /*
+     * Unmaps the kernel bundle and frees all programs returned by findBundledProgram()
+     */
+    void closeKernelBundle(bundle_handle bundle);
+
+    /*
+     * Handle to a program whose kernels are compiled on demand, see createLazyProgram()
+     */
+    typedef struct _lazy_program* lazy_program_handle;
+    /*
+     * Pre-compiles, parses and prepares the program, but does not optimize or generate the code of any kernel yet. Returns NULL on failure.
+     *
+     * The input storage can be released after this call, the returned handle needs to be released with releaseLazyProgram()
+     */
+    lazy_program_handle createLazyProgram(const storage* in, const configuration config, const char* options);
+    /*
+     * Optimizes and generates the code of the kernel, if this was not yet done. Returns 0 (CL_SUCCESS) on success
+     */
+    int compileLazyKernel(lazy_program_handle program, const char* kernel_name);
+    /*
+     * Writes the program containing all kernels compiled so far into the output, returns 0 (CL_SUCCESS) on success
+     */
+    int writeLazyProgram(lazy_program_handle program, storage* out);
+    void releaseLazyProgram(lazy_program_handle program);
+
     typedef void(*CompilationErrorHandler)(const char* message, const unsigned length, void* userData);
     void setErrorHandler(CompilationErrorHandler errorHandler, void* userData);
     
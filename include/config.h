@@ -8,7 +8,11 @@
 #define VC4C_CONFIG_H
 
 #include <stdint.h>
+#include <atomic>
 #include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace vc4c
 {
@@ -26,6 +30,84 @@ namespace vc4c
 	    ASSEMBLER = 2
 	};
 
+	enum class OptimizationLevel
+	{
+	    //only run the optimizations required to generate valid code
+	    NONE = 0,
+	    //run the cheap optimizations, for fast compilation
+	    BASIC = 1,
+	    //run all optimizations once (default)
+	    MEDIUM = 2,
+	    //run all optimizations, repeat them and search larger windows for better code at the cost of compilation time
+	    FULL = 3,
+	    //run the optimizations not increasing the code size and additionally merge duplicate code, for kernels exceeding the instruction cache
+	    SIZE = 4
+	};
+
+	enum class RegisterAllocation
+	{
+	    //graph coloring, which resolves register conflicts and spills locals, if necessary (default)
+	    GRAPH_COLORING = 0,
+	    //linear scan over the live ranges, for fast compilation. Falls back to graph coloring, if the registers can not be assigned
+	    LINEAR_SCAN = 1
+	};
+
+	enum class BudgetExceededAction
+	{
+	    //skip the optional optimization passes and use the faster register allocation, the generated code is valid but less performant (default)
+	    DEGRADE = 0,
+	    //abort the compilation with a CompilationError
+	    ABORT = 1
+	};
+
+	/*
+	 * A scalar kernel parameter bound to a constant value, see Configuration#specializedParameters
+	 */
+	struct ParameterSpecialization
+	{
+	    std::string kernelName;
+	    //the index of the parameter within the parameters of the kernel
+	    unsigned parameterIndex;
+	    //the value as passed by the run-time in the UNIFORM, e.g. the IEEE 754 bits for float parameters
+	    uint32_t value;
+	};
+
+	/*
+	 * The value of a SPIR-V specialization constant, see Configuration#specializationConstants
+	 */
+	struct SpecializationConstant
+	{
+	    //the id of the constant as given by its SpecId decoration
+	    uint32_t specId;
+	    //the bits of the value in the type of the constant, e.g. the IEEE 754 bits for floating-point constants or zero/non-zero for booleans
+	    uint64_t value;
+	};
+
+	/*
+	 * A chain of kernels executed after each other by every work-item, fused into a single kernel, see Configuration#fusedKernels
+	 */
+	struct KernelFusion
+	{
+	    //the name of the fused kernel, which takes the parameters bound to the parameters of the chained kernels
+	    std::string kernelName;
+	    //the kernels in the order of their execution
+	    std::vector<std::string> kernels;
+	    //for every chained kernel, the index of the parameter of the fused kernel passed to each of its parameters.
+	    //Bind the same parameter to the output of one kernel and the input of the next to pass the intermediate values between the kernels
+	    std::vector<std::vector<unsigned>> parameterBindings;
+	};
+
+	/*
+	 * The number of executions of a basic block of a kernel, as measured with an instrumented build (see Configuration#instrumentBlocks)
+	 */
+	struct BlockExecutionCount
+	{
+	    std::string kernelName;
+	    //the name of the label of the basic block
+	    std::string blockLabel;
+	    uint64_t count;
+	};
+
 	/*
 	 * The maximum VPM size to be used (in bytes).
 	 *
@@ -34,6 +116,18 @@ namespace vc4c
 	 */
 	constexpr unsigned VPM_DEFAULT_SIZE = 4 * 1024;
 
+	/*
+	 * Default maximum number of instructions scheduled together when reordering (see Configuration#maxReorderingInstructions).
+	 * This prevents long runs for huge linear programs at the cost of less performant code
+	 */
+	constexpr std::size_t REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK{64};
+
+	/*
+	 * Default maximum number of instructions of a kernel compiled via the fast path (see Configuration#fastPathInstructions).
+	 * The fixed costs of the optimizations and the graph-coloring dominate the compilation time of such tiny kernels
+	 */
+	constexpr std::size_t FAST_PATH_MAX_INSTRUCTIONS{64};
+
 	/*
 	 * Container for user-defined configuration
 	 */
@@ -43,6 +137,111 @@ namespace vc4c
 	    OutputMode outputMode = OutputMode::BINARY;
 	    bool writeKernelInfo = true;
 	    unsigned availableVPMSize = VPM_DEFAULT_SIZE;
+	    //the names of the kernels to compile, if empty, all kernels are compiled
+	    std::vector<std::string> selectedKernels;
+	    //the SPIRV-Tools optimization passes (as named by spirv-opt) run on SPIR-V input, if empty, the optimizer is not run
+	    std::vector<std::string> spirvOptimizationPasses = {
+	    		"freeze-spec-const", "fold-spec-const-op-composite", "unify-const", "eliminate-dead-const",
+				"inline-entry-points-exhaustive", "convert-local-access-chains", "eliminate-local-single-block"
+	    };
+	    //selects the optimization passes to run, the budgets of the optimizations are set via #setOptimizationLevel
+	    OptimizationLevel optimizationLevel = OptimizationLevel::MEDIUM;
+	    //the maximum number of times the repeatable optimization passes are run, until none of them changes the code anymore (1 runs every pass once)
+	    unsigned maxOptimizationIterations = 1;
+	    //the maximum number of consecutive instructions within a basic block which are scheduled together when reordering instructions
+	    std::size_t maxReorderingInstructions = REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK;
+	    //if set, the time and the changes in the number of instructions, NOPs and locals of every optimization pass for every kernel are written as JSON into this file
+	    std::string optimizationReportFile;
+	    //if set, the estimated cycles, stalls and dual-issue ratio of every basic block of every kernel are written as JSON into this file
+	    std::string performanceReportFile;
+	    //if set, the kernels are specialized for this local work-group size (per dimension), e.g. the local sizes are folded into constants.
+	    //The resulting code can only be executed with this work-group size
+	    std::vector<uint32_t> specializedLocalSizes;
+	    //if set (in addition to the local sizes), the kernels are specialized for this global work size (per dimension), e.g. the number of work-groups is folded into constants
+	    std::vector<uint32_t> specializedGlobalSizes;
+	    //the scalar kernel parameters bound to constant values, the uses of the parameters are replaced with the values and folded by the optimizations.
+	    //The resulting code can only be executed with exactly these parameter values (the UNIFORMs are still passed, but ignored)
+	    std::vector<ParameterSpecialization> specializedParameters;
+	    //the values of the SPIR-V specialization constants, applied when parsing SPIR-V input. Constants not listed here keep their default values
+	    std::vector<SpecializationConstant> specializationConstants;
+	    //the chains of kernels to be fused into one kernel each, saving the kernel launches and keeping the intermediate values in registers where possible.
+	    //This is only valid, if every work-item only reads the intermediate values it wrote itself (e.g. element-wise kernels), since the work-items are not synchronized between the kernels
+	    std::vector<KernelFusion> fusedKernels;
+	    //if set, the work-item UNIFORMs not used by a kernel are not read at all. The run-time then needs to only pass the UNIFORMs set in the kernel-info
+	    bool compactUniforms = false;
+	    //if set, the parameters are loaded once for all work-groups executed in a single kernel execution and the group ids are incremented by the kernel itself.
+	    //This allows the run-time to execute many work-groups with a single UNIFORM set, but increases the register pressure
+	    bool batchWorkGroups = false;
+	    //if set, every QPU uses its own part of the VPM as scratch area for DMA accesses, so the accesses do not need to lock the hardware mutex.
+	    //The number of VPM rows per QPU is written into the kernel-info
+	    bool partitionVPM = false;
+	    //the register allocator to use, set via #setOptimizationLevel
+	    RegisterAllocation registerAllocation = RegisterAllocation::GRAPH_COLORING;
+	    //kernels with at most this many instructions (before the optimizations) are compiled via the fast path: only the minimal optimization passes are run,
+	    //the registers are allocated by the linear-scan register allocator and no extra thread is started. 0 disables the fast path, set via #setOptimizationLevel
+	    std::size_t fastPathInstructions = FAST_PATH_MAX_INSTRUCTIONS;
+	    //if set, the kernels are compiled to run in both hardware threads of a QPU: only the lower half of the physical register-files is used,
+	    //the thread is switched while waiting for TMU loads and the kernels are marked as threadable in the kernel-info
+	    bool threadedExecution = false;
+	    //if set, the binary output is written as indexed container with a table of the offsets and sizes of the kernel-infos, the global data and the code of every kernel,
+	    //so the run-time can look up and load single kernels (see qpu_asm/Container.h). Only applies to OutputMode#BINARY
+	    bool indexedContainer = false;
+	    //if set, the kernel-info is written in the compact format with the resource-usage statistics of the kernel (see KernelInfo#COMPACT_FORMAT).
+	    //The compact format needs to be supported by the run-time
+	    bool compactKernelInfo = false;
+	    //whether the compact kernel-info contains the names of the kernel and its parameters (always written in the default format)
+	    bool kernelInfoNames = true;
+	    //if set, the kernels count the executions of their basic blocks in a buffer passed by the run-time as additional last parameter (see KernelInfo#BLOCK_PROFILE_PARAMETER).
+	    //Every QPU uses its own part of the buffer, the run-time needs to sum up the counts of all QPUs
+	    bool instrumentBlocks = false;
+	    //the maximum number of 32-bit constants per kernel, which are passed by the run-time as additional UNIFORMs after the parameters (see KernelInfo#UNIFORM_CONSTANT_PARAMETER)
+	    //instead of being loaded in every iteration of the loops they are used in. The constants are read once and occupy a register for the whole kernel. 0 disables
+	    unsigned maxUniformConstants = 0;
+	    //the maximum size (in bytes) of a __constant lookup table (e.g. the S-boxes of a cipher), which is copied into the VPM once at the start of the kernel.
+	    //The lookups with dynamic indices then read the VPM instead of accessing the memory via DMA or the TMUs. 0 disables
+	    unsigned maxPreloadedTableSize = 0;
+	    //if set, the vector parameters of kernels with at least 16 vector elements in total are not passed as one UNIFORM per element, but in a buffer
+	    //whose address is passed as single UNIFORM after the parameters (see KernelInfo#PARAMETER_BUFFER_PARAMETER) and which is read with a single DMA access.
+	    //The parameters passed this way are marked in the kernel-info, the run-time needs to support this
+	    bool bufferVectorParameters = false;
+	    //if set, the labels of the basic blocks counted by the instrumented kernels are written into this file (see optimizations::writeBlockLayout)
+	    std::string blockLayoutFile;
+	    //the execution counts of the basic blocks measured with an instrumented build (see optimizations::readBlockProfile).
+	    //Replaces the static estimates of the block frequencies for loop-unrolling, if-conversion, the placement of blocks, instruction reordering and the spill costs
+	    std::vector<BlockExecutionCount> blockProfile;
+	    //the budgets for compiling a single program, 0 disables the budget. What happens on exceeding a budget is set via #budgetExceededAction
+	    //the maximum wall-time (in milliseconds) from the start of the compilation (excluding the pre-compilation)
+	    unsigned maxCompilationTime = 0;
+	    //the maximum peak memory usage (in bytes) of the whole process
+	    std::size_t maxMemoryUsage = 0;
+	    //the maximum size (in bytes) of the process-wide cache of the simplified bodies of the called (non-kernel) methods, which is shared by all compilations
+	    //(e.g. of the compile server), so the helper functions contained in several programs are only simplified once. 0 disables
+	    std::size_t functionCacheSize = 0;
+	    //the generated code of every n-th compilation of this process is checked by the verifier (if the compiler was built with it), 0 disables the verification.
+	    //The code of a kernel is verified concurrently to the code generation of the other kernels, errors still fail the compilation
+	    unsigned verificationInterval = 1;
+	    //the maximum number of instructions of a single kernel
+	    std::size_t maxKernelInstructions = 0;
+	    //the maximum size (in bytes) of the interference-graph of a single kernel used by the graph-coloring register allocator,
+	    //which grows quadratically with the number of locals. On exceeding it, the linear-scan register allocator is tried first
+	    std::size_t maxInterferenceGraphSize = 0;
+	    BudgetExceededAction budgetExceededAction = BudgetExceededAction::DEGRADE;
+	    //if set, the Graphviz graphs of the selected kernels and phases are written into this directory (as "<kernel>.<phase>.dot").
+	    //The graphs are written asynchronously, so the timing of the compilation is mostly undistorted
+	    std::string debugGraphDirectory;
+	    //the kernels to write the debug graphs for, if empty, the graphs of all kernels are written
+	    std::vector<std::string> debugGraphKernels;
+	    //the phases to write the debug graphs for ("block-graph", "register-graph"), if empty, the graphs of all phases are written
+	    std::vector<std::string> debugGraphPhases;
+	    //the maximum number of nodes of a single debug graph, the edges to any further nodes are dropped. 0 disables the limit
+	    std::size_t maxDebugGraphNodes = 1000;
+	    //if set, the compilation is aborted with a CompilationError at the next check after the flag was set to true (e.g. from another thread)
+	    std::shared_ptr<std::atomic<bool>> cancellationToken;
+
+	    /*
+	     * Sets the optimization level and the budgets of the optimizations to the defaults for this level
+	     */
+	    void setOptimizationLevel(OptimizationLevel level);
 	};
 
 	/*
@@ -58,12 +257,10 @@ namespace vc4c
 	 * Numbers of elements for a native SIMD vector
 	 */
 	constexpr std::size_t NATIVE_VECTOR_SIZE{16};
-
 	/*
-	 * Maximum number of instructions to check for reordering.
-	 * This prevents long runs for huge linear programs at the cost of less performant code
+	 * Number of QPUs, identified by the QPU number 0 to 11
 	 */
-	constexpr std::size_t REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK{64};
+	constexpr unsigned NUM_QPUS{12};
 
 	/*
 	 * Maximum number of rounds the register-checker tries to resolve conflicts
@@ -75,6 +272,34 @@ namespace vc4c
 	 */
 	constexpr uint32_t QPUASM_MAGIC_NUMBER = 0xDEADBEAF;
 	constexpr uint32_t QPUASM_NUMBER_MAGIC = 0xAFBEADDE;
+
+	inline void Configuration::setOptimizationLevel(OptimizationLevel level)
+	{
+		optimizationLevel = level;
+		switch(level)
+		{
+			case OptimizationLevel::NONE:
+			case OptimizationLevel::BASIC:
+				maxOptimizationIterations = 1;
+				maxReorderingInstructions = REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK / 4;
+				registerAllocation = RegisterAllocation::LINEAR_SCAN;
+				fastPathInstructions = FAST_PATH_MAX_INSTRUCTIONS;
+				break;
+			case OptimizationLevel::MEDIUM:
+			case OptimizationLevel::SIZE:
+				maxOptimizationIterations = 1;
+				maxReorderingInstructions = REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK;
+				registerAllocation = RegisterAllocation::GRAPH_COLORING;
+				fastPathInstructions = FAST_PATH_MAX_INSTRUCTIONS;
+				break;
+			case OptimizationLevel::FULL:
+				maxOptimizationIterations = 4;
+				maxReorderingInstructions = REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK * 4;
+				registerAllocation = RegisterAllocation::GRAPH_COLORING;
+				fastPathInstructions = 0;
+				break;
+		}
+	}
 }
 
 #endif /* VC4C_CONFIG_H */
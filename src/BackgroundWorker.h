@@ -7,46 +7,38 @@
 #ifndef BACKGROUND_WORKER_H
 #define BACKGROUND_WORKER_H
 
-#include "log.h"
+#include "Logging.h"
 
 #include <functional>
 #include <exception>
 
 #ifdef MULTI_THREADED
-#include <thread>
-#include <mutex>
-#include <sys/prctl.h>
-#include <dlfcn.h>
+#include "ThreadPool.h"
 #endif
 
 namespace threading
 {
+	/*
+	 * Runs the functor asynchronously as a task on the global thread-pool
+	 */
 	struct BackgroundWorker
 	{
 	public:
 
 		BackgroundWorker(const std::function<void()>& f, const std::string& name) : name(name), functor(f), err(nullptr)
 #ifdef MULTI_THREADED
-	, runner()
+	, task()
 #endif
 		{
-#ifdef MULTI_THREADED
-			//we need thread-support, so load the pthread library dynamically (if it is not yet loaded)
-			void* handle = dlopen("libpthread.so.0", RTLD_GLOBAL | RTLD_LAZY);
-			if(handle == nullptr)
-			{
-				throw std::runtime_error(std::string("Error loading pthread library: ") + dlerror());
-			}
-#endif
 		}
 
 		void operator()()
 		{
-			const auto f = [this]() -> void
+			//the task runs with the log-level of the compilation scheduling it
+			const unsigned severity = vc4c::compilationLogSeverity;
+			const auto f = [this, severity]() -> void
 			{
-#ifdef MULTI_THREADED
-				prctl(PR_SET_NAME, name.data(), 0, 0, 0);
-#endif
+				const vc4c::LogSeverityScope logScope(severity);
 				try
 				{
 					functor();
@@ -58,7 +50,8 @@ namespace threading
 				}
 			};
 #ifdef MULTI_THREADED
-			runner = std::thread(f);
+			task = std::make_shared<Task>(f, name);
+			ThreadPool::getGlobalPool().schedule(task);
 #else
 			f();
 #endif
@@ -67,8 +60,8 @@ namespace threading
 		std::exception_ptr waitFor() const
 		{
 #ifdef MULTI_THREADED
-			if(runner.joinable())
-				const_cast<std::thread&>(runner).join();
+			if(task)
+				ThreadPool::getGlobalPool().waitFor(task);
 #endif
 			return err;
 		}
@@ -76,7 +69,7 @@ namespace threading
 		std::function<void()> functor;
 		std::exception_ptr err;
 #ifdef MULTI_THREADED
-		std::thread runner;
+		std::shared_ptr<Task> task;
 #endif
 
 		static void waitForAll(const std::vector<BackgroundWorker>& worker)
@@ -0,0 +1,120 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifdef USE_CLANG_LIBRARY
+
+#include "ClangLibrary.h"
+#include "CompilationError.h"
+#include "log.h"
+
+#include <sstream>
+#include <vector>
+
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/CodeGen/CodeGenAction.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Lex/PreprocessorOptions.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#if LLVM_VERSION_MAJOR >= 4
+#include <llvm/Bitcode/BitcodeWriter.h>
+#else
+#include <llvm/Bitcode/ReaderWriter.h>
+#endif
+
+using namespace vc4c;
+
+static std::vector<std::string> splitArguments(const std::string& arguments)
+{
+	//XXX does not handle quoted arguments
+	std::vector<std::string> result;
+	std::istringstream ss(arguments);
+	std::string arg;
+	while(ss >> arg)
+		result.push_back(arg);
+	return result;
+}
+
+void vc4c::compileWithClangLibrary(const std::string& source, std::ostream& output, const std::string& arguments, const bool toText, const Optional<std::string>& inputFile)
+{
+	const std::vector<std::string> args = splitArguments(arguments);
+	std::vector<const char*> argv;
+	argv.reserve(args.size());
+	for(const std::string& arg : args)
+		argv.push_back(arg.data());
+
+	std::string diagnostics;
+	llvm::raw_string_ostream diagnosticsStream(diagnostics);
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> diagnosticOptions(new clang::DiagnosticOptions());
+
+	clang::CompilerInstance compiler;
+	//the compiler-instance takes ownership of the diagnostics printer
+	compiler.createDiagnostics(new clang::TextDiagnosticPrinter(diagnosticsStream, diagnosticOptions.get()), true);
+
+	clang::CompilerInvocation& invocation = compiler.getInvocation();
+#if LLVM_VERSION_MAJOR >= 10
+	const bool validArguments = clang::CompilerInvocation::CreateFromArgs(invocation, argv, compiler.getDiagnostics());
+#else
+	const bool validArguments = clang::CompilerInvocation::CreateFromArgs(invocation, argv.data(), argv.data() + argv.size(), compiler.getDiagnostics());
+#endif
+	if(!validArguments)
+	{
+		diagnosticsStream.flush();
+		throw CompilationError(CompilationStep::PRECOMPILATION, "Invalid pre-compilation options", diagnostics);
+	}
+
+	//read the source from memory instead of a file or stdin
+	const std::string inputName = inputFile ? inputFile.get() : "input.cl";
+	invocation.getFrontendOpts().Inputs.clear();
+#if LLVM_VERSION_MAJOR >= 10
+	invocation.getFrontendOpts().Inputs.emplace_back(inputName, clang::InputKind(clang::Language::OpenCL));
+#elif LLVM_VERSION_MAJOR >= 5
+	invocation.getFrontendOpts().Inputs.emplace_back(inputName, clang::InputKind::OpenCL);
+#else
+	invocation.getFrontendOpts().Inputs.emplace_back(inputName, clang::IK_OpenCL);
+#endif
+	//the pre-processor takes ownership of the buffer
+	invocation.getPreprocessorOpts().addRemappedFile(inputName, llvm::MemoryBuffer::getMemBufferCopy(source, inputName).release());
+
+	llvm::LLVMContext context;
+	clang::EmitLLVMOnlyAction action(&context);
+	const bool success = compiler.ExecuteAction(action);
+	diagnosticsStream.flush();
+	if(!success)
+	{
+		logging::error() << "Errors in precompilation:" << logging::endl;
+		logging::error() << diagnostics << logging::endl;
+		throw CompilationError(CompilationStep::PRECOMPILATION, "Error in precompilation", diagnostics);
+	}
+	if(!diagnostics.empty())
+	{
+		logging::warn() << "Warnings in precompilation:" << logging::endl;
+		logging::warn() << diagnostics << logging::endl;
+	}
+
+	const std::unique_ptr<llvm::Module> module = action.takeModule();
+	if(!module)
+		throw CompilationError(CompilationStep::PRECOMPILATION, "CLang did not generate a module");
+	std::string buffer;
+	llvm::raw_string_ostream bufferStream(buffer);
+	if(toText)
+		module->print(bufferStream, nullptr);
+	else
+#if LLVM_VERSION_MAJOR >= 7
+		llvm::WriteBitcodeToFile(*module, bufferStream);
+#else
+		llvm::WriteBitcodeToFile(module.get(), bufferStream);
+#endif
+	bufferStream.flush();
+	output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+#endif /* USE_CLANG_LIBRARY */
@@ -0,0 +1,31 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef CLANGLIBRARY_H
+#define CLANGLIBRARY_H
+
+#ifdef USE_CLANG_LIBRARY
+
+#include "helper.h"
+
+#include <iostream>
+#include <string>
+
+namespace vc4c
+{
+	/*
+	 * Compiles the OpenCL C source to LLVM-IR (text or bitcode) with the linked CLang library,
+	 * without starting an external process or writing temporary files.
+	 *
+	 * The arguments are passed to the CLang front-end (the same as for "clang -cc1"), the input-file is only used for diagnostics
+	 */
+	void compileWithClangLibrary(const std::string& source, std::ostream& output, const std::string& arguments, const bool toText, const Optional<std::string>& inputFile);
+
+} /* namespace vc4c */
+
+#endif /* USE_CLANG_LIBRARY */
+
+#endif /* CLANGLIBRARY_H */
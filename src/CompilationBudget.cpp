@@ -0,0 +1,72 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "CompilationBudget.h"
+
+#include "Module.h"
+#include "Logging.h"
+
+#include <sys/resource.h>
+
+using namespace vc4c;
+
+CompilationBudget::CompilationBudget(const Configuration& config) :
+		startTime(std::chrono::steady_clock::now()), maxTime(config.maxCompilationTime), maxMemory(config.maxMemoryUsage),
+		maxInstructions(config.maxKernelInstructions), maxGraphSize(config.maxInterferenceGraphSize), action(config.budgetExceededAction), cancellationToken(config.cancellationToken)
+{
+}
+
+std::size_t vc4c::getPeakMemoryUsage()
+{
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	//the maximum resident set size is given in kilobytes
+	return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+bool CompilationBudget::check(const CompilationStep step, const Method* method) const
+{
+	if(cancellationToken && cancellationToken->load())
+		throw CompilationError(step, "Compilation was cancelled");
+
+	std::string exceededBudget;
+	if(maxTime != 0)
+	{
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+		if(elapsed > static_cast<long long>(maxTime))
+			exceededBudget = "time (" + std::to_string(elapsed) + " ms)";
+	}
+	if(exceededBudget.empty() && maxMemory != 0)
+	{
+		const std::size_t memory = getPeakMemoryUsage();
+		if(memory > maxMemory)
+			exceededBudget = "memory (" + std::to_string(memory) + " bytes)";
+	}
+	if(exceededBudget.empty() && maxInstructions != 0 && method != nullptr)
+	{
+		const std::size_t numInstructions = method->countInstructions();
+		if(numInstructions > maxInstructions)
+			exceededBudget = "instructions (" + std::to_string(numInstructions) + " in " + method->name + ")";
+	}
+	if(exceededBudget.empty())
+		return false;
+	if(action == BudgetExceededAction::ABORT)
+		throw CompilationError(step, "Compilation budget exceeded", exceededBudget);
+	DEBUG_LOG("Compilation budget exceeded for " << exceededBudget << ", degrading the compilation" << logging::endl);
+	return true;
+}
+
+bool CompilationBudget::checkInterferenceGraph(const Method& method, std::size_t graphSize) const
+{
+	if(maxGraphSize == 0 || graphSize <= maxGraphSize)
+		return false;
+	const std::string exceededBudget = "interference-graph size (" + std::to_string(graphSize) + " bytes in " + method.name + ")";
+	if(action == BudgetExceededAction::ABORT)
+		throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Compilation budget exceeded", exceededBudget);
+	DEBUG_LOG("Compilation budget exceeded for " << exceededBudget << ", degrading the compilation" << logging::endl);
+	return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef COMPILATIONBUDGET_H
+#define COMPILATIONBUDGET_H
+
+#include "config.h"
+#include "CompilationError.h"
+
+#include <chrono>
+
+namespace vc4c
+{
+	class Method;
+
+	/*
+	 * Keeps track of the cancellation and the time, memory and instruction budgets of a single compilation (see Configuration).
+	 *
+	 * The budgets are checked cooperatively, e.g. between optimization passes and register-allocation rounds,
+	 * so a single long-running step can exceed the time budget until the next check.
+	 */
+	/*
+	 * Returns the peak resident memory (in bytes) of the whole process so far
+	 */
+	std::size_t getPeakMemoryUsage();
+
+	class CompilationBudget
+	{
+	public:
+		/*
+		 * Starts the clock for the time budget
+		 */
+		explicit CompilationBudget(const Configuration& config);
+
+		/*
+		 * Checks whether the compilation was cancelled or any budget is exceeded (including the instruction budget for the given method, if any).
+		 *
+		 * Throws a CompilationError, if the compilation was cancelled or a budget is exceeded and the configured action is to abort.
+		 * Otherwise returns whether a budget is exceeded and the compilation should degrade
+		 */
+		bool check(const CompilationStep step, const Method* method = nullptr) const;
+
+		/*
+		 * Checks whether the interference-graph (of the given size in bytes) for the register allocation of the given method exceeds the budget.
+		 *
+		 * Throws a CompilationError, if the budget is exceeded and the configured action is to abort, otherwise returns whether the budget is exceeded
+		 */
+		bool checkInterferenceGraph(const Method& method, std::size_t graphSize) const;
+
+	private:
+		std::chrono::steady_clock::time_point startTime;
+		unsigned maxTime;
+		std::size_t maxMemory;
+		std::size_t maxInstructions;
+		std::size_t maxGraphSize;
+		BudgetExceededAction action;
+		std::shared_ptr<std::atomic<bool>> cancellationToken;
+	};
+} /* namespace vc4c */
+
+#endif /* COMPILATIONBUDGET_H */
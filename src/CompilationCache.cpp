@@ -0,0 +1,509 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "CompilationCache.h"
+#include "Logging.h"
+#include "ProcessUtil.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace vc4c;
+
+//the magic string starting every cache entry, followed by the key and the size of the cached binary
+static const std::string CACHE_ENTRY_MAGIC = "VC4C-CACHE";
+
+static Optional<std::string> getCacheDirectory()
+{
+	const char* dir = std::getenv("VC4C_CACHE_DIR");
+	if(dir != nullptr)
+	{
+		if(dir[0] == '\0')
+			//cache explicitly disabled
+			return {};
+		return std::string(dir);
+	}
+	dir = std::getenv("XDG_CACHE_HOME");
+	if(dir != nullptr && dir[0] != '\0')
+		return std::string(dir) + "/vc4c";
+	dir = std::getenv("HOME");
+	if(dir != nullptr && dir[0] != '\0')
+		return std::string(dir) + "/.cache/vc4c";
+	return {};
+}
+
+static bool createDirectories(const std::string& path)
+{
+	std::size_t pos = 0;
+	while(pos != std::string::npos)
+	{
+		pos = path.find('/', pos + 1);
+		const std::string part = path.substr(0, pos);
+		if(mkdir(part.data(), 0755) != 0 && errno != EEXIST)
+			return false;
+	}
+	return true;
+}
+
+//64-bit FNV-1a, the offset basis allows for independent hashes
+static uint64_t fnv1a(const char* data, const std::size_t size, uint64_t hash)
+{
+	for(std::size_t i = 0; i < size; ++i)
+	{
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static std::string createKey(const std::string& material, const char* source, const std::size_t sourceSize)
+{
+	//two independent 64-bit hashes to make collisions sufficiently unlikely
+	const uint64_t first = fnv1a(source, sourceSize, fnv1a(material.data(), material.size(), 14695981039346656037ULL));
+	const uint64_t second = fnv1a(source, sourceSize, fnv1a(material.data(), material.size(), 0x84222325CBF29CE4ULL));
+	std::ostringstream key;
+	key << std::hex << std::setfill('0') << std::setw(16) << first << std::setw(16) << second;
+	return key.str();
+}
+
+//the options whose value can be given as separate argument
+static const char* const SEPARATE_VALUE_OPTIONS[] = {"-D", "-U", "-I", "-x", "-include", "-include-pch", "-isystem"};
+
+/*
+ * Splits the options into single arguments. Quoted parts (e.g. the value of a macro containing spaces) are kept together
+ * and the values of options given as separate argument are merged with their option
+ */
+static std::vector<std::string> splitOptions(const std::string& options)
+{
+	std::vector<std::string> args;
+	std::string current;
+	char quote = '\0';
+	for(const char c : options)
+	{
+		if(quote == '\0' && std::isspace(static_cast<unsigned char>(c)))
+		{
+			if(!current.empty())
+				args.push_back(std::move(current));
+			current.clear();
+			continue;
+		}
+		if(c == quote)
+			quote = '\0';
+		else if(quote == '\0' && (c == '"' || c == '\''))
+			quote = c;
+		current.push_back(c);
+	}
+	if(!current.empty())
+		args.push_back(std::move(current));
+
+	std::vector<std::string> merged;
+	for(std::size_t i = 0; i < args.size(); ++i)
+	{
+		if(i + 1 < args.size() && std::find(std::begin(SEPARATE_VALUE_OPTIONS), std::end(SEPARATE_VALUE_OPTIONS), args[i]) != std::end(SEPARATE_VALUE_OPTIONS))
+		{
+			//"-D NAME" and "-DNAME" are the same, the other options are kept separated by a single space
+			const bool isMacroOrInclude = args[i] == "-D" || args[i] == "-U" || args[i] == "-I";
+			merged.push_back(args[i] + (isMacroOrInclude ? "" : " ") + args[i + 1]);
+			++i;
+		}
+		else
+			merged.push_back(args[i]);
+	}
+	return merged;
+}
+
+/*
+ * Whether the option does not change the pre-compiled code, e.g. warnings and verbose output.
+ * Options turning warnings into errors are kept, since they can make the compilation fail
+ */
+static bool isIgnoredOption(const std::string& arg)
+{
+	if(arg == "-w" || arg == "-v")
+		return true;
+	if(arg == "-Werror" || arg.compare(0, 8, "-Werror=") == 0)
+		return false;
+	//warnings, but not the options passed on to the pre-processor, assembler or linker ("-Wp,", "-Wa,", "-Wl,")
+	return arg.compare(0, 2, "-W") == 0 && (arg.size() < 4 || arg[3] != ',');
+}
+
+std::string vc4c::normalizeCompilationOptions(const std::string& options)
+{
+	//the last definition (or undefinition) of a macro overrides all previous ones
+	std::map<std::string, std::string> macros;
+	std::vector<std::string> includes;
+	std::vector<std::string> others;
+	for(std::string& arg : splitOptions(options))
+	{
+		if(arg.compare(0, 2, "-D") == 0 || arg.compare(0, 2, "-U") == 0)
+		{
+			const std::string name = arg.substr(2, arg.find('=') == std::string::npos ? std::string::npos : arg.find('=') - 2);
+			if(arg[1] == 'D' && arg.find('=') == std::string::npos)
+				arg.append("=1");
+			macros[name] = std::move(arg);
+		}
+		else if(arg.compare(0, 2, "-I") == 0)
+		{
+			//the include directories are searched in the given order, CLang ignores repeated directories
+			if(std::find(includes.begin(), includes.end(), arg) == includes.end())
+				includes.push_back(std::move(arg));
+		}
+		else if(!isIgnoredOption(arg))
+		{
+			others.erase(std::remove(others.begin(), others.end(), arg), others.end());
+			others.push_back(std::move(arg));
+		}
+	}
+	std::string result;
+	for(const std::string& arg : others)
+		result.append(arg).append(" ");
+	for(const std::string& arg : includes)
+		result.append(arg).append(" ");
+	for(const auto& macro : macros)
+		result.append(macro.second).append(" ");
+	if(!result.empty())
+		result.pop_back();
+	return result;
+}
+
+Optional<std::string> vc4c::getCompilationCacheDirectory()
+{
+	const Optional<std::string> dir = getCacheDirectory();
+	if(!dir)
+		return {};
+	if(!createDirectories(dir.get()))
+	{
+		logging::warn() << "Failed to create compilation cache directory '" << dir.get() << "': " << strerror(errno) << logging::endl;
+		return {};
+	}
+	return dir;
+}
+
+std::string vc4c::getCacheKey(const std::string& data)
+{
+	return createKey("", data.data(), data.size());
+}
+
+std::string vc4c::getConfigurationKey(const Configuration& config)
+{
+	std::ostringstream material;
+	material << static_cast<unsigned>(config.mathType) << ' ' << static_cast<unsigned>(config.outputMode)
+			<< ' ' << config.writeKernelInfo << ' ' << config.availableVPMSize << ' ' << config.compactUniforms << ' ' << config.batchWorkGroups << ' ' << config.partitionVPM << ' ' << static_cast<unsigned>(config.registerAllocation) << ' ' << config.fastPathInstructions << ' ' << config.threadedExecution << ' ' << config.indexedContainer << ' ' << config.compactKernelInfo << ' ' << config.kernelInfoNames << ' ' << config.maxKernelInstructions << ' ' << config.maxInterferenceGraphSize << ' ' << static_cast<unsigned>(config.budgetExceededAction) << ' ' << config.instrumentBlocks << ' ' << config.maxUniformConstants << ' ' << config.maxPreloadedTableSize << ' ' << config.bufferVectorParameters << '\0';
+	for(const std::string& kernel : config.selectedKernels)
+		material << kernel << '\0';
+	for(const std::string& pass : config.spirvOptimizationPasses)
+		material << pass << ' ';
+	material << '\0';
+	for(const BlockExecutionCount& count : config.blockProfile)
+		material << count.kernelName << ' ' << count.blockLabel << ' ' << count.count << '\0';
+	//the code specialized for a launch configuration is cached next to the generic code
+	for(uint32_t size : config.specializedLocalSizes)
+		material << size << ' ';
+	material << '\0';
+	for(uint32_t size : config.specializedGlobalSizes)
+		material << size << ' ';
+	material << '\0';
+	for(const ParameterSpecialization& binding : config.specializedParameters)
+		material << binding.kernelName << ' ' << binding.parameterIndex << ' ' << binding.value << ' ';
+	material << '\0';
+	for(const SpecializationConstant& constant : config.specializationConstants)
+		material << constant.specId << ' ' << constant.value << ' ';
+	material << '\0';
+	for(const KernelFusion& fusion : config.fusedKernels)
+	{
+		material << fusion.kernelName << ' ';
+		for(const std::string& kernel : fusion.kernels)
+			material << kernel << ' ';
+		for(const std::vector<unsigned>& bindings : fusion.parameterBindings)
+		{
+			for(unsigned index : bindings)
+				material << index << ' ';
+			material << ';';
+		}
+		material << '\0';
+	}
+	material << '\0';
+	return material.str();
+}
+
+std::string vc4c::getCompilationCacheKey(const char* source, const std::size_t sourceSize, const std::string& options, const Configuration& config)
+{
+	std::ostringstream material;
+	material << VC4C_VERSION << '\0' << normalizeCompilationOptions(options) << '\0' << getConfigurationKey(config);
+	material << sourceSize << '\0';
+	return createKey(material.str(), source, sourceSize);
+}
+
+std::string vc4c::getPrecompilationCacheKey(const std::string& source, const std::string& options, const SourceType inputType, const SourceType outputType)
+{
+	std::ostringstream material;
+	material << "precompile" << '\0' << VC4C_VERSION << '\0' << normalizeCompilationOptions(options) << '\0' << static_cast<unsigned>(inputType) << ' ' << static_cast<unsigned>(outputType) << '\0';
+	//the pre-compiler executables used
+#ifdef SPIRV_CLANG_PATH
+	material << SPIRV_CLANG_PATH << '\0';
+#endif
+#ifdef SPIRV_LLVM_SPIRV_PATH
+	material << SPIRV_LLVM_SPIRV_PATH << '\0';
+#endif
+#ifdef CLANG_PATH
+	material << CLANG_PATH << '\0';
+#endif
+	material << source.size() << '\0';
+	return createKey(material.str(), source.data(), source.size());
+}
+
+std::string vc4c::getSPIRVOptimizationCacheKey(const uint32_t* words, const std::size_t numWords, const std::vector<std::string>& passes)
+{
+	std::ostringstream material;
+	material << "spirv-opt" << '\0' << VC4C_VERSION << '\0';
+	for(const std::string& pass : passes)
+		material << pass << '\0';
+	material << numWords << '\0';
+	return createKey(material.str(), reinterpret_cast<const char*>(words), numWords * sizeof(uint32_t));
+}
+
+std::string vc4c::getParsedModuleCacheKey(const std::string& source, const Configuration& config)
+{
+	std::ostringstream material;
+	material << "parsed-module" << '\0' << VC4C_VERSION << '\0';
+	for(const std::string& pass : config.spirvOptimizationPasses)
+		material << pass << '\0';
+	return createKey(material.str(), source.data(), source.size());
+}
+
+CompilationCacheBackend::~CompilationCacheBackend()
+{
+	//defined here to not be inlined
+}
+
+namespace
+{
+	class DirectoryCacheBackend : public CompilationCacheBackend
+	{
+	public:
+		explicit DirectoryCacheBackend(const std::string& directory) : directory(directory)
+		{
+		}
+
+		Optional<std::string> read(const std::string& key) override
+		{
+			std::ifstream in(directory + "/" + key, std::ios_base::in | std::ios_base::binary);
+			if(!in)
+				return {};
+			return std::string(std::istreambuf_iterator<char>(in), {});
+		}
+
+		void write(const std::string& key, const std::string& entry) override
+		{
+			if(!createDirectories(directory))
+			{
+				logging::warn() << "Failed to create compilation cache directory '" << directory << "': " << strerror(errno) << logging::endl;
+				return;
+			}
+			const std::string fileName = directory + "/" + key;
+			//the temporary file is unique per process, so concurrent writers do not interfere
+			const std::string tmpFileName = fileName + ".tmp." + std::to_string(getpid());
+			{
+				std::ofstream out(tmpFileName, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+				out.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+				out.flush();
+				if(!out)
+				{
+					logging::warn() << "Failed to write compilation cache entry: " << tmpFileName << logging::endl;
+					std::remove(tmpFileName.data());
+					return;
+				}
+			}
+			if(std::rename(tmpFileName.data(), fileName.data()) != 0)
+			{
+				logging::warn() << "Failed to store compilation cache entry '" << fileName << "': " << strerror(errno) << logging::endl;
+				std::remove(tmpFileName.data());
+			}
+		}
+
+	private:
+		const std::string directory;
+	};
+
+	class HTTPCacheBackend : public CompilationCacheBackend
+	{
+	public:
+		explicit HTTPCacheBackend(const std::string& url) : url(url.back() == '/' ? url.substr(0, url.size() - 1) : url)
+		{
+		}
+
+		Optional<std::string> read(const std::string& key) override
+		{
+			//a missing entry is reported as HTTP error, which lets curl fail
+			std::ostringstream entry;
+			if(!runCurl("--fail --silent --max-time 10 " + url + "/" + key, nullptr, &entry))
+				return {};
+			return entry.str();
+		}
+
+		void write(const std::string& key, const std::string& entry) override
+		{
+			std::istringstream in(entry);
+			if(!runCurl("--fail --silent --max-time 30 --request PUT --data-binary @- " + url + "/" + key, &in, nullptr))
+				logging::warn() << "Failed to upload compilation cache entry to: " << url << "/" << key << logging::endl;
+		}
+
+	private:
+		const std::string url;
+
+		static bool runCurl(const std::string& arguments, std::istream* in, std::ostream* out)
+		{
+			std::ostringstream err;
+			try
+			{
+				if(runProcess("curl " + arguments, in, out, &err) == 0)
+					return true;
+			}
+			catch(const CompilationError& e)
+			{
+				//e.g. curl is not installed
+				err << e.what();
+			}
+			DEBUG_LOG("Remote compilation cache request failed: " << err.str() << logging::endl);
+			return false;
+		}
+	};
+
+	class LayeredCacheBackend : public CompilationCacheBackend
+	{
+	public:
+		LayeredCacheBackend(const std::shared_ptr<CompilationCacheBackend>& local, const std::shared_ptr<CompilationCacheBackend>& remote, bool writeRemote) :
+			local(local), remote(remote), writeRemote(writeRemote)
+		{
+		}
+
+		Optional<std::string> read(const std::string& key) override
+		{
+			Optional<std::string> entry = local ? local->read(key) : Optional<std::string>{};
+			if(entry)
+				return entry;
+			entry = remote->read(key);
+			if(entry && local)
+				local->write(key, entry.get());
+			return entry;
+		}
+
+		void write(const std::string& key, const std::string& entry) override
+		{
+			if(local)
+				local->write(key, entry);
+			if(writeRemote)
+				remote->write(key, entry);
+		}
+
+	private:
+		const std::shared_ptr<CompilationCacheBackend> local;
+		const std::shared_ptr<CompilationCacheBackend> remote;
+		const bool writeRemote;
+	};
+} /* namespace */
+
+std::shared_ptr<CompilationCacheBackend> vc4c::createDirectoryCacheBackend(const std::string& directory)
+{
+	return std::make_shared<DirectoryCacheBackend>(directory);
+}
+
+std::shared_ptr<CompilationCacheBackend> vc4c::createHTTPCacheBackend(const std::string& url)
+{
+	return std::make_shared<HTTPCacheBackend>(url);
+}
+
+std::shared_ptr<CompilationCacheBackend> vc4c::createLayeredCacheBackend(const std::shared_ptr<CompilationCacheBackend>& local,
+		const std::shared_ptr<CompilationCacheBackend>& remote, bool writeRemote)
+{
+	return std::make_shared<LayeredCacheBackend>(local, remote, writeRemote);
+}
+
+static std::shared_ptr<CompilationCacheBackend> createDefaultBackend()
+{
+	const Optional<std::string> dir = getCacheDirectory();
+	std::shared_ptr<CompilationCacheBackend> local = dir ? createDirectoryCacheBackend(dir.get()) : nullptr;
+	const char* remoteCache = std::getenv("VC4C_REMOTE_CACHE");
+	if(remoteCache == nullptr || remoteCache[0] == '\0')
+		return local;
+	const std::string remote(remoteCache);
+	const char* upload = std::getenv("VC4C_REMOTE_CACHE_UPLOAD");
+	const bool isHTTP = remote.compare(0, 7, "http://") == 0 || remote.compare(0, 8, "https://") == 0;
+	return createLayeredCacheBackend(local, isHTTP ? createHTTPCacheBackend(remote) : createDirectoryCacheBackend(remote), upload != nullptr && upload[0] != '\0');
+}
+
+static std::mutex cacheBackendLock;
+static bool isCacheBackendSet = false;
+static std::shared_ptr<CompilationCacheBackend> cacheBackend;
+
+void Compiler::setCacheBackend(const std::shared_ptr<CompilationCacheBackend>& backend)
+{
+	std::lock_guard<std::mutex> guard(cacheBackendLock);
+	cacheBackend = backend;
+	isCacheBackendSet = true;
+}
+
+std::shared_ptr<CompilationCacheBackend> Compiler::getCacheBackend()
+{
+	std::lock_guard<std::mutex> guard(cacheBackendLock);
+	if(!isCacheBackendSet)
+	{
+		cacheBackend = createDefaultBackend();
+		isCacheBackendSet = true;
+	}
+	return cacheBackend;
+}
+
+Optional<std::string> vc4c::readCompilationCache(const std::string& key)
+{
+	const std::shared_ptr<CompilationCacheBackend> backend = Compiler::getCacheBackend();
+	if(!backend)
+		return {};
+	const Optional<std::string> entry = backend->read(key);
+	if(!entry)
+		return {};
+	std::istringstream in(entry.get());
+
+	std::string magic;
+	std::string entryKey;
+	std::size_t size = 0;
+	in >> magic >> entryKey >> size;
+	if(!in || in.get() != '\n' || magic != CACHE_ENTRY_MAGIC || entryKey != key)
+	{
+		logging::warn() << "Ignoring invalid compilation cache entry: " << key << logging::endl;
+		return {};
+	}
+	std::string binary(size, '\0');
+	if(!in.read(&binary[0], static_cast<std::streamsize>(size)) || in.peek() != std::char_traits<char>::eof())
+	{
+		logging::warn() << "Ignoring truncated compilation cache entry: " << key << logging::endl;
+		return {};
+	}
+	INFO_LOG("Using cached compilation result: " << key << logging::endl);
+	return binary;
+}
+
+void vc4c::writeCompilationCache(const std::string& key, const std::string& binary)
+{
+	const std::shared_ptr<CompilationCacheBackend> backend = Compiler::getCacheBackend();
+	if(!backend)
+		return;
+	std::ostringstream entry;
+	entry << CACHE_ENTRY_MAGIC << ' ' << key << ' ' << binary.size() << '\n';
+	entry.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+	backend->write(key, entry.str());
+}
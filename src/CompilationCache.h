@@ -0,0 +1,101 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef COMPILATIONCACHE_H
+#define COMPILATIONCACHE_H
+
+#include "config.h"
+#include "helper.h"
+#include "Compiler.h"
+#include "Precompiler.h"
+
+#include <string>
+#include <vector>
+
+namespace vc4c
+{
+	/*
+	 * Persistent on-disk cache for compiled programs and the output of the pre-compiler.
+	 *
+	 * The cache is located in the directory given by the environment-variable VC4C_CACHE_DIR,
+	 * defaulting to "$XDG_CACHE_HOME/vc4c" or "$HOME/.cache/vc4c". Setting VC4C_CACHE_DIR to an empty value disables the local cache.
+	 *
+	 * Additionally, the environment-variable VC4C_REMOTE_CACHE can specify a cache shared by multiple devices, which is used for entries not found locally:
+	 * either an HTTP(S) URL (starting with "http://" or "https://") or a directory on a shared file-system.
+	 * New entries are only written to the shared cache, if the environment-variable VC4C_REMOTE_CACHE_UPLOAD is set to a non-empty value.
+	 * The cache storage can also be replaced programmatically via Compiler#setCacheBackend.
+	 *
+	 * NOTE: Only the source itself is part of the key, changes in files included by the source are not detected!
+	 */
+
+	/*
+	 * Returns the directory of the local compilation cache (creating it, if required) or no value, if the local cache is disabled or can't be created.
+	 *
+	 * This directory is also used for files which can't be shared between devices, e.g. the pre-compiled standard-library header
+	 */
+	Optional<std::string> getCompilationCacheDirectory();
+
+	/*
+	 * Calculates a cache-key for the given arbitrary data
+	 */
+	std::string getCacheKey(const std::string& data);
+
+	/*
+	 * Converts the pre-compiler options into a canonical form, so equivalent options map to the same cache entries:
+	 * - macros are sorted by name, only the last definition (or undefinition) of a macro is kept and "-DNAME" is converted to "-DNAME=1"
+	 * - options given as separate argument (e.g. "-D NAME", "-I dir") are merged with their values, surplus whitespace is removed
+	 * - include directories keep their order, only their first occurrence is kept (as by CLang), only the last occurrence of any other option is kept
+	 * - options not changing the generated code (e.g. warnings, verbose output) are removed
+	 *
+	 * NOTE: The result is only used to calculate cache-keys, the options passed to the pre-compiler are not modified
+	 */
+	std::string normalizeCompilationOptions(const std::string& options);
+
+	/*
+	 * Returns the textual representation of all parts of the configuration changing the generated code, e.g. to distinguish the variants of a program
+	 */
+	std::string getConfigurationKey(const Configuration& config);
+
+	/*
+	 * Calculates the cache-key for the given source, pre-compiler options, configuration and the compiler version
+	 */
+	std::string getCompilationCacheKey(const char* source, const std::size_t sourceSize, const std::string& options, const Configuration& config);
+
+	/*
+	 * Calculates the cache-key for the output of the pre-compiler (CLang, llvm-spirv) for the given source and options.
+	 *
+	 * This does not depend on the configuration, so a changed configuration can re-use the pre-compiled code
+	 */
+	std::string getPrecompilationCacheKey(const std::string& source, const std::string& options, const SourceType inputType, const SourceType outputType);
+
+	/*
+	 * Calculates the cache-key for the output of the SPIRV-Tools optimizer for the given SPIR-V module and optimization passes
+	 */
+	std::string getSPIRVOptimizationCacheKey(const uint32_t* words, const std::size_t numWords, const std::vector<std::string>& passes);
+
+	/*
+	 * Calculates the cache-key for the serialized module produced by the front-ends for the given (pre-compiled) input.
+	 *
+	 * Only the parts of the configuration used by the front-ends are included, so the entry can be re-used for different target configurations
+	 */
+	std::string getParsedModuleCacheKey(const std::string& source, const Configuration& config);
+
+	/*
+	 * Returns the cached compilation result for the given key from the cache backend (see Compiler#getCacheBackend), if any
+	 */
+	Optional<std::string> readCompilationCache(const std::string& key);
+
+	/*
+	 * Stores the compilation result for the given key in the cache backend.
+	 *
+	 * The directory backend writes the entry to a temporary file which is then atomically renamed,
+	 * so concurrent processes never read a partially written entry. Errors are only logged.
+	 */
+	void writeCompilationCache(const std::string& key, const std::string& binary);
+
+} /* namespace vc4c */
+
+#endif /* COMPILATIONCACHE_H */
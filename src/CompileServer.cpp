@@ -0,0 +1,432 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "CompileServer.h"
+
+#include "Compiler.h"
+#include "CompilationError.h"
+#include "MemoryStream.h"
+#include "Logging.h"
+#ifdef MULTI_THREADED
+#include "ThreadPool.h"
+#endif
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace vc4c;
+
+static constexpr uint32_t SERVER_MAGIC_NUMBER = 0x56433443; //"VC4C"
+static constexpr uint32_t SERVER_PROTOCOL_VERSION = 13;
+
+static constexpr int32_t STATUS_SUCCESS = 0;
+static constexpr int32_t STATUS_ERROR = 1;
+
+/*
+ * Builds a message as sequence of fixed-size integers and length-prefixed strings
+ */
+class MessageWriter
+{
+public:
+	template<typename T>
+	void writeInt(const T val)
+	{
+		data.append(reinterpret_cast<const char*>(&val), sizeof(T));
+	}
+
+	void writeString(const std::string& s)
+	{
+		writeInt(static_cast<uint64_t>(s.size()));
+		data.append(s);
+	}
+
+	template<typename T>
+	void writeList(const std::vector<T>& list)
+	{
+		writeInt(static_cast<uint32_t>(list.size()));
+		for(const T& val : list)
+			writeInt(val);
+	}
+
+	void writeStrings(const std::vector<std::string>& list)
+	{
+		writeInt(static_cast<uint32_t>(list.size()));
+		for(const std::string& s : list)
+			writeString(s);
+	}
+
+	std::string data;
+};
+
+/*
+ * Reads the messages built by MessageWriter directly from the socket
+ */
+class MessageReader
+{
+public:
+	explicit MessageReader(int fd) : fd(fd)
+	{
+	}
+
+	template<typename T>
+	T readInt()
+	{
+		T val;
+		read(reinterpret_cast<char*>(&val), sizeof(T));
+		return val;
+	}
+
+	std::string readString()
+	{
+		std::string s(static_cast<std::size_t>(readInt<uint64_t>()), '\0');
+		if(!s.empty())
+			read(&s[0], s.size());
+		return s;
+	}
+
+	template<typename T>
+	std::vector<T> readList()
+	{
+		std::vector<T> list(readInt<uint32_t>());
+		for(T& val : list)
+			val = readInt<T>();
+		return list;
+	}
+
+	std::vector<std::string> readStrings()
+	{
+		std::vector<std::string> list(readInt<uint32_t>());
+		for(std::string& s : list)
+			s = readString();
+		return list;
+	}
+
+private:
+	int fd;
+
+	void read(char* buffer, std::size_t size)
+	{
+		while(size > 0)
+		{
+			const ssize_t num = ::read(fd, buffer, size);
+			if(num < 0 && errno == EINTR)
+				continue;
+			if(num <= 0)
+				throw CompilationError(CompilationStep::GENERAL, "Failed to read from compilation server connection", strerror(errno));
+			buffer += num;
+			size -= static_cast<std::size_t>(num);
+		}
+	}
+};
+
+static bool sendAll(int fd, const std::string& data)
+{
+	std::size_t offset = 0;
+	while(offset < data.size())
+	{
+		//the other side closing the connection must not kill the process with SIGPIPE
+		const ssize_t num = ::send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+		if(num < 0 && errno == EINTR)
+			continue;
+		if(num <= 0)
+			return false;
+		offset += static_cast<std::size_t>(num);
+	}
+	return true;
+}
+
+static bool toSocketAddress(const std::string& socketPath, sockaddr_un& address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(socketPath.size() >= sizeof(address.sun_path))
+		return false;
+	strncpy(address.sun_path, socketPath.data(), sizeof(address.sun_path) - 1);
+	return true;
+}
+
+/*
+ * The report files, the block layout file, the debug graphs and the cancellation token are local to the client and therefore not transmitted
+ */
+static void writeConfiguration(MessageWriter& writer, const Configuration& config)
+{
+	writer.writeInt(static_cast<uint8_t>(config.mathType));
+	writer.writeInt(static_cast<uint8_t>(config.outputMode));
+	writer.writeInt(static_cast<uint8_t>(config.writeKernelInfo));
+	writer.writeInt(static_cast<uint32_t>(config.availableVPMSize));
+	writer.writeStrings(config.selectedKernels);
+	writer.writeStrings(config.spirvOptimizationPasses);
+	writer.writeInt(static_cast<uint8_t>(config.optimizationLevel));
+	writer.writeInt(static_cast<uint32_t>(config.maxOptimizationIterations));
+	writer.writeInt(static_cast<uint64_t>(config.maxReorderingInstructions));
+	writer.writeList(config.specializedLocalSizes);
+	writer.writeList(config.specializedGlobalSizes);
+	writer.writeInt(static_cast<uint32_t>(config.specializedParameters.size()));
+	for(const ParameterSpecialization& binding : config.specializedParameters)
+	{
+		writer.writeString(binding.kernelName);
+		writer.writeInt(static_cast<uint32_t>(binding.parameterIndex));
+		writer.writeInt(binding.value);
+	}
+	writer.writeInt(static_cast<uint32_t>(config.specializationConstants.size()));
+	for(const SpecializationConstant& constant : config.specializationConstants)
+	{
+		writer.writeInt(constant.specId);
+		writer.writeInt(constant.value);
+	}
+	writer.writeInt(static_cast<uint32_t>(config.fusedKernels.size()));
+	for(const KernelFusion& fusion : config.fusedKernels)
+	{
+		writer.writeString(fusion.kernelName);
+		writer.writeStrings(fusion.kernels);
+		for(const std::vector<unsigned>& bindings : fusion.parameterBindings)
+			writer.writeList(bindings);
+	}
+	writer.writeInt(static_cast<uint8_t>(config.compactUniforms));
+	writer.writeInt(static_cast<uint8_t>(config.batchWorkGroups));
+	writer.writeInt(static_cast<uint8_t>(config.partitionVPM));
+	writer.writeInt(static_cast<uint8_t>(config.registerAllocation));
+	writer.writeInt(static_cast<uint64_t>(config.fastPathInstructions));
+	writer.writeInt(static_cast<uint8_t>(config.threadedExecution));
+	writer.writeInt(static_cast<uint8_t>(config.indexedContainer));
+	writer.writeInt(static_cast<uint8_t>(config.compactKernelInfo));
+	writer.writeInt(static_cast<uint8_t>(config.kernelInfoNames));
+	writer.writeInt(static_cast<uint32_t>(config.maxCompilationTime));
+	writer.writeInt(static_cast<uint64_t>(config.maxMemoryUsage));
+	writer.writeInt(static_cast<uint64_t>(config.functionCacheSize));
+	writer.writeInt(static_cast<uint32_t>(config.verificationInterval));
+	writer.writeInt(static_cast<uint64_t>(config.maxKernelInstructions));
+	writer.writeInt(static_cast<uint64_t>(config.maxInterferenceGraphSize));
+	writer.writeInt(static_cast<uint8_t>(config.budgetExceededAction));
+	writer.writeInt(static_cast<uint8_t>(config.instrumentBlocks));
+	writer.writeInt(static_cast<uint32_t>(config.maxUniformConstants));
+	writer.writeInt(static_cast<uint32_t>(config.maxPreloadedTableSize));
+	writer.writeInt(static_cast<uint8_t>(config.bufferVectorParameters));
+	writer.writeInt(static_cast<uint32_t>(config.blockProfile.size()));
+	for(const BlockExecutionCount& count : config.blockProfile)
+	{
+		writer.writeString(count.kernelName);
+		writer.writeString(count.blockLabel);
+		writer.writeInt(static_cast<uint64_t>(count.count));
+	}
+}
+
+static Configuration readConfiguration(MessageReader& reader)
+{
+	Configuration config;
+	config.mathType = static_cast<MathType>(reader.readInt<uint8_t>());
+	config.outputMode = static_cast<OutputMode>(reader.readInt<uint8_t>());
+	config.writeKernelInfo = reader.readInt<uint8_t>() != 0;
+	config.availableVPMSize = reader.readInt<uint32_t>();
+	config.selectedKernels = reader.readStrings();
+	config.spirvOptimizationPasses = reader.readStrings();
+	config.optimizationLevel = static_cast<OptimizationLevel>(reader.readInt<uint8_t>());
+	config.maxOptimizationIterations = reader.readInt<uint32_t>();
+	config.maxReorderingInstructions = static_cast<std::size_t>(reader.readInt<uint64_t>());
+	config.specializedLocalSizes = reader.readList<uint32_t>();
+	config.specializedGlobalSizes = reader.readList<uint32_t>();
+	config.specializedParameters.resize(reader.readInt<uint32_t>());
+	for(ParameterSpecialization& binding : config.specializedParameters)
+	{
+		binding.kernelName = reader.readString();
+		binding.parameterIndex = reader.readInt<uint32_t>();
+		binding.value = reader.readInt<uint32_t>();
+	}
+	config.specializationConstants.resize(reader.readInt<uint32_t>());
+	for(SpecializationConstant& constant : config.specializationConstants)
+	{
+		constant.specId = reader.readInt<uint32_t>();
+		constant.value = reader.readInt<uint64_t>();
+	}
+	config.fusedKernels.resize(reader.readInt<uint32_t>());
+	for(KernelFusion& fusion : config.fusedKernels)
+	{
+		fusion.kernelName = reader.readString();
+		fusion.kernels = reader.readStrings();
+		fusion.parameterBindings.resize(fusion.kernels.size());
+		for(std::vector<unsigned>& bindings : fusion.parameterBindings)
+			bindings = reader.readList<unsigned>();
+	}
+	config.compactUniforms = reader.readInt<uint8_t>() != 0;
+	config.batchWorkGroups = reader.readInt<uint8_t>() != 0;
+	config.partitionVPM = reader.readInt<uint8_t>() != 0;
+	config.registerAllocation = static_cast<RegisterAllocation>(reader.readInt<uint8_t>());
+	config.fastPathInstructions = static_cast<std::size_t>(reader.readInt<uint64_t>());
+	config.threadedExecution = reader.readInt<uint8_t>() != 0;
+	config.indexedContainer = reader.readInt<uint8_t>() != 0;
+	config.compactKernelInfo = reader.readInt<uint8_t>() != 0;
+	config.kernelInfoNames = reader.readInt<uint8_t>() != 0;
+	config.maxCompilationTime = reader.readInt<uint32_t>();
+	config.maxMemoryUsage = static_cast<std::size_t>(reader.readInt<uint64_t>());
+	config.functionCacheSize = static_cast<std::size_t>(reader.readInt<uint64_t>());
+	config.verificationInterval = reader.readInt<uint32_t>();
+	config.maxKernelInstructions = static_cast<std::size_t>(reader.readInt<uint64_t>());
+	config.maxInterferenceGraphSize = static_cast<std::size_t>(reader.readInt<uint64_t>());
+	config.budgetExceededAction = static_cast<BudgetExceededAction>(reader.readInt<uint8_t>());
+	config.instrumentBlocks = reader.readInt<uint8_t>() != 0;
+	config.maxUniformConstants = reader.readInt<uint32_t>();
+	config.maxPreloadedTableSize = reader.readInt<uint32_t>();
+	config.bufferVectorParameters = reader.readInt<uint8_t>() != 0;
+	config.blockProfile.resize(reader.readInt<uint32_t>());
+	for(BlockExecutionCount& count : config.blockProfile)
+	{
+		count.kernelName = reader.readString();
+		count.blockLabel = reader.readString();
+		count.count = reader.readInt<uint64_t>();
+	}
+	return config;
+}
+
+static void handleConnection(int fd)
+{
+	MessageWriter response;
+	try
+	{
+		MessageReader request(fd);
+		if(request.readInt<uint32_t>() != SERVER_MAGIC_NUMBER || request.readInt<uint32_t>() != SERVER_PROTOCOL_VERSION)
+			throw CompilationError(CompilationStep::GENERAL, "Invalid compilation server request");
+		const Configuration config = readConfiguration(request);
+		const std::string options = request.readString();
+		const std::string fileName = request.readString();
+		const std::string source = request.readString();
+
+		MemoryStreamBuffer inputBuffer(source.data(), source.size());
+		std::istream input(&inputBuffer);
+		std::ostringstream output;
+		Optional<std::string> inputFile;
+		if(!fileName.empty())
+			inputFile = fileName;
+		Compiler::compile(input, output, config, options, inputFile);
+		response.writeInt(STATUS_SUCCESS);
+		response.writeString(output.str());
+	}
+	catch(const std::exception& e)
+	{
+		logging::error() << "Compilation server request failed: " << e.what() << logging::endl;
+		response = MessageWriter{};
+		response.writeInt(STATUS_ERROR);
+		response.writeString(e.what());
+	}
+	if(!sendAll(fd, response.data))
+		logging::warn() << "Failed to send compilation server response: " << strerror(errno) << logging::endl;
+	close(fd);
+}
+
+Optional<std::string> vc4c::getCompileServerSocket()
+{
+	const char* socket = std::getenv("VC4C_SERVER_SOCKET");
+	if(socket == nullptr || socket[0] == '\0')
+		return {};
+	return std::string(socket);
+}
+
+int vc4c::runCompileServer(const std::string& socketPath)
+{
+	sockaddr_un address;
+	if(!toSocketAddress(socketPath, address))
+	{
+		logging::error() << "Socket path is too long: " << socketPath << logging::endl;
+		return 1;
+	}
+	int serverSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(serverSocket < 0)
+	{
+		logging::error() << "Failed to create socket: " << strerror(errno) << logging::endl;
+		return 1;
+	}
+	//remove the socket left over by a previous server
+	unlink(socketPath.data());
+	if(bind(serverSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(serverSocket, SOMAXCONN) != 0)
+	{
+		logging::error() << "Failed to listen on socket '" << socketPath << "': " << strerror(errno) << logging::endl;
+		close(serverSocket);
+		return 1;
+	}
+	INFO_LOG("Compilation server listening on: " << socketPath << logging::endl);
+
+	while(true)
+	{
+		int connection = accept(serverSocket, nullptr, nullptr);
+		if(connection < 0)
+		{
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			logging::error() << "Failed to accept connection: " << strerror(errno) << logging::endl;
+			break;
+		}
+#ifdef MULTI_THREADED
+		threading::ThreadPool::getGlobalPool().schedule(std::make_shared<threading::Task>([connection]() -> void { handleConnection(connection); }, "Server"));
+#else
+		handleConnection(connection);
+#endif
+	}
+	close(serverSocket);
+	unlink(socketPath.data());
+	return 1;
+}
+
+Optional<std::size_t> vc4c::compileOnServer(const std::string& socketPath, std::istream& input, std::ostream& output, const Configuration& config,
+		const std::string& options, const Optional<std::string>& inputFile)
+{
+	sockaddr_un address;
+	if(!toSocketAddress(socketPath, address))
+		return {};
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0)
+		return {};
+	if(connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		DEBUG_LOG("Compilation server is not available: " << strerror(errno) << logging::endl);
+		close(fd);
+		return {};
+	}
+
+	MessageWriter request;
+	request.writeInt(SERVER_MAGIC_NUMBER);
+	request.writeInt(SERVER_PROTOCOL_VERSION);
+	writeConfiguration(request, config);
+	request.writeString(options);
+	//the server can run in another working directory
+	std::string fileName;
+	if(inputFile)
+	{
+		char* absolutePath = realpath(inputFile.get().data(), nullptr);
+		fileName = absolutePath != nullptr ? absolutePath : inputFile.get();
+		free(absolutePath);
+	}
+	request.writeString(fileName);
+	request.writeString(std::string(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()));
+	if(!sendAll(fd, request.data))
+	{
+		close(fd);
+		throw CompilationError(CompilationStep::GENERAL, "Failed to send request to compilation server", strerror(errno));
+	}
+
+	std::string result;
+	int32_t status = STATUS_ERROR;
+	try
+	{
+		MessageReader response(fd);
+		status = response.readInt<int32_t>();
+		result = response.readString();
+	}
+	catch(...)
+	{
+		close(fd);
+		throw;
+	}
+	close(fd);
+	if(status != STATUS_SUCCESS)
+		throw CompilationError(CompilationStep::GENERAL, "Compilation server failed", result);
+	output.write(result.data(), static_cast<std::streamsize>(result.size()));
+	output.flush();
+	return result.size();
+}
@@ -0,0 +1,49 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef COMPILESERVER_H
+#define COMPILESERVER_H
+
+#include "config.h"
+#include "helper.h"
+
+#include <iostream>
+#include <string>
+
+namespace vc4c
+{
+	/*
+	 * Long-running compilation server, listening on a UNIX domain socket.
+	 *
+	 * The server keeps the state initialized once per process (thread-pool, intrinsic tables, pre-compiled headers, compilation caches) warm,
+	 * so the single compilations do not pay for it. Every connection transmits exactly one compilation request and its result:
+	 * - request: magic number, protocol version, the configuration, the pre-compiler options, the (absolute) input file name (may be empty) and the source code
+	 * - response: status (0 on success), followed by the compiled code or the error message
+	 *
+	 * The requests are compiled in parallel on the global thread-pool.
+	 */
+
+	/*
+	 * Returns the socket of the compilation server as set in the environment-variable VC4C_SERVER_SOCKET, if any
+	 */
+	Optional<std::string> getCompileServerSocket();
+
+	/*
+	 * Listens on the given socket and serves compilation requests. Only returns on errors setting up the socket
+	 */
+	int runCompileServer(const std::string& socketPath);
+
+	/*
+	 * Sends the compilation request to the server listening on the given socket and writes the compiled code into the output.
+	 *
+	 * Returns no value, if the server is not available (so the code needs to be compiled locally).
+	 * Throws a CompilationError, if the server failed to compile the code
+	 */
+	Optional<std::size_t> compileOnServer(const std::string& socketPath, std::istream& input, std::ostream& output, const Configuration& config,
+			const std::string& options, const Optional<std::string>& inputFile);
+} /* namespace vc4c */
+
+#endif /* COMPILESERVER_H */
@@ -5,6 +5,7 @@
  */
 
 #include <vector>
+#include <fstream>
 #include <memory>
 #include <cstdlib>
 #include <cstdio>
@@ -13,17 +14,27 @@
 #include <iterator>
 #include <algorithm>
 #include <sstream>
+#include <map>
+#include <mutex>
+#include <atomic>
 
 #include "Compiler.h"
 #include "Parser.h"
 #include "llvm/IRParser.h"
 #include "spirv/SPIRVParser.h"
 #include "optimization/Optimizer.h"
+#include "optimization/Instrumentation.h"
 #include "asm/CodeGenerator.h"
-#include "log.h"
+#include "asm/DebugGraph.h"
+#include "Logging.h"
 #include "logger.h"
 #include "Profiler.h"
 #include "BackgroundWorker.h"
+#include "CompilationBudget.h"
+#include "CompilationCache.h"
+#include "MemoryStream.h"
+#include "Serialization.h"
+#include "intermediate/InstructionArena.h"
 
 #ifdef VERIFIER_HEADER
 #include VERIFIER_HEADER
@@ -52,14 +63,14 @@ static std::unique_ptr<Parser> getParser(std::istream& stream)
     switch(type)
     {
     case SourceType::LLVM_IR_TEXT:
-        logging::info() << "Using LLVM-IR frontend..." << logging::endl;
+        INFO_LOG("Using LLVM-IR frontend..." << logging::endl);
         return std::unique_ptr<Parser>(new llvm2qasm::IRParser(stream));
     case SourceType::LLVM_IR_BIN:
     	throw CompilationError(CompilationStep::GENERAL, "LLVM-IR binary needs to be first converted to SPIR-V binary or LLVM-IR text!");
     case SourceType::SPIRV_TEXT:
     	throw CompilationError(CompilationStep::GENERAL, "SPIR-V text needs to be first converted to SPIR-V binary!");
     case SourceType::SPIRV_BIN:
-        logging::info() << "Using SPIR-V frontend..." << logging::endl;
+        INFO_LOG("Using SPIR-V frontend..." << logging::endl);
         return std::unique_ptr<Parser>(new spirv2qasm::SPIRVParser(stream, false));
     case SourceType::OPENCL_C:
         throw CompilationError(CompilationStep::GENERAL, "OpenCL code needs to be first compiled with CLang!");
@@ -72,79 +83,267 @@ static std::unique_ptr<Parser> getParser(std::istream& stream)
     return nullptr;
 }
 
-// register/instruction mapping
-static void toMachineCode(qpu_asm::CodeGenerator& codeGen, Method& kernel)
+/*
+ * Returns whether the code of this compilation is to be verified, i.e. every n-th compilation of the process (see Configuration#verificationInterval)
+ */
+static bool isVerificationSampled(const Configuration& config)
 {
-	kernel.cleanLocals();
-	const auto& instructions = codeGen.generateInstructions(kernel);
 #ifdef VERIFIER_HEADER
-	std::vector<uint64_t> hexData;
-	hexData.reserve(instructions.size());
-	for (const std::unique_ptr<qpu_asm::Instruction>& instr : instructions) {
-		hexData.push_back(instr->toBinaryCode());
-	}
+	static std::atomic<unsigned> numCompilations{0};
+	return config.verificationInterval != 0 && numCompilations.fetch_add(1) % config.verificationInterval == 0;
+#else
+	return false;
+#endif
+}
 
+/*
+ * Checks the generated machine code of the kernel with the verifier, throws a CompilationError on any error found.
+ *
+ * Only works on the copy of the code, so it can run concurrently to the code generation of other kernels
+ */
+static void verifyMachineCode(const std::string& kernelName, std::vector<uint64_t>& hexData)
+{
+#ifdef VERIFIER_HEADER
+	PROFILE_START(Verification);
+	//the assembler code is only decoded for the instructions reported by the verifier
 	Validator v;
-	v.OnMessage = [&instructions](const Message& msg) -> void
+	v.OnMessage = [&hexData, &kernelName](const Message& msg) -> void
 	{
 		const Validator::Message& validatorMessage = dynamic_cast<const Validator::Message&>(msg);
 		if(validatorMessage.Loc >= 0)
 		{
-			auto it = instructions.begin();
-			std::advance(it, validatorMessage.Loc);
-			logging::error() << "Validation-error '" << validatorMessage.Text << "' in: " << (*it)->toASMString() << logging::endl;
+			logging::error() << "Validation-error '" << validatorMessage.Text << "' in kernel '" << kernelName << "': " << qpu_asm::Instruction::decode(hexData.at(static_cast<std::size_t>(validatorMessage.Loc)))->toASMString() << logging::endl;
 			if(validatorMessage.RefLoc >= 0)
-			{
-				it = instructions.begin();
-				std::advance(it, validatorMessage.RefLoc);
-				logging::error() << "With reference to instruction: " << (*it)->toASMString() << logging::endl;
-			}
+				logging::error() << "With reference to instruction: " << qpu_asm::Instruction::decode(hexData.at(static_cast<std::size_t>(validatorMessage.RefLoc)))->toASMString() << logging::endl;
 		}
 		throw CompilationError(CompilationStep::VERIFIER, msg.toString());
 	};
 	v.Instructions = &hexData;
-	logging::info() << "Validation-output: " << logging::endl;
+	INFO_LOG("Validation-output for kernel '" << kernelName << "': " << logging::endl);
 	v.Validate();
 	fflush(stderr);
+	PROFILE_END(Verification);
 #endif
 }
 
-std::size_t Compiler::convert()
+// register/instruction mapping
+//if given, the generated code is copied into the verified code, so it can be verified afterwards
+static void toMachineCode(qpu_asm::CodeGenerator& codeGen, Method& kernel, std::vector<uint64_t>* verifiedCode = nullptr)
 {
-    std::unique_ptr<Parser> parser = getParser(input);
-    Module module(config);
-    PROFILE_START(Parser);
-    parser->parse(module);
-    PROFILE_END(Parser);
+	kernel.cleanLocals();
+	PROFILE_START(CodeGeneration);
+	const auto& instructions = codeGen.generateInstructions(kernel);
+	PROFILE_END(CodeGeneration);
+	if(verifiedCode != nullptr)
+		*verifiedCode = instructions;
+	//the output is written from the encoded machine code, so the intermediate instructions are not needed anymore
+	kernel.releaseInstructions();
+}
+
+/*
+ * Records the peak memory usage of the process and the number of instructions and locals of all methods after the given phase with the profiler
+ */
+static void recordMemoryUsage(const std::string& phase, const Module* module = nullptr)
+{
+	if(!profiler::isEnabled())
+		return;
+	PROFILE_MAXIMUM(phase + ": peak RSS (bytes)", getPeakMemoryUsage());
+	if(module == nullptr)
+		return;
+	std::size_t numInstructions = 0;
+	std::size_t numLocals = 0;
+	for(const auto& method : module->methods)
+	{
+		numInstructions += method->countInstructions();
+		numLocals += method->readLocals().size();
+	}
+	PROFILE_MAXIMUM(phase + ": instructions", numInstructions);
+	PROFILE_MAXIMUM(phase + ": locals", numLocals);
+}
+
+/*
+ * Records the sizes of the intermediate representation and the high-water mark of the instruction arena of the given kernel, the maximum of all kernels is reported
+ */
+static void recordMemoryUsage(const std::string& phase, Method& kernel)
+{
+	if(!profiler::isEnabled())
+		return;
+	PROFILE_MAXIMUM(phase + ": peak RSS (bytes)", getPeakMemoryUsage());
+	PROFILE_MAXIMUM(phase + ": instructions per kernel", kernel.countInstructions());
+	PROFILE_MAXIMUM(phase + ": locals per kernel", kernel.readLocals().size());
+	PROFILE_MAXIMUM(phase + ": instruction arena peak per kernel (bytes)", kernel.getInstructionArena()->getPeakUsage());
+	PROFILE_MAXIMUM(phase + ": instruction arena reserved per kernel (bytes)", kernel.getInstructionArena()->getReservedSize());
+}
+
+/*
+ * Parses the input into the module.
+ *
+ * If the compilation cache is enabled, the module produced by the front-ends is serialized,
+ * so later compilations of the same input (e.g. with another target configuration) can skip the parsing
+ */
+static void parseModule(std::istream& input, Module& module, const Configuration& config)
+{
+	const std::string source((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+	const bool cacheEnabled = Compiler::getCacheBackend() != nullptr;
+	const std::string key = cacheEnabled ? getParsedModuleCacheKey(source, config) : "";
+	if(cacheEnabled)
+	{
+		const Optional<std::string> cached = readCompilationCache(key);
+		if(cached)
+		{
+			MemoryStreamBuffer buffer(cached.get().data(), cached.get().size());
+			std::istream stream(&buffer);
+			try
+			{
+				deserializeModule(module, stream);
+				INFO_LOG("Using cached module, skipping the front-end..." << logging::endl);
+				return;
+			}
+			catch(const CompilationError& e)
+			{
+				logging::warn() << "Failed to load cached module, parsing the input again: " << e.what() << logging::endl;
+				module.methods.clear();
+				module.globalData.clear();
+			}
+		}
+	}
+
+	MemoryStreamBuffer buffer(source.data(), source.size());
+	std::istream stream(&buffer);
+	std::unique_ptr<Parser> parser = getParser(stream);
+	parser->parse(module);
+
+	if(cacheEnabled)
+	{
+		std::ostringstream serialized;
+		try
+		{
+			serializeModule(module, serialized);
+			writeCompilationCache(key, serialized.str());
+		}
+		catch(const CompilationError& e)
+		{
+			DEBUG_LOG("Module can't be cached: " << e.what() << logging::endl);
+		}
+	}
+}
 
+static std::chrono::microseconds getElapsedTime(const std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
+
+/*
+ * Optimizes the parsed module and writes the generated code, the statistics are written into the metrics
+ */
+static std::size_t generateCode(Module& module, const Configuration& config, std::ostream& output, CompilationMetrics& metrics)
+{
     optimizations::Optimizer opt(config);
     qpu_asm::CodeGenerator codeGen(module, config);
+    auto start = std::chrono::steady_clock::now();
     PROFILE_START(Optimizer);
-    opt.optimize(module);
+    opt.prepare(module);
     PROFILE_END(Optimizer);
+    metrics.preparationTime = getElapsedTime(start);
+    recordMemoryUsage("Prepare", &module);
 
+    //every kernel is optimized and converted to machine code on its own, without waiting for the other kernels to be optimized
+    const std::vector<Method*> kernels = module.getKernels();
+    //the entries are created up-front, so every worker only modifies its own entry
+    metrics.kernels.assign(kernels.size(), KernelMetrics{});
+    //if all kernels are compiled via the fast path, starting the threads takes longer than compiling the kernels one after the other
+    const bool runInline = config.fastPathInstructions > 0 && std::all_of(kernels.begin(), kernels.end(), [&config](const Method* kernel) -> bool
+	{
+    	return kernel->countInstructions() <= config.fastPathInstructions;
+	});
+    //the verification of the code of a kernel is started as soon as the code is generated and runs concurrently to the code generation of the other kernels.
+    //The verifiers are created up-front, so their addresses (referenced by the scheduled tasks) do not change
+    const bool verify = isVerificationSampled(config);
+    std::vector<std::vector<uint64_t>> verifiedCode(verify ? kernels.size() : 0);
+    std::vector<threading::BackgroundWorker> verifiers;
+    verifiers.reserve(verifiedCode.size());
+    for(std::size_t i = 0; i < verifiedCode.size(); ++i)
+    {
+    	const std::string& kernelName = kernels[i]->name;
+    	std::vector<uint64_t>& code = verifiedCode[i];
+    	verifiers.emplace_back([&kernelName, &code]() -> void { verifyMachineCode(kernelName, code); }, "Verifier");
+    }
     std::vector<threading::BackgroundWorker> workers;
-    workers.reserve(module.getKernels().size());
-    for(Method* kernelFunc : module.getKernels())
+    workers.reserve(runInline ? 0 : kernels.size());
+    for(std::size_t i = 0; i < kernels.size(); ++i)
     {
-        auto f = [&codeGen, kernelFunc]() -> void
+    	Method* kernelFunc = kernels[i];
+    	KernelMetrics& kernelMetrics = metrics.kernels[i];
+    	std::vector<uint64_t>* kernelCode = verify ? &verifiedCode[i] : nullptr;
+    	threading::BackgroundWorker* verifier = verify ? &verifiers[i] : nullptr;
+        auto f = [&opt, &module, &codeGen, kernelFunc, &kernelMetrics, kernelCode, verifier]() -> void
 		{
-        	toMachineCode(codeGen, *kernelFunc);
+        	intermediate::InstructionArena::Scope arenaScope(kernelFunc->getInstructionArena());
+        	profiler::TraceContext traceContext(kernelFunc->name);
+        	kernelMetrics.name = kernelFunc->name;
+        	kernelMetrics.instructionsBefore = kernelFunc->countInstructions();
+        	auto kernelStart = std::chrono::steady_clock::now();
+        	opt.optimizeKernel(module, *kernelFunc);
+        	kernelMetrics.optimizationTime = getElapsedTime(kernelStart);
+        	kernelMetrics.instructionsAfter = kernelFunc->countInstructions();
+        	recordMemoryUsage("Optimizer", *kernelFunc);
+        	kernelStart = std::chrono::steady_clock::now();
+        	toMachineCode(codeGen, *kernelFunc, kernelCode);
+        	kernelMetrics.codeGenerationTime = getElapsedTime(kernelStart);
+        	recordMemoryUsage("CodeGeneration", *kernelFunc);
+        	if(verifier != nullptr)
+        		(*verifier)();
 		};
-		workers.emplace(workers.end(), f, "Code Generator")->operator ()();
+		if(runInline)
+			f();
+		else
+			workers.emplace(workers.end(), f, "Compiler")->operator ()();
     }
+    //the verifiers can only be started by the workers, so all workers need to finish before waiting for the verifiers
+    for(const threading::BackgroundWorker& worker : workers)
+    	worker.waitFor();
+    threading::BackgroundWorker::waitForAll(verifiers);
     threading::BackgroundWorker::waitForAll(workers);
+    opt.writeReport();
+    for(std::size_t i = 0; i < kernels.size(); ++i)
+    	codeGen.addKernelMetrics(*kernels[i], metrics.kernels[i]);
     
-    //TODO could discard unused globals
-    //since they are exported, they are still in the code, even if not used (e.g. optimized away)
+    //the globals not accessed by any kernel after the optimizations are dropped from the global data segment by the code generator
 
     //code generation
+    start = std::chrono::steady_clock::now();
+    PROFILE_START(WriteOutput);
     std::size_t bytesWritten = codeGen.writeOutput(output);
     output.flush();
+    PROFILE_END(WriteOutput);
+    metrics.outputTime = getElapsedTime(start);
+    recordMemoryUsage("WriteOutput");
+    codeGen.writePerformanceReport();
+    if(!config.blockLayoutFile.empty())
+    {
+    	std::ofstream file(config.blockLayoutFile, std::ios_base::out | std::ios_base::trunc);
+    	optimizations::writeBlockLayout(module, file);
+    	if(!file)
+    		logging::warn() << "Failed to write block layout to: " << config.blockLayoutFile << logging::endl;
+    }
     
     return bytesWritten;
 }
 
+std::size_t Compiler::convert()
+{
+    Module module(config);
+    metrics = CompilationMetrics{};
+    const auto start = std::chrono::steady_clock::now();
+    PROFILE_START(Parser);
+    parseModule(input, module, config);
+    PROFILE_END(Parser);
+    metrics.parsingTime = getElapsedTime(start);
+    recordMemoryUsage("Parser", &module);
+
+    return generateCode(module, config, output, metrics);
+}
+
 Configuration& Compiler::getConfiguration()
 {
     return config;
@@ -155,11 +354,58 @@ const Configuration& Compiler::getConfiguration() const
     return config;
 }
 
-std::size_t Compiler::compile(std::istream& input, std::ostream& output, const Configuration config, const std::string& options, const Optional<std::string>& inputFile)
+const CompilationMetrics& Compiler::getMetrics() const
+{
+	return metrics;
+}
+
+/*
+ * The source code in memory, mapped from the input file or the input memory buffer without copying it, if possible
+ */
+struct SourceCode
+{
+    std::unique_ptr<MappedFile> mappedFile;
+    std::string copy;
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    SourceCode(std::istream& input, const Optional<std::string>& inputFile)
+    {
+        const MemoryStreamBuffer* memoryInput = dynamic_cast<const MemoryStreamBuffer*>(input.rdbuf());
+        if(inputFile)
+            mappedFile.reset(new MappedFile(inputFile.get()));
+        if(mappedFile && mappedFile->isValid())
+        {
+            data = mappedFile->data();
+            size = mappedFile->size();
+        }
+        else if(memoryInput != nullptr && !inputFile)
+        {
+            data = memoryInput->data();
+            size = memoryInput->size();
+        }
+        else
+        {
+            std::ifstream file;
+            if(inputFile)
+                file.open(inputFile.get(), std::ios_base::in | std::ios_base::binary);
+            std::istream& sourceStream = inputFile ? file : input;
+            copy.assign(std::istreambuf_iterator<char>(sourceStream), std::istreambuf_iterator<char>());
+            data = copy.data();
+            size = copy.size();
+        }
+    }
+};
+
+/*
+ * Runs the pre-compiler to convert the source into the input of the front-ends
+ */
+static std::string precompile(const SourceCode& source, const std::string& options, const Optional<std::string>& inputFile)
 {
-    //pre-compilation
     PROFILE_START(Precompile);
-    Precompiler precompiler(input, Precompiler::getSourceType(input), inputFile);
+    MemoryStreamBuffer sourceBuffer(source.data, source.size);
+    std::istream sourceStream(&sourceBuffer);
+    Precompiler precompiler(sourceStream, Precompiler::getSourceType(sourceStream), inputFile);
     std::unique_ptr<std::istream> in;
 #if defined SPIRV_CLANG_PATH
     precompiler.run(in, SourceType::SPIRV_BIN, options);
@@ -168,15 +414,69 @@ std::size_t Compiler::compile(std::istream& input, std::ostream& output, const C
 #else
     throw CompilationError(CompilationStep::PRECOMPILATION, "No matching precompiler available!");
 #endif
+    //the output of the pre-compiler can share the buffer of the input, so it is read before the input goes out of scope
+    std::string result(std::istreambuf_iterator<char>(*in), {});
     PROFILE_END(Precompile);
+    recordMemoryUsage("Precompile");
+    return result;
+}
+
+/*
+ * With a time or memory budget, the result depends on the load of the machine, so it might be degraded and is not cached.
+ * The block layout and the debug graphs are side outputs of the compilation, which would not be written for a cached result
+ */
+static bool isCacheable(const Configuration& config)
+{
+    return config.maxCompilationTime == 0 && config.maxMemoryUsage == 0 && config.blockLayoutFile.empty() && config.debugGraphDirectory.empty();
+}
+
+std::size_t Compiler::compile(std::istream& input, std::ostream& output, const Configuration config, const std::string& options, const Optional<std::string>& inputFile,
+		CompilationMetrics* metrics)
+{
+    //access the source in memory without copying it, if possible
+    const SourceCode source(input, inputFile);
+
+    //look-up in the compilation cache
+    const std::string cacheKey = getCompilationCacheKey(source.data, source.size, options, config);
+    const Optional<std::string> cached = readCompilationCache(cacheKey);
+    if(cached)
+    {
+        output.write(cached.get().data(), static_cast<std::streamsize>(cached.get().size()));
+        output.flush();
+        if(metrics != nullptr)
+        {
+        	*metrics = CompilationMetrics{};
+        	metrics->fromCache = true;
+        }
+        return cached.get().size();
+    }
+
+    //pre-compilation
+    const auto start = std::chrono::steady_clock::now();
+    const std::string precompiled = precompile(source, options, inputFile);
+    const std::chrono::microseconds precompilationTime = getElapsedTime(start);
+    MemoryStreamBuffer precompiledBuffer(precompiled.data(), precompiled.size());
+    std::istream in(&precompiledBuffer);
     
     //compilation
-    Compiler conv(*in.get(), output);
+    std::ostringstream binary;
+    Compiler conv(in, binary);
 
     conv.getConfiguration() = config;
     std::size_t result = conv.convert();
+    if(metrics != nullptr)
+    {
+    	*metrics = conv.getMetrics();
+    	metrics->precompilationTime = precompilationTime;
+    }
+    const std::string binaryData = binary.str();
+    if(isCacheable(config))
+        writeCompilationCache(cacheKey, binaryData);
+    output.write(binaryData.data(), static_cast<std::streamsize>(binaryData.size()));
     
     //clean-up
+    //the debug graphs are written in the background, but need to be complete when the compilation returns
+    qpu_asm::waitForDebugGraphs();
     std::wcout.flush();
     std::wcerr.flush();
     output.flush();
@@ -184,7 +484,254 @@ std::size_t Compiler::compile(std::istream& input, std::ostream& output, const C
     return result;
 }
 
+std::vector<CompilationResult> Compiler::compileVariants(std::istream& input, const std::vector<std::ostream*>& outputs, const std::vector<Configuration>& configs,
+		const std::string& options, const Optional<std::string>& inputFile)
+{
+	if(outputs.size() != configs.size())
+		throw CompilationError(CompilationStep::GENERAL, "The number of outputs does not match the number of configurations");
+	std::vector<CompilationResult> results(configs.size());
+	if(configs.empty())
+		return results;
+
+	const SourceCode source(input, inputFile);
+	auto start = std::chrono::steady_clock::now();
+	const std::string precompiled = precompile(source, options, inputFile);
+	const std::chrono::microseconds precompilationTime = getElapsedTime(start);
+
+	//the front-ends only depend on the SPIR-V optimization passes, which are taken from the first configuration
+	std::unique_ptr<ModuleSnapshot> snapshot;
+	//the shared parsing is accounted to every variant
+	std::chrono::microseconds parsingTime{0};
+	{
+		//the parsed module is only kept as snapshot, so it does not occupy memory while the variants are compiled
+		Module baseModule(configs.front());
+		MemoryStreamBuffer precompiledBuffer(precompiled.data(), precompiled.size());
+		std::istream in(&precompiledBuffer);
+		start = std::chrono::steady_clock::now();
+		PROFILE_START(Parser);
+		parseModule(in, baseModule, configs.front());
+		PROFILE_END(Parser);
+		parsingTime = getElapsedTime(start);
+		recordMemoryUsage("Parser", &baseModule);
+		try
+		{
+			snapshot.reset(new ModuleSnapshot(baseModule));
+		}
+		catch(const CompilationError& e)
+		{
+			DEBUG_LOG("Module can't be copied, parsing it for every variant: " << e.what() << logging::endl);
+		}
+	}
+
+	std::vector<threading::BackgroundWorker> workers;
+	workers.reserve(configs.size());
+	for(std::size_t i = 0; i < configs.size(); ++i)
+	{
+		auto f = [&, i]() -> void
+		{
+			const Configuration& config = configs[i];
+			std::ostream& output = *outputs[i];
+			CompilationResult& result = results[i];
+			try
+			{
+				const std::string cacheKey = getCompilationCacheKey(source.data, source.size, options, config);
+				const Optional<std::string> cached = readCompilationCache(cacheKey);
+				if(cached)
+				{
+					output.write(cached.get().data(), static_cast<std::streamsize>(cached.get().size()));
+					result.bytesWritten = cached.get().size();
+					result.metrics.fromCache = true;
+				}
+				else
+				{
+					//every variant is optimized in its own copy of the parsed module
+					Module module(config);
+					if(snapshot && config.spirvOptimizationPasses == configs.front().spirvOptimizationPasses)
+						snapshot->restore(module);
+					else
+					{
+						MemoryStreamBuffer precompiledBuffer(precompiled.data(), precompiled.size());
+						std::istream in(&precompiledBuffer);
+						parseModule(in, module, config);
+					}
+					std::ostringstream binary;
+					result.metrics.precompilationTime = precompilationTime;
+					result.metrics.parsingTime = parsingTime;
+					result.bytesWritten = generateCode(module, config, binary, result.metrics);
+					const std::string binaryData = binary.str();
+					if(isCacheable(config))
+						writeCompilationCache(cacheKey, binaryData);
+					output.write(binaryData.data(), static_cast<std::streamsize>(binaryData.size()));
+				}
+				output.flush();
+				result.success = true;
+			}
+			catch(const std::exception& e)
+			{
+				logging::error() << "Compilation of variant " << i << " failed: " << e.what() << logging::endl;
+				result.error = e.what();
+			}
+		};
+		workers.emplace(workers.end(), f, "Variant")->operator ()();
+	}
+	threading::BackgroundWorker::waitForAll(workers);
+	qpu_asm::waitForDebugGraphs();
+	return results;
+}
+
+std::vector<CompilationResult> Compiler::compileAll(const std::vector<CompilationJob>& jobs)
+{
+	std::vector<CompilationResult> results(jobs.size());
+	std::vector<threading::BackgroundWorker> workers;
+	workers.reserve(jobs.size());
+	for(std::size_t i = 0; i < jobs.size(); ++i)
+	{
+		const CompilationJob& job = jobs[i];
+		CompilationResult& result = results[i];
+		auto f = [&job, &result]() -> void
+		{
+			//the errors are reported per job, so they are not passed to the worker
+			try
+			{
+				result.bytesWritten = compile(*job.input, *job.output, job.config, job.options, job.inputFile, &result.metrics);
+				result.success = true;
+			}
+			catch(const std::exception& e)
+			{
+				logging::error() << "Compilation of " << (job.inputFile ? job.inputFile.get() : "input") << " failed: " << e.what() << logging::endl;
+				result.error = e.what();
+			}
+		};
+		workers.emplace(workers.end(), f, "Batch")->operator ()();
+	}
+	threading::BackgroundWorker::waitForAll(workers);
+	return results;
+}
+
+struct LazyCompilation::State
+{
+	//the source is copied, since the input might not outlive this object, but is required for the cache-key
+	const std::string source;
+	const Configuration config;
+	const std::string options;
+	Module module;
+	optimizations::Optimizer optimizer;
+	qpu_asm::CodeGenerator codeGen;
+	//the compiled kernels with the statistics of their compilation
+	std::map<std::string, KernelMetrics> compiledKernels;
+	mutable std::mutex lock;
+
+	//the module, optimizer and code generator refer to the copied configuration
+	State(const SourceCode& source, const Configuration& config, const std::string& options) : source(source.data, source.size), config(config), options(options), module(this->config),
+			optimizer(this->config), codeGen(module, this->config)
+	{
+	}
+};
+
+LazyCompilation::LazyCompilation(std::istream& input, const Configuration& config, const std::string& options, const Optional<std::string>& inputFile) :
+		state(new State(SourceCode(input, inputFile), config, options))
+{
+	MemoryStreamBuffer sourceBuffer(state->source.data(), state->source.size());
+	std::istream sourceStream(&sourceBuffer);
+	const std::string precompiled = precompile(SourceCode(sourceStream, {}), options, inputFile);
+	MemoryStreamBuffer precompiledBuffer(precompiled.data(), precompiled.size());
+	std::istream in(&precompiledBuffer);
+	PROFILE_START(Parser);
+	parseModule(in, state->module, config);
+	PROFILE_END(Parser);
+	recordMemoryUsage("Parser", &state->module);
+	PROFILE_START(Optimizer);
+	state->optimizer.prepare(state->module);
+	PROFILE_END(Optimizer);
+	recordMemoryUsage("Prepare", &state->module);
+}
+
+LazyCompilation::~LazyCompilation()
+{
+	//defined here, where the state is a complete type
+}
+
+std::vector<std::string> LazyCompilation::getKernelNames() const
+{
+	std::lock_guard<std::mutex> guard(state->lock);
+	std::vector<std::string> names;
+	for(const Method* kernel : state->module.getKernels())
+		names.push_back(kernel->name);
+	return names;
+}
+
+bool LazyCompilation::isCompiled(const std::string& kernelName) const
+{
+	std::lock_guard<std::mutex> guard(state->lock);
+	return state->compiledKernels.find(kernelName) != state->compiledKernels.end();
+}
+
+KernelMetrics LazyCompilation::compileKernel(const std::string& kernelName)
+{
+	std::lock_guard<std::mutex> guard(state->lock);
+	auto it = state->compiledKernels.find(kernelName);
+	if(it != state->compiledKernels.end())
+		return it->second;
+	const std::vector<Method*> kernels = state->module.getKernels();
+	const auto kernelIt = std::find_if(kernels.begin(), kernels.end(), [&kernelName](const Method* kernel) -> bool { return kernel->name == kernelName; });
+	if(kernelIt == kernels.end())
+		throw CompilationError(CompilationStep::GENERAL, "Program does not contain the kernel", kernelName);
+	Method& kernel = **kernelIt;
+
+	KernelMetrics metrics;
+	intermediate::InstructionArena::Scope arenaScope(kernel.getInstructionArena());
+	profiler::TraceContext traceContext(kernel.name);
+	metrics.name = kernel.name;
+	metrics.instructionsBefore = kernel.countInstructions();
+	auto start = std::chrono::steady_clock::now();
+	state->optimizer.optimizeKernel(state->module, kernel);
+	metrics.optimizationTime = getElapsedTime(start);
+	metrics.instructionsAfter = kernel.countInstructions();
+	recordMemoryUsage("Optimizer", kernel);
+	start = std::chrono::steady_clock::now();
+	std::vector<uint64_t> verifiedCode;
+	const bool verify = isVerificationSampled(state->config);
+	toMachineCode(state->codeGen, kernel, verify ? &verifiedCode : nullptr);
+	metrics.codeGenerationTime = getElapsedTime(start);
+	recordMemoryUsage("CodeGeneration", kernel);
+	if(verify)
+		//a single kernel is compiled on demand, so there is nothing to run the verification concurrently to
+		verifyMachineCode(kernel.name, verifiedCode);
+	state->codeGen.addKernelMetrics(kernel, metrics);
+	return state->compiledKernels.emplace(kernelName, metrics).first->second;
+}
+
+std::size_t LazyCompilation::writeOutput(std::ostream& output)
+{
+	std::lock_guard<std::mutex> guard(state->lock);
+	std::ostringstream binary;
+	PROFILE_START(WriteOutput);
+	const std::size_t bytesWritten = state->codeGen.writeOutput(binary);
+	PROFILE_END(WriteOutput);
+	const std::string binaryData = binary.str();
+	if(isCacheable(state->config))
+	{
+		//the same entry is looked up when compiling the program with exactly these kernels selected
+		Configuration selectedConfig = state->config;
+		selectedConfig.selectedKernels.clear();
+		for(const auto& pair : state->compiledKernels)
+			selectedConfig.selectedKernels.push_back(pair.first);
+		writeCompilationCache(getCompilationCacheKey(state->source.data(), state->source.size(), state->options, selectedConfig), binaryData);
+	}
+	output.write(binaryData.data(), static_cast<std::streamsize>(binaryData.size()));
+	output.flush();
+	qpu_asm::waitForDebugGraphs();
+	return bytesWritten;
+}
+
 std::unique_ptr<logging::Logger> logging::LOGGER(new logging::ColoredLogger(std::wcout, logging::Level::WARNING));
+std::atomic<unsigned> vc4c::minimumLogSeverity(getLogSeverity(LogLevel::WARNING));
+thread_local unsigned vc4c::compilationLogSeverity = NO_LOG_SEVERITY;
+
+void vc4c::setMinimumLogLevel(LogLevel level)
+{
+	minimumLogSeverity.store(getLogSeverity(level), std::memory_order_relaxed);
+}
 
 void vc4c::setLogger(std::wostream& outputStream, const bool coloredOutput, const LogLevel level)
 {
@@ -192,4 +739,15 @@ void vc4c::setLogger(std::wostream& outputStream, const bool coloredOutput, cons
 		logging::LOGGER.reset(new logging::ColoredLogger(outputStream, static_cast<logging::Level>(level)));
 	else
 		logging::LOGGER.reset(new logging::StreamLogger(outputStream, static_cast<logging::Level>(level)));
+	setMinimumLogLevel(level);
+}
+
+LogLevelScope::LogLevelScope(const LogLevel level) : previousSeverity(compilationLogSeverity)
+{
+	compilationLogSeverity = getLogSeverity(level);
+}
+
+LogLevelScope::~LogLevelScope()
+{
+	compilationLogSeverity = previousSeverity;
 }
@@ -6,6 +6,7 @@
 
 #include "CompilationError.h"
 #include "InstructionWalker.h"
+#include "analysis/AnalysisManager.h"
 
 using namespace vc4c;
 
@@ -64,7 +65,7 @@ bool InstructionVisitor::visit(const InstructionWalker& start) const
 	}
 }
 
-bool InstructionVisitor::visitReverse(const InstructionWalker& start, Graph<InstructionWalker, Node<InstructionWalker, bool>>* blockGraph) const
+bool InstructionVisitor::visitReverse(const InstructionWalker& start, const analysis::ControlFlowGraph* cfg) const
 {
 	InstructionWalker it(start);
 	while(true)
@@ -91,15 +92,16 @@ bool InstructionVisitor::visitReverse(const InstructionWalker& start, Graph<Inst
 				else //start of block and follow jumps -> follow jumps backwards
 				{
 					bool continueBranches = true;
-					if(blockGraph != nullptr)
+					if(cfg != nullptr)
 					{
 						//use pre-calculated graph of basic blocks
-						blockGraph->assertNode(it).forAllNeighbors(true, [&continueBranches, this, blockGraph](const Node<InstructionWalker, bool>* node) -> void
+						for(const analysis::CFGPredecessor& pred : cfg->getPredecessors(*it.getBasicBlock()))
 						{
 							//this makes sure, a STOP_ALL skips other predecessors
-							if(continueBranches)
-								continueBranches = visitReverse(node->key, blockGraph);
-						});
+							if(!continueBranches)
+								break;
+							continueBranches = visitReverse(pred.getLastInstruction(), cfg);
+						}
 					}
 					else
 					{
@@ -125,7 +127,7 @@ bool InstructionVisitor::visitReverse(const InstructionWalker& start, Graph<Inst
 	}
 }
 
-InstructionWalker::InstructionWalker() : basicBlock(nullptr), pos(nullptr)
+InstructionWalker::InstructionWalker() : basicBlock(nullptr), pos()
 {
 
 }
@@ -220,34 +222,48 @@ static void throwOnEnd(bool isEnd)
 intermediate::IntermediateInstruction* InstructionWalker::get()
 {
 	throwOnEnd(isEndOfMethod());
-	return (*pos).get();
+	return *pos;
 }
 
 const intermediate::IntermediateInstruction* InstructionWalker::get() const
 {
 	throwOnEnd(isEndOfMethod());
-	return (*pos).get();
+	return *pos;
 }
 
 intermediate::IntermediateInstruction* InstructionWalker::release()
 {
 	throwOnEnd(isEndOfMethod());
-	return (*pos).release();
+	intermediate::IntermediateInstruction* instr = basicBlock->instructions.release(pos);
+	//removing a branch changes the successors of the block
+	if(instr != nullptr && instr->is<intermediate::Branch>())
+		basicBlock->method.getAnalyses().blockModified(*basicBlock);
+	return instr;
 }
 
 InstructionWalker& InstructionWalker::reset(intermediate::IntermediateInstruction* instr)
 {
 	throwOnEnd(isEndOfMethod());
-	if(dynamic_cast<intermediate::BranchLabel*>(instr) != dynamic_cast<intermediate::BranchLabel*>((*pos).get()))
+	if(instr->is<intermediate::BranchLabel>() != (*pos != nullptr && (*pos)->is<intermediate::BranchLabel>()))
 			throw CompilationError(CompilationStep::GENERAL, "Can't add labels into a basic block", instr->to_string());
-	(*pos).reset(instr);
+	const bool changesBranch = *pos != nullptr && (*pos)->is<intermediate::Branch>();
+	const bool changesLabel = instr->is<intermediate::BranchLabel>() && instr->as<intermediate::BranchLabel>()->getLabel() != (*pos)->as<intermediate::BranchLabel>()->getLabel();
+	basicBlock->instructions.reset(pos, instr);
+	if(changesLabel)
+		//renaming a block changes the targets of all branches
+		basicBlock->method.getAnalyses().invalidate(analysis::AnalysisType::CONTROL_FLOW_GRAPH);
+	else if(changesBranch || instr->is<intermediate::Branch>())
+		basicBlock->method.getAnalyses().blockModified(*basicBlock);
 	return *this;
 }
 
 InstructionWalker& InstructionWalker::erase()
 {
 	throwOnEnd(isEndOfMethod());
+	const bool isBranch = *pos != nullptr && (*pos)->is<intermediate::Branch>();
 	pos = basicBlock->instructions.erase(pos);
+	if(isBranch)
+		basicBlock->method.getAnalyses().blockModified(*basicBlock);
 	return *this;
 }
 
@@ -255,9 +271,11 @@ InstructionWalker& InstructionWalker::emplace(intermediate::IntermediateInstruct
 {
 	if(isStartOfBlock())
 		throw CompilationError(CompilationStep::GENERAL, "Can't emplace at the start of a basic block", instr->to_string());
-	if(dynamic_cast<intermediate::BranchLabel*>(instr) != nullptr)
+	if(instr->is<intermediate::BranchLabel>())
 		throw CompilationError(CompilationStep::GENERAL, "Can't add labels into a basic block", instr->to_string());
 	pos = basicBlock->instructions.emplace(pos, instr);
+	if(instr->is<intermediate::Branch>())
+		basicBlock->method.getAnalyses().blockModified(*basicBlock);
 	return *this;
 }
 
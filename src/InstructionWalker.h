@@ -15,6 +15,11 @@
 
 namespace vc4c
 {
+	namespace analysis
+	{
+		class ControlFlowGraph;
+	}
+
 	enum class InstructionVisitResult
 	{
 		//continue to visit the next instruction
@@ -40,9 +45,11 @@ namespace vc4c
 		/*
 		 * Visits start and all preceding instructions, according to the settings
 		 *
+		 * If a control-flow graph is given, it is used to look up the predecessors of basic blocks instead of searching for them.
+		 *
 		 * \return true, if the beginning of the block/method was reached, false, of the visiting operation aborted with STOP_ALL
 		 */
-		bool visitReverse(const InstructionWalker& start, Graph<InstructionWalker, Node<InstructionWalker, bool>>* blockGraph = nullptr) const;
+		bool visitReverse(const InstructionWalker& start, const analysis::ControlFlowGraph* cfg = nullptr) const;
 	};
 
 	class InstructionWalker
@@ -76,16 +83,21 @@ namespace vc4c
 			return !(*this == other);
 		}
 
+		/*
+		 * Returns the current instruction, if it is of the given type. Uses the instruction-kind instead of RTTI
+		 */
 		template<typename T>
 		inline T* get()
 		{
-			return dynamic_cast<T*>(get());
+			intermediate::IntermediateInstruction* instr = get();
+			return instr == nullptr ? nullptr : instr->as<T>();
 		}
 
 		template<typename T>
 		inline const T* get() const
 		{
-			return dynamic_cast<T*>(get());
+			const intermediate::IntermediateInstruction* instr = get();
+			return instr == nullptr ? nullptr : instr->as<T>();
 		}
 
 		inline bool has() const
@@ -96,7 +108,8 @@ namespace vc4c
 		template<typename T>
 		inline bool has() const
 		{
-			return get<const T>() != nullptr;
+			const intermediate::IntermediateInstruction* instr = get();
+			return instr != nullptr && instr->is<T>();
 		}
 
 		inline intermediate::IntermediateInstruction* operator->()
@@ -117,7 +130,11 @@ namespace vc4c
 		InstructionWalker& erase();
 		InstructionWalker& emplace(intermediate::IntermediateInstruction* instr);
 
-		inline void forAllInstructions(const std::function<void(const intermediate::IntermediateInstruction*)>& func) const
+		/*
+		 * The functors are passed as template parameters, so they are called directly (and can be inlined) instead of via a type-erased std::function
+		 */
+		template<typename Func>
+		inline void forAllInstructions(Func&& func) const
 		{
 			const intermediate::CombinedOperation* combined = get<const intermediate::CombinedOperation>();
 			if(combined != nullptr)
@@ -129,7 +146,8 @@ namespace vc4c
 				func(get());
 		}
 
-		inline bool allInstructionMatches(const std::function<bool(const intermediate::IntermediateInstruction*)>& func) const
+		template<typename Func>
+		inline bool allInstructionMatches(Func&& func) const
 		{
 			const intermediate::CombinedOperation* combined = get<const intermediate::CombinedOperation>();
 			if(combined != nullptr)
@@ -139,7 +157,8 @@ namespace vc4c
 			return func(get());
 		}
 
-		inline bool anyInstructionMatches(const std::function<bool(const intermediate::IntermediateInstruction*)>& func) const
+		template<typename Func>
+		inline bool anyInstructionMatches(Func&& func) const
 		{
 			const intermediate::CombinedOperation* combined = get<const intermediate::CombinedOperation>();
 			if(combined != nullptr)
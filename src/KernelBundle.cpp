@@ -0,0 +1,243 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "KernelBundle.h"
+
+#include "CompilationCache.h"
+#include "CompilationError.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace vc4c;
+
+static_assert(sizeof(BundleEntry) == 32, "The bundle entries are mapped directly from the file");
+
+static std::size_t alignTo(const std::size_t offset, const std::size_t alignment)
+{
+	return offset % alignment == 0 ? offset : offset + alignment - (offset % alignment);
+}
+
+static void writeWord(std::ostream& stream, const uint32_t lower, const uint32_t upper)
+{
+	stream.write(reinterpret_cast<const char*>(&lower), sizeof(lower));
+	stream.write(reinterpret_cast<const char*>(&upper), sizeof(upper));
+}
+
+static uint32_t checkOffset(const std::size_t offset)
+{
+	if(offset > std::numeric_limits<uint32_t>::max())
+		throw CompilationError(CompilationStep::GENERAL, "Kernel bundle exceeds the maximum size", std::to_string(offset));
+	return static_cast<uint32_t>(offset);
+}
+
+uint64_t vc4c::getConfigurationHash(const Configuration& config)
+{
+	return std::stoull(getCacheKey(getConfigurationKey(config)).substr(0, 16), nullptr, 16);
+}
+
+std::string vc4c::compressProgram(const std::string& binary)
+{
+	//the last word is padded with zeroes, the uncompressed size is stored separately
+	std::vector<uint64_t> words((binary.size() + 7) / 8, 0);
+	memcpy(words.data(), binary.data(), binary.size());
+	std::string result;
+	const auto appendWord = [&result](const uint64_t word) -> void
+	{
+		result.append(reinterpret_cast<const char*>(&word), sizeof(word));
+	};
+	//only runs of at least this many equal words are repeated, since a repeated run takes two words
+	const std::size_t minRepeatedRun = 3;
+	std::size_t literalStart = 0;
+	std::size_t i = 0;
+	while(i < words.size())
+	{
+		std::size_t runEnd = i + 1;
+		while(runEnd < words.size() && words[runEnd] == words[i] && runEnd - i < std::numeric_limits<uint32_t>::max())
+			++runEnd;
+		if(runEnd - i < minRepeatedRun && i + 1 < words.size())
+		{
+			++i;
+			continue;
+		}
+		if(runEnd - i < minRepeatedRun)
+			//the last word is part of the literal run
+			i = runEnd;
+		if(i > literalStart)
+		{
+			appendWord(static_cast<uint64_t>(i - literalStart));
+			result.append(reinterpret_cast<const char*>(words.data() + literalStart), (i - literalStart) * sizeof(uint64_t));
+		}
+		if(i < words.size())
+		{
+			appendWord(static_cast<uint64_t>(runEnd - i) | (uint64_t{1} << 32));
+			appendWord(words[i]);
+			i = runEnd;
+		}
+		literalStart = i;
+	}
+	return result;
+}
+
+std::string vc4c::decompressProgram(const char* data, const std::size_t size, const std::size_t uncompressedSize)
+{
+	std::string result;
+	result.reserve(alignTo(uncompressedSize, 8));
+	std::size_t position = 0;
+	while(position + sizeof(uint64_t) <= size)
+	{
+		uint64_t header;
+		memcpy(&header, data + position, sizeof(header));
+		position += sizeof(header);
+		const std::size_t numWords = static_cast<uint32_t>(header);
+		const bool isRepeated = (header >> 32) != 0;
+		const std::size_t runSize = (isRepeated ? 1 : numWords) * sizeof(uint64_t);
+		if(position + runSize > size || result.size() + numWords * sizeof(uint64_t) > alignTo(uncompressedSize, 8))
+			throw CompilationError(CompilationStep::GENERAL, "Invalid compressed program in kernel bundle");
+		if(isRepeated)
+		{
+			for(std::size_t i = 0; i < numWords; ++i)
+				result.append(data + position, sizeof(uint64_t));
+		}
+		else
+			result.append(data + position, runSize);
+		position += runSize;
+	}
+	if(position != size || result.size() < uncompressedSize)
+		throw CompilationError(CompilationStep::GENERAL, "Invalid compressed program in kernel bundle");
+	result.resize(uncompressedSize);
+	return result;
+}
+
+std::size_t vc4c::writeKernelBundle(std::ostream& stream, const std::vector<BundledProgram>& programs, const bool compress)
+{
+	struct PendingEntry
+	{
+		const std::string* name;
+		uint64_t configurationHash;
+		std::size_t programIndex;
+	};
+	std::vector<PendingEntry> pendingEntries;
+	for(std::size_t i = 0; i < programs.size(); ++i)
+	{
+		for(const std::string& name : programs[i].kernelNames)
+			pendingEntries.push_back(PendingEntry{&name, programs[i].configurationHash, i});
+	}
+	//the entries are sorted, so the run-time can look them up via binary search
+	std::sort(pendingEntries.begin(), pendingEntries.end(), [](const PendingEntry& first, const PendingEntry& second) -> bool
+	{
+		const int comparison = first.name->compare(*second.name);
+		return comparison < 0 || (comparison == 0 && first.configurationHash < second.configurationHash);
+	});
+	for(std::size_t i = 1; i < pendingEntries.size(); ++i)
+	{
+		if(*pendingEntries[i].name == *pendingEntries[i - 1].name && pendingEntries[i].configurationHash == pendingEntries[i - 1].configurationHash)
+			throw CompilationError(CompilationStep::GENERAL, "Kernel is contained multiple times with the same configuration in the bundle", *pendingEntries[i].name);
+	}
+
+	std::vector<std::string> storedPrograms;
+	std::vector<uint32_t> flags;
+	for(const BundledProgram& program : programs)
+	{
+		std::string compressed = compress ? compressProgram(program.binary) : std::string{};
+		const bool isCompressed = compress && compressed.size() < program.binary.size();
+		storedPrograms.push_back(isCompressed ? std::move(compressed) : program.binary);
+		flags.push_back(isCompressed ? BUNDLE_FLAG_COMPRESSED : 0);
+	}
+
+	//header + entry table, followed by the kernel names and the programs
+	std::size_t offset = 16 + pendingEntries.size() * sizeof(BundleEntry);
+	std::vector<uint32_t> nameOffsets;
+	for(const PendingEntry& entry : pendingEntries)
+	{
+		nameOffsets.push_back(checkOffset(offset));
+		offset += entry.name->size() + 1;
+	}
+	std::vector<uint32_t> programOffsets;
+	for(const std::string& program : storedPrograms)
+	{
+		offset = alignTo(offset, BUNDLE_PAGE_SIZE);
+		programOffsets.push_back(checkOffset(offset));
+		offset += program.size();
+	}
+	checkOffset(offset);
+
+	writeWord(stream, QPUASM_MAGIC_NUMBER, BUNDLE_MAGIC_NUMBER);
+	writeWord(stream, BUNDLE_VERSION, checkOffset(pendingEntries.size()));
+	for(std::size_t i = 0; i < pendingEntries.size(); ++i)
+	{
+		const PendingEntry& entry = pendingEntries[i];
+		const BundleEntry written{entry.configurationHash, nameOffsets[i], static_cast<uint32_t>(entry.name->size()), programOffsets[entry.programIndex],
+			static_cast<uint32_t>(storedPrograms[entry.programIndex].size()), static_cast<uint32_t>(programs[entry.programIndex].binary.size()), flags[entry.programIndex]};
+		stream.write(reinterpret_cast<const char*>(&written), sizeof(written));
+	}
+	std::size_t position = 16 + pendingEntries.size() * sizeof(BundleEntry);
+	for(const PendingEntry& entry : pendingEntries)
+	{
+		stream.write(entry.name->data(), static_cast<std::streamsize>(entry.name->size() + 1));
+		position += entry.name->size() + 1;
+	}
+	static const char zeroes[64] = {0};
+	for(std::size_t i = 0; i < storedPrograms.size(); ++i)
+	{
+		while(position < programOffsets[i])
+		{
+			const std::size_t count = std::min(sizeof(zeroes), programOffsets[i] - position);
+			stream.write(zeroes, static_cast<std::streamsize>(count));
+			position += count;
+		}
+		stream.write(storedPrograms[i].data(), static_cast<std::streamsize>(storedPrograms[i].size()));
+		position += storedPrograms[i].size();
+	}
+	stream.flush();
+	return position;
+}
+
+KernelBundle::KernelBundle(const std::string& fileName) : file(fileName), entries(nullptr), numEntries(0)
+{
+	if(!file.isValid() || file.size() < 16)
+		throw CompilationError(CompilationStep::GENERAL, "Failed to read kernel bundle", fileName);
+	uint32_t header[4];
+	memcpy(header, file.data(), sizeof(header));
+	if(header[0] != QPUASM_MAGIC_NUMBER || header[1] != BUNDLE_MAGIC_NUMBER || header[2] != BUNDLE_VERSION)
+		throw CompilationError(CompilationStep::GENERAL, "Invalid or unsupported kernel bundle", fileName);
+	numEntries = header[3];
+	if(16 + static_cast<std::size_t>(numEntries) * sizeof(BundleEntry) > file.size())
+		throw CompilationError(CompilationStep::GENERAL, "Kernel bundle is truncated", fileName);
+	//the mapping is page-aligned, so the entries are properly aligned
+	entries = reinterpret_cast<const BundleEntry*>(file.data() + 16);
+	for(uint32_t i = 0; i < numEntries; ++i)
+	{
+		const BundleEntry& entry = entries[i];
+		if(static_cast<std::size_t>(entry.nameOffset) + entry.nameLength >= file.size() ||
+				static_cast<std::size_t>(entry.programOffset) + entry.programSize > file.size())
+			throw CompilationError(CompilationStep::GENERAL, "Kernel bundle is truncated", fileName);
+	}
+}
+
+const BundleEntry* KernelBundle::findEntry(const std::string& kernelName, const uint64_t configurationHash) const
+{
+	const BundleEntry* end = entries + numEntries;
+	const BundleEntry* it = std::lower_bound(entries, end, kernelName, [this, configurationHash](const BundleEntry& entry, const std::string& name) -> bool
+	{
+		const int comparison = getName(entry).compare(name);
+		return comparison < 0 || (comparison == 0 && entry.configurationHash < configurationHash);
+	});
+	if(it == end || it->configurationHash != configurationHash || getName(*it) != kernelName)
+		return nullptr;
+	return it;
+}
+
+const char* KernelBundle::getProgramData(const BundleEntry& entry) const
+{
+	return file.data() + entry.programOffset;
+}
+
+std::string KernelBundle::getName(const BundleEntry& entry) const
+{
+	return std::string(file.data() + entry.nameOffset, entry.nameLength);
+}
@@ -0,0 +1,121 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef KERNELBUNDLE_H
+#define KERNELBUNDLE_H
+
+#include "config.h"
+#include "helper.h"
+#include "MemoryStream.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vc4c
+{
+	/*
+	 * The kernel bundle contains the ahead-of-time compiled programs of an application (e.g. the variants specialized for several launch configurations),
+	 * so the run-time can load the code of known kernels without pre-compiling or compiling anything.
+	 *
+	 * The bundle starts with a header of two 64-bit words:
+	 * - the QPUASM_MAGIC_NUMBER followed by the BUNDLE_MAGIC_NUMBER
+	 * - the BUNDLE_VERSION followed by the number of entries
+	 * followed by the entry table with an entry of 32 Bytes for every kernel of every program (see BundleEntry), sorted by the kernel name and the configuration hash,
+	 * and the zero-terminated names of the kernels.
+	 * The programs (as written in the binary output mode, including the kernel-infos) are aligned to BUNDLE_PAGE_SIZE,
+	 * so uncompressed programs can be used directly from the memory-mapped bundle. All entries for the kernels of a program refer to the same program.
+	 */
+	constexpr uint32_t BUNDLE_MAGIC_NUMBER = 0xB0DE1E55;
+	constexpr uint32_t BUNDLE_VERSION = 1;
+	constexpr std::size_t BUNDLE_PAGE_SIZE = 4096;
+	//the program is compressed (see compressProgram)
+	constexpr uint32_t BUNDLE_FLAG_COMPRESSED = 1;
+
+	/*
+	 * An entry in the entry table is written as:
+	 * - the hash of the configuration the program was compiled with (64 bit, see getConfigurationHash)
+	 * - the offset of the kernel name from the begin of the bundle (32 bit) and the length of the name (32 bit)
+	 * - the offset of the program from the begin of the bundle (32 bit) and the size of the stored program (32 bit), both in Bytes
+	 * - the size of the uncompressed program in Bytes (32 bit) and the flags (32 bit)
+	 */
+	struct BundleEntry
+	{
+		uint64_t configurationHash;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint32_t programOffset;
+		uint32_t programSize;
+		uint32_t uncompressedSize;
+		uint32_t flags;
+	};
+
+	/*
+	 * A compiled program to be added to a kernel bundle
+	 */
+	struct BundledProgram
+	{
+		//the names of the kernels contained in the program
+		std::vector<std::string> kernelNames;
+		uint64_t configurationHash;
+		std::string binary;
+	};
+
+	/*
+	 * Calculates the hash of all parts of the configuration changing the generated code, the programs in a kernel bundle are looked up by
+	 */
+	uint64_t getConfigurationHash(const Configuration& config);
+
+	/*
+	 * Compresses the program with a run-length encoding of its 64-bit words, which removes the long runs of NOPs and padding without requiring any library.
+	 *
+	 * Every run starts with a 64-bit word containing the number of words (lower 32 bit) and whether a single word is repeated (upper 32 bit),
+	 * followed by the repeated word or the words of the run
+	 */
+	std::string compressProgram(const std::string& binary);
+	/*
+	 * Restores the program compressed by #compressProgram, throws a CompilationError if the data is invalid
+	 */
+	std::string decompressProgram(const char* data, std::size_t size, std::size_t uncompressedSize);
+
+	/*
+	 * Writes the kernel bundle containing the given programs. If enabled, the programs are compressed, if this reduces their size.
+	 *
+	 * Returns the number of Bytes written
+	 */
+	std::size_t writeKernelBundle(std::ostream& stream, const std::vector<BundledProgram>& programs, bool compress);
+
+	/*
+	 * Read-only access to a memory-mapped kernel bundle
+	 */
+	class KernelBundle : private NonCopyable
+	{
+	public:
+		/*
+		 * Maps the bundle into memory, throws a CompilationError if the file can't be read or is no valid kernel bundle
+		 */
+		explicit KernelBundle(const std::string& fileName);
+
+		/*
+		 * Returns the entry for the program containing the kernel compiled with the configuration of the given hash, nullptr if there is none
+		 */
+		const BundleEntry* findEntry(const std::string& kernelName, uint64_t configurationHash) const;
+		/*
+		 * Returns the stored (possibly compressed) program of the entry, which points directly into the mapped bundle
+		 */
+		const char* getProgramData(const BundleEntry& entry) const;
+
+	private:
+		MappedFile file;
+		const BundleEntry* entries;
+		uint32_t numEntries;
+
+		std::string getName(const BundleEntry& entry) const;
+	};
+
+} /* namespace vc4c */
+
+#endif /* KERNELBUNDLE_H */
@@ -6,8 +6,25 @@
 
 #include "Locals.h"
 
+#include <algorithm>
+#ifdef MULTI_THREADED
+#include <array>
+#endif
+
 using namespace vc4c;
 
+#ifdef MULTI_THREADED
+//all locals share a fixed number of locks (selected by their address) for their users, since a mutex per local would make them immovable
+static constexpr std::size_t NUM_USER_LOCKS = 64;
+static std::array<std::mutex, NUM_USER_LOCKS> userLocks;
+
+static std::mutex& getUserLock(const Local* local)
+{
+	//the lowest bits of the address are always the same due to the alignment
+	return userLocks[(reinterpret_cast<uintptr_t>(local) >> 4) % NUM_USER_LOCKS];
+}
+#endif
+
 LocalUser::~LocalUser()
 {
 
@@ -15,17 +32,15 @@ LocalUser::~LocalUser()
 
 bool LocalUser::readsLocal(const Local* local) const
 {
-	const auto allLocals = getUsedLocals();
-	return allLocals.find(local) != allLocals.end() && has_flag(allLocals.at(local), Type::READER);
+	return has_flag(getUsedLocals().at(local), Type::READER);
 }
 
 bool LocalUser::writesLocal(const Local* local) const
 {
-	const auto allLocals = getUsedLocals();
-	return allLocals.find(local) != allLocals.end() && has_flag(allLocals.at(local), Type::WRITER);
+	return has_flag(getUsedLocals().at(local), Type::WRITER);
 }
 
-Local::Local(const DataType& type, const std::string& name) : type(type), name(name), reference(nullptr, ANY_ELEMENT)
+Local::Local(const DataType& type, const std::string& name) : type(type), name(name), reference(nullptr, ANY_ELEMENT), identifier(std::hash<std::string>{}(name))
 {
 
 }
@@ -34,6 +49,11 @@ Local::~Local()
 {
 }
 
+size_t vc4c::hash<const Local*>::operator()(const Local* local) const noexcept
+{
+	return local == nullptr ? 0 : local->identifier;
+}
+
 bool Local::operator<(const Local& other)
 {
 	return name < other.name;
@@ -53,7 +73,46 @@ const Value Local::createReference(int index) const
     return Value(this, type);
 }
 
-const OrderedMap<const LocalUser*, LocalUse>& Local::getUsers() const
+UserList::const_iterator UserList::find(const LocalUser* user) const
+{
+	return std::find_if(users.begin(), users.end(), [user](const value_type& entry) -> bool { return entry.first == user;});
+}
+
+LocalUse UserList::at(const LocalUser* user) const
+{
+	auto it = find(user);
+	if(it == users.end())
+		return LocalUse();
+	return it->second;
+}
+
+std::size_t UserList::erase(const LocalUser* user)
+{
+	auto it = findEntry(user);
+	if(it == users.end())
+		return 0;
+	eraseEntry(it);
+	return 1;
+}
+
+std::vector<UserList::value_type>::iterator UserList::findEntry(const LocalUser* user)
+{
+	return std::find_if(users.begin(), users.end(), [user](const value_type& entry) -> bool { return entry.first == user;});
+}
+
+void UserList::eraseEntry(std::vector<value_type>::iterator it)
+{
+	if(it->second.readsLocal())
+		--numReaders;
+	if(it->second.writesLocal())
+		--numWriters;
+	//the order of the users is not guaranteed, so we can simply move the last entry into the gap
+	if(it != users.end() - 1)
+		*it = users.back();
+	users.pop_back();
+}
+
+const UserList& Local::getUsers() const
 {
 	return users;
 }
@@ -80,49 +139,79 @@ void Local::forUsers(const LocalUser::Type type, const std::function<void(const
 
 void Local::removeUser(const LocalUser& user, const LocalUser::Type type)
 {
+#ifdef MULTI_THREADED
+	std::lock_guard<std::mutex> guard(getUserLock(this));
+#endif
 	if(type == LocalUser::Type::BOTH)
 	{
 		//if we remove the user completely, ignore if it was a user
 		users.erase(&user);
 		return;
 	}
-	if(users.find(&user) == users.end())
+	auto it = users.findEntry(&user);
+	if(it == users.users.end())
 		throw CompilationError(CompilationStep::GENERAL, "Trying to remove a not registered user for a local", user.to_string());
-	LocalUse& use = users.at(&user);
+	LocalUse use = it->second;
 	if(type == LocalUser::Type::READER)
 		--use.numReads;
 	else if(type == LocalUser::Type::WRITER)
 		--use.numWrites;
 	if(!use.readsLocal() && !use.writesLocal())
-		users.erase(&user);
+	{
+		users.eraseEntry(it);
+		return;
+	}
+	if(it->second.readsLocal() && !use.readsLocal())
+		--users.numReaders;
+	if(it->second.writesLocal() && !use.writesLocal())
+		--users.numWriters;
+	it->second = use;
 }
 
 void Local::addUser(const LocalUser& user, const LocalUser::Type type)
 {
-	if(users.find(&user) == users.end())
-		users.emplace(&user, LocalUse());
-	LocalUse& use = users.at(&user);
+#ifdef MULTI_THREADED
+	std::lock_guard<std::mutex> guard(getUserLock(this));
+#endif
+	auto it = users.findEntry(&user);
+	if(it == users.users.end())
+	{
+		users.users.emplace_back(&user, LocalUse());
+		it = users.users.end() - 1;
+	}
+	LocalUse& use = it->second;
 	if(has_flag(type, LocalUser::Type::READER))
+	{
+		if(!use.readsLocal())
+			++users.numReaders;
 		++use.numReads;
+	}
 	if(has_flag(type, LocalUser::Type::WRITER))
+	{
+		if(!use.writesLocal())
+			++users.numWriters;
 		++use.numWrites;
+	}
 }
 
 const LocalUser* Local::getSingleWriter() const
 {
-	const LocalUser* writer = nullptr;
+	if(users.getNumWriters() != 1)
+		return nullptr;
 	for(const auto& pair : this->users)
 	{
 		if(pair.second.writesLocal())
-		{
-			if(writer != nullptr)
-				//multiple writers
-				return nullptr;
-			writer = pair.first;
-		}
+			return pair.first;
 	}
-	return writer;
+	return nullptr;
+}
+
+#ifdef MULTI_THREADED
+std::unique_lock<std::mutex> Local::lockUsers() const
+{
+	return std::unique_lock<std::mutex>(getUserLock(this));
 }
+#endif
 
 std::string Local::to_string(bool withContent) const
 {
@@ -7,12 +7,19 @@
 #ifndef LOCALS_H
 #define LOCALS_H
 
+#include <array>
 #include <utility>
+#include <vector>
+#ifdef MULTI_THREADED
+#include <mutex>
+#endif
 
 #include "Values.h"
 
 namespace vc4c
 {
+	class LocalUses;
+
 	struct LocalUser
 	{
 		enum class Type
@@ -23,8 +30,16 @@ namespace vc4c
 		LocalUser() = default;
 		virtual ~LocalUser();
 
-		virtual FastMap<const Local*, Type> getUsedLocals() const = 0;
-		virtual void forUsedLocals(const std::function<void(const Local*, LocalUser::Type)>& consumer) const = 0;
+		/*
+		 * Returns the locals used by this user, each local is listed once with all types of its use combined
+		 */
+		virtual LocalUses getUsedLocals() const = 0;
+		/*
+		 * Calls the consumer with every local used (see #getUsedLocals()) and the type of its use.
+		 * The consumer is not type-erased, so this can be called for every instruction without any overhead
+		 */
+		template<typename Consumer>
+		void forUsedLocals(Consumer&& consumer) const;
 		virtual bool readsLocal(const Local* local) const;
 		virtual bool writesLocal(const Local* local) const;
 		virtual void replaceLocal(const Local* oldLocal, const Local* newLocal, const Type type = add_flag(Type::READER, Type::WRITER)) = 0;
@@ -32,6 +47,116 @@ namespace vc4c
 		virtual std::string to_string() const = 0;
 	};
 
+	/*
+	 * The locals used by a single instruction, together with the type of their use.
+	 *
+	 * Instructions use only a few locals, so they are stored inline (without any heap allocation) and looked up linearly.
+	 * Only users with more locals than fit inline (e.g. calls with many parameters) store them in a heap-allocated list.
+	 */
+	class LocalUses
+	{
+	public:
+		using value_type = std::pair<const Local*, LocalUser::Type>;
+		using const_iterator = const value_type*;
+
+		LocalUses() : numInlineEntries(0)
+		{
+		}
+
+		/*
+		 * Adds the use of the local, combining it with a previous use of the same local
+		 */
+		void add(const Local* local, const LocalUser::Type type)
+		{
+			for(value_type* entry = getEntries(); entry != getEntries() + size(); ++entry)
+			{
+				if(entry->first == local)
+				{
+					entry->second = add_flag(entry->second, type);
+					return;
+				}
+			}
+			if(!overflowEntries.empty())
+				overflowEntries.emplace_back(local, type);
+			else if(numInlineEntries < INLINE_CAPACITY)
+				inlineEntries[numInlineEntries++] = std::make_pair(local, type);
+			else
+			{
+				overflowEntries.reserve(2 * INLINE_CAPACITY);
+				overflowEntries.assign(inlineEntries.begin(), inlineEntries.end());
+				overflowEntries.emplace_back(local, type);
+			}
+		}
+
+		/*
+		 * Adds all uses of the other list
+		 */
+		void addAll(const LocalUses& other)
+		{
+			for(const value_type& entry : other)
+				add(entry.first, entry.second);
+		}
+
+		const_iterator begin() const
+		{
+			return overflowEntries.empty() ? inlineEntries.data() : overflowEntries.data();
+		}
+
+		const_iterator end() const
+		{
+			return begin() + size();
+		}
+
+		std::size_t size() const
+		{
+			return overflowEntries.empty() ? numInlineEntries : overflowEntries.size();
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		const_iterator find(const Local* local) const
+		{
+			for(const_iterator it = begin(); it != end(); ++it)
+			{
+				if(it->first == local)
+					return it;
+			}
+			return end();
+		}
+
+		/*
+		 * Returns the type of use of the given local, NONE if it is not used
+		 */
+		LocalUser::Type at(const Local* local) const
+		{
+			const_iterator it = find(local);
+			return it == end() ? LocalUser::Type::NONE : it->second;
+		}
+
+	private:
+		//an operation uses at most three locals, a combined operation up to six
+		static constexpr std::size_t INLINE_CAPACITY = 6;
+
+		std::array<value_type, INLINE_CAPACITY> inlineEntries;
+		uint8_t numInlineEntries;
+		std::vector<value_type> overflowEntries;
+
+		value_type* getEntries()
+		{
+			return overflowEntries.empty() ? inlineEntries.data() : overflowEntries.data();
+		}
+	};
+
+	template<typename Consumer>
+	void LocalUser::forUsedLocals(Consumer&& consumer) const
+	{
+		for(const LocalUses::value_type& use : getUsedLocals())
+			consumer(use.first, use.second);
+	}
+
 	class Method;
 
 	struct LocalUse
@@ -50,6 +175,69 @@ namespace vc4c
 		}
 	};
 
+	/*
+	 * The list of instructions using a local.
+	 *
+	 * Locals usually only have a few users, so a plain list is more cache-friendly than a map.
+	 * The number of reading and writing users are tracked, so they can be queried without iterating the list.
+	 */
+	class UserList
+	{
+	public:
+		using value_type = std::pair<const LocalUser*, LocalUse>;
+		using const_iterator = std::vector<value_type>::const_iterator;
+
+		const_iterator begin() const
+		{
+			return users.begin();
+		}
+
+		const_iterator end() const
+		{
+			return users.end();
+		}
+
+		std::size_t size() const
+		{
+			return users.size();
+		}
+
+		bool empty() const
+		{
+			return users.empty();
+		}
+
+		std::size_t getNumReaders() const
+		{
+			return numReaders;
+		}
+
+		std::size_t getNumWriters() const
+		{
+			return numWriters;
+		}
+
+		const_iterator find(const LocalUser* user) const;
+		/*
+		 * Returns the use of the given user, or an empty use, if it does not use the local
+		 */
+		LocalUse at(const LocalUser* user) const;
+		/*
+		 * Removes the user completely, returns the number of removed entries (0 or 1)
+		 */
+		std::size_t erase(const LocalUser* user);
+
+	private:
+		std::vector<value_type> users;
+		std::size_t numReaders = 0;
+		std::size_t numWriters = 0;
+
+		std::vector<value_type>::iterator findEntry(const LocalUser* user);
+		void eraseEntry(std::vector<value_type>::iterator it);
+
+		friend class Local;
+	};
+
 	class Local : private NonCopyable
 	{
 	public:
@@ -62,7 +250,16 @@ namespace vc4c
 
 		const Value createReference(int index = WHOLE_OBJECT) const;
 
-		const OrderedMap<const LocalUser*, LocalUse>& getUsers() const;
+		/*
+		 * Thread-safety of the users:
+		 * - adding and removing users is always synchronized, so instructions using the same local can be created, modified and destroyed in parallel,
+		 *   e.g. when different basic blocks are optimized in parallel
+		 * - reading the users is not synchronized. If other threads may add or remove users of this local at the same time, the users may only be read
+		 *   while holding the lock returned by #lockUsers()
+		 * - the users of a local only used within the basic block(s) processed by the current thread can be read without locking,
+		 *   since no other thread can then add or remove any of its users
+		 */
+		const UserList& getUsers() const;
 		FastSet<const LocalUser*> getUsers(const LocalUser::Type type) const;
 		void forUsers(const LocalUser::Type type, const std::function<void(const LocalUser*)>& consumer) const;
 		void removeUser(const LocalUser& user, const LocalUser::Type type);
@@ -71,6 +268,13 @@ namespace vc4c
 		 * Returns the only instruction writing to this local, if there is exactly one
 		 */
 		const LocalUser* getSingleWriter() const;
+#ifdef MULTI_THREADED
+		/*
+		 * Prevents other threads from adding or removing users of this local, while the returned lock is held.
+		 * NOTE: The same thread must not add or remove users of any local while holding the lock, since the locks are shared between locals
+		 */
+		std::unique_lock<std::mutex> lockUsers() const;
+#endif
 
 		template<typename T>
 		bool is() const
@@ -99,10 +303,12 @@ namespace vc4c
 	protected:
 		Local(const DataType& type, const std::string& name);
 	private:
-		//FIXME unordered_map randomly throws SEGFAULT somewhere in stdlib in #removeUser called by IntermediateInstruction#erase
-		OrderedMap<const LocalUser*, LocalUse> users;
+		UserList users;
+		//the stable value the local is hashed by (see hash<const Local*>)
+		std::size_t identifier;
 
 		friend class Method;
+		friend struct hash<const Local*>;
 	};
 
 	enum class ParameterDecorations
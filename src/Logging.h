@@ -0,0 +1,109 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_LOGGING_H
+#define VC4C_LOGGING_H
+
+#include <atomic>
+
+#include "log.h"
+#include "Compiler.h"
+
+/*
+ * Messages below this level are removed at compile-time:
+ * 0 keeps all messages, 1 removes the debug messages and 2 additionally removes the info messages
+ */
+#ifndef VC4C_LOG_STRIP_LEVEL
+#define VC4C_LOG_STRIP_LEVEL 0
+#endif
+
+namespace vc4c
+{
+	/*
+	 * The severity of the log-levels, the values of LogLevel are the characters used by cpplog and not ordered
+	 */
+	constexpr unsigned getLogSeverity(const LogLevel level)
+	{
+		return level == LogLevel::DEBUG ? 0 : level == LogLevel::INFO ? 1 : level == LogLevel::WARNING ? 2 : level == LogLevel::ERROR ? 3 : 4;
+	}
+
+	/*
+	 * The severity of the minimum level written by the logger, this needs to be updated when the logger is replaced (see setLogger)
+	 */
+	extern std::atomic<unsigned> minimumLogSeverity;
+
+	/*
+	 * Sets the minimum level of messages to be written
+	 */
+	void setMinimumLogLevel(LogLevel level);
+
+	/*
+	 * Marks no minimum severity being set for the compilation run by the current thread
+	 */
+	constexpr unsigned NO_LOG_SEVERITY = ~0u;
+
+	/*
+	 * The severity of the minimum level written for the compilation run by the current thread (see LogLevelScope),
+	 * overrides the minimumLogSeverity if set
+	 */
+	extern thread_local unsigned compilationLogSeverity;
+
+	/*
+	 * Sets the severity of the compilation run by the current thread, e.g. to the severity captured when scheduling a task, until the scope is left
+	 */
+	struct LogSeverityScope
+	{
+		explicit LogSeverityScope(const unsigned severity) : previousSeverity(compilationLogSeverity)
+		{
+			compilationLogSeverity = severity;
+		}
+		LogSeverityScope(const LogSeverityScope&) = delete;
+		~LogSeverityScope()
+		{
+			compilationLogSeverity = previousSeverity;
+		}
+
+		LogSeverityScope& operator=(const LogSeverityScope&) = delete;
+
+		const unsigned previousSeverity;
+	};
+
+	/*
+	 * Whether messages of the given level are written by the logger
+	 */
+	inline bool isLogged(const LogLevel level)
+	{
+		const unsigned severity = compilationLogSeverity;
+		return getLogSeverity(level) >= (severity != NO_LOG_SEVERITY ? severity : minimumLogSeverity.load(std::memory_order_relaxed));
+	}
+} /* namespace vc4c */
+
+/*
+ * Writes the given stream operands to the stream only if the level is logged.
+ * Thus, the operands (e.g. the to_string() of instructions) are not evaluated for discarded messages.
+ *
+ * Use as: LOG_LAZY(LogLevel::DEBUG, logging::debug(), "Value: " << value.to_string() << logging::endl);
+ */
+#define LOG_LAZY(level, stream, ...) do { if(vc4c::isLogged(level)) { stream << __VA_ARGS__; } } while(false)
+
+/*
+ * The removed messages are still type-checked (and mark the variables used only for logging as used), but never executed and thus eliminated by the compiler
+ */
+#define LOG_STRIPPED(stream, ...) do { if(false) { stream << __VA_ARGS__; } } while(false)
+
+#if VC4C_LOG_STRIP_LEVEL >= 1
+#define DEBUG_LOG(...) LOG_STRIPPED(logging::debug(), __VA_ARGS__)
+#else
+#define DEBUG_LOG(...) LOG_LAZY(vc4c::LogLevel::DEBUG, logging::debug(), __VA_ARGS__)
+#endif
+
+#if VC4C_LOG_STRIP_LEVEL >= 2
+#define INFO_LOG(...) LOG_STRIPPED(logging::info(), __VA_ARGS__)
+#else
+#define INFO_LOG(...) LOG_LAZY(vc4c::LogLevel::INFO, logging::info(), __VA_ARGS__)
+#endif
+
+#endif /* VC4C_LOGGING_H */
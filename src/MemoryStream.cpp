@@ -0,0 +1,149 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "MemoryStream.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace vc4c;
+
+MemoryStreamBuffer::MemoryStreamBuffer(const char* data, std::size_t size) : begin(data), end(data + size)
+{
+	//the buffer is never written to, so the const_cast is safe
+	char* start = const_cast<char*>(begin);
+	setg(start, start, start + size);
+}
+
+const char* MemoryStreamBuffer::data() const
+{
+	return begin;
+}
+
+std::size_t MemoryStreamBuffer::size() const
+{
+	return static_cast<std::size_t>(end - begin);
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	if(dir == std::ios_base::cur)
+		return seekpos(static_cast<off_type>(gptr() - eback()) + off, which);
+	if(dir == std::ios_base::end)
+		return seekpos(static_cast<off_type>(size()) + off, which);
+	return seekpos(off, which);
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	const off_type offset = pos;
+	if((which & std::ios_base::out) || offset < 0 || offset > static_cast<off_type>(size()))
+		return pos_type(off_type(-1));
+	setg(eback(), eback() + offset, egptr());
+	return pos;
+}
+
+OutputMemoryStreamBuffer::OutputMemoryStreamBuffer(char*& data, unsigned long& capacity) : data(data), capacity(capacity)
+{
+	if(data == nullptr)
+		capacity = 0;
+	setp(data, data + capacity);
+}
+
+std::size_t OutputMemoryStreamBuffer::size() const
+{
+	return static_cast<std::size_t>(pptr() - pbase());
+}
+
+void OutputMemoryStreamBuffer::reserve(std::size_t minCapacity)
+{
+	if(minCapacity <= capacity)
+		return;
+	const std::size_t written = size();
+	//grow exponentially to not re-allocate for every write
+	const std::size_t newCapacity = std::max(minCapacity, std::max(static_cast<std::size_t>(capacity) * 2, static_cast<std::size_t>(4096)));
+	char* newData = static_cast<char*>(realloc(data, newCapacity));
+	if(newData == nullptr)
+		throw std::bad_alloc();
+	data = newData;
+	capacity = newCapacity;
+	setp(data, data + capacity);
+	//pbump only takes an int
+	for(std::size_t remaining = written; remaining > 0;)
+	{
+		const int step = static_cast<int>(std::min(remaining, static_cast<std::size_t>(INT_MAX)));
+		pbump(step);
+		remaining -= static_cast<std::size_t>(step);
+	}
+}
+
+OutputMemoryStreamBuffer::int_type OutputMemoryStreamBuffer::overflow(int_type c)
+{
+	if(traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+	reserve(size() + 1);
+	*pptr() = traits_type::to_char_type(c);
+	pbump(1);
+	return c;
+}
+
+std::streamsize OutputMemoryStreamBuffer::xsputn(const char* s, std::streamsize count)
+{
+	if(count <= 0)
+		return 0;
+	reserve(size() + static_cast<std::size_t>(count));
+	memcpy(pptr(), s, static_cast<std::size_t>(count));
+	pbump(static_cast<int>(count));
+	return count;
+}
+
+MappedFile::MappedFile(const std::string& fileName) : mapping(nullptr), length(0)
+{
+	const int fd = open(fileName.data(), O_RDONLY);
+	if(fd < 0)
+		return;
+	struct stat fileStat;
+	//empty files can't be mapped
+	if(fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode) && fileStat.st_size > 0)
+	{
+		void* ptr = mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if(ptr != MAP_FAILED)
+		{
+			mapping = ptr;
+			length = static_cast<std::size_t>(fileStat.st_size);
+		}
+	}
+	//the mapping stays valid after closing the file
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if(mapping != nullptr)
+		munmap(mapping, length);
+}
+
+bool MappedFile::isValid() const
+{
+	return mapping != nullptr;
+}
+
+const char* MappedFile::data() const
+{
+	return static_cast<const char*>(mapping);
+}
+
+std::size_t MappedFile::size() const
+{
+	return length;
+}
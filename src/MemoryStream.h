@@ -0,0 +1,91 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef MEMORYSTREAM_H
+#define MEMORYSTREAM_H
+
+#include "helper.h"
+
+#include <streambuf>
+#include <string>
+
+namespace vc4c
+{
+	/*
+	 * Read-only stream-buffer accessing a memory region directly without copying it.
+	 *
+	 * The memory needs to stay valid for the lifetime of the buffer
+	 */
+	class MemoryStreamBuffer : public std::streambuf
+	{
+	public:
+		MemoryStreamBuffer(const char* data, std::size_t size);
+
+		const char* data() const;
+		std::size_t size() const;
+
+	protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+
+	private:
+		const char* begin;
+		const char* end;
+	};
+
+	/*
+	 * Write-only stream-buffer writing directly into a memory region allocated with malloc().
+	 *
+	 * If the data written does not fit, the memory is enlarged with realloc(). The pointer to and the size of the memory are updated in place,
+	 * so the memory can be handed to the caller (e.g. of the C interface) without copying the written data
+	 */
+	class OutputMemoryStreamBuffer : public std::streambuf
+	{
+	public:
+		OutputMemoryStreamBuffer(char*& data, unsigned long& capacity);
+
+		/*
+		 * Returns the number of bytes written
+		 */
+		std::size_t size() const;
+		/*
+		 * Makes sure, the memory can hold at least the given number of bytes
+		 */
+		void reserve(std::size_t minCapacity);
+
+	protected:
+		int_type overflow(int_type c) override;
+		std::streamsize xsputn(const char* s, std::streamsize count) override;
+
+	private:
+		char*& data;
+		unsigned long& capacity;
+	};
+
+	/*
+	 * Read-only memory-mapping of a whole file
+	 */
+	class MappedFile : private NonCopyable
+	{
+	public:
+		/*
+		 * Maps the file into memory, if the file can't be mapped, the mapping is invalid
+		 */
+		explicit MappedFile(const std::string& fileName);
+		~MappedFile();
+
+		bool isValid() const;
+		const char* data() const;
+		std::size_t size() const;
+
+	private:
+		void* mapping;
+		std::size_t length;
+	};
+
+} /* namespace vc4c */
+
+#endif /* MEMORYSTREAM_H */
@@ -5,11 +5,17 @@
  */
 
 #include "periphery/VPM.h"
-#include "log.h"
+#include "Logging.h"
 #include "Module.h"
 #include "InstructionWalker.h"
 #include "intermediate/IntermediateInstruction.h"
 #include "Profiler.h"
+#include "analysis/AnalysisManager.h"
+#include "intermediate/InstructionArena.h"
+#include "BackgroundWorker.h"
+
+#include <algorithm>
+#include <atomic>
 
 using namespace vc4c;
 
@@ -30,6 +36,9 @@ const std::string Method::GLOBAL_OFFSET_Y("%global_offset_y");
 const std::string Method::GLOBAL_OFFSET_Z("%global_offset_z");
 const std::string Method::GLOBAL_DATA_ADDRESS("%global_data_address");
 const std::string Method::GROUP_LOOP_SIZE("%group_loop_size");
+const std::string Method::BLOCK_PROFILE_BUFFER("%block_profile_buffer");
+const std::string Method::PARAMETER_BUFFER("%parameter_buffer");
+const std::string Method::PRINTF_BUFFER("%printf_buffer");
 
 std::size_t vc4c::hash<vc4c::MetaDataType>::operator()(vc4c::MetaDataType const& val) const noexcept
 {
@@ -43,7 +52,7 @@ BasicBlock::BasicBlock(Method& method, intermediate::BranchLabel* label) : metho
 
 bool BasicBlock::empty() const
 {
-	return instructions.size() == 0 || (instructions.size() == 1 && dynamic_cast<intermediate::BranchLabel*>(instructions.front().get()) != nullptr);
+	return instructions.size() == 0 || (instructions.size() == 1 && instructions.front()->is<intermediate::BranchLabel>());
 }
 
 InstructionWalker BasicBlock::begin()
@@ -58,76 +67,57 @@ InstructionWalker BasicBlock::end()
 
 bool BasicBlock::isLocallyLimited(InstructionWalker curIt, const Local* locale, const std::size_t threshold) const
 {
-	auto remainingUsers = locale->getUsers();
+#ifdef MULTI_THREADED
+	//the local might be used in basic blocks processed in parallel
+	auto usersLock = locale->lockUsers();
+#endif
+	const UserList& users = locale->getUsers();
+	//the range covers the previous instruction, the current one and the threshold instructions following it
+	if(users.size() > threshold + 2)
+		return false;
+	//a local passed between blocks (or around a loop) has users outside of this block.
+	//An outdated liveness analysis can only reject too many locals here, all others are checked exactly below
+	if(method.getAnalyses().getLiveness().isLiveAcrossBlocks(locale))
+		return false;
 
+	std::size_t numUsersFound = 0;
 	int usageRangeLeft = threshold;
 	//check whether the local is written in the instruction before (and this)
 	//this happens e.g. for comparisons
-	if(!curIt.isStartOfBlock())
-	{
-		remainingUsers.erase(curIt.copy().previousInBlock().get());
-	}
+	if(!curIt.isStartOfBlock() && users.find(curIt.copy().previousInBlock().get()) != users.end())
+		++numUsersFound;
 	while(usageRangeLeft >= 0 && !curIt.isEndOfBlock())
 	{
-		remainingUsers.erase(curIt.get());
+		if(users.find(curIt.get()) != users.end())
+			++numUsersFound;
 		--usageRangeLeft;
 		curIt.nextInBlock();
 	}
 
-	return remainingUsers.empty();
+	return numUsersFound == users.size();
 }
 
 const intermediate::BranchLabel* BasicBlock::getLabel() const
 {
-	if(dynamic_cast<intermediate::BranchLabel*>(instructions.front().get()) == nullptr)
-		throw CompilationError(CompilationStep::GENERAL, "Basic block does not start with a label", instructions.front()->to_string());
-	return dynamic_cast<intermediate::BranchLabel*>(instructions.front().get());
+	const intermediate::BranchLabel* label = instructions.front()->as<intermediate::BranchLabel>();
+	if(label == nullptr)
+		throw CompilationError(CompilationStep::GENERAL, "Basic block does not start with a label", instructions.front() == nullptr ? "(released)" : instructions.front()->to_string());
+	return label;
 }
 
 void BasicBlock::forSuccessiveBlocks(const std::function<void(BasicBlock&)>& consumer) const
 {
-	InstructionWalker it = const_cast<BasicBlock*>(this)->begin();
-	while(!it.isEndOfBlock())
-	{
-		if(it.has<intermediate::Branch>())
-		{
-			BasicBlock* next = method.findBasicBlock(it.get<intermediate::Branch>()->getTarget());
-			if(next != nullptr)
-				consumer(*next);
-		}
-		it.nextInBlock();
-		if(fallsThroughToNextBlock())
-		{
-			BasicBlock* next = method.getNextBlockAfter(this);
-			if(next != nullptr)
-				consumer(*next);
-		}
-	}
+	//copy the successors, since the consumer might modify the control-flow
+	const std::vector<BasicBlock*> successors = method.getAnalyses().getControlFlowGraph().getSuccessors(*this);
+	for(BasicBlock* next : successors)
+		consumer(*next);
 }
 
 void BasicBlock::forPredecessors(const std::function<void(InstructionWalker)>& consumer) const
 {
-	//TODO some more efficient way of doing this??!
-	const Local* label = getLabel()->getLabel();
-	BasicBlock* prevBlock = nullptr;
-	bool prevBlockFound = false;
-	for(BasicBlock& bb : method.getBasicBlocks())
-	{
-		for(auto it = bb.begin(); !it.isEndOfBlock(); it.nextInBlock())
-		{
-			intermediate::Branch* br = it.get<intermediate::Branch>();
-			if(br != nullptr && br->getTarget() == label)
-				consumer(it);
-		}
-		if(&bb == this)
-			prevBlockFound = true;
-		if(!prevBlockFound)
-			prevBlock = &bb;
-	}
-	if(prevBlockFound && prevBlock != nullptr && prevBlock->fallsThroughToNextBlock())
-	{
-		consumer(prevBlock->end().previousInBlock());
-	}
+	const std::vector<analysis::CFGPredecessor> predecessors = method.getAnalyses().getControlFlowGraph().getPredecessors(*this);
+	for(const analysis::CFGPredecessor& pred : predecessors)
+		consumer(pred.isFallThrough ? pred.getLastInstruction() : pred.branch);
 }
 
 bool BasicBlock::fallsThroughToNextBlock() const
@@ -139,7 +129,7 @@ bool BasicBlock::fallsThroughToNextBlock() const
 		it.previousInBlock();
 	}
 	while(it.has<intermediate::Nop>());
-	const intermediate::Branch* lastBranch = dynamic_cast<const intermediate::Branch*>(it.get());
+	const intermediate::Branch* lastBranch = it.get<const intermediate::Branch>();
 	const intermediate::Branch* secondLastBranch = nullptr;
 	if(!it.isStartOfBlock())
 	{
@@ -151,7 +141,7 @@ bool BasicBlock::fallsThroughToNextBlock() const
 			it.previousInBlock();
 		}
 		while(it.has<intermediate::Nop>());
-		secondLastBranch = dynamic_cast<const intermediate::Branch*>(it.get());
+		secondLastBranch = it.get<const intermediate::Branch>();
 	}
 	if(lastBranch != nullptr && lastBranch->isUnconditional())
 	{
@@ -178,21 +168,27 @@ Optional<InstructionWalker> BasicBlock::findWalkerForInstruction(const intermedi
 	return {};
 }
 
-Method::Method(const Module& module) : isKernel(false), name(), returnType(TYPE_UNKNOWN), vpm(new periphery::VPM(module.compilationConfig.availableVPMSize)), module(module)
+Method::Method(const Module& module) : isKernel(false), name(), returnType(TYPE_UNKNOWN), vpm(new periphery::VPM(module.compilationConfig.availableVPMSize)), workItemsPerQPU(1), isFastPath(false), module(module),
+		instructionArena(intermediate::InstructionArena::create()), analyses(new analysis::AnalysisManager(*this))
 {
 
 }
 
 Method::~Method()
 {
+	//the analyses refer to the basic blocks and instructions
+	analyses.reset();
 	//makes sure, instructions are removed before locals (so usages are all zero)
 	basicBlocks.clear();
+	//the arena is freed, as soon as all instructions allocated from it are freed
+	instructionArena->release();
 }
 
 const Local* Method::findLocal(const std::string& name) const
 {
-	if(locals.find(name) != locals.end())
-		return &locals.at(name);
+	auto it = localsByName.find(name);
+	if(it != localsByName.end())
+		return it->second;
 	return nullptr;
 }
 
@@ -225,11 +221,10 @@ const Local* Method::findOrCreateLocal(const DataType& type, const std::string&
 		loc = findGlobal(name);
 	if(loc != nullptr)
 		return loc;
-	auto it = locals.emplace(name, Local(type, name));
-	return &(it.first->second);
+	return createLocal(type, name);
 }
 
-static bool removeUsagesInBasicBlock(Method& method, BasicBlock& bb, const Local* locale, OrderedMap<const LocalUser*, LocalUse>& remainingUsers, int& usageRangeLeft)
+static bool removeUsagesInBasicBlock(Method& method, BasicBlock& bb, const Local* locale, UserList& remainingUsers, int& usageRangeLeft)
 {
 	InstructionWalker it = bb.begin();
 	while(usageRangeLeft >= 0 && !it.isEndOfMethod())
@@ -249,6 +244,9 @@ static bool removeUsagesInBasicBlock(Method& method, BasicBlock& bb, const Local
 
 bool Method::isLocallyLimited(InstructionWalker curIt, const Local* locale, const std::size_t threshold) const
 {
+	//the range covers at most the previous instruction, the current one and the threshold instructions following it
+	if(locale->getUsers().size() > threshold + 2)
+		return false;
 	auto remainingUsers = locale->getUsers();
 
 	int usageRangeLeft = threshold;
@@ -278,15 +276,39 @@ bool Method::isLocallyLimited(InstructionWalker curIt, const Local* locale, cons
 	return remainingUsers.empty();
 }
 
-static std::size_t tmpIndex = 0;
+//shared by all methods (which may be processed in parallel), so the generated names stay unique
+static std::atomic<std::size_t> tmpIndex(0);
+
+std::size_t Method::getTemporaryNameCounter()
+{
+	return tmpIndex;
+}
+
+void Method::advanceTemporaryNameCounter(std::size_t minimumValue)
+{
+	std::size_t current = tmpIndex;
+	while(current < minimumValue && !tmpIndex.compare_exchange_weak(current, minimumValue))
+	{
+		//retry with the value written by another thread
+	}
+}
 
 const Value Method::addNewLocal(const DataType& type, const std::string& prefix, const std::string& postfix)
 {
 	const std::string name = createLocalName(prefix, postfix);
 	if(findLocal(name) != nullptr)
 		throw CompilationError(CompilationStep::GENERAL, "Local with this name already exists", findLocal(name)->to_string());
-	auto it = locals.emplace(name, Local(type, name));
-    return it.first->second.createReference();
+	return createLocal(type, name)->createReference();
+}
+
+const Local* Method::createLocal(const DataType& type, const std::string& name)
+{
+	locals.emplace_back(new Local(type, name));
+	//the locals are hashed by their creation order, which does not depend on the (shared) counter for the names of temporary locals
+	locals.back()->identifier = locals.size();
+	const Local* loc = locals.back().get();
+	localsByName.emplace(name, loc);
+	return loc;
 }
 
 std::string Method::createLocalName(const std::string& prefix, const std::string& postfix)
@@ -319,20 +341,66 @@ std::string Method::createLocalName(const std::string& prefix, const std::string
 	return localName;
 }
 
-InstructionWalker Method::walkAllInstructions()
+intermediate::InstructionArena* Method::getInstructionArena()
 {
-	return basicBlocks.front().begin();
+	return instructionArena;
 }
 
-void Method::forAllInstructions(const std::function<void(const intermediate::IntermediateInstruction*)>& consumer) const
+analysis::AnalysisManager& Method::getAnalyses()
 {
-	for(const BasicBlock& bb : basicBlocks)
+	return *analyses;
+}
+
+const Module& Method::getModule() const
+{
+	return module;
+}
+
+//the minimum number of instructions processed by a single task, smaller blocks are processed together
+static constexpr std::size_t MIN_INSTRUCTIONS_PER_TASK = 256;
+
+void Method::forAllBasicBlocksInParallel(const std::function<void(BasicBlock&)>& consumer)
+{
+	//the analyses are calculated lazily, which would not be thread-safe
+	analyses->getLiveness();
+#ifdef MULTI_THREADED
+	std::vector<std::vector<BasicBlock*>> chunks(1);
+	std::size_t chunkInstructions = 0;
+	for(BasicBlock& bb : basicBlocks)
+	{
+		if(chunkInstructions >= MIN_INSTRUCTIONS_PER_TASK)
+		{
+			chunks.emplace_back();
+			chunkInstructions = 0;
+		}
+		chunks.back().push_back(&bb);
+		chunkInstructions += bb.instructions.size();
+	}
+	if(chunks.size() > 1)
 	{
-		for(const auto& instr : bb.instructions)
+		std::vector<threading::BackgroundWorker> workers;
+		workers.reserve(chunks.size());
+		for(const std::vector<BasicBlock*>& chunk : chunks)
 		{
-			consumer(instr.get());
+			auto f = [this, &chunk, &consumer]() -> void
+			{
+				intermediate::InstructionArena::Scope arenaScope(instructionArena);
+				for(BasicBlock* block : chunk)
+					consumer(*block);
+			};
+			workers.emplace(workers.end(), f, "BlockOptimizer")->operator ()();
 		}
+		threading::BackgroundWorker::waitForAll(workers);
+		return;
 	}
+#endif
+	for(BasicBlock& bb : basicBlocks)
+		consumer(bb);
+}
+
+InstructionWalker Method::walkAllInstructions()
+{
+	return basicBlocks.front().begin();
 }
 
 std::size_t Method::countInstructions() const
@@ -345,6 +413,16 @@ std::size_t Method::countInstructions() const
 	return count;
 }
 
+std::size_t Method::getModificationCount() const
+{
+	std::size_t count = 0;
+	for(const BasicBlock& bb : basicBlocks)
+	{
+		count += bb.instructions.getModificationCount();
+	}
+	return count;
+}
+
 std::size_t Method::cleanEmptyInstructions()
 {
 	//TODO required??
@@ -365,16 +443,25 @@ std::size_t Method::cleanEmptyInstructions()
 
 void Method::appendToEnd(intermediate::IntermediateInstruction* instr)
 {
-	if(dynamic_cast<intermediate::BranchLabel*>(instr) != nullptr)
-		basicBlocks.emplace_back(*this, dynamic_cast<intermediate::BranchLabel*>(instr));
+	if(instr->is<intermediate::BranchLabel>())
+	{
+		BasicBlock* previousBlock = basicBlocks.empty() ? nullptr : &basicBlocks.back();
+		basicBlocks.emplace_back(*this, instr->as<intermediate::BranchLabel>());
+		analyses->blockAdded(basicBlocks.back(), previousBlock);
+	}
 	else if(basicBlocks.empty())
 	{
 		// in case the input code does not always add a label to the start of a function
 		basicBlocks.emplace_back(*this, new intermediate::BranchLabel(*findOrCreateLocal(TYPE_LABEL, BasicBlock::DEFAULT_BLOCK)));
 		basicBlocks.back().instructions.emplace_back(instr);
+		analyses->blockAdded(basicBlocks.back(), nullptr);
 	}
 	else
+	{
 		basicBlocks.back().instructions.emplace_back(instr);
+		if(instr->is<intermediate::Branch>())
+			analyses->blockModified(basicBlocks.back());
+	}
 }
 
 InstructionWalker Method::appendToEnd()
@@ -384,11 +471,28 @@ InstructionWalker Method::appendToEnd()
 	return basicBlocks.back().end();
 }
 
-const OrderedMap<std::string, Local>& Method::readLocals() const
+const std::vector<std::unique_ptr<Local>>& Method::readLocals() const
 {
 	return locals;
 }
 
+void Method::removeLocal(const std::string& name)
+{
+	auto it = localsByName.find(name);
+	if(it == localsByName.end())
+		return;
+	const Local* loc = it->second;
+	localsByName.erase(it);
+	locals.erase(std::find_if(locals.begin(), locals.end(), [loc](const std::unique_ptr<Local>& l) -> bool { return l.get() == loc;}));
+}
+
+void Method::releaseInstructions()
+{
+	//the analyses refer to the basic blocks and instructions
+	analyses->invalidate();
+	basicBlocks.clear();
+}
+
 void Method::cleanLocals()
 {
 #ifdef DEBUG_MODE
@@ -405,35 +509,35 @@ void Method::cleanLocals()
 			throw CompilationError(CompilationStep::GENERAL, "Duplicate parameter for method", p.to_string());
 	}
 #endif
-	auto it = locals.begin();
-	std::size_t numCleaned = 0;
-	while(it != locals.end())
+	//compacts the list of locals in a single pass, keeping the order of the remaining locals
+	auto it = std::remove_if(locals.begin(), locals.end(), [&](std::unique_ptr<Local>& loc) -> bool
 	{
 #ifdef DEBUG_MODE
-		if(!localNames.emplace(it->first).second)
-			throw CompilationError(CompilationStep::GENERAL, "Local is already defined for method", it->second.to_string());
+		if(!localNames.emplace(loc->name).second)
+			throw CompilationError(CompilationStep::GENERAL, "Local is already defined for method", loc->to_string());
 #endif
-		if((*it).second.getUsers().empty())
-		{
-			it = locals.erase(it);
-		}
-		else
-			++it;
-	}
-	logging::debug() << "Cleaned " << numCleaned << " unused locals from method " << name << logging::endl;
+		if(!loc->getUsers().empty())
+			return false;
+		localsByName.erase(loc->name);
+		loc.reset();
+		return true;
+	});
+	const std::size_t numCleaned = static_cast<std::size_t>(locals.end() - it);
+	locals.erase(it, locals.end());
+	DEBUG_LOG("Cleaned " << numCleaned << " unused locals from method " << name << logging::endl);
 }
 
 void Method::dumpInstructions() const
 {
 	for(const BasicBlock& bb : basicBlocks)
 	{
-		logging::debug() << "Basic block ----" << logging::endl;
-		for(const auto& instr : bb.instructions)
+		DEBUG_LOG("Basic block ----" << logging::endl);
+		for(const intermediate::IntermediateInstruction* instr : bb.instructions)
 		{
 			if(instr)
-				logging::debug() << instr->to_string() << logging::endl;
+				DEBUG_LOG(instr->to_string() << logging::endl);
 		}
-		logging::debug() << "Block end ----" << logging::endl;
+		DEBUG_LOG("Block end ----" << logging::endl);
 	}
 }
 
@@ -444,12 +548,7 @@ RandomModificationList<BasicBlock>& Method::getBasicBlocks()
 
 BasicBlock* Method::findBasicBlock(const Local* label)
 {
-	for(BasicBlock& bb : basicBlocks)
-	{
-		if(bb.begin().has<intermediate::BranchLabel>() && bb.begin().get<intermediate::BranchLabel>()->getLabel() == label)
-			return &bb;
-	}
-	return nullptr;
+	return analyses->getControlFlowGraph().findBlock(label);
 }
 
 InstructionWalker Method::emplaceLabel(InstructionWalker it, intermediate::BranchLabel* label)
@@ -465,15 +564,23 @@ InstructionWalker Method::emplaceLabel(InstructionWalker it, intermediate::Branc
 		throw CompilationError(CompilationStep::GENERAL, "Failed to find basic block for instruction iterator");
 	//1. insert new basic block after the current (or in front of it, if we emplace at the start of the basic block)
 	bool isStartOfBlock = blockIt->begin() == it;
+	BasicBlock* previousBlock = nullptr;
 	if(!isStartOfBlock)
+	{
+		previousBlock = &(*blockIt);
 		++blockIt;
+	}
+	else if(blockIt != basicBlocks.begin())
+		previousBlock = &(*std::prev(blockIt));
 	BasicBlock& newBlock = *basicBlocks.emplace(blockIt, *this, label);
 	//2. move all instructions beginning with it (inclusive) to the new basic block
+	//this bypasses the InstructionWalker, since the control-flow graph is updated at once for both blocks afterwards
 	while(!isStartOfBlock && !it.isEndOfBlock())
 	{
-		newBlock.instructions.emplace_back(it.release());
-		it.erase();
+		newBlock.instructions.emplace_back(it.basicBlock->instructions.release(it.pos));
+		it.pos = it.basicBlock->instructions.erase(it.pos);
 	}
+	analyses->blockAdded(newBlock, previousBlock);
 	//3. return the begin() of the new basic block
 	return newBlock.begin();
 }
@@ -569,7 +676,7 @@ BasicBlock* Method::getPreviousBlock(const BasicBlock* block)
 //}
 
 
-Module::Module(const Configuration& compilationConfig): compilationConfig(compilationConfig)
+Module::Module(const Configuration& compilationConfig): compilationConfig(compilationConfig), budget(compilationConfig)
 {
 
 }
@@ -588,19 +695,89 @@ std::vector<Method*> Module::getKernels()
 	return kernels;
 }
 
-Optional<unsigned int> Module::getGlobalDataOffset(const Local* local) const
+/*
+ * Whether the global is read-only and initialized, so it can share its data with other globals with the same content
+ */
+static bool isConstantData(const Global& global)
 {
-	if(!local->is<Global>())
-		return {};
-	unsigned int offset = 0;
+	return global.type.isPointerType() && global.type.getPointerType().get()->addressSpace == AddressSpace::CONSTANT && !global.value.hasType(ValueType::UNDEFINED);
+}
+
+static unsigned int getNaturalAlignment(const DataType& type)
+{
+	if(type.getArrayType().hasValue)
+		return getNaturalAlignment(type.getArrayType().get()->elementType);
+	if(type.complexType != nullptr)
+		//TODO alignment of structs
+		return sizeof(uint32_t);
+	//the scalar and vector types are aligned to their size
+	return std::max(type.getPhysicalWidth(), 1u);
+}
+
+static unsigned int getAlignment(const Global& global)
+{
+	if(global.type.isPointerType() && global.type.getPointerType().get()->alignment != 0)
+		return global.type.getPointerType().get()->alignment;
+	return getNaturalAlignment(global.value.type);
+}
+
+void Module::layoutGlobalData()
+{
+	globalDataOffsets.clear();
+	globalDataSegment.clear();
+	//the uninitialized globals (e.g. __local buffers) are placed at the end, since they are the most likely to be not accessed anymore after
+	//the kernels are optimized (e.g. if they are mapped to the VPM), in which case they can be dropped from the end of the segment
+	std::vector<const Global*> globals;
+	for(const Global& global : globalData)
+	{
+		if(!global.type.isPointerType() || !global.value.hasType(ValueType::UNDEFINED))
+			globals.push_back(&global);
+	}
 	for(const Global& global : globalData)
 	{
-		if(local == &global)
+		if(global.type.isPointerType() && global.value.hasType(ValueType::UNDEFINED))
+			globals.push_back(&global);
+	}
+
+	unsigned int offset = 0;
+	for(const Global* global : globals)
+	{
+		if(isConstantData(*global))
 		{
-			return offset;
+			auto sameIt = std::find_if(globalDataSegment.begin(), globalDataSegment.end(), [global](const Global* other) -> bool
+			{
+				return isConstantData(*other) && other->value == global->value;
+			});
+			if(sameIt != globalDataSegment.end())
+			{
+				DEBUG_LOG("Global " << global->to_string() << " shares the data of " << (*sameIt)->to_string() << logging::endl);
+				globalDataOffsets.emplace(global, globalDataOffsets.at(*sameIt));
+				continue;
+			}
 		}
-		offset += global.value.type.getPhysicalWidth();
+		const unsigned int alignment = getAlignment(*global);
+		if(offset % alignment != 0)
+			offset += alignment - (offset % alignment);
+		globalDataOffsets.emplace(global, offset);
+		globalDataSegment.push_back(global);
+		offset += global->value.type.getPhysicalWidth();
 	}
-	return {};
+	DEBUG_LOG("Global data segment contains " << globalDataSegment.size() << " of " << globalData.size() << " globals with a size of " << offset << " bytes" << logging::endl);
+}
+
+Optional<unsigned int> Module::getGlobalDataOffset(const Local* local) const
+{
+	const Global* global = local->as<Global>();
+	if(global == nullptr)
+		return {};
+	auto it = globalDataOffsets.find(global);
+	if(it == globalDataOffsets.end())
+		return {};
+	return it->second;
+}
+
+const std::vector<const Global*>& Module::getGlobalDataSegment() const
+{
+	return globalDataSegment;
 }
 
@@ -8,10 +8,12 @@
 #define SRC_MODULE_H_
 
 #include "config.h"
+#include "CompilationBudget.h"
 #include "Types.h"
 #include "Values.h"
 #include "Locals.h"
 #include "performance.h"
+#include "intermediate/InstructionList.h"
 
 namespace vc4c
 {
@@ -19,6 +21,7 @@ namespace vc4c
 	{
 		class IntermediateInstruction;
 		class BranchLabel;
+		class InstructionArena;
 	}
 
 	namespace periphery
@@ -26,6 +29,11 @@ namespace vc4c
 		class VPM;
 	}
 
+	namespace analysis
+	{
+		class AnalysisManager;
+	}
+
 	enum class MetaDataType
 	{
 		//TODO remove most of them (except work-group-sizes and size-hint)
@@ -86,7 +94,7 @@ namespace vc4c
 		Optional<InstructionWalker> findWalkerForInstruction(const intermediate::IntermediateInstruction* instr, InstructionWalker start);
 	private:
 		Method& method;
-		RandomModificationList<std::unique_ptr<intermediate::IntermediateInstruction>> instructions;
+		intermediate::InstructionList instructions;
 
 		friend class InstructionWalker;
 		friend class InstructionVisitor;
@@ -111,6 +119,12 @@ namespace vc4c
 		static const std::string GLOBAL_DATA_ADDRESS;
 		//the number of (remaining) work-groups to execute in loop
 		static const std::string GROUP_LOOP_SIZE;
+		//the buffer for the counters of the instrumented basic blocks, passed by the run-time as additional last parameter (see Configuration#instrumentBlocks)
+		static const std::string BLOCK_PROFILE_BUFFER;
+		//the buffer containing the vector parameters, passed by the run-time as additional parameter after the kernel parameters (see Configuration#bufferVectorParameters)
+		static const std::string PARAMETER_BUFFER;
+		//the buffer the records of printf calls are written into, passed by the run-time as additional parameter after the block-profile buffer, if the method calls printf
+		static const std::string PRINTF_BUFFER;
 
 		bool isKernel;
 		std::string name;
@@ -118,6 +132,18 @@ namespace vc4c
 		std::vector<Parameter> parameters;
 		std::map<MetaDataType, std::vector<std::string>> metaData;
 		std::unique_ptr<periphery::VPM> vpm;
+		//the global data whose address is accessed by this method, set when the accesses are mapped into the global data segment
+		FastSet<const Global*> accessedGlobals;
+		//the labels of the basic blocks counted by the instrumentation in the order of the counters, empty if the method is not instrumented
+		std::vector<std::string> instrumentedBlocks;
+		//the locals for the constants passed by the run-time as additional UNIFORMs after the parameters and their values, in the order of the UNIFORMs (see Configuration#maxUniformConstants)
+		std::vector<std::pair<const Local*, uint32_t>> uniformConstants;
+		//the vector parameters passed in the parameter buffer instead of one UNIFORM per element, in the order of their rows in the buffer (see Configuration#bufferVectorParameters)
+		std::vector<const Parameter*> bufferedParameters;
+		//the number of work-items every QPU executes one after the other, if the work-group is larger than the number of QPUs (see optimizations#loopWorkItems)
+		uint8_t workItemsPerQPU;
+		//whether the kernel is small enough to be compiled via the fast path (see Configuration#fastPathInstructions), set before the optimizations
+		bool isFastPath;
 
 		Method(const Module& module);
 		~Method();
@@ -137,15 +163,45 @@ namespace vc4c
 		 */
 		bool isLocallyLimited(InstructionWalker curIt, const Local* locale, const std::size_t threshold = ACCUMULATOR_THRESHOLD_HINT) const;
 
+		/*
+		 * Runs the consumer for all basic blocks, in parallel (for methods large enough) if multi-threading is enabled.
+		 *
+		 * The consumer may only modify the instructions of the given block and must not add or remove any block or branch, create new locals or modify the method itself.
+		 * Reading the users of locals also used in other blocks requires locking the users of the local (see Local#getUsers())
+		 */
+		void forAllBasicBlocksInParallel(const std::function<void(BasicBlock&)>& consumer);
+
 		InstructionWalker walkAllInstructions();
-		void forAllInstructions(const std::function<void(const intermediate::IntermediateInstruction*)>& consumer) const;
+		template<typename Consumer>
+		void forAllInstructions(Consumer&& consumer) const
+		{
+			for(const BasicBlock& bb : basicBlocks)
+			{
+				for(const intermediate::IntermediateInstruction* instr : bb.instructions)
+					consumer(instr);
+			}
+		}
 		std::size_t countInstructions() const;
+		/*
+		 * Increased on every insertion, removal or replacement of an instruction, so the changes done by an optimization can be detected.
+		 * NOTE: Modifications of the instructions themselves (e.g. replacing an argument) are not counted
+		 */
+		std::size_t getModificationCount() const;
 		std::size_t cleanEmptyInstructions();
 		void appendToEnd(intermediate::IntermediateInstruction* instr);
 		InstructionWalker appendToEnd();
 
-		const OrderedMap<std::string, Local>& readLocals() const;
+		/*
+		 * The locals of this method in the order of their creation
+		 */
+		const std::vector<std::unique_ptr<Local>>& readLocals() const;
+		void removeLocal(const std::string& name);
 		void cleanLocals();
+		/*
+		 * Frees all basic blocks and instructions, e.g. after the machine code of the kernel was generated.
+		 * The locals (which might still be referenced, e.g. by #uniformConstants) and all other properties of the method are kept
+		 */
+		void releaseInstructions();
 
 		void dumpInstructions() const;
 		RandomModificationList<BasicBlock>& getBasicBlocks();
@@ -153,12 +209,37 @@ namespace vc4c
 
 		InstructionWalker emplaceLabel(InstructionWalker it, intermediate::BranchLabel* label);
 
+		/*
+		 * The memory-pool for the instructions of this method, needs to be activated to be used
+		 */
+		intermediate::InstructionArena* getInstructionArena();
+		/*
+		 * The cached analyses (e.g. control-flow graph) of this method
+		 */
+		analysis::AnalysisManager& getAnalyses();
+		/*
+		 * The module this method belongs to, e.g. to access the compilation configuration
+		 */
+		const Module& getModule() const;
+
+		/*
+		 * The counter used to generate the names of temporary locals, shared by all methods.
+		 * Needs to be restored when loading serialized methods, so no new local re-uses the name of a loaded one
+		 */
+		static std::size_t getTemporaryNameCounter();
+		static void advanceTemporaryNameCounter(std::size_t minimumValue);
+
 	private:
 		const Module& module;
+		intermediate::InstructionArena* instructionArena;
+		std::unique_ptr<analysis::AnalysisManager> analyses;
 		RandomModificationList<BasicBlock> basicBlocks;
-		OrderedMap<std::string, Local> locals;
+		//the locals are stored in a dense list, the name-lookup is only required by the front-ends and the inliner
+		std::vector<std::unique_ptr<Local>> locals;
+		FastMap<std::string, const Local*> localsByName;
 
 		std::string createLocalName(const std::string& prefix = "", const std::string& postfix = "");
+		const Local* createLocal(const DataType& type, const std::string& name);
 
 		BasicBlock* getNextBlockAfter(const BasicBlock* block);
 		BasicBlock* getPreviousBlock(const BasicBlock* block);
@@ -178,11 +259,33 @@ namespace vc4c
 
 		ReferenceRetainingList<Global> globalData;
 		std::vector<std::unique_ptr<Method>> methods;
+		//the interned complex types created by the front-ends
+		TypeHolder types;
 
 		std::vector<Method*> getKernels();
+		/*
+		 * Calculates the layout of the global data segment:
+		 * identical constant globals share their data and every global is aligned to the alignment of its type.
+		 *
+		 * Needs to be called after all globals are created and before the kernels access the offsets of the global data
+		 */
+		void layoutGlobalData();
+		/*
+		 * Returns the offset of the global within the global data segment, see #layoutGlobalData()
+		 */
 		Optional<unsigned int> getGlobalDataOffset(const Local* local) const;
+		/*
+		 * The globals stored in the global data segment in the order of their offsets, without the globals sharing the data of other globals
+		 */
+		const std::vector<const Global*>& getGlobalDataSegment() const;
 
 		const Configuration& compilationConfig;
+		//the cancellation and budgets of the compilation of this module, started with the creation of the module
+		const CompilationBudget budget;
+
+	private:
+		FastMap<const Global*, unsigned int> globalDataOffsets;
+		std::vector<const Global*> globalDataSegment;
 	};
 }
 
@@ -10,10 +10,20 @@
 #include <fstream>
 #include <libgen.h>
 #include <iterator>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "Precompiler.h"
-#include "log.h"
+#include "Logging.h"
 #include "ProcessUtil.h"
+#include "CompilationCache.h"
+#ifdef USE_CLANG_LIBRARY
+#include "ClangLibrary.h"
+#endif
 #ifdef SPIRV_HEADER
 #include "spirv/SPIRVHelper.h"
 #endif
@@ -56,7 +66,7 @@ SourceType Precompiler::getSourceType(std::istream& stream)
     return type;
 }
 
-void Precompiler::linkSourceCode(const std::unordered_map<std::istream*, Optional<std::string>>& inputs, std::ostream& output)
+void Precompiler::linkSourceCode(const std::unordered_map<std::istream*, Optional<std::string>>& inputs, std::ostream& output, const std::string& options, bool createLibrary)
 {
 #ifndef SPIRV_HEADER
 	throw CompilationError(CompilationStep::LINKER, "SPIR-V front-end is not provided!");
@@ -76,25 +86,136 @@ void Precompiler::linkSourceCode(const std::unordered_map<std::istream*, Optiona
 		{
 			Precompiler comp(*pair.first, type, pair.second);
 			conversionBuffer.emplace_back(new std::stringstream());
-			comp.run(conversionBuffer.back(), SourceType::SPIRV_BIN);
+			comp.run(conversionBuffer.back(), SourceType::SPIRV_BIN, options);
 			convertedInputs.push_back(conversionBuffer.back().get());
 		}
 	}
 
-	logging::debug() << "Linking " << inputs.size() << " input modules..." << logging::endl;
-	spirv2qasm::linkSPIRVModules(convertedInputs, output);
+	DEBUG_LOG("Linking " << inputs.size() << " input modules..." << logging::endl);
+	spirv2qasm::linkSPIRVModules(convertedInputs, output, createLibrary);
 #endif
 }
 
-static std::string buildCommand(const std::string& compiler, const std::string& defaultOptions, const std::string& options, const std::string& emitter, const std::string& outputFile, const std::string& inputFile = "-")
+void Precompiler::compileObject(std::istream& input, std::ostream& output, const std::string& options, const Optional<std::string>& inputFile)
+{
+	const SourceType type = getSourceType(input);
+	if(type == SourceType::SPIRV_BIN)
+	{
+		//is already an object
+		output << input.rdbuf();
+		return;
+	}
+	//the pre-compilation result is cached, so unchanged modules are not compiled again
+	Precompiler comp(input, type, inputFile);
+	std::unique_ptr<std::istream> object;
+	comp.run(object, SourceType::SPIRV_BIN, options);
+	//the OpenCL C compilation falls back to LLVM-IR, if the SPIR-V conversion fails
+	if(getSourceType(*object) != SourceType::SPIRV_BIN)
+		throw CompilationError(CompilationStep::PRECOMPILATION, "Module can't be compiled into a linkable SPIR-V object", inputFile ? inputFile.get() : "");
+	output << object->rdbuf();
+}
+
+#if defined SPIRV_CLANG_PATH
+static const std::string PCH_COMPILER = SPIRV_CLANG_PATH;
+#elif defined CLANG_PATH
+static const std::string PCH_COMPILER = CLANG_PATH;
+#endif
+
+static time_t getModificationTime(const std::string& file)
+{
+	struct stat fileStat;
+	if(stat(file.data(), &fileStat) != 0)
+		return 0;
+	return fileStat.st_mtime;
+}
+
+static std::vector<std::string> listStandardLibraryHeaders(const std::string& directory)
+{
+	std::vector<std::string> files;
+	DIR* dir = opendir(directory.data());
+	if(dir == nullptr)
+		return files;
+	while(const dirent* entry = readdir(dir))
+	{
+		const std::string name(entry->d_name);
+		if(name.size() > 2 && name.substr(name.size() - 2) == ".h")
+			files.push_back(directory + "/" + name);
+	}
+	closedir(dir);
+	//the order of the directory entries is not specified
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+/*
+ * Determines the pre-compiled header of the VC4CL standard-library to use.
+ *
+ * If the PCH generated at build-time is missing or older than the standard-library headers or the compiler,
+ * the PCH is generated into the compilation cache, keyed by the contents of the headers and the compiler.
+ */
+static std::string findStandardLibraryPCH()
+{
+#if defined VC4CL_STDLIB_HEADER_SOURCE && (defined SPIRV_CLANG_PATH || defined CLANG_PATH)
+	char buffer[1024];
+	strcpy(buffer, VC4CL_STDLIB_HEADER_SOURCE);
+	const std::vector<std::string> headers = listStandardLibraryHeaders(dirname(buffer));
+
+	time_t newestDependency = getModificationTime(PCH_COMPILER);
+	for(const std::string& header : headers)
+		newestDependency = std::max(newestDependency, getModificationTime(header));
+	const time_t pchTime = getModificationTime(VC4CL_STDLIB_HEADER);
+	if(pchTime != 0 && pchTime >= newestDependency)
+		return VC4CL_STDLIB_HEADER;
+
+	const Optional<std::string> cacheDir = getCompilationCacheDirectory();
+	if(!cacheDir)
+	{
+		logging::warn() << "Pre-compiled VC4CL standard-library header is outdated, but no cache directory is available to rebuild it" << logging::endl;
+		return VC4CL_STDLIB_HEADER;
+	}
+	std::string keyData = PCH_COMPILER + '\0' + std::to_string(getModificationTime(PCH_COMPILER)) + '\0';
+	for(const std::string& header : headers)
+	{
+		std::ifstream in(header, std::ios_base::in | std::ios_base::binary);
+		keyData.append(header).append(1, '\0').append(std::istreambuf_iterator<char>(in), {}).append(1, '\0');
+	}
+	const std::string pchFile = cacheDir.get() + "/VC4CLStdLib-" + getCacheKey(keyData) + ".pch";
+	if(access(pchFile.data(), R_OK) == 0)
+		return pchFile;
+
+	//write into temporary file and rename, so concurrent processes never use a partially written PCH
+	const std::string tmpFile = pchFile + ".tmp." + std::to_string(getpid());
+	const std::string command = PCH_COMPILER + " -cc1 -triple spir-unknown-unknown -O3 -cl-std=CL1.2 -cl-kernel-arg-info -cl-single-precision-constant -Wno-all -Wno-gcc-compat -x cl -emit-pch -o " + tmpFile + " " + VC4CL_STDLIB_HEADER_SOURCE;
+	INFO_LOG("Pre-compiling VC4CL standard-library with: " << command << logging::endl);
+	std::ostringstream stderr;
+	if(runProcess(command, nullptr, nullptr, &stderr) != 0 || std::rename(tmpFile.data(), pchFile.data()) != 0)
+	{
+		logging::warn() << "Failed to pre-compile VC4CL standard-library: " << stderr.str() << logging::endl;
+		std::remove(tmpFile.data());
+		return VC4CL_STDLIB_HEADER;
+	}
+	return pchFile;
+#else
+	return VC4CL_STDLIB_HEADER;
+#endif
+}
+
+static const std::string& getStandardLibraryPCH()
+{
+	//initialized thread-safe once, afterwards concurrent compilations read it without locking
+	static const std::string pchFile = findStandardLibraryPCH();
+	return pchFile;
+}
+
+static std::string buildOptions(const std::string& defaultOptions, const std::string& options)
 {
 	//check validity of options - we do not support all of them
 	if(options.find("-create-library") != std::string::npos)
 		throw CompilationError(CompilationStep::PRECOMPILATION, "Invalid compilation options", options);
 
-	//build command-string
+	//build options-string
 	std::string command;
-	command.append(compiler).append(" ").append(defaultOptions).append(" ").append(options).append(" ");
+	command.append(defaultOptions).append(" ").append(options).append(" ");
 
 	//append default options
 	if(options.find("-O") == std::string::npos)
@@ -122,22 +243,29 @@ static std::string buildCommand(const std::string& compiler, const std::string&
 #endif
 	//link in our standard-functions
 	command.append(" -Wno-undefined-inline -Wno-unused-parameter -Wno-unused-local-typedef -Wno-gcc-compat ");
-	command.append("-include-pch " VC4CL_STDLIB_HEADER " ");
+	command.append("-include-pch ").append(getStandardLibraryPCH()).append(" ");
 	if(options.find("-x cl") == std::string::npos)
 	{
 		//build OpenCL, required when input is from stdin, since clang can't determine from file-type
 		command.append("-x cl ");
 	}
+	return command;
+}
+
+static std::string buildCommand(const std::string& compiler, const std::string& defaultOptions, const std::string& options, const std::string& emitter, const std::string& outputFile, const std::string& inputFile = "-")
+{
+	std::string command;
+	command.append(compiler).append(" ").append(buildOptions(defaultOptions, options));
 	//use temporary file as output
 	//use stdin as input
 	return command.append(emitter).append(" -o ").append(outputFile).append(" ").append(inputFile);
 }
 
-static void runPrecompiler(const std::string& command, std::istream* inputStream, std::ostream* outputStream, const Optional<std::string>& tempFile)
+static void runPrecompiler(const std::vector<std::string>& commands, std::istream* inputStream, std::ostream* outputStream)
 {
 	std::ostringstream stderr;
-	int status = runProcess(command, inputStream, outputStream, &stderr);
-	if(status == 0)	//success
+	const std::vector<int> status = runProcesses(commands, inputStream, outputStream, &stderr);
+	if(std::all_of(status.begin(), status.end(), [](int s) -> bool { return s == 0;}))	//success
 	{
 		if(!stderr.str().empty())
 		{
@@ -154,11 +282,8 @@ static void runPrecompiler(const std::string& command, std::istream* inputStream
 	throw CompilationError(CompilationStep::PRECOMPILATION, "Error in precompilation", stderr.str());
 }
 
-static void compileOpenCLToLLVMIR(std::istream& input, std::ostream& output, const std::string& options, const bool toText = true, const Optional<std::string>& inputFile = {}, const Optional<std::string>& outputFile ={})
+static std::string buildClangCommand(const std::string& options, const bool toText, const Optional<std::string>& inputFile, const Optional<std::string>& outputFile)
 {
-#if not defined SPIRV_CLANG_PATH && not defined CLANG_PATH
-	throw CompilationError(CompilationStep::PRECOMPILATION, "No CLang configured for pre-compilation!");
-#endif
 #ifdef SPIRV_CLANG_PATH
 	//just OpenCL C -> LLVM IR (but with Khronos CLang)
 	const std::string compiler = SPIRV_CLANG_PATH;
@@ -169,11 +294,37 @@ static void compileOpenCLToLLVMIR(std::istream& input, std::ostream& output, con
 #endif
 	//only run preprocessor and compilation, no linking and code-generation
 	//emit LLVM IR
-	const std::string command = buildCommand(compiler, defaultOptions, options, std::string("-S ").append(toText ? "-emit-llvm": "-emit-llvm-bc"), outputFile.hasValue ? outputFile.get() : "/dev/stdout", inputFile.hasValue ? inputFile.get() : "-");
+	return buildCommand(compiler, defaultOptions, options, std::string("-S ").append(toText ? "-emit-llvm": "-emit-llvm-bc"), outputFile.hasValue ? outputFile.get() : "/dev/stdout", inputFile.hasValue ? inputFile.get() : "-");
+}
 
-	logging::info() << "Compiling OpenCL to LLVM-IR with :" << command << logging::endl;
+static std::string buildLLVMSPIRVCommand(const bool toText, const Optional<std::string>& inputFile, const Optional<std::string>& outputFile)
+{
+	std::string command = (std::string(SPIRV_LLVM_SPIRV_PATH) + (toText ? " -spirv-text" : "")) + " -o ";
+	command.append(outputFile.hasValue ? outputFile.get() : "/dev/stdout").append(" ");
+	return command.append(inputFile.hasValue ? inputFile.get() : "/dev/stdin");
+}
 
-	runPrecompiler(command, inputFile.hasValue ? nullptr : &input, outputFile.hasValue ? nullptr : &output, outputFile);
+static void compileOpenCLToLLVMIR(std::istream& input, std::ostream& output, const std::string& options, const bool toText = true, const Optional<std::string>& inputFile = {}, const Optional<std::string>& outputFile ={})
+{
+#if not defined SPIRV_CLANG_PATH && not defined CLANG_PATH
+	throw CompilationError(CompilationStep::PRECOMPILATION, "No CLang configured for pre-compilation!");
+#endif
+#ifdef USE_CLANG_LIBRARY
+	if(!outputFile)
+	{
+		//compile in-process from memory, the CLang library is always run as front-end (cc1), so use the triple of the pre-compiled standard-library
+		const std::string source(std::istreambuf_iterator<char>(input), {});
+		const std::string arguments = buildOptions("-triple spir-unknown-unknown", options);
+		INFO_LOG("Compiling OpenCL to LLVM-IR in-process with :" << arguments << logging::endl);
+		compileWithClangLibrary(source, output, arguments, toText, inputFile);
+		return;
+	}
+#endif
+	const std::string command = buildClangCommand(options, toText, inputFile, outputFile);
+
+	INFO_LOG("Compiling OpenCL to LLVM-IR with :" << command << logging::endl);
+
+	runPrecompiler({command}, inputFile.hasValue ? nullptr : &input, outputFile.hasValue ? nullptr : &output);
 }
 
 static void compileLLVMIRToSPIRV(std::istream& input, std::ostream& output, const std::string& options, const bool toText = false, const Optional<std::string>& inputFile = {}, const Optional<std::string>& outputFile ={})
@@ -183,13 +334,11 @@ static void compileLLVMIRToSPIRV(std::istream& input, std::ostream& output, cons
 #elif not defined SPIRV_PARSER_HEADER
 	throw CompilationError(CompilationStep::PRECOMPILATION, "SPIRV-Tools not configured, can't process SPIR-V!");
 #endif
-	std::string command = (std::string(SPIRV_LLVM_SPIRV_PATH) + (toText ? " -spirv-text" : "")) + " -o ";
-	command.append(outputFile.hasValue ? outputFile.get() : "/dev/stdout").append(" ");
-	command.append(inputFile.hasValue ? inputFile.get() : "/dev/stdin");
+	const std::string command = buildLLVMSPIRVCommand(toText, inputFile, outputFile);
 
-	logging::info() << "Converting LLVM-IR to SPIR-V with :" << command << logging::endl;
+	INFO_LOG("Converting LLVM-IR to SPIR-V with :" << command << logging::endl);
 
-	runPrecompiler(command, inputFile.hasValue ? nullptr : &input, outputFile.hasValue ? nullptr : &output, outputFile);
+	runPrecompiler({command}, inputFile.hasValue ? nullptr : &input, outputFile.hasValue ? nullptr : &output);
 }
 
 static void compileOpenCLToSPIRV(std::istream& input, std::ostream& output, const std::string& options, const bool toText = false, const Optional<std::string>& inputFile = {}, const Optional<std::string>& outputFile ={})
@@ -200,16 +349,29 @@ static void compileOpenCLToSPIRV(std::istream& input, std::ostream& output, cons
 	throw CompilationError(CompilationStep::PRECOMPILATION, "SPIRV-Tools not configured, can't process SPIR-V!");
 #endif
 
-	std::stringstream tmp;
-	//1) OpenCL C -> LLVM IR BC (with Khronos CLang)
-	compileOpenCLToLLVMIR(input, tmp, options, false, inputFile);
-	//2) LLVM IR BC -> SPIR-V
 	try
 	{
+#ifdef USE_CLANG_LIBRARY
+		//1) OpenCL C -> LLVM IR BC (in-process, the module is created in memory anyway)
+		std::stringstream tmp;
+		compileOpenCLToLLVMIR(input, tmp, options, false, inputFile);
+		//2) LLVM IR BC -> SPIR-V
 		compileLLVMIRToSPIRV(tmp, output, options, toText, {}, outputFile);
+#else
+		/*
+		 * 1) OpenCL C -> LLVM IR BC (with Khronos CLang)
+		 * 2) LLVM IR BC -> SPIR-V
+		 * The LLVM IR is piped directly from CLang into the SPIR-V converter, so both run at the same time and the LLVM IR is never stored
+		 */
+		const std::string clangCommand = buildClangCommand(options, false, inputFile, {});
+		const std::string spirvCommand = buildLLVMSPIRVCommand(toText, {}, outputFile);
+		INFO_LOG("Compiling OpenCL to SPIR-V with :" << clangCommand << " | " << spirvCommand << logging::endl);
+		runPrecompiler({clangCommand, spirvCommand}, inputFile.hasValue ? nullptr : &input, outputFile.hasValue ? nullptr : &output);
+#endif
 	}
 	catch(const CompilationError& e)
 	{
+		//if the error is in the OpenCL C code, this fails (again) with the CLang error
 		logging::warn() << "LLVM-IR to SPIR-V failed, trying to compile with the LLVM-IR front-end..." << logging::endl;
 		compileOpenCLToLLVMIR(input, output, options, true, inputFile, outputFile);
 	}
@@ -226,9 +388,9 @@ static void compileSPIRVToSPIRV(std::istream& input, std::ostream& output, const
 	command.append(outputFile.hasValue ? outputFile.get() : "/dev/stdout").append(" ");
 	command.append(inputFile.hasValue ? inputFile.get() : "/dev/stdin");
 
-	logging::info() << "Converting between SPIR-V text and SPIR-V binary with :" << command << logging::endl;
+	INFO_LOG("Converting between SPIR-V text and SPIR-V binary with :" << command << logging::endl);
 
-	runPrecompiler(command, inputFile.hasValue ? nullptr : &input, outputFile.hasValue ? nullptr : &output, outputFile);
+	runPrecompiler({command}, inputFile.hasValue ? nullptr : &input, outputFile.hasValue ? nullptr : &output);
 }
 
 Precompiler::Precompiler(std::istream& input, const SourceType inputType, const Optional<std::string> inputFile) :
@@ -257,44 +419,69 @@ void Precompiler::run(std::unique_ptr<std::istream>& output, const SourceType ou
 
 	if(inputType == outputType)
 	{
-		const std::string buffer(std::istreambuf_iterator<char>(input), {});
-		output.reset(new std::istringstream(buffer));
+		//share the buffer of the input (which lives as long as this pre-compiler) instead of copying the input
+		output.reset(new std::istream(input.rdbuf()));
 		return;
 	}
 
+	//the pre-compiled code does not depend on the configuration, so it can be re-used when only the configuration changes
+	Optional<std::string> cacheKey;
+	std::istringstream sourceStream;
+	if(!outputFile)
+	{
+		std::ifstream file;
+		if(inputFile)
+			file.open(inputFile.get(), std::ios_base::in | std::ios_base::binary);
+		std::istream& in = inputFile ? file : input;
+		const std::string source(std::istreambuf_iterator<char>(in), {});
+		//the standard-library header changes the output too, its PCH file identifies its version
+		const std::string keyOptions = inputType == SourceType::OPENCL_C ? extendedOptions + " " + getStandardLibraryPCH() : extendedOptions;
+		cacheKey = getPrecompilationCacheKey(source, keyOptions, inputType, outputType);
+		const Optional<std::string> cached = readCompilationCache(cacheKey.get());
+		if(cached)
+		{
+			output.reset(new std::istringstream(cached.get()));
+			return;
+		}
+		sourceStream.str(source);
+	}
+	std::istream& sourceInput = cacheKey ? sourceStream : input;
+
 	std::ostringstream tempStream;
 
 	if(inputType == SourceType::OPENCL_C)
 	{
 		if(outputType == SourceType::LLVM_IR_TEXT)
-			compileOpenCLToLLVMIR(input, tempStream, extendedOptions, true, inputFile, outputFile);
+			compileOpenCLToLLVMIR(sourceInput, tempStream, extendedOptions, true, inputFile, outputFile);
 		else if(outputType == SourceType::LLVM_IR_BIN)
-			compileOpenCLToLLVMIR(input, tempStream, extendedOptions, false, inputFile, outputFile);
+			compileOpenCLToLLVMIR(sourceInput, tempStream, extendedOptions, false, inputFile, outputFile);
 		else if(outputType == SourceType::SPIRV_BIN)
-			compileOpenCLToSPIRV(input, tempStream, extendedOptions, false, inputFile, outputFile);
+			compileOpenCLToSPIRV(sourceInput, tempStream, extendedOptions, false, inputFile, outputFile);
 		else if(outputType ==SourceType::SPIRV_TEXT)
-			compileOpenCLToSPIRV(input, tempStream, extendedOptions, true, inputFile, outputFile);
+			compileOpenCLToSPIRV(sourceInput, tempStream, extendedOptions, true, inputFile, outputFile);
 	}
 	else if(inputType == SourceType::LLVM_IR_TEXT)
 	{
 		//TODO the result of this does not have the correct output-format (but can be handled by the LLVM front-end)
-		tempStream << input.rdbuf();
+		tempStream << sourceInput.rdbuf();
 	}
 	else if(inputType == SourceType::LLVM_IR_BIN)
 	{
 		if(outputType == SourceType::SPIRV_BIN)
-			compileLLVMIRToSPIRV(input, tempStream, extendedOptions, false, inputFile, outputFile);
+			compileLLVMIRToSPIRV(sourceInput, tempStream, extendedOptions, false, inputFile, outputFile);
 		else if(outputType ==SourceType::SPIRV_TEXT)
-			compileLLVMIRToSPIRV(input, tempStream, extendedOptions, true, inputFile, outputFile);
+			compileLLVMIRToSPIRV(sourceInput, tempStream, extendedOptions, true, inputFile, outputFile);
 	}
 	else if(inputType == SourceType::SPIRV_BIN && outputType == SourceType::SPIRV_TEXT)
-		compileSPIRVToSPIRV(input, tempStream, extendedOptions, true, inputFile, outputFile);
+		compileSPIRVToSPIRV(sourceInput, tempStream, extendedOptions, true, inputFile, outputFile);
 	else if(inputType == SourceType::SPIRV_TEXT && outputType== SourceType::SPIRV_BIN)
-		compileSPIRVToSPIRV(input, tempStream, extendedOptions, false, inputFile, outputFile);
+		compileSPIRVToSPIRV(sourceInput, tempStream, extendedOptions, false, inputFile, outputFile);
 	else
 		throw CompilationError(CompilationStep::PRECOMPILATION, "Unhandled pre-compilation");
 
-	logging::info() << "Compilation complete!" << logging::endl;
+	INFO_LOG("Compilation complete!" << logging::endl);
 
+	if(cacheKey)
+		writeCompilationCache(cacheKey.get(), tempStream.str());
 	output.reset(new std::istringstream(tempStream.str()));
 }
@@ -7,19 +7,23 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
 #include <vector>
 #include <sstream>
 #include <sys/wait.h>
-#include <chrono>
-#include <thread>
-#include <sys/select.h>
-#include <sys/time.h>
 
 #include "log.h"
 #include "ProcessUtil.h"
 #include "CompilationError.h"
 #include "Profiler.h"
 
+//the environment of this process, passed on to the child process
+extern char** environ;
+
 using namespace vc4c;
 
 static int STD_IN = 0;
@@ -29,12 +33,15 @@ static int STD_ERR = 2;
 static int READ = 0;
 static int WRITE = 1;
 
-static int BUFFER_SIZE = 1024;
+static constexpr int BUFFER_SIZE = 4096;
 
 static void initPipe(int fds[2])
 {
 	if(pipe(fds) != 0)
 		throw CompilationError(CompilationStep::GENERAL, "Error creating pipe", strerror(errno));
+	//the pipes are duplicated into the standard streams of the child, all other copies are closed on starting the child process
+	if(fcntl(fds[READ], F_SETFD, FD_CLOEXEC) == -1 || fcntl(fds[WRITE], F_SETFD, FD_CLOEXEC) == -1)
+		throw CompilationError(CompilationStep::GENERAL, "Error setting pipe flags", strerror(errno));
 }
 
 static void closePipe(int fd)
@@ -43,10 +50,11 @@ static void closePipe(int fd)
 		throw CompilationError(CompilationStep::GENERAL, "Error closing pipe", strerror(errno));
 }
 
-static void mapPipe(int pipe, int fd)
+static void setNonBlocking(int fd)
 {
-	if(dup2(pipe, fd) == -1)
-		throw CompilationError(CompilationStep::GENERAL, "Error duplicating pipe", strerror(errno));
+	int flags = fcntl(fd, F_GETFL);
+	if(flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+		throw CompilationError(CompilationStep::GENERAL, "Error setting pipe flags", strerror(errno));
 }
 
 static std::vector<std::string> splitString(const std::string& input, const char delimiter)
@@ -60,77 +68,102 @@ static std::vector<std::string> splitString(const std::string& input, const char
     return result;
 }
 
-static void runChild(const std::string& command, int pipes[3][2], bool hasStdIn, bool hasStdOut, bool hasStdErr)
+/*
+ * Starts the given command with the given file descriptors as standard streams, a negative descriptor inherits the stream of this process
+ */
+static pid_t spawnChild(const std::string& command, int stdinFD, int stdoutFD, int stderrFD)
 {
 	//map pipes into stdin/stdout/stderr
-	//close pipes not used by child
-	if(hasStdIn)
-	{
-		mapPipe(pipes[STD_IN][READ], STDIN_FILENO);
-		closePipe(pipes[STD_IN][READ]);
-		closePipe(pipes[STD_IN][WRITE]);
-	}
-	if(hasStdOut)
-	{
-		mapPipe(pipes[STD_OUT][WRITE], STDOUT_FILENO);
-		closePipe(pipes[STD_OUT][READ]);
-		closePipe(pipes[STD_OUT][WRITE]);
-	}
-	if(hasStdErr)
-	{
-		mapPipe(pipes[STD_ERR][WRITE], STDERR_FILENO);
-		closePipe(pipes[STD_ERR][READ]);
-		closePipe(pipes[STD_ERR][WRITE]);
-	}
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if(stdinFD >= 0)
+		posix_spawn_file_actions_adddup2(&actions, stdinFD, STDIN_FILENO);
+	if(stdoutFD >= 0)
+		posix_spawn_file_actions_adddup2(&actions, stdoutFD, STDOUT_FILENO);
+	if(stderrFD >= 0)
+		posix_spawn_file_actions_adddup2(&actions, stderrFD, STDERR_FILENO);
 
 	//split command
 	std::vector<std::string> parts = splitString(command, ' ');
-	const std::string file = parts.at(0);
-	char* args[128];
+	std::vector<char*> args;
+	args.reserve(parts.size() + 1);
 	//man(3) exec: "The first argument, by convention, should point to the filename associated with the file being executed"
-	for(std::size_t i = 0; i < parts.size(); ++i)
+	for(std::string& part : parts)
 	{
-		args[i] = const_cast<char*>(parts.at(i).data());
+		args.push_back(const_cast<char*>(part.data()));
 	}
-	args[parts.size()] = nullptr;
+	args.push_back(nullptr);
 
-	execvp(file.data(), args);
+	/*
+	 * In contrast to fork(), posix_spawn does not copy the page-tables of this (possibly large) process,
+	 * but (at least with glibc) uses vfork-semantics to directly execute the new program
+	 */
+	pid_t pid;
+	int status = posix_spawnp(&pid, parts.at(0).data(), &actions, nullptr, args.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if(status != 0)
+		throw CompilationError(CompilationStep::GENERAL, "Error executing the child process", strerror(status));
+	return pid;
 }
 
-static bool isChildFinished(pid_t pid, int* exitStatus, bool wait = false)
+static int waitForChild(pid_t pid)
 {
 	int status = 0;
-	int result = waitpid(pid, &status, WUNTRACED | (wait ? 0 : WNOHANG));
+	int result;
+	while((result = waitpid(pid, &status, 0)) == -1 && errno == EINTR)
+	{
+		//interrupted by a signal, retry
+	}
 	if(result == -1)
 	{
 		throw CompilationError(CompilationStep::GENERAL, "Error retrieving child process information", strerror(errno));
 	}
-	if(result == 0)
-		//child still running, no changes to status, returned because of WNOHANG
-		return false;
 	//check whether child terminated "normally" having an exit-code or was terminated by a signal
 	if(WIFEXITED(status))
-	{
-		*exitStatus = WEXITSTATUS(status);
-		return true;
-	}
+		return WEXITSTATUS(status);
 	if(WIFSIGNALED(status))
-	{
-		*exitStatus = WTERMSIG(status);
-		return true;
-	}
+		return WTERMSIG(status);
 	throw CompilationError(CompilationStep::GENERAL, "Unhandled case in retrieving child process information", std::to_string(result));
 }
 
+/*
+ * The data read from the input-stream, which is not yet written to the child process
+ */
+struct PendingInput
+{
+	char buffer[BUFFER_SIZE];
+	std::streamsize offset = 0;
+	std::streamsize size = 0;
+
+	/*
+	 * Refills the buffer from the stream, if all data was written. Returns whether there is data left to write
+	 */
+	bool refill(std::istream& in)
+	{
+		if(offset < size)
+			return true;
+		in.read(buffer, BUFFER_SIZE);
+		offset = 0;
+		size = in.gcount();
+		return size > 0;
+	}
+};
+
 int vc4c::runProcess(const std::string& command, std::istream* stdin, std::ostream* stdout, std::ostream* stderr)
+{
+	return runProcesses({command}, stdin, stdout, stderr).front();
+}
+
+std::vector<int> vc4c::runProcesses(const std::vector<std::string>& commands, std::istream* stdin, std::ostream* stdout, std::ostream* stderr)
 {
 	/*
 	 * See:
 	 * https://jineshkj.wordpress.com/2006/12/22/how-to-capture-stdin-stdout-and-stderr-of-child-program/
 	 * https://stackoverflow.com/questions/6171552/popen-simultaneous-read-and-write
-	 * https://www.linuxquestions.org/questions/programming-9/popen-read-and-write-both-how-201083/
-	 * https://stackoverflow.com/questions/29554036/waiting-for-popen-subprocess-to-terminate-before-reading?rq=1
+	 * http://man7.org/linux/man-pages/man3/posix_spawn.3.html
 	 */
+	if(commands.empty())
+		throw CompilationError(CompilationStep::GENERAL, "No process to run");
 
 	int pipes[3][2];
 
@@ -141,111 +174,139 @@ int vc4c::runProcess(const std::string& command, std::istream* stdin, std::ostre
 	if(stderr != nullptr)
 		initPipe(pipes[STD_ERR]);
 
-	pid_t pid = fork();
-	if(pid == 0) //child
+	//the output of every process is directly passed to the input of the next one, all processes write into the same error stream
+	std::vector<pid_t> pids;
+	pids.reserve(commands.size());
+	int previousOutput = stdin != nullptr ? pipes[STD_IN][READ] : -1;
+	for(std::size_t i = 0; i < commands.size(); ++i)
 	{
-		runChild(command, pipes, stdin != nullptr, stdout != nullptr, stderr != nullptr);
-		/*
-		 * Nothing below this line should be executed by child process. If so, it means that the exec function wasn't successful, so lets exit:
-		 */
-		throw CompilationError(CompilationStep::GENERAL, "Error executing the child process", strerror(errno));
+		int connection[2] = {-1, -1};
+		if(i + 1 < commands.size())
+			initPipe(connection);
+		else if(stdout != nullptr)
+			connection[WRITE] = pipes[STD_OUT][WRITE];
+		pids.push_back(spawnChild(commands[i], previousOutput, connection[WRITE], stderr != nullptr ? pipes[STD_ERR][WRITE] : -1));
+		//the connections between the processes are only used by the children
+		if(i > 0)
+			closePipe(previousOutput);
+		if(i + 1 < commands.size())
+			closePipe(connection[WRITE]);
+		previousOutput = connection[READ];
 	}
 
-	char buffer[BUFFER_SIZE];
-	int numBytes = -1;
-	int exitStatus = 0;
-	bool childFinished = false;
-
-	PROFILE_START(WriteToChildProcess);
-	//write to stdin
+	//close the ends of the pipes used by the children, so we see the EOF when the children close their ends
 	if(stdin != nullptr)
-	{
-		std::istream& in = *stdin;
-		while(!(childFinished = childFinished || isChildFinished(pid, &exitStatus)))
-		{
-			in.read(buffer, BUFFER_SIZE);
-			numBytes = in.gcount();
-			write(pipes[STD_IN][WRITE], buffer, in.gcount());
-			if(numBytes != BUFFER_SIZE)
-				break;
-		}
 		closePipe(pipes[STD_IN][READ]);
-		closePipe(pipes[STD_IN][WRITE]);
-	}
-	PROFILE_END(WriteToChildProcess);
-
-	bool stdOutFinished = stdout != nullptr;
-	bool stdErrFinished = stderr != nullptr;
+	if(stdout != nullptr)
+		closePipe(pipes[STD_OUT][WRITE]);
+	if(stderr != nullptr)
+		closePipe(pipes[STD_ERR][WRITE]);
 
-	int highestFD = std::max(pipes[STD_OUT][READ], pipes[STD_ERR][READ]);
-	fd_set readDescriptors;
-	//wait 1ms
-	timeval timeout;
-	timeout.tv_sec = 0;
-	timeout.tv_usec = 1000;
+	/*
+	 * If the first child exits without reading all of its input, writing to its stdin raises SIGPIPE, which would terminate this process.
+	 * So the signal is blocked for this thread (the children are already started and do not inherit the mask) and the error (EPIPE) is handled instead.
+	 */
+	sigset_t pipeSignal;
+	sigset_t previousSignals;
+	sigemptyset(&pipeSignal);
+	sigaddset(&pipeSignal, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipeSignal, &previousSignals);
 
 	/*
-	 * While the child program has not yet finished and the output-streams are not read to the end (EOF, thus the child process has also finished),
-	 * check which output stream has data and read it
+	 * The writing of the input and the reading of the outputs are interleaved in a single loop, waiting for any of the pipes to be ready.
+	 * Otherwise, a child could block on writing to a full output pipe, while we block on writing to the full input pipe.
 	 */
-	PROFILE_START(ReadFromChildProcess);
-	while(!(stdOutFinished && stdErrFinished) || !(childFinished = childFinished || isChildFinished(pid, &exitStatus)))
+	pollfd descriptors[3];
+	for(int i = 0; i < 3; ++i)
 	{
-		FD_ZERO(&readDescriptors);
-		if(stdout != nullptr)
-			FD_SET(pipes[STD_OUT][READ], &readDescriptors);
-		if(stderr != nullptr)
-			FD_SET(pipes[STD_ERR][READ], &readDescriptors);
-		/*
-		 * "Those listed in readfds will be watched to see if characters become available for reading
-		 * [...] On exit, the sets are modified in place to indicate which file descriptors actually changed status."
-		 *
-		 * "nfds is the highest-numbered file descriptor in any of the three sets, plus 1.
-		 *
-		 * "On success, select() and pselect() return the number of file descriptors contained in the three returned descriptor sets
-		 * [...] which may be zero if the timeout expires before anything interesting happens"
-		 */
-		int selectStatus = select(highestFD + 1, &readDescriptors, NULL, NULL, &timeout);
-		if(selectStatus == -1)
-			throw CompilationError(CompilationStep::GENERAL, "Error waiting on child's output streams", strerror(errno));
-		else if(selectStatus != 0)
+		descriptors[i].fd = -1;
+		descriptors[i].events = 0;
+		descriptors[i].revents = 0;
+	}
+	if(stdin != nullptr)
+	{
+		setNonBlocking(pipes[STD_IN][WRITE]);
+		descriptors[STD_IN].fd = pipes[STD_IN][WRITE];
+		descriptors[STD_IN].events = POLLOUT;
+	}
+	if(stdout != nullptr)
+	{
+		descriptors[STD_OUT].fd = pipes[STD_OUT][READ];
+		descriptors[STD_OUT].events = POLLIN;
+	}
+	if(stderr != nullptr)
+	{
+		descriptors[STD_ERR].fd = pipes[STD_ERR][READ];
+		descriptors[STD_ERR].events = POLLIN;
+	}
+	std::ostream* outputs[3] = {nullptr, stdout, stderr};
+
+	PendingInput input;
+	char buffer[BUFFER_SIZE];
+
+	PROFILE_START(CommunicateWithChildProcess);
+	while(descriptors[STD_IN].fd != -1 || descriptors[STD_OUT].fd != -1 || descriptors[STD_ERR].fd != -1)
+	{
+		//"If the value of fd is less than 0, events shall be ignored, and revents shall be set to 0"
+		if(poll(descriptors, 3, -1) == -1)
 		{
-			//something happened
-			if(stdout != nullptr && FD_ISSET(pipes[STD_OUT][READ], &readDescriptors))
+			if(errno == EINTR)
+				continue;
+			throw CompilationError(CompilationStep::GENERAL, "Error waiting on child's streams", strerror(errno));
+		}
+
+		if(descriptors[STD_IN].revents != 0)
+		{
+			bool inputFinished = (descriptors[STD_IN].revents & (POLLERR | POLLHUP)) != 0 || !input.refill(*stdin);
+			if(!inputFinished)
 			{
-				numBytes = read(pipes[STD_OUT][READ], buffer, BUFFER_SIZE);
-				stdout->write(buffer, numBytes);
-				if(numBytes == 0)
-					//EOF
-					stdOutFinished = true;
+				ssize_t numBytes = write(descriptors[STD_IN].fd, input.buffer + input.offset, static_cast<std::size_t>(input.size - input.offset));
+				if(numBytes >= 0)
+					input.offset += numBytes;
+				else if(errno == EPIPE)
+					//child closed its input, the remaining data is discarded
+					inputFinished = true;
+				else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+					throw CompilationError(CompilationStep::GENERAL, "Error writing to child's input stream", strerror(errno));
 			}
-			if(stderr != nullptr && FD_ISSET(pipes[STD_ERR][READ], &readDescriptors))
+			if(inputFinished)
 			{
-				numBytes = read(pipes[STD_ERR][READ], buffer, BUFFER_SIZE);
-				stderr->write(buffer, numBytes);
-				if(numBytes == 0)
-					//EOF
-					stdErrFinished = true;
+				//signals EOF to the child
+				closePipe(descriptors[STD_IN].fd);
+				descriptors[STD_IN].fd = -1;
 			}
 		}
-	}
-	PROFILE_END(ReadFromChildProcess);
 
-	if(stdout != nullptr)
-	{
-		closePipe(pipes[STD_OUT][READ]);
-		closePipe(pipes[STD_OUT][WRITE]);
+		for(int i : {STD_OUT, STD_ERR})
+		{
+			if(descriptors[i].fd == -1 || descriptors[i].revents == 0)
+				continue;
+			ssize_t numBytes = read(descriptors[i].fd, buffer, BUFFER_SIZE);
+			if(numBytes > 0)
+				outputs[i]->write(buffer, numBytes);
+			else if(numBytes == 0 || errno != EINTR)
+			{
+				//EOF, the child has closed the stream (e.g. by exiting)
+				closePipe(descriptors[i].fd);
+				descriptors[i].fd = -1;
+			}
+		}
 	}
+	PROFILE_END(CommunicateWithChildProcess);
 
-	if(stderr != nullptr)
+	//consume a SIGPIPE raised by writing to the closed input of the child, before restoring the signal mask
+	const timespec noWait{0, 0};
+	while(sigtimedwait(&pipeSignal, nullptr, &noWait) == SIGPIPE)
 	{
-		closePipe(pipes[STD_ERR][READ]);
-		closePipe(pipes[STD_ERR][WRITE]);
+		//discard signal
 	}
+	pthread_sigmask(SIG_SETMASK, &previousSignals, nullptr);
 
-	if(!childFinished)
-	{
-		PROFILE(isChildFinished, pid, &exitStatus, true);
-	}
+	PROFILE_START(WaitForChildProcess);
+	std::vector<int> exitStatus;
+	exitStatus.reserve(pids.size());
+	for(const pid_t pid : pids)
+		exitStatus.push_back(waitForChild(pid));
+	PROFILE_END(WaitForChildProcess);
 	return exitStatus;
 }
@@ -9,11 +9,22 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace vc4c
 {
 	int runProcess(const std::string& command, std::istream* stdin = nullptr, std::ostream* stdout = nullptr, std::ostream* stderr = nullptr);
 
+	/*
+	 * Runs the given commands as a pipeline, the output of every process is the input of the next one.
+	 *
+	 * The input-stream is passed to the first process and the output-stream receives the output of the last process,
+	 * the error-stream receives the errors of all processes. All processes run at the same time, the intermediate data is never buffered by this process.
+	 *
+	 * Returns the exit status of every process
+	 */
+	std::vector<int> runProcesses(const std::vector<std::string>& commands, std::istream* stdin = nullptr, std::ostream* stdout = nullptr, std::ostream* stderr = nullptr);
+
 } /* namespace vc4c */
 
 #endif /* PROCESSUTIL_H */
@@ -5,20 +5,41 @@
  */
 
 #include "Profiler.h"
+#include "ThreadPool.h"
 #include "log.h"
 
-#include <chrono>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fstream>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <vector>
 #include <iomanip>
-#ifdef MULTI_THREADED
 #include <mutex>
-#endif
+#include <unistd.h>
 
 using namespace vc4c;
 
-using Clock = std::chrono::system_clock;
-using Duration = std::chrono::microseconds;
+using Clock = profiler::Clock;
+using Duration = profiler::Duration;
+static constexpr std::size_t INVALID_ID = profiler::INVALID_ID;
+
+//the maximum number of timers and counters, the samples of any additional ones are dropped
+static constexpr std::size_t MAX_ENTRIES = 1024;
+
+struct Registration
+{
+	std::string name;
+	std::string fileName;
+	std::size_t lineNumber;
+	bool isCounter;
+	bool isMaximum;
+	//the user-defined index of the counter
+	std::size_t index;
+	std::size_t prevCounter;
+};
 
 struct Entry
 {
@@ -54,40 +75,344 @@ struct Counter
 	}
 };
 
-static std::map<std::string, Entry> times;
-static std::map<std::size_t, Counter> counters;
+/*
+ * A single timed span, the times are relative to the start of the process (see Registry#epoch)
+ */
+struct Span
+{
+	std::size_t id;
+	int64_t start;
+	int64_t duration;
+	std::size_t thread;
+	std::string context;
+};
+
+struct ThreadSamples;
+
+/*
+ * The registered timers and counters and the samples of all threads.
+ *
+ * Allocated once and never freed, so threads exiting after the static destructors have run can still merge their samples
+ */
+struct Registry
+{
 #ifdef MULTI_THREADED
-static std::mutex lockTimes;
-static std::mutex lockCounters;
+	std::mutex lock;
+	threading::LockStatistics lockStatistics{"Profiler::registry"};
 #endif
+	std::vector<Registration> entries;
+	std::map<std::string, std::size_t> timerIds;
+	std::map<std::size_t, std::size_t> counterIds;
+	std::map<std::string, std::size_t> maximumIds;
+	std::set<ThreadSamples*> threads;
+	//the samples of the threads already finished
+	std::array<int64_t, MAX_ENTRIES> retiredValues;
+	std::array<uint64_t, MAX_ENTRIES> retiredInvocations;
+	//the spans of the threads already finished
+	std::vector<Span> retiredSpans;
+	std::size_t numThreads;
+	const Clock::time_point epoch;
+	std::string traceFile;
+
+	Registry() : numThreads(0), epoch(Clock::now())
+	{
+		retiredValues.fill(0);
+		retiredInvocations.fill(0);
+	}
+};
+
+static Registry& getRegistry()
+{
+	static Registry* registry = new Registry();
+	return *registry;
+}
+
+/*
+ * The samples of a single thread. The values are only written by the owning thread, so no atomic read-modify-write operations are required,
+ * the atomics only guarantee consistent values when merging the samples from another thread.
+ */
+struct ThreadSamples
+{
+	//the duration (in nanoseconds) for timers, the sum of the values for counters
+	std::array<std::atomic<int64_t>, MAX_ENTRIES> values;
+	std::array<std::atomic<uint64_t>, MAX_ENTRIES> invocations;
+	//caches the ids looked up by this thread, to not lock the registry
+	std::unordered_map<std::string, std::size_t> timerIds;
+	std::unordered_map<std::size_t, std::size_t> counterIds;
+	std::unordered_map<std::string, std::size_t> maximumIds;
+	//the sequential id of this thread in the trace
+	std::size_t threadId;
+	std::string context;
+	//only locked by the owning thread while tracing, so it is not contended except while writing the trace
+	std::mutex spanLock;
+	std::vector<Span> spans;
+
+	ThreadSamples()
+	{
+		for(std::size_t i = 0; i < MAX_ENTRIES; ++i)
+		{
+			values[i].store(0, std::memory_order_relaxed);
+			invocations[i].store(0, std::memory_order_relaxed);
+		}
+		Registry& registry = getRegistry();
+#ifdef MULTI_THREADED
+		const auto guard = threading::lockMeasured(registry.lock, registry.lockStatistics);
+#endif
+		registry.threads.insert(this);
+		threadId = registry.numThreads++;
+	}
+
+	~ThreadSamples()
+	{
+		Registry& registry = getRegistry();
+#ifdef MULTI_THREADED
+		const auto guard = threading::lockMeasured(registry.lock, registry.lockStatistics);
+#endif
+		for(std::size_t i = 0; i < MAX_ENTRIES; ++i)
+		{
+			if(i < registry.entries.size() && registry.entries[i].isMaximum)
+				registry.retiredValues[i] = std::max(registry.retiredValues[i], values[i].load(std::memory_order_relaxed));
+			else
+				registry.retiredValues[i] += values[i].load(std::memory_order_relaxed);
+			registry.retiredInvocations[i] += invocations[i].load(std::memory_order_relaxed);
+		}
+		{
+			std::lock_guard<std::mutex> spanGuard(spanLock);
+			registry.retiredSpans.insert(registry.retiredSpans.end(), spans.begin(), spans.end());
+		}
+		registry.threads.erase(this);
+	}
+
+	void updateMaximum(const std::size_t id, const int64_t value)
+	{
+		if(value > values[id].load(std::memory_order_relaxed))
+			values[id].store(value, std::memory_order_relaxed);
+		invocations[id].store(invocations[id].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	void add(const std::size_t id, const int64_t value)
+	{
+		values[id].store(values[id].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		invocations[id].store(invocations[id].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+};
+
+static thread_local ThreadSamples samples;
+
+static bool isEnabledByDefault()
+{
+#if DEBUG_MODE
+	return true;
+#else
+	const char* flag = std::getenv("VC4C_PROFILE");
+	return flag != nullptr && flag[0] != '\0' && flag[0] != '0';
+#endif
+}
+
+static std::string getDefaultTraceFile()
+{
+	const char* file = std::getenv("VC4C_TRACE_FILE");
+	return file != nullptr ? file : "";
+}
+
+static void writeTraceFile()
+{
+	const std::string& fileName = getRegistry().traceFile;
+	std::ofstream file(fileName, std::ios_base::out | std::ios_base::trunc);
+	profiler::writeTrace(file);
+	if(!file)
+		logging::warn() << "Failed to write compilation trace to: " << fileName << logging::endl;
+}
+
+static bool initializeTracing()
+{
+	const std::string fileName = getDefaultTraceFile();
+	if(fileName.empty())
+		return false;
+	getRegistry().traceFile = fileName;
+	std::atexit(writeTraceFile);
+	return true;
+}
+
+std::atomic<bool> profiler::tracingEnabled{initializeTracing()};
+std::atomic<bool> profiler::profilingEnabled{isEnabledByDefault() || tracingEnabled.load()};
+
+void profiler::setEnabled(bool enabled)
+{
+	profilingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+static std::size_t registerEntry(Registry& registry, Registration&& registration)
+{
+	if(registry.entries.size() >= MAX_ENTRIES)
+	{
+		static bool warned = false;
+		if(!warned)
+			logging::warn() << "Too many profiling entries, dropping samples for: " << registration.name << logging::endl;
+		warned = true;
+		return INVALID_ID;
+	}
+	registry.entries.emplace_back(std::move(registration));
+	return registry.entries.size() - 1;
+}
+
+std::size_t profiler::registerTimer(const std::string& name, const std::string& file, const std::size_t line)
+{
+	auto it = samples.timerIds.find(name);
+	if(it != samples.timerIds.end())
+		return it->second;
+	Registry& registry = getRegistry();
+	std::size_t id = INVALID_ID;
+	{
+#ifdef MULTI_THREADED
+		const auto guard = threading::lockMeasured(registry.lock, registry.lockStatistics);
+#endif
+		auto regIt = registry.timerIds.find(name);
+		if(regIt != registry.timerIds.end())
+			id = regIt->second;
+		else
+		{
+			id = registerEntry(registry, Registration{name, file, line, false, false, 0, SIZE_MAX});
+			if(id != INVALID_ID)
+				registry.timerIds.emplace(name, id);
+		}
+	}
+	samples.timerIds.emplace(name, id);
+	return id;
+}
 
 void profiler::endFunctionCall(const ProfilingResult& result)
 {
+	if(result.id == INVALID_ID)
+		return;
+	const Clock::time_point end = Clock::now();
+	const int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - result.startTime).count();
+	samples.add(result.id, duration);
+	if(isTracing())
+	{
+		const int64_t start = std::chrono::duration_cast<std::chrono::nanoseconds>(result.startTime - getRegistry().epoch).count();
+		std::lock_guard<std::mutex> guard(samples.spanLock);
+		samples.spans.emplace_back(Span{result.id, start, duration, samples.threadId, samples.context});
+	}
+}
+
+void profiler::setTraceFile(const std::string& fileName)
+{
+	Registry& registry = getRegistry();
+	{
+#ifdef MULTI_THREADED
+		const auto guard = threading::lockMeasured(registry.lock, registry.lockStatistics);
+#endif
+		if(registry.traceFile.empty())
+			std::atexit(writeTraceFile);
+		registry.traceFile = fileName;
+	}
+	tracingEnabled.store(true, std::memory_order_relaxed);
+	setEnabled(true);
+}
+
+static std::string escapeJSON(const std::string& text)
+{
+	std::string escaped;
+	escaped.reserve(text.size());
+	for(const char c : text)
+	{
+		if(c == '"' || c == '\\')
+			escaped.push_back('\\');
+		if(static_cast<unsigned char>(c) < 0x20)
+			continue;
+		escaped.push_back(c);
+	}
+	return escaped;
+}
+
+static void writeSpan(std::ostream& stream, const Span& span, const Registration& registration, bool isFirst)
+{
+	//the trace-event format uses microseconds
+	stream << (isFirst ? "\n" : ",\n") << "  {\"name\": \"" << escapeJSON(registration.name) << "\", \"cat\": \"vc4c\", \"ph\": \"X\", \"ts\": "
+			<< (span.start / 1000) << '.' << std::setfill('0') << std::setw(3) << (span.start % 1000) << ", \"dur\": " << (span.duration / 1000) << '.'
+			<< std::setw(3) << (span.duration % 1000) << std::setfill(' ') << ", \"pid\": " << getpid() << ", \"tid\": " << span.thread << ", \"args\": {\"location\": \""
+			<< escapeJSON(registration.fileName) << '#' << registration.lineNumber << '"';
+	if(!span.context.empty())
+		stream << ", \"context\": \"" << escapeJSON(span.context) << '"';
+	stream << "}}";
+}
+
+void profiler::writeTrace(std::ostream& stream)
+{
+	Registry& registry = getRegistry();
 #ifdef MULTI_THREADED
-	std::lock_guard<std::mutex> guard(lockTimes);
+	const auto guard = threading::lockMeasured(registry.lock, registry.lockStatistics);
 #endif
-	times[result.name].name = result.name;
-	times[result.name].duration += std::chrono::duration_cast<Duration>(Clock::now() - result.startTime);
-	times[result.name].invocations += 1;
-	times[result.name].fileName = result.fileName;
-	times[result.name].lineNumber = result.lineNumber;
+	bool isFirst = true;
+	stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	for(const Span& span : registry.retiredSpans)
+	{
+		writeSpan(stream, span, registry.entries.at(span.id), isFirst);
+		isFirst = false;
+	}
+	for(ThreadSamples* thread : registry.threads)
+	{
+		std::lock_guard<std::mutex> spanGuard(thread->spanLock);
+		for(const Span& span : thread->spans)
+		{
+			writeSpan(stream, span, registry.entries.at(span.id), isFirst);
+			isFirst = false;
+		}
+	}
+	stream << "\n]}\n";
+	stream.flush();
+}
+
+profiler::TraceContext::TraceContext(const std::string& context) : previousContext(std::move(samples.context))
+{
+	samples.context = context;
+}
+
+profiler::TraceContext::~TraceContext()
+{
+	samples.context = std::move(previousContext);
 }
 
 void profiler::dumpProfileResults(bool writeAsWarning)
 {
+	Registry& registry = getRegistry();
 #ifdef MULTI_THREADED
-	std::lock_guard<std::mutex> guard(lockTimes);
+	const auto guard = threading::lockMeasured(registry.lock, registry.lockStatistics);
 #endif
-	std::set<Entry> entries;
-	std::set<Counter> counts;
-	for(auto& entry : times)
+	//merge the samples of all threads
+	std::vector<int64_t> values(registry.retiredValues.begin(), registry.retiredValues.begin() + registry.entries.size());
+	std::vector<uint64_t> invocations(registry.retiredInvocations.begin(), registry.retiredInvocations.begin() + registry.entries.size());
+	for(const ThreadSamples* thread : registry.threads)
 	{
-		entry.second.name = entry.first;
-		entries.emplace(entry.second);
+		for(std::size_t i = 0; i < registry.entries.size(); ++i)
+		{
+			if(registry.entries[i].isMaximum)
+				values[i] = std::max(values[i], thread->values[i].load(std::memory_order_relaxed));
+			else
+				values[i] += thread->values[i].load(std::memory_order_relaxed);
+			invocations[i] += thread->invocations[i].load(std::memory_order_relaxed);
+		}
 	}
-	for(const auto& count : counters)
+
+	std::set<Entry> entries;
+	std::set<Counter> counts;
+	std::map<std::string, int64_t> maximums;
+	std::map<std::size_t, long> countsByIndex;
+	for(std::size_t i = 0; i < registry.entries.size(); ++i)
 	{
-		counts.emplace(count.second);
+		const Registration& reg = registry.entries[i];
+		if(invocations[i] == 0)
+			continue;
+		if(reg.isMaximum)
+			maximums[reg.name] = values[i];
+		else if(reg.isCounter)
+		{
+			counts.emplace(Counter{reg.name, static_cast<long>(values[i]), reg.index, static_cast<std::size_t>(invocations[i]), reg.prevCounter, reg.fileName, reg.lineNumber});
+			countsByIndex[reg.index] = static_cast<long>(values[i]);
+		}
+		else
+			entries.emplace(Entry{reg.name, std::chrono::duration_cast<Duration>(std::chrono::nanoseconds(values[i])), static_cast<std::size_t>(invocations[i]), reg.fileName, reg.lineNumber});
 	}
 
 	(writeAsWarning ? logging::warn() : logging::info()) << logging::endl;
@@ -104,25 +429,76 @@ void profiler::dumpProfileResults(bool writeAsWarning)
 	(writeAsWarning ? logging::warn() : logging::info()) << "Profiling results for " << counts.size() << " counters:" << logging::endl;
 	for(const Counter& counter : counts)
 	{
+		const bool hasPrev = counter.prevCounter != SIZE_MAX && countsByIndex.find(counter.prevCounter) != countsByIndex.end();
+		const long prevCount = hasPrev ? countsByIndex.at(counter.prevCounter) : 0;
 		(writeAsWarning ? logging::warn() : logging::info()) << std::setw(40) << counter.name << std::setw(7) << counter.count << " counts"
-				<< std::setw(5) << counter.invocations << " calls" << std::setw(6) << counter.count / counter.invocations << " avg./call"
-				<< std::setw(8) << (counter.prevCounter == SIZE_MAX ? "" : "diff")
-				<< std::setw(7) << std::showpos << (counter.prevCounter == SIZE_MAX ? 0 : counter.count - counters[counter.prevCounter].count) << " ("
-				<< std::setw(5) << std::showpos << (counter.prevCounter == SIZE_MAX ? 0 : (int)(100*(-1.0 + (double)counter.count / (double)counters[counter.prevCounter].count)))
+				<< std::setw(5) << counter.invocations << " calls" << std::setw(6) << counter.count / static_cast<long>(counter.invocations) << " avg./call"
+				<< std::setw(8) << (hasPrev ? "diff" : "")
+				<< std::setw(7) << std::showpos << (hasPrev ? counter.count - prevCount : 0) << " ("
+				<< std::setw(5) << std::showpos << (hasPrev && prevCount != 0 ? (int)(100*(-1.0 + (double)counter.count / (double)prevCount)) : 0)
 				<< std::noshowpos << "%)" << std::setw(64) << counter.fileName << "#" << counter.lineNumber << logging::endl;
 	}
+
+	(writeAsWarning ? logging::warn() : logging::info()) << logging::endl;
+	(writeAsWarning ? logging::warn() : logging::info()) << "Profiling results for " << maximums.size() << " maximums:" << logging::endl;
+	for(const auto& maximum : maximums)
+		(writeAsWarning ? logging::warn() : logging::info()) << std::setw(60) << maximum.first << std::setw(14) << maximum.second << logging::endl;
 }
 
 void profiler::increaseCounter(const std::size_t index, const std::string& name, const std::size_t value, const std::string& file, const std::size_t line, const std::size_t prevIndex)
 {
+	std::size_t id = INVALID_ID;
+	auto it = samples.counterIds.find(index);
+	if(it != samples.counterIds.end())
+		id = it->second;
+	else
+	{
+		Registry& registry = getRegistry();
+		{
 #ifdef MULTI_THREADED
-	std::lock_guard<std::mutex> guard(lockCounters);
+			const auto guard = threading::lockMeasured(registry.lock, registry.lockStatistics);
 #endif
-	counters[index].index = index;
-	counters[index].name = name;
-	counters[index].count += value;
-	counters[index].invocations += 1;
-	counters[index].prevCounter = prevIndex;
-	counters[index].fileName = file;
-	counters[index].lineNumber = line;
+			auto regIt = registry.counterIds.find(index);
+			if(regIt != registry.counterIds.end())
+				id = regIt->second;
+			else
+			{
+				id = registerEntry(registry, Registration{name, file, line, true, false, index, prevIndex});
+				if(id != INVALID_ID)
+					registry.counterIds.emplace(index, id);
+			}
+		}
+		samples.counterIds.emplace(index, id);
+	}
+	if(id != INVALID_ID)
+		samples.add(id, static_cast<int64_t>(value));
+}
+
+void profiler::updateMaximum(const std::string& name, const std::size_t value, const std::string& file, const std::size_t line)
+{
+	std::size_t id = INVALID_ID;
+	auto it = samples.maximumIds.find(name);
+	if(it != samples.maximumIds.end())
+		id = it->second;
+	else
+	{
+		Registry& registry = getRegistry();
+		{
+#ifdef MULTI_THREADED
+			const auto guard = threading::lockMeasured(registry.lock, registry.lockStatistics);
+#endif
+			auto regIt = registry.maximumIds.find(name);
+			if(regIt != registry.maximumIds.end())
+				id = regIt->second;
+			else
+			{
+				id = registerEntry(registry, Registration{name, file, line, false, true, 0, SIZE_MAX});
+				if(id != INVALID_ID)
+					registry.maximumIds.emplace(name, id);
+			}
+		}
+		samples.maximumIds.emplace(name, id);
+	}
+	if(id != INVALID_ID)
+		samples.updateMaximum(id, static_cast<int64_t>(value));
 }
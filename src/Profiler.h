@@ -7,59 +7,120 @@
 #ifndef PROFILER_H_
 #define PROFILER_H_
 
+#include <atomic>
 #include <string>
 #include <chrono>
+#include <ostream>
 
 namespace vc4c
 {
-#if DEBUG_MODE
+/*
+ * The profiling is available in all builds and switched on at run-time (see profiler#setEnabled), when disabled every macro only checks the switch.
+ *
+ * Functions and blocks with a static name are registered once per call-site, the samples are accumulated in thread-local counters and only merged
+ * when the results are dumped.
+ */
 #define PROFILE(func, ...) \
-		profiler::ProfilingResult profile##func{#func, __FILE__, __LINE__, profiler::Clock::now()}; \
+		static const std::size_t profileId##func = profiler::registerTimer(#func, __FILE__, __LINE__); \
+		profiler::ProfilingResult profile##func = profiler::startTimer(profileId##func); \
 		func(__VA_ARGS__); \
 		profiler::endFunctionCall(profile##func)
 
-#define PROFILE_START(name) profiler::ProfilingResult profile##name{#name, __FILE__, __LINE__, profiler::Clock::now()}
+#define PROFILE_START(name) \
+		static const std::size_t profileId##name = profiler::registerTimer(#name, __FILE__, __LINE__); \
+		profiler::ProfilingResult profile##name = profiler::startTimer(profileId##name)
 #define PROFILE_END(name) profiler::endFunctionCall(profile##name)
 
-#define PROFILE_START_DYNAMIC(name) profiler::ProfilingResult profile{name, __FILE__, __LINE__, profiler::Clock::now()}
+#define PROFILE_START_DYNAMIC(name) profiler::ProfilingResult profile = profiler::startTimer(profiler::isEnabled() ? profiler::registerTimer(name, __FILE__, __LINE__) : profiler::INVALID_ID)
 #define PROFILE_END_DYNAMIC(name) profiler::endFunctionCall(profile)
 
-#define PROFILE_COUNTER(index, name, value) profiler::increaseCounter(index, name, value, __FILE__, __LINE__)
-#define PROFILE_COUNTER_WITH_PREV(index, name, value, prevIndex) profiler::increaseCounter(index, name, value, __FILE__, __LINE__, prevIndex)
-
-#define PROFILE_RESULTS() profiler::dumpProfileResults();
-#else
-#define PROFILE(func, ...) func(__VA_ARGS__)
-
-#define PROFILE_START(name)
-#define PROFILE_END(name)
-
-#define PROFILE_START_DYNAMIC(name)
-#define PROFILE_END_DYNAMIC(name)
+//the name and value are only evaluated if the profiling is enabled
+#define PROFILE_COUNTER(index, name, value) do { if(profiler::isEnabled()) profiler::increaseCounter(index, name, value, __FILE__, __LINE__); } while(false)
+#define PROFILE_COUNTER_WITH_PREV(index, name, value, prevIndex) do { if(profiler::isEnabled()) profiler::increaseCounter(index, name, value, __FILE__, __LINE__, prevIndex); } while(false)
 
-#define PROFILE_COUNTER(index, name, value)
-#define PROFILE_COUNTER_WITH_PREV(index, name, value, prevIndex)
+//records the maximum of all values given for the name, e.g. for memory usage
+#define PROFILE_MAXIMUM(name, value) do { if(profiler::isEnabled()) profiler::updateMaximum(name, value, __FILE__, __LINE__); } while(false)
 
-#define PROFILE_RESULTS()
-#endif
+#define PROFILE_RESULTS() do { if(profiler::isEnabled()) profiler::dumpProfileResults(true); } while(false)
 
 	namespace profiler
 	{
-		using Clock = std::chrono::system_clock;
+		using Clock = std::chrono::steady_clock;
 		using Duration = std::chrono::microseconds;
 
+		//the id of a timer not recorded, e.g. if the profiling is disabled
+		constexpr std::size_t INVALID_ID = SIZE_MAX;
+
 		struct ProfilingResult
 		{
-			std::string name;
-			std::string fileName;
-			std::size_t lineNumber;
+			std::size_t id;
 			Clock::time_point startTime;
 		};
 
+		//the run-time switch, defaults to enabled for debug builds or if the environment variable VC4C_PROFILE is set
+		extern std::atomic<bool> profilingEnabled;
+
+		inline bool isEnabled()
+		{
+			return profilingEnabled.load(std::memory_order_relaxed);
+		}
+
+		void setEnabled(bool enabled);
+
+		/*
+		 * Returns the id of the timer with the given name, registering it on the first call
+		 */
+		std::size_t registerTimer(const std::string& name, const std::string& file, const std::size_t line);
+
+		inline ProfilingResult startTimer(const std::size_t id)
+		{
+			if(id == INVALID_ID || !isEnabled())
+				return ProfilingResult{INVALID_ID, Clock::time_point{}};
+			return ProfilingResult{id, Clock::now()};
+		}
+
 		void endFunctionCall(const ProfilingResult& result);
 
 		void dumpProfileResults(bool writeAsWarning = false);
 
+		/*
+		 * Records every timed span with its thread and timestamps and writes them as Chrome trace-event JSON (loadable in chrome://tracing or Perfetto)
+		 * into the given file at process exit. Also enables the profiling.
+		 *
+		 * Defaults to the file given in the environment variable VC4C_TRACE_FILE
+		 */
+		void setTraceFile(const std::string& fileName);
+
+		extern std::atomic<bool> tracingEnabled;
+
+		inline bool isTracing()
+		{
+			return tracingEnabled.load(std::memory_order_relaxed);
+		}
+
+		/*
+		 * Writes all spans recorded so far as Chrome trace-event JSON
+		 */
+		void writeTrace(std::ostream& stream);
+
+		/*
+		 * Sets the context (e.g. the kernel being compiled) recorded with the spans of the current thread for the life-time of this object
+		 */
+		class TraceContext
+		{
+		public:
+			explicit TraceContext(const std::string& context);
+			~TraceContext();
+
+			TraceContext(const TraceContext&) = delete;
+			TraceContext& operator=(const TraceContext&) = delete;
+
+		private:
+			std::string previousContext;
+		};
+
+		void updateMaximum(const std::string& name, const std::size_t value, const std::string& file, const std::size_t line);
+
 		void increaseCounter(const std::size_t index, const std::string& name, const std::size_t value, const std::string& file, const std::size_t line, const std::size_t prevIndex = SIZE_MAX);
 	}
 }
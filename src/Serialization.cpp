@@ -0,0 +1,954 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Serialization.h"
+
+#include "intermediate/IntermediateInstruction.h"
+#include "Logging.h"
+#include "MemoryStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+using namespace vc4c;
+using namespace vc4c::intermediate;
+
+//"VC4CIR" + version of the format
+static constexpr uint64_t SERIALIZATION_MAGIC_NUMBER = 0x5249433443564ULL;
+static constexpr uint32_t SERIALIZATION_VERSION = 2;
+
+enum class ComplexTypeTag : uint8_t
+{
+	NONE = 0,
+	//a complex type already written before, followed by its index
+	REFERENCE = 1,
+	POINTER = 2,
+	STRUCT = 3,
+	ARRAY = 4,
+	IMAGE = 5
+};
+
+//the id of the local referenced by a local without any reference
+static constexpr uint32_t NO_LOCAL = 0xFFFFFFFF;
+
+class ModuleWriter
+{
+public:
+	/*
+	 * If the shared types are given, the complex types are not written, but appended to the shared types and only referenced by their index
+	 */
+	explicit ModuleWriter(std::ostream& output, std::vector<std::shared_ptr<ComplexType>>* sharedTypes = nullptr) : output(output), sharedTypes(sharedTypes)
+	{
+	}
+
+	/*
+	 * If set, the locals of the methods (except the parameters) are written without their names
+	 */
+	bool anonymizeLocals = false;
+
+	void writeModule(const Module& module)
+	{
+		writeHeader();
+		writeGlobals(module);
+		writeInt(static_cast<uint32_t>(module.methods.size()));
+		for(const auto& method : module.methods)
+			writeMethod(*method);
+	}
+
+	void writeHeader()
+	{
+		writeInt(SERIALIZATION_MAGIC_NUMBER);
+		writeInt(SERIALIZATION_VERSION);
+		writeString(VC4C_VERSION);
+		writeInt(static_cast<uint64_t>(Method::getTemporaryNameCounter()));
+	}
+
+	void writeGlobals(const Module& module)
+	{
+		std::vector<const Local*> globals;
+		for(const Global& global : module.globalData)
+			globals.push_back(&global);
+		writeInt(static_cast<uint32_t>(globals.size()));
+		for(const Local* global : globals)
+		{
+			writeString(global->name);
+			writeType(global->type);
+			addLocal(global);
+		}
+		//the values can reference other globals
+		for(const Global& global : module.globalData)
+			writeValue(global.value);
+		writeReferences(globals);
+		numGlobals = localIds.size();
+	}
+
+	/*
+	 * Writes only the global data used by the method (directly, via the references of its locals or via the initial values of other used globals)
+	 */
+	void writeReferencedGlobals(const Method& method)
+	{
+		std::vector<const Local*> globals;
+		const auto collect = [this, &globals](const Value& value) -> void
+		{
+			collectGlobals(value, globals);
+		};
+		method.forAllInstructions([&collect](const IntermediateInstruction* instr) -> void
+		{
+			if(instr->getOutput())
+				collect(instr->getOutput().get());
+			for(const Value& arg : instr->getArguments())
+				collect(arg);
+		});
+		for(const std::unique_ptr<Local>& local : method.readLocals())
+			collectGlobals(local.get(), globals);
+		for(const Parameter& param : method.parameters)
+			collectGlobals(&param, globals);
+
+		writeInt(static_cast<uint32_t>(globals.size()));
+		for(const Local* global : globals)
+		{
+			writeString(global->name);
+			writeType(global->type);
+		}
+		for(const Local* global : globals)
+			writeValue(global->as<Global>()->value);
+		writeReferences(globals);
+		numGlobals = localIds.size();
+	}
+
+	void writeMethod(const Method& method)
+	{
+		//the locals of the previous method are not visible anymore
+		for(std::size_t i = numGlobals; i < localsById.size(); ++i)
+			localIds.erase(localsById[i]);
+		localsById.resize(numGlobals);
+
+		writeInt(static_cast<uint8_t>(method.isKernel));
+		writeString(method.name);
+		writeType(method.returnType);
+		writeInt(static_cast<uint32_t>(method.metaData.size()));
+		for(const auto& pair : method.metaData)
+		{
+			writeInt(static_cast<uint8_t>(pair.first));
+			writeInt(static_cast<uint32_t>(pair.second.size()));
+			for(const std::string& s : pair.second)
+				writeString(s);
+		}
+
+		std::vector<const Local*> locals;
+		writeInt(static_cast<uint32_t>(method.parameters.size()));
+		for(const Parameter& param : method.parameters)
+		{
+			writeString(param.name);
+			writeType(param.type);
+			writeInt(static_cast<uint32_t>(param.decorations));
+			writeInt(static_cast<uint64_t>(param.maxByteOffset));
+			writeString(param.parameterName);
+			addLocal(&param);
+			locals.push_back(&param);
+		}
+		writeInt(static_cast<uint32_t>(method.readLocals().size()));
+		for(const std::unique_ptr<Local>& local : method.readLocals())
+		{
+			writeString(anonymizeLocals ? std::string{} : local->name);
+			writeType(local->type);
+			addLocal(local.get());
+			locals.push_back(local.get());
+		}
+		writeReferences(locals);
+
+		writeInt(static_cast<uint64_t>(method.countInstructions()));
+		method.forAllInstructions([this](const IntermediateInstruction* instr) -> void
+		{
+			writeInstruction(instr);
+		});
+	}
+
+private:
+	std::ostream& output;
+	std::vector<std::shared_ptr<ComplexType>>* sharedTypes;
+	FastMap<const ComplexType*, uint32_t> complexTypes;
+	//the complex types currently being written, to detect recursive types
+	FastSet<const ComplexType*> writingTypes;
+	FastMap<const Local*, uint32_t> localIds;
+	std::vector<const Local*> localsById;
+	std::size_t numGlobals = 0;
+
+	template<typename T>
+	void writeInt(const T val)
+	{
+		output.write(reinterpret_cast<const char*>(&val), sizeof(T));
+	}
+
+	void writeString(const std::string& s)
+	{
+		writeInt(static_cast<uint32_t>(s.size()));
+		output.write(s.data(), static_cast<std::streamsize>(s.size()));
+	}
+
+	void addLocal(const Local* local)
+	{
+		localIds.emplace(local, static_cast<uint32_t>(localsById.size()));
+		localsById.push_back(local);
+	}
+
+	/*
+	 * Adds the global data referenced by the value (and by the globals referenced) to the given list, which are not yet added
+	 */
+	void collectGlobals(const Value& value, std::vector<const Local*>& globals)
+	{
+		if(value.hasType(ValueType::LOCAL))
+			collectGlobals(value.local, globals);
+		else if(value.hasType(ValueType::CONTAINER))
+		{
+			for(const Value& element : value.container.elements)
+				collectGlobals(element, globals);
+		}
+	}
+
+	void collectGlobals(const Local* local, std::vector<const Local*>& globals)
+	{
+		//follow the chain of references (e.g. a pointer into a global) up to the referenced global
+		FastSet<const Local*> visited;
+		while(local != nullptr && localIds.find(local) == localIds.end() && visited.emplace(local).second)
+		{
+			if(const Global* global = local->as<Global>())
+			{
+				addLocal(global);
+				globals.push_back(global);
+				//the initial values of globals can reference other globals
+				collectGlobals(global->value, globals);
+			}
+			local = local->reference.first;
+		}
+	}
+
+	void writeLocalId(const Local* local)
+	{
+		auto it = localIds.find(local);
+		if(it == localIds.end())
+			throw CompilationError(CompilationStep::GENERAL, "Can't serialize reference to local not defined in the method", local->name);
+		writeInt(it->second);
+	}
+
+	void writeReferences(const std::vector<const Local*>& locals)
+	{
+		for(const Local* local : locals)
+		{
+			if(local->reference.first == nullptr)
+				writeInt(NO_LOCAL);
+			else
+				writeLocalId(local->reference.first);
+			writeInt(static_cast<int32_t>(local->reference.second));
+		}
+	}
+
+	void writeType(const DataType& type)
+	{
+		writeString(type.typeName);
+		writeInt(type.num);
+		const ComplexType* complex = type.complexType.get();
+		if(complex == nullptr)
+		{
+			writeInt(static_cast<uint8_t>(ComplexTypeTag::NONE));
+			return;
+		}
+		auto it = complexTypes.find(complex);
+		if(it == complexTypes.end() && sharedTypes != nullptr)
+		{
+			//the types are immutable after parsing, so they can be used by several modules
+			it = complexTypes.emplace(complex, static_cast<uint32_t>(sharedTypes->size())).first;
+			sharedTypes->push_back(type.complexType);
+		}
+		if(it != complexTypes.end())
+		{
+			writeInt(static_cast<uint8_t>(ComplexTypeTag::REFERENCE));
+			writeInt(it->second);
+			return;
+		}
+		if(!writingTypes.emplace(complex).second)
+			throw CompilationError(CompilationStep::GENERAL, "Can't serialize recursive type", type.to_string());
+		if(const PointerType* ptr = dynamic_cast<const PointerType*>(complex))
+		{
+			writeInt(static_cast<uint8_t>(ComplexTypeTag::POINTER));
+			writeType(ptr->elementType);
+			writeInt(static_cast<uint8_t>(ptr->addressSpace));
+			writeInt(static_cast<uint32_t>(ptr->alignment));
+		}
+		else if(const StructType* str = dynamic_cast<const StructType*>(complex))
+		{
+			writeInt(static_cast<uint8_t>(ComplexTypeTag::STRUCT));
+			writeInt(static_cast<uint32_t>(str->elementTypes.size()));
+			for(const DataType& element : str->elementTypes)
+				writeType(element);
+			writeInt(static_cast<uint8_t>(str->isPacked));
+		}
+		else if(const ArrayType* array = dynamic_cast<const ArrayType*>(complex))
+		{
+			writeInt(static_cast<uint8_t>(ComplexTypeTag::ARRAY));
+			writeType(array->elementType);
+			writeInt(static_cast<uint32_t>(array->size));
+		}
+		else if(const ImageType* image = dynamic_cast<const ImageType*>(complex))
+		{
+			writeInt(static_cast<uint8_t>(ComplexTypeTag::IMAGE));
+			writeType(image->colorType);
+			writeInt(image->dimensions);
+			writeInt(static_cast<uint8_t>(image->isImageArray | (image->isImageBuffer << 1) | (image->isSampled << 2)));
+		}
+		else
+			throw CompilationError(CompilationStep::GENERAL, "Can't serialize unknown complex type", type.to_string());
+		writingTypes.erase(complex);
+		//the index is assigned after the definition (including all nested types) is written, the same order as the types are read
+		complexTypes.emplace(complex, static_cast<uint32_t>(complexTypes.size()));
+	}
+
+	void writeLiteral(const Literal& lit)
+	{
+		writeInt(static_cast<uint8_t>(lit.type));
+		switch(lit.type)
+		{
+			case LiteralType::INTEGER:
+				writeInt(static_cast<int64_t>(lit.integer));
+				break;
+			case LiteralType::REAL:
+				writeInt(lit.real);
+				break;
+			case LiteralType::BOOL:
+				writeInt(static_cast<uint8_t>(lit.flag));
+				break;
+		}
+	}
+
+	void writeValue(const Value& val)
+	{
+		writeInt(static_cast<uint8_t>(val.valueType));
+		writeType(val.type);
+		switch(val.valueType)
+		{
+			case ValueType::LITERAL:
+				writeLiteral(val.literal);
+				break;
+			case ValueType::LOCAL:
+				writeLocalId(val.local);
+				break;
+			case ValueType::REGISTER:
+				writeInt(static_cast<uint8_t>(val.reg.file));
+				writeInt(static_cast<uint32_t>(val.reg.num));
+				break;
+			case ValueType::CONTAINER:
+				writeInt(static_cast<uint32_t>(val.container.elements.size()));
+				for(const Value& element : val.container.elements)
+					writeValue(element);
+				break;
+			case ValueType::UNDEFINED:
+				break;
+			case ValueType::SMALL_IMMEDIATE:
+				writeInt(val.immediate.value);
+				break;
+		}
+	}
+
+	void writeOptionalValue(const Optional<Value>& val)
+	{
+		writeInt(static_cast<uint8_t>(val.hasValue));
+		if(val)
+			writeValue(val.get());
+	}
+
+	void writeInstruction(const IntermediateInstruction* instr)
+	{
+		writeInt(static_cast<uint8_t>(instr->kind));
+		writeOptionalValue(instr->getOutput());
+		writeInt(static_cast<uint32_t>(instr->getArguments().size()));
+		for(const Value& arg : instr->getArguments())
+			writeValue(arg);
+		writeInt(static_cast<uint8_t>(instr->signal));
+		writeInt(instr->unpackMode.value);
+		writeInt(instr->packMode.value);
+		writeInt(instr->conditional.value);
+		writeInt(static_cast<uint8_t>(instr->setFlags));
+		writeInt(static_cast<uint32_t>(instr->decoration));
+		writeInt(static_cast<uint8_t>(instr->canBeCombined));
+		//the properties not stored in the arguments
+		if(const Operation* op = instr->as<Operation>())
+			writeString(op->opCode);
+		else if(const MethodCall* call = instr->as<MethodCall>())
+			writeString(call->methodName);
+		else if(const Nop* nop = instr->as<Nop>())
+			writeInt(static_cast<uint8_t>(nop->type));
+		else if(const LoadImmediate* load = instr->as<LoadImmediate>())
+			writeInt(static_cast<uint8_t>(load->type));
+		else if(const CombinedOperation* combined = instr->as<CombinedOperation>())
+		{
+			writeInstruction(combined->op1.get());
+			writeInstruction(combined->op2.get());
+		}
+		else if(const SemaphoreAdjustment* semaphore = instr->as<SemaphoreAdjustment>())
+		{
+			writeInt(static_cast<uint8_t>(semaphore->semaphore));
+			writeInt(static_cast<uint8_t>(semaphore->increase));
+		}
+		else if(const MemoryBarrier* barrier = instr->as<MemoryBarrier>())
+		{
+			writeInt(static_cast<uint8_t>(barrier->scope));
+			writeInt(static_cast<uint32_t>(barrier->semantics));
+		}
+	}
+};
+
+class ModuleReader
+{
+public:
+	/*
+	 * The shared types are the types written by a writer using shared types
+	 */
+	explicit ModuleReader(std::istream& input, const std::vector<std::shared_ptr<ComplexType>>& sharedTypes = {}) : input(&input), complexTypes(sharedTypes)
+	{
+	}
+
+	/*
+	 * Continues reading from the given stream, e.g. for the data of a single method
+	 */
+	void setInput(std::istream& newInput)
+	{
+		input = &newInput;
+	}
+
+	void readModule(Module& module)
+	{
+		readHeader();
+		readGlobals(module);
+		const uint32_t numMethods = readInt<uint32_t>();
+		for(uint32_t i = 0; i < numMethods; ++i)
+			readNextMethod(module);
+	}
+
+	void readHeader()
+	{
+		if(readInt<uint64_t>() != SERIALIZATION_MAGIC_NUMBER || readInt<uint32_t>() != SERIALIZATION_VERSION)
+			throw CompilationError(CompilationStep::GENERAL, "Invalid serialized module");
+		const std::string version = readString();
+		if(version != VC4C_VERSION)
+			throw CompilationError(CompilationStep::GENERAL, "Serialized module was written by another version of the compiler", version);
+		//the names of the temporary locals loaded must not be re-used for new locals
+		Method::advanceTemporaryNameCounter(static_cast<std::size_t>(readInt<uint64_t>()));
+	}
+
+	void readGlobals(Module& module)
+	{
+		types = &module.types;
+		const uint32_t numGlobals = readInt<uint32_t>();
+		std::vector<Global*> globals;
+		for(uint32_t i = 0; i < numGlobals; ++i)
+		{
+			const std::string name = readString();
+			const DataType type = readType();
+			module.globalData.emplace_back(Global(name, type, UNDEFINED_VALUE));
+			globals.push_back(&module.globalData.back());
+			locals.push_back(globals.back());
+		}
+		for(Global* global : globals)
+			global->value = readValue();
+		readReferences(0, locals.size());
+		numGlobalLocals = locals.size();
+	}
+
+	/*
+	 * Reads the global data written by ModuleWriter#writeReferencedGlobals and resolves it by name to the global data of the module
+	 */
+	void readReferencedGlobals(Module& module)
+	{
+		types = &module.types;
+		const uint32_t numGlobals = readInt<uint32_t>();
+		for(uint32_t i = 0; i < numGlobals; ++i)
+		{
+			const std::string name = readString();
+			const DataType type = readType();
+			auto it = std::find_if(module.globalData.begin(), module.globalData.end(), [&name](const Global& global) -> bool { return global.name == name;});
+			if(it == module.globalData.end() || it->type != type)
+				throw CompilationError(CompilationStep::GENERAL, "Global referenced by serialized method is not part of the module", name);
+			locals.push_back(&*it);
+		}
+		//the values are only written to distinguish methods using globals of the same name but with different contents
+		for(uint32_t i = 0; i < numGlobals; ++i)
+			readValue();
+		//the references of the globals of the module are not overwritten
+		for(uint32_t i = 0; i < numGlobals; ++i)
+		{
+			readInt<uint32_t>();
+			readInt<int32_t>();
+		}
+		numGlobalLocals = locals.size();
+	}
+
+	/*
+	 * Reads the next method and appends it to the methods of the module
+	 */
+	void readNextMethod(Module& module)
+	{
+		//the locals of the previous method are not visible anymore
+		locals.resize(numGlobalLocals);
+		module.methods.emplace_back(new Method(module));
+		readMethod(*module.methods.back());
+	}
+
+private:
+	std::istream* input;
+	TypeHolder* types = nullptr;
+	std::vector<std::shared_ptr<ComplexType>> complexTypes;
+	std::vector<const Local*> locals;
+	std::size_t numGlobalLocals = 0;
+
+	template<typename T>
+	T readInt()
+	{
+		T val;
+		if(!input->read(reinterpret_cast<char*>(&val), sizeof(T)))
+			throw CompilationError(CompilationStep::GENERAL, "Unexpected end of serialized module");
+		return val;
+	}
+
+	std::string readString()
+	{
+		const uint32_t size = readInt<uint32_t>();
+		std::string s(size, '\0');
+		if(size > 0 && !input->read(&s[0], size))
+			throw CompilationError(CompilationStep::GENERAL, "Unexpected end of serialized module");
+		return s;
+	}
+
+	const Local* readLocal()
+	{
+		const uint32_t id = readInt<uint32_t>();
+		if(id >= locals.size())
+			throw CompilationError(CompilationStep::GENERAL, "Invalid local in serialized module", std::to_string(id));
+		return locals[id];
+	}
+
+	void readReferences(const std::size_t start, const std::size_t end)
+	{
+		for(std::size_t i = start; i < end; ++i)
+		{
+			const uint32_t id = readInt<uint32_t>();
+			const int32_t index = readInt<int32_t>();
+			if(id == NO_LOCAL)
+				continue;
+			if(id >= locals.size())
+				throw CompilationError(CompilationStep::GENERAL, "Invalid local reference in serialized module", std::to_string(id));
+			//same as done by the front-ends, when the local is created for accessing another local
+			const_cast<std::pair<Local*, int>&>(locals[i]->reference) = std::make_pair(const_cast<Local*>(locals[id]), static_cast<int>(index));
+		}
+	}
+
+	DataType readType()
+	{
+		const std::string name = readString();
+		const unsigned char num = readInt<unsigned char>();
+		const ComplexTypeTag tag = static_cast<ComplexTypeTag>(readInt<uint8_t>());
+		std::shared_ptr<ComplexType> complex;
+		switch(tag)
+		{
+			case ComplexTypeTag::NONE:
+				return DataType(name, num);
+			case ComplexTypeTag::REFERENCE:
+			{
+				const uint32_t index = readInt<uint32_t>();
+				if(index >= complexTypes.size())
+					throw CompilationError(CompilationStep::GENERAL, "Invalid type reference in serialized module", std::to_string(index));
+				return DataType(name, num, complexTypes[index]);
+			}
+			case ComplexTypeTag::POINTER:
+			{
+				const DataType elementType = readType();
+				const AddressSpace addressSpace = static_cast<AddressSpace>(readInt<uint8_t>());
+				//pointer and array types are interned the same way the front-ends do
+				complex = types->getPointerType(elementType, addressSpace, readInt<uint32_t>()).complexType;
+				break;
+			}
+			case ComplexTypeTag::STRUCT:
+			{
+				std::vector<DataType> elementTypes(readInt<uint32_t>());
+				for(DataType& element : elementTypes)
+					element = readType();
+				complex.reset(new StructType(elementTypes, readInt<uint8_t>() != 0));
+				break;
+			}
+			case ComplexTypeTag::ARRAY:
+			{
+				const DataType elementType = readType();
+				complex = types->getArrayType(elementType, readInt<uint32_t>()).complexType;
+				break;
+			}
+			case ComplexTypeTag::IMAGE:
+			{
+				ImageType* image = new ImageType();
+				complex.reset(image);
+				image->colorType = readType();
+				image->dimensions = readInt<uint8_t>();
+				const uint8_t flags = readInt<uint8_t>();
+				image->isImageArray = flags & 0x1;
+				image->isImageBuffer = flags & 0x2;
+				image->isSampled = flags & 0x4;
+				break;
+			}
+			default:
+				throw CompilationError(CompilationStep::GENERAL, "Invalid type in serialized module", std::to_string(static_cast<unsigned>(tag)));
+		}
+		complexTypes.push_back(complex);
+		return DataType(name, num, complex);
+	}
+
+	Literal readLiteral()
+	{
+		const LiteralType type = static_cast<LiteralType>(readInt<uint8_t>());
+		switch(type)
+		{
+			case LiteralType::INTEGER:
+				return Literal(static_cast<long>(readInt<int64_t>()));
+			case LiteralType::REAL:
+				return Literal(readInt<double>());
+			case LiteralType::BOOL:
+				return Literal(readInt<uint8_t>() != 0);
+		}
+		throw CompilationError(CompilationStep::GENERAL, "Invalid literal in serialized module", std::to_string(static_cast<unsigned>(type)));
+	}
+
+	Value readValue()
+	{
+		const ValueType valueType = static_cast<ValueType>(readInt<uint8_t>());
+		const DataType type = readType();
+		switch(valueType)
+		{
+			case ValueType::LITERAL:
+				return Value(readLiteral(), type);
+			case ValueType::LOCAL:
+				return Value(readLocal(), type);
+			case ValueType::REGISTER:
+			{
+				const RegisterFile file = static_cast<RegisterFile>(readInt<uint8_t>());
+				return Value(Register(file, readInt<uint32_t>()), type);
+			}
+			case ValueType::CONTAINER:
+			{
+				ContainerValue container;
+				const uint32_t numElements = readInt<uint32_t>();
+				container.elements.reserve(numElements);
+				for(uint32_t i = 0; i < numElements; ++i)
+					container.elements.push_back(readValue());
+				return Value(container, type);
+			}
+			case ValueType::UNDEFINED:
+				return Value(type);
+			case ValueType::SMALL_IMMEDIATE:
+				return Value(SmallImmediate(readInt<unsigned char>()), type);
+		}
+		throw CompilationError(CompilationStep::GENERAL, "Invalid value in serialized module", std::to_string(static_cast<unsigned>(valueType)));
+	}
+
+	static const Value& getArgument(const std::vector<Value>& args, const std::size_t index)
+	{
+		if(index >= args.size())
+			throw CompilationError(CompilationStep::GENERAL, "Missing argument for instruction in serialized module");
+		return args[index];
+	}
+
+	static const Local* getLocalArgument(const std::vector<Value>& args, const std::size_t index)
+	{
+		const Value& arg = getArgument(args, index);
+		if(!arg.hasType(ValueType::LOCAL))
+			throw CompilationError(CompilationStep::GENERAL, "Invalid argument for instruction in serialized module", arg.to_string());
+		return arg.local;
+	}
+
+	IntermediateInstruction* readInstruction()
+	{
+		const InstructionKind kind = static_cast<InstructionKind>(readInt<uint8_t>());
+		Optional<Value> output = NO_VALUE;
+		if(readInt<uint8_t>() != 0)
+			output = readValue();
+		std::vector<Value> args;
+		const uint32_t numArgs = readInt<uint32_t>();
+		args.reserve(numArgs);
+		for(uint32_t i = 0; i < numArgs; ++i)
+			args.push_back(readValue());
+		const Signaling signal = static_cast<Signaling>(readInt<uint8_t>());
+		const Unpack unpackMode = readInt<unsigned char>();
+		const Pack packMode = readInt<unsigned char>();
+		const ConditionCode conditional = readInt<unsigned char>();
+		const SetFlag setFlags = static_cast<SetFlag>(readInt<uint8_t>());
+		const InstructionDecorations decoration = static_cast<InstructionDecorations>(readInt<uint32_t>());
+		const bool canBeCombined = readInt<uint8_t>() != 0;
+
+		if(!output && (kind == InstructionKind::OPERATION || kind == InstructionKind::COMPARISON || kind == InstructionKind::MOVE ||
+				kind == InstructionKind::VECTOR_ROTATION || kind == InstructionKind::LOAD_IMMEDIATE || kind == InstructionKind::PHI_NODE))
+			throw CompilationError(CompilationStep::GENERAL, "Missing output for instruction in serialized module");
+		std::unique_ptr<IntermediateInstruction> instr;
+		switch(kind)
+		{
+			case InstructionKind::OPERATION:
+			{
+				const std::string opCode = readString();
+				if(args.size() > 1)
+					instr.reset(new Operation(opCode, output.get(), args[0], args[1]));
+				else
+					instr.reset(new Operation(opCode, output.get(), getArgument(args, 0)));
+				break;
+			}
+			case InstructionKind::COMPARISON:
+			{
+				const std::string comp = readString();
+				instr.reset(new Comparison(comp, output.get(), getArgument(args, 0), getArgument(args, 1)));
+				break;
+			}
+			case InstructionKind::METHOD_CALL:
+			{
+				const std::string methodName = readString();
+				if(output)
+					instr.reset(new MethodCall(output.get(), methodName, args));
+				else
+					instr.reset(new MethodCall(methodName, args));
+				break;
+			}
+			case InstructionKind::RETURN:
+				instr.reset(args.empty() ? new Return() : new Return(args[0]));
+				break;
+			case InstructionKind::MOVE:
+				instr.reset(new MoveOperation(output.get(), getArgument(args, 0)));
+				break;
+			case InstructionKind::VECTOR_ROTATION:
+				instr.reset(new VectorRotation(output.get(), getArgument(args, 0), getArgument(args, 1)));
+				break;
+			case InstructionKind::BRANCH_LABEL:
+				instr.reset(new BranchLabel(*getLocalArgument(args, 0)));
+				break;
+			case InstructionKind::BRANCH:
+				instr.reset(new Branch(getLocalArgument(args, 0), conditional, getArgument(args, 1)));
+				break;
+			case InstructionKind::NOP:
+				instr.reset(new Nop(static_cast<DelayType>(readInt<uint8_t>()), signal));
+				break;
+			case InstructionKind::COMBINED_OPERATION:
+			{
+				std::unique_ptr<IntermediateInstruction> op1(readInstruction());
+				std::unique_ptr<IntermediateInstruction> op2(readInstruction());
+				if(!op1->is<Operation>() || !op2->is<Operation>())
+					throw CompilationError(CompilationStep::GENERAL, "Invalid combined operation in serialized module");
+				instr.reset(new CombinedOperation(op1.release()->as<Operation>(), op2.release()->as<Operation>()));
+				break;
+			}
+			case InstructionKind::LOAD_IMMEDIATE:
+			{
+				const Value& immediate = getArgument(args, 0);
+				if(!immediate.hasType(ValueType::LITERAL))
+					throw CompilationError(CompilationStep::GENERAL, "Invalid immediate in serialized module", immediate.to_string());
+				instr.reset(new LoadImmediate(output.get(), immediate.literal, static_cast<LoadType>(readInt<uint8_t>())));
+				break;
+			}
+			case InstructionKind::SEMAPHORE_ADJUSTMENT:
+			{
+				const Semaphore semaphore = static_cast<Semaphore>(readInt<uint8_t>());
+				instr.reset(new SemaphoreAdjustment(semaphore, readInt<uint8_t>() != 0));
+				break;
+			}
+			case InstructionKind::PHI_NODE:
+			{
+				std::vector<std::pair<Value, const Local*>> labelPairs;
+				for(std::size_t i = 0; i + 1 < args.size(); i += 2)
+					labelPairs.emplace_back(args[i + 1], getLocalArgument(args, i));
+				instr.reset(new PhiNode(output.get(), labelPairs));
+				break;
+			}
+			case InstructionKind::MEMORY_BARRIER:
+			{
+				const MemoryScope scope = static_cast<MemoryScope>(readInt<uint8_t>());
+				instr.reset(new MemoryBarrier(scope, static_cast<MemorySemantics>(readInt<uint32_t>())));
+				break;
+			}
+			default:
+				throw CompilationError(CompilationStep::GENERAL, "Invalid instruction in serialized module", std::to_string(static_cast<unsigned>(kind)));
+		}
+		instr->signal = signal;
+		instr->unpackMode = unpackMode;
+		instr->packMode = packMode;
+		instr->conditional = conditional;
+		instr->setFlags = setFlags;
+		instr->decoration = decoration;
+		instr->canBeCombined = canBeCombined;
+		return instr.release();
+	}
+
+public:
+	void readMethod(Method& method)
+	{
+		//the instructions are allocated in the memory-pool of the method
+		intermediate::InstructionArena::Scope arenaScope(method.getInstructionArena());
+		method.isKernel = readInt<uint8_t>() != 0;
+		method.name = readString();
+		method.returnType = readType();
+		const uint32_t numMetaData = readInt<uint32_t>();
+		for(uint32_t i = 0; i < numMetaData; ++i)
+		{
+			std::vector<std::string>& entries = method.metaData[static_cast<MetaDataType>(readInt<uint8_t>())];
+			const uint32_t numEntries = readInt<uint32_t>();
+			for(uint32_t k = 0; k < numEntries; ++k)
+				entries.push_back(readString());
+		}
+
+		const std::size_t firstLocal = locals.size();
+		const uint32_t numParameters = readInt<uint32_t>();
+		//the locals refer to the parameters, so they must not be moved
+		method.parameters.reserve(numParameters);
+		for(uint32_t i = 0; i < numParameters; ++i)
+		{
+			const std::string name = readString();
+			const DataType type = readType();
+			method.parameters.emplace_back(Parameter(name, type, static_cast<ParameterDecorations>(readInt<uint32_t>())));
+			method.parameters.back().maxByteOffset = static_cast<std::size_t>(readInt<uint64_t>());
+			method.parameters.back().parameterName = readString();
+		}
+		for(const Parameter& param : method.parameters)
+			locals.push_back(&param);
+		const uint32_t numLocals = readInt<uint32_t>();
+		for(uint32_t i = 0; i < numLocals; ++i)
+		{
+			const std::string name = readString();
+			const DataType type = readType();
+			const Local* local = method.findOrCreateLocal(type, name);
+			if(local->type != type)
+				throw CompilationError(CompilationStep::GENERAL, "Local in serialized module conflicts with global or parameter", name);
+			locals.push_back(local);
+		}
+		readReferences(firstLocal, locals.size());
+
+		const uint64_t numInstructions = readInt<uint64_t>();
+		for(uint64_t i = 0; i < numInstructions; ++i)
+			method.appendToEnd(readInstruction());
+	}
+};
+
+void vc4c::serializeModule(const Module& module, std::ostream& output)
+{
+	ModuleWriter writer(output);
+	writer.writeModule(module);
+}
+
+void vc4c::deserializeModule(Module& module, std::istream& input)
+{
+	ModuleReader reader(input);
+	reader.readModule(module);
+	DEBUG_LOG("Loaded serialized module with " << module.methods.size() << " methods and " << module.globalData.size() << " globals" << logging::endl);
+}
+
+std::string vc4c::serializeMethod(const Method& method)
+{
+	std::ostringstream stream;
+	ModuleWriter writer(stream);
+	writer.writeHeader();
+	writer.writeReferencedGlobals(method);
+	writer.writeMethod(method);
+	return stream.str();
+}
+
+std::string vc4c::serializeMethodStructure(const Method& method)
+{
+	std::ostringstream stream;
+	ModuleWriter writer(stream);
+	writer.anonymizeLocals = true;
+	writer.writeReferencedGlobals(method);
+	writer.writeMethod(method);
+	return stream.str();
+}
+
+void vc4c::deserializeMethod(Module& module, Method& method, const std::string& data)
+{
+	MemoryStreamBuffer buffer(data.data(), data.size());
+	std::istream stream(&buffer);
+	ModuleReader reader(stream);
+	reader.readHeader();
+	reader.readReferencedGlobals(module);
+	reader.readMethod(method);
+}
+
+ModuleSnapshot::ModuleSnapshot(const Module& module) : globalsSize(0)
+{
+	std::ostringstream stream;
+	ModuleWriter writer(stream, &types);
+	writer.writeHeader();
+	writer.writeGlobals(module);
+	globalsSize = static_cast<std::size_t>(stream.tellp());
+
+	FastMap<std::string, std::vector<std::size_t>> methodsByName;
+	for(std::size_t i = 0; i < module.methods.size(); ++i)
+		methodsByName[module.methods[i]->name].push_back(i);
+	for(const auto& method : module.methods)
+	{
+		const std::size_t offset = static_cast<std::size_t>(stream.tellp());
+		writer.writeMethod(*method);
+		methods.push_back(MethodData{offset, static_cast<std::size_t>(stream.tellp()) - offset, method->isKernel, {}});
+		//the overloads are not distinguished here, so all methods of the called name are kept
+		std::vector<std::size_t>& calledMethods = methods.back().calledMethods;
+		method->forAllInstructions([&](const IntermediateInstruction* instr) -> void
+		{
+			const MethodCall* call = instr->as<MethodCall>();
+			auto it = call == nullptr ? methodsByName.end() : methodsByName.find(call->methodName);
+			if(it != methodsByName.end())
+				calledMethods.insert(calledMethods.end(), it->second.begin(), it->second.end());
+		});
+	}
+	data = stream.str();
+}
+
+void ModuleSnapshot::restore(Module& module) const
+{
+	//the methods not used by any kernel are removed before any optimization, so they are not restored at all
+	std::vector<bool> isUsed(methods.size(), false);
+	std::vector<std::size_t> openMethods;
+	for(std::size_t i = 0; i < methods.size(); ++i)
+	{
+		if(methods[i].isKernel)
+		{
+			isUsed[i] = true;
+			openMethods.push_back(i);
+		}
+	}
+	while(!openMethods.empty())
+	{
+		const std::size_t index = openMethods.back();
+		openMethods.pop_back();
+		for(std::size_t called : methods[index].calledMethods)
+		{
+			if(!isUsed[called])
+			{
+				isUsed[called] = true;
+				openMethods.push_back(called);
+			}
+		}
+	}
+
+	MemoryStreamBuffer globalsBuffer(data.data(), globalsSize);
+	std::istream globalsStream(&globalsBuffer);
+	ModuleReader reader(globalsStream, types);
+	reader.readHeader();
+	reader.readGlobals(module);
+	//the methods are read in their original order
+	for(std::size_t i = 0; i < methods.size(); ++i)
+	{
+		if(!isUsed[i])
+			continue;
+		MemoryStreamBuffer buffer(data.data() + methods[i].offset, methods[i].size);
+		std::istream stream(&buffer);
+		reader.setInput(stream);
+		reader.readNextMethod(module);
+	}
+	DEBUG_LOG("Restored module with " << module.methods.size() << " of " << methods.size() << " methods and " << module.globalData.size() << " globals from snapshot" << logging::endl);
+}
+
+std::size_t ModuleSnapshot::getSize() const
+{
+	return data.size();
+}
@@ -0,0 +1,94 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#include "Module.h"
+
+#include <iostream>
+
+namespace vc4c
+{
+	/*
+	 * Writes the module (global data, methods with their parameters, locals, meta-data and instructions) in a compact binary format.
+	 *
+	 * This is used to store the module as produced by the front-ends, so a compilation of the same input with a different configuration
+	 * can skip the parsing (and the pre-compilation) and resume directly with the optimizations.
+	 *
+	 * Throws a CompilationError, if the module can't be serialized (e.g. for recursive types)
+	 */
+	void serializeModule(const Module& module, std::ostream& output);
+
+	/*
+	 * Reads the module written by #serializeModule into the given (empty) module.
+	 *
+	 * Throws a CompilationError, if the data is invalid or was written by another version of the compiler
+	 */
+	void deserializeModule(Module& module, std::istream& input);
+
+	/*
+	 * Writes a single method in the format of #serializeModule. Instead of all global data of the module, only the global data used by the method is written,
+	 * which is resolved by name when reading the method (see #deserializeMethod), so the method can be restored into another module with the same global data
+	 */
+	std::string serializeMethod(const Method& method);
+	/*
+	 * Writes the method like #serializeMethod, but without the header and the names of the locals (except the parameters),
+	 * so methods of the same structure yield the same data, even if their temporary locals were named differently
+	 */
+	std::string serializeMethodStructure(const Method& method);
+	/*
+	 * Reads the method written by #serializeMethod into the given (empty) method of the module.
+	 *
+	 * Throws a CompilationError, if the data is invalid or the global data used by the method is not part of the module
+	 */
+	void deserializeMethod(Module& module, Method& method, const std::string& data);
+
+	/*
+	 * Immutable copy of a module (e.g. as produced by the front-ends), from which the modules of several (concurrent) compilations are created,
+	 * e.g. the variants compiled by Compiler#compileVariants.
+	 *
+	 * The complex types are not copied, but shared by the snapshot and all modules created from it, since they are not modified after parsing.
+	 * The global data and the methods are stored in the format of #serializeModule, so the snapshot is much smaller than the module itself
+	 * and the original module can be released. The methods are only created in a module restored from the snapshot, if they are called (directly or indirectly) by a kernel.
+	 */
+	class ModuleSnapshot : private NonCopyable
+	{
+	public:
+		/*
+		 * Throws a CompilationError, if the module can't be serialized (e.g. for recursive types)
+		 */
+		explicit ModuleSnapshot(const Module& module);
+
+		/*
+		 * Fills the given (empty) module with the global data and the methods of the snapshot
+		 */
+		void restore(Module& module) const;
+
+		/*
+		 * The size of the stored global data and methods in bytes
+		 */
+		std::size_t getSize() const;
+
+	private:
+		struct MethodData
+		{
+			std::size_t offset;
+			std::size_t size;
+			bool isKernel;
+			//the indices of the methods called by this method
+			std::vector<std::size_t> calledMethods;
+		};
+
+		std::vector<std::shared_ptr<ComplexType>> types;
+		//the header and the global data, followed by the methods
+		std::string data;
+		std::size_t globalsSize;
+		std::vector<MethodData> methods;
+	};
+} /* namespace vc4c */
+
+#endif /* SERIALIZATION_H */
@@ -0,0 +1,229 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifdef MULTI_THREADED
+
+#include "ThreadPool.h"
+#include "log.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/prctl.h>
+#include <dlfcn.h>
+
+using namespace threading;
+
+//the pool the current thread is a worker of and the index of its task-queue
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local std::size_t currentQueue = 0;
+
+static LockStatistics queueLockStatistics("ThreadPool::queue");
+static LockStatistics sleepLockStatistics("ThreadPool::sleep");
+
+/*
+ * We need thread-support, so load the pthread library dynamically (if it is not yet loaded).
+ * This is only done once per process and only when the first pool is created, so loading the library without ever compiling anything stays cheap
+ */
+static void loadThreadSupport()
+{
+	static const std::string error = []() -> std::string
+	{
+		void* handle = dlopen("libpthread.so.0", RTLD_GLOBAL | RTLD_LAZY);
+		return handle == nullptr ? std::string(dlerror()) : std::string{};
+	}();
+	if(!error.empty())
+	{
+		throw std::runtime_error(std::string("Error loading pthread library: ") + error);
+	}
+}
+
+ThreadPool::ThreadPool(std::size_t numThreads) : queues(), threads(), nextQueue(0), numPendingTasks(0), sleepMutex(), sleepCondition(), shutdown(false)
+{
+	loadThreadSupport();
+
+	numThreads = std::max(numThreads, static_cast<std::size_t>(1));
+	queues.reserve(numThreads);
+	for(std::size_t i = 0; i < numThreads; ++i)
+		queues.emplace_back(new TaskQueue());
+	threads.reserve(numThreads);
+	for(std::size_t i = 0; i < numThreads; ++i)
+		threads.emplace_back(&ThreadPool::runWorker, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepMutex);
+		shutdown = true;
+	}
+	sleepCondition.notify_all();
+	for(std::thread& thread : threads)
+	{
+		if(thread.joinable())
+			thread.join();
+	}
+}
+
+void ThreadPool::schedule(const std::shared_ptr<Task>& task)
+{
+	//tasks scheduled by a worker of this pool are most likely dependencies of the current task, so keep them local
+	const std::size_t index = currentPool == this ? currentQueue : (nextQueue++ % queues.size());
+	{
+		const auto guard = lockMeasured(queues[index]->mutex, queueLockStatistics);
+		queues[index]->tasks.push_back(task);
+	}
+	{
+		const auto guard = lockMeasured(sleepMutex, sleepLockStatistics);
+		++numPendingTasks;
+	}
+	sleepCondition.notify_one();
+}
+
+void ThreadPool::waitFor(const std::shared_ptr<Task>& task)
+{
+	while(true)
+	{
+		{
+			std::lock_guard<std::mutex> guard(task->mutex);
+			if(task->done)
+				return;
+		}
+		//help executing pending tasks instead of blocking a thread
+		std::shared_ptr<Task> other = popTask(currentPool == this ? currentQueue : 0);
+		if(!other)
+			break;
+		execute(*other);
+	}
+	//the task is currently executed by another thread
+	std::unique_lock<std::mutex> lock(task->mutex);
+	task->finished.wait(lock, [&task]() -> bool { return task->done; });
+}
+
+std::size_t ThreadPool::getNumThreads() const
+{
+	return threads.size();
+}
+
+ThreadPool& ThreadPool::getGlobalPool()
+{
+	static ThreadPool pool([]() -> std::size_t
+	{
+		const char* threads = std::getenv("VC4C_THREADS");
+		const std::size_t numThreads = threads == nullptr ? 0 : std::strtoul(threads, nullptr, 10);
+		return numThreads > 0 ? numThreads : std::thread::hardware_concurrency();
+	}());
+	return pool;
+}
+
+void ThreadPool::runWorker(std::size_t index)
+{
+	currentPool = this;
+	currentQueue = index;
+	while(true)
+	{
+		std::shared_ptr<Task> task = popTask(index);
+		if(task)
+		{
+			execute(*task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this]() -> bool { return shutdown || numPendingTasks > 0; });
+		if(shutdown)
+			return;
+	}
+}
+
+std::shared_ptr<Task> ThreadPool::popTask(std::size_t preferredQueue)
+{
+	if(numPendingTasks == 0)
+		return nullptr;
+	//take the newest task of the own queue
+	{
+		TaskQueue& queue = *queues[preferredQueue];
+		const auto guard = lockMeasured(queue.mutex, queueLockStatistics);
+		if(!queue.tasks.empty())
+		{
+			std::shared_ptr<Task> task = queue.tasks.back();
+			queue.tasks.pop_back();
+			--numPendingTasks;
+			return task;
+		}
+	}
+	//steal the oldest task of any other queue
+	for(std::size_t i = 1; i < queues.size(); ++i)
+	{
+		TaskQueue& queue = *queues[(preferredQueue + i) % queues.size()];
+		const auto guard = lockMeasured(queue.mutex, queueLockStatistics);
+		if(!queue.tasks.empty())
+		{
+			std::shared_ptr<Task> task = queue.tasks.front();
+			queue.tasks.pop_front();
+			--numPendingTasks;
+			return task;
+		}
+	}
+	return nullptr;
+}
+
+void ThreadPool::execute(Task& task)
+{
+	prctl(PR_SET_NAME, task.name.data(), 0, 0, 0);
+	try
+	{
+		task.func();
+	}
+	catch(...)
+	{
+		//the task is responsible for reporting its errors, this only keeps the worker-thread alive
+		logging::error() << "Unhandled error in task: " << task.name << logging::endl;
+	}
+	{
+		std::lock_guard<std::mutex> guard(task.mutex);
+		task.done = true;
+	}
+	task.finished.notify_all();
+}
+
+/*
+ * The registered statistics, allocated once and never freed, so statistics constructed during the static initialization of any translation unit can register themselves
+ */
+static std::pair<std::mutex, std::vector<const LockStatistics*>>& getLockRegistry()
+{
+	static auto* registry = new std::pair<std::mutex, std::vector<const LockStatistics*>>();
+	return *registry;
+}
+
+LockStatistics::LockStatistics(const std::string& name) : name(name), numAcquisitions(0), numContended(0), waitTime(0)
+{
+	auto& registry = getLockRegistry();
+	std::lock_guard<std::mutex> guard(registry.first);
+	registry.second.push_back(this);
+}
+
+std::unique_lock<std::mutex> threading::lockMeasured(std::mutex& mutex, LockStatistics& statistics)
+{
+	statistics.numAcquisitions.fetch_add(1, std::memory_order_relaxed);
+	std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+	if(lock.owns_lock())
+		return lock;
+	const auto start = std::chrono::steady_clock::now();
+	lock.lock();
+	const auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	statistics.numContended.fetch_add(1, std::memory_order_relaxed);
+	statistics.waitTime.fetch_add(static_cast<uint64_t>(waited.count()), std::memory_order_relaxed);
+	return lock;
+}
+
+std::vector<const LockStatistics*> threading::getLockStatistics()
+{
+	auto& registry = getLockRegistry();
+	std::lock_guard<std::mutex> guard(registry.first);
+	return registry.second;
+}
+
+#endif /* MULTI_THREADED */
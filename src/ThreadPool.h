@@ -0,0 +1,136 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#ifdef MULTI_THREADED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace threading
+{
+	/*
+	 * A single unit of work scheduled on a thread-pool
+	 */
+	struct Task
+	{
+	public:
+		Task(const std::function<void()>& func, const std::string& name) : func(func), name(name), done(false) { }
+
+		const std::function<void()> func;
+		const std::string name;
+
+	private:
+		std::mutex mutex;
+		std::condition_variable finished;
+		bool done;
+
+		friend class ThreadPool;
+	};
+
+	/*
+	 * Fixed-size pool of worker-threads.
+	 *
+	 * Every worker has its own task-queue, idle workers steal tasks from the queues of the other workers.
+	 * Tasks scheduled from within a worker are put into the queue of that worker (and are executed LIFO),
+	 * all other tasks are distributed round-robin.
+	 */
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(std::size_t numThreads);
+		ThreadPool(const ThreadPool&) = delete;
+		~ThreadPool();
+
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/*
+		 * Schedules the task for execution on one of the worker-threads
+		 */
+		void schedule(const std::shared_ptr<Task>& task);
+		/*
+		 * Blocks until the given task has finished.
+		 *
+		 * While waiting, the calling thread executes other pending tasks,
+		 * so waiting from within a worker-thread does not dead-lock the pool.
+		 */
+		void waitFor(const std::shared_ptr<Task>& task);
+
+		std::size_t getNumThreads() const;
+
+		/*
+		 * Returns the pool shared by all compilations of this process, sized to the number of threads given in the environment variable VC4C_THREADS
+		 * or to the hardware concurrency, if not set
+		 */
+		static ThreadPool& getGlobalPool();
+
+	private:
+		struct TaskQueue
+		{
+			std::mutex mutex;
+			std::deque<std::shared_ptr<Task>> tasks;
+		};
+
+		std::vector<std::unique_ptr<TaskQueue>> queues;
+		std::vector<std::thread> threads;
+		std::atomic<std::size_t> nextQueue;
+		std::atomic<std::size_t> numPendingTasks;
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		bool shutdown;
+
+		void runWorker(std::size_t index);
+		std::shared_ptr<Task> popTask(std::size_t preferredQueue);
+		static void execute(Task& task);
+	};
+
+	/*
+	 * The number of acquisitions of a lock and the time spent waiting for it while it was held by another thread, e.g. to find the locks limiting
+	 * the scaling of the multi-threaded compilation.
+	 *
+	 * The statistics are registered on construction (see getLockStatistics) and live for the whole process
+	 */
+	struct LockStatistics
+	{
+	public:
+		explicit LockStatistics(const std::string& name);
+		LockStatistics(const LockStatistics&) = delete;
+
+		LockStatistics& operator=(const LockStatistics&) = delete;
+
+		const std::string name;
+		std::atomic<uint64_t> numAcquisitions;
+		//the number of acquisitions, which needed to wait
+		std::atomic<uint64_t> numContended;
+		//the sum of the waiting times, in nanoseconds
+		std::atomic<uint64_t> waitTime;
+	};
+
+	/*
+	 * Acquires the lock, measuring the time waited if it is currently held by another thread. Uncontended acquisitions are not timed
+	 */
+	std::unique_lock<std::mutex> lockMeasured(std::mutex& mutex, LockStatistics& statistics);
+
+	/*
+	 * Returns the statistics of all measured locks of this process
+	 */
+	std::vector<const LockStatistics*> getLockStatistics();
+
+} /* namespace threading */
+
+#endif /* MULTI_THREADED */
+
+#endif /* THREAD_POOL_H */
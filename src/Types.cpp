@@ -43,7 +43,14 @@ bool DataType::operator==(const DataType& right) const
 {
 	if(this == &right)
 		return true;
-    return typeName.compare(right.typeName) == 0 && num == right.num && (complexType.get() == nullptr) == (right.complexType.get() == nullptr) && (complexType.get() != nullptr ? (*complexType.get()) == (*right.complexType.get()) : true);
+	//check the cheap properties first, the deep comparison of the complex types is only required for distinct (not interned) instances
+	if(num != right.num || typeName != right.typeName)
+		return false;
+	if(complexType == right.complexType)
+		return true;
+	if(complexType.get() == nullptr || right.complexType.get() == nullptr)
+		return false;
+	return (*complexType.get()) == (*right.complexType.get());
 }
 
 bool DataType::isScalarType() const
@@ -366,6 +373,40 @@ std::string ImageType::getImageTypeName() const
     return name;
 }
 
+const DataType& TypeHolder::getPointerType(const DataType& elementType, const AddressSpace addressSpace, unsigned alignment)
+{
+	const std::string name = elementType.to_string() + "*";
+	//the address space and alignment are not part of the type-name, but need to be distinguished
+	const std::string key = (name + "@") + (std::to_string(static_cast<unsigned>(addressSpace)) + "@") + std::to_string(alignment);
+	std::lock_guard<std::mutex> guard(typesLock);
+	auto it = types.find(key);
+	if(it == types.end())
+	{
+		std::shared_ptr<ComplexType> pointerType(new PointerType(elementType, addressSpace, alignment));
+		it = types.emplace(key, DataType(name, 1, pointerType)).first;
+	}
+	return it->second;
+}
+
+const DataType& TypeHolder::getArrayType(const DataType& elementType, const unsigned int size)
+{
+	const std::string name = (elementType.to_string() + "[") + std::to_string(size) + "]";
+	std::lock_guard<std::mutex> guard(typesLock);
+	auto it = types.find(name);
+	if(it == types.end())
+	{
+		std::shared_ptr<ComplexType> arrayType(new ArrayType(elementType, size));
+		it = types.emplace(name, DataType(name, 1, arrayType)).first;
+	}
+	return it->second;
+}
+
+std::size_t TypeHolder::size() const
+{
+	std::lock_guard<std::mutex> guard(typesLock);
+	return types.size();
+}
+
 std::string ImageType::toImageConfigurationName(const std::string& localName)
 {
 	return localName + ".image_config";
@@ -10,6 +10,8 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <map>
+#include <mutex>
 
 #include "helper.h"
 
@@ -171,6 +173,36 @@ namespace vc4c
 		static std::string toImageConfigurationName(const std::string& localName);
 	};
 
+	/*
+	 * Interning table for complex types.
+	 *
+	 * Every distinct pointer- or array-type created via this table exists only once and all types retrieved share the same ComplexType instance.
+	 * This allows DataType#operator== to skip the deep comparison of the complex types.
+	 *
+	 * NOTE: This is not thread-safe and is therefore only to be used by the front-ends
+	 */
+	class TypeHolder : private NonCopyable
+	{
+	public:
+		TypeHolder() = default;
+		TypeHolder(TypeHolder&& other) : types(std::move(other.types)) { }
+		TypeHolder& operator=(TypeHolder&& other)
+		{
+			types = std::move(other.types);
+			return *this;
+		}
+
+		const DataType& getPointerType(const DataType& elementType, const AddressSpace addressSpace = AddressSpace::PRIVATE, unsigned alignment = 0);
+		const DataType& getArrayType(const DataType& elementType, const unsigned int size);
+
+		std::size_t size() const;
+
+	private:
+		std::map<std::string, DataType> types;
+		//the front-ends may create types from multiple threads, the references to the types stay valid on insertion
+		mutable std::mutex typesLock;
+	};
+
 	//TODO move somewhere else?
 
 	enum class Semaphore
@@ -388,7 +388,7 @@ Value::Value(Value&& val) : local(val.local), type(val.type), valueType(val.valu
     else if (val.hasType(ValueType::REGISTER))
         reg = val.reg;
     else if (val.hasType(ValueType::CONTAINER))
-        container = val.container;
+        container = std::move(val.container);
     else if(val.hasType(ValueType::SMALL_IMMEDIATE))
     	immediate = val.immediate;
     else if(!val.hasType(ValueType::LOCAL) && !val.hasType(ValueType::UNDEFINED))
@@ -597,7 +597,48 @@ Value& Value::assertReadable()
 	throw CompilationError(CompilationStep::GENERAL, "Cannot read from a write-only value", to_string(false));
 }
 
+static inline std::size_t combineHash(std::size_t seed, std::size_t value)
+{
+	//same as boost::hash_combine
+	return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+static std::size_t hashLiteral(const Literal& lit)
+{
+	switch(lit.type)
+	{
+		case LiteralType::BOOL:
+			return std::hash<bool>{}(lit.flag);
+		case LiteralType::INTEGER:
+			return std::hash<long>{}(lit.integer);
+		case LiteralType::REAL:
+			//0.0 and -0.0 compare equal, so they need to have the same hash
+			return lit.real == 0.0 ? 0 : std::hash<double>{}(lit.real);
+	}
+	return 0;
+}
+
 std::size_t vc4c::hash<vc4c::Value>::operator()(vc4c::Value const& val) const noexcept
 {
-	return std::hash<std::string>::operator()(val.to_string());
+	//the complex-type is not hashed, since equal types always have the same name
+	std::size_t result = combineHash(std::hash<std::string>{}(val.type.typeName), val.type.num);
+	result = combineHash(result, static_cast<std::size_t>(val.valueType));
+	switch(val.valueType)
+	{
+		case ValueType::LITERAL:
+			return combineHash(result, hashLiteral(val.literal));
+		case ValueType::LOCAL:
+			return combineHash(result, std::hash<const Local*>{}(val.local));
+		case ValueType::REGISTER:
+			return combineHash(combineHash(result, static_cast<std::size_t>(val.reg.file)), val.reg.num);
+		case ValueType::CONTAINER:
+			for(const Value& element : val.container.elements)
+				result = combineHash(result, operator()(element));
+			return result;
+		case ValueType::SMALL_IMMEDIATE:
+			return combineHash(result, val.immediate.value);
+		case ValueType::UNDEFINED:
+			return result;
+	}
+	return result;
 }
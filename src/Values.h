@@ -11,6 +11,8 @@
 #include "performance.h"
 #include "Bitfield.h"
 
+#include <memory>
+
 namespace vc4c
 {
 	enum class RegisterFile
@@ -133,6 +135,10 @@ namespace vc4c
 	static constexpr Register REG_TMU_COORD_T_V_Y { RegisterFile::PHYSICAL_ANY, 57 };
 	static constexpr Register REG_TMU_COORD_R_BORDER_COLOR { RegisterFile::PHYSICAL_ANY, 58 };
 	static constexpr Register REG_TMU_COORD_B_LOD_BIAS { RegisterFile::PHYSICAL_ANY, 59 };
+	/*
+	 * The s-coordinate (or general-memory address) register of the second TMU, which is read via the signal "load tmu1"
+	 */
+	static constexpr Register REG_TMU1_ADDRESS { RegisterFile::PHYSICAL_ANY, 60 };
 
 	enum class LiteralType
 	{
@@ -212,9 +218,60 @@ namespace vc4c
 
 	struct Value;
 
+	/*
+	 * The elements of a container-value.
+	 *
+	 * The elements are shared between the copies of a container and only copied when a shared container is modified (copy-on-write).
+	 * So copying a value (e.g. a vector literal) never copies its elements and an empty container does not allocate any memory.
+	 *
+	 * NOTE: The references and iterators returned by the modifying accessors are invalidated by copying the container
+	 */
+	class ContainerElements
+	{
+	public:
+		using value_type = Value;
+		using iterator = std::vector<Value>::iterator;
+		using const_iterator = std::vector<Value>::const_iterator;
+
+		ContainerElements() = default;
+		ContainerElements(const std::vector<Value>& elements);
+		ContainerElements(std::vector<Value>&& elements);
+
+		std::size_t size() const;
+		bool empty() const;
+		const Value& at(std::size_t index) const;
+		Value& at(std::size_t index);
+		const Value& operator[](std::size_t index) const;
+		Value& operator[](std::size_t index);
+		const Value& front() const;
+		const Value& back() const;
+
+		const_iterator begin() const;
+		const_iterator end() const;
+		iterator begin();
+		iterator end();
+
+		void reserve(std::size_t capacity);
+		void push_back(const Value& val);
+		template<typename... Args>
+		void emplace_back(Args&&... args);
+
+		bool operator==(const ContainerElements& other) const;
+		inline bool operator!=(const ContainerElements& other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		std::shared_ptr<std::vector<Value>> elements;
+
+		const std::vector<Value>& read() const;
+		std::vector<Value>& modify();
+	};
+
 	struct ContainerValue
 	{
-		std::vector<Value> elements;
+		ContainerElements elements;
 
 		/*
 		 * Determines whether all elements of this container have the same value.
@@ -231,6 +288,19 @@ namespace vc4c
 
 	class Local;
 
+	/*
+	 * Locals are hashed by their position in the method (or their name, if not created by a method) instead of their address,
+	 * so iterating the unordered containers of locals does not depend on the memory layout and the compilation is reproducible
+	 */
+	template<>
+	struct hash<const Local*>
+	{
+		size_t operator()(const Local* local) const noexcept;
+	};
+
+	template<>
+	struct hash<Local*> : public hash<const Local*> {};
+
 	struct Value
 	{
 		union
@@ -284,6 +354,113 @@ namespace vc4c
 		Value& assertReadable();
 	};
 
+	inline ContainerElements::ContainerElements(const std::vector<Value>& elements) :
+		elements(elements.empty() ? nullptr : std::make_shared<std::vector<Value>>(elements))
+	{
+	}
+
+	inline ContainerElements::ContainerElements(std::vector<Value>&& elements) :
+		elements(elements.empty() ? nullptr : std::make_shared<std::vector<Value>>(std::move(elements)))
+	{
+	}
+
+	inline const std::vector<Value>& ContainerElements::read() const
+	{
+		static const std::vector<Value> NO_ELEMENTS;
+		return elements ? *elements : NO_ELEMENTS;
+	}
+
+	inline std::vector<Value>& ContainerElements::modify()
+	{
+		if(!elements)
+			elements = std::make_shared<std::vector<Value>>();
+		else if(elements.use_count() > 1)
+			//copy-on-write, the other containers sharing the elements keep the original ones
+			elements = std::make_shared<std::vector<Value>>(*elements);
+		return *elements;
+	}
+
+	inline std::size_t ContainerElements::size() const
+	{
+		return elements ? elements->size() : 0;
+	}
+
+	inline bool ContainerElements::empty() const
+	{
+		return size() == 0;
+	}
+
+	inline const Value& ContainerElements::at(std::size_t index) const
+	{
+		return read().at(index);
+	}
+
+	inline Value& ContainerElements::at(std::size_t index)
+	{
+		return modify().at(index);
+	}
+
+	inline const Value& ContainerElements::operator[](std::size_t index) const
+	{
+		return read()[index];
+	}
+
+	inline Value& ContainerElements::operator[](std::size_t index)
+	{
+		return modify()[index];
+	}
+
+	inline const Value& ContainerElements::front() const
+	{
+		return read().front();
+	}
+
+	inline const Value& ContainerElements::back() const
+	{
+		return read().back();
+	}
+
+	inline ContainerElements::const_iterator ContainerElements::begin() const
+	{
+		return read().begin();
+	}
+
+	inline ContainerElements::const_iterator ContainerElements::end() const
+	{
+		return read().end();
+	}
+
+	inline ContainerElements::iterator ContainerElements::begin()
+	{
+		return modify().begin();
+	}
+
+	inline ContainerElements::iterator ContainerElements::end()
+	{
+		return modify().end();
+	}
+
+	inline void ContainerElements::reserve(std::size_t capacity)
+	{
+		modify().reserve(capacity);
+	}
+
+	inline void ContainerElements::push_back(const Value& val)
+	{
+		modify().push_back(val);
+	}
+
+	template<typename... Args>
+	inline void ContainerElements::emplace_back(Args&&... args)
+	{
+		modify().emplace_back(std::forward<Args>(args)...);
+	}
+
+	inline bool ContainerElements::operator==(const ContainerElements& other) const
+	{
+		return elements == other.elements || read() == other.read();
+	}
+
 	const Value BOOL_TRUE(Literal(true), TYPE_BOOL);
 	const Value BOOL_FALSE(Literal(false), TYPE_BOOL);
 	const Value INT_ZERO(Literal(0L), TYPE_INT8);
@@ -303,8 +480,13 @@ namespace vc4c
 	const Value ROTATION_REGISTER(REG_ACC5, TYPE_INT8);
 	const Value MUTEX_REGISTER(REG_MUTEX, TYPE_BOOL);
 
+	/*
+	 * Structural hash for values, consistent with Value#operator==.
+	 *
+	 * In contrast to hashing the string-representation, this never allocates any memory
+	 */
 	template<>
-	struct hash<Value> : public std::hash<std::string>
+	struct hash<Value>
 	{
 		size_t operator()(const Value& ) const noexcept;
 	};
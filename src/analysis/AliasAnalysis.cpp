@@ -0,0 +1,95 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "AliasAnalysis.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+bool analysis::isGlobalData(const Local* local)
+{
+	return local->is<Global>() || local->name == Method::GLOBAL_DATA_ADDRESS;
+}
+
+bool analysis::isVolatileMemory(const Local* base)
+{
+	return base->is<Parameter>() && has_flag(base->as<Parameter>()->decorations, ParameterDecorations::VOLATILE);
+}
+
+bool analysis::isRestrictMemory(const Local* base)
+{
+	//the flag for volatile memory also contains the restrict bit
+	return base->is<Parameter>() && has_flag(base->as<Parameter>()->decorations, ParameterDecorations::RESTRICT) && !isVolatileMemory(base);
+}
+
+bool analysis::isConstantMemory(const Local* base)
+{
+	if(getAddressSpace(base) == AddressSpace::CONSTANT)
+		return true;
+	return base->is<Parameter>() && has_flag(base->as<Parameter>()->decorations, ParameterDecorations::READ_ONLY) && !isVolatileMemory(base);
+}
+
+AddressSpace analysis::getAddressSpace(const Local* base)
+{
+	//the address spaces of other pointers are not reliable, since pointers created by the compiler default to the private address space
+	if((!base->is<Parameter>() && !base->is<Global>()) || !base->type.isPointerType())
+		return AddressSpace::GENERIC;
+	return base->type.getPointerType().get()->addressSpace;
+}
+
+/*
+ * The scalar type pointed to by the parameter, if it is a pointer to a scalar or vector type wider than a char
+ */
+static Optional<DataType> getDeclaredScalarType(const Local* base)
+{
+	if(!base->is<Parameter>() || !base->type.isPointerType())
+		return Optional<DataType>(false, TYPE_UNKNOWN);
+	const DataType& elementType = base->type.getPointerType().get()->elementType;
+	if(elementType.complexType != nullptr || elementType.getScalarBitCount() <= 8)
+		return Optional<DataType>(false, TYPE_UNKNOWN);
+	return elementType.getElementType();
+}
+
+bool analysis::mayAliasBases(const Local* first, const Local* second)
+{
+	if(first == second)
+		return true;
+	//different globals are located at different offsets in the global data segment
+	if(first->is<Global>() && second->is<Global>())
+		return false;
+	//kernel parameters never point into the global data segment
+	if((first->is<Parameter>() && isGlobalData(second)) || (isGlobalData(first) && second->is<Parameter>()))
+		return false;
+	const AddressSpace firstSpace = getAddressSpace(first);
+	const AddressSpace secondSpace = getAddressSpace(second);
+	if(firstSpace != AddressSpace::GENERIC && secondSpace != AddressSpace::GENERIC && firstSpace != secondSpace)
+		return false;
+	if(!first->is<Parameter>() || !second->is<Parameter>())
+		//any other address can be derived from any memory object
+		return true;
+	//a restrict pointer does not alias any other pointer parameter
+	if(isRestrictMemory(first) || isRestrictMemory(second))
+		return false;
+	const Optional<DataType> firstType = getDeclaredScalarType(first);
+	const Optional<DataType> secondType = getDeclaredScalarType(second);
+	if(firstType && secondType && !isVolatileMemory(first) && !isVolatileMemory(second))
+		return firstType.get().isFloatingType() == secondType.get().isFloatingType() && firstType.get().getScalarBitCount() == secondType.get().getScalarBitCount();
+	return true;
+}
+
+AliasResult analysis::getAliasResult(const MemoryLocation& first, const MemoryLocation& second)
+{
+	if(first.base == second.base)
+	{
+		if(first.offset == second.offset && first.size == second.size)
+			return AliasResult::MUST_ALIAS;
+		//the accessed byte ranges overlap
+		if(first.offset < second.offset + static_cast<long>(second.size) && second.offset < first.offset + static_cast<long>(first.size))
+			return AliasResult::MAY_ALIAS;
+		return AliasResult::NO_ALIAS;
+	}
+	return mayAliasBases(first.base, second.base) ? AliasResult::MAY_ALIAS : AliasResult::NO_ALIAS;
+}
@@ -0,0 +1,83 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_ALIAS_ANALYSIS_H
+#define VC4C_ALIAS_ANALYSIS_H
+
+#include "../Module.h"
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * The memory accessed by a memory access, as base and constant byte offset.
+		 *
+		 * The base is either a memory object (a parameter, a global or the global data segment) the address is derived from
+		 * or, if the address has no known base and offset, the local of the address itself.
+		 */
+		struct MemoryLocation
+		{
+			const Local* base;
+			long offset;
+			unsigned size;
+		};
+
+		enum class AliasResult
+		{
+			//the locations never refer to the same memory
+			NO_ALIAS,
+			//the locations might overlap
+			MAY_ALIAS,
+			//the locations refer to exactly the same memory
+			MUST_ALIAS
+		};
+
+		/*
+		 * Whether the local is a global or the address of the global data segment the globals are located in
+		 */
+		bool isGlobalData(const Local* local);
+		/*
+		 * Whether the local is a parameter pointing to volatile memory
+		 */
+		bool isVolatileMemory(const Local* base);
+		/*
+		 * Whether the local is a restrict parameter, whose memory is only accessed via this parameter
+		 */
+		bool isRestrictMemory(const Local* base);
+		/*
+		 * Whether the memory of the local is not modified while the kernel executes, e.g. __constant memory or read-only parameters
+		 */
+		bool isConstantMemory(const Local* base);
+		/*
+		 * The address space of the memory object the base refers to, GENERIC if it is not known (e.g. for the global data segment and the locals of addresses)
+		 */
+		AddressSpace getAddressSpace(const Local* base);
+
+		/*
+		 * Whether the memory objects referred to by the two (different) bases can overlap:
+		 * - different globals are located at different offsets of the global data segment, which is never pointed to by kernel parameters
+		 * - memory objects in different (known) address spaces are disjoint
+		 * - the memory of a restrict parameter is not accessed via any other parameter
+		 * - parameters pointing to scalars of different types (except char) do not point to the same memory, since accessing memory via a different type
+		 *   is undefined behavior. Only the declared types of the parameters are used, since the types of the accesses may be changed by the front-end
+		 */
+		bool mayAliasBases(const Local* first, const Local* second);
+
+		/*
+		 * Determines whether the two locations refer to the same memory, the byte-ranges of locations with the same base are compared,
+		 * locations with different bases are checked via #mayAliasBases
+		 */
+		AliasResult getAliasResult(const MemoryLocation& first, const MemoryLocation& second);
+
+		inline bool mayAlias(const MemoryLocation& first, const MemoryLocation& second)
+		{
+			return getAliasResult(first, second) != AliasResult::NO_ALIAS;
+		}
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_ALIAS_ANALYSIS_H */
@@ -0,0 +1,151 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "AnalysisManager.h"
+#include "../Profiler.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+AnalysisManager::AnalysisManager(Method& method) : method(method)
+{
+}
+
+const ControlFlowGraph& AnalysisManager::getControlFlowGraph()
+{
+	if(!cfg)
+	{
+		PROFILE_START(createCFG);
+		cfg.reset(new ControlFlowGraph(ControlFlowGraph::createCFG(method)));
+		PROFILE_END(createCFG);
+	}
+	return *cfg;
+}
+
+const DominatorTree& AnalysisManager::getDominatorTree()
+{
+	const ControlFlowGraph& graph = getControlFlowGraph();
+	if(!dominators || dominatorsVersion != graph.getVersion())
+	{
+		PROFILE_START(createDominatorTree);
+		dominators.reset(new DominatorTree(DominatorTree::createDominatorTree(graph)));
+		dominatorsVersion = graph.getVersion();
+		PROFILE_END(createDominatorTree);
+	}
+	return *dominators;
+}
+
+const LivenessAnalysis& AnalysisManager::getLiveness()
+{
+	const ControlFlowGraph& graph = getControlFlowGraph();
+	if(!liveness || livenessVersion != graph.getVersion())
+	{
+		PROFILE_START(createLiveness);
+		liveness.reset(new LivenessAnalysis(LivenessAnalysis::createLiveness(method, graph)));
+		livenessVersion = graph.getVersion();
+		PROFILE_END(createLiveness);
+	}
+	return *liveness;
+}
+
+const LoopAnalysis& AnalysisManager::getLoops()
+{
+	const ControlFlowGraph& graph = getControlFlowGraph();
+	const DominatorTree& tree = getDominatorTree();
+	if(!loops || loopsVersion != graph.getVersion())
+	{
+		PROFILE_START(createLoops);
+		loops.reset(new LoopAnalysis(LoopAnalysis::createLoops(graph, tree)));
+		loopsVersion = graph.getVersion();
+		PROFILE_END(createLoops);
+	}
+	return *loops;
+}
+
+const DivergenceAnalysis& AnalysisManager::getDivergence()
+{
+	const ControlFlowGraph& graph = getControlFlowGraph();
+	if(!divergence || divergenceVersion != graph.getVersion())
+	{
+		PROFILE_START(createDivergence);
+		divergence.reset(new DivergenceAnalysis(DivergenceAnalysis::createDivergence(method, graph)));
+		divergenceVersion = graph.getVersion();
+		PROFILE_END(createDivergence);
+	}
+	return *divergence;
+}
+
+const ValueRangeAnalysis& AnalysisManager::getValueRanges()
+{
+	//the ranges do not depend on the control-flow, only on the instructions
+	if(!valueRanges)
+	{
+		PROFILE_START(createValueRanges);
+		valueRanges.reset(new ValueRangeAnalysis(ValueRangeAnalysis::createValueRanges(method)));
+		PROFILE_END(createValueRanges);
+	}
+	return *valueRanges;
+}
+
+const FlagsAnalysis& AnalysisManager::getFlags()
+{
+	const ControlFlowGraph& graph = getControlFlowGraph();
+	if(!flags || flagsVersion != graph.getVersion())
+	{
+		PROFILE_START(createFlags);
+		flags.reset(new FlagsAnalysis(FlagsAnalysis::createFlags(method, graph)));
+		flagsVersion = graph.getVersion();
+		PROFILE_END(createFlags);
+	}
+	return *flags;
+}
+
+const InstructionNumbering& AnalysisManager::getNumbering()
+{
+	if(!numbering || !numbering->isUpToDate(method))
+	{
+		PROFILE_START(createNumbering);
+		numbering.reset(new InstructionNumbering(InstructionNumbering::createNumbering(method)));
+		PROFILE_END(createNumbering);
+	}
+	return *numbering;
+}
+
+void AnalysisManager::invalidate(AnalysisType analyses)
+{
+	//the other analyses are calculated on top of the control-flow graph
+	if(has_flag(analyses, AnalysisType::CONTROL_FLOW_GRAPH))
+		analyses = AnalysisType::ALL;
+	if(has_flag(analyses, AnalysisType::CONTROL_FLOW_GRAPH))
+		cfg.reset();
+	if(has_flag(analyses, AnalysisType::DOMINATOR_TREE))
+		dominators.reset();
+	if(has_flag(analyses, AnalysisType::LIVENESS))
+		liveness.reset();
+	if(has_flag(analyses, AnalysisType::LOOPS))
+		loops.reset();
+	if(has_flag(analyses, AnalysisType::DIVERGENCE))
+		divergence.reset();
+	if(has_flag(analyses, AnalysisType::VALUE_RANGES))
+		valueRanges.reset();
+	if(has_flag(analyses, AnalysisType::FLAGS))
+		flags.reset();
+	if(has_flag(analyses, AnalysisType::NUMBERING))
+		numbering.reset();
+}
+
+void AnalysisManager::blockModified(BasicBlock& block)
+{
+	//the dependent analyses detect the changed graph by its version
+	if(cfg)
+		cfg->updateBlock(block);
+}
+
+void AnalysisManager::blockAdded(BasicBlock& block, BasicBlock* previousBlock)
+{
+	if(cfg)
+		cfg->addBlock(block, previousBlock);
+}
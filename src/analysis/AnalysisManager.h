@@ -0,0 +1,97 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_ANALYSIS_MANAGER_H
+#define VC4C_ANALYSIS_MANAGER_H
+
+#include "ControlFlowGraph.h"
+#include "DivergenceAnalysis.h"
+#include "DominatorTree.h"
+#include "FlagsAnalysis.h"
+#include "InstructionNumbering.h"
+#include "LivenessAnalysis.h"
+#include "LoopAnalysis.h"
+#include "ValueRange.h"
+
+#include <memory>
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		enum class AnalysisType : unsigned char
+		{
+			NONE = 0,
+			CONTROL_FLOW_GRAPH = 1,
+			DOMINATOR_TREE = 2,
+			LIVENESS = 4,
+			LOOPS = 8,
+			DIVERGENCE = 16,
+			VALUE_RANGES = 32,
+			FLAGS = 64,
+			NUMBERING = 128,
+			ALL = 255
+		};
+
+		/*
+		 * Caches the analyses of a single method, so they are only calculated again after they were invalidated.
+		 *
+		 * Optimization passes declare the analyses they preserve, all other analyses are invalidated after the pass ran.
+		 * Passes which modify the method need to invalidate the affected analyses themselves, before they use an analysis again.
+		 * The control-flow graph is an exception, it is updated by the method itself when blocks or branches change.
+		 */
+		class AnalysisManager : private NonCopyable
+		{
+		public:
+			explicit AnalysisManager(Method& method);
+
+			const ControlFlowGraph& getControlFlowGraph();
+			const DominatorTree& getDominatorTree();
+			const LivenessAnalysis& getLiveness();
+			const LoopAnalysis& getLoops();
+			const DivergenceAnalysis& getDivergence();
+			const ValueRangeAnalysis& getValueRanges();
+			const FlagsAnalysis& getFlags();
+			/*
+			 * The numbering is created again, if the instructions of the method were modified since it was created
+			 */
+			const InstructionNumbering& getNumbering();
+
+			/*
+			 * Drops the cached results of the given analyses and all analyses depending on them
+			 */
+			void invalidate(AnalysisType analyses = AnalysisType::ALL);
+
+			/*
+			 * Notifies the analyses about a branch being added to or removed from the given block
+			 */
+			void blockModified(BasicBlock& block);
+			/*
+			 * Notifies the analyses about the given block being inserted after the previous block (or at the start of the method, if the previous block is not set)
+			 */
+			void blockAdded(BasicBlock& block, BasicBlock* previousBlock);
+
+		private:
+			Method& method;
+			std::unique_ptr<ControlFlowGraph> cfg;
+			std::unique_ptr<DominatorTree> dominators;
+			std::unique_ptr<LivenessAnalysis> liveness;
+			std::unique_ptr<LoopAnalysis> loops;
+			std::unique_ptr<DivergenceAnalysis> divergence;
+			std::unique_ptr<ValueRangeAnalysis> valueRanges;
+			std::unique_ptr<FlagsAnalysis> flags;
+			std::unique_ptr<InstructionNumbering> numbering;
+			//the versions of the control-flow graph the analyses were calculated for
+			std::size_t dominatorsVersion = 0;
+			std::size_t livenessVersion = 0;
+			std::size_t loopsVersion = 0;
+			std::size_t divergenceVersion = 0;
+			std::size_t flagsVersion = 0;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_ANALYSIS_MANAGER_H */
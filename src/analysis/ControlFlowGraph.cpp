@@ -0,0 +1,233 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "ControlFlowGraph.h"
+
+#include "../asm/DebugGraph.h"
+
+#include <algorithm>
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+InstructionWalker CFGPredecessor::getLastInstruction() const
+{
+	if(isFallThrough)
+		return block->end().previousInBlock();
+	return branch;
+}
+
+ControlFlowGraph ControlFlowGraph::createCFG(Method& method)
+{
+	ControlFlowGraph graph;
+	BasicBlock* prevBlock = nullptr;
+	for(BasicBlock& bb : method.getBasicBlocks())
+	{
+		CFGNode& node = graph.nodes[&bb];
+		node.previousBlock = prevBlock;
+		if(prevBlock != nullptr)
+			graph.nodes.at(prevBlock).nextBlock = &bb;
+		else
+			graph.startBlock = &bb;
+		graph.blocksByLabel.emplace(bb.getLabel()->getLabel(), &bb);
+		prevBlock = &bb;
+	}
+	//a single pass over all instructions to find all branches
+	for(BasicBlock& bb : method.getBasicBlocks())
+		graph.addOutgoingEdges(bb);
+	return graph;
+}
+
+const std::vector<BasicBlock*>& ControlFlowGraph::getSuccessors(const BasicBlock& block) const
+{
+	return assertNode(block).successors;
+}
+
+const std::vector<CFGPredecessor>& ControlFlowGraph::getPredecessors(const BasicBlock& block) const
+{
+	return assertNode(block).predecessors;
+}
+
+const std::vector<BasicBlock*>& ControlFlowGraph::getReversePostOrder() const
+{
+	if(reversePostOrderVersion == version)
+		return reversePostOrder;
+	reversePostOrder.clear();
+	reversePostOrderVersion = version;
+	if(startBlock == nullptr)
+		return reversePostOrder;
+	//iterative depth-first search to determine the post-order
+	FastSet<const BasicBlock*> visitedBlocks;
+	//the block and the index of its next successor to visit
+	std::vector<std::pair<BasicBlock*, std::size_t>> stack;
+	stack.emplace_back(startBlock, 0);
+	visitedBlocks.emplace(startBlock);
+	while(!stack.empty())
+	{
+		auto& top = stack.back();
+		const std::vector<BasicBlock*>& successors = assertNode(*top.first).successors;
+		if(top.second < successors.size())
+		{
+			BasicBlock* next = successors[top.second];
+			++top.second;
+			if(visitedBlocks.emplace(next).second)
+				stack.emplace_back(next, 0);
+		}
+		else
+		{
+			reversePostOrder.push_back(top.first);
+			stack.pop_back();
+		}
+	}
+	std::reverse(reversePostOrder.begin(), reversePostOrder.end());
+	return reversePostOrder;
+}
+
+BasicBlock* ControlFlowGraph::findBlock(const Local* label) const
+{
+	auto it = blocksByLabel.find(label);
+	if(it == blocksByLabel.end())
+		return nullptr;
+	return it->second;
+}
+
+std::size_t ControlFlowGraph::getVersion() const
+{
+	return version;
+}
+
+void ControlFlowGraph::updateBlock(BasicBlock& block)
+{
+	removeOutgoingEdges(block);
+	addOutgoingEdges(block);
+}
+
+void ControlFlowGraph::addBlock(BasicBlock& block, BasicBlock* previousBlock)
+{
+	const Local* label = block.getLabel()->getLabel();
+	CFGNode& node = nodes[&block];
+	blocksByLabel[label] = &block;
+	node.previousBlock = previousBlock;
+	if(previousBlock != nullptr)
+	{
+		CFGNode& prevNode = assertNode(*previousBlock);
+		node.nextBlock = prevNode.nextBlock;
+		prevNode.nextBlock = &block;
+	}
+	else
+	{
+		node.nextBlock = startBlock;
+		startBlock = &block;
+	}
+	if(node.nextBlock != nullptr)
+		assertNode(*node.nextBlock).previousBlock = &block;
+
+	//the previous block now falls through to the new block and might have had some of its branches moved to the new block
+	if(previousBlock != nullptr)
+		updateBlock(*previousBlock);
+	//connect all other branches already jumping to the new block
+	auto unresolvedIt = unresolvedBranches.find(label);
+	if(unresolvedIt != unresolvedBranches.end())
+	{
+		for(InstructionWalker& branch : unresolvedIt->second)
+		{
+			BasicBlock* source = branch.getBasicBlock();
+			addEdge(*source, block, CFGPredecessor{source, branch, false});
+			std::vector<const Local*>& sourceTargets = assertNode(*source).unresolvedTargets;
+			sourceTargets.erase(std::find(sourceTargets.begin(), sourceTargets.end(), label));
+		}
+		unresolvedBranches.erase(unresolvedIt);
+	}
+	addOutgoingEdges(block);
+}
+
+void ControlFlowGraph::dumpGraph(const std::string& fileName, const std::size_t maxNodes) const
+{
+	//Graphviz (http://graphviz.org/) graph, generate SVG with: "dot -Tsvg <input>.dot -o <output>.svg"
+	qpu_asm::DebugGraph<const BasicBlock*> graph(fileName, maxNodes, true);
+	const std::function<std::string(const BasicBlock* const&)> nameFunc = [](const BasicBlock* const& block) -> std::string
+	{
+		return block->getLabel()->getLabel()->name;
+	};
+	for(const auto& pair : nodes)
+	{
+		if(graph.isFull())
+			break;
+		for(const BasicBlock* successor : pair.second.successors)
+			graph.addEdge(pair.first, successor, nameFunc);
+	}
+}
+
+ControlFlowGraph::CFGNode& ControlFlowGraph::assertNode(const BasicBlock& block)
+{
+	auto it = nodes.find(&block);
+	if(it == nodes.end())
+		throw CompilationError(CompilationStep::GENERAL, "Basic block is not part of the control-flow graph", block.getLabel()->to_string());
+	return it->second;
+}
+
+const ControlFlowGraph::CFGNode& ControlFlowGraph::assertNode(const BasicBlock& block) const
+{
+	auto it = nodes.find(&block);
+	if(it == nodes.end())
+		throw CompilationError(CompilationStep::GENERAL, "Basic block is not part of the control-flow graph", block.getLabel()->to_string());
+	return it->second;
+}
+
+void ControlFlowGraph::addEdge(BasicBlock& predecessor, BasicBlock& successor, const CFGPredecessor& edge)
+{
+	std::vector<BasicBlock*>& successors = assertNode(predecessor).successors;
+	if(std::find(successors.begin(), successors.end(), &successor) == successors.end())
+		successors.push_back(&successor);
+	assertNode(successor).predecessors.push_back(edge);
+	++version;
+}
+
+void ControlFlowGraph::removeOutgoingEdges(BasicBlock& block)
+{
+	CFGNode& node = assertNode(block);
+	for(BasicBlock* successor : node.successors)
+	{
+		std::vector<CFGPredecessor>& preds = assertNode(*successor).predecessors;
+		preds.erase(std::remove_if(preds.begin(), preds.end(), [&block](const CFGPredecessor& pred) -> bool { return pred.block == &block;}), preds.end());
+	}
+	node.successors.clear();
+	for(const Local* label : node.unresolvedTargets)
+	{
+		auto unresolvedIt = unresolvedBranches.find(label);
+		if(unresolvedIt == unresolvedBranches.end())
+			continue;
+		std::vector<InstructionWalker>& branches = unresolvedIt->second;
+		branches.erase(std::remove_if(branches.begin(), branches.end(), [&block](InstructionWalker& branch) -> bool { return branch.getBasicBlock() == &block;}), branches.end());
+		if(branches.empty())
+			unresolvedBranches.erase(unresolvedIt);
+	}
+	node.unresolvedTargets.clear();
+	++version;
+}
+
+void ControlFlowGraph::addOutgoingEdges(BasicBlock& block)
+{
+	CFGNode& node = assertNode(block);
+	for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+	{
+		const intermediate::Branch* br = it.get<const intermediate::Branch>();
+		if(br == nullptr)
+			continue;
+		auto targetIt = blocksByLabel.find(br->getTarget());
+		if(targetIt != blocksByLabel.end())
+			addEdge(block, *targetIt->second, CFGPredecessor{&block, it, false});
+		else
+		{
+			//the block for the label might be added later
+			unresolvedBranches[br->getTarget()].push_back(it);
+			node.unresolvedTargets.push_back(br->getTarget());
+		}
+	}
+	if(node.nextBlock != nullptr && block.fallsThroughToNextBlock())
+		addEdge(block, *node.nextBlock, CFGPredecessor{&block, InstructionWalker{}, true});
+	++version;
+}
@@ -0,0 +1,113 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_CONTROL_FLOW_GRAPH_H
+#define VC4C_CONTROL_FLOW_GRAPH_H
+
+#include "../InstructionWalker.h"
+
+#include <vector>
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * A control-flow edge into a basic block
+		 */
+		struct CFGPredecessor
+		{
+			//the block the control-flow comes from
+			BasicBlock* block;
+			//the branch jumping to the successor, if the control-flow does not fall through
+			InstructionWalker branch;
+			bool isFallThrough;
+
+			/*
+			 * Returns the last instruction executed in the predecessor before the control-flow reaches the successor.
+			 *
+			 * For fall-through edges, this is determined on every call, since the last instruction of a block can be modified without changing the control-flow
+			 */
+			InstructionWalker getLastInstruction() const;
+		};
+
+		/*
+		 * The successors and predecessors of all basic blocks of a method.
+		 *
+		 * Once created, the graph is kept up to date by the method, when basic blocks are added or branches are inserted, replaced or removed.
+		 * NOTE: Any other modification is assumed to not change whether a block falls through to the next block.
+		 */
+		class ControlFlowGraph
+		{
+		public:
+			static ControlFlowGraph createCFG(Method& method);
+
+			/*
+			 * The blocks directly following the given block, every block is listed at most once
+			 */
+			const std::vector<BasicBlock*>& getSuccessors(const BasicBlock& block) const;
+			/*
+			 * All edges into the given block
+			 */
+			const std::vector<CFGPredecessor>& getPredecessors(const BasicBlock& block) const;
+			/*
+			 * The blocks reachable from the start of the method in reverse post-order, e.g. every block is listed before its successors (except for back-edges)
+			 */
+			const std::vector<BasicBlock*>& getReversePostOrder() const;
+			/*
+			 * Returns the basic block starting with the given label, if any
+			 */
+			BasicBlock* findBlock(const Local* label) const;
+			/*
+			 * Increased on every modification of the graph, so analyses calculated on top of it can detect whether they are outdated
+			 */
+			std::size_t getVersion() const;
+
+			/*
+			 * Re-calculates the outgoing edges of the given block, after branches were added to or removed from it
+			 */
+			void updateBlock(BasicBlock& block);
+			/*
+			 * Adds the newly inserted block (directly after the given previous block, if any) and its edges
+			 */
+			void addBlock(BasicBlock& block, BasicBlock* previousBlock);
+
+			/*
+			 * Writes the graph asynchronously as Graphviz graph into the given file, with the successors of at most the given number of blocks (0 for all)
+			 */
+			void dumpGraph(const std::string& fileName, std::size_t maxNodes) const;
+
+		private:
+			struct CFGNode
+			{
+				std::vector<BasicBlock*> successors;
+				std::vector<CFGPredecessor> predecessors;
+				//the neighbors in the order of the blocks within the method, required for the fall-through edges
+				BasicBlock* previousBlock = nullptr;
+				BasicBlock* nextBlock = nullptr;
+				//the targets of branches out of this block, for which there is no block (yet)
+				std::vector<const Local*> unresolvedTargets;
+			};
+
+			FastMap<const BasicBlock*, CFGNode> nodes;
+			FastMap<const Local*, BasicBlock*> blocksByLabel;
+			//the branches jumping to labels which (not yet) start a block
+			FastMap<const Local*, std::vector<InstructionWalker>> unresolvedBranches;
+			BasicBlock* startBlock = nullptr;
+			std::size_t version = 0;
+			mutable std::vector<BasicBlock*> reversePostOrder;
+			mutable std::size_t reversePostOrderVersion = SIZE_MAX;
+
+			CFGNode& assertNode(const BasicBlock& block);
+			const CFGNode& assertNode(const BasicBlock& block) const;
+			void addEdge(BasicBlock& predecessor, BasicBlock& successor, const CFGPredecessor& edge);
+			void removeOutgoingEdges(BasicBlock& block);
+			void addOutgoingEdges(BasicBlock& block);
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_CONTROL_FLOW_GRAPH_H */
@@ -0,0 +1,101 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "DivergenceAnalysis.h"
+#include "../intermediate/IntermediateInstruction.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+/*
+ * Whether the instruction directly produces a different value for every work-item
+ */
+static bool isDivergenceSource(const intermediate::IntermediateInstruction* instr)
+{
+	if(has_flag(instr->decoration, intermediate::InstructionDecorations::BUILTIN_LOCAL_ID) || has_flag(instr->decoration, intermediate::InstructionDecorations::BUILTIN_GLOBAL_ID))
+		return true;
+	const intermediate::MethodCall* call = dynamic_cast<const intermediate::MethodCall*>(instr);
+	return call != nullptr && (call->methodName.compare("vc4cl_local_id") == 0 || call->methodName.compare("vc4cl_global_id") == 0);
+}
+
+DivergenceAnalysis DivergenceAnalysis::createDivergence(Method& method, const ControlFlowGraph& cfg)
+{
+	DivergenceAnalysis analysis;
+	//the blocks only executed by some of the work-items, e.g. reachable from a divergent branch
+	FastSet<const BasicBlock*> divergentBlocks;
+	bool changed = true;
+	//the divergences are propagated until nothing changes anymore, since loops can pass divergent values back to the start
+	while(changed)
+	{
+		changed = false;
+		for(BasicBlock& bb : method.getBasicBlocks())
+		{
+			const bool isDivergentBlock = divergentBlocks.find(&bb) != divergentBlocks.end();
+			//whether the flags are currently set from a divergent value
+			bool hasDivergentFlags = false;
+			for(auto it = bb.begin(); !it.isEndOfBlock(); it.nextInBlock())
+			{
+				if(it.get() == nullptr)
+					continue;
+				bool isDivergent = isDivergenceSource(it.get()) || std::any_of(it->getArguments().begin(), it->getArguments().end(), [&analysis](const Value& arg) -> bool { return analysis.isDivergent(arg);});
+				if(it->setFlags == SetFlag::SET_FLAGS)
+					hasDivergentFlags = isDivergent;
+				isDivergent = isDivergent || (it->conditional != COND_ALWAYS && hasDivergentFlags);
+				if(it.has<intermediate::Branch>())
+				{
+					if(it->conditional != COND_ALWAYS && isDivergent && analysis.divergentBranches.emplace(it.get<intermediate::Branch>()).second)
+					{
+						changed = true;
+						//all blocks reachable from the branch are only executed by some of the work-items
+						std::vector<const BasicBlock*> openBlocks(cfg.getSuccessors(bb).begin(), cfg.getSuccessors(bb).end());
+						while(!openBlocks.empty())
+						{
+							const BasicBlock* block = openBlocks.back();
+							openBlocks.pop_back();
+							if(divergentBlocks.emplace(block).second)
+								openBlocks.insert(openBlocks.end(), cfg.getSuccessors(*block).begin(), cfg.getSuccessors(*block).end());
+						}
+					}
+					continue;
+				}
+				if(!it->hasValueType(ValueType::LOCAL))
+					continue;
+				const Local* output = it->getOutput().get().local;
+				//the values of locals written on several paths (e.g. phi-nodes) depend on the path taken by the work-item
+				if(isDivergentBlock && output->getUsers().getNumWriters() > 1)
+					isDivergent = true;
+				if(isDivergent && analysis.divergentLocals.emplace(output).second)
+					changed = true;
+			}
+		}
+	}
+	return analysis;
+}
+
+bool DivergenceAnalysis::isDivergent(const Local* local) const
+{
+	return local->name == Method::LOCAL_IDS || divergentLocals.find(local) != divergentLocals.end();
+}
+
+bool DivergenceAnalysis::isDivergent(const Value& value) const
+{
+	if(value.hasType(ValueType::LOCAL))
+		return isDivergent(value.local);
+	//e.g. the element number or the values read from memory
+	if(value.hasType(ValueType::REGISTER))
+		return value.reg != REG_UNIFORM && value.reg != REG_NOP;
+	return false;
+}
+
+bool DivergenceAnalysis::isDivergent(const intermediate::Branch* branch) const
+{
+	return divergentBranches.find(branch) != divergentBranches.end();
+}
+
+bool DivergenceAnalysis::hasDivergentControlFlow() const
+{
+	return !divergentBranches.empty();
+}
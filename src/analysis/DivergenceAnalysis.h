@@ -0,0 +1,61 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_DIVERGENCE_ANALYSIS_H
+#define VC4C_DIVERGENCE_ANALYSIS_H
+
+#include "ControlFlowGraph.h"
+
+namespace vc4c
+{
+	namespace intermediate
+	{
+		class Branch;
+	} /* namespace intermediate */
+
+	namespace analysis
+	{
+		/*
+		 * The locals and branches whose values (or directions) can differ between the work-items of a work-group.
+		 *
+		 * A value is divergent, if it depends on the local or global id of the work-item, is read from a register (other than the UNIFORMs),
+		 * is written conditionally on divergent flags or is merged from different paths after a divergent branch.
+		 * All other values are uniform, e.g. are calculated only from literals, parameters and work-group information.
+		 *
+		 * Work-items can only be mapped onto the SIMD elements of a single QPU execution, if all branches are uniform,
+		 * since the elements execute the same instruction stream.
+		 */
+		class DivergenceAnalysis
+		{
+		public:
+			static DivergenceAnalysis createDivergence(Method& method, const ControlFlowGraph& cfg);
+
+			/*
+			 * Whether the value of the local can be different for the work-items
+			 */
+			bool isDivergent(const Local* local) const;
+			/*
+			 * Whether the value can be different for the work-items, literals and the UNIFORMs are never divergent
+			 */
+			bool isDivergent(const Value& value) const;
+			/*
+			 * Whether the branch can be taken by some work-items and not taken by others
+			 */
+			bool isDivergent(const intermediate::Branch* branch) const;
+
+			/*
+			 * Whether the control-flow (in contrast to only the values) is different for the work-items
+			 */
+			bool hasDivergentControlFlow() const;
+
+		private:
+			FastSet<const Local*> divergentLocals;
+			FastSet<const intermediate::Branch*> divergentBranches;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_DIVERGENCE_ANALYSIS_H */
@@ -0,0 +1,86 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "DominatorTree.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+static const std::size_t UNDEFINED_DOMINATOR = SIZE_MAX;
+
+static std::size_t intersect(const std::vector<std::size_t>& dominators, std::size_t first, std::size_t second)
+{
+	//walks up the tree until both paths meet, the reverse post-order index of a dominator is always smaller than the one of the dominated block
+	while(first != second)
+	{
+		while(first > second)
+			first = dominators[first];
+		while(second > first)
+			second = dominators[second];
+	}
+	return first;
+}
+
+DominatorTree DominatorTree::createDominatorTree(const ControlFlowGraph& cfg)
+{
+	DominatorTree tree;
+	const std::vector<BasicBlock*>& order = cfg.getReversePostOrder();
+	tree.blocks.assign(order.begin(), order.end());
+	for(std::size_t i = 0; i < order.size(); ++i)
+		tree.indices.emplace(order[i], i);
+	if(order.empty())
+		return tree;
+
+	tree.immediateDominators.assign(order.size(), UNDEFINED_DOMINATOR);
+	tree.immediateDominators[0] = 0;
+	bool changed = true;
+	while(changed)
+	{
+		changed = false;
+		for(std::size_t i = 1; i < order.size(); ++i)
+		{
+			std::size_t newDominator = UNDEFINED_DOMINATOR;
+			for(const CFGPredecessor& pred : cfg.getPredecessors(*order[i]))
+			{
+				auto predIt = tree.indices.find(pred.block);
+				//skip unreachable and not yet processed predecessors
+				if(predIt == tree.indices.end() || tree.immediateDominators[predIt->second] == UNDEFINED_DOMINATOR)
+					continue;
+				if(newDominator == UNDEFINED_DOMINATOR)
+					newDominator = predIt->second;
+				else
+					newDominator = intersect(tree.immediateDominators, predIt->second, newDominator);
+			}
+			if(newDominator != tree.immediateDominators[i])
+			{
+				tree.immediateDominators[i] = newDominator;
+				changed = true;
+			}
+		}
+	}
+	return tree;
+}
+
+const BasicBlock* DominatorTree::getImmediateDominator(const BasicBlock& block) const
+{
+	auto it = indices.find(&block);
+	if(it == indices.end() || it->second == 0)
+		return nullptr;
+	return blocks[immediateDominators[it->second]];
+}
+
+bool DominatorTree::dominates(const BasicBlock& dominator, const BasicBlock& block) const
+{
+	auto domIt = indices.find(&dominator);
+	auto blockIt = indices.find(&block);
+	if(domIt == indices.end() || blockIt == indices.end())
+		return false;
+	std::size_t index = blockIt->second;
+	//the dominators have smaller indices, so we can stop as soon as we passed the index of the dominator
+	while(index > domIt->second)
+		index = immediateDominators[index];
+	return index == domIt->second;
+}
@@ -0,0 +1,45 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_DOMINATOR_TREE_H
+#define VC4C_DOMINATOR_TREE_H
+
+#include "ControlFlowGraph.h"
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * The immediate dominators of all basic blocks reachable from the start of the method.
+		 *
+		 * Uses the algorithm from "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy
+		 */
+		class DominatorTree
+		{
+		public:
+			static DominatorTree createDominatorTree(const ControlFlowGraph& cfg);
+
+			/*
+			 * Returns the immediate dominator of the given block, nullptr for the start block and blocks not reachable from it
+			 */
+			const BasicBlock* getImmediateDominator(const BasicBlock& block) const;
+			/*
+			 * Whether every path from the start of the method to block passes through dominator (every block dominates itself)
+			 */
+			bool dominates(const BasicBlock& dominator, const BasicBlock& block) const;
+
+		private:
+			//the index of the block in the reverse post-order
+			FastMap<const BasicBlock*, std::size_t> indices;
+			//the reverse post-order index of the immediate dominator per reverse post-order index
+			std::vector<std::size_t> immediateDominators;
+			std::vector<const BasicBlock*> blocks;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_DOMINATOR_TREE_H */
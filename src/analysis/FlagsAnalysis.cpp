@@ -0,0 +1,253 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "FlagsAnalysis.h"
+#include "../intermediate/IntermediateInstruction.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+/*
+ * Whether the argument has the same value whenever it is read, as long as it is not written, e.g. no periphery register
+ */
+static bool isStableArgument(const Value& arg)
+{
+	if(arg.hasType(ValueType::REGISTER))
+		return arg.reg == REG_ELEMENT_NUMBER || arg.reg == REG_QPU_NUMBER;
+	return arg.hasType(ValueType::LOCAL) || arg.hasType(ValueType::LITERAL) || arg.hasType(ValueType::SMALL_IMMEDIATE);
+}
+
+/*
+ * Whether the flags set by the instruction are tracked, i.e. it is a single unconditional operation or move
+ */
+static bool isTrackedSetter(InstructionWalker it)
+{
+	return (it.has<intermediate::Operation>() || (it.has<intermediate::MoveOperation>() && !it.has<intermediate::VectorRotation>())) &&
+			it->conditional == COND_ALWAYS && it->setFlags == SetFlag::SET_FLAGS && !it->hasPackMode();
+}
+
+/*
+ * Whether both instructions calculate the same flags, if their arguments have the same values
+ */
+static bool isSameFlagsCalculation(const intermediate::IntermediateInstruction* first, const intermediate::IntermediateInstruction* second)
+{
+	if(first->kind != second->kind || first->unpackMode != second->unpackMode || first->packMode != second->packMode || first->getArguments() != second->getArguments())
+		return false;
+	const intermediate::Operation* firstOp = dynamic_cast<const intermediate::Operation*>(first);
+	const intermediate::Operation* secondOp = dynamic_cast<const intermediate::Operation*>(second);
+	if((firstOp == nullptr) != (secondOp == nullptr) || (firstOp != nullptr && firstOp->opCode != secondOp->opCode))
+		return false;
+	return std::all_of(first->getArguments().begin(), first->getArguments().end(), isStableArgument);
+}
+
+static bool readsFlags(InstructionWalker it)
+{
+	return it.anyInstructionMatches([](const intermediate::IntermediateInstruction* instr) -> bool { return instr->conditional != COND_ALWAYS;});
+}
+
+static bool setsFlags(InstructionWalker it)
+{
+	//the flags are not preserved across a thread switch
+	return it->signal == Signaling::THREAD_SWITCH || it->signal == Signaling::LAST_THREAD_SWITCH || it.has<intermediate::MethodCall>() ||
+			it.anyInstructionMatches([](const intermediate::IntermediateInstruction* instr) -> bool { return instr->setFlags == SetFlag::SET_FLAGS;});
+}
+
+FlagsAnalysis FlagsAnalysis::createFlags(Method& method, const ControlFlowGraph& cfg)
+{
+	FlagsAnalysis analysis;
+	const FlagsState unknown{nullptr, false};
+
+	//applies the instructions of the block to the flags at its start, optionally recording the state at every instruction
+	const auto processBlock = [&analysis, &unknown](BasicBlock& block, FlagsState state, bool record) -> FlagsState
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has())
+				continue;
+			if(record && state.setter != nullptr)
+				analysis.flagsStates.emplace(it.get(), state);
+			if(setsFlags(it))
+			{
+				if(!isTrackedSetter(it))
+					state = unknown;
+				else if(state.setter != nullptr && state.argumentsUnchanged && isSameFlagsCalculation(state.setter, it.get()))
+				{
+					//the flags stay set by the first instruction
+					if(record)
+						analysis.redundantSetters.emplace(it.get());
+				}
+				else
+					state = FlagsState{it.get(), true};
+			}
+			if(state.setter != nullptr && state.argumentsUnchanged)
+			{
+				const intermediate::IntermediateInstruction* setter = state.setter;
+				it->forUsedLocals([&state, setter](const Local* local, LocalUser::Type type) -> void
+				{
+					if(has_flag(type, LocalUser::Type::WRITER) && setter->readsLocal(local))
+						state.argumentsUnchanged = false;
+				});
+			}
+		}
+		return state;
+	};
+
+	//the flags at the end of the blocks, a missing entry means the block was not yet visited (and does not restrict the flags of its successors)
+	FastMap<const BasicBlock*, FlagsState> exitStates;
+	const auto getEntryState = [&cfg, &exitStates, &unknown](const BasicBlock& block, bool isStart) -> FlagsState
+	{
+		if(isStart)
+			return unknown;
+		bool isFirst = true;
+		FlagsState state = unknown;
+		for(const CFGPredecessor& pred : cfg.getPredecessors(block))
+		{
+			auto it = exitStates.find(pred.block);
+			if(it == exitStates.end())
+				continue;
+			if(isFirst)
+				state = it->second;
+			else if(state.setter != it->second.setter)
+				return unknown;
+			else
+				state.argumentsUnchanged = state.argumentsUnchanged && it->second.argumentsUnchanged;
+			isFirst = false;
+		}
+		return state;
+	};
+	const std::vector<BasicBlock*>& blocks = cfg.getReversePostOrder();
+	bool changed = true;
+	//the states are propagated until they do not change anymore, since the flags set in a loop can reach the start of the loop again
+	while(changed)
+	{
+		changed = false;
+		for(BasicBlock* block : blocks)
+		{
+			const FlagsState exit = processBlock(*block, getEntryState(*block, block == blocks.front()), false);
+			auto it = exitStates.find(block);
+			if(it == exitStates.end() || it->second.setter != exit.setter || it->second.argumentsUnchanged != exit.argumentsUnchanged)
+			{
+				exitStates[block] = exit;
+				changed = true;
+			}
+		}
+	}
+	for(BasicBlock* block : blocks)
+		processBlock(*block, getEntryState(*block, block == blocks.front()), true);
+
+	//the locals with (possibly) different values per element, propagated until no more locals are added
+	changed = true;
+	while(changed)
+	{
+		changed = false;
+		for(BasicBlock& block : method.getBasicBlocks())
+		{
+			for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+			{
+				if(!it.has())
+					continue;
+				const bool isMethodCall = it.has<intermediate::MethodCall>();
+				it.forAllInstructions([&](const intermediate::IntermediateInstruction* instr) -> void
+				{
+					if(!instr->hasValueType(ValueType::LOCAL) || analysis.nonSplatLocals.find(instr->getOutput().get().local) != analysis.nonSplatLocals.end())
+						return;
+					const intermediate::LoadImmediate* load = dynamic_cast<const intermediate::LoadImmediate*>(instr);
+					bool isSplat = !isMethodCall && dynamic_cast<const intermediate::VectorRotation*>(instr) == nullptr &&
+							(load == nullptr || load->type == intermediate::LoadType::REPLICATE_INT32);
+					isSplat = isSplat && std::all_of(instr->getArguments().begin(), instr->getArguments().end(), [&analysis](const Value& arg) -> bool { return analysis.isSplat(arg);});
+					if(isSplat && instr->conditional != COND_ALWAYS)
+					{
+						//the flags of a combined instruction are recorded for the combined instruction
+						const intermediate::IntermediateInstruction* setter = analysis.getFlagsSetter(it.get());
+						isSplat = setter != nullptr && analysis.hasUniformFlags(setter);
+					}
+					if(!isSplat)
+					{
+						analysis.nonSplatLocals.emplace(instr->getOutput().get().local);
+						changed = true;
+					}
+				});
+			}
+		}
+	}
+
+	//the blocks reading the flags set before their start, and the blocks setting the flags
+	FastSet<const BasicBlock*> readingBlocks;
+	FastSet<const BasicBlock*> settingBlocks;
+	for(BasicBlock* block : blocks)
+	{
+		for(auto it = block->begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has())
+				continue;
+			if(readsFlags(it))
+			{
+				readingBlocks.emplace(block);
+				break;
+			}
+			if(setsFlags(it))
+			{
+				settingBlocks.emplace(block);
+				break;
+			}
+		}
+	}
+	changed = true;
+	while(changed)
+	{
+		changed = false;
+		for(auto blockIt = blocks.rbegin(); blockIt != blocks.rend(); ++blockIt)
+		{
+			if(analysis.flagsLiveAfter.find(*blockIt) != analysis.flagsLiveAfter.end())
+				continue;
+			for(const BasicBlock* successor : cfg.getSuccessors(**blockIt))
+			{
+				if(readingBlocks.find(successor) != readingBlocks.end() ||
+						(settingBlocks.find(successor) == settingBlocks.end() && analysis.flagsLiveAfter.find(successor) != analysis.flagsLiveAfter.end()))
+				{
+					analysis.flagsLiveAfter.emplace(*blockIt);
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+	return analysis;
+}
+
+const intermediate::IntermediateInstruction* FlagsAnalysis::getFlagsSetter(const intermediate::IntermediateInstruction* instr) const
+{
+	auto it = flagsStates.find(instr);
+	return it == flagsStates.end() ? nullptr : it->second.setter;
+}
+
+bool FlagsAnalysis::isRedundantFlagsSetter(const intermediate::IntermediateInstruction* instr) const
+{
+	return redundantSetters.find(instr) != redundantSetters.end();
+}
+
+bool FlagsAnalysis::hasUniformFlags(const intermediate::IntermediateInstruction* setter) const
+{
+	return std::all_of(setter->getArguments().begin(), setter->getArguments().end(), [this](const Value& arg) -> bool { return isSplat(arg);});
+}
+
+bool FlagsAnalysis::isSplat(const Value& value) const
+{
+	if(value.hasType(ValueType::LITERAL) || value.hasType(ValueType::SMALL_IMMEDIATE))
+		return true;
+	if(value.hasType(ValueType::REGISTER))
+		return value.reg == REG_UNIFORM || value.reg == REG_QPU_NUMBER;
+	if(!value.hasType(ValueType::LOCAL) || nonSplatLocals.find(value.local) != nonSplatLocals.end())
+		return false;
+	//locals never written are e.g. parameters and work-item information, which are read from the UNIFORMs.
+	//Vector parameters are read element by element
+	return value.local->getUsers().getNumWriters() > 0 || value.local->is<Global>() || value.local->type.getVectorWidth() == 1;
+}
+
+bool FlagsAnalysis::areFlagsLiveAfter(const BasicBlock& block) const
+{
+	return flagsLiveAfter.find(&block) != flagsLiveAfter.end();
+}
@@ -0,0 +1,72 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_FLAGS_ANALYSIS_H
+#define VC4C_FLAGS_ANALYSIS_H
+
+#include "ControlFlowGraph.h"
+
+namespace vc4c
+{
+	namespace intermediate
+	{
+		class IntermediateInstruction;
+	} /* namespace intermediate */
+
+	namespace analysis
+	{
+		/*
+		 * The state of the ALU flags at every instruction: the instruction the flags were set by on all paths reaching the instruction,
+		 * and whether the values this instruction calculated the flags from are still unmodified, so calculating them again would result in the same flags.
+		 *
+		 * Additionally, the locals whose values are the same in all SIMD elements, so flags calculated from them are the same for all elements.
+		 *
+		 * Only unconditional flags set by a single (not combined) instruction are tracked, the flags are unknown after any other instruction setting flags
+		 * and at the start of the method.
+		 */
+		class FlagsAnalysis
+		{
+		public:
+			static FlagsAnalysis createFlags(Method& method, const ControlFlowGraph& cfg);
+
+			/*
+			 * The instruction the flags read by the given instruction were set by on all paths, nullptr if not known
+			 */
+			const intermediate::IntermediateInstruction* getFlagsSetter(const intermediate::IntermediateInstruction* instr) const;
+			/*
+			 * Whether the instruction sets the flags to the values they already have,
+			 * since it calculates them the same way from the same unmodified values as the instruction they were set by
+			 */
+			bool isRedundantFlagsSetter(const intermediate::IntermediateInstruction* instr) const;
+			/*
+			 * Whether the flags set by the instruction are the same for all SIMD elements
+			 */
+			bool hasUniformFlags(const intermediate::IntermediateInstruction* setter) const;
+			/*
+			 * Whether the value is the same for all SIMD elements, e.g. literals, UNIFORMs and values calculated from them
+			 */
+			bool isSplat(const Value& value) const;
+			/*
+			 * Whether the flags at the end of the block can be read in any of its successors, before they are set again
+			 */
+			bool areFlagsLiveAfter(const BasicBlock& block) const;
+
+		private:
+			struct FlagsState
+			{
+				const intermediate::IntermediateInstruction* setter;
+				bool argumentsUnchanged;
+			};
+
+			FastMap<const intermediate::IntermediateInstruction*, FlagsState> flagsStates;
+			FastSet<const intermediate::IntermediateInstruction*> redundantSetters;
+			FastSet<const Local*> nonSplatLocals;
+			FastSet<const BasicBlock*> flagsLiveAfter;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_FLAGS_ANALYSIS_H */
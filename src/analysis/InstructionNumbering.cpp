@@ -0,0 +1,83 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "InstructionNumbering.h"
+#include "../InstructionWalker.h"
+#include "../intermediate/IntermediateInstruction.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+InstructionNumbering InstructionNumbering::createNumbering(Method& method)
+{
+	InstructionNumbering numbering;
+	std::size_t index = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		const std::size_t blockStart = index;
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has())
+				continue;
+			numbering.positions.emplace(it.get(), index);
+			it.forAllInstructions([&numbering, index](const intermediate::IntermediateInstruction* instr) -> void
+			{
+				instr->forUsedLocals([&numbering, index](const Local* local, LocalUser::Type type) -> void
+				{
+					auto rangeIt = numbering.usageRanges.find(local);
+					if(rangeIt == numbering.usageRanges.end())
+						numbering.usageRanges.emplace(local, PositionRange{index, index});
+					else
+						//the instructions are numbered in ascending order, so the first use is already set
+						rangeIt->second.second = index;
+				});
+			});
+			++index;
+		}
+		numbering.blockRanges.emplace(&block, PositionRange{blockStart, index});
+	}
+	numbering.numInstructions = index;
+	numbering.modificationCount = method.getModificationCount();
+	numbering.numBlocks = method.getBasicBlocks().size();
+	return numbering;
+}
+
+bool InstructionNumbering::isUpToDate(Method& method) const
+{
+	return modificationCount == method.getModificationCount() && numBlocks == method.getBasicBlocks().size();
+}
+
+std::size_t InstructionNumbering::getPosition(const intermediate::IntermediateInstruction* instr) const
+{
+	auto it = positions.find(instr);
+	if(it == positions.end())
+		throw CompilationError(CompilationStep::GENERAL, "Instruction is not part of the instruction numbering", instr == nullptr ? "(null)" : instr->to_string());
+	return it->second;
+}
+
+bool InstructionNumbering::isBefore(const intermediate::IntermediateInstruction* first, const intermediate::IntermediateInstruction* second) const
+{
+	return getPosition(first) < getPosition(second);
+}
+
+std::size_t InstructionNumbering::getNumInstructions() const
+{
+	return numInstructions;
+}
+
+const PositionRange* InstructionNumbering::getUsageRange(const Local* local) const
+{
+	auto it = usageRanges.find(local);
+	return it == usageRanges.end() ? nullptr : &it->second;
+}
+
+PositionRange InstructionNumbering::getBlockRange(const BasicBlock& block) const
+{
+	auto it = blockRanges.find(&block);
+	if(it == blockRanges.end())
+		throw CompilationError(CompilationStep::GENERAL, "Basic block is not part of the instruction numbering", block.getLabel()->to_string());
+	return it->second;
+}
@@ -0,0 +1,79 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_INSTRUCTION_NUMBERING_H
+#define VC4C_INSTRUCTION_NUMBERING_H
+
+#include "../Module.h"
+
+#include <utility>
+
+namespace vc4c
+{
+	namespace intermediate
+	{
+		class IntermediateInstruction;
+	} /* namespace intermediate */
+
+	namespace analysis
+	{
+		/*
+		 * The range of positions [start, end) of the instructions of a basic block or the range of positions [first, last] a local is used in
+		 */
+		using PositionRange = std::pair<std::size_t, std::size_t>;
+
+		/*
+		 * Numbers all instructions of a method densely in their linear order (the order of the basic blocks and of the instructions within them),
+		 * so the order of two instructions and the range a local is used in can be determined without walking the instructions.
+		 *
+		 * The numbering is not updated when instructions are inserted or removed, instead the method is numbered again when the numbering is requested
+		 * from the AnalysisManager after the instructions of the method changed (see #isUpToDate).
+		 * Released instructions (the place-holders left in the instruction lists) are not numbered.
+		 */
+		class InstructionNumbering
+		{
+		public:
+			static InstructionNumbering createNumbering(Method& method);
+
+			/*
+			 * Whether the instructions of the method were not modified since the numbering was created
+			 */
+			bool isUpToDate(Method& method) const;
+
+			/*
+			 * The position of the instruction in the method, throws a CompilationError if the instruction was not numbered
+			 */
+			std::size_t getPosition(const intermediate::IntermediateInstruction* instr) const;
+			/*
+			 * Whether the first instruction is located before the second instruction in the linear order of the method
+			 */
+			bool isBefore(const intermediate::IntermediateInstruction* first, const intermediate::IntermediateInstruction* second) const;
+			/*
+			 * The number of instructions numbered, i.e. the number of non-released instructions of the method
+			 */
+			std::size_t getNumInstructions() const;
+			/*
+			 * The positions of the first and the last instruction (inclusive) reading or writing the local, or nothing if the local is not used
+			 */
+			const PositionRange* getUsageRange(const Local* local) const;
+			/*
+			 * The positions of the first instruction of the block and after the last instruction of the block
+			 */
+			PositionRange getBlockRange(const BasicBlock& block) const;
+
+		private:
+			FastMap<const intermediate::IntermediateInstruction*, std::size_t> positions;
+			FastMap<const Local*, PositionRange> usageRanges;
+			FastMap<const BasicBlock*, PositionRange> blockRanges;
+			std::size_t numInstructions = 0;
+			//the modification count and the number of blocks of the method, the numbering was created for
+			std::size_t modificationCount = 0;
+			std::size_t numBlocks = 0;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_INSTRUCTION_NUMBERING_H */
@@ -0,0 +1,189 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "LivenessAnalysis.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+static constexpr std::size_t BITS_PER_WORD = 64;
+
+/*
+ * Whether the write of the instruction completely overwrites the previous value of the output
+ */
+static bool isKillingWrite(const intermediate::IntermediateInstruction* instr)
+{
+	//the single operations of a combined instruction may be executed with different conditions, so we do not know
+	return instr->conditional == COND_ALWAYS && !has_flag(instr->decoration, intermediate::InstructionDecorations::ELEMENT_INSERTION) &&
+			dynamic_cast<const intermediate::CombinedOperation*>(instr) == nullptr;
+}
+
+static void setBit(std::vector<uint64_t>& set, const std::size_t index)
+{
+	set[index / BITS_PER_WORD] |= uint64_t{1} << (index % BITS_PER_WORD);
+}
+
+LivenessAnalysis LivenessAnalysis::createLiveness(Method& method, const ControlFlowGraph& cfg)
+{
+	LivenessAnalysis liveness;
+	//the locals read before written (uses) and the locals written before read (definitions) per block, as indices into the locals
+	struct BlockUses
+	{
+		std::vector<std::size_t> uses;
+		std::vector<std::size_t> definitions;
+	};
+	FastMap<const BasicBlock*, BlockUses> blockUses;
+	const auto indexOf = [&liveness](const Local* local) -> std::size_t
+	{
+		auto it = liveness.localIndices.emplace(local, liveness.indexedLocals.size());
+		if(it.second)
+			liveness.indexedLocals.push_back(local);
+		return it.first->second;
+	};
+	for(BasicBlock& bb : method.getBasicBlocks())
+	{
+		BlockUses& uses = blockUses[&bb];
+		FastSet<const Local*> defs;
+		FastSet<const Local*> reads;
+		std::vector<const Local*> writtenLocals;
+		for(auto it = bb.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == nullptr)
+				continue;
+			//the arguments are read before the output is written, independent of the order the locals are reported in
+			writtenLocals.clear();
+			it->forUsedLocals([&](const Local* local, LocalUser::Type type) -> void
+			{
+				if(local->type == TYPE_LABEL)
+					return;
+				if(has_flag(type, LocalUser::Type::READER) && defs.find(local) == defs.end() && reads.emplace(local).second)
+					uses.uses.push_back(indexOf(local));
+				if(has_flag(type, LocalUser::Type::WRITER))
+					writtenLocals.push_back(local);
+			});
+			if(isKillingWrite(it.get()))
+			{
+				for(const Local* local : writtenLocals)
+				{
+					if(defs.emplace(local).second)
+						uses.definitions.push_back(indexOf(local));
+				}
+			}
+		}
+	}
+
+	const std::size_t numWords = (liveness.indexedLocals.size() + BITS_PER_WORD - 1) / BITS_PER_WORD;
+	//the locals not defined within a block (the inversion of the definitions), to only pass through the live locals not written in the block
+	FastMap<const BasicBlock*, LiveSet> passThroughs;
+	std::vector<BasicBlock*> openBlocks;
+	FastSet<const BasicBlock*> queuedBlocks;
+	for(BasicBlock& bb : method.getBasicBlocks())
+	{
+		BlockLiveness& blockLiveness = liveness.blocks[&bb];
+		blockLiveness.liveIns.assign(numWords, 0);
+		blockLiveness.liveOuts.assign(numWords, 0);
+		LiveSet& passThrough = passThroughs[&bb];
+		passThrough.assign(numWords, ~uint64_t{0});
+		const BlockUses& uses = blockUses.at(&bb);
+		for(std::size_t index : uses.uses)
+			setBit(blockLiveness.liveIns, index);
+		for(std::size_t index : uses.definitions)
+			passThrough[index / BITS_PER_WORD] &= ~(uint64_t{1} << (index % BITS_PER_WORD));
+		openBlocks.push_back(&bb);
+		queuedBlocks.emplace(&bb);
+	}
+
+	//propagate the live locals backwards until nothing changes anymore
+	while(!openBlocks.empty())
+	{
+		BasicBlock* block = openBlocks.back();
+		openBlocks.pop_back();
+		queuedBlocks.erase(block);
+		BlockLiveness& blockLiveness = liveness.blocks.at(block);
+		for(const BasicBlock* successor : cfg.getSuccessors(*block))
+		{
+			const LiveSet& successorLiveIns = liveness.blocks.at(successor).liveIns;
+			for(std::size_t i = 0; i < numWords; ++i)
+				blockLiveness.liveOuts[i] |= successorLiveIns[i];
+		}
+		const LiveSet& passThrough = passThroughs.at(block);
+		bool changed = false;
+		for(std::size_t i = 0; i < numWords; ++i)
+		{
+			const uint64_t newLiveIns = blockLiveness.liveIns[i] | (blockLiveness.liveOuts[i] & passThrough[i]);
+			changed = changed || newLiveIns != blockLiveness.liveIns[i];
+			blockLiveness.liveIns[i] = newLiveIns;
+		}
+		if(changed)
+		{
+			for(const CFGPredecessor& pred : cfg.getPredecessors(*block))
+			{
+				if(queuedBlocks.emplace(pred.block).second)
+					openBlocks.push_back(pred.block);
+			}
+		}
+	}
+
+	liveness.liveAcrossBlocks.assign(numWords, 0);
+	for(const auto& pair : liveness.blocks)
+	{
+		for(std::size_t i = 0; i < numWords; ++i)
+			liveness.liveAcrossBlocks[i] |= pair.second.liveIns[i];
+	}
+	return liveness;
+}
+
+bool LivenessAnalysis::isLiveIn(const BasicBlock& block, const Local* local) const
+{
+	return contains(assertBlock(block).liveIns, local);
+}
+
+bool LivenessAnalysis::isLiveOut(const BasicBlock& block, const Local* local) const
+{
+	return contains(assertBlock(block).liveOuts, local);
+}
+
+bool LivenessAnalysis::isLiveAcrossBlocks(const Local* local) const
+{
+	return contains(liveAcrossBlocks, local);
+}
+
+FastSet<const Local*> LivenessAnalysis::getLiveIns(const BasicBlock& block) const
+{
+	return toSet(assertBlock(block).liveIns);
+}
+
+FastSet<const Local*> LivenessAnalysis::getLiveOuts(const BasicBlock& block) const
+{
+	return toSet(assertBlock(block).liveOuts);
+}
+
+const LivenessAnalysis::BlockLiveness& LivenessAnalysis::assertBlock(const BasicBlock& block) const
+{
+	auto it = blocks.find(&block);
+	if(it == blocks.end())
+		throw CompilationError(CompilationStep::GENERAL, "Basic block is not part of the liveness analysis", block.getLabel()->to_string());
+	return it->second;
+}
+
+bool LivenessAnalysis::contains(const LiveSet& set, const Local* local) const
+{
+	auto it = localIndices.find(local);
+	if(it == localIndices.end())
+		return false;
+	return (set[it->second / BITS_PER_WORD] >> (it->second % BITS_PER_WORD)) & 1;
+}
+
+FastSet<const Local*> LivenessAnalysis::toSet(const LiveSet& set) const
+{
+	FastSet<const Local*> locals;
+	for(std::size_t i = 0; i < indexedLocals.size(); ++i)
+	{
+		if((set[i / BITS_PER_WORD] >> (i % BITS_PER_WORD)) & 1)
+			locals.emplace(indexedLocals[i]);
+	}
+	return locals;
+}
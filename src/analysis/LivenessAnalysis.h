@@ -0,0 +1,75 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_LIVENESS_ANALYSIS_H
+#define VC4C_LIVENESS_ANALYSIS_H
+
+#include "ControlFlowGraph.h"
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * The locals live at the start and the end of every basic block.
+		 *
+		 * A local is live, if there is a path to a reading instruction not passing an (unconditional) write of the local.
+		 * Labels are not tracked.
+		 *
+		 * The live locals are stored as bit-vectors over the locals used in the method, so all queries for a single local are constant-time.
+		 * Locals created after the analysis was calculated are never live.
+		 */
+		class LivenessAnalysis
+		{
+		public:
+			static LivenessAnalysis createLiveness(Method& method, const ControlFlowGraph& cfg);
+
+			/*
+			 * Whether the local is read in or after the given block before being written
+			 */
+			bool isLiveIn(const BasicBlock& block, const Local* local) const;
+			/*
+			 * Whether the local is read in any successor of the given block before being written
+			 */
+			bool isLiveOut(const BasicBlock& block, const Local* local) const;
+			/*
+			 * Whether the local is live at the start of any block, e.g. whether its value is passed between blocks (or around a loop)
+			 */
+			bool isLiveAcrossBlocks(const Local* local) const;
+
+			/*
+			 * The locals read in or after the given block before being written
+			 */
+			FastSet<const Local*> getLiveIns(const BasicBlock& block) const;
+			/*
+			 * The locals read in any successor of the given block before being written
+			 */
+			FastSet<const Local*> getLiveOuts(const BasicBlock& block) const;
+
+		private:
+			//one bit per local (in the order of the indices assigned)
+			using LiveSet = std::vector<uint64_t>;
+
+			struct BlockLiveness
+			{
+				LiveSet liveIns;
+				LiveSet liveOuts;
+			};
+
+			std::vector<const Local*> indexedLocals;
+			FastMap<const Local*, std::size_t> localIndices;
+			FastMap<const BasicBlock*, BlockLiveness> blocks;
+			//the union of the live-ins of all blocks
+			LiveSet liveAcrossBlocks;
+
+			const BlockLiveness& assertBlock(const BasicBlock& block) const;
+			bool contains(const LiveSet& set, const Local* local) const;
+			FastSet<const Local*> toSet(const LiveSet& set) const;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_LIVENESS_ANALYSIS_H */
@@ -0,0 +1,88 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "LoopAnalysis.h"
+
+#include <algorithm>
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+bool Loop::contains(const BasicBlock& block) const
+{
+	return blockSet.find(&block) != blockSet.end();
+}
+
+LoopAnalysis LoopAnalysis::createLoops(const ControlFlowGraph& cfg, const DominatorTree& dominators)
+{
+	LoopAnalysis analysis;
+	const std::vector<BasicBlock*>& order = cfg.getReversePostOrder();
+	FastMap<const BasicBlock*, std::size_t> indices;
+	for(std::size_t i = 0; i < order.size(); ++i)
+		indices.emplace(order[i], i);
+
+	for(BasicBlock* header : order)
+	{
+		//the sources of the back-edges are the predecessors dominated by the header
+		std::vector<BasicBlock*> openBlocks;
+		for(const CFGPredecessor& pred : cfg.getPredecessors(*header))
+		{
+			if(dominators.dominates(*header, *pred.block))
+				openBlocks.push_back(pred.block);
+		}
+		if(openBlocks.empty())
+			continue;
+
+		Loop loop;
+		loop.header = header;
+		loop.preheader = nullptr;
+		loop.blockSet.emplace(header);
+		//walk backwards from the back-edges until we reach the header
+		while(!openBlocks.empty())
+		{
+			BasicBlock* block = openBlocks.back();
+			openBlocks.pop_back();
+			if(!loop.blockSet.emplace(block).second)
+				continue;
+			for(const CFGPredecessor& pred : cfg.getPredecessors(*block))
+			{
+				//unreachable blocks are not part of any loop
+				if(indices.find(pred.block) != indices.end())
+					openBlocks.push_back(pred.block);
+			}
+		}
+		for(BasicBlock* block : order)
+		{
+			if(loop.contains(*block))
+				loop.blocks.push_back(block);
+		}
+
+		BasicBlock* entry = nullptr;
+		bool hasSingleEntry = true;
+		for(const CFGPredecessor& pred : cfg.getPredecessors(*header))
+		{
+			if(loop.contains(*pred.block))
+				continue;
+			hasSingleEntry = hasSingleEntry && (entry == nullptr || entry == pred.block);
+			entry = pred.block;
+		}
+		if(hasSingleEntry && entry != nullptr && cfg.getSuccessors(*entry).size() == 1)
+			loop.preheader = entry;
+		analysis.loops.push_back(std::move(loop));
+	}
+
+	//the inner loops consist of a subset of the blocks of the outer loops
+	std::stable_sort(analysis.loops.begin(), analysis.loops.end(), [](const Loop& first, const Loop& second) -> bool
+	{
+		return first.blocks.size() < second.blocks.size();
+	});
+	return analysis;
+}
+
+const std::vector<Loop>& LoopAnalysis::getLoops() const
+{
+	return loops;
+}
@@ -0,0 +1,56 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_LOOP_ANALYSIS_H
+#define VC4C_LOOP_ANALYSIS_H
+
+#include "DominatorTree.h"
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * A natural loop: the header and all blocks which can reach a back-edge to the header without passing through the header.
+		 *
+		 * Loops sharing the same header (e.g. via "continue") are merged into a single loop.
+		 */
+		struct Loop
+		{
+			BasicBlock* header;
+			//the blocks of the loop (including the header) in reverse post-order, e.g. every block is listed before the blocks it dominates
+			std::vector<BasicBlock*> blocks;
+			//the single block outside of the loop entering the header, if it has no other successor
+			BasicBlock* preheader;
+
+			bool contains(const BasicBlock& block) const;
+
+		private:
+			FastSet<const BasicBlock*> blockSet;
+
+			friend class LoopAnalysis;
+		};
+
+		/*
+		 * The natural loops of a method
+		 */
+		class LoopAnalysis
+		{
+		public:
+			static LoopAnalysis createLoops(const ControlFlowGraph& cfg, const DominatorTree& dominators);
+
+			/*
+			 * All loops of the method, inner loops are listed before the loops containing them
+			 */
+			const std::vector<Loop>& getLoops() const;
+
+		private:
+			std::vector<Loop> loops;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_LOOP_ANALYSIS_H */
@@ -0,0 +1,292 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "ValueRange.h"
+#include "../InstructionWalker.h"
+#include "../asm/KernelInfo.h"
+#include "../intermediate/IntermediateInstruction.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+constexpr uint64_t ValueRange::MAX_VALUE;
+const ValueRange ValueRange::FULL_RANGE{0, ValueRange::MAX_VALUE};
+
+/*
+ * The number of times the range of a local may grow, before it is assumed to take the full range (e.g. for loop counters)
+ */
+static constexpr unsigned MAX_RANGE_UPDATES = 8;
+
+bool ValueRange::fitsIntoBits(unsigned numBits) const
+{
+	//all ranges are limited to 32-bit values
+	return numBits >= 32 || maxValue < (uint64_t(1) << numBits);
+}
+
+ValueRange ValueRange::unite(const ValueRange& other) const
+{
+	return ValueRange{std::min(minValue, other.minValue), std::max(maxValue, other.maxValue)};
+}
+
+bool ValueRange::operator==(const ValueRange& other) const
+{
+	return minValue == other.minValue && maxValue == other.maxValue;
+}
+
+static ValueRange makeRange(uint64_t minValue, uint64_t maxValue)
+{
+	if(maxValue > ValueRange::MAX_VALUE)
+		//the value can overflow
+		return ValueRange::FULL_RANGE;
+	return ValueRange{minValue, maxValue};
+}
+
+/*
+ * The (known) range of the value, or nothing if the value is written by instructions not yet visited
+ */
+static Optional<ValueRange> getKnownRange(const FastMap<const Local*, ValueRange>& ranges, const Value& value)
+{
+	if(value.hasType(ValueType::LOCAL))
+	{
+		auto it = ranges.find(value.local);
+		if(it != ranges.end())
+			return it->second;
+		if(value.local->getUsers().getNumWriters() > 0)
+			return {};
+		//e.g. parameters
+		return ValueRange::FULL_RANGE;
+	}
+	if(value.hasType(ValueType::LITERAL))
+	{
+		if(value.literal.type == LiteralType::BOOL)
+			return ValueRange{value.literal.flag ? 1u : 0u, value.literal.flag ? 1u : 0u};
+		if(value.literal.type == LiteralType::INTEGER)
+		{
+			const uint64_t literal = static_cast<uint32_t>(value.literal.integer);
+			return ValueRange{literal, literal};
+		}
+	}
+	if(value.hasType(ValueType::SMALL_IMMEDIATE) && value.immediate.getIntegerValue())
+	{
+		const uint64_t literal = static_cast<uint32_t>(static_cast<int32_t>(value.immediate.getIntegerValue().get()));
+		return ValueRange{literal, literal};
+	}
+	if(value.hasType(ValueType::CONTAINER) && !value.container.elements.empty())
+	{
+		Optional<ValueRange> range = getKnownRange(ranges, value.container.elements.front());
+		for(const Value& element : value.container.elements)
+		{
+			const Optional<ValueRange> elementRange = getKnownRange(ranges, element);
+			if(!range || !elementRange)
+				return {};
+			range = range.get().unite(elementRange.get());
+		}
+		return range;
+	}
+	return ValueRange::FULL_RANGE;
+}
+
+static ValueRange calculateRange(const intermediate::Operation* op, const ValueRange& arg0, const ValueRange& arg1)
+{
+	const std::string& opCode = op->opCode;
+	const unsigned sourceBits = op->getFirstArg().type.getScalarBitCount();
+	if(opCode.compare("and") == 0)
+		return ValueRange{0, std::min(arg0.maxValue, arg1.maxValue)};
+	if(opCode.compare("or") == 0 || opCode.compare("xor") == 0)
+	{
+		//the result has no more bits than the larger operand
+		uint64_t mask = 1;
+		while(mask <= std::max(arg0.maxValue, arg1.maxValue))
+			mask <<= 1;
+		return ValueRange{opCode.compare("or") == 0 ? std::max(arg0.minValue, arg1.minValue) : 0, mask - 1};
+	}
+	if(opCode.compare("add") == 0)
+		return makeRange(arg0.minValue + arg1.minValue, arg0.maxValue + arg1.maxValue);
+	if(opCode.compare("sub") == 0 && arg0.minValue >= arg1.maxValue)
+		return makeRange(arg0.minValue - arg1.maxValue, arg0.maxValue - arg1.minValue);
+	if(opCode.compare("mul24") == 0 && arg0.fitsIntoBits(24) && arg1.fitsIntoBits(24))
+		return makeRange(arg0.minValue * arg1.minValue, arg0.maxValue * arg1.maxValue);
+	if(opCode.compare("mul") == 0 && arg0.fitsIntoBits(32) && arg1.fitsIntoBits(32))
+		return makeRange(arg0.minValue * arg1.minValue, arg0.maxValue * arg1.maxValue);
+	//the shift offsets are taken modulo 32 by the hardware
+	if(opCode.compare("shl") == 0 && arg1.maxValue < 32)
+		return makeRange(arg0.minValue << arg1.minValue, arg0.maxValue << arg1.maxValue);
+	if((opCode.compare("shr") == 0 || opCode.compare("lshr") == 0) && arg1.maxValue < 32)
+		return ValueRange{arg0.minValue >> arg1.maxValue, arg0.maxValue >> arg1.minValue};
+	//for positive values, the arithmetic and logical shifts are the same
+	if((opCode.compare("asr") == 0 || opCode.compare("ashr") == 0) && arg1.maxValue < 32 && arg0.fitsIntoBits(31))
+		return ValueRange{arg0.minValue >> arg1.maxValue, arg0.maxValue >> arg1.minValue};
+	//the integer minimum and maximum are signed
+	if(opCode.compare("max") == 0 && arg0.fitsIntoBits(31) && arg1.fitsIntoBits(31))
+		return ValueRange{std::max(arg0.minValue, arg1.minValue), std::max(arg0.maxValue, arg1.maxValue)};
+	if(opCode.compare("min") == 0 && arg0.fitsIntoBits(31) && arg1.fitsIntoBits(31))
+		return ValueRange{std::min(arg0.minValue, arg1.minValue), std::min(arg0.maxValue, arg1.maxValue)};
+	if(opCode.compare("udiv") == 0 && arg1.minValue > 0)
+		return ValueRange{arg0.minValue / arg1.maxValue, arg0.maxValue / arg1.minValue};
+	if((opCode.compare("urem") == 0 || opCode.compare("umod") == 0) && arg1.minValue > 0)
+		return ValueRange{0, std::min(arg0.maxValue, arg1.maxValue - 1)};
+	//zero-extension and truncation both clear the upper bits of the source or destination
+	if(opCode.compare("zext") == 0 && sourceBits < 32)
+		return ValueRange{arg0.fitsIntoBits(sourceBits) ? arg0.minValue : 0, std::min(arg0.maxValue, (uint64_t(1) << sourceBits) - 1)};
+	if(opCode.compare("trunc") == 0 && op->getOutput().get().type.getScalarBitCount() < 32)
+	{
+		const unsigned destBits = op->getOutput().get().type.getScalarBitCount();
+		return ValueRange{arg0.fitsIntoBits(destBits) ? arg0.minValue : 0, std::min(arg0.maxValue, (uint64_t(1) << destBits) - 1)};
+	}
+	//sign-extending a positive value does not modify it
+	if((opCode.compare("zext") == 0 || opCode.compare("sext") == 0) && (sourceBits >= 32 || arg0.fitsIntoBits(sourceBits - 1)))
+		return arg0;
+	return ValueRange::FULL_RANGE;
+}
+
+/*
+ * The bounds of the work-item built-ins, which are determined by the work-group size
+ */
+static Optional<ValueRange> getBuiltinRange(const intermediate::IntermediateInstruction* instr, const uint64_t maxLocalSize)
+{
+	const intermediate::MethodCall* call = dynamic_cast<const intermediate::MethodCall*>(instr);
+	if(has_flag(instr->decoration, intermediate::InstructionDecorations::BUILTIN_LOCAL_ID) || (call != nullptr && call->methodName.compare("vc4cl_local_id") == 0))
+		return ValueRange{0, maxLocalSize - 1};
+	//unused dimensions are currently set to zero
+	if(has_flag(instr->decoration, intermediate::InstructionDecorations::BUILTIN_LOCAL_SIZE) || (call != nullptr && call->methodName.compare("vc4cl_local_size") == 0))
+		return ValueRange{0, maxLocalSize};
+	if(has_flag(instr->decoration, intermediate::InstructionDecorations::BUILTIN_WORK_DIMENSIONS) || (call != nullptr && call->methodName.compare("vc4cl_work_dimensions") == 0))
+		return ValueRange{1, 3};
+	return {};
+}
+
+/*
+ * Calculates the range of the value written by the instruction, or nothing if the range of an argument is not yet known
+ */
+static Optional<ValueRange> calculateRange(const intermediate::IntermediateInstruction* instr, const FastMap<const Local*, ValueRange>& ranges, const uint64_t maxLocalSize)
+{
+	Optional<ValueRange> builtinRange = getBuiltinRange(instr, maxLocalSize);
+	if(builtinRange && instr->is<intermediate::MethodCall>())
+		return builtinRange;
+	if(instr->hasPackMode() || instr->hasUnpackMode() || instr->getOutput().get().type.isFloatingType())
+		return builtinRange ? builtinRange.get() : ValueRange::FULL_RANGE;
+
+	Optional<ValueRange> range = ValueRange::FULL_RANGE;
+	if(instr->is<intermediate::LoadImmediate>() && instr->as<intermediate::LoadImmediate>()->type != intermediate::LoadType::REPLICATE_INT32)
+	{
+		const std::vector<long> values = instr->as<intermediate::LoadImmediate>()->getPerElementValues();
+		const long minValue = *std::min_element(values.begin(), values.end());
+		//negative elements wrap around to the top of the unsigned range
+		if(minValue >= 0)
+			range = ValueRange{static_cast<uint64_t>(minValue), static_cast<uint64_t>(*std::max_element(values.begin(), values.end()))};
+	}
+	else if(instr->is<intermediate::LoadImmediate>())
+		range = getKnownRange(ranges, Value(instr->as<intermediate::LoadImmediate>()->getImmediate(), instr->getOutput().get().type));
+	else if(instr->is<intermediate::MoveOperation>())
+		range = getKnownRange(ranges, instr->as<intermediate::MoveOperation>()->getSource());
+	else if(instr->is<intermediate::Operation>())
+	{
+		const intermediate::Operation* op = instr->as<intermediate::Operation>();
+		const Optional<ValueRange> arg0 = getKnownRange(ranges, op->getFirstArg());
+		const Optional<ValueRange> arg1 = op->getSecondArg() ? getKnownRange(ranges, op->getSecondArg().get()) : Optional<ValueRange>(ValueRange::FULL_RANGE);
+		if(!arg0 || !arg1)
+			range = Optional<ValueRange>();
+		else if(op->getFirstArg().type.isFloatingType())
+			range = ValueRange::FULL_RANGE;
+		else
+			range = calculateRange(op, arg0.get(), arg1.get());
+	}
+	if(builtinRange && range)
+		//the built-ins are read with masks, which are less strict than the known bounds
+		return ValueRange{std::max(range.get().minValue, builtinRange.get().minValue), std::min(range.get().maxValue, builtinRange.get().maxValue)};
+	return builtinRange ? builtinRange : range;
+}
+
+static uint64_t getMaximumLocalSize(const Method& method)
+{
+	uint64_t maxLocalSize = qpu_asm::KernelInfo::MAX_WORK_GROUP_SIZES;
+	auto it = method.metaData.find(MetaDataType::WORK_GROUP_SIZES);
+	if(it != method.metaData.end() && !it->second.empty())
+	{
+		uint64_t requiredSize = 0;
+		for(const std::string& s : it->second)
+			requiredSize = std::max(requiredSize, static_cast<uint64_t>(std::atoi(s.data())));
+		//larger work-groups are executed with several work-items per QPU (see optimizations#loopWorkItems)
+		if(requiredSize > 0)
+			maxLocalSize = requiredSize;
+	}
+	return maxLocalSize;
+}
+
+ValueRangeAnalysis ValueRangeAnalysis::createValueRanges(Method& method)
+{
+	ValueRangeAnalysis analysis;
+	const uint64_t maxLocalSize = getMaximumLocalSize(method);
+	FastMap<const Local*, unsigned> numUpdates;
+	bool changed = true;
+	//the ranges are widened until nothing changes anymore, since loops can pass values back to the start
+	while(changed)
+	{
+		changed = false;
+		for(BasicBlock& bb : method.getBasicBlocks())
+		{
+			for(auto it = bb.begin(); !it.isEndOfBlock(); it.nextInBlock())
+			{
+				if(it.get() == nullptr)
+					continue;
+				const intermediate::IntermediateInstruction* instr = it.get();
+				FastMap<const Local*, ValueRange> writtenRanges;
+				if(instr->hasValueType(ValueType::LOCAL) && (instr->is<intermediate::Operation>() || instr->is<intermediate::MoveOperation>() || instr->is<intermediate::LoadImmediate>() || instr->is<intermediate::MethodCall>()))
+				{
+					const Optional<ValueRange> range = calculateRange(instr, analysis.ranges, maxLocalSize);
+					if(!range)
+						continue;
+					writtenRanges.emplace(instr->getOutput().get().local, range.get());
+				}
+				else
+				{
+					//the values written by all other instructions are not known
+					instr->forUsedLocals([&writtenRanges](const Local* local, LocalUser::Type type) -> void
+					{
+						if(has_flag(type, LocalUser::Type::WRITER))
+							writtenRanges.emplace(local, ValueRange::FULL_RANGE);
+					});
+				}
+				for(const auto& pair : writtenRanges)
+				{
+					auto rangeIt = analysis.ranges.find(pair.first);
+					if(rangeIt == analysis.ranges.end())
+					{
+						analysis.ranges.emplace(pair.first, pair.second);
+						changed = true;
+						continue;
+					}
+					ValueRange newRange = rangeIt->second.unite(pair.second);
+					if(newRange == rangeIt->second)
+						continue;
+					if(++numUpdates[pair.first] > MAX_RANGE_UPDATES)
+						newRange = ValueRange::FULL_RANGE;
+					rangeIt->second = newRange;
+					changed = true;
+				}
+			}
+		}
+	}
+	return analysis;
+}
+
+ValueRange ValueRangeAnalysis::getRange(const Local* local) const
+{
+	auto it = ranges.find(local);
+	//locals never written (e.g. parameters) or only written depending on themselves can take any value
+	return it != ranges.end() ? it->second : ValueRange::FULL_RANGE;
+}
+
+ValueRange ValueRangeAnalysis::getRange(const Value& value) const
+{
+	if(value.hasType(ValueType::LOCAL))
+		return getRange(value.local);
+	const Optional<ValueRange> range = getKnownRange(ranges, value);
+	return range ? range.get() : ValueRange::FULL_RANGE;
+}
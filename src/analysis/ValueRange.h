@@ -0,0 +1,56 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_VALUE_RANGE_H
+#define VC4C_VALUE_RANGE_H
+
+#include "../Module.h"
+
+namespace vc4c
+{
+	namespace analysis
+	{
+		/*
+		 * The range of the (unsigned) 32-bit values a local can take in any of its SIMD elements
+		 */
+		struct ValueRange
+		{
+			uint64_t minValue;
+			uint64_t maxValue;
+
+			static constexpr uint64_t MAX_VALUE = 0xFFFFFFFF;
+			static const ValueRange FULL_RANGE;
+
+			/*
+			 * Whether all values fit into the given (unsigned) number of bits
+			 */
+			bool fitsIntoBits(unsigned numBits) const;
+			ValueRange unite(const ValueRange& other) const;
+			bool operator==(const ValueRange& other) const;
+		};
+
+		/*
+		 * The ranges of the integer values of the locals of a method.
+		 *
+		 * The ranges are determined from literals, masks, shifts, zero-extensions and the work-item built-ins with known bounds
+		 * (e.g. the local ids, which are limited by the maximum or required work-group size) and propagated through the arithmetic operations.
+		 * Any value which can overflow (or is not an integer at all) is assumed to take the full 32-bit range.
+		 */
+		class ValueRangeAnalysis
+		{
+		public:
+			static ValueRangeAnalysis createValueRanges(Method& method);
+
+			ValueRange getRange(const Local* local) const;
+			ValueRange getRange(const Value& value) const;
+
+		private:
+			FastMap<const Local*, ValueRange> ranges;
+		};
+	} /* namespace analysis */
+} /* namespace vc4c */
+
+#endif /* VC4C_VALUE_RANGE_H */
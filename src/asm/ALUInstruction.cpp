@@ -73,38 +73,40 @@ ALUInstruction::~ALUInstruction()
 
 std::string ALUInstruction::toASMString() const
 {
-    std::string addPart;
-    std::string mulPart;
-    bool hasImmediate = getSig() == Signaling::ALU_IMMEDIATE;
-    std::string addArgs, mulArgs;
-    if(getAddition().numOperands > 0)
-    	addArgs.append(", ").append(toInputRegister(getAddMutexA(), getInputA(), getInputB(), hasImmediate));
-    if(getAddition().numOperands > 1)
-		addArgs.append(", ").append(toInputRegister(getAddMutexB(), getInputA(), getInputB(), hasImmediate));
-    if(getMultiplication().numOperands > 0)
-    	mulArgs.append(", ").append(toInputRegister(getMulMutexA(), getInputA(), getInputB(), hasImmediate));
-    if(getMultiplication().numOperands > 1)
-		mulArgs.append(", ").append(toInputRegister(getMulMutexB(), getInputA(), getInputB(), hasImmediate));
-    addPart = std::string(getAddition().name) + (toExtrasString(getSig(), getAddCondition(), getSetFlag(), getUnpack(), getPack()) + " ") + (getAddition() != OPADD_NOP ? toOutputRegister(getWriteSwap() == WriteSwap::DONT_SWAP, getAddOut()) : "") + addArgs;
-    mulPart = std::string(getMultiplication().name) + (toExtrasString(getSig(), getMulCondition(), getSetFlag(), getUnpack(), getPack()) + " ") + (getMultiplication() != OPMUL_NOP ? toOutputRegister(getWriteSwap() == WriteSwap::SWAP, getMulOut()) : "") + mulArgs;
-    if(getMulMutexA() != InputMutex::REGA && getMulMutexA() != InputMutex::REGB && getMulMutexB() != InputMutex::REGA && getMulMutexB() != InputMutex::REGB && getSig() == Signaling::ALU_IMMEDIATE && (getAddition() == OPADD_NOP || (getAddMutexA() != InputMutex::REGB && getAddMutexB() != InputMutex::REGB)))
+    const bool hasImmediate = getSig() == Signaling::ALU_IMMEDIATE;
+    const bool addUsed = getAddition() != OPADD_NOP;
+    const bool mulUsed = getMultiplication() != OPMUL_NOP;
+    std::string result;
+    result.reserve(96);
+    if(addUsed || !mulUsed)
     {
-    	//both inputs for mul are accumulators, an immediate value is used
-    	//and the ADD ALU executes NOP or both inputs from the ADD ALU are not on register-file B
-    	// -> vector rotation
-    	mulPart.append(" ").append(static_cast<SmallImmediate>(getInputB()).toString());
+        result.append(getAddition().name).append(toExtrasString(getSig(), getAddCondition(), getSetFlag(), getUnpack(), getPack())).append(" ");
+        if(addUsed)
+            result.append(toOutputRegister(getWriteSwap() == WriteSwap::DONT_SWAP, getAddOut()));
+        if(getAddition().numOperands > 0)
+            result.append(", ").append(toInputRegister(getAddMutexA(), getInputA(), getInputB(), hasImmediate));
+        if(getAddition().numOperands > 1)
+            result.append(", ").append(toInputRegister(getAddMutexB(), getInputA(), getInputB(), hasImmediate));
     }
-    if(getAddition() != OPADD_NOP)
+    if(mulUsed)
     {
-        if(getMultiplication() != OPMUL_NOP)
+        if(addUsed)
+            result.append("; ");
+        result.append(getMultiplication().name).append(toExtrasString(getSig(), getMulCondition(), getSetFlag(), getUnpack(), getPack())).append(" ");
+        result.append(toOutputRegister(getWriteSwap() == WriteSwap::SWAP, getMulOut()));
+        if(getMultiplication().numOperands > 0)
+            result.append(", ").append(toInputRegister(getMulMutexA(), getInputA(), getInputB(), hasImmediate));
+        if(getMultiplication().numOperands > 1)
+            result.append(", ").append(toInputRegister(getMulMutexB(), getInputA(), getInputB(), hasImmediate));
+        if(getMulMutexA() != InputMutex::REGA && getMulMutexA() != InputMutex::REGB && getMulMutexB() != InputMutex::REGA && getMulMutexB() != InputMutex::REGB && hasImmediate && (!addUsed || (getAddMutexA() != InputMutex::REGB && getAddMutexB() != InputMutex::REGB)))
         {
-            return (addPart + "; ") + mulPart;
+            //both inputs for mul are accumulators, an immediate value is used
+            //and the ADD ALU executes NOP or both inputs from the ADD ALU are not on register-file B
+            // -> vector rotation
+            result.append(" ").append(toInputRegister(InputMutex::REGB, getInputA(), getInputB(), true));
         }
-        return addPart;
     }
-    if(getMultiplication() != OPMUL_NOP)
-        return mulPart;
-    return addPart;
+    return result;
 }
 
 std::pair<OpAdd, OpMul> vc4c::toOpCode(const std::string& opCode)
@@ -4,26 +4,54 @@
  * See the file "LICENSE" for the full license governing this code.
  */
 
+#include "ALUInstruction.h"
 #include "GraphColoring.h"
+#include "LinearScan.h"
 #include "CodeGenerator.h"
+#include "Compiler.h"
 #include "../InstructionWalker.h"
-#include "log.h"
+#include "../Logging.h"
 #include "KernelInfo.h"
+#include "CycleEstimator.h"
+#include "Container.h"
 #include "../intermediate/Helper.h"
+#include "../periphery/TMU.h"
+#include "../periphery/VPM.h"
 #include "../Profiler.h"
+#include "../ThreadPool.h"
+#include "../analysis/AnalysisManager.h"
+#include "../optimization/Combiner.h"
 
+#include <algorithm>
+#include <array>
+#include <fstream>
 #include <sstream>
 #include <map>
+#include <set>
 #include <limits.h>
 
 using namespace vc4c;
 using namespace vc4c::qpu_asm;
 using namespace vc4c::intermediate;
 
-CodeGenerator::CodeGenerator(const Module& module, const Configuration& config) : config(config), module(module)
+#ifdef MULTI_THREADED
+//the kernels of a program are generated concurrently and only synchronize on the maps of the results
+static threading::LockStatistics instructionsLockStatistics("CodeGenerator::instructionsLock");
+#endif
+
+CodeGenerator::CodeGenerator(const Module& module, const Configuration& config) : config(config), module(module), allInstructions(DeclarationOrder{&module})
 {
 }
 
+bool CodeGenerator::DeclarationOrder::operator()(const Method* first, const Method* second) const
+{
+	const auto position = [this](const Method* method) -> std::size_t
+	{
+		return static_cast<std::size_t>(std::find_if(module->methods.begin(), module->methods.end(), [method](const std::unique_ptr<Method>& m) -> bool { return m.get() == method;}) - module->methods.begin());
+	};
+	return position(first) < position(second);
+}
+
 static InstructionWalker loadVectorParameter(const Parameter& param, Method& method, InstructionWalker it)
 {
 	//we need to load a UNIFORM per vector element into the particular vector element
@@ -52,7 +80,81 @@ static InstructionWalker loadVectorParameter(const Parameter& param, Method& met
 	return it;
 }
 
-static void generateStartSegment(Method& method)
+/*
+ * The minimum number of vector elements of all vector parameters, for which the vector parameters are passed in the parameter buffer (if enabled).
+ * The single DMA access only saves instructions over reading the elements one by one, if there are enough elements
+ */
+static constexpr unsigned PARAMETER_BUFFER_MIN_ELEMENTS = 16;
+
+/*
+ * Selects the vector parameters to be passed in the parameter buffer (see Configuration#bufferVectorParameters) and reserves the VPM area to read the buffer into
+ */
+static std::vector<const Parameter*> selectBufferedParameters(Method& method, const Configuration& config)
+{
+	std::vector<const Parameter*> parameters;
+	if(!config.bufferVectorParameters)
+		return parameters;
+	unsigned numElements = 0;
+	for(const Parameter& param : method.parameters)
+	{
+		//a single DMA access reads up to 16 rows
+		if(!param.type.isPointerType() && param.type.num != 1 && parameters.size() < NATIVE_VECTOR_SIZE)
+		{
+			parameters.push_back(&param);
+			numElements += param.type.num;
+		}
+	}
+	if(numElements < PARAMETER_BUFFER_MIN_ELEMENTS)
+		return {};
+	const Local* buffer = method.findOrCreateLocal(TYPE_INT32.toPointerType(), Method::PARAMETER_BUFFER);
+	if(method.vpm->addArea(buffer, static_cast<unsigned>(parameters.size()) * periphery::VPM_ROW_SIZE, periphery::VPMUsage::SPECIFIC_DMA) == nullptr)
+	{
+		DEBUG_LOG("Not enough VPM space left to read the parameter buffer, passing the vector parameters as UNIFORMs" << logging::endl);
+		return {};
+	}
+	return parameters;
+}
+
+/*
+ * Reads the buffered parameters with a single DMA access into their VPM area and from there one row per parameter into the parameters
+ */
+static InstructionWalker loadBufferedParameters(Method& method, InstructionWalker it)
+{
+	const Value buffer = method.findLocal(Method::PARAMETER_BUFFER)->createReference();
+	it.emplace(new MoveOperation(buffer, UNIFORM_REGISTER));
+	it.nextInBlock();
+	const periphery::VPMArea& area = *method.vpm->findArea(buffer.local);
+	const unsigned numRows = static_cast<unsigned>(method.bufferedParameters.size());
+	//the parameters are the same for all QPUs, so the QPUs can read the buffer into the same area without locking the VPM
+	it = method.vpm->insertReadRAMIntoArea(method, it, buffer, area, numRows * periphery::VPM_ROW_SIZE, false);
+	const periphery::VPRSetup genericSetup(periphery::VPRGenericSetup(2 /* 32-bit */, 1, static_cast<uint8_t>(numRows % 16) /* 0 => 16 */,
+			static_cast<uint8_t>(area.baseOffset / periphery::VPM_ROW_SIZE)));
+	it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<long>(genericSetup))));
+	it.nextInBlock();
+	//all rows set up need to be read, even for unused parameters
+	for(const Parameter* param : method.bufferedParameters)
+	{
+		if(param->getUsers().empty())
+			it.emplace(new MoveOperation(NOP_REGISTER, VPM_IO_REGISTER));
+		else if(has_flag(param->decorations, ParameterDecorations::SIGN_EXTEND) || has_flag(param->decorations, ParameterDecorations::ZERO_EXTEND))
+		{
+			const Value row = method.addNewLocal(TYPE_INT32.toVectorType(param->type.num), "%param_row");
+			it.emplace(new MoveOperation(row, VPM_IO_REGISTER));
+			it.nextInBlock();
+			if(has_flag(param->decorations, ParameterDecorations::SIGN_EXTEND))
+				it = insertSignExtension(it, method, row, param->createReference());
+			else
+				it = insertZeroExtension(it, method, row, param->createReference());
+			continue;
+		}
+		else
+			it.emplace(new MoveOperation(param->createReference(), VPM_IO_REGISTER));
+		it.nextInBlock();
+	}
+	return it;
+}
+
+static void generateStartSegment(Method& method, const Configuration& config)
 {
     auto it = method.walkAllInstructions();
     if(!it.has<BranchLabel>() || BasicBlock::DEFAULT_BLOCK.compare(it.get<BranchLabel>()->getLabel()->name) != 0)
@@ -72,38 +174,37 @@ static void generateStartSegment(Method& method)
      * - group_id: id of this work-group
      * - global_offset: global initial offset per dimension
      * - address of global data / to load the global data from
-     * 
+     *
+     * Only the UNIFORMs actually read by the kernel are loaded into locals, see KernelInfo#usedUniforms
      */
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::WORK_DIMENSIONS)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::LOCAL_SIZES)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::LOCAL_IDS)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::NUM_GROUPS_X)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::NUM_GROUPS_Y)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-	it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::NUM_GROUPS_Z)->createReference(), UNIFORM_REGISTER));
-	it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::GROUP_ID_X)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::GROUP_ID_Y)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-	it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::GROUP_ID_Z)->createReference(), UNIFORM_REGISTER));
-	it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_OFFSET_X)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_OFFSET_Y)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
-	it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_OFFSET_Z)->createReference(), UNIFORM_REGISTER));
-	it.nextInBlock();
-    it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_DATA_ADDRESS)->createReference(), UNIFORM_REGISTER));
-    it.nextInBlock();
+    const uint16_t usedUniforms = getUsedWorkItemUniforms(method);
+    for(std::size_t i = 0; i < KernelInfo::WORK_ITEM_UNIFORMS.size(); ++i)
+    {
+    	if((usedUniforms & (1u << i)) != 0)
+    		it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32, KernelInfo::WORK_ITEM_UNIFORMS[i])->createReference(), UNIFORM_REGISTER));
+    	else if(!config.compactUniforms)
+    		//the UNIFORM is still passed by the run-time and needs to be skipped, but we do not need to occupy a register for it
+    		it.emplace(new MoveOperation(NOP_REGISTER, UNIFORM_REGISTER));
+    	else
+    		//the run-time only passes the UNIFORMs used (as set in the kernel-info)
+    		continue;
+    	it.nextInBlock();
+    }
     
     //load arguments to locals (via reading from uniform)
+    method.bufferedParameters = selectBufferedParameters(method, config);
     for(const Parameter& param : method.parameters)
     {
+    	if(std::find(method.bufferedParameters.begin(), method.bufferedParameters.end(), &param) != method.bufferedParameters.end())
+    		//the parameter is read from the parameter buffer below
+    		continue;
+    	if(param.getUsers().empty() && (param.type.isPointerType() || param.type.num == 1))
+    	{
+    		//the UNIFORM of an unused (e.g. specialized) parameter is still passed by the run-time and needs to be skipped
+    		it.emplace(new MoveOperation(NOP_REGISTER, UNIFORM_REGISTER));
+    		it.nextInBlock();
+    		continue;
+    	}
         //do the loading
     	//we need special treatment for non-scalar parameter (e.g. vectors), since they can't be read with just 1 UNIFORM
     	if(!param.type.isPointerType() && param.type.num != 1)
@@ -124,6 +225,27 @@ static void generateStartSegment(Method& method)
             it.nextInBlock();
         }
     }
+    //the address of the parameter buffer is passed directly after the parameters (see Configuration#bufferVectorParameters)
+    if(!method.bufferedParameters.empty())
+    	it = loadBufferedParameters(method, it);
+    //the buffer for the block counters is passed after the parameters (see Configuration#instrumentBlocks)
+    if(!method.instrumentedBlocks.empty())
+    {
+    	it.emplace(new MoveOperation(method.findOrCreateLocal(TYPE_INT32.toPointerType(), Method::BLOCK_PROFILE_BUFFER)->createReference(), UNIFORM_REGISTER));
+    	it.nextInBlock();
+    }
+    //the printf buffer is passed after the block-profile buffer (see KernelInfo#PRINTF_BUFFER_PARAMETER)
+    if(const Local* printfBuffer = method.findLocal(Method::PRINTF_BUFFER))
+    {
+    	it.emplace(new MoveOperation(printfBuffer->createReference(), UNIFORM_REGISTER));
+    	it.nextInBlock();
+    }
+    //the constants passed as UNIFORMs are read last (see Configuration#maxUniformConstants)
+    for(const auto& constant : method.uniformConstants)
+    {
+    	it.emplace(new MoveOperation(constant.first->createReference(), UNIFORM_REGISTER));
+    	it.nextInBlock();
+    }
 
 //    //write initial values to locals
 //    for(const Local& local : method.readLocals())
@@ -137,8 +259,15 @@ static void generateStartSegment(Method& method)
 //    }
 }
 
-static void generateStopSegment(Method& method)
+static void generateStopSegment(Method& method, const Configuration& config)
 {
+    if(config.threadedExecution)
+    {
+    	//give up the hardware thread for the rest of the execution, so the other thread can run exclusively
+    	method.appendToEnd((new Nop(DelayType::THREAD_END))->setSignaling(Signaling::LAST_THREAD_SWITCH));
+    	method.appendToEnd(new Nop(DelayType::THREAD_END));
+    	method.appendToEnd(new Nop(DelayType::THREAD_END));
+    }
     //write interrupt for host
     //write QPU number finished (value must be NON-NULL, so we invert it -> the first 28 bits are always 1)
     method.appendToEnd(new Operation("not", Value(REG_HOST_INTERRUPT, TYPE_INT8), Value(REG_QPU_NUMBER, TYPE_INT8)));
@@ -150,10 +279,156 @@ static void generateStopSegment(Method& method)
     method.appendToEnd(new Nop(DelayType::THREAD_END));
 }
 
+/*
+ * Checks whether the flags set before the branch are already the flags the branch requires, so they do not need to be set again.
+ * This is the case, if the last instruction setting flags is the same flag set-up (e.g. for the previous branch on the same condition)
+ * or for branches depending on all elements, the unconditional calculation of the condition itself.
+ */
+static bool areBranchFlagsSet(InstructionWalker it, const Branch* branch, const Value& firstArg)
+{
+	const Value cond = branch->getCondition();
+	it.previousInBlock();
+	while(!it.isStartOfBlock())
+	{
+		if(it.has())
+		{
+			if(it.anyInstructionMatches([](const IntermediateInstruction* instr) -> bool {return instr->setFlags == SetFlag::SET_FLAGS;}))
+			{
+				const Operation* op = it.get<Operation>();
+				if(op != nullptr && op->opCode == "or" && op->hasValueType(ValueType::REGISTER) && op->getOutput().get().hasRegister(REG_NOP) &&
+						!op->hasConditionalExecution() && op->getFirstArg() == firstArg && op->getSecondArg() && op->getSecondArg().get() == cond)
+					return true;
+				return has_flag(branch->decoration, InstructionDecorations::BRANCH_ON_ALL_ELEMENTS) && cond.hasType(ValueType::LOCAL) &&
+						it->writesLocal(cond.local) && !it->hasConditionalExecution() && !it->hasPackMode() && !it.has<CombinedOperation>();
+			}
+			//the condition is modified after the flags are set
+			if(cond.hasType(ValueType::LOCAL) && it->writesLocal(cond.local))
+				return false;
+		}
+		it.previousInBlock();
+	}
+	return false;
+}
+
+/*
+ * Finds the unconditional flag setter the boolean value is calculated from directly before the given position within the same block,
+ * i.e. "mov.T %cond, true" and "xor.T' %cond, true, true" (see intrinsifyIntegerRelation) after the setter.
+ *
+ * Returns the setter and sets the condition the boolean is true for, nullptr if the boolean is calculated in any other way.
+ */
+static const IntermediateInstruction* findBooleanFlags(InstructionWalker it, const Local* boolean, ConditionCode& trueCode)
+{
+	if(boolean->getUsers().getNumWriters() != 2)
+		return nullptr;
+	ConditionCode trueCond = COND_NEVER;
+	ConditionCode falseCond = COND_NEVER;
+	it.previousInBlock();
+	while(!it.isStartOfBlock())
+	{
+		if(it.has())
+		{
+			if(it->signal == Signaling::THREAD_SWITCH || it->signal == Signaling::LAST_THREAD_SWITCH || it.has<MethodCall>())
+				return nullptr;
+			if(it.anyInstructionMatches([](const IntermediateInstruction* instr) -> bool {return instr->setFlags == SetFlag::SET_FLAGS;}))
+			{
+				if(trueCond == COND_NEVER || falseCond != trueCond.invert() || it.has<CombinedOperation>() || it->hasConditionalExecution() || it->hasPackMode())
+					return nullptr;
+				trueCode = trueCond;
+				return it.get();
+			}
+			if(it->writesLocal(boolean))
+			{
+				if(it.has<CombinedOperation>() || !it->hasConditionalExecution() || it->hasPackMode() || it->hasUnpackMode())
+					return nullptr;
+				const MoveOperation* move = it.get<MoveOperation>();
+				const Operation* op = it.get<Operation>();
+				if(move != nullptr && !it.has<VectorRotation>() && move->getSource().hasLiteral(BOOL_TRUE.literal))
+					trueCond = it->conditional;
+				else if(move != nullptr && !it.has<VectorRotation>() && move->getSource().hasLiteral(BOOL_FALSE.literal))
+					falseCond = it->conditional;
+				else if(op != nullptr && op->opCode == "xor" && op->getSecondArg() && op->getFirstArg() == op->getSecondArg().get())
+					falseCond = it->conditional;
+				else
+					return nullptr;
+			}
+		}
+		it.previousInBlock();
+	}
+	return nullptr;
+}
+
+/*
+ * Removes the flag set-ups inserted for branches on a boolean calculated from the flags of a comparison, if the flags of the comparison
+ * are the same for all SIMD elements and still set at the branches. The branches then depend directly on the flags of the comparison.
+ *
+ * The boolean stays the condition of the branches, so the control-flow is not modified.
+ */
+static void useComparisonFlags(Method& method, const std::vector<InstructionWalker>& setups)
+{
+	if(setups.empty())
+		return;
+	//the start and stop segments modify the control-flow
+	method.getAnalyses().invalidate();
+	const analysis::FlagsAnalysis& flags = method.getAnalyses().getFlags();
+	std::size_t num = 0;
+	for(InstructionWalker setup : setups)
+	{
+		const Operation* op = setup.get<Operation>();
+		if(op == nullptr || op->getFirstArg() != ELEMENT_NUMBER_REGISTER || !op->getSecondArg() || !op->getSecondArg().get().hasType(ValueType::LOCAL))
+			continue;
+		const Value cond = op->getSecondArg().get();
+		ConditionCode trueCode = COND_NEVER;
+		const IntermediateInstruction* setter = findBooleanFlags(setup, cond.local, trueCode);
+		if(setter == nullptr || !flags.hasUniformFlags(setter))
+			continue;
+		//all instructions reading the flags of the set-up need to be branches on the same boolean
+		std::vector<Branch*> branches;
+		bool isOverwritten = false;
+		bool canBeRemoved = true;
+		InstructionWalker it = setup.copy().nextInBlock();
+		while(!it.isEndOfBlock())
+		{
+			if(it.has())
+			{
+				if(it->hasConditionalExecution())
+				{
+					Branch* branch = it.get<Branch>();
+					if(branch == nullptr || has_flag(branch->decoration, InstructionDecorations::BRANCH_ON_ALL_ELEMENTS) || branch->getCondition() != cond)
+					{
+						canBeRemoved = false;
+						break;
+					}
+					branches.push_back(branch);
+				}
+				if(it->signal == Signaling::THREAD_SWITCH || it->signal == Signaling::LAST_THREAD_SWITCH ||
+						it.anyInstructionMatches([](const IntermediateInstruction* instr) -> bool {return instr->setFlags == SetFlag::SET_FLAGS;}))
+				{
+					isOverwritten = true;
+					break;
+				}
+			}
+			it.nextInBlock();
+		}
+		if(!canBeRemoved || branches.empty() || (!isOverwritten && flags.areFlagsLiveAfter(*setup.getBasicBlock())))
+			continue;
+		for(Branch* branch : branches)
+		{
+			//the flags are the same for all elements, so the branch is taken if the condition holds for all of them
+			branch->conditional = branch->conditional == COND_ZERO_CLEAR ? trueCode : trueCode.invert();
+			branch->setDecorations(InstructionDecorations::BRANCH_ON_ALL_ELEMENTS);
+		}
+		DEBUG_LOG("Using flags of comparison for branches on: " << cond.to_string() << logging::endl);
+		setup.erase();
+		++num;
+	}
+	DEBUG_LOG("Removed " << num << " flag set-ups for branches" << logging::endl);
+}
+
 static void extendBranches(Method& method)
 {
     std::size_t num = 0;
-    logging::debug() << "-----" << logging::endl;
+    std::vector<InstructionWalker> setups;
+    DEBUG_LOG("-----" << logging::endl);
     auto it = method.walkAllInstructions();
     while(!it.isEndOfMethod())
 	{
@@ -168,13 +443,14 @@ static void extendBranches(Method& method)
 				 *
 				 * Using ELEMENT_NUMBER sets the vector-elements 1 to 15 to a non-zero value and 0 to either 0 (if condition was false) or 1 (if condition was true)
 				 */
-				//TODO can be skipped, if it is checked/guaranteed, that the last instruction setting flags is the boolean-selection for the given condition
-				//but we need to check more than the last instructions, since there could be moves inserted by phi
-				if(has_flag(branch->decoration, InstructionDecorations::BRANCH_ON_ALL_ELEMENTS))
-					it.emplace(new Operation("or", NOP_REGISTER, branch->getCondition(), branch->getCondition(), COND_ALWAYS, SetFlag::SET_FLAGS));
-				else
-					it.emplace(new Operation("or", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, branch->getCondition(), COND_ALWAYS, SetFlag::SET_FLAGS));
-				it.nextInBlock();
+				const Value firstArg = has_flag(branch->decoration, InstructionDecorations::BRANCH_ON_ALL_ELEMENTS) ? branch->getCondition() : ELEMENT_NUMBER_REGISTER;
+				//the set-up can be skipped, if the flags are still set from the previous branch on the same condition
+				if(!areBranchFlagsSet(it, branch, firstArg))
+				{
+					it.emplace(new Operation("or", NOP_REGISTER, firstArg, branch->getCondition(), COND_ALWAYS, SetFlag::SET_FLAGS));
+					setups.push_back(it.copy());
+					it.nextInBlock();
+				}
 			}
 			++num;
 			//go to next instruction
@@ -186,12 +462,435 @@ static void extendBranches(Method& method)
 		}
 		it.nextInMethod();
 	}
-    logging::debug() << "Extended " << num << " branches" << logging::endl;
+    DEBUG_LOG("Extended " << num << " branches" << logging::endl);
+    useComparisonFlags(method, setups);
+}
+
+/*
+ * Checks whether the flags set before the given instruction are read afterwards, before they are overwritten.
+ * The flags are not preserved across a thread switch.
+ */
+static bool areFlagsLiveAt(InstructionWalker it)
+{
+	while(!it.isEndOfBlock())
+	{
+		if(it.has() && it->hasConditionalExecution())
+			return true;
+		if(it.has() && it->setFlags == SetFlag::SET_FLAGS)
+			return false;
+		it.nextInBlock();
+	}
+	//the flags could be read in the succeeding block
+	return true;
+}
+
+static void insertThreadSwitches(Method& method)
+{
+	std::size_t num = 0;
+	auto it = method.walkAllInstructions();
+	while(!it.isEndOfMethod())
+	{
+		if(it.has() && (it->signal == Signaling::LOAD_TMU0 || it->signal == Signaling::LOAD_TMU1) && !areFlagsLiveAt(it))
+		{
+			//switch to the other hardware thread while waiting for the TMU result,
+			//the thread switch takes effect after 2 delay slots
+			it.emplace((new Nop(DelayType::WAIT_TMU))->setSignaling(Signaling::THREAD_SWITCH));
+			it.nextInBlock();
+			it.emplace(new Nop(DelayType::WAIT_TMU));
+			it.nextInBlock();
+			it.emplace(new Nop(DelayType::WAIT_TMU));
+			it.nextInBlock();
+			++num;
+		}
+		it.nextInMethod();
+	}
+	DEBUG_LOG("Inserted " << num << " thread switches" << logging::endl);
+}
+
+/*
+ * The registers read and written by the instruction, with the locals replaced by the registers they are mapped to
+ */
+static void getAccessedRegisters(InstructionWalker it, const FastMap<const Local*, Register>& registerMapping, std::vector<Register>& readRegisters, std::vector<Register>& writtenRegisters)
+{
+	auto toRegister = [&registerMapping](const Value& val, std::vector<Register>& registers) -> void
+	{
+		if(val.hasType(ValueType::REGISTER) && val.reg != REG_NOP)
+			registers.push_back(val.reg);
+		else if(val.hasType(ValueType::LOCAL) && registerMapping.find(val.local) != registerMapping.end())
+			registers.push_back(registerMapping.at(val.local));
+	};
+	it.forAllInstructions([&](const IntermediateInstruction* instr) -> void
+	{
+		for(const Value& arg : instr->getArguments())
+			toRegister(arg, readRegisters);
+		if(instr->getOutput())
+			toRegister(instr->getOutput().get(), writtenRegisters);
+	});
+}
+
+static bool accessesAny(const std::vector<Register>& registers, const std::vector<Register>& other)
+{
+	//registers with the same number are treated as the same register, e.g. the physical register-files A and B
+	return std::any_of(registers.begin(), registers.end(), [&other](const Register& reg) -> bool
+	{
+		return std::any_of(other.begin(), other.end(), [&reg](const Register& o) -> bool {return o.num == reg.num;});
+	});
+}
+
+/*
+ * Checks whether the second instruction can directly follow the first one:
+ * a value written into a physical register-file cannot be read in the next instruction and the input of a vector rotation cannot be written in the previous instruction
+ */
+static bool canFollow(InstructionWalker first, InstructionWalker second, const FastMap<const Local*, Register>& registerMapping)
+{
+	std::vector<Register> firstReads, firstWrites, secondReads, secondWrites;
+	getAccessedRegisters(first, registerMapping, firstReads, firstWrites);
+	getAccessedRegisters(second, registerMapping, secondReads, secondWrites);
+	for(const Register& reg : firstWrites)
+	{
+		for(const Register& read : secondReads)
+		{
+			if(read.num == reg.num && (!reg.isAccumulator() || second.has<VectorRotation>()))
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Whether the instruction can be moved into the delay slots of a branch: it needs to be a simple calculation,
+ * which only depends on the locals (and not on the flags, signals, periphery registers or the implicitly written accumulators r4 and r5)
+ */
+static bool canBeMovedIntoDelaySlot(InstructionWalker it, const FastMap<const Local*, Register>& registerMapping)
+{
+	if(!it.has() || it.has<Nop>() || it.has<Branch>() || it.has<BranchLabel>() || it.has<VectorRotation>() || !it->mapsToASMInstruction())
+		return false;
+	if(!it.allInstructionMatches([](const IntermediateInstruction* instr) -> bool
+	{
+		return !instr->hasSideEffects() && !instr->hasConditionalExecution() && instr->setFlags == SetFlag::DONT_SET && !instr->hasValueType(ValueType::REGISTER) &&
+				std::none_of(instr->getArguments().begin(), instr->getArguments().end(), [](const Value& arg) -> bool {return arg.hasType(ValueType::REGISTER);});
+	}))
+		return false;
+	std::vector<Register> reads, writes;
+	getAccessedRegisters(it, registerMapping, reads, writes);
+	return std::none_of(reads.begin(), reads.end(), [](const Register& reg) -> bool {return reg == REG_SFU_OUT || reg == REG_ACC5;}) &&
+			std::none_of(writes.begin(), writes.end(), [](const Register& reg) -> bool {return reg == REG_SFU_OUT || reg == REG_ACC5;});
+}
+
+static InstructionWalker getNextInstruction(InstructionWalker it)
+{
+	it.nextInMethod();
+	while(!it.isEndOfMethod() && (!it.has() || it.has<BranchLabel>() || !it->mapsToASMInstruction()))
+		it.nextInMethod();
+	return it;
+}
+
+static InstructionWalker getPreviousInstruction(InstructionWalker it)
+{
+	it.previousInBlock();
+	while(!it.isStartOfBlock() && (!it.has() || !it->mapsToASMInstruction()))
+		it.previousInBlock();
+	return it;
+}
+
+/*
+ * Returns the general-purpose register the value is located in, either the register itself or the register the local is mapped to
+ */
+static Optional<Register> getMappedRegister(const Value& val, const FastMap<const Local*, Register>& registerMapping)
+{
+	if(val.hasType(ValueType::REGISTER) && val.reg.isGeneralPurpose())
+		return val.reg;
+	if(val.hasType(ValueType::LOCAL))
+	{
+		auto it = registerMapping.find(val.local);
+		if(it != registerMapping.end())
+			return it->second;
+	}
+	return Optional<Register>(false, Register{});
+}
+
+/*
+ * Whether the instructions before the given position do not depend on the number of instructions following them,
+ * e.g. none of the previous 3 instructions is a NOP or accesses a periphery register
+ */
+static bool canRemoveInstructionAfter(InstructionWalker it)
+{
+	bool canBeRemoved = true;
+	InstructionWalker previous = it;
+	for(std::size_t i = 0; i < 3 && canBeRemoved; ++i)
+	{
+		previous = getPreviousInstruction(previous);
+		canBeRemoved = !previous.isStartOfBlock() && !previous.has<Nop>() && !previous.has<Branch>() && previous.allInstructionMatches([](const IntermediateInstruction* instr) -> bool
+		{
+			return !instr->hasSideEffects() && (!instr->hasValueType(ValueType::REGISTER) || instr->getOutput().get().reg.isGeneralPurpose());
+		});
+	}
+	return canBeRemoved;
+}
+
+/*
+ * Removes the plain copies of a register into itself, e.g. between locals assigned to the same register (see GraphColoring).
+ *
+ * A copy is only removed, if the instructions before and after it can follow each other directly
+ * and the copy might not be required to delay a previous instruction (e.g. an instruction accessing a periphery register or a NOP the copy replaced)
+ */
+static void removeCoalescedCopies(Method& method, const FastMap<const Local*, Register>& registerMapping)
+{
+	std::size_t num = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		InstructionWalker it = block.begin().nextInBlock();
+		while(!it.isEndOfBlock())
+		{
+			const MoveOperation* move = it.get<MoveOperation>();
+			if(move == nullptr || it.has<VectorRotation>() || !move->getOutput() || move->conditional != COND_ALWAYS || move->hasSideEffects() ||
+					move->setFlags != SetFlag::DONT_SET || move->hasPackMode() || move->hasUnpackMode())
+			{
+				it.nextInBlock();
+				continue;
+			}
+			const Optional<Register> source = getMappedRegister(move->getSource(), registerMapping);
+			const Optional<Register> dest = getMappedRegister(move->getOutput().get(), registerMapping);
+			if(!source || !dest || source.get() != dest.get())
+			{
+				it.nextInBlock();
+				continue;
+			}
+			const bool canBeRemoved = canRemoveInstructionAfter(it);
+			InstructionWalker next = it.copy().nextInBlock();
+			while(!next.isEndOfBlock() && (!next.has() || !next->mapsToASMInstruction()))
+				next.nextInBlock();
+			if(!canBeRemoved || next.isEndOfBlock() || next.has<Branch>() || !canFollow(getPreviousInstruction(it), next, registerMapping))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			DEBUG_LOG("Removing copy of a register into itself: " << move->to_string() << logging::endl);
+			it.erase();
+			++num;
+		}
+	}
+	DEBUG_LOG("Removed " << num << " copies of registers into themselves" << logging::endl);
+}
+
+/*
+ * Removes the NOPs inserted to delay the read of a value written in the previous instruction (e.g. by #splitReadAfterWrites),
+ * which are not required with the registers assigned, e.g. since the value is located in an accumulator
+ */
+static void removeRegisterDelays(Method& method, const FastMap<const Local*, Register>& registerMapping)
+{
+	std::size_t num = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		InstructionWalker it = block.begin().nextInBlock();
+		while(!it.isEndOfBlock())
+		{
+			const Nop* nop = it.get<Nop>();
+			if(nop == nullptr || nop->type != DelayType::WAIT_REGISTER || nop->hasSideEffects() || !canRemoveInstructionAfter(it))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			InstructionWalker next = it.copy().nextInBlock();
+			while(!next.isEndOfBlock() && (!next.has() || !next->mapsToASMInstruction()))
+				next.nextInBlock();
+			if(next.isEndOfBlock() || next.has<Branch>() || !canFollow(getPreviousInstruction(it), next, registerMapping))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			it.erase();
+			++num;
+		}
+	}
+	DEBUG_LOG("Removed " << num << " NOPs not required with the assigned registers" << logging::endl);
+}
+
+/*
+ * Whether the two instructions can be executed as a single instruction with the registers they are assigned:
+ * The outputs need to be in different physical register-files (or accumulators) and the inputs need to be read via a single address per physical file,
+ * where a small immediate occupies the address of register-file B
+ */
+static bool fitsRegisterFiles(const IntermediateInstruction* first, const IntermediateInstruction* second, const FastMap<const Local*, Register>& registerMapping)
+{
+	Optional<Register> inputA(false, Register{});
+	Optional<Register> inputB(false, Register{});
+	bool usesImmediate = false;
+	for(const IntermediateInstruction* instr : {first, second})
+	{
+		for(const Value& arg : instr->getArguments())
+		{
+			if(arg.hasType(ValueType::SMALL_IMMEDIATE) || arg.hasType(ValueType::LITERAL))
+			{
+				usesImmediate = true;
+				continue;
+			}
+			const Optional<Register> reg = getMappedRegister(arg, registerMapping);
+			if(!reg)
+				return false;
+			if(reg.get().isAccumulator())
+				continue;
+			Optional<Register>& input = reg.get().file == RegisterFile::PHYSICAL_A ? inputA : inputB;
+			if((reg.get().file != RegisterFile::PHYSICAL_A && reg.get().file != RegisterFile::PHYSICAL_B) || (input && input.get() != reg.get()))
+				return false;
+			input = reg.get();
+		}
+	}
+	if(usesImmediate && inputB)
+		return false;
+	const Optional<Register> firstOut = getMappedRegister(first->getOutput().get(), registerMapping);
+	const Optional<Register> secondOut = getMappedRegister(second->getOutput().get(), registerMapping);
+	if(!firstOut || !secondOut)
+		return false;
+	//both ALUs can write the same accumulator (with inverted conditions), but not two registers of the same physical file
+	return firstOut.get().isAccumulator() || secondOut.get().isAccumulator() || firstOut.get().file != secondOut.get().file;
+}
+
+/*
+ * Combines the neighboring instructions, which were not combined before the register allocation (see #combineOperations),
+ * e.g. since they were separated by a NOP or copy removed afterwards.
+ *
+ * Only simple calculations of locals (without pack-modes or signals) are combined, if their registers can be addressed in a single instruction
+ * and the instructions before and after the pair can follow the combined instruction directly.
+ */
+static void combineAfterAllocation(Method& method, const FastMap<const Local*, Register>& registerMapping)
+{
+	auto isSimpleCalculation = [](InstructionWalker it) -> bool
+	{
+		return (it.has<Operation>() || (it.has<MoveOperation>() && !it.has<VectorRotation>())) && it->getOutput() && !it->hasSideEffects() &&
+				it->signal == Signaling::NO_SIGNAL && !it->hasPackMode() && !it->hasUnpackMode() && !it->hasValueType(ValueType::REGISTER);
+	};
+	std::size_t num = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		InstructionWalker it = block.begin().nextInBlock();
+		while(!it.isEndOfBlock())
+		{
+			if(!it.has() || !isSimpleCalculation(it))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			InstructionWalker next = it.copy().nextInBlock();
+			while(!next.isEndOfBlock() && !next.has())
+				next.nextInBlock();
+			if(next.isEndOfBlock() || !isSimpleCalculation(next) || !optimizations::canCombineInstructions(it.get(), next.get()) || !fitsRegisterFiles(it.get(), next.get(), registerMapping))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			//the second instruction is executed one instruction earlier and the first instruction is directly followed by the instruction after the pair
+			const InstructionWalker previous = getPreviousInstruction(it);
+			InstructionWalker following = next.copy().nextInBlock();
+			while(!following.isEndOfBlock() && (!following.has() || !following->mapsToASMInstruction()))
+				following.nextInBlock();
+			if(previous.isStartOfBlock() || following.isEndOfBlock() || !canFollow(previous, next, registerMapping) || !canFollow(it, following, registerMapping))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			if(optimizations::combineWithNextInstruction(it, next))
+				++num;
+			it.nextInBlock();
+		}
+	}
+	DEBUG_LOG("Combined " << num << " pairs of instructions after the register allocation" << logging::endl);
+}
+
+/*
+ * Replaces the NOPs in the delay slots of the first branch of every basic block with independent instructions from before the branch.
+ *
+ * The delay slots are always executed (whether the branch is taken or not), so any instruction, which is not required for the branch (e.g. its condition)
+ * and is not depending on the flags can be moved there.
+ * This is done after the register allocation, so no instruction is inserted into the delay slots afterwards.
+ */
+static void fillBranchDelaySlots(Method& method, const FastMap<const Local*, Register>& registerMapping)
+{
+	std::size_t num = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		InstructionWalker branchIt = block.begin();
+		while(!branchIt.isEndOfBlock() && !branchIt.has<Branch>())
+			branchIt.nextInBlock();
+		if(branchIt.isEndOfBlock())
+			continue;
+		std::vector<InstructionWalker> delaySlots;
+		InstructionWalker slot = branchIt.copy().nextInBlock();
+		while(!slot.isEndOfBlock() && delaySlots.size() < 3 && slot.has<Nop>() && slot.get<Nop>()->type == DelayType::BRANCH_DELAY && !slot->hasSideEffects())
+		{
+			delaySlots.push_back(slot);
+			slot.nextInBlock();
+		}
+		if(delaySlots.size() != 3)
+			continue;
+		//the instructions following the last delay slot, if the branch is taken or not
+		std::vector<InstructionWalker> followers;
+		followers.push_back(getNextInstruction(delaySlots.back()));
+		BasicBlock* targetBlock = method.findBasicBlock(branchIt.get<Branch>()->getTarget());
+		if(targetBlock != nullptr)
+			followers.push_back(getNextInstruction(targetBlock->begin()));
+
+		//collect the instructions to move together with the registers accessed by all instructions between them and the branch.
+		//Since the moved instructions are also added to the accessed registers, they are independent of each other and can be placed in any order
+		std::vector<InstructionWalker> candidates;
+		std::vector<Register> readInBetween, writtenInBetween;
+		getAccessedRegisters(branchIt, registerMapping, readInBetween, writtenInBetween);
+		InstructionWalker it = getPreviousInstruction(branchIt);
+		std::size_t instructionsLeft = REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK;
+		while(!it.isStartOfBlock() && candidates.size() < delaySlots.size() && instructionsLeft > 0)
+		{
+			//do not move instructions over thread switches, TMU loads, etc.
+			if(it.has<Nop>() && it->hasSideEffects())
+				break;
+			std::vector<Register> reads, writes;
+			getAccessedRegisters(it, registerMapping, reads, writes);
+			bool canMove = canBeMovedIntoDelaySlot(it, registerMapping) && !accessesAny(writes, readInBetween) && !accessesAny(writes, writtenInBetween) && !accessesAny(reads, writtenInBetween);
+			if(canMove)
+			{
+				//the instructions before and after the moved instruction(s) become neighbors
+				const InstructionWalker previous = getPreviousInstruction(it);
+				InstructionWalker next = getNextInstruction(it);
+				while(std::find(candidates.begin(), candidates.end(), next) != candidates.end())
+					next = getNextInstruction(next);
+				canMove = !previous.isStartOfBlock() && canFollow(previous, next, registerMapping);
+			}
+			if(canMove)
+				candidates.push_back(it);
+			readInBetween.insert(readInBetween.end(), reads.begin(), reads.end());
+			writtenInBetween.insert(writtenInBetween.end(), writes.begin(), writes.end());
+			it = getPreviousInstruction(it);
+			--instructionsLeft;
+		}
+		if(candidates.size() == delaySlots.size())
+		{
+			//the instruction in the last delay slot is followed by the first instruction of either successor block
+			auto last = std::find_if(candidates.begin(), candidates.end(), [&followers, &registerMapping](InstructionWalker candidate) -> bool
+			{
+				return std::all_of(followers.begin(), followers.end(), [&candidate, &registerMapping](InstructionWalker follower) -> bool
+				{
+					return follower.isEndOfMethod() || canFollow(candidate, follower, registerMapping);
+				});
+			});
+			if(last == candidates.end())
+				candidates.pop_back();
+			else
+				std::iter_swap(last, candidates.end() - 1);
+		}
+		//the delay slots are filled from the front, the remaining delay slots stay NOPs
+		for(std::size_t i = 0; i < candidates.size(); ++i)
+		{
+			DEBUG_LOG("Moving instruction into branch delay slot: " << candidates[i]->to_string() << logging::endl);
+			delaySlots[i].reset(candidates[i].release());
+			candidates[i].erase();
+			++num;
+		}
+	}
+	DEBUG_LOG("Filled " << num << " branch delay slots" << logging::endl);
 }
 
 static FastMap<const Local*, std::size_t> mapLabels(Method& method)
 {
-    logging::debug() << "-----" << logging::endl;
+    DEBUG_LOG("-----" << logging::endl);
     FastMap<const Local*, std::size_t> labelsMap;
     //index is in bytes, so an increment of 1 instructions, increments by 8 bytes
     std::size_t index = 0;
@@ -202,7 +901,7 @@ static FastMap<const Local*, std::size_t> mapLabels(Method& method)
     	BranchLabel* label = it.isEndOfBlock() ? nullptr : it.get<BranchLabel>();
 		if (label != nullptr)
 		{
-			logging::debug() << "Mapping label '" << label->getLabel()->name << "' to byte-position " << index << logging::endl;
+			DEBUG_LOG("Mapping label '" << label->getLabel()->name << "' to byte-position " << index << logging::endl);
 			labelsMap[label->getLabel()] = index;
 			//we do not need the position of the label at all anymore
 			it.erase();
@@ -221,46 +920,159 @@ static FastMap<const Local*, std::size_t> mapLabels(Method& method)
 			//this handles empty basic blocks, so the index is not incremented in the next iteration
 			it.nextInMethod();
 	}
-    logging::debug() << "Mapped " << labelsMap.size() << " labels to positions" << logging::endl;
+    DEBUG_LOG("Mapped " << labelsMap.size() << " labels to positions" << logging::endl);
 
     return labelsMap;
 }
 
-const FastModificationList<std::unique_ptr<qpu_asm::Instruction>>& CodeGenerator::generateInstructions(Method& method)
+static FastMap<const Local*, Register> colorGraph(Method& method, const CompilationBudget& budget, std::size_t& numRounds)
 {
-	PROFILE_COUNTER(100000, "CodeGeneration (before)", method.countInstructions());
-#ifdef MULTI_THREADED
-	instructionsLock.lock();
-#endif
-    auto& generatedInstructions = allInstructions[&method];
-#ifdef MULTI_THREADED
-    instructionsLock.unlock();
-#endif
-    //prepend start segment
-    generateStartSegment(method);
-    //append end segment
-    generateStopSegment(method);
-
-    //expand branches (add 3 NOPs)
-    extendBranches(method);
-
     //check and fix possible errors with register-association
     PROFILE_START(initializeLocalsUses);
-	GraphColoring coloring(method, method.walkAllInstructions());
+	std::unique_ptr<GraphColoring> coloring(new GraphColoring(method, method.walkAllInstructions()));
 	PROFILE_END(initializeLocalsUses);
 	PROFILE_START(colorGraph);
 	std::size_t round = 0;
-	while(round < REGISTER_RESOLVER_MAX_ROUNDS && !coloring.colorGraph())
+	bool liveRangesSplit = false;
+	while(round < REGISTER_RESOLVER_MAX_ROUNDS)
 	{
-		if(coloring.fixErrors())
+		//every round is recorded on its own, to show the rounds in the trace
+		PROFILE_START(colorGraphRound);
+		const bool isColored = coloring->colorGraph();
+		PROFILE_END(colorGraphRound);
+		++numRounds;
+		if(isColored)
+			break;
+		//the register allocation can't be skipped, so only cancellation and aborting budgets are handled here
+		budget.check(CompilationStep::LABEL_REGISTER_MAPPING, &method);
+		if(coloring->fixErrors())
 			break;
 		++round;
+		if(round == REGISTER_RESOLVER_MAX_ROUNDS)
+		{
+			//the conflicts can not be resolved with the available registers, so the live-ranges of the conflicting locals are shortened once,
+			//before the spilled locals are removed from the graph. In both cases, the resolver starts over
+			bool modified = false;
+			if(!liveRangesSplit)
+			{
+				liveRangesSplit = true;
+				modified = coloring->splitLiveRanges();
+			}
+			if(!modified)
+				modified = coloring->spillLocals();
+			if(modified)
+			{
+				coloring.reset(new GraphColoring(method, method.walkAllInstructions()));
+				round = 0;
+			}
+		}
 	}
 	if(round >= REGISTER_RESOLVER_MAX_ROUNDS)
 	{
 		logging::warn() << "Register conflict resolver has exceeded its maximum rounds, there might still be errors!" << logging::endl;
 	}
 	PROFILE_END(colorGraph);
+	PROFILE_MAXIMUM("Interference-graph nodes", coloring->getGraph().size());
+	PROFILE_MAXIMUM("Interference-graph edges", coloring->getGraph().countEdges());
+	PROFILE_MAXIMUM("Interference-graph matrix (bytes)", coloring->getGraph().getMatrixSize());
+
+    PROFILE_START(toRegisterMap);
+	PROFILE_START(toRegisterMapGraph);
+	auto registerMapping = coloring->toRegisterMap();
+	PROFILE_END(toRegisterMapGraph);
+	PROFILE_END(toRegisterMap);
+	return registerMapping;
+}
+
+static std::string toMetricsName(const intermediate::DelayType type)
+{
+	switch(type)
+	{
+		case intermediate::DelayType::BRANCH_DELAY:
+			return "branch_delay";
+		case intermediate::DelayType::WAIT_SFU:
+			return "wait_sfu";
+		case intermediate::DelayType::WAIT_TMU:
+			return "wait_tmu";
+		case intermediate::DelayType::WAIT_REGISTER:
+			return "wait_register";
+		case intermediate::DelayType::THREAD_END:
+			return "thread_end";
+		case intermediate::DelayType::WAIT_UNIFORM:
+			return "wait_uniform";
+	}
+	return "unknown";
+}
+
+const std::vector<uint64_t>& CodeGenerator::generateInstructions(Method& method)
+{
+	PROFILE_COUNTER(100000, "CodeGeneration (before)", method.countInstructions());
+	//the assembler code is only generated for the output modes writing it
+	const bool keepAssemblerCode = config.outputMode == OutputMode::ASSEMBLER || config.outputMode == OutputMode::HEX;
+#ifdef MULTI_THREADED
+	std::unique_lock<std::mutex> instructionsGuard = threading::lockMeasured(instructionsLock, instructionsLockStatistics);
+#endif
+    auto& generatedInstructions = allInstructions[&method];
+    std::vector<std::string>* assemblerCode = keepAssemblerCode ? &allAssemblerCode[&method] : nullptr;
+#ifdef MULTI_THREADED
+    instructionsGuard.unlock();
+#endif
+    //prepend start segment
+    generateStartSegment(method, config);
+    //append end segment
+    generateStopSegment(method, config);
+
+    //expand branches (add 3 NOPs)
+    extendBranches(method);
+    if(config.threadedExecution)
+    	//insert thread switches for TMU loads
+    	insertThreadSwitches(method);
+    //the start and stop segments modify the control-flow
+    method.getAnalyses().invalidate();
+
+    //map to registers
+    FastMap<const Local*, Register> registerMapping;
+    bool isAllocated = false;
+    //on exceeding a budget or for kernels compiled via the fast path, the faster linear scan (which needs no interference-graph) is tried first
+    if(config.registerAllocation == RegisterAllocation::LINEAR_SCAN || method.isFastPath ||
+    		module.budget.checkInterferenceGraph(method, ColoredGraph::estimateMatrixSize(method.readLocals().size())) ||
+			module.budget.check(CompilationStep::LABEL_REGISTER_MAPPING, &method))
+    {
+    	PROFILE_START(linearScan);
+    	LinearScanAllocator allocator(method);
+    	isAllocated = allocator.allocate();
+    	if(isAllocated)
+    		registerMapping = allocator.toRegisterMap();
+    	else
+    		DEBUG_LOG("Linear scan failed to allocate the registers, falling back to graph coloring" << logging::endl);
+    	PROFILE_END(linearScan);
+    }
+    std::size_t numRounds = 0;
+    if(!isAllocated)
+    	registerMapping = colorGraph(method, module.budget, numRounds);
+
+    std::set<Register> usedRegisters;
+    for(const auto& pair : registerMapping)
+    {
+    	if(pair.second.isGeneralPurpose() && !pair.second.isAccumulator())
+    		usedRegisters.insert(pair.second);
+    }
+#ifdef MULTI_THREADED
+	instructionsLock.lock();
+#endif
+    allocationStatistics[&method].numRegisters = static_cast<unsigned>(usedRegisters.size());
+    allocationStatistics[&method].numRounds = numRounds;
+#ifdef MULTI_THREADED
+    instructionsLock.unlock();
+#endif
+
+    //the peephole optimizations with the registers assigned run before the labels are mapped, since they remove instructions
+    removeCoalescedCopies(method, registerMapping);
+    removeRegisterDelays(method, registerMapping);
+    combineAfterAllocation(method, registerMapping);
+
+    //fill the branch delay slots with independent instructions, after the register allocation, so no more instructions are inserted into them
+    fillBranchDelaySlots(method, registerMapping);
     
     //create label-map + remove labels
     const auto labelMap = mapLabels(method);
@@ -268,51 +1080,118 @@ const FastModificationList<std::unique_ptr<qpu_asm::Instruction>>& CodeGenerator
     //IMPORTANT: DO NOT OPTIMIZE, RE-ORDER, COMBINE, INSERT OR REMOVE ANY INSTRUCTION AFTER THIS POINT!!!
     //otherwise, labels/branches will be wrong
 
-    //map to registers
-    PROFILE_START(toRegisterMap);
-	PROFILE_START(toRegisterMapGraph);
-	auto registerMapping = coloring.toRegisterMap();
-	PROFILE_END(toRegisterMapGraph);
-	PROFILE_END(toRegisterMap);
-
-    logging::debug() << "-----" << logging::endl;
+    DEBUG_LOG("-----" << logging::endl);
     std::size_t index = 0;
-    method.forAllInstructions([&generatedInstructions, &index, &registerMapping, &labelMap](const IntermediateInstruction* instr) -> bool
+    generatedInstructions.reserve(method.countInstructions());
+    if(assemblerCode != nullptr)
+    	assemblerCode->reserve(method.countInstructions());
+    method.forAllInstructions([&generatedInstructions, assemblerCode, &index, &registerMapping, &labelMap](const IntermediateInstruction* instr) -> bool
 	{
-    	Instruction* mapped = instr->convertToAsm(registerMapping, labelMap, index);
+    	//the mapped instruction is only kept until it is encoded
+    	const std::unique_ptr<Instruction> mapped(instr->convertToAsm(registerMapping, labelMap, index));
 		if (mapped != nullptr) {
-			generatedInstructions.emplace_back(mapped);
+			generatedInstructions.push_back(mapped->toBinaryCode());
+			if(assemblerCode != nullptr)
+				assemblerCode->push_back(mapped->toASMString());
 		}
 		++index;
 		return true;
 	});
 
-    logging::debug() << "-----" << logging::endl;
+    DEBUG_LOG("-----" << logging::endl);
     index = 0;
-    for (const std::unique_ptr<Instruction>& instr : generatedInstructions) {
-        logging::debug() << std::hex << index << ' ' << instr->toHexString(true) << logging::endl;
+    for (const uint64_t code : generatedInstructions) {
+        DEBUG_LOG(std::hex << index << ' ' << Instruction::decode(code)->toHexString(true) << logging::endl);
         index += 8;
     }
-    logging::debug() << "Generated " << std::dec << generatedInstructions.size() << " instructions!" << logging::endl;
+    DEBUG_LOG("Generated " << std::dec << generatedInstructions.size() << " instructions!" << logging::endl);
+
+    //the offset of the kernel is only known when the output is written
+    KernelInfo info = getKernelInfos(method, 0, generatedInstructions.size());
+    info.batchedWorkGroups = config.batchWorkGroups || periphery::hasTextureAccesses(method);
+    std::map<std::string, std::size_t> nopsByReason;
+    method.forAllInstructions([&nopsByReason](const IntermediateInstruction* instr)
+	{
+		if(const intermediate::Nop* nop = dynamic_cast<const intermediate::Nop*>(instr))
+			++nopsByReason[toMetricsName(nop->type)];
+	});
+#ifdef MULTI_THREADED
+	instructionsGuard = threading::lockMeasured(instructionsLock, instructionsLockStatistics);
+#endif
+	allKernelInfos.emplace(&method, std::move(info));
+	allNopsByReason[&method] = std::move(nopsByReason);
+#ifdef MULTI_THREADED
+    instructionsGuard.unlock();
+#endif
 
     PROFILE_COUNTER_WITH_PREV(1001000, "CodeGeneration (after)", generatedInstructions.size(), 100000);
     return generatedInstructions;
 }
 
-static void toBinary(const Value& val, std::vector<uint8_t>& queue)
+/*
+ * Streams the global data segment in words of 8 Bytes directly into the output, without buffering the whole segment
+ */
+class DataSegmentWriter
+{
+public:
+	DataSegmentWriter(std::ostream& stream, const OutputMode mode) : stream(stream), mode(mode), numBytes(0)
+	{
+	}
+
+	void push(const uint8_t byte)
+	{
+		word[numBytes % 8] = byte;
+		++numBytes;
+		if((numBytes % 8) == 0)
+			flush();
+	}
+
+	/*
+	 * Fills the segment with zeroes up to the given offset (in bytes)
+	 */
+	void pad(const std::size_t offset)
+	{
+		while(numBytes < offset)
+			push(0);
+	}
+
+	std::size_t size() const
+	{
+		return numBytes;
+	}
+
+private:
+	std::ostream& stream;
+	const OutputMode mode;
+	std::size_t numBytes;
+	std::array<uint8_t, 8> word;
+
+	void flush()
+	{
+		if(mode == OutputMode::BINARY)
+			stream.write(reinterpret_cast<const char*>(word.data()), word.size());
+		else if(mode == OutputMode::HEX)
+			//TODO endianess correct??
+			stream << toHexString((static_cast<uint64_t>(word[0]) << 56) | (static_cast<uint64_t>(word[1]) << 48) | (static_cast<uint64_t>(word[2]) << 40) |
+					(static_cast<uint64_t>(word[3]) << 32) | (static_cast<uint64_t>(word[4]) << 24) | (static_cast<uint64_t>(word[5]) << 16) |
+					(static_cast<uint64_t>(word[6]) << 8) | static_cast<uint64_t>(word[7])) << '\n';
+	}
+};
+
+static void toBinary(const Value& val, DataSegmentWriter& writer)
 {
 	switch(val.valueType)
 	{
 		case ValueType::CONTAINER:
 			for(const Value& element : val.container.elements)
-				toBinary(element, queue);
+				toBinary(element, writer);
 			break;
 		case ValueType::LITERAL:
 			switch(val.literal.type)
 			{
 				case LiteralType::BOOL:
 					for(std::size_t i = 0; i < val.type.getVectorWidth(true); ++i)
-						queue.push_back(val.literal.flag);
+						writer.push(val.literal.flag);
 					break;
 				case LiteralType::INTEGER:
 				case LiteralType::REAL:
@@ -321,12 +1200,12 @@ static void toBinary(const Value& val, std::vector<uint8_t>& queue)
 						//TODO endianess correct!?
 						//little endian
 						if(val.type.getElementType().getPhysicalWidth() > 3)
-							queue.push_back(static_cast<uint8_t>((val.literal.toImmediate() & 0xFF000000) >> 24));
+							writer.push(static_cast<uint8_t>((val.literal.toImmediate() & 0xFF000000) >> 24));
 						if(val.type.getElementType().getPhysicalWidth() > 2)
-							queue.push_back(static_cast<uint8_t>((val.literal.toImmediate() & 0xFF0000) >> 16));
+							writer.push(static_cast<uint8_t>((val.literal.toImmediate() & 0xFF0000) >> 16));
 						if(val.type.getElementType().getPhysicalWidth() > 1)
-							queue.push_back(static_cast<uint8_t>((val.literal.toImmediate() & 0xFF00) >> 8));
-						queue.push_back(static_cast<uint8_t>(val.literal.toImmediate() & 0xFF));
+							writer.push(static_cast<uint8_t>((val.literal.toImmediate() & 0xFF00) >> 8));
+						writer.push(static_cast<uint8_t>(val.literal.toImmediate() & 0xFF));
 					}
 					break;
 				default:
@@ -335,8 +1214,7 @@ static void toBinary(const Value& val, std::vector<uint8_t>& queue)
 			break;
 		case ValueType::UNDEFINED:
 			//e.g. for array <type> undefined, need to reserve enough bytes
-			for(std::size_t s = 0; s < val.type.getPhysicalWidth(); ++s)
-				queue.push_back(0);
+			writer.pad(writer.size() + val.type.getPhysicalWidth());
 			break;
 		//TODO structs/arrays?? (locals + struct-type??)
 		default:
@@ -344,33 +1222,180 @@ static void toBinary(const Value& val, std::vector<uint8_t>& queue)
 	}
 }
 
-static std::vector<uint8_t> generateDataSegment(const ReferenceRetainingList<Global>& globalData)
+/*
+ * Returns the globals written into the global data segment.
+ *
+ * The globals after the last global accessed by any kernel are dropped, the globals in between are kept to not change the offsets
+ */
+static std::vector<const Global*> getWrittenGlobals(const Module& module, const std::vector<const Method*>& kernels)
 {
-	logging::debug() << "Writing data segment for " << globalData.size() << " values..." << logging::endl;
-	//the first entry is the value, the second the width (in bytes)
-	std::vector<uint8_t> bytes;
-	bytes.reserve(2048);
-	for(const Global& global : globalData)
-		toBinary(global.value, bytes);
-	while((bytes.size() % 8) != 0)
+	std::size_t usedSize = 0;
+	for(const Global* global : module.getGlobalDataSegment())
 	{
-		bytes.push_back(0);
+		//globals not accessed via their address (e.g. image-configurations) are kept
+		if(!global->type.isPointerType())
+			usedSize = module.getGlobalDataOffset(global).get() + global->value.type.getPhysicalWidth();
 	}
-	return bytes;
+	for(const Method* kernel : kernels)
+	{
+		for(const Global* global : kernel->accessedGlobals)
+			usedSize = std::max(usedSize, static_cast<std::size_t>(module.getGlobalDataOffset(global).get() + global->value.type.getPhysicalWidth()));
+	}
+	std::vector<const Global*> globals;
+	for(const Global* global : module.getGlobalDataSegment())
+	{
+		if(module.getGlobalDataOffset(global).get() >= usedSize)
+		{
+			DEBUG_LOG("Dropping global not accessed by any kernel: " << global->to_string() << logging::endl);
+			continue;
+		}
+		globals.push_back(global);
+	}
+	return globals;
 }
 
-std::size_t CodeGenerator::writeOutput(std::ostream& stream)
+/*
+ * Calculates the size of the global data segment (in bytes) from the layout of the globals, padded to a multiple of 8 Bytes
+ */
+static std::size_t getDataSegmentSize(const Module& module, const std::vector<const Global*>& globals)
+{
+	std::size_t size = 0;
+	for(const Global* global : globals)
+		size = std::max(size, static_cast<std::size_t>(module.getGlobalDataOffset(global).get() + global->value.type.getPhysicalWidth()));
+	return size % 8 == 0 ? size : size + 8 - (size % 8);
+}
+
+static void writeDataSegment(std::ostream& stream, const OutputMode mode, const Module& module, const std::vector<const Global*>& globals, const std::size_t segmentSize)
 {
-	std::size_t globalDataLength = 0;
-	for(const Global& global : module.globalData)
+	DEBUG_LOG("Writing data segment for " << globals.size() << " values..." << logging::endl);
+	DataSegmentWriter writer(stream, mode);
+	for(const Global* global : globals)
 	{
-		globalDataLength += global.value.type.getPhysicalWidth();
+		//padding for the alignment of the global
+		writer.pad(module.getGlobalDataOffset(global).get());
+		toBinary(global->value, writer);
 	}
-	//add padding, so the global data is a multiple of 8 Bytes
-	if((globalDataLength % 8) != 0)
-		globalDataLength = globalDataLength + (8 - globalDataLength % 8);
+	writer.pad(segmentSize);
+	if(writer.size() != segmentSize)
+		throw CompilationError(CompilationStep::CODE_GENERATION, "Size of written global data does not match the calculated size", std::to_string(writer.size()));
+}
+
+CodeGenerator::SharedCode CodeGenerator::findSharedCode() const
+{
+	SharedCode sharedCode;
+	for(const auto& kernel : allInstructions)
+	{
+		const std::vector<uint64_t>& code = kernel.second;
+		Method* host = nullptr;
+		std::size_t hostSize = 0;
+		for(const auto& other : allInstructions)
+		{
+			const std::vector<uint64_t>& otherCode = other.second;
+			if(other.first == kernel.first || code.empty() || otherCode.size() < code.size())
+				continue;
+			//of several kernels with identical code, the first one is written
+			if(otherCode.size() == code.size() && !allInstructions.key_comp()(other.first, kernel.first))
+				continue;
+			//the longest kernel containing the code is written itself, since its code can't be part of any other kernel
+			if(host != nullptr && otherCode.size() <= hostSize)
+				continue;
+			if(std::equal(code.begin(), code.end(), otherCode.end() - static_cast<long>(code.size())))
+			{
+				host = other.first;
+				hostSize = otherCode.size();
+			}
+		}
+		if(host != nullptr)
+		{
+			DEBUG_LOG("Kernel '" << kernel.first->name << "' shares its " << code.size() << " instructions with kernel: " << host->name << logging::endl);
+			sharedCode.emplace(kernel.first, std::make_pair(host, hostSize - code.size()));
+		}
+	}
+	return sharedCode;
+}
+
+std::vector<KernelInfo> CodeGenerator::createKernelInfos(std::size_t offset, const SharedCode& sharedCode) const
+{
+	std::map<const Method*, std::size_t> offsets;
+	for(const auto& pair : allInstructions)
+	{
+		if(sharedCode.find(pair.first) != sharedCode.end())
+			continue;
+		offsets.emplace(pair.first, offset);
+		offset += pair.second.size();
+	}
+	std::vector<KernelInfo> infos;
+	infos.reserve(allInstructions.size());
+	for(const auto& pair : allInstructions)
+	{
+		infos.push_back(allKernelInfos.at(pair.first));
+		const auto sharedIt = sharedCode.find(pair.first);
+		infos.back().offset = static_cast<uint16_t>(sharedIt == sharedCode.end() ? offsets.at(pair.first) : offsets.at(sharedIt->second.first) + sharedIt->second.second);
+		if(config.compactUniforms)
+			infos.back().usedUniforms |= KernelInfo::UNIFORMS_COMPACTED;
+		infos.back().threadable = config.threadedExecution;
+		infos.back().numRegisters = static_cast<uint8_t>(allocationStatistics.at(pair.first).numRegisters);
+		infos.back().estimatedCycles = static_cast<uint32_t>(std::min(estimateCycles(pair.second).total.numCycles, static_cast<std::size_t>(UINT32_MAX)));
+		infos.back().isCompact = config.compactKernelInfo;
+		//the values of the UNIFORM constants are stored as type-names of their parameters
+		infos.back().withNames = config.kernelInfoNames || !pair.first->uniformConstants.empty();
+	}
+	return infos;
+}
+
+std::size_t CodeGenerator::writeContainer(std::ostream& stream, const std::vector<const Global*>& globals, const std::size_t globalDataSize) const
+{
+	//the code of every kernel starts at the begin of its own section
+	std::vector<KernelInfo> infos = createKernelInfos(0);
+	std::vector<std::size_t> infoSizes;
+	std::vector<std::size_t> codeSizes;
+	for(KernelInfo& info : infos)
+	{
+		info.offset = 0;
+		infoSizes.push_back(info.getNumWords(OutputMode::BINARY) * 8);
+	}
+	for(const auto& pair : allInstructions)
+		codeSizes.push_back(pair.second.size() * 8);
+	const std::vector<SectionEntry> sections = layoutContainer(globalDataSize, infoSizes, codeSizes);
+
+	std::size_t position = writeContainerHeader(stream, sections);
+	auto section = sections.begin();
+	for(const KernelInfo& info : infos)
+	{
+		position = padToSection(stream, position, *section);
+		info.write(stream, OutputMode::BINARY);
+		position += section->size;
+		++section;
+	}
+	position = padToSection(stream, position, *section);
+	writeDataSegment(stream, OutputMode::BINARY, module, globals, globalDataSize);
+	position += globalDataSize;
+	++section;
+	for(const auto& pair : allInstructions)
+	{
+		position = padToSection(stream, position, *section);
+		stream.write(reinterpret_cast<const char*>(pair.second.data()), static_cast<std::streamsize>(pair.second.size() * 8));
+		position += pair.second.size() * 8;
+		++section;
+	}
+	stream.flush();
+	return position;
+}
+
+std::size_t CodeGenerator::writeOutput(std::ostream& stream)
+{
+	std::vector<const Method*> kernels;
+	for(const auto& pair : allInstructions)
+		kernels.push_back(pair.first);
+	const std::vector<const Global*> globals = getWrittenGlobals(module, kernels);
+	//the global data is padded to a multiple of 8 Bytes
+	const std::size_t globalDataSize = getDataSegmentSize(module, globals);
+	if(config.indexedContainer && config.outputMode == OutputMode::BINARY)
+		return writeContainer(stream, globals, globalDataSize);
 	//add a single dummy-command as delimiter
-	globalDataLength += 8;
+	const std::size_t globalDataLength = globalDataSize + 8;
+	//the assembler code is written for every kernel to stay readable, without kernel-infos the shared code could not be found
+	const SharedCode sharedCode = config.outputMode == OutputMode::ASSEMBLER || !config.writeKernelInfo ? SharedCode{} : findSharedCode();
 
     std::size_t numBytes = 0;
     //initial offset -> magic number + global data length
@@ -388,20 +1413,13 @@ std::size_t CodeGenerator::writeOutput(std::ostream& stream)
      }
     if(config.writeKernelInfo)
     {
-        std::vector<KernelInfo> infos;
-        infos.reserve(allInstructions.size());
         //generate kernel-infos
-        for(const auto& pair : allInstructions)
-        {
-            infos.push_back(getKernelInfos(*pair.first, offset, pair.second.size()));
-            offset += pair.second.size();
-        }
+        std::vector<KernelInfo> infos = createKernelInfos(offset, sharedCode);
         //add global offset (size of all kernel-infos)
-        std::ostringstream dummyStream;
         offset = 0;
         for(const KernelInfo& info : infos)
         {
-            offset += info.write(dummyStream, config.outputMode);
+            offset += info.getNumWords(config.outputMode);
         }
         //for the dummy-command as delimiter
         offset += 1;
@@ -428,14 +1446,13 @@ std::size_t CodeGenerator::writeOutput(std::ostream& stream)
     {
     	case OutputMode::ASSEMBLER:
     	{
-    		for(const Global& global : module.globalData)
-    			stream << global.to_string(true) << std::endl;
+    		for(const Global* global : globals)
+    			stream << global->to_string(true) << std::endl;
     		break;
     	}
     	case OutputMode::BINARY:
     	{
-    		const auto binary = generateDataSegment(module.globalData);
-    		stream.write((const char*)binary.data(), binary.size());
+    		writeDataSegment(stream, config.outputMode, module, globals, globalDataSize);
     		//add empty command
 			uint64_t zero = 0;
 			stream.write((char*)&zero, sizeof(uint64_t));
@@ -444,14 +1461,9 @@ std::size_t CodeGenerator::writeOutput(std::ostream& stream)
     	}
     	case OutputMode::HEX:
     	{
-			const auto binary = generateDataSegment(module.globalData);
-			for(const Global& global : module.globalData)
-				stream << "//" << global.to_string(true) << std::endl;
-			for(std::size_t i = 0; i < binary.size(); i += 8)
-				//TODO endianess correct??
-				stream << toHexString((static_cast<uint64_t>(binary.at(i)) << 56) | (static_cast<uint64_t>(binary.at(i+1)) << 48) | (static_cast<uint64_t>(binary.at(i+2)) << 40) |
-						(static_cast<uint64_t>(binary.at(i+3)) << 32) | (static_cast<uint64_t>(binary.at(i+4)) << 24) | (static_cast<uint64_t>(binary.at(i+5)) << 16) |
-						(static_cast<uint64_t>(binary.at(i+6)) << 8) | static_cast<uint64_t>(binary.at(i+7))) << std::endl;
+			for(const Global* global : globals)
+				stream << "//" << global->to_string(true) << std::endl;
+			writeDataSegment(stream, config.outputMode, module, globals, globalDataSize);
 			//add empty command
 			uint64_t zero = 0;
 			stream << zero << ',' << zero << ',' << std::endl;
@@ -460,29 +1472,104 @@ std::size_t CodeGenerator::writeOutput(std::ostream& stream)
 		}
 	}
 
+    //the textual output is collected and written in large chunks
+    TextOutputBuffer textBuffer(stream);
     for(const auto& pair : allInstructions)
     {
+        if(sharedCode.find(pair.first) != sharedCode.end())
+        	continue;
         switch (config.outputMode) {
         case OutputMode::ASSEMBLER:
-            for (const std::unique_ptr<Instruction>& instr : pair.second) {
-                stream << instr->toASMString() << std::endl;
+            for (const std::string& assemblerCode : allAssemblerCode.at(pair.first)) {
+                textBuffer.writeASM(assemblerCode);
                 numBytes += 0;//XXX ??
             }
             break;
         case OutputMode::BINARY:
-            for (const std::unique_ptr<Instruction>& instr : pair.second) {
-                const uint64_t binary = instr->toBinaryCode();
-                stream.write((const char*) &binary, 8);
-                numBytes += 8;
-            }
+            stream.write(reinterpret_cast<const char*>(pair.second.data()), static_cast<std::streamsize>(pair.second.size() * 8));
+            numBytes += pair.second.size() * 8;
             break;
         case OutputMode::HEX:
-            for (const std::unique_ptr<Instruction>& instr : pair.second) {
-                stream << instr->toHexString(true) << std::endl;
+        {
+            const std::vector<std::string>& assemblerCode = allAssemblerCode.at(pair.first);
+            for (std::size_t i = 0; i < pair.second.size(); ++i) {
+                textBuffer.writeHex(pair.second[i], assemblerCode[i]);
                 numBytes += 8; //XXX ??
             }
         }
+        }
     }
+    textBuffer.flush();
     stream.flush();
     return numBytes;
 }
+
+void CodeGenerator::writePerformanceReport() const
+{
+	if(config.performanceReportFile.empty())
+		return;
+	std::ofstream file(config.performanceReportFile, std::ios_base::out | std::ios_base::trunc);
+	file << "{\n  \"kernels\": [";
+	bool isFirstKernel = true;
+	for(const auto& pair : allInstructions)
+	{
+		const KernelEstimate estimate = estimateCycles(pair.second);
+		DEBUG_LOG("Estimated " << estimate.total.numCycles << " cycles (" << estimate.total.getStallCycles() << " stalls) for kernel: " << pair.first->name << logging::endl);
+		//kernel names are valid C identifiers, so they do not need to be escaped
+		file << (isFirstKernel ? "\n" : ",\n") << "    {\n      \"name\": \"" << pair.first->name << "\",\n      \"total\": ";
+		estimate.total.writeJSON(file);
+		file << ",\n      \"blocks\": [";
+		for(std::size_t i = 0; i < estimate.blocks.size(); ++i)
+		{
+			file << (i == 0 ? "\n        " : ",\n        ");
+			estimate.blocks[i].writeJSON(file);
+		}
+		file << "\n      ]\n    }";
+		isFirstKernel = false;
+	}
+	file << "\n  ]\n}\n";
+	if(!file)
+		logging::warn() << "Failed to write performance report to: " << config.performanceReportFile << logging::endl;
+}
+
+void CodeGenerator::addKernelMetrics(Method& kernel, KernelMetrics& metrics) const
+{
+	auto it = allInstructions.find(&kernel);
+	if(it == allInstructions.end())
+		return;
+	const KernelEstimate estimate = estimateCycles(it->second);
+	metrics.machineInstructions = it->second.size();
+	metrics.numNops = estimate.total.numNops;
+	metrics.dualIssueRatio = estimate.total.getDualIssueRatio();
+	metrics.estimatedCycles = estimate.total.numCycles;
+	metrics.numDMALoads = 0;
+	metrics.numDMAStores = 0;
+	metrics.numMutexAcquisitions = 0;
+	for(const uint64_t code : it->second)
+	{
+		const std::unique_ptr<Instruction> instr = Instruction::decode(code);
+		const ALUInstruction* alu = dynamic_cast<const ALUInstruction*>(instr.get());
+		if(alu == nullptr)
+			continue;
+		//"add ALU writes to regfile A, mult to regfile B", unless swapped
+		const bool addWritesA = alu->getWriteSwap() == WriteSwap::DONT_SWAP;
+		if(alu->getAddition() != OPADD_NOP && alu->getAddOut() == REG_VPM_IN_ADDR.num)
+			++(addWritesA ? metrics.numDMALoads : metrics.numDMAStores);
+		if(alu->getMultiplication() != OPMUL_NOP && alu->getMulOut() == REG_VPM_IN_ADDR.num)
+			++(addWritesA ? metrics.numDMAStores : metrics.numDMALoads);
+		if(alu->getInputA() == REG_MUTEX.num || (alu->getSig() != Signaling::ALU_IMMEDIATE && alu->getInputB() == REG_MUTEX.num))
+			++metrics.numMutexAcquisitions;
+	}
+	metrics.nopsByReason = allNopsByReason.at(&kernel);
+	const AllocationStatistics& statistics = allocationStatistics.at(&kernel);
+	metrics.numRegisters = statistics.numRegisters;
+	metrics.registerAllocationRounds = statistics.numRounds;
+	metrics.numSpilledLocals = 0;
+	metrics.vpmBytes = 0;
+	for(const periphery::VPMArea& area : kernel.vpm->getAreas())
+	{
+		if(area.usageType == periphery::VPMUsage::REGISTER_SPILLING)
+			metrics.numSpilledLocals += kernel.vpm->getNumObjects(area);
+		metrics.vpmBytes += area.size;
+	}
+}
@@ -17,10 +17,13 @@
 
 #include "../Module.h"
 #include "Instruction.h"
+#include "KernelInfo.h"
 #include <config.h>
 
 namespace vc4c
 {
+	struct KernelMetrics;
+
 	namespace qpu_asm
 	{
 
@@ -30,21 +33,78 @@ namespace vc4c
 			CodeGenerator(const Module& module, const Configuration& config = { });
 
 			/*
+			 * Returns the encoded machine code of the method.
+			 *
+			 * All information required to write the output is extracted from the intermediate instructions,
+			 * so the instructions of the method can be released afterwards (see Method#releaseInstructions)
+			 *
 			 * NOTE: Instruction to Assembler mapping can be run in parallel for different methods,
 			 * so no static or non-constant global data can be used
 			 */
-			const FastModificationList<std::unique_ptr<qpu_asm::Instruction>>& generateInstructions(Method& method);
+			const std::vector<uint64_t>& generateInstructions(Method& method);
 
 			std::size_t writeOutput(std::ostream& stream);
 
+			/*
+			 * Writes the statically estimated cycles of all kernels generated so far, if configured (see Configuration#performanceReportFile)
+			 */
+			void writePerformanceReport() const;
+
+			/*
+			 * Fills the statistics of the code generated for the given kernel into the metrics
+			 */
+			void addKernelMetrics(Method& kernel, KernelMetrics& metrics) const;
+
 		private:
+			/*
+			 * Orders the kernels by their declaration in the module, so the order of the kernels in the output does not depend on their addresses
+			 */
+			struct DeclarationOrder
+			{
+				const Module* module;
+
+				bool operator()(const Method* first, const Method* second) const;
+			};
+
 			Configuration config;
 			const Module& module;
-			std::map<Method*, FastModificationList<std::unique_ptr<qpu_asm::Instruction>>> allInstructions;
+			//the machine code of every kernel, encoded directly into a contiguous buffer
+			std::map<Method*, std::vector<uint64_t>, DeclarationOrder> allInstructions;
+			//the assembler code of every instruction, only kept for the textual output modes
+			std::map<Method*, std::vector<std::string>> allAssemblerCode;
+			struct AllocationStatistics
+			{
+				//the number of physical registers (excluding the accumulators) allocated
+				unsigned numRegisters = 0;
+				//the number of graph-coloring rounds
+				std::size_t numRounds = 0;
+			};
+			std::map<Method*, AllocationStatistics> allocationStatistics;
+			//the parts of the kernel-info and the metrics depending on the intermediate instructions, which are released after the code is generated
+			std::map<Method*, KernelInfo> allKernelInfos;
+			std::map<Method*, std::map<std::string, std::size_t>> allNopsByReason;
 #ifdef MULTI_THREADED
 		std::mutex instructionsLock;
 #endif
 
+			//the kernels whose code is not written, since it is the same as the end of the code of another kernel, that kernel and the index of the first shared instruction
+			using SharedCode = std::map<const Method*, std::pair<Method*, std::size_t>>;
+
+			/*
+			 * Creates the kernel-infos for all kernels generated so far, the code of the first kernel starting at the given offset (in 64-bit words).
+			 * The kernels sharing the code of another kernel start within the code of that kernel
+			 */
+			std::vector<KernelInfo> createKernelInfos(std::size_t offset, const SharedCode& sharedCode = {}) const;
+			/*
+			 * Finds the kernels whose code is identical to (the end of) the code of another kernel.
+			 * Since all branches are relative, such code can be executed from within the code of the other kernel and is only written once
+			 */
+			SharedCode findSharedCode() const;
+			/*
+			 * Writes the indexed container (see Configuration#indexedContainer)
+			 */
+			std::size_t writeContainer(std::ostream& stream, const std::vector<const Global*>& globals, std::size_t globalDataSize) const;
+
 	};
 }
 }
@@ -0,0 +1,86 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Container.h"
+
+#include "CompilationError.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace vc4c;
+using namespace vc4c::qpu_asm;
+
+static std::size_t alignTo(const std::size_t offset, const std::size_t alignment)
+{
+	return offset % alignment == 0 ? offset : offset + alignment - (offset % alignment);
+}
+
+static void addSection(std::vector<SectionEntry>& sections, const SectionType type, const std::size_t kernelIndex, const std::size_t offset, const std::size_t size)
+{
+	if(offset + size > std::numeric_limits<uint32_t>::max())
+		throw CompilationError(CompilationStep::CODE_GENERATION, "Container exceeds the maximum size", std::to_string(offset + size));
+	sections.push_back(SectionEntry{type, static_cast<uint16_t>(kernelIndex), static_cast<uint32_t>(offset), static_cast<uint32_t>(size)});
+}
+
+std::vector<SectionEntry> qpu_asm::layoutContainer(std::size_t globalDataSize, const std::vector<std::size_t>& kernelInfoSizes, const std::vector<std::size_t>& kernelCodeSizes)
+{
+	if(kernelInfoSizes.size() != kernelCodeSizes.size() || kernelInfoSizes.size() > std::numeric_limits<uint16_t>::max())
+		throw CompilationError(CompilationStep::CODE_GENERATION, "Invalid number of kernels for container", std::to_string(kernelCodeSizes.size()));
+	const std::size_t numSections = kernelInfoSizes.size() + kernelCodeSizes.size() + 1;
+	std::vector<SectionEntry> sections;
+	sections.reserve(numSections);
+	//header + section table
+	std::size_t offset = 16 + numSections * 16;
+	for(std::size_t i = 0; i < kernelInfoSizes.size(); ++i)
+	{
+		offset = alignTo(offset, 8);
+		addSection(sections, SectionType::KERNEL_INFO, i, offset, kernelInfoSizes[i]);
+		offset += kernelInfoSizes[i];
+	}
+	offset = alignTo(offset, CONTAINER_PAGE_SIZE);
+	addSection(sections, SectionType::GLOBAL_DATA, 0, offset, globalDataSize);
+	offset += globalDataSize;
+	for(std::size_t i = 0; i < kernelCodeSizes.size(); ++i)
+	{
+		offset = alignTo(offset, CONTAINER_PAGE_SIZE);
+		addSection(sections, SectionType::KERNEL_CODE, i, offset, kernelCodeSizes[i]);
+		offset += kernelCodeSizes[i];
+	}
+	return sections;
+}
+
+static void writeWord(std::ostream& stream, const uint32_t lower, const uint32_t upper)
+{
+	stream.write(reinterpret_cast<const char*>(&lower), sizeof(lower));
+	stream.write(reinterpret_cast<const char*>(&upper), sizeof(upper));
+}
+
+std::size_t qpu_asm::writeContainerHeader(std::ostream& stream, const std::vector<SectionEntry>& sections)
+{
+	writeWord(stream, QPUASM_MAGIC_NUMBER, CONTAINER_MAGIC_NUMBER);
+	writeWord(stream, CONTAINER_VERSION, static_cast<uint32_t>(sections.size()));
+	for(const SectionEntry& section : sections)
+	{
+		writeWord(stream, static_cast<uint32_t>(section.type) | (static_cast<uint32_t>(section.kernelIndex) << 16), 0);
+		writeWord(stream, section.offset, section.size);
+	}
+	return 16 + sections.size() * 16;
+}
+
+std::size_t qpu_asm::padToSection(std::ostream& stream, std::size_t position, const SectionEntry& section)
+{
+	if(position > section.offset)
+		throw CompilationError(CompilationStep::CODE_GENERATION, "Container section overlaps previous data", std::to_string(section.offset));
+	static const char zeroes[64] = {0};
+	while(position < section.offset)
+	{
+		const std::size_t count = std::min(sizeof(zeroes), section.offset - position);
+		stream.write(zeroes, static_cast<std::streamsize>(count));
+		position += count;
+	}
+	return position;
+}
@@ -0,0 +1,81 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <config.h>
+
+#include <ostream>
+#include <vector>
+
+namespace vc4c
+{
+	namespace qpu_asm
+	{
+		/*
+		 * The indexed container format (see Configuration#indexedContainer) allows the run-time to look up and load single kernels without parsing the whole binary.
+		 *
+		 * The container starts with a header of two 64-bit words:
+		 * - the QPUASM_MAGIC_NUMBER followed by the CONTAINER_MAGIC_NUMBER (to distinguish it from the sequential format)
+		 * - the CONTAINER_VERSION followed by the number of sections
+		 * followed by the section table with an entry of 16 Bytes for every section (see SectionEntry).
+		 *
+		 * The kernel-infos directly follow the section table (aligned to 8 Bytes), the global data and the code of the kernels
+		 * are aligned to CONTAINER_PAGE_SIZE, so they can be memory-mapped separately.
+		 * The offset field of the kernel-infos is always zero, since the code of every kernel starts at the begin of its section.
+		 */
+		constexpr uint32_t CONTAINER_MAGIC_NUMBER = 0xC0DEC0DE;
+		constexpr uint32_t CONTAINER_VERSION = 1;
+		constexpr std::size_t CONTAINER_PAGE_SIZE = 4096;
+
+		enum class SectionType : uint16_t
+		{
+			//the kernel-info (in the same format as written for the sequential format)
+			KERNEL_INFO = 1,
+			//the machine code of a single kernel
+			KERNEL_CODE = 2,
+			//the global data segment, shared by all kernels
+			GLOBAL_DATA = 3
+		};
+
+		/*
+		 * An entry in the section table is written as:
+		 * - the section type (16 bit), the index of the kernel (16 bit, zero for the global data), 32 bit reserved (zero)
+		 * - the offset from the begin of the container (32 bit) and the size (32 bit), both in Bytes
+		 */
+		struct SectionEntry
+		{
+			SectionType type;
+			uint16_t kernelIndex;
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		/*
+		 * Calculates the offsets of all sections from the size of the global data and the sizes of the kernel-infos and -codes (in Bytes, per kernel).
+		 *
+		 * The entries are in the order the sections are written: all kernel-infos, the global data and the codes of all kernels
+		 */
+		std::vector<SectionEntry> layoutContainer(std::size_t globalDataSize, const std::vector<std::size_t>& kernelInfoSizes, const std::vector<std::size_t>& kernelCodeSizes);
+
+		/*
+		 * Writes the container header and the section table
+		 *
+		 * Returns the number of Bytes written
+		 */
+		std::size_t writeContainerHeader(std::ostream& stream, const std::vector<SectionEntry>& sections);
+
+		/*
+		 * Pads the output with zero Bytes from the current position up to the offset of the section
+		 *
+		 * Returns the new position
+		 */
+		std::size_t padToSection(std::ostream& stream, std::size_t position, const SectionEntry& section);
+	}
+}
+
+#endif /* CONTAINER_H */
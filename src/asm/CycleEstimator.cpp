@@ -0,0 +1,290 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "CycleEstimator.h"
+
+#include "ALUInstruction.h"
+#include "BranchInstruction.h"
+#include "LoadInstruction.h"
+#include "SemaphoreInstruction.h"
+
+#include <algorithm>
+#include <deque>
+
+using namespace vc4c;
+using namespace vc4c::qpu_asm;
+
+std::string qpu_asm::toString(const StallSource source)
+{
+	switch(source)
+	{
+		case StallSource::SFU:
+			return "sfu";
+		case StallSource::TMU:
+			return "tmu";
+		case StallSource::VPM:
+			return "vpm";
+		case StallSource::DMA:
+			return "dma";
+		case StallSource::MUTEX:
+			return "mutex";
+		case StallSource::SEMAPHORE:
+			return "semaphore";
+	}
+	throw CompilationError(CompilationStep::CODE_GENERATION, "Unhandled stall source", std::to_string(static_cast<unsigned>(source)));
+}
+
+CycleEstimate::CycleEstimate()
+{
+	stallCycles.fill(0);
+}
+
+std::size_t CycleEstimate::getStallCycles() const
+{
+	std::size_t sum = 0;
+	for(const std::size_t cycles : stallCycles)
+		sum += cycles;
+	return sum;
+}
+
+std::size_t CycleEstimate::getStallCycles(const StallSource source) const
+{
+	return stallCycles.at(static_cast<std::size_t>(source));
+}
+
+double CycleEstimate::getDualIssueRatio() const
+{
+	if(numALUInstructions == 0)
+		return 0.0;
+	return static_cast<double>(numDualIssued) / static_cast<double>(numALUInstructions);
+}
+
+CycleEstimate& CycleEstimate::operator+=(const CycleEstimate& other)
+{
+	numInstructions += other.numInstructions;
+	numCycles += other.numCycles;
+	numALUInstructions += other.numALUInstructions;
+	numDualIssued += other.numDualIssued;
+	numNops += other.numNops;
+	for(std::size_t i = 0; i < NUM_STALL_SOURCES; ++i)
+		stallCycles[i] += other.stallCycles[i];
+	return *this;
+}
+
+void CycleEstimate::writeJSON(std::ostream& stream) const
+{
+	stream << "{\"first_instruction\": " << firstInstruction << ", \"instructions\": " << numInstructions << ", \"cycles\": " << numCycles
+			<< ", \"alu_instructions\": " << numALUInstructions << ", \"dual_issued\": " << numDualIssued << ", \"dual_issue_ratio\": " << getDualIssueRatio()
+			<< ", \"nops\": " << numNops << ", \"stalls\": {";
+	for(std::size_t i = 0; i < NUM_STALL_SOURCES; ++i)
+		stream << (i == 0 ? "" : ", ") << '"' << toString(static_cast<StallSource>(i)) << "\": " << stallCycles[i];
+	stream << "}}";
+}
+
+/*
+ * The state of the periphery, as far as it is relevant for stalls.
+ *
+ * All values are the cycle the corresponding resource is available without stalling
+ */
+struct PeripheryState
+{
+	std::size_t r4Ready = 0;
+	std::size_t vpmReadReady = 0;
+	std::size_t dmaLoadReady = 0;
+	std::size_t dmaStoreReady = 0;
+	//the TMU loads queued (per TMU), the ldtmu signal retrieves the oldest one
+	std::array<std::deque<std::size_t>, 2> pendingLoads;
+};
+
+struct Stall
+{
+	std::size_t cycles = 0;
+	StallSource source = StallSource::SFU;
+
+	void update(const std::size_t readyCycle, const std::size_t currentCycle, const StallSource src)
+	{
+		if(readyCycle > currentCycle && readyCycle - currentCycle > cycles)
+		{
+			cycles = readyCycle - currentCycle;
+			source = src;
+		}
+	}
+};
+
+static bool isFileA(const bool isAddALU, const WriteSwap swap)
+{
+	//"add ALU writes to regfile A, mult to regfile B", unless swapped
+	return isAddALU == (swap == WriteSwap::DONT_SWAP);
+}
+
+static void updateOnRead(const PeripheryState& state, Stall& stall, const Address address, const bool fileA, const std::size_t cycle)
+{
+	if(address == REG_VPM_IO.num)
+		stall.update(state.vpmReadReady, cycle, StallSource::VPM);
+	else if(address == REG_VPM_IN_WAIT.num)
+		stall.update(fileA ? state.dmaLoadReady : state.dmaStoreReady, cycle, StallSource::DMA);
+	else if(address == REG_MUTEX.num)
+		stall.update(cycle + SYNCHRONIZATION_LATENCY, cycle, StallSource::MUTEX);
+}
+
+static void updateOnWrite(PeripheryState& state, const Address address, const bool fileA, const std::size_t cycle)
+{
+	if(address >= REG_SFU_RECIP.num && address <= REG_SFU_LOG2.num)
+		state.r4Ready = cycle + SFU_LATENCY;
+	//only writing the S coordinate (or the address for general memory look-ups) triggers the TMU load
+	else if(address == REG_TMU_ADDRESS.num)
+		state.pendingLoads[0].push_back(cycle + TMU_LOAD_LATENCY);
+	else if(address == REG_TMU1_ADDRESS.num)
+		state.pendingLoads[1].push_back(cycle + TMU_LOAD_LATENCY);
+	else if(address == REG_VPM_IN_SETUP.num && fileA)
+		state.vpmReadReady = cycle + VPM_READ_LATENCY;
+	else if(address == REG_VPM_IN_ADDR.num)
+	{
+		if(fileA)
+			state.dmaLoadReady = cycle + DMA_LATENCY;
+		else
+			state.dmaStoreReady = cycle + DMA_LATENCY;
+	}
+}
+
+static void updateOnSignal(PeripheryState& state, Stall& stall, const Signaling sig, const std::size_t cycle)
+{
+	if(sig == Signaling::LOAD_TMU0 || sig == Signaling::LOAD_TMU1)
+	{
+		auto& queue = state.pendingLoads[sig == Signaling::LOAD_TMU0 ? 0 : 1];
+		if(!queue.empty())
+		{
+			stall.update(queue.front(), cycle, StallSource::TMU);
+			queue.pop_front();
+		}
+	}
+	else if(sig == Signaling::THREAD_SWITCH || sig == Signaling::LAST_THREAD_SWITCH)
+	{
+		//the other thread runs while this one waits for its loads
+		for(auto& queue : state.pendingLoads)
+		{
+			for(std::size_t& readyCycle : queue)
+				readyCycle = std::min(readyCycle, cycle);
+		}
+	}
+}
+
+/*
+ * Executes a single instruction: determines the stall before issuing it and updates the statistics and the state of the periphery.
+ *
+ * Returns the cycle the next instruction can be issued
+ */
+static std::size_t executeInstruction(const Instruction* instr, PeripheryState& state, CycleEstimate& estimate, std::size_t cycle)
+{
+	Stall stall;
+	Address addOut = REG_NOP.num;
+	Address mulOut = REG_NOP.num;
+	WriteSwap swap = WriteSwap::DONT_SWAP;
+	if(const ALUInstruction* alu = dynamic_cast<const ALUInstruction*>(instr))
+	{
+		const OpAdd add = alu->getAddition();
+		const OpMul mul = alu->getMultiplication();
+		const bool addUsed = add != OPADD_NOP;
+		const bool mulUsed = mul != OPMUL_NOP;
+		if(addUsed || mulUsed)
+			++estimate.numALUInstructions;
+		else
+			++estimate.numNops;
+		if(addUsed && mulUsed)
+			++estimate.numDualIssued;
+
+		const bool readsR4 = (addUsed && add.numOperands > 0 && alu->getAddMutexA() == InputMutex::ACC4) ||
+				(addUsed && add.numOperands > 1 && alu->getAddMutexB() == InputMutex::ACC4) ||
+				(mulUsed && mul.numOperands > 0 && alu->getMulMutexA() == InputMutex::ACC4) ||
+				(mulUsed && mul.numOperands > 1 && alu->getMulMutexB() == InputMutex::ACC4);
+		if(readsR4)
+			stall.update(state.r4Ready, cycle, StallSource::SFU);
+		//the read-addresses access the periphery, independent of whether the value is used by any ALU
+		updateOnRead(state, stall, alu->getInputA(), true, cycle);
+		if(alu->getSig() != Signaling::ALU_IMMEDIATE)
+			updateOnRead(state, stall, alu->getInputB(), false, cycle);
+		updateOnSignal(state, stall, alu->getSig(), cycle);
+
+		addOut = alu->getAddOut();
+		mulOut = alu->getMulOut();
+		swap = alu->getWriteSwap();
+	}
+	else if(const LoadInstruction* load = dynamic_cast<const LoadInstruction*>(instr))
+	{
+		addOut = load->getAddOut();
+		mulOut = load->getMulOut();
+		swap = load->getWriteSwap();
+	}
+	else if(const SemaphoreInstruction* semaphore = dynamic_cast<const SemaphoreInstruction*>(instr))
+	{
+		if(!semaphore->getIncrementSemaphore())
+			stall.update(cycle + SYNCHRONIZATION_LATENCY, cycle, StallSource::SEMAPHORE);
+		addOut = semaphore->getAddOut();
+		mulOut = semaphore->getMulOut();
+		swap = semaphore->getWriteSwap();
+	}
+	else if(const BranchInstruction* branch = dynamic_cast<const BranchInstruction*>(instr))
+	{
+		//the link-address can be written to a register
+		addOut = branch->getAddOut();
+		mulOut = branch->getMulOut();
+	}
+
+	estimate.stallCycles[static_cast<std::size_t>(stall.source)] += stall.cycles;
+	cycle += stall.cycles;
+	updateOnWrite(state, addOut, isFileA(true, swap), cycle);
+	updateOnWrite(state, mulOut, isFileA(false, swap), cycle);
+	return cycle + 1;
+}
+
+KernelEstimate qpu_asm::estimateCycles(const std::vector<uint64_t>& instructions)
+{
+	//determine the start of the basic blocks: the branch targets and the instructions after the branch delay slots
+	std::vector<bool> isBlockStart(instructions.size() + 1, false);
+	isBlockStart[0] = true;
+	std::size_t index = 0;
+	for(const uint64_t code : instructions)
+	{
+		//only the branches need to be decoded to find the starts of the blocks
+		const std::unique_ptr<Instruction> instr = static_cast<Signaling>(code >> 60) == Signaling::BRANCH ? Instruction::decode(code) : nullptr;
+		if(const BranchInstruction* branch = dynamic_cast<const BranchInstruction*>(instr.get()))
+		{
+			isBlockStart[std::min(index + 4, instructions.size())] = true;
+			if(branch->getBranchRelative() == BranchRel::BRANCH_RELATIVE && branch->getAddRegister() == BranchReg::NONE)
+			{
+				//"branch target is relative to PC+4", the offset is in bytes
+				const int64_t target = static_cast<int64_t>(index) + 4 + branch->getImmediate() / 8;
+				if(target >= 0 && target < static_cast<int64_t>(instructions.size()))
+					isBlockStart[static_cast<std::size_t>(target)] = true;
+			}
+		}
+		++index;
+	}
+
+	KernelEstimate result;
+	PeripheryState state;
+	std::size_t cycle = 0;
+	index = 0;
+	for(const uint64_t code : instructions)
+	{
+		const std::unique_ptr<Instruction> instr = Instruction::decode(code);
+		if(isBlockStart[index])
+		{
+			result.blocks.emplace_back();
+			result.blocks.back().firstInstruction = index;
+		}
+		CycleEstimate& block = result.blocks.back();
+		const std::size_t nextCycle = executeInstruction(instr.get(), state, block, cycle);
+		++block.numInstructions;
+		block.numCycles += nextCycle - cycle;
+		cycle = nextCycle;
+		++index;
+	}
+
+	for(const CycleEstimate& block : result.blocks)
+		result.total += block;
+	return result;
+}
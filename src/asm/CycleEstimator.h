@@ -0,0 +1,107 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef CYCLE_ESTIMATOR_H
+#define CYCLE_ESTIMATOR_H
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "Instruction.h"
+#include "../performance.h"
+
+namespace vc4c
+{
+	namespace qpu_asm
+	{
+		/*
+		 * The sources of stalls known to the cycle estimator
+		 */
+		enum class StallSource : unsigned char
+		{
+			//reading r4 before the SFU result is available
+			SFU,
+			//loading a TMU result into r4 (ldtmu) before the memory access has finished
+			TMU,
+			//reading from the VPM read FIFO before it is filled
+			VPM,
+			//waiting for a DMA load/store to finish
+			DMA,
+			//acquiring the hardware mutex
+			MUTEX,
+			//decrementing a semaphore
+			SEMAPHORE
+		};
+		static constexpr std::size_t NUM_STALL_SOURCES = 6;
+		std::string toString(const StallSource source);
+
+		//"the SFU result is available in r4 two instructions after the SFU register is written" (page 36)
+		static constexpr std::size_t SFU_LATENCY = 3;
+		//a TMU read stalls at least 9 cycles, when reading from the TMU cache (see REG_TMU_OUT)
+		static constexpr std::size_t TMU_LOAD_LATENCY = 9;
+		//the VPM read FIFO needs some cycles after a read setup, until the first value can be read without stalling
+		static constexpr std::size_t VPM_READ_LATENCY = 3;
+		//rough estimate for a DMA transfer of a single row of 16 words with no other QPU accessing the memory
+		static constexpr std::size_t DMA_LATENCY = 40;
+		//rough estimate for acquiring the mutex/decrementing a semaphore with no other QPU holding it
+		static constexpr std::size_t SYNCHRONIZATION_LATENCY = 4;
+
+		/*
+		 * The estimated execution statistics of a (part of a) kernel.
+		 *
+		 * All cycle values are in instructions, a single instruction is issued every cycle (4 clock-cycles for all 16 SIMD elements)
+		 */
+		struct CycleEstimate
+		{
+			//the index of the first instruction (relative to the kernel start)
+			std::size_t firstInstruction = 0;
+			std::size_t numInstructions = 0;
+			//the estimated cycles, including the stalls
+			std::size_t numCycles = 0;
+			//the number of ALU instructions executing any operation in the ADD and/or MUL ALU
+			std::size_t numALUInstructions = 0;
+			//the number of ALU instructions executing an operation in both, the ADD and the MUL ALU
+			std::size_t numDualIssued = 0;
+			//the number of ALU instructions executing no operation at all (including the ones only triggering a signal)
+			std::size_t numNops = 0;
+			std::array<std::size_t, NUM_STALL_SOURCES> stallCycles;
+
+			CycleEstimate();
+
+			std::size_t getStallCycles() const;
+			std::size_t getStallCycles(const StallSource source) const;
+			//the ratio of ALU instructions utilizing both ALUs
+			double getDualIssueRatio() const;
+
+			CycleEstimate& operator+=(const CycleEstimate& other);
+
+			void writeJSON(std::ostream& stream) const;
+		};
+
+		/*
+		 * The estimated execution statistics of a whole kernel, split into its basic blocks
+		 */
+		struct KernelEstimate
+		{
+			CycleEstimate total;
+			std::vector<CycleEstimate> blocks;
+		};
+
+		/*
+		 * Statically estimates the number of cycles the given machine code takes to execute on a single QPU.
+		 *
+		 * The model executes every instruction exactly once (the cycles of loops are not multiplied) and assumes no contention on the memory,
+		 * the VPM and the mutex. It uses the same latencies as the instruction scheduler (see Reordering.cpp), the latencies of the DMA and the mutex
+		 * are rough estimates only.
+		 * With threaded execution, the waiting time for a TMU load issued before a thread-switch is assumed to be hidden by the other thread.
+		 */
+		KernelEstimate estimateCycles(const std::vector<uint64_t>& instructions);
+	}
+}
+
+#endif /* CYCLE_ESTIMATOR_H */
@@ -6,11 +6,32 @@
 
 #include "DebugGraph.h"
 
+#include "log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#ifdef MULTI_THREADED
+#include <mutex>
+
+#include "../ThreadPool.h"
+#endif
+
+using namespace vc4c;
 using namespace vc4c::qpu_asm;
 
+const std::string qpu_asm::DEBUG_GRAPH_BLOCKS = "block-graph";
+const std::string qpu_asm::DEBUG_GRAPH_REGISTERS = "register-graph";
+
 static const std::string STYLE_EDGE_STRONG = "";
 static const std::string STYLE_EDGE_WEAK = "[style=\"dashed\"]";
 
+#ifdef MULTI_THREADED
+//the graphs scheduled but not yet waited for, of all compilations of this process
+static std::mutex pendingGraphsLock;
+static std::vector<std::shared_ptr<threading::Task>> pendingGraphs;
+#endif
+
 static std::string cleanName(const std::string& name)
 {
 	std::string copy(name);
@@ -30,7 +51,71 @@ static std::string createEdge(bool isDirected)
 	return isDirected ? " -> " : " -- ";
 }
 
-void vc4c::qpu_asm::printEdge(std::ofstream& file, const std::string& name1, const std::string& name2, bool weakEdge, bool isDirected)
+static void printGraph(const std::string& fileName, const std::vector<DebugEdge>& edges, bool isDirected, std::size_t numNodes, bool isTruncated)
 {
-	file << cleanName(name1) << createEdge(isDirected) << cleanName(name2) << (weakEdge ? STYLE_EDGE_STRONG : STYLE_EDGE_WEAK) << ";" << std::endl;
+	std::ofstream file(fileName);
+	if(!file)
+	{
+		logging::warn() << "Failed to open file for debug graph: " << fileName << logging::endl;
+		return;
+	}
+	//strict: at most one edge can connect two nodes, multiple same connections are merged (including their attributes)
+	//graph: undirected graph, digraph: directed graph
+	if(isDirected)
+		file << "strict digraph {" << std::endl;
+	else
+		file << "strict graph {" << std::endl;
+	//global graph settings: draw edges as splines and remove overlap between edges and nodes, draw nodes over edges
+	file << "graph [splines=true, overlap=\"prism\", outputorder=\"edgesfirst\"];" << std::endl;
+	if(isTruncated)
+		file << "graph [label=\"truncated to " << numNodes << " nodes\"];" << std::endl;
+	//fill background of nodes white
+	file << "node [style=\"filled\", fillcolor=\"white\"];" << std::endl;
+	for(const DebugEdge& edge : edges)
+		file << cleanName(edge.firstNode) << createEdge(isDirected) << cleanName(edge.secondNode) << (edge.weakEdge ? STYLE_EDGE_WEAK : STYLE_EDGE_STRONG) << ";" << std::endl;
+	file << "}" << std::endl;
+}
+
+Optional<std::string> qpu_asm::getDebugGraphFile(const Configuration& config, const std::string& kernelName, const std::string& phase)
+{
+	if(config.debugGraphDirectory.empty())
+		return {};
+	if(!config.debugGraphKernels.empty() && std::find(config.debugGraphKernels.begin(), config.debugGraphKernels.end(), kernelName) == config.debugGraphKernels.end())
+		return {};
+	if(!config.debugGraphPhases.empty() && std::find(config.debugGraphPhases.begin(), config.debugGraphPhases.end(), phase) == config.debugGraphPhases.end())
+		return {};
+	std::string fileName(kernelName);
+	std::replace(fileName.begin(), fileName.end(), '/', '_');
+	return config.debugGraphDirectory + "/" + fileName + "." + phase + ".dot";
+}
+
+void qpu_asm::writeDebugGraph(const std::string& fileName, std::vector<DebugEdge>&& edges, bool isDirected, std::size_t numNodes, bool isTruncated)
+{
+#ifdef MULTI_THREADED
+	const auto data = std::make_shared<std::vector<DebugEdge>>(std::move(edges));
+	const auto task = std::make_shared<threading::Task>([fileName, data, isDirected, numNodes, isTruncated]() -> void
+	{
+		printGraph(fileName, *data, isDirected, numNodes, isTruncated);
+	}, "DebugGraph");
+	{
+		std::lock_guard<std::mutex> guard(pendingGraphsLock);
+		pendingGraphs.push_back(task);
+	}
+	threading::ThreadPool::getGlobalPool().schedule(task);
+#else
+	printGraph(fileName, edges, isDirected, numNodes, isTruncated);
+#endif
+}
+
+void qpu_asm::waitForDebugGraphs()
+{
+#ifdef MULTI_THREADED
+	std::vector<std::shared_ptr<threading::Task>> tasks;
+	{
+		std::lock_guard<std::mutex> guard(pendingGraphsLock);
+		tasks.swap(pendingGraphs);
+	}
+	for(const auto& task : tasks)
+		threading::ThreadPool::getGlobalPool().waitFor(task);
+#endif
 }
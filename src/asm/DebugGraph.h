@@ -7,65 +7,104 @@
 #ifndef DEBUG_GRAPH_H
 #define DEBUG_GRAPH_H
 
-#include <fstream>
+#include <config.h>
 #include <functional>
+#include <string>
+#include <vector>
 
-#include "GraphColoring.h"
+#include "helper.h"
+#include "../performance.h"
 
 namespace vc4c
 {
 	namespace qpu_asm
 	{
+		//the phases a debug graph can be written for, see Configuration#debugGraphPhases
+		extern const std::string DEBUG_GRAPH_BLOCKS;
+		extern const std::string DEBUG_GRAPH_REGISTERS;
 
-		void printEdge(std::ofstream& file, const std::string& name1, const std::string& name2, bool weakEdge, bool isDirected);
+		/*
+		 * Returns the file to write the debug graph of the given phase for the given kernel into, if the graph is selected by the configuration
+		 */
+		Optional<std::string> getDebugGraphFile(const Configuration& config, const std::string& kernelName, const std::string& phase);
+
+		struct DebugEdge
+		{
+			std::string firstNode;
+			std::string secondNode;
+			bool weakEdge;
+		};
+
+		/*
+		 * Formats and writes the edges into the file asynchronously, so the compilation is not slowed down by the output.
+		 * Without multi-threading support, the graph is written directly.
+		 */
+		void writeDebugGraph(const std::string& fileName, std::vector<DebugEdge>&& edges, bool isDirected, std::size_t numNodes, bool isTruncated);
+
+		/*
+		 * Blocks until all debug graphs scheduled so far are written
+		 */
+		void waitForDebugGraphs();
 
 		/*
 		 * Generates a Graphviz (http://graphviz.org/) graph out of the colored graph/basic block graph
 		 *
+		 * The edges are only collected while the graph is built, the file is written (asynchronously) on destruction.
+		 * Edges to more than the maximum number of nodes (if not zero) are dropped and the graph is marked as truncated.
+		 *
 		 * Generate SVG with: "sfdp -Tsvg <input>.dot -o <output>.svg"
 		 */
-		template<typename T, typename R>
+		template<typename T>
 		class DebugGraph
 		{
 		public:
-			DebugGraph(const std::string& fileName, bool isDirected = false) : isDirected(isDirected), file(fileName)
+			DebugGraph(const std::string& fileName, std::size_t maxNodes, bool isDirected = false) :
+				fileName(fileName), maxNodes(maxNodes), isDirected(isDirected), truncated(false)
 			{
-				//strict: at most one edge can connect two nodes, multiple same connections are merged (including their attributes)
-				//graph: undirected graph, digraph: directed graph
-				if(isDirected)
-					file << "strict digraph {" << std::endl;
-				else
-					file << "strict graph {" << std::endl;
-				//global graph settings: draw edges as splines and remove overlap between edges and nodes, draw nodes over edges
-				file << "graph [splines=true, overlap=\"prism\", outputorder=\"edgesfirst\"];" << std::endl;
-				//fill background of nodes white
-				file << "node [style=\"filled\", fillcolor=\"white\"];" << std::endl;
 			}
+			DebugGraph(const DebugGraph&) = delete;
 			~DebugGraph()
 			{
-				file << "}" << std::endl;
-				file.flush();
-				file.close();
+				writeDebugGraph(fileName, std::move(edges), isDirected, nodes.size(), truncated);
 			}
 
-			template<typename NodeType = Node<T, R>>
-			void addNodeWithNeighbors(const NodeType& node, const std::function<std::string(const T&)> nameFunc, const std::function<bool(const R&)> weakEdgeFunc = [](const R& r) -> bool{return false;})
+			DebugGraph& operator=(const DebugGraph&) = delete;
+
+			void addEdge(const T& node1, const T& node2, const std::function<std::string(const T&)>& nameFunc, bool weakEdge = false)
 			{
-				processedNodes.emplace(reinterpret_cast<const Node<T, R>*>(&node));
-				for(const auto& pair : node.getNeighbors())
+				if(!addNode(node1) || !addNode(node2))
 				{
-					//making sure, every edge is printed just once is not necessary because of the "strict" keyword,
-					//but it saves a lot of processing time in Graphviz
-					if(processedNodes.find(reinterpret_cast<const Node<T, R>*>(pair.first)) != processedNodes.end())
-						return;
-					printEdge(file, nameFunc(const_cast<T&>(node.key)), nameFunc(const_cast<T&>(pair.first->key)), weakEdgeFunc(pair.second), isDirected);
+					truncated = true;
+					return;
 				}
+				edges.push_back(DebugEdge{nameFunc(node1), nameFunc(node2), weakEdge});
+			}
+
+			/*
+			 * Whether no more nodes can be added, so the caller can stop adding edges early
+			 */
+			bool isFull() const
+			{
+				return maxNodes != 0 && nodes.size() >= maxNodes;
 			}
 
 		private:
+			const std::string fileName;
+			const std::size_t maxNodes;
 			const bool isDirected;
-			std::ofstream file;
-			FastSet<const Node<T, R>*> processedNodes;
+			bool truncated;
+			FastSet<T> nodes;
+			std::vector<DebugEdge> edges;
+
+			bool addNode(const T& node)
+			{
+				if(nodes.find(node) != nodes.end())
+					return true;
+				if(isFull())
+					return false;
+				nodes.emplace(node);
+				return true;
+			}
 		};
 
 	} /* namespace qpu_asm */
@@ -0,0 +1,1287 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Emulator.h"
+
+#include "ALUInstruction.h"
+#include "BranchInstruction.h"
+#include "LoadInstruction.h"
+#include "SemaphoreInstruction.h"
+#include "../periphery/VPM.h"
+#include "../Logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <limits>
+
+using namespace vc4c;
+using namespace vc4c::qpu_asm;
+
+using Vector = std::array<uint32_t, NATIVE_VECTOR_SIZE>;
+using ElementMask = std::array<bool, NATIVE_VECTOR_SIZE>;
+
+//"12 clock stalls when it reads from V3D L2 cache, 20 clock stalls when it reads directly from memory" (see REG_TMU_OUT)
+static constexpr std::size_t TMU_L2_LATENCY = 12;
+static constexpr std::size_t TMU_MEMORY_LATENCY = 20;
+//the TMU and L2 caches are modeled with lines of 64 bytes and unlimited capacity
+static constexpr uint32_t CACHE_LINE_SIZE = 64;
+//rough estimate for every additional row transferred by a single DMA operation
+static constexpr std::size_t DMA_ROW_LATENCY = 8;
+//"three 'delay slot' instructions following a branch instruction are always executed" (page 34)
+static constexpr std::size_t BRANCH_DELAY_SLOTS = 3;
+//the two instructions following the program end signal are still executed
+static constexpr std::size_t PROGRAM_END_DELAY_SLOTS = 2;
+//the number of 32-bit words in a VPM row
+static constexpr std::size_t VPM_ROW_WORDS = 16;
+//the number of VPM rows addressable by the generic block setups
+static constexpr std::size_t VPM_NUM_ROWS = 256;
+static constexpr std::size_t NUM_SEMAPHORES = 16;
+static constexpr uint8_t MAX_SEMAPHORE_VALUE = 15;
+static constexpr std::size_t NO_MUTEX_OWNER = std::numeric_limits<std::size_t>::max();
+
+CycleEstimate EmulationResult::getTotal() const
+{
+	CycleEstimate total;
+	for(const CycleEstimate& qpu : qpus)
+		total += qpu;
+	return total;
+}
+
+void EmulationResult::writeJSON(std::ostream& stream) const
+{
+	stream << "{\"completed\": " << (completed ? "true" : "false") << ", \"cycles\": " << numCycles << ", \"register_hazards\": " << numRegisterHazards
+			<< ", \"traffic\": {\"tmu_loads\": " << traffic.numTMULoads << ", \"tmu_bytes\": " << traffic.tmuBytes << ", \"dma_loads\": " << traffic.numDMALoads
+			<< ", \"dma_load_bytes\": " << traffic.dmaLoadBytes << ", \"dma_stores\": " << traffic.numDMAStores << ", \"dma_store_bytes\": " << traffic.dmaStoreBytes
+			<< ", \"uniform_bytes\": " << traffic.uniformBytes << "}, \"total\": ";
+	getTotal().writeJSON(stream);
+	stream << ", \"qpus\": [";
+	for(std::size_t i = 0; i < qpus.size(); ++i)
+	{
+		stream << (i == 0 ? "" : ", ");
+		qpus[i].writeJSON(stream);
+	}
+	stream << "]}";
+}
+
+static float toFloat(uint32_t bits)
+{
+	//the QPU flushes denormal values to zero
+	if((bits & 0x7F800000) == 0)
+		bits &= 0x80000000;
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+static uint32_t fromFloat(const float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	if((bits & 0x7F800000) == 0)
+		bits &= 0x80000000;
+	return bits;
+}
+
+static float fromHalf(const uint32_t half)
+{
+	const uint32_t sign = (half & 0x8000) << 16;
+	const uint32_t exponent = (half >> 10) & 0x1F;
+	const uint32_t mantissa = half & 0x3FF;
+	if(exponent == 0)
+		//zero or denormal (flushed to zero)
+		return toFloat(sign);
+	if(exponent == 0x1F)
+		//infinity or NaN
+		return toFloat(sign | 0x7F800000 | (mantissa << 13));
+	return toFloat(sign | ((exponent - 15 + 127) << 23) | (mantissa << 13));
+}
+
+static uint32_t toHalf(const float value)
+{
+	const uint32_t bits = fromFloat(value);
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const uint32_t mantissa = bits & 0x7FFFFF;
+	if(((bits >> 23) & 0xFF) == 0xFF)
+		return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+	const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+	if(exponent >= 0x1F)
+		return sign | 0x7C00;
+	if(exponent <= 0)
+		return sign;
+	uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+	//round to nearest, a carry into the exponent yields the correct result (up to infinity)
+	if((mantissa & 0x1000) != 0)
+		++half;
+	return half;
+}
+
+template<typename Func>
+static uint32_t calculatePerByte(const uint32_t a, const uint32_t b, const Func& func)
+{
+	uint32_t result = 0;
+	for(uint32_t shift = 0; shift < 32; shift += 8)
+		result |= (func((a >> shift) & 0xFF, (b >> shift) & 0xFF) & 0xFF) << shift;
+	return result;
+}
+
+/*
+ * Calculates the result of the ADD ALU.
+ *
+ * The carry is only set for integer additions and subtractions overflowing the unsigned 32-bit range,
+ * the wide result is the (not truncated) signed result of integer additions and subtractions for the saturation of the pack-mode
+ */
+static uint32_t calculateAdd(const OpAdd& op, const uint32_t a, const uint32_t b, bool& carry, int64_t& wideResult)
+{
+	const int32_t signedA = static_cast<int32_t>(a);
+	const int32_t signedB = static_cast<int32_t>(b);
+	const uint32_t offset = b & 0x1F;
+	carry = false;
+	uint32_t result = 0;
+	switch(op.opCode)
+	{
+		case OPADD_FADD.opCode:
+			result = fromFloat(toFloat(a) + toFloat(b));
+			break;
+		case OPADD_FSUB.opCode:
+			result = fromFloat(toFloat(a) - toFloat(b));
+			break;
+		case OPADD_FMIN.opCode:
+			result = fromFloat(std::fmin(toFloat(a), toFloat(b)));
+			break;
+		case OPADD_FMAX.opCode:
+			result = fromFloat(std::fmax(toFloat(a), toFloat(b)));
+			break;
+		case OPADD_FMINABS.opCode:
+			result = fromFloat(std::fmin(std::fabs(toFloat(a)), std::fabs(toFloat(b))));
+			break;
+		case OPADD_FMAXABS.opCode:
+			result = fromFloat(std::fmax(std::fabs(toFloat(a)), std::fabs(toFloat(b))));
+			break;
+		case OPADD_FTOI.opCode:
+		{
+			//values not representable as 32-bit integer are converted to zero
+			const float f = toFloat(a);
+			result = std::isnan(f) || std::fabs(f) >= 2147483648.0f ? 0 : static_cast<uint32_t>(static_cast<int32_t>(f));
+			break;
+		}
+		case OPADD_ITOF.opCode:
+			result = fromFloat(static_cast<float>(signedA));
+			break;
+		case OPADD_ADD.opCode:
+			result = a + b;
+			carry = static_cast<uint64_t>(a) + b > std::numeric_limits<uint32_t>::max();
+			wideResult = static_cast<int64_t>(signedA) + signedB;
+			return result;
+		case OPADD_SUB.opCode:
+			result = a - b;
+			carry = a < b;
+			wideResult = static_cast<int64_t>(signedA) - signedB;
+			return result;
+		case OPADD_SHR.opCode:
+			result = a >> offset;
+			break;
+		case OPADD_ASR.opCode:
+			result = static_cast<uint32_t>(signedA >> offset);
+			break;
+		case OPADD_ROR.opCode:
+			result = offset == 0 ? a : (a >> offset) | (a << (32 - offset));
+			break;
+		case OPADD_SHL.opCode:
+			result = a << offset;
+			break;
+		case OPADD_MIN.opCode:
+			result = signedA < signedB ? a : b;
+			break;
+		case OPADD_MAX.opCode:
+			result = signedA > signedB ? a : b;
+			break;
+		case OPADD_AND.opCode:
+			result = a & b;
+			break;
+		case OPADD_OR.opCode:
+			result = a | b;
+			break;
+		case OPADD_XOR.opCode:
+			result = a ^ b;
+			break;
+		case OPADD_NOT.opCode:
+			result = ~a;
+			break;
+		case OPADD_CLZ.opCode:
+			result = a == 0 ? 32 : static_cast<uint32_t>(__builtin_clz(a));
+			break;
+		case OPADD_V8ADDS.opCode:
+			result = calculatePerByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return std::min(x + y, 255u); });
+			break;
+		case OPADD_V8SUBS.opCode:
+			result = calculatePerByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return x > y ? x - y : 0; });
+			break;
+		default:
+			throw CompilationError(CompilationStep::GENERAL, "Invalid ADD ALU operation", std::to_string(static_cast<unsigned>(op.opCode)));
+	}
+	wideResult = static_cast<int32_t>(result);
+	return result;
+}
+
+static uint32_t calculateMul(const OpMul& op, const uint32_t a, const uint32_t b)
+{
+	switch(op.opCode)
+	{
+		case OPMUL_FMUL.opCode:
+			return fromFloat(toFloat(a) * toFloat(b));
+		case OPMUL_MUL24.opCode:
+			return (a & 0xFFFFFF) * (b & 0xFFFFFF);
+		case OPMUL_V8MULD.opCode:
+			return calculatePerByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return (x * y + 127) / 255; });
+		case OPMUL_V8MIN.opCode:
+			return calculatePerByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return std::min(x, y); });
+		case OPMUL_V8MAX.opCode:
+			return calculatePerByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return std::max(x, y); });
+		case OPMUL_V8ADDS.opCode:
+			return calculatePerByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return std::min(x + y, 255u); });
+		case OPMUL_V8SUBS.opCode:
+			return calculatePerByte(a, b, [](uint32_t x, uint32_t y) -> uint32_t { return x > y ? x - y : 0; });
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Invalid MUL ALU operation", std::to_string(static_cast<unsigned>(op.opCode)));
+}
+
+static uint32_t calculateSFU(const Address address, const uint32_t value)
+{
+	const float f = toFloat(value);
+	if(address == REG_SFU_RECIP.num)
+		return fromFloat(1.0f / f);
+	if(address == REG_SFU_RECIP_SQRT.num)
+		return fromFloat(1.0f / std::sqrt(f));
+	if(address == REG_SFU_EXP2.num)
+		return fromFloat(std::exp2(f));
+	return fromFloat(std::log2(f));
+}
+
+static uint32_t getSmallImmediateValue(const SmallImmediate immediate)
+{
+	//0 - 15 are the integers 0 to 15, 16 - 31 the integers -16 to -1
+	if(immediate.value <= 15)
+		return immediate.value;
+	if(immediate.value <= 31)
+		return static_cast<uint32_t>(static_cast<int32_t>(immediate.value) - 32);
+	//32 - 47 are the floating-point values 1.0 to 128.0 and 1/256 to 1/2
+	return fromFloat(immediate.getFloatingValue().get());
+}
+
+/*
+ * Applies the unpack-mode to a value read from register-file A (or from r4, if the pm-bit is set)
+ */
+static uint32_t unpackValue(const Unpack mode, const uint32_t value, const bool isR4, const bool isFloatInput)
+{
+	//the r4 unpack unit always converts to floating-point
+	const bool convertToFloat = isR4 || isFloatInput;
+	switch(mode.value)
+	{
+		case UNPACK_16A_32.value:
+			return convertToFloat ? fromFloat(fromHalf(value & 0xFFFF)) : static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(value & 0xFFFF)));
+		case UNPACK_16B_32.value:
+			return convertToFloat ? fromFloat(fromHalf(value >> 16)) : static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(value >> 16)));
+		case UNPACK_8888_32.value:
+			return (value >> 24) * 0x01010101;
+		case UNPACK_8A_32.value:
+		case UNPACK_8B_32.value:
+		case UNPACK_8C_32.value:
+		case UNPACK_8D_32.value:
+		{
+			const uint32_t byte = (value >> (8 * (mode.value - UNPACK_8A_32.value))) & 0xFF;
+			return convertToFloat ? fromFloat(static_cast<float>(byte) / 255.0f) : byte;
+		}
+	}
+	return value;
+}
+
+/*
+ * Applies the pack-mode of register-file A to a result, returns the new value of the whole register
+ */
+static uint32_t packValue(const Pack mode, const uint32_t value, const int64_t wideValue, const uint32_t oldValue, const bool isFloatResult)
+{
+	const int32_t signedValue = static_cast<int32_t>(value);
+	switch(mode.value)
+	{
+		case PACK_32_16A.value:
+			return (oldValue & 0xFFFF0000) | (isFloatResult ? toHalf(toFloat(value)) : value & 0xFFFF);
+		case PACK_32_16B.value:
+			return (oldValue & 0xFFFF) | ((isFloatResult ? toHalf(toFloat(value)) : value & 0xFFFF) << 16);
+		case PACK_32_8888.value:
+			return (value & 0xFF) * 0x01010101;
+		case PACK_32_8A.value:
+		case PACK_32_8B.value:
+		case PACK_32_8C.value:
+		case PACK_32_8D.value:
+		{
+			const uint32_t shift = 8 * (mode.value - PACK_32_8A.value);
+			return (oldValue & ~(0xFFu << shift)) | ((value & 0xFF) << shift);
+		}
+		case PACK_32_32.value:
+			return static_cast<uint32_t>(saturate<int32_t>(static_cast<long>(wideValue)));
+		case PACK_32_16A_S.value:
+			return (oldValue & 0xFFFF0000) | (isFloatResult ? toHalf(toFloat(value)) : static_cast<uint32_t>(saturate<int16_t>(signedValue)) & 0xFFFF);
+		case PACK_32_16B_S.value:
+			return (oldValue & 0xFFFF) | ((isFloatResult ? toHalf(toFloat(value)) : static_cast<uint32_t>(saturate<int16_t>(signedValue)) & 0xFFFF) << 16);
+		case PACK_32_8888_S.value:
+			return static_cast<uint32_t>(saturate<uint8_t>(signedValue)) * 0x01010101;
+		case PACK_32_8A_S.value:
+		case PACK_32_8B_S.value:
+		case PACK_32_8C_S.value:
+		case PACK_32_8D_S.value:
+		{
+			const uint32_t shift = 8 * (mode.value - PACK_32_8A_S.value);
+			return (oldValue & ~(0xFFu << shift)) | (static_cast<uint32_t>(saturate<uint8_t>(signedValue)) << shift);
+		}
+	}
+	return value;
+}
+
+/*
+ * Applies the color conversion of the MUL ALU (pm-bit set), returns the new value of the whole register
+ */
+static uint32_t packColor(const Pack mode, const uint32_t value, const uint32_t oldValue)
+{
+	//"c = sat[round(f * 255)]"
+	const float f = toFloat(value);
+	const uint32_t color = std::isnan(f) ? 0 : static_cast<uint32_t>(std::min(std::max(std::round(f * 255.0f), 0.0f), 255.0f));
+	if(mode.value == PACK_32_8888.value)
+		return color * 0x01010101;
+	if(mode.value >= PACK_MUL_COLOR0.value && mode.value <= PACK_MUL_COLOR3.value)
+	{
+		const uint32_t shift = 8 * (mode.value - PACK_MUL_COLOR0.value);
+		return (oldValue & ~(0xFFu << shift)) | (color << shift);
+	}
+	return value;
+}
+
+/*
+ * The state shared by all QPUs
+ */
+struct SharedState
+{
+	std::vector<uint8_t>& memory;
+	std::vector<uint32_t> vpm;
+	std::size_t mutexOwner = NO_MUTEX_OWNER;
+	std::array<uint8_t, NUM_SEMAPHORES> semaphores;
+	//the cycles the DMA engines finish the transfers queued so far
+	std::size_t dmaLoadsDone = 0;
+	std::size_t dmaStoresDone = 0;
+	//the cache-lines in the V3D L2 cache
+	FastSet<uint32_t> l2CacheLines;
+	MemoryTraffic traffic;
+	std::size_t numRegisterHazards = 0;
+
+	explicit SharedState(std::vector<uint8_t>& memory) : memory(memory), vpm(VPM_NUM_ROWS * VPM_ROW_WORDS, 0)
+	{
+		semaphores.fill(0);
+	}
+
+	void checkAddress(const uint32_t address, const uint32_t numBytes) const
+	{
+		if(static_cast<uint64_t>(address) + numBytes > memory.size())
+			throw CompilationError(CompilationStep::GENERAL, "Emulated memory access out of bounds", std::to_string(address));
+	}
+
+	uint32_t read(const uint32_t address, const uint32_t numBytes) const
+	{
+		checkAddress(address, numBytes);
+		uint32_t value = 0;
+		for(uint32_t i = 0; i < numBytes; ++i)
+			value |= static_cast<uint32_t>(memory[address + i]) << (8 * i);
+		return value;
+	}
+
+	void write(const uint32_t address, const uint32_t value, const uint32_t numBytes)
+	{
+		checkAddress(address, numBytes);
+		for(uint32_t i = 0; i < numBytes; ++i)
+			memory[address + i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+
+	uint32_t& getVPMWord(const std::size_t index)
+	{
+		if(index >= vpm.size())
+			throw CompilationError(CompilationStep::GENERAL, "Emulated VPM access out of bounds", std::to_string(index));
+		return vpm[index];
+	}
+};
+
+struct TMULoad
+{
+	Vector values;
+	std::size_t readyCycle;
+};
+
+/*
+ * The state of a single QPU
+ */
+struct QPUState
+{
+	const std::size_t number;
+	std::size_t pc = 0;
+	bool finished = false;
+	//the remaining delay slots until the branch is taken or the program ends
+	std::size_t branchDelay = 0;
+	std::size_t branchTarget = 0;
+	std::size_t endDelay = 0;
+
+	std::array<Vector, 32> fileA;
+	std::array<Vector, 32> fileB;
+	//the accumulators r0 to r5
+	std::array<Vector, 6> accumulators;
+	ElementMask zeroFlags;
+	ElementMask negativeFlags;
+	ElementMask carryFlags;
+	uint32_t uniformAddress;
+	//the register-file locations written by the current and the previous instruction
+	uint32_t writtenA = 0;
+	uint32_t writtenB = 0;
+	uint32_t lastWrittenA = 0;
+	uint32_t lastWrittenB = 0;
+
+	std::size_t r4Ready = 0;
+	std::array<std::deque<TMULoad>, 2> tmuLoads;
+	FastSet<uint32_t> tmuCacheLines;
+
+	//the generic block read: the setup, the address of the next vector, the number of vectors remaining and the cycle the first vector is available
+	uint32_t vpmReadSetup = 0;
+	uint32_t vpmReadAddress = 0;
+	uint32_t vpmReadsRemaining = 0;
+	std::size_t vpmReadReady = 0;
+	uint32_t vpmWriteSetup = 0;
+	uint32_t vpmWriteAddress = 0;
+	uint32_t dmaLoadSetup = 0;
+	uint32_t dmaLoadPitch = 0;
+	std::size_t dmaLoadReady = 0;
+	uint32_t dmaStoreSetup = 0;
+	uint32_t dmaStoreStride = 0;
+	std::size_t dmaStoreReady = 0;
+
+	CycleEstimate statistics;
+
+	QPUState(const std::size_t number, const uint32_t uniformAddress) : number(number), uniformAddress(uniformAddress)
+	{
+		for(Vector& reg : fileA)
+			reg.fill(0);
+		for(Vector& reg : fileB)
+			reg.fill(0);
+		for(Vector& reg : accumulators)
+			reg.fill(0);
+		zeroFlags.fill(false);
+		negativeFlags.fill(false);
+		carryFlags.fill(false);
+	}
+
+	Vector* getRegister(const Address address, const bool isFileA)
+	{
+		if(address < 32)
+			return isFileA ? &fileA[address] : &fileB[address];
+		if(address >= REG_ACC0.num && address <= REG_ACC3.num)
+			return &accumulators[address - REG_ACC0.num];
+		return nullptr;
+	}
+};
+
+/*
+ * The result of an ALU (or the value passed through the ALUs by load immediate, semaphore and branch instructions)
+ */
+struct ALUOutput
+{
+	bool isUsed = false;
+	Address address = REG_NOP.num;
+	ConditionCode condition = COND_NEVER;
+	bool isFloat = false;
+	Vector values;
+	ElementMask carries;
+	std::array<int64_t, NATIVE_VECTOR_SIZE> wideValues;
+
+	ALUOutput()
+	{
+		values.fill(0);
+		carries.fill(false);
+		wideValues.fill(0);
+	}
+
+	void setImmediate(const Address out, const ConditionCode cond, const Vector& immediate)
+	{
+		isUsed = true;
+		address = out;
+		condition = cond;
+		values = immediate;
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+			wideValues[i] = static_cast<int32_t>(immediate[i]);
+	}
+};
+
+static bool isFileA(const bool isAddALU, const WriteSwap swap)
+{
+	//"add ALU writes to regfile A, mult to regfile B", unless swapped
+	return isAddALU == (swap == WriteSwap::DONT_SWAP);
+}
+
+static ElementMask getConditionMask(const QPUState& qpu, const ConditionCode cond)
+{
+	ElementMask mask;
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		switch(cond.value)
+		{
+			case COND_ALWAYS.value:
+				mask[i] = true;
+				break;
+			case COND_ZERO_SET.value:
+				mask[i] = qpu.zeroFlags[i];
+				break;
+			case COND_ZERO_CLEAR.value:
+				mask[i] = !qpu.zeroFlags[i];
+				break;
+			case COND_NEGATIVE_SET.value:
+				mask[i] = qpu.negativeFlags[i];
+				break;
+			case COND_NEGATIVE_CLEAR.value:
+				mask[i] = !qpu.negativeFlags[i];
+				break;
+			case COND_CARRY_SET.value:
+				mask[i] = qpu.carryFlags[i];
+				break;
+			case COND_CARRY_CLEAR.value:
+				mask[i] = !qpu.carryFlags[i];
+				break;
+			default:
+				mask[i] = false;
+		}
+	}
+	return mask;
+}
+
+static bool isBranchTaken(const QPUState& qpu, const BranchCond cond)
+{
+	const auto all = [](const ElementMask& flags, const bool value) -> bool
+	{
+		return std::all_of(flags.begin(), flags.end(), [value](bool flag) -> bool { return flag == value; });
+	};
+	const auto any = [](const ElementMask& flags, const bool value) -> bool
+	{
+		return std::any_of(flags.begin(), flags.end(), [value](bool flag) -> bool { return flag == value; });
+	};
+	switch(cond)
+	{
+		case BranchCond::ALL_Z_SET:
+			return all(qpu.zeroFlags, true);
+		case BranchCond::ALL_Z_CLEAR:
+			return all(qpu.zeroFlags, false);
+		case BranchCond::ANY_Z_SET:
+			return any(qpu.zeroFlags, true);
+		case BranchCond::ANY_Z_CLEAR:
+			return any(qpu.zeroFlags, false);
+		case BranchCond::ALL_N_SET:
+			return all(qpu.negativeFlags, true);
+		case BranchCond::ALL_N_CLEAR:
+			return all(qpu.negativeFlags, false);
+		case BranchCond::ANY_N_SET:
+			return any(qpu.negativeFlags, true);
+		case BranchCond::ANY_N_CLEAR:
+			return any(qpu.negativeFlags, false);
+		case BranchCond::ALL_C_SET:
+			return all(qpu.carryFlags, true);
+		case BranchCond::ALL_C_CLEAR:
+			return all(qpu.carryFlags, false);
+		case BranchCond::ANY_C_SET:
+			return any(qpu.carryFlags, true);
+		case BranchCond::ANY_C_CLEAR:
+			return any(qpu.carryFlags, false);
+		case BranchCond::ALWAYS:
+			return true;
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Invalid branch condition", std::to_string(static_cast<unsigned>(cond)));
+}
+
+static void updateFlags(QPUState& qpu, const ALUOutput& output, const ElementMask& mask)
+{
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		if(!mask[i])
+			continue;
+		const uint32_t value = output.values[i];
+		//a floating-point zero has two representations
+		qpu.zeroFlags[i] = output.isFloat ? (value & 0x7FFFFFFF) == 0 : value == 0;
+		qpu.negativeFlags[i] = (value & 0x80000000) != 0 && !(output.isFloat && qpu.zeroFlags[i]);
+		qpu.carryFlags[i] = output.carries[i];
+	}
+}
+
+/*
+ * Returns the index of the VPM word and the byte within the word, the given element of a horizontal generic block access is located at
+ */
+static std::pair<std::size_t, uint32_t> getVPMLocation(const uint32_t address, const uint8_t size, const std::size_t element)
+{
+	//for 8-bit and 16-bit values, the lower bits of the address select the byte/half-word within the words of the row
+	if(size == 0)
+		return std::make_pair((address >> 2) * VPM_ROW_WORDS + element, address & 0x3);
+	if(size == 1)
+		return std::make_pair((address >> 1) * VPM_ROW_WORDS + element, (address & 0x1) * 2);
+	return std::make_pair(address * VPM_ROW_WORDS + element, 0u);
+}
+
+static uint32_t readLane(const uint32_t word, const uint32_t byteOffset, const uint32_t width)
+{
+	if(width == 4)
+		return word;
+	return (word >> (byteOffset * 8)) & ((1u << (width * 8)) - 1);
+}
+
+static uint32_t writeLane(const uint32_t word, const uint32_t byteOffset, const uint32_t width, const uint32_t value)
+{
+	if(width == 4)
+		return value;
+	const uint32_t mask = ((1u << (width * 8)) - 1) << (byteOffset * 8);
+	return (word & ~mask) | ((value << (byteOffset * 8)) & mask);
+}
+
+/*
+ * Returns the width of a generic block access in bytes
+ */
+static uint32_t checkGenericSetup(const uint8_t size, const bool isHorizontal, const bool isLaned)
+{
+	if(size > 2)
+		throw CompilationError(CompilationStep::GENERAL, "Invalid VPM generic block access size", std::to_string(static_cast<unsigned>(size)));
+	//"Packed, Laned. Ignored for 32-bit width"
+	if(!isHorizontal || (isLaned && size != 2))
+		throw CompilationError(CompilationStep::GENERAL, "Vertical and laned VPM accesses are not supported by the emulator");
+	return 1u << size;
+}
+
+/*
+ * Returns the width in bytes and the byte offset within the VPM words of a DMA access
+ */
+static uint32_t getDMAWidth(const uint8_t mode, uint32_t& byteOffset)
+{
+	//"0: width = 32-bit, 2-3: width = 16-bit, Half-word offset = MODEW[0], 4-7: width = 8-bit, Byte offset = MODEW[1:0]"
+	if(mode == 0)
+	{
+		byteOffset = 0;
+		return 4;
+	}
+	if(mode >= 4)
+	{
+		byteOffset = mode & 0x3;
+		return 1;
+	}
+	if(mode >= 2)
+	{
+		byteOffset = (mode & 0x1) * 2;
+		return 2;
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Invalid VPM DMA mode", std::to_string(static_cast<unsigned>(mode)));
+}
+
+static Vector readVPM(QPUState& qpu, SharedState& shared)
+{
+	const periphery::VPRSetup setup(qpu.vpmReadSetup);
+	const uint8_t size = setup.genericSetup.getSize();
+	const uint32_t width = checkGenericSetup(size, setup.genericSetup.getHorizontal(), setup.genericSetup.getLaned());
+	Vector result;
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		const auto location = getVPMLocation(qpu.vpmReadAddress, size, i);
+		result[i] = readLane(shared.getVPMWord(location.first), location.second, width);
+	}
+	//"Stride. This is added to ADDR after every vector read. 0 => 64."
+	qpu.vpmReadAddress += setup.genericSetup.getStride() == 0 ? 64 : setup.genericSetup.getStride();
+	--qpu.vpmReadsRemaining;
+	return result;
+}
+
+static void writeVPM(QPUState& qpu, SharedState& shared, const Vector& values, const ElementMask& mask)
+{
+	const periphery::VPWSetup setup(qpu.vpmWriteSetup);
+	const uint8_t size = setup.genericSetup.getSize();
+	const uint32_t width = checkGenericSetup(size, setup.genericSetup.getHorizontal(), setup.genericSetup.getLaned());
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		if(!mask[i])
+			continue;
+		const auto location = getVPMLocation(qpu.vpmWriteAddress, size, i);
+		uint32_t& word = shared.getVPMWord(location.first);
+		word = writeLane(word, location.second, width, values[i]);
+	}
+	qpu.vpmWriteAddress += setup.genericSetup.getStride() == 0 ? 64 : setup.genericSetup.getStride();
+}
+
+static void setupVPMRead(QPUState& qpu, const uint32_t value, const std::size_t cycle)
+{
+	const periphery::VPRSetup setup(value);
+	if(setup.isStrideSetup())
+		qpu.dmaLoadPitch = setup.strideSetup.getStride();
+	//the mode-bits of the DMA setup overlap with the bits checked by VPRSetup#isDMASetup()
+	else if((value & 0x80000000) != 0)
+		qpu.dmaLoadSetup = value;
+	else if(setup.isGenericSetup())
+	{
+		qpu.vpmReadSetup = value;
+		qpu.vpmReadAddress = setup.genericSetup.getAddress();
+		//"Number of vectors to read (0 => 16)."
+		qpu.vpmReadsRemaining = setup.genericSetup.getNumber() == 0 ? 16 : setup.genericSetup.getNumber();
+		qpu.vpmReadReady = cycle + VPM_READ_LATENCY;
+	}
+	else
+		throw CompilationError(CompilationStep::GENERAL, "Invalid VPM read setup", std::to_string(value));
+}
+
+static void setupVPMWrite(QPUState& qpu, const uint32_t value)
+{
+	const periphery::VPWSetup setup(value);
+	if(setup.isGenericSetup())
+	{
+		qpu.vpmWriteSetup = value;
+		qpu.vpmWriteAddress = setup.genericSetup.getAddress();
+	}
+	else if(setup.isDMASetup())
+		qpu.dmaStoreSetup = value;
+	else if(setup.isStrideSetup())
+		qpu.dmaStoreStride = setup.strideSetup.getStride();
+	else
+		throw CompilationError(CompilationStep::GENERAL, "Invalid VPM write setup", std::to_string(value));
+}
+
+static void startDMALoad(QPUState& qpu, SharedState& shared, const uint32_t address, const std::size_t cycle)
+{
+	const periphery::VPRSetup setup(qpu.dmaLoadSetup);
+	const periphery::VPRDMASetup& dma = setup.dmaSetup;
+	if(dma.getVertical())
+		throw CompilationError(CompilationStep::GENERAL, "Vertical VPM DMA loads are not supported by the emulator");
+	uint32_t byteOffset = 0;
+	const uint32_t width = getDMAWidth(dma.getMode(), byteOffset);
+	//"(0 => 16)"
+	const uint32_t rowLength = dma.getRowLength() == 0 ? 16 : dma.getRowLength();
+	const uint32_t numRows = dma.getNumberRows() == 0 ? 16 : dma.getNumberRows();
+	const uint32_t vpmPitch = dma.getVPitch() == 0 ? 16 : dma.getVPitch();
+	//"If MPITCH is 0, selects MPITCHB from the extended pitch setup register. Otherwise, pitch = 8*2^MPITCH bytes."
+	const uint32_t memoryPitch = dma.getMPitch() == 0 ? qpu.dmaLoadPitch : (8u << dma.getMPitch());
+	//"ADDRA[10:0] = {Y[6:0], X[3:0]}"
+	const uint32_t row = (dma.getAddress() >> 4) & 0x7F;
+	const uint32_t column = dma.getAddress() & 0xF;
+	for(uint32_t r = 0; r < numRows; ++r)
+	{
+		for(uint32_t i = 0; i < rowLength; ++i)
+		{
+			uint32_t& word = shared.getVPMWord((row + r * vpmPitch) * VPM_ROW_WORDS + column + i);
+			word = writeLane(word, byteOffset, width, shared.read(address + r * memoryPitch + i * width, width));
+		}
+	}
+	++shared.traffic.numDMALoads;
+	shared.traffic.dmaLoadBytes += numRows * rowLength * width;
+	//the DMA engine is shared by all QPUs and executes the transfers in order
+	shared.dmaLoadsDone = std::max(cycle, shared.dmaLoadsDone) + DMA_LATENCY + (numRows - 1) * DMA_ROW_LATENCY;
+	qpu.dmaLoadReady = shared.dmaLoadsDone;
+}
+
+static void startDMAStore(QPUState& qpu, SharedState& shared, const uint32_t address, const std::size_t cycle)
+{
+	const periphery::VPWSetup setup(qpu.dmaStoreSetup);
+	const periphery::VPWDMASetup& dma = setup.dmaSetup;
+	if(!dma.getHorizontal())
+		throw CompilationError(CompilationStep::GENERAL, "Vertical VPM DMA stores are not supported by the emulator");
+	uint32_t byteOffset = 0;
+	const uint32_t width = getDMAWidth(dma.getMode(), byteOffset);
+	//"(0 => 128)"
+	const uint32_t rowLength = dma.getDepth() == 0 ? 128 : dma.getDepth();
+	const uint32_t numRows = dma.getUnits() == 0 ? 128 : dma.getUnits();
+	//"X,Y address of first 32-bit word in VPM to load to/store from. ADDRA[10:0] = {Y[6:0], X[3:0]}"
+	const uint32_t row = (dma.getVPMBase() >> 4) & 0x7F;
+	const uint32_t column = dma.getVPMBase() & 0xF;
+	//"Distance between last byte of a row and start of next row in memory, in bytes."
+	const uint32_t memoryPitch = rowLength * width + qpu.dmaStoreStride;
+	for(uint32_t r = 0; r < numRows; ++r)
+	{
+		for(uint32_t i = 0; i < rowLength; ++i)
+		{
+			const uint32_t word = shared.getVPMWord((row + r) * VPM_ROW_WORDS + column + i);
+			shared.write(address + r * memoryPitch + i * width, readLane(word, byteOffset, width), width);
+		}
+	}
+	++shared.traffic.numDMAStores;
+	shared.traffic.dmaStoreBytes += numRows * rowLength * width;
+	shared.dmaStoresDone = std::max(cycle, shared.dmaStoresDone) + DMA_LATENCY + (numRows - 1) * DMA_ROW_LATENCY;
+	qpu.dmaStoreReady = shared.dmaStoresDone;
+}
+
+static void loadTMU(QPUState& qpu, SharedState& shared, const std::size_t tmu, const Vector& addresses, const ElementMask& mask, const std::size_t cycle)
+{
+	TMULoad load;
+	load.values.fill(0);
+	std::size_t latency = TMU_LOAD_LATENCY;
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		if(!mask[i])
+			continue;
+		//general memory look-ups read the aligned 32-bit word
+		const uint32_t address = addresses[i] & ~0x3u;
+		load.values[i] = shared.read(address, 4);
+		shared.traffic.tmuBytes += 4;
+		const uint32_t line = address / CACHE_LINE_SIZE;
+		if(qpu.tmuCacheLines.count(line) == 0)
+		{
+			latency = std::max(latency, shared.l2CacheLines.count(line) == 0 ? TMU_MEMORY_LATENCY : TMU_L2_LATENCY);
+			qpu.tmuCacheLines.insert(line);
+			shared.l2CacheLines.insert(line);
+		}
+	}
+	++shared.traffic.numTMULoads;
+	load.readyCycle = cycle + latency;
+	qpu.tmuLoads[tmu].push_back(load);
+}
+
+/*
+ * Returns whether the QPU needs to wait before reading the given register-file address
+ */
+static Optional<StallSource> checkRead(const QPUState& qpu, const SharedState& shared, const Address address, const bool isFileA, const std::size_t cycle)
+{
+	if(address == REG_VPM_IO.num)
+	{
+		if(qpu.vpmReadsRemaining == 0)
+			throw CompilationError(CompilationStep::GENERAL, "Reading from VPM without a generic block read setup stalls forever", std::to_string(qpu.pc));
+		if(qpu.vpmReadReady > cycle)
+			return StallSource::VPM;
+	}
+	else if(address == REG_VPM_IN_WAIT.num)
+	{
+		if((isFileA ? qpu.dmaLoadReady : qpu.dmaStoreReady) > cycle)
+			return StallSource::DMA;
+	}
+	else if(address == REG_MUTEX.num)
+	{
+		if(shared.mutexOwner == qpu.number)
+			throw CompilationError(CompilationStep::GENERAL, "Acquiring the mutex already held by the same QPU dead-locks", std::to_string(qpu.pc));
+		if(shared.mutexOwner != NO_MUTEX_OWNER)
+			return StallSource::MUTEX;
+	}
+	return {};
+}
+
+static Vector readRegister(QPUState& qpu, SharedState& shared, const Address address, const bool isFileA, const std::size_t cycle)
+{
+	Vector result;
+	result.fill(0);
+	if(address < 32)
+	{
+		if(((isFileA ? qpu.lastWrittenA : qpu.lastWrittenB) & (1u << address)) != 0)
+		{
+			DEBUG_LOG("QPU " << qpu.number << " reads register " << (isFileA ? "ra" : "rb") << static_cast<unsigned>(address) << " directly after writing it at instruction " << qpu.pc << logging::endl);
+			++shared.numRegisterHazards;
+		}
+		return isFileA ? qpu.fileA[address] : qpu.fileB[address];
+	}
+	if(address == REG_UNIFORM.num)
+	{
+		result.fill(shared.read(qpu.uniformAddress, 4));
+		qpu.uniformAddress += 4;
+		shared.traffic.uniformBytes += 4;
+	}
+	else if(address == REG_ELEMENT_NUMBER.num)
+	{
+		//register-file A reads the element number, register-file B the QPU number
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+			result[i] = static_cast<uint32_t>(isFileA ? i : qpu.number);
+	}
+	else if(address == REG_VPM_IO.num)
+		result = readVPM(qpu, shared);
+	else if(address == REG_VPM_IN_BUSY.num)
+		result.fill((isFileA ? qpu.dmaLoadReady : qpu.dmaStoreReady) > cycle ? 1 : 0);
+	else if(address == REG_MUTEX.num)
+		shared.mutexOwner = qpu.number;
+	//all other addresses (including the DMA wait registers, once the stall is over) read zero
+	return result;
+}
+
+/*
+ * Writes the values of the elements, for which the condition is met, to the register or periphery at the given address
+ */
+static void writeRegister(QPUState& qpu, SharedState& shared, const Address address, const bool isFileA, const Vector& values, const ElementMask& mask, const std::size_t cycle)
+{
+	if(std::none_of(mask.begin(), mask.end(), [](bool flag) -> bool { return flag; }))
+		return;
+	if(Vector* reg = qpu.getRegister(address, isFileA))
+	{
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+		{
+			if(mask[i])
+				(*reg)[i] = values[i];
+		}
+		if(address < 32)
+			(isFileA ? qpu.writtenA : qpu.writtenB) |= 1u << address;
+	}
+	else if(address == REG_ACC5.num)
+	{
+		//writing r5 replicates the first element of every quad (register-file A) or the first element (register-file B)
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+			qpu.accumulators[5][i] = values[isFileA ? i & ~std::size_t{3} : 0];
+	}
+	//the periphery registers only use the value of the first element
+	else if(address == REG_UNIFORM_ADDRESS.num)
+		qpu.uniformAddress = values[0];
+	else if(address == REG_VPM_IO.num)
+		writeVPM(qpu, shared, values, mask);
+	else if(address == REG_VPM_IN_SETUP.num)
+	{
+		if(isFileA)
+			setupVPMRead(qpu, values[0], cycle);
+		else
+			setupVPMWrite(qpu, values[0]);
+	}
+	else if(address == REG_VPM_IN_ADDR.num)
+	{
+		if(isFileA)
+			startDMALoad(qpu, shared, values[0], cycle);
+		else
+			startDMAStore(qpu, shared, values[0], cycle);
+	}
+	else if(address == REG_MUTEX.num)
+	{
+		if(shared.mutexOwner != qpu.number)
+			logging::warn() << "QPU " << qpu.number << " releases the mutex it does not hold at instruction " << qpu.pc << logging::endl;
+		shared.mutexOwner = NO_MUTEX_OWNER;
+	}
+	else if(address >= REG_SFU_RECIP.num && address <= REG_SFU_LOG2.num)
+	{
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+			qpu.accumulators[4][i] = calculateSFU(address, values[i]);
+		qpu.r4Ready = cycle + SFU_LATENCY;
+	}
+	else if(address == REG_TMU_ADDRESS.num || address == REG_TMU1_ADDRESS.num)
+		loadTMU(qpu, shared, address == REG_TMU_ADDRESS.num ? 0 : 1, values, mask, cycle);
+	else if(address > REG_TMU_ADDRESS.num)
+		throw CompilationError(CompilationStep::GENERAL, "Texture look-ups are not supported by the emulator", std::to_string(static_cast<unsigned>(address)));
+	//all other addresses (e.g. nop, host interrupt) have no effect on the emulation
+}
+
+static void writeOutput(QPUState& qpu, SharedState& shared, const ALUOutput& output, const bool isFileA, const ElementMask& mask, const Pack pack, const bool isMulColor, const std::size_t cycle)
+{
+	if(!output.isUsed || output.address == REG_NOP.num)
+		return;
+	Vector values = output.values;
+	//"the a-regfile pack block allows the 32-bit ALU result to be packed back into the a-regfile", the color conversion applies to any output of the MUL ALU
+	if(pack.value != PACK_NOP.value && (isMulColor || (isFileA && output.address < 32)))
+	{
+		const Vector* reg = qpu.getRegister(output.address, isFileA);
+		for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+		{
+			const uint32_t oldValue = reg != nullptr ? (*reg)[i] : 0;
+			values[i] = isMulColor ? packColor(pack, values[i], oldValue) : packValue(pack, values[i], output.wideValues[i], oldValue, output.isFloat);
+		}
+	}
+	writeRegister(qpu, shared, output.address, isFileA, values, mask, cycle);
+}
+
+static void writeOutputs(QPUState& qpu, SharedState& shared, const ALUOutput& add, const ALUOutput& mul, const Pack pack, const WriteSwap swap, const SetFlag setFlags, const std::size_t cycle)
+{
+	//the conditions are evaluated with the flags before this instruction
+	const ElementMask addMask = getConditionMask(qpu, add.isUsed ? add.condition : COND_NEVER);
+	const ElementMask mulMask = getConditionMask(qpu, mul.isUsed ? mul.condition : COND_NEVER);
+	if(setFlags == SetFlag::SET_FLAGS)
+	{
+		//"flags are updated from the add ALU unless the add ALU performed a NOP (or its condition code was NEVER) in which case flags are updated from the mul ALU"
+		if(add.isUsed && add.condition != COND_NEVER)
+			updateFlags(qpu, add, addMask);
+		else if(mul.isUsed)
+			updateFlags(qpu, mul, mulMask);
+	}
+	//the pm-bit selects between the pack unit of register-file A and the color conversion of the MUL ALU
+	const bool isMulColor = (pack.value & 0x10) != 0;
+	const Pack mode(static_cast<unsigned char>(pack.value & 0xF));
+	writeOutput(qpu, shared, add, isFileA(true, swap), addMask, isMulColor ? PACK_NOP : mode, false, cycle);
+	writeOutput(qpu, shared, mul, isFileA(false, swap), mulMask, mode, isMulColor, cycle);
+}
+
+static bool isFloatInput(const OpAdd& op)
+{
+	return op.opCode >= OPADD_FADD.opCode && op.opCode <= OPADD_FTOI.opCode;
+}
+
+static bool isFloatResult(const OpAdd& op)
+{
+	return op.opCode >= OPADD_FADD.opCode && op.opCode <= OPADD_ITOF.opCode && op != OPADD_FTOI;
+}
+
+static void executeALU(const ALUInstruction& alu, QPUState& qpu, SharedState& shared, const std::size_t cycle)
+{
+	const OpAdd add = alu.getAddition();
+	const OpMul mul = alu.getMultiplication();
+	//the register-files are read once per instruction, independent of whether the value is used by any ALU
+	const Vector regA = readRegister(qpu, shared, alu.getInputA(), true, cycle);
+	Vector regB;
+	//the MUL ALU output is rotated by this number of elements (zero for no rotation)
+	std::size_t rotation = 0;
+	if(alu.getSig() == Signaling::ALU_IMMEDIATE)
+	{
+		const SmallImmediate immediate(alu.getInputB());
+		regB.fill(0);
+		if(immediate.value == VECTOR_ROTATE_R5.value)
+			rotation = qpu.accumulators[5][0] & 0xF;
+		else if(immediate.isVectorRotation())
+			rotation = immediate.getRotationOffset().get();
+		else
+			regB.fill(getSmallImmediateValue(immediate));
+	}
+	else
+		regB = readRegister(qpu, shared, alu.getInputB(), false, cycle);
+
+	const bool unpackR4 = (alu.getPack().value & 0x10) != 0;
+	const auto getOperand = [&](const InputMutex mux, const std::size_t element, const bool isFloat) -> uint32_t
+	{
+		if(mux == InputMutex::REGA)
+			return unpackR4 ? regA[element] : unpackValue(alu.getUnpack(), regA[element], false, isFloat);
+		if(mux == InputMutex::REGB)
+			return regB[element];
+		if(mux == InputMutex::ACC4 && unpackR4)
+			return unpackValue(alu.getUnpack(), qpu.accumulators[4][element], true, isFloat);
+		return qpu.accumulators[static_cast<std::size_t>(mux)][element];
+	};
+
+	ALUOutput addOutput;
+	addOutput.isUsed = add != OPADD_NOP;
+	addOutput.address = alu.getAddOut();
+	addOutput.condition = alu.getAddCondition();
+	addOutput.isFloat = isFloatResult(add);
+	ALUOutput mulOutput;
+	mulOutput.isUsed = mul != OPMUL_NOP;
+	mulOutput.address = alu.getMulOut();
+	mulOutput.condition = alu.getMulCondition();
+	mulOutput.isFloat = mul == OPMUL_FMUL;
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		if(addOutput.isUsed)
+		{
+			bool carry = false;
+			addOutput.values[i] = calculateAdd(add, getOperand(alu.getAddMutexA(), i, isFloatInput(add)), getOperand(alu.getAddMutexB(), i, isFloatInput(add)), carry, addOutput.wideValues[i]);
+			addOutput.carries[i] = carry;
+		}
+		if(mulOutput.isUsed)
+		{
+			//"multiplication output vector rotated by 1 - 15 upwards (so element 0 moves to element 1 - 15)"
+			const std::size_t source = (i + NATIVE_VECTOR_SIZE - rotation) % NATIVE_VECTOR_SIZE;
+			mulOutput.values[i] = calculateMul(mul, getOperand(alu.getMulMutexA(), source, mulOutput.isFloat), getOperand(alu.getMulMutexB(), source, mulOutput.isFloat));
+			mulOutput.wideValues[i] = static_cast<int32_t>(mulOutput.values[i]);
+		}
+	}
+	writeOutputs(qpu, shared, addOutput, mulOutput, alu.getPack(), alu.getWriteSwap(), alu.getSetFlag(), cycle);
+
+	const Signaling sig = alu.getSig();
+	if(sig == Signaling::LOAD_TMU0 || sig == Signaling::LOAD_TMU1)
+	{
+		auto& queue = qpu.tmuLoads[sig == Signaling::LOAD_TMU0 ? 0 : 1];
+		qpu.accumulators[4] = queue.front().values;
+		queue.pop_front();
+	}
+	else if(sig == Signaling::PROGRAM_END)
+		qpu.endDelay = PROGRAM_END_DELAY_SLOTS;
+	else if(sig == Signaling::WAIT_FOR_SCORE || sig == Signaling::SCORE_UNLOCK || sig == Signaling::COVERAGE_LOAD || sig == Signaling::COLOR_LOAD ||
+			sig == Signaling::COLOR_LOAD_END || sig == Signaling::ALPHA_LOAD)
+		throw CompilationError(CompilationStep::GENERAL, "Tile buffer accesses are not supported by the emulator", toString(sig));
+	//the thread-switch signals have no effect with a single thread per QPU
+}
+
+static void executeLoad(const LoadInstruction& load, const uint64_t binaryCode, QPUState& qpu, SharedState& shared, const std::size_t cycle)
+{
+	const uint8_t type = static_cast<uint8_t>((binaryCode >> 57) & 0x7F);
+	Vector values;
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		if(type == static_cast<uint8_t>(OpLoad::LOAD_IMM_32))
+			values[i] = load.getImmediateInt();
+		else
+		{
+			//"16 individual 2-bit values per-element", the upper half contains the MSB, the lower half the LSB of the element values
+			const uint32_t bits = (((load.getImmediateShort0() >> i) & 0x1) << 1) | ((load.getImmediateShort1() >> i) & 0x1);
+			values[i] = type == static_cast<uint8_t>(OpLoad::LOAD_SIGNED) && (bits & 0x2) != 0 ? bits | 0xFFFFFFFC : bits;
+		}
+	}
+	ALUOutput addOutput;
+	addOutput.setImmediate(load.getAddOut(), load.getAddCondition(), values);
+	ALUOutput mulOutput;
+	mulOutput.setImmediate(load.getMulOut(), load.getMulCondition(), values);
+	writeOutputs(qpu, shared, addOutput, mulOutput, load.getPack(), load.getWriteSwap(), load.getSetFlag(), cycle);
+}
+
+static void executeSemaphore(const SemaphoreInstruction& semaphore, const uint64_t binaryCode, QPUState& qpu, SharedState& shared, const std::size_t cycle)
+{
+	uint8_t& value = shared.semaphores[static_cast<std::size_t>(semaphore.getSemaphore())];
+	if(semaphore.getIncrementSemaphore())
+		++value;
+	else
+		--value;
+	//"The instruction otherwise behaves like a 32-bit load immediate instruction"
+	Vector values;
+	values.fill(static_cast<uint32_t>(binaryCode));
+	ALUOutput addOutput;
+	addOutput.setImmediate(semaphore.getAddOut(), semaphore.getAddCondition(), values);
+	ALUOutput mulOutput;
+	mulOutput.setImmediate(semaphore.getMulOut(), semaphore.getMulCondition(), values);
+	writeOutputs(qpu, shared, addOutput, mulOutput, semaphore.getPack(), semaphore.getWriteSwap(), semaphore.getSetFlag(), cycle);
+}
+
+static void executeBranch(const BranchInstruction& branch, QPUState& qpu, SharedState& shared, const std::size_t numInstructions, const std::size_t cycle)
+{
+	if(isBranchTaken(qpu, branch.getBranchCondition()))
+	{
+		//the target is in bytes, "the sum of the (signed) immediate field, the current PC+4 (if the rel bit is set) and the value read from the a register file SIMD element 0 (if the reg bit is set)"
+		int64_t target = branch.getImmediate();
+		if(branch.getBranchRelative() == BranchRel::BRANCH_RELATIVE)
+			target += static_cast<int64_t>(qpu.pc + 4) * 8;
+		if(branch.getAddRegister() == BranchReg::BRANCH_REG)
+			target += qpu.fileA[branch.getRegisterAddress()][0];
+		if(target < 0 || target % 8 != 0 || static_cast<std::size_t>(target / 8) >= numInstructions)
+			throw CompilationError(CompilationStep::GENERAL, "Invalid branch target", std::to_string(target));
+		qpu.branchTarget = static_cast<std::size_t>(target / 8);
+		qpu.branchDelay = BRANCH_DELAY_SLOTS;
+	}
+	//"the link address (the current instruction plus four) appears at the output of the add and mul ALUs"
+	Vector link;
+	link.fill(static_cast<uint32_t>((qpu.pc + 4) * 8));
+	ALUOutput addOutput;
+	addOutput.setImmediate(branch.getAddOut(), COND_ALWAYS, link);
+	ALUOutput mulOutput;
+	mulOutput.setImmediate(branch.getMulOut(), COND_ALWAYS, link);
+	writeOutputs(qpu, shared, addOutput, mulOutput, PACK_NOP, WriteSwap::DONT_SWAP, SetFlag::DONT_SET, cycle);
+}
+
+/*
+ * Returns the reason the QPU needs to wait before issuing the instruction in the given cycle, if any
+ */
+static Optional<StallSource> checkStall(const Instruction* instr, const QPUState& qpu, const SharedState& shared, const std::size_t cycle)
+{
+	if(const ALUInstruction* alu = dynamic_cast<const ALUInstruction*>(instr))
+	{
+		const OpAdd add = alu->getAddition();
+		const OpMul mul = alu->getMultiplication();
+		const bool readsR4 = (add != OPADD_NOP && add.numOperands > 0 && alu->getAddMutexA() == InputMutex::ACC4) ||
+				(add != OPADD_NOP && add.numOperands > 1 && alu->getAddMutexB() == InputMutex::ACC4) ||
+				(mul != OPMUL_NOP && mul.numOperands > 0 && alu->getMulMutexA() == InputMutex::ACC4) ||
+				(mul != OPMUL_NOP && mul.numOperands > 1 && alu->getMulMutexB() == InputMutex::ACC4);
+		if(readsR4 && qpu.r4Ready > cycle)
+			return StallSource::SFU;
+		const Optional<StallSource> stallA = checkRead(qpu, shared, alu->getInputA(), true, cycle);
+		if(stallA)
+			return stallA;
+		if(alu->getSig() != Signaling::ALU_IMMEDIATE)
+		{
+			const Optional<StallSource> stallB = checkRead(qpu, shared, alu->getInputB(), false, cycle);
+			if(stallB)
+				return stallB;
+		}
+		if(alu->getSig() == Signaling::LOAD_TMU0 || alu->getSig() == Signaling::LOAD_TMU1)
+		{
+			const auto& queue = qpu.tmuLoads[alu->getSig() == Signaling::LOAD_TMU0 ? 0 : 1];
+			if(queue.empty())
+				throw CompilationError(CompilationStep::GENERAL, "Loading from TMU without a pending look-up stalls forever", std::to_string(qpu.pc));
+			if(queue.front().readyCycle > cycle)
+				return StallSource::TMU;
+		}
+	}
+	else if(const SemaphoreInstruction* semaphore = dynamic_cast<const SemaphoreInstruction*>(instr))
+	{
+		//"The QPU stalls if it is attempting to decrement a semaphore below 0 or increment it above 15."
+		const uint8_t value = shared.semaphores[static_cast<std::size_t>(semaphore->getSemaphore())];
+		if(semaphore->getIncrementSemaphore() ? value == MAX_SEMAPHORE_VALUE : value == 0)
+			return StallSource::SEMAPHORE;
+	}
+	return {};
+}
+
+/*
+ * Issues the next instruction of the QPU in the given cycle, unless it needs to stall
+ */
+static void executeCycle(QPUState& qpu, SharedState& shared, const std::vector<std::unique_ptr<Instruction>>& instructions, const std::vector<uint64_t>& binaryCode, const std::size_t cycle)
+{
+	if(qpu.pc >= instructions.size())
+		throw CompilationError(CompilationStep::GENERAL, "QPU executes past the end of the code", std::to_string(qpu.number));
+	const Instruction* instr = instructions[qpu.pc].get();
+	++qpu.statistics.numCycles;
+	const Optional<StallSource> stall = checkStall(instr, qpu, shared, cycle);
+	if(stall)
+	{
+		++qpu.statistics.stallCycles[static_cast<std::size_t>(stall.get())];
+		return;
+	}
+
+	const bool isBranching = qpu.branchDelay > 0;
+	const bool isEnding = qpu.endDelay > 0;
+	if(const ALUInstruction* alu = dynamic_cast<const ALUInstruction*>(instr))
+	{
+		if(alu->getAddition() != OPADD_NOP || alu->getMultiplication() != OPMUL_NOP)
+			++qpu.statistics.numALUInstructions;
+		else
+			++qpu.statistics.numNops;
+		if(alu->getAddition() != OPADD_NOP && alu->getMultiplication() != OPMUL_NOP)
+			++qpu.statistics.numDualIssued;
+		executeALU(*alu, qpu, shared, cycle);
+	}
+	else if(const LoadInstruction* load = dynamic_cast<const LoadInstruction*>(instr))
+		executeLoad(*load, binaryCode[qpu.pc], qpu, shared, cycle);
+	else if(const SemaphoreInstruction* semaphore = dynamic_cast<const SemaphoreInstruction*>(instr))
+		executeSemaphore(*semaphore, binaryCode[qpu.pc], qpu, shared, cycle);
+	else if(const BranchInstruction* branch = dynamic_cast<const BranchInstruction*>(instr))
+		executeBranch(*branch, qpu, shared, instructions.size(), cycle);
+	++qpu.statistics.numInstructions;
+	qpu.lastWrittenA = qpu.writtenA;
+	qpu.lastWrittenB = qpu.writtenB;
+	qpu.writtenA = 0;
+	qpu.writtenB = 0;
+
+	if(isEnding && --qpu.endDelay == 0)
+	{
+		qpu.finished = true;
+		if(shared.mutexOwner == qpu.number)
+			logging::warn() << "QPU " << qpu.number << " finished while holding the mutex" << logging::endl;
+	}
+	else if(isBranching && --qpu.branchDelay == 0)
+		qpu.pc = qpu.branchTarget;
+	else
+		++qpu.pc;
+}
+
+EmulationResult qpu_asm::emulate(EmulationData& data)
+{
+	if(data.uniformAddresses.empty() || data.uniformAddresses.size() > MAX_EMULATED_QPUS)
+		throw CompilationError(CompilationStep::GENERAL, "Invalid number of QPUs to emulate", std::to_string(data.uniformAddresses.size()));
+	std::vector<std::unique_ptr<Instruction>> instructions;
+	instructions.reserve(data.instructions.size());
+	for(const uint64_t binaryCode : data.instructions)
+		instructions.emplace_back(Instruction::decode(binaryCode));
+
+	SharedState shared(data.memory);
+	std::vector<QPUState> qpus;
+	qpus.reserve(data.uniformAddresses.size());
+	for(std::size_t i = 0; i < data.uniformAddresses.size(); ++i)
+		qpus.emplace_back(i, data.uniformAddresses[i]);
+
+	EmulationResult result;
+	std::size_t cycle = 0;
+	while(!result.completed && cycle < data.maxCycles)
+	{
+		//the QPUs are served in the order of their numbers, e.g. when several QPUs try to acquire the mutex in the same cycle
+		for(QPUState& qpu : qpus)
+		{
+			if(!qpu.finished)
+				executeCycle(qpu, shared, instructions, data.instructions, cycle);
+		}
+		++cycle;
+		result.completed = std::all_of(qpus.begin(), qpus.end(), [](const QPUState& qpu) -> bool { return qpu.finished; });
+	}
+	if(!result.completed)
+		logging::warn() << "Emulation aborted after " << cycle << " cycles, not all QPUs reached the end of the program" << logging::endl;
+
+	result.numCycles = cycle;
+	result.numRegisterHazards = shared.numRegisterHazards;
+	result.traffic = shared.traffic;
+	for(const QPUState& qpu : qpus)
+		result.qpus.push_back(qpu.statistics);
+	DEBUG_LOG("Emulated " << qpus.size() << " QPUs for " << cycle << " cycles with " << result.getTotal().getStallCycles() << " stall cycles" << logging::endl);
+	return result;
+}
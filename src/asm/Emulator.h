@@ -0,0 +1,96 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <ostream>
+#include <vector>
+
+#include "CycleEstimator.h"
+
+namespace vc4c
+{
+	namespace qpu_asm
+	{
+		/*
+		 * The number of QPUs of the VideoCore IV, the maximum number of QPUs to be emulated at once
+		 */
+		constexpr std::size_t MAX_EMULATED_QPUS{12};
+
+		/*
+		 * The input (and output) of an emulation
+		 */
+		struct EmulationData
+		{
+			//the machine code to execute (see Instruction#toBinaryCode), all QPUs start at the first instruction.
+			//The code is not part of the emulated memory, so the absolute branch targets are relative to the first instruction
+			std::vector<uint64_t> instructions;
+			//the emulated memory starting at address zero, containing the UNIFORMs and the buffers accessed by the kernel.
+			//After the emulation, it contains the values written by the kernel
+			std::vector<uint8_t> memory;
+			//the address (in the emulated memory) of the UNIFORMs for every QPU to run, this determines the number of QPUs
+			std::vector<uint32_t> uniformAddresses;
+			//the emulation is aborted after this number of cycles, e.g. for endless loops or dead-locks
+			std::size_t maxCycles = 10000000;
+		};
+
+		/*
+		 * The memory accesses of all QPUs during an emulation
+		 */
+		struct MemoryTraffic
+		{
+			//the number of TMU look-ups (of 16 elements each) and the bytes loaded by them
+			std::size_t numTMULoads = 0;
+			std::size_t tmuBytes = 0;
+			//the number of DMA transfers from memory to VPM and the bytes transferred
+			std::size_t numDMALoads = 0;
+			std::size_t dmaLoadBytes = 0;
+			//the number of DMA transfers from VPM to memory and the bytes transferred
+			std::size_t numDMAStores = 0;
+			std::size_t dmaStoreBytes = 0;
+			std::size_t uniformBytes = 0;
+		};
+
+		/*
+		 * The measured execution statistics of an emulation
+		 */
+		struct EmulationResult
+		{
+			//whether all QPUs reached the end of the program within the maximum number of cycles
+			bool completed = false;
+			//the cycles until the last QPU finished (or the emulation was aborted)
+			std::size_t numCycles = 0;
+			//the number of times a register-file location was read directly after being written, which the hardware does not support
+			std::size_t numRegisterHazards = 0;
+			MemoryTraffic traffic;
+			//the statistics of every QPU, all executions of an instruction are counted
+			std::vector<CycleEstimate> qpus;
+
+			/*
+			 * The summed statistics of all QPUs
+			 */
+			CycleEstimate getTotal() const;
+
+			void writeJSON(std::ostream& stream) const;
+		};
+
+		/*
+		 * Executes the given machine code on the emulated QPUs.
+		 *
+		 * Every QPU executes the 16 SIMD elements of both ALUs and issues an instruction per cycle, unless it stalls on the SFU, TMU, VPM, DMA, the mutex or a semaphore.
+		 * The periphery uses the latencies of the cycle estimator (see CycleEstimator.h), a TMU load additionally takes longer, if the data is not yet cached.
+		 * The VPM, the DMA engine, the hardware mutex and the semaphores are shared by all QPUs, so the emulation also measures the contention between the QPUs.
+		 *
+		 * The data is transferred at the start of a DMA operation, the completion is only delayed. Texture look-ups, the tile buffer, the vertical and laned VPM modes
+		 * are not supported and abort the emulation with a CompilationError, as do accesses outside of the emulated memory.
+		 * The QPUs are emulated with a single hardware thread each, the thread-switch signals are ignored.
+		 */
+		EmulationResult emulate(EmulationData& data);
+	}
+}
+
+#endif /* EMULATOR_H */
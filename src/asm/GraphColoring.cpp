@@ -6,12 +6,16 @@
 
 #include "GraphColoring.h"
 #include "RegisterAllocation.h"
-#include "log.h"
+#include "../Logging.h"
 #include "DebugGraph.h"
 
 #include "../Profiler.h"
+#include "../analysis/AnalysisManager.h"
+#include "../optimization/Instrumentation.h"
+#include "../periphery/VPM.h"
 
 #include <algorithm>
+#include <cmath>
 
 using namespace vc4c;
 using namespace vc4c::qpu_asm;
@@ -54,7 +58,7 @@ static void forLocalsUsedTogether(const Local* local, const std::function<void(c
 	}
 }
 
-ColoredNode::ColoredNode(const Local* local, const RegisterFile possibleFiles) : Node(local), initialFile(possibleFiles), possibleFiles(possibleFiles)
+ColoredNode::ColoredNode(const Local* local, const RegisterFile possibleFiles) : key(local), id(SIZE_MAX), initialFile(possibleFiles), possibleFiles(possibleFiles)
 {
 
 }
@@ -102,7 +106,20 @@ void ColoredNode::takeValues(const ColoredNode& other)
 	this->availableAcc = other.availableAcc;
 	this->availableA = other.availableA;
 	this->availableB = other.availableB;
-	neighbors.insert(other.neighbors.begin(), other.neighbors.end());
+}
+
+void ColoredNode::reset(const RegisterFile possibleFiles, const std::size_t numPhysicalRegisters)
+{
+	this->initialFile = possibleFiles;
+	this->possibleFiles = possibleFiles;
+	availableA.set();
+	availableB.set();
+	availableAcc.set();
+	for(std::size_t i = numPhysicalRegisters; i < availableA.size(); ++i)
+	{
+		availableA.reset(i);
+		availableB.reset(i);
+	}
 }
 
 Register ColoredNode::getRegisterFixed() const
@@ -183,18 +200,176 @@ std::size_t ColoredNode::fixToRegister()
 	throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Cannot fix local to file with no registers left", to_string());
 }
 
-std::string ColoredNode::to_string(bool longDescription) const
+std::size_t ColoredNode::fixToRegister(const Register& preferred)
+{
+	if(preferred == REG_NOP || !isRegisterAvailable(preferred))
+		return fixToRegister();
+	possibleFiles = preferred.file;
+	if(preferred.file == RegisterFile::ACCUMULATOR)
+	{
+		availableAcc.reset();
+		availableAcc.set(static_cast<std::size_t>(preferred.getAccumulatorNumber()));
+		return static_cast<std::size_t>(preferred.getAccumulatorNumber());
+	}
+	std::bitset<32>& available = preferred.file == RegisterFile::PHYSICAL_A ? availableA : availableB;
+	available.reset();
+	available.set(preferred.num);
+	return preferred.num;
+}
+
+bool ColoredNode::isFixedToRegister() const
+{
+	if(possibleFiles == RegisterFile::PHYSICAL_A)
+		return availableA.count() == 1;
+	if(possibleFiles == RegisterFile::PHYSICAL_B)
+		return availableB.count() == 1;
+	if(possibleFiles == RegisterFile::ACCUMULATOR)
+		return availableAcc.count() == 1;
+	return false;
+}
+
+bool ColoredNode::isRegisterAvailable(const Register& reg) const
+{
+	if(reg.file == RegisterFile::ACCUMULATOR)
+	{
+		//r4 and r5 are never assigned to locals
+		const int index = reg.getAccumulatorNumber();
+		return has_flag(possibleFiles, RegisterFile::ACCUMULATOR) && index >= 0 && static_cast<std::size_t>(index) < availableAcc.size() && availableAcc.test(static_cast<std::size_t>(index));
+	}
+	if(reg.file == RegisterFile::PHYSICAL_A)
+		return has_flag(possibleFiles, RegisterFile::PHYSICAL_A) && reg.num < availableA.size() && availableA.test(reg.num);
+	if(reg.file == RegisterFile::PHYSICAL_B)
+		return has_flag(possibleFiles, RegisterFile::PHYSICAL_B) && reg.num < availableB.size() && availableB.test(reg.num);
+	return false;
+}
+
+std::string ColoredNode::to_string() const
 {
-	std::string res = (key->name + " init: ").append(toString(initialFile)).append(", avail: ").append(toString(possibleFiles))
+	return (key->name + " init: ").append(toString(initialFile)).append(", avail: ").append(toString(possibleFiles))
 			.append(" (").append(availableAcc.to_string()).append(", ").append(availableA.to_string()).append(", ")
 			.append(availableB.to_string()).append(")");
-	if(longDescription)
+}
+
+ColoredNode& ColoredGraph::getOrCreateNode(const Local* local, const RegisterFile possibleFiles)
+{
+	auto it = find(local);
+	if(it != end())
+		return it->second;
+	if(nodes.size() == capacity)
+		resizeMatrix(std::max<std::size_t>(64, capacity * 2));
+	ColoredNode& node = emplace(local, ColoredNode(local, possibleFiles)).first->second;
+	node.id = nodes.size();
+	nodes.push_back(&node);
+	return node;
+}
+
+void ColoredGraph::reserve(std::size_t numNodes)
+{
+	Base::reserve(numNodes);
+	nodes.reserve(numNodes);
+	if(numNodes > capacity)
+		resizeMatrix(numNodes);
+}
+
+void ColoredGraph::clear()
+{
+	Base::clear();
+	nodes.clear();
+	std::fill(usedTogether.begin(), usedTogether.end(), 0);
+	std::fill(usedSimultaneously.begin(), usedSimultaneously.end(), 0);
+}
+
+void ColoredGraph::addNeighbor(const ColoredNode& node, const ColoredNode& neighbor, const LocalRelation relation)
+{
+	const std::size_t index = node.id * wordsPerRow + neighbor.id / 64;
+	const uint64_t mask = uint64_t{1} << (neighbor.id % 64);
+	if(((usedTogether[index] | usedSimultaneously[index]) & mask) != 0)
+		//keep the previous relation
+		return;
+	if(relation == LocalRelation::USED_TOGETHER)
+		usedTogether[index] |= mask;
+	else
+		usedSimultaneously[index] |= mask;
+}
+
+void ColoredGraph::copyNeighbors(const ColoredNode& source, const ColoredNode& destination)
+{
+	const std::size_t sourceOffset = source.id * wordsPerRow;
+	const std::size_t destOffset = destination.id * wordsPerRow;
+	for(std::size_t word = 0; word < wordsPerRow; ++word)
+	{
+		const uint64_t existing = usedTogether[destOffset + word] | usedSimultaneously[destOffset + word];
+		usedTogether[destOffset + word] |= usedTogether[sourceOffset + word] & ~existing;
+		usedSimultaneously[destOffset + word] |= usedSimultaneously[sourceOffset + word] & ~existing;
+	}
+}
+
+std::size_t ColoredGraph::countEdges() const
+{
+	std::size_t numEdges = 0;
+	for(std::size_t i = 0; i < usedTogether.size(); ++i)
+		numEdges += static_cast<std::size_t>(__builtin_popcountll(usedTogether[i] | usedSimultaneously[i]));
+	return numEdges;
+}
+
+std::size_t ColoredGraph::getMatrixSize() const
+{
+	return (usedTogether.size() + usedSimultaneously.size()) * sizeof(uint64_t);
+}
+
+std::size_t ColoredGraph::estimateMatrixSize(std::size_t numNodes)
+{
+	//two bit-planes with a row of words per node
+	return 2 * numNodes * ((numNodes + 63) / 64) * sizeof(uint64_t);
+}
+
+void ColoredGraph::removeNeighbors(const ColoredNode& node)
+{
+	std::fill_n(usedTogether.begin() + static_cast<std::ptrdiff_t>(node.id * wordsPerRow), wordsPerRow, 0);
+	std::fill_n(usedSimultaneously.begin() + static_cast<std::ptrdiff_t>(node.id * wordsPerRow), wordsPerRow, 0);
+	const std::size_t word = node.id / 64;
+	const uint64_t mask = ~(uint64_t{1} << (node.id % 64));
+	for(std::size_t row = 0; row < nodes.size(); ++row)
+	{
+		usedTogether[row * wordsPerRow + word] &= mask;
+		usedSimultaneously[row * wordsPerRow + word] &= mask;
+	}
+}
+
+LocalRelation ColoredGraph::getRelation(const ColoredNode& node, const ColoredNode& neighbor) const
+{
+	const std::size_t index = node.id * wordsPerRow + neighbor.id / 64;
+	const uint64_t mask = uint64_t{1} << (neighbor.id % 64);
+	if((usedTogether[index] & mask) != 0)
+		return LocalRelation::USED_TOGETHER;
+	if((usedSimultaneously[index] & mask) != 0)
+		return LocalRelation::USED_SIMULTANEOUSLY;
+	throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Local is not a neighbor of the node", node.to_string() + " - " + neighbor.to_string());
+}
+
+std::size_t ColoredGraph::countNeighbors(const ColoredNode& node) const
+{
+	const std::size_t offset = node.id * wordsPerRow;
+	std::size_t count = 0;
+	for(std::size_t word = 0; word < wordsPerRow; ++word)
+		count += static_cast<std::size_t>(__builtin_popcountll(usedTogether[offset + word] | usedSimultaneously[offset + word]));
+	return count;
+}
+
+void ColoredGraph::resizeMatrix(std::size_t newCapacity)
+{
+	const std::size_t newWordsPerRow = (newCapacity + 63) / 64;
+	std::vector<uint64_t> newTogether(newCapacity * newWordsPerRow, 0);
+	std::vector<uint64_t> newSimultaneously(newCapacity * newWordsPerRow, 0);
+	for(std::size_t row = 0; row < nodes.size(); ++row)
 	{
-		res.append(", neighbors: ");
-		for(const auto& neighbor : neighbors)
-			res.append(neighbor.first->key->name).append(", ");
+		std::copy_n(usedTogether.begin() + static_cast<std::ptrdiff_t>(row * wordsPerRow), wordsPerRow, newTogether.begin() + static_cast<std::ptrdiff_t>(row * newWordsPerRow));
+		std::copy_n(usedSimultaneously.begin() + static_cast<std::ptrdiff_t>(row * wordsPerRow), wordsPerRow, newSimultaneously.begin() + static_cast<std::ptrdiff_t>(row * newWordsPerRow));
 	}
-	return res;
+	usedTogether.swap(newTogether);
+	usedSimultaneously.swap(newSimultaneously);
+	capacity = newCapacity;
+	wordsPerRow = newWordsPerRow;
 }
 
 static void fixToRegisterFile(const RegisterFile file, const Local* local, FastMap<const Local*, LocalUsage>& localUses)
@@ -370,48 +545,47 @@ static void fixLocals(const InstructionWalker it, FastMap<const Local*, LocalUsa
 	}
 }
 
-GraphColoring::GraphColoring(Method& method, InstructionWalker it) : method(method), closedSet(), openSet(), localUses()
+FastMap<const Local*, LocalUsage> qpu_asm::determineLocalUses(Method& method, InstructionWalker it)
 {
-	closedSet.reserve(method.readLocals().size());
-	openSet.reserve(method.readLocals().size());
+	FastMap<const Local*, LocalUsage> localUses;
 	localUses.reserve(method.readLocals().size());
 
 	Optional<const Local*> lastWrittenLocal0(false, nullptr);
 	Optional<const Local*> lastWrittenLocal1(false, nullptr);
+	//the accumulators are shared between the hardware threads, so locals used across a thread switch cannot be located in accumulators
+	std::size_t numThreadSwitches = 0;
+	FastMap<const Local*, std::size_t> threadSwitchesAtFirstUse;
 	while(!it.isEndOfMethod())
 	{
 		if(it.get() != nullptr && !it.has<intermediate::Branch>() && !it.has<intermediate::BranchLabel>() && !it.has<intermediate::MemoryBarrier>())
 		{
 			// 1) create entry per local
-			it->forUsedLocals([this, it](const Local* l, const LocalUser::Type type) -> void
+			it->forUsedLocals([&localUses, &threadSwitchesAtFirstUse, numThreadSwitches, it](const Local* l, const LocalUser::Type type) -> void
 			{
 				if(localUses.find(l) == localUses.end())
 				{
 					if(l->type == TYPE_LABEL)
 						throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Created use for label", it->to_string());
 					localUses.emplace(l, LocalUsage(it, it));
+					threadSwitchesAtFirstUse.emplace(l, numThreadSwitches);
 				}
 			});
 			// 2) update fixed locals
 			PROFILE(fixLocals, it, localUses, lastWrittenLocal0, lastWrittenLocal1);
-			// 3) update local usage-ranges as well as assign all locals to closed-set or open-set
-			it->forUsedLocals([this, it](const Local* l, const LocalUser::Type type) -> void
+			// 3) update local usage-ranges
+			it->forUsedLocals([&localUses, &threadSwitchesAtFirstUse, numThreadSwitches, it](const Local* l, const LocalUser::Type type) -> void
 			{
 				auto& range = localUses.at(l);
 				range.associatedInstructions.insert(it);
 				range.lastOccurrence = it;
-				if(isFixed(range.possibleFiles))
-				{
-					// local is fixed to a certain register-file, move to closed set
-					closedSet.insert(l);
-					openSet.erase(l);
-				}
-				else if(range.lastOccurrence.get() == range.firstOccurrence.get())
+				if(threadSwitchesAtFirstUse.at(l) != numThreadSwitches)
 				{
-					//first use of local (initialization), add to open-set
-					openSet.insert(l);
+					range.blockedFiles = add_flag(range.blockedFiles, RegisterFile::ACCUMULATOR);
+					range.possibleFiles = remove_flag(range.possibleFiles, RegisterFile::ACCUMULATOR);
 				}
 			});
+			if(it->signal == Signaling::THREAD_SWITCH || it->signal == Signaling::LAST_THREAD_SWITCH)
+				++numThreadSwitches;
 		}
 		it.nextInMethod();
 	}
@@ -422,42 +596,47 @@ GraphColoring::GraphColoring(Method& method, InstructionWalker it) : method(meth
 		auto it = localUses.find(&arg);
 		if (it != localUses.end())
 		{
-			it->second.firstOccurrence = const_cast<Method&>(method).walkAllInstructions();
+			it->second.firstOccurrence = method.walkAllInstructions();
 			if(!isFixed(it->second.possibleFiles))
 				//make sure, parameters are not mapped to accumulators
 				it->second.possibleFiles = remove_flag(it->second.possibleFiles, RegisterFile::ACCUMULATOR);
 			break;
 		}
 	}
+	return localUses;
 }
 
-static Graph<InstructionWalker, Node<InstructionWalker, bool>> createBlockGraph(Method& method)
+std::size_t qpu_asm::getNumPhysicalRegisters(const Method& method)
 {
-	Graph<InstructionWalker, Node<InstructionWalker, bool>> graph;
+	return method.getModule().compilationConfig.threadedExecution ? 16 : 32;
+}
 
-	for(BasicBlock& bb :method.getBasicBlocks())
+GraphColoring::GraphColoring(Method& method, InstructionWalker it) : method(method), numPhysicalRegisters(getNumPhysicalRegisters(method)), closedSet(), openSet(), localUses(determineLocalUses(method, it))
+{
+	closedSet.reserve(localUses.size());
+	openSet.reserve(localUses.size());
+	for(const auto& pair : localUses)
 	{
-		bb.forPredecessors([&bb, &graph](InstructionWalker it) -> void
-		{
-			//forward connection
-			graph.getOrCreateNode(it).addNeighbor(&graph.getOrCreateNode(bb.begin()), false);
-			//backward connection
-			graph.getOrCreateNode(bb.begin()).addNeighbor(&graph.getOrCreateNode(it), true);
-		});
+		if(isFixed(pair.second.possibleFiles))
+			// local is fixed to a certain register-file, move to closed set
+			closedSet.insert(pair.first);
+		else
+			openSet.insert(pair.first);
 	}
-#ifdef DEBUG_MODE
-	DebugGraph<InstructionWalker, bool> debugGraph("/tmp/vc4c-block-graph.dot", true);
-	auto nameFunc = [](const InstructionWalker& it) -> std::string {return const_cast<InstructionWalker&>(it).getBasicBlock()->getLabel()->getLabel()->name;};
-	auto weakLinkFunc = [](const bool b) -> bool {return b;};
-	for(const auto& node : graph)
+	while(!it.isEndOfMethod())
 	{
-		debugGraph.addNodeWithNeighbors(node.second, nameFunc, weakLinkFunc);
+		const intermediate::MoveOperation* move = it.get<intermediate::MoveOperation>();
+		if(move != nullptr && !it.has<intermediate::VectorRotation>() && move->getSource().hasType(ValueType::LOCAL) && move->hasValueType(ValueType::LOCAL) &&
+				move->conditional == COND_ALWAYS && !move->hasSideEffects() && !move->hasPackMode() && !move->hasUnpackMode())
+		{
+			copiedLocals[move->getSource().local].insert(move->getOutput().get().local);
+			copiedLocals[move->getOutput().get().local].insert(move->getSource().local);
+		}
+		it.nextInMethod();
 	}
-#endif
-	return graph;
 }
 
-static void walkUsageRange(InstructionWalker start, const Local* local, FastMap<intermediate::IntermediateInstruction*, FastSet<const Local*>>& localRanges, Graph<InstructionWalker, Node<InstructionWalker, bool>>* blockGraph = nullptr)
+static void walkUsageRange(InstructionWalker start, const Local* local, FastMap<intermediate::IntermediateInstruction*, FastSet<const Local*>>& localRanges, const analysis::ControlFlowGraph* cfg = nullptr)
 {
 	//to prevent infinite recursions
 	//TODO is tracking labels enough or need we track all instructions (or branches, since we jump backwards?)??
@@ -531,7 +710,7 @@ static void walkUsageRange(InstructionWalker start, const Local* local, FastMap<
 	};
 
 	InstructionVisitor visitor{consumer, false, true};
-	bool allFound = visitor.visitReverse(start, blockGraph);
+	bool allFound = visitor.visitReverse(start, cfg);
 
 	if(!allFound)
 	{
@@ -540,42 +719,76 @@ static void walkUsageRange(InstructionWalker start, const Local* local, FastMap<
 	}
 }
 
+static bool readsLocal(InstructionWalker it, const Local* local)
+{
+	bool isRead = false;
+	it.forAllInstructions([local, &isRead](const intermediate::IntermediateInstruction* instr)
+	{
+		if(instr->readsLocal(local))
+			isRead = true;
+	});
+	return isRead;
+}
+
+static bool isMappedToRegister(const Local* local, const LocalUsage& usage)
+{
+	//any local which is never used is added to the colored graph as a node without neighbors (since it has no influence to any neighbors)
+	//labels are not mapped to registers
+	return usage.firstOccurrence.get() != usage.lastOccurrence.get() && local->type != TYPE_LABEL;
+}
+
+/*
+ * Resets the node to the register-files of its usage.
+ *
+ * \return whether the local is mapped to a register at all
+ */
+static bool initializeNode(ColoredNode& node, const LocalUsage& usage, const std::size_t numPhysicalRegisters)
+{
+	if(!isMappedToRegister(node.key, usage))
+	{
+		if(node.key->type != TYPE_LABEL)
+			DEBUG_LOG("Local " << node.key->name << " is never read!" << logging::endl);
+		node.reset(RegisterFile::NONE, numPhysicalRegisters);
+		return false;
+	}
+	node.reset(usage.possibleFiles, numPhysicalRegisters);
+	return true;
+}
+
+/*
+ * Applies the register (file) the node is fixed to on its neighbor
+ */
+static void blockNeighbor(const ColoredNode& node, const std::size_t fixedRegister, ColoredNode& neighbor, const LocalRelation relation)
+{
+	if(relation == LocalRelation::USED_TOGETHER && (node.possibleFiles == RegisterFile::PHYSICAL_A || node.possibleFiles == RegisterFile::PHYSICAL_B))
+	{
+		neighbor.possibleFiles = remove_flag(neighbor.possibleFiles, node.possibleFiles);
+	}
+	else
+		neighbor.blockRegister(node.possibleFiles, fixedRegister);
+}
+
 void GraphColoring::createGraph()
 {
-	FastMap<intermediate::IntermediateInstruction*, FastSet<const Local*>> localRanges;
+	localRanges.clear();
 	localRanges.reserve(method.countInstructions());
 
 	// 1. iteration: set files and locals used together and map to start/end of range
 	PROFILE_START(createColoredNodes); //TODO too slow: 20s keccak
+	graph.reserve(localUses.size());
 	for(const auto& pair : localUses)
 	{
 		auto& node = graph.getOrCreateNode(pair.first);
-		node.possibleFiles = pair.second.possibleFiles;
-		node.initialFile = pair.second.possibleFiles;
-		if(pair.second.firstOccurrence.get() == pair.second.lastOccurrence.get())
-		{
-			logging::debug() << "Local " << pair.first->name << " is never read!" << logging::endl;
-			node.possibleFiles = RegisterFile::NONE;
-			node.initialFile = RegisterFile::NONE;
-			//any local which is never used is added to the colored graph
-			//as a node without neighbors (since it has no influence to any neighbors)
-			//so we also remove all reference from the closed or open locals
-			closedSet.erase(node.key);
-			openSet.erase(node.key);
-			continue;
-		}
-		if(pair.first->type == TYPE_LABEL)
+		if(!initializeNode(node, pair.second, numPhysicalRegisters))
 		{
-			node.possibleFiles = RegisterFile::NONE;
-			node.initialFile = RegisterFile::NONE;
-			//labels are not mapped to registers
+			//locals never read and labels are not colored, so we also remove all reference from the closed or open locals
 			closedSet.erase(node.key);
 			openSet.erase(node.key);
 			continue;
 		}
 		forLocalsUsedTogether(pair.first, [&node, this](const Local* l) -> void
 		{
-			node.addNeighbor(&(graph.getOrCreateNode(l)), LocalRelation::USED_TOGETHER);
+			graph.addNeighbor(node, graph.getOrCreateNode(l), LocalRelation::USED_TOGETHER);
 		});
 //		for(InstructionWalker it = pair.second.firstOccurrence; it.get() != pair.second.lastOccurrence.get(); it.nextInMethod())
 //		{
@@ -598,13 +811,15 @@ void GraphColoring::createGraph()
 //			}
 //			range.insert(pair.first);
 //		}
-		logging::debug() << "Created node: " << node.to_string() << logging::endl;
+		DEBUG_LOG("Created node: " << node.to_string() << logging::endl);
 	}
 	PROFILE_END(createColoredNodes);
 
-	PROFILE_START(createBlockGraph);
-	auto blockGraph = createBlockGraph(method);
-	PROFILE_END(createBlockGraph);
+	//the control-flow is not modified by the register-allocation, so the graph is only calculated once for all rounds
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	const Optional<std::string> blockGraphFile = getDebugGraphFile(method.getModule().compilationConfig, method.name, DEBUG_GRAPH_BLOCKS);
+	if(blockGraphFile)
+		cfg.dumpGraph(blockGraphFile.get(), method.getModule().compilationConfig.maxDebugGraphNodes);
 
 	PROFILE_START(createUsageRanges);
 	InstructionWalker it = method.walkAllInstructions();
@@ -613,11 +828,11 @@ void GraphColoring::createGraph()
 		//from all reading instructions, walk up to the writes of the locals and add all instructions in between to the local usage-range
 		if(!it.has<intermediate::BranchLabel>() && !it.has<intermediate::Branch>())
 		{
-			it->forUsedLocals([it, &localRanges, &blockGraph](const Local* local, LocalUser::Type usageType) -> void
+			it->forUsedLocals([it, this, &cfg](const Local* local, LocalUser::Type usageType) -> void
 			{
 				if(has_flag(usageType, LocalUser::Type::READER))
 				{
-					PROFILE(walkUsageRange, it, local, localRanges, &blockGraph);
+					PROFILE(walkUsageRange, it, local, localRanges, &cfg);
 				}
 			});
 		}
@@ -627,38 +842,89 @@ void GraphColoring::createGraph()
 	//TODO if this method works, could here spill all locals with more than XX (64) neighbors!?!
 	for(const auto& node : graph)
 	{
-		PROFILE_COUNTER(1000005, "SpillCandidates", node.second.getNeighbors().size() >= 64);
+		PROFILE_COUNTER(1000005, "SpillCandidates", graph.countNeighbors(node.second) >= 64);
 	}
 	//2. iteration: associate locals used together
 	PROFILE_START(addEdges); //TODO too slow: 24s for keccak (240s total)
+	std::vector<const ColoredNode*> rangeNodes;
 	for(const auto& range : localRanges)
 	{
-		for(const Local* loc1 : range.second)
+		rangeNodes.clear();
+		for(const Local* loc : range.second)
+			rangeNodes.push_back(&graph.at(loc));
+		for(const ColoredNode* node1 : rangeNodes)
 		{
-			ColoredNode& node = graph.at(loc1);
-			for(const Local* loc2 : range.second)
+			for(const ColoredNode* node2 : rangeNodes)
 			{
-				if(loc1 == loc2)
+				if(node1 == node2)
 					continue;
-				node.addNeighbor(&graph.at(loc2), LocalRelation::USED_SIMULTANEOUSLY);
+				graph.addNeighbor(*node1, *node2, LocalRelation::USED_SIMULTANEOUSLY);
 			}
 		}
 	}
 	PROFILE_END(addEdges);
 
-	logging::debug() << "Colored graph with " << graph.size() << " nodes created!" << logging::endl;
-#ifdef DEBUG_MODE
-	DebugGraph<Local*, LocalRelation> debugGraph("/tmp/vc4c-register-graph.dot");
-	const std::function<std::string(const Local* const&)> nameFunc = [](const Local* const& l) -> std::string {return l->name;};
-	const std::function<bool(const LocalRelation&)> weakEdgeFunc = [](const LocalRelation& r) -> bool {return r == LocalRelation::USED_TOGETHER;};
-	for(const auto& node : graph)
+	DEBUG_LOG("Colored graph with " << graph.size() << " nodes created!" << logging::endl);
+	const Optional<std::string> registerGraphFile = getDebugGraphFile(method.getModule().compilationConfig, method.name, DEBUG_GRAPH_REGISTERS);
+	if(registerGraphFile)
+	{
+		DebugGraph<const Local*> debugGraph(registerGraphFile.get(), method.getModule().compilationConfig.maxDebugGraphNodes);
+		const std::function<std::string(const Local* const&)> nameFunc = [](const Local* const& l) -> std::string {return l->name;};
+		const std::function<bool(const LocalRelation&)> weakEdgeFunc = [](const LocalRelation& r) -> bool {return r == LocalRelation::USED_TOGETHER;};
+		for(const auto& node : graph)
+		{
+			if(debugGraph.isFull())
+				break;
+			graph.forAllNeighbors(node.second, [&](const ColoredNode& neighbor, LocalRelation relation)
+			{
+				//print every edge just once
+				if(neighbor.id > node.second.id)
+					debugGraph.addEdge(node.first, neighbor.key, nameFunc, weakEdgeFunc(relation));
+			});
+		}
+	}
+}
+
+/*
+ * Returns the number of instructions between the first and the last use of the local,
+ * if all uses are located within a single basic block and not too far apart, SIZE_MAX otherwise
+ */
+static std::size_t getLiveRangeLength(const LocalUsage& usage)
+{
+	InstructionWalker it = usage.firstOccurrence;
+	for(std::size_t length = 0; length <= 4 * ACCUMULATOR_THRESHOLD_HINT && !it.isEndOfBlock(); ++length)
+	{
+		if(it.get() == usage.lastOccurrence.get())
+			return length;
+		it.nextInBlock();
+	}
+	return SIZE_MAX;
+}
+
+/*
+ * Returns the register of a local copied from or into the local of the node, if it is already fixed to a register, which is also available for the node.
+ * Assigning both locals to the same register turns the copy into a move to itself, which is removed by the code-generator
+ */
+static Register getCopiedRegister(const ColoredGraph& graph, const ColoredNode& node, const FastMap<const Local*, FastSet<const Local*>>& copiedLocals)
+{
+	auto copyIt = copiedLocals.find(node.key);
+	if(copyIt == copiedLocals.end())
+		return REG_NOP;
+	for(const Local* copy : copyIt->second)
 	{
-		debugGraph.addNodeWithNeighbors<ColoredNode>(node.second, nameFunc, weakEdgeFunc);
+		auto nodeIt = graph.find(copy);
+		if(nodeIt != graph.end() && nodeIt->second.isFixedToRegister())
+		{
+			const Register reg = nodeIt->second.getRegisterFixed();
+			if(node.isRegisterAvailable(reg))
+				return reg;
+		}
 	}
-#endif
+	return REG_NOP;
 }
 
-static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedSet, FastSet<const Local*>& openSet, FastSet<const Local*>& errorSet)
+static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedSet, FastSet<const Local*>& openSet, FastSet<const Local*>& errorSet,
+		const FastMap<const Local*, FastSet<const Local*>>& copiedLocals)
 {
 	PROFILE_START(processClosedSet);
 	while(!closedSet.empty())
@@ -666,7 +932,7 @@ static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedS
 		//for every entry in closed-set, remove fixed register from all used-together neighbors
 		//and decrement register-file for all other neighbors
 		if(graph.find(*closedSet.begin()) == graph.end())
-			logging::debug() << "1) Error getting local " << (*closedSet.begin())->name << " from graph" << logging::endl;
+			DEBUG_LOG("1) Error getting local " << (*closedSet.begin())->name << " from graph" << logging::endl);
 		auto& node = graph.at(*closedSet.begin());
 		if(node.possibleFiles == RegisterFile::NONE)
 		{
@@ -679,53 +945,173 @@ static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedS
 		}
 		else
 		{
-			const std::size_t fixedRegister = node.fixToRegister();
-			for(auto& pair : node.getNeighbors())
+			const std::size_t fixedRegister = node.fixToRegister(getCopiedRegister(graph, node, copiedLocals));
+			graph.forAllNeighbors(node, [&](ColoredNode& neighbor, LocalRelation relation)
 			{
-				ColoredNode* neighbor = reinterpret_cast<ColoredNode*>(pair.first);
-				if(pair.second == LocalRelation::USED_TOGETHER && (node.possibleFiles == RegisterFile::PHYSICAL_A || node.possibleFiles == RegisterFile::PHYSICAL_B))
-				{
-					neighbor->possibleFiles = remove_flag(neighbor->possibleFiles, node.possibleFiles);
-				}
-				else
-					neighbor->blockRegister(node.possibleFiles, fixedRegister);
-				if(isFixed(neighbor->possibleFiles) && openSet.find(pair.first->key) != openSet.end())
+				blockNeighbor(node, fixedRegister, neighbor, relation);
+				if(isFixed(neighbor.possibleFiles) && openSet.find(neighbor.key) != openSet.end())
 				{
-					openSet.erase(pair.first->key);
-					closedSet.insert(pair.first->key);
+					openSet.erase(neighbor.key);
+					closedSet.insert(neighbor.key);
 				}
-			}
+			});
 		}
 		closedSet.erase(node.key);
 	}
 	PROFILE_END(processClosedSet);
 }
 
+void GraphColoring::updateGraph()
+{
+	//the erroneous and modified locals and their neighbors are colored again, all other locals keep their registers
+	FastSet<const Local*> affectedLocals(modifiedLocals);
+	for(const Local* local : errorSet)
+	{
+		affectedLocals.insert(local);
+		graph.forAllNeighbors(graph.at(local), [&affectedLocals](const ColoredNode& neighbor, LocalRelation relation)
+		{
+			affectedLocals.insert(neighbor.key);
+		});
+	}
+	errorSet.clear();
+	openSet.clear();
+	closedSet.clear();
+
+	//1. re-calculate the usage-ranges of the modified locals
+	PROFILE_START(updateUsageRanges);
+	if(!modifiedLocals.empty())
+	{
+		for(auto& range : localRanges)
+		{
+			for(const Local* local : modifiedLocals)
+				range.second.erase(local);
+		}
+	}
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	for(const Local* local : modifiedLocals)
+	{
+		for(InstructionWalker it : localUses.at(local).associatedInstructions)
+		{
+			if(!it.has<intermediate::BranchLabel>() && !it.has<intermediate::Branch>() && readsLocal(it, local))
+				walkUsageRange(it, local, localRanges, &cfg);
+		}
+	}
+	PROFILE_END(updateUsageRanges);
+
+	//2. re-create the edges of the modified locals
+	PROFILE_START(updateEdges);
+	for(const Local* local : modifiedLocals)
+		graph.removeNeighbors(graph.getOrCreateNode(local));
+	//the edges for locals used together need to be added first, since they are not overridden by the other relation
+	for(const Local* local : modifiedLocals)
+	{
+		ColoredNode& node = graph.at(local);
+		if(!initializeNode(node, localUses.at(local), numPhysicalRegisters))
+			continue;
+		forLocalsUsedTogether(local, [&node, this](const Local* l) -> void
+		{
+			ColoredNode& neighbor = graph.getOrCreateNode(l);
+			graph.addNeighbor(node, neighbor, LocalRelation::USED_TOGETHER);
+			//the locals not mapped to registers have no edges to other locals
+			if(isMappedToRegister(l, localUses.at(l)))
+				graph.addNeighbor(neighbor, node, LocalRelation::USED_TOGETHER);
+		});
+	}
+	std::vector<const ColoredNode*> modifiedNodes;
+	for(const auto& range : localRanges)
+	{
+		modifiedNodes.clear();
+		for(const Local* loc : range.second)
+		{
+			if(modifiedLocals.find(loc) != modifiedLocals.end())
+				modifiedNodes.push_back(&graph.at(loc));
+		}
+		for(const ColoredNode* node : modifiedNodes)
+		{
+			for(const Local* loc : range.second)
+			{
+				const ColoredNode& neighbor = graph.at(loc);
+				if(node == &neighbor)
+					continue;
+				graph.addNeighbor(*node, neighbor, LocalRelation::USED_SIMULTANEOUSLY);
+				graph.addNeighbor(neighbor, *node, LocalRelation::USED_SIMULTANEOUSLY);
+			}
+		}
+	}
+	PROFILE_END(updateEdges);
+
+	//3. reset the affected locals and block the registers of their unaffected neighbors
+	PROFILE_START(resetAffectedNodes);
+	for(const Local* local : affectedLocals)
+	{
+		ColoredNode& node = graph.at(local);
+		const LocalUsage& usage = localUses.at(local);
+		if(!initializeNode(node, usage, numPhysicalRegisters))
+			continue;
+		graph.forAllReverseNeighbors(node, [&affectedLocals, &node](ColoredNode& neighbor, LocalRelation relation)
+		{
+			if(affectedLocals.find(neighbor.key) == affectedLocals.end() && isFixed(neighbor.possibleFiles) && neighbor.hasFreeRegisters(neighbor.possibleFiles))
+				blockNeighbor(neighbor, neighbor.fixToRegister(), node, relation);
+		});
+		if(isFixed(usage.possibleFiles))
+			closedSet.insert(local);
+		else if(usage.possibleFiles != RegisterFile::NONE)
+			openSet.insert(local);
+	}
+	PROFILE_END(resetAffectedNodes);
+	DEBUG_LOG("Updated register graph for " << modifiedLocals.size() << " modified locals, re-coloring " << affectedLocals.size() << " locals" << logging::endl);
+	modifiedLocals.clear();
+}
+
 bool GraphColoring::colorGraph()
 {
-	if(!graph.empty())
+	if(graph.empty())
+	{
+		PROFILE(createGraph);
+	}
+	else
 	{
-		PROFILE(resetGraph);
+		PROFILE(updateGraph);
 	}
-	PROFILE(createGraph);
 
 	//process all nodes fixed initially to a register-file
-	processClosedSet(graph, closedSet, openSet, errorSet);
+	processClosedSet(graph, closedSet, openSet, errorSet, copiedLocals);
+
+	//the locals are assigned in the order of the length of their live-ranges, so the shortest-living locals get the accumulators
+	//and the long-living locals are moved to the physical files, which leaves the accumulators free for the temporary values
+	std::vector<std::pair<std::size_t, const Local*>> openLocals;
+	openLocals.reserve(openSet.size());
+	for(const Local* local : openSet)
+		openLocals.emplace_back(getLiveRangeLength(localUses.at(local)), local);
+	std::stable_sort(openLocals.begin(), openLocals.end(), [](const std::pair<std::size_t, const Local*>& p1, const std::pair<std::size_t, const Local*>& p2) -> bool
+	{
+		return p1.first < p2.first;
+	});
 
-	while(!openSet.empty())
+	for(const auto& pair : openLocals)
 	{
-		//for every node in the open-set, assign to accumulator if possible, assign to the first available register-file otherwise
-		//and update all neighbors
-		if(graph.find(*openSet.begin()) == graph.end())
-			logging::debug() << "3) Error getting local " << (*openSet.begin())->name << " from graph" << logging::endl;
-		auto& node = graph.at(*openSet.begin());
+		//the local might already have been fixed by assigning one of its neighbors
+		if(openSet.find(pair.second) == openSet.end())
+			continue;
+		//for every node in the open-set, assign short-living locals to accumulator if possible,
+		//assign to the first available register-file otherwise and update all neighbors
+		if(graph.find(pair.second) == graph.end())
+			DEBUG_LOG("3) Error getting local " << pair.second->name << " from graph" << logging::endl);
+		auto& node = graph.at(pair.second);
+		const bool preferAccumulator = pair.first <= ACCUMULATOR_THRESHOLD_HINT;
 		RegisterFile currentFile = RegisterFile::NONE;
-		if(has_flag(node.possibleFiles, RegisterFile::ACCUMULATOR))
+		const Register copiedRegister = getCopiedRegister(graph, node, copiedLocals);
+		if(copiedRegister != REG_NOP)
+			//use the same register as the local copied from/into, to remove the copy
+			currentFile = copiedRegister.file;
+		else if(preferAccumulator && has_flag(node.possibleFiles, RegisterFile::ACCUMULATOR))
 			currentFile = RegisterFile::ACCUMULATOR;
 		else if(has_flag(node.possibleFiles, RegisterFile::PHYSICAL_A))
 			currentFile = RegisterFile::PHYSICAL_A;
 		else if(has_flag(node.possibleFiles, RegisterFile::PHYSICAL_B))
 			currentFile = RegisterFile::PHYSICAL_B;
+		else if(has_flag(node.possibleFiles, RegisterFile::ACCUMULATOR))
+			currentFile = RegisterFile::ACCUMULATOR;
 		else
 		{
 			errorSet.insert(node.key);
@@ -735,7 +1121,7 @@ bool GraphColoring::colorGraph()
 		node.possibleFiles = currentFile;
 		closedSet.insert(node.key);
 		openSet.erase(node.key);
-		processClosedSet(graph, closedSet, openSet, errorSet);
+		processClosedSet(graph, closedSet, openSet, errorSet, copiedLocals);
 	}
 
 	return errorSet.empty();
@@ -761,21 +1147,19 @@ static RegisterFile getBlockedInputs(const InstructionWalker it, const ColoredGr
 	return blockedFiles;
 }
 
-static LocalUse checkUser(const OrderedMap<const LocalUser*, LocalUse>& users, const InstructionWalker it)
+static LocalUse checkUser(const UserList& users, const InstructionWalker it)
 {
 	LocalUse use;
 	it.forAllInstructions([&users, &use](const intermediate::IntermediateInstruction* instr)
 	{
-		if(users.find(instr) != users.end())
-		{
-			use.numReads += users.at(instr).numReads;
-			use.numWrites += users.at(instr).numWrites;
-		}
+		const LocalUse instrUse = users.at(instr);
+		use.numReads += instrUse.numReads;
+		use.numWrites += instrUse.numWrites;
 	});
 	return use;
 }
 
-static LocalUse assertUser(const OrderedMap<const LocalUser*, LocalUse>& users, const InstructionWalker it)
+static LocalUse assertUser(const UserList& users, const InstructionWalker it)
 {
 	auto use = checkUser(users, it);
 	if(!use.readsLocal() && !use.writesLocal())
@@ -787,22 +1171,37 @@ static LocalUse assertUser(const OrderedMap<const LocalUser*, LocalUse>& users,
 
 static bool reassignNodeToRegister(ColoredGraph& graph, ColoredNode& node)
 {
-	for(const auto& pair : node.getNeighbors())
+	graph.forAllNeighbors(node, [&node](ColoredNode& neighbor, LocalRelation relation)
 	{
-		ColoredNode* neighbor = reinterpret_cast<ColoredNode*>(pair.first);
-		if(pair.second == LocalRelation::USED_TOGETHER && (neighbor->possibleFiles == RegisterFile::PHYSICAL_A || neighbor->possibleFiles == RegisterFile::PHYSICAL_B))
+		if(relation == LocalRelation::USED_TOGETHER && (neighbor.possibleFiles == RegisterFile::PHYSICAL_A || neighbor.possibleFiles == RegisterFile::PHYSICAL_B))
 		{
-			node.possibleFiles = remove_flag(node.possibleFiles, neighbor->possibleFiles);
+			node.possibleFiles = remove_flag(node.possibleFiles, neighbor.possibleFiles);
 		}
-		else if(isFixed(neighbor->possibleFiles)&& neighbor->hasFreeRegisters(neighbor->possibleFiles))	//if the neighbor is a temporary introduced by this fix, it may not yet be fixed to a register-file
-			node.blockRegister(neighbor->possibleFiles, neighbor->fixToRegister());
-	}
+		else if(isFixed(neighbor.possibleFiles)&& neighbor.hasFreeRegisters(neighbor.possibleFiles))	//if the neighbor is a temporary introduced by this fix, it may not yet be fixed to a register-file
+			node.blockRegister(neighbor.possibleFiles, neighbor.fixToRegister());
+	});
 	bool fixed = isFixed(node.possibleFiles) && node.hasFreeRegisters(node.possibleFiles) && node.fixToRegister() != SIZE_MAX;
 	PROFILE_COUNTER(1000040, "reassignNodeToRegister", fixed);
 	return fixed;
 }
 
-static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, ColoredNode& node, FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse, const RegisterFile file)
+/*
+ * Returns the instructions in the order of the method, so fixing the errors (which inserts instructions and creates new locals) does not depend on the addresses of the instructions
+ */
+static std::vector<InstructionWalker> toMethodOrder(Method& method, const FastSet<InstructionWalker>& instructions)
+{
+	std::vector<InstructionWalker> result;
+	result.reserve(instructions.size());
+	for(InstructionWalker it = method.walkAllInstructions(); !it.isEndOfMethod() && result.size() < instructions.size(); it.nextInMethod())
+	{
+		if(instructions.find(it) != instructions.end())
+			result.push_back(it);
+	}
+	return result;
+}
+
+static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, ColoredNode& node, FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse, const RegisterFile file,
+		FastMap<intermediate::IntermediateInstruction*, FastSet<const Local*>>& localRanges, FastSet<const Local*>& modifiedLocals)
 {
 	bool needNextRound = false;
 	const auto& users = node.key->getUsers();
@@ -810,7 +1209,7 @@ static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, Colored
 	//this might strain the accumulators, which can be fixed by the next iteration in CASE 1)
 
 	//we need to copy the associated instructions, since we modify the collection
-	const FastSet<InstructionWalker> copy(localUse.associatedInstructions);
+	const std::vector<InstructionWalker> copy = toMethodOrder(method, localUse.associatedInstructions);
 	for(InstructionWalker it : copy)
 	{
 		//1) check if instruction reads this local
@@ -832,10 +1231,26 @@ static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, Colored
 		}
 		//3) insert move to temporary and use temporary as input to instruction
 		const Value tmp = method.addNewLocal(node.key->type, "%register_fix");
-		logging::debug() << "Fixing register-conflict by using temporary as input for: " << it->to_string() << logging::endl;
+		DEBUG_LOG("Fixing register-conflict by using temporary as input for: " << it->to_string() << logging::endl);
 		it.emplace(new intermediate::MoveOperation(tmp, node.key->createReference()));
-		auto tmpUse = localUses.emplace(tmp.local, LocalUsage(it, it)).first->second;
+		auto& tmpUse = localUses.emplace(tmp.local, LocalUsage(it, it)).first->second;
 		it.nextInBlock();
+		//the locals live while the instruction is executed (or read by it) are also live during the inserted move
+		FastSet<const Local*> moveRange;
+		if(localRanges.find(it.get()) != localRanges.end())
+			moveRange = localRanges.at(it.get());
+		it.forAllInstructions([&moveRange, &modifiedLocals](const intermediate::IntermediateInstruction* instr)
+		{
+			instr->forUsedLocals([&moveRange, &modifiedLocals](const Local* local, LocalUser::Type type)
+			{
+				//all locals used by the instruction (including the replaced one) change their relation to the others
+				modifiedLocals.insert(local);
+				if(has_flag(type, LocalUser::Type::READER))
+					moveRange.insert(local);
+			});
+		});
+		localRanges[tmpUse.firstOccurrence.get()] = std::move(moveRange);
+		modifiedLocals.insert(tmp.local);
 		it->replaceLocal(node.key, tmp.local, LocalUser::Type::READER);
 		//4) add temporary to graph (and local usage) with same blocked registers as local, but accumulator as file (since it is read in the next instruction)
 		tmpUse.possibleFiles = RegisterFile::ACCUMULATOR;
@@ -851,15 +1266,16 @@ static bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, Colored
 		localUse.associatedInstructions.erase(it);
 		localUse.associatedInstructions.insert(tmpUse.firstOccurrence);
 		//TODO or always force a re-creation of the graph ?? Could remove all setting/updating of graph-nodes
-		auto tmpNode = graph.emplace(tmp.local, ColoredNode(tmp.local, RegisterFile::ACCUMULATOR)).first->second;
+		auto& tmpNode = graph.getOrCreateNode(tmp.local, RegisterFile::ACCUMULATOR);
 		//XXX setting the neighbors of the temporary to the neighbors of the local actually is far too broad, but we cannot determine the actual neighbors
 		tmpNode.takeValues(node);
+		graph.copyNeighbors(node, tmpNode);
 		//TODO need to update the local used in the current instruction as input with the new temporary
-		for(auto& pair : node.getNeighbors())
+		graph.forAllNeighbors(node, [&graph, &tmpNode](const ColoredNode& neighbor, LocalRelation relation)
 		{
-			pair.first->addNeighbor(&tmpNode, LocalRelation::USED_SIMULTANEOUSLY);
-		}
-		if(!reassignNodeToRegister(graph, graph.at(tmp.local)))
+			graph.addNeighbor(neighbor, tmpNode, LocalRelation::USED_SIMULTANEOUSLY);
+		});
+		if(!reassignNodeToRegister(graph, tmpNode))
 			needNextRound = true;
 	}
 	//5) update available files of local
@@ -874,7 +1290,8 @@ static bool blocksLocal(const ColoredNode* neighbor, LocalRelation relation)
 	return relation == LocalRelation::USED_TOGETHER && isFixed(neighbor->possibleFiles) && !has_flag(neighbor->possibleFiles, RegisterFile::ACCUMULATOR);
 }
 
-static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& node, FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse)
+static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& node, FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse,
+		FastMap<intermediate::IntermediateInstruction*, FastSet<const Local*>>& localRanges, FastSet<const Local*>& modifiedLocals)
 {
 	/*
 	 * The following cases can occur:
@@ -905,9 +1322,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 	 *   - need to make sure, copy is written to when the main local is written!
 	 */
 
-	//TODO if we only use fixes which do not change the graph (don't insert new locals)
-	//we could skip re-creating the whole graph and simply try to assign a register to the node
-	//by re-checking which registers are not used by any neighbor
+	//NOTE: all locals whose uses are changed by a fix need to be added to the modified locals, so their edges are updated before the next round
 
 	const auto& users = node.key->getUsers();
 
@@ -915,13 +1330,13 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 	if(node.initialFile == RegisterFile::ACCUMULATOR && !node.hasFreeRegisters(RegisterFile::ACCUMULATOR))
 	{
 		//fix read-after-writes, so local can be on non-accumulator:
-		logging::debug() << "Fixing register error case 1 for: " << node.key->to_string() << logging::endl;
+		DEBUG_LOG("Fixing register error case 1 for: " << node.key->to_string() << logging::endl);
 		PROFILE_COUNTER(1000010, "Register error case 1", 1);
 
 		//the register-files which can be used after the fix by this local
 		RegisterFile freeFiles = remove_flag(RegisterFile::ANY, localUses.at(node.key).blockedFiles);
 
-		for(InstructionWalker it : localUse.associatedInstructions)
+		for(InstructionWalker it : toMethodOrder(method, localUse.associatedInstructions))
 		{
 			//1) check if usage is a write
 			if(assertUser(users, it).writesLocal())
@@ -937,7 +1352,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 				//3) if so, insert nop
 				if(localRead)
 				{
-					logging::debug() << "Fixing register-conflict by inserting NOP before: " << it->to_string() << logging::endl;
+					DEBUG_LOG("Fixing register-conflict by inserting NOP before: " << it->to_string() << logging::endl);
 					it.emplace(new intermediate::Nop(intermediate::DelayType::WAIT_REGISTER));
 					PROFILE_COUNTER(1000011, "NOP insertions", 1);
 				}
@@ -963,7 +1378,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 		//-> insert a new temporary to be used instead of this local as parameter for all instructions,
 		// this local is used together with another local fixed to a physical file
 		//-> or, if blocking local is in other combined instruction, split up instructions
-		logging::debug() << "Fixing register error case 2 for: " << node.key->to_string() << logging::endl;
+		DEBUG_LOG("Fixing register error case 2 for: " << node.key->to_string() << logging::endl);
 		PROFILE_COUNTER(1000020, "Register error case 2", 1);
 
 		bool fileACouldBeUsed = has_flag(node.initialFile, RegisterFile::PHYSICAL_A) && node.hasFreeRegisters(RegisterFile::PHYSICAL_A);
@@ -1019,8 +1434,8 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 					{
 						if(arg.hasType(ValueType::LOCAL))
 						{
-							ColoredNode* neighbor = reinterpret_cast<ColoredNode*>(&graph.assertNode(arg.local));
-							if(blocksLocal(neighbor, node.getNeighbors().at(neighbor)))
+							ColoredNode* neighbor = &graph.assertNode(arg.local);
+							if(blocksLocal(neighbor, graph.getRelation(node, *neighbor)))
 							{
 								splitCombined = true;
 								break;
@@ -1030,8 +1445,8 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 				}
 				else if((usedInOp1 ? op->op2 : op->op1)->hasValueType(ValueType::LOCAL))
 				{
-					ColoredNode* neighbor = reinterpret_cast<ColoredNode*>(&graph.assertNode((usedInOp1 ? op->op2 : op->op1)->getOutput().get().local));
-					if(blocksLocal(neighbor, node.getNeighbors().at(neighbor)))
+					ColoredNode* neighbor = &graph.assertNode((usedInOp1 ? op->op2 : op->op1)->getOutput().get().local);
+					if(blocksLocal(neighbor, graph.getRelation(node, *neighbor)))
 					{
 						splitCombined = true;
 					}
@@ -1039,7 +1454,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 			}
 			if(splitCombined)
 			{
-				logging::debug() << "Fixing register conflict by splitting combined operation: " << op->to_string() << logging::endl;
+				DEBUG_LOG("Fixing register conflict by splitting combined operation: " << op->to_string() << logging::endl);
 				localUse.associatedInstructions.erase(use);
 				if(usedInOp1)
 				{
@@ -1062,12 +1477,12 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 		*/
 		//TODO need to update blocked files for split combinations
 
-		logging::debug() << "Trying to fix local to register-file " << toString(add_flag(fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::NONE, fileBCouldBeUsed ? RegisterFile::PHYSICAL_B : RegisterFile::NONE)) << logging::endl;
+		DEBUG_LOG("Trying to fix local to register-file " << toString(add_flag(fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::NONE, fileBCouldBeUsed ? RegisterFile::PHYSICAL_B : RegisterFile::NONE)) << logging::endl);
 
 		if(!has_flag(localUses.at(node.key).blockedFiles, RegisterFile::ACCUMULATOR))
 		{
 			//the "easier" solution is to copy the local into an accumulator before each use, where it conflicts with other inputs
-			return moveLocalToRegisterFile(method, graph, node, localUses, localUse, fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B);
+			return moveLocalToRegisterFile(method, graph, node, localUses, localUse, fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, localRanges, modifiedLocals);
 		}
 		else
 		{
@@ -1086,7 +1501,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 	{
 		//for any of the possible files, there are no more free registers to assign
 		//so we need to copy the local to a temporary before every use, so it can be mapped to the other file
-		logging::debug() << "Fixing register error case 3 for: " << node.key->to_string() << logging::endl;
+		DEBUG_LOG("Fixing register error case 3 for: " << node.key->to_string() << logging::endl);
 		PROFILE_COUNTER(1000030, "Register error case 3", 1);
 
 		bool moveToFileA = node.hasFreeRegisters(RegisterFile::PHYSICAL_A);
@@ -1102,13 +1517,12 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 		}
 		else if(!moveToFileA && !moveToFileB)
 		{
-			//there are no more free register AT ALL
-			//since we do not spill, we can only about
-			logging::error() << "Local " << node.key->to_string() << " cannot be assigned to ANY register, aborting!" << logging::endl;
-			throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Failed to assign local to ANY register", node.key->to_string());
+			//there are no more free register AT ALL, this can only be fixed by spilling
+			DEBUG_LOG("Local " << node.key->to_string() << " cannot be assigned to ANY register" << logging::endl);
+			return false;
 		}
 
-		logging::debug() << "Trying to fix local to register-file " << toString(add_flag(moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::NONE, moveToFileB ? RegisterFile::PHYSICAL_B : RegisterFile::NONE)) << logging::endl;
+		DEBUG_LOG("Trying to fix local to register-file " << toString(add_flag(moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::NONE, moveToFileB ? RegisterFile::PHYSICAL_B : RegisterFile::NONE)) << logging::endl);
 
 		if(has_flag(localUses.at(node.key).blockedFiles, RegisterFile::ACCUMULATOR))
 		{
@@ -1116,7 +1530,7 @@ static bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& nod
 			throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Cannot fix register-conflict with local used as packed input", node.key->to_string());
 		}
 
-		return moveLocalToRegisterFile(method, graph, node, localUses, localUse, moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B);
+		return moveLocalToRegisterFile(method, graph, node, localUses, localUse, moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, localRanges, modifiedLocals);
 	}
 	else
 		throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Unhandled conflict in register-mapping node", node.to_string());
@@ -1129,67 +1543,350 @@ bool GraphColoring::fixErrors()
 	PROFILE_START(fixRegisterErrors);
 	for(const auto& node : graph)
 	{
-		logging::debug() << node.second.to_string() << logging::endl;
+		DEBUG_LOG(node.second.to_string() << logging::endl);
 	}
 
 	bool allFixed = true;
 	for(const Local* local : errorSet)
 	{
 		ColoredNode& node = graph.at(local);
-		logging::debug() << "Error in register-allocation for node: " << node.to_string() << logging::endl;
-		auto& s = logging::debug() << "Local is blocked by: ";
-		for(const auto& pair : node.getNeighbors())
+		DEBUG_LOG("Error in register-allocation for node: " << node.to_string() << logging::endl);
+		if(isLogged(LogLevel::DEBUG))
 		{
-			ColoredNode* neighbor = reinterpret_cast<ColoredNode*>(pair.first);
-			if(blocksLocal(neighbor, pair.second))
-				s << neighbor->to_string() << ", ";
+			auto& s = logging::debug() << "Local is blocked by: ";
+			graph.forAllNeighbors(node, [&s](const ColoredNode& neighbor, LocalRelation relation)
+			{
+				if(blocksLocal(&neighbor, relation))
+					s << neighbor.to_string() << ", ";
+			});
+			s << logging::endl;
 		}
-		s << logging::endl;
-		if(!fixSingleError(method, graph, node, localUses, localUses.at(local)))
+		if(!fixSingleError(method, graph, node, localUses, localUses.at(local), localRanges, modifiedLocals))
 			allFixed = false;
 	}
 	PROFILE_END(fixRegisterErrors);
 	return allFixed;
 }
 
-FastMap<const Local*, Register> GraphColoring::toRegisterMap() const
+static bool isShortLiving(const LocalUsage& usage)
 {
-	if(!errorSet.empty())
+	//spilling a local used only within a few instructions does not lower the register pressure, since the reloaded temporaries live just as long
+	InstructionWalker it = usage.firstOccurrence;
+	for(unsigned i = 0; i < 4 && !it.isEndOfBlock(); ++i)
 	{
-		for(const Local* loc : errorSet)
-			logging::error() << "Error assigning local to register: " << loc->name << logging::endl;
-		throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "There are erroneous register-associations!");
+		if(it.get() == usage.lastOccurrence.get())
+			return true;
+		it.nextInBlock();
 	}
+	return false;
+}
 
-	UnorderedMap<const Local*, Register> result;
+static bool isSpillable(const Local* local, const LocalUsage& usage)
+{
+	if(isShortLiving(usage))
+		return false;
+	bool isSupported = true;
+	for(InstructionWalker it : usage.associatedInstructions)
+	{
+		it.forAllInstructions([local, &isSupported](const intermediate::IntermediateInstruction* instr)
+		{
+			//the temporaries are accessed in the instructions next to the VPM access and are therefore located in accumulators, which cannot be (un)packed
+			if((instr->readsLocal(local) && instr->hasUnpackMode()) || (instr->writesLocal(local) && instr->hasPackMode()))
+				isSupported = false;
+		});
+	}
+	return isSupported;
+}
 
-	for(const auto& pair : graph)
+static double calculateSpillCost(const ColoredGraph& graph, const ColoredNode& node, const LocalUsage& usage, const FastMap<const BasicBlock*, double>& blockWeights)
+{
+	double weightedUses = 0;
+	for(InstructionWalker it : usage.associatedInstructions)
 	{
-		result.emplace(pair.first, pair.second.getRegisterFixed());
-		logging::debug() << "Assigned local " << pair.first->name << " to register " << result.at(pair.first).to_string(true, false) << logging::endl;
+		const auto weight = blockWeights.find(it.getBasicBlock());
+		weightedUses += weight == blockWeights.end() ? 1.0 : weight->second;
 	}
+	return weightedUses / static_cast<double>(std::max<std::size_t>(graph.countNeighbors(node), 1));
+}
 
-	return result;
+bool GraphColoring::spillLocals()
+{
+	FastMap<const BasicBlock*, unsigned> loopDepths;
+	for(const analysis::Loop& loop : method.getAnalyses().getLoops().getLoops())
+	{
+		for(const BasicBlock* block : loop.blocks)
+			++loopDepths[block];
+	}
+	//the uses are weighted by the executions of their blocks per kernel execution, as measured by the block-profile (see Configuration#blockProfile) or estimated from the loop depth
+	FastMap<const BasicBlock*, double> blockWeights;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		const Optional<double> frequency = optimizations::getRelativeFrequency(method, block, method.getModule().compilationConfig);
+		const auto depth = loopDepths.find(&block);
+		blockWeights.emplace(&block, frequency ? frequency.get() : std::pow(10.0, depth == loopDepths.end() ? 0 : depth->second));
+	}
+
+	//1. select the locals to spill
+	FastSet<const Local*> selectedLocals;
+	for(const Local* local : errorSet)
+	{
+		const ColoredNode& node = graph.at(local);
+		std::vector<const Local*> candidates{local};
+		graph.forAllNeighbors(node, [&candidates](const ColoredNode& neighbor, LocalRelation relation)
+		{
+			candidates.push_back(neighbor.key);
+		});
+		if(std::any_of(candidates.begin(), candidates.end(), [&selectedLocals](const Local* candidate) -> bool { return selectedLocals.find(candidate) != selectedLocals.end(); }))
+			//the conflict is already resolved by spilling a local selected for another conflict
+			continue;
+		const Local* cheapestLocal = nullptr;
+		double lowestCost = 0;
+		for(const Local* candidate : candidates)
+		{
+			const auto usage = localUses.find(candidate);
+			if(usage == localUses.end() || !isSpillable(candidate, usage->second))
+				continue;
+			const double cost = calculateSpillCost(graph, graph.at(candidate), usage->second, blockWeights);
+			if(cheapestLocal == nullptr || cost < lowestCost)
+			{
+				cheapestLocal = candidate;
+				lowestCost = cost;
+			}
+		}
+		if(cheapestLocal != nullptr)
+		{
+			DEBUG_LOG("Selected local for spilling: " << cheapestLocal->to_string() << " (cost " << lowestCost << ")" << logging::endl);
+			selectedLocals.insert(cheapestLocal);
+		}
+	}
+
+	//2. reserve one VPM row per QPU for every spilled local, the locals not interfering with each other are never live at the same time and share the same rows
+	periphery::VPMPlanner planner(*method.vpm, periphery::VPMUsage::REGISTER_SPILLING);
+	for(const Local* local : selectedLocals)
+	{
+		planner.addDemand(local, periphery::VPM_ROW_SIZE, 1.0);
+		const auto addConflict = [&planner, &selectedLocals, local](const ColoredNode& neighbor, LocalRelation relation) -> void
+		{
+			if(selectedLocals.find(neighbor.key) != selectedLocals.end())
+				planner.addConflict(local, neighbor.key);
+		};
+		graph.forAllNeighbors(graph.at(local), addConflict);
+		graph.forAllReverseNeighbors(graph.at(local), addConflict);
+	}
+	const FastMap<const Local*, const periphery::VPMArea*> areas = planner.allocate();
+	FastMap<const Local*, const periphery::VPMArea*> spilledLocals;
+	for(const Local* local : selectedLocals)
+	{
+		auto it = areas.find(local);
+		//the generic VPM setups can only address the first 64 rows
+		if(it == areas.end() || it->second->baseOffset / periphery::VPM_ROW_SIZE + NUM_QPUS > 64)
+		{
+			DEBUG_LOG("Not enough VPM space left to spill: " << local->to_string() << logging::endl);
+			continue;
+		}
+		spilledLocals.emplace(local, it->second);
+	}
+	if(spilledLocals.empty())
+		return false;
+
+	//3. replace every use with a temporary, which is reloaded before and spilled after the instruction
+	for(InstructionWalker it = method.walkAllInstructions(); !it.isEndOfMethod(); it.nextInMethod())
+	{
+		if(it.get() == nullptr || it.has<intermediate::Branch>() || it.has<intermediate::BranchLabel>())
+			continue;
+		bool isReloaded = false;
+		std::vector<std::pair<Value, const periphery::VPMArea*>> spilledValues;
+		for(const auto& pair : spilledLocals)
+		{
+			bool readsLocal = false;
+			bool writesLocal = false;
+			bool writesConditionally = false;
+			it.forAllInstructions([&](const intermediate::IntermediateInstruction* instr)
+			{
+				readsLocal = readsLocal || instr->readsLocal(pair.first);
+				if(instr->writesLocal(pair.first))
+				{
+					writesLocal = true;
+					writesConditionally = writesConditionally || instr->hasConditionalExecution();
+				}
+			});
+			if(!readsLocal && !writesLocal)
+				continue;
+			const Value tmp = method.addNewLocal(pair.first->type, "%spill");
+			//a conditional write only overwrites some of the elements, so the others need to be reloaded too
+			if(readsLocal || writesConditionally)
+			{
+				it = method.vpm->insertReloadRegister(method, it, tmp, *pair.second);
+				isReloaded = true;
+			}
+			it->replaceLocal(pair.first, tmp.local, LocalUser::Type::BOTH);
+			if(writesLocal)
+				spilledValues.emplace_back(tmp, pair.second);
+		}
+		if(isReloaded && it.has<intermediate::VectorRotation>())
+		{
+			//a vector-rotation of an accumulator cannot follow an instruction writing to that accumulator
+			it.emplace(new intermediate::Nop(intermediate::DelayType::WAIT_REGISTER));
+			it.nextInBlock();
+		}
+		if(!spilledValues.empty())
+		{
+			it.nextInBlock();
+			for(const auto& spill : spilledValues)
+				it = method.vpm->insertSpillRegister(method, it, spill.first, *spill.second);
+			//continue with the last inserted instruction, which does not access any spilled local
+			it.previousInBlock();
+		}
+	}
+	DEBUG_LOG("Spilled " << spilledLocals.size() << " locals into the VPM" << logging::endl);
+	return true;
 }
 
-void GraphColoring::resetGraph()
+/*
+ * Creates a copy of the instruction writing the local, if it can be cheaply re-calculated before every use instead of keeping its value alive
+ */
+static intermediate::IntermediateInstruction* createRematerialization(const Method& method, const intermediate::IntermediateInstruction* writer, const Value& dest)
 {
-	//reset the graph and the closed- and open sets
-	openSet.clear();
-	closedSet.clear();
-	errorSet.clear();
-	graph.clear();
-	for(const auto& pair : localUses)
+	//the constants passed as UNIFORMs can be loaded again at their uses, the UNIFORM is still read by the writer (see Method#uniformConstants)
+	for(const auto& constant : method.uniformConstants)
+		if(writer->hasValueType(ValueType::LOCAL) && constant.first == writer->getOutput().get().local)
+			return new intermediate::LoadImmediate(dest, Literal(static_cast<long>(constant.second)));
+	if(writer->hasConditionalExecution() || writer->hasSideEffects() || writer->hasPackMode() || writer->hasUnpackMode())
+		return nullptr;
+	if(writer->is<intermediate::LoadImmediate>())
 	{
-		if(isFixed(pair.second.possibleFiles))
+		const intermediate::LoadImmediate* load = dynamic_cast<const intermediate::LoadImmediate*>(writer);
+		return (new intermediate::LoadImmediate(dest, load->getImmediate(), load->type))->copyExtrasFrom(writer);
+	}
+	const intermediate::MoveOperation* move = dynamic_cast<const intermediate::MoveOperation*>(writer);
+	if(move != nullptr && !move->is<intermediate::VectorRotation>())
+	{
+		const Value source = move->getSource();
+		if(source.isLiteralValue() || source.hasRegister(REG_ELEMENT_NUMBER) || source.hasRegister(REG_QPU_NUMBER))
+			return (new intermediate::MoveOperation(dest, source))->copyExtrasFrom(writer);
+	}
+	return nullptr;
+}
+
+bool GraphColoring::splitLiveRanges()
+{
+	//1. select the long-living locals written just once, which conflict with the locals which could not be assigned to a register
+	FastSet<const Local*> candidates;
+	for(const Local* local : errorSet)
+	{
+		candidates.insert(local);
+		graph.forAllNeighbors(graph.at(local), [&candidates](const ColoredNode& neighbor, LocalRelation relation)
 		{
-			// local is fixed to a certain register-file, move to closed set
-			closedSet.insert(pair.first);
+			candidates.insert(neighbor.key);
+		});
+	}
+	//the locals to rematerialize with the instruction writing them
+	FastMap<const Local*, InstructionWalker> rematerializedLocals;
+	//the locals to split with the block they are written in
+	FastMap<const Local*, const BasicBlock*> splitLocals;
+	for(const Local* local : candidates)
+	{
+		const auto usage = localUses.find(local);
+		if(usage == localUses.end() || !isMappedToRegister(local, usage->second) || isShortLiving(usage->second))
+			continue;
+		const LocalUser* writer = local->getSingleWriter();
+		if(writer == nullptr)
+			continue;
+		//the write needs to be a separate instruction (e.g. not part of a combined operation), so it can be removed
+		const auto writerIt = std::find_if(usage->second.associatedInstructions.begin(), usage->second.associatedInstructions.end(),
+				[writer](const InstructionWalker& it) -> bool { return it.get() == writer; });
+		if(writerIt == usage->second.associatedInstructions.end())
+			continue;
+		std::unique_ptr<intermediate::IntermediateInstruction> rematerialization(createRematerialization(method, writerIt->get(), local->createReference()));
+		if(rematerialization)
+			rematerializedLocals.emplace(local, *writerIt);
+		else if(!writerIt->get()->hasConditionalExecution())
+			splitLocals.emplace(local, InstructionWalker(*writerIt).getBasicBlock());
+	}
+	if(rematerializedLocals.empty() && splitLocals.empty())
+		return false;
+
+	//2. replace the uses of the locals with the rematerialized values or the copies for the current block
+	//the copies of the split locals per block
+	FastMap<const BasicBlock*, FastMap<const Local*, Value>> blockCopies;
+	std::size_t numCopies = 0;
+	for(InstructionWalker it = method.walkAllInstructions(); !it.isEndOfMethod(); it.nextInMethod())
+	{
+		if(it.get() == nullptr || it.has<intermediate::Branch>() || it.has<intermediate::BranchLabel>())
+			continue;
+		bool isRewritten = false;
+		for(const auto& pair : rematerializedLocals)
+		{
+			if(it.get() == pair.second.get() || !readsLocal(it, pair.first))
+				continue;
+			const Value tmp = method.addNewLocal(pair.first->type, "%remat");
+			it.emplace(createRematerialization(method, pair.second.get(), tmp));
+			it.nextInBlock();
+			it->replaceLocal(pair.first, tmp.local, LocalUser::Type::READER);
+			isRewritten = true;
 		}
-		else if(pair.second.possibleFiles != RegisterFile::NONE)
+		BasicBlock* block = it.getBasicBlock();
+		for(const auto& pair : splitLocals)
 		{
-			//first use of local (initialization), add to open-set
-			openSet.insert(pair.first);
+			if(pair.second == block || !readsLocal(it, pair.first))
+				continue;
+			auto& copies = blockCopies[block];
+			auto copyIt = copies.find(pair.first);
+			if(copyIt == copies.end())
+			{
+				const Value copy = method.addNewLocal(pair.first->type, "%split");
+				//insert the copy directly after the label of the block
+				InstructionWalker pos = block->begin().nextInBlock();
+				if(pos.get() == it.get())
+					isRewritten = true;
+				pos.emplace(new intermediate::MoveOperation(copy, pair.first->createReference()));
+				copyIt = copies.emplace(pair.first, copy).first;
+				++numCopies;
+			}
+			it->replaceLocal(pair.first, copyIt->second.local, LocalUser::Type::READER);
 		}
+		if(isRewritten && it.has<intermediate::VectorRotation>())
+		{
+			//a vector-rotation of an accumulator cannot follow an instruction writing to that accumulator
+			it.emplace(new intermediate::Nop(intermediate::DelayType::WAIT_REGISTER));
+			it.nextInBlock();
+		}
+	}
+	//3. remove the original calculation of the rematerialized values
+	for(auto& pair : rematerializedLocals)
+	{
+		//the UNIFORM of a constant still needs to be consumed, to keep the order of the following UNIFORMs
+		if(pair.second->hasSideEffects())
+			pair.second->setOutput(NOP_REGISTER);
+		else
+			pair.second.erase();
+	}
+
+	DEBUG_LOG("Rematerialized " << rematerializedLocals.size() << " locals and split " << numCopies << " live-ranges of " << splitLocals.size() << " locals" << logging::endl);
+	return !rematerializedLocals.empty() || numCopies > 0;
+}
+
+const ColoredGraph& GraphColoring::getGraph() const
+{
+	return graph;
+}
+
+FastMap<const Local*, Register> GraphColoring::toRegisterMap() const
+{
+	if(!errorSet.empty())
+	{
+		for(const Local* loc : errorSet)
+			logging::error() << "Error assigning local to register: " << loc->name << logging::endl;
+		throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "There are erroneous register-associations!");
+	}
+
+	UnorderedMap<const Local*, Register> result;
+
+	for(const auto& pair : graph)
+	{
+		result.emplace(pair.first, pair.second.getRegisterFixed());
+		DEBUG_LOG("Assigned local " << pair.first->name << " to register " << result.at(pair.first).to_string(true, false) << logging::endl);
 	}
+
+	return result;
 }
@@ -12,6 +12,7 @@
 #include <set>
 #include <unordered_set>
 #include <bitset>
+#include <vector>
 
 #include "../performance.h"
 #include "../Types.h"
@@ -48,7 +49,18 @@ namespace vc4c
 			LocalUsage(InstructionWalker first, InstructionWalker last);
 		};
 
-		class ColoredNode : public Node<const Local*, LocalRelation>
+		/*
+		 * Determines the usage-ranges and the register-files which can be used for all locals accessed from the given instruction on
+		 */
+		FastMap<const Local*, LocalUsage> determineLocalUses(Method& method, InstructionWalker it);
+
+		/*
+		 * The number of registers of each physical register-file the locals of the method can be assigned to.
+		 * Kernels compiled for threaded execution (see Configuration#threadedExecution) can only use the lower half of the register-files.
+		 */
+		std::size_t getNumPhysicalRegisters(const Method& method);
+
+		class ColoredNode
 		{
 		public:
 			ColoredNode(const Local* local, const RegisterFile possibleFiles = RegisterFile::ANY);
@@ -61,6 +73,10 @@ namespace vc4c
 			bool hasFreeRegisters(const RegisterFile file) const;
 			std::size_t countFreeRegisters(const RegisterFile file) const;
 			void takeValues(const ColoredNode& other);
+			/*!
+			 * Discards any assigned or blocked register and resets the node to the given register-files
+			 */
+			void reset(const RegisterFile possibleFiles, const std::size_t numPhysicalRegisters);
 
 			/*
 			 * \return The fixed register, this node has
@@ -72,9 +88,25 @@ namespace vc4c
 			 * \return the register-index in the corresponding bit-set
 			 */
 			std::size_t fixToRegister();
+			/*!
+			 * Fixes this node to the preferred register, if it is still available, to any other register otherwise.
+			 * \return the register-index in the corresponding bit-set
+			 */
+			std::size_t fixToRegister(const Register& preferred);
+			/*
+			 * \return Whether this node is fixed to a single register of a single register-file
+			 */
+			bool isFixedToRegister() const;
+			/*
+			 * \return Whether the given register is not blocked for this node
+			 */
+			bool isRegisterAvailable(const Register& reg) const;
 
-			std::string to_string(bool longDescription = false) const;
+			std::string to_string() const;
 
+			const Local* const key;
+			//the index of this node in the interference-matrix of the graph
+			std::size_t id;
 			RegisterFile initialFile;
 			RegisterFile possibleFiles;
 
@@ -84,7 +116,93 @@ namespace vc4c
 			std::bitset<4> availableAcc = 0xFUL;
 		};
 
-		using ColoredGraph = Graph<const Local*, ColoredNode>;
+		/*
+		 * The graph of the locals to be mapped to registers.
+		 *
+		 * The edges are not stored per node, but in a square bit-matrix indexed by the node ids with one bit-plane per relation.
+		 * Adding an edge (which happens very often for the same pair of locals used simultaneously) or iterating the neighbors of a node
+		 * therefore requires no allocations and only touches a single contiguous row of memory.
+		 *
+		 * NOTE: The edges are directed, a node is only neighbor of another node, if the edge was added in this direction.
+		 */
+		class ColoredGraph : public Graph<const Local*, ColoredNode>
+		{
+		public:
+			ColoredNode& getOrCreateNode(const Local* local, const RegisterFile possibleFiles = RegisterFile::ANY);
+			void reserve(std::size_t numNodes);
+			void clear();
+
+			/*!
+			 * Adds the given neighbor with the given relation.
+			 * Multiple calls to this method do not override the previous association.
+			 */
+			void addNeighbor(const ColoredNode& node, const ColoredNode& neighbor, const LocalRelation relation);
+			/*!
+			 * Adds all neighbors of the source node (with their relations) as neighbors of the destination node
+			 */
+			void copyNeighbors(const ColoredNode& source, const ColoredNode& destination);
+			/*!
+			 * Removes all edges from and to the given node
+			 */
+			void removeNeighbors(const ColoredNode& node);
+			LocalRelation getRelation(const ColoredNode& node, const ColoredNode& neighbor) const;
+			std::size_t countNeighbors(const ColoredNode& node) const;
+			std::size_t countEdges() const;
+			/*!
+			 * \return the number of bytes of the interference-matrix
+			 */
+			std::size_t getMatrixSize() const;
+			/*!
+			 * \return the number of bytes of the interference-matrix for the given number of nodes
+			 */
+			static std::size_t estimateMatrixSize(std::size_t numNodes);
+
+			template<typename Consumer>
+			void forAllNeighbors(const ColoredNode& node, Consumer&& consumer) const
+			{
+				const std::size_t offset = node.id * wordsPerRow;
+				for(std::size_t word = 0; word < wordsPerRow; ++word)
+				{
+					uint64_t bits = usedTogether[offset + word] | usedSimultaneously[offset + word];
+					while(bits != 0)
+					{
+						const unsigned bit = static_cast<unsigned>(__builtin_ctzll(bits));
+						bits &= bits - 1;
+						const bool together = ((usedTogether[offset + word] >> bit) & 1) != 0;
+						consumer(*nodes[word * 64 + bit], together ? LocalRelation::USED_TOGETHER : LocalRelation::USED_SIMULTANEOUSLY);
+					}
+				}
+			}
+
+			/*
+			 * Calls the consumer for all nodes, which have the given node as neighbor
+			 */
+			template<typename Consumer>
+			void forAllReverseNeighbors(const ColoredNode& node, Consumer&& consumer) const
+			{
+				const std::size_t word = node.id / 64;
+				const uint64_t mask = uint64_t{1} << (node.id % 64);
+				for(std::size_t row = 0; row < nodes.size(); ++row)
+				{
+					if((usedTogether[row * wordsPerRow + word] & mask) != 0)
+						consumer(*nodes[row], LocalRelation::USED_TOGETHER);
+					else if((usedSimultaneously[row * wordsPerRow + word] & mask) != 0)
+						consumer(*nodes[row], LocalRelation::USED_SIMULTANEOUSLY);
+				}
+			}
+
+		private:
+			//the nodes, indexed by their id
+			std::vector<ColoredNode*> nodes;
+			//the number of nodes the matrix has space for
+			std::size_t capacity = 0;
+			std::size_t wordsPerRow = 0;
+			//the bit-planes for the two relations, with a row of wordsPerRow words per node
+			std::vector<uint64_t> usedTogether;
+			std::vector<uint64_t> usedSimultaneously;
+
+			void resizeMatrix(std::size_t newCapacity);
+		};
 
 		/*
 		 * Graph coloring
@@ -117,6 +235,11 @@ namespace vc4c
 			 */
 			GraphColoring(Method& method, InstructionWalker it);
 
+			/*!
+			 * Creates and colors the graph on the first call.
+			 * Any further call only updates and re-colors the part of the graph affected by the previous call to fixErrors(),
+			 * all other locals keep their registers.
+			 */
 			bool colorGraph();
 
 			/*!
@@ -124,18 +247,54 @@ namespace vc4c
 			 */
 			bool fixErrors();
 
+			/*!
+			 * Spills locals into the VPM to resolve the register conflicts, which could not be fixed otherwise.
+			 *
+			 * For every local which could not be assigned to a register, the local with the lowest spill cost out of it and the locals it is used
+			 * simultaneously with is spilled. The spill cost is the number of uses (weighted by the depth of the loops they are in) per interfering local.
+			 * Every use of a spilled local is replaced by a temporary, which is reloaded before and spilled after the instruction.
+			 *
+			 * \return Whether any local was spilled, in which case the graph needs to be re-created
+			 */
+			bool spillLocals();
+
+			/*!
+			 * Shortens the live-ranges of the long-living locals conflicting with the locals which could not be assigned to a register.
+			 *
+			 * Locals calculated by a single cheap instruction (loading a literal or reading the element- or QPU-number) are rematerialized,
+			 * i.e. the value is re-calculated right before every use instead of being kept alive.
+			 * All other locals written just once are copied into a new local at the beginning of every other basic block they are read in,
+			 * so only the copy is used (and needs to be assigned to a register file usable by all its uses) within that block.
+			 *
+			 * \return Whether any live-range was modified, in which case the graph needs to be re-created
+			 */
+			bool splitLiveRanges();
+
 			FastMap<const Local*, Register> toRegisterMap() const;
+
+			const ColoredGraph& getGraph() const;
 		private:
 			Method& method;
+			const std::size_t numPhysicalRegisters;
 			FastSet<const Local*> closedSet;
 			FastSet<const Local*> openSet;
 			FastMap<const Local*, LocalUsage> localUses;
 
 			ColoredGraph graph;
 			FastSet<const Local*> errorSet;
+			//the locals, which are live while the instruction is executed
+			FastMap<intermediate::IntermediateInstruction*, FastSet<const Local*>> localRanges;
+			//the locals whose uses were modified by the last call to fixErrors()
+			FastSet<const Local*> modifiedLocals;
+			//the locals copied into each other by plain moves, which are preferably assigned to the same register, so the moves can be removed
+			FastMap<const Local*, FastSet<const Local*>> copiedLocals;
 
 			void createGraph();
-			void resetGraph();
+			/*
+			 * Updates the usage-ranges and edges of the locals modified by fixing the errors
+			 * and prepares only the erroneous and modified locals and their neighbors to be colored again
+			 */
+			void updateGraph();
 		};
 	}
 }
@@ -5,8 +5,13 @@
  */
 
 #include <stdbool.h>
+#include <array>
 
 #include "Instruction.h"
+#include "ALUInstruction.h"
+#include "BranchInstruction.h"
+#include "LoadInstruction.h"
+#include "SemaphoreInstruction.h"
 #include "../Values.h"
 
 using namespace vc4c;
@@ -27,74 +32,179 @@ uint64_t Instruction::toBinaryCode() const
     return value;
 }
 
+std::unique_ptr<Instruction> Instruction::decode(uint64_t binaryCode)
+{
+	std::unique_ptr<Instruction> instr;
+	const Signaling sig = static_cast<Signaling>(binaryCode >> 60);
+	if(sig == Signaling::BRANCH)
+		instr.reset(new BranchInstruction());
+	else if(sig == Signaling::LOAD_IMMEDIATE)
+	{
+		//load immediate and semaphore instructions are distinguished by the bits following the signal
+		const uint8_t type = static_cast<uint8_t>((binaryCode >> 57) & MASK_Septuple);
+		if(type == static_cast<uint8_t>(OpSemaphore::SEMAPHORE))
+			instr.reset(new SemaphoreInstruction());
+		else if(type == static_cast<uint8_t>(OpLoad::LOAD_IMM_32) || type == static_cast<uint8_t>(OpLoad::LOAD_SIGNED) || type == static_cast<uint8_t>(OpLoad::LOAD_UNSIGNED))
+			instr.reset(new LoadInstruction());
+		else
+			throw CompilationError(CompilationStep::GENERAL, "Invalid load immediate instruction", qpu_asm::toHexString(binaryCode));
+	}
+	else
+		instr.reset(new ALUInstruction());
+	instr->value = binaryCode;
+	return instr;
+}
+
 std::string Instruction::toHexString(bool withAssemblerCode) const
 {
-    uint64_t binaryCode = toBinaryCode();
+    std::string result;
+    appendHexString(result, toBinaryCode());
     if(withAssemblerCode)
-    {
-        return (std::string(qpu_asm::toHexString(binaryCode)) + "//") + toASMString();
-    }
-    return qpu_asm::toHexString(binaryCode);
+        result.append("//").append(toASMString());
+    return result;
+}
+
+//the names of the physical registers, indexed by [file B][write access][address]
+using RegisterNames = std::array<std::array<std::array<std::string, 64>, 2>, 2>;
+
+static RegisterNames createRegisterNames()
+{
+	RegisterNames names;
+	for(unsigned file = 0; file < 2; ++file)
+	{
+		for(unsigned write = 0; write < 2; ++write)
+		{
+			for(unsigned address = 0; address < 64; ++address)
+			{
+				const Register reg{file == 0 ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, static_cast<unsigned char>(address)};
+				names[file][write][address] = reg.to_string(true, write == 0);
+			}
+		}
+	}
+	return names;
+}
+
+static const std::string& getRegisterName(const bool regFileA, const Address reg, const bool readAccess)
+{
+	static const RegisterNames names = createRegisterNames();
+	return names.at(regFileA ? 0 : 1).at(readAccess ? 0 : 1).at(reg);
 }
 
-std::string Instruction::toInputRegister(const InputMutex mutex, const Address regA, const Address regB, const bool hasImmediate)
+static std::array<std::string, 64> createSmallImmediateNames()
 {
+	std::array<std::string, 64> names;
+	for(unsigned char i = 0; i < names.size(); ++i)
+		names[i] = SmallImmediate(i).toString();
+	return names;
+}
+
+const std::string& Instruction::toInputRegister(const InputMutex mutex, const Address regA, const Address regB, const bool hasImmediate)
+{
+    static const std::array<std::string, 6> accumulators = {"r0", "r1", "r2", "r3", "r4", "r5"};
+    static const std::array<std::string, 64> smallImmediates = createSmallImmediateNames();
     if(mutex == InputMutex::ACC0)
-        return "r0";
+        return accumulators[0];
     if(mutex == InputMutex::ACC1)
-        return "r1";
+        return accumulators[1];
     if(mutex == InputMutex::ACC2)
-        return "r2";
+        return accumulators[2];
     if(mutex == InputMutex::ACC3)
-        return "r3";
+        return accumulators[3];
     if(mutex == InputMutex::ACC4)
-        return "r4";
+        return accumulators[4];
     if(mutex == InputMutex::ACC5)
-        return "r5";
+        return accumulators[5];
     //general register-file
     if(mutex == InputMutex::REGA)
-    {
-        const Register tmp{RegisterFile::PHYSICAL_A, regA};
-        return tmp.to_string(true, true);
-    }
+        return getRegisterName(true, regA, true);
     else if(hasImmediate)
-    {
         //is immediate value
-        return static_cast<SmallImmediate>(regB).toString();
-    }
+        return smallImmediates.at(regB);
     else
-    {
-        const Register tmp{RegisterFile::PHYSICAL_B, regB};
-        return tmp.to_string(true, true);
-    }
+        return getRegisterName(false, regB, true);
 }
 
-std::string Instruction::toOutputRegister(bool regFileA, const Address reg)
+const std::string& Instruction::toOutputRegister(bool regFileA, const Address reg)
 {
-    const Register tmp{regFileA ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, reg};
-    return tmp.to_string(true, false);
+    return getRegisterName(regFileA, reg, false);
 }
 
 std::string Instruction::toExtrasString(const Signaling sig, const ConditionCode cond, const SetFlag flags, const Unpack unpack, const Pack pack)
 {
-    std::string result("");
+    std::string result;
     if(sig != Signaling::NO_SIGNAL && sig != Signaling::ALU_IMMEDIATE)
-        result += std::string(".") + toString(sig);
+        result.append(".").append(toString(sig));
     if(cond != COND_ALWAYS)
-        result += std::string(".") + cond.toString();
+        result.append(".").append(cond.toString());
     if(flags == SetFlag::SET_FLAGS)
-        result += std::string(".") + toString(flags);
+        result.append(".").append(toString(flags));
     if(unpack != UNPACK_NOP)
-    	result += std::string(".") + unpack.toString();
+    	result.append(".").append(unpack.toString());
     if(pack != PACK_NOP)
-    	result += std::string(".") + pack.toString();
+    	result.append(".").append(pack.toString());
     return result;
 }
 
-std::string qpu_asm::toHexString(const uint64_t code)
+static void appendHexWord(std::string& out, const uint32_t word)
+{
+	static const char digits[] = "0123456789abcdef";
+	char buffer[10] = {'0', 'x'};
+	for(unsigned i = 0; i < 8; ++i)
+		buffer[2 + i] = digits[(word >> (28 - 4 * i)) & 0xF];
+	out.append(buffer, sizeof(buffer));
+}
+
+void qpu_asm::appendHexString(std::string& out, const uint64_t code)
 {
 	//lower half before upper half
-	char buffer[64];
-	snprintf(buffer, sizeof(buffer), "0x%08x, 0x%08x, ", static_cast<uint32_t>(code & 0xFFFFFFFFLL), static_cast<uint32_t>((code & 0xFFFFFFFF00000000LL) >> 32));
-	return buffer;
+	appendHexWord(out, static_cast<uint32_t>(code & 0xFFFFFFFFLL));
+	out.append(", ");
+	appendHexWord(out, static_cast<uint32_t>((code & 0xFFFFFFFF00000000LL) >> 32));
+	out.append(", ");
+}
+
+std::string qpu_asm::toHexString(const uint64_t code)
+{
+	std::string result;
+	result.reserve(24);
+	appendHexString(result, code);
+	return result;
+}
+
+TextOutputBuffer::TextOutputBuffer(std::ostream& stream, std::size_t chunkSize) : stream(stream), chunkSize(chunkSize)
+{
+	buffer.reserve(chunkSize + 256);
+}
+
+TextOutputBuffer::~TextOutputBuffer()
+{
+	flush();
+}
+
+void TextOutputBuffer::writeASM(const std::string& assemblerCode)
+{
+	buffer.append(assemblerCode);
+	endLine();
+}
+
+void TextOutputBuffer::writeHex(const uint64_t binaryCode, const std::string& assemblerCode)
+{
+	appendHexString(buffer, binaryCode);
+	if(!assemblerCode.empty())
+		buffer.append("//").append(assemblerCode);
+	endLine();
+}
+
+void TextOutputBuffer::flush()
+{
+	if(!buffer.empty())
+		stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	buffer.clear();
+}
+
+void TextOutputBuffer::endLine()
+{
+	buffer.push_back('\n');
+	if(buffer.size() >= chunkSize)
+		flush();
 }
@@ -7,6 +7,8 @@
 #ifndef INSTRUCTION_H
 #define INSTRUCTION_H
 
+#include <memory>
+#include <ostream>
 #include <string>
 
 #include "OpCodes.h"
@@ -34,14 +36,51 @@ namespace vc4c
 
 			std::string toHexString(bool withAssemblerCode) const;
 
+			/*
+			 * Creates the instruction of the matching type (ALU, branch, load immediate or semaphore) for the given machine code
+			 */
+			static std::unique_ptr<Instruction> decode(uint64_t binaryCode);
+
 		protected:
 
-			static std::string toInputRegister(const InputMutex mutex, const Address regA, const Address regB, const bool hasImmediate = false);
-			static std::string toOutputRegister(const bool regFileA, const Address reg);
+			static const std::string& toInputRegister(const InputMutex mutex, const Address regA, const Address regB, const bool hasImmediate = false);
+			static const std::string& toOutputRegister(const bool regFileA, const Address reg);
 			static std::string toExtrasString(const Signaling sig, const ConditionCode cond = COND_ALWAYS, const SetFlag flags = SetFlag::DONT_SET, const Unpack unpack = UNPACK_NOP, const Pack pack = PACK_NOP);
 		};
 
 		std::string toHexString(const uint64_t code);
+		/*
+		 * Appends the hex-representation of the given code (in the same format as #toHexString) to the string
+		 */
+		void appendHexString(std::string& out, const uint64_t code);
+
+		/*
+		 * Buffers the textual (hex or assembler) representation of the instructions and writes it to the stream in large chunks,
+		 * instead of formatting and flushing every line separately
+		 */
+		class TextOutputBuffer : private NonCopyable
+		{
+		public:
+			explicit TextOutputBuffer(std::ostream& stream, std::size_t chunkSize = 64 * 1024);
+			~TextOutputBuffer();
+
+			void writeASM(const std::string& assemblerCode);
+			/*
+			 * Writes the machine code in hex, followed by the assembler code as comment, if not empty
+			 */
+			void writeHex(uint64_t binaryCode, const std::string& assemblerCode);
+			/*
+			 * Writes all buffered text to the stream
+			 */
+			void flush();
+
+		private:
+			std::ostream& stream;
+			std::string buffer;
+			const std::size_t chunkSize;
+
+			void endLine();
+		};
 	}
 }
 
@@ -5,10 +5,14 @@
  */
 
 #include <string.h>
+#include <algorithm>
+#include <bitset>
+#include <sstream>
 
 #include "KernelInfo.h"
 #include "../intermediate/IntermediateInstruction.h"
-#include "log.h"
+#include "../periphery/VPM.h"
+#include "../Logging.h"
 
 using namespace vc4c;
 using namespace vc4c::qpu_asm;
@@ -54,11 +58,86 @@ std::string ParamInfo::to_string() const
 			//access qualifier
 			std::string((isPointer && isConst) ? "const " : "") + std::string((isPointer && isRestricted) ? "restrict " : "") + std::string((isPointer && isVolatile) ? "volatile " : "") +
 			//input/output
-			((isPointer && isInput) ? "in " : "") + ((isPointer && isOutput) ? "out " : "") +
+			((isPointer && isInput) ? "in " : "") + ((isPointer && isOutput) ? "out " : "") + (isBuffered ? "buffered " : "") +
 			//type + name
 			((typeName) + " ") + (name + " (") + (std::to_string(size) + " B, ") + std::to_string(elements) + " items)";
 }
 
+static uint16_t getParameterFlags(const ParamInfo& param)
+{
+	return static_cast<uint16_t>(param.isBuffered << 13 | param.isPointer << 12 | param.isOutput << 9 | param.isInput << 8 | (static_cast<unsigned char>(param.addressSpace) & 0xF) << 4 | param.isConst | param.isRestricted << 1 | param.isVolatile << 2);
+}
+
+/*
+ * The string table of the compact format: the kernel name followed by the name and type name of every parameter, all zero-terminated
+ */
+static std::string getStringTable(const KernelInfo& info)
+{
+	std::string table = info.name;
+	table.push_back('\0');
+	for(const ParamInfo& param : info.parameters)
+	{
+		table.append(param.name).push_back('\0');
+		table.append(param.typeName).push_back('\0');
+	}
+	return table;
+}
+
+/*
+ * The compact format consists of:
+ * - the offset, length, flags (see KernelInfo#COMPACT_FORMAT), number of parameters and VPM rows per QPU
+ * - the work-group sizes and flags (same as the default format)
+ * - the estimated cycles and the number of used registers
+ * - the VPM bytes for the first four VPM usages and the VPM bytes of the last usage and the size of the string table (in 64-bit words)
+ * - two 32-bit entries per 64-bit word for the parameters: size, number of elements and flags (same as the default format)
+ * - the optional string table
+ */
+static std::size_t writeCompact(const KernelInfo& info, std::ostream& stream, const OutputMode mode)
+{
+	if(info.parameters.size() > 0xFF)
+		throw CompilationError(CompilationStep::CODE_GENERATION, "Too many parameters for compact kernel-info", std::to_string(info.parameters.size()));
+	const std::string stringTable = info.withNames ? getStringTable(info) : "";
+	const std::size_t stringWords = (stringTable.size() + 7) / 8;
+	if(stringWords > 0xFFFF)
+		throw CompilationError(CompilationStep::CODE_GENERATION, "String table of compact kernel-info is too big", info.name);
+
+	std::size_t numWords = 0;
+	uint8_t buf[8];
+	const uint16_t flags = KernelInfo::COMPACT_FORMAT | (info.withNames ? KernelInfo::COMPACT_HAS_NAMES : 0) | (info.usesMutex ? KernelInfo::COMPACT_USES_MUTEX : 0)
+			| (info.usesSemaphores ? KernelInfo::COMPACT_USES_SEMAPHORES : 0) | static_cast<uint16_t>((info.workItemsPerQPU - 1) << KernelInfo::WORK_ITEMS_PER_QPU_OFFSET);
+	((uint16_t*)buf)[0] = info.offset;
+	((uint16_t*)buf)[1] = info.length;
+	((uint16_t*)buf)[2] = flags;
+	((uint16_t*)buf)[3] = static_cast<uint16_t>(info.parameters.size() | (static_cast<uint16_t>(info.vpmRowsPerQPU) << 8));
+	writeStream(stream, buf, mode);
+	*((uint64_t*)buf) = info.workGroupSize | (static_cast<uint64_t>(info.usedUniforms) << 48) | (static_cast<uint64_t>(info.threadable) << 61) | (static_cast<uint64_t>(info.batchedWorkGroups) << 62);
+	writeStream(stream, buf, mode);
+	*((uint64_t*)buf) = static_cast<uint64_t>(info.estimatedCycles) | (static_cast<uint64_t>(info.numRegisters) << 32);
+	writeStream(stream, buf, mode);
+	((uint16_t*)buf)[0] = info.vpmBytes[0];
+	((uint16_t*)buf)[1] = info.vpmBytes[1];
+	((uint16_t*)buf)[2] = info.vpmBytes[2];
+	((uint16_t*)buf)[3] = info.vpmBytes[3];
+	writeStream(stream, buf, mode);
+	*((uint64_t*)buf) = static_cast<uint64_t>(info.vpmBytes[4]) | (static_cast<uint64_t>(stringWords) << 16);
+	writeStream(stream, buf, mode);
+	numWords += 5;
+	for(std::size_t i = 0; i < info.parameters.size(); i += 2)
+	{
+		memset(buf, 0, sizeof(buf));
+		for(std::size_t k = 0; k < 2 && i + k < info.parameters.size(); ++k)
+		{
+			const ParamInfo& param = info.parameters[i + k];
+			((uint16_t*)buf)[k * 2] = static_cast<uint16_t>(param.elements << 8 | param.size);
+			((uint16_t*)buf)[k * 2 + 1] = getParameterFlags(param);
+		}
+		writeStream(stream, buf, mode);
+		++numWords;
+	}
+	copyName(stream, stringTable, mode);
+	return numWords + stringWords;
+}
+
 uint8_t KernelInfo::write(std::ostream& stream, const OutputMode mode) const
 {
     std::size_t numWords = 0;
@@ -67,16 +146,24 @@ uint8_t KernelInfo::write(std::ostream& stream, const OutputMode mode) const
 		const std::string s = to_string();
 		stream << "// " << s << std::endl;
 	}
+    if(isCompact && (mode == OutputMode::BINARY || mode == OutputMode::HEX))
+    	return static_cast<uint8_t>(writeCompact(*this, stream, mode));
     if(mode == OutputMode::BINARY || mode == OutputMode::HEX)
     {
         uint8_t buf[8];
         ((uint16_t*)buf)[0] = offset;
         ((uint16_t*)buf)[1] = length;
-        ((uint16_t*)buf)[2] = name.size();
-        ((uint16_t*)buf)[3] = parameters.size();
+        if(workItemsPerQPU > 1 && name.size() > 0xFF)
+            throw CompilationError(CompilationStep::CODE_GENERATION, "Kernel name is too long for kernel executing multiple work-items per QPU", name);
+        ((uint16_t*)buf)[2] = name.size() | ((workItemsPerQPU - 1) << WORK_ITEMS_PER_QPU_OFFSET);
+        //the number of parameters only uses the lower 8 bits, the upper 8 bits contain the number of VPM rows per QPU
+        if(vpmRowsPerQPU != 0 && parameters.size() > 0xFF)
+            throw CompilationError(CompilationStep::CODE_GENERATION, "Too many parameters for kernel with partitioned VPM", std::to_string(parameters.size()));
+        ((uint16_t*)buf)[3] = parameters.size() | (static_cast<uint16_t>(vpmRowsPerQPU) << 8);
         writeStream(stream, buf, mode);
         ++numWords;
-        *((uint64_t*)buf) = workGroupSize;
+        //the work-group sizes only use the lower 48 bits, the upper 16 bits contain the mask of used UNIFORMs (bits 48 to 60 and 63), the threadable flag (bit 61) and the batched work-group flag (bit 62)
+        *((uint64_t*)buf) = workGroupSize | (static_cast<uint64_t>(usedUniforms) << 48) | (static_cast<uint64_t>(threadable) << 61) | (static_cast<uint64_t>(batchedWorkGroups) << 62);
         writeStream(stream, buf, mode);
         ++numWords;
         numWords += copyName(stream, name, mode);
@@ -86,7 +173,7 @@ uint8_t KernelInfo::write(std::ostream& stream, const OutputMode mode) const
             ((uint16_t*)buf)[0] = parameters[i].elements << 8 | parameters[i].size;
             ((uint16_t*)buf)[1] = parameters[i].name.size();
             ((uint16_t*)buf)[2] = parameters[i].typeName.size();
-            ((uint16_t*)buf)[3] = parameters[i].isPointer << 12 | parameters[i].isOutput << 9 | parameters[i].isInput << 8 | (static_cast<unsigned char>(parameters[i].addressSpace) & 0xF) << 4 | parameters[i].isConst | parameters[i].isRestricted << 1 | parameters[i].isVolatile << 2;
+            ((uint16_t*)buf)[3] = getParameterFlags(parameters[i]);
             writeStream(stream, buf, mode);
             ++numWords;
             numWords += copyName(stream, parameters[i].name, mode);
@@ -96,9 +183,51 @@ uint8_t KernelInfo::write(std::ostream& stream, const OutputMode mode) const
     return numWords;
 }
 
+static std::size_t getNumNameWords(const std::string& name)
+{
+	return (name.size() + 7) / 8;
+}
+
+std::size_t KernelInfo::getNumWords(const OutputMode mode) const
+{
+	if(mode != OutputMode::BINARY && mode != OutputMode::HEX)
+		return 0;
+	if(isCompact)
+		return 5 + (parameters.size() + 1) / 2 + (withNames ? getNumNameWords(getStringTable(*this)) : 0);
+	//header, work-group sizes and kernel name
+	std::size_t numWords = 2 + getNumNameWords(name);
+	for(const ParamInfo& param : parameters)
+		numWords += 1 + getNumNameWords(param.name) + getNumNameWords(param.typeName);
+	return numWords;
+}
+
 std::string KernelInfo::to_string() const
 {
-	return std::string("Kernel '") + (name + "', offset ") + (std::to_string(offset) + ", with following parameters: ") + ::to_string<ParamInfo>(parameters);
+	return std::string("Kernel '") + (name + "', offset ") + (std::to_string(offset) + ", used work-item UNIFORMs ") + (std::bitset<16>(usedUniforms).to_string() + ", VPM rows per QPU ") + (std::to_string(vpmRowsPerQPU) + (threadable ? ", threadable" : "") + (usesMutex ? ", uses mutex" : "") + (usesSemaphores ? ", uses semaphores" : "") + (workItemsPerQPU > 1 ? ", " + std::to_string(workItemsPerQPU) + " work-items per QPU" : "")) +
+			(", " + std::to_string(numRegisters) + " registers, " + std::to_string(estimatedCycles) + " estimated cycles, with following parameters: ") + ::to_string<ParamInfo>(parameters);
+}
+
+const std::vector<std::string> KernelInfo::WORK_ITEM_UNIFORMS = {
+	Method::WORK_DIMENSIONS, Method::LOCAL_SIZES, Method::LOCAL_IDS, Method::NUM_GROUPS_X, Method::NUM_GROUPS_Y, Method::NUM_GROUPS_Z,
+	Method::GROUP_ID_X, Method::GROUP_ID_Y, Method::GROUP_ID_Z, Method::GLOBAL_OFFSET_X, Method::GLOBAL_OFFSET_Y, Method::GLOBAL_OFFSET_Z,
+	Method::GLOBAL_DATA_ADDRESS
+};
+
+const std::string KernelInfo::BLOCK_PROFILE_PARAMETER("__vc4c_block_profile");
+const std::string KernelInfo::PRINTF_BUFFER_PARAMETER("__vc4c_printf_buffer");
+const std::string KernelInfo::UNIFORM_CONSTANT_PARAMETER("__vc4c_uniform_constant");
+const std::string KernelInfo::PARAMETER_BUFFER_PARAMETER("__vc4c_parameter_buffer");
+
+uint16_t qpu_asm::getUsedWorkItemUniforms(const Method& method)
+{
+	uint16_t mask = 0;
+	for(std::size_t i = 0; i < KernelInfo::WORK_ITEM_UNIFORMS.size(); ++i)
+	{
+		const Local* local = method.findLocal(KernelInfo::WORK_ITEM_UNIFORMS[i]);
+		if(local != nullptr && !local->getUsers(LocalUser::Type::READER).empty())
+			mask |= static_cast<uint16_t>(1u << i);
+	}
+	return mask;
 }
 
 static std::string getMetaData(const std::map<MetaDataType, std::vector<std::string>>& metaData, const MetaDataType type, const std::size_t index)
@@ -118,6 +247,27 @@ KernelInfo qpu_asm::getKernelInfos(const Method& method, const std::size_t initi
     info.name = method.name[0] == '@' ? method.name.substr(1) : method.name;
     info.parameters.reserve(method.parameters.size());
     info.workGroupSize = 0;
+    info.usedUniforms = getUsedWorkItemUniforms(method);
+    info.batchedWorkGroups = false;
+    info.threadable = false;
+    info.vpmRowsPerQPU = static_cast<uint8_t>(method.vpm->getScratchRowsPerQPU());
+    info.numRegisters = 0;
+    info.estimatedCycles = 0;
+    info.vpmBytes.fill(0);
+    for(const periphery::VPMArea& area : method.vpm->getAreas())
+    	info.vpmBytes[static_cast<std::size_t>(area.usageType)] = static_cast<uint16_t>(info.vpmBytes[static_cast<std::size_t>(area.usageType)] + area.size);
+    info.usesMutex = false;
+    info.usesSemaphores = false;
+    info.workItemsPerQPU = method.workItemsPerQPU;
+    method.forAllInstructions([&info](const intermediate::IntermediateInstruction* instr) -> void
+	{
+    	if(instr->is<intermediate::SemaphoreAdjustment>())
+    		info.usesSemaphores = true;
+    	else if(instr->getOutput().hasValue && instr->getOutput().get().hasRegister(REG_MUTEX))
+    		info.usesMutex = true;
+	});
+    info.isCompact = false;
+    info.withNames = true;
     if(method.metaData.find(MetaDataType::WORK_GROUP_SIZES) != method.metaData.end())
     {
         uint32_t requiredSize = 1;
@@ -129,7 +279,7 @@ KernelInfo qpu_asm::getKernelInfos(const Method& method, const std::size_t initi
             offset += 16;
             requiredSize *= size;
         }
-        if(requiredSize > KernelInfo::MAX_WORK_GROUP_SIZES)
+        if(requiredSize / info.workItemsPerQPU > KernelInfo::MAX_WORK_GROUP_SIZES)
         {
             logging::error() << "Required work-group size " << requiredSize << " exceeds the limit of " << KernelInfo::MAX_WORK_GROUP_SIZES << logging::endl;
         }
@@ -161,19 +311,43 @@ KernelInfo qpu_asm::getKernelInfos(const Method& method, const std::size_t initi
 				paramName[0] == '%' ? paramName.substr(1) : paramName,
                 typeName.empty() ? paramType.to_string() : typeName,
 				(paramType.isPointerType() ? (uint8_t)1 : paramType.num),
-				paramType.isPointerType() ? paramType.getPointerType().get()->addressSpace : AddressSpace::PRIVATE
+				paramType.isPointerType() ? paramType.getPointerType().get()->addressSpace : AddressSpace::PRIVATE,
+				std::find(method.bufferedParameters.begin(), method.bufferedParameters.end(), &method.parameters.at(i)) != method.bufferedParameters.end()
         });
     }
+    if(!method.bufferedParameters.empty())
+    {
+    	info.parameters.push_back(ParamInfo{4, true, false, true, true, false, false, KernelInfo::PARAMETER_BUFFER_PARAMETER,
+    			"uint[" + std::to_string(method.bufferedParameters.size() * NATIVE_VECTOR_SIZE) + "]", 1, AddressSpace::CONSTANT, false});
+    }
+    if(!method.instrumentedBlocks.empty())
+    {
+    	//the counters are stored as vectors of 16 elements
+    	const std::size_t numCounters = (method.instrumentedBlocks.size() + NATIVE_VECTOR_SIZE - 1) / NATIVE_VECTOR_SIZE * NATIVE_VECTOR_SIZE;
+    	info.parameters.push_back(ParamInfo{4, true, true, true, false, false, true, KernelInfo::BLOCK_PROFILE_PARAMETER,
+    			"uint[" + std::to_string(numCounters) + "]", 1, AddressSpace::GLOBAL, false});
+    }
+    if(method.findLocal(Method::PRINTF_BUFFER) != nullptr)
+    {
+    	info.parameters.push_back(ParamInfo{4, true, true, true, false, false, true, KernelInfo::PRINTF_BUFFER_PARAMETER,
+    			"uint[]", 1, AddressSpace::GLOBAL, false});
+    }
+    for(const auto& constant : method.uniformConstants)
+    {
+    	std::ostringstream value;
+    	value << "0x" << std::hex << constant.second;
+    	info.parameters.push_back(ParamInfo{4, false, false, true, true, false, false, KernelInfo::UNIFORM_CONSTANT_PARAMETER, value.str(), 1, AddressSpace::PRIVATE, false});
+    }
     
     return info;
 }
 
 void qpu_asm::writeKernelInfos(const std::vector<KernelInfo>& info, std::ostream& output, const OutputMode mode)
 {
-    logging::debug() << "Writing kernel infos..." << logging::endl;
+    DEBUG_LOG("Writing kernel infos..." << logging::endl);
     for(const KernelInfo& item : info)
     {
-        logging::debug() << item.to_string() << logging::endl;
+        DEBUG_LOG(item.to_string() << logging::endl);
         item.write(output, mode);
     }
 }
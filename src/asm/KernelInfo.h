@@ -7,10 +7,12 @@
 #ifndef KERNELINFO_H
 #define KERNELINFO_H
 
+#include <array>
 #include <vector>
 #include <iostream>
 
 #include "../Module.h"
+#include "../periphery/VPM.h"
 #include "config.h"
 
 namespace vc4c
@@ -33,6 +35,8 @@ namespace vc4c
 			std::string typeName;
 			uint8_t elements;
 			AddressSpace addressSpace;
+			//whether the parameter is passed in the parameter buffer instead of one UNIFORM per element (see KernelInfo#PARAMETER_BUFFER_PARAMETER)
+			bool isBuffered;
 
 			std::string to_string() const;
 		};
@@ -47,14 +51,79 @@ namespace vc4c
 			std::vector<ParamInfo> parameters;
 			//the 3 dimensions for the work-group size specified in the source code
 			uint64_t workGroupSize;
+			//bit-mask of the work-item UNIFORMs (in the order of #WORK_ITEM_UNIFORMS) read by the kernel.
+			//If #UNIFORMS_COMPACTED is set, the kernel only reads these UNIFORMs, otherwise all work-item UNIFORMs need to be passed
+			uint16_t usedUniforms;
+			//whether the kernel loads the UNIFORMs only once and calculates the group ids of all following work-groups itself (see Configuration#batchWorkGroups)
+			bool batchedWorkGroups;
+			//whether the kernel can be run in both hardware threads of a QPU (see Configuration#threadedExecution)
+			bool threadable;
+			//the number of VPM rows used by every QPU as scratch area (QPU n uses the rows [n * vpmRowsPerQPU, (n + 1) * vpmRowsPerQPU)),
+			//zero if the scratch area is shared between all QPUs and guarded by the hardware mutex (see Configuration#partitionVPM)
+			uint8_t vpmRowsPerQPU;
+			//the number of physical registers (of both register-files) the kernel uses
+			uint8_t numRegisters;
+			//the statically estimated number of cycles for a single execution of the kernel (see CycleEstimator.h)
+			uint32_t estimatedCycles;
+			//the number of bytes of VPM reserved by the kernel, per type of VPM area (indexed by VPMUsage)
+			std::array<uint16_t, periphery::NUM_VPM_USAGES> vpmBytes;
+			//whether the kernel locks the hardware mutex
+			bool usesMutex;
+			//whether the kernel increments or decrements any of the hardware semaphores (e.g. for barriers)
+			bool usesSemaphores;
+			//the number of consecutive work-items every QPU executes (see Method#workItemsPerQPU), the run-time starts only (work-group size / workItemsPerQPU) QPUs
+			uint8_t workItemsPerQPU;
+			//whether to write the compact format with the resource usage statistics (see Configuration#compactKernelInfo)
+			bool isCompact;
+			//whether the compact format contains the string table with the kernel, parameter and type names
+			bool withNames;
 
 			uint8_t write(std::ostream& stream, const OutputMode mode) const;
+			/*
+			 * Returns the number of 64-bit words #write writes for the given output-mode, without writing anything
+			 */
+			std::size_t getNumWords(const OutputMode mode) const;
 			std::string to_string() const;
 
 			//The maximum work group sizes specified in the VC4CL runtime library
 			static constexpr uint32_t MAX_WORK_GROUP_SIZES = 12;
+			//The names of the locals for the UNIFORMs relaying the work-item info, in the order they are passed by the run-time
+			static const std::vector<std::string> WORK_ITEM_UNIFORMS;
+			//The name of the additional last parameter of instrumented kernels, the buffer for the block counters of all QPUs (see Configuration#instrumentBlocks).
+			//Its type-name gives the number of counters per QPU, QPU n uses the 32-bit counters [n * num-counters, (n + 1) * num-counters)
+			static const std::string BLOCK_PROFILE_PARAMETER;
+			//The name of the additional parameter after the block-profile buffer of kernels calling printf, the buffer the printf records are written into.
+			//The first word contains the number of bytes reserved by the records and needs to be initialized with zero, the second word the capacity for the records in bytes.
+			//Every record starts at a multiple of 64 bytes after this header and consists of the address of the format string, the number of argument words and
+			//one 32-bit word per (vector) element of the arguments (the address of strings), padded to a multiple of 16 words.
+			//If the number of bytes reserved exceeds the capacity, the records not fitting were dropped
+			static const std::string PRINTF_BUFFER_PARAMETER;
+			//The name of the additional parameters after the block-profile buffer for the constants passed as UNIFORMs (see Configuration#maxUniformConstants).
+			//The run-time needs to pass the 32-bit value given as hexadecimal type-name for every such parameter
+			static const std::string UNIFORM_CONSTANT_PARAMETER;
+			//The name of the additional parameter after the kernel parameters for the address of the parameter buffer (see Configuration#bufferVectorParameters).
+			//The buffered parameters are not passed as UNIFORMs, instead every buffered parameter is stored in its own row of 16 32-bit words (in the order of the parameters),
+			//containing the values otherwise passed as UNIFORMs. Its type-name gives the size of the buffer
+			static const std::string PARAMETER_BUFFER_PARAMETER;
+			//Flag in #usedUniforms, whether the unused work-item UNIFORMs are omitted
+			static constexpr uint16_t UNIFORMS_COMPACTED = 0x8000;
+			//Flags in the third 16-bit field of the first word of the compact format (which contains the length of the name in the default format)
+			static constexpr uint16_t COMPACT_FORMAT = 0x8000;
+			static constexpr uint16_t COMPACT_HAS_NAMES = 0x0001;
+			static constexpr uint16_t COMPACT_USES_MUTEX = 0x0002;
+			static constexpr uint16_t COMPACT_USES_SEMAPHORES = 0x0004;
+			//Offset of the number of work-items per QPU minus one (7 bits) in the third 16-bit field of the first word of both formats.
+			//In the default format, this limits the length of the kernel name to 255, if more than one work-item is executed per QPU
+			static constexpr uint16_t WORK_ITEMS_PER_QPU_OFFSET = 8;
 		};
 
+		/*
+		 * Determines the work-item UNIFORMs which are actually read by the kernel.
+		 *
+		 * Bit i is set, if the local for the i-th entry of KernelInfo#WORK_ITEM_UNIFORMS is read anywhere in the method.
+		 */
+		uint16_t getUsedWorkItemUniforms(const Method& method);
+
 		KernelInfo getKernelInfos(const Method& method, const std::size_t initialOffset, const std::size_t numInstructions);
 		void writeKernelInfos(const std::vector<KernelInfo>& info, std::ostream& output, const OutputMode mode);
 	}
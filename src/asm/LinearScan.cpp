@@ -0,0 +1,253 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "LinearScan.h"
+#include "RegisterAllocation.h"
+#include "../Logging.h"
+
+#include "../analysis/AnalysisManager.h"
+
+#include <algorithm>
+#include <bitset>
+
+using namespace vc4c;
+using namespace vc4c::qpu_asm;
+
+/*
+ * The range of instructions (in the linear order of the method) a local is live in
+ */
+struct LiveInterval
+{
+	const Local* local;
+	std::size_t start;
+	std::size_t end;
+	RegisterFile possibleFiles;
+	//the physical files blocked by other inputs (e.g. literals, fixed registers) of any instruction reading this local
+	RegisterFile blockedFiles;
+	//the locals which are read by the same instructions (or written by the same combined instruction), which can not be on the same physical file
+	FastSet<const Local*> usedTogether;
+};
+
+static void extendInterval(FastMap<const Local*, LiveInterval>& intervals, const Local* local, const std::size_t index, const RegisterFile possibleFiles)
+{
+	auto it = intervals.find(local);
+	if(it == intervals.end())
+	{
+		intervals.emplace(local, LiveInterval{local, index, index, possibleFiles, RegisterFile::NONE, {}});
+		return;
+	}
+	it->second.start = std::min(it->second.start, index);
+	it->second.end = std::max(it->second.end, index);
+}
+
+/*
+ * The registers not in use by any active interval
+ */
+struct FreeRegisters
+{
+	std::bitset<32> fileA;
+	std::bitset<32> fileB;
+	std::bitset<4> accumulators;
+
+	explicit FreeRegisters(const std::size_t numPhysicalRegisters) : fileA(0xFFFFFFFFUL), fileB(0xFFFFFFFFUL), accumulators(0xFUL)
+	{
+		for(std::size_t i = numPhysicalRegisters; i < fileA.size(); ++i)
+		{
+			fileA.reset(i);
+			fileB.reset(i);
+		}
+	}
+
+	Optional<Register> take(const RegisterFile file)
+	{
+		std::size_t size = file == RegisterFile::ACCUMULATOR ? accumulators.size() : fileA.size();
+		for(std::size_t i = 0; i < size; ++i)
+		{
+			if(file == RegisterFile::ACCUMULATOR && accumulators.test(i))
+			{
+				accumulators.reset(i);
+				return ACCUMULATORS.at(i);
+			}
+			if(file == RegisterFile::PHYSICAL_A && fileA.test(i))
+			{
+				fileA.reset(i);
+				return Register{RegisterFile::PHYSICAL_A, i};
+			}
+			if(file == RegisterFile::PHYSICAL_B && fileB.test(i))
+			{
+				fileB.reset(i);
+				return Register{RegisterFile::PHYSICAL_B, i};
+			}
+		}
+		return {};
+	}
+
+	void release(const Register& reg)
+	{
+		if(reg.file == RegisterFile::PHYSICAL_A)
+			fileA.set(reg.num);
+		else if(reg.file == RegisterFile::PHYSICAL_B)
+			fileB.set(reg.num);
+		else
+		{
+			for(std::size_t i = 0; i < accumulators.size(); ++i)
+			{
+				if(ACCUMULATORS.at(i) == reg)
+					accumulators.set(i);
+			}
+		}
+	}
+};
+
+static Optional<Register> chooseRegister(const LiveInterval& interval, const RegisterFile files, FreeRegisters& freeRegisters)
+{
+	//same as for the graph coloring, short-living locals are mapped to accumulators, so they do not block the physical registers
+	const bool preferAccumulator = interval.possibleFiles == RegisterFile::ACCUMULATOR || interval.end - interval.start <= ACCUMULATOR_THRESHOLD_HINT;
+	if(preferAccumulator && has_flag(files, RegisterFile::ACCUMULATOR) && freeRegisters.accumulators.any())
+		return freeRegisters.take(RegisterFile::ACCUMULATOR);
+	//use the physical file which has more free registers left
+	const bool canUseA = has_flag(files, RegisterFile::PHYSICAL_A) && freeRegisters.fileA.any();
+	const bool canUseB = has_flag(files, RegisterFile::PHYSICAL_B) && freeRegisters.fileB.any();
+	if(canUseA && (!canUseB || freeRegisters.fileA.count() >= freeRegisters.fileB.count()))
+		return freeRegisters.take(RegisterFile::PHYSICAL_A);
+	if(canUseB)
+		return freeRegisters.take(RegisterFile::PHYSICAL_B);
+	if(has_flag(files, RegisterFile::ACCUMULATOR) && freeRegisters.accumulators.any())
+		return freeRegisters.take(RegisterFile::ACCUMULATOR);
+	return {};
+}
+
+LinearScanAllocator::LinearScanAllocator(Method& method) : method(method)
+{
+}
+
+bool LinearScanAllocator::allocate()
+{
+	registers.clear();
+	const FastMap<const Local*, LocalUsage> localUses = determineLocalUses(method, method.walkAllInstructions());
+
+	//1. determine the intervals of the locals used within the blocks, in the linear order of the instructions
+	const analysis::InstructionNumbering& numbering = method.getAnalyses().getNumbering();
+	FastMap<const Local*, LiveInterval> intervals;
+	intervals.reserve(localUses.size());
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == nullptr || it.has<intermediate::Branch>() || it.has<intermediate::BranchLabel>() || it.has<intermediate::MemoryBarrier>())
+				continue;
+			const std::size_t index = numbering.getPosition(it.get());
+			FastSet<const Local*> inputs;
+			std::vector<const Local*> outputs;
+			RegisterFile blockedInputFiles = RegisterFile::NONE;
+			it.forAllInstructions([&](const intermediate::IntermediateInstruction* instr)
+			{
+				for(const Value& arg : instr->getArguments())
+				{
+					if(arg.hasType(ValueType::LOCAL))
+						inputs.insert(arg.local);
+					else if(arg.hasType(ValueType::LITERAL) || arg.hasType(ValueType::SMALL_IMMEDIATE))
+						blockedInputFiles = add_flag(blockedInputFiles, RegisterFile::PHYSICAL_B);
+					else if(arg.hasType(ValueType::REGISTER) && (arg.reg.file == RegisterFile::PHYSICAL_A || arg.reg.file == RegisterFile::PHYSICAL_B))
+						blockedInputFiles = add_flag(blockedInputFiles, arg.reg.file);
+				}
+				if(instr->hasValueType(ValueType::LOCAL))
+					outputs.push_back(instr->getOutput().get().local);
+			});
+			for(const Local* local : inputs)
+			{
+				extendInterval(intervals, local, index, localUses.at(local).possibleFiles);
+				LiveInterval& interval = intervals.at(local);
+				interval.blockedFiles = add_flag(interval.blockedFiles, blockedInputFiles);
+				for(const Local* other : inputs)
+				{
+					if(other != local)
+						interval.usedTogether.insert(other);
+				}
+			}
+			for(const Local* local : outputs)
+			{
+				extendInterval(intervals, local, index, localUses.at(local).possibleFiles);
+				//the outputs of a combined instruction are written to different register-files
+				for(const Local* other : outputs)
+				{
+					if(other != local)
+						intervals.at(local).usedTogether.insert(other);
+				}
+			}
+		}
+	}
+
+	//2. extend the intervals to the boundaries of the blocks the locals are live across
+	const analysis::LivenessAnalysis& liveness = method.getAnalyses().getLiveness();
+	for(const BasicBlock& block : method.getBasicBlocks())
+	{
+		const analysis::PositionRange range = numbering.getBlockRange(block);
+		const std::size_t lastIndex = range.second > range.first ? range.second - 1 : range.first;
+		for(const Local* local : liveness.getLiveIns(block))
+		{
+			if(intervals.find(local) != intervals.end())
+				extendInterval(intervals, local, range.first, RegisterFile::NONE);
+		}
+		for(const Local* local : liveness.getLiveOuts(block))
+		{
+			if(intervals.find(local) != intervals.end())
+				extendInterval(intervals, local, lastIndex, RegisterFile::NONE);
+		}
+	}
+
+	//3. assign the registers in the order of the start of the intervals
+	std::vector<const LiveInterval*> sortedIntervals;
+	sortedIntervals.reserve(intervals.size());
+	for(const auto& pair : intervals)
+		sortedIntervals.push_back(&pair.second);
+	std::sort(sortedIntervals.begin(), sortedIntervals.end(), [](const LiveInterval* first, const LiveInterval* second) -> bool
+	{
+		return first->start < second->start || (first->start == second->start && first->end < second->end) ||
+				(first->start == second->start && first->end == second->end && first->local->name < second->local->name);
+	});
+
+	FreeRegisters freeRegisters(getNumPhysicalRegisters(method));
+	//the active intervals with the register assigned
+	std::vector<std::pair<const LiveInterval*, Register>> activeIntervals;
+	for(const LiveInterval* interval : sortedIntervals)
+	{
+		//release the registers of all intervals which ended before this one starts
+		activeIntervals.erase(std::remove_if(activeIntervals.begin(), activeIntervals.end(), [interval, &freeRegisters](const std::pair<const LiveInterval*, Register>& active) -> bool
+		{
+			if(active.first->end >= interval->start)
+				return false;
+			freeRegisters.release(active.second);
+			return true;
+		}), activeIntervals.end());
+
+		RegisterFile files = remove_flag(interval->possibleFiles, interval->blockedFiles);
+		for(const Local* other : interval->usedTogether)
+		{
+			auto otherRegister = registers.find(other);
+			if(otherRegister != registers.end() && (otherRegister->second.file == RegisterFile::PHYSICAL_A || otherRegister->second.file == RegisterFile::PHYSICAL_B))
+				files = remove_flag(files, otherRegister->second.file);
+		}
+		const Optional<Register> reg = chooseRegister(*interval, files, freeRegisters);
+		if(!reg)
+		{
+			DEBUG_LOG("Linear scan failed to assign a register to local " << interval->local->to_string() << " (" << toString(files) << ") live in [" << interval->start << ", " << interval->end << "]" << logging::endl);
+			registers.clear();
+			return false;
+		}
+		registers.emplace(interval->local, reg.get());
+		activeIntervals.emplace_back(interval, reg.get());
+	}
+	DEBUG_LOG("Linear scan assigned registers to " << registers.size() << " locals" << logging::endl);
+	return true;
+}
+
+FastMap<const Local*, Register> LinearScanAllocator::toRegisterMap() const
+{
+	for(const auto& pair : registers)
+		DEBUG_LOG("Assigned local " << pair.first->name << " to register " << pair.second.to_string(true, false) << logging::endl);
+	return registers;
+}
@@ -0,0 +1,46 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_LINEAR_SCAN_H
+#define VC4C_LINEAR_SCAN_H
+
+#include "GraphColoring.h"
+
+namespace vc4c
+{
+	namespace qpu_asm
+	{
+		/*
+		 * Linear-scan register allocation, a faster alternative to the graph coloring.
+		 *
+		 * The live range of every local is approximated by a single interval over the linear order of the instructions,
+		 * which is extended to the boundaries of all blocks the local is live across (e.g. for loops).
+		 * The intervals are assigned registers in the order of their start, re-using the registers of the intervals which ended before.
+		 *
+		 * The register-files possible for every local are determined the same way as for the graph coloring (see #determineLocalUses).
+		 * Additionally, all locals read by the same instruction (and both outputs of a combined instruction) are placed on distinct physical files.
+		 * Unlike the graph coloring, conflicts are not resolved by inserting instructions, the allocation fails instead.
+		 */
+		class LinearScanAllocator
+		{
+		public:
+			explicit LinearScanAllocator(Method& method);
+
+			/*!
+			 * \return Whether all locals have been assigned a register
+			 */
+			bool allocate();
+
+			FastMap<const Local*, Register> toRegisterMap() const;
+
+		private:
+			Method& method;
+			FastMap<const Local*, Register> registers;
+		};
+	}
+}
+
+#endif /* VC4C_LINEAR_SCAN_H */
@@ -9,92 +9,539 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cstdlib>
 #include <string.h>
 
 #include "Compiler.h"
 #include "../lib/cpplog/include/logger.h"
-#include "log.h"
+#include "Logging.h"
 #include "CompilationError.h"
+#include "MemoryStream.h"
+#include "BackgroundWorker.h"
+#include "KernelBundle.h"
+#include "CompileServer.h"
+#include "optimization/Instrumentation.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
 
 using namespace vc4c;
 
 const configuration DEFAULT_CONFIG = {
-    MATH_TYPE_FAST, OUTPUT_BINARY, LOG_WARNING
+    MATH_TYPE_FAST, OUTPUT_BINARY, LOG_WARNING, OPTIMIZATION_LEVEL_MEDIUM, NULL, 1
 };
 
 static CompilationErrorHandler errorCallback = NULL;
 static void* callbackData = NULL;
+//the programs of a batch are compiled in parallel, but the error handler is not required to be thread-safe
+static std::mutex errorCallbackLock;
 
-int convert(const storage* in, storage* out, const configuration config, const char* options)
+/*
+ * Sets up the global logger on the first call and returns the log-level of the compilation.
+ *
+ * The logger is never replaced afterwards, since concurrent compilations may still write to it.
+ * Instead, every compilation filters its messages by its own level (see LogLevelScope)
+ */
+static LogLevel configureLogger(const configuration config)
+{
+	static std::once_flag loggerFlag;
+	std::call_once(loggerFlag, []() -> void
+	{
+		//TODO allow to redirect log
+		logging::LOGGER.reset(new logging::ColoredLogger(std::wcerr, static_cast<logging::Level>(LogLevel::DEBUG)));
+	});
+    return static_cast<LogLevel>(config.log_level);
+}
+
+static Configuration toConfiguration(const configuration config)
 {
-	//TODO allow to redirect log
-    logging::LOGGER.reset(new logging::ColoredLogger(std::wcerr, static_cast<logging::Level>(config.log_level)));
     Configuration realConfig;
     realConfig.mathType = static_cast<MathType>(config.math_type);
     realConfig.outputMode = static_cast<OutputMode>(config.output_mode);
     realConfig.writeKernelInfo = true;
-        
+    realConfig.setOptimizationLevel(static_cast<OptimizationLevel>(config.optimization_level));
+    realConfig.verificationInterval = config.verification_interval;
+    if(config.block_profile_file != NULL)
+    {
+    	//the block-profile only guides the optimizations, so the program is still compiled without it
+    	std::ifstream profile(config.block_profile_file);
+    	try
+    	{
+    		if(!profile)
+    			throw CompilationError(CompilationStep::GENERAL, "Failed to open block-profile", config.block_profile_file);
+    		realConfig.blockProfile = optimizations::readBlockProfile(profile);
+    	}
+    	catch(const CompilationError& e)
+    	{
+    		logging::warn() << "Ignoring block-profile: " << e.what() << logging::endl;
+    	}
+    }
+    return realConfig;
+}
+
+/*
+ * Reports the error of a failed compilation to the error handler
+ */
+static void reportError(const CompilationError& err)
+{
+	logging::severe() << err.what() << logging::endl;
+	std::lock_guard<std::mutex> guard(errorCallbackLock);
+	if(errorCallback != NULL)
+		errorCallback(err.what(), strlen(err.what()), callbackData);
+}
+
+static int convertWithConfiguration(const storage* in, storage* out, const Configuration& realConfig, const char* options, CompilationMetrics* metrics = nullptr)
+{
+    //the input is read directly from the memory-mapped file or the caller's buffer
+    std::unique_ptr<MemoryStreamBuffer> inputBuffer;
     std::unique_ptr<std::istream> is;
+    Optional<std::string> inputFile;
     if(in->is_file)
     {
-        logging::debug() << "Compiling from source-file: " << in->file_name << logging::endl;
+        DEBUG_LOG("Compiling from source-file: " << in->file_name << logging::endl);
         is.reset(new std::ifstream(in->file_name, std::ios_base::in));
+        inputFile = std::string(in->file_name);
     }
     else
     {
-        logging::debug() << "Compiling from input-string with " << in->data_length << " characters..." << logging::endl;
-        const std::string s(in->data, in->data_length);
-        is.reset(new std::istringstream(s, std::ios_base::in));
+        DEBUG_LOG("Compiling from input-string with " << in->data_length << " characters..." << logging::endl);
+        inputBuffer.reset(new MemoryStreamBuffer(in->data, in->data_length));
+        is.reset(new std::istream(inputBuffer.get()));
     }
+    //the output is written directly into the caller's buffer, which is enlarged if necessary
+    std::unique_ptr<OutputMemoryStreamBuffer> outputBuffer;
     std::unique_ptr<std::ostream> os;
     if(out->is_file)
     {
-        logging::debug() << "Compiling into file: " << out->file_name << logging::endl;
+        DEBUG_LOG("Compiling into file: " << out->file_name << logging::endl);
         os.reset(new std::ofstream(out->file_name, std::ios_base::out|std::ios_base::trunc|std::ios_base::binary));
     }
     else
     {
-        logging::debug() << "Compiling into buffer..." << logging::endl;
-        os.reset(new std::ostringstream());
+        DEBUG_LOG("Compiling into buffer..." << logging::endl);
+        outputBuffer.reset(new OutputMemoryStreamBuffer(out->data, out->data_length));
+        os.reset(new std::ostream(outputBuffer.get()));
     }
     
     std::size_t bytesWritten = 0;
     try
     {
     	const std::string optionsString(options == NULL ? "" : options);
-        bytesWritten = Compiler::compile(*is.get(), *os.get(), realConfig, optionsString);
-        logging::info() << "Compilation done, " << bytesWritten << " bytes written!" << logging::endl;
+        //compile via the running compilation server, which keeps the caches warm, if available
+        //the metrics are only available when compiling in this process
+        const Optional<std::string> serverSocket = metrics == nullptr ? getCompileServerSocket() : Optional<std::string>{};
+        Optional<std::size_t> serverResult;
+        if(serverSocket)
+        	serverResult = compileOnServer(serverSocket.get(), *is.get(), *os.get(), realConfig, optionsString, inputFile);
+        bytesWritten = serverResult ? serverResult.get() : Compiler::compile(*is.get(), *os.get(), realConfig, optionsString, inputFile, metrics);
+        INFO_LOG("Compilation done, " << bytesWritten << " bytes written!" << logging::endl);
     }
     catch(CompilationError& err)
     {
-        logging::severe() << err.what() << logging::endl;
-        if(errorCallback != NULL)
-        {
-            errorCallback(err.what(), strlen(err.what()), callbackData);
-        }
+        reportError(err);
         bytesWritten = 0;
         return -15 /* CL_COMPILE_PROGRAM_FAILURE */;
     }
     
     if(!out->is_file)
     {
-        if(out->data == nullptr)
-        {
-            out->data = static_cast<char*>(malloc(bytesWritten + 1));
-            out->data_length = bytesWritten + 1;
-        }
-        else if(out->data_length < bytesWritten + 1)
-        {
-            out->data = static_cast<char*>(realloc(out->data, bytesWritten + 1));
-            out->data_length = bytesWritten + 1;
-        }
-        memcpy(out->data, ((std::ostringstream*)os.get())->str().data(), bytesWritten);
-        out->data[bytesWritten] = '\0';
+        //terminate the written data
+        const std::size_t dataSize = outputBuffer->size();
+        outputBuffer->reserve(dataSize + 1);
+        out->data[dataSize] = '\0';
     }
     
     return bytesWritten > 0 ? 0 /* CL_SUCCESS */ : -15 /* CL_COMPILE_PROGRAM_FAILURE */;
 }
 
+int convert(const storage* in, storage* out, const configuration config, const char* options)
+{
+	const LogLevelScope logScope(configureLogger(config));
+	return convertWithConfiguration(in, out, toConfiguration(config), options);
+}
+
+int convertSpecialized(const storage* in, storage* out, const configuration config, const char* options, const unsigned num_dimensions, const unsigned* local_sizes, const unsigned* global_sizes)
+{
+	const LogLevelScope logScope(configureLogger(config));
+	Configuration realConfig = toConfiguration(config);
+	if(local_sizes != NULL)
+		realConfig.specializedLocalSizes.assign(local_sizes, local_sizes + num_dimensions);
+	if(local_sizes != NULL && global_sizes != NULL)
+		realConfig.specializedGlobalSizes.assign(global_sizes, global_sizes + num_dimensions);
+	return convertWithConfiguration(in, out, realConfig, options);
+}
+
+int convertWithParameters(const storage* in, storage* out, const configuration config, const char* options, const char* kernel_name, const unsigned num_parameters, const unsigned* parameter_indices, const unsigned* parameter_values)
+{
+	const LogLevelScope logScope(configureLogger(config));
+	Configuration realConfig = toConfiguration(config);
+	for(unsigned i = 0; i < num_parameters; ++i)
+		realConfig.specializedParameters.push_back(ParameterSpecialization{kernel_name, parameter_indices[i], parameter_values[i]});
+	return convertWithConfiguration(in, out, realConfig, options);
+}
+
+int convertWithSpecializationConstants(const storage* in, storage* out, const configuration config, const char* options, const unsigned num_constants, const unsigned* spec_ids,
+		const unsigned long long* values)
+{
+	const LogLevelScope logScope(configureLogger(config));
+	Configuration realConfig = toConfiguration(config);
+	for(unsigned i = 0; i < num_constants; ++i)
+		realConfig.specializationConstants.push_back(SpecializationConstant{spec_ids[i], static_cast<uint64_t>(values[i])});
+	return convertWithConfiguration(in, out, realConfig, options);
+}
+
+int convertWithFusedKernels(const storage* in, storage* out, const configuration config, const char* options, const char* fused_kernel_name, const unsigned num_kernels, const char* const* kernel_names,
+		const unsigned* num_parameters, const unsigned* parameter_bindings)
+{
+	const LogLevelScope logScope(configureLogger(config));
+	Configuration realConfig = toConfiguration(config);
+	KernelFusion fusion;
+	fusion.kernelName = fused_kernel_name;
+	for(unsigned i = 0; i < num_kernels; ++i)
+	{
+		fusion.kernels.emplace_back(kernel_names[i]);
+		fusion.parameterBindings.emplace_back(parameter_bindings, parameter_bindings + num_parameters[i]);
+		parameter_bindings += num_parameters[i];
+	}
+	realConfig.fusedKernels.push_back(fusion);
+	return convertWithConfiguration(in, out, realConfig, options);
+}
+
+static unsigned long toMicroseconds(const std::chrono::microseconds duration)
+{
+	return static_cast<unsigned long>(duration.count());
+}
+
+int convertWithMetrics(const storage* in, storage* out, const configuration config, const char* options, compilation_metrics* metrics)
+{
+	const LogLevelScope logScope(configureLogger(config));
+	CompilationMetrics realMetrics;
+	const int result = convertWithConfiguration(in, out, toConfiguration(config), options, &realMetrics);
+	if(metrics == NULL)
+		return result;
+	metrics->from_cache = realMetrics.fromCache;
+	metrics->precompilation_time_us = toMicroseconds(realMetrics.precompilationTime);
+	metrics->parsing_time_us = toMicroseconds(realMetrics.parsingTime);
+	metrics->preparation_time_us = toMicroseconds(realMetrics.preparationTime);
+	metrics->output_time_us = toMicroseconds(realMetrics.outputTime);
+	metrics->num_kernels = static_cast<unsigned>(realMetrics.kernels.size());
+	metrics->kernels = NULL;
+	if(realMetrics.kernels.empty())
+		return result;
+	metrics->kernels = static_cast<kernel_metrics*>(calloc(realMetrics.kernels.size(), sizeof(kernel_metrics)));
+	for(std::size_t i = 0; i < realMetrics.kernels.size(); ++i)
+	{
+		const KernelMetrics& kernel = realMetrics.kernels[i];
+		kernel_metrics& dest = metrics->kernels[i];
+		dest.name = strdup(kernel.name.data());
+		dest.optimization_time_us = toMicroseconds(kernel.optimizationTime);
+		dest.code_generation_time_us = toMicroseconds(kernel.codeGenerationTime);
+		dest.instructions_before = kernel.instructionsBefore;
+		dest.instructions_after = kernel.instructionsAfter;
+		dest.machine_instructions = kernel.machineInstructions;
+		dest.nop_count = kernel.numNops;
+		dest.dual_issue_ratio = kernel.dualIssueRatio;
+		dest.registers_used = kernel.numRegisters;
+		dest.spilled_locals = kernel.numSpilledLocals;
+		dest.vpm_bytes = kernel.vpmBytes;
+		dest.register_allocation_rounds = kernel.registerAllocationRounds;
+		dest.dma_loads = kernel.numDMALoads;
+		dest.dma_stores = kernel.numDMAStores;
+		dest.mutex_acquisitions = kernel.numMutexAcquisitions;
+		dest.estimated_cycles = kernel.estimatedCycles;
+	}
+	return result;
+}
+
+void releaseMetrics(compilation_metrics* metrics)
+{
+	if(metrics == NULL || metrics->kernels == NULL)
+		return;
+	for(unsigned i = 0; i < metrics->num_kernels; ++i)
+		free(metrics->kernels[i].name);
+	free(metrics->kernels);
+	metrics->kernels = NULL;
+	metrics->num_kernels = 0;
+}
+
+int convertAll(const unsigned num_programs, const storage* in, storage* out, const configuration* configs, const char** options, int* results)
+{
+	if(num_programs == 0)
+		return 0 /* CL_SUCCESS */;
+	std::vector<threading::BackgroundWorker> workers;
+	workers.reserve(num_programs);
+	for(unsigned i = 0; i < num_programs; ++i)
+	{
+		auto f = [=]() -> void
+		{
+			//every program of the batch is compiled with its own log-level
+			const LogLevelScope logScope(configureLogger(configs[i]));
+			try
+			{
+				results[i] = convertWithConfiguration(&in[i], &out[i], toConfiguration(configs[i]), options == NULL ? NULL : options[i]);
+			}
+			catch(const std::exception& e)
+			{
+				logging::severe() << e.what() << logging::endl;
+				results[i] = -15 /* CL_COMPILE_PROGRAM_FAILURE */;
+			}
+		};
+		workers.emplace(workers.end(), f, "Batch")->operator ()();
+	}
+	threading::BackgroundWorker::waitForAll(workers);
+	for(unsigned i = 0; i < num_programs; ++i)
+	{
+		if(results[i] != 0)
+			return results[i];
+	}
+	return 0 /* CL_SUCCESS */;
+}
+
+enum class CompilationState
+{
+	PENDING,
+	RUNNING,
+	CANCELLED,
+	FINISHED
+};
+
+struct _compilation
+{
+	_compilation(const storage& in, storage* out, const Configuration& config, const std::string& options, CompilationCallback callback, void* userData) :
+		inputData(in.is_file ? std::string(in.file_name) : std::string(in.data, in.data_length)), in(in), out(out), config(config), options(options), callback(callback), userData(userData), state(CompilationState::PENDING),
+		result(-15 /* CL_COMPILE_PROGRAM_FAILURE */), worker([this]() -> void { run(); }, "Async")
+	{
+		//the input (or the file name) is owned by the handle, so the caller's buffer can be freed after starting the compilation
+		this->in.data = &inputData[0];
+		//allows to cancel the compilation while it is running
+		this->config.cancellationToken = std::make_shared<std::atomic<bool>>(false);
+	}
+
+	void run()
+	{
+		CompilationState expected = CompilationState::PENDING;
+		const bool started = state.compare_exchange_strong(expected, CompilationState::RUNNING);
+		if(started)
+		{
+			try
+			{
+				result = convertWithConfiguration(&in, out, config, options.c_str());
+			}
+			catch(const std::exception& e)
+			{
+				logging::severe() << e.what() << logging::endl;
+			}
+		}
+		if(callback != NULL)
+			callback(this, result, userData);
+		if(started)
+			state = CompilationState::FINISHED;
+	}
+
+	std::string inputData;
+	storage in;
+	storage* const out;
+	Configuration config;
+	const std::string options;
+	const CompilationCallback callback;
+	void* const userData;
+	std::atomic<CompilationState> state;
+	int result;
+	threading::BackgroundWorker worker;
+};
+
+compilation_handle convertAsync(const storage* in, storage* out, const configuration config, const char* options, CompilationCallback callback, void* user_data)
+{
+	const LogLevelScope logScope(configureLogger(config));
+	compilation_handle handle = new _compilation(*in, out, toConfiguration(config), options == NULL ? "" : options, callback, user_data);
+	handle->worker();
+	return handle;
+}
+
+int waitForCompilation(compilation_handle handle)
+{
+	handle->worker.waitFor();
+	return handle->result;
+}
+
+int isCompilationFinished(compilation_handle handle)
+{
+	const CompilationState state = handle->state;
+	return state == CompilationState::FINISHED || state == CompilationState::CANCELLED ? 1 : 0;
+}
+
+int cancelCompilation(compilation_handle handle)
+{
+	CompilationState expected = CompilationState::PENDING;
+	if(handle->state.compare_exchange_strong(expected, CompilationState::CANCELLED))
+		return 0;
+	if(expected != CompilationState::RUNNING)
+		return -1;
+	//the running compilation is aborted at its next check
+	handle->config.cancellationToken->store(true);
+	return 0;
+}
+
+void releaseCompilation(compilation_handle handle)
+{
+	handle->worker.waitFor();
+	delete handle;
+}
+
+struct _lazy_program
+{
+	_lazy_program(std::istream& input, const Configuration& config, const std::string& options, const Optional<std::string>& inputFile, const LogLevel level) :
+		logLevel(level), compilation(input, config, options, inputFile)
+	{
+	}
+
+	//the log-level is applied to every call, since they can be made from different threads
+	const LogLevel logLevel;
+	LazyCompilation compilation;
+};
+
+lazy_program_handle createLazyProgram(const storage* in, const configuration config, const char* options)
+{
+	const LogLevel level = configureLogger(config);
+	const LogLevelScope logScope(level);
+	try
+	{
+		const std::string optionsString(options == NULL ? "" : options);
+		if(in->is_file)
+		{
+			std::ifstream input(in->file_name, std::ios_base::in);
+			return new _lazy_program(input, toConfiguration(config), optionsString, std::string(in->file_name), level);
+		}
+		MemoryStreamBuffer inputBuffer(in->data, in->data_length);
+		std::istream input(&inputBuffer);
+		return new _lazy_program(input, toConfiguration(config), optionsString, {}, level);
+	}
+	catch(const CompilationError& err)
+	{
+		reportError(err);
+		return NULL;
+	}
+}
+
+int compileLazyKernel(lazy_program_handle program, const char* kernel_name)
+{
+	const LogLevelScope logScope(program->logLevel);
+	try
+	{
+		program->compilation.compileKernel(kernel_name);
+		return 0 /* CL_SUCCESS */;
+	}
+	catch(const CompilationError& err)
+	{
+		reportError(err);
+		return -15 /* CL_COMPILE_PROGRAM_FAILURE */;
+	}
+}
+
+int writeLazyProgram(lazy_program_handle program, storage* out)
+{
+	const LogLevelScope logScope(program->logLevel);
+	try
+	{
+		if(out->is_file)
+		{
+			std::ofstream output(out->file_name, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+			return program->compilation.writeOutput(output) > 0 ? 0 /* CL_SUCCESS */ : -15 /* CL_COMPILE_PROGRAM_FAILURE */;
+		}
+		OutputMemoryStreamBuffer outputBuffer(out->data, out->data_length);
+		std::ostream output(&outputBuffer);
+		const std::size_t bytesWritten = program->compilation.writeOutput(output);
+		//terminate the written data
+		const std::size_t dataSize = outputBuffer.size();
+		outputBuffer.reserve(dataSize + 1);
+		out->data[dataSize] = '\0';
+		return bytesWritten > 0 ? 0 /* CL_SUCCESS */ : -15 /* CL_COMPILE_PROGRAM_FAILURE */;
+	}
+	catch(const CompilationError& err)
+	{
+		reportError(err);
+		return -15 /* CL_COMPILE_PROGRAM_FAILURE */;
+	}
+}
+
+void releaseLazyProgram(lazy_program_handle program)
+{
+	delete program;
+}
+
+struct _kernel_bundle
+{
+	explicit _kernel_bundle(const char* fileName) : bundle(fileName)
+	{
+	}
+
+	KernelBundle bundle;
+	std::mutex lock;
+	//the decompressed programs by their offset, the programs of several entries are shared
+	std::map<uint32_t, std::string> decompressedPrograms;
+};
+
+bundle_handle openKernelBundle(const char* file_name)
+{
+	try
+	{
+		return new _kernel_bundle(file_name);
+	}
+	catch(const CompilationError& e)
+	{
+		logging::error() << e.what() << logging::endl;
+		return NULL;
+	}
+}
+
+unsigned long long getConfigurationHash(const configuration config, const unsigned num_dimensions, const unsigned* local_sizes, const unsigned* global_sizes)
+{
+	//same as for compiling the specialized code, see convertSpecialized()
+	Configuration realConfig = toConfiguration(config);
+	if(local_sizes != NULL)
+		realConfig.specializedLocalSizes.assign(local_sizes, local_sizes + num_dimensions);
+	if(global_sizes != NULL)
+		realConfig.specializedGlobalSizes.assign(global_sizes, global_sizes + num_dimensions);
+	return vc4c::getConfigurationHash(realConfig);
+}
+
+int findBundledProgram(bundle_handle bundle, const char* kernel_name, unsigned long long configuration_hash, const char** data, unsigned long* length)
+{
+	const BundleEntry* entry = bundle->bundle.findEntry(kernel_name, configuration_hash);
+	if(entry == nullptr)
+		return -46 /* CL_INVALID_KERNEL_NAME */;
+	if(!(entry->flags & BUNDLE_FLAG_COMPRESSED))
+	{
+		*data = bundle->bundle.getProgramData(*entry);
+		*length = entry->programSize;
+		return 0 /* CL_SUCCESS */;
+	}
+	std::lock_guard<std::mutex> guard(bundle->lock);
+	auto it = bundle->decompressedPrograms.find(entry->programOffset);
+	if(it == bundle->decompressedPrograms.end())
+	{
+		try
+		{
+			it = bundle->decompressedPrograms.emplace(entry->programOffset,
+					decompressProgram(bundle->bundle.getProgramData(*entry), entry->programSize, entry->uncompressedSize)).first;
+		}
+		catch(const CompilationError& e)
+		{
+			logging::error() << e.what() << logging::endl;
+			return -11 /* CL_BUILD_PROGRAM_FAILURE */;
+		}
+	}
+	*data = it->second.data();
+	*length = it->second.size();
+	return 0 /* CL_SUCCESS */;
+}
+
+void closeKernelBundle(bundle_handle bundle)
+{
+	delete bundle;
+}
+
 void setErrorHandler(CompilationErrorHandler errorHandler, void* userData)
 {
     errorCallback = errorHandler;
@@ -11,7 +11,7 @@
 using namespace vc4c;
 using namespace vc4c::intermediate;
 
-BranchLabel::BranchLabel(const Local& label) : IntermediateInstruction(label.createReference())
+BranchLabel::BranchLabel(const Local& label) : IntermediateInstruction(InstructionKind::BRANCH_LABEL, label.createReference())
 {
 	setArgument(0, label.createReference());
 }
@@ -47,7 +47,7 @@ const Local* BranchLabel::getLabel() const
 }
 
 Branch::Branch(const Local* target, const ConditionCode condCode, const Value& cond) :
-IntermediateInstruction(NO_VALUE, condCode)
+IntermediateInstruction(InstructionKind::BRANCH, NO_VALUE, condCode)
 {
 	if(condCode != COND_ALWAYS && condCode != COND_ZERO_CLEAR && condCode != COND_ZERO_SET)
 		//only allow always and comparison for zero, since branches only work on boolean values (0, 1)
@@ -91,6 +91,14 @@ qpu_asm::Instruction* Branch::convertToAsm(const FastMap<const Local*, Register>
 			cond = BranchCond::ALL_Z_CLEAR;
 		else if(conditional == COND_ZERO_SET)
 			cond = BranchCond::ALL_Z_SET;
+		else if(conditional == COND_NEGATIVE_CLEAR)
+			cond = BranchCond::ALL_N_CLEAR;
+		else if(conditional == COND_NEGATIVE_SET)
+			cond = BranchCond::ALL_N_SET;
+		else if(conditional == COND_CARRY_CLEAR)
+			cond = BranchCond::ALL_C_CLEAR;
+		else if(conditional == COND_CARRY_SET)
+			cond = BranchCond::ALL_C_SET;
 		else
 			throw CompilationError(CompilationStep::CODE_GENERATION, "Unhandled branch condition depending on all elements", conditional.toString());
 	}
@@ -115,7 +123,7 @@ const Value Branch::getCondition() const
 }
 
 PhiNode::PhiNode(const Value& dest, const std::vector<std::pair<Value, const Local*>>& labelPairs, const ConditionCode& cond, const SetFlag setFlags) :
-		IntermediateInstruction(dest, cond, setFlags)
+		IntermediateInstruction(InstructionKind::PHI_NODE, dest, cond, setFlags)
 {
 	for(std::size_t i = 0; i < labelPairs.size(); ++i)
 	{
@@ -12,7 +12,7 @@ using namespace vc4c;
 using namespace vc4c::intermediate;
 
 SemaphoreAdjustment::SemaphoreAdjustment(const Semaphore semaphore, const bool increase, const ConditionCode& cond, const SetFlag setFlags) :
-IntermediateInstruction(NO_VALUE, cond, setFlags), semaphore(semaphore), increase(increase)
+IntermediateInstruction(InstructionKind::SEMAPHORE_ADJUSTMENT, NO_VALUE, cond, setFlags), semaphore(semaphore), increase(increase)
 {
 
 }
@@ -37,7 +37,7 @@ IntermediateInstruction* SemaphoreAdjustment::copyFor(Method& method, const std:
     return (new SemaphoreAdjustment(semaphore, increase, conditional, setFlags))->copyExtrasFrom(this);
 }
 
-MemoryBarrier::MemoryBarrier(const MemoryScope scope, const MemorySemantics semantics) : IntermediateInstruction(NO_VALUE), scope(scope), semantics(semantics)
+MemoryBarrier::MemoryBarrier(const MemoryScope scope, const MemorySemantics semantics) : IntermediateInstruction(InstructionKind::MEMORY_BARRIER, NO_VALUE), scope(scope), semantics(semantics)
 {
 
 }
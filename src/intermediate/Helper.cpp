@@ -6,6 +6,9 @@
 
 #include <config.h>
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <limits>
 
 #include "Helper.h"
 #include "CompilationError.h"
@@ -164,6 +167,276 @@ static bool checkIndicesNotUndefined(const ContainerValue& container, const unsi
 	return true;
 }
 
+/*
+ * The kinds of per-element conditions, which can be created with at most two flag-setting operations on the element-number
+ */
+enum class LaneConditionType
+{
+	//all elements, no flags required
+	ALL,
+	//(element & mask) == 0
+	AND_ZERO,
+	//(element & mask) != 0, for a single-bit mask
+	AND_NOT_ZERO,
+	//element == value
+	EQUALS,
+	//(element ^ value) & mask == 0, requires two operations
+	MASKED_EQUALS,
+	//element < value
+	LESS,
+	//element >= value
+	GREATER_EQUALS
+};
+
+struct LaneCondition
+{
+	LaneConditionType type;
+	//the bit-set of the elements this condition is met for
+	uint32_t lanes;
+	long mask;
+	long value;
+	//the number of operations required to set the flags
+	unsigned cost;
+};
+
+static unsigned countLanes(const uint32_t lanes)
+{
+	return static_cast<unsigned>(std::bitset<16>(lanes).count());
+}
+
+static const std::vector<LaneCondition>& getLaneConditions()
+{
+	static const std::vector<LaneCondition> conditions = []() -> std::vector<LaneCondition>
+	{
+		std::vector<LaneCondition> result;
+		//all sub-cubes of the 4-bit element numbers, e.g. all even elements or all elements of a quad
+		for(long mask = 0; mask < 16; ++mask)
+		{
+			for(long value = 0; value < 16; ++value)
+			{
+				if((value & ~mask) != 0)
+					continue;
+				uint32_t lanes = 0;
+				for(long lane = 0; lane < 16; ++lane)
+				{
+					if((lane & mask) == value)
+						lanes |= 1u << lane;
+				}
+				if(mask == 0)
+					result.push_back(LaneCondition{LaneConditionType::ALL, lanes, mask, value, 0});
+				else if(value == 0)
+					result.push_back(LaneCondition{LaneConditionType::AND_ZERO, lanes, mask, value, 1});
+				else if(value == mask && countLanes(static_cast<uint32_t>(mask)) == 1)
+					result.push_back(LaneCondition{LaneConditionType::AND_NOT_ZERO, lanes, mask, value, 1});
+				else if(mask == 0xF)
+					result.push_back(LaneCondition{LaneConditionType::EQUALS, lanes, mask, value, 1});
+				else
+					result.push_back(LaneCondition{LaneConditionType::MASKED_EQUALS, lanes, mask, value, 2});
+			}
+		}
+		//all ranges starting at the first or ending at the last element
+		for(long value = 1; value < 16; ++value)
+		{
+			result.push_back(LaneCondition{LaneConditionType::LESS, (1u << value) - 1, 0, value, 1});
+			result.push_back(LaneCondition{LaneConditionType::GREATER_EQUALS, 0xFFFFu & ~((1u << value) - 1), 0, value, 1});
+		}
+		return result;
+	}();
+	return conditions;
+}
+
+/*
+ * Greedily selects the cheapest conditions to write all the target elements, only writing elements in the allowed set
+ */
+static std::vector<const LaneCondition*> coverLanes(const uint32_t targetLanes, const uint32_t allowedLanes, unsigned& cost)
+{
+	std::vector<const LaneCondition*> result;
+	uint32_t remaining = targetLanes;
+	while(remaining != 0)
+	{
+		const LaneCondition* best = nullptr;
+		unsigned bestGain = 0;
+		for(const LaneCondition& cond : getLaneConditions())
+		{
+			if((cond.lanes & ~allowedLanes) != 0)
+				continue;
+			const unsigned gain = countLanes(cond.lanes & remaining);
+			//every condition costs its flag-setting operations plus the conditional move
+			if(gain != 0 && (best == nullptr || gain * (best->cost + 1) > bestGain * (cond.cost + 1)))
+			{
+				best = &cond;
+				bestGain = gain;
+			}
+		}
+		//there is always the condition for a single element
+		result.push_back(best);
+		cost += best->cost + 1;
+		remaining &= ~best->lanes;
+	}
+	return result;
+}
+
+/*
+ * A vector containing some of the elements of the shuffle result at their correct positions
+ */
+struct ShuffleSource
+{
+	//the index of the source vector
+	unsigned char source;
+	//whether the vector is a broadcast of a single source element instead of a rotation of the source vector
+	bool isBroadcast;
+	//the rotation offset (upwards) or the broadcast source element
+	unsigned char offset;
+	//the elements this vector provides correctly
+	uint32_t lanes;
+	//the number of operations required to create this vector
+	unsigned cost;
+};
+
+struct ShuffleStep
+{
+	ShuffleSource source;
+	std::vector<const LaneCondition*> conditions;
+};
+
+/*
+ * Plans the instructions for a shuffle with a constant mask.
+ *
+ * Every element of the result can be taken from the source vector rotated by the difference of the element positions, or from the broadcast of the source element.
+ * Elements sharing a rotation offset or source element are grouped and written with as few conditional moves as possible,
+ * choosing greedily the vector which writes the most elements per operation.
+ */
+static std::vector<ShuffleStep> planVectorShuffle(const ContainerValue& mask, const unsigned char firstVectorWidth)
+{
+	std::array<std::array<uint32_t, 16>, 2> rotationLanes;
+	std::array<std::array<uint32_t, 16>, 2> broadcastLanes;
+	for(std::size_t s = 0; s < 2; ++s)
+	{
+		rotationLanes[s].fill(0);
+		broadcastLanes[s].fill(0);
+	}
+	uint32_t definedLanes = 0;
+	for(std::size_t i = 0; i < mask.elements.size(); ++i)
+	{
+		const Value& index = mask.elements.at(i);
+		if(index.isUndefined())
+			//don't write anything at this position
+			continue;
+		if(!index.hasType(ValueType::LITERAL) || index.literal.integer < 0 || index.literal.integer >= 2 * firstVectorWidth)
+			throw CompilationError(CompilationStep::GENERAL, "Invalid mask value", index.to_string());
+		const std::size_t source = index.literal.integer < firstVectorWidth ? 0 : 1;
+		const std::size_t element = static_cast<std::size_t>(index.literal.integer) - source * firstVectorWidth;
+		rotationLanes[source][(i + 16 - element) % 16] |= 1u << i;
+		broadcastLanes[source][element] |= 1u << i;
+		definedLanes |= 1u << i;
+	}
+	//the elements not defined by the mask (or outside of the result vector) can be overwritten with anything
+	const uint32_t undefinedLanes = 0xFFFFu & ~definedLanes;
+
+	std::vector<ShuffleSource> candidates;
+	for(unsigned char s = 0; s < 2; ++s)
+	{
+		for(unsigned char offset = 0; offset < 16; ++offset)
+		{
+			if(rotationLanes[s][offset] != 0)
+				//reading the source vector directly requires no rotation
+				candidates.push_back(ShuffleSource{s, false, offset, rotationLanes[s][offset], offset == 0 ? 0u : 1u});
+			if(broadcastLanes[s][offset] != 0 && countLanes(broadcastLanes[s][offset]) > 1)
+				//rotation to the first element (if required), writing and reading the replication register
+				candidates.push_back(ShuffleSource{s, true, offset, broadcastLanes[s][offset], offset == 0 ? 2u : 3u});
+		}
+	}
+
+	std::vector<ShuffleStep> steps;
+	uint32_t remaining = definedLanes;
+	while(remaining != 0)
+	{
+		const ShuffleSource* best = nullptr;
+		std::vector<const LaneCondition*> bestConditions;
+		unsigned bestGain = 0;
+		unsigned bestCost = 0;
+		for(const ShuffleSource& candidate : candidates)
+		{
+			const unsigned gain = countLanes(candidate.lanes & remaining);
+			if(gain == 0)
+				continue;
+			unsigned cost = candidate.cost;
+			auto conditions = coverLanes(candidate.lanes & remaining, candidate.lanes | undefinedLanes, cost);
+			if(best == nullptr || gain * bestCost > bestGain * cost)
+			{
+				best = &candidate;
+				bestConditions = std::move(conditions);
+				bestGain = gain;
+				bestCost = cost;
+			}
+		}
+		steps.push_back(ShuffleStep{*best, std::move(bestConditions)});
+		remaining &= ~best->lanes;
+	}
+	return steps;
+}
+
+static ConditionCode insertLaneCondition(InstructionWalker& it, Method& method, const LaneCondition& cond)
+{
+	switch(cond.type)
+	{
+		case LaneConditionType::ALL:
+			return COND_ALWAYS;
+		case LaneConditionType::AND_ZERO:
+			it.emplace(new Operation("and", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, Value(Literal(cond.mask), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+			it.nextInBlock();
+			return COND_ZERO_SET;
+		case LaneConditionType::AND_NOT_ZERO:
+			it.emplace(new Operation("and", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, Value(Literal(cond.mask), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+			it.nextInBlock();
+			return COND_ZERO_CLEAR;
+		case LaneConditionType::EQUALS:
+			it.emplace(new Operation("xor", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, Value(Literal(cond.value), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+			it.nextInBlock();
+			return COND_ZERO_SET;
+		case LaneConditionType::MASKED_EQUALS:
+		{
+			const Value tmp = method.addNewLocal(ELEMENT_NUMBER_REGISTER.type, "%vector_shuffle");
+			it.emplace(new Operation("xor", tmp, ELEMENT_NUMBER_REGISTER, Value(Literal(cond.value), TYPE_INT8)));
+			it.nextInBlock();
+			it.emplace(new Operation("and", NOP_REGISTER, tmp, Value(Literal(cond.mask), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+			it.nextInBlock();
+			return COND_ZERO_SET;
+		}
+		case LaneConditionType::LESS:
+			it.emplace(new Operation("sub", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, Value(Literal(cond.value), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+			it.nextInBlock();
+			return COND_NEGATIVE_SET;
+		case LaneConditionType::GREATER_EQUALS:
+			it.emplace(new Operation("sub", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, Value(Literal(cond.value), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+			it.nextInBlock();
+			return COND_NEGATIVE_CLEAR;
+	}
+	throw CompilationError(CompilationStep::GENERAL, "Unhandled lane condition", std::to_string(static_cast<unsigned>(cond.type)));
+}
+
+/*
+ * Creates the vector for the shuffle source and returns the value containing the elements at their result positions
+ */
+static Value insertShuffleSource(InstructionWalker& it, Method& method, const ShuffleSource& source, const Value& sourceVector, const Value& dest)
+{
+	if(source.isBroadcast)
+	{
+		Value element = sourceVector;
+		if(source.offset != 0)
+		{
+			element = method.addNewLocal(sourceVector.type, "%vector_shuffle");
+			it = insertVectorRotation(it, sourceVector, Value(Literal(static_cast<long>(source.offset)), TYPE_INT8), element, Direction::DOWN);
+		}
+		it = insertReplication(it, element, dest);
+		return dest;
+	}
+	if(source.offset == 0)
+		return sourceVector;
+	it = insertVectorRotation(it, sourceVector, Value(Literal(static_cast<long>(source.offset)), TYPE_INT8), dest, Direction::UP);
+	return dest;
+}
+
 InstructionWalker intermediate::insertVectorShuffle(InstructionWalker it, Method& method, const Value& destination, const Value& source0, const Value& source1, const Value& mask)
 {
     if(mask.isUndefined())
@@ -214,29 +487,41 @@ InstructionWalker intermediate::insertVectorShuffle(InstructionWalker it, Method
         return insertReplication(it, tmp, destination);
     }
     
+    if(mask.container.elements.size() > 16)
+    	throw CompilationError(CompilationStep::GENERAL, "Invalid mask for vector shuffle", mask.to_string(false, true));
+    const std::vector<ShuffleStep> steps = planVectorShuffle(mask.container, static_cast<unsigned char>(source0.type.getVectorWidth()));
+    if(steps.size() == 1 && steps.front().conditions.size() == 1 && steps.front().conditions.front()->type == LaneConditionType::ALL)
+    {
+    	//a single rotation or broadcast writes all elements (e.g. rotating the vector), so we can write the destination directly
+    	const ShuffleSource& source = steps.front().source;
+    	const Value result = insertShuffleSource(it, method, source, source.source == 0 ? source0 : source1, destination);
+    	if(result != destination)
+    	{
+    		it.emplace(new MoveOperation(destination, result));
+    		it.nextInBlock();
+    	}
+    	return it;
+    }
+
     //zero out destination first, also required so register allocator finds unconditional write to destination
-    if(destination.hasType(ValueType::LOCAL) && destination.local->getUsers(LocalUser::Type::WRITER).empty())
+    if(destination.hasType(ValueType::LOCAL) && destination.local->getUsers().getNumWriters() == 0)
     {
 		it.emplace(new intermediate::MoveOperation(destination, INT_ZERO));
 		it.nextInBlock();
     }
 
     //mask is container of literals, indices have arbitrary order
-    for(std::size_t i = 0; i < mask.container.elements.size(); ++i)
+    for(const ShuffleStep& step : steps)
     {
-        Value index = mask.container.elements.at(i);
-        if(index.isUndefined())
-        	//don't write anything at this position
-        	continue;
-        if(!index.hasType(ValueType::LITERAL))
-        	throw CompilationError(CompilationStep::GENERAL, "Invalid mask value", mask.to_string(false, true));
-        const Value& container = index.literal.integer < static_cast<long>(source0.type.getVectorWidth()) ? source0 : source1;
-        if(index.literal.integer >= static_cast<long>(source0.type.getVectorWidth()))
-        	index.literal.integer = index.literal.integer - source0.type.getVectorWidth();
-        index.type = TYPE_INT8;
-        const Value tmp = method.addNewLocal(container.type.getElementType(), "%vector_shuffle");
-        it = insertVectorExtraction(it, method, container, index, tmp);
-        it = insertVectorInsertion(it, method, destination, Value(Literal(static_cast<long>(i)), TYPE_INT8), tmp);
+    	const Value tmp = method.addNewLocal(destination.type, "%vector_shuffle");
+    	const Value value = insertShuffleSource(it, method, step.source, step.source.source == 0 ? source0 : source1, tmp);
+    	for(const LaneCondition* cond : step.conditions)
+    	{
+    		const ConditionCode condCode = insertLaneCondition(it, method, *cond);
+    		it.emplace(new MoveOperation(destination, value, condCode));
+    		it->setDecorations(InstructionDecorations::ELEMENT_INSERTION);
+    		it.nextInBlock();
+    	}
     }
     return it;
 }
@@ -303,7 +588,9 @@ InstructionWalker intermediate::insertSignExtension(InstructionWalker it, Method
     }
     
     //TODO this literal here is wrong for usage in CodeGenerator
-    const Value widthDiff(Literal(static_cast<long>(dest.type.getScalarBitCount() - src.type.getScalarBitCount())), TYPE_INT8);
+    //the (lower word of) 64-bit destinations is sign-extended to 32 bit, the upper word is set by lowering the 64-bit operations
+    const long destWidth = std::min(static_cast<long>(dest.type.getScalarBitCount()), 32L);
+    const Value widthDiff(Literal(destWidth - static_cast<long>(src.type.getScalarBitCount())), TYPE_INT8);
     // TODO unpack-mode can sign-extend
     // out = asr(shl(in, bit_diff) bit_diff)
     const Value tmp = method.addNewLocal(TYPE_INT32, "%sext");
@@ -339,13 +626,24 @@ InstructionWalker intermediate::insertSaturation(InstructionWalker it, Method& m
 	}
 	else	//saturation can be easily done via pack-modes
 	{
+		//there are no pack-modes saturating to signed char and unsigned short, so they are clamped with the native min/max operations
+		const auto insertClamp = [&](const long minValue, const long maxValue) -> InstructionWalker
+		{
+			const Value tmp = method.addNewLocal(TYPE_INT32, "%saturate");
+			it.emplace(new Operation("max", tmp, src, Value(Literal(minValue), TYPE_INT32)));
+			it.nextInBlock();
+			return it.emplace(new Operation("min", dest, tmp, Value(Literal(maxValue), TYPE_INT32)));
+		};
 		switch(dest.type.getScalarBitCount())
 		{
-			//TODO truncation is wrong!!
 			case 8:
-				return it.emplace((new MoveOperation(dest, src))->setPackMode(isSigned ? PACK_INT_TO_CHAR_TRUNCATE : PACK_INT_TO_UNSIGNED_CHAR_SATURATE));
+				if(isSigned)
+					return insertClamp(std::numeric_limits<int8_t>::min(), std::numeric_limits<int8_t>::max());
+				return it.emplace((new MoveOperation(dest, src))->setPackMode(PACK_INT_TO_UNSIGNED_CHAR_SATURATE));
 			case 16:
-				return it.emplace((new MoveOperation(dest, src))->setPackMode(isSigned ? PACK_INT_TO_SIGNED_SHORT_SATURATE : PACK_INT_TO_SHORT_TRUNCATE));
+				if(!isSigned)
+					return insertClamp(std::numeric_limits<uint16_t>::min(), std::numeric_limits<uint16_t>::max());
+				return it.emplace((new MoveOperation(dest, src))->setPackMode(PACK_INT_TO_SIGNED_SHORT_SATURATE));
 			case 32:
 				return it.emplace((new MoveOperation(dest, src))->setPackMode(PACK_32_32));
 			default:
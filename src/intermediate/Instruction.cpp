@@ -50,13 +50,23 @@ std::string intermediate::toString(const InstructionDecorations decoration)
 	return res.substr(0, res.empty() ? 0 : res.size() - 1);
 }
 
-IntermediateInstruction::IntermediateInstruction(Optional<Value> output, ConditionCode cond, SetFlag setFlags, Pack packMode) :
-signal(Signaling::NO_SIGNAL), unpackMode(UNPACK_NOP),  packMode(packMode), conditional(cond), setFlags(setFlags), decoration(InstructionDecorations::NONE), canBeCombined(true), output(output), arguments()
+IntermediateInstruction::IntermediateInstruction(InstructionKind kind, Optional<Value> output, ConditionCode cond, SetFlag setFlags, Pack packMode) : InstructionListNode(this),
+signal(Signaling::NO_SIGNAL), unpackMode(UNPACK_NOP),  packMode(packMode), conditional(cond), setFlags(setFlags), decoration(InstructionDecorations::NONE), canBeCombined(true), kind(kind), output(output), arguments()
 {
 	if(output.hasValue)
 		addAsUserToValue(output, LocalUser::Type::WRITER);
 }
 
+void* IntermediateInstruction::operator new(std::size_t size)
+{
+	return InstructionArena::allocate(size);
+}
+
+void IntermediateInstruction::operator delete(void* ptr) noexcept
+{
+	InstructionArena::deallocate(ptr);
+}
+
 IntermediateInstruction::~IntermediateInstruction()
 {
 	//this can't be in LocalUser
@@ -162,9 +172,9 @@ bool IntermediateInstruction::firesSignal(bool ignoreImmediates) const
 
 bool IntermediateInstruction::hasSideEffects() const
 {
-	if(dynamic_cast<const Branch*>(this) != nullptr)
+	if(is<Branch>())
 		return true;
-	if(dynamic_cast<const SemaphoreAdjustment*>(this) != nullptr)
+	if(is<SemaphoreAdjustment>())
 		return true;
 	if(hasValueType(ValueType::REGISTER) && output.get().reg.hasSideEffectsOnWrite())
 		return true;
@@ -278,30 +288,19 @@ Optional<Value> IntermediateInstruction::getPrecalculatedValueForArg(const std::
 	return NO_VALUE;
 }
 
-FastMap<const Local*, LocalUser::Type> IntermediateInstruction::getUsedLocals() const
+LocalUses IntermediateInstruction::getUsedLocals() const
 {
-	FastMap<const Local*, LocalUser::Type> locals;
+	LocalUses locals;
 	if(output.hasValue && output.get().hasType(ValueType::LOCAL))
-		locals.emplace(output.get().local, LocalUser::Type::WRITER);
+		locals.add(output.get().local, LocalUser::Type::WRITER);
 	for(const Value& arg : arguments)
 	{
 		if(arg.hasType(ValueType::LOCAL))
-			locals.emplace(arg.local, LocalUser::Type::READER);
+			locals.add(arg.local, LocalUser::Type::READER);
 	}
 	return locals;
 }
 
-void IntermediateInstruction::forUsedLocals(const std::function<void(const Local*, LocalUser::Type)>& consumer) const
-{
-	if(output.hasValue && output.get().hasType(ValueType::LOCAL))
-		consumer(output.get().local, LocalUser::Type::WRITER);
-	for(const Value& arg : arguments)
-	{
-		if(arg.hasType(ValueType::LOCAL))
-			consumer(arg.local, LocalUser::Type::READER);
-	}
-}
-
 bool IntermediateInstruction::readsLocal(const Local* local) const
 {
 	for(const auto& arg : arguments)
@@ -0,0 +1,138 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "InstructionArena.h"
+
+#include <algorithm>
+#include <new>
+
+using namespace vc4c;
+using namespace vc4c::intermediate;
+
+/*
+ * Prepended to every allocation to find the owning arena (or none for heap-allocations) on deallocation.
+ * Has the size of the maximum alignment, so the instruction itself is properly aligned
+ */
+struct alignas(16) AllocationHeader
+{
+	InstructionArena* arena;
+	std::size_t sizeClass;
+};
+
+static thread_local InstructionArena* activeArena = nullptr;
+
+InstructionArena::InstructionArena() : references(1), nextFree(nullptr), remainingSize(0), freeBlocks(), usedSize(0), peakSize(0)
+{
+
+}
+
+InstructionArena* InstructionArena::create()
+{
+	return new InstructionArena();
+}
+
+void InstructionArena::release()
+{
+	dropReference();
+}
+
+void* InstructionArena::allocate(std::size_t size)
+{
+	const std::size_t sizeClass = (size + sizeof(AllocationHeader) + GRANULARITY - 1) / GRANULARITY;
+	InstructionArena* arena = activeArena;
+	AllocationHeader* header = nullptr;
+	if(arena == nullptr || sizeClass >= NUM_SIZE_CLASSES)
+	{
+		//no arena active or too big for the size-classes
+		header = static_cast<AllocationHeader*>(::operator new(size + sizeof(AllocationHeader)));
+		header->arena = nullptr;
+	}
+	else
+	{
+		header = static_cast<AllocationHeader*>(arena->allocateBlock(sizeClass));
+		header->arena = arena;
+	}
+	header->sizeClass = sizeClass;
+	return header + 1;
+}
+
+void InstructionArena::deallocate(void* ptr) noexcept
+{
+	if(ptr == nullptr)
+		return;
+	AllocationHeader* header = static_cast<AllocationHeader*>(ptr) - 1;
+	if(header->arena == nullptr)
+		::operator delete(header);
+	else
+		header->arena->freeBlock(header, header->sizeClass);
+}
+
+InstructionArena::Scope::Scope(InstructionArena* arena) : previous(activeArena)
+{
+	activeArena = arena;
+}
+
+InstructionArena::Scope::~Scope()
+{
+	activeArena = previous;
+}
+
+std::size_t InstructionArena::getPeakUsage() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return peakSize;
+}
+
+std::size_t InstructionArena::getReservedSize() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return chunks.size() * CHUNK_SIZE;
+}
+
+void* InstructionArena::allocateBlock(std::size_t sizeClass)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	++references;
+	usedSize += sizeClass * GRANULARITY;
+	peakSize = std::max(peakSize, usedSize);
+	if(freeBlocks[sizeClass] != nullptr)
+	{
+		FreeBlock* block = freeBlocks[sizeClass];
+		freeBlocks[sizeClass] = block->next;
+		return block;
+	}
+	const std::size_t blockSize = sizeClass * GRANULARITY;
+	if(remainingSize < blockSize)
+	{
+		//the rest of the current chunk is wasted, but this is at most the size of the largest size-class
+		chunks.emplace_back(new char[CHUNK_SIZE]);
+		nextFree = chunks.back().get();
+		remainingSize = CHUNK_SIZE;
+	}
+	void* block = nextFree;
+	nextFree += blockSize;
+	remainingSize -= blockSize;
+	return block;
+}
+
+void InstructionArena::freeBlock(void* block, std::size_t sizeClass) noexcept
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		FreeBlock* freeBlock = static_cast<FreeBlock*>(block);
+		freeBlock->next = freeBlocks[sizeClass];
+		freeBlocks[sizeClass] = freeBlock;
+		usedSize -= sizeClass * GRANULARITY;
+	}
+	dropReference();
+}
+
+void InstructionArena::dropReference() noexcept
+{
+	if(--references == 0)
+		//frees all chunks at once
+		delete this;
+}
@@ -0,0 +1,108 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef INSTRUCTION_ARENA_H
+#define INSTRUCTION_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "helper.h"
+
+namespace vc4c
+{
+	namespace intermediate
+	{
+		/*
+		 * Memory-pool for the instructions of a single method.
+		 *
+		 * The memory for instructions is taken from big chunks and freed instructions are recycled via free-lists per size-class.
+		 * This gives cheaper allocations and better locality when walking the instructions of a method.
+		 *
+		 * The arena is reference-counted: the owning method and every instruction allocated from it hold a reference,
+		 * so an instruction outliving its method (e.g. moved into another method) stays valid.
+		 * The chunks are freed in bulk once the last reference is dropped.
+		 *
+		 * Instructions are only allocated from an arena, if it is activated for the current thread via an InstructionArena::Scope,
+		 * otherwise they are allocated on the heap.
+		 */
+		class InstructionArena : private NonCopyable
+		{
+		public:
+			/*
+			 * Creates a new arena with a single reference held by the caller
+			 */
+			static InstructionArena* create();
+			/*
+			 * Drops the reference of the owner of this arena
+			 */
+			void release();
+
+			/*
+			 * Allocates memory from the arena active for the current thread, falls back to the heap if there is none
+			 */
+			static void* allocate(std::size_t size);
+			/*
+			 * Frees memory allocated via #allocate
+			 */
+			static void deallocate(void* ptr) noexcept;
+
+			/*
+			 * Returns the maximum number of bytes allocated from this arena at the same time (including the allocation headers)
+			 */
+			std::size_t getPeakUsage() const;
+			/*
+			 * Returns the number of bytes reserved for the chunks of this arena
+			 */
+			std::size_t getReservedSize() const;
+
+			/*
+			 * Activates the given arena for the current thread for the lifetime of this object
+			 */
+			class Scope : private NonCopyable
+			{
+			public:
+				explicit Scope(InstructionArena* arena);
+				~Scope();
+
+			private:
+				InstructionArena* previous;
+			};
+
+		private:
+			struct FreeBlock
+			{
+				FreeBlock* next;
+			};
+
+			static constexpr std::size_t GRANULARITY = 16;
+			static constexpr std::size_t NUM_SIZE_CLASSES = 48;
+			static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+			mutable std::mutex lock;
+			std::atomic<std::size_t> references;
+			std::vector<std::unique_ptr<char[]>> chunks;
+			char* nextFree;
+			std::size_t remainingSize;
+			FreeBlock* freeBlocks[NUM_SIZE_CLASSES];
+			//the number of bytes currently allocated and the high-water mark
+			std::size_t usedSize;
+			std::size_t peakSize;
+
+			InstructionArena();
+			~InstructionArena() = default;
+
+			void* allocateBlock(std::size_t sizeClass);
+			void freeBlock(void* block, std::size_t sizeClass) noexcept;
+			void dropReference() noexcept;
+		};
+	} /* namespace intermediate */
+} /* namespace vc4c */
+
+#endif /* INSTRUCTION_ARENA_H */
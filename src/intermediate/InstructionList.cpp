@@ -0,0 +1,122 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "InstructionList.h"
+#include "IntermediateInstruction.h"
+
+using namespace vc4c;
+using namespace vc4c::intermediate;
+
+InstructionList::InstructionList() : head(), numNodes(0), numModifications(0)
+{
+	head.prev = &head;
+	head.next = &head;
+}
+
+InstructionList::~InstructionList()
+{
+	clear();
+}
+
+IntermediateInstruction* InstructionList::front() const
+{
+	return head.next->instruction;
+}
+
+InstructionList::iterator InstructionList::emplace(iterator pos, IntermediateInstruction* instr)
+{
+	InstructionListNode* node = checkPointer(instr);
+	if(node->next != nullptr || node->prev != nullptr)
+		throw CompilationError(CompilationStep::GENERAL, "Instruction is already part of a basic block", instr->to_string());
+	link(node, pos.node);
+	++numNodes;
+	++numModifications;
+	return iterator(node);
+}
+
+void InstructionList::emplace_back(IntermediateInstruction* instr)
+{
+	emplace(end(), instr);
+}
+
+InstructionList::iterator InstructionList::erase(iterator pos)
+{
+	InstructionListNode* next = pos.node->next;
+	unlink(pos.node);
+	--numNodes;
+	++numModifications;
+	freeNode(pos.node);
+	return iterator(next);
+}
+
+IntermediateInstruction* InstructionList::release(iterator& pos)
+{
+	IntermediateInstruction* instr = pos.node->instruction;
+	if(instr == nullptr)
+		//nothing to release
+		return nullptr;
+	InstructionListNode* placeHolder = new InstructionListNode();
+	link(placeHolder, pos.node);
+	unlink(pos.node);
+	pos.node = placeHolder;
+	++numModifications;
+	return instr;
+}
+
+void InstructionList::reset(iterator& pos, IntermediateInstruction* instr)
+{
+	InstructionListNode* old = pos.node;
+	if(old == checkPointer(instr))
+		return;
+	if(instr->next != nullptr || instr->prev != nullptr)
+		throw CompilationError(CompilationStep::GENERAL, "Instruction is already part of a basic block", instr->to_string());
+	link(instr, old);
+	unlink(old);
+	freeNode(old);
+	pos.node = instr;
+	++numModifications;
+}
+
+void InstructionList::clear()
+{
+	InstructionListNode* node = head.next;
+	while(node != &head)
+	{
+		InstructionListNode* next = node->next;
+		node->prev = nullptr;
+		node->next = nullptr;
+		freeNode(node);
+		node = next;
+	}
+	head.prev = &head;
+	head.next = &head;
+	numNodes = 0;
+	++numModifications;
+}
+
+void InstructionList::link(InstructionListNode* node, InstructionListNode* before)
+{
+	node->next = before;
+	node->prev = before->prev;
+	before->prev->next = node;
+	before->prev = node;
+}
+
+void InstructionList::unlink(InstructionListNode* node)
+{
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->prev = nullptr;
+	node->next = nullptr;
+}
+
+void InstructionList::freeNode(InstructionListNode* node)
+{
+	if(node->instruction != nullptr)
+		delete node->instruction;
+	else
+		delete node;
+}
@@ -0,0 +1,158 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef INSTRUCTION_LIST_H
+#define INSTRUCTION_LIST_H
+
+#include <cstddef>
+
+#include "helper.h"
+
+namespace vc4c
+{
+	namespace intermediate
+	{
+		class IntermediateInstruction;
+
+		/*
+		 * The links of the intrusive instruction-list.
+		 *
+		 * Every instruction is its own list-node, additionally there are nodes not holding any instruction:
+		 * the list-head of every list and the place-holders for released instructions.
+		 */
+		struct InstructionListNode : private NonCopyable
+		{
+			explicit InstructionListNode(IntermediateInstruction* instruction = nullptr) : prev(nullptr), next(nullptr), instruction(instruction)
+			{}
+
+			InstructionListNode* prev;
+			InstructionListNode* next;
+			//the instruction this node represents, nullptr for the list-head and place-holders
+			IntermediateInstruction* const instruction;
+		};
+
+		/*
+		 * Doubly-linked list of instructions with the links embedded in the instructions themselves.
+		 *
+		 * The list owns the instructions linked into it, so on erasing/clearing, the instructions are freed.
+		 *
+		 * NOTE: Since the instructions are the list-nodes, replacing an instruction (#reset) invalidates all other iterators to the replaced instruction!
+		 */
+		class InstructionList : private NonCopyable
+		{
+		public:
+			class iterator
+			{
+			public:
+				explicit iterator(InstructionListNode* node = nullptr) : node(node)
+				{}
+
+				inline IntermediateInstruction* operator*() const
+				{
+					return node->instruction;
+				}
+
+				inline iterator& operator++()
+				{
+					node = node->next;
+					return *this;
+				}
+
+				inline iterator& operator--()
+				{
+					node = node->prev;
+					return *this;
+				}
+
+				inline bool operator==(const iterator& other) const
+				{
+					return node == other.node;
+				}
+
+				inline bool operator!=(const iterator& other) const
+				{
+					return node != other.node;
+				}
+
+			private:
+				InstructionListNode* node;
+
+				friend class InstructionList;
+			};
+
+			InstructionList();
+			~InstructionList();
+
+			inline iterator begin() const
+			{
+				return iterator(head.next);
+			}
+
+			inline iterator end() const
+			{
+				return iterator(const_cast<InstructionListNode*>(&head));
+			}
+
+			inline bool empty() const
+			{
+				return numNodes == 0;
+			}
+
+			/*
+			 * The number of entries, including the place-holders of released instructions
+			 */
+			inline std::size_t size() const
+			{
+				return numNodes;
+			}
+
+			/*
+			 * The number of insertions, removals and replacements of entries since the creation of the list
+			 */
+			inline std::size_t getModificationCount() const
+			{
+				return numModifications;
+			}
+
+			/*
+			 * Returns the first instruction, nullptr if the list is empty or the first instruction was released
+			 */
+			IntermediateInstruction* front() const;
+
+			/*
+			 * Inserts the instruction (taking ownership) in front of the given position and returns the position of the inserted instruction
+			 */
+			iterator emplace(iterator pos, IntermediateInstruction* instr);
+			void emplace_back(IntermediateInstruction* instr);
+			/*
+			 * Removes and frees the entry at the given position and returns the position of the following entry
+			 */
+			iterator erase(iterator pos);
+			/*
+			 * Releases the ownership of the instruction at the given position.
+			 * The instruction is replaced with a place-holder and the position is updated to point to it
+			 */
+			IntermediateInstruction* release(iterator& pos);
+			/*
+			 * Replaces the entry at the given position with the new instruction, the previous instruction is freed.
+			 * The position is updated to point to the new instruction
+			 */
+			void reset(iterator& pos, IntermediateInstruction* instr);
+			void clear();
+
+		private:
+			InstructionListNode head;
+			std::size_t numNodes;
+			std::size_t numModifications;
+
+			static void link(InstructionListNode* node, InstructionListNode* before);
+			static void unlink(InstructionListNode* node);
+			static void freeNode(InstructionListNode* node);
+		};
+	} /* namespace intermediate */
+} /* namespace vc4c */
+
+#endif /* INSTRUCTION_LIST_H */
@@ -8,9 +8,11 @@
 #define INTERMEDIATEINSTRUCTION_H
 
 #include <map>
+#include <type_traits>
 
 #include "../Module.h"
 #include "helper.h"
+#include "InstructionArena.h"
 #include "../asm/OpCodes.h"
 #include "CompilationError.h"
 
@@ -70,18 +72,78 @@ namespace vc4c
 
 		std::string toString(const InstructionDecorations decoration);
 
+		/*
+		 * Tag identifying the concrete type of an instruction.
+		 *
+		 * The kinds of a class and all its sub-classes form a contiguous range (e.g. OPERATION to COMPARISON),
+		 * so type-checks can be done via a simple comparison instead of a dynamic_cast
+		 */
+		enum class InstructionKind : unsigned char
+		{
+			OPERATION,
+			COMPARISON,
+			LAST_OPERATION = COMPARISON,
+			METHOD_CALL,
+			RETURN,
+			MOVE,
+			VECTOR_ROTATION,
+			LAST_MOVE = VECTOR_ROTATION,
+			BRANCH_LABEL,
+			BRANCH,
+			NOP,
+			COMBINED_OPERATION,
+			LOAD_IMMEDIATE,
+			SEMAPHORE_ADJUSTMENT,
+			PHI_NODE,
+			MEMORY_BARRIER
+		};
+
 		/*
 		 * Converted to QPU instructions,
 		 * but still with method-calls and typed locals
 		 */
-		class IntermediateInstruction : public LocalUser
+		class IntermediateInstruction : public LocalUser, public InstructionListNode
 		{
 		public:
-			IntermediateInstruction(Optional<Value> output = { }, ConditionCode cond = COND_ALWAYS, SetFlag setFlags = SetFlag::DONT_SET, Pack packMode = PACK_NOP);
+			IntermediateInstruction(InstructionKind kind, Optional<Value> output = { }, ConditionCode cond = COND_ALWAYS, SetFlag setFlags = SetFlag::DONT_SET, Pack packMode = PACK_NOP);
 			virtual ~IntermediateInstruction();
 
-			FastMap<const Local*, LocalUser::Type> getUsedLocals() const override;
-			void forUsedLocals(const std::function<void(const Local*, LocalUser::Type)>& consumer) const override;
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return true;
+			}
+
+			/*
+			 * Checks via the instruction-kind, whether this instruction is of the given type (or one of its sub-types)
+			 */
+			template<typename T>
+			inline bool is() const
+			{
+				return std::remove_cv<T>::type::classof(this);
+			}
+
+			/*
+			 * Returns this instruction cast to the given type or nullptr, if it is not of this type
+			 */
+			template<typename T>
+			inline T* as()
+			{
+				return is<T>() ? static_cast<T*>(this) : nullptr;
+			}
+
+			template<typename T>
+			inline const T* as() const
+			{
+				return is<T>() ? static_cast<const T*>(this) : nullptr;
+			}
+
+			/*
+			 * Instructions are allocated in the InstructionArena active for the current thread, if any
+			 */
+			static void* operator new(std::size_t size);
+			static void operator delete(void* ptr) noexcept;
+
+			LocalUses getUsedLocals() const override;
 			bool readsLocal(const Local* local) const override;
 			bool writesLocal(const Local* local) const override;
 			void replaceLocal(const Local* oldLocal, const Local* newLocal, const Type type) override;
@@ -125,6 +187,7 @@ namespace vc4c
 			SetFlag setFlags;
 			InstructionDecorations decoration;
 			bool canBeCombined;
+			const InstructionKind kind;
 		protected:
 			const Value renameValue(Method& method, const Value& orig, const std::string& prefix) const;
 
@@ -148,6 +211,11 @@ namespace vc4c
 			Operation(const std::string& opCode, const Value& dest, const Value& arg0, const Value& arg1, const ConditionCode cond = COND_ALWAYS, const SetFlag setFlags = SetFlag::DONT_SET);
 			virtual ~Operation();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind >= InstructionKind::OPERATION && instr->kind <= InstructionKind::LAST_OPERATION;
+			}
+
 			std::string to_string() const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
@@ -159,6 +227,9 @@ namespace vc4c
 
 			std::string opCode;
 			CombinedOperation* parent;
+
+		protected:
+			Operation(InstructionKind kind, const std::string& opCode, const Value& dest, const Value& arg0, const Value& arg1, const ConditionCode cond, const SetFlag setFlags);
 		};
 
 		struct MethodCall: public IntermediateInstruction
@@ -167,6 +238,11 @@ namespace vc4c
 			MethodCall(const Value& dest, const std::string& methodName, const std::vector<Value>& args = { });
 			virtual ~MethodCall();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::METHOD_CALL;
+			}
+
 			std::string to_string() const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
@@ -184,6 +260,11 @@ namespace vc4c
 			Return();
 			virtual ~Return();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::RETURN;
+			}
+
 			std::string to_string() const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
@@ -197,6 +278,11 @@ namespace vc4c
 			MoveOperation(const Value& dest, const Value& arg, const ConditionCode cond = COND_ALWAYS, const SetFlag setFlags = SetFlag::DONT_SET);
 			virtual ~MoveOperation();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind >= InstructionKind::MOVE && instr->kind <= InstructionKind::LAST_MOVE;
+			}
+
 			std::string to_string() const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
@@ -206,6 +292,9 @@ namespace vc4c
 
 			void setSource(const Value& value);
 			const Value getSource() const;
+
+		protected:
+			MoveOperation(InstructionKind kind, const Value& dest, const Value& arg, const ConditionCode cond, const SetFlag setFlags);
 		};
 
 		struct VectorRotation: public MoveOperation
@@ -213,6 +302,11 @@ namespace vc4c
 			VectorRotation(const Value& dest, const Value& src, const Value& offset, const ConditionCode cond = COND_ALWAYS, const SetFlag setFlags = SetFlag::DONT_SET);
 			virtual ~VectorRotation();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::VECTOR_ROTATION;
+			}
+
 			std::string to_string() const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
@@ -228,6 +322,11 @@ namespace vc4c
 			BranchLabel(const Local& label);
 			virtual ~BranchLabel();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::BRANCH_LABEL;
+			}
+
 			std::string to_string() const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
@@ -241,6 +340,11 @@ namespace vc4c
 			Branch(const Local* target, const ConditionCode condCode, const Value& cond);
 			virtual ~Branch();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::BRANCH;
+			}
+
 			std::string to_string() const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
@@ -273,6 +377,11 @@ namespace vc4c
 			Nop(const DelayType type, const Signaling signal = Signaling::NO_SIGNAL);
 			virtual ~Nop();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::NOP;
+			}
+
 			std::string to_string() const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
@@ -317,6 +426,11 @@ namespace vc4c
 		public:
 			Comparison(const std::string& comp, const Value& dest, const Value& val0, const Value& val1);
 			virtual ~Comparison();
+
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::COMPARISON;
+			}
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
 		};
 
@@ -326,8 +440,12 @@ namespace vc4c
 			CombinedOperation(Operation* op1, Operation* op2);
 			virtual ~CombinedOperation();
 
-			FastMap<const Local*, LocalUser::Type> getUsedLocals() const override;
-			void forUsedLocals(const std::function<void(const Local*, LocalUser::Type)>& consumer) const override;
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::COMBINED_OPERATION;
+			}
+
+			LocalUses getUsedLocals() const override;
 			bool readsLocal(const Local* local) const override;
 			bool writesLocal(const Local* local) const override;
 			void replaceLocal(const Local* oldLocal, const Local* newLocal, const Type type) override;
@@ -345,12 +463,31 @@ namespace vc4c
 			const std::unique_ptr<IntermediateInstruction> op2;
 		};
 
+		enum class LoadType
+		{
+			//the 32-bit immediate is written into all SIMD elements
+			REPLICATE_INT32,
+			//every SIMD element is set to its own 2-bit signed value (-2 to 1)
+			PER_ELEMENT_SIGNED,
+			//every SIMD element is set to its own 2-bit unsigned value (0 to 3)
+			PER_ELEMENT_UNSIGNED
+		};
+
 		struct LoadImmediate: public IntermediateInstruction
 		{
 		public:
 			LoadImmediate(const Value& dest, const Literal& source, const ConditionCode& cond = COND_ALWAYS, const SetFlag setFlags = SetFlag::DONT_SET);
+			/*
+			 * For the per-element load types, bit i of the source is the lower bit and bit 16 + i the upper bit of the value of SIMD element i
+			 */
+			LoadImmediate(const Value& dest, const Literal& source, LoadType type, const ConditionCode& cond = COND_ALWAYS, const SetFlag setFlags = SetFlag::DONT_SET);
 			virtual ~LoadImmediate();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::LOAD_IMMEDIATE;
+			}
+
 			std::string to_string() const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
@@ -358,6 +495,18 @@ namespace vc4c
 
 			const Literal& getImmediate() const;
 			void setImmediate(const Literal& value);
+
+			/*
+			 * Returns the 2-bit values of all 16 SIMD elements loaded by a per-element load
+			 */
+			std::vector<long> getPerElementValues() const;
+			/*
+			 * Creates the source of a per-element load setting the SIMD elements to the given values (at most 16),
+			 * which need to be in the range of the load type
+			 */
+			static Literal toPerElementImmediate(const std::vector<long>& values, LoadType type);
+
+			const LoadType type;
 		};
 
 		struct SemaphoreAdjustment: public IntermediateInstruction
@@ -366,6 +515,11 @@ namespace vc4c
 			SemaphoreAdjustment(const Semaphore semaphore, const bool increase, const ConditionCode& cond = COND_ALWAYS, const SetFlag setFlags = SetFlag::DONT_SET);
 			virtual ~SemaphoreAdjustment();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::SEMAPHORE_ADJUSTMENT;
+			}
+
 			std::string to_string() const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
@@ -380,6 +534,11 @@ namespace vc4c
 			PhiNode(const Value& dest, const std::vector<std::pair<Value, const Local*>>& labelPairs, const ConditionCode& cond = COND_ALWAYS, const SetFlag setFlags = SetFlag::DONT_SET);
 			virtual ~PhiNode();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::PHI_NODE;
+			}
+
 			std::string to_string() const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
@@ -439,6 +598,11 @@ namespace vc4c
 			MemoryBarrier(const MemoryScope scope, const MemorySemantics semantics);
 			virtual ~MemoryBarrier();
 
+			static bool classof(const IntermediateInstruction* instr)
+			{
+				return instr->kind == InstructionKind::MEMORY_BARRIER;
+			}
+
 			std::string to_string() const override;
 			qpu_asm::Instruction* convertToAsm(const FastMap<const Local*, Register>& registerMapping, const FastMap<const Local*, std::size_t>& labelMapping, const std::size_t instructionIndex) const override;
 			IntermediateInstruction* copyFor(Method& method, const std::string& localPrefix) const override;
@@ -448,9 +612,8 @@ namespace vc4c
 			MemorySemantics semantics;
 		};
 
-		using Instructions = FastModificationList<std::unique_ptr<IntermediateInstruction>>;
-		using InstructionsIterator = FastModificationList<std::unique_ptr<IntermediateInstruction>>::iterator;
-		using ConstInstructionsIterator = FastModificationList<std::unique_ptr<IntermediateInstruction>>::const_iterator;
+		using Instructions = InstructionList;
+		using InstructionsIterator = InstructionList::iterator;
 	}
 }
 
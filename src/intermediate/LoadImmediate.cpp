@@ -15,13 +15,22 @@ using namespace vc4c;
 using namespace vc4c::intermediate;
 
 LoadImmediate::LoadImmediate(const Value& dest, const Literal& source, const ConditionCode& cond, const SetFlag setFlags) :
-IntermediateInstruction({true, dest}, cond, setFlags)
+IntermediateInstruction(InstructionKind::LOAD_IMMEDIATE, {true, dest}, cond, setFlags), type(LoadType::REPLICATE_INT32)
 {
     //32-bit integers are loaded through all SIMD-elements!
     // "[...] write either a 32-bit immediate across the entire SIMD array" (p. 33)
 	setImmediate(source);
 }
 
+LoadImmediate::LoadImmediate(const Value& dest, const Literal& source, LoadType type, const ConditionCode& cond, const SetFlag setFlags) :
+IntermediateInstruction(InstructionKind::LOAD_IMMEDIATE, {true, dest}, cond, setFlags), type(type)
+{
+	// "[...] or 16 individual 2-bit signed or unsigned values per-element" (p. 33)
+	if(type != LoadType::REPLICATE_INT32 && source.type != LiteralType::INTEGER)
+		throw CompilationError(CompilationStep::GENERAL, "Per-element load requires an integer bit-mask", source.to_string());
+	setImmediate(source);
+}
+
 LoadImmediate::~LoadImmediate()
 {
 
@@ -29,16 +38,26 @@ LoadImmediate::~LoadImmediate()
 
 std::string LoadImmediate::to_string() const
 {
+	if(type != LoadType::REPLICATE_INT32)
+	{
+		std::string elements;
+		for(const long element : getPerElementValues())
+			elements.append(elements.empty() ? "" : ", ").append(std::to_string(element));
+		return (getOutput().get().to_string(true) + " = loadi ") + (type == LoadType::PER_ELEMENT_SIGNED ? "signed <" : "unsigned <") + elements + ">" + createAdditionalInfoString();
+	}
     return (getOutput().get().to_string(true) + " = loadi ") + getArgument(0).to_string() + createAdditionalInfoString();
 }
 
 IntermediateInstruction* LoadImmediate::copyFor(Method& method, const std::string& localPrefix) const
 {
-    return (new LoadImmediate(renameValue(method, getOutput(), localPrefix), getArgument(0).get().literal, conditional, setFlags))->copyExtrasFrom(this);
+    return (new LoadImmediate(renameValue(method, getOutput(), localPrefix), getArgument(0).get().literal, type, conditional, setFlags))->copyExtrasFrom(this);
 }
 
 Optional<Value> LoadImmediate::precalculate(const std::size_t numIterations) const
 {
+	//the per-element values are not folded into a container, since containers are lowered into per-element loads again
+	if(type != LoadType::REPLICATE_INT32)
+		return NO_VALUE;
 	return getArgument(0);
 }
 
@@ -46,8 +65,14 @@ qpu_asm::Instruction* LoadImmediate::convertToAsm(const FastMap<const Local*, Re
 {
     const Register outReg = getOutput().get().hasType(ValueType::REGISTER) ? getOutput().get().reg : registerMapping.at(getOutput().get().local);
     const ConditionCode conditional0 = outReg.num == REG_NOP.num ? COND_NEVER : this->conditional;
-    return new qpu_asm::LoadInstruction(PACK_NOP, conditional0, COND_NEVER, setFlags,
-                               outReg.file == RegisterFile::PHYSICAL_A ? WriteSwap::DONT_SWAP : WriteSwap::SWAP, outReg.num, REG_NOP.num, getArgument(0).get().literal.toImmediate());
+    const WriteSwap swap = outReg.file == RegisterFile::PHYSICAL_A ? WriteSwap::DONT_SWAP : WriteSwap::SWAP;
+    //the upper 16 bits contain the upper bits of the per-element values
+    const uint32_t bits = static_cast<uint32_t>(getImmediate().integer);
+    if(type == LoadType::PER_ELEMENT_SIGNED)
+    	return new qpu_asm::LoadInstruction(PACK_NOP, conditional0, COND_NEVER, setFlags, swap, outReg.num, REG_NOP.num, static_cast<int16_t>(bits >> 16), static_cast<int16_t>(bits & 0xFFFF));
+    if(type == LoadType::PER_ELEMENT_UNSIGNED)
+    	return new qpu_asm::LoadInstruction(PACK_NOP, conditional0, COND_NEVER, setFlags, swap, outReg.num, REG_NOP.num, static_cast<uint16_t>(bits >> 16), static_cast<uint16_t>(bits & 0xFFFF));
+    return new qpu_asm::LoadInstruction(PACK_NOP, conditional0, COND_NEVER, setFlags, swap, outReg.num, REG_NOP.num, getArgument(0).get().literal.toImmediate());
     
 }
 
@@ -60,3 +85,34 @@ void LoadImmediate::setImmediate(const Literal& value)
 {
 	setArgument(0, Value(value, value.type == LiteralType::INTEGER ? TYPE_INT32 : (value.type == LiteralType::REAL ? TYPE_FLOAT : TYPE_BOOL)));
 }
+
+std::vector<long> LoadImmediate::getPerElementValues() const
+{
+	const uint32_t bits = static_cast<uint32_t>(getImmediate().integer);
+	std::vector<long> values;
+	values.reserve(NATIVE_VECTOR_SIZE);
+	for(unsigned i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+	{
+		const long value = static_cast<long>(((bits >> (16 + i)) & 0x1) << 1 | ((bits >> i) & 0x1));
+		//the upper bit is the sign-bit for signed loads
+		values.push_back(type == LoadType::PER_ELEMENT_SIGNED && value > 1 ? value - 4 : value);
+	}
+	return values;
+}
+
+Literal LoadImmediate::toPerElementImmediate(const std::vector<long>& values, LoadType type)
+{
+	if(values.size() > NATIVE_VECTOR_SIZE)
+		throw CompilationError(CompilationStep::GENERAL, "Too many elements for per-element load", std::to_string(values.size()));
+	uint32_t bits = 0;
+	for(std::size_t i = 0; i < values.size(); ++i)
+	{
+		const long value = values[i];
+		if((type == LoadType::PER_ELEMENT_SIGNED && (value < -2 || value > 1)) || (type == LoadType::PER_ELEMENT_UNSIGNED && (value < 0 || value > 3)) || type == LoadType::REPLICATE_INT32)
+			throw CompilationError(CompilationStep::GENERAL, "Value can't be loaded per-element", std::to_string(value));
+		const uint32_t twoBits = static_cast<uint32_t>(value) & 0x3;
+		bits |= (twoBits & 0x1) << i;
+		bits |= (twoBits >> 1) << (16 + i);
+	}
+	return Literal(static_cast<long>(bits));
+}
@@ -9,14 +9,14 @@
 using namespace vc4c;
 using namespace vc4c::intermediate;
 
-MethodCall::MethodCall(const std::string& methodName, const std::vector<Value>& args) : IntermediateInstruction(NO_VALUE), methodName(methodName)
+MethodCall::MethodCall(const std::string& methodName, const std::vector<Value>& args) : IntermediateInstruction(InstructionKind::METHOD_CALL, NO_VALUE), methodName(methodName)
 {
 	for(std::size_t i = 0; i < args.size(); ++i)
 		setArgument(i, args[i]);
 }
 
 MethodCall::MethodCall(const Value& dest, const std::string& methodName, const std::vector<Value>& args) :
-IntermediateInstruction({true, dest}), methodName(methodName)
+IntermediateInstruction(InstructionKind::METHOD_CALL, {true, dest}), methodName(methodName)
 {
 	for(std::size_t i = 0; i < args.size(); ++i)
 		setArgument(i, args[i]);
@@ -92,12 +92,12 @@ bool MethodCall::matchesSignature(const Method& method) const
 	return true;
 }
 
-Return::Return(const Value& val) : IntermediateInstruction(NO_VALUE)
+Return::Return(const Value& val) : IntermediateInstruction(InstructionKind::RETURN, NO_VALUE)
 {
 	setArgument(0, val);
 }
 
-Return::Return() : IntermediateInstruction(NO_VALUE)
+Return::Return() : IntermediateInstruction(InstructionKind::RETURN, NO_VALUE)
 {
 
 }
@@ -15,13 +15,18 @@ using namespace vc4c;
 using namespace vc4c::intermediate;
 
 Operation::Operation(const std::string& opCode, const Value& dest, const Value& arg0, const ConditionCode cond, const SetFlag setFlags) :
-IntermediateInstruction(dest, cond, setFlags), opCode(opCode), parent(nullptr)
+IntermediateInstruction(InstructionKind::OPERATION, dest, cond, setFlags), opCode(opCode), parent(nullptr)
 {
 	setArgument(0, arg0);
 }
 
 Operation::Operation(const std::string& opCode, const Value& dest, const Value& arg0, const Value& arg1, const ConditionCode cond, const SetFlag setFlags) :
-IntermediateInstruction(dest, cond, setFlags), opCode(opCode), parent(nullptr)
+Operation(InstructionKind::OPERATION, opCode, dest, arg0, arg1, cond, setFlags)
+{
+}
+
+Operation::Operation(InstructionKind kind, const std::string& opCode, const Value& dest, const Value& arg0, const Value& arg1, const ConditionCode cond, const SetFlag setFlags) :
+IntermediateInstruction(kind, dest, cond, setFlags), opCode(opCode), parent(nullptr)
 {
 	setArgument(0, arg0);
 	setArgument(1, arg1);
@@ -395,7 +400,12 @@ Optional<Value> Operation::precalculate(const std::size_t numIterations) const
 }
 
 MoveOperation::MoveOperation(const Value& dest, const Value& arg, const ConditionCode cond, const SetFlag setFlags) :
-IntermediateInstruction({true, dest}, cond, setFlags)
+MoveOperation(InstructionKind::MOVE, dest, arg, cond, setFlags)
+{
+}
+
+MoveOperation::MoveOperation(InstructionKind kind, const Value& dest, const Value& arg, const ConditionCode cond, const SetFlag setFlags) :
+IntermediateInstruction(kind, {true, dest}, cond, setFlags)
 {
 	setArgument(0, arg);
 }
@@ -472,7 +482,7 @@ const Value MoveOperation::getSource() const
 }
 
 VectorRotation::VectorRotation(const Value& dest, const Value& src, const Value& offset, const ConditionCode cond, const SetFlag setFlags) :
-MoveOperation(dest, src, cond, setFlags)
+MoveOperation(InstructionKind::VECTOR_ROTATION, dest, src, cond, setFlags)
 {
     signal = Signaling::ALU_IMMEDIATE;
     setArgument(1, offset);
@@ -543,7 +553,7 @@ const Value VectorRotation::getOffset() const
 	return getArgument(1);
 }
 
-Nop::Nop(const DelayType type, const Signaling signal) : IntermediateInstruction(NO_VALUE), type(type)
+Nop::Nop(const DelayType type, const Signaling signal) : IntermediateInstruction(InstructionKind::NOP, NO_VALUE), type(type)
 {
     this->signal = signal;
     this->canBeCombined = false;
@@ -571,7 +581,7 @@ qpu_asm::Instruction* Nop::convertToAsm(const FastMap<const Local*, Register>& r
 }
 
 Comparison::Comparison(const std::string& comp, const Value& dest, const Value& val0, const Value& val1) :
-Operation(comp, dest, val0, val1)
+Operation(InstructionKind::COMPARISON, comp, dest, val0, val1, COND_ALWAYS, SetFlag::DONT_SET)
 {
 
 }
@@ -586,7 +596,7 @@ IntermediateInstruction* Comparison::copyFor(Method& method, const std::string&
     return (new Comparison(opCode, renameValue(method, getOutput(), localPrefix), renameValue(method, getFirstArg(), localPrefix), renameValue(method, getSecondArg(), localPrefix)))->copyExtrasFrom(this);
 }
 
-CombinedOperation::CombinedOperation(Operation* op1, Operation* op2) : IntermediateInstruction(NO_VALUE), op1(op1), op2(op2)
+CombinedOperation::CombinedOperation(Operation* op1, Operation* op2) : IntermediateInstruction(InstructionKind::COMBINED_OPERATION, NO_VALUE), op1(op1), op2(op2)
 {
 	op1->parent = this;
 	op2->parent = this;
@@ -597,20 +607,14 @@ CombinedOperation::~CombinedOperation()
 
 }
 
-FastMap<const Local*, LocalUser::Type> CombinedOperation::getUsedLocals() const
-{
-	FastMap<const Local*, LocalUser::Type> res = op1 != nullptr ? op1->getUsedLocals() : FastMap<const Local*, LocalUser::Type>{};
-	const FastMap<const Local*, LocalUser::Type> tmp = op2 != nullptr ? op2->getUsedLocals() : FastMap<const Local*, LocalUser::Type>{};
-	res.insert(tmp.begin(), tmp.end());
-	return res;
-}
-
-void CombinedOperation::forUsedLocals(const std::function<void(const Local*, LocalUser::Type)>& consumer) const
+LocalUses CombinedOperation::getUsedLocals() const
 {
+	LocalUses res;
 	if(op1)
-		op1->forUsedLocals(consumer);
+		res.addAll(op1->getUsedLocals());
 	if(op2)
-		op2->forUsedLocals(consumer);
+		res.addAll(op2->getUsedLocals());
+	return res;
 }
 
 bool CombinedOperation::readsLocal(const Local* local) const
@@ -683,10 +687,10 @@ bool CombinedOperation::mapsToASMInstruction() const
 
 const Operation* CombinedOperation::getFirstOp() const
 {
-	return dynamic_cast<const Operation*>(op1.get());
+	return op1->as<Operation>();
 }
 
 const Operation* CombinedOperation::getSecondOP() const
 {
-	return dynamic_cast<const Operation*>(op2.get());
+	return op2->as<Operation>();
 }
@@ -5,9 +5,10 @@
  */
 
 #include "Images.h"
+#include "Operators.h"
 #include "../intermediate/Helper.h"
 #include "../periphery/VPM.h"
-#include "log.h"
+#include "../Logging.h"
 
 using namespace vc4c;
 using namespace vc4c::intermediate;
@@ -37,14 +38,220 @@ static InstructionWalker insertQueryPitches(InstructionWalker it, Method& method
 	return insertZeroExtension(it, method, resultPitches, pitches);
 }
 
-InstructionWalker intermediate::intrinsifyImageFunction(InstructionWalker it, Method& method)
+//the number of moves to follow back to the original value, e.g. the parameter of the kernel passed through inlined functions
+static constexpr unsigned MAX_MOVE_CHAIN = 8;
+
+/*
+ * Follows the unconditional moves the value is copied with, e.g. to find the kernel parameter or constant passed to an inlined function
+ */
+static Value getOriginalValue(const Value& val)
+{
+	Value result = val;
+	for(unsigned i = 0; i < MAX_MOVE_CHAIN && result.hasType(ValueType::LOCAL) && dynamic_cast<const Parameter*>(result.local) == nullptr; ++i)
+	{
+		const IntermediateInstruction* writer = dynamic_cast<const IntermediateInstruction*>(result.local->getSingleWriter());
+		if(writer == nullptr || !writer->is<MoveOperation>() || writer->is<VectorRotation>() || writer->hasConditionalExecution() ||
+				writer->hasPackMode() || writer->hasUnpackMode())
+			break;
+		result = writer->as<MoveOperation>()->getSource();
+	}
+	return result;
+}
+
+static Value getImageParameter(const Value& image)
+{
+	const Value param = getOriginalValue(image);
+	if(!param.hasType(ValueType::LOCAL) || dynamic_cast<const Parameter*>(param.local) == nullptr || !param.type.getImageType().hasValue)
+		throw CompilationError(CompilationStep::OPTIMIZER, "Images can only be read via the TMU from kernel parameters", image.to_string());
+	return param;
+}
+
+static Sampler getConstantSampler(const Value& sampler)
+{
+	const Value val = getOriginalValue(sampler);
+	if(!val.hasType(ValueType::LITERAL))
+		throw CompilationError(CompilationStep::OPTIMIZER, "Images can only be read via the TMU with compile-time constant samplers", sampler.to_string());
+	return Sampler(static_cast<uint8_t>(val.literal.integer));
+}
+
+static periphery::WrapMode toWrapMode(const AddressingMode mode)
+{
+	switch(mode)
+	{
+		case AddressingMode::NONE:
+		case AddressingMode::CLAMP_TO_EDGE:
+			return periphery::WrapMode::CLAMP;
+		case AddressingMode::CLAMP:
+			//returns the border color for out-of-range coordinates
+			return periphery::WrapMode::BORDER;
+		case AddressingMode::REPEAT:
+			return periphery::WrapMode::REPEAT;
+		case AddressingMode::MIRRORED_REPEAT:
+			return periphery::WrapMode::MIRROR;
+	}
+	throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled addressing-mode", std::to_string(static_cast<unsigned>(mode)));
+}
+
+/*
+ * The bits of the texture access setup (see periphery#TextureAccessSetup) determined by the sampler
+ */
+static uint32_t toSamplerSetup(const Sampler sampler)
+{
+	//width and height are set by the host
+	periphery::TextureAccessSetup setup(periphery::RGBA8888, 0, 0);
+	const periphery::WrapMode wrapMode = toWrapMode(sampler.getAddressingMode());
+	setup.setWrapS(wrapMode);
+	setup.setWrapT(wrapMode);
+	//we only have a single LOD, so the mip-map filters are not used
+	const periphery::TextureFilter filter = sampler.getFilterMode() == FilterMode::LINEAR ? periphery::TextureFilter::LINEAR : periphery::TextureFilter::NEAREST;
+	setup.setMagnificationFilter(filter);
+	setup.setMinificationFilter(filter);
+	return setup;
+}
+
+/*
+ * Returns the reciprocals of the width (element 0) and height (element 1) of the image to normalize the coordinates.
+ *
+ * The sizes are read once at the start of the kernel from the image-configuration (bits 8 - 18 and 20 - 30 of the texture access setup)
+ */
+static Value getReciprocalSizes(Method& method, const Value& image, const MathType mathType)
+{
+	const std::string localName = image.local->name + ".size_reciprocals";
+	if(method.findLocal(localName) != nullptr)
+		return method.findLocal(localName)->createReference();
+
+	const Global* imageConfig = method.findGlobal(ImageType::toImageConfigurationName(image.local->name));
+	if(imageConfig == nullptr)
+		throw CompilationError(CompilationStep::OPTIMIZER, "Failed to find the image-configuration for", image.to_string());
+	const Value result = method.findOrCreateLocal(TYPE_FLOAT.toVectorType(2), localName)->createReference();
+	//insert at the start of the kernel, so the sizes are available in all blocks
+	InstructionWalker it = method.walkAllInstructions().nextInBlock();
+	const Value config = method.addNewLocal(TYPE_INT32.toVectorType(2), "%image_config");
+	const Value accessSetup = method.addNewLocal(TYPE_INT32, "%image_access_setup");
+	it = periphery::insertReadDMA(method, it, config, imageConfig->createReference());
+	it = insertVectorExtraction(it, method, config, INT_ONE, accessSetup);
+	//width in element 0, height in element 1
+	const Value shifts = method.addNewLocal(TYPE_INT32.toVectorType(2), "%image_size");
+	const Value shifted = method.addNewLocal(TYPE_INT32.toVectorType(2), "%image_size");
+	const Value sizes = method.addNewLocal(TYPE_INT32.toVectorType(2), "%image_size");
+	const Value floatSizes = method.addNewLocal(TYPE_FLOAT.toVectorType(2), "%image_size");
+	it.emplace(new MoveOperation(shifts, Value(Literal(8L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("xor", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, INT_ONE, COND_ALWAYS, SetFlag::SET_FLAGS));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(shifts, Value(Literal(20L), TYPE_INT8), COND_ZERO_SET));
+	it.nextInBlock();
+	it.emplace(new Operation("shr", shifted, accessSetup, shifts));
+	it.nextInBlock();
+	//TODO a size of zero represents 2048
+	it.emplace(new Operation("and", sizes, shifted, Value(Literal(0x7FFL), TYPE_INT16)));
+	it.nextInBlock();
+	it.emplace(new Operation("itof", floatSizes, sizes));
+	it.nextInBlock();
+	insertSFUFunction(method, it, REG_SFU_RECIP, floatSizes, result, mathType);
+	return result;
+}
+
+/*
+ * Converts the coordinate to a normalized floating-point coordinate in [0, 1] and replicates it across all SIMD elements
+ */
+static InstructionWalker insertNormalizeCoordinate(Method& method, InstructionWalker it, const Value& coordinate, const Optional<Value>& reciprocalSize, const Value& dest)
+{
+	Value floatCoord = coordinate;
+	if(!coordinate.type.isFloatingType())
+	{
+		//integer coordinates address the center of the pixel
+		const Value tmp = method.addNewLocal(TYPE_FLOAT, "%image_coord");
+		floatCoord = method.addNewLocal(TYPE_FLOAT, "%image_coord");
+		it.emplace(new Operation("itof", tmp, coordinate));
+		it.nextInBlock();
+		it.emplace(new Operation("fadd", floatCoord, tmp, Value(Literal(0.5), TYPE_FLOAT)));
+		it.nextInBlock();
+	}
+	if(reciprocalSize)
+	{
+		const Value normalized = method.addNewLocal(TYPE_FLOAT, "%image_coord");
+		it.emplace(new Operation("fmul", normalized, floatCoord, reciprocalSize.get()));
+		it.nextInBlock();
+		floatCoord = normalized;
+	}
+	//the TMU performs a look-up per SIMD element, the color channels are selected from the same pixel
+	return insertReplication(it, floatCoord, dest);
+}
+
+static InstructionWalker insertReadPixel(Method& method, InstructionWalker it, const MathType mathType)
+{
+	MethodCall* callSite = it.get<MethodCall>();
+	if(callSite->getArguments().size() < 3)
+		throw CompilationError(CompilationStep::OPTIMIZER, "Invalid number of arguments for reading an image", callSite->to_string());
+	const Value image = getImageParameter(callSite->getArgument(0));
+	const Sampler sampler = getConstantSampler(callSite->getArgument(1));
+	const Value coordinates = callSite->getArgument(2);
+	const Value dest = callSite->getOutput();
+	const ImageType* imageType = image.type.getImageType().get();
+	if(imageType->dimensions > 2 || imageType->isImageArray)
+		throw CompilationError(CompilationStep::OPTIMIZER, "Reading 3D images or image-arrays via the TMU is not yet supported", image.to_string());
+	DEBUG_LOG("Intrinsifying reading of image " << image.to_string() << " via TMU with sampler " << static_cast<unsigned>(sampler) << logging::endl);
+
+	//non-normalized coordinates are scaled with the reciprocal of the image size
+	Optional<Value> reciprocalSizes = NO_VALUE;
+	if(!sampler.getNormalizedCoordinates())
+		reciprocalSizes = getReciprocalSizes(method, image, mathType);
+
+	const Value xCoord = method.addNewLocal(TYPE_FLOAT.toVectorType(16), "%image_x");
+	it = insertNormalizeCoordinate(method, it, coordinates, reciprocalSizes, xCoord);
+	Optional<Value> yCoord = NO_VALUE;
+	if(imageType->dimensions > 1)
+	{
+		//the y-coordinate (and reciprocal height) is in element 1
+		const Value y = method.addNewLocal(coordinates.type.getElementType(), "%image_y");
+		it = insertVectorExtraction(it, method, coordinates, INT_ONE, y);
+		Optional<Value> reciprocalHeight = NO_VALUE;
+		if(reciprocalSizes)
+		{
+			reciprocalHeight = method.addNewLocal(TYPE_FLOAT, "%image_size");
+			it = insertVectorExtraction(it, method, reciprocalSizes.get(), INT_ONE, reciprocalHeight.get());
+		}
+		yCoord = method.addNewLocal(TYPE_FLOAT.toVectorType(16), "%image_y");
+		it = insertNormalizeCoordinate(method, it, y, reciprocalHeight, yCoord.get());
+	}
+
+	const Value pixel = method.addNewLocal(TYPE_INT32.toVectorType(16), "%image_pixel");
+	it = periphery::insertReadTMU(method, it, image, pixel, xCoord, yCoord);
+
+	//the TMU returns the 8-bit color channels of the pixel, which are extracted via the unpack-modes
+	//(for floating-point operations, the unpack-modes convert the color-channels to floats in [0, 1])
+	static const Unpack CHANNELS[] = {UNPACK_R4_COLOR0, UNPACK_R4_COLOR1, UNPACK_R4_COLOR2, UNPACK_R4_COLOR3};
+	const bool isFloat = dest.type.isFloatingType();
+	for(unsigned char i = 0; i < std::min(dest.type.num, static_cast<unsigned char>(4)); ++i)
+	{
+		//the first write is unconditional, so the register-allocator can find it
+		const ConditionCode cond = i == 0 ? COND_ALWAYS : COND_ZERO_SET;
+		if(i > 0)
+		{
+			it.emplace(new Operation("xor", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, Value(SmallImmediate(i), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+			it.nextInBlock();
+		}
+		if(isFloat)
+			it.emplace((new Operation("fmul", dest, pixel, Value(Literal(1.0), TYPE_FLOAT), cond))->setUnpackMode(CHANNELS[i]));
+		else
+			it.emplace((new MoveOperation(dest, pixel, cond))->setUnpackMode(CHANNELS[i]));
+		it.nextInBlock();
+	}
+	it.erase();
+	//so next instruction is not skipped
+	it.previousInBlock();
+	return it;
+}
+
+InstructionWalker intermediate::intrinsifyImageFunction(InstructionWalker it, Method& method, const MathType mathType)
 {
 	MethodCall* callSite = it.get<MethodCall>();
 	if(callSite != nullptr)
 	{
 		if(callSite->methodName.find("vc4cl_image_get_pitches") != std::string::npos)
 		{
-			logging::debug() << "intrinsifying retrieving image pitches" << logging::endl;
+			DEBUG_LOG("intrinsifying retrieving image pitches" << logging::endl);
 			it = insertQueryPitches(it, method, callSite->getArgument(0), callSite->getOutput());
 			it.erase();
 			//so next instruction is not skipped
@@ -52,12 +259,12 @@ InstructionWalker intermediate::intrinsifyImageFunction(InstructionWalker it, Me
 		}
 		else if(callSite->methodName.find("vc4cl_image_get_data_address") != std::string::npos)
 		{
-			logging::debug() << "Intrinsifying calculating image data address" << logging::endl;
+			DEBUG_LOG("Intrinsifying calculating image data address" << logging::endl);
 			it.reset(new Operation("add", callSite->getOutput(), callSite->getArgument(0), IMAGE_DATA_OFFSET));
 		}
 		else if(callSite->methodName.find("vc4cl_image_read_pixel") != std::string::npos)
 		{
-			throw CompilationError(CompilationStep::LLVM_2_IR, "Unsupported intrinsic", callSite->to_string());
+			it = insertReadPixel(method, it, mathType);
 		}
 		else if(callSite->methodName.find("vc4cl_image_write_pixel") != std::string::npos)
 		{
@@ -65,23 +272,35 @@ InstructionWalker intermediate::intrinsifyImageFunction(InstructionWalker it, Me
 		}
 		else if(callSite->methodName.find("vc4cl_sampler_get_normalized_coords") != std::string::npos)
 		{
-			logging::debug() << "Intrinsifying getting normalized-coordinates flag from sampler" << logging::endl;
+			DEBUG_LOG("Intrinsifying getting normalized-coordinates flag from sampler" << logging::endl);
 			it.reset(new Operation("and", callSite->getOutput(), callSite->getArgument(0), Value(Literal(Sampler::MASK_NORMALIZED_COORDS), TYPE_INT8)));
 		}
 		else if(callSite->methodName.find("vc4cl_sampler_get_addressing_mode") != std::string::npos)
 		{
-			logging::debug() << "Intrinsifying getting addressing-mode flag from sampler" << logging::endl;
+			DEBUG_LOG("Intrinsifying getting addressing-mode flag from sampler" << logging::endl);
 			it.reset(new Operation("and", callSite->getOutput(), callSite->getArgument(0), Value(Literal(Sampler::MASK_ADDRESSING_MODE), TYPE_INT8)));
 		}
 		else if(callSite->methodName.find("vc4cl_sampler_get_filter_mode") != std::string::npos)
 		{
-			logging::debug() << "Intrinsifying getting filter-mode flag from sampler" << logging::endl;
+			DEBUG_LOG("Intrinsifying getting filter-mode flag from sampler" << logging::endl);
 			it.reset(new Operation("and", callSite->getOutput(), callSite->getArgument(0), Value(Literal(Sampler::MASK_FILTER_MODE), TYPE_INT8)));
 		}
 	}
 	return it;
 }
 
+void intermediate::reserveImageConfigurations(Module& module, Method& kernel)
+{
+	kernel.forAllInstructions([&module](const IntermediateInstruction* instr) -> void
+	{
+		const MethodCall* callSite = instr->as<MethodCall>();
+		if(callSite == nullptr || callSite->methodName.find("vc4cl_image_read_pixel") == std::string::npos || callSite->getArguments().size() < 3)
+			return;
+		const Value image = getImageParameter(callSite->getArgument(0));
+		periphery::reserveImageConfiguration(module, image, toSamplerSetup(getConstantSampler(callSite->getArgument(1))));
+	});
+}
+
 InstructionWalker intermediate::insertQueryChannelDataType(InstructionWalker it, Method& method, const Value& image, const Value& dest)
 {
 	//0. check if the channel-type was already retrieved for this image
@@ -131,7 +131,21 @@ namespace vc4c
 		//offset of 16 bytes
 		static const Value IMAGE_DATA_OFFSET(Literal(16L), TYPE_INT8);
 
-		InstructionWalker intrinsifyImageFunction(InstructionWalker it, Method& method);
+		/*
+		 * Intrinsifies the image-functions of the VC4CLStdLib.
+		 *
+		 * Image reads (vc4cl_image_read_pixel(image, sampler, coordinates)) are performed via the TMU, using the hardware filtering and wrap-modes.
+		 * The sampler needs to be a compile-time constant, its modes are stored in the image-configuration (see #reserveImageConfigurations).
+		 */
+		InstructionWalker intrinsifyImageFunction(InstructionWalker it, Method& method, const MathType mathType);
+
+		/*
+		 * Reserves the image-configurations (see periphery#reserveImageConfiguration) for all images read in the kernel,
+		 * with the wrap- and filter-modes of the constant samplers used to read them.
+		 *
+		 * This needs to run after the inlining, since the images and samplers are passed through the functions of the VC4CLStdLib.
+		 */
+		void reserveImageConfigurations(Module& module, Method& kernel);
 
 		//TODO rewrite all query info to read from global representing the image-config (need to know layout!!), in VC4CLStdLib via intrinsics?
 		//TODO rewrite all queries to TMU call
@@ -9,10 +9,12 @@
 #include "Comparisons.h"
 #include "Operators.h"
 #include "Images.h"
-#include "log.h"
+#include "../Logging.h"
 #include "../intermediate/Helper.h"
-#include <map>
+#include "../analysis/AnalysisManager.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <stdbool.h>
 #include <vector>
 
@@ -33,342 +35,446 @@ enum class IntrinsicType
     DMA_READ,
     DMA_WRITE,
 	DMA_COPY,
-	VECTOR_ROTATE
+	VECTOR_ROTATE,
+	TYPE_CAST
 };
 
 //The function to apply for pre-calculation
-using UnaryInstruction = std::function<Optional<Value>(const Value&)>;
-static const UnaryInstruction NO_OP = [](const Value& val){return NO_VALUE;};
+using UnaryFolding = Optional<Value>(*)(const Value&);
 //The function to apply for pre-calculation
-using BinaryInstruction = std::function<Optional<Value>(const Value&, const Value&)>;
-static const BinaryInstruction NO_OP2 = [](const Value& val0, const Value& val1){return NO_VALUE;};
+using BinaryFolding = Optional<Value>(*)(const Value&, const Value&);
 
 //see VC4CLStdLib (_intrinsics.h)
 static constexpr unsigned char VC4CL_UNSIGNED {1};
+//all intrinsic functions of the VC4CLStdLib have this prefix
+static const std::string INTRINSIC_PREFIX("vc4cl_");
 
-struct Intrinsic
+static Optional<Value> foldRecipSqrt(const Value& val)
 {
-    const IntrinsicType type;
-	const char* opCode;
-    const Value val;
-    const Optional<UnaryInstruction> unaryInstr;
-    const Optional<BinaryInstruction> binaryInstr;
-    const bool withSignFlag;
-    
-    Intrinsic(const IntrinsicType type, const Value& val, const UnaryInstruction unary, bool withSignFlag = false) : type(type), opCode(""), val(val), unaryInstr(unary), withSignFlag(withSignFlag)
-    {
-        
-    }
-    
-    Intrinsic(const IntrinsicType type, const char* opcode, const UnaryInstruction unary, bool withSignFlag = false) : type(type), opCode(opcode), val(UNDEFINED_VALUE), binaryInstr(NO_OP2), withSignFlag(withSignFlag)
-    {
-        
-    }
-    
-    Intrinsic(const IntrinsicType type, const char* opcode, const BinaryInstruction binary, bool withSignFlag = false) : type(type), opCode(opcode), val(UNDEFINED_VALUE), binaryInstr(binary), withSignFlag(withSignFlag)
-	{
+	return Value(Literal(1.0 / std::sqrt(val.literal.real)), TYPE_FLOAT);
+}
 
-	}
+static Optional<Value> foldExp2(const Value& val)
+{
+	return Value(Literal(std::exp2(val.literal.real)), TYPE_FLOAT);
+}
 
-    Intrinsic(const IntrinsicType type, const Value& val) : type(type), opCode(""), val(val), withSignFlag(false)
-    {
-        
-    }
-};
+static Optional<Value> foldLog2(const Value& val)
+{
+	return Value(Literal(std::log2(val.literal.real)), TYPE_FLOAT);
+}
 
-const static std::map<std::string, Intrinsic> nonaryInstrinsics = {
-    {"vc4cl_mutex_lock", Intrinsic{IntrinsicType::MUTEX_LOCK, NOP_REGISTER}},
-    {"vc4cl_mutex_unlock", Intrinsic{IntrinsicType::MUTEX_UNLOCK, NOP_REGISTER}},
-	{"vc4cl_element_number", Intrinsic{IntrinsicType::VALUE_READ, ELEMENT_NUMBER_REGISTER}},
-	{"vc4cl_qpu_number", Intrinsic{IntrinsicType::VALUE_READ, Value(REG_QPU_NUMBER, TYPE_INT8)}}
-};
+static Optional<Value> foldRecip(const Value& val)
+{
+	return Value(Literal(1.0 / val.literal.real), TYPE_FLOAT);
+}
 
-const static std::map<std::string, Intrinsic> unaryIntrinsicMapping = {
-    {"vc4cl_ftoi", Intrinsic{IntrinsicType::ADD_ALU, "ftoi", [](const Value& val){return Value(Literal(static_cast<long>(std::round(val.literal.real))), TYPE_INT32);}}},
-    {"vc4cl_itof", Intrinsic{IntrinsicType::ADD_ALU, "itof", [](const Value& val){return Value(Literal(static_cast<double>(val.literal.integer)), TYPE_FLOAT);}}},
-    {"vc4cl_clz", Intrinsic{IntrinsicType::ADD_ALU, "clz", NO_OP}},
-    {"vc4cl_sfu_rsqrt", Intrinsic{IntrinsicType::SFU, Value(REG_SFU_RECIP_SQRT, TYPE_FLOAT), [](const Value& val){return Value(Literal(1.0 / std::sqrt(val.literal.real)), TYPE_FLOAT);}}},
-    {"vc4cl_sfu_exp2", Intrinsic{IntrinsicType::SFU, Value(REG_SFU_EXP2, TYPE_FLOAT), [](const Value& val){return Value(Literal(std::exp2(val.literal.real)), TYPE_FLOAT);}}},
-    {"vc4cl_sfu_log2", Intrinsic{IntrinsicType::SFU, Value(REG_SFU_LOG2, TYPE_FLOAT), [](const Value& val){return Value(Literal(std::log2(val.literal.real)), TYPE_FLOAT);}}},
-    {"vc4cl_sfu_recip", Intrinsic{IntrinsicType::SFU, Value(REG_SFU_RECIP, TYPE_FLOAT), [](const Value& val){return Value(Literal(1.0 / val.literal.real), TYPE_FLOAT);}}},
-    {"vc4cl_semaphore_increment", Intrinsic{IntrinsicType::SEMAPHORE_INCREMENT, NOP_REGISTER}},
-    {"vc4cl_semaphore_decrement", Intrinsic{IntrinsicType::SEMAPHORE_DECREMENT, NOP_REGISTER}},
-    {"vc4cl_dma_read", Intrinsic{IntrinsicType::DMA_READ, NOP_REGISTER}}
-};
+static Optional<Value> foldFmax(const Value& val0, const Value& val1)
+{
+	return Value(Literal(std::max(val0.literal.real, val1.literal.real)), TYPE_FLOAT);
+}
 
-const static std::map<std::string, Intrinsic> binaryIntrinsicMapping = {
-    {"vc4cl_fmax", Intrinsic{IntrinsicType::ADD_ALU, "fmax", [](const Value& val0, const Value& val1){return Value(Literal(std::max(val0.literal.real, val1.literal.real)), TYPE_FLOAT);}}},
-    {"vc4cl_fmin", Intrinsic{IntrinsicType::ADD_ALU, "fmin", [](const Value& val0, const Value& val1){return Value(Literal(std::min(val0.literal.real, val1.literal.real)), TYPE_FLOAT);}}},
-    {"vc4cl_fmaxabs", Intrinsic{IntrinsicType::ADD_ALU, "fmaxabs", [](const Value& val0, const Value& val1){return Value(Literal(std::max(std::abs(val0.literal.real), std::abs(val1.literal.real))), TYPE_FLOAT);}}},
-    {"vc4cl_fminabs", Intrinsic{IntrinsicType::ADD_ALU, "fminabs", [](const Value& val0, const Value& val1){return Value(Literal(std::min(std::abs(val0.literal.real), std::abs(val1.literal.real))), TYPE_FLOAT);}}},
-	//FIXME sign / no-sign!!
-    {"vc4cl_shr", Intrinsic{IntrinsicType::ADD_ALU, "shr", [](const Value& val0, const Value& val1){return Value(Literal(val0.literal.integer >> val1.literal.integer), val0.type.getUnionType(val1.type));}}},
-    {"vc4cl_asr", Intrinsic{IntrinsicType::ADD_ALU, "asr", [](const Value& val0, const Value& val1){return Value(Literal(val0.literal.integer >> val1.literal.integer), val0.type.getUnionType(val1.type));}}},
-    {"vc4cl_ror", Intrinsic{IntrinsicType::ADD_ALU, "ror", NO_OP2}},
-    {"vc4cl_shl", Intrinsic{IntrinsicType::ADD_ALU, "shl", [](const Value& val0, const Value& val1){return Value(Literal(val0.literal.integer << val1.literal.integer), val0.type.getUnionType(val1.type));}}},
-    {"vc4cl_min", Intrinsic{IntrinsicType::ADD_ALU, "min", [](const Value& val0, const Value& val1){return Value(Literal(std::min(val0.literal.integer, val1.literal.integer)), val0.type.getUnionType(val1.type));}, true}},
-    {"vc4cl_max", Intrinsic{IntrinsicType::ADD_ALU, "max", [](const Value& val0, const Value& val1){return Value(Literal(std::max(val0.literal.integer, val1.literal.integer)), val0.type.getUnionType(val1.type));}, true}},
-    {"vc4cl_and", Intrinsic{IntrinsicType::ADD_ALU, "and", [](const Value& val0, const Value& val1){return Value(Literal(val0.literal.integer & val1.literal.integer), val0.type.getUnionType(val1.type));}}},
-    {"vc4cl_mul24", Intrinsic{IntrinsicType::MUL_ALU, "mul24", [](const Value& val0, const Value& val1){return Value(Literal((val0.literal.integer & 0xFFFFFFL) * (val1.literal.integer & 0xFFFFFFL)), val0.type.getUnionType(val1.type));}, true}},
-    {"vc4cl_dma_write", Intrinsic{IntrinsicType::DMA_WRITE, NOP_REGISTER}},
-	{"vc4cl_vector_rotate", Intrinsic{IntrinsicType::VECTOR_ROTATE, NOP_REGISTER}}
-};
+static Optional<Value> foldFmin(const Value& val0, const Value& val1)
+{
+	return Value(Literal(std::min(val0.literal.real, val1.literal.real)), TYPE_FLOAT);
+}
 
-const static std::map<std::string, Intrinsic> ternaryIntrinsicMapping = {
-	{"vc4cl_dma_copy", Intrinsic{IntrinsicType::DMA_COPY, NOP_REGISTER}}
+static Optional<Value> foldFmaxabs(const Value& val0, const Value& val1)
+{
+	return Value(Literal(std::max(std::abs(val0.literal.real), std::abs(val1.literal.real))), TYPE_FLOAT);
+}
+
+static Optional<Value> foldFminabs(const Value& val0, const Value& val1)
+{
+	return Value(Literal(std::min(std::abs(val0.literal.real), std::abs(val1.literal.real))), TYPE_FLOAT);
+}
+
+//FIXME sign / no-sign!!
+static Optional<Value> foldShr(const Value& val0, const Value& val1)
+{
+	return Value(Literal(val0.literal.integer >> val1.literal.integer), val0.type.getUnionType(val1.type));
+}
+
+static Optional<Value> foldShl(const Value& val0, const Value& val1)
+{
+	return Value(Literal(val0.literal.integer << val1.literal.integer), val0.type.getUnionType(val1.type));
+}
+
+static Optional<Value> foldMin(const Value& val0, const Value& val1)
+{
+	return Value(Literal(std::min(val0.literal.integer, val1.literal.integer)), val0.type.getUnionType(val1.type));
+}
+
+static Optional<Value> foldMax(const Value& val0, const Value& val1)
+{
+	return Value(Literal(std::max(val0.literal.integer, val1.literal.integer)), val0.type.getUnionType(val1.type));
+}
+
+static Optional<Value> foldAnd(const Value& val0, const Value& val1)
+{
+	return Value(Literal(val0.literal.integer & val1.literal.integer), val0.type.getUnionType(val1.type));
+}
+
+static Optional<Value> foldMul24(const Value& val0, const Value& val1)
+{
+	return Value(Literal((val0.literal.integer & 0xFFFFFFL) * (val1.literal.integer & 0xFFFFFFL)), val0.type.getUnionType(val1.type));
+}
+
+/*
+ * Compact description of an intrinsic function, only containing plain values, so the table can be built at compile-time
+ */
+struct Intrinsic
+{
+	const char* name;
+	const IntrinsicType type;
+	//the number of arguments, not counting the optional sign-flag
+	const unsigned char numArguments;
+	//the operation to execute for ADD_ALU and MUL_ALU intrinsics
+	const char* opCode;
+	//the register to read from for VALUE_READ or to write to for SFU intrinsics
+	const Register reg;
+	//pre-calculates the result for literal arguments, if set
+	const UnaryFolding unaryFolding;
+	const BinaryFolding binaryFolding;
+	//the bit-mask to apply for TYPE_CAST intrinsics, zero for simple moves
+	const unsigned long typeCastMask;
+	const bool withSignFlag;
+	//the pack-mode to apply to the result of ADD_ALU, MUL_ALU and TYPE_CAST intrinsics, e.g. to saturate the result
+	const Pack packMode;
 };
 
-const static std::map<std::string, std::pair<Intrinsic, Optional<Value>>> typeCastIntrinsics = {
-    {"vc4cl_bitcast_uchar", {Intrinsic{IntrinsicType::ADD_ALU, "and", [](const Value& val){return Value(Literal(val.literal.integer & 0xFF), TYPE_INT8);}, true}, Value(Literal(0xFFUL), TYPE_INT8)}},
-    {"vc4cl_bitcast_char", {Intrinsic{IntrinsicType::ADD_ALU, "and", [](const Value& val){return Value(Literal(val.literal.integer & 0xFF), TYPE_INT8);}}, Value(Literal(0xFFUL), TYPE_INT8)}},
-    {"vc4cl_bitcast_ushort", {Intrinsic{IntrinsicType::ADD_ALU, "and", [](const Value& val){return Value(Literal(val.literal.integer & 0xFFFF), TYPE_INT16);}, true}, Value(Literal(0xFFFFUL), TYPE_INT16)}},
-    {"vc4cl_bitcast_short", {Intrinsic{IntrinsicType::ADD_ALU, "and", [](const Value& val){return Value(Literal(val.literal.integer & 0xFFFF), TYPE_INT16);}}, Value(Literal(0xFFFFUL), TYPE_INT16)}},
-    {"vc4cl_bitcast_uint", {Intrinsic{IntrinsicType::ADD_ALU, "mov", [](const Value& val){return Value(Literal(val.literal.integer & 0xFFFFFFFFUL), TYPE_INT32);}, true}, NO_VALUE}},
-    {"vc4cl_bitcast_int", {Intrinsic{IntrinsicType::ADD_ALU, "mov", [](const Value& val){return Value(Literal(val.literal.integer & 0xFFFFFFFFUL), TYPE_INT32);}}, NO_VALUE}},
-    {"vc4cl_bitcast_float", {Intrinsic{IntrinsicType::ADD_ALU, "mov", [](const Value& val){return Value(Literal(val.literal.integer & 0xFFFFFFFFUL), TYPE_INT32);}}, NO_VALUE}}
+/*
+ * All intrinsic functions, sorted by name (see the static assertion below), so they can be looked up by binary search
+ */
+static constexpr Intrinsic INTRINSICS[] = {
+	{"vc4cl_and", IntrinsicType::ADD_ALU, 2, "and", REG_NOP, nullptr, foldAnd, 0, false, PACK_NOP},
+	{"vc4cl_asr", IntrinsicType::ADD_ALU, 2, "asr", REG_NOP, nullptr, foldShr, 0, false, PACK_NOP},
+	{"vc4cl_bitcast_char", IntrinsicType::TYPE_CAST, 1, "and", REG_NOP, nullptr, nullptr, 0xFF, false, PACK_NOP},
+	{"vc4cl_bitcast_float", IntrinsicType::TYPE_CAST, 1, "mov", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_bitcast_int", IntrinsicType::TYPE_CAST, 1, "mov", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_bitcast_short", IntrinsicType::TYPE_CAST, 1, "and", REG_NOP, nullptr, nullptr, 0xFFFF, false, PACK_NOP},
+	{"vc4cl_bitcast_uchar", IntrinsicType::TYPE_CAST, 1, "and", REG_NOP, nullptr, nullptr, 0xFF, true, PACK_NOP},
+	{"vc4cl_bitcast_uint", IntrinsicType::TYPE_CAST, 1, "mov", REG_NOP, nullptr, nullptr, 0, true, PACK_NOP},
+	{"vc4cl_bitcast_ushort", IntrinsicType::TYPE_CAST, 1, "and", REG_NOP, nullptr, nullptr, 0xFFFF, true, PACK_NOP},
+	{"vc4cl_clz", IntrinsicType::ADD_ALU, 1, "clz", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_dma_copy", IntrinsicType::DMA_COPY, 3, "", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_dma_read", IntrinsicType::DMA_READ, 1, "", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_dma_write", IntrinsicType::DMA_WRITE, 2, "", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_element_number", IntrinsicType::VALUE_READ, 0, "", REG_ELEMENT_NUMBER, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_fmax", IntrinsicType::ADD_ALU, 2, "fmax", REG_NOP, nullptr, foldFmax, 0, false, PACK_NOP},
+	{"vc4cl_fmaxabs", IntrinsicType::ADD_ALU, 2, "fmaxabs", REG_NOP, nullptr, foldFmaxabs, 0, false, PACK_NOP},
+	{"vc4cl_fmin", IntrinsicType::ADD_ALU, 2, "fmin", REG_NOP, nullptr, foldFmin, 0, false, PACK_NOP},
+	{"vc4cl_fminabs", IntrinsicType::ADD_ALU, 2, "fminabs", REG_NOP, nullptr, foldFminabs, 0, false, PACK_NOP},
+	{"vc4cl_ftoi", IntrinsicType::ADD_ALU, 1, "ftoi", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_itof", IntrinsicType::ADD_ALU, 1, "itof", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_max", IntrinsicType::ADD_ALU, 2, "max", REG_NOP, nullptr, foldMax, 0, true, PACK_NOP},
+	{"vc4cl_min", IntrinsicType::ADD_ALU, 2, "min", REG_NOP, nullptr, foldMin, 0, true, PACK_NOP},
+	{"vc4cl_mul24", IntrinsicType::MUL_ALU, 2, "mul24", REG_NOP, nullptr, foldMul24, 0, true, PACK_NOP},
+	{"vc4cl_mutex_lock", IntrinsicType::MUTEX_LOCK, 0, "", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_mutex_unlock", IntrinsicType::MUTEX_UNLOCK, 0, "", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_qpu_number", IntrinsicType::VALUE_READ, 0, "", REG_QPU_NUMBER, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_ror", IntrinsicType::ADD_ALU, 2, "ror", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_saturate_lsb", IntrinsicType::TYPE_CAST, 1, "mov", REG_NOP, nullptr, nullptr, 0, false, PACK_INT_TO_UNSIGNED_CHAR_SATURATE},
+	{"vc4cl_saturate_short", IntrinsicType::TYPE_CAST, 1, "mov", REG_NOP, nullptr, nullptr, 0, false, PACK_INT_TO_SIGNED_SHORT_SATURATE},
+	{"vc4cl_saturated_add", IntrinsicType::ADD_ALU, 2, "add", REG_NOP, nullptr, nullptr, 0, false, PACK_32_32},
+	{"vc4cl_saturated_sub", IntrinsicType::ADD_ALU, 2, "sub", REG_NOP, nullptr, nullptr, 0, false, PACK_32_32},
+	{"vc4cl_semaphore_decrement", IntrinsicType::SEMAPHORE_DECREMENT, 1, "", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_semaphore_increment", IntrinsicType::SEMAPHORE_INCREMENT, 1, "", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_sfu_exp2", IntrinsicType::SFU, 1, "", REG_SFU_EXP2, foldExp2, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_sfu_log2", IntrinsicType::SFU, 1, "", REG_SFU_LOG2, foldLog2, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_sfu_recip", IntrinsicType::SFU, 1, "", REG_SFU_RECIP, foldRecip, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_sfu_rsqrt", IntrinsicType::SFU, 1, "", REG_SFU_RECIP_SQRT, foldRecipSqrt, nullptr, 0, false, PACK_NOP},
+	{"vc4cl_shl", IntrinsicType::ADD_ALU, 2, "shl", REG_NOP, nullptr, foldShl, 0, false, PACK_NOP},
+	{"vc4cl_shr", IntrinsicType::ADD_ALU, 2, "shr", REG_NOP, nullptr, foldShr, 0, false, PACK_NOP},
+	{"vc4cl_vector_rotate", IntrinsicType::VECTOR_ROTATE, 2, "", REG_NOP, nullptr, nullptr, 0, false, PACK_NOP}
 };
+static constexpr std::size_t NUM_INTRINSICS = sizeof(INTRINSICS) / sizeof(INTRINSICS[0]);
 
-static InstructionWalker intrinsifyNoArgs(Method& method, InstructionWalker it)
+static constexpr bool isNameLess(const char* first, const char* second)
+{
+	return *first != *second ? static_cast<unsigned char>(*first) < static_cast<unsigned char>(*second) : (*first != '\0' && isNameLess(first + 1, second + 1));
+}
+
+static constexpr bool isSortedFrom(const std::size_t index)
+{
+	return index + 1 >= NUM_INTRINSICS || (isNameLess(INTRINSICS[index].name, INTRINSICS[index + 1].name) && isSortedFrom(index + 1));
+}
+static_assert(isSortedFrom(0), "Intrinsics need to be sorted by name");
+
+/*
+ * Returns the length of the common prefix of the (zero-terminated) intrinsic name and the method-name, starting at the given position
+ */
+static std::size_t getCommonPrefixLength(const char* name, const std::string& methodName, const std::size_t start)
+{
+	std::size_t length = 0;
+	while(name[length] != '\0' && start + length < methodName.size() && name[length] == methodName[start + length])
+		++length;
+	return length;
+}
+
+/*
+ * Looks up the intrinsic called by the given method-name.
+ *
+ * The method-names are not cleaned of all type-suffixes, so this looks for the longest intrinsic name starting at the "vc4cl_" prefix
+ * (e.g. "vc4cl_fminabs" instead of "vc4cl_fmin")
+ */
+static const Intrinsic* findIntrinsic(const std::string& methodName)
+{
+	const std::size_t start = methodName.find(INTRINSIC_PREFIX);
+	if(start == std::string::npos)
+		return nullptr;
+	//the first entry sorted after the method-name, all intrinsic names, which are a prefix of the method-name, are sorted before
+	const Intrinsic* entry = std::upper_bound(INTRINSICS, INTRINSICS + NUM_INTRINSICS, methodName, [start](const std::string& name, const Intrinsic& intrinsic) -> bool
+	{
+		return name.compare(start, std::string::npos, intrinsic.name) < 0;
+	});
+	//all entries between an intrinsic name, which is a prefix of the method-name, and the method-name share this prefix,
+	//so we can stop as soon as the common prefix is not longer than the "vc4cl_" prefix
+	while(entry != INTRINSICS)
+	{
+		--entry;
+		const std::size_t length = getCommonPrefixLength(entry->name, methodName, start);
+		if(entry->name[length] == '\0')
+			return entry;
+		if(length <= INTRINSIC_PREFIX.size())
+			break;
+	}
+	return nullptr;
+}
+
+static InstructionWalker intrinsifyNoArgs(Method& method, InstructionWalker it, const Intrinsic& intrinsic)
 {
     MethodCall* callSite = it.get<MethodCall>();
-    if(callSite == nullptr)
-    {
-        return it;
-    }
     if(callSite->getArguments().size() > 1 /* check for sign-flag too*/)
     {
         return it;
     }
-    for(const auto& pair : nonaryInstrinsics)
-    {
-        if(callSite->methodName.find(pair.first) != std::string::npos)
-        {
-            logging::debug() << "Intrinsifying method-call without arguments to " << callSite->methodName << logging::endl;
-            if(pair.second.type == IntrinsicType::VALUE_READ)
-            {
-                it.reset(new MoveOperation(callSite->getOutput(), pair.second.val));
-            }
-            else if(pair.second.type == IntrinsicType::MUTEX_LOCK)
-            {
-                it.reset(new MoveOperation(NOP_REGISTER, MUTEX_REGISTER));
-            }
-            else if(pair.second.type == IntrinsicType::MUTEX_UNLOCK)
-            {
-                it.reset(new MoveOperation(MUTEX_REGISTER, BOOL_TRUE));
-            }
-            else
-            {
-                throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled no-arg intrisics", pair.first);
-            }
-            return it;
-        }
-    }
-    return it;
+	DEBUG_LOG("Intrinsifying method-call without arguments to " << callSite->methodName << logging::endl);
+	if(intrinsic.type == IntrinsicType::VALUE_READ)
+	{
+		const DataType type = intrinsic.reg == REG_ELEMENT_NUMBER ? ELEMENT_NUMBER_REGISTER.type : TYPE_INT8;
+		it.reset(new MoveOperation(callSite->getOutput(), Value(intrinsic.reg, type)));
+	}
+	else if(intrinsic.type == IntrinsicType::MUTEX_LOCK)
+	{
+		it.reset(new MoveOperation(NOP_REGISTER, MUTEX_REGISTER));
+	}
+	else if(intrinsic.type == IntrinsicType::MUTEX_UNLOCK)
+	{
+		it.reset(new MoveOperation(MUTEX_REGISTER, BOOL_TRUE));
+	}
+	else
+	{
+		throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled no-arg intrisics", intrinsic.name);
+	}
+	return it;
 }
 
-static InstructionWalker intrinsifyUnary(Method& method, InstructionWalker it)
+static InstructionWalker intrinsifyUnary(Method& method, InstructionWalker it, const Intrinsic& intrinsic, const MathType mathType)
 {
     MethodCall* callSite = it.get<MethodCall>();
-    if(callSite == nullptr)
-    {
-        return it;
-    }
     if(callSite->getArguments().size() == 0 || callSite->getArguments().size() > 2 /* check for sign-flag too*/)
     {
         return it;
     }
-    for(const auto& pair : unaryIntrinsicMapping)
-    {
-        if(callSite->methodName.find(pair.first) != std::string::npos)
-        {
-        	if(callSite->getArgument(0).get().hasType(ValueType::LITERAL) && pair.second.unaryInstr && pair.second.unaryInstr.get()(callSite->getArgument(0)).hasValue)
-        	{
-        		logging::debug() << "Intrinsifying unary '" << callSite->to_string() << "' to pre-calculated value" << logging::endl;
-        		it.reset(new MoveOperation(callSite->getOutput(), pair.second.unaryInstr.get()(callSite->getArgument(0)), callSite->conditional, callSite->setFlags));
-        	}
-        	else if(pair.second.type == IntrinsicType::SFU)
-            {
-				logging::debug() << "Intrinsifying unary '" << callSite->to_string() << "' to SFU call" << logging::endl;
-				it = insertSFUCall(pair.second.val.reg, it, callSite->getArgument(0), callSite->conditional, callSite->setFlags);
-				//3. write result to output (from r4)
-				it.reset(new MoveOperation(callSite->getOutput(), Value(REG_SFU_OUT, callSite->getOutput().get().type), COND_ALWAYS));
-            }
-            else if(pair.second.type == IntrinsicType::ADD_ALU || pair.second.type == IntrinsicType::MUL_ALU)
-            {
-                logging::debug() << "Intrinsifying unary '" << callSite->to_string() << "' to operation " << pair.second.opCode << logging::endl;
-                it.reset(new Operation(pair.second.opCode, callSite->getOutput(), callSite->getArgument(0), COND_ALWAYS));
-            }
-            else if(pair.second.type == IntrinsicType::NOOP)
-            {
-                logging::debug() << "Skipping no-op " << callSite->to_string() << logging::endl;
-                it.erase();
-                //so next instruction is not skipped
-                it.previousInBlock();
-            }
-            else if(pair.second.type == IntrinsicType::DMA_READ)
-            {
-                logging::debug() << "Intrinsifying memory read " << callSite->to_string() << logging::endl;
-                it = periphery::insertReadDMA(method, it, callSite->getOutput(), callSite->getArgument(0), false);
-                it.erase();
-                //so next instruction is not skipped
-                it.previousInBlock();
-            }
-            else if(pair.second.type == IntrinsicType::SEMAPHORE_INCREMENT)
-            {
-            	if(!callSite->getArgument(0).get().hasType(ValueType::LITERAL))
-            		throw CompilationError(CompilationStep::OPTIMIZER, "Semaphore-number needs to be a compile-time constant", callSite->to_string());
-            	if(callSite->getArgument(0).get().literal.integer < 0 || callSite->getArgument(0).get().literal.integer >= 16)
-            		throw CompilationError(CompilationStep::OPTIMIZER, "Semaphore-number needs to be between 0 and 15", callSite->to_string());
-            	logging::debug() << "Intrinsifying semaphore increment with instruction" << logging::endl;
-            	it.reset(new SemaphoreAdjustment(static_cast<Semaphore>(callSite->getArgument(0).get().literal.integer), true, callSite->conditional, callSite->setFlags));
-            }
-            else if(pair.second.type == IntrinsicType::SEMAPHORE_DECREMENT)
-			{
-            	if(!callSite->getArgument(0).get().hasType(ValueType::LITERAL))
-					throw CompilationError(CompilationStep::OPTIMIZER, "Semaphore-number needs to be a compile-time constant", callSite->to_string());
-				if(callSite->getArgument(0).get().literal.integer < 0 || callSite->getArgument(0).get().literal.integer >= 16)
-					throw CompilationError(CompilationStep::OPTIMIZER, "Semaphore-number needs to be between 0 and 15", callSite->to_string());
-				logging::debug() << "Intrinsifying semaphore decrement with instruction" << logging::endl;
-				it.reset(new SemaphoreAdjustment(static_cast<Semaphore>(callSite->getArgument(0).get().literal.integer), false, callSite->conditional, callSite->setFlags));
-			}
-            else
-            {
-                throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled unary intrisics", pair.first);
-            }
-        	const bool isUnsigned = pair.second.withSignFlag && callSite->getArgument(2).hasValue && callSite->getArgument(2).get().literal.integer == VC4CL_UNSIGNED;
-        	if(isUnsigned)
-        		it->setDecorations(InstructionDecorations::UNSIGNED_RESULT);
-            return it;
-        }
-    }
-    for(const auto& pair : typeCastIntrinsics)
-    {
-        if(callSite->methodName.find(pair.first) != std::string::npos)
-        {
-        	if(callSite->getArgument(0).get().hasType(ValueType::LITERAL) && pair.second.first.unaryInstr && pair.second.first.unaryInstr.get()(callSite->getArgument(0)).hasValue)
-			{
-				logging::debug() << "Intrinsifying type-cast '" << callSite->to_string() << "' to pre-calculated value" << logging::endl;
-				it.reset(new MoveOperation(callSite->getOutput(), pair.second.first.unaryInstr.get()(callSite->getArgument(0)), callSite->conditional, callSite->setFlags));
-			}
-        	else if(!pair.second.second.hasValue)	//there is no value to apply -> simple move
-        	{
-        		logging::debug() << "Intrinsifying '" << callSite->to_string() << "' to simple move" << logging::endl;
-				it.reset(new MoveOperation(callSite->getOutput(), callSite->getArgument(0)));
-        	}
-        	else if(pair.second.first.type == IntrinsicType::ADD_ALU || pair.second.first.type == IntrinsicType::MUL_ALU)
-            {
-        		//TODO could use pack-mode here, but only for UNSIGNED values!!
-				logging::debug() << "Intrinsifying '" << callSite->to_string() << "' to operation " << pair.second.first.opCode << " with constant " << pair.second.second.to_string() << logging::endl;
-                it.reset(new Operation(pair.second.first.opCode, callSite->getOutput(), callSite->getArgument(0), pair.second.second, COND_ALWAYS));
-            }
-            else
-            {
-                throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled type-cast intrisics", pair.first);
-            }
-			if(pair.second.first.withSignFlag)
-				it->setDecorations(InstructionDecorations::UNSIGNED_RESULT);
-            return it;
-        }
-    }
-    return it;
+	if(callSite->getArgument(0).get().hasType(ValueType::LITERAL) && intrinsic.unaryFolding != nullptr && intrinsic.unaryFolding(callSite->getArgument(0)).hasValue)
+	{
+		DEBUG_LOG("Intrinsifying unary '" << callSite->to_string() << "' to pre-calculated value" << logging::endl);
+		it.reset(new MoveOperation(callSite->getOutput(), intrinsic.unaryFolding(callSite->getArgument(0)), callSite->conditional, callSite->setFlags));
+	}
+	else if(intrinsic.type == IntrinsicType::SFU)
+	{
+		DEBUG_LOG("Intrinsifying unary '" << callSite->to_string() << "' to SFU call" << logging::endl);
+		if(mathType == MathType::FAST)
+		{
+			it = insertSFUCall(intrinsic.reg, it, callSite->getArgument(0), callSite->conditional, callSite->setFlags);
+			//3. write result to output (from r4)
+			it.reset(new MoveOperation(callSite->getOutput(), Value(REG_SFU_OUT, callSite->getOutput().get().type), COND_ALWAYS));
+		}
+		else
+		{
+			//the more accurate results are calculated with several instructions
+			it = insertSFUFunction(method, it, intrinsic.reg, callSite->getArgument(0), callSite->getOutput(), mathType);
+			it.erase();
+			//so next instruction is not skipped
+			it.previousInBlock();
+		}
+	}
+	else if(intrinsic.type == IntrinsicType::ADD_ALU || intrinsic.type == IntrinsicType::MUL_ALU)
+	{
+		DEBUG_LOG("Intrinsifying unary '" << callSite->to_string() << "' to operation " << intrinsic.opCode << logging::endl);
+		it.reset(new Operation(intrinsic.opCode, callSite->getOutput(), callSite->getArgument(0), COND_ALWAYS));
+	}
+	else if(intrinsic.type == IntrinsicType::NOOP)
+	{
+		DEBUG_LOG("Skipping no-op " << callSite->to_string() << logging::endl);
+		it.erase();
+		//so next instruction is not skipped
+		it.previousInBlock();
+	}
+	else if(intrinsic.type == IntrinsicType::DMA_READ)
+	{
+		DEBUG_LOG("Intrinsifying memory read " << callSite->to_string() << logging::endl);
+		it = periphery::insertReadDMA(method, it, callSite->getOutput(), callSite->getArgument(0), false);
+		it.erase();
+		//so next instruction is not skipped
+		it.previousInBlock();
+	}
+	else if(intrinsic.type == IntrinsicType::SEMAPHORE_INCREMENT)
+	{
+		if(!callSite->getArgument(0).get().hasType(ValueType::LITERAL))
+			throw CompilationError(CompilationStep::OPTIMIZER, "Semaphore-number needs to be a compile-time constant", callSite->to_string());
+		if(callSite->getArgument(0).get().literal.integer < 0 || callSite->getArgument(0).get().literal.integer >= 16)
+			throw CompilationError(CompilationStep::OPTIMIZER, "Semaphore-number needs to be between 0 and 15", callSite->to_string());
+		DEBUG_LOG("Intrinsifying semaphore increment with instruction" << logging::endl);
+		it.reset(new SemaphoreAdjustment(static_cast<Semaphore>(callSite->getArgument(0).get().literal.integer), true, callSite->conditional, callSite->setFlags));
+	}
+	else if(intrinsic.type == IntrinsicType::SEMAPHORE_DECREMENT)
+	{
+		if(!callSite->getArgument(0).get().hasType(ValueType::LITERAL))
+			throw CompilationError(CompilationStep::OPTIMIZER, "Semaphore-number needs to be a compile-time constant", callSite->to_string());
+		if(callSite->getArgument(0).get().literal.integer < 0 || callSite->getArgument(0).get().literal.integer >= 16)
+			throw CompilationError(CompilationStep::OPTIMIZER, "Semaphore-number needs to be between 0 and 15", callSite->to_string());
+		DEBUG_LOG("Intrinsifying semaphore decrement with instruction" << logging::endl);
+		it.reset(new SemaphoreAdjustment(static_cast<Semaphore>(callSite->getArgument(0).get().literal.integer), false, callSite->conditional, callSite->setFlags));
+	}
+	else
+	{
+		throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled unary intrisics", intrinsic.name);
+	}
+	const bool isUnsigned = intrinsic.withSignFlag && callSite->getArgument(2).hasValue && callSite->getArgument(2).get().literal.integer == VC4CL_UNSIGNED;
+	if(isUnsigned)
+		it->setDecorations(InstructionDecorations::UNSIGNED_RESULT);
+	return it;
 }
 
-static InstructionWalker intrinsifyBinary(Method& method, InstructionWalker it)
+static InstructionWalker intrinsifyTypeCast(Method& method, InstructionWalker it, const Intrinsic& intrinsic)
 {
     MethodCall* callSite = it.get<MethodCall>();
-    if(callSite == nullptr)
+    if(callSite->getArguments().size() == 0 || callSite->getArguments().size() > 2 /* check for sign-flag too*/)
     {
         return it;
     }
+	if(intrinsic.typeCastMask == 0)	//there is no value to apply -> simple move
+	{
+		DEBUG_LOG("Intrinsifying '" << callSite->to_string() << "' to simple move" << logging::endl);
+		it.reset((new MoveOperation(callSite->getOutput(), callSite->getArgument(0)))->setPackMode(intrinsic.packMode));
+	}
+	else
+	{
+		//TODO could use pack-mode here, but only for UNSIGNED values!!
+		const Value mask(Literal(intrinsic.typeCastMask), intrinsic.typeCastMask <= 0xFF ? TYPE_INT8 : TYPE_INT16);
+		DEBUG_LOG("Intrinsifying '" << callSite->to_string() << "' to operation " << intrinsic.opCode << " with constant " << mask.to_string() << logging::endl);
+		it.reset(new Operation(intrinsic.opCode, callSite->getOutput(), callSite->getArgument(0), mask, COND_ALWAYS));
+	}
+	if(intrinsic.withSignFlag)
+		it->setDecorations(InstructionDecorations::UNSIGNED_RESULT);
+	return it;
+}
+
+static InstructionWalker intrinsifyBinary(Method& method, InstructionWalker it, const Intrinsic& intrinsic)
+{
+    MethodCall* callSite = it.get<MethodCall>();
     if(callSite->getArguments().size() < 2 || callSite->getArguments().size() > 3 /* check for sign-flag too*/)
     {
         return it;
     }
-    for(const auto& pair : binaryIntrinsicMapping)
-    {
-        if(callSite->methodName.find(pair.first) != std::string::npos)
-        {
-        	if(callSite->getArgument(0).get().hasType(ValueType::LITERAL) && callSite->getArgument(1).get().hasType(ValueType::LITERAL) && pair.second.binaryInstr && pair.second.binaryInstr.get()(callSite->getArgument(0), callSite->getArgument(1)).hasValue)
-			{
-				logging::debug() << "Intrinsifying binary '" << callSite->to_string() << "' to pre-calculated value" << logging::endl;
-				it.reset(new MoveOperation(callSite->getOutput(), pair.second.binaryInstr.get()(callSite->getArgument(0), callSite->getArgument(1)), callSite->conditional, callSite->setFlags));
-			}
-        	else if(pair.second.type == IntrinsicType::ADD_ALU || pair.second.type == IntrinsicType::MUL_ALU)
-            {
-                logging::debug() << "Intrinsifying binary '" << callSite->to_string() << "' to operation " << pair.second.opCode << logging::endl;
-                it.reset(new Operation(pair.second.opCode, callSite->getOutput(), callSite->getArgument(0), callSite->getArgument(1), COND_ALWAYS));
-            }
-            else if(pair.second.type == IntrinsicType::DMA_WRITE)
-            {
-                logging::debug() << "Intrinsifying memory write " << callSite->to_string() << logging::endl;
-                it = periphery::insertWriteDMA(method, it, callSite->getArgument(1), callSite->getArgument(0), false);
-                it.erase();
-                //so next instruction is not skipped
-                it.previousInBlock();
-            }
-            else if(pair.second.type == IntrinsicType::VECTOR_ROTATE)
-            {
-            	logging::debug() << "Intrinsifying vector rotation " << callSite->to_string() << logging::endl;
-            	it = insertVectorRotation(it, callSite->getArgument(0), callSite->getArgument(1), callSite->getOutput(), Direction::UP);
-            	it.erase();
-				//so next instruction is not skipped
-            	it.previousInBlock();
-            }
-            else
-            {
-                throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled binary intrisics", pair.first);
-            }
-        	const bool isUnsigned = pair.second.withSignFlag && callSite->getArgument(3).hasValue && callSite->getArgument(3).get().literal.integer == VC4CL_UNSIGNED;
-        	if(isUnsigned)
-				it->setDecorations(InstructionDecorations::UNSIGNED_RESULT);
-            return it;
-        }
-    }
-    return it;
+	if(callSite->getArgument(0).get().hasType(ValueType::LITERAL) && callSite->getArgument(1).get().hasType(ValueType::LITERAL) && intrinsic.binaryFolding != nullptr && intrinsic.binaryFolding(callSite->getArgument(0), callSite->getArgument(1)).hasValue)
+	{
+		DEBUG_LOG("Intrinsifying binary '" << callSite->to_string() << "' to pre-calculated value" << logging::endl);
+		it.reset(new MoveOperation(callSite->getOutput(), intrinsic.binaryFolding(callSite->getArgument(0), callSite->getArgument(1)), callSite->conditional, callSite->setFlags));
+	}
+	else if(intrinsic.type == IntrinsicType::ADD_ALU || intrinsic.type == IntrinsicType::MUL_ALU)
+	{
+		DEBUG_LOG("Intrinsifying binary '" << callSite->to_string() << "' to operation " << intrinsic.opCode << logging::endl);
+		//e.g. the saturating addition and subtraction apply the saturation via the pack-mode of the write
+		it.reset((new Operation(intrinsic.opCode, callSite->getOutput(), callSite->getArgument(0), callSite->getArgument(1), COND_ALWAYS))->setPackMode(intrinsic.packMode));
+	}
+	else if(intrinsic.type == IntrinsicType::DMA_WRITE)
+	{
+		DEBUG_LOG("Intrinsifying memory write " << callSite->to_string() << logging::endl);
+		it = periphery::insertWriteDMA(method, it, callSite->getArgument(1), callSite->getArgument(0), false);
+		it.erase();
+		//so next instruction is not skipped
+		it.previousInBlock();
+	}
+	else if(intrinsic.type == IntrinsicType::VECTOR_ROTATE)
+	{
+		DEBUG_LOG("Intrinsifying vector rotation " << callSite->to_string() << logging::endl);
+		it = insertVectorRotation(it, callSite->getArgument(0), callSite->getArgument(1), callSite->getOutput(), Direction::UP);
+		it.erase();
+		//so next instruction is not skipped
+		it.previousInBlock();
+	}
+	else
+	{
+		throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled binary intrisics", intrinsic.name);
+	}
+	const bool isUnsigned = intrinsic.withSignFlag && callSite->getArgument(3).hasValue && callSite->getArgument(3).get().literal.integer == VC4CL_UNSIGNED;
+	if(isUnsigned)
+		it->setDecorations(InstructionDecorations::UNSIGNED_RESULT);
+	return it;
 }
 
-static InstructionWalker intrinsifyTernary(Method& method, InstructionWalker it)
+static InstructionWalker intrinsifyTernary(Method& method, InstructionWalker it, const Intrinsic& intrinsic)
 {
     MethodCall* callSite = it.get<MethodCall>();
-    if(callSite == nullptr)
-    {
-        return it;
-    }
     if(callSite->getArguments().size() < 3 || callSite->getArguments().size() > 4 /* check for sign-flag too*/)
     {
         return it;
     }
-    for(const auto& pair : ternaryIntrinsicMapping)
-    {
-        if(callSite->methodName.find(pair.first) != std::string::npos)
-        {
-            if(pair.second.type == IntrinsicType::ADD_ALU || pair.second.type == IntrinsicType::MUL_ALU)
-            {
-                logging::debug() << "Intrinsifying ternary '" << callSite->to_string() << "' to operation " << pair.second.opCode << logging::endl;
-                it.emplace(new Operation(pair.second.opCode, callSite->getOutput(), callSite->getArgument(0), callSite->getArgument(1)));
-            }
-            else if(pair.second.type == IntrinsicType::DMA_COPY)
-            {
-			   logging::debug() << "Intrinsifying ternary '" << callSite->to_string() << "' to DMA copy operation " << logging::endl;
-			   const DataType type = callSite->getArgument(0).get().type.getElementType();
-			   //TODO number of elements!
-			   it = method.vpm->insertReadRAM(it, callSite->getArgument(1), type, false);
-			   it = method.vpm->insertWriteRAM(it, callSite->getArgument(0), type, false);
-			   it.erase();
-			   //so next instruction is not skipped
-			   it.previousInBlock();
-            }
-            else
-            {
-                throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled ternary intrisics", pair.first);
-            }
-            const bool isUnsigned = pair.second.withSignFlag && callSite->getArgument(4).hasValue && callSite->getArgument(4).get().literal.integer == VC4CL_UNSIGNED;
-            if(isUnsigned)
-            	it->setDecorations(InstructionDecorations::UNSIGNED_RESULT);
-            return it;
-        }
-    }
-    return it;
+	if(intrinsic.type == IntrinsicType::ADD_ALU || intrinsic.type == IntrinsicType::MUL_ALU)
+	{
+		DEBUG_LOG("Intrinsifying ternary '" << callSite->to_string() << "' to operation " << intrinsic.opCode << logging::endl);
+		it.emplace(new Operation(intrinsic.opCode, callSite->getOutput(), callSite->getArgument(0), callSite->getArgument(1)));
+	}
+	else if(intrinsic.type == IntrinsicType::DMA_COPY)
+	{
+		DEBUG_LOG("Intrinsifying ternary '" << callSite->to_string() << "' to DMA copy operation " << logging::endl);
+		const DataType type = callSite->getArgument(0).get().type.getElementType();
+		//TODO number of elements!
+		it = method.vpm->insertReadRAM(it, callSite->getArgument(1), type, false);
+		it = method.vpm->insertWriteRAM(it, callSite->getArgument(0), type, false);
+		it.erase();
+		//so next instruction is not skipped
+		it.previousInBlock();
+	}
+	else
+	{
+		throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled ternary intrisics", intrinsic.name);
+	}
+	const bool isUnsigned = intrinsic.withSignFlag && callSite->getArgument(4).hasValue && callSite->getArgument(4).get().literal.integer == VC4CL_UNSIGNED;
+	if(isUnsigned)
+		it->setDecorations(InstructionDecorations::UNSIGNED_RESULT);
+	return it;
+}
+
+/*
+ * Dispatches the call to an intrinsic function to the intrinsification matching its number of arguments
+ */
+static InstructionWalker intrinsifyCall(Method& method, InstructionWalker it, const MathType mathType)
+{
+	MethodCall* callSite = it.get<MethodCall>();
+	if(callSite == nullptr)
+		return it;
+	//the name is resolved only once per call-site
+	const Intrinsic* intrinsic = findIntrinsic(callSite->methodName);
+	if(intrinsic == nullptr)
+		return it;
+	if(intrinsic->type == IntrinsicType::TYPE_CAST)
+		return intrinsifyTypeCast(method, it, *intrinsic);
+	switch(intrinsic->numArguments)
+	{
+		case 0:
+			return intrinsifyNoArgs(method, it, *intrinsic);
+		case 1:
+			return intrinsifyUnary(method, it, *intrinsic, mathType);
+		case 2:
+			return intrinsifyBinary(method, it, *intrinsic);
+		case 3:
+			return intrinsifyTernary(method, it, *intrinsic);
+	}
+	throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled number of arguments for intrinsic", intrinsic->name);
 }
 
 static void swapComparisons(const std::string& opCode, Comparison* comp)
@@ -379,6 +485,94 @@ static void swapComparisons(const std::string& opCode, Comparison* comp)
     comp->opCode = opCode;
 }
 
+/*
+ * Whether the value is the negation of the other value, i.e. written once by subtracting the other value from zero
+ */
+static bool isNegation(const Value& negated, const Value& value, const bool isFloating)
+{
+	if(!negated.hasType(ValueType::LOCAL))
+		return false;
+	const Operation* op = dynamic_cast<const Operation*>(negated.local->getSingleWriter());
+	return op != nullptr && op->opCode == (isFloating ? "fsub" : "sub") && op->conditional == COND_ALWAYS && !op->hasPackMode() && !op->hasUnpackMode() &&
+			op->getSecondArg() && op->getSecondArg().get() == value && op->getFirstArg().hasLiteral(isFloating ? Literal(0.0) : Literal(0L));
+}
+
+/*
+ * The front-ends lower a selection to a move setting the flags for the condition, followed by the moves of the values selected if the condition is true or false.
+ * If the condition is a (signed or floating-point) less-than comparison of the selected values, e.g. "select(a < b, a, b)",
+ * the comparison and the selection are replaced by the single native min/max operation of the ADD ALU.
+ * Clamping ("min(max(x, lo), hi)") is thus lowered to just the two native operations.
+ *
+ * Similarly, the selection of the absolute value ("select(a < 0, -a, a)") is replaced by a max of the value and its negation (integer)
+ * or by a fmaxabs of the value with itself (floating-point).
+ *
+ * Returns the walker to the instruction following the removed comparison, if the comparison and the selection were replaced
+ */
+static InstructionWalker intrinsifyMinMaxSelection(Method& method, InstructionWalker it, const Comparison* comp, const bool isFloating)
+{
+	const bool isLessThan = isFloating ? (comp->opCode == COMP_ORDERED_LT || comp->opCode == COMP_ORDERED_LE || comp->opCode == COMP_UNORDERED_LT ||
+			comp->opCode == COMP_UNORDERED_LE) : (comp->opCode == COMP_SIGNED_LT || comp->opCode == COMP_SIGNED_LE);
+	if(!isLessThan || comp->conditional != COND_ALWAYS || !comp->hasValueType(ValueType::LOCAL) || comp->getOutput().get().local->getUsers().getNumReaders() != 1)
+		return it;
+	const Local* condition = comp->getOutput().get().local;
+	const Value first = comp->getFirstArg();
+	const Value second = comp->getSecondArg();
+
+	//the compared values must not change until they are selected
+	InstructionWalker setter = it.copy().nextInBlock();
+	while(!setter.isEndOfBlock() && !(setter.has() && setter->readsLocal(condition)))
+	{
+		if(setter.has() && ((first.hasType(ValueType::LOCAL) && setter->writesLocal(first.local)) || (second.hasType(ValueType::LOCAL) && setter->writesLocal(second.local))))
+			return it;
+		setter.nextInBlock();
+	}
+	if(setter.isEndOfBlock() || !setter.has<MoveOperation>() || setter.has<VectorRotation>() || !setter->hasValueType(ValueType::REGISTER) || !setter->getOutput().get().hasRegister(REG_NOP) ||
+			setter->conditional != COND_ALWAYS || setter->setFlags != SetFlag::SET_FLAGS || setter->hasUnpackMode())
+		return it;
+	InstructionWalker trueMove = setter.copy().nextInBlock();
+	if(trueMove.isEndOfBlock())
+		return it;
+	InstructionWalker falseMove = trueMove.copy().nextInBlock();
+	const auto isSelectingMove = [](InstructionWalker move, const ConditionCode cond) -> bool
+	{
+		return !move.isEndOfBlock() && move.has<MoveOperation>() && !move.has<VectorRotation>() && move->conditional == cond && move->setFlags == SetFlag::DONT_SET &&
+				!move->hasPackMode() && !move->hasUnpackMode() && move->signal == Signaling::NO_SIGNAL && move->hasValueType(ValueType::LOCAL);
+	};
+	if(!isSelectingMove(trueMove, COND_ZERO_CLEAR) || !isSelectingMove(falseMove, COND_ZERO_SET) || trueMove->getOutput().get() != falseMove->getOutput().get())
+		return it;
+	const Value trueValue = trueMove.get<MoveOperation>()->getSource();
+	const Value falseValue = falseMove.get<MoveOperation>()->getSource();
+
+	std::string opCode;
+	Value arg0 = trueValue;
+	Value arg1 = falseValue;
+	if(trueValue == first && falseValue == second)
+		opCode = isFloating ? "fmin" : "min";
+	else if(trueValue == second && falseValue == first)
+		opCode = isFloating ? "fmax" : "max";
+	else if(second.hasLiteral(isFloating ? Literal(0.0) : Literal(0L)) && falseValue == first && isNegation(trueValue, first, isFloating))
+		//a < 0 ? -a : a
+		opCode = isFloating ? "fmaxabs" : "max";
+	else if(first.hasLiteral(isFloating ? Literal(0.0) : Literal(0L)) && trueValue == second && isNegation(falseValue, second, isFloating))
+		//0 < a ? a : -a
+		opCode = isFloating ? "fmaxabs" : "max";
+	else
+		return it;
+	if(opCode == "fmaxabs")
+	{
+		//the negation is not required anymore, fmaxabs(a, a) = |a|
+		arg0 = isNegation(trueValue, first, isFloating) ? falseValue : trueValue;
+		arg1 = arg0;
+	}
+
+	DEBUG_LOG("Replacing comparison '" << comp->to_string() << "' and selection with native '" << opCode << "' operation" << logging::endl);
+	const InstructionDecorations decorations = trueMove->decoration;
+	trueMove.reset((new Operation(opCode, trueMove->getOutput(), arg0, arg1))->setDecorations(decorations));
+	falseMove.erase();
+	setter.erase();
+	return it.erase();
+}
+
 static InstructionWalker intrinsifyComparison(Method& method, InstructionWalker it)
 {
     Comparison* comp = it.get<Comparison>();
@@ -386,7 +580,7 @@ static InstructionWalker intrinsifyComparison(Method& method, InstructionWalker
     {
         return it;
     }
-    logging::debug() << "Intrinsifying comparison '" << comp->opCode << "' to arithmetic operations" << logging::endl;
+    DEBUG_LOG("Intrinsifying comparison '" << comp->opCode << "' to arithmetic operations" << logging::endl);
     bool isFloating = comp->getFirstArg().type.isFloatingType();
     if(!isFloating)
     {
@@ -407,7 +601,10 @@ static InstructionWalker intrinsifyComparison(Method& method, InstructionWalker
         {
             swapComparisons(COMP_SIGNED_LT, comp);
         }
-            
+
+        auto newIt = intrinsifyMinMaxSelection(method, it, comp, isFloating);
+        if(newIt != it)
+            return newIt;
         it = intrinsifyIntegerRelation(method, it, comp);
     }
     else
@@ -429,7 +626,10 @@ static InstructionWalker intrinsifyComparison(Method& method, InstructionWalker
         {
             swapComparisons(COMP_UNORDERED_LT, comp);
         }
-        
+
+        auto newIt = intrinsifyMinMaxSelection(method, it, comp, isFloating);
+        if(newIt != it)
+            return newIt;
         it = intrinsifyFloatingRelation(method, it, comp);
     }
     
@@ -442,6 +642,69 @@ static bool isPowerTwo(long val)
     return val > 0 && (val & (val - 1)) == 0;
 }
 
+/*
+ * Whether the two shift offsets add up to 32, i.e. are both literals or one is calculated by subtracting the other from 32
+ */
+static bool isComplementaryShift(const Value& offset, const Value& otherOffset)
+{
+	if(offset.hasType(ValueType::LITERAL) && otherOffset.hasType(ValueType::LITERAL))
+		return offset.literal.integer + otherOffset.literal.integer == 32;
+	if(!offset.hasType(ValueType::LOCAL))
+		return false;
+	const Operation* op = dynamic_cast<const Operation*>(offset.local->getSingleWriter());
+	return op != nullptr && op->opCode == "sub" && op->conditional == COND_ALWAYS && op->getFirstArg().hasLiteral(Literal(32L)) && op->getSecondArg() &&
+			op->getSecondArg().get() == otherOffset;
+}
+
+/*
+ * Replaces the rotation idiom "(x << n) | (x >> (32 - n))" (with the parts combined by an or or a xor, in any order) by a single rotation of the ADD ALU,
+ * where the offset is either a constant or the right-shift offset is calculated from the left-shift offset (or vice versa).
+ * Since "ror" rotates to the right, the offset of the right-shift is used.
+ *
+ * Byte swaps built from rotations (e.g. "(rotate(x, 8) & 0x00FF00FF) | (rotate(x, 24) & 0xFF00FF00)") are thus lowered to two rotations and the masks.
+ */
+static InstructionWalker intrinsifyRotation(Method& method, InstructionWalker it)
+{
+	Operation* op = it.get<Operation>();
+	if(op == nullptr || (op->opCode != "or" && op->opCode != "xor") || !op->getSecondArg() || op->hasPackMode() || op->hasUnpackMode() ||
+			op->getFirstArg().type.getScalarBitCount() != 32 || !op->getFirstArg().hasType(ValueType::LOCAL) || !op->getSecondArg().get().hasType(ValueType::LOCAL))
+		return it;
+	const Operation* first = dynamic_cast<const Operation*>(op->getFirstArg().local->getSingleWriter());
+	const Operation* second = dynamic_cast<const Operation*>(op->getSecondArg().get().local->getSingleWriter());
+	if(first == nullptr || second == nullptr || first->opCode != "shl")
+		std::swap(first, second);
+	if(first == nullptr || second == nullptr || first->opCode != "shl" || (second->opCode != "shr" && second->opCode != "lshr"))
+		return it;
+	const Value source = first->getFirstArg();
+	if(first->conditional != COND_ALWAYS || second->conditional != COND_ALWAYS || first->hasPackMode() || first->hasUnpackMode() || second->hasPackMode() ||
+			second->hasUnpackMode() || !first->getSecondArg() || !second->getSecondArg() || second->getFirstArg() != source ||
+			!(isComplementaryShift(first->getSecondArg().get(), second->getSecondArg().get()) || isComplementaryShift(second->getSecondArg().get(), first->getSecondArg().get())))
+		return it;
+
+	//both shifts need to be located before in the same block and read the same value of the source as the rotation
+	bool foundFirst = false;
+	bool foundSecond = false;
+	InstructionWalker checkIt = it.copy();
+	while(!checkIt.isStartOfBlock() && !(foundFirst && foundSecond))
+	{
+		checkIt.previousInBlock();
+		if(!checkIt.has())
+			continue;
+		foundFirst = foundFirst || checkIt.get() == first;
+		foundSecond = foundSecond || checkIt.get() == second;
+		if(source.hasType(ValueType::LOCAL) && checkIt->writesLocal(source.local))
+			return it;
+	}
+	if(!foundFirst || !foundSecond)
+		return it;
+
+	DEBUG_LOG("Intrinsifying rotation idiom with native rotation: " << op->to_string() << logging::endl);
+	op->opCode = "ror";
+	op->setArgument(0, source);
+	op->setArgument(1, second->getSecondArg().get());
+	return it;
+}
+
 static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker it, const MathType& mathType)
 {
     Operation* op = it.get<Operation>();
@@ -459,25 +722,30 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
         //a * 2^n = a << n
         if(arg0.hasType(ValueType::LITERAL) && arg1.hasType(ValueType::LITERAL))
         {
-            logging::debug() << "Calculating result for multiplication with constants" << logging::endl;
+            DEBUG_LOG("Calculating result for multiplication with constants" << logging::endl);
             it.reset(new MoveOperation(Value(op->getOutput().get().local, arg0.type), Value(Literal(arg0.literal.integer * arg1.literal.integer), arg0.type), op->conditional, op->setFlags));
         }
         else if(arg0.hasType(ValueType::LITERAL) && isPowerTwo(arg0.literal.integer))
         {
-            logging::debug() << "Intrinsifying multiplication with left-shift" << logging::endl;
+            DEBUG_LOG("Intrinsifying multiplication with left-shift" << logging::endl);
             op->opCode = "shl";
             op->setArgument(0, arg1);
             op->setArgument(1, Value(Literal(static_cast<long>(std::log2(arg0.literal.integer))), arg0.type));
         }
         else if(arg1.hasType(ValueType::LITERAL) && isPowerTwo(arg1.literal.integer))
         {
-            logging::debug() << "Intrinsifying multiplication with left-shift" << logging::endl;
+            DEBUG_LOG("Intrinsifying multiplication with left-shift" << logging::endl);
             op->opCode = "shl";
             op->setArgument(1, Value(Literal(static_cast<long>(std::log2(arg1.literal.integer))), arg1.type));
         }
         else if(std::max(arg0.type.getScalarBitCount(), arg1.type.getScalarBitCount()) <= 24)
         {
-            logging::debug() << "Intrinsifying multiplication of small integers to mul24" << logging::endl;
+            DEBUG_LOG("Intrinsifying multiplication of small integers to mul24" << logging::endl);
+            op->opCode = "mul24";
+        }
+        else if(method.getAnalyses().getValueRanges().getRange(arg0).fitsIntoBits(24) && method.getAnalyses().getValueRanges().getRange(arg1).fitsIntoBits(24))
+        {
+            DEBUG_LOG("Intrinsifying multiplication of integers with small value ranges to mul24" << logging::endl);
             op->opCode = "mul24";
         }
         else
@@ -490,21 +758,16 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     {
         if(arg0.hasType(ValueType::LITERAL) && arg1.hasType(ValueType::LITERAL))
         {
-            logging::debug() << "Calculating result for division with constants" << logging::endl;
+            DEBUG_LOG("Calculating result for division with constants" << logging::endl);
             it.reset(new MoveOperation(Value(op->getOutput().get().local, arg0.type), Value(Literal((long)(unsigned long)(arg0.literal.integer / arg1.literal.integer)), arg0.type), op->conditional, op->setFlags));
         }
         //a / 2^n = a >> n
         else if(arg1.hasType(ValueType::LITERAL) && isPowerTwo(arg1.literal.integer))
         {
-            logging::debug() << "Intrinsifying division with right-shift" << logging::endl;
+            DEBUG_LOG("Intrinsifying division with right-shift" << logging::endl);
             op->opCode = "shr";
             op->setArgument(1, Value(Literal(static_cast<long>(std::log2(arg1.literal.integer))), arg1.type));
         }
-//        else if(arg1.hasType(ValueType::LITERAL))
-//        {
-//            //TODO replace with multiplication and shift (only if no overflow!)
-//            //http://forums.parallax.com/discussion/114807/fast-faster-fastest-code-integer-division
-//        }
         else
         {
             it = intrinsifyUnsignedIntegerDivision(method, it, *op);
@@ -515,13 +778,13 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     {
         if(arg0.hasType(ValueType::LITERAL) && arg1.hasType(ValueType::LITERAL))
         {
-            logging::debug() << "Calculating result for signed division with constants" << logging::endl;
+            DEBUG_LOG("Calculating result for signed division with constants" << logging::endl);
             it.reset(new MoveOperation(Value(op->getOutput().get().local, arg0.type), Value(Literal(arg0.literal.integer / arg1.literal.integer), arg0.type), op->conditional, op->setFlags));
         }
         //a / 2^n = a >> n
         else if(arg1.hasType(ValueType::LITERAL) && isPowerTwo(arg1.literal.integer))
         {
-            logging::debug() << "Intrinsifying signed division with arithmetic right-shift" << logging::endl;
+            DEBUG_LOG("Intrinsifying signed division with arithmetic right-shift" << logging::endl);
             op->opCode = "asr";
             op->setArgument(1, Value(Literal(static_cast<long>(std::log2(arg1.literal.integer))), arg1.type));
         }
@@ -536,12 +799,12 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     {
         if(arg0.hasType(ValueType::LITERAL) && arg1.hasType(ValueType::LITERAL))
         {
-            logging::debug() << "Calculating result for modulo with constants" << logging::endl;
+            DEBUG_LOG("Calculating result for modulo with constants" << logging::endl);
             it.reset(new MoveOperation(Value(op->getOutput().get().local, arg0.type), Value(Literal((long)(unsigned long)(arg0.literal.integer % arg1.literal.integer)), arg0.type), op->conditional, op->setFlags));
         }
         else if(arg1.hasType(ValueType::LITERAL) && isPowerTwo(arg1.literal.integer))
         {
-            logging::debug() << "Intrinsifying unsigned modulo by power of two" << logging::endl;
+            DEBUG_LOG("Intrinsifying unsigned modulo by power of two" << logging::endl);
             op->opCode = "and";
             op->setArgument(1, Value(Literal(arg1.literal.integer - 1), arg1.type));
         }
@@ -555,7 +818,7 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     {
         if(arg0.hasType(ValueType::LITERAL) && arg1.hasType(ValueType::LITERAL))
         {
-            logging::debug() << "Calculating result for signed modulo with constants" << logging::endl;
+            DEBUG_LOG("Calculating result for signed modulo with constants" << logging::endl);
             it.reset(new MoveOperation(Value(op->getOutput().get().local, arg0.type), Value(Literal(arg0.literal.integer % arg1.literal.integer), arg0.type), op->conditional, op->setFlags));
         }
         else
@@ -568,18 +831,18 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     {
         if(arg0.hasType(ValueType::LITERAL) && arg1.hasType(ValueType::LITERAL))
         {
-            logging::debug() << "Calculating result for signed division with constants" << logging::endl;
+            DEBUG_LOG("Calculating result for signed division with constants" << logging::endl);
             it.reset(new MoveOperation(Value(op->getOutput().get().local, arg0.type), Value(Literal(arg0.literal.real / arg1.literal.real), arg0.type), op->conditional, op->setFlags));
         }
         else if(arg1.hasType(ValueType::LITERAL))
         {
-            logging::debug() << "Intrinsifying floating division with multiplication of constant inverse" << logging::endl;
+            DEBUG_LOG("Intrinsifying floating division with multiplication of constant inverse" << logging::endl);
             op->opCode = "fmul";
             op->setArgument(1, Value(Literal(1.0f / arg1.literal.real), arg1.type));
         }
         else if(has_flag(op->decoration, InstructionDecorations::ALLOW_RECIP) || has_flag(op->decoration, InstructionDecorations::FAST_MATH))
         {
-            logging::debug() << "Intrinsifying floating division with multiplication of reciprocal" << logging::endl;
+            DEBUG_LOG("Intrinsifying floating division with multiplication of reciprocal" << logging::endl);
             it = insertSFUCall(REG_SFU_RECIP, it, arg1, op->conditional);
             it.nextInBlock();
             op->opCode = "fmul";
@@ -587,8 +850,8 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
         }
         else
         {
-            logging::debug() << "Intrinsifying floating division with multiplication of inverse" << logging::endl;
-            it = intrinsifyFloatingDivision(method, it, *op);
+            DEBUG_LOG("Intrinsifying floating division with multiplication of inverse" << logging::endl);
+            it = intrinsifyFloatingDivision(method, it, *op, mathType);
         }
     }
     //truncate bits
@@ -597,7 +860,7 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     	if(saturateResult)
     	{
     		//let pack-mode handle saturation
-    		logging::debug() << "Intrinsifying saturated truncate with move and pack-mode" << logging::endl;
+    		DEBUG_LOG("Intrinsifying saturated truncate with move and pack-mode" << logging::endl);
     		it = insertSaturation(it, method, op->getFirstArg(), op->getOutput(), !has_flag(op->decoration, InstructionDecorations::UNSIGNED_RESULT));
     		it.nextInBlock();
     		it.erase();
@@ -606,13 +869,13 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     	else if(op->getFirstArg().type.getScalarBitCount() > 32 && op->getOutput().get().type.getScalarBitCount() == 32)
         {
             //do nothing, is just a move, since we truncate the 64-bit integers anyway
-            logging::debug() << "Intrinsifying truncate from unsupported type with move" << logging::endl;
+            DEBUG_LOG("Intrinsifying truncate from unsupported type with move" << logging::endl);
             it.reset((new MoveOperation(op->getOutput(), op->getFirstArg(), op->conditional, op->setFlags))->copyExtrasFrom(op));
         }
         //if dest < i32 -> orig & dest-bits or pack-code
         else if(op->getOutput().get().type.getScalarBitCount() < 32)
         {
-            logging::debug() << "Intrinsifying truncate with and" << logging::endl;
+            DEBUG_LOG("Intrinsifying truncate with and" << logging::endl);
             op->opCode = "and";
             op->setArgument(1, Value(Literal(op->getOutput().get().type.getScalarWidthMask()), TYPE_INT32));
         }
@@ -629,14 +892,37 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
         //if orig = i64, dest = i32 -> move
     	else if(op->getFirstArg().type.getScalarBitCount() >= 32 && op->getOutput().get().type.getScalarBitCount() == 32)
         {
-            logging::debug() << "Intrinsifying fptrunc with move" << logging::endl;
+            DEBUG_LOG("Intrinsifying fptrunc with move" << logging::endl);
             it.reset((new MoveOperation(op->getOutput(), op->getFirstArg(), op->conditional, op->setFlags))->copyExtrasFrom(op));
         }
         else if(op->getFirstArg().type.getScalarBitCount() < 32)
             throw CompilationError(CompilationStep::OPTIMIZER, "Unsupported floating-point type", op->getFirstArg().type.to_string());
+        else if(op->getOutput().get().type.getScalarBitCount() == 16)
+        {
+        	//the pack-mode converts the result of a floating-point operation to half-float
+        	DEBUG_LOG("Intrinsifying fptrunc to half-float with pack-mode" << logging::endl);
+        	it.reset((new Operation("fmul", op->getOutput(), op->getFirstArg(), Value(Literal(1.0), TYPE_FLOAT), op->conditional, op->setFlags))->copyExtrasFrom(op)->setPackMode(PACK_FLOAT_TO_HALF_TRUNCATE));
+        }
         else
             throw CompilationError(CompilationStep::OPTIMIZER, "Unsupported floating-point type", op->getOutput().get().type.to_string());
     }
+    else if(op->opCode.compare("fpext") == 0)
+    {
+    	if(op->getFirstArg().type.getScalarBitCount() == 16 && op->getOutput().get().type.getScalarBitCount() == 32)
+    	{
+    		//the unpack-mode converts half-floats to floats, if the consuming operation is a floating-point operation
+    		DEBUG_LOG("Intrinsifying fpext from half-float with unpack-mode" << logging::endl);
+    		it.reset((new Operation("fmul", op->getOutput(), op->getFirstArg(), Value(Literal(1.0), TYPE_FLOAT), op->conditional, op->setFlags))->copyExtrasFrom(op)->setUnpackMode(UNPACK_HALF_TO_FLOAT));
+    	}
+    	else if(op->getFirstArg().type.getScalarBitCount() >= 32)
+    	{
+    		//do nothing, is just a move, since we truncate the 64-bit floating-point values anyway
+    		DEBUG_LOG("Intrinsifying fpext with move" << logging::endl);
+    		it.reset((new MoveOperation(op->getOutput(), op->getFirstArg(), op->conditional, op->setFlags))->copyExtrasFrom(op));
+    	}
+    	else
+    		throw CompilationError(CompilationStep::OPTIMIZER, "Unsupported floating-point type", op->getFirstArg().type.to_string());
+    }
     //arithmetic shift right
     else if(op->opCode.compare("ashr") == 0)
     {
@@ -709,9 +995,14 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
         op->decoration = add_flag(op->decoration, InstructionDecorations::UNSIGNED_RESULT);
     }
     //sign extension
+    else if(op->opCode.compare("sext") == 0 && op->getFirstArg().type.getScalarBitCount() < 32 && method.getAnalyses().getValueRanges().getRange(op->getFirstArg()).fitsIntoBits(op->getFirstArg().type.getScalarBitCount() - 1))
+    {
+        DEBUG_LOG("Intrinsifying sign extension of positive value with move" << logging::endl);
+        it.reset((new MoveOperation(op->getOutput(), op->getFirstArg(), op->conditional, op->setFlags))->copyExtrasFrom(op));
+    }
     else if(op->opCode.compare("sext") == 0)
     {
-        logging::debug() << "Intrinsifying sign extension with shifting" << logging::endl;
+        DEBUG_LOG("Intrinsifying sign extension with shifting" << logging::endl);
         it = insertSignExtension(it, method, op->getFirstArg(), op->getOutput(), op->conditional, op->setFlags);
         //remove 'sext'
         it.erase();
@@ -719,9 +1010,14 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
         it.previousInBlock();
     }
     //zero extension
+    else if(op->opCode.compare("zext") == 0 && method.getAnalyses().getValueRanges().getRange(op->getFirstArg()).fitsIntoBits(std::min(op->getFirstArg().type.getScalarBitCount(), op->getOutput().get().type.getScalarBitCount())))
+    {
+        DEBUG_LOG("Intrinsifying zero extension of value without leading bits with move" << logging::endl);
+        it.reset((new MoveOperation(op->getOutput(), op->getFirstArg(), op->conditional, op->setFlags))->copyExtrasFrom(op));
+    }
     else if(op->opCode.compare("zext") == 0)
     {
-        logging::debug() << "Intrinsifying zero extension with and" << logging::endl;
+        DEBUG_LOG("Intrinsifying zero extension with and" << logging::endl);
         it = insertZeroExtension(it, method, op->getFirstArg(), op->getOutput(), op->conditional, op->setFlags);
         //remove 'zext'
         it.erase();
@@ -731,8 +1027,40 @@ static InstructionWalker intrinsifyArithmetic(Method& method, InstructionWalker
     return it;
 }
 
-static InstructionWalker intrinsifyReadWorkGroupInfo(Method& method, InstructionWalker it, const Value& arg, const std::vector<std::string>& locals, const Value& defaultValue, const InstructionDecorations decoration)
+/*
+ * The local size of the dimension, if it is fixed by the required work-group size of the kernel (or the work-group size the code is specialized for)
+ */
+static Optional<uint32_t> getKnownLocalSize(const Method& method, const Value& dimension)
+{
+	if(!dimension.hasType(ValueType::LITERAL) || dimension.literal.integer < 0 || dimension.literal.integer > 2)
+		return {};
+	auto it = method.metaData.find(MetaDataType::WORK_GROUP_SIZES);
+	if(it == method.metaData.end() || it->second.size() <= static_cast<std::size_t>(dimension.literal.integer))
+		return {};
+	const int size = std::atoi(it->second.at(static_cast<std::size_t>(dimension.literal.integer)).data());
+	if(size <= 0)
+		return {};
+	return static_cast<uint32_t>(size);
+}
+
+/*
+ * The number of work-groups of the dimension, if the code is specialized for a global work size
+ */
+static Optional<uint32_t> getKnownNumGroups(const Method& method, const Configuration& config, const Value& dimension)
+{
+	const Optional<uint32_t> localSize = getKnownLocalSize(method, dimension);
+	if(!localSize || config.specializedGlobalSizes.size() <= static_cast<std::size_t>(dimension.literal.integer))
+		return {};
+	return config.specializedGlobalSizes.at(static_cast<std::size_t>(dimension.literal.integer)) / localSize.get();
+}
+
+static InstructionWalker intrinsifyReadWorkGroupInfo(Method& method, InstructionWalker it, const Value& arg, const std::vector<std::string>& locals, const Value& defaultValue, const InstructionDecorations decoration, const Optional<uint32_t>& knownValue = {})
 {
+	if(knownValue)
+	{
+		DEBUG_LOG("Replacing work-group info with the specialized value " << knownValue.get() << logging::endl);
+		return it.reset((new MoveOperation(it->getOutput(), Value(Literal(static_cast<long>(knownValue.get())), TYPE_INT32)))->copyExtrasFrom(it.get())->setDecorations(add_flag(it->decoration, decoration)));
+	}
 	if(arg.hasType(ValueType::LITERAL))
 	{
 		Value src = UNDEFINED_VALUE;
@@ -773,8 +1101,13 @@ static InstructionWalker intrinsifyReadWorkGroupInfo(Method& method, Instruction
 	return it.reset(new MoveOperation(it->getOutput(), defaultValue, COND_NEGATIVE_SET));
 }
 
-static InstructionWalker intrinsifyReadWorkItemInfo(Method& method, InstructionWalker it, const Value& arg, const std::string& local, const InstructionDecorations decoration)
+static InstructionWalker intrinsifyReadWorkItemInfo(Method& method, InstructionWalker it, const Value& arg, const std::string& local, const InstructionDecorations decoration, const Optional<uint32_t>& knownValue = {})
 {
+	if(knownValue)
+	{
+		DEBUG_LOG("Replacing work-item info with the specialized value " << knownValue.get() << logging::endl);
+		return it.reset((new MoveOperation(it->getOutput(), Value(Literal(static_cast<long>(knownValue.get())), TYPE_INT8)))->copyExtrasFrom(it.get())->setDecorations(add_flag(it->decoration, decoration)));
+	}
 	/*
 	 * work-item infos (id, size) are stored within a single UNIFORM:
 	 * high <-> low byte
@@ -797,20 +1130,25 @@ static InstructionWalker intrinsifyReadWorkItemInfo(Method& method, InstructionW
 	const Value tmp1 = method.addNewLocal(TYPE_INT32, "%local_info");
 	it.emplace(new Operation("shr", tmp1, itemInfo->createReference(), tmp0));
 	it.nextInBlock();
-	return it.reset((new Operation("and", it->getOutput(), tmp1, Value(Literal(0xFFL), TYPE_INT8)))->copyExtrasFrom(it.get()));
+	return it.reset((new Operation("and", it->getOutput(), tmp1, Value(Literal(0xFFL), TYPE_INT8)))->copyExtrasFrom(it.get())->setDecorations(add_flag(it->decoration, decoration)));
 }
 
-static InstructionWalker intrinsifyWorkItemFunctions(Method& method, InstructionWalker it)
+static InstructionWalker expandWorkItemFunction(Method& method, InstructionWalker it, const Configuration& config)
 {
 	MethodCall* callSite = it.get<MethodCall>();
 	if(callSite == nullptr)
 		return it;
 	if(callSite->getArguments().size() > 1)
 		return it;
+	const Value dimension = callSite->getArguments().empty() ? UNDEFINED_VALUE : callSite->getArgument(0).get();
+	const Optional<uint32_t> localSize = getKnownLocalSize(method, dimension);
+	const Optional<uint32_t> numGroups = getKnownNumGroups(method, config, dimension);
+	//in a dimension with a single work-item, the local id is always zero
+	const Optional<uint32_t> localId = localSize && localSize.get() == 1 ? Optional<uint32_t>(0u) : Optional<uint32_t>();
 
 	if(callSite->methodName.compare("vc4cl_work_dimensions") == 0 && callSite->getArguments().size() == 0)
 	{
-		logging::debug() << "Intrinsifying reading of work-item dimensions" << logging::endl;
+		DEBUG_LOG("Intrinsifying reading of work-item dimensions" << logging::endl);
 		//setting the type to int8 allows us to optimize e.g. multiplications with work-item values
 		Value out = callSite->getOutput();
 		out.type = TYPE_INT8;
@@ -818,50 +1156,50 @@ static InstructionWalker intrinsifyWorkItemFunctions(Method& method, Instruction
 	}
 	if(callSite->methodName.compare("vc4cl_num_groups") == 0 && callSite->getArguments().size() == 1)
 	{
-		logging::debug() << "Intrinsifying reading of the number of work-groups" << logging::endl;
-		return intrinsifyReadWorkGroupInfo(method, it, callSite->getArgument(0), {Method::NUM_GROUPS_X, Method::NUM_GROUPS_Y, Method::NUM_GROUPS_Z}, INT_ONE, InstructionDecorations::BUILTIN_NUM_GROUPS);
+		DEBUG_LOG("Intrinsifying reading of the number of work-groups" << logging::endl);
+		return intrinsifyReadWorkGroupInfo(method, it, callSite->getArgument(0), {Method::NUM_GROUPS_X, Method::NUM_GROUPS_Y, Method::NUM_GROUPS_Z}, INT_ONE, InstructionDecorations::BUILTIN_NUM_GROUPS, numGroups);
 	}
 	if(callSite->methodName.compare("vc4cl_group_id") == 0 && callSite->getArguments().size() == 1)
 	{
-		logging::debug() << "Intrinsifying reading of the work-group ids" << logging::endl;
+		DEBUG_LOG("Intrinsifying reading of the work-group ids" << logging::endl);
 		return intrinsifyReadWorkGroupInfo(method, it, callSite->getArgument(0), {Method::GROUP_ID_X, Method::GROUP_ID_Y, Method::GROUP_ID_Z}, INT_ZERO, InstructionDecorations::BUILTIN_GROUP_ID);
 	}
 	if(callSite->methodName.compare("vc4cl_global_offset") == 0 && callSite->getArguments().size() == 1)
 	{
-		logging::debug() << "Intrinsifying reading of the global offsets" << logging::endl;
+		DEBUG_LOG("Intrinsifying reading of the global offsets" << logging::endl);
 		return intrinsifyReadWorkGroupInfo(method, it, callSite->getArgument(0), {Method::GLOBAL_OFFSET_X, Method::GLOBAL_OFFSET_Y, Method::GLOBAL_OFFSET_Z}, INT_ZERO, InstructionDecorations::BUILTIN_GLOBAL_OFFSET);
 	}
 	if(callSite->methodName.compare("vc4cl_local_size") == 0 && callSite->getArguments().size() == 1)
 	{
-		logging::debug() << "Intrinsifying reading of local work-item sizes" << logging::endl;
+		DEBUG_LOG("Intrinsifying reading of local work-item sizes" << logging::endl);
 		//TODO needs to have a size of 1 for all higher dimensions (instead of currently implicit 0)
-		return intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_SIZES, InstructionDecorations::BUILTIN_LOCAL_SIZE);
+		return intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_SIZES, InstructionDecorations::BUILTIN_LOCAL_SIZE, localSize);
 	}
 	if(callSite->methodName.compare("vc4cl_local_id") == 0 && callSite->getArguments().size() == 1)
 	{
-		logging::debug() << "Intrinsifying reading of local work-item ids" << logging::endl;
-		return intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_IDS, InstructionDecorations::BUILTIN_LOCAL_ID);
+		DEBUG_LOG("Intrinsifying reading of local work-item ids" << logging::endl);
+		return intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_IDS, InstructionDecorations::BUILTIN_LOCAL_ID, localId);
 	}
 	if(callSite->methodName.compare("vc4cl_global_size") == 0 && callSite->getArguments().size() == 1)
 	{
 		//global_size(dim) = local_size(dim) * num_groups(dim)
-		logging::debug() << "Intrinsifying reading of global work-item sizes" << logging::endl;
+		DEBUG_LOG("Intrinsifying reading of global work-item sizes" << logging::endl);
 
 		const Value tmpLocalSize = method.addNewLocal(TYPE_INT8, "%local_size");
 		const Value tmpNumGroups = method.addNewLocal(TYPE_INT32, "%num_groups");
 		//emplace dummy instructions to be replaced
 		it.emplace(new MoveOperation(tmpLocalSize, NOP_REGISTER));
-		it = intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_SIZES, InstructionDecorations::BUILTIN_LOCAL_SIZE);
+		it = intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_SIZES, InstructionDecorations::BUILTIN_LOCAL_SIZE, localSize);
 		it.nextInBlock();
 		it.emplace(new MoveOperation(tmpNumGroups, NOP_REGISTER));
-		it = intrinsifyReadWorkGroupInfo(method, it, callSite->getArgument(0), {Method::NUM_GROUPS_X, Method::NUM_GROUPS_Y, Method::NUM_GROUPS_Z}, INT_ONE, InstructionDecorations::BUILTIN_NUM_GROUPS);
+		it = intrinsifyReadWorkGroupInfo(method, it, callSite->getArgument(0), {Method::NUM_GROUPS_X, Method::NUM_GROUPS_Y, Method::NUM_GROUPS_Z}, INT_ONE, InstructionDecorations::BUILTIN_NUM_GROUPS, numGroups);
 		it.nextInBlock();
 		return it.reset((new Operation("mul24", callSite->getOutput(), tmpLocalSize, tmpNumGroups))->copyExtrasFrom(callSite)->setDecorations(add_flag(callSite->decoration, InstructionDecorations::BUILTIN_GLOBAL_SIZE)));
 	}
 	if(callSite->methodName.compare("vc4cl_global_id") == 0 && callSite->getArguments().size() == 1)
 	{
 		//global_id(dim) = global_offset(dim) + (group_id(dim) * local_size(dim) + local_id(dim)
-		logging::debug() << "Intrinsifying reading of global work-item ids" << logging::endl;
+		DEBUG_LOG("Intrinsifying reading of global work-item ids" << logging::endl);
 
 		const Value tmpGroupID = method.addNewLocal(TYPE_INT32, "%group_id");
 		const Value tmpLocalSize = method.addNewLocal(TYPE_INT8, "%local_size");
@@ -874,13 +1212,13 @@ static InstructionWalker intrinsifyWorkItemFunctions(Method& method, Instruction
 		it = intrinsifyReadWorkGroupInfo(method, it, callSite->getArgument(0), {Method::GROUP_ID_X, Method::GROUP_ID_Y, Method::GROUP_ID_Z}, INT_ZERO, InstructionDecorations::BUILTIN_GROUP_ID);
 		it.nextInBlock();
 		it.emplace(new MoveOperation(tmpLocalSize, NOP_REGISTER));
-		it = intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_SIZES, InstructionDecorations::BUILTIN_LOCAL_SIZE);
+		it = intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_SIZES, InstructionDecorations::BUILTIN_LOCAL_SIZE, localSize);
 		it.nextInBlock();
 		it.emplace(new MoveOperation(tmpGlobalOffset, NOP_REGISTER));
 		it = intrinsifyReadWorkGroupInfo(method, it, callSite->getArgument(0), {Method::GLOBAL_OFFSET_X, Method::GLOBAL_OFFSET_Y, Method::GLOBAL_OFFSET_Z}, INT_ZERO, InstructionDecorations::BUILTIN_GLOBAL_OFFSET);
 		it.nextInBlock();
 		it.emplace(new MoveOperation(tmpLocalID, NOP_REGISTER));
-		it = intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_IDS, InstructionDecorations::BUILTIN_LOCAL_ID);
+		it = intrinsifyReadWorkItemInfo(method, it, callSite->getArgument(0), Method::LOCAL_IDS, InstructionDecorations::BUILTIN_LOCAL_ID, localId);
 		it.nextInBlock();
 		it.emplace(new Operation("mul24", tmpRes0, tmpGroupID, tmpLocalSize));
 		it.nextInBlock();
@@ -891,6 +1229,546 @@ static InstructionWalker intrinsifyWorkItemFunctions(Method& method, Instruction
 	return it;
 }
 
+static const char* const WORK_ITEM_FUNCTIONS[] = {
+	"vc4cl_work_dimensions", "vc4cl_num_groups", "vc4cl_group_id", "vc4cl_global_offset", "vc4cl_local_size", "vc4cl_local_id", "vc4cl_global_size", "vc4cl_global_id"
+};
+
+/*
+ * The work-item functions of a constant dimension are calculated once at the start of the method and all calls read the calculated value.
+ * Thus, e.g. get_global_id(0) called in several inlined functions is only calculated once and calculations whose value is never used are removed as dead code.
+ *
+ * NOTE: The work-item loops and work-group loops (see optimizations#loopWorkItems and optimizations#unrollWorkGroups) are inserted around the whole kernel code,
+ * so the values are still re-calculated for every work-item and work-group
+ */
+static InstructionWalker intrinsifyWorkItemFunctions(Method& method, InstructionWalker it, const Configuration& config)
+{
+	MethodCall* callSite = it.get<MethodCall>();
+	if(callSite == nullptr || callSite->getArguments().size() > 1 || !callSite->getOutput())
+		return it;
+	if(std::none_of(std::begin(WORK_ITEM_FUNCTIONS), std::end(WORK_ITEM_FUNCTIONS), [callSite](const char* name) -> bool { return callSite->methodName.compare(name) == 0;}))
+		return it;
+	if(!callSite->getArguments().empty() && !callSite->getArgument(0).get().hasType(ValueType::LITERAL))
+		//the dimension is only known at run-time
+		return expandWorkItemFunction(method, it, config);
+	const std::string cachedName = "%" + callSite->methodName.substr(std::string("vc4cl_").size()) +
+			(callSite->getArguments().empty() ? std::string() : "_" + std::to_string(callSite->getArgument(0).get().literal.integer));
+	const Local* cached = method.findLocal(cachedName);
+	InstructionDecorations builtinDecorations = InstructionDecorations::NONE;
+	if(cached == nullptr)
+	{
+		cached = method.findOrCreateLocal(callSite->getOutput().get().type, cachedName);
+		auto start = method.walkAllInstructions().nextInBlock();
+		start.emplace(new MethodCall(cached->createReference(), callSite->methodName, callSite->getArguments()));
+		start = expandWorkItemFunction(method, start, config);
+		builtinDecorations = start->decoration;
+		DEBUG_LOG("Calculating " << callSite->methodName << " once at the start of the method into: " << cached->to_string() << logging::endl);
+	}
+	else
+	{
+		const LocalUser* writer = cached->getSingleWriter();
+		if(writer != nullptr && dynamic_cast<const IntermediateInstruction*>(writer) != nullptr)
+			builtinDecorations = dynamic_cast<const IntermediateInstruction*>(writer)->decoration;
+	}
+	//the decorations of the built-in (e.g. the known value ranges of the local ids) are kept for the reading instruction
+	return it.reset((new MoveOperation(callSite->getOutput(), cached->createReference()))->copyExtrasFrom(callSite)->setDecorations(add_flag(callSite->decoration, builtinDecorations)));
+}
+
+/*
+ * The hardware semaphores used to implement the work-group barrier.
+ *
+ * The semaphores 12 to 15 are not used by the generated code otherwise.
+ * The work-items increment the arrival semaphore and wait on the release semaphore, which the first work-item increments
+ * once it counted all arrivals. Consecutive barriers alternate between two release semaphores, so a fast work-item cannot
+ * consume the release of the previous barrier still reserved for a slower work-item.
+ */
+static constexpr Semaphore BARRIER_ARRIVAL = Semaphore::BARRIER_SFU_SLICE_0;
+static constexpr Semaphore BARRIER_RELEASE_EVEN = Semaphore::BARRIER_SFU_SLICE_1;
+static constexpr Semaphore BARRIER_RELEASE_ODD = Semaphore::BARRIER_SFU_SLICE_2;
+
+//the per-QPU index of the next barrier (modulo 2), selecting the release semaphore
+static const std::string BARRIER_PARITY("%barrier_parity");
+
+static bool isBarrierCall(const IntermediateInstruction* instr)
+{
+	const MethodCall* call = instr->as<MethodCall>();
+	return call != nullptr && call->methodName.compare("vc4cl_barrier") == 0;
+}
+
+static bool isMemoryRegister(const Value& val)
+{
+	if(!val.hasType(ValueType::REGISTER))
+		return false;
+	//the TMU registers are REG_TMU_ADDRESS to REG_TMU1_COORD_B_LOD_BIAS (56 to 63)
+	return val.reg.isVertexPipelineMemory() || val.reg == REG_TMU_OUT || (val.reg.num >= REG_TMU_ADDRESS.num && val.reg.num <= REG_TMU1_ADDRESS.num + 3);
+}
+
+/*
+ * Whether the instruction can access the __local or __global memory, i.e. needs to be ordered by the memory fence of a barrier.
+ * Not yet intrinsified calls are assumed to access memory
+ */
+static bool accessesMemory(const IntermediateInstruction* instr)
+{
+	if(instr->is<MethodCall>())
+		return true;
+	if(instr->signal == Signaling::LOAD_TMU0 || instr->signal == Signaling::LOAD_TMU1)
+		return true;
+	if(instr->getOutput() && isMemoryRegister(instr->getOutput().get()))
+		return true;
+	for(const Value& arg : instr->getArguments())
+	{
+		if(isMemoryRegister(arg))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Checks for memory accesses between the previous and the next barrier (or the start/end of the kernel) in the order of the code.
+ *
+ * Since the basic blocks of loops are consecutive, a memory access reachable via a back-edge lies either before or after the barrier too.
+ */
+static bool hasMemoryAccessAround(InstructionWalker it)
+{
+	auto isBarrier = [](const IntermediateInstruction* instr) -> bool
+	{
+		return instr->is<SemaphoreAdjustment>() || instr->is<MemoryBarrier>() || isBarrierCall(instr);
+	};
+	InstructionWalker prev = it.copy().previousInMethod();
+	while(!prev.isStartOfMethod())
+	{
+		if(prev.get() != nullptr)
+		{
+			if(isBarrier(prev.get()))
+				break;
+			if(accessesMemory(prev.get()))
+				return true;
+		}
+		prev.previousInMethod();
+	}
+	InstructionWalker next = it.copy().nextInMethod();
+	while(!next.isEndOfMethod())
+	{
+		if(next.get() != nullptr)
+		{
+			if(isBarrier(next.get()))
+				break;
+			if(accessesMemory(next.get()))
+				return true;
+		}
+		next.nextInMethod();
+	}
+	return false;
+}
+
+/*
+ * Repeats the semaphore adjustment the given number of times, either unrolled for a known count or as loop
+ */
+static InstructionWalker insertSemaphoreAdjustments(Method& method, InstructionWalker it, const Semaphore semaphore, const bool increase, const Optional<uint32_t>& knownCount, const Value& count)
+{
+	if(knownCount)
+	{
+		for(uint32_t i = 0; i < knownCount.get(); ++i)
+		{
+			it.emplace(new SemaphoreAdjustment(semaphore, increase));
+			it.nextInBlock();
+		}
+		return it;
+	}
+	//the count is at least one, see intrinsifyBarrier
+	const Value counter = method.addNewLocal(TYPE_INT32, "%barrier_counter");
+	const Value loopLabel = method.addNewLocal(TYPE_LABEL, "%barrier_loop");
+	it.emplace(new MoveOperation(counter, count));
+	it.nextInBlock();
+	it = method.emplaceLabel(it, new BranchLabel(*loopLabel.local));
+	it.nextInBlock();
+	it.emplace(new SemaphoreAdjustment(semaphore, increase));
+	it.nextInBlock();
+	it.emplace(new Operation("sub", counter, counter, INT_ONE));
+	it.nextInBlock();
+	it.emplace(new Branch(loopLabel.local, COND_ZERO_CLEAR, counter));
+	it.nextInBlock();
+	return it;
+}
+
+/*
+ * Appends a barrier to the end of the kernel, which is only executed after an odd number of barriers.
+ *
+ * This resets the parity to zero (which all work-items of the group agree on, since all of them pass the same barriers),
+ * so the initialization of the parity at the start of the kernel is correct when the kernel is re-run for the next work-group (see optimizations#unrollWorkGroups)
+ */
+static void appendBarrierParityReset(Method& method, const Value& parity)
+{
+	//the returns are replaced with branches to the end-label (see optimizations#eliminateReturn), so they need to execute the reset too
+	if(method.findLocal(BasicBlock::LAST_BLOCK) == nullptr)
+		method.appendToEnd(new BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, BasicBlock::LAST_BLOCK)));
+	const Value skipLabel = method.addNewLocal(TYPE_LABEL, "%barrier_parity_reset");
+	method.appendToEnd(new Branch(skipLabel.local, COND_ZERO_SET, parity));
+	//is intrinsified like any other barrier, when it is reached
+	method.appendToEnd(new MethodCall("vc4cl_barrier", {INT_ZERO}));
+	method.appendToEnd(new BranchLabel(*skipLabel.local));
+}
+
+static InstructionWalker intrinsifyBarrier(Method& method, InstructionWalker it)
+{
+	MethodCall* callSite = it.get<MethodCall>();
+	if(callSite == nullptr || !isBarrierCall(callSite) || callSite->getArguments().size() != 1)
+		return it;
+	//void vc4cl_barrier(cl_mem_fence_flags flags)
+	const Value flags = callSite->getArgument(0).get();
+
+	Optional<uint32_t> knownSize(1u);
+	for(long dim = 0; dim < 3; ++dim)
+	{
+		const Optional<uint32_t> size = getKnownLocalSize(method, Value(Literal(dim), TYPE_INT8));
+		knownSize = knownSize && size ? Optional<uint32_t>(knownSize.get() * size.get()) : Optional<uint32_t>();
+	}
+	if(knownSize && knownSize.get() == 1)
+	{
+		//a single work-item does not need to synchronize with anyone and its own memory accesses are in order
+		DEBUG_LOG("Removing barrier for work-group with a single work-item" << logging::endl);
+		it.erase();
+		//so next instruction is not skipped
+		it.previousInBlock();
+		return it;
+	}
+	DEBUG_LOG("Intrinsifying barrier for " << (knownSize ? std::to_string(knownSize.get()) : std::string("unknown number of")) << " work-items" << logging::endl);
+
+	//CLK_LOCAL_MEM_FENCE = 1, CLK_GLOBAL_MEM_FENCE = 2
+	const bool needsFence = (!flags.hasType(ValueType::LITERAL) || flags.literal.integer != 0) && hasMemoryAccessAround(it);
+	if(needsFence)
+	{
+		const unsigned semantics = static_cast<unsigned>(MemorySemantics::ACQUIRE_RELEASE) | static_cast<unsigned>(MemorySemantics::WORK_GROUP_MEMORY) | static_cast<unsigned>(MemorySemantics::CROSS_WORK_GROUP_MEMORY);
+		it.emplace(new MemoryBarrier(MemoryScope::WORK_GROUP, static_cast<MemorySemantics>(semantics)));
+		it.nextInBlock();
+	}
+
+	const Local* parityLocal = method.findLocal(BARRIER_PARITY);
+	if(parityLocal == nullptr)
+	{
+		parityLocal = method.findOrCreateLocal(TYPE_INT8, BARRIER_PARITY);
+		InstructionWalker startIt = method.walkAllInstructions();
+		startIt.nextInBlock();
+		startIt.emplace(new MoveOperation(parityLocal->createReference(), INT_ZERO));
+		appendBarrierParityReset(method, parityLocal->createReference());
+	}
+	const Value parity = parityLocal->createReference();
+
+	//the number of work-items to wait for, i.e. the size of the work-group minus the first work-item
+	const Optional<uint32_t> knownCount = knownSize ? Optional<uint32_t>(knownSize.get() - 1) : Optional<uint32_t>();
+	Value count = UNDEFINED_VALUE;
+	const Value masterLabel = method.addNewLocal(TYPE_LABEL, "%barrier_master");
+	const Value workerEvenLabel = method.addNewLocal(TYPE_LABEL, "%barrier_worker_even");
+	const Value masterEvenLabel = method.addNewLocal(TYPE_LABEL, "%barrier_master_even");
+	const Value afterLabel = method.addNewLocal(TYPE_LABEL, "%barrier_after");
+
+	//the first work-item (with all local ids zero) counts the arrivals and releases the other work-items
+	it.emplace(new Branch(masterLabel.local, COND_ZERO_SET, method.findOrCreateLocal(TYPE_INT32, Method::LOCAL_IDS)->createReference()));
+	it.nextInBlock();
+	it.emplace(new SemaphoreAdjustment(BARRIER_ARRIVAL, true));
+	it.nextInBlock();
+	it.emplace(new Branch(workerEvenLabel.local, COND_ZERO_SET, parity));
+	it.nextInBlock();
+	it.emplace(new SemaphoreAdjustment(BARRIER_RELEASE_ODD, false));
+	it.nextInBlock();
+	it.emplace(new Branch(afterLabel.local, COND_ALWAYS, BOOL_TRUE));
+	it.nextInBlock();
+	it = method.emplaceLabel(it, new BranchLabel(*workerEvenLabel.local));
+	it.nextInBlock();
+	it.emplace(new SemaphoreAdjustment(BARRIER_RELEASE_EVEN, false));
+	it.nextInBlock();
+	it.emplace(new Branch(afterLabel.local, COND_ALWAYS, BOOL_TRUE));
+	it.nextInBlock();
+
+	it = method.emplaceLabel(it, new BranchLabel(*masterLabel.local));
+	it.nextInBlock();
+	if(!knownCount)
+	{
+		/*
+		 * The local sizes are stored within a single UNIFORM (see intrinsifyReadWorkItemInfo),
+		 * unused dimensions may have a size of zero and are counted as one
+		 */
+		const Value localSizes = method.findOrCreateLocal(TYPE_INT32, Method::LOCAL_SIZES)->createReference();
+		Value product = UNDEFINED_VALUE;
+		for(long dim = 0; dim < 3; ++dim)
+		{
+			Value size = localSizes;
+			if(dim > 0)
+			{
+				size = method.addNewLocal(TYPE_INT32, "%barrier_size");
+				it.emplace(new Operation("shr", size, localSizes, Value(Literal(dim * 8), TYPE_INT8)));
+				it.nextInBlock();
+			}
+			const Value maskedSize = method.addNewLocal(TYPE_INT32, "%barrier_size");
+			it.emplace(new Operation("and", maskedSize, size, Value(Literal(0xFFL), TYPE_INT8)));
+			it.nextInBlock();
+			const Value clampedSize = method.addNewLocal(TYPE_INT32, "%barrier_size");
+			it.emplace(new Operation("max", clampedSize, maskedSize, INT_ONE));
+			it.nextInBlock();
+			if(dim == 0)
+				product = clampedSize;
+			else
+			{
+				const Value tmp = method.addNewLocal(TYPE_INT32, "%barrier_size");
+				it.emplace(new Operation("mul24", tmp, product, clampedSize));
+				it.nextInBlock();
+				product = tmp;
+			}
+		}
+		count = method.addNewLocal(TYPE_INT32, "%barrier_count");
+		it.emplace(new Operation("sub", count, product, INT_ONE));
+		it.nextInBlock();
+		//a work-group of a single work-item has nothing to wait for
+		it.emplace(new Branch(afterLabel.local, COND_ZERO_SET, count));
+		it.nextInBlock();
+	}
+	it = insertSemaphoreAdjustments(method, it, BARRIER_ARRIVAL, false, knownCount, count);
+	it.emplace(new Branch(masterEvenLabel.local, COND_ZERO_SET, parity));
+	it.nextInBlock();
+	it = insertSemaphoreAdjustments(method, it, BARRIER_RELEASE_ODD, true, knownCount, count);
+	it.emplace(new Branch(afterLabel.local, COND_ALWAYS, BOOL_TRUE));
+	it.nextInBlock();
+	it = method.emplaceLabel(it, new BranchLabel(*masterEvenLabel.local));
+	it.nextInBlock();
+	it = insertSemaphoreAdjustments(method, it, BARRIER_RELEASE_EVEN, true, knownCount, count);
+
+	it = method.emplaceLabel(it, new BranchLabel(*afterLabel.local));
+	it.nextInBlock();
+	//the next barrier uses the other release semaphore
+	return it.reset(new Operation("xor", parity, parity, INT_ONE));
+}
+
+/*
+ * The header of the printf buffer (see Method#PRINTF_BUFFER): the number of bytes reserved so far and the capacity for the records in bytes
+ */
+static constexpr long PRINTF_BUFFER_HEADER = 2 * sizeof(uint32_t);
+//the record starts with the address of the format string and the number of argument words
+static constexpr std::size_t PRINTF_RECORD_HEADER_WORDS = 2;
+static constexpr long PRINTF_ROW_SIZE = NATIVE_VECTOR_SIZE * sizeof(uint32_t);
+
+/*
+ * Writes the (scalar or vector) value into the words [firstWord, firstWord + vector-width) of the record rows.
+ *
+ * Since the value is rotated once by the position of its first word modulo 16, the elements of a value split over two rows are
+ * already at the correct positions in both rows.
+ */
+static InstructionWalker insertPrintfWords(Method& method, InstructionWalker it, const std::vector<Value>& rows, const std::size_t firstWord, const Value& value)
+{
+	const std::size_t numWords = value.type.getVectorWidth();
+	const DataType wordType = TYPE_INT32.toVectorType(static_cast<unsigned char>(numWords));
+	Value words = value;
+	if(!value.isLiteralValue())
+	{
+		//pointers and floating-point values are stored as their bit-pattern
+		words = method.addNewLocal(wordType, "%printf_arg");
+		it.emplace(new MoveOperation(words, value));
+		it.nextInBlock();
+	}
+	const Value rotated = method.addNewLocal(TYPE_INT32.toVectorType(NATIVE_VECTOR_SIZE), "%printf_words");
+	it = insertVectorRotation(it, words, Value(Literal(static_cast<long>(firstWord % NATIVE_VECTOR_SIZE)), TYPE_INT8), rotated, Direction::UP);
+	for(std::size_t i = 0; i < numWords; ++i)
+	{
+		const std::size_t word = firstWord + i;
+		it.emplace(new Operation("xor", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, Value(Literal(static_cast<long>(word % NATIVE_VECTOR_SIZE)), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+		it.nextInBlock();
+		it.emplace((new MoveOperation(rows.at(word / NATIVE_VECTOR_SIZE), rotated, COND_ZERO_SET))->setDecorations(InstructionDecorations::ELEMENT_INSERTION));
+		it.nextInBlock();
+	}
+	return it;
+}
+
+/*
+ * Lowers a call to printf into a single record in the printf buffer passed by the run-time (see Method#PRINTF_BUFFER), which is formatted by the host.
+ *
+ * All arguments of the call are packed into the 16 elements of one row (or several consecutive rows, if they do not fit), which is built in registers.
+ * Under the hardware mutex, only the space for the record is reserved by incrementing the number of bytes used, each row is then written with a single DMA access.
+ * The record consists of the address of the format string, the number of argument words and one word per (vector) element of the arguments.
+ * String arguments are given by their address, so the host needs to resolve the format string and %s arguments from the global data segment.
+ * If the buffer is full, the record is dropped (but still reserved, so the host can detect the overflow) and printf returns -1.
+ */
+static InstructionWalker intrinsifyPrintf(Method& method, InstructionWalker it)
+{
+	MethodCall* callSite = it.get<MethodCall>();
+	if(callSite == nullptr || callSite->methodName.compare("printf") != 0 || callSite->getArguments().empty())
+		return it;
+	DEBUG_LOG("Intrinsifying printf call into buffer record: " << callSite->to_string() << logging::endl);
+
+	std::size_t numWords = PRINTF_RECORD_HEADER_WORDS;
+	for(std::size_t i = 1; i < callSite->getArguments().size(); ++i)
+	{
+		const DataType& type = callSite->getArgument(i).get().type;
+		if(!type.isPointerType() && type.getScalarBitCount() > 32)
+			throw CompilationError(CompilationStep::OPTIMIZER, "Printf arguments of 64-bit types are not supported", callSite->to_string());
+		numWords += type.isPointerType() ? 1 : type.getVectorWidth();
+	}
+	const std::size_t numRows = (numWords + NATIVE_VECTOR_SIZE - 1) / NATIVE_VECTOR_SIZE;
+	const long recordSize = static_cast<long>(numRows) * PRINTF_ROW_SIZE;
+
+	//1. build the record in registers, the unused words are zeroed
+	const DataType rowType = TYPE_INT32.toVectorType(NATIVE_VECTOR_SIZE);
+	std::vector<Value> rows;
+	for(std::size_t i = 0; i < numRows; ++i)
+	{
+		rows.push_back(method.addNewLocal(rowType, "%printf_record"));
+		it.emplace(new MoveOperation(rows.back(), INT_ZERO));
+		it.nextInBlock();
+	}
+	Value format = callSite->getArgument(0).get();
+	format.type = TYPE_INT32;
+	it = insertPrintfWords(method, it, rows, 0, format);
+	it = insertPrintfWords(method, it, rows, 1, Value(Literal(static_cast<long>(numWords - PRINTF_RECORD_HEADER_WORDS)), TYPE_INT32));
+	std::size_t word = PRINTF_RECORD_HEADER_WORDS;
+	for(std::size_t i = 1; i < callSite->getArguments().size(); ++i)
+	{
+		Value arg = callSite->getArgument(i).get();
+		if(arg.type.isPointerType())
+			arg.type = TYPE_INT32;
+		it = insertPrintfWords(method, it, rows, word, arg);
+		word += arg.type.getVectorWidth();
+	}
+
+	//2. reserve the space for the record
+	const Value buffer = method.findOrCreateLocal(TYPE_INT32.toPointerType(), Method::PRINTF_BUFFER)->createReference();
+	const Value capacityAddress = method.addNewLocal(TYPE_INT32.toPointerType(), "%printf_capacity_address");
+	const Value capacity = method.addNewLocal(TYPE_INT32, "%printf_capacity");
+	const Value offset = method.addNewLocal(TYPE_INT32, "%printf_offset");
+	const Value end = method.addNewLocal(TYPE_INT32, "%printf_end");
+	it.emplace(new Operation("add", capacityAddress, buffer, Value(Literal(static_cast<long>(sizeof(uint32_t))), TYPE_INT32)));
+	it.nextInBlock();
+	it = periphery::insertReadDMA(method, it, capacity, capacityAddress);
+	it.emplace(new MoveOperation(NOP_REGISTER, MUTEX_REGISTER));
+	it.nextInBlock();
+	it = periphery::insertReadDMA(method, it, offset, buffer, false);
+	it.emplace(new Operation("add", end, offset, Value(Literal(recordSize), TYPE_INT32)));
+	it.nextInBlock();
+	it = periphery::insertWriteDMA(method, it, end, buffer, false);
+	it.emplace(new MoveOperation(MUTEX_REGISTER, BOOL_TRUE));
+	it.nextInBlock();
+
+	//3. write the record, if it fits into the buffer (the sizes are far below 2^31, so the sign of the difference is the overflow)
+	const Value remaining = method.addNewLocal(TYPE_INT32, "%printf_remaining");
+	const Value overflow = method.addNewLocal(TYPE_INT32, "%printf_overflow");
+	it.emplace(new Operation("sub", remaining, capacity, end));
+	it.nextInBlock();
+	it.emplace(new Operation("shr", overflow, remaining, Value(Literal(31L), TYPE_INT8)));
+	it.nextInBlock();
+	const Value skipLabel = method.addNewLocal(TYPE_LABEL, "%printf_skip");
+	it.emplace(new Branch(skipLabel.local, COND_ZERO_CLEAR, overflow));
+	it.nextInBlock();
+	it = method.emplaceLabel(it, new BranchLabel(*method.addNewLocal(TYPE_LABEL, "%printf_write").local));
+	it.nextInBlock();
+	const Value recordAddress = method.addNewLocal(TYPE_INT32.toPointerType(), "%printf_record_address");
+	const Value recordOffset = method.addNewLocal(TYPE_INT32, "%printf_record_offset");
+	it.emplace(new Operation("add", recordOffset, offset, Value(Literal(PRINTF_BUFFER_HEADER), TYPE_INT32)));
+	it.nextInBlock();
+	it.emplace(new Operation("add", recordAddress, buffer, recordOffset));
+	it.nextInBlock();
+	for(std::size_t i = 0; i < numRows; ++i)
+	{
+		Value rowAddress = recordAddress;
+		if(i > 0)
+		{
+			rowAddress = method.addNewLocal(TYPE_INT32.toPointerType(), "%printf_row_address");
+			it.emplace(new Operation("add", rowAddress, recordAddress, Value(Literal(static_cast<long>(i) * PRINTF_ROW_SIZE), TYPE_INT32)));
+			it.nextInBlock();
+		}
+		it = periphery::insertWriteDMA(method, it, rows[i], rowAddress);
+	}
+	it = method.emplaceLabel(it, new BranchLabel(*skipLabel.local));
+	it.nextInBlock();
+
+	//4. printf returns 0 on success and -1 otherwise
+	if(callSite->getOutput())
+		return it.reset((new Operation("sub", callSite->getOutput(), INT_ZERO, overflow))->copyExtrasFrom(callSite));
+	it.erase();
+	//so next instruction is not skipped
+	it.previousInBlock();
+	return it;
+}
+
+static InstructionWalker intrinsifyMemoryFunction(Method& method, InstructionWalker it)
+{
+	MethodCall* callSite = it.get<MethodCall>();
+	if(callSite == nullptr || callSite->getArguments().size() < 3)
+		return it;
+	//calls with a constant number of bytes are already converted by the front-ends, these have a dynamic length
+	//@llvm.memcpy.p0i8.p0i8.i32(i8* <dest>, i8* <src>, i32 <len>, i32 <align>, i1 <isvolatile>)
+	//@llvm.memset.p0i8.i32(i8* <dest>, i8 <val>, i32 <len>, i32 <align>, i1 <isvolatile>)
+	const bool isCopy = callSite->methodName.find("llvm.memcpy") == 0;
+	const bool isFill = callSite->methodName.find("llvm.memset") == 0;
+	if(!isCopy && !isFill)
+		return it;
+	DEBUG_LOG("Intrinsifying '" << callSite->to_string() << "' to DMA loop" << logging::endl);
+	const Value dest = callSite->getArgument(0).get();
+	const Value arg = callSite->getArgument(1).get();
+	const Value numBytes = callSite->getArgument(2).get();
+	if(isCopy)
+		it = method.vpm->insertCopyRAM(method, it, dest, arg, numBytes, true);
+	else
+		it = method.vpm->insertFillRAM(method, it, dest, arg, numBytes, true);
+	it.erase();
+	//so next instruction is not skipped
+	it.previousInBlock();
+	return it;
+}
+
+static InstructionWalker intrinsifyHalfMemoryAccess(Method& method, InstructionWalker it)
+{
+	MethodCall* callSite = it.get<MethodCall>();
+	if(callSite == nullptr || callSite->getArguments().size() < 2)
+		return it;
+	//calls not implemented by the standard-library, the type-suffixes of the name (e.g. vload_half4jPKDh) are ignored
+	//float vload_half(size_t offset, const half* p), void vstore_half(float data, size_t offset, half* p)
+	const bool isLoad = callSite->methodName.find("vload_half") == 0 || callSite->methodName.find("vloada_half") == 0;
+	const bool isStore = callSite->methodName.find("vstore_half") == 0 || callSite->methodName.find("vstorea_half") == 0;
+	if((!isLoad && !isStore) || (isStore && callSite->getArguments().size() < 3))
+		return it;
+	const Value data = isLoad ? callSite->getOutput().get() : callSite->getArgument(0).get();
+	const Value offset = callSite->getArgument(isLoad ? 0 : 1).get();
+	const Value pointer = callSite->getArgument(isLoad ? 1 : 2).get();
+	const DataType halfType = TYPE_HALF.toVectorType(static_cast<unsigned char>(data.type.getVectorWidth()));
+	//the aligned versions of the 3-element vectors are aligned to 4 elements
+	const bool isAligned = callSite->methodName.find("vloada_half") == 0 || callSite->methodName.find("vstorea_half") == 0;
+	const long stride = static_cast<long>(TYPE_HALF.getScalarBitCount() / 8) * (isAligned && halfType.num == 3 ? 4 : halfType.num);
+	DEBUG_LOG("Intrinsifying '" << callSite->to_string() << "' to 16-bit memory access with " << (isLoad ? "unpack" : "pack") << "-mode" << logging::endl);
+
+	Value address = pointer;
+	if(offset.hasType(ValueType::LITERAL))
+	{
+		if(offset.literal.integer != 0)
+		{
+			address = method.addNewLocal(pointer.type, "%half_address");
+			it.emplace(new Operation("add", address, pointer, Value(Literal(offset.literal.integer * stride), TYPE_INT32)));
+			it.nextInBlock();
+		}
+	}
+	else
+	{
+		const Value byteOffset = method.addNewLocal(TYPE_INT32, "%half_offset");
+		address = method.addNewLocal(pointer.type, "%half_address");
+		it.emplace(new Operation("mul", byteOffset, offset, Value(Literal(stride), TYPE_INT32)));
+		it.nextInBlock();
+		it.emplace(new Operation("add", address, pointer, byteOffset));
+		it.nextInBlock();
+	}
+
+	//the half-words are transferred as such, the conversion from/to float is done by the un-/pack-modes, which can be combined with the consumer/producer
+	const Value tmp = method.addNewLocal(halfType, isLoad ? "%vload_half" : "%vstore_half");
+	if(isLoad)
+	{
+		it = periphery::insertReadDMA(method, it, tmp, address);
+		it.reset((new Operation("fmul", data, tmp, Value(Literal(1.0), TYPE_FLOAT)))->copyExtrasFrom(callSite)->setUnpackMode(UNPACK_HALF_TO_FLOAT));
+		return it;
+	}
+	//the rounding-modes of vstore_half_r are not supported, the pack-mode truncates
+	it.emplace((new Operation("fmul", tmp, data, Value(Literal(1.0), TYPE_FLOAT)))->setPackMode(PACK_FLOAT_TO_HALF_TRUNCATE));
+	it.nextInBlock();
+	it = periphery::insertWriteDMA(method, it, tmp, address);
+	it.erase();
+	//so next instruction is not skipped
+	it.previousInBlock();
+	return it;
+}
+
 InstructionWalker optimizations::intrinsify(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
 {
 	if(!it.has<Operation>() && !it.has<MethodCall>())
@@ -900,27 +1778,27 @@ InstructionWalker optimizations::intrinsify(const Module& module, Method& method
 	if(newIt == it)
 	{
 		//no changes so far
-		newIt = intrinsifyWorkItemFunctions(method, it);
+		newIt = intrinsifyWorkItemFunctions(method, it, config);
 	}
 	if(newIt == it)
 	{
 		//no changes so far
-		newIt = intrinsifyNoArgs(method, it);
+		newIt = intrinsifyBarrier(method, it);
 	}
 	if(newIt == it)
 	{
 		//no changes so far
-		newIt = intrinsifyUnary(method, it);
+		newIt = intrinsifyPrintf(method, it);
 	}
 	if(newIt == it)
 	{
 		//no changes so far
-		newIt = intrinsifyBinary(method, it);
+		newIt = intrinsifyCall(method, it, config.mathType);
 	}
 	if(newIt == it)
 	{
 		//no changes so far
-		newIt = intrinsifyTernary(method, it);
+		newIt = intrinsifyRotation(method, it);
 	}
 	if(newIt == it)
 	{
@@ -930,7 +1808,17 @@ InstructionWalker optimizations::intrinsify(const Module& module, Method& method
 	if(newIt == it)
 	{
 		//no changes so far
-		newIt = intrinsifyImageFunction(it, method);
+		newIt = intrinsifyImageFunction(it, method, config.mathType);
+	}
+	if(newIt == it)
+	{
+		//no changes so far
+		newIt = intrinsifyMemoryFunction(method, it);
+	}
+	if(newIt == it)
+	{
+		//no changes so far
+		newIt = intrinsifyHalfMemoryAccess(method, it);
 	}
 	return newIt;
 }
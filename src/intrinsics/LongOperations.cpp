@@ -0,0 +1,607 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "LongOperations.h"
+
+#include "../InstructionWalker.h"
+#include "../intermediate/IntermediateInstruction.h"
+#include "../Logging.h"
+
+#include <cstdint>
+
+using namespace vc4c;
+using namespace vc4c::intermediate;
+
+//the name-suffix of the local holding the upper word of a 64-bit local
+static const std::string UPPER_WORD_SUFFIX(".upper");
+
+static bool isLongType(const DataType& type)
+{
+	return (type.isScalarType() || type.isVectorType()) && !type.isPointerType() && type.getScalarBitCount() == 64;
+}
+
+static DataType getWordType(const DataType& longType)
+{
+	return TYPE_INT32.toVectorType(static_cast<unsigned char>(longType.getVectorWidth()));
+}
+
+static const Local* findUpperWord(const Method& method, const Local* local)
+{
+	return method.findLocal(local->name + UPPER_WORD_SUFFIX);
+}
+
+static Value toWordLiteral(const uint32_t bits)
+{
+	//32-bit literals are stored as signed values
+	return Value(Literal(static_cast<long>(static_cast<int32_t>(bits))), TYPE_INT32);
+}
+
+/*
+ * The lower word of the 64-bit value: literals are truncated, the 64-bit locals hold their lower word themselves
+ */
+static Value getLowerWord(const Value& val)
+{
+	if(val.hasType(ValueType::LITERAL))
+		return toWordLiteral(static_cast<uint32_t>(static_cast<uint64_t>(val.literal.integer)));
+	return val;
+}
+
+/*
+ * Whether the upper word of the value is known or will be calculated by lowering the given locals
+ */
+static bool hasUpperWord(const Method& method, const Value& val, const FastSet<const Local*>& lowerable)
+{
+	if(val.hasType(ValueType::LITERAL) || val.isUndefined())
+		return true;
+	if(!val.hasType(ValueType::LOCAL) || !isLongType(val.local->type))
+		return false;
+	return findUpperWord(method, val.local) != nullptr || lowerable.find(val.local) != lowerable.end();
+}
+
+/*
+ * The upper word of the 64-bit value, if it is known
+ */
+static Optional<Value> getUpperWord(const Method& method, const Value& val)
+{
+	if(val.hasType(ValueType::LITERAL))
+		return toWordLiteral(static_cast<uint32_t>(static_cast<uint64_t>(val.literal.integer) >> 32));
+	if(val.isUndefined())
+		return UNDEFINED_VALUE;
+	if(!val.hasType(ValueType::LOCAL) || !isLongType(val.local->type))
+		return NO_VALUE;
+	const Local* upper = findUpperWord(method, val.local);
+	if(upper == nullptr)
+		return NO_VALUE;
+	return upper->createReference();
+}
+
+static bool isLiteralZero(const Value& val)
+{
+	return val.hasType(ValueType::LITERAL) && val.literal.integer == 0;
+}
+
+static bool isLoweringSupported(const Method& method, const IntermediateInstruction* instr, const FastSet<const Local*>& lowerable)
+{
+	if(instr == nullptr || instr->hasConditionalExecution() || instr->setFlags == SetFlag::SET_FLAGS || instr->hasPackMode() || instr->hasUnpackMode())
+		return false;
+	if(!instr->hasValueType(ValueType::LOCAL))
+		return false;
+	//the lowering reads the inputs after writing the lower word of the output
+	for(const Value& arg : instr->getArguments())
+	{
+		if(arg.hasLocal(instr->getOutput().get().local))
+			return false;
+	}
+	if(instr->is<MoveOperation>())
+		return hasUpperWord(method, instr->as<MoveOperation>()->getSource(), lowerable);
+	const Operation* op = instr->as<Operation>();
+	if(op == nullptr || op->is<Comparison>())
+		return false;
+	if(op->opCode.compare("zext") == 0 || op->opCode.compare("sext") == 0)
+		return !isLongType(op->getFirstArg().type);
+	if(!op->getSecondArg() || !hasUpperWord(method, op->getFirstArg(), lowerable))
+		return false;
+	for(const char* opCode : {"and", "or", "xor", "add", "sub", "mul"})
+	{
+		if(op->opCode.compare(opCode) == 0)
+			return hasUpperWord(method, op->getSecondArg().get(), lowerable);
+	}
+	for(const char* opCode : {"shl", "lshr", "ashr"})
+	{
+		//only the lower word of the offset is used
+		if(op->opCode.compare(opCode) == 0)
+			return op->getSecondArg().get().hasType(ValueType::LITERAL) || op->getSecondArg().get().hasType(ValueType::LOCAL);
+	}
+	return false;
+}
+
+/*
+ * Calculates the high word of the 64-bit product of the two unsigned 32-bit values.
+ *
+ * Same as the calculation for the division by constant (see Operators.cpp), the operands are split into 16-bit halves,
+ * multiplied with mul24 and the partial products are added up, including the carry of the (not calculated) low word.
+ */
+static InstructionWalker insertUnsignedMultiplyHigh(Method& method, InstructionWalker it, const Value& arg0, const Value& arg1, const Value& dest)
+{
+	const DataType type = dest.type;
+	Value halves[2][2] = {{UNDEFINED_VALUE, UNDEFINED_VALUE}, {UNDEFINED_VALUE, UNDEFINED_VALUE}};
+	const Value* args[2] = {&arg0, &arg1};
+	for(std::size_t i = 0; i < 2; ++i)
+	{
+		if(args[i]->hasType(ValueType::LITERAL))
+		{
+			const uint32_t bits = static_cast<uint32_t>(args[i]->literal.integer);
+			halves[i][0] = Value(Literal(static_cast<long>(bits & 0xFFFF)), TYPE_INT32);
+			halves[i][1] = Value(Literal(static_cast<long>(bits >> 16)), TYPE_INT32);
+			continue;
+		}
+		halves[i][0] = method.addNewLocal(type, "%mulhi.low");
+		halves[i][1] = method.addNewLocal(type, "%mulhi.high");
+		it.emplace(new Operation("and", halves[i][0], *args[i], Value(Literal(0xFFFFL), TYPE_INT32)));
+		it.nextInBlock();
+		it.emplace(new Operation("shr", halves[i][1], *args[i], Value(Literal(16L), TYPE_INT8)));
+		it.nextInBlock();
+	}
+
+	const Value lowLow = method.addNewLocal(type, "%mulhi.ll");
+	const Value lowHigh = method.addNewLocal(type, "%mulhi.lh");
+	const Value highLow = method.addNewLocal(type, "%mulhi.hl");
+	const Value highHigh = method.addNewLocal(type, "%mulhi.hh");
+	it.emplace(new Operation("mul24", lowLow, halves[0][0], halves[1][0]));
+	it.nextInBlock();
+	it.emplace(new Operation("mul24", lowHigh, halves[0][0], halves[1][1]));
+	it.nextInBlock();
+	it.emplace(new Operation("mul24", highLow, halves[0][1], halves[1][0]));
+	it.nextInBlock();
+	it.emplace(new Operation("mul24", highHigh, halves[0][1], halves[1][1]));
+	it.nextInBlock();
+
+	//carry = ((ll >> 16) + (lh & 0xFFFF) + (hl & 0xFFFF)) >> 16
+	const Value carry0 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry1 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry2 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry3 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry4 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry = method.addNewLocal(type, "%mulhi.carry");
+	it.emplace(new Operation("shr", carry0, lowLow, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("and", carry1, lowHigh, Value(Literal(0xFFFFL), TYPE_INT32)));
+	it.nextInBlock();
+	it.emplace(new Operation("and", carry2, highLow, Value(Literal(0xFFFFL), TYPE_INT32)));
+	it.nextInBlock();
+	it.emplace(new Operation("add", carry3, carry0, carry1));
+	it.nextInBlock();
+	it.emplace(new Operation("add", carry4, carry3, carry2));
+	it.nextInBlock();
+	it.emplace(new Operation("shr", carry, carry4, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+
+	//high = hh + (lh >> 16) + (hl >> 16) + carry
+	const Value high0 = method.addNewLocal(type, "%mulhi.high");
+	const Value high1 = method.addNewLocal(type, "%mulhi.high");
+	const Value high2 = method.addNewLocal(type, "%mulhi.high");
+	const Value high3 = method.addNewLocal(type, "%mulhi.high");
+	it.emplace(new Operation("shr", high0, lowHigh, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("shr", high1, highLow, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("add", high2, highHigh, high0));
+	it.nextInBlock();
+	it.emplace(new Operation("add", high3, high2, high1));
+	it.nextInBlock();
+	it.emplace(new Operation("add", dest, high3, carry));
+	it.nextInBlock();
+	return it;
+}
+
+/*
+ * Lowers the instruction writing a 64-bit local.
+ *
+ * The instruction (calculating the lower word) is kept where possible, the calculation of the upper word is inserted after it.
+ * Returns the position of the last instruction inserted
+ */
+static InstructionWalker lowerWriter(Method& method, InstructionWalker it)
+{
+	const Value out = it->getOutput();
+	const Value upperOut = getUpperWord(method, out).get();
+	const DataType type = upperOut.type;
+	InstructionWalker next = it.copy().nextInBlock();
+
+	if(it.has<MoveOperation>())
+	{
+		const Value src = it.get<MoveOperation>()->getSource();
+		const Value upperSrc = getUpperWord(method, src).get();
+		it->setArgument(0, getLowerWord(src));
+		if(it.has<VectorRotation>() && !upperSrc.isLiteralValue())
+		{
+			//we insert a delay before every vector rotation, see insertVectorRotation
+			next.emplace(new Nop(DelayType::WAIT_REGISTER));
+			next.nextInBlock();
+			next.emplace(new VectorRotation(upperOut, upperSrc, it.get<VectorRotation>()->getOffset()));
+		}
+		else
+			next.emplace(new MoveOperation(upperOut, upperSrc));
+		return next;
+	}
+
+	Operation* op = it.get<Operation>();
+	const std::string opCode = op->opCode;
+	const Value arg0 = op->getFirstArg();
+	if(opCode.compare("zext") == 0)
+	{
+		next.emplace(new MoveOperation(upperOut, INT_ZERO));
+		return next;
+	}
+	if(opCode.compare("sext") == 0)
+	{
+		//the lower word is sign-extended to 32 bit, the upper word is the replicated sign
+		next.emplace(new Operation("asr", upperOut, out, Value(Literal(31L), TYPE_INT8)));
+		return next;
+	}
+
+	const Value arg1 = op->getSecondArg().get();
+	const Value upper0 = getUpperWord(method, arg0).get();
+	const Value lower0 = getLowerWord(arg0);
+	op->setArgument(0, lower0);
+
+	if(opCode.compare("shl") == 0 || opCode.compare("lshr") == 0 || opCode.compare("ashr") == 0)
+	{
+		const bool isLeft = opCode.compare("shl") == 0;
+		const bool isArithmetic = opCode.compare("ashr") == 0;
+		const std::string rightShift = isArithmetic ? "asr" : "shr";
+		if(arg1.hasType(ValueType::LITERAL))
+		{
+			const long offset = arg1.literal.integer & 63;
+			const Value offsetValue(Literal(offset & 31), TYPE_INT8);
+			const Value inverseOffset(Literal(32 - (offset & 31)), TYPE_INT8);
+			if(offset == 0)
+			{
+				it.reset(new MoveOperation(out, lower0));
+				next.emplace(new MoveOperation(upperOut, upper0));
+				return next;
+			}
+			if(isLeft && offset < 32)
+			{
+				//lower = lower << n, upper = (upper << n) | (lower >> (32 - n))
+				op->setArgument(1, offsetValue);
+				const Value tmp0 = method.addNewLocal(type, "%long.shl");
+				const Value tmp1 = method.addNewLocal(type, "%long.shl");
+				next.emplace(new Operation("shl", tmp0, upper0, offsetValue));
+				next.nextInBlock();
+				next.emplace(new Operation("shr", tmp1, lower0, inverseOffset));
+				next.nextInBlock();
+				next.emplace(new Operation("or", upperOut, tmp0, tmp1));
+				return next;
+			}
+			if(isLeft)
+			{
+				//lower = 0, upper = lower << (n - 32)
+				it.reset(new MoveOperation(out, INT_ZERO));
+				if(offset == 32)
+					next.emplace(new MoveOperation(upperOut, lower0));
+				else
+					next.emplace(new Operation("shl", upperOut, lower0, offsetValue));
+				return next;
+			}
+			if(offset < 32)
+			{
+				//lower = (lower >> n) | (upper << (32 - n)), upper = upper >> n
+				const Value tmp0 = method.addNewLocal(type, "%long.shr");
+				const Value tmp1 = method.addNewLocal(type, "%long.shr");
+				it.emplace(new Operation("shr", tmp0, lower0, offsetValue));
+				it.nextInBlock();
+				it.emplace(new Operation("shl", tmp1, upper0, inverseOffset));
+				it.nextInBlock();
+				it.reset(new Operation("or", out, tmp0, tmp1));
+				next.emplace(new Operation(rightShift, upperOut, upper0, offsetValue));
+				return next;
+			}
+			//lower = upper >> (n - 32), upper = 0 or the sign
+			if(offset == 32)
+				it.reset(new MoveOperation(out, upper0));
+			else
+				it.reset(new Operation(rightShift, out, upper0, offsetValue));
+			if(isArithmetic)
+				next.emplace(new Operation("asr", upperOut, upper0, Value(Literal(31L), TYPE_INT8)));
+			else
+				next.emplace(new MoveOperation(upperOut, INT_ZERO));
+			return next;
+		}
+
+		/*
+		 * Shifts by a variable offset calculate both cases (offset < 32 and offset >= 32) and select the correct one.
+		 * The hardware only uses the lower 5 bits of the offset, so the shift by (n - 32) is the same as the shift by n.
+		 * To not shift by 32 (= 0) for an offset of zero, the bits moved between the words are shifted in two steps
+		 */
+		const Value offset = arg1;
+		const Value inverseOffset = method.addNewLocal(type, "%long.offset");
+		it.emplace(new Operation("sub", inverseOffset, Value(Literal(31L), TYPE_INT8), offset));
+		it.nextInBlock();
+		if(isLeft)
+		{
+			const Value shiftedLower = method.addNewLocal(type, "%long.shl");
+			const Value tmp0 = method.addNewLocal(type, "%long.shl");
+			const Value tmp1 = method.addNewLocal(type, "%long.shl");
+			const Value tmp2 = method.addNewLocal(type, "%long.shl");
+			const Value shiftedUpper = method.addNewLocal(type, "%long.shl");
+			it.emplace(new Operation("shl", shiftedLower, lower0, offset));
+			it.nextInBlock();
+			it.emplace(new Operation("shl", tmp0, upper0, offset));
+			it.nextInBlock();
+			it.emplace(new Operation("shr", tmp1, lower0, INT_ONE));
+			it.nextInBlock();
+			it.emplace(new Operation("shr", tmp2, tmp1, inverseOffset));
+			it.nextInBlock();
+			it.emplace(new Operation("or", shiftedUpper, tmp0, tmp2));
+			it.nextInBlock();
+			it.emplace(new Operation("sub", NOP_REGISTER, offset, Value(Literal(32L), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+			it.nextInBlock();
+			it.emplace(new MoveOperation(upperOut, shiftedUpper, COND_NEGATIVE_SET));
+			it.nextInBlock();
+			it.emplace(new MoveOperation(upperOut, shiftedLower, COND_NEGATIVE_CLEAR));
+			it.nextInBlock();
+			it.emplace(new MoveOperation(out, shiftedLower, COND_NEGATIVE_SET));
+			it.nextInBlock();
+			it.reset(new MoveOperation(out, INT_ZERO, COND_NEGATIVE_CLEAR));
+			return it;
+		}
+		const Value tmp0 = method.addNewLocal(type, "%long.shr");
+		const Value tmp1 = method.addNewLocal(type, "%long.shr");
+		const Value tmp2 = method.addNewLocal(type, "%long.shr");
+		const Value shiftedLower = method.addNewLocal(type, "%long.shr");
+		const Value shiftedUpper = method.addNewLocal(type, "%long.shr");
+		it.emplace(new Operation("shr", tmp0, lower0, offset));
+		it.nextInBlock();
+		it.emplace(new Operation("shl", tmp1, upper0, INT_ONE));
+		it.nextInBlock();
+		it.emplace(new Operation("shl", tmp2, tmp1, inverseOffset));
+		it.nextInBlock();
+		it.emplace(new Operation("or", shiftedLower, tmp0, tmp2));
+		it.nextInBlock();
+		it.emplace(new Operation(rightShift, shiftedUpper, upper0, offset));
+		it.nextInBlock();
+		Value fill = INT_ZERO;
+		if(isArithmetic)
+		{
+			fill = method.addNewLocal(type, "%long.sign");
+			it.emplace(new Operation("asr", fill, upper0, Value(Literal(31L), TYPE_INT8)));
+			it.nextInBlock();
+		}
+		it.emplace(new Operation("sub", NOP_REGISTER, offset, Value(Literal(32L), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(out, shiftedLower, COND_NEGATIVE_SET));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(out, shiftedUpper, COND_NEGATIVE_CLEAR));
+		it.nextInBlock();
+		it.emplace(new MoveOperation(upperOut, shiftedUpper, COND_NEGATIVE_SET));
+		it.nextInBlock();
+		it.reset(new MoveOperation(upperOut, fill, COND_NEGATIVE_CLEAR));
+		return it;
+	}
+
+	const Value upper1 = getUpperWord(method, arg1).get();
+	const Value lower1 = getLowerWord(arg1);
+	op->setArgument(1, lower1);
+
+	if(opCode.compare("and") == 0 || opCode.compare("or") == 0 || opCode.compare("xor") == 0)
+	{
+		//bit-wise operations are independent for both words
+		next.emplace(new Operation(opCode, upperOut, upper0, upper1));
+		return next;
+	}
+	if(opCode.compare("add") == 0)
+	{
+		//upper = upper0 + upper1 + carry, carry = ((lower0 & lower1) | ((lower0 | lower1) & ~lower)) >> 31 (see Hacker's Delight, 2-13)
+		const Value sum = method.addNewLocal(type, "%long.add");
+		const Value tmp0 = method.addNewLocal(type, "%long.carry");
+		const Value tmp1 = method.addNewLocal(type, "%long.carry");
+		const Value tmp2 = method.addNewLocal(type, "%long.carry");
+		const Value tmp3 = method.addNewLocal(type, "%long.carry");
+		const Value tmp4 = method.addNewLocal(type, "%long.carry");
+		const Value carry = method.addNewLocal(type, "%long.carry");
+		//independent of the lower word, can be paired with it
+		it.emplace(new Operation("add", sum, upper0, upper1));
+		it.nextInBlock();
+		next.emplace(new Operation("and", tmp0, lower0, lower1));
+		next.nextInBlock();
+		next.emplace(new Operation("or", tmp1, lower0, lower1));
+		next.nextInBlock();
+		next.emplace(new Operation("not", tmp2, out));
+		next.nextInBlock();
+		next.emplace(new Operation("and", tmp3, tmp1, tmp2));
+		next.nextInBlock();
+		next.emplace(new Operation("or", tmp4, tmp0, tmp3));
+		next.nextInBlock();
+		next.emplace(new Operation("shr", carry, tmp4, Value(Literal(31L), TYPE_INT8)));
+		next.nextInBlock();
+		next.emplace(new Operation("add", upperOut, sum, carry));
+		return next;
+	}
+	if(opCode.compare("sub") == 0)
+	{
+		//upper = upper0 - upper1 - borrow, borrow = ((~lower0 & lower1) | (~(lower0 ^ lower1) & lower)) >> 31 (see Hacker's Delight, 2-13)
+		const Value difference = method.addNewLocal(type, "%long.sub");
+		const Value tmp0 = method.addNewLocal(type, "%long.borrow");
+		const Value tmp1 = method.addNewLocal(type, "%long.borrow");
+		const Value tmp2 = method.addNewLocal(type, "%long.borrow");
+		const Value tmp3 = method.addNewLocal(type, "%long.borrow");
+		const Value tmp4 = method.addNewLocal(type, "%long.borrow");
+		const Value tmp5 = method.addNewLocal(type, "%long.borrow");
+		const Value borrow = method.addNewLocal(type, "%long.borrow");
+		it.emplace(new Operation("sub", difference, upper0, upper1));
+		it.nextInBlock();
+		next.emplace(new Operation("not", tmp0, lower0));
+		next.nextInBlock();
+		next.emplace(new Operation("and", tmp1, tmp0, lower1));
+		next.nextInBlock();
+		next.emplace(new Operation("xor", tmp2, lower0, lower1));
+		next.nextInBlock();
+		next.emplace(new Operation("not", tmp3, tmp2));
+		next.nextInBlock();
+		next.emplace(new Operation("and", tmp4, tmp3, out));
+		next.nextInBlock();
+		next.emplace(new Operation("or", tmp5, tmp1, tmp4));
+		next.nextInBlock();
+		next.emplace(new Operation("shr", borrow, tmp5, Value(Literal(31L), TYPE_INT8)));
+		next.nextInBlock();
+		next.emplace(new Operation("sub", upperOut, difference, borrow));
+		return next;
+	}
+	if(opCode.compare("mul") == 0)
+	{
+		//the lower word is the 32-bit product, upper = mul_hi(lower0, lower1) + lower0 * upper1 + upper0 * lower1
+		std::vector<Value> parts;
+		parts.reserve(3);
+		parts.push_back(method.addNewLocal(type, "%long.mul"));
+		next = insertUnsignedMultiplyHigh(method, next, lower0, lower1, parts.front());
+		if(!isLiteralZero(upper1))
+		{
+			parts.push_back(method.addNewLocal(type, "%long.mul"));
+			next.emplace(new Operation("mul", parts.back(), lower0, upper1));
+			next.nextInBlock();
+		}
+		if(!isLiteralZero(upper0))
+		{
+			parts.push_back(method.addNewLocal(type, "%long.mul"));
+			next.emplace(new Operation("mul", parts.back(), upper0, lower1));
+			next.nextInBlock();
+		}
+		Value sum = parts.front();
+		for(std::size_t i = 1; i < parts.size(); ++i)
+		{
+			const Value tmp = i + 1 == parts.size() ? upperOut : method.addNewLocal(type, "%long.mul");
+			next.emplace(new Operation("add", tmp, sum, parts[i]));
+			next.nextInBlock();
+			sum = tmp;
+		}
+		if(parts.size() == 1)
+			next.emplace(new MoveOperation(upperOut, sum));
+		else
+			next.previousInBlock();
+		return next;
+	}
+	throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled 64-bit operation", op->to_string());
+}
+
+/*
+ * Lowers the comparison of two 64-bit values by comparing both words
+ */
+static InstructionWalker lowerComparison(Method& method, InstructionWalker it)
+{
+	const Comparison* comp = it.get<Comparison>();
+	const std::string opCode = comp->opCode;
+	const Value out = comp->getOutput();
+	const Value arg0 = comp->getFirstArg();
+	const Value arg1 = comp->getSecondArg().get();
+	const Optional<Value> upper0 = getUpperWord(method, arg0);
+	const Optional<Value> upper1 = getUpperWord(method, arg1);
+	if(!upper0 || !upper1)
+		return it;
+	const DataType type = getWordType(arg0.type);
+	const Value lower0 = getLowerWord(arg0);
+	const Value lower1 = getLowerWord(arg1);
+
+	if(opCode.compare(COMP_EQ) == 0 || opCode.compare(COMP_NEQ) == 0)
+	{
+		//a == b <=> ((a.lower ^ b.lower) | (a.upper ^ b.upper)) == 0
+		const Value tmp0 = method.addNewLocal(type, "%long.cmp");
+		const Value tmp1 = method.addNewLocal(type, "%long.cmp");
+		const Value tmp2 = method.addNewLocal(type, "%long.cmp");
+		it.emplace(new Operation("xor", tmp0, lower0, lower1));
+		it.nextInBlock();
+		it.emplace(new Operation("xor", tmp1, upper0.get(), upper1.get()));
+		it.nextInBlock();
+		it.emplace(new Operation("or", tmp2, tmp0, tmp1));
+		it.nextInBlock();
+		it.reset(new Comparison(opCode, out, tmp2, INT_ZERO));
+		return it;
+	}
+	const bool isSigned = opCode.compare(COMP_SIGNED_GT) == 0 || opCode.compare(COMP_SIGNED_GE) == 0 || opCode.compare(COMP_SIGNED_LT) == 0 ||
+			opCode.compare(COMP_SIGNED_LE) == 0;
+	const bool isUnsigned = opCode.compare(COMP_UNSIGNED_GT) == 0 || opCode.compare(COMP_UNSIGNED_GE) == 0 || opCode.compare(COMP_UNSIGNED_LT) == 0 ||
+			opCode.compare(COMP_UNSIGNED_LE) == 0;
+	if(!isSigned && !isUnsigned)
+		return it;
+	//a < b <=> a.upper < b.upper || (a.upper == b.upper && a.lower < b.lower), the lower words are always compared unsigned
+	const std::string relation = opCode.substr(1);
+	const std::string strictRelation = relation[0] == 'g' ? "gt" : "lt";
+	const DataType boolType = TYPE_BOOL.toVectorType(static_cast<unsigned char>(arg0.type.getVectorWidth()));
+	const Value upperStrict = method.addNewLocal(boolType, "%long.cmp");
+	const Value upperEqual = method.addNewLocal(boolType, "%long.cmp");
+	const Value lowerRelation = method.addNewLocal(boolType, "%long.cmp");
+	const Value lowerDecides = method.addNewLocal(boolType, "%long.cmp");
+	it.emplace(new Comparison(std::string(isSigned ? "s" : "u") + strictRelation, upperStrict, upper0.get(), upper1.get()));
+	it.nextInBlock();
+	it.emplace(new Comparison(COMP_EQ, upperEqual, upper0.get(), upper1.get()));
+	it.nextInBlock();
+	it.emplace(new Comparison(std::string("u") + relation, lowerRelation, lower0, lower1));
+	it.nextInBlock();
+	it.emplace(new Operation("and", lowerDecides, upperEqual, lowerRelation));
+	it.nextInBlock();
+	it.reset(new Operation("or", out, upperStrict, lowerDecides));
+	return it;
+}
+
+void optimizations::lowerLongOperations(const Module& module, Method& method, const Configuration& config)
+{
+	//1. find all 64-bit locals not yet lowered (e.g. the bodies of inlined methods are already lowered)
+	FastSet<const Local*> lowerable;
+	for(auto it = method.walkAllInstructions(); !it.isEndOfMethod(); it.nextInMethod())
+	{
+		if(it.has() && it->hasValueType(ValueType::LOCAL) && isLongType(it->getOutput().get().local->type) && findUpperWord(method, it->getOutput().get().local) == nullptr)
+			lowerable.emplace(it->getOutput().get().local);
+	}
+	if(lowerable.empty())
+		return;
+
+	//2. remove all locals with a writer which can't be lowered (or depends on such a local), until nothing changes
+	bool changed = true;
+	while(changed)
+	{
+		changed = false;
+		auto localIt = lowerable.begin();
+		while(localIt != lowerable.end())
+		{
+			bool isSupported = true;
+			(*localIt)->forUsers(LocalUser::Type::WRITER, [&method, &lowerable, &isSupported](const LocalUser* user) -> void
+			{
+				isSupported = isSupported && isLoweringSupported(method, dynamic_cast<const IntermediateInstruction*>(user), lowerable);
+			});
+			if(isSupported)
+				++localIt;
+			else
+			{
+				DEBUG_LOG("Cannot lower 64-bit local, its value is truncated to 32 bit: " << (*localIt)->to_string() << logging::endl);
+				localIt = lowerable.erase(localIt);
+				changed = true;
+			}
+		}
+	}
+
+	//3. create the locals for the upper words
+	for(const Local* local : lowerable)
+		method.findOrCreateLocal(getWordType(local->type), local->name + UPPER_WORD_SUFFIX);
+
+	//4. lower the writers of the locals and the comparisons of all 64-bit values with known upper words
+	std::size_t numLowered = 0;
+	for(auto it = method.walkAllInstructions(); !it.isEndOfMethod(); it.nextInMethod())
+	{
+		if(!it.has())
+			continue;
+		if(it.has<Comparison>() && !it->hasConditionalExecution() && it->setFlags == SetFlag::DONT_SET && isLongType(it.get<Comparison>()->getFirstArg().type))
+		{
+			it = lowerComparison(method, it);
+			++numLowered;
+		}
+		else if(it->hasValueType(ValueType::LOCAL) && lowerable.find(it->getOutput().get().local) != lowerable.end())
+		{
+			DEBUG_LOG("Lowering 64-bit operation: " << it->to_string() << logging::endl);
+			it = lowerWriter(method, it);
+			++numLowered;
+		}
+	}
+	DEBUG_LOG("Lowered " << numLowered << " 64-bit operations to pairs of 32-bit words" << logging::endl);
+}
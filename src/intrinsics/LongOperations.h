@@ -0,0 +1,31 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef LONG_OPERATIONS_H
+#define LONG_OPERATIONS_H
+
+#include <config.h>
+#include "../Module.h"
+
+namespace vc4c
+{
+	namespace optimizations
+	{
+		/*
+		 * Lowers the arithmetic on 64-bit integers to pairs of 32-bit registers.
+		 *
+		 * The 64-bit local itself keeps holding the lower word (as before, where all 64-bit values were truncated to 32 bit),
+		 * the upper word is held in an additional local with the suffix ".upper".
+		 * Only locals whose upper word can be calculated completely (from literals, extensions of 32-bit values and supported operations) are lowered,
+		 * all other 64-bit values (e.g. loaded from memory or passed as parameters) are still truncated.
+		 *
+		 * This needs to run before the operations are intrinsified, since the extensions and truncations are converted to simple moves.
+		 */
+		void lowerLongOperations(const Module& module, Method& method, const Configuration& config);
+	}
+}
+
+#endif /* LONG_OPERATIONS_H */
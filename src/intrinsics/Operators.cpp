@@ -10,7 +10,7 @@
 #include "Comparisons.h"
 #include "helper.h"
 #include "../intermediate/Helper.h"
-#include "log.h"
+#include "../Logging.h"
 
 using namespace vc4c;
 using namespace vc4c::intermediate;
@@ -67,7 +67,7 @@ InstructionWalker intermediate::intrinsifyUnsignedIntegerMultiplication(Method&
     //mul24 can multiply 24-bits * 24-bits into 32-bits
     //default case, full multiplication
     //NOTE: the instructions are ordered in a way, that the insertion of NOPs to split read-after-write is minimal
-    logging::debug() << "Intrinsifying unsigned multiplication of integers" << logging::endl;
+    DEBUG_LOG("Intrinsifying unsigned multiplication of integers" << logging::endl);
 
     const Value a0 = method.addNewLocal(op.getOutput().get().type, "%mul.a0");
     const Value a1 = method.addNewLocal(op.getOutput().get().type, "%mul.a1");
@@ -216,8 +216,169 @@ InstructionWalker intermediate::intrinsifySignedIntegerDivision(Method& method,
 	return it;
 }
 
+/*
+ * Calculates the high word of the 64-bit product of the unsigned numerator with the constant factor.
+ *
+ * Since mul24 can only multiply 24-bit values, the operands are split into 16-bit halves and the partial products are added up,
+ * including the carry of the (not calculated) low word.
+ */
+static InstructionWalker insertMultiplyHigh(Method& method, InstructionWalker it, const Value& numerator, const uint32_t factor, const Value& dest)
+{
+	const DataType type = dest.type;
+	const Value nLow = method.addNewLocal(type, "%mulhi.n_low");
+	const Value nHigh = method.addNewLocal(type, "%mulhi.n_high");
+	it.emplace(new Operation("and", nLow, numerator, Value(Literal(0xFFFFL), TYPE_INT32)));
+	it.nextInBlock();
+	it.emplace(new Operation("shr", nHigh, numerator, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+	const Value fLow(Literal(static_cast<long>(factor & 0xFFFF)), TYPE_INT32);
+	const Value fHigh(Literal(static_cast<long>(factor >> 16)), TYPE_INT32);
+
+	const Value lowLow = method.addNewLocal(type, "%mulhi.ll");
+	const Value lowHigh = method.addNewLocal(type, "%mulhi.lh");
+	const Value highLow = method.addNewLocal(type, "%mulhi.hl");
+	const Value highHigh = method.addNewLocal(type, "%mulhi.hh");
+	it.emplace(new Operation("mul24", lowLow, nLow, fLow));
+	it.nextInBlock();
+	it.emplace(new Operation("mul24", lowHigh, nLow, fHigh));
+	it.nextInBlock();
+	it.emplace(new Operation("mul24", highLow, nHigh, fLow));
+	it.nextInBlock();
+	it.emplace(new Operation("mul24", highHigh, nHigh, fHigh));
+	it.nextInBlock();
+
+	//carry = ((ll >> 16) + (lh & 0xFFFF) + (hl & 0xFFFF)) >> 16
+	const Value carry0 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry1 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry2 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry3 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry4 = method.addNewLocal(type, "%mulhi.carry");
+	const Value carry = method.addNewLocal(type, "%mulhi.carry");
+	it.emplace(new Operation("shr", carry0, lowLow, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("and", carry1, lowHigh, Value(Literal(0xFFFFL), TYPE_INT32)));
+	it.nextInBlock();
+	it.emplace(new Operation("and", carry2, highLow, Value(Literal(0xFFFFL), TYPE_INT32)));
+	it.nextInBlock();
+	it.emplace(new Operation("add", carry3, carry0, carry1));
+	it.nextInBlock();
+	it.emplace(new Operation("add", carry4, carry3, carry2));
+	it.nextInBlock();
+	it.emplace(new Operation("shr", carry, carry4, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+
+	//high = hh + (lh >> 16) + (hl >> 16) + carry
+	const Value high0 = method.addNewLocal(type, "%mulhi.high");
+	const Value high1 = method.addNewLocal(type, "%mulhi.high");
+	const Value high2 = method.addNewLocal(type, "%mulhi.high");
+	const Value high3 = method.addNewLocal(type, "%mulhi.high");
+	it.emplace(new Operation("shr", high0, lowHigh, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("shr", high1, highLow, Value(Literal(16L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("add", high2, highHigh, high0));
+	it.nextInBlock();
+	it.emplace(new Operation("add", high3, high2, high1));
+	it.nextInBlock();
+	it.emplace(new Operation("add", dest, high3, carry));
+	it.nextInBlock();
+	return it;
+}
+
+/*
+ * Replaces the division by a constant with a multiplication with the "magic" reciprocal and a right-shift.
+ *
+ * Sources/Info:
+ * - Granlund, Montgomery: "Division by Invariant Integers using Multiplication"
+ * - https://github.com/ridiculousfish/libdivide
+ */
+static InstructionWalker intrinsifyUnsignedIntegerDivisionByConstant(Method& method, InstructionWalker it, Operation& op, const bool useRemainder)
+{
+	const Value numerator = op.getFirstArg();
+	const Value divisor = op.getSecondArg().get();
+	const uint32_t divisorValue = static_cast<uint32_t>(divisor.literal.integer);
+	const DataType type = op.getOutput().get().type;
+
+	DEBUG_LOG("Intrinsifying division of unsigned integers by constant " << divisorValue << logging::endl);
+
+	Value quotient = method.addNewLocal(type, "%udiv.quotient");
+	//the shift is floor(log2(divisor)), so 2^(32 + shift) / divisor fits into 32 bits for divisors which are not a power of two
+	unsigned shift = 0;
+	while((uint64_t(2) << shift) <= divisorValue)
+		++shift;
+	if((divisorValue & (divisorValue - 1)) == 0)
+	{
+		it.emplace(new Operation("shr", quotient, numerator, Value(Literal(static_cast<long>(shift)), TYPE_INT8)));
+		it.nextInBlock();
+	}
+	else
+	{
+		const uint64_t factor = (uint64_t(1) << (32 + shift)) / divisorValue;
+		const uint64_t rest = (uint64_t(1) << (32 + shift)) % divisorValue;
+		const Value high = method.addNewLocal(type, "%udiv.mulhi");
+		if(divisorValue - rest < (uint64_t(1) << shift))
+		{
+			//q = mulhi(n, m) >> s
+			it = insertMultiplyHigh(method, it, numerator, static_cast<uint32_t>(factor + 1), high);
+			it.emplace(new Operation("shr", quotient, high, Value(Literal(static_cast<long>(shift)), TYPE_INT8)));
+			it.nextInBlock();
+		}
+		else
+		{
+			//the magic number has 33 bits, so its upper bit is added separately: q = (((n - t) >> 1) + t) >> s with t = mulhi(n, m)
+			const uint64_t magic = 2 * factor + (2 * rest >= divisorValue ? 1 : 0) + 1;
+			it = insertMultiplyHigh(method, it, numerator, static_cast<uint32_t>(magic), high);
+			const Value tmp0 = method.addNewLocal(type, "%udiv.tmp");
+			const Value tmp1 = method.addNewLocal(type, "%udiv.tmp");
+			const Value tmp2 = method.addNewLocal(type, "%udiv.tmp");
+			it.emplace(new Operation("sub", tmp0, numerator, high));
+			it.nextInBlock();
+			it.emplace(new Operation("shr", tmp1, tmp0, INT_ONE));
+			it.nextInBlock();
+			it.emplace(new Operation("add", tmp2, tmp1, high));
+			it.nextInBlock();
+			it.emplace(new Operation("shr", quotient, tmp2, Value(Literal(static_cast<long>(shift)), TYPE_INT8)));
+			it.nextInBlock();
+		}
+	}
+
+	op.decoration = add_flag(op.decoration, InstructionDecorations::UNSIGNED_RESULT);
+	if(useRemainder)
+	{
+		//r = n - q * d
+		const Value product = method.addNewLocal(type, "%udiv.product");
+		if(divisorValue >= 256 && divisorValue < (1u << 24))
+		{
+			//the quotient is less than 2^24 too, so mul24 is sufficient
+			it.emplace(new Operation("mul24", product, quotient, divisor));
+			it.nextInBlock();
+		}
+		else
+		{
+			it.emplace(new Operation("mul", product, quotient, divisor));
+			it = intrinsifyUnsignedIntegerMultiplication(method, it, *it.get<Operation>());
+			it.nextInBlock();
+		}
+		op.opCode = "sub";
+		op.setArgument(0, numerator);
+		op.setArgument(1, product);
+	}
+	else
+	{
+		op.opCode = "or";
+		op.setArgument(0, quotient);
+		op.setArgument(1, quotient);
+	}
+	return it;
+}
+
 InstructionWalker intermediate::intrinsifyUnsignedIntegerDivision(Method& method, InstructionWalker it, Operation& op, const bool useRemainder)
 {
+	if(op.getSecondArg() && op.getSecondArg().get().hasType(ValueType::LITERAL) && op.getSecondArg().get().literal.integer != 0)
+	{
+		return intrinsifyUnsignedIntegerDivisionByConstant(method, it, op, useRemainder);
+	}
+
     //https://en.wikipedia.org/wiki/Division_algorithm#Integer_division_.28unsigned.29_with_remainder
 	//see also: https://www.microsoft.com/en-us/research/wp-content/uploads/2008/08/tr-2008-141.pdf
 	//TODO for |type| < 24, use floating-point division??
@@ -225,7 +386,7 @@ InstructionWalker intermediate::intrinsifyUnsignedIntegerDivision(Method& method
     const Value& numerator = op.getFirstArg();
     const Value& divisor = op.getSecondArg().orElse(UNDEFINED_VALUE);
     
-    logging::debug() << "Intrinsifying division of unsigned integers" << logging::endl;
+    DEBUG_LOG("Intrinsifying division of unsigned integers" << logging::endl);
     
     //TODO divisor = 0 handling!
     
@@ -299,92 +460,123 @@ InstructionWalker intermediate::intrinsifyUnsignedIntegerDivision(Method& method
     return it;
 }
 
-InstructionWalker intermediate::intrinsifyFloatingDivision(Method& method, InstructionWalker it, Operation& op)
+/*
+ * The number of Newton-Raphson steps to improve the accuracy of the SFU results with
+ */
+static unsigned getRefinementSteps(const MathType mathType)
+{
+	switch(mathType)
+	{
+		case MathType::FAST:
+			return 0;
+		case MathType::EXACT:
+			return 1;
+		case MathType::STRICT:
+			return 2;
+	}
+	return 2;
+}
+
+InstructionWalker intermediate::insertSFUFunction(Method& method, InstructionWalker it, const Register sfuReg, const Value& arg, const Value& dest, const MathType mathType)
 {
-    //TODO correct??
+	/*
+	 * The SFU results are only approximations (e.g. the GLSL compiler adds a Newton-Raphson step to the reciprocal,
+	 * see http://anholt.livejournal.com/49474.html), every Newton-Raphson step doubles the number of correct bits
+	 */
+	const unsigned numSteps = getRefinementSteps(mathType);
+	Value result = numSteps == 0 ? dest : method.addNewLocal(dest.type, "%sfu_result");
+	it = insertSFUCall(sfuReg, it, arg);
+	it.emplace(new MoveOperation(result, Value(REG_SFU_OUT, dest.type)));
+	it.nextInBlock();
 
+	for(unsigned step = 1; step <= numSteps; ++step)
+	{
+		const Value refined = step == numSteps ? dest : method.addNewLocal(dest.type, "%sfu_result");
+		const Value tmp0 = method.addNewLocal(dest.type, "%sfu_tmp");
+		const Value tmp1 = method.addNewLocal(dest.type, "%sfu_tmp");
+		if(sfuReg == REG_SFU_RECIP)
+		{
+			//x(i+1) = x(i) * (2 - a * x(i))
+			it.emplace(new Operation("fmul", tmp0, arg, result));
+			it.nextInBlock();
+			it.emplace(new Operation("fsub", tmp1, Value(Literal(2.0), TYPE_FLOAT), tmp0));
+			it.nextInBlock();
+			it.emplace(new Operation("fmul", refined, result, tmp1));
+			it.nextInBlock();
+		}
+		else if(sfuReg == REG_SFU_RECIP_SQRT)
+		{
+			//x(i+1) = x(i) * (1.5 - 0.5 * a * x(i)^2)
+			const Value tmp2 = method.addNewLocal(dest.type, "%sfu_tmp");
+			const Value tmp3 = method.addNewLocal(dest.type, "%sfu_tmp");
+			it.emplace(new Operation("fmul", tmp0, result, result));
+			it.nextInBlock();
+			it.emplace(new Operation("fmul", tmp1, arg, Value(Literal(0.5), TYPE_FLOAT)));
+			it.nextInBlock();
+			it.emplace(new Operation("fmul", tmp2, tmp0, tmp1));
+			it.nextInBlock();
+			it.emplace(new Operation("fsub", tmp3, Value(Literal(1.5), TYPE_FLOAT), tmp2));
+			it.nextInBlock();
+			it.emplace(new Operation("fmul", refined, result, tmp3));
+			it.nextInBlock();
+		}
+		else if(sfuReg == REG_SFU_EXP2)
+		{
+			//x(i+1) = x(i) * (1 + ln(2) * (a - log2(x(i))))
+			const Value tmp2 = method.addNewLocal(dest.type, "%sfu_tmp");
+			it = insertSFUCall(REG_SFU_LOG2, it, result);
+			it.emplace(new Operation("fsub", tmp0, arg, Value(REG_SFU_OUT, dest.type)));
+			it.nextInBlock();
+			it.emplace(new Operation("fmul", tmp1, tmp0, Value(Literal(M_LN2), TYPE_FLOAT)));
+			it.nextInBlock();
+			it.emplace(new Operation("fadd", tmp2, tmp1, FLOAT_ONE));
+			it.nextInBlock();
+			it.emplace(new Operation("fmul", refined, result, tmp2));
+			it.nextInBlock();
+		}
+		else if(sfuReg == REG_SFU_LOG2)
+		{
+			//x(i+1) = x(i) + (a * exp2(-x(i)) - 1) / ln(2)
+			const Value tmp2 = method.addNewLocal(dest.type, "%sfu_tmp");
+			const Value tmp3 = method.addNewLocal(dest.type, "%sfu_tmp");
+			it.emplace(new Operation("fsub", tmp0, FLOAT_ZERO, result));
+			it.nextInBlock();
+			it = insertSFUCall(REG_SFU_EXP2, it, tmp0);
+			it.emplace(new Operation("fmul", tmp1, arg, Value(REG_SFU_OUT, dest.type)));
+			it.nextInBlock();
+			it.emplace(new Operation("fsub", tmp2, tmp1, FLOAT_ONE));
+			it.nextInBlock();
+			it.emplace(new Operation("fmul", tmp3, tmp2, Value(Literal(M_LOG2E), TYPE_FLOAT)));
+			it.nextInBlock();
+			it.emplace(new Operation("fadd", refined, result, tmp3));
+			it.nextInBlock();
+		}
+		else
+			throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled SFU function", sfuReg.to_string(true));
+		result = refined;
+	}
+	return it;
+}
+
+InstructionWalker intermediate::intrinsifyFloatingDivision(Method& method, InstructionWalker it, Operation& op, const MathType mathType)
+{
     /*
      * https://dspace.mit.edu/bitstream/handle/1721.1/80133/43609668-MIT.pdf
      * https://en.wikipedia.org/wiki/Division_algorithm#Newton.E2.80.93Raphson_division
      * http://www.rfwireless-world.com/Tutorials/floating-point-tutorial.html
      */
-    logging::debug() << "Intrinsifying floating-point division" << logging::endl;
+    DEBUG_LOG("Intrinsifying floating-point division" << logging::endl);
     
     const Value nominator = op.getFirstArg();
     const Value divisor = op.getSecondArg();
     
-    ////
-    // Newton-Raphson
-    ////
-    //TODO: "The Newton-Raphson  algorithm [...] is commonly used if the result does not require proper rounding"
-    //-> use Goldschmidt??
-    
-    //1. initialization step: P0 = SFU_RECIP(D)
-    /*
-     * The GLSL shader uses the SFU_RECIP with a Newton-Raphson step "to improve our approximation",
-     * see http://anholt.livejournal.com/49474.html
-     */
-    const Value P0 = method.addNewLocal(op.getOutput().get().type, "%fdiv_recip");
-    insertSFUCall(REG_SFU_RECIP, it, divisor);
-    it.emplace(new MoveOperation(P0, Value(REG_SFU_OUT, TYPE_FLOAT)));
-    it.nextInBlock();
-    const Value const2(Literal(2.0), TYPE_FLOAT);
-    
-    //2. iteration step: Pi+1 = Pi(2 - D * Pi)
-    //run 5 iterations
-    const Value P1 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p1");
-    const Value P1_1 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p1");
-    const Value P1_2 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p1");
-    it.emplace( new Operation("fmul", P1, divisor, P0));
-    it.nextInBlock();
-    it.emplace( new Operation("fsub", P1_1, const2, P1));
-    it.nextInBlock();
-    it.emplace( new Operation("fmul", P1_2, P0, P1_1));
-    it.nextInBlock();
-    
-    const Value P2 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p2");
-    const Value P2_1 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p2");
-    const Value P2_2 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p2");
-    it.emplace( new Operation("fmul", P2, divisor, P1_2));
-    it.nextInBlock();
-    it.emplace( new Operation("fsub", P2_1, const2, P2));
-    it.nextInBlock();
-    it.emplace( new Operation("fmul", P2_2, P1_2, P2_1));
-    it.nextInBlock();
-    
-    const Value P3 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p3");
-    const Value P3_1 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p3");
-    const Value P3_2 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p3");
-    it.emplace( new Operation("fmul", P3, divisor, P2_2));
-    it.nextInBlock();
-    it.emplace( new Operation("fsub", P3_1, const2, P3));
-    it.nextInBlock();
-    it.emplace( new Operation("fmul", P3_2, P2_2, P3_1));
-    it.nextInBlock();
-    
-    const Value P4 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p4");
-    const Value P4_1 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p4");
-    const Value P4_2 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p4");
-    it.emplace( new Operation("fmul", P4, divisor, P3_2));
-    it.nextInBlock();
-    it.emplace( new Operation("fsub", P4_1, const2, P4));
-    it.nextInBlock();
-    it.emplace( new Operation("fmul", P4_2, P3_2, P4_1));
-    it.nextInBlock();
-    
-    const Value P5 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p5");
-    const Value P5_1 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p5");
-    const Value P5_2 = method.addNewLocal(op.getOutput().get().type, "%fdiv_p5");
-	it.emplace( new Operation("fmul", P5, divisor, P4_2));
-	it.nextInBlock();
-	it.emplace( new Operation("fsub", P5_1, const2, P5));
-	it.nextInBlock();
-	it.emplace( new Operation("fmul", P5_2, P4_2, P5_1));
-	it.nextInBlock();
+    //1. P = SFU_RECIP(D), improved with Newton-Raphson steps: Pi+1 = Pi(2 - D * Pi)
+    const Value reciprocal = method.addNewLocal(op.getOutput().get().type, "%fdiv_recip");
+    it = insertSFUFunction(method, it, REG_SFU_RECIP, divisor, reciprocal, mathType);
 
-    //3. final step: Q = Pn * N
+    //2. final step: Q = P * N
     op.setArgument(0, nominator);
-    op.setArgument(1, P5_2);
+    op.setArgument(1, reciprocal);
     op.opCode = "fmul";
     
     return it;
@@ -20,7 +20,13 @@ namespace vc4c
 		InstructionWalker intrinsifySignedIntegerDivision(Method& method, InstructionWalker it, Operation& op, const bool useRemainder = false);
 		InstructionWalker intrinsifyUnsignedIntegerDivision(Method& method, InstructionWalker it, Operation& op, const bool useRemainder = false);
 
-		InstructionWalker intrinsifyFloatingDivision(Method& method, InstructionWalker it, Operation& op);
+		InstructionWalker intrinsifyFloatingDivision(Method& method, InstructionWalker it, Operation& op, const MathType mathType);
+
+		/*
+		 * Calculates the SFU function (RECIP, RECIP_SQRT, EXP2 or LOG2) of the argument into the destination.
+		 * Depending on the math type, the SFU result is refined with up to 2 Newton-Raphson steps.
+		 */
+		InstructionWalker insertSFUFunction(Method& method, InstructionWalker it, const Register sfuReg, const Value& arg, const Value& dest, const MathType mathType);
 	}
 }
 
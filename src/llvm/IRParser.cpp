@@ -12,18 +12,25 @@
 
 #include "IRParser.h"
 #include "../intermediate/IntermediateInstruction.h"
-#include "log.h"
+#include "../Logging.h"
 #include "Token.h"
+#include "../BackgroundWorker.h"
 
 using namespace vc4c;
 using namespace vc4c::llvm2qasm;
 
-IRParser::IRParser(Scanner& scanner) : scanner(scanner), module(nullptr), currentMethod(nullptr)
+IRParser::IRParser(Scanner& scanner) : scanner(scanner), module(nullptr), currentMethod(nullptr), allocationsHoisted(false)
 {
 
 }
 
-IRParser::IRParser(std::istream& stream) : scanner(stream), module(nullptr), currentMethod(nullptr)
+IRParser::IRParser(std::istream& stream) : scanner(stream), module(nullptr), currentMethod(nullptr), allocationsHoisted(false)
+{
+
+}
+
+IRParser::IRParser(const IRParser& parent, const Scanner& bodyScanner) : scanner(bodyScanner), complexTypes(parent.complexTypes), module(parent.module),
+		currentMethod(nullptr), allocationsHoisted(true)
 {
 
 }
@@ -118,6 +125,9 @@ void IRParser::parse(Module& module)
         }
         parseMethod();
     }
+#ifdef MULTI_THREADED
+    parseMethodBodies();
+#endif
     //map meta-data to kernels
     extractKernelInfo();
 
@@ -242,9 +252,7 @@ DataType IRParser::parseType()
     DataType type = TYPE_UNKNOWN;
     if(isArray)
     {
-    	type.num = 1;
-    	type.complexType.reset(new ArrayType{childType, num});
-    	type.typeName = (childType.to_string() + "[") + std::to_string(num) +"]";
+    	type = module->types.getArrayType(childType, num);
     }
     else if(isVector)
     {
@@ -258,8 +266,7 @@ DataType IRParser::parseType()
     for(unsigned i = 0; i < numPointerTypes; ++i)
     {
     	//wrap in pointer type
-    	std::shared_ptr<ComplexType> elementType(new PointerType(type, addressSpace.hasValue ? addressSpace.get() : AddressSpace::PRIVATE));
-    	type = DataType(type.to_string() + "*", 1, elementType);
+    	type = module->types.getPointerType(type, addressSpace.hasValue ? addressSpace.get() : AddressSpace::PRIVATE);
     }
     return type;
 }
@@ -305,18 +312,20 @@ std::vector<std::pair<Value, ParameterDecorations>> IRParser::parseParameters()
             if(!scanner.peek().isEnd() && (scanner.peek().hasValue('<') || scanner.peek().hasValue('%') || scanner.peek().type != TokenType::STRING))
             {
             	const Value arg = parseValue(false, type);
-            	logging::debug() << "Parameter " << arg.to_string() << logging::endl;
+            	DEBUG_LOG("Parameter " << arg.to_string() << logging::endl);
 				res.push_back(std::make_pair(arg, decorations));
             }
             else	//TODO correct??
             {
             	//as of CLang 3.9, parameters seem to not (always) have explicit names anymore
 				//if this is the case, assign the number of the parameter
+				const std::string parameterName = std::string("%") + std::to_string(res.size());
 				if (nextToken.type == TokenType::STRING && !nextToken.hasValue('%')) {
 					nextToken.type = TokenType::STRING;
-					strncpy(nextToken.text, (std::string("%") + std::to_string(res.size())).data(), TOKEN_BUFFER_SIZE);
+					nextToken.text = parameterName.data();
+					nextToken.length = parameterName.size();
 				}
-				logging::debug() << "Parameter " << type.to_string() << ' ' << nextToken.to_string() << logging::endl;
+				DEBUG_LOG("Parameter " << type.to_string() << ' ' << nextToken.to_string() << logging::endl);
 				res.push_back(std::make_pair(toValue(nextToken, type), decorations));
             }
         }
@@ -432,8 +441,8 @@ DataType IRParser::parseStructDefinition()
         //pop '>'
         scanner.pop();
     }
-    logging::debug() << "Struct type: " << type.to_string() << (type.getStructType().get()->isPacked ? " (packed)" : "") << logging::endl;
-    logging::debug() << "with elements: " << to_string<DataType>(type.getStructType().get()->elementTypes) << logging::endl;
+    DEBUG_LOG("Struct type: " << type.to_string() << (type.getStructType().get()->isPacked ? " (packed)" : "") << logging::endl);
+    DEBUG_LOG("with elements: " << to_string<DataType>(type.getStructType().get()->elementTypes) << logging::endl);
     return type;
 }
 
@@ -484,7 +493,7 @@ bool IRParser::parseGlobalData()
     else
     	val = parseValue();
 
-    logging::debug() << "Reading global data '" << name << "' with " << val.to_string(false, true) << logging::endl;
+    DEBUG_LOG("Reading global data '" << name << "' with " << val.to_string(false, true) << logging::endl);
     //store local + value
     module->globalData.push_back(Global(name, val.type.toPointerType(), val));
     return true;
@@ -494,7 +503,7 @@ bool IRParser::parseMethod()
 {
 	//define [linkage] [visibility] [DLLStorageClass] [cconv] [ret attrs] <ResultType> @<FunctionName> ([argument list]) [(unnamed_addr|local_unnamed_addr)] [fn Attrs] [section "name"]
 	bool isKernelSet = false;
-    logging::debug() << "-----" << logging::endl;
+    DEBUG_LOG("-----" << logging::endl);
     skipLinkage(scanner);
     skipVisibility(scanner);
     //skip keywords
@@ -504,7 +513,7 @@ bool IRParser::parseMethod()
     }
     const DataType returnType(parseType());
     const std::string methodName(cleanMethodName(scanner.pop().getText()));
-    logging::debug() << "Reading method '" << methodName << "' -> " << returnType.to_string() << ':' << logging::endl;
+    DEBUG_LOG("Reading method '" << methodName << "' -> " << returnType.to_string() << ':' << logging::endl);
     methods.push_back(LLVMMethod(*module));
     auto& method = methods.back();
     method.method->name = methodName;
@@ -514,7 +523,7 @@ bool IRParser::parseMethod()
     for (const auto& param : params) {
     	method.method->parameters.emplace_back(std::move(Parameter(param.first.local->name, param.first.type, param.second)));
     	//since with creating the Value for the parameter, a new local is allocated, we need to remove it
-    	const_cast<OrderedMap<std::string, Local>&>(method.method->readLocals()).erase(param.first.local->name);
+    	method.method->removeLocal(param.first.local->name);
     }
     if (!scanner.hasInput()) {
         return false;
@@ -573,18 +582,24 @@ bool IRParser::parseMethod()
     while (scanner.peek().type == TokenType::END) {
         scanner.pop();
     }
-    logging::debug() << "-----" << logging::endl;
+#ifdef MULTI_THREADED
+    //the body is parsed later, in parallel with the bodies of all other methods
+    methodBodies.emplace_back(methods.size() - 1, scanner);
+    skipMethodBody(method);
+#else
+    DEBUG_LOG("-----" << logging::endl);
     parseMethodBody(method);
-    logging::debug() << "-----" << logging::endl;
+    DEBUG_LOG("-----" << logging::endl);
     mapInstructions(method);
-    logging::debug() << "-----" << logging::endl;
+    DEBUG_LOG("-----" << logging::endl);
+#endif
 
     return true;
 }
 
 void IRParser::parseMethodBody(LLVMMethod& method)
 {
-    logging::debug() << "Reading method body: " << logging::endl;
+    DEBUG_LOG("Reading method body: " << logging::endl);
     //    //add label %0 to the beginning of the method
     //    //as of CLang 3.9, the first parameter can have the name %0
     //    if(method.method.findParameter(LocalRef("%0")) == nullptr)
@@ -599,7 +614,55 @@ void IRParser::parseMethodBody(LLVMMethod& method)
     //pop '}'
     scanner.pop();
 
-    logging::debug() << "Done, " << method.instructions.size() << " instructions" << logging::endl;
+    DEBUG_LOG("Done, " << method.instructions.size() << " instructions" << logging::endl);
+}
+
+void IRParser::skipMethodBody(LLVMMethod& method)
+{
+	//only the allocations are handled here, since they modify the global data of the module
+    do {
+        const Token nextToken = scanner.pop();
+        if (nextToken.isEnd()) {
+            continue;
+        }
+        if (nextToken.hasValue('%') && scanner.peek().hasValue('=')) {
+            //pop '='
+            scanner.pop();
+            if (scanner.peek().hasValue("alloca")) {
+                scanner.pop();
+                parseAllocation(method, nextToken.getText());
+            }
+        }
+        //skip to end of line
+        while (!scanner.peek().isEnd()) {
+            scanner.pop();
+        }
+    }
+    while (scanner.hasInput() && !scanner.peek().hasValue('}'));
+    //pop '}'
+    scanner.pop();
+}
+
+void IRParser::parseMethodBodies()
+{
+	//all types and global data are known at this point, so the method-bodies can be parsed independent of each other
+	std::vector<threading::BackgroundWorker> workers;
+	workers.reserve(methodBodies.size());
+	for(const auto& body : methodBodies)
+	{
+		LLVMMethod& method = methods.at(body.first);
+		const Scanner& bodyScanner = body.second;
+		auto f = [this, &method, &bodyScanner]() -> void
+		{
+			IRParser bodyParser(*this, bodyScanner);
+			bodyParser.currentMethod = method.method.get();
+			bodyParser.parseMethodBody(method);
+			bodyParser.mapInstructions(method);
+		};
+		workers.emplace(workers.end(), f, "IRParser")->operator ()();
+	}
+	threading::BackgroundWorker::waitForAll(workers);
+	methodBodies.clear();
 }
 
 LLVMInstruction* IRParser::parseInstruction(LLVMMethod& method)
@@ -774,18 +837,8 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
     Token nextToken = scanner.pop();
 
     if (nextToken.hasValue("alloca")) {
-        //<result> = alloca [inalloca] <type> [, <ty> <NumElements>] [, align <alignment>]
-        //allocation -> determine type
-        nextToken = scanner.peek();
-        if (nextToken.hasValue("inalloca")) {
-            scanner.pop();
-            nextToken = scanner.peek();
-        }
-        DataType type(parseType());
-        logging::debug() << "Allocate " << type.to_string() << " for " << destination << logging::endl;
-        //TODO for scalar or vector types, lower into local, possible??
-        //lift into global, same as SPIR-V OpVariable
-        method.module->globalData.push_back(Global(destination, type.toPointerType(), Value(type)));
+        if (!allocationsHoisted)
+            parseAllocation(method, destination);
         return nullptr;
     }
     else if (nextToken.hasValue("bitcast")) {
@@ -799,7 +852,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
         scanner.pop();
 
         const DataType destType(parseType());
-        logging::debug() << "Making reference from bitcast " << type.to_string() << " from " << source << " to " << destType.to_string() << ' ' << destination << logging::endl;
+        DEBUG_LOG("Making reference from bitcast " << type.to_string() << " from " << source << " to " << destType.to_string() << ' ' << destination << logging::endl);
         //simply associate new and original
         Value ref = method.method->findOrCreateLocal(type, source)->createReference();
         return new Copy(method.method->findOrCreateLocal(destType, destination), ref);
@@ -867,7 +920,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
         	const std::string sourceName(scanner.pop().getText());
         	src = method.method->findOrCreateLocal(sourceType, sourceName)->createReference();
         }
-        logging::debug() << "Copying by loading of " << type.to_string() << " from " << src.to_string() << " into " << destination << logging::endl;
+        DEBUG_LOG("Copying by loading of " << type.to_string() << " from " << src.to_string() << " into " << destination << logging::endl);
 
         Value srcIndex(TYPE_UNKNOWN);
         Value srcContainer(TYPE_UNKNOWN);
@@ -972,7 +1025,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
             args.push_back(pair.first);
         });
         name = cleanMethodNameParameters(name, args);
-        logging::debug() << "Method call to " << name << " storing " << returnType.to_string() << " into " << destination << logging::endl;
+        DEBUG_LOG("Method call to " << name << " storing " << returnType.to_string() << " into " << destination << logging::endl);
         method.method->findOrCreateLocal(returnType, destination);
         return (new CallSite(method.method->findOrCreateLocal(returnType, destination), name, returnType, args))->setDecorations(decorations);
 
@@ -1007,7 +1060,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
 
         const Value dest(method.method->findOrCreateLocal(elementType, destination)->createReference());
         const Value src = method.method->findOrCreateLocal(type, var)->createReference();
-        logging::debug() << "Getting " << elementType.to_string() << " " << to_string<Value>(indices) << " from " << src.to_string() << " into " << dest.to_string(true) << logging::endl;
+        DEBUG_LOG("Getting " << elementType.to_string() << " " << to_string<Value>(indices) << " from " << src.to_string() << " into " << dest.to_string(true) << logging::endl);
         return new IndexOf(dest.local, src, indices);
     }
     else if (nextToken.hasValue("icmp") || nextToken.hasValue("fcmp")) {
@@ -1024,7 +1077,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
         scanner.pop();
         const Value op2(parseValue(false, op1.type));
 
-        logging::debug() << "Comparison " << flag << " between " << op1.to_string() << " and " << op2.to_string() << " into " << destination << logging::endl;
+        DEBUG_LOG("Comparison " << flag << " between " << op1.to_string() << " and " << op2.to_string() << " into " << destination << logging::endl);
         return (new Comparison(method.method->findOrCreateLocal(TYPE_BOOL, destination), flag, op1, op2, nextToken.hasValue("fcmp")))->setDecorations(decorations);
     }
     else if (nextToken.hasValue("insertelement") || nextToken.hasValue("insertvalue")) {
@@ -1043,7 +1096,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
 		else
 			index = parseValue();
 
-        logging::debug() << "Setting container element " << index.to_string() << " of " << container.to_string() << " to " << newValue.to_string() << logging::endl;
+        DEBUG_LOG("Setting container element " << index.to_string() << " of " << container.to_string() << " to " << newValue.to_string() << logging::endl);
         return new ContainerInsertion(method.method->findOrCreateLocal(container.type, destination), container, newValue, index);
     }
     else if (nextToken.hasValue("extractelement") || nextToken.hasValue("extractvalue")) {
@@ -1059,7 +1112,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
         else
         	index = parseValue();
 
-        logging::debug() << "Reading container element " << index.to_string() << " of " << container.to_string() << " into " << destination << logging::endl;
+        DEBUG_LOG("Reading container element " << index.to_string() << " of " << container.to_string() << " into " << destination << logging::endl);
         //TODO still correct after removal of index?
         //TODO extra operation required or is reference enough??
         return new ContainerExtraction(method.method->findOrCreateLocal(container.type.getElementType(), destination), container, index);
@@ -1075,8 +1128,8 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
         //mask is in value, e.g. "<i32 0, i32 2>"
         const Value shuffleMask = parseValue();
 
-        logging::debug() << "Shuffling vectors " << container1.to_string() << " and " << container2.to_string()
-                << " with mask " << shuffleMask.to_string() << " into " << destination << logging::endl;
+        DEBUG_LOG("Shuffling vectors " << container1.to_string() << " and " << container2.to_string()
+                << " with mask " << shuffleMask.to_string() << " into " << destination << logging::endl);
 
         DataType resultType = container1.type;
         resultType.num = shuffleMask.type.num;
@@ -1100,7 +1153,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
             labels.emplace_back(val, method.method->findOrCreateLocal(TYPE_LABEL, label));
         }
         while (scanner.peek().hasValue(','));
-        logging::debug() << "Phi-Node into " << destination << logging::endl;
+        DEBUG_LOG("Phi-Node into " << destination << logging::endl);
         return new PhiNode(method.method->findOrCreateLocal(type, destination), labels);
     }
     else if (nextToken.hasValue("select")) {
@@ -1114,7 +1167,7 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
         scanner.pop();
         const Value val2(parseValue());
 
-        logging::debug() << "Selection of " << val1.to_string() << " or " << val2.to_string() << " according to " << cond.to_string() << " into " << destination << logging::endl;
+        DEBUG_LOG("Selection of " << val1.to_string() << " or " << val2.to_string() << " according to " << cond.to_string() << " into " << destination << logging::endl);
         return new Selection(method.method->findOrCreateLocal(val1.type, destination), cond, val1, val2);
     }
     else {
@@ -1142,25 +1195,39 @@ LLVMInstruction* IRParser::parseAssignment(LLVMMethod& method, const Token& dest
             if (isConversion)
             {
             	const DataType destType = parseType();
-                logging::debug() << "Convert (" << opCode << ") " << arg1.to_string() << " to " << destType.to_string() << ' ' << destination << logging::endl;
+                DEBUG_LOG("Convert (" << opCode << ") " << arg1.to_string() << " to " << destType.to_string() << ' ' << destination << logging::endl);
                 return (new UnaryOperator(opCode, method.method->findOrCreateLocal(destType, destination)->createReference(), arg1))->setDecorations(decorations);
 
             }
             else
             {
             	const Value arg2 = parseValue(false, type);
-                logging::debug() << "Binary-Operator " << opCode << " with " << arg1.to_string() << " and " << arg2.to_string() << " into " << destination << logging::endl;
+                DEBUG_LOG("Binary-Operator " << opCode << " with " << arg1.to_string() << " and " << arg2.to_string() << " into " << destination << logging::endl);
                 return (new BinaryOperator(opCode, method.method->findOrCreateLocal(type, destination), arg1, arg2))->setDecorations(decorations);
             }
         }
         else {
             //unary instruction
-            logging::debug() << "Unary-Operator " << opCode << " with " << type.to_string() << ' ' << arg1.to_string() << " into " << destination << logging::endl;
+            DEBUG_LOG("Unary-Operator " << opCode << " with " << type.to_string() << ' ' << arg1.to_string() << " into " << destination << logging::endl);
             return (new UnaryOperator(opCode, method.method->findOrCreateLocal(type, destination)->createReference(), arg1))->setDecorations(decorations);
         }
     }
 }
 
+void IRParser::parseAllocation(LLVMMethod& method, const std::string& destination)
+{
+    //<result> = alloca [inalloca] <type> [, <ty> <NumElements>] [, align <alignment>]
+    //allocation -> determine type
+    if (scanner.peek().hasValue("inalloca")) {
+        scanner.pop();
+    }
+    DataType type(parseType());
+    DEBUG_LOG("Allocate " << type.to_string() << " for " << destination << logging::endl);
+    //TODO for scalar or vector types, lower into local, possible??
+    //lift into global, same as SPIR-V OpVariable
+    method.module->globalData.push_back(Global(destination, type.toPointerType(), Value(type)));
+}
+
 LLVMInstruction* IRParser::parseMethodCall(LLVMMethod& method)
 {
 	if(scanner.peek().hasValue("spir_func"))
@@ -1177,7 +1244,7 @@ LLVMInstruction* IRParser::parseMethodCall(LLVMMethod& method)
         args.push_back(pair.first);
     });
     name = cleanMethodNameParameters(name, args);
-    logging::debug() << "Method call to " << name << " -> " << returnType.to_string() << logging::endl;
+    DEBUG_LOG("Method call to " << name << " -> " << returnType.to_string() << logging::endl);
     return new CallSite(name, returnType, args);
 }
 
@@ -1196,7 +1263,7 @@ LLVMInstruction* IRParser::parseStore(LLVMMethod& method)
     Value destination(parseValue());
 
     //TODO overhaul, fix, remove destIndex, destContainer
-    logging::debug() << "Copying by storing " << value.to_string() << " into " << destination.to_string() << logging::endl;
+    DEBUG_LOG("Copying by storing " << value.to_string() << " into " << destination.to_string() << logging::endl);
     Value destIndex(UNDEFINED_VALUE);
     Value destContainer(UNDEFINED_VALUE);
     //check whether write to out-parameter
@@ -1268,7 +1335,7 @@ LLVMInstruction* IRParser::parseBranch(LLVMMethod& method)
         //unconditional branch
         const std::string label(scanner.pop().getText());
 
-        logging::debug() << "Unconditional branch to " << label << logging::endl;
+        DEBUG_LOG("Unconditional branch to " << label << logging::endl);
         return new Branch(label);
     }
     else {
@@ -1285,7 +1352,7 @@ LLVMInstruction* IRParser::parseBranch(LLVMMethod& method)
         scanner.pop();
         const std::string falseLabel(scanner.pop().getText());
 
-        logging::debug() << "Branch when " << cond.to_string() << " to either " << trueLabel << " or " << falseLabel << logging::endl;
+        DEBUG_LOG("Branch when " << cond.to_string() << " to either " << trueLabel << " or " << falseLabel << logging::endl);
         return new Branch(cond, trueLabel, falseLabel);
     }
 }
@@ -1295,7 +1362,7 @@ LLVMInstruction* IRParser::parseReturn(LLVMMethod& method)
     const DataType type(parseType());
     const Token value = scanner.peek();
 
-    logging::debug() << "Returning " << type.to_string() << ' ' << value.to_string() << logging::endl;
+    DEBUG_LOG("Returning " << type.to_string() << ' ' << value.to_string() << logging::endl);
     if (!value.isEnd()) {
         scanner.pop();
         return new ValueReturn(toValue(value, type));
@@ -1314,7 +1381,7 @@ LLVMInstruction* IRParser::parseLabel(LLVMMethod& method, const Token& label)
     //trunc trailing comment
     labelName = labelName.substr(0, labelName.find("  "));
     labelName = std::string("%") + labelName;
-    logging::debug() << "Setting label " << labelName << logging::endl;
+    DEBUG_LOG("Setting label " << labelName << logging::endl);
     return new LLVMLabel(labelName);
 }
 
@@ -1347,7 +1414,7 @@ LLVMInstruction* IRParser::parseSwitch(LLVMMethod& method)
     }
     while (!scanner.peek().hasValue(']'));
 
-    logging::debug() << "Switching on " << cond.to_string() << " with " << cases.size() << " labels, defaulting to " << defaultLabel << logging::endl;
+    DEBUG_LOG("Switching on " << cond.to_string() << " with " << cases.size() << " labels, defaulting to " << defaultLabel << logging::endl);
     return new Switch(cond, defaultLabel, cases);
 }
 
@@ -1416,7 +1483,7 @@ void IRParser::extractKernelInfo()
     	}
     	for(const std::string& extension : extensions)
     	{
-    		logging::debug() << "Using OpenCL extension: " << extension << logging::endl;
+    		DEBUG_LOG("Using OpenCL extension: " << extension << logging::endl);
     		bool extensionFound = false;
     		for(const std::string& supportedExtension : supportedOpenCLExtensions)
     		{
@@ -1439,7 +1506,7 @@ void IRParser::extractKernelInfo()
 		}
 		for(const std::string& feature : features)
 		{
-			logging::debug() << "Using optional OpenCL core-feature: " << feature << logging::endl;
+			DEBUG_LOG("Using optional OpenCL core-feature: " << feature << logging::endl);
 			bool featureFound = true;
 			for(const std::string& supportedFeature : supportedOpenCLOptionalCoreFeatures)
 			{
@@ -1528,9 +1595,10 @@ void IRParser::extractKernelInfo()
 
 void IRParser::mapInstructions(LLVMMethod& method) const
 {
-    logging::debug() << "Mapping LLVM instructions to immediates: " << logging::endl;
+    DEBUG_LOG("Mapping LLVM instructions to immediates: " << logging::endl);
+    intermediate::InstructionArena::Scope arenaScope(method.method->getInstructionArena());
     for (const auto& instr : method.instructions) {
         instr->mapInstruction(*method.method);
     }
-    logging::debug() << "Done, generated " << method.method->countInstructions() << " immediate instructions from " << method.instructions.size() << " LLVM instructions" << logging::endl;
+    DEBUG_LOG("Done, generated " << method.method->countInstructions() << " immediate instructions from " << method.instructions.size() << " LLVM instructions" << logging::endl);
 }
@@ -41,8 +41,15 @@ namespace vc4c
 			void parse(Module& module) override;
 
 		private:
+			/*
+			 * Creates a parser for a single method-body, sharing the module and types of the parent
+			 */
+			IRParser(const IRParser& parent, const Scanner& bodyScanner);
+
 			Scanner scanner;
 			std::vector<LLVMMethod> methods;
+			//the scanners positioned at the start of the bodies of the methods with the given index, to be parsed in parallel
+			std::vector<std::pair<std::size_t, Scanner>> methodBodies;
 			std::vector<std::string> kernelIDs;
 			std::vector<std::string> kernelNames;
 			FastMap<std::string, std::vector<std::string>> metaData;
@@ -50,6 +57,8 @@ namespace vc4c
 
 			Module* module;
 			Method* currentMethod;
+			//whether the allocations were already lifted into globals while skipping the method-bodies
+			bool allocationsHoisted;
 
 			DataType parseType();
 			std::vector<std::pair<Value, ParameterDecorations>> parseParameters();
@@ -62,9 +71,12 @@ namespace vc4c
 			bool parseMethod();
 
 			void parseMethodBody(LLVMMethod& method);
+			void skipMethodBody(LLVMMethod& method);
+			void parseMethodBodies();
 
 			LLVMInstruction* parseInstruction(LLVMMethod& method);
 			LLVMInstruction* parseAssignment(LLVMMethod& method, const Token& dest);
+			void parseAllocation(LLVMMethod& method, const std::string& destination);
 			LLVMInstruction* parseMethodCall(LLVMMethod& method);
 			LLVMInstruction* parseStore(LLVMMethod& method);
 			LLVMInstruction* parseBranch(LLVMMethod& method);
@@ -11,7 +11,7 @@
 #include "../intermediate/IntermediateInstruction.h"
 #include "../intermediate/Helper.h"
 #include "../periphery/VPM.h"
-#include "log.h"
+#include "../Logging.h"
 
 using namespace vc4c;
 using namespace vc4c::llvm2qasm;
@@ -120,14 +120,14 @@ bool CallSite::mapInstruction(Method& method) const
     //remove calls to @llvm.lifetime.start / @llvm.lifetime.end
     if(methodName.compare("llvm.lifetime.start") == 0 || methodName.compare("llvm.lifetime.end") == 0)
     {
-        logging::debug() << "Dropping intrinsic method call to " << methodName << logging::endl;
+        DEBUG_LOG("Dropping intrinsic method call to " << methodName << logging::endl);
         return true;
     }
     const Value output = dest == nullptr ? NOP_REGISTER : Value(dest, returnType);
     //handle other llvm.* intrinsics
     if(methodName.compare("llvm.fmuladd.f32") == 0)
     {
-    	logging::debug() << "Converting intrinsic method call '" << methodName << "' to operations" << logging::endl;
+    	DEBUG_LOG("Converting intrinsic method call '" << methodName << "' to operations" << logging::endl);
     	const Value tmp = method.addNewLocal(returnType, "%fmuladd");
     	method.appendToEnd(new intermediate::Operation("fmul", tmp, arguments.at(0), arguments.at(1)));
     	method.appendToEnd(new intermediate::Operation("fadd", output, tmp, arguments.at(2)));
@@ -137,30 +137,18 @@ bool CallSite::mapInstruction(Method& method) const
     {
     	//FIXME for now skip unsupported case, since errors here seem to crash the test-runner, but errors later on dont??
     	//@llvm.memcpy.p0i8.p0i8.i32(i8* <dest>, i8* <src>, i32 <len>, i32 <align>, i1 <isvolatile>)
-    	logging::debug() << "Intrinsifying llvm.memcpy function-call" << logging::endl;
-    	method.vpm->insertCopyRAM(method, method.appendToEnd(), arguments.at(0), arguments.at(1), arguments.at(2).literal.integer, true);
+    	DEBUG_LOG("Intrinsifying llvm.memcpy function-call" << logging::endl);
+    	method.vpm->insertCopyRAM(method, method.appendToEnd(), arguments.at(0), arguments.at(1), static_cast<unsigned>(arguments.at(2).literal.integer), true);
     	return true;
     }
     if(methodName.find("llvm.memset") == 0 && arguments.at(2).hasType(ValueType::LITERAL))
 	{
 		//declare void @llvm.memset.p0i8.i32(i8* <dest>, i8 <val>, i32|i64 <len>, i32 <align>, i1 <isvolatile>)
-		logging::debug() << "Intrinsifying llvm.memset with DMA writes" << logging::endl;
-		const Value& memAddr = arguments.at(0);
-		const Value& fillByte = arguments.at(1);
-		const Value& numBytes = arguments.at(2);
-		const Value& volatileAccess = arguments.at(4);
-		method.appendToEnd(new intermediate::MoveOperation(NOP_REGISTER, MUTEX_REGISTER));
-		method.vpm->insertWriteVPM(method.appendToEnd(), fillByte, false);
-		//TODO could be optimized, write multiple bytes at once
-		for(long i = 0; i < numBytes.literal.integer; ++i)
-		{
-			const Value tmp = method.addNewLocal(memAddr.type, "%memset_offset");
-			method.appendToEnd(new intermediate::Operation("add", tmp, memAddr, Value(Literal(i), TYPE_INT32)));
-			method.vpm->insertWriteRAM(method.appendToEnd(), tmp, TYPE_INT8, false);
-		}
-		method.appendToEnd( new intermediate::MoveOperation(MUTEX_REGISTER, BOOL_TRUE));
+		DEBUG_LOG("Intrinsifying llvm.memset with DMA writes" << logging::endl);
+		method.vpm->insertFillRAM(method, method.appendToEnd(), arguments.at(0), arguments.at(1), static_cast<unsigned>(arguments.at(2).literal.integer), true);
+		return true;
 	}
-    logging::debug() << "Generating immediate call to " << methodName << " -> " << returnType.to_string() << logging::endl;
+    DEBUG_LOG("Generating immediate call to " << methodName << " -> " << returnType.to_string() << logging::endl);
     if(dest == nullptr)
     	method.appendToEnd((new intermediate::MethodCall(methodName, arguments))->setDecorations(decorations));
     else
@@ -208,18 +196,18 @@ bool Copy::mapInstruction(Method& method) const
     {
         if(isRead)
         {
-            logging::debug() << "Generating reading of " << orig.to_string() << " from index " << index.to_string() << " into " << dest->to_string() << logging::endl;
+            DEBUG_LOG("Generating reading of " << orig.to_string() << " from index " << index.to_string() << " into " << dest->to_string() << logging::endl);
             periphery::insertReadDMA(method, method.appendToEnd(), Value(dest, orig.type), index);
         }
         else
         {
-            logging::debug() << "Generating writing of " << orig.to_string() << " into " << index.to_string() << logging::endl;
+            DEBUG_LOG("Generating writing of " << orig.to_string() << " into " << index.to_string() << logging::endl);
             periphery::insertWriteDMA(method, method.appendToEnd(), orig, index);
         }
     }
     else
     {
-        logging::debug() << "Generating copy of " << orig.to_string() << " into " << dest->name << logging::endl;
+        DEBUG_LOG("Generating copy of " << orig.to_string() << " into " << dest->name << logging::endl);
         method.appendToEnd(new intermediate::MoveOperation(Value(dest, orig.type), orig));
     }
     return true;
@@ -256,7 +244,7 @@ std::vector<const Local*> UnaryOperator::getAllLocals() const
 
 bool UnaryOperator::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating unary operation " << opCode << " with " << arg.to_string() << " into " << dest.to_string() << logging::endl;
+    DEBUG_LOG("Generating unary operation " << opCode << " with " << arg.to_string() << " into " << dest.to_string() << logging::endl);
     method.appendToEnd((new intermediate::Operation(opCode, dest, arg))->setDecorations(decorations));
     return true;
 }
@@ -284,7 +272,7 @@ std::vector<const Local*> BinaryOperator::getAllLocals() const
 
 bool BinaryOperator::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating binary operation " << opCode << " with " << arg.to_string() << " and " << arg2.to_string() << " into " << dest.to_string() <<logging::endl;
+    DEBUG_LOG("Generating binary operation " << opCode << " with " << arg.to_string() << " and " << arg2.to_string() << " into " << dest.to_string() <<logging::endl);
     method.appendToEnd((new intermediate::Operation(opCode, dest, arg, arg2))->setDecorations(decorations));
     return true;
 }
@@ -321,7 +309,7 @@ bool IndexOf::mapInstruction(Method& method) const
 {
     //need to get pointer/address -> reference to content
     //a[i] of type t is at position &a + i * sizeof(t)
-    logging::debug() << "Generating calculating index " << to_string<Value>(indices) << " of " << container.to_string() << " into " << dest->to_string() << logging::endl;
+    DEBUG_LOG("Generating calculating index " << to_string<Value>(indices) << " of " << container.to_string() << " into " << dest->to_string() << logging::endl);
     
     //TODO firstIndexIsElement is not true for all cases!! (E.g. not for pointers to pointers?)
     intermediate::insertCalculateIndices(method.appendToEnd(), method, container, dest->createReference(), indices, true);
@@ -365,7 +353,7 @@ std::vector<const Local*> Comparison::getAllLocals() const
 
 bool Comparison::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating comparison " << comp << " with " << op1.to_string() << " and " << op2.to_string() << " into " << dest->name << logging::endl;
+    DEBUG_LOG("Generating comparison " << comp << " with " << op1.to_string() << " and " << op2.to_string() << " into " << dest->name << logging::endl);
     method.appendToEnd((new intermediate::Comparison(comp, Value(dest, TYPE_BOOL), op1, op2))->setDecorations(decorations));
     return true;
 }
@@ -404,7 +392,7 @@ std::vector<const Local*> ContainerInsertion::getAllLocals() const
 
 bool ContainerInsertion::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating insertion of " << newValue.to_string() << " at " << index.to_string() << " into " << container.to_string() << " into " << dest->to_string() << logging::endl;
+    DEBUG_LOG("Generating insertion of " << newValue.to_string() << " at " << index.to_string() << " into " << container.to_string() << " into " << dest->to_string() << logging::endl);
     //1. copy whole container
     method.appendToEnd(new intermediate::MoveOperation(Value(dest, container.type), container));
     //2. insert new element
@@ -455,7 +443,7 @@ std::vector<const Local*> ContainerExtraction::getAllLocals() const
 bool ContainerExtraction::mapInstruction(Method& method) const
 {
     const DataType elementType = container.type.getElementType();
-    logging::debug() << "Generation extraction of " << elementType.to_string() << " at " << index.to_string() << " from " << container.to_string() << " into " << dest->to_string() << logging::endl;
+    DEBUG_LOG("Generation extraction of " << elementType.to_string() << " at " << index.to_string() << " from " << container.to_string() << " into " << dest->to_string() << logging::endl);
     
     if(container.type.isVectorType() || index.hasLiteral(Literal(0L)))
     {
@@ -498,12 +486,12 @@ bool ValueReturn::mapInstruction(Method& method) const
 {
     if(hasValue)
     {
-        logging::debug() << "Generating return of " << val.to_string() << logging::endl;
+        DEBUG_LOG("Generating return of " << val.to_string() << logging::endl);
         method.appendToEnd(new intermediate::Return(val));
     }
     else
     {
-        logging::debug() << "Generating return nothing" << logging::endl;
+        DEBUG_LOG("Generating return nothing" << logging::endl);
         method.appendToEnd(new intermediate::Return());
     }
     return true;
@@ -543,7 +531,7 @@ std::vector<const Local*> ShuffleVector::getAllLocals() const
 bool ShuffleVector::mapInstruction(Method& method) const
 {
     //shuffling = iteration over all elements in both vectors and re-ordering in order given
-    logging::debug() << "Generating operations mixing " << v1.to_string() << " and " << v2.to_string() << " into " << dest->name << logging::endl;
+    DEBUG_LOG("Generating operations mixing " << v1.to_string() << " and " << v2.to_string() << " into " << dest->name << logging::endl);
     DataType destType = v1.type;
     destType.num = mask.type.num;
     intermediate::insertVectorShuffle(method.appendToEnd(), method, Value(dest, destType), v1, v2, mask);
@@ -562,7 +550,7 @@ LLVMLabel::~LLVMLabel()
 
 bool LLVMLabel::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating label " << label << logging::endl;
+    DEBUG_LOG("Generating label " << label << logging::endl);
     method.appendToEnd(new intermediate::BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, label)));
     return true;
 }
@@ -595,7 +583,7 @@ std::vector<const Local*> PhiNode::getAllLocals() const
 
 bool PhiNode::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating Phi-Node with " << labels.size() << " options into " << dest->to_string() << logging::endl;
+    DEBUG_LOG("Generating Phi-Node with " << labels.size() << " options into " << dest->to_string() << logging::endl);
     method.appendToEnd(new intermediate::PhiNode(dest->createReference(), labels));
     return true;
 }
@@ -629,7 +617,7 @@ std::vector<const Local*> Selection::getAllLocals() const
 
 bool Selection::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating moves for selection " << opt1.to_string() << " or " << opt2.to_string() << " according to " << cond.to_string() << logging::endl;
+    DEBUG_LOG("Generating moves for selection " << opt1.to_string() << " or " << opt2.to_string() << " according to " << cond.to_string() << logging::endl);
     //if cond == 1 -> first else second
     //makes sure, the flags are set for the correction value
     method.appendToEnd(new intermediate::MoveOperation(NOP_REGISTER, cond, COND_ALWAYS, SetFlag::SET_FLAGS));
@@ -663,7 +651,7 @@ std::vector<const Local*> Branch::getAllLocals() const
 
 bool Branch::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating branch on condition " << cond.to_string() << " to either " << thenLabel << " or " << elseLabel << logging::endl;
+    DEBUG_LOG("Generating branch on condition " << cond.to_string() << " to either " << thenLabel << " or " << elseLabel << logging::endl);
     method.appendToEnd(new intermediate::Branch(method.findOrCreateLocal(TYPE_LABEL, thenLabel), COND_ZERO_SET, cond));
     if(!elseLabel.empty())
     {
@@ -692,7 +680,7 @@ std::vector<const Local*> Switch::getAllLocals() const
 
 bool Switch::mapInstruction(Method& method) const
 {
-    logging::debug() << "Generating branches for switch on " << cond.to_string() << " with " << jumpLabels.size() << " options and the default " << defaultLabel << logging::endl;
+    DEBUG_LOG("Generating branches for switch on " << cond.to_string() << " with " << jumpLabels.size() << " options and the default " << defaultLabel << logging::endl);
     for(const std::pair<int, std::string>& option : jumpLabels)
     {
         //for every case, if equal,branch to given label
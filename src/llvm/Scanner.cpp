@@ -9,15 +9,22 @@
 #include <cmath>
 
 #include "Scanner.h"
+#include "../MemoryStream.h"
 
 using namespace vc4c;
 using namespace vc4c::llvm2qasm;
 
-Scanner::Scanner(std::istream& input) : lineNumber(0), rowNumber(0), input(input), lookAhead(false,{})
+//the size of the blocks the input is read in, if the input is not already in memory
+static constexpr std::size_t READ_BLOCK_SIZE { 64 * 1024 };
+//the maximum length of a number literal
+static constexpr std::size_t NUMBER_BUFFER_SIZE { 128 };
+
+Scanner::Scanner(std::istream& input) : lineNumber(0), rowNumber(0), input(input), lookAhead(false,{}), storage(), position(nullptr), end(nullptr), buffered(false)
 {
 }
 
-Scanner::Scanner(const Scanner& orig) : lineNumber(orig.lineNumber), rowNumber(orig.rowNumber), input(orig.input), lookAhead(orig.lookAhead)
+Scanner::Scanner(const Scanner& orig) : lineNumber(orig.lineNumber), rowNumber(orig.rowNumber), input(orig.input), lookAhead(orig.lookAhead),
+		storage(orig.storage), position(orig.position), end(orig.end), buffered(orig.buffered)
 {
 }
 
@@ -49,7 +56,8 @@ const Token Scanner::pop()
 
 bool Scanner::hasInput()
 {
-    return lookAhead.first || (input.peek() != std::istream::traits_type::eof() && input.peek() != '\0');
+	fillBuffer();
+    return lookAhead.first || peekChar() != '\0';
 }
 
 std::string Scanner::getErrorPosition() const
@@ -65,23 +73,91 @@ unsigned int Scanner::getLineNumber() const
     return lineNumber;
 }
 
-int Scanner::skipChar()
+void Scanner::fillBuffer()
+{
+	//the input is read lazily, so the stream can still be filled after constructing the scanner
+	if(buffered)
+		return;
+	buffered = true;
+	if(const MemoryStreamBuffer* memory = dynamic_cast<const MemoryStreamBuffer*>(input.rdbuf()))
+	{
+		//use the memory directly, starting at the current read-position
+		const std::streamoff offset = input.tellg();
+		if(offset >= 0 && static_cast<std::size_t>(offset) <= memory->size())
+		{
+			position = memory->data() + offset;
+			end = memory->data() + memory->size();
+			input.seekg(0, std::ios_base::end);
+			return;
+		}
+	}
+	storage = std::make_shared<std::string>();
+	std::streambuf* buffer = input.rdbuf();
+	std::size_t size = 0;
+	while(buffer != nullptr)
+	{
+		storage->resize(size + READ_BLOCK_SIZE);
+		const std::streamsize numRead = buffer->sgetn(&(*storage)[size], static_cast<std::streamsize>(READ_BLOCK_SIZE));
+		size += static_cast<std::size_t>(std::max(numRead, static_cast<std::streamsize>(0)));
+		if(numRead < static_cast<std::streamsize>(READ_BLOCK_SIZE))
+			break;
+	}
+	storage->resize(size);
+	position = storage->data();
+	end = storage->data() + storage->size();
+}
+
+char Scanner::peekChar() const
+{
+	//the end of the input is handled like a null-byte
+	return position != end ? *position : '\0';
+}
+
+char Scanner::skipChar()
 {
     ++rowNumber;
-    return input.get();
+    return *position++;
 }
 
 inline bool isStringCharacter(char c)
 {
-    return std::isalnum(c) || c == '@' || c == '%' || c == '"' || c == '_' || c == '.' || c == '#' || c == '/' || c == '*' || c == '!';
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '@' || c == '%' || c == '"' || c == '_' || c == '.' || c == '#' || c == '/' || c == '*' || c == '!';
+}
+
+struct Keyword
+{
+	const char* text;
+	std::size_t length;
+	TokenType type;
+	bool flag;
+};
+
+//the keywords are compared case-insensitive
+static const Keyword KEYWORDS[] = {
+	{"true", 4, TokenType::BOOLEAN, true},
+	{nullptr, 0, TokenType::EMPTY, false},
+	{nullptr, 0, TokenType::EMPTY, false},
+	{"false", 5, TokenType::BOOLEAN, false}
+};
+static constexpr std::size_t NUM_KEYWORD_SLOTS { sizeof(KEYWORDS) / sizeof(KEYWORDS[0]) };
+
+static const Keyword* findKeyword(const char* text, const std::size_t length)
+{
+	//perfect hash over the length and the first character, every keyword has its own slot
+	const std::size_t slot = (length + static_cast<std::size_t>(std::tolower(static_cast<unsigned char>(text[0])))) % NUM_KEYWORD_SLOTS;
+	const Keyword& keyword = KEYWORDS[slot];
+	if(keyword.text != nullptr && keyword.length == length && strncasecmp(keyword.text, text, length) == 0)
+		return &keyword;
+	return nullptr;
 }
 
 const Token Scanner::readToken()
 {
+	fillBuffer();
     Token result = {};
     //skip all leading white-spaces
-    std::iostream::traits_type::int_type c;
-    while (std::isspace(c = input.peek())) {
+    char c;
+    while (std::isspace(static_cast<unsigned char>(c = peekChar()))) {
         skipChar();
         if(c == '\n')   //end statement on line break
         {
@@ -92,7 +168,7 @@ const Token Scanner::readToken()
         }
     }
 
-    if(c == std::iostream::traits_type::eof() || c == '\0')
+    if(c == '\0')
     {
         result.type = TokenType::EMPTY;
         return result;
@@ -100,26 +176,27 @@ const Token Scanner::readToken()
     else if(c == ';')    //skip comments
     {
         //skip complete line
+        static const std::string labelMarker = "<label>";
         const Token t = readLine();
-        if(t.to_string().find("<label>") != std::string::npos)
+        if(std::search(t.text, t.text + t.length, labelMarker.begin(), labelMarker.end()) != t.text + t.length)
             return t;
         Token end;
         end.type = TokenType::END;
         return end;
     }
-    else if (std::isdigit(c))    //number -> integer or real
+    else if (std::isdigit(static_cast<unsigned char>(c)))    //number -> integer or real
     {
         return readNumber();
     }
     else if (isStringCharacter(c))   //text -> text or bool
     {
+        const char* start = position;
         bool inStringLiteral = c == '"';
-        char buffer[TOKEN_BUFFER_SIZE] = {0};
-        unsigned i = 0;
-        for(; i < TOKEN_BUFFER_SIZE; ++i)
+        while(position != end)
         {
-            c = input.peek();
-            if(!inStringLiteral && i == 1 && (buffer[0] == '!' || buffer[0] == 'c') && c == '"')
+            const std::size_t i = static_cast<std::size_t>(position - start);
+            c = *position;
+            if(!inStringLiteral && i == 1 && (start[0] == '!' || start[0] == 'c') && c == '"')
                 //some strings in LLVM start with '!"', others (string-constants) with 'c"'
                 inStringLiteral = true;
             if(inStringLiteral)
@@ -127,11 +204,10 @@ const Token Scanner::readToken()
                 //end string literal only after next '"'
                 //XXX improve by testing for \"
                 //test to not read string '!"' for a string starting with '!"'
-                if((buffer[0] == '"' ? i > 0 : i > 1) && c =='"')
+                if((start[0] == '"' ? i > 0 : i > 1) && c =='"')
                 {
                     //include closing '"'
-                    buffer[i] = (char)skipChar();
-                    ++i;
+                    skipChar();
                     break;
                 }
             }
@@ -139,92 +215,94 @@ const Token Scanner::readToken()
             {
                 break;
             }
-            buffer[i] = (char)skipChar();
-        }
-        if (strcasecmp("true", buffer) == 0) // boolean true
-        {
-            result.type = TokenType::BOOLEAN;
-            result.flag = true;
+            skipChar();
         }
-        else if (strcasecmp("false", buffer) == 0) // boolean false
+        const std::size_t length = static_cast<std::size_t>(position - start);
+        if(const Keyword* keyword = findKeyword(start, length))
         {
-            result.type = TokenType::BOOLEAN;
-            result.flag = false;
+            result.type = keyword->type;
+            result.flag = keyword->flag;
         }
         else // some other text
         {
             result.type = TokenType::STRING;
-            memcpy(result.text, buffer, i);
+            result.text = start;
+            result.length = length;
         }
         return result;
     }
         //special character
     else {
         result.type = TokenType::STRING;
+        result.text = position;
         //special treatment for '+' and '-' -> could start number
         if (c == '+' || c == '-') {
-            skipChar();
-            auto d = input.peek();
-            if (std::isdigit(d)) {
+            const char d = position + 1 != end ? position[1] : '\0';
+            if (std::isdigit(static_cast<unsigned char>(d))) {
                 //start of number
-                input.putback(c);
                 return readNumber();
             }
-            else if(d == c)     //++ or --
+            skipChar();
+            if(d == c)     //++ or --
             {
                 skipChar();
-                result.text[0] = (char)c;
-                result.text[1] = (char)c;
+                result.length = 2;
             }
             else //operator
             {
-                result.text[0] = (char)c;
+                result.length = 1;
             }
+            return result;
         }
             //other single character tokens
         else if (c == '(' || c == ')' || c == '*' || c == ':' || c == ',' || c == '[' || c == ']' 
                  || c == '=' || c == '{' || c == '}' || c == '<' || c == '>') {
             skipChar();
-            result.text[0] = c;
+            result.length = 1;
+            return result;
         }
-        return result;
     }
-    throw CompilationError(CompilationStep::SCANNER, lineNumber, std::string("Invalid character:") + (char) c);
+    throw CompilationError(CompilationStep::SCANNER, lineNumber, std::string("Invalid character:") + c);
 }
 
 const Token Scanner::readNumber()
 {
     Token result;
-    std::string numberToken;
-    while(std::isalnum(input.peek()) || input.peek() == '.' || input.peek() == '-' || input.peek() == '+')
+    const char* start = position;
+    char c;
+    while(std::isalnum(static_cast<unsigned char>(c = peekChar())) || c == '.' || c == '-' || c == '+')
     {
-        ++rowNumber;
-        numberToken.push_back(input.get());
+        skipChar();
     }
+    const std::size_t length = static_cast<std::size_t>(position - start);
+    if(length >= NUMBER_BUFFER_SIZE)
+        throw CompilationError(CompilationStep::SCANNER, lineNumber, std::string("Number literal too long: ") + std::string(start, length));
+    //the conversion functions require a null-terminated string
+    char numberToken[NUMBER_BUFFER_SIZE];
+    memcpy(numberToken, start, length);
+    numberToken[length] = '\0';
     result.type = TokenType::NUMBER;
-    if(numberToken.find_first_of("e.p") != std::string::npos)
+    if(strpbrk(numberToken, "e.p") != nullptr)
     {
         //floating literal
-        result.real = std::strtod(numberToken.data(), nullptr);
+        result.real = std::strtod(numberToken, nullptr);
     }
     else
     {
         //integer literal
-        result.integer = std::strtol(numberToken.data(), nullptr, 0 /* let method decide */);
+        result.integer = std::strtol(numberToken, nullptr, 0 /* let method decide */);
     }
-    //so our index is correct again
-    result.type = TokenType::NUMBER;
     return result;
 }
 
 const Token Scanner::readLine()
 {
-    std::iostream::traits_type::int_type c;
+	fillBuffer();
     Token line;
     line.type = TokenType::STRING;
-    memset(line.text, '\0', TOKEN_BUFFER_SIZE);
-    std::size_t i = 0;
-    while ((c = input.peek()) != std::iostream::traits_type::eof() && c != '\0')
+    line.text = position;
+    char c;
+    while ((c = peekChar()) != '\0')
     {
         if(c == '\n')   //end statement on line break
         {
@@ -232,7 +310,8 @@ const Token Scanner::readLine()
             rowNumber = 0;
             break;
         }
-        line.text[i++] = skipChar();
+        skipChar();
     }
+    line.length = static_cast<std::size_t>(position - line.text);
     return line;
 }
@@ -8,6 +8,7 @@
 #define SCANNER_H
 
 #include <iostream>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -19,6 +20,12 @@ namespace vc4c
 	namespace llvm2qasm
 	{
 
+		/*
+		 * Scanner for LLVM IR text.
+		 *
+		 * The whole input is scanned from a contiguous buffer (the memory of a MemoryStreamBuffer is used directly),
+		 * so tokens only reference slices of this buffer instead of copying their text.
+		 */
 		class Scanner
 		{
 		public:
@@ -44,11 +51,19 @@ namespace vc4c
 			std::istream& input;
 			std::pair<bool, Token> lookAhead;
 
+			//the buffer is shared between copies of this scanner, so tokens stay valid
+			std::shared_ptr<std::string> storage;
+			const char* position;
+			const char* end;
+			bool buffered;
+
 			const Token readToken();
 
 			const Token readNumber();
 
-			int skipChar();
+			void fillBuffer();
+			char peekChar() const;
+			char skipChar();
 		};
 	}
 }
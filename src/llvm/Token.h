@@ -10,13 +10,13 @@
 #include "CompilationError.h"
 #include "helper.h"
 
+#include <cstring>
+
 namespace vc4c
 {
 
 	namespace llvm2qasm
 	{
-		static constexpr unsigned int TOKEN_BUFFER_SIZE { 2048 };
-
 		enum class TokenType
 			: unsigned char
 			{
@@ -54,7 +54,7 @@ namespace vc4c
 					case TokenType::NUMBER:
 						return std::to_string(integer);
 					case TokenType::STRING:
-						return text;
+						return std::string(text, length);
 					case TokenType::EMPTY:
 						return "(empty)";
 					case TokenType::END:
@@ -66,23 +66,30 @@ namespace vc4c
 
 			bool hasValue(const std::string& val) const
 			{
-				return type == TokenType::STRING && val.compare(text) == 0;
+				return type == TokenType::STRING && val.size() == length && val.compare(0, length, text, length) == 0;
+			}
+
+			bool hasValue(const char* val) const
+			{
+				return type == TokenType::STRING && std::strlen(val) == length && std::memcmp(text, val, length) == 0;
 			}
 
 			bool hasValue(const char val) const
 			{
-				return type == TokenType::STRING && *text == val;
+				return type == TokenType::STRING && length > 0 && *text == val;
 			}
 
 			Optional<std::string> getText() const
 			{
 				if (type == TokenType::STRING)
-					return std::string(text);
+					return std::string(text, length);
 				return
 				{};
 			}
 		private:
-			char text[TOKEN_BUFFER_SIZE];
+			//the text is not null-terminated and points into the input-buffer of the scanner (or other storage outliving the token)
+			const char* text = nullptr;
+			std::size_t length = 0;
 
 			friend class Scanner;
 			friend class IRParser;
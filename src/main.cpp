@@ -13,8 +13,11 @@
 #include <sstream>
 
 #include "Compiler.h"
+#include "CompileServer.h"
+#include "KernelBundle.h"
 #include "log.h"
 #include "Profiler.h"
+#include "optimization/Instrumentation.h"
 
 using namespace std;
 using namespace vc4c;
@@ -25,9 +28,13 @@ using namespace vc4c;
 int main(int argc, char** argv)
 {
     
+    if(argc == 3 && strcmp("--server", argv[1]) == 0)
+    	return runCompileServer(argv[2]);
+
     if(argc < 3)
     {
         std::cerr << "Usage: vc4c [flags] [options] -o <destination> <sources>" << std::endl;
+        std::cerr << "   or: vc4c --server <socket>\tRun as compilation server on the given UNIX socket, used by the C interface if VC4C_SERVER_SOCKET is set" << std::endl;
         std::cerr << "flags:" << std::endl;
         std::cerr << "\t--hex\t\t\tGenerate hex output (e.g. included in source-code)" << std::endl;
         std::cerr << "\t--bin\t\t\tGenerate binary output (as used by VC4CL run-time)" << std::endl;
@@ -35,6 +42,48 @@ int main(int argc, char** argv)
         std::cerr << "options:" << std::endl;
         std::cerr << "\t--kernel-info\t\tWrite the kernel-info meta-data (as required by VC4CL run-time, default)" << std::endl;
         std::cerr << "\t--no-kernel-info\tDont write the kernel-info meta-data" << std::endl;
+        std::cerr << "\t--kernel=<name>\t\tOnly compile the given kernel, can be specified multiple times" << std::endl;
+        std::cerr << "\t--spirv-passes=<list>\tComma-separated list of SPIRV-Tools optimization passes to run on SPIR-V input, empty to disable" << std::endl;
+        std::cerr << "\t--local-size=<list>\tComma-separated work-group size (per dimension) to specialize the kernels for, the code can only be run with this size" << std::endl;
+        std::cerr << "\t--global-size=<list>\tComma-separated global work size (per dimension) to specialize the kernels for, requires --local-size" << std::endl;
+        std::cerr << "\t--bind=<kernel>:<index>=<value>\tSpecialize the kernel for the scalar parameter with the given index having the given (integer or float) value, can be specified multiple times" << std::endl;
+        std::cerr << "\t--spec-constant=<id>=<value>\tSet the SPIR-V specialization constant with the given SpecId to the given (integer, boolean or float) value, can be specified multiple times" << std::endl;
+        std::cerr << "\t--compact-uniforms\tDo not read the work-item UNIFORMs not used by the kernel, the run-time needs to only pass the used ones (as listed in the kernel-info)" << std::endl;
+        std::cerr << "\t--bundle\t\tWrite a kernel bundle with the binary code of all kernels for every variant, which the run-time can load without compiling" << std::endl;
+        std::cerr << "\t--bundle-local-size=<list>\tAdd a variant specialized for the comma-separated work-group size to the kernel bundle, can be specified multiple times" << std::endl;
+        std::cerr << "\t--compress-bundle\tCompress the programs in the kernel bundle" << std::endl;
+        std::cerr << "\t--container\t\tWrite the binary as indexed container with a section table, so single kernels can be loaded separately, the run-time needs to support this" << std::endl;
+        std::cerr << "\t--profile\t\tCollect and print the profiling results (same as setting the environment variable VC4C_PROFILE)" << std::endl;
+        std::cerr << "\t--trace=<file>\t\tWrite the timed compilation phases of all threads as Chrome trace-event JSON into the given file (same as setting VC4C_TRACE_FILE)" << std::endl;
+        std::cerr << "\t--compact-kernel-info\tWrite the kernel-info in the compact format with resource-usage statistics, the run-time needs to support this" << std::endl;
+        std::cerr << "\t--no-kernel-info-names\tOmit the names of the kernels and parameters from the compact kernel-info" << std::endl;
+        std::cerr << "\t--batch-work-groups\tLoad the parameters once and calculate the group ids in the kernel for all work-groups executed in one run, the run-time needs to support this" << std::endl;
+        std::cerr << "\t--partition-vpm\t\tGive every QPU its own part of the VPM to access memory without locking the hardware mutex" << std::endl;
+        std::cerr << "\t--threaded\t\tRun the kernels in both hardware threads of a QPU, switching threads while waiting for memory loads (uses only half of the registers)" << std::endl;
+        std::cerr << "\t--linear-scan\t\tAllocate the registers via linear scan for faster compilation (default for -O0 and -O1)" << std::endl;
+        std::cerr << "\t--graph-coloring\tAllocate the registers via graph coloring, which can resolve more conflicts (default for -O2 and -O3)" << std::endl;
+        std::cerr << "\t--fast-path=<n>\t\tCompile kernels with at most this many instructions with only the minimal optimizations and the linear-scan allocator, 0 disables (default: " << FAST_PATH_MAX_INSTRUCTIONS << ", 0 for -O3)" << std::endl;
+        std::cerr << "\t--optimization-report=<file>\tWrite the time and effect of every optimization pass for every kernel as JSON into the given file" << std::endl;
+        std::cerr << "\t--performance-report=<file>\tWrite the statically estimated cycles of every basic block of every kernel as JSON into the given file" << std::endl;
+        std::cerr << "\t--debug-graphs=<dir>\tWrite the block-graph and the register-graph of every kernel as Graphviz files into the given directory, in the background" << std::endl;
+        std::cerr << "\t--debug-graph-kernel=<name>\tOnly write the debug graphs of the given kernel, can be given multiple times" << std::endl;
+        std::cerr << "\t--debug-graph-phase=<phase>\tOnly write the given debug graph (block-graph or register-graph), can be given multiple times" << std::endl;
+        std::cerr << "\t--debug-graph-nodes=<n>\tTruncate the debug graphs to the given number of nodes (default: 1000, 0 for no limit)" << std::endl;
+        std::cerr << "\t--instrument-blocks=<file>\tCount the executions of the basic blocks in a buffer passed as additional last kernel parameter and write the counted blocks into the given file" << std::endl;
+        std::cerr << "\t--uniform-constants=<n>\tPass up to the given number of constants loaded in loops as additional UNIFORMs (listed in the kernel-info), the run-time needs to support this" << std::endl;
+        std::cerr << "\t--preload-tables=<bytes>\tCopy __constant lookup tables of up to the given size into the VPM at the start of the kernel and read the lookups from there" << std::endl;
+        std::cerr << "\t--buffer-vector-params\tPass the vector parameters in a buffer read with a single DMA access instead of one UNIFORM per element, the run-time needs to support this" << std::endl;
+        std::cerr << "\t--block-profile=<file>\tUse the block execution counts (the file written by --instrument-blocks with the counts filled in) to guide loop-unrolling and instruction reordering" << std::endl;
+        std::cerr << "\t--max-time=<ms>\t\tThe time budget for compiling (excluding the pre-compilation), on exceeding it the optional optimizations are skipped" << std::endl;
+        std::cerr << "\t--max-memory=<MB>\tThe budget for the peak memory usage, on exceeding it the optional optimizations are skipped" << std::endl;
+        std::cerr << "\t--function-cache=<MB>\tThe size of the cache of simplified methods shared by all programs compiled by this process (e.g. with --server)" << std::endl;
+        std::cerr << "\t--verify=<n>\t\tVerify the generated code of every n-th compilation (if built with the verifier), 0 to disable, defaults to 1" << std::endl;
+        std::cerr << "\t--max-instructions=<n>\tThe budget for the number of instructions per kernel, on exceeding it the optional optimizations are skipped" << std::endl;
+        std::cerr << "\t--max-graph-size=<MB>\tThe budget for the interference-graph of the register allocation per kernel, on exceeding it the linear-scan allocator is tried first" << std::endl;
+        std::cerr << "\t--abort-on-budget\tAbort the compilation with an error instead of skipping optimizations, if a budget is exceeded" << std::endl;
+        std::cerr << "\t-O0, -O1, -O2, -O3\tThe optimization level, from only the required optimizations to all optimizations with larger budgets (default: -O2), also passed to the pre-compiler" << std::endl;
+        std::cerr << "\t-Os\t\t\tOptimize for code size, e.g. for kernels exceeding the instruction cache: no loop unrolling and merging of duplicate code, also passed to the pre-compiler" << std::endl;
+        std::cerr << "\t-c\t\t\tOnly compile the sources into a linkable object (SPIR-V), multiple sources are linked into a library object. Objects can be passed as sources again" << std::endl;
         std::cerr << "\tany other option is passed to the pre-compiler" << std::endl;
         return 1;
     }
@@ -42,7 +91,16 @@ int main(int argc, char** argv)
     Configuration config;
     std::vector<std::string> inputFiles;
     std::string outputFile;
+    bool compileOnly = false;
+    bool writeBundle = false;
+    bool compressBundle = false;
+    //the work-group sizes of the additional specialized variants written into the kernel bundle
+    std::vector<std::vector<uint32_t>> bundleLocalSizes;
     std::string options;
+    //the register allocation explicitly selected, overrides the default of the optimization level
+    Optional<RegisterAllocation> registerAllocation;
+    //the fast-path threshold explicitly selected, overrides the default of the optimization level
+    Optional<std::size_t> fastPathInstructions;
     
     int i = 1;
     for(; i < argc - 2; ++i)
@@ -64,6 +122,164 @@ int main(int argc, char** argv)
             config.writeKernelInfo = true;
         else if(strcmp("--no-kernel-info", argv[i]) == 0)
             config.writeKernelInfo = false;
+        else if(strncmp("--kernel=", argv[i], strlen("--kernel=")) == 0)
+            config.selectedKernels.emplace_back(argv[i] + strlen("--kernel="));
+        else if(strncmp("--spirv-passes=", argv[i], strlen("--spirv-passes=")) == 0)
+        {
+        	config.spirvOptimizationPasses.clear();
+        	std::istringstream passes(argv[i] + strlen("--spirv-passes="));
+        	std::string pass;
+        	while(std::getline(passes, pass, ','))
+        	{
+        		if(!pass.empty())
+        			config.spirvOptimizationPasses.push_back(pass);
+        	}
+        }
+        else if(strncmp("--local-size=", argv[i], strlen("--local-size=")) == 0 || strncmp("--global-size=", argv[i], strlen("--global-size=")) == 0)
+        {
+        	const bool isLocal = strncmp("--local-size=", argv[i], strlen("--local-size=")) == 0;
+        	std::vector<uint32_t>& sizes = isLocal ? config.specializedLocalSizes : config.specializedGlobalSizes;
+        	sizes.clear();
+        	std::istringstream list(argv[i] + (isLocal ? strlen("--local-size=") : strlen("--global-size=")));
+        	std::string size;
+        	while(std::getline(list, size, ','))
+        	{
+        		if(!size.empty())
+        			sizes.push_back(static_cast<uint32_t>(std::atoi(size.data())));
+        	}
+        }
+        else if(strncmp("--bind=", argv[i], strlen("--bind=")) == 0)
+        {
+        	const std::string binding(argv[i] + strlen("--bind="));
+        	const std::size_t colonPos = binding.rfind(':');
+        	const std::size_t equalsPos = binding.find('=', colonPos == std::string::npos ? 0 : colonPos);
+        	if(colonPos == std::string::npos || equalsPos == std::string::npos)
+        	{
+        		std::cerr << "Invalid parameter binding: " << binding << std::endl;
+        		return 2;
+        	}
+        	const std::string value = binding.substr(equalsPos + 1);
+        	const bool isFloat = value.find('.') != std::string::npos;
+        	config.specializedParameters.push_back(ParameterSpecialization{binding.substr(0, colonPos),
+        		static_cast<unsigned>(std::atoi(binding.substr(colonPos + 1, equalsPos - colonPos - 1).data())),
+        		isFloat ? bit_cast<float, uint32_t>(std::strtof(value.data(), nullptr)) : static_cast<uint32_t>(std::strtoll(value.data(), nullptr, 0))});
+        }
+        else if(strncmp("--spec-constant=", argv[i], strlen("--spec-constant=")) == 0)
+        {
+        	const std::string constant(argv[i] + strlen("--spec-constant="));
+        	const std::size_t equalsPos = constant.find('=');
+        	if(equalsPos == std::string::npos)
+        	{
+        		std::cerr << "Invalid specialization constant: " << constant << std::endl;
+        		return 2;
+        	}
+        	const std::string value = constant.substr(equalsPos + 1);
+        	//floating-point values are written as single precision, double constants need to be given as their bits
+        	const bool isFloat = value.find('.') != std::string::npos;
+        	const uint64_t bits = value == "true" ? 1 : value == "false" ? 0 :
+        		isFloat ? bit_cast<float, uint32_t>(std::strtof(value.data(), nullptr)) : static_cast<uint64_t>(std::strtoull(value.data(), nullptr, 0));
+        	config.specializationConstants.push_back(SpecializationConstant{static_cast<uint32_t>(std::strtoul(constant.data(), nullptr, 0)), bits});
+        }
+        else if(strcmp("--bundle", argv[i]) == 0)
+        	writeBundle = true;
+        else if(strncmp("--bundle-local-size=", argv[i], strlen("--bundle-local-size=")) == 0)
+        {
+        	writeBundle = true;
+        	bundleLocalSizes.emplace_back();
+        	std::istringstream list(argv[i] + strlen("--bundle-local-size="));
+        	std::string size;
+        	while(std::getline(list, size, ','))
+        	{
+        		if(!size.empty())
+        			bundleLocalSizes.back().push_back(static_cast<uint32_t>(std::atoi(size.data())));
+        	}
+        }
+        else if(strcmp("--compress-bundle", argv[i]) == 0)
+        	compressBundle = true;
+        else if(strcmp("--compact-uniforms", argv[i]) == 0)
+        	config.compactUniforms = true;
+        else if(strcmp("--container", argv[i]) == 0)
+        	config.indexedContainer = true;
+        else if(strcmp("--profile", argv[i]) == 0)
+        	profiler::setEnabled(true);
+        else if(strncmp("--trace=", argv[i], strlen("--trace=")) == 0)
+        	profiler::setTraceFile(argv[i] + strlen("--trace="));
+        else if(strcmp("--compact-kernel-info", argv[i]) == 0)
+        	config.compactKernelInfo = true;
+        else if(strcmp("--no-kernel-info-names", argv[i]) == 0)
+        	config.kernelInfoNames = false;
+        else if(strcmp("--batch-work-groups", argv[i]) == 0)
+        	config.batchWorkGroups = true;
+        else if(strcmp("--partition-vpm", argv[i]) == 0)
+        	config.partitionVPM = true;
+        else if(strcmp("--threaded", argv[i]) == 0)
+        	config.threadedExecution = true;
+        else if(strcmp("--linear-scan", argv[i]) == 0)
+        	registerAllocation = RegisterAllocation::LINEAR_SCAN;
+        else if(strcmp("--graph-coloring", argv[i]) == 0)
+        	registerAllocation = RegisterAllocation::GRAPH_COLORING;
+        else if(strncmp("--fast-path=", argv[i], strlen("--fast-path=")) == 0)
+        	fastPathInstructions = static_cast<std::size_t>(std::atol(argv[i] + strlen("--fast-path=")));
+        else if(strncmp("--optimization-report=", argv[i], strlen("--optimization-report=")) == 0)
+        	config.optimizationReportFile = argv[i] + strlen("--optimization-report=");
+        else if(strncmp("--performance-report=", argv[i], strlen("--performance-report=")) == 0)
+        	config.performanceReportFile = argv[i] + strlen("--performance-report=");
+        else if(strncmp("--debug-graphs=", argv[i], strlen("--debug-graphs=")) == 0)
+        	config.debugGraphDirectory = argv[i] + strlen("--debug-graphs=");
+        else if(strncmp("--debug-graph-kernel=", argv[i], strlen("--debug-graph-kernel=")) == 0)
+        	config.debugGraphKernels.push_back(argv[i] + strlen("--debug-graph-kernel="));
+        else if(strncmp("--debug-graph-phase=", argv[i], strlen("--debug-graph-phase=")) == 0)
+        	config.debugGraphPhases.push_back(argv[i] + strlen("--debug-graph-phase="));
+        else if(strncmp("--debug-graph-nodes=", argv[i], strlen("--debug-graph-nodes=")) == 0)
+        	config.maxDebugGraphNodes = static_cast<std::size_t>(std::atol(argv[i] + strlen("--debug-graph-nodes=")));
+        else if(strncmp("--instrument-blocks=", argv[i], strlen("--instrument-blocks=")) == 0)
+        {
+        	config.instrumentBlocks = true;
+        	config.blockLayoutFile = argv[i] + strlen("--instrument-blocks=");
+        }
+        else if(strncmp("--uniform-constants=", argv[i], strlen("--uniform-constants=")) == 0)
+        	config.maxUniformConstants = static_cast<unsigned>(std::atoi(argv[i] + strlen("--uniform-constants=")));
+        else if(strcmp("--buffer-vector-params", argv[i]) == 0)
+        	config.bufferVectorParameters = true;
+        else if(strncmp("--preload-tables=", argv[i], strlen("--preload-tables=")) == 0)
+        	config.maxPreloadedTableSize = static_cast<unsigned>(std::atoi(argv[i] + strlen("--preload-tables=")));
+        else if(strncmp("--block-profile=", argv[i], strlen("--block-profile=")) == 0)
+        {
+        	std::ifstream profile(argv[i] + strlen("--block-profile="));
+        	if(!profile)
+        	{
+        		std::cerr << "Failed to read block-profile: " << (argv[i] + strlen("--block-profile=")) << std::endl;
+        		return 2;
+        	}
+        	config.blockProfile = optimizations::readBlockProfile(profile);
+        }
+        else if(strncmp("--max-time=", argv[i], strlen("--max-time=")) == 0)
+        	config.maxCompilationTime = static_cast<unsigned>(std::atoi(argv[i] + strlen("--max-time=")));
+        else if(strncmp("--max-memory=", argv[i], strlen("--max-memory=")) == 0)
+        	config.maxMemoryUsage = static_cast<std::size_t>(std::atol(argv[i] + strlen("--max-memory="))) * 1024 * 1024;
+        else if(strncmp("--function-cache=", argv[i], strlen("--function-cache=")) == 0)
+        	config.functionCacheSize = static_cast<std::size_t>(std::atol(argv[i] + strlen("--function-cache="))) * 1024 * 1024;
+        else if(strncmp("--verify=", argv[i], strlen("--verify=")) == 0)
+        	config.verificationInterval = static_cast<unsigned>(std::atoi(argv[i] + strlen("--verify=")));
+        else if(strncmp("--max-instructions=", argv[i], strlen("--max-instructions=")) == 0)
+        	config.maxKernelInstructions = static_cast<std::size_t>(std::atol(argv[i] + strlen("--max-instructions=")));
+        else if(strncmp("--max-graph-size=", argv[i], strlen("--max-graph-size=")) == 0)
+        	config.maxInterferenceGraphSize = static_cast<std::size_t>(std::atol(argv[i] + strlen("--max-graph-size="))) * 1024 * 1024;
+        else if(strcmp("--abort-on-budget", argv[i]) == 0)
+        	config.budgetExceededAction = BudgetExceededAction::ABORT;
+        else if(strcmp("-O0", argv[i]) == 0 || strcmp("-O1", argv[i]) == 0 || strcmp("-O2", argv[i]) == 0 || strcmp("-O3", argv[i]) == 0)
+        {
+        	config.setOptimizationLevel(static_cast<OptimizationLevel>(argv[i][2] - '0'));
+        	//the pre-compiler optimizes according to the same level
+        	options.append(argv[i]).append(" ");
+        }
+        else if(strcmp("-Os", argv[i]) == 0)
+        {
+        	config.setOptimizationLevel(OptimizationLevel::SIZE);
+        	options.append(argv[i]).append(" ");
+        }
+        else if(strcmp("-c", argv[i]) == 0)
+        	compileOnly = true;
         else if(strcmp("-o", argv[i]) == 0)
         {
         	outputFile = argv[i+1];
@@ -79,6 +295,10 @@ int main(int argc, char** argv)
     {
     	inputFiles.push_back(argv[i]);
     }
+    if(registerAllocation)
+    	config.registerAllocation = registerAllocation.get();
+    if(fastPathInstructions)
+    	config.fastPathInstructions = fastPathInstructions.get();
 
     if(inputFiles.empty())
     {
@@ -99,6 +319,26 @@ int main(int argc, char** argv)
     setLogger(std::wcout, true, LogLevel::WARNING);
 #endif
 
+    if(compileOnly)
+    {
+    	std::ofstream output(outputFile, std::ios_base::out|std::ios_base::trunc|std::ios_base::binary);
+    	if(inputFiles.size() == 1)
+    	{
+    		std::ifstream input(inputFiles.at(0));
+    		Precompiler::compileObject(input, output, options, inputFiles.at(0));
+    		return 0;
+    	}
+    	std::vector<std::unique_ptr<std::istream>> fileStreams;
+    	std::unordered_map<std::istream*, Optional<std::string>> inputs;
+    	for(const std::string& file : inputFiles)
+    	{
+    		fileStreams.emplace_back(new std::ifstream(file));
+    		inputs.emplace(fileStreams.back().get(), Optional<std::string>(file));
+    	}
+    	Precompiler::linkSourceCode(inputs, output, options, true);
+    	return 0;
+    }
+
     Optional<std::string> inputFile;
     std::unique_ptr<std::istream> input;
     //link if necessary
@@ -112,7 +352,7 @@ int main(int argc, char** argv)
     		inputs.emplace(fileStreams.back().get(), Optional<std::string>(file));
     	}
     	input.reset(new std::stringstream());
-    	Precompiler::linkSourceCode(inputs, *reinterpret_cast<std::ostream*>(input.get()));
+    	Precompiler::linkSourceCode(inputs, *reinterpret_cast<std::ostream*>(input.get()), options);
     }
     else
     {
@@ -121,6 +361,41 @@ int main(int argc, char** argv)
     }
 
     std::ofstream output(outputFile, std::ios_base::out|std::ios_base::trunc|std::ios_base::binary);
+    if(writeBundle)
+    {
+    	//the bundle contains the code as loaded by the run-time
+    	config.outputMode = OutputMode::BINARY;
+    	std::vector<Configuration> configs(1, config);
+    	for(const std::vector<uint32_t>& sizes : bundleLocalSizes)
+    	{
+    		configs.push_back(config);
+    		configs.back().specializedLocalSizes = sizes;
+    	}
+    	//the kernel names are taken from the metrics, which are not available for cached programs
+    	Compiler::setCacheBackend(nullptr);
+    	std::vector<std::ostringstream> binaries(configs.size());
+    	std::vector<std::ostream*> outputs;
+    	for(std::ostringstream& binary : binaries)
+    		outputs.push_back(&binary);
+    	PROFILE_START(Compiler);
+    	const std::vector<CompilationResult> results = Compiler::compileVariants(*input.get(), outputs, configs, options, inputFile);
+    	PROFILE_END(Compiler);
+    	std::vector<BundledProgram> programs;
+    	for(std::size_t v = 0; v < configs.size(); ++v)
+    	{
+    		if(!results[v].success)
+    		{
+    			std::cerr << "Compilation of variant " << v << " failed: " << results[v].error << std::endl;
+    			return 4;
+    		}
+    		programs.push_back(BundledProgram{{}, getConfigurationHash(configs[v]), binaries[v].str()});
+    		for(const KernelMetrics& kernel : results[v].metrics.kernels)
+    			programs.back().kernelNames.push_back(kernel.name);
+    	}
+    	writeKernelBundle(output, programs, compressBundle);
+    	PROFILE_RESULTS();
+    	return 0;
+    }
 	PROFILE_START(Compiler);
 	Compiler::compile(*input.get(), output, config, options, inputFile);
 	PROFILE_END(Compiler);
@@ -5,13 +5,17 @@
  */
 
 #include "Combiner.h"
-#include "log.h"
+#include "Reordering.h"
+#include "../Logging.h"
 #include "helper.h"
 #include "../intermediate/Helper.h"
 #include "../InstructionWalker.h"
+#include "../periphery/TMU.h"
+#include "../asm/KernelInfo.h"
 
 #include <stdlib.h>
 #include <algorithm>
+#include <iterator>
 #include <memory>
 
 using namespace vc4c;
@@ -59,7 +63,7 @@ InstructionWalker optimizations::combineDuplicateBranches(const Module& module,
 			//for now, only remove unconditional branches
 			if(!thisBranch->isUnconditional() || !nextBranch->isUnconditional())
 				return it;
-			logging::debug() << "Removing duplicate branch to same target: " << thisBranch->to_string() << logging::endl;
+			DEBUG_LOG("Removing duplicate branch to same target: " << thisBranch->to_string() << logging::endl);
 			it = it.erase();
 			//don't skip next instruction
 			it.previousInMethod();
@@ -68,10 +72,11 @@ InstructionWalker optimizations::combineDuplicateBranches(const Module& module,
 	return it;
 }
 
-using MergeCondition = std::function<bool(Operation*, Operation*, MoveOperation*, MoveOperation*)>;
-static const std::vector<MergeCondition> mergeConditions = {
+//plain function pointers instead of std::function, so the table is built without any allocation when the library is loaded
+using MergeCondition = bool (*)(const Operation*, const Operation*, const MoveOperation*, const MoveOperation*);
+static const MergeCondition mergeConditions[] = {
 	//check both instructions can be combined and are actually mapped to machine code
-	[](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+	[](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
 		if(firstOp != nullptr && !(firstOp->canBeCombined && firstOp->mapsToASMInstruction()))
 			return false;
 		if(firstMove != nullptr && !(firstMove->canBeCombined && firstMove->mapsToASMInstruction()))
@@ -83,11 +88,11 @@ static const std::vector<MergeCondition> mergeConditions = {
 		return true;
 	},
 	//check neither instruction is a vector rotation
-	[](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
-		return (firstMove == nullptr || dynamic_cast<VectorRotation*>(firstMove) == nullptr) && (secondMove == nullptr || dynamic_cast<VectorRotation*>(secondMove) == nullptr);
+	[](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
+		return (firstMove == nullptr || !firstMove->is<VectorRotation>()) && (secondMove == nullptr || !secondMove->is<VectorRotation>());
 	},
     //check both instructions use different ALUs
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
         if(firstOp != nullptr && secondOp != nullptr)
         {
             const auto firstCodes = toOpCode(firstOp->opCode);
@@ -100,7 +105,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return true;
     },
     //check reads from or writes to special registers
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
         if(firstOp != nullptr && (firstOp->hasValueType(ValueType::REGISTER) || firstOp->getFirstArg().hasType(ValueType::REGISTER) || (firstOp->getSecondArg() && firstOp->getSecondArg().get().hasType(ValueType::REGISTER))))
             return false;
         else if(firstMove != nullptr && (firstMove->hasValueType(ValueType::REGISTER) || firstMove->getSource().hasType(ValueType::REGISTER)))
@@ -112,7 +117,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return true;
     },
     //check second operation using the result of the first
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
         Value outFirst(UNDEFINED_VALUE);
         if(firstOp != nullptr && firstOp->getOutput())
             outFirst = firstOp->getOutput();
@@ -136,7 +141,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return true;
     },
     //check operations use same output and do not have inverted conditions
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
         Value outFirst(UNDEFINED_VALUE);
         ConditionCode condFirst = COND_ALWAYS;
         if(firstOp != nullptr && firstOp->getOutput())
@@ -169,7 +174,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return true;
     },
     //check first operation sets flags and second operation depends on them
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
         SetFlag setsFlags = SetFlag::DONT_SET;
         bool usesFlags = false;
         ConditionCode firstCond = COND_ALWAYS;
@@ -205,7 +210,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return setsFlags == SetFlag::DONT_SET || !usesFlags;
     },
     //check MUL ALU sets flags (flags would be set by ADD ALU)
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
     	ConditionCode firstCond = firstOp ? firstOp->conditional : firstMove->conditional;
 		ConditionCode secondCond = secondOp ? secondOp->conditional : secondMove->conditional;
 		if(firstCond.isInversionOf(secondCond))
@@ -220,7 +225,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return true;
     },
     //check maximum 1 immediate value is used (both can use the same immediate value)
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
         Optional<SmallImmediate> immediate(false, 0);
         if(firstOp != nullptr)
         {
@@ -252,7 +257,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return true;
     },
     //check a maximum of 2 inputs are read from
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
         std::pair<Value, Value> inputs = std::make_pair(UNDEFINED_VALUE, UNDEFINED_VALUE);
         if(firstOp != nullptr)
         {
@@ -292,7 +297,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return true;
     },
     //check at most 1 signal (including IMMEDIATE) is set, same for Un-/Pack
-    [](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+    [](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
         Signaling firstSignal = Signaling::NO_SIGNAL;
         Signaling secondSignal = Signaling::NO_SIGNAL;
 
@@ -349,7 +354,7 @@ static const std::vector<MergeCondition> mergeConditions = {
         return true;
     },
 	//check not two different boolean values which both are used in conditional jump
-	[](Operation* firstOp, Operation* secondOp, MoveOperation* firstMove, MoveOperation* secondMove) -> bool{
+	[](const Operation* firstOp, const Operation* secondOp, const MoveOperation* firstMove, const MoveOperation* secondMove) -> bool{
     	//since boolean values are combined with ELEM_NUMBER (reg-file A) before conditional branch, they cannot be on reg-file A
     	//combining two of those can cause register-association errors
     	//TODO find a way to fix this
@@ -364,10 +369,79 @@ static const std::vector<MergeCondition> mergeConditions = {
     }
 };
 
+bool optimizations::canCombineInstructions(const IntermediateInstruction* first, const IntermediateInstruction* second)
+{
+	const Operation* op = first->as<Operation>();
+	const MoveOperation* move = first->as<MoveOperation>();
+	const Operation* nextOp = second->as<Operation>();
+	const MoveOperation* nextMove = second->as<MoveOperation>();
+	if((op == nullptr && move == nullptr) || (nextOp == nullptr && nextMove == nullptr))
+		return false;
+	return std::all_of(std::begin(mergeConditions), std::end(mergeConditions), [op, nextOp, move, nextMove](const MergeCondition cond) -> bool
+	{
+		return cond(op, nextOp, move, nextMove);
+	});
+}
+
+bool optimizations::combineWithNextInstruction(InstructionWalker it, InstructionWalker nextIt)
+{
+	Operation* op = it.get<Operation>();
+	MoveOperation* move = it.get<MoveOperation>();
+	Operation* nextOp = nextIt.get<Operation>();
+	MoveOperation* nextMove = nextIt.get<MoveOperation>();
+	//move supports both ADD and MUL ALU
+	//if merge, make "move" to other op-code or x x / v8max x x
+	DEBUG_LOG("Merging instructions " << it->to_string() << " and " << nextIt->to_string() << logging::endl);
+	if(op != nullptr && nextOp != nullptr)
+	{
+		it.reset(new CombinedOperation(it.release()->as<Operation>(), nextIt.release()->as<Operation>()));
+		nextIt.erase();
+		return true;
+	}
+	else if(op != nullptr && nextMove != nullptr)
+	{
+		Operation* newMove = nextMove->combineWith(op->opCode);
+		if(newMove != nullptr)
+		{
+			it.reset(new CombinedOperation(it.release()->as<Operation>(), newMove));
+			nextIt.erase();
+			return true;
+		}
+		logging::warn() << "Error combining move-operation '" << nextMove->to_string() << "' with: " << op->to_string() << logging::endl;
+	}
+	else if(move != nullptr && nextOp != nullptr)
+	{
+		Operation* newMove = move->combineWith(nextOp->opCode);
+		if(newMove != nullptr)
+		{
+			it.reset(new CombinedOperation(newMove, nextIt.release()->as<Operation>()));
+			nextIt.erase();
+			return true;
+		}
+		logging::warn() << "Error combining move-operation '" << move->to_string() << "' with: " << nextOp->to_string() << logging::endl;
+	}
+	else if(move != nullptr && nextMove != nullptr)
+	{
+		Operation* newMove0 = move->combineWith("mul24");
+		Operation* newMove1 = nextMove->combineWith("add");
+		if(newMove0 != nullptr && newMove1 != nullptr)
+		{
+			it.reset(new CombinedOperation(newMove0, newMove1));
+			nextIt.erase();
+			return true;
+		}
+		logging::warn() << "Error combining move-operation '" << move->to_string() << "' with: " << nextMove->to_string() << logging::endl;
+	}
+	else
+		throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled combination, type", (it->to_string() + ", ") + nextIt->to_string());
+	return false;
+}
+
 void optimizations::combineOperations(const Module& module, Method& method, const Configuration& config)
 {
 	//TODO can combine operation x and y if y is something like (result of x & 0xFF/0xFFFF) -> pack-mode
-	for(BasicBlock& bb : method.getBasicBlocks())
+	//only successive instructions within a block are combined, so the blocks can be processed in parallel
+	method.forAllBasicBlocksInParallel([](BasicBlock& bb) -> void
 	{
 		auto it = bb.begin();
 		while(!it.isEndOfBlock() && !it.copy().nextInBlock().isEndOfBlock())
@@ -401,10 +475,7 @@ void optimizations::combineOperations(const Module& module, Method& method, cons
 					 *   otherwise this could cause reading two UNIFORMS at once / writing VPM/VPM_ADDR at once
 					 */
 					//TODO a written-to register MUST not be read in the next instruction (check instruction before/after combined) (unless within local range)
-					bool conditionsMet = std::all_of(mergeConditions.begin(), mergeConditions.end(), [op, nextOp, move, nextMove](const MergeCondition& cond) -> bool
-					{
-						return cond(op, nextOp, move, nextMove);
-					});
+					bool conditionsMet = canCombineInstructions(instr, nextInstr);
 					if(instr->hasValueType(ValueType::LOCAL) && nextInstr->hasValueType(ValueType::LOCAL))
 					{
 						//extra check, only combine writes to the same local, if local is only used within the next instruction
@@ -427,63 +498,21 @@ void optimizations::combineOperations(const Module& module, Method& method, cons
 						}
 					}
 					if(conditionsMet)
-					{
-						//move supports both ADD and MUL ALU
-						//if merge, make "move" to other op-code or x x / v8max x x
-						logging::debug() << "Merging instructions " << instr->to_string() << " and " << nextInstr->to_string() << logging::endl;
-						if(op != nullptr && nextOp != nullptr)
-						{
-							it.reset(new CombinedOperation(dynamic_cast<Operation*>(it.release()), dynamic_cast<Operation*>(nextIt.release())));
-							nextIt.erase();
-						}
-						else if(op != nullptr && nextMove != nullptr)
-						{
-							Operation* newMove = nextMove->combineWith(op->opCode);
-							if(newMove != nullptr)
-							{
-								it.reset(new CombinedOperation(dynamic_cast<Operation*>(it.release()), newMove));
-								nextIt.erase();
-							}
-							else
-								logging::warn() << "Error combining move-operation '" << nextMove->to_string() << "' with: " << op->to_string() << logging::endl;
-						}
-						else if(move != nullptr && nextOp != nullptr)
-						{
-							Operation* newMove = move->combineWith(nextOp->opCode);
-							if(newMove != nullptr)
-							{
-								it.reset(new CombinedOperation(newMove, dynamic_cast<Operation*>(nextIt.release())));
-								nextIt.erase();
-							}
-							else
-								logging::warn() << "Error combining move-operation '" << move->to_string() << "' with: " << nextOp->to_string() << logging::endl;
-						}
-						else if(move != nullptr && nextMove != nullptr)
-						{
-							Operation* newMove0 = move->combineWith("mul24");
-							Operation* newMove1 = nextMove->combineWith("add");
-							if(newMove0 != nullptr && newMove1 != nullptr)
-							{
-								it.reset(new CombinedOperation(newMove0, newMove1));
-								nextIt.erase();
-							}
-							else
-								logging::warn() << "Error combining move-operation '" << move->to_string() << "' with: " << nextMove->to_string() << logging::endl;
-						}
-						else
-							throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled combination, type", (instr->to_string() + ", ") + nextInstr->to_string());
-					}
+						combineWithNextInstruction(it, nextIt);
 				}
 			}
 			it.nextInBlock();
 		}
-	}
+	});
 }
 
 static Optional<Literal> getSourceLiteral(InstructionWalker it)
 {
 	if(it.has<LoadImmediate>())
 	{
+		//the immediate of a per-element load is not the loaded value
+		if(it.get<LoadImmediate>()->type != LoadType::REPLICATE_INT32)
+			return Optional<Literal>(false, 0L);
 		return it.get<LoadImmediate>()->getImmediate();
 	}
 	else if(it.has<MoveOperation>() && it.get<MoveOperation>()->getSource().hasType(ValueType::LITERAL))
@@ -520,13 +549,15 @@ static bool canReplaceLiteralLoad(InstructionWalker it, const InstructionWalker
 
 void optimizations::combineLoadingLiterals(const Module& module, Method& method, const Configuration& config)
 {
-	for(BasicBlock& block : method.getBasicBlocks())
+	//the blocks are processed in parallel, which is safe, since only loads of locals used exclusively within the current block are combined.
+	//This is why the local needs to be checked for being locally limited, before accessing its users
+	method.forAllBasicBlocksInParallel([](BasicBlock& block) -> void
 	{
 		FastMap<long, InstructionWalker> lastLoadImmediate;
 		InstructionWalker it = block.begin();
 		while(!it.isEndOfBlock())
 		{
-			if(it->hasValueType(ValueType::LOCAL) && it->getOutput().get().local->getUsers(LocalUser::Type::WRITER).size() == 1 && block.isLocallyLimited(it, it->getOutput().get().local))
+			if(it->hasValueType(ValueType::LOCAL) && block.isLocallyLimited(it, it->getOutput().get().local) && it->getOutput().get().local->getUsers().getNumWriters() == 1)
 			{
 				Optional<Literal> literal = getSourceLiteral(it);
 				if(literal.hasValue)
@@ -535,7 +566,7 @@ void optimizations::combineLoadingLiterals(const Module& module, Method& method,
 					{
 						Local* oldLocal = it->getOutput().get().local;
 						Local* newLocal = lastLoadImmediate.at(literal.get().integer)->getOutput().get().local;
-						logging::debug() << "Removing duplicate loading of local: " << it->to_string() << logging::endl;
+						DEBUG_LOG("Removing duplicate loading of local: " << it->to_string() << logging::endl);
 						//Local#forUsers can't be used here, since we modify the list of users via LocalUser#replaceLocal
 						FastSet<const LocalUser*> readers = oldLocal->getUsers(LocalUser::Type::READER);
 						for(const LocalUser* reader : readers)
@@ -551,11 +582,240 @@ void optimizations::combineLoadingLiterals(const Module& module, Method& method,
 			}
 			it.nextInBlock();
 		}
+	});
+}
+
+static bool isGroupId(const Local* local)
+{
+	return local->name == Method::GROUP_ID_X || local->name == Method::GROUP_ID_Y || local->name == Method::GROUP_ID_Z;
+}
+
+/*
+ * Whether the value is the same for all work-groups executed in a batched work-group loop
+ */
+static bool isGroupInvariant(const Value& value, const FastSet<const Local*>& hoistedLocals)
+{
+	if(value.hasType(ValueType::LITERAL) || value.hasType(ValueType::SMALL_IMMEDIATE))
+		return true;
+	//registers can change their values (or have side-effects on reading)
+	if(!value.hasType(ValueType::LOCAL))
+		return false;
+	if(hoistedLocals.find(value.local) != hoistedLocals.end())
+		return true;
+	//locals which are not written at all are the parameters and work-item info, which are loaded from UNIFORMs once at the start of the kernel.
+	//Only the group ids change between the work-groups
+	return value.local->getUsers().getNumWriters() == 0 && !isGroupId(value.local);
+}
+
+static void batchWorkGroups(Method& method)
+{
+	/*
+	 * The parameters and work-item info are loaded once at the start of the kernel (see CodeGenerator#generateStartSegment).
+	 * The UNIFORM read afterwards contains the number of additional work-groups to execute.
+	 *
+	 * start:
+	 *   <loading of parameters, inserted by the code-generator>
+	 *   <set-up which is the same for all work-groups>
+	 *   %group_loop_size = uniform
+	 * %group_loop:
+	 *   <kernel code>
+	 *   %loop_condition = %group_loop_size
+	 *   %group_loop_size = %group_loop_size - 1
+	 *   <increment group-ids>
+	 *   br.ifzc %group_loop, %loop_condition
+	 */
+	BasicBlock& startBlock = *method.getBasicBlocks().begin();
+	FastSet<const Local*> hoistedLocals;
+	InstructionWalker insertIt = startBlock.begin().nextInBlock();
+	auto it = insertIt.copy();
+	while(!it.isEndOfBlock())
+	{
+		const IntermediateInstruction* instr = it.get();
+		bool canBeHoisted = instr != nullptr && (instr->kind == InstructionKind::OPERATION || instr->kind == InstructionKind::MOVE || instr->kind == InstructionKind::LOAD_IMMEDIATE) &&
+				instr->conditional == COND_ALWAYS && !instr->hasSideEffects() && instr->hasValueType(ValueType::LOCAL) && instr->getOutput().get().local->getUsers().getNumWriters() == 1;
+		if(canBeHoisted)
+		{
+			for(const Value& arg : instr->getArguments())
+				canBeHoisted = canBeHoisted && isGroupInvariant(arg, hoistedLocals);
+		}
+		if(!canBeHoisted)
+		{
+			it.nextInBlock();
+			continue;
+		}
+		DEBUG_LOG("Moving work-group invariant instruction out of work-group loop: " << it->to_string() << logging::endl);
+		hoistedLocals.emplace(instr->getOutput().get().local);
+		if(it == insertIt)
+		{
+			//already at the right position
+			insertIt.nextInBlock();
+			it.nextInBlock();
+		}
+		else
+		{
+			insertIt.emplace(it.release()).nextInBlock();
+			it.erase();
+		}
 	}
+	DEBUG_LOG("Moved " << hoistedLocals.size() << " work-group invariant instructions out of the work-group loop" << logging::endl);
+
+	const Local* loopSize = method.findOrCreateLocal(TYPE_INT32, Method::GROUP_LOOP_SIZE);
+	insertIt.emplace(new MoveOperation(loopSize->createReference(), UNIFORM_REGISTER));
+	insertIt.nextInBlock();
+	const Local* loopLabel = method.findOrCreateLocal(TYPE_LABEL, "%group_loop");
+	method.emplaceLabel(insertIt, new BranchLabel(*loopLabel));
+
+	const Value loopCondition = method.addNewLocal(TYPE_INT32, "%group_loop_condition");
+	method.appendToEnd(new MoveOperation(loopCondition, loopSize->createReference()));
+	method.appendToEnd(new Operation("sub", loopSize->createReference(), loopSize->createReference(), INT_ONE));
+	//increment the group-id in x-direction and carry the overflow into the next dimensions
+	const Value groupIdX = method.findOrCreateLocal(TYPE_INT32, Method::GROUP_ID_X)->createReference();
+	const Value groupIdY = method.findOrCreateLocal(TYPE_INT32, Method::GROUP_ID_Y)->createReference();
+	const Value groupIdZ = method.findOrCreateLocal(TYPE_INT32, Method::GROUP_ID_Z)->createReference();
+	method.appendToEnd(new Operation("add", groupIdX, groupIdX, INT_ONE));
+	method.appendToEnd(new Operation("xor", NOP_REGISTER, groupIdX, method.findOrCreateLocal(TYPE_INT32, Method::NUM_GROUPS_X)->createReference(), COND_ALWAYS, SetFlag::SET_FLAGS));
+	method.appendToEnd(new MoveOperation(groupIdX, INT_ZERO, COND_ZERO_SET));
+	method.appendToEnd(new Operation("add", groupIdY, groupIdY, INT_ONE, COND_ZERO_SET));
+	method.appendToEnd(new Operation("xor", NOP_REGISTER, groupIdY, method.findOrCreateLocal(TYPE_INT32, Method::NUM_GROUPS_Y)->createReference(), COND_ALWAYS, SetFlag::SET_FLAGS));
+	method.appendToEnd(new MoveOperation(groupIdY, INT_ZERO, COND_ZERO_SET));
+	method.appendToEnd(new Operation("add", groupIdZ, groupIdZ, INT_ONE, COND_ZERO_SET));
+	method.appendToEnd(new Branch(loopLabel, COND_ZERO_CLEAR, loopCondition));
+}
+
+/*
+ * The number of work-items every QPU needs to execute, so the required work-group size fits onto the QPUs.
+ *
+ * This is the smallest divisor of the work-group size, so every QPU executes the same number of work-items.
+ */
+static uint8_t determineWorkItemsPerQPU(const Method& method)
+{
+	auto it = method.metaData.find(MetaDataType::WORK_GROUP_SIZES);
+	if(it == method.metaData.end())
+		return 1;
+	uint32_t workGroupSize = 1;
+	for(const std::string& s : it->second)
+		workGroupSize *= static_cast<uint32_t>(std::max(std::atoi(s.data()), 1));
+	if(workGroupSize <= qpu_asm::KernelInfo::MAX_WORK_GROUP_SIZES)
+		return 1;
+	uint32_t factor = (workGroupSize + qpu_asm::KernelInfo::MAX_WORK_GROUP_SIZES - 1) / qpu_asm::KernelInfo::MAX_WORK_GROUP_SIZES;
+	while(workGroupSize % factor != 0)
+		++factor;
+	//the factor is stored in 7 bits of the kernel-info
+	return factor > 128 ? 0 : static_cast<uint8_t>(factor);
+}
+
+static uint32_t getRequiredLocalSize(const Method& method, const std::size_t dimension)
+{
+	const std::vector<std::string>& sizes = method.metaData.at(MetaDataType::WORK_GROUP_SIZES);
+	return sizes.size() > dimension ? static_cast<uint32_t>(std::max(std::atoi(sizes[dimension].data()), 1)) : 1;
+}
+
+void optimizations::loopWorkItems(const Module& module, Method& method, const Configuration& config)
+{
+	const uint8_t workItemsPerQPU = determineWorkItemsPerQPU(method);
+	if(workItemsPerQPU == 1)
+		return;
+	if(workItemsPerQPU == 0)
+	{
+		logging::warn() << "Work-group size of kernel '" << method.name << "' is too large to be executed in a loop" << logging::endl;
+		return;
+	}
+	/*
+	 * The work-items of a loop iteration can't wait for the work-items of the following iterations on the same QPU,
+	 * so the kernel would need to be split into the regions between the barriers
+	 */
+	bool hasBarrier = false;
+	method.forAllInstructions([&hasBarrier](const IntermediateInstruction* instr) -> void
+	{
+		hasBarrier = hasBarrier || instr->is<SemaphoreAdjustment>();
+	});
+	if(hasBarrier)
+	{
+		logging::warn() << "Kernel '" << method.name << "' with barriers can't execute multiple work-items per QPU" << logging::endl;
+		return;
+	}
+	DEBUG_LOG("Running " << static_cast<unsigned>(workItemsPerQPU) << " work-items per QPU for kernel: " << method.name << logging::endl);
+
+	/*
+	 * Work-Item Loop:
+	 *
+	 * The run-time executes only (work-group size / workItemsPerQPU) QPUs, QPU n starts with the local ids of the work-item with the linear id n * workItemsPerQPU.
+	 * Every QPU runs the kernel for workItemsPerQPU consecutive work-items, the local ids are incremented by the kernel.
+	 *
+	 * start:
+	 *   <loading of parameters, inserted by the code-generator>
+	 *   %work_item_loop_size = workItemsPerQPU - 1
+	 *   %local_ids_start = %local_ids
+	 * %work_item_loop:
+	 *   <kernel code>
+	 *   %loop_condition = %work_item_loop_size
+	 *   %work_item_loop_size = %work_item_loop_size - 1
+	 *   <increment local ids>
+	 *   br.ifzc %work_item_loop, %loop_condition
+	 *   %local_ids = %local_ids_start
+	 */
+	const Local* localIds = method.findLocal(Method::LOCAL_IDS);
+	const bool readsLocalIds = localIds != nullptr && !localIds->getUsers(LocalUser::Type::READER).empty();
+
+	InstructionWalker insertIt = method.walkAllInstructions().nextInBlock();
+	const Value loopSize = method.addNewLocal(TYPE_INT8, "%work_item_loop_size");
+	insertIt.emplace(new MoveOperation(loopSize, Value(Literal(static_cast<long>(workItemsPerQPU - 1)), TYPE_INT8)));
+	insertIt.nextInBlock();
+	Value startIds = UNDEFINED_VALUE;
+	if(readsLocalIds)
+	{
+		startIds = method.addNewLocal(TYPE_INT32, "%local_ids_start");
+		insertIt.emplace(new MoveOperation(startIds, localIds->createReference()));
+		insertIt.nextInBlock();
+	}
+	const Local* loopLabel = method.findOrCreateLocal(TYPE_LABEL, "%work_item_loop");
+	method.emplaceLabel(insertIt, new BranchLabel(*loopLabel));
+
+	//the returns jump to the end of the kernel, which needs to be the end of the loop
+	if(method.findLocal(BasicBlock::LAST_BLOCK) == nullptr)
+		method.appendToEnd(new BranchLabel(*method.findOrCreateLocal(TYPE_LABEL, BasicBlock::LAST_BLOCK)));
+	const Value loopCondition = method.addNewLocal(TYPE_INT8, "%work_item_loop_condition");
+	method.appendToEnd(new MoveOperation(loopCondition, loopSize));
+	method.appendToEnd(new Operation("sub", loopSize, loopSize, INT_ONE));
+	if(readsLocalIds)
+	{
+		//the local ids are stored as bytes within a single value, the overflow of a dimension is carried into the next one
+		const Value ids = localIds->createReference();
+		method.appendToEnd(new Operation("add", ids, ids, INT_ONE));
+		for(std::size_t dim = 0; dim < 2; ++dim)
+		{
+			const long shift = static_cast<long>(dim * 8);
+			const long size = static_cast<long>(getRequiredLocalSize(method, dim));
+			Value dimensionId = ids;
+			if(shift > 0)
+			{
+				dimensionId = method.addNewLocal(TYPE_INT32, "%local_id");
+				method.appendToEnd(new Operation("shr", dimensionId, ids, Value(Literal(shift), TYPE_INT8)));
+			}
+			const Value maskedId = method.addNewLocal(TYPE_INT32, "%local_id");
+			method.appendToEnd(new Operation("and", maskedId, dimensionId, Value(Literal(0xFFL), TYPE_INT8)));
+			method.appendToEnd(new Operation("xor", NOP_REGISTER, maskedId, Value(Literal(size), TYPE_INT32), COND_ALWAYS, SetFlag::SET_FLAGS));
+			//resets the id of this dimension to zero and increments the id of the next dimension
+			method.appendToEnd(new Operation("add", ids, ids, Value(Literal((1L << (shift + 8)) - (size << shift)), TYPE_INT32), COND_ZERO_SET));
+		}
+	}
+	method.appendToEnd(new Branch(loopLabel, COND_ZERO_CLEAR, loopCondition));
+	if(readsLocalIds)
+		//the ids are read again for the next work-group (see #unrollWorkGroups)
+		method.appendToEnd(new MoveOperation(localIds->createReference(), startIds));
+	method.workItemsPerQPU = workItemsPerQPU;
 }
 
 void optimizations::unrollWorkGroups(const Module& module, Method& method, const Configuration& config)
 {
+	//the UNIFORMs can't be re-loaded, if the UNIFORM pointer is modified (e.g. for texture accesses)
+	if(config.batchWorkGroups || periphery::hasTextureAccesses(method))
+	{
+		if(!config.batchWorkGroups)
+			DEBUG_LOG("Kernel '" << method.name << "' modifies the UNIFORM pointer, batching work-groups" << logging::endl);
+		batchWorkGroups(method);
+		return;
+	}
 	/*
 	 * Kernel Loop Optimization:
 	 *
@@ -601,21 +861,104 @@ InstructionWalker optimizations::combineSelectionWithZero(const Module& module,
 	//additionally, one of the moves writes a zero-vale
 	if(move->getSource().hasLiteral(INT_ZERO.literal))
 	{
-		logging::debug() << "Rewriting selection of either zero or " << nextMove->getSource().to_string() << " using only one input" << logging::endl;
+		DEBUG_LOG("Rewriting selection of either zero or " << nextMove->getSource().to_string() << " using only one input" << logging::endl);
 		it.reset((new Operation("xor", move->getOutput(), nextMove->getSource(), nextMove->getSource()))->copyExtrasFrom(move));
 		//to process this instruction again (e.g. loading literals)
 		it.previousInBlock();
 	}
 	else if(nextMove->getSource().hasLiteral(INT_ZERO.literal))
 	{
-		logging::debug() << "Rewriting selection of either " << move->getSource().to_string() << " or zero using only one input" << logging::endl;
+		DEBUG_LOG("Rewriting selection of either " << move->getSource().to_string() << " or zero using only one input" << logging::endl);
 		nextIt.reset((new Operation("xor", nextMove->getOutput(), move->getSource(), move->getSource()))->copyExtrasFrom(nextMove));
 	}
 	return it;
 }
 
+/*
+ * Whether all elements of the value are known to be the same, so rotating it has no effect
+ */
+static bool isSplatValue(const Value& val, const unsigned depth = 0)
+{
+	if(val.isLiteralValue())
+		return true;
+	if(val.hasType(ValueType::REGISTER))
+		//the UNIFORMs are written to all elements, as is the replicated value
+		return val.reg == REG_UNIFORM || val.reg == REG_REPLICATE_ALL;
+	//limit the recursion depth, since every level needs to check the writer
+	if(!val.hasType(ValueType::LOCAL) || depth > 4)
+		return false;
+	const LocalUser* user = val.local->getSingleWriter();
+	const IntermediateInstruction* writer = user != nullptr ? dynamic_cast<const IntermediateInstruction*>(user) : nullptr;
+	if(writer == nullptr || writer->hasConditionalExecution() || writer->hasPackMode() || writer->hasUnpackMode() || writer->firesSignal())
+		return false;
+	if(writer->is<LoadImmediate>())
+		return writer->as<LoadImmediate>()->type == LoadType::REPLICATE_INT32;
+	//rotating a splat value yields the same value
+	if(writer->is<VectorRotation>())
+		return isSplatValue(writer->as<VectorRotation>()->getSource(), depth + 1);
+	//all ALU operations are executed element-wise
+	if(writer->is<MoveOperation>() || writer->is<Operation>())
+	{
+		for(const Value& arg : writer->getArguments())
+		{
+			if(!isSplatValue(arg, depth + 1))
+				return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Whether the value read by the first rotation is still the same when the second rotation is executed
+ */
+static bool isSourceUnchanged(const Value& src, InstructionWalker firstIt, InstructionWalker secondIt)
+{
+	if(src.isLiteralValue())
+		return true;
+	if(!src.hasType(ValueType::LOCAL))
+		return false;
+	if(firstIt.getBasicBlock() == secondIt.getBasicBlock())
+	{
+		//the source must not be re-written between the two rotations
+		firstIt.nextInBlock();
+		while(firstIt != secondIt)
+		{
+			if(firstIt.has() && firstIt->writesLocal(src.local))
+				return false;
+			firstIt.nextInBlock();
+		}
+		return true;
+	}
+	/*
+	 * Across basic blocks, the source needs to be written at most once and before the first rotation in its block.
+	 * Then every path from the first to the second rotation, which re-writes the source (e.g. a loop), also re-executes the first rotation.
+	 */
+	const auto& writers = src.local->getUsers(LocalUser::Type::WRITER);
+	if(writers.empty())
+		//e.g. parameters
+		return true;
+	if(writers.size() != 1)
+		return false;
+	const IntermediateInstruction* writer = dynamic_cast<const IntermediateInstruction*>(*writers.begin());
+	return writer != nullptr && firstIt.getBasicBlock()->findWalkerForInstruction(writer, firstIt).hasValue;
+}
+
 void optimizations::combineVectorRotations(const Module& module, Method& method, const Configuration& config)
 {
+	//the positions of all rotations, since the first rotation of a chain can be in another block
+	FastMap<const VectorRotation*, InstructionWalker> rotations;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		InstructionWalker it = block.begin();
+		while(!it.isEndOfBlock())
+		{
+			if(it.has<VectorRotation>())
+				rotations.emplace(it.get<VectorRotation>(), it);
+			it.nextInBlock();
+		}
+	}
+
 	for(BasicBlock& block : method.getBasicBlocks())
 	{
 		InstructionWalker it = block.begin();
@@ -624,41 +967,50 @@ void optimizations::combineVectorRotations(const Module& module, Method& method,
 			if(it.has<VectorRotation>() && !it->hasSideEffects())
 			{
 				VectorRotation* rot = it.get<VectorRotation>();
-				if(rot->getSource().hasType(ValueType::LOCAL) && rot->getOffset().hasType(ValueType::SMALL_IMMEDIATE) && rot->getOffset().immediate != VECTOR_ROTATE_R5)
+				if(isSplatValue(rot->getSource()))
+				{
+					//rotating a vector with all elements the same has no effect
+					DEBUG_LOG("Replacing rotation of splat value with move: " << rot->to_string() << logging::endl);
+					rotations.erase(rot);
+					it.reset((new MoveOperation(rot->getOutput(), rot->getSource(), rot->conditional))->copyExtrasFrom(rot));
+				}
+				else if(rot->getSource().hasType(ValueType::LOCAL) && rot->getOffset().hasType(ValueType::SMALL_IMMEDIATE) && rot->getOffset().immediate != VECTOR_ROTATE_R5)
 				{
 					const LocalUser* writer = rot->getSource().local->getSingleWriter();
-					if(writer != nullptr)
+					const VectorRotation* firstRot = writer != nullptr ? dynamic_cast<const VectorRotation*>(writer) : nullptr;
+					auto firstIt = firstRot != nullptr ? rotations.find(firstRot) : rotations.end();
+					/*
+					 * Can combine the offsets of two rotations,
+					 * - if the only source of a vector rotation is only written once,
+					 * - the source of the input is another vector rotation,
+					 * - which is the only reader of the first rotation,
+					 * - both rotations only use immediate offsets,
+					 * - the input of the first rotation is not changed in between and
+					 * - neither rotation has any side effects or is executed conditionally
+					 */
+					if(firstIt != rotations.end() && !firstRot->hasSideEffects() && !firstRot->hasConditionalExecution() && !firstRot->hasPackMode() &&
+							firstRot->getOffset().hasType(ValueType::SMALL_IMMEDIATE) && firstRot->getOffset().immediate != VECTOR_ROTATE_R5 &&
+							rot->getSource().local->getUsers(LocalUser::Type::READER).size() == 1 && isSourceUnchanged(firstRot->getSource(), firstIt->second, it))
 					{
-						const VectorRotation* firstRot = dynamic_cast<const VectorRotation*>(writer);
-						if(firstRot != nullptr && !firstRot->hasSideEffects() && firstRot->getOffset().hasType(ValueType::SMALL_IMMEDIATE) && firstRot->getOffset().immediate != VECTOR_ROTATE_R5)
+						const uint8_t offset = (rot->getOffset().immediate.getRotationOffset().get() + firstRot->getOffset().immediate.getRotationOffset().get()) % 16;
+						if(offset == 0)
+						{
+							DEBUG_LOG("Replacing unnecessary vector rotations " << firstRot->to_string() << " and " << rot->to_string() << " with single move" << logging::endl);
+							it.reset((new MoveOperation(rot->getOutput(), firstRot->getSource(), rot->conditional))->copyExtrasFrom(rot));
+						}
+						else
 						{
-							auto firstIt = it.getBasicBlock()->findWalkerForInstruction(firstRot, it);
-							if(firstIt.hasValue)
-							{
-								/*
-								 * Can combine the offsets of two rotations,
-								 * - if the only source of a vector rotation is only written once,
-								 * - the source of the input is another vector rotation,
-								 * - both rotations only use immediate offsets and
-								 * - neither rotation has any side effects
-								 */
-								const uint8_t offset = (rot->getOffset().immediate.getRotationOffset().get() + firstRot->getOffset().immediate.getRotationOffset().get()) % 16;
-								if(offset == 0)
-								{
-									logging::debug() << "Replacing unnecessary vector rotations " << firstRot->to_string() << " and " << rot->to_string() << " with single move" << logging::endl;
-									it.reset((new MoveOperation(rot->getOutput(), firstRot->getSource()))->copyExtrasFrom(rot));
-									it->copyExtrasFrom(firstRot);
-									firstIt.get().erase();
-								}
-								else
-								{
-									logging::debug() << "Combining vector rotations " << firstRot->to_string() << " and " << rot->to_string() << " to a single rotation with offset " << static_cast<unsigned>(offset) << logging::endl;
-									it.reset((new VectorRotation(rot->getOutput(), firstRot->getSource(), Value(SmallImmediate::fromRotationOffset(offset), TYPE_INT8)))->copyExtrasFrom(rot));
-									it->copyExtrasFrom(firstRot);
-									firstIt.get().erase();
-								}
-							}
+							DEBUG_LOG("Combining vector rotations " << firstRot->to_string() << " and " << rot->to_string() << " to a single rotation with offset " << static_cast<unsigned>(offset) << logging::endl);
+							it.reset((new VectorRotation(rot->getOutput(), firstRot->getSource(), Value(SmallImmediate::fromRotationOffset(offset), TYPE_INT8), rot->conditional))->copyExtrasFrom(rot));
+							rotations.emplace(it.get<VectorRotation>(), it);
 						}
+						rotations.erase(rot);
+						InstructionWalker eraseIt = firstIt->second;
+						rotations.erase(firstIt);
+						eraseIt.erase();
+						if(offset != 0)
+							//the combined rotation might read its source too far from its write to be mapped to an accumulator
+							moveRotationSourcesToAccumulators(module, method, it, config);
 					}
 				}
 			}
@@ -666,3 +1018,368 @@ void optimizations::combineVectorRotations(const Module& module, Method& method,
 		}
 	}
 }
+
+/*
+ * How the pack- and unpack-modes interpret the values of an ALU operation,
+ * e.g. the 16-bit modes convert from/to half-floats for floating-point operations, but from/to 16-bit integers for integer operations
+ */
+enum class ALUValueKind
+{
+	OTHER,
+	INTEGER,
+	FLOAT
+};
+
+static ALUValueKind getValueKind(const IntermediateInstruction* instr)
+{
+	if(instr == nullptr || instr->is<VectorRotation>())
+		return ALUValueKind::OTHER;
+	//moves are executed as "or" (or "v8min")
+	if(instr->is<MoveOperation>())
+		return ALUValueKind::INTEGER;
+	const Operation* op = instr->as<Operation>();
+	if(op == nullptr)
+		return ALUValueKind::OTHER;
+	for(const char* opCode : {"fadd", "fsub", "fmul", "fmin", "fmax", "fminabs", "fmaxabs"})
+	{
+		if(op->opCode.compare(opCode) == 0)
+			return ALUValueKind::FLOAT;
+	}
+	for(const char* opCode : {"add", "sub", "shr", "asr", "ror", "shl", "min", "max", "and", "or", "xor", "not", "clz", "mul24"})
+	{
+		if(op->opCode.compare(opCode) == 0)
+			return ALUValueKind::INTEGER;
+	}
+	//the conversions and the v8 operations are not handled
+	return ALUValueKind::OTHER;
+}
+
+static Optional<long> getIntegerConstant(const Value& val)
+{
+	if(val.hasType(ValueType::LITERAL))
+		return Optional<long>(true, val.literal.integer);
+	if(val.hasType(ValueType::SMALL_IMMEDIATE) && val.immediate.getIntegerValue())
+		return Optional<long>(true, static_cast<long>(val.immediate.getIntegerValue().get()));
+	if(val.hasType(ValueType::LOCAL) && val.local->getSingleWriter() != nullptr)
+	{
+		//literals not fitting into a small immediate are loaded into a local
+		const IntermediateInstruction* writer = dynamic_cast<const IntermediateInstruction*>(val.local->getSingleWriter());
+		if(writer != nullptr && writer->is<LoadImmediate>() && writer->as<LoadImmediate>()->type == LoadType::REPLICATE_INT32 && !writer->hasConditionalExecution() && !writer->hasPackMode())
+			return Optional<long>(true, writer->as<LoadImmediate>()->getImmediate().integer);
+	}
+	return {};
+}
+
+static bool isSimpleOperation(const IntermediateInstruction* instr)
+{
+	return instr != nullptr && !instr->hasConditionalExecution() && !instr->hasSideEffects() && !instr->hasPackMode() && !instr->hasUnpackMode() && instr->hasValueType(ValueType::LOCAL);
+}
+
+/*
+ * Returns the single local input of the move or "fmul x, 1.0" only converting a value via its pack- or unpack-mode
+ */
+static Optional<Value> getConvertedValue(const IntermediateInstruction* instr)
+{
+	if(instr == nullptr || instr->hasConditionalExecution() || instr->hasSideEffects() || !instr->hasValueType(ValueType::LOCAL) || instr->hasPackMode() == instr->hasUnpackMode())
+		return NO_VALUE;
+	if(instr->is<MoveOperation>() && !instr->is<VectorRotation>() && instr->as<MoveOperation>()->getSource().hasType(ValueType::LOCAL))
+		return instr->as<MoveOperation>()->getSource();
+	const Operation* op = instr->as<Operation>();
+	if(op != nullptr && op->opCode.compare("fmul") == 0 && op->getFirstArg().hasType(ValueType::LOCAL) && op->getSecondArg() && op->getSecondArg().get().hasLiteral(Literal(1.0)))
+		return op->getFirstArg();
+	return NO_VALUE;
+}
+
+static bool isAccessedBetween(const Local* local, InstructionWalker start, const IntermediateInstruction* end, bool onlyWrites)
+{
+	for(start.nextInBlock(); !start.isEndOfBlock() && start.get() != end; start.nextInBlock())
+	{
+		if(start.get() != nullptr && (start->writesLocal(local) || (!onlyWrites && start->readsLocal(local))))
+			return true;
+	}
+	return false;
+}
+
+static bool isReadByVectorRotation(const Local* local)
+{
+	for(const LocalUser* reader : local->getUsers(LocalUser::Type::READER))
+	{
+		if(dynamic_cast<const VectorRotation*>(reader) != nullptr)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Rewrites the zero-extension of 8-bit integers ("and %out, %in, 0xFF") and the sign-extension of 16-bit integers
+ * ("shl %tmp, %in, 16" + "asr %out, %tmp, 16") to a move with the corresponding unpack-mode
+ */
+static bool rewriteExtension(InstructionWalker it)
+{
+	Operation* op = it.get<Operation>();
+	if(!isSimpleOperation(op) || !op->getSecondArg())
+		return false;
+	if(op->opCode.compare("and") == 0)
+	{
+		for(std::size_t i = 0; i < 2; ++i)
+		{
+			const Value& src = op->getArguments()[i];
+			const Optional<long> mask = getIntegerConstant(op->getArguments()[1 - i]);
+			if(src.hasType(ValueType::LOCAL) && mask && mask.get() == 0xFF && !isReadByVectorRotation(src.local))
+			{
+				DEBUG_LOG("Rewriting zero-extension to move with unpack-mode: " << op->to_string() << logging::endl);
+				it.reset((new MoveOperation(op->getOutput(), src))->copyExtrasFrom(op)->setUnpackMode(UNPACK_CHAR_TO_INT));
+				return true;
+			}
+		}
+	}
+	else if(op->opCode.compare("asr") == 0 && op->getFirstArg().hasType(ValueType::LOCAL))
+	{
+		const Optional<long> offset = getIntegerConstant(op->getSecondArg());
+		const LocalUser* writer = op->getFirstArg().local->getSingleWriter();
+		const Operation* shift = writer != nullptr ? dynamic_cast<const Operation*>(writer) : nullptr;
+		if(!offset || (offset.get() & 31) != 16 || !isSimpleOperation(shift) || shift->opCode.compare("shl") != 0 || !shift->getSecondArg() ||
+				op->getFirstArg().local->getUsers(LocalUser::Type::READER).size() != 1)
+			return false;
+		const Optional<long> shiftOffset = getIntegerConstant(shift->getSecondArg());
+		const Value src = shift->getFirstArg();
+		if(!shiftOffset || (shiftOffset.get() & 31) != 16 || !src.hasType(ValueType::LOCAL) || isReadByVectorRotation(src.local))
+			return false;
+		Optional<InstructionWalker> shiftIt = it.getBasicBlock()->findWalkerForInstruction(shift, it);
+		if(!shiftIt || isAccessedBetween(src.local, shiftIt.get(), op, true))
+			return false;
+		DEBUG_LOG("Rewriting sign-extension to move with unpack-mode: " << shift->to_string() << " and " << op->to_string() << logging::endl);
+		it.reset((new MoveOperation(op->getOutput(), src))->copyExtrasFrom(op)->setUnpackMode(UNPACK_SHORT_TO_INT));
+		shiftIt.get().erase();
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Moves the unpack-mode of a converting instruction into the only instruction consuming its result
+ */
+static bool foldUnpackIntoConsumer(InstructionWalker it, const Value& src)
+{
+	const IntermediateInstruction* converter = it.get();
+	const Local* result = converter->getOutput().get().local;
+	const auto readers = result->getUsers(LocalUser::Type::READER);
+	if(readers.size() != 1 || isReadByVectorRotation(src.local))
+		return false;
+	InstructionWalker consumerIt = it.copy().nextInBlock();
+	while(!consumerIt.isEndOfBlock() && consumerIt.get() != *readers.begin())
+		consumerIt.nextInBlock();
+	if(consumerIt.isEndOfBlock())
+		return false;
+	IntermediateInstruction* consumer = consumerIt.get();
+	if(getValueKind(consumer) != getValueKind(converter) || consumer->hasUnpackMode() || isAccessedBetween(src.local, it, consumer, true))
+		return false;
+	//the unpack-mode is applied to all inputs read from register-file A, so the other inputs must not be locals
+	Optional<std::size_t> index;
+	for(std::size_t i = 0; i < consumer->getArguments().size(); ++i)
+	{
+		const Value& arg = consumer->getArguments()[i];
+		if(arg.hasType(ValueType::LOCAL) || arg.hasType(ValueType::REGISTER))
+		{
+			if(index || !arg.hasType(ValueType::LOCAL) || arg.local != result)
+				return false;
+			index = Optional<std::size_t>(true, i);
+		}
+	}
+	if(!index)
+		return false;
+	DEBUG_LOG("Folding unpack-mode of " << converter->to_string() << " into: " << consumer->to_string() << logging::endl);
+	consumer->setArgument(index.get(), Value(src.local, consumer->getArguments()[index.get()].type));
+	consumer->setUnpackMode(converter->unpackMode);
+	it.erase();
+	return true;
+}
+
+/*
+ * Moves the pack-mode of a converting instruction into the only instruction producing its input
+ */
+static bool foldPackIntoProducer(InstructionWalker it, const Value& src)
+{
+	const IntermediateInstruction* converter = it.get();
+	const LocalUser* writer = src.local->getSingleWriter();
+	IntermediateInstruction* producer = writer != nullptr ? dynamic_cast<IntermediateInstruction*>(const_cast<LocalUser*>(writer)) : nullptr;
+	if(producer == nullptr || src.local->getUsers(LocalUser::Type::READER).size() != 1 || getValueKind(producer) != getValueKind(converter))
+		return false;
+	if(producer->hasConditionalExecution() || producer->setFlags == SetFlag::SET_FLAGS || producer->hasPackMode() || !producer->hasValueType(ValueType::LOCAL))
+		return false;
+	const Local* result = converter->getOutput().get().local;
+	Optional<InstructionWalker> producerIt = it.getBasicBlock()->findWalkerForInstruction(producer, it);
+	if(!producerIt || isAccessedBetween(result, producerIt.get(), converter, false))
+		return false;
+	DEBUG_LOG("Folding pack-mode of " << converter->to_string() << " into: " << producer->to_string() << logging::endl);
+	producer->setOutput(converter->getOutput());
+	producer->setPackMode(converter->packMode);
+	producer->decoration = add_flag(producer->decoration, converter->decoration);
+	it.erase();
+	return true;
+}
+
+void optimizations::foldPackModes(const Module& module, Method& method, const Configuration& config)
+{
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		//skip the label
+		InstructionWalker it = block.begin().nextInBlock();
+		while(!it.isEndOfBlock())
+		{
+			//the extension is rewritten in-place, so it can be folded right away
+			if(it.get() != nullptr)
+				rewriteExtension(it);
+			const Optional<Value> src = getConvertedValue(it.get());
+			InstructionWalker prev = it.copy().previousInBlock();
+			if(src && it->hasUnpackMode() && foldUnpackIntoConsumer(it, src.get()))
+				it = prev;
+			else if(src && it->hasPackMode() && foldPackIntoProducer(it, src.get()))
+				it = prev;
+			it.nextInBlock();
+		}
+	}
+}
+
+/*
+ * Whether the operation gives the same result for the elements combined in any order, which is not the case for floating-point additions and multiplications
+ * (due to the rounding of the intermediate results), unless fast math is allowed
+ */
+static bool isReductionOperation(const Operation* op, const Configuration& config)
+{
+	if(op->getArguments().size() != 2 || op->hasConditionalExecution() || op->hasSideEffects() || op->hasPackMode() || op->hasUnpackMode() || !op->hasValueType(ValueType::LOCAL))
+		return false;
+	if(op->opCode == "fadd" || op->opCode == "fmul")
+		return config.mathType == MathType::FAST;
+	return op->opCode == "add" || op->opCode == "and" || op->opCode == "or" || op->opCode == "xor" || op->opCode == "min" || op->opCode == "max" ||
+			op->opCode == "fmin" || op->opCode == "fmax";
+}
+
+/*
+ * Collects the operands combined by the tree of operations with the same op-code, whose intermediate results are only used within the tree
+ */
+static void collectReductionOperands(const Operation* op, const Configuration& config, FastSet<const IntermediateInstruction*>& tree, std::vector<Value>& operands)
+{
+	for(const Value& arg : op->getArguments())
+	{
+		const Operation* argOp = arg.hasType(ValueType::LOCAL) && arg.local->getUsers(LocalUser::Type::READER).size() == 1 ? dynamic_cast<const Operation*>(arg.local->getSingleWriter()) : nullptr;
+		if(argOp != nullptr && argOp->opCode == op->opCode && isReductionOperation(argOp, config) && operands.size() < NATIVE_VECTOR_SIZE && tree.emplace(argOp).second)
+			collectReductionOperands(argOp, config, tree, operands);
+		else
+			operands.push_back(arg);
+	}
+}
+
+/*
+ * Returns the index of the element extracted from the vector, if the value is the only use of the extraction of a single element
+ */
+static Optional<unsigned> getExtractedElement(const Value& value, const Value& vector)
+{
+	if(!value.hasType(ValueType::LOCAL) || value.local->getUsers(LocalUser::Type::READER).size() != 1)
+		return {};
+	const MoveOperation* move = dynamic_cast<const MoveOperation*>(value.local->getSingleWriter());
+	if(move == nullptr || move->hasConditionalExecution() || move->hasSideEffects() || move->hasPackMode() || move->hasUnpackMode() || move->getSource() != vector)
+		return {};
+	const VectorRotation* rotation = dynamic_cast<const VectorRotation*>(move);
+	if(rotation == nullptr)
+		//the first element is extracted with a simple move
+		return 0u;
+	if(!rotation->getOffset().hasType(ValueType::SMALL_IMMEDIATE) || rotation->getOffset().immediate == VECTOR_ROTATE_R5)
+		return {};
+	//the element is rotated down into the first element, i.e. rotated up by the remaining elements
+	return static_cast<unsigned>((NATIVE_VECTOR_SIZE - rotation->getOffset().immediate.getRotationOffset().get()) % NATIVE_VECTOR_SIZE);
+}
+
+/*
+ * Replaces the combination of all elements of a vector extracted one by one (e.g. the sum of the elements calculated by dot()) with log2(N) steps of rotating the vector
+ * down by half the remaining elements and combining it with the not rotated vector. The first element then contains the combination of all elements.
+ */
+static bool combineReduction(Method& method, InstructionWalker it, const Configuration& config)
+{
+	const Operation* root = it.get<Operation>();
+	if(root == nullptr || !isReductionOperation(root, config) || root->getOutput().get().type.getVectorWidth() != 1)
+		return false;
+	FastSet<const IntermediateInstruction*> tree;
+	std::vector<Value> operands;
+	collectReductionOperands(root, config, tree, operands);
+	const unsigned numElements = static_cast<unsigned>(operands.size());
+	//only the complete vectors with a power of two elements can be halved in every step
+	if(numElements < 2 || numElements > NATIVE_VECTOR_SIZE || (numElements & (numElements - 1)) != 0 || !operands.front().hasType(ValueType::LOCAL))
+		return false;
+	const MoveOperation* firstExtraction = dynamic_cast<const MoveOperation*>(operands.front().local->getSingleWriter());
+	if(firstExtraction == nullptr || !firstExtraction->getSource().hasType(ValueType::LOCAL))
+		return false;
+	const Value vector = firstExtraction->getSource();
+	if(vector.type.getVectorWidth() != numElements || vector.local->getUsers().getNumWriters() > 1)
+		return false;
+	std::vector<bool> extractedElements(numElements, false);
+	for(const Value& operand : operands)
+	{
+		const Optional<unsigned> element = getExtractedElement(operand, vector);
+		if(!element || element.get() >= numElements || extractedElements[element.get()])
+			return false;
+		extractedElements[element.get()] = true;
+		tree.emplace(dynamic_cast<const IntermediateInstruction*>(operand.local->getSingleWriter()));
+	}
+
+	//all extractions and operations need to precede the combination within this block, without the vector being written in between
+	std::size_t numFound = 0;
+	const LocalUser* vectorWriter = vector.local->getSingleWriter();
+	for(auto pos = it.copy().previousInBlock(); numFound < tree.size() && !pos.isStartOfBlock(); pos.previousInBlock())
+	{
+		if(pos.get() == vectorWriter)
+			return false;
+		if(tree.find(pos.get()) != tree.end())
+			++numFound;
+	}
+	if(numFound != tree.size())
+		return false;
+
+	DEBUG_LOG("Combining reduction of " << numElements << " elements of " << vector.to_string() << " into " << root->to_string() << logging::endl);
+	const std::string opCode = root->opCode;
+	Value partial = vector;
+	for(unsigned step = numElements / 2; step > 0; step /= 2)
+	{
+		const Value rotated = method.addNewLocal(vector.type, "%reduction");
+		it = insertVectorRotation(it, partial, Value(Literal(static_cast<long>(step)), TYPE_INT8), rotated, Direction::DOWN);
+		if(step == 1)
+			it.reset((new Operation(opCode, root->getOutput().get(), partial, rotated))->copyExtrasFrom(root));
+		else
+		{
+			const Value combined = method.addNewLocal(vector.type, "%reduction");
+			it.emplace(new Operation(opCode, combined, partial, rotated));
+			it.nextInBlock();
+			partial = combined;
+		}
+	}
+	//the extractions and the combining operations are only used by the replaced combination
+	auto pos = it.copy().previousInBlock();
+	while(!tree.empty() && !pos.isStartOfBlock())
+	{
+		if(tree.erase(pos.get()) == 0)
+		{
+			pos.previousInBlock();
+			continue;
+		}
+		const bool isRotation = pos.has<VectorRotation>();
+		pos.erase().previousInBlock();
+		//the delay inserted before the rotation is not required anymore either
+		if(isRotation && pos.has<Nop>() && pos.get<Nop>()->type == DelayType::WAIT_REGISTER)
+			pos.erase().previousInBlock();
+	}
+	return true;
+}
+
+void optimizations::combineVectorReductions(const Module& module, Method& method, const Configuration& config)
+{
+	std::size_t numReductions = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.has<Operation>() && combineReduction(method, it, config))
+				++numReductions;
+		}
+	}
+	DEBUG_LOG("Combined " << numReductions << " reductions of vector elements" << logging::endl);
+}
@@ -23,6 +23,18 @@ namespace vc4c
 		 * Combine ALU-instructions which (can) use different ALUs into a single instruction accessing both ALUs
 		 */
 		void combineOperations(const Module& module, Method& method, const Configuration& config);
+		/*
+		 * Checks whether the two (independent) instructions can be executed within a single instruction accessing both ALUs,
+		 * e.g. they use different ALUs (moves can be executed on either ALU), at most 2 inputs and the same small immediate, signal and pack-mode.
+		 *
+		 * NOTE: This does not check the surrounding instructions (e.g. vector rotations reading one of the results in the next instruction)
+		 */
+		bool canCombineInstructions(const intermediate::IntermediateInstruction* first, const intermediate::IntermediateInstruction* second);
+		/*
+		 * Replaces the instruction and the (combinable, see #canCombineInstructions) next instruction with a single instruction accessing both ALUs,
+		 * returns whether the instructions were combined
+		 */
+		bool combineWithNextInstruction(InstructionWalker it, InstructionWalker nextIt);
 
 		/*
 		 * Combines the loading of the same literal within a small range in basic blocks
@@ -33,9 +45,20 @@ namespace vc4c
 		 * Adds a branch from the end to the start to allow for running several kernels (from several work-groups) in one execution.
 		 * Since the kernels have different group-IDs, all instructions (including loading of parameters) are repeated.
 		 * Otherwise, all parameters would need to reserve their registers over the whole range of the program, which would fail a lot of kernels.
+		 *
+		 * If Configuration#batchWorkGroups is set, the parameters are loaded only once, the set-up which is the same for all work-groups is moved out of the loop
+		 * and the group ids are incremented by the kernel, so only a single UNIFORM (the number of additional work-groups) is read for all work-groups.
 		 */
 		void unrollWorkGroups(const Module& module, Method& method, const Configuration& config);
 
+		/*
+		 * Wraps the kernel into a loop over several work-items, if the required work-group size exceeds the number of QPUs.
+		 * Every QPU then executes several consecutive work-items and increments the local ids itself (see Method#workItemsPerQPU).
+		 *
+		 * Kernels with barriers are not supported, since the work-items executed by a single QPU can't wait for each other.
+		 */
+		void loopWorkItems(const Module& module, Method& method, const Configuration& config);
+
 		/*
 		 * Prepares selections (successive writes to same value with inverted conditions) which write to a local, have no side-effects and one of the sources is zero
 		 * for combination, by rewriting the zero-write to xor-ing the other value
@@ -43,9 +66,24 @@ namespace vc4c
 		InstructionWalker combineSelectionWithZero(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
 
 		/*
-		 * Combines vector several consecutive rotations with the same data
+		 * Combines vector several consecutive rotations with the same data (also across basic blocks) and replaces rotations of vectors with all elements the same
+		 * (e.g. literals, UNIFORMs and values calculated from them) with moves
 		 */
 		void combineVectorRotations(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Replaces the combination (e.g. sum, minimum, maximum) of all elements of a vector extracted one by one with log2(N) steps rotating the vector down
+		 * by half of the remaining elements and combining it with itself, e.g. 4 instead of 15 rotations and 15 operations for a 16-element vector.
+		 *
+		 * Floating-point additions and multiplications are only re-ordered for fast math.
+		 */
+		void combineVectorReductions(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Folds type conversions into the pack- and unpack-modes of the instructions producing/consuming the converted value,
+		 * e.g. the zero-extension of 8-bit and sign-extension of 16-bit integers as well as conversions from/to half-floats
+		 */
+		void foldPackModes(const Module& module, Method& method, const Configuration& config);
 	}
 }
 #endif /* COMBINER_H */
@@ -0,0 +1,621 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "ControlFlow.h"
+#include "Instrumentation.h"
+#include "../InstructionWalker.h"
+#include "../intermediate/IntermediateInstruction.h"
+#include "../analysis/AnalysisManager.h"
+#include "../Logging.h"
+
+#include <algorithm>
+
+using namespace vc4c;
+using namespace vc4c::optimizations;
+using namespace vc4c::intermediate;
+
+/*
+ * The maximum number of instructions of a block to be executed conditionally.
+ * A branch costs the flag set-up, the branch itself and 3 delay slots, so executing more instructions than that for all work-items is not faster.
+ */
+static constexpr std::size_t MAX_CONVERTED_INSTRUCTIONS = 6;
+/*
+ * The cost of a conditional branch (setting the flags, the branch and the 3 delay slots) in instructions, used to weigh the measured branch probabilities
+ */
+static constexpr std::size_t BRANCH_COST = 5;
+//the upper limit for the number of converted instructions of blocks measured to be executed almost always
+static constexpr std::size_t MAX_CONVERTED_PROFILED_INSTRUCTIONS = 16;
+
+/*
+ * Whether the instruction can be executed conditionally (or speculatively) within the preceding block
+ */
+static bool canBeConverted(const IntermediateInstruction* instr, const Value& condition)
+{
+	if(!instr->is<Operation>() && !instr->is<MoveOperation>() && !instr->is<LoadImmediate>())
+		return false;
+	//the flags are set once for all instructions, which therefore can't be conditional themselves
+	if(instr->hasSideEffects() || instr->conditional != COND_ALWAYS)
+		return false;
+	if(!instr->getOutput() || !instr->getOutput().get().hasType(ValueType::LOCAL))
+		return false;
+	//the condition is still checked by the branches afterwards
+	return !condition.hasLocal(instr->getOutput().get().local);
+}
+
+/*
+ * Whether the local is only used within the converted block, so it can be written unconditionally
+ */
+static bool isLocalToBlock(const Local* local, const FastSet<const LocalUser*>& blockInstructions)
+{
+	const auto& users = local->getUsers();
+	if(users.getNumWriters() != 1)
+		return false;
+	for(const auto& user : users)
+	{
+		if(blockInstructions.find(user.first) == blockInstructions.end())
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Replaces the two complementary branches to the same block with a single unconditional branch
+ */
+static void mergeBranches(BasicBlock& block)
+{
+	InstructionWalker first = block.end().previousInBlock();
+	InstructionWalker second = first.copy().previousInBlock();
+	if(!first.has<Branch>() || !second.has<Branch>() || second.copy().previousInBlock().has<Branch>())
+		return;
+	const Branch* firstBranch = first.get<const Branch>();
+	const Branch* secondBranch = second.get<const Branch>();
+	if(firstBranch->getTarget() != secondBranch->getTarget() || firstBranch->getCondition() != secondBranch->getCondition() || !firstBranch->conditional.isInversionOf(secondBranch->conditional))
+		return;
+	const Local* target = firstBranch->getTarget();
+	second.reset(new Branch(target, COND_ALWAYS, BOOL_TRUE));
+	first.erase();
+}
+
+/*
+ * Determines the maximum number of instructions to convert from the block-profile (see Configuration#blockProfile), if the executions of both blocks are measured.
+ *
+ * With the successor executed for the fraction p of the executions of the block, converting N instructions costs N + 1 instructions for every execution of the block,
+ * while the branch costs the branch itself and the branch back for p of the executions: BRANCH_COST * (1 + p) + p * N.
+ * Thus, converting pays off for N <= (BRANCH_COST * (1 + p) - 1) / (1 - p)
+ */
+static std::size_t getMaxConvertedInstructions(Method& method, const BasicBlock& block, const BasicBlock& successor, const Configuration& config)
+{
+	const Optional<uint64_t> blockCount = getExecutionCount(method, block, config);
+	const Optional<uint64_t> successorCount = getExecutionCount(method, successor, config);
+	if(!blockCount || !successorCount || blockCount.get() == 0)
+		return MAX_CONVERTED_INSTRUCTIONS;
+	const double probability = std::min(1.0, static_cast<double>(successorCount.get()) / static_cast<double>(blockCount.get()));
+	if(probability >= 1.0)
+		return MAX_CONVERTED_PROFILED_INSTRUCTIONS;
+	const double limit = (static_cast<double>(BRANCH_COST) * (1.0 + probability) - 1.0) / (1.0 - probability);
+	return std::min(MAX_CONVERTED_PROFILED_INSTRUCTIONS, static_cast<std::size_t>(limit));
+}
+
+static bool convertBlock(Method& method, const analysis::ControlFlowGraph& cfg, BasicBlock& block, BasicBlock& successor, const Configuration& config)
+{
+	if(&successor == &block || cfg.getPredecessors(successor).size() != 1 || cfg.getSuccessors(successor).size() != 1)
+		return false;
+	const analysis::CFGPredecessor& edge = cfg.getPredecessors(successor).front();
+	if(edge.isFallThrough || edge.block != &block)
+		return false;
+	BasicBlock* nextBlock = cfg.getSuccessors(successor).front();
+	const Branch* branch = edge.branch.get<const Branch>();
+	const Value condition = branch->getCondition();
+	//the instructions are executed per SIMD element, in contrast to branches on all elements
+	if(branch->conditional == COND_ALWAYS || nextBlock == &successor || !condition.hasType(ValueType::LOCAL) || has_flag(branch->decoration, InstructionDecorations::BRANCH_ON_ALL_ELEMENTS))
+		return false;
+
+	const std::size_t maxInstructions = getMaxConvertedInstructions(method, block, successor, config);
+	FastSet<const LocalUser*> blockInstructions;
+	for(auto it = successor.begin().nextInBlock(); !it.isEndOfBlock(); it.nextInBlock())
+	{
+		if(it.get() == nullptr)
+			continue;
+		if(it.has<Branch>())
+		{
+			//the branch to the single successor
+			if(!it.get<Branch>()->isUnconditional())
+				return false;
+			continue;
+		}
+		if(!canBeConverted(it.get(), condition) || blockInstructions.size() == maxInstructions)
+			return false;
+		blockInstructions.emplace(it.get());
+	}
+	//a branch only checks the first element of the condition, so only scalar values can be written depending on the per-element flags
+	for(auto it = successor.begin().nextInBlock(); !it.isEndOfBlock(); it.nextInBlock())
+	{
+		if(it.get() == nullptr || it.has<Branch>())
+			continue;
+		const Local* out = it->getOutput().get().local;
+		if(!isLocalToBlock(out, blockInstructions) && !out->type.isScalarType())
+			return false;
+	}
+
+	DEBUG_LOG("Converting branch '" << branch->to_string() << "' to conditional execution of " << blockInstructions.size() << " instructions" << logging::endl);
+	//the instructions are inserted before the outgoing branches
+	InstructionWalker insertIt = block.end();
+	while(insertIt.copy().previousInBlock().has<Branch>())
+		insertIt.previousInBlock();
+	bool flagsSet = false;
+	for(auto it = successor.begin().nextInBlock(); !it.isEndOfBlock();)
+	{
+		if(it.get() == nullptr || it.has<Branch>())
+		{
+			it.nextInBlock();
+			continue;
+		}
+		//values calculated only for the converted block can be calculated for all elements, all other values are only written if the branch would have been taken
+		if(!isLocalToBlock(it->getOutput().get().local, blockInstructions))
+		{
+			if(!flagsSet)
+			{
+				insertIt.emplace(new MoveOperation(NOP_REGISTER, condition, COND_ALWAYS, SetFlag::SET_FLAGS)).nextInBlock();
+				flagsSet = true;
+			}
+			it->setCondition(branch->conditional);
+		}
+		insertIt.emplace(it.release()).nextInBlock();
+		it.erase();
+	}
+	//the converted block is not reachable anymore, the branch directly skips it
+	InstructionWalker branchIt = edge.branch;
+	branchIt.reset((new Branch(nextBlock->getLabel()->getLabel(), branch->conditional, condition))->copyExtrasFrom(branch));
+	mergeBranches(block);
+	return true;
+}
+
+void optimizations::convertIfsToConditionals(const Module& module, Method& method, const Configuration& config)
+{
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	std::size_t numConverted = 0;
+	bool changed = true;
+	//converting a block can enable the conversion of the other side of an if-else construct
+	while(changed)
+	{
+		changed = false;
+		for(BasicBlock& block : method.getBasicBlocks())
+		{
+			//the successors are modified by the conversion
+			const std::vector<BasicBlock*> successors = cfg.getSuccessors(block);
+			for(BasicBlock* successor : successors)
+			{
+				if(convertBlock(method, cfg, block, *successor, config))
+				{
+					changed = true;
+					++numConverted;
+					break;
+				}
+			}
+		}
+	}
+	DEBUG_LOG("Converted " << numConverted << " branches to conditional execution" << logging::endl);
+}
+
+static BasicBlock* getBlockBefore(Method& method, const BasicBlock& block)
+{
+	BasicBlock* previousBlock = nullptr;
+	for(BasicBlock& bb : method.getBasicBlocks())
+	{
+		if(&bb == &block)
+			break;
+		previousBlock = &bb;
+	}
+	return previousBlock;
+}
+
+/*
+ * Whether the block is measured to be never executed and can be moved, since the control-flow neither falls through into it nor out of it
+ */
+static bool isMovableColdBlock(Method& method, const analysis::ControlFlowGraph& cfg, BasicBlock& block, const BasicBlock* lastBlock, const BasicBlock* blockBeforeLast, const Configuration& config)
+{
+	const Optional<uint64_t> count = getExecutionCount(method, block, config);
+	if(!count || count.get() != 0)
+		return false;
+	//the block directly before the end of the kernel is already in place
+	if(&block == &method.getBasicBlocks().front() || &block == lastBlock || &block == blockBeforeLast || block.fallsThroughToNextBlock())
+		return false;
+	const std::vector<analysis::CFGPredecessor> predecessors = cfg.getPredecessors(block);
+	return std::none_of(predecessors.begin(), predecessors.end(), [](const analysis::CFGPredecessor& edge) -> bool { return edge.isFallThrough; });
+}
+
+void optimizations::moveColdBlocks(const Module& module, Method& method, const Configuration& config)
+{
+	if(config.blockProfile.empty())
+		return;
+	//the code-generator appends the end of the kernel to the last block, so the cold blocks are inserted before it
+	const Local* lastLabel = method.findLocal(BasicBlock::LAST_BLOCK);
+	BasicBlock* lastBlock = lastLabel == nullptr ? nullptr : method.findBasicBlock(lastLabel);
+	if(lastBlock == nullptr)
+		return;
+	std::vector<BasicBlock*> coldBlocks;
+	{
+		const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+		const BasicBlock* blockBeforeLast = getBlockBefore(method, *lastBlock);
+		for(BasicBlock& block : method.getBasicBlocks())
+		{
+			if(isMovableColdBlock(method, cfg, block, lastBlock, blockBeforeLast, config))
+				coldBlocks.push_back(&block);
+		}
+	}
+
+	for(BasicBlock* block : coldBlocks)
+	{
+		DEBUG_LOG("Moving block never executed according to the block-profile to the end of the kernel: " << block->getLabel()->to_string() << logging::endl);
+		//the block falling through to the end of the kernel needs to jump over the moved blocks
+		BasicBlock* previousBlock = getBlockBefore(method, *lastBlock);
+		if(previousBlock != nullptr && previousBlock->fallsThroughToNextBlock())
+			previousBlock->end().emplace(new Branch(lastLabel, COND_ALWAYS, BOOL_TRUE));
+
+		const Local* coldLabel = method.addNewLocal(TYPE_LABEL, "%cold_block").local;
+		InstructionWalker insertIt = method.emplaceLabel(lastBlock->begin(), new BranchLabel(*coldLabel)).nextInBlock();
+		//all predecessors jump to the block, so they can jump to the moved copy instead
+		const std::vector<analysis::CFGPredecessor> predecessors = method.getAnalyses().getControlFlowGraph().getPredecessors(*block);
+		for(const analysis::CFGPredecessor& edge : predecessors)
+		{
+			const Branch* branch = edge.branch.get<const Branch>();
+			InstructionWalker branchIt = edge.branch;
+			branchIt.reset((new Branch(coldLabel, branch->conditional, branch->getCondition()))->copyExtrasFrom(branch));
+		}
+		//the original block only keeps its label and is never reached
+		for(auto it = block->begin().nextInBlock(); !it.isEndOfBlock();)
+		{
+			if(it.get() != nullptr)
+				insertIt.emplace(it.release()).nextInBlock();
+			it.erase();
+		}
+	}
+	if(!coldBlocks.empty())
+		DEBUG_LOG("Moved " << coldBlocks.size() << " cold blocks to the end of the kernel" << logging::endl);
+}
+
+/*
+ * Without a block-profile, the blocks of a loop are assumed to be executed this many times as often as the blocks around the loop
+ */
+static constexpr double LOOP_FREQUENCY_FACTOR = 8.0;
+
+/*
+ * A control-flow edge considered for placing the target directly after the source
+ */
+struct PlacementEdge
+{
+	BasicBlock* source;
+	BasicBlock* target;
+	double weight;
+	bool isFallThrough;
+	std::size_t sourcePosition;
+};
+
+/*
+ * The measured execution count of the block, or an estimated frequency from the number of loops containing the block
+ */
+static double estimateFrequency(Method& method, const BasicBlock& block, const analysis::LoopAnalysis& loops, const Configuration& config)
+{
+	const Optional<uint64_t> count = getExecutionCount(method, block, config);
+	if(count)
+		return static_cast<double>(count.get());
+	double frequency = 1.0;
+	for(const analysis::Loop& loop : loops.getLoops())
+	{
+		if(loop.contains(block))
+			frequency *= LOOP_FREQUENCY_FACTOR;
+	}
+	return frequency;
+}
+
+/*
+ * Removes the unconditional branch at the end of the block, if it jumps to the block placed directly after it.
+ * A conditional branch to the next block directly followed by an unconditional branch is inverted to jump to the target of the unconditional branch instead.
+ */
+static bool removeBranchToNextBlock(BasicBlock& block, const BasicBlock* nextBlock)
+{
+	if(nextBlock == nullptr)
+		return false;
+	InstructionWalker it = block.end();
+	do
+	{
+		it.previousInBlock();
+	}
+	while(!it.isStartOfBlock() && (!it.has() || it.has<Nop>()));
+	const Branch* lastBranch = it.get<const Branch>();
+	if(lastBranch == nullptr || !lastBranch->isUnconditional())
+		return false;
+	const Local* nextLabel = nextBlock->getLabel()->getLabel();
+	if(lastBranch->getTarget() == nextLabel)
+	{
+		it.erase();
+		return true;
+	}
+	InstructionWalker previousIt = it.copy().previousInBlock();
+	const Branch* previousBranch = previousIt.get<const Branch>();
+	//the inverted condition of a branch depending on all elements would depend on any element
+	if(previousBranch == nullptr || previousBranch->isUnconditional() || previousBranch->getTarget() != nextLabel ||
+			has_flag(previousBranch->decoration, InstructionDecorations::BRANCH_ON_ALL_ELEMENTS))
+		return false;
+	IntermediateInstruction* invertedBranch = new Branch(lastBranch->getTarget(), previousBranch->conditional.invert(), previousBranch->getCondition());
+	invertedBranch->setDecorations(previousBranch->decoration);
+	previousIt.reset(invertedBranch);
+	it.erase();
+	return true;
+}
+
+void optimizations::placeBasicBlocks(const Module& module, Method& method, const Configuration& config)
+{
+	RandomModificationList<BasicBlock>& blocks = method.getBasicBlocks();
+	if(blocks.size() < 3)
+		return;
+	//the kernel starts with the first block and the code-generator appends the end of the kernel to the last block
+	BasicBlock* const firstBlock = &blocks.front();
+	BasicBlock* const lastBlock = &blocks.back();
+
+	FastMap<const BasicBlock*, std::size_t> positions;
+	FastMap<const BasicBlock*, double> frequencies;
+	FastMap<const BasicBlock*, BasicBlock*> fallThroughSuccessors;
+	std::vector<PlacementEdge> edges;
+	{
+		const analysis::LoopAnalysis& loops = method.getAnalyses().getLoops();
+		const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+		for(BasicBlock& block : blocks)
+		{
+			const std::size_t position = positions.size();
+			positions.emplace(&block, position);
+			frequencies.emplace(&block, estimateFrequency(method, block, loops, config));
+		}
+		for(BasicBlock& block : blocks)
+		{
+			for(const analysis::CFGPredecessor& edge : cfg.getPredecessors(block))
+			{
+				if(edge.isFallThrough)
+					fallThroughSuccessors.emplace(edge.block, &block);
+				//the edge can be executed at most as often as the less frequent of its blocks
+				edges.push_back(PlacementEdge{edge.block, &block, std::min(frequencies.at(edge.block), frequencies.at(&block)), edge.isFallThrough, positions.at(edge.block)});
+			}
+		}
+	}
+	//the most frequent edges are placed first, on ties the existing fall-throughs are kept
+	std::stable_sort(edges.begin(), edges.end(), [](const PlacementEdge& e1, const PlacementEdge& e2) -> bool
+	{
+		if(e1.weight != e2.weight)
+			return e1.weight > e2.weight;
+		if(e1.isFallThrough != e2.isFallThrough)
+			return e1.isFallThrough;
+		return e1.sourcePosition < e2.sourcePosition;
+	});
+
+	//the chains of blocks placed directly after each other, every block starts in its own chain
+	std::vector<std::vector<BasicBlock*>> chains;
+	FastMap<const BasicBlock*, std::size_t> chainIndices;
+	for(BasicBlock& block : blocks)
+	{
+		chainIndices.emplace(&block, chains.size());
+		chains.push_back({&block});
+	}
+	for(const PlacementEdge& edge : edges)
+	{
+		const std::size_t sourceChain = chainIndices.at(edge.source);
+		const std::size_t targetChain = chainIndices.at(edge.target);
+		if(sourceChain == targetChain || chains[sourceChain].back() != edge.source || chains[targetChain].front() != edge.target ||
+				edge.target == firstBlock || edge.source == lastBlock)
+			continue;
+		for(BasicBlock* block : chains[targetChain])
+			chainIndices[block] = sourceChain;
+		chains[sourceChain].insert(chains[sourceChain].end(), chains[targetChain].begin(), chains[targetChain].end());
+		chains[targetChain].clear();
+	}
+
+	//the chain starting the kernel is placed first and the chain ending it last, the other chains by their frequency
+	const std::size_t firstChain = chainIndices.at(firstBlock);
+	const std::size_t lastChain = chainIndices.at(lastBlock);
+	std::vector<std::size_t> chainOrder;
+	for(std::size_t i = 0; i < chains.size(); ++i)
+	{
+		if(!chains[i].empty() && i != firstChain && i != lastChain)
+			chainOrder.push_back(i);
+	}
+	std::stable_sort(chainOrder.begin(), chainOrder.end(), [&chains, &frequencies](std::size_t c1, std::size_t c2) -> bool
+	{
+		return frequencies.at(chains[c1].front()) > frequencies.at(chains[c2].front());
+	});
+	chainOrder.insert(chainOrder.begin(), firstChain);
+	if(lastChain != firstChain)
+		chainOrder.push_back(lastChain);
+
+	std::vector<BasicBlock*> order;
+	order.reserve(blocks.size());
+	for(std::size_t chain : chainOrder)
+		order.insert(order.end(), chains[chain].begin(), chains[chain].end());
+	bool isUnchanged = true;
+	for(std::size_t i = 0; i < order.size(); ++i)
+		isUnchanged = isUnchanged && positions.at(order[i]) == i;
+	if(isUnchanged)
+		return;
+
+	//the blocks are moved in the list, so the references to them stay valid
+	FastMap<const BasicBlock*, RandomModificationList<BasicBlock>::iterator> blockIterators;
+	for(auto it = blocks.begin(); it != blocks.end(); ++it)
+		blockIterators.emplace(&*it, it);
+	for(BasicBlock* block : order)
+		blocks.splice(blocks.end(), blocks, blockIterators.at(block));
+	//the control-flow graph only tracks the insertion of blocks
+	method.getAnalyses().invalidate();
+
+	std::size_t numInserted = 0;
+	std::size_t numRemoved = 0;
+	for(auto blockIt = blocks.begin(); blockIt != blocks.end(); ++blockIt)
+	{
+		auto nextIt = blockIt;
+		++nextIt;
+		BasicBlock* nextBlock = nextIt == blocks.end() ? nullptr : &*nextIt;
+		auto fallThroughIt = fallThroughSuccessors.find(&*blockIt);
+		if(fallThroughIt != fallThroughSuccessors.end() && fallThroughIt->second != nextBlock)
+		{
+			//the block previously fell through to a block now placed elsewhere
+			blockIt->end().emplace(new Branch(fallThroughIt->second->getLabel()->getLabel(), COND_ALWAYS, BOOL_TRUE));
+			++numInserted;
+		}
+		if(removeBranchToNextBlock(*blockIt, nextBlock))
+			++numRemoved;
+	}
+	method.getAnalyses().invalidate();
+	DEBUG_LOG("Placed basic blocks by their execution frequency, removing " << numRemoved << " and inserting " << numInserted << " branches" << logging::endl);
+}
+
+/*
+ * The size of an unconditional branch (the branch and its 3 delay slots) in instructions
+ */
+static constexpr std::size_t BRANCH_SIZE = 4;
+
+/*
+ * Whether both instructions are identical and can therefore be replaced by a single instruction executed for both
+ */
+static bool isSameInstruction(const IntermediateInstruction* first, const IntermediateInstruction* second)
+{
+	if(first == nullptr || second == nullptr || first->kind != second->kind)
+		return false;
+	if(!first->is<Operation>() && !first->is<MoveOperation>() && !first->is<LoadImmediate>() && !first->is<Nop>())
+		return false;
+	if(first->signal != second->signal || first->unpackMode != second->unpackMode || first->packMode != second->packMode || first->conditional != second->conditional ||
+			first->setFlags != second->setFlags || first->decoration != second->decoration || first->getArguments() != second->getArguments())
+		return false;
+	if(static_cast<bool>(first->getOutput()) != static_cast<bool>(second->getOutput()) || (first->getOutput() && first->getOutput().get() != second->getOutput().get()))
+		return false;
+	if(first->is<Operation>())
+		return first->as<const Operation>()->opCode == second->as<const Operation>()->opCode;
+	if(first->is<LoadImmediate>())
+		return first->as<const LoadImmediate>()->type == second->as<const LoadImmediate>()->type && first->as<const LoadImmediate>()->getImmediate() == second->as<const LoadImmediate>()->getImmediate();
+	if(first->is<Nop>())
+		return first->as<const Nop>()->type == second->as<const Nop>()->type;
+	return true;
+}
+
+/*
+ * Returns the instructions before the unconditional branch ending the block, from the last to the first.
+ * The list is empty, if the block does not end with the given branch
+ */
+static std::vector<InstructionWalker> getTailInstructions(InstructionWalker branch)
+{
+	std::vector<InstructionWalker> tail;
+	auto it = branch.copy().nextInBlock();
+	while(!it.isEndOfBlock() && !it.has())
+		it.nextInBlock();
+	if(!it.isEndOfBlock() || !branch.get<const Branch>()->isUnconditional())
+		return tail;
+	it = branch.copy().previousInBlock();
+	while(!it.isStartOfBlock())
+	{
+		if(it.has())
+		{
+			if(it.has<Branch>() || it.has<BranchLabel>())
+				break;
+			tail.push_back(it);
+		}
+		it.previousInBlock();
+	}
+	return tail;
+}
+
+static std::size_t getCommonTailLength(const std::vector<InstructionWalker>& first, const std::vector<InstructionWalker>& second)
+{
+	std::size_t length = 0;
+	while(length < first.size() && length < second.size() && isSameInstruction(first[length].get(), second[length].get()))
+		++length;
+	return length;
+}
+
+/*
+ * Moves the identical instructions at the end of several predecessors of the block into a new block placed directly before it.
+ * Returns the number of instructions removed
+ */
+static std::size_t mergeTailsOfPredecessors(Method& method, BasicBlock& block)
+{
+	std::vector<BasicBlock*> predecessors;
+	std::vector<std::vector<InstructionWalker>> tails;
+	for(const analysis::CFGPredecessor& edge : method.getAnalyses().getControlFlowGraph().getPredecessors(block))
+	{
+		if(edge.isFallThrough || edge.block == &block || std::find(predecessors.begin(), predecessors.end(), edge.block) != predecessors.end())
+			continue;
+		std::vector<InstructionWalker> tail = getTailInstructions(edge.branch);
+		if(tail.empty())
+			continue;
+		predecessors.push_back(edge.block);
+		tails.push_back(std::move(tail));
+	}
+	//the method starts with its first block, so no block can be inserted before it
+	if(predecessors.size() < 2 || &block == &method.getBasicBlocks().front())
+		return 0;
+
+	//selects the group of predecessors sharing the tail removing the most instructions
+	std::size_t bestSavings = 0;
+	std::size_t bestLength = 0;
+	std::vector<std::size_t> bestGroup;
+	for(std::size_t i = 0; i < tails.size(); ++i)
+	{
+		std::vector<std::pair<std::size_t, std::size_t>> lengths;
+		for(std::size_t j = 0; j < tails.size(); ++j)
+		{
+			const std::size_t length = i == j ? tails[i].size() : getCommonTailLength(tails[i], tails[j]);
+			if(length > 0)
+				lengths.emplace_back(length, j);
+		}
+		std::sort(lengths.begin(), lengths.end(), std::greater<std::pair<std::size_t, std::size_t>>());
+		for(std::size_t n = 2; n <= lengths.size(); ++n)
+		{
+			const std::size_t length = lengths[n - 1].first;
+			if(length * (n - 1) > bestSavings)
+			{
+				bestSavings = length * (n - 1);
+				bestLength = length;
+				bestGroup.clear();
+				for(std::size_t k = 0; k < n; ++k)
+					bestGroup.push_back(lengths[k].second);
+			}
+		}
+	}
+	//the block previously falling through to the block would fall through to the merged tail and needs to jump over it
+	BasicBlock* previousBlock = getBlockBefore(method, block);
+	const bool needsBranchOverTail = previousBlock != nullptr && previousBlock->fallsThroughToNextBlock();
+	if(bestSavings == 0 || (needsBranchOverTail && bestSavings <= BRANCH_SIZE))
+		return 0;
+
+	DEBUG_LOG("Merging the common tail of " << bestGroup.size() << " predecessors of " << block.getLabel()->to_string() << " with " << bestLength << " instructions" << logging::endl);
+	if(needsBranchOverTail)
+		previousBlock->end().emplace(new Branch(block.getLabel()->getLabel(), COND_ALWAYS, BOOL_TRUE));
+
+	const Local* tailLabel = method.addNewLocal(TYPE_LABEL, "%merged_tail").local;
+	InstructionWalker insertIt = method.emplaceLabel(block.begin(), new BranchLabel(*tailLabel)).nextInBlock();
+	std::vector<InstructionWalker>& firstTail = tails[bestGroup.front()];
+	for(std::size_t k = bestLength; k > 0; --k)
+		insertIt.emplace(firstTail[k - 1].release()).nextInBlock();
+	for(std::size_t index : bestGroup)
+	{
+		for(std::size_t k = 0; k < bestLength; ++k)
+			tails[index][k].erase();
+		//the branch is the last instruction of the predecessor
+		InstructionWalker branchIt = predecessors[index]->end().previousInBlock();
+		while(!branchIt.has())
+			branchIt.previousInBlock();
+		branchIt.reset((new Branch(tailLabel, COND_ALWAYS, BOOL_TRUE))->copyExtrasFrom(branchIt.get()));
+	}
+	method.getAnalyses().invalidate();
+	return needsBranchOverTail ? bestSavings - BRANCH_SIZE : bestSavings;
+}
+
+void optimizations::mergeTailBlocks(const Module& module, Method& method, const Configuration& config)
+{
+	std::vector<BasicBlock*> blocks;
+	for(BasicBlock& block : method.getBasicBlocks())
+		blocks.push_back(&block);
+	std::size_t numRemoved = 0;
+	for(BasicBlock* block : blocks)
+		numRemoved += mergeTailsOfPredecessors(method, *block);
+	method.cleanEmptyInstructions();
+	DEBUG_LOG("Merged the common tails of blocks, removing " << numRemoved << " instructions" << logging::endl);
+}
@@ -0,0 +1,45 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef OPTIMIZATION_CONTROL_FLOW_H
+#define OPTIMIZATION_CONTROL_FLOW_H
+
+#include <config.h>
+#include "../Module.h"
+
+namespace vc4c
+{
+	namespace optimizations
+	{
+		/*
+		 * Replaces conditional branches to small blocks without side-effects (e.g. the sides of if-else constructs) with the conditionally executed instructions of these blocks.
+		 * The instructions are moved into the block branching to them, the branch then directly jumps to the block following the converted block.
+		 */
+		void convertIfsToConditionals(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Moves the blocks measured to be never executed (see Configuration#blockProfile) to the end of the kernel,
+		 * so the frequently executed code is contiguous and the branches around the cold code fall through instead.
+		 * Only blocks which are only reached and left via branches are moved, the branches to them are redirected to the moved copy
+		 */
+		void moveColdBlocks(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Re-orders the basic blocks, so the most frequently taken successor of a block (from the block-profile, if any, or estimated from the loops) is placed directly after it.
+		 * The unconditional branches to the block now following are removed (saving the branch and its 3 delay slots), the blocks no longer falling through to their successor jump to it instead.
+		 * The first and last block of the kernel stay in place
+		 */
+		void placeBasicBlocks(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Moves identical instructions at the end of several blocks jumping to the same block (e.g. the copies for phi-nodes) into a single new block placed before it,
+		 * which all of these blocks jump to instead. This reduces the code size at the cost of possibly one more branch, so it is only run when optimizing for size.
+		 */
+		void mergeTailBlocks(const Module& module, Method& method, const Configuration& config);
+	}
+}
+
+#endif /* OPTIMIZATION_CONTROL_FLOW_H */
@@ -5,12 +5,17 @@
  */
 
 #include "Eliminator.h"
-#include "log.h"
+#include "../Logging.h"
 #include "../InstructionWalker.h"
+#include "../analysis/AnalysisManager.h"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
 #include <map>
 #include <list>
+#include <set>
 
 using namespace vc4c;
 using namespace vc4c::optimizations;
@@ -42,10 +47,10 @@ void optimizations::eliminateDeadStore(const Module& module, Method& method, con
                 {
                     //b) never read at all
                 	//must check from the start, because in SPIR-V, locals can be read before they are written to (e.g. in phi-node and branch backwards)
-                    bool isRead = !dest->getUsers(LocalUser::Type::READER).empty();
+                    bool isRead = dest->getUsers().getNumReaders() > 0;
                     if(!isRead)
                     {
-                        logging::debug() << "Removing instruction " << instr->to_string() << ", since its output is never read" << logging::endl;
+                        DEBUG_LOG("Removing instruction " << instr->to_string() << ", since its output is never read" << logging::endl);
                         it.erase();
                         //if we removed this instruction, maybe the previous one can be removed too??
                         it.previousInBlock();
@@ -55,7 +60,7 @@ void optimizations::eliminateDeadStore(const Module& module, Method& method, con
             }
 			if(move != nullptr)
 			{
-				if(move->getSource().hasType(ValueType::LOCAL) && move->getOutput().get().hasType(ValueType::LOCAL) && !move->hasConditionalExecution() && !move->hasPackMode() && !move->hasSideEffects() && dynamic_cast<intermediate::VectorRotation*>(move) == nullptr)
+				if(move->getSource().hasType(ValueType::LOCAL) && move->getOutput().get().hasType(ValueType::LOCAL) && !move->hasConditionalExecution() && !move->hasPackMode() && !move->hasSideEffects() && !move->is<intermediate::VectorRotation>())
 				{
 					//if for a move, neither the input-local nor the output-local are written to afterwards,
 					//XXX or the input -local is only written after the last use of the output-local
@@ -64,11 +69,11 @@ void optimizations::eliminateDeadStore(const Module& module, Method& method, con
 					const Local* inLoc = move->getSource().local;
 					const Local* outLoc = move->getOutput().get().local;
 					//for instruction added by phi-elimination, the result could have been written to (with a different source) previously, so check
-					bool isWrittenTo = !outLoc->getUsers(LocalUser::Type::WRITER).empty();
+					bool isWrittenTo = outLoc->getUsers().getNumWriters() > 0;
 					if(!isWrittenTo && inLoc->type == outLoc->type)
 					{
 						//TODO what if both locals are written before (and used differently), possible??
-						logging::debug() << "Merging locals " << inLoc->to_string() << " and " <<  outLoc->to_string() << " since they contain the same value" << logging::endl;
+						DEBUG_LOG("Merging locals " << inLoc->to_string() << " and " <<  outLoc->to_string() << " since they contain the same value" << logging::endl);
 						outLoc->forUsers(LocalUser::Type::READER, [inLoc, outLoc](const LocalUser* instr) -> void
 						{
 							//change outLoc to inLoc
@@ -122,7 +127,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					   || opCodes.first == OPADD_SUB || opCodes.first == OPADD_XOR))
 					{
 						//any of these instructions do exactly nothing if the second argument is zero
-						logging::debug() << "Removing obsolete " << op->to_string() << logging::endl;
+						DEBUG_LOG("Removing obsolete " << op->to_string() << logging::endl);
 						it.erase();
 						//don't skip next instruction
 						it.previousInBlock();
@@ -130,7 +135,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					else if(op->getSecondArg().get().hasLiteral(Literal(0.0)) && (opCodes.first == OPADD_FADD || opCodes.first == OPADD_FSUB))
 					{
 						//any of these instructions do exactly nothing if the second argument is zero
-						logging::debug() << "Removing obsolete " << op->to_string() << logging::endl;
+						DEBUG_LOG("Removing obsolete " << op->to_string() << logging::endl);
 						it.erase();
 						//don't skip next instruction
 						it.previousInBlock();
@@ -138,7 +143,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					else if(op->getSecondArg().get().hasLiteral(Literal(0L)) && (opCodes.second == OPMUL_MUL24))
 					{
 						//any of these instructions do exactly nothing if the second argument is one
-						logging::debug() << "Removing obsolete " << op->to_string() << logging::endl;
+						DEBUG_LOG("Removing obsolete " << op->to_string() << logging::endl);
 						it.erase();
 						//don't skip next instruction
 						it.previousInBlock();
@@ -146,7 +151,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					else if(op->getSecondArg().get().hasLiteral(Literal(0xFFFFFFFFUL)) && (opCodes.first == OPADD_AND))
 					{
 						//and all bits set doesn't do anything useful
-						logging::debug() << "Removing obsolete " << op->to_string() << logging::endl;
+						DEBUG_LOG("Removing obsolete " << op->to_string() << logging::endl);
 						it.erase();
 						//don't skip next instruction
 						it.previousInBlock();
@@ -164,7 +169,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					   || opCodes.first == OPADD_SHL || opCodes.first == OPADD_SHR || opCodes.first == OPADD_XOR))
 					{
 						//any of these instructions do exactly nothing if the first argument is zero
-						logging::debug() << "Removing obsolete " << op->to_string() << logging::endl;
+						DEBUG_LOG("Removing obsolete " << op->to_string() << logging::endl);
 						it.erase();
 						//don't skip next instruction
 						it.previousInBlock();
@@ -172,7 +177,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					else if(op->getFirstArg().hasLiteral(Literal(0.0)) && (opCodes.first == OPADD_FADD))
 					{
 						//any of these instructions do exactly nothing if the first argument is zero
-						logging::debug() << "Removing obsolete " << op->to_string() << logging::endl;
+						DEBUG_LOG("Removing obsolete " << op->to_string() << logging::endl);
 						it.erase();
 						//don't skip next instruction
 						it.previousInBlock();
@@ -180,7 +185,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					else if(op->getFirstArg().hasLiteral(Literal(0L)) && (opCodes.second == OPMUL_MUL24))
 					{
 						//any of these instructions do exactly nothing if the first argument is one
-						logging::debug() << "Removing obsolete " << op->to_string() << logging::endl;
+						DEBUG_LOG("Removing obsolete " << op->to_string() << logging::endl);
 						it.erase();
 						//don't skip next instruction
 						it.previousInBlock();
@@ -188,7 +193,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					else if(op->getFirstArg().hasLiteral(Literal(0xFFFFFFFFUL)) && (opCodes.first == OPADD_AND))
 					{
 						//and all bits set doesn't do anything useful
-						logging::debug() << "Removing obsolete " << op->to_string() << logging::endl;
+						DEBUG_LOG("Removing obsolete " << op->to_string() << logging::endl);
 						it.erase();
 						//don't skip next instruction
 						it.previousInBlock();
@@ -206,19 +211,19 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					   || opCodes.first == OPADD_FADD || opCodes.first == OPADD_FSUB))
 					{
 						//any of these instructions do exactly nothing if the second argument is zero
-						logging::debug() << "Replacing obsolete " << op->to_string() << " with move" << logging::endl;
+						DEBUG_LOG("Replacing obsolete " << op->to_string() << " with move" << logging::endl);
 						it.reset(new intermediate::MoveOperation(op->getOutput().get(), op->getFirstArg(), op->conditional, op->setFlags));
 					}
 					else if(op->getSecondArg().get().hasLiteral(Literal(0L)) && (opCodes.second == OPMUL_MUL24))
 					{
 						//any of these instructions do exactly nothing if the second argument is one
-						logging::debug() << "Replacing obsolete " << op->to_string() << " with move" << logging::endl;
+						DEBUG_LOG("Replacing obsolete " << op->to_string() << " with move" << logging::endl);
 						it.reset(new intermediate::MoveOperation(op->getOutput().get(), op->getFirstArg(), op->conditional, op->setFlags));
 					}
 					else if(op->getSecondArg().get().hasLiteral(Literal(0xFFFFFFFFUL)) && (opCodes.first == OPADD_AND))
 					{
 						//and all bits set doesn't do anything useful
-						logging::debug() << "Replacing obsolete " << op->to_string() << " with move" << logging::endl;
+						DEBUG_LOG("Replacing obsolete " << op->to_string() << " with move" << logging::endl);
 						it.reset(new intermediate::MoveOperation(op->getOutput().get(), op->getFirstArg(), op->conditional, op->setFlags));
 					}
 				}
@@ -230,19 +235,19 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 					   || opCodes.first == OPADD_SHL || opCodes.first == OPADD_SHR || opCodes.first == OPADD_XOR))
 					{
 						//any of these instructions do exactly nothing if the first argument is zero
-						logging::debug() << "Replacing obsolete " << op->to_string() << " with move" << logging::endl;
+						DEBUG_LOG("Replacing obsolete " << op->to_string() << " with move" << logging::endl);
 						it.reset(new intermediate::MoveOperation(op->getOutput().get(), op->getSecondArg(), op->conditional, op->setFlags));
 					}
 					else if(op->getFirstArg().hasLiteral(Literal(0L)) && (opCodes.second == OPMUL_MUL24))
 					{
 						//any of these instructions do exactly nothing if the first argument is one
-						logging::debug() << "Replacing obsolete " << op->to_string() << " with move" << logging::endl;
+						DEBUG_LOG("Replacing obsolete " << op->to_string() << " with move" << logging::endl);
 						it.reset(new intermediate::MoveOperation(op->getOutput().get(), op->getSecondArg(), op->conditional, op->setFlags));
 					}
 					else if(op->getFirstArg().hasLiteral(Literal(0xFFFFFFFFUL)) && (opCodes.first == OPADD_AND))
 					{
 						//and all bits set doesn't do anything useful
-						logging::debug() << "Replacing obsolete " << op->to_string() << " with move" << logging::endl;
+						DEBUG_LOG("Replacing obsolete " << op->to_string() << " with move" << logging::endl);
 						it.reset(new intermediate::MoveOperation(op->getOutput().get(), op->getSecondArg(), op->conditional, op->setFlags));
 					}
 				}
@@ -255,7 +260,7 @@ InstructionWalker optimizations::eliminateUselessInstruction(const Module& modul
 		if(move->getSource() == move->getOutput().get() && !move->hasSideEffects() && !move->hasPackMode() && !move->hasUnpackMode() && !it.has<intermediate::VectorRotation>())
 		{
 			//skip copying to same, if no flags/signals/pack and unpack-modes are set
-			logging::debug() << "Removing obsolete " << move->to_string() << logging::endl;
+			DEBUG_LOG("Removing obsolete " << move->to_string() << logging::endl);
 			it.erase();
 			//don't skip next instruction
 			it.previousInBlock();
@@ -280,7 +285,7 @@ InstructionWalker optimizations::eliminateUselessBranch(const Module& module, Me
 			{
 				if(label->getLabel() == branch->getTarget())
 				{
-					logging::debug() << "Removing branch to next instruction: " << branch->to_string() << logging::endl;
+					DEBUG_LOG("Removing branch to next instruction: " << branch->to_string() << logging::endl);
 					it = it.erase();
 					//don't skip next instruction
 					it.previousInMethod();
@@ -291,6 +296,209 @@ InstructionWalker optimizations::eliminateUselessBranch(const Module& module, Me
 	return it;
 }
 
+/*
+ * The 32-bit representation of the elements of a vector literal, folded element-wise in plain arrays instead of via the Value and Literal objects
+ */
+using VectorBits = std::array<uint32_t, NATIVE_VECTOR_SIZE>;
+
+/*
+ * Reads the elements of a container of literals (or a scalar literal used for all elements) into the array
+ */
+static bool toVectorBits(const Value& val, const std::size_t numElements, VectorBits& bits)
+{
+	bits.fill(0);
+	if(val.hasType(ValueType::LITERAL))
+	{
+		bits.fill(val.literal.toImmediate());
+		return true;
+	}
+	if(!val.hasType(ValueType::CONTAINER) || val.container.elements.size() != numElements)
+		return false;
+	for(std::size_t i = 0; i < numElements; ++i)
+	{
+		const Value& element = val.container.elements[i];
+		if(!element.hasType(ValueType::LITERAL))
+			return false;
+		bits[i] = element.literal.toImmediate();
+	}
+	return true;
+}
+
+//the QPU flushes denormal inputs and results to zero
+static float toQPUFloat(const uint32_t bits)
+{
+	const float val = bit_cast<uint32_t, float>(bits);
+	return std::fpclassify(val) == FP_SUBNORMAL ? std::copysign(0.0f, val) : val;
+}
+
+static uint32_t fromQPUFloat(const float val)
+{
+	return bit_cast<float, uint32_t>(std::fpclassify(val) == FP_SUBNORMAL ? std::copysign(0.0f, val) : val);
+}
+
+/*
+ * Applies the operation to all elements. The loop runs over the full native vector (the unused elements are zero),
+ * so the compiler can vectorize it for the host
+ */
+template<typename Func>
+static void foldElements(VectorBits& result, const VectorBits& first, const VectorBits& second, Func&& func)
+{
+	for(std::size_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+		result[i] = func(first[i], second[i]);
+}
+
+/*
+ * Calculates the operation on vector literals with the semantics of the QPU (e.g. 32-bit wrap-around, 24-bit multiplication and flushing denormal floats).
+ *
+ * Only operations of the QPU on 32-bit elements are folded, since the upper bits of narrower types are not defined by the hardware
+ */
+static Optional<Value> foldVectorOperation(const intermediate::Operation& op)
+{
+	const Value& firstArg = op.getFirstArg();
+	const Value secondArg = op.getSecondArg() ? op.getSecondArg().get() : UNDEFINED_VALUE;
+	if(!firstArg.hasType(ValueType::CONTAINER) && !secondArg.hasType(ValueType::CONTAINER))
+		return NO_VALUE;
+	if(op.hasPackMode() || !op.getOutput())
+		return NO_VALUE;
+	const DataType type = firstArg.hasType(ValueType::CONTAINER) ? firstArg.type : secondArg.type;
+	const std::size_t numElements = firstArg.hasType(ValueType::CONTAINER) ? firstArg.container.elements.size() : secondArg.container.elements.size();
+	if(type.getScalarBitCount() != 32 || type.isPointerType() || numElements == 0 || numElements > NATIVE_VECTOR_SIZE)
+		return NO_VALUE;
+
+	VectorBits first;
+	VectorBits second;
+	if(!toVectorBits(firstArg, numElements, first) || (op.getSecondArg() && !toVectorBits(secondArg, numElements, second)))
+		return NO_VALUE;
+	if(!op.getSecondArg())
+		second.fill(0);
+
+	VectorBits result;
+	bool isFloatResult = false;
+	bool isValid = true;
+	const std::pair<OpAdd, OpMul> opCodes = toOpCode(op.opCode);
+	if(opCodes.second != OPMUL_NOP)
+	{
+		switch(opCodes.second.opCode)
+		{
+			case OPMUL_FMUL.opCode:
+				isFloatResult = true;
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return fromQPUFloat(toQPUFloat(a) * toQPUFloat(b));});
+				break;
+			case OPMUL_MUL24.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return (a & 0xFFFFFF) * (b & 0xFFFFFF);});
+				break;
+			default:
+				return NO_VALUE;
+		}
+	}
+	else
+	{
+		switch(opCodes.first.opCode)
+		{
+			case OPADD_FADD.opCode:
+				isFloatResult = true;
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return fromQPUFloat(toQPUFloat(a) + toQPUFloat(b));});
+				break;
+			case OPADD_FSUB.opCode:
+				isFloatResult = true;
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return fromQPUFloat(toQPUFloat(a) - toQPUFloat(b));});
+				break;
+			case OPADD_FMIN.opCode:
+				isFloatResult = true;
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return fromQPUFloat(std::min(toQPUFloat(a), toQPUFloat(b)));});
+				break;
+			case OPADD_FMAX.opCode:
+				isFloatResult = true;
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return fromQPUFloat(std::max(toQPUFloat(a), toQPUFloat(b)));});
+				break;
+			case OPADD_FMINABS.opCode:
+				isFloatResult = true;
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return fromQPUFloat(std::min(std::abs(toQPUFloat(a)), std::abs(toQPUFloat(b))));});
+				break;
+			case OPADD_FMAXABS.opCode:
+				isFloatResult = true;
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return fromQPUFloat(std::max(std::abs(toQPUFloat(a)), std::abs(toQPUFloat(b))));});
+				break;
+			case OPADD_FTOI.opCode:
+				//the behavior of the hardware for values not fitting into an integer is not known, so they are not folded
+				foldElements(result, first, second, [&isValid](uint32_t a, uint32_t b) -> uint32_t
+				{
+					const float val = toQPUFloat(a);
+					isValid = isValid && std::isfinite(val) && std::abs(val) < 2147483648.0f;
+					return isValid ? static_cast<uint32_t>(static_cast<int32_t>(val)) : 0;
+				});
+				break;
+			case OPADD_ITOF.opCode:
+				isFloatResult = true;
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return fromQPUFloat(static_cast<float>(static_cast<int32_t>(a)));});
+				break;
+			case OPADD_ADD.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return a + b;});
+				break;
+			case OPADD_SUB.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return a - b;});
+				break;
+			case OPADD_SHR.opCode:
+				//the shift offset is taken from the lower 5 bits
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return a >> (b & 31);});
+				break;
+			case OPADD_ASR.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return static_cast<uint32_t>(static_cast<int32_t>(a) >> (b & 31));});
+				break;
+			case OPADD_ROR.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return (b & 31) == 0 ? a : (a >> (b & 31)) | (a << (32 - (b & 31)));});
+				break;
+			case OPADD_SHL.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return a << (b & 31);});
+				break;
+			case OPADD_MIN.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return static_cast<uint32_t>(std::min(static_cast<int32_t>(a), static_cast<int32_t>(b)));});
+				break;
+			case OPADD_MAX.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return static_cast<uint32_t>(std::max(static_cast<int32_t>(a), static_cast<int32_t>(b)));});
+				break;
+			case OPADD_AND.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return a & b;});
+				break;
+			case OPADD_OR.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return a | b;});
+				break;
+			case OPADD_XOR.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return a ^ b;});
+				break;
+			case OPADD_NOT.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t { return ~a;});
+				break;
+			case OPADD_CLZ.opCode:
+				foldElements(result, first, second, [](uint32_t a, uint32_t b) -> uint32_t
+				{
+					uint32_t count = 0;
+					while(count < 32 && (a & (0x80000000u >> count)) == 0)
+						++count;
+					return count;
+				});
+				break;
+			default:
+				return NO_VALUE;
+		}
+	}
+	if(!isValid)
+		return NO_VALUE;
+
+	const DataType resultType = op.getOutput().get().type.getScalarBitCount() == 32 ? op.getOutput().get().type : type;
+	const DataType elementType = resultType.getElementType();
+	std::vector<Value> elements;
+	elements.reserve(numElements);
+	for(std::size_t i = 0; i < numElements; ++i)
+	{
+		if(isFloatResult)
+			elements.emplace_back(Literal(static_cast<double>(bit_cast<uint32_t, float>(result[i]))), elementType);
+		else
+			elements.emplace_back(Literal(static_cast<long>(static_cast<int32_t>(result[i]))), elementType);
+	}
+	return Value(ContainerValue{ContainerElements(std::move(elements))}, resultType);
+}
+
 InstructionWalker optimizations::calculateConstantInstruction(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
 {
 	intermediate::Operation* op = it.get<intermediate::Operation>();
@@ -308,7 +516,17 @@ InstructionWalker optimizations::calculateConstantInstruction(const Module& modu
 			const Optional<Value> value = op->precalculate(3);
 			if(value)
 			{
-				logging::debug() << "Replacing '" << op->to_string() << "' with constant value: " << value.to_string() << logging::endl;
+				DEBUG_LOG("Replacing '" << op->to_string() << "' with constant value: " << value.to_string() << logging::endl);
+				it.reset((new intermediate::MoveOperation(op->getOutput(), value))->copyExtrasFrom(op));
+			}
+		}
+		else if(op->getFirstArg().hasType(ValueType::CONTAINER) || (op->getSecondArg() && op->getSecondArg().get().hasType(ValueType::CONTAINER)))
+		{
+			//vectors of literals (e.g. tables of constants) are folded as a whole
+			const Optional<Value> value = foldVectorOperation(*op);
+			if(value)
+			{
+				DEBUG_LOG("Replacing '" << op->to_string() << "' with constant vector: " << value.to_string() << logging::endl);
 				it.reset((new intermediate::MoveOperation(op->getOutput(), value))->copyExtrasFrom(op));
 			}
 		}
@@ -331,7 +549,7 @@ static void mapPhi(const intermediate::PhiNode& node, Method& method, Instructio
 			logging::error() << "Cannot map phi-node to label: " << pair.first->name << logging::endl;
 			throw CompilationError(CompilationStep::OPTIMIZER, "Failed to map all phi-options to valid basic-blocks");
 		}
-		logging::debug() << "Inserting 'move' into end of basic-block: " << pair.first->name << logging::endl;
+		DEBUG_LOG("Inserting 'move' into end of basic-block: " << pair.first->name << logging::endl);
 		//make sure, moves are inserted before the outgoing branches
 		InstructionWalker it = bb->end();
 		ConditionCode jumpCondition = COND_ALWAYS;
@@ -369,7 +587,7 @@ void optimizations::eliminatePhiNodes(const Module& module, Method& method, cons
 		if(phiNode != nullptr)
 		{
 			//2) map the phi-node to the move-operations per predecessor-label
-			logging::debug() << "Eliminating phi-node by inserting moves: " << it->to_string() << logging::endl;
+			DEBUG_LOG("Eliminating phi-node by inserting moves: " << it->to_string() << logging::endl);
 			mapPhi(*phiNode, method, it);
 			it.erase();
 		}
@@ -388,8 +606,852 @@ InstructionWalker optimizations::eliminateReturn(const Module& module, Method& m
 			target = method.findOrCreateLocal(TYPE_LABEL, BasicBlock::LAST_BLOCK);
 			method.appendToEnd(new intermediate::BranchLabel(*target));
 		}
-		logging::debug() << "Replacing return in kernel-function with branch to end-label" << logging::endl;
+		DEBUG_LOG("Replacing return in kernel-function with branch to end-label" << logging::endl);
 		it.reset(new intermediate::Branch(target, COND_ALWAYS, BOOL_TRUE));
 	}
 	return it;
 }
+
+/*
+ * The value calculated by an instruction, independent of the local it is written to
+ */
+struct Expression
+{
+	intermediate::InstructionKind kind;
+	std::string opCode;
+	std::vector<Value> arguments;
+	DataType outputType;
+	Unpack unpackMode;
+	Pack packMode;
+
+	bool operator==(const Expression& other) const
+	{
+		return kind == other.kind && opCode == other.opCode && arguments == other.arguments && outputType == other.outputType &&
+				unpackMode == other.unpackMode && packMode == other.packMode;
+	}
+};
+
+struct ExpressionHash
+{
+	std::size_t operator()(const Expression& expr) const noexcept
+	{
+		std::size_t result = std::hash<std::string>{}(expr.opCode) ^ static_cast<std::size_t>(expr.kind);
+		for(const Value& arg : expr.arguments)
+			result = result * 31 + vc4c::hash<Value>{}(arg);
+		return result;
+	}
+};
+
+using ExpressionTable = UnorderedMap<Expression, Value, ExpressionHash>;
+
+//the operations for which the order of the arguments does not matter
+static const char* const COMMUTATIVE_OPERATIONS[] = {
+		"add", "fadd", "fmul", "mul24", "and", "or", "xor", "min", "max", "fmin", "fmax", "fminabs", "fmaxabs", "v8adds", "v8muld", "v8min", "v8max"
+};
+
+static bool isCommutative(const std::string& opCode)
+{
+	return std::find(std::begin(COMMUTATIVE_OPERATIONS), std::end(COMMUTATIVE_OPERATIONS), opCode) != std::end(COMMUTATIVE_OPERATIONS);
+}
+
+/*
+ * The state of the value numbering along the current path in the dominator tree
+ */
+struct ValueNumbering
+{
+	//the expressions calculated in any dominating block and the locals holding their values
+	ExpressionTable expressions;
+	//the expressions without any local argument are only reused within a single block, since re-calculating them is cheaper than keeping them alive
+	ExpressionTable blockExpressions;
+	//the locals with a single writer, which is located in a dominating block (or before in the current block)
+	FastSet<const Local*> definedLocals;
+	//the locals which are copies of other locals
+	FastMap<const Local*, Value> copies;
+	//the entries added per dominating block, to be able to remove them when leaving the block
+	std::vector<Expression> addedExpressions;
+	std::vector<const Local*> addedDefinitions;
+	std::vector<const Local*> addedCopies;
+
+	/*
+	 * Returns the value of the argument used for comparing expressions, nothing if the value of the argument is not known to be the same for all instructions in the current scope
+	 */
+	Optional<Value> getArgumentValue(const Value& arg) const
+	{
+		if(arg.hasType(ValueType::LITERAL) || arg.hasType(ValueType::SMALL_IMMEDIATE))
+			return arg;
+		//registers can change their values (or have side-effects on reading)
+		if(!arg.hasType(ValueType::LOCAL))
+			return NO_VALUE;
+		auto copyIt = copies.find(arg.local);
+		if(copyIt != copies.end())
+			return copyIt->second;
+		//e.g. parameters are never written and don't change their value
+		const auto numWriters = arg.local->getUsers().getNumWriters();
+		if(numWriters == 0 || (numWriters == 1 && definedLocals.find(arg.local) != definedLocals.end()))
+			return arg;
+		return NO_VALUE;
+	}
+
+	void addDefinition(const Local* local)
+	{
+		if(local->getUsers().getNumWriters() == 1 && definedLocals.emplace(local).second)
+			addedDefinitions.push_back(local);
+	}
+};
+
+/*
+ * Creates the expression for the instruction, if the instruction is a pure computation only depending on its arguments
+ */
+static bool toExpression(const intermediate::IntermediateInstruction* instr, const ValueNumbering& numbering, Expression& expr)
+{
+	if(instr->kind != intermediate::InstructionKind::OPERATION && instr->kind != intermediate::InstructionKind::MOVE && instr->kind != intermediate::InstructionKind::LOAD_IMMEDIATE)
+		return false;
+	if(instr->conditional != COND_ALWAYS || instr->hasSideEffects())
+		return false;
+	//the output needs to be written only by this instruction, so it always contains the value of this expression
+	if(!instr->hasValueType(ValueType::LOCAL) || instr->getOutput().get().local->getUsers().getNumWriters() != 1)
+		return false;
+	expr.kind = instr->kind;
+	const intermediate::Operation* op = instr->as<const intermediate::Operation>();
+	const intermediate::LoadImmediate* load = instr->as<const intermediate::LoadImmediate>();
+	expr.opCode = op != nullptr ? op->opCode : "";
+	//the same immediate is a different value, if it is loaded per-element
+	if(load != nullptr && load->type != intermediate::LoadType::REPLICATE_INT32)
+		expr.opCode = load->type == intermediate::LoadType::PER_ELEMENT_SIGNED ? "ldi_signed" : "ldi_unsigned";
+	expr.outputType = instr->getOutput().get().type;
+	expr.unpackMode = instr->unpackMode;
+	expr.packMode = instr->packMode;
+	expr.arguments.clear();
+	for(const Value& arg : instr->getArguments())
+	{
+		const Optional<Value> value = numbering.getArgumentValue(arg);
+		if(!value)
+			return false;
+		expr.arguments.push_back(value.get());
+	}
+	return true;
+}
+
+/*
+ * Whether all reads of the local are dominated by the given (writing) position
+ */
+static bool areAllReadsDominated(const Local* local, const BasicBlock* block, std::size_t index, const FastMap<const LocalUser*, std::pair<const BasicBlock*, std::size_t>>& positions,
+		const analysis::DominatorTree& dominators)
+{
+	for(const LocalUser* reader : local->getUsers(LocalUser::Type::READER))
+	{
+		auto it = positions.find(reader);
+		//e.g. the single operations of combined instructions
+		if(it == positions.end())
+			return false;
+		if(it->second.first == block ? it->second.second <= index : !dominators.dominates(*block, *it->second.first))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Handles the instructions of the block, returns the number of eliminated expressions
+ */
+static std::size_t numberValues(BasicBlock& block, ValueNumbering& numbering, const FastMap<const LocalUser*, std::pair<const BasicBlock*, std::size_t>>& positions,
+		const analysis::DominatorTree& dominators)
+{
+	std::size_t numEliminated = 0;
+	numbering.blockExpressions.clear();
+	Expression expr{intermediate::InstructionKind::NOP, "", {}, TYPE_UNKNOWN, UNPACK_NOP, PACK_NOP};
+	auto it = block.begin();
+	while(!it.isEndOfBlock())
+	{
+		intermediate::IntermediateInstruction* instr = it.get();
+		if(instr == nullptr || !toExpression(instr, numbering, expr))
+		{
+			if(instr != nullptr)
+			{
+				instr->forUsedLocals([&numbering](const Local* local, LocalUser::Type type) -> void
+				{
+					if(has_flag(type, LocalUser::Type::WRITER))
+						numbering.addDefinition(local);
+				});
+			}
+			it.nextInBlock();
+			continue;
+		}
+		const Value output = instr->getOutput();
+		numbering.addDefinition(output.local);
+		//plain copies are not eliminated, but their output is handled as the copied value
+		if(expr.kind == intermediate::InstructionKind::MOVE && expr.arguments[0].hasType(ValueType::LOCAL) && expr.unpackMode == UNPACK_NOP && expr.packMode == PACK_NOP)
+		{
+			numbering.copies.emplace(output.local, expr.arguments[0]);
+			numbering.addedCopies.push_back(output.local);
+			it.nextInBlock();
+			continue;
+		}
+		const bool hasLocalArgument = std::any_of(expr.arguments.begin(), expr.arguments.end(), [](const Value& arg) -> bool { return arg.hasType(ValueType::LOCAL);});
+		ExpressionTable& table = hasLocalArgument ? numbering.expressions : numbering.blockExpressions;
+		auto exprIt = table.find(expr);
+		if(exprIt == table.end() && expr.arguments.size() == 2 && isCommutative(expr.opCode))
+		{
+			std::swap(expr.arguments[0], expr.arguments[1]);
+			exprIt = table.find(expr);
+			std::swap(expr.arguments[0], expr.arguments[1]);
+		}
+		if(exprIt == table.end())
+		{
+			table.emplace(expr, output);
+			if(hasLocalArgument)
+				numbering.addedExpressions.push_back(expr);
+			it.nextInBlock();
+			continue;
+		}
+		const Value& previousValue = exprIt->second;
+		++numEliminated;
+		//the value is available in all instructions dominated by this one
+		const auto& position = positions.at(instr);
+		if(areAllReadsDominated(output.local, &block, position.second, positions, dominators))
+		{
+			DEBUG_LOG("Replacing '" << instr->to_string() << "' with the value of the same expression in: " << previousValue.to_string() << logging::endl);
+			for(const LocalUser* reader : output.local->getUsers(LocalUser::Type::READER))
+				const_cast<LocalUser*>(reader)->replaceLocal(output.local, previousValue.local, LocalUser::Type::READER);
+			it.erase();
+		}
+		else
+		{
+			DEBUG_LOG("Replacing '" << instr->to_string() << "' with copy of the same expression in: " << previousValue.to_string() << logging::endl);
+			it.reset((new intermediate::MoveOperation(output, previousValue))->setDecorations(instr->decoration));
+			numbering.copies.emplace(output.local, previousValue);
+			numbering.addedCopies.push_back(output.local);
+			it.nextInBlock();
+		}
+	}
+	return numEliminated;
+}
+
+void optimizations::eliminateCommonSubexpressions(const Module& module, Method& method, const Configuration& config)
+{
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	const analysis::DominatorTree& dominators = method.getAnalyses().getDominatorTree();
+	if(cfg.getReversePostOrder().empty())
+		return;
+
+	FastMap<const BasicBlock*, std::vector<BasicBlock*>> dominatedBlocks;
+	for(BasicBlock* block : cfg.getReversePostOrder())
+	{
+		const BasicBlock* dominator = dominators.getImmediateDominator(*block);
+		if(dominator != nullptr)
+			dominatedBlocks[dominator].push_back(block);
+	}
+	//the positions of all instructions, to determine whether an instruction is dominated by another one
+	FastMap<const LocalUser*, std::pair<const BasicBlock*, std::size_t>> positions;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		std::size_t index = 0;
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+			positions.emplace(it.get(), std::make_pair(&block, index++));
+	}
+
+	//visit the dominator tree in pre-order, so all instructions of the dominating blocks were already handled
+	struct Scope
+	{
+		BasicBlock* block;
+		std::size_t numExpressions;
+		std::size_t numDefinitions;
+		std::size_t numCopies;
+		bool entered;
+	};
+	ValueNumbering numbering;
+	std::size_t numEliminated = 0;
+	std::vector<Scope> scopes{Scope{cfg.getReversePostOrder().front(), 0, 0, 0, false}};
+	while(!scopes.empty())
+	{
+		Scope& scope = scopes.back();
+		if(scope.entered)
+		{
+			//leave the block, its values are not available in the blocks not dominated by it
+			for(std::size_t i = scope.numExpressions; i < numbering.addedExpressions.size(); ++i)
+				numbering.expressions.erase(numbering.addedExpressions[i]);
+			numbering.addedExpressions.erase(numbering.addedExpressions.begin() + scope.numExpressions, numbering.addedExpressions.end());
+			for(std::size_t i = scope.numDefinitions; i < numbering.addedDefinitions.size(); ++i)
+				numbering.definedLocals.erase(numbering.addedDefinitions[i]);
+			numbering.addedDefinitions.erase(numbering.addedDefinitions.begin() + scope.numDefinitions, numbering.addedDefinitions.end());
+			for(std::size_t i = scope.numCopies; i < numbering.addedCopies.size(); ++i)
+				numbering.copies.erase(numbering.addedCopies[i]);
+			numbering.addedCopies.erase(numbering.addedCopies.begin() + scope.numCopies, numbering.addedCopies.end());
+			scopes.pop_back();
+			continue;
+		}
+		scope.entered = true;
+		scope.numExpressions = numbering.addedExpressions.size();
+		scope.numDefinitions = numbering.addedDefinitions.size();
+		scope.numCopies = numbering.addedCopies.size();
+		BasicBlock* block = scope.block;
+		numEliminated += numberValues(*block, numbering, positions, dominators);
+		auto childIt = dominatedBlocks.find(block);
+		if(childIt != dominatedBlocks.end())
+		{
+			for(auto it = childIt->second.rbegin(); it != childIt->second.rend(); ++it)
+				scopes.push_back(Scope{*it, 0, 0, 0, false});
+		}
+	}
+	DEBUG_LOG("Eliminated " << numEliminated << " common sub-expressions" << logging::endl);
+}
+
+/*
+ * Whether the instruction is a plain copy of a local into another local of the same type
+ */
+static bool isPlainCopy(const intermediate::MoveOperation* move)
+{
+	return move != nullptr && !move->is<intermediate::VectorRotation>() && move->getSource().hasType(ValueType::LOCAL) && move->hasValueType(ValueType::LOCAL) &&
+			move->conditional == COND_ALWAYS && !move->hasSideEffects() && !move->hasPackMode() && !move->hasUnpackMode() &&
+			move->getSource().type == move->getOutput().get().type;
+}
+
+/*
+ * Whether the value of the source of the copy is still the same in all readers of its output:
+ * the source is either never written (e.g. a parameter) or written only once before the copy,
+ * so it can not be overwritten between the copy and any read dominated by the copy
+ */
+static bool isSourceUnchanged(const Local* source, const BasicBlock* block, std::size_t index, const FastMap<const LocalUser*, std::pair<const BasicBlock*, std::size_t>>& positions,
+		const analysis::DominatorTree& dominators)
+{
+	const auto numWriters = source->getUsers().getNumWriters();
+	if(numWriters == 0)
+		return true;
+	if(numWriters != 1)
+		return false;
+	auto it = positions.find(source->getSingleWriter());
+	if(it == positions.end())
+		return false;
+	return it->second.first == block ? it->second.second < index : dominators.dominates(*it->second.first, *block);
+}
+
+/*
+ * Makes the producer of the source of the copy write the output of the copy directly (e.g. for the copies inserted for phi-nodes),
+ * if the source is only read by the copy and the output is neither read nor written between the producer and the copy
+ */
+static bool mergeIntoProducer(InstructionWalker it, const Local* source, const Local* output)
+{
+	if(source->getUsers().getNumWriters() != 1 || source->getUsers().getNumReaders() != 1)
+		return false;
+	const LocalUser* writer = source->getSingleWriter();
+	InstructionWalker producer = it.copy().previousInBlock();
+	while(!producer.isStartOfBlock() && producer.get() != writer)
+	{
+		if(producer.has() && (producer->readsLocal(output) || producer->writesLocal(output)))
+			return false;
+		producer.previousInBlock();
+	}
+	if(producer.get() != writer || producer.has<intermediate::CombinedOperation>() || producer->conditional != COND_ALWAYS ||
+			(!producer.has<intermediate::Operation>() && !producer.has<intermediate::MoveOperation>() && !producer.has<intermediate::LoadImmediate>()))
+		return false;
+	DEBUG_LOG("Merging '" << producer->to_string() << "' into copy: " << it->to_string() << logging::endl);
+	producer->setOutput(Value(output, producer->getOutput().get().type));
+	//the register-allocator needs to know, that the output is (also) written as a phi-node
+	if(has_flag(it->decoration, intermediate::InstructionDecorations::PHI_NODE))
+		producer->setDecorations(intermediate::InstructionDecorations::PHI_NODE);
+	return true;
+}
+
+void optimizations::propagateMoves(const Module& module, Method& method, const Configuration& config)
+{
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	const analysis::DominatorTree& dominators = method.getAnalyses().getDominatorTree();
+	if(cfg.getReversePostOrder().empty())
+		return;
+	//the positions of all instructions, to determine whether an instruction is dominated by another one
+	FastMap<const LocalUser*, std::pair<const BasicBlock*, std::size_t>> positions;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		std::size_t index = 0;
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+			positions.emplace(it.get(), std::make_pair(&block, index++));
+	}
+
+	std::size_t numPropagated = 0;
+	std::size_t numMerged = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		auto it = block.begin();
+		while(!it.isEndOfBlock())
+		{
+			const intermediate::MoveOperation* move = it.get<intermediate::MoveOperation>();
+			if(!isPlainCopy(move))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			const Local* source = move->getSource().local;
+			const Local* output = move->getOutput().get().local;
+			//parameters, globals and locals referring to other locals (e.g. the elements of memory areas) keep their identity
+			if(source == output || output->is<Parameter>() || output->is<Global>() || source->is<Global>() || (output->reference.first != nullptr && output->reference != source->reference))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			const auto& position = positions.at(move);
+			if(output->getUsers().getNumWriters() == 1 && isSourceUnchanged(source, &block, position.second, positions, dominators) &&
+					areAllReadsDominated(output, &block, position.second, positions, dominators))
+			{
+				//the output is a copy of the source in all its readers, so the source can be read directly
+				DEBUG_LOG("Propagating source of copy: " << move->to_string() << logging::endl);
+				for(const LocalUser* reader : output->getUsers(LocalUser::Type::READER))
+					const_cast<LocalUser*>(reader)->replaceLocal(output, source, LocalUser::Type::READER);
+				it.erase();
+				++numPropagated;
+				continue;
+			}
+			if(!source->is<Parameter>() && mergeIntoProducer(it, source, output))
+			{
+				it.erase();
+				++numMerged;
+				continue;
+			}
+			it.nextInBlock();
+		}
+	}
+	DEBUG_LOG("Propagated " << numPropagated << " copies and merged " << numMerged << " copies into their producers" << logging::endl);
+}
+
+void optimizations::eliminateRedundantFlags(const Module& module, Method& method, const Configuration& config)
+{
+	const analysis::FlagsAnalysis& flags = method.getAnalyses().getFlags();
+	std::size_t numRemoved = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		auto it = block.begin();
+		while(!it.isEndOfBlock())
+		{
+			if(!it.has() || !flags.isRedundantFlagsSetter(it.get()))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			++numRemoved;
+			if(it->hasValueType(ValueType::REGISTER) && it->getOutput().get().hasRegister(REG_NOP) && it->signal == Signaling::NO_SIGNAL)
+			{
+				//the instruction is only executed for its flags
+				DEBUG_LOG("Removing instruction setting the flags already set: " << it->to_string() << logging::endl);
+				it.erase();
+				continue;
+			}
+			DEBUG_LOG("Removing the setting of the flags already set from: " << it->to_string() << logging::endl);
+			it->setFlags = SetFlag::DONT_SET;
+			it.nextInBlock();
+		}
+	}
+	DEBUG_LOG("Removed " << numRemoved << " settings of flags already set" << logging::endl);
+}
+
+/*
+ * The lattice-value of a local (or the flags) for the sparse conditional constant propagation
+ */
+struct ConstantLattice
+{
+	enum class State
+	{
+		//no (executable) writer was visited yet
+		UNDEFINED,
+		//all visited writers write the same constant value
+		CONSTANT,
+		//the value is not known at compile-time
+		OVERDEFINED
+	};
+	State state;
+	Optional<Value> value;
+
+	static ConstantLattice undefined()
+	{
+		return ConstantLattice{State::UNDEFINED, NO_VALUE};
+	}
+
+	static ConstantLattice overdefined()
+	{
+		return ConstantLattice{State::OVERDEFINED, NO_VALUE};
+	}
+
+	static ConstantLattice constant(const Value& val)
+	{
+		return ConstantLattice{State::CONSTANT, val};
+	}
+
+	/*
+	 * Combines the values of two writers of the same local
+	 */
+	ConstantLattice meet(const ConstantLattice& other) const
+	{
+		if(state == State::UNDEFINED)
+			return other;
+		if(other.state == State::UNDEFINED)
+			return *this;
+		if(state == State::CONSTANT && other.state == State::CONSTANT && value.get().literal == other.value.get().literal)
+			return *this;
+		return overdefined();
+	}
+};
+
+/*
+ * Whether a condition is met, if this can be determined at compile-time
+ */
+enum class StaticResult
+{
+	NEVER,
+	ALWAYS,
+	UNKNOWN
+};
+
+static StaticResult toResult(const bool isMet)
+{
+	return isMet ? StaticResult::ALWAYS : StaticResult::NEVER;
+}
+
+/*
+ * Whether the condition is met for the given flags, if this can be determined at compile-time
+ */
+static StaticResult evaluateCondition(const ConditionCode cond, const ConstantLattice& flags)
+{
+	if(cond == COND_ALWAYS)
+		return StaticResult::ALWAYS;
+	if(cond == COND_NEVER)
+		return StaticResult::NEVER;
+	if(flags.state != ConstantLattice::State::CONSTANT)
+		return StaticResult::UNKNOWN;
+	const Literal& lit = flags.value.get().literal;
+	const bool isZero = lit.type == LiteralType::REAL ? lit.real == 0.0 : lit.toImmediate() == 0;
+	const bool isNegative = lit.type == LiteralType::REAL ? lit.real < 0.0 : static_cast<int32_t>(lit.toImmediate()) < 0;
+	if(cond == COND_ZERO_SET)
+		return toResult(isZero);
+	if(cond == COND_ZERO_CLEAR)
+		return toResult(!isZero);
+	if(cond == COND_NEGATIVE_SET)
+		return toResult(isNegative);
+	if(cond == COND_NEGATIVE_CLEAR)
+		return toResult(!isNegative);
+	//the carry flag depends on the operation setting the flags
+	return StaticResult::UNKNOWN;
+}
+
+/*
+ * Evaluates the (not yet intrinsified) comparison of the two constants
+ */
+static StaticResult evaluateComparison(const std::string& comparison, const Value& first, const Value& second)
+{
+	if(comparison == intermediate::COMP_TRUE)
+		return StaticResult::ALWAYS;
+	if(comparison == intermediate::COMP_FALSE)
+		return StaticResult::NEVER;
+	if(first.type.isFloatingType())
+	{
+		if(first.literal.type != LiteralType::REAL || second.literal.type != LiteralType::REAL)
+			return StaticResult::UNKNOWN;
+		const double a = first.literal.real;
+		const double b = second.literal.real;
+		const bool unordered = std::isnan(a) || std::isnan(b);
+		if(comparison == intermediate::COMP_ORDERED)
+			return toResult(!unordered);
+		if(comparison == intermediate::COMP_UNORDERED)
+			return toResult(unordered);
+		const bool isUnordered = comparison.front() == 'u';
+		if(unordered)
+			return toResult(isUnordered);
+		const std::string relation = comparison.substr(1);
+		if(relation == "eq")
+			return toResult(a == b);
+		if(relation == "ne")
+			return toResult(a != b);
+		if(relation == "gt")
+			return toResult(a > b);
+		if(relation == "ge")
+			return toResult(a >= b);
+		if(relation == "lt")
+			return toResult(a < b);
+		if(relation == "le")
+			return toResult(a <= b);
+		return StaticResult::UNKNOWN;
+	}
+	if(first.literal.type == LiteralType::REAL || second.literal.type == LiteralType::REAL)
+		return StaticResult::UNKNOWN;
+	//the values are compared with the bit-width of their type
+	const unsigned char numBits = std::min(first.type.getScalarBitCount(), static_cast<unsigned char>(32));
+	const uint32_t mask = numBits >= 32 ? 0xFFFFFFFFu : ((1u << numBits) - 1);
+	const uint32_t a = first.literal.toImmediate() & mask;
+	const uint32_t b = second.literal.toImmediate() & mask;
+	const uint32_t signBit = 1u << (numBits - 1);
+	const int64_t signedA = static_cast<int64_t>(a ^ signBit) - static_cast<int64_t>(signBit);
+	const int64_t signedB = static_cast<int64_t>(b ^ signBit) - static_cast<int64_t>(signBit);
+	if(comparison == intermediate::COMP_EQ)
+		return toResult(a == b);
+	if(comparison == intermediate::COMP_NEQ)
+		return toResult(a != b);
+	if(comparison == intermediate::COMP_UNSIGNED_GT)
+		return toResult(a > b);
+	if(comparison == intermediate::COMP_UNSIGNED_GE)
+		return toResult(a >= b);
+	if(comparison == intermediate::COMP_UNSIGNED_LT)
+		return toResult(a < b);
+	if(comparison == intermediate::COMP_UNSIGNED_LE)
+		return toResult(a <= b);
+	if(comparison == intermediate::COMP_SIGNED_GT)
+		return toResult(signedA > signedB);
+	if(comparison == intermediate::COMP_SIGNED_GE)
+		return toResult(signedA >= signedB);
+	if(comparison == intermediate::COMP_SIGNED_LT)
+		return toResult(signedA < signedB);
+	if(comparison == intermediate::COMP_SIGNED_LE)
+		return toResult(signedA <= signedB);
+	return StaticResult::UNKNOWN;
+}
+
+/*
+ * Returns the block the control-flow falls through to from the given block, if any
+ */
+static BasicBlock* getFallThroughSuccessor(const analysis::ControlFlowGraph& cfg, const BasicBlock& block)
+{
+	for(BasicBlock* successor : cfg.getSuccessors(block))
+	{
+		for(const analysis::CFGPredecessor& edge : cfg.getPredecessors(*successor))
+		{
+			if(edge.block == &block && edge.isFallThrough)
+				return successor;
+		}
+	}
+	return nullptr;
+}
+
+struct ConstantPropagation
+{
+	const analysis::ControlFlowGraph& cfg;
+	FastMap<const Local*, ConstantLattice> values;
+	FastSet<const BasicBlock*> executableBlocks;
+	//the blocks to (re-)visit, since they became executable or a value read in them changed
+	std::vector<BasicBlock*> pendingBlocks;
+	FastSet<const BasicBlock*> pendingSet;
+	FastMap<const LocalUser*, BasicBlock*> instructionBlocks;
+
+	explicit ConstantPropagation(const analysis::ControlFlowGraph& cfg) : cfg(cfg)
+	{
+	}
+
+	void enqueue(BasicBlock* block)
+	{
+		if(block != nullptr && pendingSet.emplace(block).second)
+			pendingBlocks.push_back(block);
+	}
+
+	void markExecutable(BasicBlock* block)
+	{
+		if(block != nullptr && executableBlocks.emplace(block).second)
+			enqueue(block);
+	}
+
+	ConstantLattice getValue(const Value& val) const
+	{
+		if(val.hasType(ValueType::LITERAL))
+			return ConstantLattice::constant(val);
+		if(val.hasType(ValueType::SMALL_IMMEDIATE) && val.immediate.toLiteral())
+			return ConstantLattice::constant(Value(val.immediate.toLiteral().get(), val.type));
+		//parameters, globals and locals never written are not known at compile-time
+		if(!val.hasType(ValueType::LOCAL) || val.local->is<Parameter>() || val.local->is<Global>() || val.local->getUsers().getNumWriters() == 0)
+			return ConstantLattice::overdefined();
+		auto it = values.find(val.local);
+		return it == values.end() ? ConstantLattice::undefined() : it->second;
+	}
+
+	/*
+	 * Determines the value calculated by the instruction from the current values of its arguments
+	 */
+	ConstantLattice evaluate(const intermediate::IntermediateInstruction* instr) const
+	{
+		if(instr->hasUnpackMode())
+			return ConstantLattice::overdefined();
+		//this includes vector rotations, since rotating a splat value does not change it
+		if(instr->is<intermediate::MoveOperation>())
+			return instr->hasPackMode() ? ConstantLattice::overdefined() : getValue(instr->getArgument(0));
+		if(instr->is<intermediate::LoadImmediate>())
+		{
+			const Optional<Value> value = instr->precalculate(1);
+			return value ? ConstantLattice::constant(value) : ConstantLattice::overdefined();
+		}
+		const intermediate::Operation* op = instr->as<const intermediate::Operation>();
+		if(op == nullptr)
+			return ConstantLattice::overdefined();
+		std::vector<Value> args;
+		for(const Value& arg : op->getArguments())
+		{
+			const ConstantLattice argValue = getValue(arg);
+			if(argValue.state != ConstantLattice::State::CONSTANT)
+				return argValue.state == ConstantLattice::State::UNDEFINED ? argValue : ConstantLattice::overdefined();
+			args.push_back(Value(argValue.value.get().literal, arg.type));
+		}
+		if(op->is<intermediate::Comparison>())
+		{
+			if(args.size() != 2 || op->hasPackMode())
+				return ConstantLattice::overdefined();
+			const StaticResult result = evaluateComparison(op->opCode, args[0], args[1]);
+			if(result == StaticResult::UNKNOWN)
+				return ConstantLattice::overdefined();
+			return ConstantLattice::constant(result == StaticResult::ALWAYS ? BOOL_TRUE : BOOL_FALSE);
+		}
+		//calculate the operation as if it was executed on the literal arguments
+		std::unique_ptr<intermediate::Operation> tmp(args.size() > 1 ? new intermediate::Operation(op->opCode, NOP_REGISTER, args[0], args[1]) :
+				new intermediate::Operation(op->opCode, NOP_REGISTER, args.at(0)));
+		tmp->packMode = op->packMode;
+		const Optional<Value> result = tmp->precalculate(1);
+		return result ? ConstantLattice::constant(result) : ConstantLattice::overdefined();
+	}
+
+	void update(const Local* local, const ConstantLattice& contribution)
+	{
+		ConstantLattice& current = values.emplace(local, ConstantLattice::undefined()).first->second;
+		ConstantLattice next = current.meet(contribution.state == ConstantLattice::State::CONSTANT ? ConstantLattice::constant(Value(contribution.value.get().literal, local->type)) : contribution);
+		if(next.state == current.state && (next.state != ConstantLattice::State::CONSTANT || next.value.get().literal == current.value.get().literal))
+			return;
+		current = next;
+		//all instructions reading the local need to be re-evaluated
+		for(const LocalUser* reader : local->getUsers(LocalUser::Type::READER))
+		{
+			auto blockIt = instructionBlocks.find(reader);
+			if(blockIt != instructionBlocks.end() && executableBlocks.find(blockIt->second) != executableBlocks.end())
+				enqueue(blockIt->second);
+		}
+	}
+
+	/*
+	 * Returns whether the branch is taken, if this is known at compile-time
+	 */
+	StaticResult isBranchTaken(const intermediate::Branch* branch) const
+	{
+		if(branch->isUnconditional())
+			return StaticResult::ALWAYS;
+		return evaluateCondition(branch->conditional, getValue(branch->getCondition()));
+	}
+
+	void visitBlock(BasicBlock& block)
+	{
+		//the flags set in the predecessors are not known
+		ConstantLattice flags = ConstantLattice::overdefined();
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			const intermediate::IntermediateInstruction* instr = it.get();
+			if(instr == nullptr || instr->is<intermediate::BranchLabel>())
+				continue;
+			if(const intermediate::Branch* branch = instr->as<const intermediate::Branch>())
+			{
+				const StaticResult taken = isBranchTaken(branch);
+				if(taken != StaticResult::NEVER)
+					markExecutable(cfg.findBlock(branch->getTarget()));
+				if(taken == StaticResult::ALWAYS)
+					//the following instructions are never executed, the block does not fall through
+					return;
+				continue;
+			}
+			const StaticResult executed = evaluateCondition(instr->conditional, flags);
+			if(executed == StaticResult::NEVER)
+				continue;
+			const ConstantLattice result = evaluate(instr);
+			if(instr->hasValueType(ValueType::LOCAL))
+				update(instr->getOutput().get().local, result);
+			if(instr->setFlags == SetFlag::SET_FLAGS)
+				flags = executed == StaticResult::ALWAYS ? result : ConstantLattice::overdefined();
+		}
+		markExecutable(getFallThroughSuccessor(cfg, block));
+	}
+};
+
+void optimizations::propagateConstants(const Module& module, Method& method, const Configuration& config)
+{
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	if(cfg.getReversePostOrder().empty())
+		return;
+	ConstantPropagation propagation(cfg);
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() != nullptr)
+				propagation.instructionBlocks.emplace(it.get(), &block);
+		}
+	}
+
+	propagation.markExecutable(cfg.getReversePostOrder().front());
+	while(!propagation.pendingBlocks.empty())
+	{
+		BasicBlock* block = propagation.pendingBlocks.back();
+		propagation.pendingBlocks.pop_back();
+		propagation.pendingSet.erase(block);
+		propagation.visitBlock(*block);
+	}
+
+	std::size_t numReplaced = 0;
+	std::size_t numBranches = 0;
+	std::size_t numBlocks = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		if(propagation.executableBlocks.find(&block) == propagation.executableBlocks.end())
+		{
+			//the label is kept, the block is empty and never jumped to
+			auto it = block.begin().nextInBlock();
+			if(!it.isEndOfBlock())
+			{
+				DEBUG_LOG("Removing unreachable block: " << block.getLabel()->to_string() << logging::endl);
+				++numBlocks;
+			}
+			while(!it.isEndOfBlock())
+				it.erase();
+			continue;
+		}
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			intermediate::IntermediateInstruction* instr = it.get();
+			if(instr == nullptr || instr->is<intermediate::BranchLabel>())
+				continue;
+			if(intermediate::Branch* branch = it.get<intermediate::Branch>())
+			{
+				const StaticResult taken = propagation.isBranchTaken(branch);
+				if(taken == StaticResult::UNKNOWN)
+					continue;
+				++numBranches;
+				if(taken == StaticResult::NEVER)
+				{
+					DEBUG_LOG("Removing branch which is never taken: " << branch->to_string() << logging::endl);
+					it.erase();
+					//don't skip next instruction
+					it.previousInBlock();
+					continue;
+				}
+				if(!branch->isUnconditional())
+				{
+					DEBUG_LOG("Replacing branch which is always taken with unconditional branch: " << branch->to_string() << logging::endl);
+					it.reset((new intermediate::Branch(branch->getTarget(), COND_ALWAYS, BOOL_TRUE))->setDecorations(branch->decoration));
+				}
+				//the remaining branches of the block are never reached
+				it.nextInBlock();
+				while(!it.isEndOfBlock())
+					it.erase();
+				break;
+			}
+			const bool isConstantOutput = instr->hasValueType(ValueType::LOCAL) && propagation.getValue(instr->getOutput()).state == ConstantLattice::State::CONSTANT;
+			if(isConstantOutput && instr->is<intermediate::Operation>() && instr->setFlags == SetFlag::DONT_SET && !instr->hasSideEffects())
+			{
+				const Value value(propagation.getValue(instr->getOutput()).value.get().literal, instr->getOutput().get().type);
+				DEBUG_LOG("Replacing '" << instr->to_string() << "' with propagated constant value: " << value.to_string() << logging::endl);
+				it.reset((new intermediate::MoveOperation(instr->getOutput(), value, instr->conditional))->setDecorations(instr->decoration));
+				++numReplaced;
+				continue;
+			}
+			if(!instr->is<intermediate::Operation>() && (!instr->is<intermediate::MoveOperation>() || instr->is<intermediate::VectorRotation>()))
+				continue;
+			for(std::size_t i = 0; i < instr->getArguments().size(); ++i)
+			{
+				const Value arg = instr->getArgument(i);
+				if(!arg.hasType(ValueType::LOCAL))
+					continue;
+				const ConstantLattice value = propagation.getValue(arg);
+				if(value.state == ConstantLattice::State::CONSTANT)
+				{
+					instr->setArgument(i, Value(value.value.get().literal, arg.type));
+					++numReplaced;
+				}
+			}
+		}
+	}
+	DEBUG_LOG("Propagated " << numReplaced << " constant values, resolved " << numBranches << " branches and removed " << numBlocks << " unreachable blocks" << logging::endl);
+}
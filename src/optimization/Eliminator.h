@@ -17,6 +17,27 @@ namespace vc4c
 	{
 		void eliminateDeadStore(const Module& module, Method& method, const Configuration& config);
 		void eliminatePhiNodes(const Module& module, Method& method, const Configuration& config);
+		/*
+		 * Global value numbering: re-uses the values of pure computations (ALU operations, moves and immediate loads) calculated in dominating instructions
+		 */
+		void eliminateCommonSubexpressions(const Module& module, Method& method, const Configuration& config);
+		/*
+		 * Copy propagation: replaces the reads of the output of a plain copy with its source, if the source is not changed in between,
+		 * and makes the single instruction producing the source write the output of the copy directly, if the copy is the only use of the source
+		 */
+		void propagateMoves(const Module& module, Method& method, const Configuration& config);
+		/*
+		 * Removes the setting of flags, which recalculates the flags already set by a previous instruction from the same values (see analysis::FlagsAnalysis)
+		 */
+		void eliminateRedundantFlags(const Module& module, Method& method, const Configuration& config);
+		/*
+		 * Sparse conditional constant propagation: determines the locals which have the same constant value in all executed writers,
+		 * following only the control-flow edges which can be taken with the constant branch conditions.
+		 *
+		 * The constants are inserted into the reading instructions, the branches with constant conditions are resolved
+		 * and the instructions of all blocks which can never be reached are removed.
+		 */
+		void propagateConstants(const Module& module, Method& method, const Configuration& config);
 
 		InstructionWalker eliminateUselessInstruction(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
 		InstructionWalker calculateConstantInstruction(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
@@ -0,0 +1,90 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "FunctionCache.h"
+
+#include "../CompilationCache.h"
+#include "CompilationError.h"
+#include "../Logging.h"
+#include "../Serialization.h"
+
+#include <deque>
+#include <mutex>
+
+using namespace vc4c;
+using namespace vc4c::optimizations;
+
+namespace
+{
+	struct FunctionCache
+	{
+		std::mutex lock;
+		FastMap<std::string, std::shared_ptr<const std::string>> entries;
+		//the keys in the order of their insertion, the oldest entries are dropped first
+		std::deque<std::string> insertionOrder;
+		std::size_t totalSize = 0;
+	};
+} /* namespace */
+
+static FunctionCache& getFunctionCache()
+{
+	static FunctionCache cache;
+	return cache;
+}
+
+std::string optimizations::getFunctionCacheKey(const Method& method, const Configuration& config)
+{
+	try
+	{
+		std::string material = getConfigurationKey(config);
+		material.append(std::to_string(static_cast<unsigned>(config.optimizationLevel))).append(1, '\0');
+		material.append(serializeMethodStructure(method));
+		return getCacheKey(material);
+	}
+	catch(const CompilationError& e)
+	{
+		DEBUG_LOG("Method '" << method.name << "' can't be cached: " << e.what() << logging::endl);
+		return "";
+	}
+}
+
+std::shared_ptr<const std::string> optimizations::findCachedFunction(const std::string& key)
+{
+	FunctionCache& cache = getFunctionCache();
+	std::lock_guard<std::mutex> guard(cache.lock);
+	auto it = cache.entries.find(key);
+	return it == cache.entries.end() ? nullptr : it->second;
+}
+
+void optimizations::cacheFunction(const std::string& key, const Method& method, const std::size_t maxCacheSize)
+{
+	std::shared_ptr<const std::string> data;
+	try
+	{
+		data = std::make_shared<const std::string>(serializeMethod(method));
+	}
+	catch(const CompilationError& e)
+	{
+		DEBUG_LOG("Method '" << method.name << "' can't be cached: " << e.what() << logging::endl);
+		return;
+	}
+	if(data->size() > maxCacheSize)
+		return;
+	FunctionCache& cache = getFunctionCache();
+	std::lock_guard<std::mutex> guard(cache.lock);
+	if(!cache.entries.emplace(key, data).second)
+		//cached by a concurrent compilation in the meantime
+		return;
+	cache.insertionOrder.push_back(key);
+	cache.totalSize += data->size();
+	while(cache.totalSize > maxCacheSize && !cache.insertionOrder.empty())
+	{
+		auto it = cache.entries.find(cache.insertionOrder.front());
+		cache.totalSize -= it->second->size();
+		cache.entries.erase(it);
+		cache.insertionOrder.pop_front();
+	}
+}
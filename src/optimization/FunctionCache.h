@@ -0,0 +1,45 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef FUNCTION_CACHE_H
+#define FUNCTION_CACHE_H
+
+#include <config.h>
+#include "../Module.h"
+
+#include <memory>
+#include <string>
+
+namespace vc4c
+{
+	namespace optimizations
+	{
+		/*
+		 * The process-wide cache of the simplified bodies of the called (non-kernel) methods, shared by all compilations (see Configuration#functionCacheSize).
+		 *
+		 * Many programs contain the same helper functions (e.g. the implementations of the standard-library), which are simplified after their callees were inlined.
+		 * The simplified bodies are stored (see #serializeMethod) by the structure of the method before the simplification and the configuration,
+		 * so any later compilation of a method with the same structure re-uses the simplified body instead of running the simplification again.
+		 */
+
+		/*
+		 * Returns the key of the method in its current state for the given configuration, an empty key if the method can't be cached (e.g. for recursive types)
+		 */
+		std::string getFunctionCacheKey(const Method& method, const Configuration& config);
+
+		/*
+		 * Returns the stored simplified body for the key, if any
+		 */
+		std::shared_ptr<const std::string> findCachedFunction(const std::string& key);
+
+		/*
+		 * Stores the (simplified) body of the method for the given key. If the cache exceeds the given size, the oldest entries are dropped
+		 */
+		void cacheFunction(const std::string& key, const Method& method, std::size_t maxCacheSize);
+	}
+}
+
+#endif /* FUNCTION_CACHE_H */
@@ -7,7 +7,9 @@
 #include "Inliner.h"
 #include "../intermediate/IntermediateInstruction.h"
 #include "../intermediate/Helper.h"
-#include "log.h"
+#include "../Logging.h"
+
+#include <algorithm>
 
 using namespace vc4c;
 using namespace vc4c::optimizations;
@@ -18,15 +20,167 @@ static const Method* matchSignatures(const std::vector<std::unique_ptr<Method>>&
     {
         if(callSignature->matchesSignature(*m.get()))
         {
-            logging::debug() << "Found method matching " << m->returnType.to_string() << ' ' << m->name << " with " << m->parameters.size() << " arguments" << logging::endl;
+            DEBUG_LOG("Found method matching " << m->returnType.to_string() << ' ' << m->name << " with " << m->parameters.size() << " arguments" << logging::endl);
             return m.get();
         }
     }
     return nullptr;
 }
 
-static Method& inlineMethod(const std::string& localPrefix, const std::vector<std::unique_ptr<Method>>& methods, Method& currentMethod)
+/*
+ * Methods smaller than this are always inlined, since the instructions for calling them would outweigh their bodies
+ */
+static constexpr std::size_t MIN_SUBROUTINE_SIZE = 32;
+/*
+ * The maximum number of instructions added by inlining all calls of a method (the size of the method times the number of additional calls),
+ * above this, the method is called as a sub-routine instead. Any larger kernel does not fit into the instruction cache (4 KB, 512 instructions) anyway
+ */
+static constexpr std::size_t MAX_INLINED_GROWTH = 2048;
+//the maximum growth when optimizing for code size
+static constexpr std::size_t MAX_INLINED_GROWTH_FOR_SIZE = 64;
+
+/*
+ * A method called via a sub-routine contained once in the calling method, instead of being inlined at every call-site
+ */
+struct SubRoutine
+{
+	const Method* method;
+	std::string localPrefix;
+	//the index of the call-site to return to
+	const Local* returnSite;
+	const Local* entryLabel;
+	std::vector<const Local*> returnLabels;
+};
+
+/*
+ * Decides which of the called methods are not inlined, but called as sub-routines, since inlining them at all call-sites would increase the code size too much
+ */
+static std::vector<SubRoutine> selectSubRoutines(const std::vector<std::unique_ptr<Method>>& methods, Method& currentMethod, const Configuration& config)
+{
+	//the methods are listed in the order of their first call, so the sub-routines are always placed in the same order
+	std::vector<std::pair<const Method*, std::size_t>> numCalls;
+	currentMethod.forAllInstructions([&methods, &numCalls](const intermediate::IntermediateInstruction* instr) -> void
+	{
+		if(const intermediate::MethodCall* call = instr->as<const intermediate::MethodCall>())
+		{
+			const Method* calledMethod = matchSignatures(methods, call);
+			if(calledMethod == nullptr)
+				return;
+			auto it = std::find_if(numCalls.begin(), numCalls.end(), [calledMethod](const std::pair<const Method*, std::size_t>& pair) -> bool { return pair.first == calledMethod;});
+			if(it == numCalls.end())
+				numCalls.emplace_back(calledMethod, 1);
+			else
+				++it->second;
+		}
+	});
+	const std::size_t maxGrowth = config.optimizationLevel == OptimizationLevel::SIZE ? MAX_INLINED_GROWTH_FOR_SIZE : MAX_INLINED_GROWTH;
+	std::vector<SubRoutine> subRoutines;
+	for(const auto& pair : numCalls)
+	{
+		const std::size_t size = pair.first->countInstructions();
+		if(pair.second < 2 || size < MIN_SUBROUTINE_SIZE || size * (pair.second - 1) <= maxGrowth)
+			continue;
+		const std::string prefix = std::string("%") + (pair.first->name + ".sub.");
+		DEBUG_LOG("Calling method " << pair.first->name << " with " << size << " instructions from " << pair.second << " call-sites as sub-routine" << logging::endl);
+		subRoutines.push_back(SubRoutine{pair.first, prefix, currentMethod.findOrCreateLocal(TYPE_INT8, prefix + "return_site"), currentMethod.findOrCreateLocal(TYPE_LABEL, prefix + "entry"), {}});
+	}
+	return subRoutines;
+}
+
+/*
+ * Replaces the call with a jump into the sub-routine, which jumps back to the label inserted after the call
+ */
+static InstructionWalker callSubRoutine(Method& currentMethod, InstructionWalker it, intermediate::MethodCall* call, SubRoutine& subRoutine)
+{
+	//the parameters of the sub-routine are written by all callers
+	for(std::size_t i = 0; i < call->getArguments().size(); ++i)
+	{
+		const Parameter& param = subRoutine.method->parameters.at(i);
+		const Value ref = currentMethod.findOrCreateLocal(param.type, subRoutine.localPrefix + param.name)->createReference();
+		if(has_flag(param.decorations, ParameterDecorations::SIGN_EXTEND))
+			it = intermediate::insertSignExtension(it, currentMethod, call->getArgument(i), ref);
+		else if(has_flag(param.decorations, ParameterDecorations::ZERO_EXTEND))
+			it = intermediate::insertZeroExtension(it, currentMethod, call->getArgument(i), ref);
+		else
+		{
+			it.emplace(new intermediate::MoveOperation(ref, call->getArgument(i)));
+			it.nextInMethod();
+		}
+	}
+	const long returnSite = static_cast<long>(subRoutine.returnLabels.size());
+	const Local* returnLabel = currentMethod.findOrCreateLocal(TYPE_LABEL, subRoutine.localPrefix + "return." + std::to_string(returnSite));
+	subRoutine.returnLabels.push_back(returnLabel);
+	it.emplace(new intermediate::MoveOperation(subRoutine.returnSite->createReference(), Value(Literal(returnSite), TYPE_INT8)));
+	it.nextInMethod();
+	it.emplace(new intermediate::Branch(subRoutine.entryLabel, COND_ALWAYS, BOOL_TRUE));
+	it.nextInMethod();
+	if(it.get() != call)
+		throw CompilationError(CompilationStep::OPTIMIZER, "Method call expected, got", it->to_string());
+	DEBUG_LOG("Replaced " << call->to_string() << " with call of sub-routine" << logging::endl);
+	const Optional<Value> output = call->getReturnType() == TYPE_VOID ? Optional<Value>(NO_VALUE) : call->getOutput();
+	it = it.erase();
+	it = currentMethod.emplaceLabel(it, new intermediate::BranchLabel(*returnLabel));
+	if(output)
+	{
+		it.nextInMethod();
+		it.emplace(new intermediate::MoveOperation(output.get(), currentMethod.findOrCreateLocal(subRoutine.method->returnType, subRoutine.localPrefix + "result")->createReference()));
+	}
+	return it;
+}
+
+/*
+ * Appends the body of the sub-routine to the end of the calling method.
+ * The returns jump back to the call-site selected by the index of the call-site set by the caller
+ */
+static void appendSubRoutine(Method& currentMethod, const SubRoutine& subRoutine)
 {
+	//the code before the sub-routine must not fall through into it
+	InstructionWalker lastIt = currentMethod.appendToEnd();
+	while(!lastIt.isStartOfMethod() && !lastIt.has())
+		lastIt.previousInMethod();
+	const bool fallsThrough = !lastIt.has<intermediate::Return>() && !(lastIt.has<intermediate::Branch>() && lastIt.get<intermediate::Branch>()->isUnconditional());
+	const Local* skipLabel = currentMethod.findOrCreateLocal(TYPE_LABEL, subRoutine.localPrefix + "skip");
+	if(fallsThrough)
+		currentMethod.appendToEnd(new intermediate::Branch(skipLabel, COND_ALWAYS, BOOL_TRUE));
+
+	const Local* returnLabel = currentMethod.findOrCreateLocal(TYPE_LABEL, subRoutine.localPrefix + "return");
+	currentMethod.appendToEnd(new intermediate::BranchLabel(*subRoutine.entryLabel));
+	for(const Parameter& arg : subRoutine.method->parameters)
+		currentMethod.findOrCreateLocal(arg.type, subRoutine.localPrefix + arg.name);
+	subRoutine.method->forAllInstructions([&currentMethod, &subRoutine, returnLabel](const intermediate::IntermediateInstruction* instr) -> void
+	{
+		if(const intermediate::Return* ret = instr->as<const intermediate::Return>())
+		{
+			if(ret->getReturnValue())
+			{
+				Value retVal(ret->getReturnValue().get());
+				if(retVal.hasType(ValueType::LOCAL))
+					retVal.local = const_cast<Local*>(currentMethod.findOrCreateLocal(retVal.type, subRoutine.localPrefix + retVal.local->name));
+				const Value result = currentMethod.findOrCreateLocal(subRoutine.method->returnType, subRoutine.localPrefix + "result")->createReference();
+				currentMethod.appendToEnd(new intermediate::MoveOperation(result, retVal));
+			}
+			currentMethod.appendToEnd(new intermediate::Branch(returnLabel, COND_ALWAYS, BOOL_TRUE));
+		}
+		else
+			currentMethod.appendToEnd(instr->copyFor(currentMethod, subRoutine.localPrefix));
+	});
+
+	//the index of the call-site selects the label to jump back to
+	currentMethod.appendToEnd(new intermediate::BranchLabel(*returnLabel));
+	for(std::size_t i = 0; i + 1 < subRoutine.returnLabels.size(); ++i)
+	{
+		const Value cond = currentMethod.addNewLocal(TYPE_BOOL, "%return_site");
+		currentMethod.appendToEnd(new intermediate::Comparison(intermediate::COMP_EQ, cond, subRoutine.returnSite->createReference(), Value(Literal(static_cast<long>(i)), TYPE_INT8)));
+		currentMethod.appendToEnd(new intermediate::Branch(subRoutine.returnLabels[i], COND_ZERO_CLEAR, cond));
+	}
+	currentMethod.appendToEnd(new intermediate::Branch(subRoutine.returnLabels.back(), COND_ALWAYS, BOOL_TRUE));
+	if(fallsThrough)
+		currentMethod.appendToEnd(new intermediate::BranchLabel(*skipLabel));
+}
+
+static Method& inlineMethod(const std::vector<std::unique_ptr<Method>>& methods, Method& currentMethod, const Configuration& config)
+{
+	std::vector<SubRoutine> subRoutines = selectSubRoutines(methods, currentMethod, config);
 	auto it = currentMethod.walkAllInstructions();
     while(!it.isEndOfMethod())
     {
@@ -36,14 +190,15 @@ static Method& inlineMethod(const std::string& localPrefix, const std::vector<st
         {
             //search for method with matching signature
             const Method* calledMethod = matchSignatures(methods, call);
-            if(calledMethod != nullptr)
+            auto subRoutineIt = std::find_if(subRoutines.begin(), subRoutines.end(), [calledMethod](const SubRoutine& subRoutine) -> bool { return subRoutine.method == calledMethod;});
+            if(calledMethod != nullptr && subRoutineIt != subRoutines.end())
+            	it = callSubRoutine(currentMethod, it, call, *subRoutineIt);
+            else if(calledMethod != nullptr)
             {
                 const std::size_t numInstructions = currentMethod.countInstructions();
-                //recursively search for used methods
-                const std::string newLocalPrefix = localPrefix + (!(call->getReturnType() == TYPE_VOID) ? call->getOutput().get().local->name : std::string("%") + (calledMethod->name + ".") + std::to_string(rand())) + '.';
+                const std::string newLocalPrefix = (!(call->getReturnType() == TYPE_VOID) ? call->getOutput().get().local->name : std::string("%") + (calledMethod->name + ".") + std::to_string(rand())) + '.';
                 const Local* methodEndLabel = currentMethod.findOrCreateLocal(TYPE_LABEL, newLocalPrefix + "after");
-                inlineMethod(newLocalPrefix, methods, const_cast<Method&>(*calledMethod));
-                //at this point, the called method has already inlined all other methods
+                //the called method has already inlined all other methods (see #getInliningOrder), so its body can be copied as is
             
                 //Starting at lowest level (here), insert in parent
                 //map parameters to arguments
@@ -71,14 +226,14 @@ static Method& inlineMethod(const std::string& localPrefix, const std::vector<st
                 	currentMethod.findOrCreateLocal(arg.type, newLocalPrefix + arg.name);
                 }
                 //TODO maybe this is not needed at all? Since IntermediateInstruction#copyFor already creates all used locals
-                for(const auto& pair : calledMethod->readLocals())
+                for(const auto& loc : calledMethod->readLocals())
                 {
-                	currentMethod.findOrCreateLocal(pair.second.type, newLocalPrefix + pair.second.name);
+                	currentMethod.findOrCreateLocal(loc->type, newLocalPrefix + loc->name);
                 }
                 //insert instructions
                 calledMethod->forAllInstructions([&it, &currentMethod, &methodEndLabel, &newLocalPrefix, &call](const intermediate::IntermediateInstruction* instr) -> void
                 {
-                    const intermediate::Return* ret = dynamic_cast<const intermediate::Return*>(instr);
+                    const intermediate::Return* ret = instr->as<intermediate::Return>();
                     if(ret != nullptr)
                     {
                         if(ret->getReturnValue())
@@ -100,8 +255,8 @@ static Method& inlineMethod(const std::string& localPrefix, const std::vector<st
                     {
                         //prefix locals with destination of call
                         //copy instructions
-                    	if(dynamic_cast<const intermediate::BranchLabel*>(instr) != nullptr)
-                    		it = currentMethod.emplaceLabel(it, dynamic_cast<intermediate::BranchLabel*>(instr->copyFor(currentMethod, newLocalPrefix)));
+                    	if(instr->is<intermediate::BranchLabel>())
+                    		it = currentMethod.emplaceLabel(it, instr->copyFor(currentMethod, newLocalPrefix)->as<intermediate::BranchLabel>());
                     	else
                     		it.emplace(instr->copyFor(currentMethod, newLocalPrefix));
                     }
@@ -111,7 +266,7 @@ static Method& inlineMethod(const std::string& localPrefix, const std::vector<st
                 {
                     throw CompilationError(CompilationStep::OPTIMIZER, "Method call expected, got", it->to_string());
                 }
-                logging::debug() << "Function body for " << call->to_string() << " inlined, added " << (currentMethod.countInstructions() - 1 - numInstructions) << " instructions" << logging::endl;
+                DEBUG_LOG("Function body for " << call->to_string() << " inlined, added " << (currentMethod.countInstructions() - 1 - numInstructions) << " instructions" << logging::endl);
                 //replace method-call from parent with label to jump to (for returns)
                 it = it.erase();
                 it = currentMethod.emplaceLabel(it, new intermediate::BranchLabel(*methodEndLabel));
@@ -119,15 +274,288 @@ static Method& inlineMethod(const std::string& localPrefix, const std::vector<st
         }
         it.nextInMethod();
     }
+    for(const SubRoutine& subRoutine : subRoutines)
+    	appendSubRoutine(currentMethod, subRoutine);
     
     return currentMethod;
 }
 
 void optimizations::inlineMethods(const Module& module, Method& kernel, const Configuration& config)
 {
-    logging::info() << "-----" << logging::endl;
-    logging::info() << "Inlining functions for kernel: " << kernel.name << logging::endl;
-    //Starting at kernel
-    inlineMethod("", module.methods, kernel);
-    logging::info() << "-----" << logging::endl;
+    INFO_LOG("-----" << logging::endl);
+    INFO_LOG("Inlining functions for: " << kernel.name << logging::endl);
+    inlineMethod(module.methods, kernel, config);
+    INFO_LOG("-----" << logging::endl);
+}
+
+static void addInInliningOrder(const Module& module, Method* method, FastSet<const Method*>& visitedMethods, std::vector<Method*>& order)
+{
+	if(!visitedMethods.emplace(method).second)
+		//already listed (or recursive call, which is not supported anyway)
+		return;
+	method->forAllInstructions([&](const intermediate::IntermediateInstruction* instr) -> void
+	{
+		if(const intermediate::MethodCall* call = instr->as<intermediate::MethodCall>())
+		{
+			const Method* calledMethod = matchSignatures(module.methods, call);
+			if(calledMethod != nullptr)
+				addInInliningOrder(module, const_cast<Method*>(calledMethod), visitedMethods, order);
+		}
+	});
+	order.push_back(method);
+}
+
+std::vector<Method*> optimizations::getInliningOrder(const Module& module)
+{
+	FastSet<const Method*> visitedMethods;
+	std::vector<Method*> order;
+	order.reserve(module.methods.size());
+	for(const auto& method : module.methods)
+	{
+		if(method->isKernel)
+			addInInliningOrder(module, method.get(), visitedMethods, order);
+	}
+	return order;
+}
+
+static void markUsedGlobals(const Local* local, FastSet<const Global*>& usedGlobals);
+
+static void markUsedGlobals(const Value& value, FastSet<const Global*>& usedGlobals)
+{
+	if(value.hasType(ValueType::LOCAL))
+		markUsedGlobals(value.local, usedGlobals);
+	else if(value.hasType(ValueType::CONTAINER))
+	{
+		for(const Value& element : value.container.elements)
+			markUsedGlobals(element, usedGlobals);
+	}
+}
+
+static void markUsedGlobals(const Local* local, FastSet<const Global*>& usedGlobals)
+{
+	//follow the chain of references (e.g. a pointer into a global) up to the referenced global
+	while(local != nullptr)
+	{
+		if(const Global* global = local->as<Global>())
+		{
+			//the initial values of globals can reference other globals
+			if(usedGlobals.emplace(global).second)
+				markUsedGlobals(global->value, usedGlobals);
+			return;
+		}
+		local = local->reference.first;
+	}
+}
+
+void optimizations::removeUnusedMethods(Module& module, const Configuration& config)
+{
+	//only compile the selected kernels, the other kernels are still kept as long as they are called by the selected ones
+	for(const std::string& kernelName : config.selectedKernels)
+	{
+		const bool found = std::any_of(module.methods.begin(), module.methods.end(), [&kernelName](const std::unique_ptr<Method>& m) -> bool
+		{
+			return m->isKernel && m->name == kernelName;
+		});
+		if(!found)
+			throw CompilationError(CompilationStep::OPTIMIZER, "Selected kernel does not exist", kernelName);
+	}
+	if(!config.selectedKernels.empty())
+	{
+		for(auto& method : module.methods)
+		{
+			if(method->isKernel && std::find(config.selectedKernels.begin(), config.selectedKernels.end(), method->name) == config.selectedKernels.end())
+			{
+				DEBUG_LOG("Skipping not selected kernel: " << method->name << logging::endl);
+				method->isKernel = false;
+			}
+		}
+	}
+
+	//all methods called (directly and indirectly) by the kernels
+	FastSet<const Method*> usedMethods;
+	std::vector<const Method*> openMethods;
+	for(Method* kernel : module.getKernels())
+	{
+		usedMethods.emplace(kernel);
+		openMethods.push_back(kernel);
+	}
+	FastSet<const Global*> usedGlobals;
+	while(!openMethods.empty())
+	{
+		const Method* method = openMethods.back();
+		openMethods.pop_back();
+		method->forAllInstructions([&](const intermediate::IntermediateInstruction* instr) -> void
+		{
+			if(const intermediate::MethodCall* call = instr->as<intermediate::MethodCall>())
+			{
+				const Method* calledMethod = matchSignatures(module.methods, call);
+				if(calledMethod != nullptr && usedMethods.emplace(calledMethod).second)
+					openMethods.push_back(calledMethod);
+			}
+			if(instr->getOutput())
+				markUsedGlobals(instr->getOutput().get(), usedGlobals);
+			for(const Value& arg : instr->getArguments())
+				markUsedGlobals(arg, usedGlobals);
+		});
+		for(const auto& loc : method->readLocals())
+			markUsedGlobals(loc.get(), usedGlobals);
+	}
+
+	const std::size_t numMethods = module.methods.size();
+	module.methods.erase(std::remove_if(module.methods.begin(), module.methods.end(), [&usedMethods](const std::unique_ptr<Method>& m) -> bool
+	{
+		return usedMethods.find(m.get()) == usedMethods.end();
+	}), module.methods.end());
+
+	//the globals are removed after the methods, since the instructions of the removed methods still reference them
+	const std::size_t numGlobals = module.globalData.size();
+	auto it = module.globalData.begin();
+	while(it != module.globalData.end())
+	{
+		if(usedGlobals.find(&(*it)) == usedGlobals.end())
+			it = module.globalData.erase(it);
+		else
+			++it;
+	}
+	DEBUG_LOG("Removed " << (numMethods - module.methods.size()) << " unused methods and " << (numGlobals - module.globalData.size()) << " unused globals" << logging::endl);
+}
+
+/*
+ * Merges the decorations of the kernel parameters bound to the same parameter of the fused kernel:
+ * the parameter is read and written, if any kernel reads or writes it, but is only read-only or restrict, if it is for all kernels
+ */
+static ParameterDecorations mergeDecorations(const std::vector<const Parameter*>& params)
+{
+	ParameterDecorations decorations = ParameterDecorations::NONE;
+	bool isVolatile = false;
+	bool isReadOnly = true;
+	bool isRestrict = true;
+	for(const Parameter* param : params)
+	{
+		decorations = add_flag(decorations, static_cast<ParameterDecorations>(static_cast<unsigned>(param->decorations) &
+				static_cast<unsigned>(combine_flags(combine_flags(ParameterDecorations::INPUT, ParameterDecorations::OUTPUT), combine_flags(ParameterDecorations::ZERO_EXTEND, ParameterDecorations::SIGN_EXTEND)))));
+		isVolatile = isVolatile || has_flag(param->decorations, ParameterDecorations::VOLATILE);
+		isReadOnly = isReadOnly && has_flag(param->decorations, ParameterDecorations::READ_ONLY) && !has_flag(param->decorations, ParameterDecorations::OUTPUT);
+		isRestrict = isRestrict && has_flag(param->decorations, ParameterDecorations::RESTRICT);
+	}
+	//the flag for volatile memory contains the read-only and restrict bits
+	if(isVolatile)
+		return add_flag(decorations, ParameterDecorations::VOLATILE);
+	if(isReadOnly)
+		decorations = add_flag(decorations, ParameterDecorations::READ_ONLY);
+	if(isRestrict)
+		decorations = add_flag(decorations, ParameterDecorations::RESTRICT);
+	return decorations;
+}
+
+static void fuseKernel(Module& module, const KernelFusion& fusion)
+{
+	if(fusion.kernels.empty() || fusion.kernels.size() != fusion.parameterBindings.size())
+		throw CompilationError(CompilationStep::OPTIMIZER, "Number of parameter bindings does not match the number of kernels to fuse", fusion.kernelName);
+	if(std::any_of(module.methods.begin(), module.methods.end(), [&fusion](const std::unique_ptr<Method>& m) -> bool { return m->name == fusion.kernelName;}))
+		throw CompilationError(CompilationStep::OPTIMIZER, "Fused kernel has the name of an existing method", fusion.kernelName);
+
+	//the kernels in the order of execution and the kernel-parameters bound to each parameter of the fused kernel
+	std::vector<const Method*> kernels;
+	std::vector<std::vector<const Parameter*>> boundParameters;
+	for(std::size_t i = 0; i < fusion.kernels.size(); ++i)
+	{
+		auto kernelIt = std::find_if(module.methods.begin(), module.methods.end(), [&](const std::unique_ptr<Method>& m) -> bool
+		{
+			return m->isKernel && m->name == fusion.kernels[i];
+		});
+		if(kernelIt == module.methods.end())
+			throw CompilationError(CompilationStep::OPTIMIZER, "Kernel to fuse does not exist", fusion.kernels[i]);
+		const Method* kernel = kernelIt->get();
+		const std::vector<unsigned>& bindings = fusion.parameterBindings[i];
+		if(bindings.size() != kernel->parameters.size())
+			throw CompilationError(CompilationStep::OPTIMIZER, "Number of parameter bindings does not match the parameters of the fused kernel", kernel->name);
+		for(std::size_t k = 0; k < bindings.size(); ++k)
+		{
+			if(bindings[k] >= boundParameters.size())
+				boundParameters.resize(bindings[k] + 1);
+			const Parameter& param = kernel->parameters[k];
+			if(!boundParameters[bindings[k]].empty() && !(boundParameters[bindings[k]].front()->type == param.type))
+				throw CompilationError(CompilationStep::OPTIMIZER, "Parameters bound to the same parameter of the fused kernel have different types", param.to_string());
+			boundParameters[bindings[k]].push_back(&param);
+		}
+		kernels.push_back(kernel);
+	}
+
+	module.methods.emplace_back(new Method(module));
+	Method& fused = *module.methods.back();
+	intermediate::InstructionArena::Scope arenaScope(fused.getInstructionArena());
+	fused.isKernel = true;
+	fused.name = fusion.kernelName;
+	fused.returnType = TYPE_VOID;
+	fused.parameters.reserve(boundParameters.size());
+	for(std::size_t i = 0; i < boundParameters.size(); ++i)
+	{
+		if(boundParameters[i].empty())
+			throw CompilationError(CompilationStep::OPTIMIZER, "Parameter of the fused kernel is not bound to any kernel parameter", std::to_string(i));
+		const Parameter* param = boundParameters[i].front();
+		//different kernels can use the same names for their parameters
+		const bool isDuplicateName = std::any_of(fused.parameters.begin(), fused.parameters.end(), [param](const Parameter& p) -> bool { return p.name == param->name;});
+		fused.parameters.emplace_back(isDuplicateName ? param->name + "." + std::to_string(i) : param->name, param->type, mergeDecorations(boundParameters[i]));
+		fused.parameters.back().parameterName = param->parameterName;
+	}
+	//the meta-data of the parameters are taken from the first kernel parameter bound to them
+	for(const MetaDataType type : {MetaDataType::ARG_ADDR_SPACES, MetaDataType::ARG_ACCESS_QUALIFIERS, MetaDataType::ARG_TYPE_NAMES, MetaDataType::ARG_TYPE_QUALIFIERS, MetaDataType::ARG_NAMES})
+	{
+		for(std::size_t i = 0; i < boundParameters.size(); ++i)
+		{
+			const Method* kernel = nullptr;
+			std::size_t index = 0;
+			for(std::size_t k = 0; k < kernels.size() && kernel == nullptr; ++k)
+			{
+				auto paramIt = std::find(fusion.parameterBindings[k].begin(), fusion.parameterBindings[k].end(), static_cast<unsigned>(i));
+				if(paramIt != fusion.parameterBindings[k].end())
+				{
+					kernel = kernels[k];
+					index = static_cast<std::size_t>(paramIt - fusion.parameterBindings[k].begin());
+				}
+			}
+			auto metaIt = kernel->metaData.find(type);
+			if(metaIt != kernel->metaData.end() && index < metaIt->second.size())
+			{
+				std::vector<std::string>& entries = fused.metaData[type];
+				entries.resize(i + 1);
+				entries[i] = metaIt->second[index];
+			}
+		}
+	}
+	//all kernels are executed with the same work-group size, so the required sizes need to match
+	for(const Method* kernel : kernels)
+	{
+		for(const MetaDataType type : {MetaDataType::WORK_GROUP_SIZES, MetaDataType::WORK_GROUP_SIZES_HINT})
+		{
+			auto metaIt = kernel->metaData.find(type);
+			if(metaIt == kernel->metaData.end())
+				continue;
+			auto fusedIt = fused.metaData.find(type);
+			if(fusedIt == fused.metaData.end())
+				fused.metaData.emplace(type, metaIt->second);
+			else if(type == MetaDataType::WORK_GROUP_SIZES && fusedIt->second != metaIt->second)
+				throw CompilationError(CompilationStep::OPTIMIZER, "Kernels to fuse require different work-group sizes", kernel->name);
+		}
+	}
+
+	//the kernels are called after each other and then inlined like any other method
+	fused.appendToEnd(new intermediate::BranchLabel(*fused.findOrCreateLocal(TYPE_LABEL, BasicBlock::DEFAULT_BLOCK)));
+	for(std::size_t i = 0; i < kernels.size(); ++i)
+	{
+		std::vector<Value> args;
+		args.reserve(kernels[i]->parameters.size());
+		for(unsigned index : fusion.parameterBindings[i])
+			args.push_back(fused.parameters[index].createReference());
+		fused.appendToEnd(new intermediate::MethodCall(kernels[i]->name, args));
+	}
+	fused.appendToEnd(new intermediate::Return());
+	DEBUG_LOG("Fused " << kernels.size() << " kernels into kernel '" << fused.name << "' with " << fused.parameters.size() << " parameters" << logging::endl);
+}
+
+void optimizations::fuseKernels(Module& module, const Configuration& config)
+{
+	for(const KernelFusion& fusion : config.fusedKernels)
+		fuseKernel(module, fusion);
 }
@@ -17,7 +17,35 @@ namespace vc4c
 {
 	namespace optimizations
 	{
+		/*
+		 * Inlines the bodies of all methods called by the given method.
+		 *
+		 * Large methods called from several call-sites, which would increase the code size too much when inlined everywhere (e.g. the rounds of hash functions),
+		 * are instead contained once as sub-routine at the end of the calling method. The callers write the parameters and the index of their call-site and jump into the sub-routine,
+		 * which jumps back to the call-site selected by that index.
+		 *
+		 * All called methods need to have their method-calls already inlined, see #getInliningOrder
+		 */
 		void inlineMethods(const Module& module, Method& kernel, const Configuration& config);
+
+		/*
+		 * Returns all methods reachable from the kernels, every method is listed after all the methods it calls
+		 */
+		std::vector<Method*> getInliningOrder(const Module& module);
+
+		/*
+		 * Removes all methods not reachable from the kernels (or only the kernels selected in the configuration)
+		 * as well as all global data not used by the remaining methods
+		 */
+		void removeUnusedMethods(Module& module, const Configuration& config);
+
+		/*
+		 * Creates the fused kernels (see Configuration#fusedKernels), each calling the chained kernels after each other with the bound parameters.
+		 *
+		 * The calls are inlined like all other method calls, so the values passed between the kernels via memory can then be forwarded (see #forwardMemoryAccesses).
+		 * The chained kernels are kept, unless they are not selected to be compiled.
+		 */
+		void fuseKernels(Module& module, const Configuration& config);
 	}
 }
 
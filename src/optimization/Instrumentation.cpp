@@ -0,0 +1,174 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Instrumentation.h"
+
+#include "../periphery/VPM.h"
+#include "../Logging.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace vc4c;
+using namespace vc4c::optimizations;
+using namespace vc4c::intermediate;
+
+//the counters of 16 blocks are stored in the elements of a single vector
+static constexpr std::size_t COUNTERS_PER_VECTOR = NATIVE_VECTOR_SIZE;
+//a block is hot, if it is executed at least 1/HOT_BLOCK_FRACTION times as often as the most executed block of the kernel
+static constexpr uint64_t HOT_BLOCK_FRACTION = 8;
+
+void optimizations::instrumentBasicBlocks(const Module& module, Method& kernel, const Configuration& config)
+{
+	if(config.threadedExecution)
+	{
+		//both hardware threads of a QPU would use the same counters and overwrite the counts of each other
+		logging::warn() << "Instrumenting basic blocks is not supported for threaded execution, skipping kernel: " << kernel.name << logging::endl;
+		return;
+	}
+	std::vector<BasicBlock*> blocks;
+	for(BasicBlock& block : kernel.getBasicBlocks())
+	{
+		if(blocks.size() == MAX_INSTRUMENTED_BLOCKS)
+		{
+			logging::warn() << "Kernel '" << kernel.name << "' has more than " << MAX_INSTRUMENTED_BLOCKS << " basic blocks, only the first blocks are counted" << logging::endl;
+			break;
+		}
+		blocks.push_back(&block);
+	}
+	if(blocks.empty())
+		return;
+
+	const DataType counterType = TYPE_INT32.toVectorType(COUNTERS_PER_VECTOR);
+	const std::size_t numVectors = (blocks.size() + COUNTERS_PER_VECTOR - 1) / COUNTERS_PER_VECTOR;
+	const Value buffer = kernel.findOrCreateLocal(TYPE_INT32.toPointerType(), Method::BLOCK_PROFILE_BUFFER)->createReference();
+
+	//every QPU accumulates the counts of all work-groups it executes in its own part of the buffer
+	auto it = kernel.walkAllInstructions();
+	if(it.has<BranchLabel>())
+		it.nextInBlock();
+	const Value qpuNumber = kernel.addNewLocal(TYPE_INT8, "%qpu_number");
+	const Value qpuOffset = kernel.addNewLocal(TYPE_INT32, "%block_counters_offset");
+	it.emplace(new MoveOperation(qpuNumber, Value(REG_QPU_NUMBER, TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("mul24", qpuOffset, qpuNumber, Value(Literal(static_cast<long>(numVectors * counterType.getPhysicalWidth())), TYPE_INT32)));
+	it.nextInBlock();
+	std::vector<Value> counters;
+	std::vector<Value> addresses;
+	for(std::size_t i = 0; i < numVectors; ++i)
+	{
+		Value offset = qpuOffset;
+		if(i > 0)
+		{
+			offset = kernel.addNewLocal(TYPE_INT32, "%block_counters_offset");
+			it.emplace(new Operation("add", offset, qpuOffset, Value(Literal(static_cast<long>(i * counterType.getPhysicalWidth())), TYPE_INT32)));
+			it.nextInBlock();
+		}
+		addresses.push_back(kernel.addNewLocal(TYPE_INT32.toPointerType(), "%block_counters_address"));
+		it.emplace(new Operation("add", addresses.back(), buffer, offset));
+		it.nextInBlock();
+		counters.push_back(kernel.addNewLocal(counterType, "%block_counters"));
+		it = periphery::insertReadDMA(kernel, it, counters.back(), addresses.back());
+	}
+
+	for(std::size_t i = 0; i < blocks.size(); ++i)
+	{
+		//the counter of the first block can only be incremented after the counters are loaded
+		InstructionWalker blockIt = i == 0 ? it : blocks[i]->begin().nextInBlock();
+		//only the element of the counter of this block is incremented
+		blockIt.emplace(new Operation("xor", NOP_REGISTER, ELEMENT_NUMBER_REGISTER, Value(Literal(static_cast<long>(i % COUNTERS_PER_VECTOR)), TYPE_INT8), COND_ALWAYS, SetFlag::SET_FLAGS));
+		blockIt.nextInBlock();
+		const Value& counter = counters[i / COUNTERS_PER_VECTOR];
+		blockIt.emplace(new Operation("add", counter, counter, INT_ONE, COND_ZERO_SET));
+		kernel.instrumentedBlocks.push_back(blocks[i]->getLabel()->getLabel()->name);
+	}
+
+	//the counters are written back at every exit of the kernel
+	bool hasReturn = false;
+	it = kernel.walkAllInstructions();
+	while(!it.isEndOfMethod())
+	{
+		if(it.has<Return>())
+		{
+			for(std::size_t i = 0; i < numVectors; ++i)
+				it = periphery::insertWriteDMA(kernel, it, counters[i], addresses[i]);
+			hasReturn = true;
+		}
+		it.nextInMethod();
+	}
+	if(!hasReturn)
+	{
+		//the returns are already eliminated, so the kernel ends with its last block
+		it = kernel.appendToEnd();
+		for(std::size_t i = 0; i < numVectors; ++i)
+			it = periphery::insertWriteDMA(kernel, it, counters[i], addresses[i]);
+	}
+	DEBUG_LOG("Instrumented " << blocks.size() << " basic blocks of kernel '" << kernel.name << "' with " << numVectors << " counter vectors" << logging::endl);
+}
+
+void optimizations::writeBlockLayout(const Module& module, std::ostream& stream)
+{
+	for(const auto& method : module.methods)
+	{
+		for(std::size_t i = 0; i < method->instrumentedBlocks.size(); ++i)
+			stream << method->name << ' ' << i << ' ' << method->instrumentedBlocks[i] << " 0" << std::endl;
+	}
+}
+
+std::vector<BlockExecutionCount> optimizations::readBlockProfile(std::istream& stream)
+{
+	std::vector<BlockExecutionCount> profile;
+	std::string line;
+	while(std::getline(stream, line))
+	{
+		if(line.empty() || line[0] == '#')
+			continue;
+		std::istringstream entry(line);
+		BlockExecutionCount count;
+		std::size_t index;
+		if(!(entry >> count.kernelName >> index >> count.blockLabel >> count.count))
+			throw CompilationError(CompilationStep::GENERAL, "Invalid entry in block-profile", line);
+		profile.push_back(count);
+	}
+	return profile;
+}
+
+Optional<uint64_t> optimizations::getExecutionCount(const Method& method, const BasicBlock& block, const Configuration& config)
+{
+	const std::string& label = block.getLabel()->getLabel()->name;
+	const auto it = std::find_if(config.blockProfile.begin(), config.blockProfile.end(), [&](const BlockExecutionCount& count) -> bool
+	{
+		return count.kernelName == method.name && count.blockLabel == label;
+	});
+	if(it == config.blockProfile.end())
+		return {};
+	return it->count;
+}
+
+Optional<double> optimizations::getRelativeFrequency(Method& method, const BasicBlock& block, const Configuration& config)
+{
+	if(config.blockProfile.empty() || method.getBasicBlocks().empty())
+		return {};
+	const Optional<uint64_t> count = getExecutionCount(method, block, config);
+	const Optional<uint64_t> kernelCount = getExecutionCount(method, method.getBasicBlocks().front(), config);
+	if(!count || !kernelCount || kernelCount.get() == 0)
+		return {};
+	return static_cast<double>(count.get()) / static_cast<double>(kernelCount.get());
+}
+
+bool optimizations::isHotBlock(const Method& method, const BasicBlock& block, const Configuration& config)
+{
+	const Optional<uint64_t> count = getExecutionCount(method, block, config);
+	if(!count || count.get() == 0)
+		return false;
+	uint64_t maxCount = 0;
+	for(const BlockExecutionCount& entry : config.blockProfile)
+	{
+		if(entry.kernelName == method.name)
+			maxCount = std::max(maxCount, entry.count);
+	}
+	return count.get() * HOT_BLOCK_FRACTION >= maxCount;
+}
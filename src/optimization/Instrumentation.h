@@ -0,0 +1,59 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef OPTIMIZATION_INSTRUMENTATION_H
+#define OPTIMIZATION_INSTRUMENTATION_H
+
+#include <config.h>
+#include "../Module.h"
+
+#include <istream>
+#include <ostream>
+
+namespace vc4c
+{
+	namespace optimizations
+	{
+		/*
+		 * The maximum number of basic blocks counted per kernel, every 16 counters occupy a register for the whole kernel
+		 */
+		constexpr std::size_t MAX_INSTRUMENTED_BLOCKS{64};
+
+		/*
+		 * Inserts a counter into (up to MAX_INSTRUMENTED_BLOCKS) basic blocks of the kernel, which is incremented on every execution of the block.
+		 *
+		 * The counters are loaded at the start of the kernel from the part of the current QPU in the buffer passed by the run-time (see Method#BLOCK_PROFILE_BUFFER)
+		 * and written back at its end, so they accumulate the counts of all work-groups executed.
+		 * The labels of the counted blocks are stored in the order of the counters in Method#instrumentedBlocks
+		 */
+		void instrumentBasicBlocks(const Module& module, Method& kernel, const Configuration& config);
+
+		/*
+		 * Writes a "<kernel> <index> <label> 0" line for every counter of the instrumented kernels.
+		 * The run-time fills in the measured counts (summed over all QPUs) and passes them to a later compilation (see Configuration#blockProfile)
+		 */
+		void writeBlockLayout(const Module& module, std::ostream& stream);
+		/*
+		 * Reads the block-profile in the format written by #writeBlockLayout with the counts filled in
+		 */
+		std::vector<BlockExecutionCount> readBlockProfile(std::istream& stream);
+
+		/*
+		 * Returns the measured number of executions of the block, if the configuration contains a block-profile for it
+		 */
+		Optional<uint64_t> getExecutionCount(const Method& method, const BasicBlock& block, const Configuration& config);
+		/*
+		 * Returns the measured number of executions of the block per execution of the kernel (its first block), if the configuration contains a block-profile for both blocks
+		 */
+		Optional<double> getRelativeFrequency(Method& method, const BasicBlock& block, const Configuration& config);
+		/*
+		 * Whether the block was measured to be executed a significant fraction as often as the most executed block of the kernel
+		 */
+		bool isHotBlock(const Method& method, const BasicBlock& block, const Configuration& config);
+	}
+}
+
+#endif /* OPTIMIZATION_INSTRUMENTATION_H */
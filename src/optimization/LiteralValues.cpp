@@ -5,9 +5,11 @@
  */
 
 #include "LiteralValues.h"
-#include "log.h"
+#include "Instrumentation.h"
+#include "../Logging.h"
 #include "../Profiler.h"
 #include "../InstructionWalker.h"
+#include "../analysis/AnalysisManager.h"
 
 #include <cmath>
 #include <algorithm>
@@ -15,6 +17,259 @@
 using namespace vc4c;
 using namespace vc4c::optimizations;
 
+static bool fitsSmallImmediate(const long value)
+{
+	return value >= -16 && value <= 15;
+}
+
+static bool isPowerOfTwo(const int64_t value)
+{
+	return value > 0 && (value & (value - 1)) == 0;
+}
+
+static long log2(int64_t value)
+{
+	long result = 0;
+	while(value > 1)
+	{
+		value >>= 1;
+		++result;
+	}
+	return result;
+}
+
+static int64_t gcd(int64_t a, int64_t b)
+{
+	while(b != 0)
+	{
+		const int64_t tmp = a % b;
+		a = b;
+		b = tmp;
+	}
+	return a;
+}
+
+/*
+ * Emits the instructions assembling a vector constant, or only counts them to compare the different ways of building it
+ */
+struct VectorConstantBuilder
+{
+	Method& method;
+	InstructionWalker it;
+	const DataType type;
+	const bool emit;
+	unsigned numInstructions = 0;
+
+	VectorConstantBuilder(Method& method, InstructionWalker it, const DataType& type, bool emit) : method(method), it(it), type(type), emit(emit)
+	{
+	}
+
+	Value loadPerElement(const std::vector<long>& values, const intermediate::LoadType loadType)
+	{
+		++numInstructions;
+		if(!emit)
+			return UNDEFINED_VALUE;
+		const Value tmp = method.addNewLocal(type, "%container");
+		it.emplace(new intermediate::LoadImmediate(tmp, intermediate::LoadImmediate::toPerElementImmediate(values, loadType), loadType));
+		it.nextInBlock();
+		return tmp;
+	}
+
+	Value calculate(const std::string& opCode, const Value& arg0, const Value& arg1)
+	{
+		++numInstructions;
+		//literal operands not fitting into a small immediate are loaded separately (see #handleImmediate)
+		for(const Value& arg : {arg0, arg1})
+			if(arg.hasType(ValueType::LITERAL) && !fitsSmallImmediate(arg.literal.integer))
+				++numInstructions;
+		if(!emit)
+			return UNDEFINED_VALUE;
+		const Value tmp = method.addNewLocal(type, "%container");
+		it.emplace(new intermediate::Operation(opCode, tmp, arg0, arg1));
+		it.nextInBlock();
+		return tmp;
+	}
+};
+
+static Value toLiteral(const int64_t value)
+{
+	return Value(Literal(static_cast<long>(static_cast<int32_t>(value))), TYPE_INT32);
+}
+
+/*
+ * Builds the vector as offset + element-number * factor
+ */
+static Value buildAffineVector(VectorConstantBuilder& builder, const int64_t offset, const int64_t factor)
+{
+	Value result = ELEMENT_NUMBER_REGISTER;
+	const int64_t absFactor = factor < 0 ? -factor : factor;
+	if(absFactor != 1 && isPowerOfTwo(absFactor))
+		result = builder.calculate("shl", result, toLiteral(log2(absFactor)));
+	else if(absFactor != 1)
+		result = builder.calculate("mul24", result, toLiteral(absFactor));
+	if(factor < 0)
+		return builder.calculate("sub", toLiteral(offset), result);
+	if(offset != 0)
+		result = builder.calculate("add", result, toLiteral(offset));
+	return result;
+}
+
+/*
+ * Builds the vector as offset + scale * (the base-4 digits of the elements, each loaded with a per-element load-immediate)
+ */
+static Value buildDigitVector(VectorConstantBuilder& builder, const std::vector<uint64_t>& scaledValues, const int64_t offset, const int64_t scale)
+{
+	const uint64_t maxValue = *std::max_element(scaledValues.begin(), scaledValues.end());
+	int topDigit = 0;
+	while((maxValue >> (2 * topDigit + 2)) != 0)
+		++topDigit;
+	auto getDigits = [&scaledValues](int digit) -> std::vector<long>
+	{
+		std::vector<long> digits;
+		digits.reserve(scaledValues.size());
+		for(const uint64_t value : scaledValues)
+			digits.push_back(static_cast<long>((value >> (2 * digit)) & 0x3));
+		return digits;
+	};
+	Value result = builder.loadPerElement(getDigits(topDigit), intermediate::LoadType::PER_ELEMENT_UNSIGNED);
+	long pendingShift = 0;
+	for(int digit = topDigit - 1; digit >= 0; --digit)
+	{
+		pendingShift += 2;
+		const std::vector<long> digits = getDigits(digit);
+		if(std::all_of(digits.begin(), digits.end(), [](long d) -> bool { return d == 0; }))
+			continue;
+		result = builder.calculate("shl", result, toLiteral(pendingShift));
+		pendingShift = 0;
+		result = builder.calculate("add", result, builder.loadPerElement(digits, intermediate::LoadType::PER_ELEMENT_UNSIGNED));
+	}
+	if(isPowerOfTwo(scale))
+		pendingShift += log2(scale);
+	if(pendingShift != 0)
+		result = builder.calculate("shl", result, toLiteral(pendingShift));
+	if(!isPowerOfTwo(scale))
+		result = builder.calculate("mul24", result, toLiteral(scale));
+	if(offset != 0)
+		result = builder.calculate("add", result, toLiteral(offset));
+	return result;
+}
+
+/*
+ * The ways of building an integer vector constant without inserting the elements one by one
+ */
+enum class VectorConstantStrategy
+{
+	NONE,
+	PER_ELEMENT_SIGNED,
+	AFFINE,
+	DIGITS
+};
+
+struct VectorConstantPlan
+{
+	VectorConstantStrategy strategy = VectorConstantStrategy::NONE;
+	unsigned numInstructions = 0;
+	int64_t offset = 0;
+	int64_t factor = 1;
+	std::vector<uint64_t> scaledValues;
+
+	Value build(VectorConstantBuilder& builder, const std::vector<int64_t>& values) const
+	{
+		switch(strategy)
+		{
+			case VectorConstantStrategy::PER_ELEMENT_SIGNED:
+				return builder.loadPerElement(std::vector<long>(values.begin(), values.end()), intermediate::LoadType::PER_ELEMENT_SIGNED);
+			case VectorConstantStrategy::AFFINE:
+				return buildAffineVector(builder, offset, factor);
+			case VectorConstantStrategy::DIGITS:
+				return buildDigitVector(builder, scaledValues, offset, factor);
+			default:
+				throw CompilationError(CompilationStep::OPTIMIZER, "No strategy selected to build vector constant");
+		}
+	}
+};
+
+/*
+ * Selects the cheapest way of building the integer vector, undefined elements (not set in defined) can take any value
+ */
+static VectorConstantPlan selectVectorConstantPlan(Method& method, InstructionWalker it, const DataType& type, std::vector<int64_t>& values, const std::vector<bool>& defined)
+{
+	VectorConstantPlan best;
+	auto consider = [&](VectorConstantPlan plan)
+	{
+		VectorConstantBuilder counter(method, it, type, false);
+		plan.numInstructions = (plan.build(counter, values), counter.numInstructions);
+		if(best.strategy == VectorConstantStrategy::NONE || plan.numInstructions < best.numInstructions)
+			best = std::move(plan);
+	};
+
+	//a) offset + element-number * factor
+	std::size_t first = values.size();
+	std::size_t second = values.size();
+	for(std::size_t i = 0; i < values.size(); ++i)
+	{
+		if(defined[i] && first == values.size())
+			first = i;
+		else if(defined[i] && second == values.size())
+			second = i;
+	}
+	if(second < values.size() && (values[second] - values[first]) % static_cast<int64_t>(second - first) == 0)
+	{
+		VectorConstantPlan plan;
+		plan.strategy = VectorConstantStrategy::AFFINE;
+		plan.factor = (values[second] - values[first]) / static_cast<int64_t>(second - first);
+		plan.offset = values[first] - plan.factor * static_cast<int64_t>(first);
+		bool matches = plan.factor != 0 && (plan.factor < 0 ? -plan.factor : plan.factor) < (1 << 24) && plan.offset >= INT32_MIN && plan.offset <= INT32_MAX;
+		for(std::size_t i = 0; i < values.size() && matches; ++i)
+			matches = !defined[i] || values[i] == plan.offset + plan.factor * static_cast<int64_t>(i);
+		if(matches)
+			consider(std::move(plan));
+	}
+
+	//the remaining strategies require a value for all elements, the undefined ones are set to the minimum
+	int64_t minValue = INT32_MAX;
+	for(std::size_t i = 0; i < values.size(); ++i)
+		if(defined[i])
+			minValue = std::min(minValue, values[i]);
+	for(std::size_t i = 0; i < values.size(); ++i)
+		if(!defined[i])
+			values[i] = minValue;
+
+	//b) a single load of the 2-bit signed values
+	if(std::all_of(values.begin(), values.end(), [](int64_t v) -> bool { return v >= -2 && v <= 1; }))
+	{
+		VectorConstantPlan plan;
+		plan.strategy = VectorConstantStrategy::PER_ELEMENT_SIGNED;
+		consider(std::move(plan));
+	}
+
+	//c) offset + scale * (base-4 digits), both with the minimum as offset and without any offset
+	for(const int64_t offset : {minValue, int64_t{0}})
+	{
+		int64_t scale = 0;
+		std::vector<uint64_t> differences;
+		differences.reserve(values.size());
+		for(const int64_t value : values)
+		{
+			differences.push_back(static_cast<uint32_t>(value - offset));
+			scale = gcd(static_cast<int64_t>(differences.back()), scale);
+		}
+		if(scale == 0)
+			continue;
+		//mul24 only uses the lower 24 bits of its operands
+		if(!isPowerOfTwo(scale) && (scale >= (1 << 24) || *std::max_element(differences.begin(), differences.end()) / static_cast<uint64_t>(scale) >= (1 << 24)))
+			scale = 1;
+		VectorConstantPlan plan;
+		plan.strategy = VectorConstantStrategy::DIGITS;
+		plan.offset = offset;
+		plan.factor = scale;
+		for(const uint64_t difference : differences)
+			plan.scaledValues.push_back(difference / static_cast<uint64_t>(scale));
+		consider(std::move(plan));
+	}
+	return best;
+}
+
 static InstructionWalker copyVector(Method& method, InstructionWalker it, const Value& out, const Value& in)
 {
 	if(in.container.isAllSame())
@@ -38,6 +293,44 @@ static InstructionWalker copyVector(Method& method, InstructionWalker it, const
     {
         throw CompilationError(CompilationStep::OPTIMIZER, "Input vector has invalid type", in.type.to_string());
     }
+
+    /*
+     * Inserting the elements one by one takes 2 instructions per element (setting the flags for and conditionally writing element i).
+     * Integer constants can mostly be built from the element-number or from their 2-bit digits (each loaded for all elements at once) in fewer instructions
+     */
+    const std::size_t numElements = in.type.getVectorWidth();
+    std::vector<int64_t> values;
+    std::vector<bool> defined;
+    values.reserve(numElements);
+    defined.reserve(numElements);
+    for(std::size_t i = 0; i < numElements && !in.type.isFloatingType(); ++i)
+    {
+    	const Value element = in.getCompoundPart(static_cast<int>(i));
+    	if(!element.isUndefined() && !(element.hasType(ValueType::LITERAL) && element.literal.type == LiteralType::INTEGER))
+    		break;
+    	defined.push_back(!element.isUndefined());
+    	//the elements are calculated with 32-bit arithmetic
+    	values.push_back(element.isUndefined() ? 0 : static_cast<int32_t>(element.literal.integer));
+    }
+    if(values.size() == numElements && numElements <= NATIVE_VECTOR_SIZE && std::find(defined.begin(), defined.end(), true) != defined.end())
+    {
+    	const VectorConstantPlan plan = selectVectorConstantPlan(method, it, in.type, values, defined);
+    	if(plan.strategy != VectorConstantStrategy::NONE && plan.numInstructions < 2 * numElements - 1)
+    	{
+    		DEBUG_LOG("Building vector constant " << in.to_string() << " with " << plan.numInstructions << " instructions" << logging::endl);
+    		VectorConstantBuilder builder(method, it, in.type, true);
+    		plan.build(builder, values);
+    		it = builder.it;
+    		//the last instruction writes the result directly
+    		it.copy().previousInBlock()->setOutput(realOut);
+    		if(realOut != out)
+    		{
+    			it.emplace((new intermediate::MoveOperation(out, realOut))->copyExtrasFrom(it.get()));
+    			it.nextInBlock();
+    		}
+    		return it;
+    	}
+    }
     
     for(std::size_t i = 0; i < in.type.getVectorWidth(); ++i)
     {
@@ -78,7 +371,7 @@ InstructionWalker optimizations::handleContainer(const Module& module, Method& m
 	{
 		if(!move->getSource().type.isPointerType())
 		{
-			logging::debug() << "Rewriting move from container " << move->to_string() << logging::endl;
+			DEBUG_LOG("Rewriting move from container " << move->to_string() << logging::endl);
 			it = copyVector(method, it, move->getOutput(), move->getSource());
 			it.erase();
 			//don't skip next instruction
@@ -89,7 +382,7 @@ InstructionWalker optimizations::handleContainer(const Module& module, Method& m
 	{
 		if(op->getFirstArg().hasType(ValueType::CONTAINER) && !op->getFirstArg().type.isPointerType())
 		{
-			logging::debug() << "Rewriting operation with container-input " << op->to_string() << logging::endl;
+			DEBUG_LOG("Rewriting operation with container-input " << op->to_string() << logging::endl);
 			const Value tmpVal = method.addNewLocal(op->getOutput().get().type, "%container");
 			it = copyVector(method, it, tmpVal, op->getFirstArg());
 			op->setArgument(0, tmpVal);
@@ -98,7 +391,7 @@ InstructionWalker optimizations::handleContainer(const Module& module, Method& m
 		}
 		if(op->getSecondArg() && op->getSecondArg().get().hasType(ValueType::CONTAINER) && !op->getSecondArg().get().type.isPointerType())
 		{
-			logging::debug() << "Rewriting operation with container-input " << op->to_string() << logging::endl;
+			DEBUG_LOG("Rewriting operation with container-input " << op->to_string() << logging::endl);
 			const Value tmpVal = method.addNewLocal(op->getOutput().get().type, "%container");
 			it = copyVector(method, it, tmpVal, op->getSecondArg());
 			op->setArgument(1, tmpVal);
@@ -116,166 +409,141 @@ struct ImmediateHandler
     bool changeValue = false;
     //if set to true, value must be loaded via a load-immediate instruction
     bool loadImmediate = false;
-    //if set to SHL, the value is the immediate left-shifted by itself (y << y)
-    //if set to ADD/FADD, the value is the immediate added with itself (y + y)
+    //if set, the value is the result of the operation applied to the immediate (as both operands for binary operations), e.g. y + y or y << y
     const OpAdd* opAdd = &OPADD_NOP;
-    //if set to MUL24/FMUL, value is the square (y * y) of the given immediate
+    //if set, the value is the result of the operation applied to the immediate as both operands, e.g. the square y * y
     const OpMul* opMul = &OPMUL_NOP;
     //the immediate to load/use
     SmallImmediate immediate = SmallImmediate(0);
 };
 
-static bool contains(const std::vector<float>& container, const float val)
+/*
+ * A 32-bit value, which can be created from a small immediate with at most one ALU operation
+ */
+struct ImmediateEntry
 {
-	for(const float v : container)
+	uint32_t value;
+	unsigned char immediate;
+	const OpAdd* opAdd;
+	const OpMul* opMul;
+
+	bool operator<(const ImmediateEntry& other) const
 	{
-		if(val == v)
-			return true;
+		return value < other.value;
 	}
-	return false;
+};
+
+//the bits of the value represented by the small immediate, 0 - 15 and -16 to -1 for 0 - 31 and the float values for 32 - 47
+static uint32_t getImmediateBits(const unsigned char immediate)
+{
+	if(immediate < 16)
+		return immediate;
+	if(immediate < 32)
+		return static_cast<uint32_t>(static_cast<int32_t>(immediate) - 32);
+	return bit_cast<float, uint32_t>(std::ldexp(1.0f, immediate < 40 ? immediate - 32 : immediate - 48));
 }
 
-static int index(const std::vector<float>& container, const float val)
+/*
+ * Creates the table of all values, which can be created from a single small immediate, sorted by value.
+ *
+ * Only the operations which are calculated the same way by Operation#precalculate (or not pre-calculated at all) are used,
+ * and the integer (floating-point) operations only for integer (floating-point) immediates, since the type of the immediate is taken from its encoding.
+ * If a value can be created in several ways, the first way listed here (e.g. without any operation) is used.
+ */
+static std::vector<ImmediateEntry> createImmediateTable(const bool floatingPoint)
 {
-	for(std::size_t i = 0; i < container.size(); ++i)
+	std::vector<ImmediateEntry> entries;
+	auto addEntry = [&entries](uint32_t value, unsigned char immediate, const OpAdd* opAdd, const OpMul* opMul)
 	{
-		if(val == container[i])
-			return i;
+		entries.push_back(ImmediateEntry{value, immediate, opAdd, opMul});
+	};
+	for(unsigned char i = 0; i < 48; ++i)
+	{
+		const uint32_t bits = getImmediateBits(i);
+		const bool isFloat = i >= 32;
+		if(isFloat == floatingPoint || (floatingPoint && i < 16))
+			//the bits of the floating-point values 0 - 15 are the denormals, which are loaded as integer immediates
+			addEntry(bits, i, &OPADD_NOP, &OPMUL_NOP);
+	}
+	for(unsigned char i = 0; i < 48; ++i)
+	{
+		const uint32_t bits = getImmediateBits(i);
+		const int32_t integer = static_cast<int32_t>(bits);
+		const float real = bit_cast<uint32_t, float>(bits);
+		if(!floatingPoint && i < 32)
+		{
+			addEntry(bits + bits, i, &OPADD_ADD, &OPMUL_NOP);
+			if(i < 16)
+			{
+				addEntry(bits << bits, i, &OPADD_SHL, &OPMUL_NOP);
+				addEntry(bits * bits, i, &OPADD_NOP, &OPMUL_MUL24);
+			}
+			//e.g. 1 ror 1 is the sign-bit
+			const uint32_t offset = bits & 31;
+			addEntry(offset == 0 ? bits : (bits >> offset) | (bits << (32 - offset)), i, &OPADD_ROR, &OPMUL_NOP);
+			uint32_t leadingZeros = 0;
+			while(leadingZeros < 32 && (bits & (0x80000000u >> leadingZeros)) == 0)
+				++leadingZeros;
+			addEntry(leadingZeros, i, &OPADD_CLZ, &OPMUL_NOP);
+		}
+		else if(!floatingPoint)
+			addEntry(static_cast<uint32_t>(static_cast<int32_t>(real)), i, &OPADD_FTOI, &OPMUL_NOP);
+		else if(i >= 32)
+		{
+			addEntry(bit_cast<float, uint32_t>(real * real), i, &OPADD_NOP, &OPMUL_FMUL);
+			addEntry(bit_cast<float, uint32_t>(real + real), i, &OPADD_FADD, &OPMUL_NOP);
+		}
+		else
+			addEntry(bit_cast<float, uint32_t>(static_cast<float>(integer)), i, &OPADD_ITOF, &OPMUL_NOP);
 	}
-	return -1;
+	//keeps the first way listed for every value
+	std::stable_sort(entries.begin(), entries.end());
+	entries.erase(std::unique(entries.begin(), entries.end(), [](const ImmediateEntry& one, const ImmediateEntry& other) -> bool { return one.value == other.value; }), entries.end());
+	return entries;
 }
 
 static ImmediateHandler mapImmediateValue(const Literal& source)
 {
-    static const std::vector<int> intAdds = {0 +0, 1+1, 2+2, 3+3, 4+4, 5+5, 6+6, 7+7, 8+8, 9+9, 10+10, 11+11, 12+12, 13+13, 14+14, 15+15, -16-16, -15-15, -14-14, -13-13, -12-12, -11-11, -10-10, -9-9, -8-8, -7-7, -6-6, -5-5, -4-4, -3-3, -2-2, -1-1};
-    static const std::vector<int> shifts = {0 << 0, 1 << 1, 2 << 2, 3 << 3, 4 << 4, 5 << 5, 6 << 6, 7 << 7, 8 << 8, 9 << 9, 10 << 10, 11 << 11, 12 << 12, 13 << 13, 14 << 14, 15 << 15};
-    static const std::vector<float> powersOf2 = {1.0, 2.0, 4.0, 8.0, 16.0, 32.0, 64.0, 128.0};
-    static const std::vector<float> partsOf2 = {1.0/256.0, 1.0/128.0, 1.0/64.0, 1.0/32.0, 1.0/16.0, 1.0/8.0, 1.0/4.0, 1.0/2.0};
+	//the tables are created once on first use, the look-up is a binary search
+	static const std::vector<ImmediateEntry> integerTable = createImmediateTable(false);
+	static const std::vector<ImmediateEntry> floatTable = createImmediateTable(true);
     ImmediateHandler handler;
-    switch(source.type)
+    handler.changeValue = true;
+    if(source.type == LiteralType::BOOL)
     {
-    case LiteralType::BOOL:
         //no need to create a load-instruction
-    	handler.changeValue = true;
     	handler.immediate.value = source.flag;
         return handler;
-    case LiteralType::INTEGER:
-    {
-    	//to convert to real negative values
-    	const int32_t integer = static_cast<int32_t>(source.integer);
-        //ALU with immediate supports -16 <= x <= 15
-        if(integer >= -16 && integer <= 15)
-        {
-            if(integer < 0)
-                //-16 <= x < 0
-                //need to move values, because bit-value 16 means -16, 17 -> -15, ..., 31 -> -1
-                handler.immediate.value = 32 + integer /* + since integer is negative */;
-            else    //0 <= x <= 15 -> keep as is
-            	handler.immediate.value = integer;
-            handler.changeValue = true;
-            return handler;
-        }
-        // integer value x < -16 || x > 15
-        else
-        {
-        	//FIXME sanitizer fails for -1 * -1 (aka. -9223372036854775808 * -9223372036854775808) not fitting into long (./example/SHA-256.cl)
-            long root = static_cast<long>(sqrt(integer));
-            if(root * root == integer && root >= 0 && root <= 15 )
-            {
-                handler.changeValue = true;
-                handler.immediate.value = root;
-                handler.opMul = &OPMUL_MUL24;
-                return handler;
-            }
-        }
-        for(std::size_t i = 0; i < intAdds.size(); ++i)
-        {
-            if(intAdds[i] == integer)
-            {
-                handler.changeValue = true;
-                handler.immediate.value = i;
-                handler.opAdd = &OPADD_ADD;
-                return handler;
-            }
-        }
-        for(std::size_t i = 0; i < shifts.size(); ++i)
-        {
-            if(shifts[i] == integer)
-            {
-                handler.changeValue = true;
-                handler.immediate.value = i;
-                handler.opAdd = &OPADD_SHL;
-                return handler;
-            }
-        }
-        //need load immediate instruction
-        handler.changeValue = true;
-        handler.loadImmediate = true;
-        return handler;
     }
-    case LiteralType::REAL:
-        //handle values representable with integer small immediates
-        const int integer = bit_cast<float, int>(static_cast<float>(source.real));
-        if(integer >= 0 && integer <= 15)
-        {
-            //0 <= x <= 15 -> keep as is
-        	handler.changeValue = true;
-        	handler.immediate.value = integer;
-            return handler;
-        }
-        //ALU with immediate supports
-        //1.0, 2.0, 4.0, ..., 128.0
-        //1/256, 1/128, ..., 1/2
-        int powerOfTwo = -1;
-        int partOfTwo = -1;
-        for(std::size_t i = 0; i < powersOf2.size(); ++i)
-        {
-            if(static_cast<float>(source.real) == powersOf2[i])
-            {
-                powerOfTwo = i;
-                break;
-            }
-        }
-        for(std::size_t i = 0; i < partsOf2.size(); ++i)
-        {
-            if(static_cast<float>(source.real) == partsOf2[i])
-            {
-                partOfTwo = i;
-                break;
-            }
-        }
-        if(powerOfTwo != -1)
-        {
-            handler.changeValue = true;
-            handler.immediate.value = 32 + powerOfTwo;
-            return handler;
-        }
-        if(partOfTwo != -1)
-        {
-            handler.changeValue = true;
-            handler.immediate.value = 40 + partOfTwo;
-            return handler;
-        }
-		float root = static_cast<float>(sqrt(source.real));
-		if(static_cast<float>(root * root) == source.real && (contains(powersOf2, root) || contains(partsOf2, root)))
-		{
-			//need to map to the constant representing the power/part of two, not the value itself
-			int i = index(powersOf2, root);
-			if(i >= 0)
-				i += 32;
-			if(i < 0)
-				i = 40 + index(partsOf2, root);
-			handler.changeValue = true;
-			handler.immediate.value = i;
-			handler.opMul = &OPMUL_FMUL;
-			return handler;
-		}
-        //any other float, load-immediate bit-casted integer
-        handler.changeValue = true;
-        handler.loadImmediate = true;
-        return handler;
+    if(source.type != LiteralType::INTEGER && source.type != LiteralType::REAL)
+    	throw CompilationError(CompilationStep::OPTIMIZER, "Unknown literal-type", source.to_string());
+    const bool isFloat = source.type == LiteralType::REAL;
+    const std::vector<ImmediateEntry>& table = isFloat ? floatTable : integerTable;
+    //for integers, the lower 32 bits are used (e.g. to convert to real negative values)
+    const ImmediateEntry key{isFloat ? bit_cast<float, uint32_t>(static_cast<float>(source.real)) : static_cast<uint32_t>(source.integer), 0, nullptr, nullptr};
+    const auto entry = std::lower_bound(table.begin(), table.end(), key);
+    if(entry == table.end() || entry->value != key.value)
+    {
+    	//need load immediate instruction
+    	handler.loadImmediate = true;
+    	return handler;
     }
-    throw CompilationError(CompilationStep::OPTIMIZER, "Unknown literal-type", source.to_string());
+    handler.immediate.value = entry->immediate;
+    handler.opAdd = entry->opAdd;
+    handler.opMul = entry->opMul;
+    return handler;
+}
+
+/*
+ * Creates the operation calculating the value from the immediate, as mapped by #mapImmediateValue
+ */
+static intermediate::Operation* createImmediateOperation(const ImmediateHandler& mapped, const Value& dest, const ConditionCode cond)
+{
+	const DataType type = mapped.immediate.getFloatingValue().hasValue ? TYPE_FLOAT : TYPE_INT32;
+	const Value immediate(mapped.immediate, type);
+	if(*mapped.opAdd != OPADD_NOP && mapped.opAdd->numOperands == 1)
+		return new intermediate::Operation(mapped.opAdd->name, dest, immediate, cond);
+	return new intermediate::Operation(*mapped.opAdd != OPADD_NOP ? mapped.opAdd->name : mapped.opMul->name, dest, immediate, immediate, cond);
 }
 
 InstructionWalker optimizations::handleImmediate(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
@@ -297,20 +565,16 @@ InstructionWalker optimizations::handleImmediate(const Module& module, Method& m
 				if(mapped.loadImmediate)
 				{
 					//requires load immediate
-					logging::debug() << "Loading immediate value: " << source.literal.to_string() << logging::endl;
+					DEBUG_LOG("Loading immediate value: " << source.literal.to_string() << logging::endl);
 					it.reset((new intermediate::LoadImmediate(move->getOutput(), source.literal))->copyExtrasFrom(move));
 				}
-				else if(*mapped.opAdd != OPADD_NOP)
-				{
-					it.reset((new intermediate::Operation(mapped.opAdd->name, move->getOutput(), Value(mapped.immediate, move->getSource().type), Value(mapped.immediate, move->getSource().type)))->copyExtrasFrom(move));
-				}
-				else if(*mapped.opMul != OPMUL_NOP)
+				else if(*mapped.opAdd != OPADD_NOP || *mapped.opMul != OPMUL_NOP)
 				{
-					it.reset((new intermediate::Operation(mapped.opMul->name, move->getOutput(), Value(mapped.immediate, move->getSource().type), Value(mapped.immediate, move->getSource().type)))->copyExtrasFrom(move));
+					it.reset(createImmediateOperation(mapped, move->getOutput(), COND_ALWAYS)->copyExtrasFrom(move));
 				}
 				else
 				{
-					logging::debug() << "Mapping constant for immediate value " << source.literal.to_string() << " to: " << mapped.immediate.toString() << logging::endl;
+					DEBUG_LOG("Mapping constant for immediate value " << source.literal.to_string() << " to: " << mapped.immediate.toString() << logging::endl);
 					move->setSource(Value(mapped.immediate, source.type));
 				}
 			}
@@ -334,28 +598,20 @@ InstructionWalker optimizations::handleImmediate(const Module& module, Method& m
 				if(mapped.loadImmediate)
 				{
 					//requires load immediate
-					logging::debug() << "Loading immediate value: " << source.literal.to_string() << logging::endl;
+					DEBUG_LOG("Loading immediate value: " << source.literal.to_string() << logging::endl);
 					it.emplace(new intermediate::LoadImmediate(tmp, source.literal, op->conditional));
 					it.nextInBlock();
 					op->setArgument(0, tmp);
 				}
-				else if(*mapped.opAdd != OPADD_NOP)
+				else if(*mapped.opAdd != OPADD_NOP || *mapped.opMul != OPMUL_NOP)
 				{
-					DataType type = mapped.immediate.getFloatingValue().hasValue ? TYPE_FLOAT : TYPE_INT32;
-					it.emplace(new intermediate::Operation(mapped.opAdd->name, tmp, Value(mapped.immediate, type), Value(mapped.immediate, type), op->conditional));
-					it.nextInBlock();
-					op->setArgument(0, tmp);
-				}
-				else if(*mapped.opMul != OPMUL_NOP)
-				{
-					DataType type = mapped.immediate.getFloatingValue().hasValue ? TYPE_FLOAT : TYPE_INT32;
-					it.emplace(new intermediate::Operation(mapped.opMul->name, tmp, Value(mapped.immediate, type), Value(mapped.immediate, type), op->conditional));
+					it.emplace(createImmediateOperation(mapped, tmp, op->conditional));
 					it.nextInBlock();
 					op->setArgument(0, tmp);
 				}
 				else
 				{
-					logging::debug() << "Mapping constant for immediate value " << source.literal.to_string() << " to: " << mapped.immediate.toString() << logging::endl;
+					DEBUG_LOG("Mapping constant for immediate value " << source.literal.to_string() << " to: " << mapped.immediate.toString() << logging::endl);
 					op->setArgument(0, Value(mapped.immediate, source.type));
 				}
 			}
@@ -375,28 +631,20 @@ InstructionWalker optimizations::handleImmediate(const Module& module, Method& m
 					if(mapped.loadImmediate)
 					{
 						//requires load immediate
-						logging::debug() << "Loading immediate value: " << source.literal.to_string() << logging::endl;
+						DEBUG_LOG("Loading immediate value: " << source.literal.to_string() << logging::endl);
 						it.emplace(new intermediate::LoadImmediate(tmp, source.literal, op->conditional));
 						it.nextInBlock();
 						op->setArgument(1, tmp);
 					}
-					else if(*mapped.opAdd != OPADD_NOP)
+					else if(*mapped.opAdd != OPADD_NOP || *mapped.opMul != OPMUL_NOP)
 					{
-						DataType type = mapped.immediate.getFloatingValue().hasValue ? TYPE_FLOAT : TYPE_INT32;
-						it.emplace(new intermediate::Operation(mapped.opAdd->name, tmp, Value(mapped.immediate, type), Value(mapped.immediate, type), op->conditional));
-						it.nextInBlock();
-						op->setArgument(1, tmp);
-					}
-					else if(*mapped.opMul != OPMUL_NOP)
-					{
-						DataType type = mapped.immediate.getFloatingValue().hasValue ? TYPE_FLOAT : TYPE_INT32;
-						it.emplace(new intermediate::Operation(mapped.opMul->name, tmp, Value(mapped.immediate, type), Value(mapped.immediate, type), op->conditional));
+						it.emplace(createImmediateOperation(mapped, tmp, op->conditional));
 						it.nextInBlock();
 						op->setArgument(1, tmp);
 					}
 					else
 					{
-						logging::debug() << "Mapping constant for immediate value " << source.literal.to_string() << " to: " << mapped.immediate.toString() << logging::endl;
+						DEBUG_LOG("Mapping constant for immediate value " << source.literal.to_string() << " to: " << mapped.immediate.toString() << logging::endl);
 						op->setArgument(1, Value(mapped.immediate, source.type));
 					}
 				}
@@ -433,7 +681,7 @@ InstructionWalker optimizations::handleUseWithImmediate(const Module& module, Me
 			if(localIt != args.end() && !it.getBasicBlock()->isLocallyLimited(findWriteOfLocal(it, localIt->local), localIt->local))
 			{
 				//one other local is used and its range is greater than the accumulator threshold
-				logging::debug() << "Inserting temporary to split up use of long-living local with immediate value: " << op->to_string() << logging::endl;
+				DEBUG_LOG("Inserting temporary to split up use of long-living local with immediate value: " << op->to_string() << logging::endl);
 				const Value tmp = method.addNewLocal(localIt->type, "%use_with_literal");
 				it.emplace(new intermediate::MoveOperation(tmp, *localIt));
 				it.nextInBlock();
@@ -445,3 +693,69 @@ InstructionWalker optimizations::handleUseWithImmediate(const Module& module, Me
 
 	return it;
 }
+
+//the loads of a constant need to be executed at least as often as a block within a loop (see the estimated block weights),
+//to outweigh reading the UNIFORM and the register occupied for the whole kernel
+static constexpr double MIN_UNIFORM_CONSTANT_WEIGHT = 10.0;
+
+struct ConstantLoads
+{
+	uint32_t value;
+	//the sum of the executions of all loads per kernel execution
+	double weight;
+	std::vector<InstructionWalker> loads;
+};
+
+void optimizations::passConstantsAsUniforms(const Module& module, Method& method, const Configuration& config)
+{
+	if(config.maxUniformConstants == 0)
+		return;
+	FastMap<const BasicBlock*, unsigned> loopDepths;
+	for(const analysis::Loop& loop : method.getAnalyses().getLoops().getLoops())
+	{
+		for(const BasicBlock* block : loop.blocks)
+			++loopDepths[block];
+	}
+
+	//the loads are weighted by the executions of their blocks, as measured by the block-profile (see Configuration#blockProfile) or estimated from the loop depth
+	FastMap<uint32_t, std::size_t> constantIndices;
+	std::vector<ConstantLoads> constants;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		const Optional<double> frequency = getRelativeFrequency(method, block, config);
+		const auto depth = loopDepths.find(&block);
+		const double weight = frequency ? frequency.get() : std::pow(10.0, depth == loopDepths.end() ? 0 : depth->second);
+		for(InstructionWalker it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			const intermediate::LoadImmediate* load = it.get<const intermediate::LoadImmediate>();
+			//a UNIFORM has the same value in all SIMD elements
+			if(load == nullptr || load->type != intermediate::LoadType::REPLICATE_INT32 || load->hasConditionalExecution() || load->hasSideEffects() ||
+					load->hasPackMode() || !load->hasValueType(ValueType::LOCAL) || load->getOutput().get().local->getUsers().getNumWriters() != 1)
+				continue;
+			const uint32_t value = load->getImmediate().toImmediate();
+			auto index = constantIndices.emplace(value, constants.size());
+			if(index.second)
+				constants.push_back(ConstantLoads{value, 0.0, {}});
+			constants[index.first->second].weight += weight;
+			constants[index.first->second].loads.push_back(it);
+		}
+	}
+
+	//the constants loaded most often are passed as UNIFORMs
+	std::stable_sort(constants.begin(), constants.end(), [](const ConstantLoads& one, const ConstantLoads& other) -> bool { return one.weight > other.weight; });
+	for(std::size_t i = 0; i < constants.size() && i < config.maxUniformConstants && constants[i].weight >= MIN_UNIFORM_CONSTANT_WEIGHT; ++i)
+	{
+		const Value constant = method.addNewLocal(TYPE_INT32, "%uniform_constant");
+		method.uniformConstants.emplace_back(constant.local, constants[i].value);
+		DEBUG_LOG("Passing constant " << constants[i].value << " loaded " << constants[i].loads.size() << " times as UNIFORM" << logging::endl);
+		for(InstructionWalker& load : constants[i].loads)
+		{
+			const Local* oldLocal = load->getOutput().get().local;
+			//Local#forUsers can't be used here, since we modify the list of users via LocalUser#replaceLocal
+			FastSet<const LocalUser*> readers = oldLocal->getUsers(LocalUser::Type::READER);
+			for(const LocalUser* reader : readers)
+				const_cast<LocalUser*>(reader)->replaceLocal(oldLocal, constant.local, LocalUser::Type::READER);
+			load.erase();
+		}
+	}
+}
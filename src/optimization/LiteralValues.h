@@ -18,6 +18,13 @@ namespace vc4c
 		InstructionWalker handleContainer(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
 		InstructionWalker handleImmediate(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
 		InstructionWalker handleUseWithImmediate(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
+
+		/*
+		 * Replaces the loads of the constants executed most often (e.g. within loops) with UNIFORMs passed by the run-time and read once at the start of the kernel.
+		 *
+		 * The values are listed in the kernel-info, see Method#uniformConstants
+		 */
+		void passConstantsAsUniforms(const Module& module, Method& method, const Configuration& config);
 	}
 }
 
@@ -0,0 +1,450 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Loops.h"
+#include "Instrumentation.h"
+#include "../InstructionWalker.h"
+#include "../intermediate/IntermediateInstruction.h"
+#include "../analysis/AnalysisManager.h"
+#include "../periphery/VPM.h"
+#include "../Logging.h"
+
+#include <set>
+
+using namespace vc4c;
+using namespace vc4c::optimizations;
+using namespace vc4c::intermediate;
+
+/*
+ * The maximum number of locals live at the start of a loop (including the hoisted values).
+ * Of the 64 physical registers (32 per register-file), some are kept free for the temporaries within the loop body.
+ */
+static constexpr std::size_t MAX_LIVE_LOCALS_IN_LOOP = 48;
+
+/*
+ * Whether the value is the same in all iterations of the loop
+ */
+static bool isInvariant(const Value& value, const analysis::Loop& loop, const FastMap<const LocalUser*, BasicBlock*>& blocks, const FastSet<const Local*>& hoistedLocals)
+{
+	if(value.hasType(ValueType::LITERAL) || value.hasType(ValueType::SMALL_IMMEDIATE))
+		return true;
+	//registers can change their values (or have side-effects on reading)
+	if(!value.hasType(ValueType::LOCAL))
+		return false;
+	if(hoistedLocals.find(value.local) != hoistedLocals.end())
+		return true;
+	for(const LocalUser* writer : value.local->getUsers(LocalUser::Type::WRITER))
+	{
+		auto it = blocks.find(writer);
+		//e.g. the single operations of combined instructions
+		if(it == blocks.end() || loop.contains(*it->second))
+			return false;
+	}
+	return true;
+}
+
+static bool canBeHoisted(const IntermediateInstruction* instr, const analysis::Loop& loop, const FastMap<const LocalUser*, BasicBlock*>& blocks, const FastSet<const Local*>& hoistedLocals)
+{
+	if(instr->kind != InstructionKind::OPERATION && instr->kind != InstructionKind::MOVE && instr->kind != InstructionKind::LOAD_IMMEDIATE)
+		return false;
+	//the instruction is executed before the loop (even if it would not be executed in the loop at all), which is only valid for unconditional pure calculations
+	if(instr->conditional != COND_ALWAYS || instr->hasSideEffects())
+		return false;
+	//the output needs to be written only by this instruction, so it contains the same value throughout the loop
+	if(!instr->hasValueType(ValueType::LOCAL) || instr->getOutput().get().local->getUsers().getNumWriters() != 1)
+		return false;
+	for(const Value& arg : instr->getArguments())
+	{
+		if(!isInvariant(arg, loop, blocks, hoistedLocals))
+			return false;
+	}
+	return true;
+}
+
+void optimizations::moveLoopInvariantCode(const Module& module, Method& method, const Configuration& config)
+{
+	const analysis::LoopAnalysis& loops = method.getAnalyses().getLoops();
+	if(loops.getLoops().empty())
+		return;
+	//moving instructions between blocks does not change the live locals at the loop headers (except for the hoisted locals, which are tracked separately)
+	const analysis::LivenessAnalysis& liveness = method.getAnalyses().getLiveness();
+
+	FastMap<const LocalUser*, BasicBlock*> blocks;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() != nullptr)
+				blocks.emplace(it.get(), &block);
+		}
+	}
+
+	std::size_t numHoisted = 0;
+	//inner loops are handled first, so their invariants can be hoisted further out of the outer loops
+	for(const analysis::Loop& loop : loops.getLoops())
+	{
+		if(loop.preheader == nullptr)
+		{
+			DEBUG_LOG("Skipping loop without pre-header: " << loop.header->getLabel()->to_string() << logging::endl);
+			continue;
+		}
+		std::size_t numLiveLocals = liveness.getLiveIns(*loop.header).size();
+		//insert the instructions before the branch to the loop (if any)
+		InstructionWalker insertIt = loop.preheader->end();
+		while(insertIt.copy().previousInBlock().has<Branch>())
+			insertIt.previousInBlock();
+
+		FastSet<const Local*> hoistedLocals;
+		bool changed = true;
+		while(changed && numLiveLocals < MAX_LIVE_LOCALS_IN_LOOP)
+		{
+			changed = false;
+			//the blocks are ordered, so most invariants are found before their users
+			for(BasicBlock* block : loop.blocks)
+			{
+				auto it = block->begin();
+				while(!it.isEndOfBlock() && numLiveLocals < MAX_LIVE_LOCALS_IN_LOOP)
+				{
+					if(it.get() == nullptr || !canBeHoisted(it.get(), loop, blocks, hoistedLocals))
+					{
+						it.nextInBlock();
+						continue;
+					}
+					DEBUG_LOG("Moving loop invariant instruction out of loop " << loop.header->getLabel()->to_string() << ": " << it->to_string() << logging::endl);
+					const Local* output = it->getOutput().get().local;
+					hoistedLocals.emplace(output);
+					if(!liveness.isLiveIn(*loop.header, output))
+						++numLiveLocals;
+					blocks[it.get()] = loop.preheader;
+					insertIt.emplace(it.release()).nextInBlock();
+					it.erase();
+					++numHoisted;
+					changed = true;
+				}
+			}
+		}
+		if(numLiveLocals >= MAX_LIVE_LOCALS_IN_LOOP)
+			DEBUG_LOG("Stopped hoisting invariants out of loop " << loop.header->getLabel()->to_string() << " to not increase the register pressure any further" << logging::endl);
+	}
+	DEBUG_LOG("Moved " << numHoisted << " loop invariant instructions" << logging::endl);
+}
+
+//the maximum number of instructions of an unrolled loop, so the loop body still fits well into the instruction cache (4 KB, 512 instructions)
+static constexpr std::size_t MAX_UNROLLED_LOOP_SIZE = 256;
+//the maximum number of instructions of an unrolled loop measured to be hot (see Configuration#blockProfile), which may fill the whole instruction cache
+static constexpr std::size_t MAX_UNROLLED_HOT_LOOP_SIZE = 512;
+//the maximum number of iterations simulated to determine the trip-count of a loop
+static constexpr std::size_t MAX_TRIP_COUNT = 1024;
+//the estimated number of instructions for operations and calls which are expanded into instruction sequences afterwards
+static constexpr std::size_t EXPANDED_INSTRUCTION_COST = 8;
+
+/*
+ * The estimated number of instructions this instruction is mapped to
+ */
+static std::size_t estimateCost(const IntermediateInstruction* instr)
+{
+	if(instr->is<MethodCall>() || instr->is<Comparison>())
+		return EXPANDED_INSTRUCTION_COST;
+	const Operation* op = instr->as<const Operation>();
+	if(op != nullptr && op->opCode != "nop")
+	{
+		//operations not supported by the ALUs are intrinsified into instruction sequences
+		const auto opCodes = toOpCode(op->opCode);
+		if(opCodes.first == OPADD_NOP && opCodes.second == OPMUL_NOP)
+			return EXPANDED_INSTRUCTION_COST;
+	}
+	return 1;
+}
+
+static bool accessesVPM(const IntermediateInstruction* instr)
+{
+	if(instr->hasValueType(ValueType::REGISTER) && instr->getOutput().get().reg == REG_VPM_IO)
+		return true;
+	return std::any_of(instr->getArguments().begin(), instr->getArguments().end(), [](const Value& arg) -> bool { return arg.hasType(ValueType::REGISTER) && arg.reg == REG_VPM_IO;});
+}
+
+static bool isSupportedComparison(const std::string& comparison)
+{
+	//only built on first use, so loading the library does not construct the set
+	static const std::set<std::string> comparisons = {
+			COMP_EQ, COMP_NEQ, COMP_SIGNED_LT, COMP_SIGNED_LE, COMP_SIGNED_GT, COMP_SIGNED_GE, COMP_UNSIGNED_LT, COMP_UNSIGNED_LE, COMP_UNSIGNED_GT, COMP_UNSIGNED_GE
+	};
+	return comparisons.find(comparison) != comparisons.end();
+}
+
+static bool evaluateComparison(const std::string& comparison, int32_t left, int32_t right)
+{
+	const uint32_t uLeft = static_cast<uint32_t>(left);
+	const uint32_t uRight = static_cast<uint32_t>(right);
+	if(comparison == COMP_EQ)
+		return left == right;
+	if(comparison == COMP_NEQ)
+		return left != right;
+	if(comparison == COMP_SIGNED_LT)
+		return left < right;
+	if(comparison == COMP_SIGNED_LE)
+		return left <= right;
+	if(comparison == COMP_SIGNED_GT)
+		return left > right;
+	if(comparison == COMP_SIGNED_GE)
+		return left >= right;
+	if(comparison == COMP_UNSIGNED_LT)
+		return uLeft < uRight;
+	if(comparison == COMP_UNSIGNED_LE)
+		return uLeft <= uRight;
+	if(comparison == COMP_UNSIGNED_GT)
+		return uLeft > uRight;
+	if(comparison == COMP_UNSIGNED_GE)
+		return uLeft >= uRight;
+	throw CompilationError(CompilationStep::OPTIMIZER, "Unsupported comparison", comparison);
+}
+
+static const IntermediateInstruction* getSingleWriter(const Local* local)
+{
+	const auto writers = local->getUsers(LocalUser::Type::WRITER);
+	if(writers.size() != 1)
+		return nullptr;
+	return dynamic_cast<const IntermediateInstruction*>(*writers.begin());
+}
+
+/*
+ * Returns the step of the induction variable, if the instruction adds a literal to it
+ */
+static Optional<long> getInductionStep(const IntermediateInstruction* instr, const Local* inductionVariable)
+{
+	const Operation* op = instr == nullptr ? nullptr : instr->as<const Operation>();
+	if(op == nullptr || instr->kind != InstructionKind::OPERATION || op->conditional != COND_ALWAYS || !op->getSecondArg())
+		return Optional<long>(false, 0);
+	const Value arg0 = op->getFirstArg();
+	const Value arg1 = op->getSecondArg();
+	if(op->opCode == "add" && arg0.hasLocal(inductionVariable) && arg1.hasType(ValueType::LITERAL))
+		return arg1.literal.integer;
+	if(op->opCode == "add" && arg1.hasLocal(inductionVariable) && arg0.hasType(ValueType::LITERAL))
+		return arg0.literal.integer;
+	if(op->opCode == "sub" && arg0.hasLocal(inductionVariable) && arg1.hasType(ValueType::LITERAL))
+		return -arg1.literal.integer;
+	return Optional<long>(false, 0);
+}
+
+/*
+ * Determines the number of iterations of a loop consisting of the single given block, zero if the trip-count is not constant (or not known).
+ *
+ * Supported are loops of the form:
+ *   i = start (in the pre-header)
+ * loop:
+ *   [i.next = i + step]
+ *   cond = cmp i (or i.next), literal
+ *   i = i.next (or i = i + step, possibly conditional with flags set on cond)
+ *   br.cond loop (on cond)
+ */
+static std::size_t determineTripCount(BasicBlock& preheader, InstructionWalker backEdge, const FastMap<const IntermediateInstruction*, std::size_t>& positions)
+{
+	const Branch* branch = backEdge.get<const Branch>();
+	const Value condition = branch->getCondition();
+	if(branch->conditional == COND_ALWAYS || !condition.hasType(ValueType::LOCAL))
+		return 0;
+	const Comparison* comparison = dynamic_cast<const Comparison*>(getSingleWriter(condition.local));
+	if(comparison == nullptr || positions.find(comparison) == positions.end() || !isSupportedComparison(comparison->opCode) || !comparison->getSecondArg() || !comparison->getSecondArg().get().hasType(ValueType::LITERAL))
+		return 0;
+	const Value compared = comparison->getFirstArg();
+	if(!compared.hasType(ValueType::LOCAL) || compared.type.isFloatingType() || compared.type.getScalarBitCount() > 32)
+		return 0;
+	const int32_t limit = static_cast<int32_t>(comparison->getSecondArg().get().literal.integer);
+
+	//determine the induction variable, its update and the copy of the updated value (if any)
+	const Local* inductionVariable = compared.local;
+	const IntermediateInstruction* nextValue = nullptr;
+	if(compared.local->getUsers().getNumWriters() == 1)
+	{
+		//compares the updated value, which is then copied into the induction variable
+		nextValue = getSingleWriter(compared.local);
+		const Operation* op = nextValue == nullptr ? nullptr : nextValue->as<const Operation>();
+		if(op == nullptr || !op->getFirstArg().hasType(ValueType::LOCAL))
+			return 0;
+		inductionVariable = op->getFirstArg().local;
+		if(!getInductionStep(nextValue, inductionVariable).hasValue && op->getSecondArg() && op->getSecondArg().get().hasType(ValueType::LOCAL))
+			inductionVariable = op->getSecondArg().get().local;
+	}
+	const auto writers = inductionVariable->getUsers(LocalUser::Type::WRITER);
+	if(writers.size() != 2)
+		return 0;
+	const IntermediateInstruction* initialWrite = nullptr;
+	const IntermediateInstruction* update = nullptr;
+	for(const LocalUser* user : writers)
+	{
+		const IntermediateInstruction* writer = dynamic_cast<const IntermediateInstruction*>(user);
+		if(positions.find(writer) != positions.end())
+			update = writer;
+		else
+			initialWrite = writer;
+	}
+	if(initialWrite == nullptr || update == nullptr)
+		return 0;
+
+	//the initial value is set unconditionally in the pre-header, which is the only entry into the loop
+	Optional<long> startValue(false, 0);
+	if(initialWrite->conditional == COND_ALWAYS && !initialWrite->hasSideEffects() && !initialWrite->hasPackMode() && !initialWrite->hasUnpackMode())
+	{
+		if(initialWrite->is<LoadImmediate>() && initialWrite->as<const LoadImmediate>()->type == LoadType::REPLICATE_INT32)
+			startValue = initialWrite->as<const LoadImmediate>()->getImmediate().integer;
+		else if(initialWrite->kind == InstructionKind::MOVE && initialWrite->as<const MoveOperation>()->getSource().hasType(ValueType::LITERAL))
+			startValue = initialWrite->as<const MoveOperation>()->getSource().literal.integer;
+	}
+	bool initialWriteInPreheader = false;
+	for(auto it = preheader.begin(); !it.isEndOfBlock() && !initialWriteInPreheader; it.nextInBlock())
+		initialWriteInPreheader = it.get() == initialWrite;
+	if(!startValue.hasValue || !initialWriteInPreheader)
+		return 0;
+
+	//the update is either the addition itself or the copy of the added value
+	Optional<long> step = getInductionStep(update, inductionVariable);
+	if(!step.hasValue)
+	{
+		const MoveOperation* move = update->kind == InstructionKind::MOVE ? update->as<const MoveOperation>() : nullptr;
+		if(move == nullptr || !move->getSource().hasType(ValueType::LOCAL) || move->hasPackMode() || move->hasUnpackMode() || move->setFlags == SetFlag::SET_FLAGS)
+			return 0;
+		if(nextValue == nullptr)
+			nextValue = getSingleWriter(move->getSource().local);
+		if(nextValue == nullptr || nextValue->getOutput().get().local != move->getSource().local || positions.find(nextValue) == positions.end())
+			return 0;
+		step = getInductionStep(nextValue, inductionVariable);
+		//the induction variable is updated after the next value is calculated
+		if(!step.hasValue || positions.at(nextValue) > positions.at(update))
+			return 0;
+	}
+	else if(nextValue != nullptr)
+		//the updated value is calculated by another instruction
+		return 0;
+	if(update->conditional != COND_ALWAYS)
+	{
+		//copies of phi-nodes are only executed if the branch is taken, the flags are set just before
+		const MoveOperation* setFlags = nullptr;
+		for(auto it = backEdge.getBasicBlock()->begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == update)
+				break;
+			setFlags = it.has<MoveOperation>() ? it.get<const MoveOperation>() : nullptr;
+		}
+		if(update->conditional != branch->conditional || setFlags == nullptr || setFlags->setFlags != SetFlag::SET_FLAGS || setFlags->getSource() != condition)
+			return 0;
+	}
+	if(nextValue != nullptr && positions.at(nextValue) > positions.at(comparison))
+		return 0;
+
+	//the compared value is either the updated value or the induction variable before or after the update
+	const bool comparesUpdatedValue = nextValue != nullptr ? compared.local != inductionVariable || positions.at(update) < positions.at(comparison) :
+			positions.at(update) < positions.at(comparison);
+	int32_t value = static_cast<int32_t>(startValue.get());
+	for(std::size_t tripCount = 1; tripCount <= MAX_TRIP_COUNT; ++tripCount)
+	{
+		const int32_t nextInduction = static_cast<int32_t>(static_cast<uint32_t>(value) + static_cast<uint32_t>(step.get()));
+		const bool result = evaluateComparison(comparison->opCode, comparesUpdatedValue ? nextInduction : value, limit);
+		const bool isTaken = branch->conditional == COND_ZERO_CLEAR ? result : !result;
+		if(!isTaken)
+			return tripCount;
+		value = nextInduction;
+	}
+	return 0;
+}
+
+void optimizations::unrollLoops(const Module& module, Method& method, const Configuration& config)
+{
+	const analysis::LoopAnalysis& loopAnalysis = method.getAnalyses().getLoops();
+	//the loops are copied, since removing back-edges invalidates the loop analysis
+	std::vector<std::pair<BasicBlock*, BasicBlock*>> loops;
+	for(const analysis::Loop& loop : loopAnalysis.getLoops())
+	{
+		if(loop.blocks.size() == 1 && loop.preheader != nullptr)
+			loops.emplace_back(loop.header, loop.preheader);
+	}
+	const analysis::LivenessAnalysis& liveness = method.getAnalyses().getLiveness();
+
+	for(const auto& pair : loops)
+	{
+		BasicBlock& block = *pair.first;
+
+		//the body of the loop and the branches at its end, other branches are not supported
+		FastMap<const IntermediateInstruction*, std::size_t> positions;
+		std::vector<const IntermediateInstruction*> body;
+		Optional<InstructionWalker> backEdge;
+		bool hasBranchWithinBody = false;
+		bool isAfterBranch = false;
+		std::size_t bodyCost = 0;
+		std::size_t numVPMAccesses = 0;
+		FastSet<const Local*> writtenLocals;
+		for(auto it = block.begin().nextInBlock(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == nullptr)
+				continue;
+			positions.emplace(it.get(), positions.size());
+			if(it.has<Branch>())
+			{
+				if(it.get<Branch>()->getTarget() == block.getLabel()->getLabel())
+				{
+					hasBranchWithinBody = hasBranchWithinBody || backEdge;
+					backEdge = it;
+				}
+				isAfterBranch = true;
+				continue;
+			}
+			hasBranchWithinBody = hasBranchWithinBody || isAfterBranch;
+			body.push_back(it.get());
+			bodyCost += estimateCost(it.get());
+			numVPMAccesses += accessesVPM(it.get()) ? 1 : 0;
+			it->forUsedLocals([&writtenLocals](const Local* local, LocalUser::Type type) -> void
+			{
+				if(has_flag(type, LocalUser::Type::WRITER))
+					writtenLocals.emplace(local);
+			});
+		}
+		if(!backEdge || hasBranchWithinBody || body.empty())
+			continue;
+		const std::size_t tripCount = determineTripCount(*pair.second, backEdge.get(), positions);
+		if(tripCount == 0)
+		{
+			DEBUG_LOG("Skipping unrolling of loop with unknown trip-count: " << block.getLabel()->to_string() << logging::endl);
+			continue;
+		}
+
+		const Optional<uint64_t> executionCount = getExecutionCount(method, block, config);
+		if(executionCount && executionCount.get() == 0)
+		{
+			DEBUG_LOG("Skipping unrolling of loop never executed according to the block-profile: " << block.getLabel()->to_string() << logging::endl);
+			continue;
+		}
+
+		//the copies use the same locals, so the register pressure within the loop doesn't change, but the re-ordering afterwards can increase it
+		if(liveness.getLiveIns(block).size() + writtenLocals.size() >= MAX_LIVE_LOCALS_IN_LOOP)
+		{
+			DEBUG_LOG("Skipping unrolling of loop with too many live locals: " << block.getLabel()->to_string() << logging::endl);
+			continue;
+		}
+		//the VPM accesses of subsequent iterations are combined afterwards, which is limited by the number of vectors cached in the VPM
+		const std::size_t maxVPMFactor = numVPMAccesses == 0 ? tripCount : method.vpm->getMaxCacheVectors(TYPE_INT32.toVectorType(16), false) / numVPMAccesses;
+		const std::size_t maxUnrolledSize = isHotBlock(method, block, config) ? MAX_UNROLLED_HOT_LOOP_SIZE : MAX_UNROLLED_LOOP_SIZE;
+		std::size_t factor = std::min(tripCount, std::min(maxVPMFactor, maxUnrolledSize / bodyCost));
+		//partial unrolling only works for factors dividing the trip-count, since the loop condition is only checked once per unrolled iteration
+		while(factor > 1 && tripCount % factor != 0)
+			--factor;
+		if(factor < 2 && tripCount > 1)
+		{
+			DEBUG_LOG("Skipping unrolling of loop exceeding the cost limits: " << block.getLabel()->to_string() << logging::endl);
+			continue;
+		}
+
+		DEBUG_LOG("Unrolling loop " << block.getLabel()->to_string() << " with " << tripCount << " iterations by factor " << factor << logging::endl);
+		//the copies are inserted before the original body, only the last copy (the original body) checks for the loop condition
+		InstructionWalker insertIt = block.begin().nextInBlock();
+		for(std::size_t i = 1; i < factor; ++i)
+		{
+			for(const IntermediateInstruction* instr : body)
+				insertIt.emplace(instr->copyFor(method, "")).nextInBlock();
+		}
+		if(factor == tripCount)
+			//the loop is completely unrolled, the last iteration never jumps back
+			backEdge.get().erase();
+	}
+}
@@ -0,0 +1,31 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef OPTIMIZATION_LOOPS_H
+#define OPTIMIZATION_LOOPS_H
+
+#include <config.h>
+#include "../Module.h"
+
+namespace vc4c
+{
+	namespace optimizations
+	{
+		/*
+		 * Moves pure calculations (ALU operations, moves and immediate loads) which produce the same value in every iteration of a loop into the block preceding the loop.
+		 * Hoisting stops as soon as too many locals would be live across the loop.
+		 */
+		void moveLoopInvariantCode(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Unrolls loops consisting of a single block with a constant trip-count, either completely or by a factor dividing the trip-count.
+		 * The unroll factor is limited by the size of the unrolled loop, the register pressure and the number of VPM accesses which can be cached.
+		 */
+		void unrollLoops(const Module& module, Method& method, const Configuration& config);
+	}
+}
+
+#endif /* OPTIMIZATION_LOOPS_H */
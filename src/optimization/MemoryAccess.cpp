@@ -7,17 +7,26 @@
 #include "MemoryAccess.h"
 #include "../InstructionWalker.h"
 #include "../intermediate/IntermediateInstruction.h"
-#include "log.h"
+#include "../intermediate/Helper.h"
+#include "../Logging.h"
+#include "../periphery/TMU.h"
 #include "../periphery/VPM.h"
 #include "../Profiler.h"
+#include "../analysis/AliasAnalysis.h"
+#include "../analysis/ControlFlowGraph.h"
+#include "../analysis/AnalysisManager.h"
+#include "../analysis/FlagsAnalysis.h"
 
 #include <functional>
 #include <algorithm>
+#include <array>
+#include <deque>
 
 using namespace vc4c;
 using namespace vc4c::optimizations;
 using namespace vc4c::intermediate;
 using namespace vc4c::periphery;
+using analysis::MemoryLocation;
 
 struct BaseAndOffset
 {
@@ -39,7 +48,7 @@ static BaseAndOffset findOffset(const Value& val)
 	const LocalUser* writer = val.local->getSingleWriter();
 	if(dynamic_cast<const IntermediateInstruction*>(writer) != nullptr)
 	{
-		logging::debug() << writer->to_string() << logging::endl;
+		DEBUG_LOG(writer->to_string() << logging::endl);
 		const Optional<Value> offset =  dynamic_cast<const IntermediateInstruction*>(writer)->precalculate(8);
 		if(offset.hasValue && offset.get().hasType(ValueType::LITERAL))
 		{
@@ -49,6 +58,17 @@ static BaseAndOffset findOffset(const Value& val)
 	return BaseAndOffset();
 }
 
+/*
+ * Converts the byte offset to an offset in elements of the pointed-to type, if it is a multiple of the element size
+ */
+static BaseAndOffset toElementOffset(const Value& base, const long byteOffset, const Value& val)
+{
+	const long elementSize = static_cast<long>(val.type.getElementType().getPhysicalWidth());
+	if(elementSize == 0 || byteOffset % elementSize != 0)
+		return BaseAndOffset();
+	return BaseAndOffset(base, byteOffset / elementSize);
+}
+
 static BaseAndOffset findBaseAndOffset(const Value& val)
 {
 	//TODO add support for offsets via getlocal/global_id, etc.
@@ -70,23 +90,27 @@ static BaseAndOffset findBaseAndOffset(const Value& val)
 	//1. a move from another local -> need to follow the move
 	if(dynamic_cast<const MoveOperation*>(*writers.begin()) != nullptr)
 		return findBaseAndOffset(dynamic_cast<const MoveOperation*>(*writers.begin())->getSource());
-	const auto& args = dynamic_cast<const IntermediateInstruction*>(*writers.begin())->getArguments();
-	//2. an arithmetic operation with a local and a literal -> the local is the base, the literal the offset
+	//only additions of an offset to the base are supported (any other operation, e.g. a subtraction, does not yield base + offset)
+	const Operation* op = dynamic_cast<const Operation*>(*writers.begin());
+	if(op == nullptr || op->opCode != "add")
+		return BaseAndOffset();
+	const auto& args = op->getArguments();
+	//2. an addition of a local and a literal -> the local is the base, the literal the offset
 	if(args.size() == 2 && std::any_of(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LOCAL);}) && std::any_of(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LITERAL);}))
 	{
-		return BaseAndOffset(*std::find_if(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LOCAL);}),
-				static_cast<long>((*std::find_if(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LITERAL);})).literal.integer / val.type.getElementType().getPhysicalWidth()));
+		return toElementOffset(*std::find_if(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LOCAL);}),
+				(*std::find_if(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LITERAL);})).literal.integer, val);
 	}
 
-	//3. an arithmetic operation with two locals -> one is the base, the other the calculation of the literal
+	//3. an addition of two locals -> one is the base, the other the calculation of the literal
 	if(args.size() == 2 && std::all_of(args.begin(), args.end(), [](const Value& arg) -> bool{return arg.hasType(ValueType::LOCAL);}))
 	{
 		const auto offset0 = findOffset(args.at(0));
 		const auto offset1 = findOffset(args.at(1));
 		if(offset0.offset.hasValue && args.at(1).hasType(ValueType::LOCAL))
-			return BaseAndOffset(args.at(1), static_cast<long>(offset0.offset.get() / val.type.getElementType().getPhysicalWidth()));
+			return toElementOffset(args.at(1), offset0.offset.get(), val);
 		if(offset1.offset.hasValue && args.at(0).hasType(ValueType::LOCAL))
-			return BaseAndOffset(args.at(0), static_cast<long>(offset1.offset.get() / val.type.getElementType().getPhysicalWidth()));
+			return toElementOffset(args.at(0), offset1.offset.get(), val);
 	}
 
 	return BaseAndOffset();
@@ -146,20 +170,118 @@ static InstructionWalker findGenericSetup(InstructionWalker it, const Instructio
 	return end;
 }
 
+/*
+ * Maps the blocks to the block directly following them, if the control-flow passes linearly from the one block to the other,
+ * e.g. the following block is the only successor and has no other predecessor.
+ * Consecutive accesses in such a chain of blocks (e.g. created by unrolling loops) are always executed together and can therefore be combined.
+ */
+using LinearSuccessors = FastMap<const BasicBlock*, BasicBlock*>;
+
+static void skipToNextBlockInChain(InstructionWalker& it, const LinearSuccessors& successors)
+{
+	if(!it.isEndOfBlock())
+		return;
+	auto next = successors.find(it.getBasicBlock());
+	if(next != successors.end())
+		it = next->second->begin();
+}
+
+static void nextInChain(InstructionWalker& it, const LinearSuccessors& successors)
+{
+	it.nextInBlock();
+	skipToNextBlockInChain(it, successors);
+}
+
+/*
+ * Determines the chains of basic blocks of the method and returns the blocks continuing a chain, which are handled as part of the chain starting at their predecessor
+ */
+static FastSet<const BasicBlock*> findLinearSuccessors(Method& method, LinearSuccessors& successors)
+{
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	FastSet<const BasicBlock*> chainedBlocks;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		const auto& next = cfg.getSuccessors(block);
+		if(next.size() == 1 && next.front() != &block && cfg.getPredecessors(*next.front()).size() == 1 && chainedBlocks.find(next.front()) == chainedBlocks.end())
+		{
+			successors.emplace(&block, next.front());
+			chainedBlocks.emplace(next.front());
+		}
+	}
+	return chainedBlocks;
+}
+
 struct VPMAccessGroup
 {
 	bool isVPMWrite;
 	DataType groupType;
+	//the distance between two consecutive accesses of the group (in elements), 1 for consecutive memory
+	long stride;
+	//the distance between two consecutive accesses (in bytes), if it is only known at run-time (e.g. the pitch of the rows of an image)
+	Optional<Value> dynamicStride = NO_VALUE;
 	RandomAccessList<InstructionWalker> dmaSetups;
 	RandomAccessList<InstructionWalker> genericSetups;
 	RandomAccessList<InstructionWalker> addressWrites;
 };
 
-static InstructionWalker findGroupOfVPMAccess(VPM& vpm, InstructionWalker start, const InstructionWalker end, VPMAccessGroup& group)
+static bool isDynamicVPMSetup(InstructionWalker it)
+{
+	return it->hasValueType(ValueType::REGISTER) && (it->getOutput().get().hasRegister(REG_VPM_IN_SETUP) || it->getOutput().get().hasRegister(REG_VPM_OUT_SETUP)) && !it.has<LoadImmediate>();
+}
+
+/*
+ * Whether the DMA setup transfers several rows at once, e.g. for bulk memory copies
+ */
+static bool isMultiRowDMASetup(const LoadImmediate* setup, bool isVPMWrite)
+{
+	if(isVPMWrite)
+		return VPWSetup::fromLiteral(setup->getImmediate().integer).dmaSetup.getUnits() != 1;
+	return VPRSetup::fromLiteral(setup->getImmediate().integer).dmaSetup.getNumberRows() != 1;
+}
+
+/*
+ * Returns the local the address is calculated from the previous address by adding to, i.e. the distance of the accesses only known at run-time
+ */
+static Optional<Value> findDynamicStride(const Value& previousAddress, const Value& address)
+{
+	if(!address.hasType(ValueType::LOCAL) || !previousAddress.hasType(ValueType::LOCAL))
+		return NO_VALUE;
+	const Operation* op = dynamic_cast<const Operation*>(address.local->getSingleWriter());
+	if(op == nullptr || op->opCode != "add" || op->hasConditionalExecution() || op->hasPackMode() || op->hasUnpackMode() || !op->getSecondArg())
+		return NO_VALUE;
+	if(op->getFirstArg() == previousAddress && op->getSecondArg().get().hasType(ValueType::LOCAL))
+		return op->getSecondArg();
+	if(op->getSecondArg().get() == previousAddress && op->getFirstArg().hasType(ValueType::LOCAL))
+		return op->getFirstArg();
+	return NO_VALUE;
+}
+
+/*
+ * Whether the stride only known at run-time can be inserted into the DMA stride setup of the first access of the group:
+ * it must not be modified after the first access and it needs to fit into the pitch between the VPR rows (13 bits) or the gap between the VPW rows (16 bits)
+ */
+static bool isValidDynamicStride(const analysis::ValueRangeAnalysis& ranges, const Value& stride, uint64_t rowWidth, bool isVPMWrite, InstructionWalker groupStart, InstructionWalker it, const LinearSuccessors& successors)
+{
+	if(stride.local->getUsers().getNumWriters() > 1)
+		return false;
+	for(; !groupStart.isEndOfBlock() && groupStart != it; nextInChain(groupStart, successors))
+	{
+		if(groupStart.get() != nullptr && groupStart->writesLocal(stride.local))
+			return false;
+	}
+	const analysis::ValueRange range = ranges.getRange(stride);
+	if(isVPMWrite)
+		return range.minValue >= rowWidth && range.maxValue - rowWidth <= 0xFFFF;
+	return range.maxValue <= 0x1FFF;
+}
+
+static InstructionWalker findGroupOfVPMAccess(VPM& vpm, const analysis::ValueRangeAnalysis& ranges, InstructionWalker start, const LinearSuccessors& successors, VPMAccessGroup& group)
 {
 	Optional<Value> baseAddress = NO_VALUE;
-	long nextOffset = -1;
+	long lastOffset = -1;
 	group.groupType = TYPE_UNKNOWN;
+	group.stride = 1;
+	group.dynamicStride = NO_VALUE;
 	group.dmaSetups.clear();
 	group.genericSetups.clear();
 	group.addressWrites.clear(),
@@ -171,7 +293,7 @@ static InstructionWalker findGroupOfVPMAccess(VPM& vpm, InstructionWalker start,
 	//1) is not too large: either in total numbers of instructions or in ratio instructions / VPW writes, since we save a few cycles per write (incl. delay for wait DMA)
 
 	auto it = start;
-	for(; !it.isEndOfBlock() && it != end; it.nextInBlock())
+	for(; !it.isEndOfBlock(); nextInChain(it, successors))
 	{
 		if(it.get() == nullptr)
 			continue;
@@ -182,32 +304,63 @@ static InstructionWalker findGroupOfVPMAccess(VPM& vpm, InstructionWalker start,
 		if(it.has<SemaphoreAdjustment>())
 			//semaphore accesses end groups, also don't check this instruction again
 			return it.nextInBlock();
+		if(isDynamicVPMSetup(it))
+		{
+			//accesses to other VPM areas (e.g. __local memory mapped into VPM) overwrite the VPM setups of the group
+			if(baseAddress.hasValue)
+				break;
+			continue;
+		}
 
 		if(!it->hasValueType(ValueType::REGISTER) || !(it->getOutput().get().hasRegister(REG_VPM_IN_ADDR) || it->getOutput().get().hasRegister(REG_VPM_OUT_ADDR)))
 			//for simplicity, we only check for VPM addresses and find all other instructions relative to it
 			continue;
 		if(!it.has<MoveOperation>())
 			throw CompilationError(CompilationStep::OPTIMIZER, "Setting VPM address with non-move is not supported", it->to_string());
-		const auto baseAndOffset = findBaseAndOffset(it.get<MoveOperation>()->getSource());
+		const Value& address = it.get<MoveOperation>()->getSource();
+		const auto baseAndOffset = findBaseAndOffset(address);
 		const bool isVPMWrite = it->getOutput().get().hasRegister(REG_VPM_OUT_ADDR);
-		logging::debug() << "Found base address " << baseAndOffset.base.to_string() << " with offset " << std::to_string(baseAndOffset.offset.orElse(-1L)) << " for " << (isVPMWrite ? "writing into" : "reading from") << " memory" << logging::endl;
+		DEBUG_LOG("Found base address " << baseAndOffset.base.to_string() << " with offset " << std::to_string(baseAndOffset.offset.orElse(-1L)) << " for " << (isVPMWrite ? "writing into" : "reading from") << " memory" << logging::endl);
+
+		//an address calculated by adding the same local to the previous address continues the group with a stride only known at run-time
+		Optional<Value> dynamicStride = NO_VALUE;
+		if(baseAddress.hasValue && group.isVPMWrite == isVPMWrite && (group.addressWrites.size() == 1 || group.dynamicStride.hasValue))
+			dynamicStride = findDynamicStride(group.addressWrites.back().get<MoveOperation>()->getSource(), address);
+		if(group.dynamicStride.hasValue && (!dynamicStride.hasValue || dynamicStride.get() != group.dynamicStride.get()))
+			//a group exists, but the address is not the same distance apart
+			break;
+		if(dynamicStride.hasValue && group.addressWrites.size() == 1 &&
+				!isValidDynamicStride(ranges, dynamicStride.get(), address.type.getElementType().getPhysicalWidth(), isVPMWrite, group.dmaSetups.at(0), it, successors))
+			dynamicStride = NO_VALUE;
 
-		if(!baseAndOffset.base.hasValue)
+		if(!dynamicStride.hasValue && !baseAndOffset.base.hasValue)
 			//this address-write could not be fixed to a base and an offset
 			//skip this address write for the next check
 			return it.nextInBlock();
-		if(baseAndOffset.base.hasValue && baseAndOffset.base.get().hasType(ValueType::LOCAL) && baseAndOffset.base.get().local->is<Parameter>() && has_flag(baseAndOffset.base.get().local->as<Parameter>()->decorations, ParameterDecorations::VOLATILE))
+		if(!dynamicStride.hasValue && baseAndOffset.base.get().hasType(ValueType::LOCAL) && baseAndOffset.base.get().local->is<Parameter>() && has_flag(baseAndOffset.base.get().local->as<Parameter>()->decorations, ParameterDecorations::VOLATILE))
 			//address points to a volatile parameter, which explicitly forbids combining reads/writes
 			//skip this address write for the next check
 			return it.nextInBlock();
 
-		//check if this address is consecutive to the previous one (if any)
-		if(baseAddress.hasValue)
+		//check if this address continues the (strided) sequence of the previous ones (if any)
+		long stride = group.stride;
+		if(baseAddress.hasValue && !dynamicStride.hasValue)
 		{
 			if(baseAndOffset.base.hasValue && baseAddress.get() != baseAndOffset.base.get())
 				//a group exists, but the base addresses don't match
 				break;
-			if(!baseAndOffset.offset.hasValue || baseAndOffset.offset.get() != nextOffset)
+			if(!baseAndOffset.offset.hasValue)
+				break;
+			if(group.addressWrites.size() == 1)
+			{
+				//the second access determines the stride of the group
+				stride = baseAndOffset.offset.get() - lastOffset;
+				const long strideBytes = stride * static_cast<long>(address.type.getElementType().getPhysicalWidth());
+				//the VPR DMA stride is the pitch between the rows (13 bits), the VPW DMA stride the gap between the rows (16 bits)
+				if(stride < 1 || (isVPMWrite && strideBytes - static_cast<long>(address.type.getElementType().getPhysicalWidth()) > 0xFFFF) || (!isVPMWrite && strideBytes > 0x1FFF))
+					break;
+			}
+			else if(baseAndOffset.offset.get() != lastOffset + stride)
 				//a group exists, but the offsets do not match
 				break;
 		}
@@ -216,13 +369,22 @@ static InstructionWalker findGroupOfVPMAccess(VPM& vpm, InstructionWalker start,
 		if(baseAddress.hasValue && group.isVPMWrite != isVPMWrite)
 			break;
 
-		auto genericSetup = findGenericSetup(it, end, isVPMWrite);
-		auto dmaSetup = findDMASetup(it, end, isVPMWrite);
+		const InstructionWalker notFound = it.getBasicBlock()->end();
+		auto genericSetup = findGenericSetup(it, notFound, isVPMWrite);
+		auto dmaSetup = findDMASetup(it, notFound, isVPMWrite);
+
+		if(dmaSetup != notFound && dmaSetup.has<LoadImmediate>() && isMultiRowDMASetup(dmaSetup.get<LoadImmediate>(), isVPMWrite))
+		{
+			//the access already transfers several rows, it cannot be combined any further
+			if(baseAddress.hasValue)
+				break;
+			return it.nextInBlock();
+		}
 
 		//check if the VPM and DMA configurations match with the previous one
 		if(baseAddress.hasValue)
 		{
-			if(genericSetup == end || dmaSetup == end)
+			if(genericSetup == notFound || dmaSetup == notFound)
 				//either there are no setups for this VPM access, or they are not loaded from literals (e.g. dynamic setup)
 				break;
 			if(!genericSetup.has<LoadImmediate>() || genericSetup.get<LoadImmediate>()->getImmediate().integer != group.genericSetups.at(0).get<LoadImmediate>()->getImmediate().integer)
@@ -234,7 +396,8 @@ static InstructionWalker findGroupOfVPMAccess(VPM& vpm, InstructionWalker start,
 		}
 
 		//check for complex types
-		DataType elementType = baseAndOffset.base.get().type.isPointerType() ? baseAndOffset.base.get().type.getPointerType().get()->elementType : baseAndOffset.base.get().type;
+		const DataType baseType = dynamicStride.hasValue ? group.groupType : baseAndOffset.base.get().type;
+		DataType elementType = baseType.isPointerType() ? baseType.getPointerType().get()->elementType : baseType;
 		elementType = elementType.getArrayType().hasValue ? elementType.getArrayType().get()->elementType : elementType;
 		if(elementType.complexType)
 			//XXX for now, skip combining any access to complex types (here: only struct, image)
@@ -243,12 +406,15 @@ static InstructionWalker findGroupOfVPMAccess(VPM& vpm, InstructionWalker start,
 
 		//all matches so far, add to group (or create a new one)
 		group.isVPMWrite = isVPMWrite;
-		group.groupType = baseAndOffset.base.get().type;
-		baseAddress = baseAndOffset.base.get();
+		group.groupType = baseType;
+		group.stride = stride;
+		group.dynamicStride = dynamicStride;
+		if(!dynamicStride.hasValue)
+			baseAddress = baseAndOffset.base.get();
 		group.addressWrites.push_back(it);
 		group.dmaSetups.push_back(dmaSetup);
 		group.genericSetups.push_back(genericSetup);
-		nextOffset = baseAndOffset.offset.orElse(-1L) + 1;
+		lastOffset = baseAndOffset.offset.orElse(-1L);
 
 		if(group.isVPMWrite && group.addressWrites.size() >= vpm.getMaxCacheVectors(elementType, true))
 		{
@@ -271,20 +437,73 @@ static InstructionWalker findGroupOfVPMAccess(VPM& vpm, InstructionWalker start,
 	return it;
 }
 
-static void groupVPMWrites(VPM& vpm, VPMAccessGroup& group)
+/*
+ * Removes all mutex acquires and releases between the two instructions (following the chain of blocks)
+ */
+static std::size_t removeMutexAccesses(InstructionWalker it, const InstructionWalker end, const LinearSuccessors& successors)
+{
+	std::size_t numRemoved = 0;
+	while(!it.isEndOfBlock() && it != end)
+	{
+		if(it.get() && it->getOutput().hasValue && it->getOutput().get().hasRegister(REG_MUTEX))
+		{
+			it.erase();
+			++numRemoved;
+		}
+		else if(it.has<MoveOperation>() && it.get<MoveOperation>()->getSource().hasRegister(REG_MUTEX))
+		{
+			it.erase();
+			++numRemoved;
+		}
+		else
+			it.nextInBlock();
+		skipToNextBlockInChain(it, successors);
+	}
+	return numRemoved;
+}
+
+static void groupVPMWrites(Method& method, VPMAccessGroup& group, const LinearSuccessors& successors)
 {
 	if(group.genericSetups.size() != group.addressWrites.size() || group.genericSetups.size() != group.dmaSetups.size())
 			throw CompilationError(CompilationStep::OPTIMIZER, "Number of instructions do not match for combining VPR reads!");
 	if(group.addressWrites.size() <= 1)
 		return;
-	logging::debug() << "Combining " << group.addressWrites.size() << " writes to consecutive memory into one DMA write... " << logging::endl;
+	DEBUG_LOG("Combining " << group.addressWrites.size() << " writes to memory with a stride of " << (group.dynamicStride.hasValue ? group.dynamicStride.to_string() : std::to_string(group.stride)) << " into one DMA write... " << logging::endl);
 
 	//1. Update DMA setup to the number of rows written
 	VPWSetup dmaSetupValue(group.dmaSetups.at(0).get<LoadImmediate>()->getImmediate().integer);
 	dmaSetupValue.dmaSetup.setUnits(group.addressWrites.size());
 	group.dmaSetups.at(0).get<LoadImmediate>()->setImmediate(Literal(static_cast<long>(dmaSetupValue.value)));
 	std::size_t numRemoved = 0;
-	vpm.updateScratchSize(group.addressWrites.size() * group.groupType.getElementType().getPhysicalWidth());
+	method.vpm->updateScratchSize(group.addressWrites.size() * group.groupType.getElementType().getPhysicalWidth());
+
+	//1.1 Update the DMA stride setup to skip the elements not written
+	//the row written only covers the actual elements, so for 3-element vectors the padding element needs to be skipped too
+	const DataType rowType = group.addressWrites.at(0).get<MoveOperation>()->getSource().type.getElementType();
+	const long rowWidth = static_cast<long>(rowType.getVectorWidth() * rowType.getScalarBitCount() / 8);
+	const long rowPitch = static_cast<long>(rowType.getPhysicalWidth());
+	if(group.stride != 1 || group.dynamicStride.hasValue || rowWidth != rowPitch)
+	{
+		LoadImmediate* strideSetup = group.dmaSetups.at(0).copy().nextInBlock().get<LoadImmediate>();
+		if(strideSetup == nullptr || !strideSetup->getOutput().get().hasRegister(REG_VPM_OUT_SETUP) || !VPWSetup::fromLiteral(strideSetup->getImmediate().integer).isStrideSetup())
+			throw CompilationError(CompilationStep::OPTIMIZER, "Failed to find VPW DMA stride setup for DMA setup", group.dmaSetups.at(0)->to_string());
+		if(group.dynamicStride.hasValue)
+		{
+			//the gap (the stride minus the row written) is only known at run-time and added to the setup with a gap of zero,
+			//which cannot overflow into the other bits, since the gap is known to fit into 16 bits
+			const Value setupRegister = strideSetup->getOutput().get();
+			const Value setup = method.addNewLocal(TYPE_INT32, "%vpw_stride_setup");
+			auto strideIt = group.dmaSetups.at(0).copy().nextInBlock();
+			strideIt.reset(new LoadImmediate(setup, Literal(static_cast<long>(VPWSetup(VPWStrideSetup(0)).value) - rowWidth)));
+			strideIt.nextInBlock();
+			strideIt.emplace(new Operation("add", setupRegister, setup, group.dynamicStride.get()));
+		}
+		else
+		{
+			const VPWSetup strideValue(VPWStrideSetup(static_cast<uint16_t>(group.stride * rowPitch - rowWidth)));
+			strideSetup->setImmediate(Literal(static_cast<long>(strideValue.value)));
+		}
+	}
 
 	//2. Remove all but the first generic and DMA setups
 	for(std::size_t i = 1; i < group.genericSetups.size(); ++i)
@@ -310,47 +529,56 @@ static void groupVPMWrites(VPM& vpm, VPMAccessGroup& group)
 	}
 
 	//4. remove all Mutex acquires and releases between the first and the last write, so memory consistency is restored
-	auto it = group.dmaSetups.front();
-	while(!it.isEndOfBlock() && it != group.addressWrites.back())
-	{
-		if(it.get() && it->getOutput().hasValue && it->getOutput().get().hasRegister(REG_MUTEX))
-		{
-			it = it.erase();
-			++numRemoved;
-		}
-		else if(it.has<MoveOperation>() && it.get<MoveOperation>()->getSource().hasRegister(REG_MUTEX))
-		{
-			it = it.erase();
-			++numRemoved;
-		}
-		else
-			it.nextInBlock();
-	}
+	numRemoved += removeMutexAccesses(group.dmaSetups.front(), group.addressWrites.back(), successors);
 
-	logging::debug() << "Removed " << numRemoved << " instructions by combining VPW writes" << logging::endl;
+	DEBUG_LOG("Removed " << numRemoved << " instructions by combining VPW writes" << logging::endl);
 }
 
-static void groupVPMReads(VPM& vpm, VPMAccessGroup& group)
+static void groupVPMReads(Method& method, VPMAccessGroup& group, const LinearSuccessors& successors)
 {
 	if(group.genericSetups.size() != group.addressWrites.size() || group.genericSetups.size() != group.dmaSetups.size())
 		throw CompilationError(CompilationStep::OPTIMIZER, "Number of instructions do not match for combining VPR reads!");
 
 	if(group.genericSetups.size() <= 1)
 		return;
-	logging::debug() << "Combining " << group.genericSetups.size() << " reads of consecutive memory into one DMA read... " << logging::endl;
+	DEBUG_LOG("Combining " << group.genericSetups.size() << " reads of memory with a stride of " << (group.dynamicStride.hasValue ? group.dynamicStride.to_string() : std::to_string(group.stride)) << " into one DMA read... " << logging::endl);
 
 	//1. Update DMA setup to the number of rows read
 	VPRSetup dmaSetupValue(group.dmaSetups.at(0).get<LoadImmediate>()->getImmediate().integer);
 	dmaSetupValue.dmaSetup.setNumberRows(group.genericSetups.size() % 16);
 	group.dmaSetups.at(0).get<LoadImmediate>()->setImmediate(Literal(static_cast<long>(dmaSetupValue.value)));
 	std::size_t numRemoved = 0;
-	vpm.updateScratchSize(group.genericSetups.size() * group.groupType.getElementType().getPhysicalWidth());
+	method.vpm->updateScratchSize(group.genericSetups.size() * group.groupType.getElementType().getPhysicalWidth());
 
 	//1.1 Update generic Setup to the number of rows read
 	VPRSetup genericSetup(group.genericSetups.at(0).get<LoadImmediate>()->getImmediate().integer);
 	genericSetup.genericSetup.setNumber(group.genericSetups.size() % 16);
 	group.genericSetups.at(0).get<LoadImmediate>()->setImmediate(Literal(static_cast<long>(genericSetup.value)));
 
+	//1.2 Update the DMA stride setup (the pitch between two rows in memory) to skip the elements not read
+	if(group.stride != 1 || group.dynamicStride.hasValue)
+	{
+		LoadImmediate* strideSetup = group.dmaSetups.at(0).copy().nextInBlock().get<LoadImmediate>();
+		if(strideSetup == nullptr || !strideSetup->getOutput().get().hasRegister(REG_VPM_IN_SETUP) || !VPRSetup::fromLiteral(strideSetup->getImmediate().integer).isStrideSetup())
+			throw CompilationError(CompilationStep::OPTIMIZER, "Failed to find VPR DMA stride setup for DMA setup", group.dmaSetups.at(0)->to_string());
+		if(group.dynamicStride.hasValue)
+		{
+			//the pitch is only known at run-time and added to the setup with a pitch of zero, which cannot overflow into the other bits,
+			//since the pitch is known to fit into 13 bits
+			const Value setupRegister = strideSetup->getOutput().get();
+			const Value setup = method.addNewLocal(TYPE_INT32, "%vpr_stride_setup");
+			auto strideIt = group.dmaSetups.at(0).copy().nextInBlock();
+			strideIt.reset(new LoadImmediate(setup, Literal(static_cast<long>(VPRSetup(VPRStrideSetup(0)).value))));
+			strideIt.nextInBlock();
+			strideIt.emplace(new Operation("add", setupRegister, setup, group.dynamicStride.get()));
+		}
+		else
+		{
+			const VPRSetup strideValue(VPRStrideSetup(static_cast<uint16_t>(group.stride * group.addressWrites.at(0).get<MoveOperation>()->getSource().type.getElementType().getPhysicalWidth())));
+			strideSetup->setImmediate(Literal(static_cast<long>(strideValue.value)));
+		}
+	}
+
 	//2. Remove all but the first generic and DMA setups
 	for(std::size_t i = 1; i < group.genericSetups.size(); ++i)
 	{
@@ -364,22 +592,7 @@ static void groupVPMReads(VPM& vpm, VPMAccessGroup& group)
 	}
 
 	//3. remove all Mutex acquires and releases between the first and the last write, so memory consistency is restored
-	auto it = group.addressWrites.front();
-	while(!it.isEndOfBlock() && it != group.addressWrites.back())
-	{
-		if(it.get() && it->getOutput().hasValue && it->getOutput().get().hasRegister(REG_MUTEX))
-		{
-			it = it.erase();
-			++numRemoved;
-		}
-		else if(it.has<MoveOperation>() && it.get<MoveOperation>()->getSource().hasRegister(REG_MUTEX))
-		{
-			it = it.erase();
-			++numRemoved;
-		}
-		else
-			it.nextInBlock();
-	}
+	numRemoved += removeMutexAccesses(group.addressWrites.front(), group.addressWrites.back(), successors);
 
 	//4. remove all but the first address writes (and the following DMA writes)
 	for(std::size_t i = 1; i < group.addressWrites.size(); ++i)
@@ -391,7 +604,7 @@ static void groupVPMReads(VPM& vpm, VPMAccessGroup& group)
 		numRemoved += 2;
 	}
 
-	logging::debug() << "Removed " << numRemoved << " instructions by combining VPR reads" << logging::endl;
+	DEBUG_LOG("Removed " << numRemoved << " instructions by combining VPR reads" << logging::endl);
 }
 
 void optimizations::combineVPMAccess(const Module& module, Method& method, const Configuration& config)
@@ -400,21 +613,33 @@ void optimizations::combineVPMAccess(const Module& module, Method& method, const
 
 	//TODO for now, this cannot handle RAM->VPM, VPM->RAM only access as well as VPM->QPU or QPU->VPM
 
-	// run within all basic blocks
+	//determine the chains of blocks executed linearly after each other
+	LinearSuccessors successors;
+	const FastSet<const BasicBlock*> chainedBlocks = findLinearSuccessors(method, successors);
+	//the ranges of the strides only known at run-time
+	const analysis::ValueRangeAnalysis& ranges = method.getAnalyses().getValueRanges();
+
+	// run within all chains of basic blocks
 	for(BasicBlock& block : method.getBasicBlocks())
 	{
+		if(chainedBlocks.find(&block) != chainedBlocks.end())
+			//is handled as part of the chain starting at its predecessor
+			continue;
 		auto it = block.begin();
+		FastSet<const BasicBlock*> visitedBlocks;
 		while(!it.isEndOfBlock())
 		{
 			VPMAccessGroup group;
-			it = findGroupOfVPMAccess(*method.vpm.get(), it, block.end(), group);
+			it = findGroupOfVPMAccess(*method.vpm.get(), ranges, it, successors, group);
 			if(group.addressWrites.size() > 1)
 			{
 				if(group.isVPMWrite)
-					groupVPMWrites(*method.vpm.get(), group);
+					groupVPMWrites(method, group, successors);
 				else
-					groupVPMReads(*method.vpm.get(), group);
+					groupVPMReads(method, group, successors);
 			}
+			if(it.isEndOfBlock() && visitedBlocks.emplace(it.getBasicBlock()).second)
+				skipToNextBlockInChain(it, successors);
 		}
 	}
 
@@ -423,104 +648,1953 @@ void optimizations::combineVPMAccess(const Module& module, Method& method, const
 	PROFILE_COUNTER(8010, "Scratch memory size", method.vpm->getScratchArea().size);
 }
 
-InstructionWalker optimizations::accessGlobalData(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
+static bool isSetupWrite(InstructionWalker it, const Register& reg)
+{
+	return !it.isEndOfBlock() && it.has<LoadImmediate>() && it->getOutput().get().hasRegister(reg);
+}
+
+static bool isRegisterRead(InstructionWalker it, const Register& reg)
+{
+	return !it.isEndOfBlock() && it.has<MoveOperation>() && it.get<MoveOperation>()->getSource().hasRegister(reg);
+}
+
+static bool isMutexRelease(InstructionWalker it)
+{
+	return !it.isEndOfBlock() && it.has<MoveOperation>() && it->getOutput().get().hasRegister(REG_MUTEX);
+}
+
+static bool isMappableElement(const Value& value)
+{
+	return value.type.num == 1 && value.type.getScalarBitCount() == 32 && !value.type.getArrayType().hasValue && (value.type.complexType == nullptr || value.type.isPointerType());
+}
+
+static bool isTMUElement(const Value& value)
+{
+	//the TMU reads one 32-bit word per SIMD element
+	return value.type.getScalarBitCount() == 32 && !value.type.getArrayType().hasValue && (value.type.complexType == nullptr || value.type.isPointerType());
+}
+
+/*
+ * A single memory access as generated by periphery#insertReadDMA or periphery#insertWriteDMA
+ */
+struct DMAAccess
+{
+	//the first instruction of the access (the VPM setup or the VPM write)
+	InstructionWalker start;
+	//the write of the memory address
+	InstructionWalker addressWrite;
+	//the last instruction of the access (the VPM read or the DMA wait)
+	InstructionWalker end;
+	bool isWrite;
+	//whether the access is guarded by a mutex
+	bool hasMutex;
+};
+
+static Optional<DMAAccess> checkDMAAccess(InstructionWalker addressWrite, bool(*isSupportedElement)(const Value&))
 {
 	/*
-	 * Map pointer to global data to the start-of-global-data parameter
-	 *  plus the offset of the global data
+	 * Reading from memory (see periphery#insertReadDMA):
+	 * (mutex acquire), VPR DMA setup, VPR stride setup, address write, DMA wait, VPR generic setup, VPM read, (mutex release)
+	 *
+	 * Writing to memory (see periphery#insertWriteDMA):
+	 * (mutex acquire), VPW generic setup, VPM write, VPW DMA setup, VPW stride setup, address write, DMA wait, (mutex release)
 	 */
-	for(std::size_t i = 0; i < it->getArguments().size(); ++i)
+	DMAAccess access;
+	access.addressWrite = addressWrite;
+	access.isWrite = addressWrite->getOutput().get().hasRegister(REG_VPM_OUT_ADDR);
+	const Register setupRegister = access.isWrite ? REG_VPM_OUT_SETUP : REG_VPM_IN_SETUP;
+	if(addressWrite.isStartOfBlock() || addressWrite.copy().previousInBlock().isStartOfBlock())
+		return {};
+	auto dmaSetup = addressWrite.copy().previousInBlock().previousInBlock();
+	if(!isSetupWrite(addressWrite.copy().previousInBlock(), setupRegister) || !isSetupWrite(dmaSetup, setupRegister))
+		return {};
+	auto dmaWait = addressWrite.copy().nextInBlock();
+	if(!isRegisterRead(dmaWait, access.isWrite ? REG_VPM_OUT_WAIT : REG_VPM_IN_WAIT))
+		return {};
+	if(access.isWrite)
 	{
-		const auto& arg = it->getArgument(i).get();
-		if(arg.hasType(ValueType::LOCAL) && arg.type.isPointerType() && arg.local->is<Global>())
+		if(dmaSetup.isStartOfBlock() || dmaSetup.copy().previousInBlock().isStartOfBlock())
+			return {};
+		auto vpmWrite = dmaSetup.copy().previousInBlock();
+		access.start = vpmWrite.copy().previousInBlock();
+		if(!vpmWrite.has<MoveOperation>() || !vpmWrite->getOutput().get().hasRegister(REG_VPM_IO) || !isSupportedElement(vpmWrite.get<MoveOperation>()->getSource()))
+			return {};
+		if(!isSetupWrite(access.start, setupRegister))
+			return {};
+		access.end = dmaWait;
+	}
+	else
+	{
+		access.start = dmaSetup;
+		auto vpmRead = dmaWait.copy().nextInBlock().nextInBlock();
+		if(!isSetupWrite(dmaWait.copy().nextInBlock(), setupRegister) || !isRegisterRead(vpmRead, REG_VPM_IO) || !isSupportedElement(vpmRead->getOutput().get()))
+			return {};
+		access.end = vpmRead;
+	}
+	access.hasMutex = !access.start.isStartOfBlock() && isRegisterRead(access.start.copy().previousInBlock(), REG_MUTEX) && isMutexRelease(access.end.copy().nextInBlock());
+	return access;
+}
+
+static void removeMutex(DMAAccess& access)
+{
+	if(access.hasMutex)
+	{
+		access.start.copy().previousInBlock().erase();
+		access.end.copy().nextInBlock().erase();
+		access.hasMutex = false;
+	}
+}
+
+static bool isPointerDerivation(const IntermediateInstruction* instr)
+{
+	if(!instr->hasValueType(ValueType::LOCAL) || !instr->getOutput().get().type.isPointerType())
+		return false;
+	if(instr->kind == InstructionKind::MOVE)
+		return true;
+	return instr->kind == InstructionKind::OPERATION && (dynamic_cast<const Operation*>(instr)->opCode == "add" || dynamic_cast<const Operation*>(instr)->opCode == "sub");
+}
+
+/*
+ * Determines all accesses to the memory object (via the pointers derived from it), which have a supported element-type.
+ *
+ * Returns false, if any of the derived pointers can also point to another memory object.
+ * If the object (or a derived pointer) is used in any other way than a memory access, hasOtherUses is set.
+ */
+static bool findMemoryAccesses(Method& method, const Local* base, std::vector<DMAAccess>& accesses, bool& hasOtherUses, bool(*isSupportedElement)(const Value&))
+{
+	hasOtherUses = false;
+	//1. determine all pointers derived from the memory object
+	FastSet<const Local*> pointers;
+	pointers.emplace(base);
+	bool changed = true;
+	while(changed)
+	{
+		changed = false;
+		method.forAllInstructions([&](const IntermediateInstruction* instr) -> bool
 		{
-			const Optional<unsigned int> globalOffset = module.getGlobalDataOffset(arg.local);
-			if(globalOffset.hasValue)
+			if(isPointerDerivation(instr) && pointers.find(instr->getOutput().get().local) == pointers.end() &&
+					std::any_of(instr->getArguments().begin(), instr->getArguments().end(), [&](const Value& arg) -> bool { return arg.hasType(ValueType::LOCAL) && pointers.find(arg.local) != pointers.end(); }))
 			{
-				logging::debug() << "Replacing access to global data: " << it->to_string() << logging::endl;
-				Value tmp = UNDEFINED_VALUE;
-				if(globalOffset.get() == 0)
-				{
-					tmp = method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_DATA_ADDRESS)->createReference();
-				}
-				else
-				{
-					//emplace calculation of global-data pointer and replace argument
-					tmp = method.addNewLocal(TYPE_INT32, "%global_data_offset");
-					it.emplace(new intermediate::Operation("add", tmp, method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_DATA_ADDRESS)->createReference(), Value(Literal(static_cast<unsigned long>(globalOffset)), TYPE_INT32)));
-					it.nextInBlock();
-				}
-				it->setArgument(i, tmp);
+				pointers.emplace(instr->getOutput().get().local);
+				changed = true;
+			}
+			return true;
+		});
+	}
+	//2. the derived pointers must not be written with any other value (e.g. a pointer to another memory object)
+	for(const Local* pointer : pointers)
+	{
+		if(pointer == base)
+			continue;
+		for(const LocalUser* writer : pointer->getUsers(LocalUser::Type::WRITER))
+		{
+			const IntermediateInstruction* instr = dynamic_cast<const IntermediateInstruction*>(writer);
+			if(instr == nullptr || !isPointerDerivation(instr) || std::none_of(instr->getArguments().begin(), instr->getArguments().end(), [&](const Value& arg) -> bool { return arg.hasType(ValueType::LOCAL) && pointers.find(arg.local) != pointers.end(); }))
+			{
+				DEBUG_LOG("Pointer derived from " << base->to_string() << " is also written by: " << writer->to_string() << logging::endl);
+				return false;
 			}
 		}
 	}
-	return it;
+	//3. check all uses of these pointers
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == nullptr)
+				continue;
+			std::size_t numPointerArgs = 0;
+			for(const Value& arg : it->getArguments())
+			{
+				if(arg.hasType(ValueType::LOCAL) && pointers.find(arg.local) != pointers.end())
+					++numPointerArgs;
+			}
+			if(numPointerArgs == 0)
+				continue;
+			if(isPointerDerivation(it.get()) && numPointerArgs == 1)
+				continue;
+			Optional<DMAAccess> access;
+			if(it.has<MoveOperation>() && it->hasValueType(ValueType::REGISTER) && (it->getOutput().get().hasRegister(REG_VPM_IN_ADDR) || it->getOutput().get().hasRegister(REG_VPM_OUT_ADDR)))
+				access = checkDMAAccess(it, isSupportedElement);
+			if(!access)
+			{
+				//the pointer is used in any other way (e.g. compared, passed to a function, stored or accessed with another type)
+				DEBUG_LOG("Memory object " << base->to_string() << " is used by: " << it->to_string() << logging::endl);
+				hasOtherUses = true;
+				continue;
+			}
+			accesses.push_back(access.get());
+		}
+	}
+	return true;
 }
 
-void optimizations::spillLocals(const Module& module, Method& method, const Configuration& config)
+void optimizations::mapLocalMemoryToVPM(const Module& module, Method& method, const Configuration& config)
 {
-	static const std::size_t MINIMUM_THRESHOLD = 128; /* TODO some better limit */
-	//TODO need to know how much of the VPM is still free (need per-kernel VPM object)
-	//also need to heed not to write/read into/from VPM from within a block of DMA reads/writes
-	//XXX or revert: run this before #combineVPMAccess and reserve as much VPM as required (dynamically, how? or first determine size, then spill)
-	//and use the remainder for #combineVPMAccess
-	//also need to regard writing into VPM (without DMA) for #combineVPMAccess, so the VPM configurations do not conflict
+	//all objects are collected first, so the objects with the most accesses per byte are mapped, if not all of them fit into the VPM
+	std::vector<std::pair<const Global*, std::vector<DMAAccess>>> candidates;
+	VPMPlanner planner(*method.vpm, VPMUsage::LOCAL_MEMORY);
+	for(const Global& global : module.globalData)
+	{
+		if(!global.type.isPointerType() || global.type.getPointerType().get()->addressSpace != AddressSpace::LOCAL)
+			continue;
+		const DataType& contentType = global.type.getPointerType().get()->elementType;
+		const DataType elementType = contentType.getArrayType().hasValue ? contentType.getArrayType().get()->elementType : contentType;
+		if(elementType.complexType != nullptr || elementType.num != 1 || elementType.getScalarBitCount() != 32)
+			continue;
+		const unsigned size = contentType.getPhysicalWidth();
+		std::vector<DMAAccess> accesses;
+		bool hasOtherUses = false;
+		if(!findMemoryAccesses(method, &global, accesses, hasOtherUses, isMappableElement) || hasOtherUses || accesses.empty())
+			continue;
+		planner.addDemand(&global, size, static_cast<double>(accesses.size()));
+		candidates.emplace_back(&global, std::move(accesses));
+	}
+	const FastMap<const Local*, const VPMArea*> areas = planner.allocate();
 
-	/*
-	 * 1. find all candidate locals for spilling:
-	 * - no labels (since they are never mapped to registers)
-	 * - only one write (for now, for easier handling)
-	 * - not used only locally within a minimum range, since those locals are more likely to be mapped to registers
-	 */
-	//tracks the locals and their writing instructions
-	FastMap<const Local*, InstructionWalker> spillingCandidates;
-	for(const auto& pair : method.readLocals())
+	std::size_t numMapped = 0;
+	for(auto& candidate : candidates)
 	{
-		if(pair.second.type == TYPE_LABEL)
+		const Global& global = *candidate.first;
+		auto areaIt = areas.find(&global);
+		if(areaIt == areas.end())
+		{
+			DEBUG_LOG("Not enough VPM space left to map " << global.to_string() << logging::endl);
 			continue;
-		//XXX for now, only select locals which are written just once
-		//or maybe never (not yet), e.g. for hidden parameter
-		//or written several times but read only once
-		//TODO also include explicit parameters
-		auto numWrites = pair.second.getUsers(LocalUser::Type::WRITER).size();
-		auto numReads = pair.second.getUsers(LocalUser::Type::READER).size();
-		if((numWrites <= 1 && numReads > 0) || (numWrites >= 1 && numReads == 1))
+		}
+		const VPMArea* area = areaIt->second;
+		for(DMAAccess& access : candidate.second)
 		{
-			spillingCandidates.emplace(&pair.second, InstructionWalker{});
+			DEBUG_LOG("Mapping access to __local memory into VPM: " << access.addressWrite->to_string() << logging::endl);
+			const Value offset = method.addNewLocal(TYPE_INT32, "%local_offset");
+			auto it = access.start;
+			it.emplace(new Operation("sub", offset, access.addressWrite.get<MoveOperation>()->getSource(), global.createReference()));
+			it.nextInBlock();
+			if(access.isWrite)
+			{
+				//the instruction after the VPM setup is the write of the value into the VPM
+				const Value src = access.start.copy().nextInBlock().get<MoveOperation>()->getSource();
+				//several QPUs might write into the same row, so the read-modify-write needs to be guarded
+				it = method.vpm->insertWriteVPM(method, it, src, *area, offset, !access.hasMutex);
+			}
+			else
+			{
+				const Value dest = access.end->getOutput().get();
+				//the whole row is read at once, so there is no need to lock the VPM
+				removeMutex(access);
+				it = method.vpm->insertReadVPM(method, it, dest, *area, offset);
+			}
+			//remove the DMA access
+			while(it != access.end)
+				it.erase();
+			it.erase();
 		}
+		++numMapped;
 	}
+	DEBUG_LOG("Mapped " << numMapped << " __local memory objects into VPM" << logging::endl);
+}
 
-	InstructionWalker it = method.walkAllInstructions();
-	//skip all leading empty basic blocks
-	while(!it.isEndOfMethod() && it.has<intermediate::BranchLabel>())
-		it.nextInMethod();
-	auto candIt = spillingCandidates.begin();
-	while(!it.isEndOfMethod() && candIt != spillingCandidates.end())
+void optimizations::preloadConstantTables(const Module& module, Method& method, const Configuration& config)
+{
+	if(config.maxPreloadedTableSize == 0)
+		return;
+	//same as for __local memory, the tables with the most lookups per byte are preloaded, if not all of them fit into the VPM
+	std::vector<std::pair<const Global*, std::vector<DMAAccess>>> candidates;
+	VPMPlanner planner(*method.vpm, VPMUsage::LOCAL_MEMORY);
+	for(const Global& global : module.globalData)
 	{
-		//check if only read the first X instructions (from the start of the kernel), e.g. for (hidden) parameter, where the next check fails,
-		//since they are not yet written anywhere
-		if(method.isLocallyLimited(it, candIt->first, MINIMUM_THRESHOLD))
-			candIt = spillingCandidates.erase(candIt);
-		else
-			++candIt;
+		if(!global.type.isPointerType() || global.type.getPointerType().get()->addressSpace != AddressSpace::CONSTANT)
+			continue;
+		const DataType& contentType = global.type.getPointerType().get()->elementType;
+		const DataType elementType = contentType.getArrayType().hasValue ? contentType.getArrayType().get()->elementType : contentType;
+		if(elementType.complexType != nullptr || elementType.num != 1 || elementType.getScalarBitCount() != 32)
+			continue;
+		const unsigned size = contentType.getPhysicalWidth();
+		if(size > config.maxPreloadedTableSize)
+			continue;
+		std::vector<DMAAccess> accesses;
+		bool hasOtherUses = false;
+		if(!findMemoryAccesses(method, &global, accesses, hasOtherUses, isMappableElement) || hasOtherUses || accesses.empty())
+			continue;
+		if(std::any_of(accesses.begin(), accesses.end(), [](const DMAAccess& access) -> bool { return access.isWrite;}))
+			continue;
+		planner.addDemand(&global, size, static_cast<double>(accesses.size()));
+		candidates.emplace_back(&global, std::move(accesses));
 	}
-	while(!it.isEndOfMethod() && !spillingCandidates.empty())
+	if(candidates.empty())
+		return;
+	const FastMap<const Local*, const VPMArea*> areas = planner.allocate();
+
+	std::size_t numPreloaded = 0;
+	auto start = method.walkAllInstructions().nextInBlock();
+	for(auto& candidate : candidates)
 	{
-		//TODO if at some point all Basic block have references to their used locals, remove all locals which are used just in one basic block instead of this logic??
-		if(it->hasValueType(ValueType::LOCAL) && spillingCandidates.find(it->getOutput().get().local) != spillingCandidates.end())
+		const Global& global = *candidate.first;
+		auto areaIt = areas.find(&global);
+		if(areaIt == areas.end() || areaIt->second->baseOffset + areaIt->second->size > VPM_MAX_DMA_ROWS * VPM_ROW_SIZE)
 		{
-			if(method.isLocallyLimited(it, it->getOutput().get().local, MINIMUM_THRESHOLD))
-				spillingCandidates.erase(it->getOutput().get().local);
-			else
-				spillingCandidates.at(it->getOutput().get().local) = it;
+			DEBUG_LOG("Not enough VPM space left to preload " << global.to_string() << logging::endl);
+			continue;
+		}
+		const VPMArea* area = areaIt->second;
+		//every QPU loads the table at its start. Since all QPUs write the very same data, the copy is valid for the other QPUs while it is being loaded again
+		start = method.vpm->insertReadRAMIntoArea(method, start, global.createReference(), *area, global.type.getPointerType().get()->elementType.getPhysicalWidth());
+		for(DMAAccess& access : candidate.second)
+		{
+			DEBUG_LOG("Reading lookup of __constant table from VPM: " << access.addressWrite->to_string() << logging::endl);
+			const Value offset = method.addNewLocal(TYPE_INT32, "%table_offset");
+			auto it = access.start;
+			it.emplace(new Operation("sub", offset, access.addressWrite.get<MoveOperation>()->getSource(), global.createReference()));
+			it.nextInBlock();
+			const Value dest = access.end->getOutput().get();
+			//the table is never written after it is loaded, so there is no need to lock the VPM
+			removeMutex(access);
+			it = method.vpm->insertReadVPM(method, it, dest, *area, offset);
+			//remove the DMA access
+			while(it != access.end)
+				it.erase();
+			it.erase();
+		}
+		++numPreloaded;
+	}
+	DEBUG_LOG("Preloaded " << numPreloaded << " __constant tables into VPM" << logging::endl);
+}
+
+static bool isTMURegister(const Value& val, bool useTMU1)
+{
+	if(!val.hasType(ValueType::REGISTER))
+		return false;
+	if(val.reg == REG_TMU_OUT || val.reg.isSpecialFunctionsUnit())
+		return true;
+	//the registers of the selected TMU (56 - 59 for TMU0, 60 - 63 for TMU1)
+	const std::size_t firstRegister = useTMU1 ? REG_TMU1_ADDRESS.num : REG_TMU_ADDRESS.num;
+	return val.reg.file != RegisterFile::ACCUMULATOR && val.reg.num >= firstRegister && val.reg.num < firstRegister + 4;
+}
+
+/*
+ * Moves the TMU load (the load-signal and the read of r4) as far down as possible (but before the first use of the loaded value),
+ * so the instructions in between are executed while waiting for the memory-access
+ */
+static void sinkTMULoad(InstructionWalker loadSignal, bool useTMU1)
+{
+	const Value dest = loadSignal.copy().nextInBlock()->getOutput().get();
+	auto pos = loadSignal.copy().nextInBlock().nextInBlock();
+	while(!pos.isEndOfBlock())
+	{
+		if(pos.get() != nullptr)
+		{
+			if(pos.has<Branch>() || pos.has<BranchLabel>() || pos.has<MemoryBarrier>() || pos->signal != Signaling::NO_SIGNAL)
+				break;
+			if(pos->getOutput() && (pos->getOutput().get() == dest || isTMURegister(pos->getOutput().get(), useTMU1) || (dest.hasType(ValueType::LOCAL) && pos->getOutput().get().hasLocal(dest.local))))
+				break;
+			if(std::any_of(pos->getArguments().begin(), pos->getArguments().end(), [&](const Value& arg) -> bool { return isTMURegister(arg, useTMU1) || (dest.hasType(ValueType::LOCAL) && arg.hasLocal(dest.local)); }))
+				break;
 		}
-		it.nextInMethod();
+		pos.nextInBlock();
 	}
+	if(pos == loadSignal.copy().nextInBlock().nextInBlock())
+		return;
+	auto readResult = loadSignal.copy().nextInBlock();
+	pos.emplace(loadSignal.release());
+	pos.nextInBlock();
+	pos.emplace(readResult.release());
+	loadSignal.erase();
+	readResult.erase();
+}
 
-	for(const auto& pair : spillingCandidates)
+void optimizations::loadReadOnlyMemoryViaTMU(const Module& module, Method& method, const Configuration& config)
+{
+	std::vector<const Local*> candidates;
+	for(const Parameter& param : method.parameters)
+	{
+		if(!param.type.isPointerType())
+			continue;
+		if(param.type.getPointerType().get()->addressSpace == AddressSpace::CONSTANT || has_flag(param.decorations, ParameterDecorations::READ_ONLY) ||
+				has_flag(param.decorations, ParameterDecorations::RESTRICT))
+			candidates.push_back(&param);
+	}
+	for(const Global& global : module.globalData)
 	{
-		logging::debug() << "Spilling candidate: " << pair.first->to_string() << " (" << pair.first->getUsers(LocalUser::Type::WRITER).size() << " writes, " << pair.first->getUsers(LocalUser::Type::READER).size() << " reads)" << logging::endl;
+		if(global.type.isPointerType() && global.type.getPointerType().get()->addressSpace == AddressSpace::CONSTANT)
+			candidates.push_back(&global);
 	}
 
-	//TODO do not preemptively spill, only on register conflicts. Which case??
+	std::size_t numLoads = 0;
+	for(const Local* base : candidates)
+	{
+		std::vector<DMAAccess> accesses;
+		bool hasOtherUses = false;
+		if(!findMemoryAccesses(method, base, accesses, hasOtherUses, isTMUElement))
+			continue;
+		const Parameter* param = dynamic_cast<const Parameter*>(base);
+		if(param != nullptr && param->type.getPointerType().get()->addressSpace != AddressSpace::CONSTANT && !has_flag(param->decorations, ParameterDecorations::READ_ONLY))
+		{
+			//a restrict pointer can only be read via the TMU, if this kernel does not modify the memory pointed to (the TMU cache is not coherent with the VPM writes)
+			if(hasOtherUses || std::any_of(accesses.begin(), accesses.end(), [](const DMAAccess& access) -> bool { return access.isWrite; }))
+				continue;
+		}
+		for(DMAAccess& access : accesses)
+		{
+			if(access.isWrite)
+				continue;
+			DEBUG_LOG("Loading read-only memory via TMU: " << access.addressWrite->to_string() << logging::endl);
+			//alternate between the two TMUs, so two loads can be in flight at the same time
+			const bool useTMU1 = (numLoads % 2) == 1;
+			const Value dest = access.end->getOutput().get();
+			Value addr = access.addressWrite.get<MoveOperation>()->getSource();
+			//the TMU does not use the VPM, so there is no need to lock it
+			removeMutex(access);
+			auto it = access.start;
+			if(dest.type.num > 1)
+			{
+				//every SIMD element reads its own 32-bit word, the elements not used by the vector re-read the last word to not access memory out of bounds
+				const Value laneIndex = method.addNewLocal(TYPE_INT32.toVectorType(16), "%tmu_lane");
+				it.emplace(new Operation("min", laneIndex, ELEMENT_NUMBER_REGISTER, Value(Literal(static_cast<long>(dest.type.num - 1)), TYPE_INT8)));
+				it.nextInBlock();
+				const Value laneOffset = method.addNewLocal(TYPE_INT32.toVectorType(16), "%tmu_offset");
+				it.emplace(new Operation("shl", laneOffset, laneIndex, Value(Literal(2L), TYPE_INT8)));
+				it.nextInBlock();
+				const Value laneAddress = method.addNewLocal(addr.type, "%tmu_address");
+				it.emplace(new Operation("add", laneAddress, addr, laneOffset));
+				it.nextInBlock();
+				addr = laneAddress;
+			}
+			it = insertGeneralReadTMU(it, dest, addr, useTMU1);
+			//remove the DMA access
+			while(it != access.end)
+				it.erase();
+			it.erase();
+			//the load-signal and the read of the result are the last two instructions inserted
+			sinkTMULoad(it.copy().previousInBlock().previousInBlock(), useTMU1);
+			++numLoads;
+		}
+	}
+	DEBUG_LOG("Converted " << numLoads << " memory reads to TMU loads" << logging::endl);
+}
+
+static bool isVPMAccessOnly(InstructionWalker it)
+{
+	if(it.has<LoadImmediate>())
+		return it->getOutput().get().hasRegister(REG_VPM_IN_SETUP) || it->getOutput().get().hasRegister(REG_VPM_OUT_SETUP);
+	if(!it.has<MoveOperation>() || it->hasConditionalExecution())
+		return false;
+	const Value& out = it->getOutput().get();
+	const Value& src = it.get<MoveOperation>()->getSource();
+	return out.hasRegister(REG_VPM_IO) || out.hasRegister(REG_VPM_IN_ADDR) || out.hasRegister(REG_VPM_OUT_ADDR) ||
+			src.hasRegister(REG_VPM_IO) || src.hasRegister(REG_VPM_IN_WAIT) || src.hasRegister(REG_VPM_OUT_WAIT);
+}
+
+/*
+ * Returns the VPM row addressed by the given setup and the position of the row-number within the setup-value, if the setup addresses a row at all
+ */
+static Optional<std::pair<unsigned, unsigned>> getAddressedRow(const LoadImmediate* setup)
+{
+	const uint32_t value = static_cast<uint32_t>(setup->getImmediate().integer);
+	if(setup->getOutput().get().hasRegister(REG_VPM_IN_SETUP))
+	{
+		const VPRSetup vprSetup(value);
+		if(vprSetup.isGenericSetup())
+		{
+			//"ADDR[5:0] = Y[5:0]" for 32-bit, the lower 1 or 2 bits select the half-word or byte for 16- or 8-bit values (see periphery#calculateAddress)
+			const unsigned shift = 2 - std::min(2u, static_cast<unsigned>(vprSetup.genericSetup.getSize()));
+			return std::make_pair(static_cast<unsigned>(vprSetup.genericSetup.getAddress()) >> shift, shift);
+		}
+		if(vprSetup.isDMASetup())
+			//"ADDRXY[10:0] = {Y[6:0], X[3:0]}"
+			return std::make_pair(static_cast<unsigned>(vprSetup.dmaSetup.getAddress()) >> 4, 4u);
+	}
+	else
+	{
+		const VPWSetup vpwSetup(value);
+		if(vpwSetup.isGenericSetup())
+		{
+			const unsigned shift = 2 - std::min(2u, static_cast<unsigned>(vpwSetup.genericSetup.getSize()));
+			return std::make_pair(static_cast<unsigned>(vpwSetup.genericSetup.getAddress()) >> shift, shift);
+		}
+		if(vpwSetup.isDMASetup())
+			//"ADDRA[10:0] = {Y[6:0], X[3:0]}", starting at bit 3
+			return std::make_pair(static_cast<unsigned>(vpwSetup.dmaSetup.getVPMBase()) >> 4, 7u);
+	}
+	return {};
+}
+
+void optimizations::partitionVPMScratch(const Module& module, Method& method, const Configuration& config)
+{
+	if(!config.partitionVPM)
+		return;
+	const unsigned rowsPerQPU = method.vpm->partitionScratchArea(NUM_QPUS);
+	if(rowsPerQPU == 0)
+	{
+		DEBUG_LOG("Cannot partition the VPM scratch area for " << method.name << logging::endl);
+		return;
+	}
+
+	//1. remove the mutex around the accesses which only use the scratch area, e.g. no atomic operations and no accesses to __local memory in VPM
+	std::size_t numMutexRemoved = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		auto it = block.begin();
+		while(!it.isEndOfBlock())
+		{
+			if(!isRegisterRead(it, REG_MUTEX))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			auto end = it.copy().nextInBlock();
+			while(!end.isEndOfBlock() && (end.get() == nullptr || (!isMutexRelease(end) && isVPMAccessOnly(end))))
+				end.nextInBlock();
+			if(!isMutexRelease(end))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			end.erase();
+			it.erase();
+			++numMutexRemoved;
+		}
+	}
+
+	//2. offset all accesses to the scratch area by the part of the current QPU
+	const Value qpuNumber = method.addNewLocal(TYPE_INT8, "%qpu_number");
+	const Value rowOffset = method.addNewLocal(TYPE_INT32, "%vpm_qpu_row");
+	FastMap<unsigned, Value> setupOffsets;
+	auto start = method.walkAllInstructions().nextInBlock();
+	//the QPU number can only be read from register-file B and can therefore not be combined with a small immediate
+	start.emplace(new MoveOperation(qpuNumber, Value(REG_QPU_NUMBER, TYPE_INT8)));
+	start.nextInBlock();
+	start.emplace(new Operation("mul24", rowOffset, qpuNumber, Value(Literal(static_cast<long>(rowsPerQPU)), TYPE_INT8)));
+	start.nextInBlock();
+	std::size_t numSetups = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has<LoadImmediate>() || !(it->getOutput().get().hasRegister(REG_VPM_IN_SETUP) || it->getOutput().get().hasRegister(REG_VPM_OUT_SETUP)))
+				continue;
+			const auto row = getAddressedRow(it.get<LoadImmediate>());
+			if(!row || row.get().first >= rowsPerQPU)
+				continue;
+			auto offsetIt = setupOffsets.find(row.get().second);
+			if(offsetIt == setupOffsets.end())
+			{
+				const Value offset = method.addNewLocal(TYPE_INT32, "%vpm_qpu_offset");
+				start.emplace(new Operation("shl", offset, rowOffset, Value(Literal(static_cast<long>(row.get().second)), TYPE_INT8)));
+				start.nextInBlock();
+				offsetIt = setupOffsets.emplace(row.get().second, offset).first;
+			}
+			//the literal is too large to be used as operand, so it is loaded separately
+			const Value setupRegister = it->getOutput().get();
+			const Value setup = method.addNewLocal(TYPE_INT32, "%vpm_setup");
+			it.reset(new LoadImmediate(setup, it.get<LoadImmediate>()->getImmediate()));
+			it.nextInBlock();
+			it.emplace(new Operation("add", setupRegister, setup, offsetIt->second));
+			++numSetups;
+		}
+	}
+	DEBUG_LOG("Partitioned VPM scratch area with " << rowsPerQPU << " rows per QPU, removed " << numMutexRemoved << " mutex locks and updated " << numSetups << " VPM setups" << logging::endl);
+}
+
+/*
+ * The maximum number of atomic sections merged into a single mutex lock, so other QPUs are not blocked for too long
+ */
+static constexpr unsigned MAX_MERGED_ATOMIC_SECTIONS = 8;
+/*
+ * The maximum number of instructions between two atomic sections which are executed while holding the mutex after merging the sections
+ */
+static constexpr unsigned MAX_ATOMIC_SECTION_GAP = 16;
+
+/*
+ * Returns the mutex release of the section locked by the given instruction, if the section is a read-modify-write (e.g. atomic) section,
+ * otherwise the end of the block is returned
+ */
+static InstructionWalker findAtomicSectionEnd(InstructionWalker lock)
+{
+	bool modifiesValue = false;
+	auto it = lock.copy().nextInBlock();
+	while(!it.isEndOfBlock() && !isMutexRelease(it))
+	{
+		if(isRegisterRead(it, REG_MUTEX))
+			return it.getBasicBlock()->end();
+		modifiesValue = modifiesValue || (it.has() && !isVPMAccessOnly(it));
+		it.nextInBlock();
+	}
+	return modifiesValue ? it : it.getBasicBlock()->end();
+}
+
+/*
+ * Whether the instruction can be executed while holding the mutex, i.e. it does not access any periphery and cannot wait for another QPU
+ */
+static bool canExecuteWithinMutex(InstructionWalker it)
+{
+	if(!it.has())
+		return true;
+	if(it.has<MethodCall>() || it.has<SemaphoreAdjustment>() || it.has<MemoryBarrier>() || it.has<Branch>() || it.has<BranchLabel>() || it->signal != Signaling::NO_SIGNAL)
+		return false;
+	if(it->hasValueType(ValueType::REGISTER) && !it->getOutput().get().hasRegister(REG_NOP))
+		return false;
+	return std::all_of(it->getArguments().begin(), it->getArguments().end(), [](const Value& arg) -> bool
+	{
+		return !arg.hasType(ValueType::REGISTER) || arg.hasRegister(REG_UNIFORM) || arg.hasRegister(REG_ELEMENT_NUMBER) || arg.hasRegister(REG_QPU_NUMBER);
+	});
+}
+
+void optimizations::mergeAtomicSections(const Module& module, Method& method, const Configuration& config)
+{
+	std::size_t numMerged = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		auto it = block.begin();
+		while(!it.isEndOfBlock())
+		{
+			if(!isRegisterRead(it, REG_MUTEX))
+			{
+				it.nextInBlock();
+				continue;
+			}
+			auto release = findAtomicSectionEnd(it);
+			if(release.isEndOfBlock())
+			{
+				it.nextInBlock();
+				continue;
+			}
+			unsigned numSections = 1;
+			while(numSections < MAX_MERGED_ATOMIC_SECTIONS)
+			{
+				//the instructions between the sections are executed while holding the mutex, so they need to be short and must not access any periphery
+				auto nextLock = release.copy().nextInBlock();
+				unsigned gapSize = 0;
+				while(!nextLock.isEndOfBlock() && !isRegisterRead(nextLock, REG_MUTEX) && gapSize <= MAX_ATOMIC_SECTION_GAP && canExecuteWithinMutex(nextLock))
+				{
+					if(nextLock.has())
+						++gapSize;
+					nextLock.nextInBlock();
+				}
+				if(!isRegisterRead(nextLock, REG_MUTEX) || gapSize > MAX_ATOMIC_SECTION_GAP)
+					break;
+				auto nextRelease = findAtomicSectionEnd(nextLock);
+				if(nextRelease.isEndOfBlock())
+					break;
+				release.erase();
+				nextLock.erase();
+				release = nextRelease;
+				++numSections;
+				++numMerged;
+			}
+			it = release.nextInBlock();
+		}
+	}
+	DEBUG_LOG("Merged " << numMerged << " atomic sections into the preceding mutex locks" << logging::endl);
+}
+
+/*
+ * The maximum number of streams of DMA reads prefetched within a single loop, each stream occupies one VPM row per QPU
+ */
+static constexpr std::size_t MAX_PREFETCHED_STREAMS = 4;
+
+static bool isAnyElement(const Value& value)
+{
+	return true;
+}
+
+static Optional<long> getIntegerLiteral(const Value& value)
+{
+	if(value.hasType(ValueType::LITERAL))
+		return value.literal.integer;
+	if(value.hasType(ValueType::SMALL_IMMEDIATE) && value.immediate.getIntegerValue())
+		return static_cast<long>(value.immediate.getIntegerValue().get());
+	return Optional<long>(false, 0);
+}
+
+/*
+ * The single basic block of a loop
+ */
+struct LoopBody
+{
+	//the positions of the instructions within the block
+	FastMap<const IntermediateInstruction*, std::size_t> positions;
+	//the branch back to the start of the block
+	const Branch* backEdge;
+	//the last instruction setting the flags before the back-edge (if any)
+	const IntermediateInstruction* lastSetFlags;
+};
+
+/*
+ * Returns the step of the induction variable, if the instruction adds a literal to it
+ */
+static Optional<long> getLiteralStep(const IntermediateInstruction* instr, const Local* inductionVariable)
+{
+	const Operation* op = instr == nullptr || instr->kind != InstructionKind::OPERATION ? nullptr : instr->as<const Operation>();
+	if(op == nullptr || !op->getSecondArg() || op->hasPackMode() || op->hasUnpackMode())
+		return Optional<long>(false, 0);
+	const Value arg0 = op->getFirstArg();
+	const Value arg1 = op->getSecondArg();
+	if(op->opCode == "add" && arg0.hasLocal(inductionVariable) && getIntegerLiteral(arg1))
+		return getIntegerLiteral(arg1);
+	if(op->opCode == "add" && arg1.hasLocal(inductionVariable) && getIntegerLiteral(arg0))
+		return getIntegerLiteral(arg0);
+	if(op->opCode == "sub" && arg0.hasLocal(inductionVariable) && getIntegerLiteral(arg1))
+		return -getIntegerLiteral(arg1).get();
+	return Optional<long>(false, 0);
+}
+
+/*
+ * Determines the step of an induction variable (a local initialized before and updated within the loop), if it is constant
+ */
+static Optional<long> getInductionVariableStep(const Local* inductionVariable, const IntermediateInstruction* update, const LoopBody& body)
+{
+	if(update->conditional != COND_ALWAYS)
+	{
+		//copies of phi-nodes are only executed if the back-edge is taken, the flags are set just before
+		const MoveOperation* setFlags = body.lastSetFlags == nullptr || body.lastSetFlags->kind != InstructionKind::MOVE ? nullptr : body.lastSetFlags->as<const MoveOperation>();
+		if(update->conditional != body.backEdge->conditional || setFlags == nullptr || setFlags->getSource() != body.backEdge->getCondition() ||
+				body.positions.at(update) < body.positions.at(setFlags))
+			return Optional<long>(false, 0);
+	}
+	const Optional<long> step = getLiteralStep(update, inductionVariable);
+	if(step || update->kind != InstructionKind::MOVE)
+		return step;
+	//the update is the copy of the value calculated before
+	const MoveOperation* move = update->as<const MoveOperation>();
+	if(!move->getSource().hasType(ValueType::LOCAL) || move->hasPackMode() || move->hasUnpackMode())
+		return Optional<long>(false, 0);
+	const auto writers = move->getSource().local->getUsers(LocalUser::Type::WRITER);
+	const IntermediateInstruction* nextValue = writers.size() != 1 ? nullptr : dynamic_cast<const IntermediateInstruction*>(*writers.begin());
+	if(nextValue == nullptr || nextValue->conditional != COND_ALWAYS || body.positions.find(nextValue) == body.positions.end() || body.positions.at(nextValue) > body.positions.at(update))
+		return Optional<long>(false, 0);
+	return getLiteralStep(nextValue, inductionVariable);
+}
+
+/*
+ * Collects the instructions of the loop consisting of the given single block, the back-edge is not set, if the block does not jump back to its start
+ */
+static LoopBody createLoopBody(BasicBlock& block)
+{
+	LoopBody body;
+	body.backEdge = nullptr;
+	body.lastSetFlags = nullptr;
+	for(auto it = block.begin().nextInBlock(); !it.isEndOfBlock(); it.nextInBlock())
+	{
+		if(it.get() == nullptr)
+			continue;
+		body.positions.emplace(it.get(), body.positions.size());
+		if(it.has<Branch>() && it.get<Branch>()->getTarget() == block.getLabel()->getLabel())
+			body.backEdge = it.get<const Branch>();
+		else if(body.backEdge == nullptr && it->setFlags == SetFlag::SET_FLAGS)
+			body.lastSetFlags = it.get();
+	}
+	return body;
+}
+
+/*
+ * Determines by how much the value read at the given position changes from one iteration of the loop to the next, if this is constant.
+ *
+ * Supported are literals, the element and QPU numbers, locals not written within the loop, induction variables updated (after the read) by adding a literal
+ * and additions, subtractions, copies and shifts or multiplications by literals of these, calculated within the loop before the read.
+ */
+static Optional<long> getIterationStep(const Value& value, const LoopBody& body, std::size_t position)
+{
+	if(getIntegerLiteral(value) || value.hasRegister(REG_ELEMENT_NUMBER) || value.hasRegister(REG_QPU_NUMBER))
+		return 0L;
+	if(!value.hasType(ValueType::LOCAL))
+		return Optional<long>(false, 0);
+	const IntermediateInstruction* writer = nullptr;
+	bool isWrittenOutsideOfLoop = false;
+	for(const LocalUser* user : value.local->getUsers(LocalUser::Type::WRITER))
+	{
+		const IntermediateInstruction* instr = dynamic_cast<const IntermediateInstruction*>(user);
+		if(body.positions.find(instr) == body.positions.end())
+			isWrittenOutsideOfLoop = true;
+		else if(writer != nullptr)
+			//written several times within the loop
+			return Optional<long>(false, 0);
+		else
+			writer = instr;
+	}
+	if(writer == nullptr)
+		//the value does not change within the loop
+		return 0L;
+	if(writer->hasSideEffects() || writer->hasPackMode() || writer->hasUnpackMode())
+		return Optional<long>(false, 0);
+	if(isWrittenOutsideOfLoop)
+	{
+		//the induction variable needs to be updated after it is read, so the read value is the one of the current iteration
+		if(body.positions.at(writer) < position)
+			return Optional<long>(false, 0);
+		return getInductionVariableStep(value.local, writer, body);
+	}
+	//the value needs to be calculated in every iteration before it is read
+	if(writer->conditional != COND_ALWAYS || body.positions.at(writer) > position)
+		return Optional<long>(false, 0);
+	if(writer->kind == InstructionKind::MOVE)
+		return getIterationStep(writer->as<const MoveOperation>()->getSource(), body, body.positions.at(writer));
+	const Operation* op = writer->kind == InstructionKind::OPERATION ? writer->as<const Operation>() : nullptr;
+	if(op == nullptr || !op->getSecondArg())
+		return Optional<long>(false, 0);
+	const Value arg0 = op->getFirstArg();
+	const Value arg1 = op->getSecondArg();
+	const Optional<long> step0 = getIterationStep(arg0, body, body.positions.at(writer));
+	const Optional<long> step1 = getIterationStep(arg1, body, body.positions.at(writer));
+	if(!step0 || !step1)
+		return Optional<long>(false, 0);
+	if(op->opCode == "add")
+		return step0.get() + step1.get();
+	if(op->opCode == "sub")
+		return step0.get() - step1.get();
+	if(op->opCode == "shl" && getIntegerLiteral(arg1))
+		return step0.get() << getIntegerLiteral(arg1).get();
+	if(op->opCode == "mul24" && getIntegerLiteral(arg1))
+		return step0.get() * getIntegerLiteral(arg1).get();
+	if(op->opCode == "mul24" && getIntegerLiteral(arg0))
+		return step1.get() * getIntegerLiteral(arg0).get();
+	if(step0.get() == 0 && step1.get() == 0)
+		//any other calculation of values not changing within the loop
+		return 0L;
+	return Optional<long>(false, 0);
+}
+
+/*
+ * Inserts the calculation of the value read in the first iteration of the loop (as supported by #getIterationStep) into the pre-header
+ */
+static Value calculateFirstIteration(Method& method, InstructionWalker& it, const Value& value, const LoopBody& body, FastMap<const Local*, Value>& copies)
+{
+	if(!value.hasType(ValueType::LOCAL))
+		return value;
+	auto copyIt = copies.find(value.local);
+	if(copyIt != copies.end())
+		return copyIt->second;
+	const IntermediateInstruction* writer = nullptr;
+	for(const LocalUser* user : value.local->getUsers(LocalUser::Type::WRITER))
+	{
+		const IntermediateInstruction* instr = dynamic_cast<const IntermediateInstruction*>(user);
+		if(body.positions.find(instr) == body.positions.end())
+			//locals not written within the loop and induction variables already have the value of the first iteration
+			return value;
+		writer = instr;
+	}
+	if(writer == nullptr)
+		return value;
+	const Value copy = method.addNewLocal(value.type, "%prefetch");
+	if(writer->kind == InstructionKind::MOVE)
+		it.emplace(new MoveOperation(copy, calculateFirstIteration(method, it, writer->as<const MoveOperation>()->getSource(), body, copies)));
+	else
+	{
+		const Operation* op = writer->as<const Operation>();
+		const Value arg0 = calculateFirstIteration(method, it, op->getFirstArg(), body, copies);
+		const Value arg1 = calculateFirstIteration(method, it, op->getSecondArg(), body, copies);
+		it.emplace(new Operation(op->opCode, copy, arg0, arg1));
+	}
+	it.nextInBlock();
+	copies.emplace(value.local, copy);
+	return copy;
+}
+
+/*
+ * Returns the position in the pre-header of a loop before the branches to the loop
+ */
+static InstructionWalker findPreheaderEnd(BasicBlock& preheader)
+{
+	InstructionWalker it = preheader.end();
+	while(!it.copy().previousInBlock().isStartOfBlock() && it.copy().previousInBlock().has<Branch>())
+		it.previousInBlock();
+	return it;
+}
+
+/*
+ * Returns the step of an address as operand, the literal is loaded before the given position, if it is too large to be used as operand directly
+ */
+static Value loadAddressStep(Method& method, InstructionWalker& it, long step, const std::string& name)
+{
+	if(step >= -16 && step <= 15)
+		return Value(Literal(step), TYPE_INT8);
+	const Value stepValue = method.addNewLocal(TYPE_INT32, name);
+	it.emplace(new LoadImmediate(stepValue, Literal(step)));
+	it.nextInBlock();
+	return stepValue;
+}
+
+/*
+ * Returns the setup-value for the VPM DMA or generic setup accessing the given row instead of the first row of the scratch area
+ */
+static Literal toPrefetchRow(const LoadImmediate* setup, unsigned row)
+{
+	return Literal(setup->getImmediate().integer + (static_cast<long>(row) << getAddressedRow(setup).get().second));
+}
+
+/*
+ * A stream of DMA reads within a loop, e.g. a read with an address changing by a constant number of bytes in every iteration
+ */
+struct PrefetchedStream
+{
+	DMAAccess access;
+	//the difference of the addresses read in two consecutive iterations
+	long addressStep;
+};
+
+struct PrefetchedLoop
+{
+	BasicBlock* block;
+	BasicBlock* preheader;
+	LoopBody body;
+	std::vector<PrefetchedStream> streams;
+	//the writes of addresses to start DMA writes within the loop
+	std::vector<InstructionWalker> dmaWrites;
+	//the blocks executed after the loop
+	std::vector<BasicBlock*> exits;
+};
+
+/*
+ * Whether the access is a single DMA read of one row into the first row of the scratch area (as inserted by periphery#insertReadDMA)
+ */
+static bool isSingleRowRead(const DMAAccess& access)
+{
+	const LoadImmediate* dmaSetup = access.start.get<const LoadImmediate>();
+	const LoadImmediate* genericSetup = access.end.copy().previousInBlock().get<const LoadImmediate>();
+	if(access.isWrite || !access.hasMutex || dmaSetup == nullptr || genericSetup == nullptr || access.addressWrite->hasConditionalExecution())
+		return false;
+	const VPRSetup dmaValue(static_cast<uint32_t>(dmaSetup->getImmediate().integer));
+	const VPRSetup genericValue(static_cast<uint32_t>(genericSetup->getImmediate().integer));
+	if(!dmaValue.isDMASetup() || !genericValue.isGenericSetup() || dmaValue.dmaSetup.getNumberRows() != 1 || genericValue.genericSetup.getNumber() != 1)
+		return false;
+	const auto dmaRow = getAddressedRow(dmaSetup);
+	const auto genericRow = getAddressedRow(genericSetup);
+	return dmaRow && genericRow && dmaRow.get().first == 0 && genericRow.get().first == 0;
+}
+
+static InstructionWalker insertStartDMARead(InstructionWalker it, const Literal& dmaSetup, const Literal& strideSetup, const Value& address)
+{
+	it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, dmaSetup));
+	it.nextInBlock();
+	it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, strideSetup));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(VPM_IN_ADDR_REGISTER, address));
+	return it.nextInBlock();
+}
+
+void optimizations::prefetchDMAReads(const Module& module, Method& method, const Configuration& config)
+{
+	//the prefetched rows stay in the VPM while the loop runs, so they must not be overwritten by other QPUs
+	if(!config.partitionVPM)
+		return;
+
+	//1. determine the memory objects read, a read can only be prefetched, if the memory is not modified by the previous iteration
+	//maps the address writes of the reads which can be prefetched and of all writes to the memory objects accessed
+	FastMap<const IntermediateInstruction*, const Local*> prefetchableReads;
+	FastMap<const IntermediateInstruction*, const Local*> writtenObjects;
+	std::vector<const Local*> memoryObjects;
+	for(const Parameter& param : method.parameters)
+	{
+		if(param.type.isPointerType())
+			memoryObjects.push_back(&param);
+	}
+	for(const Global& global : module.globalData)
+	{
+		if(global.type.isPointerType())
+			memoryObjects.push_back(&global);
+	}
+	for(const Local* base : memoryObjects)
+	{
+		std::vector<DMAAccess> accesses;
+		bool hasOtherUses = false;
+		if(!findMemoryAccesses(method, base, accesses, hasOtherUses, isAnyElement))
+			continue;
+		for(const DMAAccess& access : accesses)
+		{
+			if(access.isWrite)
+				writtenObjects.emplace(access.addressWrite.get(), base);
+		}
+		const bool isModified = hasOtherUses || std::any_of(accesses.begin(), accesses.end(), [](const DMAAccess& access) -> bool { return access.isWrite; });
+		if(!analysis::isConstantMemory(base) && isModified)
+			continue;
+		for(const DMAAccess& access : accesses)
+		{
+			if(!access.isWrite)
+				prefetchableReads.emplace(access.addressWrite.get(), base);
+		}
+	}
+
+	//2. find the streams of reads within loops consisting of a single block
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	std::vector<PrefetchedLoop> loops;
+	std::size_t maxStreams = 0;
+	for(const analysis::Loop& loop : method.getAnalyses().getLoops().getLoops())
+	{
+		if(loop.blocks.size() != 1 || loop.preheader == nullptr)
+			continue;
+		PrefetchedLoop prefetch;
+		prefetch.block = loop.header;
+		prefetch.preheader = loop.preheader;
+		prefetch.body = createLoopBody(*loop.header);
+		bool isSupported = true;
+		for(auto it = loop.header->begin().nextInBlock(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == nullptr)
+				continue;
+			//barriers and semaphores synchronize with other QPUs, which might have modified the memory
+			isSupported = isSupported && !it.has<MemoryBarrier>() && !it.has<SemaphoreAdjustment>();
+		}
+		if(!isSupported || prefetch.body.backEdge == nullptr)
+			continue;
+		//the memory objects read, which other pointers can point to, unless they are constant
+		std::vector<const Local*> aliasedObjects;
+		for(auto it = loop.header->begin().nextInBlock(); isSupported && !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(!it.has<MoveOperation>() || !it->hasValueType(ValueType::REGISTER))
+				continue;
+			if(it->getOutput().get().hasRegister(REG_VPM_OUT_ADDR))
+				prefetch.dmaWrites.push_back(it);
+			if(!it->getOutput().get().hasRegister(REG_VPM_IN_ADDR))
+				continue;
+			//any other DMA read would have to wait for the prefetched reads
+			const Optional<DMAAccess> access = checkDMAAccess(it, isAnyElement);
+			const auto readIt = prefetchableReads.find(it.get());
+			const Optional<long> step = getIterationStep(it.get<MoveOperation>()->getSource(), prefetch.body, prefetch.body.positions.at(it.get()));
+			if(!access || !isSingleRowRead(access.get()) || readIt == prefetchableReads.end() || !step)
+			{
+				isSupported = false;
+				continue;
+			}
+			if(!analysis::isConstantMemory(readIt->second))
+				aliasedObjects.push_back(readIt->second);
+			prefetch.streams.push_back(PrefetchedStream{access.get(), step.get()});
+		}
+		//the memory written in the loop must not be read in a following iteration, writes to unknown memory objects can modify any memory
+		const bool isOverwritten = std::any_of(prefetch.dmaWrites.begin(), prefetch.dmaWrites.end(), [&](InstructionWalker write) -> bool
+		{
+			const auto writeIt = writtenObjects.find(write.get());
+			return std::any_of(aliasedObjects.begin(), aliasedObjects.end(), [&](const Local* base) -> bool
+			{
+				return writeIt == writtenObjects.end() || analysis::mayAliasBases(base, writeIt->second);
+			});
+		});
+		if(!isSupported || prefetch.streams.empty() || prefetch.streams.size() > MAX_PREFETCHED_STREAMS || isOverwritten)
+		{
+			DEBUG_LOG("Skipping prefetching of DMA reads in loop: " << loop.header->getLabel()->to_string() << logging::endl);
+			continue;
+		}
+		for(BasicBlock* successor : cfg.getSuccessors(*loop.header))
+		{
+			if(successor != loop.header)
+				prefetch.exits.push_back(successor);
+		}
+		maxStreams = std::max(maxStreams, prefetch.streams.size());
+		loops.push_back(std::move(prefetch));
+	}
+	if(loops.empty())
+		return;
+
+	//3. reserve one row per stream for every QPU, the loops are executed after each other and can therefore use the same rows
+	const unsigned firstRow = (method.vpm->getScratchArea().size + VPM_ROW_SIZE - 1) / VPM_ROW_SIZE;
+	if(method.vpm->partitionScratchArea(NUM_QPUS, static_cast<unsigned>(maxStreams)) != firstRow + maxStreams)
+	{
+		DEBUG_LOG("Not enough VPM space left to prefetch DMA reads for " << method.name << logging::endl);
+		return;
+	}
+
+	//4. read the rows for the first iteration before the loop and the rows for the next iteration right after the rows of the current iteration are read
+	std::size_t numStreams = 0;
+	for(PrefetchedLoop& loop : loops)
+	{
+		DEBUG_LOG("Prefetching " << loop.streams.size() << " DMA reads in loop: " << loop.block->getLabel()->to_string() << logging::endl);
+		InstructionWalker preheaderIt = findPreheaderEnd(*loop.preheader);
+		//4.1 start the reads of the first iteration, only one DMA read can be active at any time
+		FastMap<const Local*, Value> copies;
+		std::vector<Value> steps;
+		for(std::size_t i = 0; i < loop.streams.size(); ++i)
+		{
+			const DMAAccess& access = loop.streams[i].access;
+			const unsigned row = firstRow + static_cast<unsigned>(i);
+			const Value firstAddress = calculateFirstIteration(method, preheaderIt, access.addressWrite.get<MoveOperation>()->getSource(), loop.body, copies);
+			if(i > 0)
+			{
+				preheaderIt.emplace(new MoveOperation(NOP_REGISTER, VPM_IN_WAIT_REGISTER));
+				preheaderIt.nextInBlock();
+			}
+			preheaderIt = insertStartDMARead(preheaderIt, toPrefetchRow(access.start.get<LoadImmediate>(), row), access.start.copy().nextInBlock().get<LoadImmediate>()->getImmediate(), firstAddress);
+			steps.push_back(loadAddressStep(method, preheaderIt, loop.streams[i].addressStep, "%prefetch_step"));
+		}
+		//4.2 wait for the row of the current iteration to be read and start reading the row of the next iteration
+		for(std::size_t i = 0; i < loop.streams.size(); ++i)
+		{
+			DMAAccess& access = loop.streams[i].access;
+			const unsigned row = firstRow + static_cast<unsigned>(i);
+			const Literal dmaSetup = toPrefetchRow(access.start.get<LoadImmediate>(), row);
+			const Literal strideSetup = access.start.copy().nextInBlock().get<LoadImmediate>()->getImmediate();
+			const Literal genericSetup = toPrefetchRow(access.end.copy().previousInBlock().get<LoadImmediate>(), row);
+			const Value address = access.addressWrite.get<MoveOperation>()->getSource();
+			const Value dest = access.end->getOutput().get();
+			//the row is only accessed by this QPU, so there is no need to lock the VPM
+			removeMutex(access);
+			auto it = access.start;
+			while(it != access.end)
+				it.erase();
+			it.erase();
+			it.emplace(new MoveOperation(NOP_REGISTER, VPM_IN_WAIT_REGISTER));
+			it.nextInBlock();
+			it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, genericSetup));
+			it.nextInBlock();
+			it.emplace(new MoveOperation(dest, VPM_IO_REGISTER));
+			it.nextInBlock();
+			const Value nextAddress = method.addNewLocal(address.type, "%prefetch_address");
+			it.emplace(new Operation("add", nextAddress, address, steps.at(i)));
+			it.nextInBlock();
+			insertStartDMARead(it, dmaSetup, strideSetup, nextAddress);
+			++numStreams;
+		}
+		//4.3 a DMA write can only be started after the active DMA read is finished
+		for(InstructionWalker& it : loop.dmaWrites)
+			it.emplace(new MoveOperation(NOP_REGISTER, VPM_IN_WAIT_REGISTER));
+		//4.4 the last iteration reads the rows after the last accessed ones, which needs to finish before any other DMA access
+		for(BasicBlock* exit : loop.exits)
+			exit->begin().nextInBlock().emplace(new MoveOperation(NOP_REGISTER, VPM_IN_WAIT_REGISTER));
+	}
+	DEBUG_LOG("Prefetching " << numStreams << " streams of DMA reads in " << loops.size() << " loops" << logging::endl);
+}
+
+/*
+ * The maximum number of loads pipelined per TMU within a single loop, each of them keeps one request in the FIFO of the TMU across the back-edge
+ */
+static constexpr std::size_t MAX_PIPELINED_TMU_LOADS = 4;
+
+/*
+ * A general-memory lookup via the TMU within a loop (as inserted by periphery#insertGeneralReadTMU)
+ */
+struct PipelinedTMULoad
+{
+	//the write of the address to the TMU register
+	InstructionWalker addressWrite;
+	//the read of the loaded value from r4, following the load-signal
+	InstructionWalker resultRead;
+	//the difference of the addresses read in two consecutive iterations
+	long addressStep;
+};
+
+static bool isTMURequest(InstructionWalker it)
+{
+	if(!it->hasValueType(ValueType::REGISTER))
+		return false;
+	const Register& reg = it->getOutput().get().reg;
+	return reg.file != RegisterFile::ACCUMULATOR && reg.num >= REG_TMU_ADDRESS.num && reg.num < REG_TMU1_ADDRESS.num + 4;
+}
+
+void optimizations::pipelineTMULoads(const Module& module, Method& method, const Configuration& config)
+{
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	std::size_t numLoads = 0;
+	std::size_t numLoops = 0;
+	for(const analysis::Loop& loop : method.getAnalyses().getLoops().getLoops())
+	{
+		if(loop.blocks.size() != 1 || loop.preheader == nullptr)
+			continue;
+		const LoopBody body = createLoopBody(*loop.header);
+		if(body.backEdge == nullptr)
+			continue;
+		//1. find the TMU loads, the results are returned by the TMUs in the order of the requests
+		std::vector<PipelinedTMULoad> loads;
+		std::array<std::deque<std::size_t>, 2> pendingRequests;
+		std::array<std::size_t, 2> numLoadsPerTMU{{0, 0}};
+		bool isSupported = true;
+		for(auto it = loop.header->begin().nextInBlock(); isSupported && !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == nullptr)
+				continue;
+			if(it.has<MethodCall>())
+				isSupported = false;
+			else if(it->signal == Signaling::LOAD_TMU0 || it->signal == Signaling::LOAD_TMU1)
+			{
+				auto& pending = pendingRequests[it->signal == Signaling::LOAD_TMU0 ? 0 : 1];
+				auto resultRead = it.copy().nextInBlock();
+				//the load of a request issued before the loop or the result not directly read
+				if(pending.empty() || resultRead.isEndOfBlock() || !resultRead.has<MoveOperation>() || !resultRead.get<MoveOperation>()->getSource().hasRegister(REG_TMU_OUT))
+					isSupported = false;
+				else
+				{
+					loads.at(pending.front()).resultRead = resultRead;
+					pending.pop_front();
+				}
+			}
+			else if(isTMURequest(it))
+			{
+				//only general-memory lookups can be pipelined, not image reads setting several coordinates
+				const Register& reg = it->getOutput().get().reg;
+				const Optional<long> step = !it.has<MoveOperation>() ? Optional<long>(false, 0) : getIterationStep(it.get<MoveOperation>()->getSource(), body, body.positions.at(it.get()));
+				if((reg.num != REG_TMU_ADDRESS.num && reg.num != REG_TMU1_ADDRESS.num) || !step || it->hasConditionalExecution() || it->hasPackMode() || it->signal != Signaling::NO_SIGNAL)
+					isSupported = false;
+				else
+				{
+					const std::size_t tmu = reg.num == REG_TMU_ADDRESS.num ? 0 : 1;
+					pendingRequests[tmu].push_back(loads.size());
+					++numLoadsPerTMU[tmu];
+					loads.push_back(PipelinedTMULoad{it, it, step.get()});
+				}
+			}
+		}
+		isSupported = isSupported && !loads.empty() && pendingRequests[0].empty() && pendingRequests[1].empty() &&
+				numLoadsPerTMU[0] <= MAX_PIPELINED_TMU_LOADS && numLoadsPerTMU[1] <= MAX_PIPELINED_TMU_LOADS;
+		//the requests of the iteration after the last one need to be loaded when leaving the loop, which is only possible, if the exits are not reached otherwise
+		std::vector<BasicBlock*> exits;
+		for(BasicBlock* successor : cfg.getSuccessors(*loop.header))
+		{
+			if(successor != loop.header)
+				exits.push_back(successor);
+			if(successor != loop.header && cfg.getPredecessors(*successor).size() != 1)
+				isSupported = false;
+		}
+		if(!isSupported)
+		{
+			DEBUG_LOG("Skipping pipelining of TMU loads in loop: " << loop.header->getLabel()->to_string() << logging::endl);
+			continue;
+		}
+
+		//2. request the addresses of the first iteration before the loop and request the addresses of the next iteration right after the values of the current iteration are loaded
+		DEBUG_LOG("Pipelining " << loads.size() << " TMU loads in loop: " << loop.header->getLabel()->to_string() << logging::endl);
+		InstructionWalker preheaderIt = findPreheaderEnd(*loop.preheader);
+		FastMap<const Local*, Value> copies;
+		for(PipelinedTMULoad& load : loads)
+		{
+			const Value tmuRegister = load.addressWrite->getOutput().get();
+			const Value address = load.addressWrite.get<MoveOperation>()->getSource();
+			preheaderIt.emplace(new MoveOperation(tmuRegister, calculateFirstIteration(method, preheaderIt, address, body, copies)));
+			preheaderIt.nextInBlock();
+			Value nextAddress = address;
+			if(load.addressStep != 0)
+			{
+				//the next address is calculated where the current one is requested, since the values it is calculated from might be modified before the load
+				const Value step = loadAddressStep(method, preheaderIt, load.addressStep, "%tmu_step");
+				nextAddress = method.addNewLocal(address.type, "%tmu_next_address");
+				load.addressWrite.reset(new Operation("add", nextAddress, address, step));
+			}
+			else
+				load.addressWrite.erase();
+			load.resultRead.copy().nextInBlock().emplace(new MoveOperation(tmuRegister, nextAddress));
+			++numLoads;
+		}
+		//3. the values requested for the iteration after the last one are loaded and discarded when leaving the loop
+		for(BasicBlock* exit : exits)
+		{
+			for(std::size_t tmu = 0; tmu < numLoadsPerTMU.size(); ++tmu)
+			{
+				for(std::size_t i = 0; i < numLoadsPerTMU[tmu]; ++i)
+				{
+					auto it = exit->begin().nextInBlock();
+					it.emplace(new Nop(DelayType::WAIT_TMU));
+					it->setSignaling(tmu == 0 ? Signaling::LOAD_TMU0 : Signaling::LOAD_TMU1);
+				}
+			}
+		}
+		++numLoops;
+	}
+	DEBUG_LOG("Pipelined " << numLoads << " TMU loads in " << numLoops << " loops" << logging::endl);
+}
+
+/*
+ * Determines the base and the constant byte offset of the address. Bases which are themselves derived from another base with a constant offset
+ * (e.g. the address of a global, which is an offset into the global data segment) are followed up to the base they are derived from.
+ */
+static Optional<MemoryLocation> findMemoryLocation(const Value& address, const DataType& accessType)
+{
+	BaseAndOffset baseAndOffset = findBaseAndOffset(address);
+	if(!baseAndOffset.base || !baseAndOffset.offset || !baseAndOffset.base.get().hasType(ValueType::LOCAL))
+		return {};
+	MemoryLocation location{baseAndOffset.base.get().local, baseAndOffset.offset.get() * static_cast<long>(address.type.getElementType().getPhysicalWidth()), accessType.getPhysicalWidth()};
+	while(!location.base->is<Parameter>() && !analysis::isGlobalData(location.base))
+	{
+		const Value base = location.base->createReference();
+		baseAndOffset = findBaseAndOffset(base);
+		if(!baseAndOffset.base || !baseAndOffset.offset || !baseAndOffset.base.get().hasType(ValueType::LOCAL) || baseAndOffset.base.get().local == location.base)
+			break;
+		location.offset += baseAndOffset.offset.get() * static_cast<long>(base.type.getElementType().getPhysicalWidth());
+		location.base = baseAndOffset.base.get().local;
+	}
+	return location;
+}
+
+/*
+ * A value known to be stored in memory at the given location, either written to or read from it
+ */
+struct KnownMemoryValue
+{
+	MemoryLocation location;
+	Value value;
+	//whether the value was read from memory (or written into it)
+	bool isRead;
+};
+
+static bool isForwardableElement(const Value& value)
+{
+	return !value.type.getArrayType().hasValue && (value.type.complexType == nullptr || value.type.isPointerType());
+}
+
+static void removeKnownValues(std::vector<KnownMemoryValue>& knownValues, const std::function<bool(const KnownMemoryValue&)>& predicate)
+{
+	knownValues.erase(std::remove_if(knownValues.begin(), knownValues.end(), predicate), knownValues.end());
+}
+
+/*
+ * Replaces the DMA read with a move of the value already known to be stored at the accessed location
+ */
+static InstructionWalker replaceDMARead(DMAAccess& access, const Value& knownValue)
+{
+	const Value dest = access.end->getOutput().get();
+	//remove the mutex acquire, all setups, the address write and the DMA wait
+	auto it = access.start.copy().previousInBlock();
+	while(it != access.end)
+		it.erase();
+	//remove the mutex release
+	access.end.copy().nextInBlock().erase();
+	access.end.reset(new MoveOperation(dest, knownValue));
+	return access.end;
+}
+
+/*
+ * Whether the address can point to volatile memory, i.e. it is calculated from a volatile parameter (or its calculation is too complex to be followed)
+ */
+static bool isAddressOfVolatileMemory(const Value& address, FastSet<const Local*>& visitedLocals)
+{
+	if(!address.hasType(ValueType::LOCAL) || !visitedLocals.emplace(address.local).second)
+		return false;
+	if(address.local->is<Parameter>())
+		return analysis::isVolatileMemory(address.local);
+	if(visitedLocals.size() > 64)
+		return true;
+	for(const LocalUser* writer : address.local->getUsers(LocalUser::Type::WRITER))
+	{
+		for(const Value& arg : dynamic_cast<const IntermediateInstruction*>(writer)->getArguments())
+		{
+			if(isAddressOfVolatileMemory(arg, visitedLocals))
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * The location accessed via the address, if the address has no known base and constant offset (e.g. an element indexed by the work-item id).
+ *
+ * The location is identified by the local of the address itself, which is not modified after it was calculated, following copies of other such locals.
+ * Thus, only accesses with the same address value (e.g. the same index calculated once and shared by the common sub-expression elimination) are known to access the same memory.
+ */
+static Optional<MemoryLocation> findAddressLocation(const Value& address, const DataType& accessType)
+{
+	if(!address.hasType(ValueType::LOCAL) || address.local->getUsers().getNumWriters() > 1)
+		return {};
+	const Local* local = address.local;
+	const MoveOperation* copy = dynamic_cast<const MoveOperation*>(local->getSingleWriter());
+	while(copy != nullptr && !copy->is<VectorRotation>() && copy->getSource().hasType(ValueType::LOCAL) && copy->getSource().local->getUsers().getNumWriters() <= 1 &&
+			!copy->hasConditionalExecution() && !copy->hasPackMode() && !copy->hasUnpackMode())
+	{
+		local = copy->getSource().local;
+		copy = dynamic_cast<const MoveOperation*>(local->getSingleWriter());
+	}
+	FastSet<const Local*> visitedLocals;
+	if(isAddressOfVolatileMemory(local->createReference(), visitedLocals))
+		return {};
+	return MemoryLocation{local, 0, accessType.getPhysicalWidth()};
+}
+
+/*
+ * Forwards the known values within the block, updating the values known at the end of the block
+ */
+static void forwardMemoryAccesses(BasicBlock& block, std::vector<KnownMemoryValue>& knownValues, std::size_t& numForwarded, std::size_t& numDuplicates)
+{
+	//1. find all DMA accesses of single values (each guarded by its own mutex) within this block
+	FastMap<const IntermediateInstruction*, DMAAccess> accesses;
+	FastSet<const IntermediateInstruction*> accessInstructions;
+	for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+	{
+		if(it.get() == nullptr || !it.has<MoveOperation>() || !it->hasValueType(ValueType::REGISTER) || !(it->getOutput().get().hasRegister(REG_VPM_IN_ADDR) || it->getOutput().get().hasRegister(REG_VPM_OUT_ADDR)))
+			continue;
+		Optional<DMAAccess> access = checkDMAAccess(it, isForwardableElement);
+		if(!access || !access.get().hasMutex)
+			continue;
+		bool isConditional = false;
+		for(auto pos = access.get().start.copy().previousInBlock(); pos != access.get().end.copy().nextInBlock().nextInBlock(); pos.nextInBlock())
+		{
+			isConditional = isConditional || pos->hasConditionalExecution();
+			accessInstructions.emplace(pos.get());
+		}
+		if(isConditional)
+		{
+			for(auto pos = access.get().start.copy().previousInBlock(); pos != access.get().end.copy().nextInBlock().nextInBlock(); pos.nextInBlock())
+				accessInstructions.erase(pos.get());
+			continue;
+		}
+		accesses.emplace(it.get(), access.get());
+	}
+
+	//2. track the values known to be stored in memory along the block
+	auto it = block.begin();
+	while(!it.isEndOfBlock())
+	{
+		if(it.get() == nullptr)
+		{
+			it.nextInBlock();
+			continue;
+		}
+		auto accessIt = accesses.find(it.get());
+		if(accessIt != accesses.end())
+		{
+			DMAAccess& access = accessIt->second;
+			const Value address = it.get<MoveOperation>()->getSource();
+			const Value data = access.isWrite ? access.start.copy().nextInBlock().get<MoveOperation>()->getSource() : access.end->getOutput().get();
+			Optional<MemoryLocation> location = findMemoryLocation(address, data.type);
+			if(!location)
+				location = findAddressLocation(address, data.type);
+			if(!location)
+			{
+				//the accessed memory is unknown, so a write can modify any memory location
+				if(access.isWrite)
+					knownValues.clear();
+			}
+			else if(access.isWrite)
+			{
+				removeKnownValues(knownValues, [&](const KnownMemoryValue& known) -> bool { return analysis::mayAlias(known.location, location.get()); });
+				//for smaller types, the upper bits of the written register are not necessarily zero, so only 32-bit values can be forwarded
+				if(!analysis::isVolatileMemory(location.get().base) && data.hasType(ValueType::LOCAL) && data.type.getScalarBitCount() == 32)
+					knownValues.push_back(KnownMemoryValue{location.get(), data, false});
+			}
+			else if(!analysis::isVolatileMemory(location.get().base))
+			{
+				auto known = std::find_if(knownValues.begin(), knownValues.end(), [&](const KnownMemoryValue& known) -> bool
+				{
+					return known.location.base == location.get().base && known.location.offset == location.get().offset && known.location.size == location.get().size &&
+							known.value.type.getScalarBitCount() == data.type.getScalarBitCount() && known.value.type.getVectorWidth() == data.type.getVectorWidth();
+				});
+				if(known != knownValues.end())
+				{
+					DEBUG_LOG("Replacing DMA read of " << data.to_string() << " with already known value " << known->value.to_string() << logging::endl);
+					++(known->isRead ? numDuplicates : numForwarded);
+					it = replaceDMARead(access, known->value);
+				}
+				else
+				{
+					removeKnownValues(knownValues, [&](const KnownMemoryValue& known) -> bool { return known.value.local == data.local || known.location.base == data.local; });
+					knownValues.push_back(KnownMemoryValue{location.get(), data, true});
+				}
+			}
+			it.nextInBlock();
+			continue;
+		}
+		if(accessInstructions.find(it.get()) != accessInstructions.end())
+		{
+			//the other instructions of the accesses are handled together with the address write
+			it.nextInBlock();
+			continue;
+		}
+		//barriers, semaphores, method calls, other mutex regions (e.g. atomic operations) and DMA accesses not handled here can modify any memory
+		if(it.has<MemoryBarrier>() || it.has<SemaphoreAdjustment>() || it.has<MethodCall>() || isRegisterRead(it, REG_MUTEX) ||
+				(it->hasValueType(ValueType::REGISTER) && (it->getOutput().get().hasRegister(REG_VPM_IN_ADDR) || it->getOutput().get().hasRegister(REG_VPM_OUT_ADDR))))
+			knownValues.clear();
+		//values, addresses and bases which are overwritten are not known anymore
+		if(it->hasValueType(ValueType::LOCAL))
+		{
+			const Local* local = it->getOutput().get().local;
+			removeKnownValues(knownValues, [local](const KnownMemoryValue& known) -> bool { return known.value.local == local || known.location.base == local; });
+		}
+		it.nextInBlock();
+	}
+}
+
+void optimizations::forwardMemoryAccesses(const Module& module, Method& method, const Configuration& config)
+{
+	std::size_t numForwarded = 0;
+	std::size_t numDuplicates = 0;
+	//the values are known along the chains of blocks executed after each other, e.g. the bodies of inlined functions
+	LinearSuccessors successors;
+	const FastSet<const BasicBlock*> chainedBlocks = findLinearSuccessors(method, successors);
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		if(chainedBlocks.find(&block) != chainedBlocks.end())
+			//is handled as part of the chain starting at its predecessor
+			continue;
+		std::vector<KnownMemoryValue> knownValues;
+		BasicBlock* current = &block;
+		while(current != nullptr)
+		{
+			forwardMemoryAccesses(*current, knownValues, numForwarded, numDuplicates);
+			auto next = successors.find(current);
+			current = next != successors.end() ? next->second : nullptr;
+		}
+	}
+	DEBUG_LOG("Forwarded " << numForwarded << " stored values to DMA reads and removed " << numDuplicates << " duplicate DMA reads" << logging::endl);
+}
+
+static bool isVectorizableElement(const Value& value)
+{
+	return value.type.num == 1 && value.type.getScalarBitCount() == 32 && value.type.complexType == nullptr;
+}
+
+/*
+ * A DMA access of a single scalar value at a known location, which can be combined with the accesses of the neighboring locations
+ */
+struct ScalarMemoryAccess
+{
+	DMAAccess access;
+	MemoryLocation location;
+	Value address;
+	Value data;
+	//the position of the address write within the basic block
+	std::size_t position;
+};
+
+/*
+ * The memory covered by all accesses of the group
+ */
+static MemoryLocation getGroupLocation(const std::vector<ScalarMemoryAccess>& group)
+{
+	return MemoryLocation{group.front().location.base, group.front().location.offset, group.front().location.size * static_cast<unsigned>(group.size())};
+}
+
+static bool isNextInGroup(const std::vector<ScalarMemoryAccess>& group, const ScalarMemoryAccess& access)
+{
+	if(group.empty() || group.size() >= NATIVE_VECTOR_SIZE)
+		return false;
+	const MemoryLocation location = getGroupLocation(group);
+	return access.location.base == location.base && access.location.offset == location.offset + static_cast<long>(location.size) &&
+			access.data.type == group.front().data.type;
+}
+
+/*
+ * Removes the DMA access including the mutex acquire and release, returns the position after the removed instructions
+ */
+static InstructionWalker eraseDMAAccess(DMAAccess& access)
+{
+	auto it = access.start.copy().previousInBlock();
+	const auto end = access.end.copy().nextInBlock().nextInBlock();
+	while(it != end)
+		it.erase();
+	return it;
+}
+
+/*
+ * Replaces the DMA reads of the consecutive elements with a single DMA read of a vector at the position of the first read,
+ * from which every read element is extracted at the position of its original read
+ */
+static void combineDMAReads(Method& method, std::vector<ScalarMemoryAccess>& accesses)
+{
+	const Value vector = method.addNewLocal(accesses.front().data.type.toVectorType(static_cast<unsigned char>(accesses.size())), "%vectorized_load");
+	//the address of the first element is already calculated before the mutex is acquired
+	periphery::insertReadDMA(method, accesses.front().access.start.copy().previousInBlock(), vector, accesses.front().address);
+	for(std::size_t i = 0; i < accesses.size(); ++i)
+	{
+		InstructionWalker it = replaceDMARead(accesses[i].access, vector);
+		const Value dest = it->getOutput().get();
+		it.erase();
+		intermediate::insertVectorExtraction(it, method, vector, Value(Literal(static_cast<long>(i)), TYPE_INT8), dest);
+	}
+}
+
+/*
+ * Replaces the DMA writes of the consecutive elements with a single DMA write of a vector at the position of the last write.
+ * The written values are inserted into the vector at the positions of their original writes
+ */
+static void combineDMAWrites(Method& method, std::vector<ScalarMemoryAccess>& accesses)
+{
+	const Value vector = method.addNewLocal(accesses.front().data.type.toVectorType(static_cast<unsigned char>(accesses.size())), "%vectorized_store");
+	for(std::size_t i = 0; i < accesses.size(); ++i)
+	{
+		InstructionWalker it = eraseDMAAccess(accesses[i].access);
+		if(i == 0)
+		{
+			it.emplace(new MoveOperation(vector, accesses[i].data));
+			it.nextInBlock();
+		}
+		else
+			it = intermediate::insertVectorInsertion(it, method, vector, Value(Literal(static_cast<long>(i)), TYPE_INT8), accesses[i].data);
+		if(i + 1 == accesses.size())
+			periphery::insertWriteDMA(method, it, vector, accesses.front().address);
+	}
+}
+
+void optimizations::vectorizeMemoryAccesses(const Module& module, Method& method, const Configuration& config)
+{
+	std::size_t numReads = 0;
+	std::size_t numWrites = 0;
+	const analysis::FlagsAnalysis* flags = nullptr;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		//1. find all DMA accesses of single 32-bit values (each guarded by its own mutex) at known, not volatile locations within this block
+		FastMap<const IntermediateInstruction*, ScalarMemoryAccess> accesses;
+		FastSet<const IntermediateInstruction*> accessInstructions;
+		//the position of the last instruction reading the flags, the flags set for the inserted vector elements must not overwrite them
+		Optional<std::size_t> lastFlagsRead;
+		std::size_t position = 0;
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock(), ++position)
+		{
+			if(it.get() == nullptr)
+				continue;
+			if(it->hasConditionalExecution())
+				lastFlagsRead = position;
+			if(!it.has<MoveOperation>() || !it->hasValueType(ValueType::REGISTER) || !(it->getOutput().get().hasRegister(REG_VPM_IN_ADDR) || it->getOutput().get().hasRegister(REG_VPM_OUT_ADDR)))
+				continue;
+			Optional<DMAAccess> access = checkDMAAccess(it, isVectorizableElement);
+			if(!access || !access.get().hasMutex)
+				continue;
+			bool isConditional = false;
+			for(auto pos = access.get().start.copy().previousInBlock(); pos != access.get().end.copy().nextInBlock().nextInBlock(); pos.nextInBlock())
+				isConditional = isConditional || pos->hasConditionalExecution();
+			const Value address = it.get<MoveOperation>()->getSource();
+			const Value data = access.get().isWrite ? access.get().start.copy().nextInBlock().get<MoveOperation>()->getSource() : access.get().end->getOutput().get();
+			const Optional<MemoryLocation> location = findMemoryLocation(address, data.type);
+			//the combined write is done at the position of the last write, so the address of the first write must not change in between
+			if(isConditional || !location || analysis::isVolatileMemory(location.get().base) || (address.hasType(ValueType::LOCAL) && address.local->getUsers(LocalUser::Type::WRITER).size() > 1))
+				continue;
+			for(auto pos = access.get().start.copy().previousInBlock(); pos != access.get().end.copy().nextInBlock().nextInBlock(); pos.nextInBlock())
+				accessInstructions.emplace(pos.get());
+			accesses.emplace(it.get(), ScalarMemoryAccess{access.get(), location.get(), address, data, position});
+		}
+		if(accesses.size() < 2)
+			continue;
+
+		//2. group the accesses of consecutive elements, as long as no other memory access in between may access the same memory
+		std::vector<std::vector<ScalarMemoryAccess>> groups;
+		std::vector<ScalarMemoryAccess> readGroup;
+		std::vector<ScalarMemoryAccess> writeGroup;
+		const auto finishGroup = [&groups](std::vector<ScalarMemoryAccess>& group) -> void
+		{
+			if(group.size() > 1)
+				groups.push_back(group);
+			group.clear();
+		};
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() == nullptr)
+				continue;
+			auto accessIt = accesses.find(it.get());
+			if(accessIt != accesses.end())
+			{
+				const ScalarMemoryAccess& access = accessIt->second;
+				std::vector<ScalarMemoryAccess>& sameGroup = access.access.isWrite ? writeGroup : readGroup;
+				std::vector<ScalarMemoryAccess>& otherGroup = access.access.isWrite ? readGroup : writeGroup;
+				//reading the memory written by the combined write (which is moved down) or writing the memory read by the combined read (which is moved up)
+				if(!otherGroup.empty() && analysis::mayAlias(getGroupLocation(otherGroup), access.location))
+					finishGroup(otherGroup);
+				if(!isNextInGroup(sameGroup, access))
+					finishGroup(sameGroup);
+				sameGroup.push_back(access);
+				continue;
+			}
+			if(accessInstructions.find(it.get()) != accessInstructions.end())
+				continue;
+			//barriers, semaphores, method calls, other mutex regions (e.g. atomic operations) and DMA accesses not handled here can access any memory
+			if(it.has<MemoryBarrier>() || it.has<SemaphoreAdjustment>() || it.has<MethodCall>() || isRegisterRead(it, REG_MUTEX) ||
+					(it->hasValueType(ValueType::REGISTER) && (it->getOutput().get().hasRegister(REG_VPM_IN_ADDR) || it->getOutput().get().hasRegister(REG_VPM_OUT_ADDR))))
+			{
+				finishGroup(readGroup);
+				finishGroup(writeGroup);
+			}
+			//the address of the combined write is read at the position of the last write
+			if(!writeGroup.empty() && it->hasValueType(ValueType::LOCAL) && writeGroup.front().address.hasLocal(it->getOutput().get().local))
+				finishGroup(writeGroup);
+		}
+		finishGroup(readGroup);
+		finishGroup(writeGroup);
+
+		//3. combine the accesses of every group into accesses of vectors
+		for(std::vector<ScalarMemoryAccess>& group : groups)
+		{
+			if(group.front().access.isWrite)
+			{
+				//inserting the elements into the vector sets the flags
+				if(lastFlagsRead && lastFlagsRead.get() > group.front().position)
+					continue;
+				if(flags == nullptr)
+					flags = &method.getAnalyses().getFlags();
+				if(flags->areFlagsLiveAfter(block))
+					continue;
+			}
+			//a group has at most 16 elements (see isNextInGroup), which are accessed as a single vector of any width:
+			//the row length of the DMA access masks the transfer to the elements of the vector (see VPM#insertReadRAM and VPM#insertWriteRAM),
+			//so the remaining elements (e.g. 7 = 4 + 3 or 13 = 8 + 4 + 1) do not need to be split into several accesses or left as scalar accesses
+			DEBUG_LOG("Combining " << group.size() << " DMA " << (group.front().access.isWrite ? "writes" : "reads") << " of consecutive elements starting at: " << group.front().address.to_string() << logging::endl);
+			if(group.front().access.isWrite)
+			{
+				combineDMAWrites(method, group);
+				numWrites += group.size();
+			}
+			else
+			{
+				combineDMAReads(method, group);
+				numReads += group.size();
+			}
+		}
+	}
+	DEBUG_LOG("Combined " << numReads << " DMA reads and " << numWrites << " DMA writes of consecutive elements into vector accesses" << logging::endl);
+}
+
+//the maximum number of elements of a __private array to be promoted to one local per element
+static constexpr unsigned MAX_PROMOTED_ELEMENTS = 16;
+
+static Value getInitialElement(const Global& global, const DataType& elementType, const unsigned index)
+{
+	const Value& value = global.value;
+	if(value.hasType(ValueType::CONTAINER) && index < value.container.elements.size() && value.container.elements.at(index).hasType(ValueType::LITERAL))
+		return Value(value.container.elements.at(index).literal, elementType);
+	if(value.hasType(ValueType::LITERAL))
+		return Value(value.literal, elementType);
+	//undefined or zero-initialized memory
+	return Value(INT_ZERO.literal, elementType);
+}
+
+/*
+ * Replaces the DMA access with direct reads and writes of the value, inserted by the given function at the position of the access
+ */
+static void replaceDMAAccess(DMAAccess& access, const std::function<InstructionWalker(InstructionWalker it, const Value& address, const Value& value)>& replacement)
+{
+	const Value address = access.addressWrite.get<MoveOperation>()->getSource();
+	const Value value = access.isWrite ? access.start.copy().nextInBlock().get<MoveOperation>()->getSource() : access.end->getOutput().get();
+	//the memory is only accessed by the executing QPU, so there is no need to lock the VPM
+	removeMutex(access);
+	auto it = replacement(access.start, address, value);
+	while(it != access.end)
+		it.erase();
+	it.erase();
+}
+
+/*
+ * The blocks in which the memory object might hold a value still to be read, i.e. the blocks reachable from any access which can also reach any access.
+ * Objects whose live blocks do not overlap are never live at the same time and can therefore share the same memory
+ */
+static FastSet<const BasicBlock*> getLiveBlocks(const analysis::ControlFlowGraph& cfg, const std::vector<DMAAccess>& accesses)
+{
+	std::vector<const BasicBlock*> accessBlocks;
+	for(const DMAAccess& access : accesses)
+	{
+		InstructionWalker it = access.start;
+		accessBlocks.push_back(it.getBasicBlock());
+	}
+	FastSet<const BasicBlock*> reachable;
+	reachable.insert(accessBlocks.begin(), accessBlocks.end());
+	std::vector<const BasicBlock*> worklist(accessBlocks);
+	while(!worklist.empty())
+	{
+		const BasicBlock* block = worklist.back();
+		worklist.pop_back();
+		for(const BasicBlock* successor : cfg.getSuccessors(*block))
+		{
+			if(reachable.emplace(successor).second)
+				worklist.push_back(successor);
+		}
+	}
+	FastSet<const BasicBlock*> reaching;
+	reaching.insert(accessBlocks.begin(), accessBlocks.end());
+	worklist = accessBlocks;
+	while(!worklist.empty())
+	{
+		const BasicBlock* block = worklist.back();
+		worklist.pop_back();
+		for(const analysis::CFGPredecessor& predecessor : cfg.getPredecessors(*block))
+		{
+			if(reaching.emplace(predecessor.block).second)
+				worklist.push_back(predecessor.block);
+		}
+	}
+	FastSet<const BasicBlock*> liveBlocks;
+	for(const BasicBlock* block : reachable)
+	{
+		if(reaching.find(block) != reaching.end())
+			liveBlocks.emplace(block);
+	}
+	return liveBlocks;
+}
+
+void optimizations::promotePrivateMemory(const Module& module, Method& method, const Configuration& config)
+{
+	std::size_t numLocals = 0;
+	std::size_t numRegisters = 0;
+	std::size_t numVPM = 0;
+	auto start = method.walkAllInstructions().nextInBlock();
+	Optional<Value> qpuNumber = NO_VALUE;
+	//the objects to be mapped into the VPM with their accesses
+	std::vector<std::pair<const Global*, std::vector<DMAAccess>>> vpmCandidates;
+	VPMPlanner planner(*method.vpm, VPMUsage::PRIVATE_MEMORY);
+	for(const Global& global : module.globalData)
+	{
+		//the allocations of __private memory (e.g. arrays) are lifted into the global data
+		if(!global.type.isPointerType() || global.type.getPointerType().get()->addressSpace != AddressSpace::PRIVATE)
+			continue;
+		const DataType& contentType = global.type.getPointerType().get()->elementType;
+		const DataType elementType = contentType.getArrayType().hasValue ? contentType.getArrayType().get()->elementType : contentType;
+		if(elementType.complexType != nullptr || elementType.num != 1 || elementType.getScalarBitCount() != 32)
+			continue;
+		const unsigned numElements = contentType.getArrayType().hasValue ? contentType.getArrayType().get()->size : 1;
+		std::vector<DMAAccess> accesses;
+		bool hasOtherUses = false;
+		if(!findMemoryAccesses(method, &global, accesses, hasOtherUses, isMappableElement) || hasOtherUses || accesses.empty())
+			continue;
+
+		//determine the element accessed by every access, if it is constant
+		std::vector<unsigned> elementIndices;
+		elementIndices.reserve(accesses.size());
+		for(const DMAAccess& access : accesses)
+		{
+			const auto location = findMemoryLocation(access.addressWrite.get<MoveOperation>()->getSource(), elementType);
+			if(!location || location.get().base != &global || location.get().offset < 0 || location.get().offset % 4 != 0 || static_cast<unsigned>(location.get().offset / 4) >= numElements)
+				break;
+			elementIndices.push_back(static_cast<unsigned>(location.get().offset / 4));
+		}
+
+		if(elementIndices.size() == accesses.size() && numElements <= MAX_PROMOTED_ELEMENTS)
+		{
+			//1. all elements are accessed with constant indices -> one local per element
+			DEBUG_LOG("Promoting __private memory " << global.to_string() << " to one local per element" << logging::endl);
+			std::vector<Value> elements;
+			elements.reserve(numElements);
+			for(unsigned i = 0; i < numElements; ++i)
+			{
+				elements.push_back(method.addNewLocal(elementType, global.name));
+				start.emplace(new MoveOperation(elements.back(), getInitialElement(global, elementType, i)));
+				start.nextInBlock();
+			}
+			for(std::size_t i = 0; i < accesses.size(); ++i)
+			{
+				const Value& element = elements.at(elementIndices.at(i));
+				const bool isWrite = accesses.at(i).isWrite;
+				replaceDMAAccess(accesses.at(i), [&element, isWrite](InstructionWalker it, const Value& address, const Value& value) -> InstructionWalker
+				{
+					it.emplace(isWrite ? new MoveOperation(element, value) : new MoveOperation(value, element));
+					return it.nextInBlock();
+				});
+			}
+			++numLocals;
+		}
+		else if(numElements <= 16)
+		{
+			//2. the elements fit into a single SIMD register -> the elements are accessed via vector rotations
+			DEBUG_LOG("Promoting __private memory " << global.to_string() << " into the elements of a single register" << logging::endl);
+			const Value container = method.addNewLocal(elementType.toVectorType(16), global.name);
+			//the initial unconditional write is also required for the register allocation, since the insertions only write single elements
+			start.emplace(new MoveOperation(container, getInitialElement(global, elementType, 0)));
+			start.nextInBlock();
+			for(unsigned i = 1; i < numElements; ++i)
+			{
+				const Value element = getInitialElement(global, elementType, i);
+				if(element.literal.integer != getInitialElement(global, elementType, 0).literal.integer)
+					start = insertVectorInsertion(start, method, container, Value(Literal(static_cast<long>(i)), TYPE_INT8), element);
+			}
+			for(DMAAccess& access : accesses)
+			{
+				const bool isWrite = access.isWrite;
+				replaceDMAAccess(access, [&](InstructionWalker it, const Value& address, const Value& value) -> InstructionWalker
+				{
+					const Value offset = method.addNewLocal(TYPE_INT32, "%private_offset");
+					it.emplace(new Operation("sub", offset, address, global.createReference()));
+					it.nextInBlock();
+					const Value index = method.addNewLocal(TYPE_INT32, "%private_index");
+					it.emplace(new Operation("shr", index, offset, Value(Literal(2L), TYPE_INT8)));
+					it.nextInBlock();
+					if(isWrite)
+						return insertVectorInsertion(it, method, container, index, value);
+					return insertVectorExtraction(it, method, container, index, value);
+				});
+			}
+			++numRegisters;
+		}
+		else
+		{
+			//3. every QPU stores its copy of the memory in its own part of a VPM area
+			if(!global.value.isUndefined())
+				//the VPM area is not initialized
+				continue;
+			//the areas are reserved for all objects at once, so objects never live at the same time can share the same rows
+			planner.addDemand(&global, contentType.getPhysicalWidth(), static_cast<double>(accesses.size()));
+			vpmCandidates.emplace_back(&global, std::move(accesses));
+		}
+	}
+
+	if(!vpmCandidates.empty())
+	{
+		const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+		std::vector<FastSet<const BasicBlock*>> liveBlocks;
+		liveBlocks.reserve(vpmCandidates.size());
+		for(const auto& candidate : vpmCandidates)
+			liveBlocks.push_back(getLiveBlocks(cfg, candidate.second));
+		for(std::size_t i = 0; i < vpmCandidates.size(); ++i)
+		{
+			for(std::size_t j = i + 1; j < vpmCandidates.size(); ++j)
+			{
+				if(std::any_of(liveBlocks[i].begin(), liveBlocks[i].end(), [&liveBlocks, j](const BasicBlock* block) -> bool { return liveBlocks[j].find(block) != liveBlocks[j].end();}))
+					planner.addConflict(vpmCandidates[i].first, vpmCandidates[j].first);
+			}
+		}
+	}
+	const FastMap<const Local*, const VPMArea*> areas = planner.allocate();
+	for(auto& candidate : vpmCandidates)
+	{
+		const Global& global = *candidate.first;
+		auto areaIt = areas.find(&global);
+		if(areaIt == areas.end())
+		{
+			DEBUG_LOG("Not enough VPM space left to map __private memory " << global.to_string() << logging::endl);
+			continue;
+		}
+		const VPMArea* area = areaIt->second;
+		DEBUG_LOG("Mapping __private memory " << global.to_string() << " into the VPM" << logging::endl);
+		if(!qpuNumber)
+		{
+			//the QPU number can only be read from register-file B and can therefore not be combined with a small immediate
+			qpuNumber = method.addNewLocal(TYPE_INT8, "%qpu_number");
+			start.emplace(new MoveOperation(qpuNumber.get(), Value(REG_QPU_NUMBER, TYPE_INT8)));
+			start.nextInBlock();
+		}
+		//the area might be shared with larger objects, so the size of the part of every QPU is determined by the area
+		const unsigned partSize = area->size / NUM_QPUS;
+		const Value qpuOffset = method.addNewLocal(TYPE_INT32, "%private_qpu_offset");
+		start.emplace(new Operation("mul24", qpuOffset, qpuNumber.get(), Value(Literal(static_cast<long>(partSize)), TYPE_INT32)));
+		start.nextInBlock();
+		for(DMAAccess& access : candidate.second)
+		{
+			const bool isWrite = access.isWrite;
+			replaceDMAAccess(access, [&](InstructionWalker it, const Value& address, const Value& value) -> InstructionWalker
+			{
+				const Value offset = method.addNewLocal(TYPE_INT32, "%private_offset");
+				it.emplace(new Operation("sub", offset, address, global.createReference()));
+				it.nextInBlock();
+				const Value qpuAreaOffset = method.addNewLocal(TYPE_INT32, "%private_offset");
+				it.emplace(new Operation("add", qpuAreaOffset, offset, qpuOffset));
+				it.nextInBlock();
+				//the rows of this QPU are never accessed by any other QPU, so there is no need for the mutex
+				if(isWrite)
+					return method.vpm->insertWriteVPM(method, it, value, *area, qpuAreaOffset, false);
+				return method.vpm->insertReadVPM(method, it, value, *area, qpuAreaOffset);
+			});
+		}
+		++numVPM;
+	}
+	DEBUG_LOG("Promoted " << numLocals << " __private memory objects to locals, " << numRegisters << " into single registers and mapped " << numVPM << " into the VPM" << logging::endl);
+}
+
+InstructionWalker optimizations::accessGlobalData(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
+{
+	/*
+	 * Map pointer to global data to the start-of-global-data parameter
+	 *  plus the offset of the global data
+	 */
+	for(std::size_t i = 0; i < it->getArguments().size(); ++i)
+	{
+		const Value arg = it->getArgument(i).get();
+		if(arg.hasType(ValueType::LOCAL) && arg.type.isPointerType() && arg.local->is<Global>())
+		{
+			const Optional<unsigned int> globalOffset = module.getGlobalDataOffset(arg.local);
+			if(globalOffset.hasValue)
+			{
+				DEBUG_LOG("Replacing access to global data: " << it->to_string() << logging::endl);
+				method.accessedGlobals.emplace(arg.local->as<Global>());
+				Value tmp = UNDEFINED_VALUE;
+				if(globalOffset.get() == 0)
+				{
+					tmp = method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_DATA_ADDRESS)->createReference();
+				}
+				else
+				{
+					//emplace calculation of global-data pointer and replace argument
+					tmp = method.addNewLocal(TYPE_INT32, "%global_data_offset");
+					it.emplace(new intermediate::Operation("add", tmp, method.findOrCreateLocal(TYPE_INT32, Method::GLOBAL_DATA_ADDRESS)->createReference(), Value(Literal(static_cast<unsigned long>(globalOffset)), TYPE_INT32)));
+					it.nextInBlock();
+				}
+				it->setArgument(i, tmp);
+			}
+		}
+	}
+	return it;
 }
@@ -16,16 +16,120 @@ namespace vc4c
 	{
 		/*
 		 * Combine consecutive configuration of VPW/VPR with the same settings
+		 *
+		 * Accesses to the same base address with a constant stride are combined into a single multi-row DMA transfer (of up to 16 rows for reading
+		 * and 64 rows for writing), guarded by a single mutex lock. The accesses are combined within chains of basic blocks which are always executed
+		 * after each other (e.g. unrolled loop iterations).
+		 * Accesses whose addresses are each calculated by adding the same local to the previous address (e.g. the rows of an image with a run-time pitch)
+		 * are combined too, if the range of the local is known to fit into the DMA stride.
 		 */
 		void combineVPMAccess(const Module& module, Method& method, const Configuration& config);
 
-		InstructionWalker accessGlobalData(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
+		/*
+		 * Promotes __private memory (e.g. arrays), which is otherwise located in the global data segment and therefore shared between all work-items.
+		 *
+		 * Arrays of up to 16 32-bit elements only accessed with constant indices are replaced by one local per element,
+		 * arrays of up to 16 elements accessed with dynamic indices are stored in the elements of a single register.
+		 * Larger uninitialized arrays are placed into a VPM area, which holds a separate copy for every QPU.
+		 *
+		 * NOTE: This needs to run before the access to global data is mapped to the global data address
+		 */
+		void promotePrivateMemory(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Maps small __local arrays of 32-bit elements into the VPM, which is shared between all QPUs.
+		 * The DMA accesses to these arrays are replaced by direct reads and writes of the VPM.
+		 *
+		 * NOTE: This needs to run before the access to global data is mapped to the global data address and before the VPM accesses are combined
+		 */
+		void mapLocalMemoryToVPM(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Copies small __constant lookup tables of 32-bit elements (e.g. the S-boxes of block ciphers, if enabled via Configuration#maxPreloadedTableSize) into a VPM area
+		 * once at the start of the kernel and replaces the DMA reads of the tables with direct reads of the VPM.
+		 * Thus, the lookups with data-dependent indices do not need a DMA access or TMU load each.
+		 *
+		 * NOTE: This needs to run before the access to global data is mapped to the global data address and before the read-only memory is loaded via the TMUs
+		 */
+		void preloadConstantTables(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Replaces the DMA reads of read-only memory (__constant memory, const and restrict pointer parameters which are never written)
+		 * with general-memory lookups via the TMUs, which do not need to lock the VPM and can be executed by all QPUs in parallel.
+		 * Vectors of 32-bit elements are loaded with one address per SIMD element. The loads alternate between TMU0 and TMU1
+		 * and are moved as close as possible to the first use of the loaded value to hide the memory latency.
+		 *
+		 * NOTE: This needs to run before the access to global data is mapped to the global data address
+		 */
+		void loadReadOnlyMemoryViaTMU(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Pipelines the TMU loads within loops consisting of a single block, whose addresses change by a constant number of bytes in every iteration.
+		 * The addresses of the first iteration are requested before the loop and the addresses of the next iteration are requested right after the values
+		 * of the current iteration are loaded, so the memory latency overlaps with the rest of the iteration instead of stalling the load.
+		 * Since the loop condition is only known at the end of an iteration, the last iteration requests the addresses after the last ones accessed,
+		 * whose values are loaded and discarded when leaving the loop.
+		 *
+		 * NOTE: This needs to run after the read-only memory is loaded via the TMUs
+		 */
+		void pipelineTMULoads(const Module& module, Method& method, const Configuration& config);
 
 		/*
-		 * Spills long-living locals which are rarely read into the VPM to be cached there.
-		 * Also splits the uses before and after being spilled into several locals
+		 * Prefetches the DMA reads within loops consisting of a single block (if enabled via Configuration#partitionVPM),
+		 * whose addresses change by a constant number of bytes in every iteration and whose memory is not modified within the loop,
+		 * i.e. is never written and does not alias any memory written in the loop (see analysis#mayAliasBases).
+		 *
+		 * Every such stream of reads uses its own VPM row per QPU. The row for the first iteration is read in the pre-header of the loop,
+		 * every iteration waits for its prefetched row and then starts reading the row of the next iteration,
+		 * so the DMA transfer runs while the rest of the iteration is executed.
+		 * Since the loop condition is only known at the end of an iteration, the last iteration reads the row after the last one accessed.
+		 *
+		 * NOTE: This needs to run after the VPM accesses are combined and before the scratch area is partitioned,
+		 * since it reserves the prefetched rows as part of the partitioned scratch area
 		 */
-		void spillLocals(const Module& module, Method& method, const Configuration& config);
+		void prefetchDMAReads(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Forwards the values written to memory via DMA to later DMA reads of the same address within a chain of basic blocks executed after each other
+		 * (e.g. the bodies of inlined functions or fused kernels) and removes DMA reads of values already read.
+		 *
+		 * The accessed memory locations are determined from the base address and constant offset of the DMA address, other addresses (e.g. indexed by the work-item id)
+		 * only match accesses with the very same address value. Writes to locations which may alias
+		 * (see analysis#getAliasResult) discard the known values,
+		 * as do memory barriers, method calls and any other (e.g. atomic) memory accesses. Accesses to volatile parameters are never removed.
+		 *
+		 * NOTE: This needs to run before the VPM accesses are combined
+		 */
+		void forwardMemoryAccesses(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Combines the DMA accesses of consecutive 32-bit scalar elements (e.g. a[4*i+0] to a[4*i+3]) within a basic block into a single DMA access of a vector.
+		 * Up to 16 elements of any number are combined into one access, whose DMA row length masks the transfer to the accessed elements.
+		 *
+		 * The read elements are extracted from the read vector, the written elements are inserted into the written vector, both via vector rotations.
+		 * Reads are combined at the position of the first read, writes at the position of the last write, so accesses which may alias (see #forwardMemoryAccesses)
+		 * in between split the accesses into separate groups. Accesses to volatile parameters are never combined.
+		 */
+		void vectorizeMemoryAccesses(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Gives every QPU its own part of the VPM scratch area (if enabled via Configuration#partitionVPM and the parts fit into the VPM).
+		 * All VPM setups addressing the scratch area are offset by the part of the executing QPU
+		 * and the mutex locks around DMA accesses only using the scratch area are removed.
+		 *
+		 * NOTE: This needs to run after the VPM accesses are combined, since the size of the scratch area is fixed afterwards
+		 */
+		void partitionVPMScratch(const Module& module, Method& method, const Configuration& config);
+
+		/*
+		 * Merges consecutive read-modify-write (e.g. atomic) sections within a basic block into a single section guarded by the hardware mutex,
+		 * removing the release and re-acquisition of the mutex in between, e.g. for histograms updating several bins.
+		 *
+		 * Only a few short sections without any periphery access (other than the DMA accesses) in between are merged to not block other QPUs for too long.
+		 */
+		void mergeAtomicSections(const Module& module, Method& method, const Configuration& config);
+
+		InstructionWalker accessGlobalData(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
 	}
 }
 
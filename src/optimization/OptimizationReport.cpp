@@ -0,0 +1,71 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "OptimizationReport.h"
+#include "../Module.h"
+#include "../intermediate/IntermediateInstruction.h"
+
+using namespace vc4c;
+using namespace vc4c::optimizations;
+
+void OptimizationReport::addKernel(const std::string& kernelName, std::vector<PassStatistics>&& passes)
+{
+#ifdef MULTI_THREADED
+	std::lock_guard<std::mutex> guard(lock);
+#endif
+	kernels.emplace_back(kernelName, std::move(passes));
+}
+
+static std::string escapeJSON(const std::string& text)
+{
+	std::string escaped;
+	escaped.reserve(text.size());
+	for(const char c : text)
+	{
+		if(c == '"' || c == '\\')
+			escaped.push_back('\\');
+		if(static_cast<unsigned char>(c) < 0x20)
+			//the names only contain printable characters anyway
+			continue;
+		escaped.push_back(c);
+	}
+	return escaped;
+}
+
+void OptimizationReport::writeJSON(std::ostream& stream) const
+{
+#ifdef MULTI_THREADED
+	std::lock_guard<std::mutex> guard(lock);
+#endif
+	stream << "{\n  \"kernels\": [";
+	for(std::size_t k = 0; k < kernels.size(); ++k)
+	{
+		stream << (k == 0 ? "\n" : ",\n") << "    {\n      \"name\": \"" << escapeJSON(kernels[k].first) << "\",\n      \"passes\": [";
+		const std::vector<PassStatistics>& passes = kernels[k].second;
+		for(std::size_t p = 0; p < passes.size(); ++p)
+		{
+			const PassStatistics& pass = passes[p];
+			stream << (p == 0 ? "\n" : ",\n") << "        {\"name\": \"" << escapeJSON(pass.passName) << "\", \"iteration\": " << pass.iteration
+					<< ", \"time_us\": " << pass.duration.count()
+					<< ", \"instructions_before\": " << pass.instructionsBefore << ", \"instructions_after\": " << pass.instructionsAfter
+					<< ", \"nops_before\": " << pass.nopsBefore << ", \"nops_after\": " << pass.nopsAfter
+					<< ", \"locals_before\": " << pass.localsBefore << ", \"locals_after\": " << pass.localsAfter << "}";
+		}
+		stream << "\n      ]\n    }";
+	}
+	stream << "\n  ]\n}\n";
+}
+
+std::size_t OptimizationReport::countNops(const Method& method)
+{
+	std::size_t numNops = 0;
+	method.forAllInstructions([&numNops](const intermediate::IntermediateInstruction* instr) -> void
+	{
+		if(instr != nullptr && instr->is<intermediate::Nop>())
+			++numNops;
+	});
+	return numNops;
+}
@@ -0,0 +1,70 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef OPTIMIZATION_REPORT_H
+#define OPTIMIZATION_REPORT_H
+
+#include "helper.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+#ifdef MULTI_THREADED
+#include <mutex>
+#endif
+
+namespace vc4c
+{
+	class Method;
+
+	namespace optimizations
+	{
+		/*
+		 * The effects of a single run of an optimization pass on a kernel
+		 */
+		struct PassStatistics
+		{
+			std::string passName;
+			//the run of a repeated pass, 1 for the first run
+			unsigned iteration;
+			std::chrono::microseconds duration;
+			std::size_t instructionsBefore;
+			std::size_t instructionsAfter;
+			std::size_t nopsBefore;
+			std::size_t nopsAfter;
+			std::size_t localsBefore;
+			std::size_t localsAfter;
+		};
+
+		/*
+		 * Collects the statistics of the optimization passes for all kernels, e.g. to find out which passes pay off
+		 */
+		class OptimizationReport : private NonCopyable
+		{
+		public:
+			/*
+			 * Adds the statistics of all passes run for a single kernel. Kernels can be added in parallel
+			 */
+			void addKernel(const std::string& kernelName, std::vector<PassStatistics>&& passes);
+
+			void writeJSON(std::ostream& stream) const;
+
+			/*
+			 * Determines the number of NOPs in the given method
+			 */
+			static std::size_t countNops(const Method& method);
+
+		private:
+			std::vector<std::pair<std::string, std::vector<PassStatistics>>> kernels;
+#ifdef MULTI_THREADED
+			mutable std::mutex lock;
+#endif
+		};
+	} /* namespace optimizations */
+} /* namespace vc4c */
+
+#endif /* OPTIMIZATION_REPORT_H */
@@ -10,16 +10,31 @@
 #include "Eliminator.h"
 #include "Reordering.h"
 #include "Combiner.h"
+#include "ControlFlow.h"
 #include "MemoryAccess.h"
+#include "Loops.h"
+#include "Peephole.h"
+#include "Instrumentation.h"
+#include "FunctionCache.h"
+#include "../intrinsics/Images.h"
 #include "../intrinsics/Intrinsics.h"
+#include "../intrinsics/LongOperations.h"
 #include "../Profiler.h"
+#include "../Serialization.h"
 #include "../BackgroundWorker.h"
-#include "log.h"
+#include "../Logging.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iterator>
 
 using namespace vc4c;
 using namespace vc4c::optimizations;
 
-OptimizationPass::OptimizationPass(const std::string& name, const Pass pass, const std::size_t index) : name(name), index(index), pass(pass)
+OptimizationPass::OptimizationPass(const std::string& name, const Pass pass, const std::size_t index, const analysis::AnalysisType preservedAnalyses) :
+		name(name), index(index), preservedAnalyses(preservedAnalyses), pass(pass)
 {
 }
 
@@ -28,9 +43,13 @@ bool OptimizationPass::operator <(const OptimizationPass& other) const
 	return index < other.index;
 }
 
-void OptimizationPass::operator ()(const Module& module, Method& method, const Configuration& config) const
+bool OptimizationPass::operator ()(const Module& module, Method& method, const Configuration& config) const
 {
+	const std::size_t numModifications = method.getModificationCount();
 	pass(module, method, config);
+	//the control-flow graph (and thus the dominators calculated on top of it) is kept up to date by the method itself
+	method.getAnalyses().invalidate(remove_flag(add_flag(add_flag(add_flag(analysis::AnalysisType::LIVENESS, analysis::AnalysisType::DIVERGENCE), analysis::AnalysisType::VALUE_RANGES), analysis::AnalysisType::FLAGS), preservedAnalyses));
+	return method.getModificationCount() != numModifications;
 }
 
 bool OptimizationPass::operator ==(const OptimizationPass& other) const
@@ -38,8 +57,11 @@ bool OptimizationPass::operator ==(const OptimizationPass& other) const
 	return name.compare(other.name) == 0 && index == other.index;
 }
 
-OptimizationStep::OptimizationStep(const std::string& name, const Step step, const std::size_t index) : name(name), index(index), step(step)
+OptimizationStep::OptimizationStep(const std::string& name, const Step step, const std::size_t index, std::initializer_list<intermediate::InstructionKind> kinds) :
+		name(name), index(index), step(step), kindMask(kinds.size() == 0 ? ~uint32_t{0} : 0)
 {
+	for(const intermediate::InstructionKind kind : kinds)
+		kindMask |= uint32_t{1} << static_cast<unsigned>(kind);
 }
 
 bool OptimizationStep::operator <(const OptimizationStep& other) const
@@ -57,6 +79,11 @@ bool OptimizationStep::operator ==(const OptimizationStep& other) const
 	return name.compare(other.name) == 0 && index == other.index;
 }
 
+bool OptimizationStep::appliesTo(const intermediate::InstructionKind kind) const
+{
+	return (kindMask >> static_cast<unsigned>(kind)) & 1;
+}
+
 static InstructionWalker checkMethodCalls(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
 {
 	if(it.has<intermediate::MethodCall>())
@@ -66,163 +93,648 @@ static InstructionWalker checkMethodCalls(const Module& module, Method& method,
 	return it;
 }
 
-static const std::set<OptimizationStep> SINGLE_STEPS = {
+using intermediate::InstructionKind;
+
+static const std::set<OptimizationStep>& getSingleSteps()
+{
+	static const std::set<OptimizationStep> steps = {
 		//replaces all remaining returns with jumps to the end of the kernel-function
-		OptimizationStep("EliminateReturns", eliminateReturn, 0),
+		OptimizationStep("EliminateReturns", eliminateReturn, 0, {InstructionKind::RETURN}),
 		//combined successive branches to the same label (e.g. end of switch-case)
-		OptimizationStep("CombineDuplicateBranches", combineDuplicateBranches, 10),
+		OptimizationStep("CombineDuplicateBranches", combineDuplicateBranches, 10, {InstructionKind::BRANCH}),
 		//eliminates useless branches (e.g. jumps to the next instruction)
-		OptimizationStep("EliminateUselessBranch", eliminateUselessBranch, 20),
+		OptimizationStep("EliminateUselessBranch", eliminateUselessBranch, 20, {InstructionKind::BRANCH}),
 		//intrinsifies calls to built-ins and unsupported operations
-		OptimizationStep("IntrinsifyBuiltin", intrinsify, 30),
+		OptimizationStep("IntrinsifyBuiltin", intrinsify, 30, {InstructionKind::OPERATION, InstructionKind::COMPARISON, InstructionKind::METHOD_CALL}),
 		//moves vector-containers to locals and re-directs all uses to the local
-		OptimizationStep("HandleLiteralVector", handleContainer, 40),
+		OptimizationStep("HandleLiteralVector", handleContainer, 40, {InstructionKind::OPERATION, InstructionKind::COMPARISON, InstructionKind::MOVE, InstructionKind::VECTOR_ROTATION}),
 		//maps access to global data to the offset in the code
 		OptimizationStep("MapGlobalDataToAddress", accessGlobalData, 50),
 		//calculates constant values where applicable
 		//TODO sometimes reverts immediate-loads which are then again converted to immediate-loads??
-		OptimizationStep("CalculateConstantValue", calculateConstantInstruction, 60),
+		OptimizationStep("CalculateConstantValue", calculateConstantInstruction, 60, {InstructionKind::OPERATION, InstructionKind::COMPARISON}),
 		//eliminates/rewrites useless instructions (e.g. y = x + 0 -> y = x)
-		OptimizationStep("EliminateUselessInstruction", eliminateUselessInstruction, 70),
+		OptimizationStep("EliminateUselessInstruction", eliminateUselessInstruction, 70, {InstructionKind::OPERATION, InstructionKind::COMPARISON, InstructionKind::MOVE, InstructionKind::VECTOR_ROTATION}),
 		//extracts immediate values into loads
-		OptimizationStep("LoadImmediateValues", handleImmediate, 80),
+		OptimizationStep("LoadImmediateValues", handleImmediate, 80, {InstructionKind::OPERATION, InstructionKind::COMPARISON, InstructionKind::MOVE, InstructionKind::VECTOR_ROTATION}),
 		//prevents register-conflicts by moving long-living locals into temporaries before being used together with literal values
-		OptimizationStep("HandleUseWithImmediateValues", handleUseWithImmediate, 90),
+		OptimizationStep("HandleUseWithImmediateValues", handleUseWithImmediate, 90, {InstructionKind::OPERATION, InstructionKind::COMPARISON}),
 		//moves all sources of vector-rotations to accumulators (if too large usage-range)
-		OptimizationStep("MoveRotationSourcesToAccs", moveRotationSourcesToAccumulators, 100),
+		OptimizationStep("MoveRotationSourcesToAccs", moveRotationSourcesToAccumulators, 100, {InstructionKind::VECTOR_ROTATION}),
 		//simple fail-fast for not inlined or intrinsified method-calls
-		OptimizationStep("CheckMethodCalls", checkMethodCalls, 110),
+		OptimizationStep("CheckMethodCalls", checkMethodCalls, 110, {InstructionKind::METHOD_CALL}),
 		//combine consecutive instructions writing the same local with a value and zero depending on some flags
-		OptimizationStep("CombineSelectionWithZero", combineSelectionWithZero, 120)
+		OptimizationStep("CombineSelectionWithZero", combineSelectionWithZero, 120, {InstructionKind::MOVE, InstructionKind::VECTOR_ROTATION})
+	};
+	return steps;
+}
+
+static InstructionWalker intrinsifyOperation(const Module& module, Method& method, InstructionWalker it, const Configuration& config)
+{
+	//built-in functions (e.g. work-item functions) access locals of the kernel by name, so they can only be intrinsified after inlining
+	if(it.has<intermediate::MethodCall>())
+		return it;
+	return intrinsify(module, method, it, config);
+}
+
+//the steps which only depend on the instruction itself and can therefore be run on methods before they are inlined
+static const std::set<OptimizationStep>& getInlinedMethodSteps()
+{
+	static const std::set<OptimizationStep> steps = {
+		OptimizationStep("IntrinsifyOperation", intrinsifyOperation, 30, {InstructionKind::OPERATION, InstructionKind::COMPARISON}),
+		OptimizationStep("CalculateConstantValue", calculateConstantInstruction, 60, {InstructionKind::OPERATION, InstructionKind::COMPARISON}),
+		OptimizationStep("EliminateUselessInstruction", eliminateUselessInstruction, 70, {InstructionKind::OPERATION, InstructionKind::COMPARISON, InstructionKind::MOVE, InstructionKind::VECTOR_ROTATION})
+	};
+	return steps;
+}
+
+/*
+ * The instructions (still) to run the single steps on.
+ *
+ * Initially, all instructions are visited in order. Afterwards only the instructions created or modified by a step
+ * and the readers of the locals written by these are visited again, since only these can offer new opportunities for the steps.
+ */
+struct StepWorklist
+{
+	//the known instructions and the block they were found in, any instruction not contained is created by a step
+	FastMap<const intermediate::IntermediateInstruction*, BasicBlock*> knownInstructions;
+	//the instructions to visit again, per block. The entries are only compared with the instructions of the block, never dereferenced
+	FastMap<BasicBlock*, FastSet<const intermediate::IntermediateInstruction*>> pendingInstructions;
+	//the locals written by the instruction currently visited
+	std::vector<const Local*> writtenLocals;
+
+	void queueReaders(const Local* local)
+	{
+		local->forUsers(LocalUser::Type::READER, [this](const LocalUser* user) -> void
+		{
+			//the single operations of combined instructions are not part of the instruction list
+			auto it = knownInstructions.find(dynamic_cast<const intermediate::IntermediateInstruction*>(user));
+			if(it != knownInstructions.end())
+				pendingInstructions[it->second].emplace(it->first);
+		});
+	}
+
+	void queueReadersOfWrittenLocals()
+	{
+		for(const Local* local : writtenLocals)
+			queueReaders(local);
+	}
 };
 
-static void runSingleSteps(const Module& module, Method& method, const Configuration& config)
+//the counters of the modifications per step are recorded after the counters of the passes (see #runOptimizationPass)
+static constexpr std::size_t STEP_CHANGES_COUNTER_OFFSET = 2000000;
+
+//the number of instruction kinds, i.e. the size of the dispatch table of the steps
+static constexpr std::size_t NUM_INSTRUCTION_KINDS = static_cast<std::size_t>(InstructionKind::MEMORY_BARRIER) + 1;
+
+/*
+ * The steps to run per instruction kind (in the order of their indices), so the steps which can't modify an instruction are not even called for it
+ */
+struct StepDispatch
+{
+	std::array<std::vector<const OptimizationStep*>, NUM_INSTRUCTION_KINDS> stepsByKind;
+	//the steps run on positions without an instruction
+	std::vector<const OptimizationStep*> allSteps;
+
+	explicit StepDispatch(const std::set<OptimizationStep>& steps)
+	{
+		for(const OptimizationStep& step : steps)
+		{
+			allSteps.push_back(&step);
+			for(std::size_t kind = 0; kind < NUM_INSTRUCTION_KINDS; ++kind)
+			{
+				if(step.appliesTo(static_cast<InstructionKind>(kind)))
+					stepsByKind[kind].push_back(&step);
+			}
+		}
+	}
+
+	const std::vector<const OptimizationStep*>& getSteps(const InstructionWalker& it) const
+	{
+		return it.has() ? stepsByKind[static_cast<std::size_t>(it->kind)] : allSteps;
+	}
+};
+
+/*
+ * Runs all steps on the instruction at the given position and tracks the modifications in the work-list
+ */
+static void runStepsOnInstruction(const Module& module, Method& method, const Configuration& config, const StepDispatch& dispatch,
+		InstructionWalker& it, const InstructionWalker& prevIt, StepWorklist& worklist)
 {
-	auto& s = (logging::debug() << "Running steps: ");
-	for(const OptimizationStep& step : SINGLE_STEPS)
-		s << step.name << ", ";
-	s << logging::endl;
-
-//	//FOR VECTOR:
-//
-//	//since an optimization-step can be run on the result of the previous step,
-//	//we can't just pass the resulting iterator (pointing behind the optimization result) into the next optimization-step
-//	//using the index makes sure, that any added instruction is processed by the following optimization-steps
-//	//for removed instructions, the next optimization-step automatically handles the next instruction (which moves to the index of the removed one)
-//	for(std::size_t i = 0; i < method.readInstructions().size(); ++i)
-//	{
-//		for(const OptimizationStep& step : SINGLE_STEPS)
-//		{
-//			auto it = method.modifyInstructions();
-//			//this is actually constant time, something like "it = it + i"
-//			std::advance(it, i);
-//			PROFILE_START_DYNAMIC(step.name);
-//			step(module, method, it, config);
-//			PROFILE_END_DYNAMIC(step.name);
-//		}
-//	}
-	//FOR LIST:
+	const intermediate::IntermediateInstruction* instr = it.get();
+	worklist.writtenLocals.clear();
+	instr->forUsedLocals([&worklist](const Local* local, LocalUser::Type type) -> void
+	{
+		if(has_flag(type, LocalUser::Type::WRITER))
+			worklist.writtenLocals.push_back(local);
+	});
+	//the readers of the values written by new instructions need to be re-visited
+	bool modified = worklist.knownInstructions.emplace(instr, it.getBasicBlock()).second;
 
 	//since an optimization-step can be run on the result of the previous step,
 	//we can't just pass the resulting iterator (pointing behind the optimization result) into the next optimization-step
 	//but since lists do not reallocate elements at inserting/removing, we can re-use the previous iterator
-	auto it = method.walkAllInstructions();
+	const std::vector<const OptimizationStep*>* steps = &dispatch.getSteps(it);
+	auto stepIt = steps->begin();
+	while(stepIt != steps->end())
+	{
+		const OptimizationStep& step = **stepIt;
+		PROFILE_START_DYNAMIC(step.name);
+		auto newIt = step(module, method, it, config);
+		//we can't just test newIt == it here, since if we replace the content of the iterator instead of deleting it, the iterators are still the same, even if we emplace instructions before
+		const bool changed = newIt.copy().previousInMethod() != prevIt || newIt != it;
+		PROFILE_END_DYNAMIC(step.name);
+		if(changed)
+		{
+			PROFILE_COUNTER(STEP_CHANGES_COUNTER_OFFSET + step.index, step.name + " (changes)", 1);
+			it = prevIt;
+			//the instruction might have been freed, so the same address could be re-used by a new instruction
+			worklist.knownInstructions.erase(instr);
+			modified = true;
+			//the remaining steps are run on the instruction now at the position, which might be of another kind
+			steps = &dispatch.getSteps(it);
+			stepIt = std::upper_bound(steps->begin(), steps->end(), step.index, [](const std::size_t index, const OptimizationStep* other) -> bool
+			{
+				return index < other->index;
+			});
+		}
+		else
+			++stepIt;
+	}
+	if(modified)
+		worklist.queueReadersOfWrittenLocals();
+}
+
+static void runSteps(const Module& module, Method& method, const Configuration& config, const std::set<OptimizationStep>& steps)
+{
+	if(isLogged(LogLevel::DEBUG))
+	{
+		auto& s = (logging::debug() << "Running steps: ");
+		for(const OptimizationStep& step : steps)
+			s << step.name << ", ";
+		s << logging::endl;
+	}
+
+	const StepDispatch dispatch(steps);
+	StepWorklist worklist;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.get() != nullptr)
+				worklist.knownInstructions.emplace(it.get(), &block);
+		}
+	}
+
+	//visit all instructions in order
 	//this construct with previous iterator is required, because the iterator could be invalidated (if the underlying node is removed)
+	auto it = method.walkAllInstructions();
 	auto prevIt = it;
 	while(!it.isEndOfMethod())
 	{
-		for(const OptimizationStep& step : SINGLE_STEPS)
+		if(it.get() != nullptr)
 		{
-			PROFILE_START_DYNAMIC(step.name);
-			auto newIt = step(module, method, it, config);
-			//we can't just test newIt == it here, since if we replace the content of the iterator instead of deleting it, the iterators are still the same, even if we emplace instructions before
-			if(newIt.copy().previousInMethod() != prevIt || newIt != it)
-				it = prevIt;
-			PROFILE_END_DYNAMIC(step.name);
+			//instructions queued before being visited the first time don't need to be visited again
+			auto pendingIt = worklist.pendingInstructions.find(it.getBasicBlock());
+			if(pendingIt != worklist.pendingInstructions.end())
+				pendingIt->second.erase(it.get());
+			runStepsOnInstruction(module, method, config, dispatch, it, prevIt, worklist);
 		}
 		it.nextInMethod();
 		prevIt = it.copy().previousInMethod();
 	}
+
+	//visit the instructions queued by the modifications until nothing changes anymore.
+	//Since steps might revert the modifications of other steps, the number of re-visits is limited
+	std::size_t remainingVisits = worklist.knownInstructions.size();
+	std::size_t numVisits = 0;
+	while(!worklist.pendingInstructions.empty() && remainingVisits > 0)
+	{
+		BasicBlock* block = worklist.pendingInstructions.begin()->first;
+		FastSet<const intermediate::IntermediateInstruction*> pending = std::move(worklist.pendingInstructions.begin()->second);
+		worklist.pendingInstructions.erase(worklist.pendingInstructions.begin());
+
+		it = block->begin();
+		prevIt = it;
+		//the instructions created while visiting the block are visited too, since we re-start at the previous position on any modification
+		while(!it.isEndOfBlock() && remainingVisits > 0)
+		{
+			if(it.get() != nullptr && (pending.erase(it.get()) > 0 || worklist.knownInstructions.find(it.get()) == worklist.knownInstructions.end()))
+			{
+				runStepsOnInstruction(module, method, config, dispatch, it, prevIt, worklist);
+				--remainingVisits;
+				++numVisits;
+			}
+			it.nextInBlock();
+			prevIt = it.copy().previousInBlock();
+		}
+	}
+	if(!worklist.pendingInstructions.empty())
+		DEBUG_LOG("Stopped re-visiting instructions for single steps after " << numVisits << " visits" << logging::endl);
+	else
+		DEBUG_LOG("Re-visited " << numVisits << " instructions for single steps" << logging::endl);
+}
+
+static void runSingleSteps(const Module& module, Method& method, const Configuration& config)
+{
+	runSteps(module, method, config, getSingleSteps());
 }
 
+//the passes only modifying instructions within basic blocks (without touching any branch) keep the control-flow intact
+static const analysis::AnalysisType KEEPS_CONTROL_FLOW = add_flag(add_flag(analysis::AnalysisType::CONTROL_FLOW_GRAPH, analysis::AnalysisType::DOMINATOR_TREE), analysis::AnalysisType::LOOPS);
+
+//the loops are unrolled before the comparisons of the loop conditions are intrinsified by the single steps
+const OptimizationPass optimizations::UNROLL_LOOPS = OptimizationPass("UnrollLoops", unrollLoops, 10);
+//__private memory is promoted after the loops are unrolled, since unrolling turns the indices into constants
+const OptimizationPass optimizations::PROMOTE_PRIVATE_MEMORY = OptimizationPass("PromotePrivateMemory", promotePrivateMemory, 12, KEEPS_CONTROL_FLOW);
+//__local memory is mapped into VPM (and read-only memory to the TMUs) before the single steps map the memory objects to their address in the global data segment
+const OptimizationPass optimizations::MAP_LOCAL_MEMORY = OptimizationPass("MapLocalMemoryToVPM", mapLocalMemoryToVPM, 15, KEEPS_CONTROL_FLOW);
+//the lookup tables are preloaded after __local memory is mapped, which benefits more from the VPM, and before the lookups would be converted to TMU loads
+const OptimizationPass optimizations::PRELOAD_CONSTANT_TABLES = OptimizationPass("PreloadConstantTables", preloadConstantTables, 16, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::LOAD_VIA_TMU = OptimizationPass("LoadReadOnlyMemoryViaTMU", loadReadOnlyMemoryViaTMU, 17, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::PIPELINE_TMU_LOADS = OptimizationPass("PipelineTMULoads", pipelineTMULoads, 18, KEEPS_CONTROL_FLOW);
+//the constants are propagated before the single steps intrinsify the comparisons, which would hide the constant branch conditions
+const OptimizationPass optimizations::PROPAGATE_CONSTANTS = OptimizationPass("PropagateConstants", propagateConstants, 19);
 const OptimizationPass optimizations::RUN_SINGLE_STEPS = OptimizationPass("SingleSteps", runSingleSteps, 20);
-const OptimizationPass optimizations::SPILL_LOCALS = OptimizationPass("SpillLocals", spillLocals, 70);
-const OptimizationPass optimizations::COMBINE_VPM_SETUP = OptimizationPass("CombineVPMAccess", combineVPMAccess, 80);
-const OptimizationPass optimizations::COMBINE_LITERAL_LOADS = OptimizationPass("CombineLiteralLoads", combineLoadingLiterals, 90);
-const OptimizationPass optimizations::COMBINE_ROTATIONS = OptimizationPass("CombineRotations", combineVectorRotations, 100);
-const OptimizationPass optimizations::ELIMINATE = OptimizationPass("EliminateDeadStores", eliminateDeadStore, 110);
-const OptimizationPass optimizations::SPLIT_READ_WRITES = OptimizationPass("SplitReadAfterWrites", splitReadAfterWrites, 120);
-const OptimizationPass optimizations::REORDER = OptimizationPass("ReorderInstructions", reorderWithinBasicBlocks, 130);
-const OptimizationPass optimizations::COMBINE = OptimizationPass("CombineALUIinstructions", combineOperations, 140);
+//the reductions are recognized after the intrinsics (e.g. min/max) are lowered to operations, before the extractions of the elements are shared with other uses
+const OptimizationPass optimizations::COMBINE_REDUCTIONS = OptimizationPass("CombineVectorReductions", combineVectorReductions, 25, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::ELIMINATE_COMMON_SUBEXPRESSIONS = OptimizationPass("EliminateCommonSubexpressions", eliminateCommonSubexpressions, 30, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::MOVE_LOOP_INVARIANTS = OptimizationPass("MoveLoopInvariantCode", moveLoopInvariantCode, 40, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::CONVERT_IFS = OptimizationPass("ConvertIfsToConditionals", convertIfsToConditionals, 50);
+//the cold blocks are moved after the if-conversion, which could merge them into their predecessors instead
+//the tails are merged after the if-conversion, which might remove the branches to the merged blocks
+const OptimizationPass optimizations::MERGE_TAIL_BLOCKS = OptimizationPass("MergeTailBlocks", mergeTailBlocks, 52);
+const OptimizationPass optimizations::MOVE_COLD_BLOCKS = OptimizationPass("MoveColdBlocks", moveColdBlocks, 55);
+//the blocks are placed after the cold blocks are moved out, so the remaining blocks can be chained directly
+const OptimizationPass optimizations::PLACE_BLOCKS = OptimizationPass("PlaceBasicBlocks", placeBasicBlocks, 57);
+//the DMA reads are forwarded before the VPM accesses are combined, since combined accesses can not be removed individually
+const OptimizationPass optimizations::FORWARD_MEMORY_ACCESSES = OptimizationPass("ForwardMemoryAccesses", forwardMemoryAccesses, 75, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::VECTORIZE_MEMORY_ACCESSES = OptimizationPass("VectorizeMemoryAccesses", vectorizeMemoryAccesses, 77, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::COMBINE_VPM_SETUP = OptimizationPass("CombineVPMAccess", combineVPMAccess, 80, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::PREFETCH_DMA_READS = OptimizationPass("PrefetchDMAReads", prefetchDMAReads, 82, KEEPS_CONTROL_FLOW);
+//the VPM scratch area can only be partitioned after the VPM accesses are combined, since combining increases the scratch size
+const OptimizationPass optimizations::PARTITION_VPM = OptimizationPass("PartitionVPMScratch", partitionVPMScratch, 85, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::MERGE_ATOMIC_SECTIONS = OptimizationPass("MergeAtomicSections", mergeAtomicSections, 87, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::COMBINE_LITERAL_LOADS = OptimizationPass("CombineLiteralLoads", combineLoadingLiterals, 90, KEEPS_CONTROL_FLOW);
+//the constants are selected after the loop invariant loads are moved out of the loops and the duplicate loads are combined
+const OptimizationPass optimizations::PASS_CONSTANTS_AS_UNIFORMS = OptimizationPass("PassConstantsAsUniforms", passConstantsAsUniforms, 95, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::COMBINE_ROTATIONS = OptimizationPass("CombineRotations", combineVectorRotations, 100, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::FOLD_PACK_MODES = OptimizationPass("FoldPackModes", foldPackModes, 105, KEEPS_CONTROL_FLOW);
+//the copies are propagated after all passes inserting copies (e.g. for phi-nodes, intrinsics, rotations), before the dead stores are removed
+const OptimizationPass optimizations::PROPAGATE_MOVES = OptimizationPass("PropagateMoves", propagateMoves, 108, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::ELIMINATE = OptimizationPass("EliminateDeadStores", eliminateDeadStore, 110, KEEPS_CONTROL_FLOW);
+//the flags are only removed before the reordering, which might use the instructions setting them to fill delays
+const OptimizationPass optimizations::ELIMINATE_REDUNDANT_FLAGS = OptimizationPass("EliminateRedundantFlags", eliminateRedundantFlags, 112, KEEPS_CONTROL_FLOW);
+//the peephole rules are not repeated, since removing instructions after the reordering could break the delays the scheduler filled with other instructions
+const OptimizationPass optimizations::PEEPHOLE = OptimizationPass("PeepholeRules", applyPeepholeRules, 115, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::SPLIT_READ_WRITES = OptimizationPass("SplitReadAfterWrites", splitReadAfterWrites, 120, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::REORDER = OptimizationPass("ReorderInstructions", reorderWithinBasicBlocks, 130, KEEPS_CONTROL_FLOW);
+const OptimizationPass optimizations::COMBINE = OptimizationPass("CombineALUIinstructions", combineOperations, 140, KEEPS_CONTROL_FLOW);
+//the work-item loop is nested within the work-group loop
+const OptimizationPass optimizations::LOOP_WORK_ITEMS = OptimizationPass("LoopWorkItems", loopWorkItems, 145);
 const OptimizationPass optimizations::UNROLL_WORK_GROUPS = OptimizationPass("UnrollWorkGroups", unrollWorkGroups, 150);
 
-const std::set<OptimizationPass> optimizations::DEFAULT_PASSES = {
-		RUN_SINGLE_STEPS, /* SPILL_LOCALS, */ COMBINE_VPM_SETUP, COMBINE_LITERAL_LOADS, COMBINE_ROTATIONS, ELIMINATE, SPLIT_READ_WRITES, REORDER, COMBINE, UNROLL_WORK_GROUPS
-};
+const std::set<OptimizationPass>& optimizations::getDefaultPasses()
+{
+	static const std::set<OptimizationPass> passes = {
+		UNROLL_LOOPS, PROMOTE_PRIVATE_MEMORY, MAP_LOCAL_MEMORY, PRELOAD_CONSTANT_TABLES, LOAD_VIA_TMU, PIPELINE_TMU_LOADS, PROPAGATE_CONSTANTS, RUN_SINGLE_STEPS, COMBINE_REDUCTIONS, ELIMINATE_COMMON_SUBEXPRESSIONS, MOVE_LOOP_INVARIANTS, CONVERT_IFS, MOVE_COLD_BLOCKS, PLACE_BLOCKS, FORWARD_MEMORY_ACCESSES, VECTORIZE_MEMORY_ACCESSES, COMBINE_VPM_SETUP, PREFETCH_DMA_READS, PARTITION_VPM, MERGE_ATOMIC_SECTIONS, COMBINE_LITERAL_LOADS, PASS_CONSTANTS_AS_UNIFORMS, COMBINE_ROTATIONS, FOLD_PACK_MODES, PROPAGATE_MOVES, ELIMINATE, ELIMINATE_REDUNDANT_FLAGS, PEEPHOLE, SPLIT_READ_WRITES, REORDER, COMBINE, LOOP_WORK_ITEMS, UNROLL_WORK_GROUPS
+	};
+	return passes;
+}
 
-Optimizer::Optimizer(const Configuration& config, const std::set<OptimizationPass>& passes) : config(config), passes(passes)
+const std::set<OptimizationPass>& optimizations::getMinimalPasses()
 {
+	static const std::set<OptimizationPass> passes = {
+		//splitting read-after-writes is not required, but register-allocation will most likely fail without
+		//promoting __private memory is required, since the memory is otherwise shared between all work-items
+		PROMOTE_PRIVATE_MEMORY, RUN_SINGLE_STEPS, PARTITION_VPM, SPLIT_READ_WRITES, LOOP_WORK_ITEMS, UNROLL_WORK_GROUPS
+	};
+	return passes;
+}
+
+const std::set<OptimizationPass>& optimizations::getBasicPasses()
+{
+	static const std::set<OptimizationPass> passes = {
+		PROMOTE_PRIVATE_MEMORY, MAP_LOCAL_MEMORY, LOAD_VIA_TMU, RUN_SINGLE_STEPS, COMBINE_VPM_SETUP, PARTITION_VPM, COMBINE_ROTATIONS, ELIMINATE, SPLIT_READ_WRITES, REORDER, LOOP_WORK_ITEMS, UNROLL_WORK_GROUPS
+	};
+	return passes;
+}
+
+const std::set<OptimizationPass>& optimizations::getSizePasses()
+{
+	static const std::set<OptimizationPass> passes = {
+		//unrolling loops and prefetching the DMA reads or TMU loads of the next loop iteration duplicate code
+		PROMOTE_PRIVATE_MEMORY, MAP_LOCAL_MEMORY, PRELOAD_CONSTANT_TABLES, LOAD_VIA_TMU, PROPAGATE_CONSTANTS, RUN_SINGLE_STEPS, COMBINE_REDUCTIONS, ELIMINATE_COMMON_SUBEXPRESSIONS, MOVE_LOOP_INVARIANTS, CONVERT_IFS, MERGE_TAIL_BLOCKS, MOVE_COLD_BLOCKS, PLACE_BLOCKS, FORWARD_MEMORY_ACCESSES, VECTORIZE_MEMORY_ACCESSES, COMBINE_VPM_SETUP, PARTITION_VPM, MERGE_ATOMIC_SECTIONS, COMBINE_LITERAL_LOADS, PASS_CONSTANTS_AS_UNIFORMS, COMBINE_ROTATIONS, FOLD_PACK_MODES, PROPAGATE_MOVES, ELIMINATE, ELIMINATE_REDUNDANT_FLAGS, PEEPHOLE, SPLIT_READ_WRITES, REORDER, COMBINE, LOOP_WORK_ITEMS, UNROLL_WORK_GROUPS
+	};
+	return passes;
+}
+
+static const std::set<OptimizationPass>& getPasses(const OptimizationLevel level)
+{
+	switch(level)
+	{
+		case OptimizationLevel::NONE:
+			return getMinimalPasses();
+		case OptimizationLevel::BASIC:
+			return getBasicPasses();
+		case OptimizationLevel::MEDIUM:
+		case OptimizationLevel::FULL:
+			return getDefaultPasses();
+		case OptimizationLevel::SIZE:
+			return getSizePasses();
+	}
+	throw CompilationError(CompilationStep::OPTIMIZER, "Unhandled optimization level", std::to_string(static_cast<unsigned>(level)));
+}
+
+//the passes only ever simplifying the code, so they can be run repeatedly
+//e.g. eliminating an instruction can result in more ALU operations to be combined and combining instructions can produce dead stores
+const std::set<OptimizationPass>& optimizations::getRepeatedPasses()
+{
+	static const std::set<OptimizationPass> passes = {
+		COMBINE_LITERAL_LOADS, COMBINE_ROTATIONS, ELIMINATE, COMBINE
+	};
+	return passes;
+}
+
+Optimizer::Optimizer(const Configuration& config) : Optimizer(config, getPasses(config.optimizationLevel))
+{
+}
+
+Optimizer::Optimizer(const Configuration& config, const std::set<OptimizationPass>& passes, const std::set<OptimizationPass>& repeatedPasses) :
+		config(config), passes(passes), repeatedPasses(repeatedPasses)
+{
+	if(!config.optimizationReportFile.empty())
+		report.reset(new OptimizationReport());
 }
 
 Optimizer::~Optimizer()
 {
 }
 
-static void runOptimizationPasses(const Module& module, Method& method, const Configuration& config, const std::set<OptimizationPass>& passes)
+static bool runOptimizationPass(const Module& module, Method& method, const Configuration& config, const OptimizationPass& pass, const unsigned iteration, std::vector<PassStatistics>* statistics)
+{
+	DEBUG_LOG(logging::endl);
+	DEBUG_LOG("Running pass: " << pass.name << logging::endl);
+	PassStatistics stats;
+	if(statistics != nullptr)
+	{
+		stats.passName = pass.name;
+		stats.iteration = iteration;
+		stats.instructionsBefore = method.countInstructions();
+		stats.nopsBefore = OptimizationReport::countNops(method);
+		stats.localsBefore = method.readLocals().size();
+	}
+	const auto startTime = std::chrono::steady_clock::now();
+	PROFILE_COUNTER(pass.index * 100, pass.name + " (before)", method.countInstructions());
+	PROFILE_START_DYNAMIC(pass.name);
+	bool changed = pass(module, method, config);
+	PROFILE_END_DYNAMIC(pass.name);
+	PROFILE_COUNTER_WITH_PREV((pass.index + 1) * 100, pass.name + " (after)", method.countInstructions(), pass.index * 100);
+	if(statistics != nullptr)
+	{
+		stats.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime);
+		stats.instructionsAfter = method.countInstructions();
+		stats.nopsAfter = OptimizationReport::countNops(method);
+		stats.localsAfter = method.readLocals().size();
+		statistics->push_back(stats);
+	}
+	return changed;
+}
+
+static void runOptimizationPasses(const Module& module, Method& method, const Configuration& config, const std::set<OptimizationPass>& passes, const std::set<OptimizationPass>& repeatedPasses, OptimizationReport* report)
 {
-    logging::debug() << "-----" << logging::endl;
-    logging::info() << "Running optimization passes for: " << method.name << logging::endl;
+    DEBUG_LOG("-----" << logging::endl);
+    INFO_LOG("Running optimization passes for: " << method.name << logging::endl);
     std::size_t numInstructions = method.countInstructions();
-    
+    std::vector<PassStatistics> statistics;
+
+    //only the repeatable passes which are actually enabled are repeated, after the last of them ran for the first time
+    std::vector<const OptimizationPass*> passesToRepeat;
     for(const OptimizationPass& pass : passes)
     {
-        logging::debug() << logging::endl;
-        logging::debug() << "Running pass: " << pass.name << logging::endl;
-        PROFILE_COUNTER(pass.index * 100, pass.name + " (before)", method.countInstructions());
-        PROFILE_START_DYNAMIC(pass.name);
-        pass(module, method, config);
-        PROFILE_END_DYNAMIC(pass.name);
-        PROFILE_COUNTER_WITH_PREV((pass.index + 1) * 100, pass.name + " (after)", method.countInstructions(), pass.index * 100);
+    	if(repeatedPasses.find(pass) != repeatedPasses.end())
+    		passesToRepeat.push_back(&pass);
     }
-    logging::info() << logging::endl;
+    bool repeatedPassChanged = false;
+
+    for(const OptimizationPass& pass : passes)
+    {
+        //on exceeding a budget, only the passes required for valid code are run
+        if(module.budget.check(CompilationStep::OPTIMIZER, &method) && getMinimalPasses().find(pass) == getMinimalPasses().end())
+        {
+        	DEBUG_LOG("Skipping optional pass: " << pass.name << logging::endl);
+        	continue;
+        }
+        bool changed = runOptimizationPass(module, method, config, pass, 1, report != nullptr ? &statistics : nullptr);
+        if(std::find(passesToRepeat.begin(), passesToRepeat.end(), &pass) == passesToRepeat.end())
+        	continue;
+        repeatedPassChanged = repeatedPassChanged || changed;
+        if(&pass != passesToRepeat.back())
+        	continue;
+        //rerun the repeatable passes until a fixed-point is reached
+        unsigned iteration = 1;
+        while(repeatedPassChanged && iteration < config.maxOptimizationIterations && !module.budget.check(CompilationStep::OPTIMIZER, &method))
+        {
+        	++iteration;
+        	DEBUG_LOG("Repeating optimization passes (iteration " << iteration << ")" << logging::endl);
+        	repeatedPassChanged = false;
+        	for(const OptimizationPass* repeatedPass : passesToRepeat)
+        		repeatedPassChanged = runOptimizationPass(module, method, config, *repeatedPass, iteration, report != nullptr ? &statistics : nullptr) || repeatedPassChanged;
+        }
+        if(repeatedPassChanged && config.maxOptimizationIterations > 1)
+        	DEBUG_LOG("Stopped repeating optimization passes after " << iteration << " iterations without reaching a fixed-point" << logging::endl);
+    }
+    if(report != nullptr)
+    	report->addKernel(method.name, std::move(statistics));
+    INFO_LOG(logging::endl);
     if (numInstructions != method.countInstructions()) {
-        logging::info() << "Optimizations done, changed number of instructions from " << numInstructions << " to " << method.countInstructions() << logging::endl;
+        INFO_LOG("Optimizations done, changed number of instructions from " << numInstructions << " to " << method.countInstructions() << logging::endl);
     }
     else {
-        logging::info() << "Optimizations done" << logging::endl;
+        INFO_LOG("Optimizations done" << logging::endl);
     }
-    logging::debug() << "-----" << logging::endl;
+    DEBUG_LOG("-----" << logging::endl);
     method.dumpInstructions();
 }
 
 void Optimizer::optimize(Module& module) const
 {
+	prepare(module);
+
 	std::vector<threading::BackgroundWorker> workers;
 	workers.reserve(module.getKernels().size());
+	for(Method* kernelFunc : module.getKernels())
+	{
+		auto f = [kernelFunc, &module, this]() -> void {
+			optimizeKernel(module, *kernelFunc);
+		};
+		workers.emplace(workers.end(), f, "Optimizer")->operator ()();
+	}
+	threading::BackgroundWorker::waitForAll(workers);
+	writeReport();
+}
+
+/*
+ * Replaces the reads of the parameters bound to constant values (see Configuration#specializedParameters) with a local initialized to the value,
+ * which is then propagated and folded by the optimizations like any other constant
+ */
+static void specializeParameters(Method& kernel, const Configuration& config)
+{
+	intermediate::InstructionArena::Scope arenaScope(kernel.getInstructionArena());
+	for(const ParameterSpecialization& binding : config.specializedParameters)
+	{
+		if(binding.kernelName != kernel.name)
+			continue;
+		if(binding.parameterIndex >= kernel.parameters.size())
+			throw CompilationError(CompilationStep::OPTIMIZER, "Specialized parameter index is out of range for kernel", kernel.name);
+		const Parameter& param = kernel.parameters.at(binding.parameterIndex);
+		if(param.type.isPointerType() || param.type.num != 1)
+			throw CompilationError(CompilationStep::OPTIMIZER, "Only scalar parameters can be specialized", param.to_string());
+
+		Literal value(false);
+		if(param.type.isFloatingType())
+			value = Literal(static_cast<double>(bit_cast<uint32_t, float>(binding.value)));
+		else
+		{
+			//the value is extended the same way as the UNIFORM is when loading the parameter
+			const unsigned numBits = param.type.getScalarBitCount();
+			int64_t extended = binding.value;
+			if(numBits < 32)
+			{
+				extended &= (int64_t{1} << numBits) - 1;
+				if(has_flag(param.decorations, ParameterDecorations::SIGN_EXTEND) && (extended & (int64_t{1} << (numBits - 1))) != 0)
+					extended -= int64_t{1} << numBits;
+			}
+			else if(has_flag(param.decorations, ParameterDecorations::SIGN_EXTEND))
+				extended = static_cast<int32_t>(binding.value);
+			value = Literal(static_cast<long>(extended));
+		}
+		DEBUG_LOG("Specializing parameter '" << param.name << "' of kernel '" << kernel.name << "' for the value " << value.to_string() << logging::endl);
+
+		const Value bound = kernel.addNewLocal(param.type, param.name, "bound");
+		FastSet<const LocalUser*> readers = param.getUsers(LocalUser::Type::READER);
+		for(const LocalUser* reader : readers)
+			const_cast<LocalUser*>(reader)->replaceLocal(&param, bound.local, LocalUser::Type::READER);
+		auto it = kernel.walkAllInstructions();
+		if(it.has<intermediate::BranchLabel>())
+			it.nextInBlock();
+		it.emplace(new intermediate::MoveOperation(bound, Value(value, param.type)));
+	}
+}
+
+void Optimizer::prepare(Module& module) const
+{
+	//the fused kernels can be selected to be compiled like any other kernel
+	fuseKernels(module, config);
+	//drop everything not used by the kernels, before any work is spent on it
+	removeUnusedMethods(module, config);
+	if(!config.specializedLocalSizes.empty())
+	{
+		//code specialized for a work-group size can only be run with this size, which is exactly what the required work-group size states
+		std::vector<std::string> localSizes;
+		for(std::size_t i = 0; i < 3; ++i)
+			localSizes.push_back(std::to_string(i < config.specializedLocalSizes.size() ? config.specializedLocalSizes.at(i) : 1));
+		for(Method* kernel : module.getKernels())
+		{
+			DEBUG_LOG("Specializing kernel '" << kernel->name << "' for the work-group size " << to_string<std::string>(localSizes, "x") << logging::endl);
+			kernel->metaData[MetaDataType::WORK_GROUP_SIZES] = localSizes;
+		}
+	}
+	if(!config.specializedParameters.empty())
+	{
+		for(Method* kernel : module.getKernels())
+			specializeParameters(*kernel, config);
+	}
 	for(auto& method : module.methods)
 	{
 		//PHI-nodes need to be eliminated before inlining functions
 		//since otherwise the phi-node is mapped to the initial label, not to the last label added by the functions (the real end of the original, but split up block)
+		intermediate::InstructionArena::Scope arenaScope(method->getInstructionArena());
 		PROFILE_COUNTER(90, "Eliminate Phi-nodes (before)", method->countInstructions());
 		eliminatePhiNodes(module, *method.get(), config);
 		PROFILE_COUNTER_WITH_PREV(95, "Eliminate Phi-nodes (after)", method->countInstructions(), 90);
 	}
-	for(Method* kernelFunc : module.getKernels())
+	//the methods are inlined bottom-up, so every called method is flattened and simplified only once,
+	//the callers (and at last the kernels) then only copy the already simplified bodies
+	//inlining modifies the called methods (which can be kernels too), so it is run for all methods before any kernel is optimized
+	for(Method* method : getInliningOrder(module))
 	{
-		Method& kernel = *kernelFunc;
+		std::shared_ptr<const std::string> cachedMethod;
+		{
+			intermediate::InstructionArena::Scope arenaScope(method->getInstructionArena());
+			//the preparation is required for all kernels, so only cancellation and aborting budgets are handled here
+			module.budget.check(CompilationStep::OPTIMIZER);
 
-		PROFILE_COUNTER(100, "Inline (before)", kernel.countInstructions());
-		inlineMethods(module, kernel, config);
-		PROFILE_COUNTER_WITH_PREV(110, "Inline (after)", kernel.countInstructions(), 100);
+			PROFILE_COUNTER(100, "Inline (before)", method->countInstructions());
+			inlineMethods(module, *method, config);
+			PROFILE_COUNTER_WITH_PREV(110, "Inline (after)", method->countInstructions(), 100);
+			//needs to run before the extensions are intrinsified, the bodies of inlined methods are already lowered
+			PROFILE_COUNTER(112, "Lower 64-bit operations (before)", method->countInstructions());
+			lowerLongOperations(module, *method, config);
+			PROFILE_COUNTER_WITH_PREV(114, "Lower 64-bit operations (after)", method->countInstructions(), 112);
+			if(!method->isKernel)
+			{
+				//the callees are already inlined, so methods of the same structure are simplified to the same body
+				const std::string cacheKey = config.functionCacheSize > 0 ? getFunctionCacheKey(*method, config) : "";
+				cachedMethod = cacheKey.empty() ? nullptr : findCachedFunction(cacheKey);
+				if(!cachedMethod)
+				{
+					//kernels are fully optimized afterwards anyway
+					PROFILE_COUNTER(120, "Simplify inlined method (before)", method->countInstructions());
+					runSteps(module, *method, config, getInlinedMethodSteps());
+					eliminateDeadStore(module, *method, config);
+					PROFILE_COUNTER_WITH_PREV(130, "Simplify inlined method (after)", method->countInstructions(), 120);
+					if(!cacheKey.empty())
+						cacheFunction(cacheKey, *method, config.functionCacheSize);
+				}
+			}
+		}
+		if(cachedMethod)
+		{
+			//the method is read into a new method, since the instructions can't be removed from the memory-pool of the old one
+			DEBUG_LOG("Using cached simplified body for method '" << method->name << "'" << logging::endl);
+			std::unique_ptr<Method> simplified(new Method(module));
+			deserializeMethod(module, *simplified, *cachedMethod);
+			auto it = std::find_if(module.methods.begin(), module.methods.end(), [method](const std::unique_ptr<Method>& m) -> bool
+			{
+				return m.get() == method;
+			});
+			it->swap(simplified);
+		}
 	}
-	for(Method* kernelFunc : module.getKernels())
+	//all calls are inlined into the kernels, so the called methods and the global data only used by them are not required anymore
+	removeUnusedMethods(module, config);
+	//the samplers used to read the images are only known after inlining, but need to be set before the image-reads are intrinsified
+	for(Method* kernel : module.getKernels())
+		intermediate::reserveImageConfigurations(module, *kernel);
+	//the kernels are optimized in parallel, so the offsets of the global data need to be fixed before
+	module.layoutGlobalData();
+}
+
+void Optimizer::optimizeKernel(const Module& module, Method& kernel) const
+{
+	intermediate::InstructionArena::Scope arenaScope(kernel.getInstructionArena());
+	//the preparation modifies the kernels without keeping track of the analyses
+	kernel.getAnalyses().invalidate();
+	//mapping the work-items onto the SIMD elements requires all elements to execute the same instructions
+	if(kernel.getAnalyses().getDivergence().hasDivergentControlFlow())
+		DEBUG_LOG("Kernel '" << kernel.name << "' has control-flow diverging between work-items" << logging::endl);
+	else
+		DEBUG_LOG("Kernel '" << kernel.name << "' has uniform control-flow for all work-items" << logging::endl);
+	//the counters are inserted before any optimization, so the counted blocks are the blocks of the source and the optimizations see the counters like any other code
+	if(config.instrumentBlocks)
+		instrumentBasicBlocks(module, kernel, config);
+	kernel.isFastPath = config.fastPathInstructions > 0 && kernel.countInstructions() <= config.fastPathInstructions;
+	if(kernel.isFastPath)
 	{
-		auto f = [kernelFunc, &module, this]() -> void {
-			runOptimizationPasses(module, *kernelFunc, config, passes);
-		};
-		workers.emplace(workers.end(), f, "Optimizer")->operator ()();
+		//for tiny kernels, the fixed costs of the passes outweigh the few instructions they could save
+		DEBUG_LOG("Compiling kernel '" << kernel.name << "' via the fast path" << logging::endl);
+		std::set<OptimizationPass> minimalPasses;
+		std::set_intersection(passes.begin(), passes.end(), getMinimalPasses().begin(), getMinimalPasses().end(), std::inserter(minimalPasses, minimalPasses.begin()));
+		runOptimizationPasses(module, kernel, config, minimalPasses, {}, report.get());
 	}
-	threading::BackgroundWorker::waitForAll(workers);
+	else
+		runOptimizationPasses(module, kernel, config, passes, repeatedPasses, report.get());
 }
 
 void Optimizer::addPass(const OptimizationPass& pass)
@@ -234,3 +746,13 @@ void Optimizer::removePass(const OptimizationPass& pass)
 {
 	passes.erase(pass);
 }
+
+void Optimizer::writeReport() const
+{
+	if(!report)
+		return;
+	std::ofstream file(config.optimizationReportFile, std::ios_base::out | std::ios_base::trunc);
+	report->writeJSON(file);
+	if(!file)
+		logging::warn() << "Failed to write optimization report to: " << config.optimizationReportFile << logging::endl;
+}
@@ -10,6 +10,9 @@
 #include <config.h>
 #include "../Module.h"
 #include "../intermediate/IntermediateInstruction.h"
+#include "../analysis/AnalysisManager.h"
+#include "OptimizationReport.h"
+#include <memory>
 #include <set>
 
 namespace vc4c
@@ -29,14 +32,19 @@ namespace vc4c
 			 */
 			using Pass = std::function<void(const Module&, Method&, const Configuration&)>;
 
-			OptimizationPass(const std::string& name, const Pass pass, const std::size_t index);
+			OptimizationPass(const std::string& name, const Pass pass, const std::size_t index, const analysis::AnalysisType preservedAnalyses = analysis::AnalysisType::NONE);
 
 			bool operator<(const OptimizationPass& other) const;
-			void operator()(const Module& module, Method& method, const Configuration& config) const;
+			/*
+			 * Runs the pass and returns whether the pass changed any instruction of the method
+			 */
+			bool operator()(const Module& module, Method& method, const Configuration& config) const;
 			bool operator==(const OptimizationPass& other) const;
 
 			std::string name;
 			std::size_t index;
+			//the cached analyses still valid after this pass ran, all other analyses are invalidated
+			analysis::AnalysisType preservedAnalyses;
 		private:
 			Pass pass;
 		};
@@ -53,33 +61,89 @@ namespace vc4c
 			 */
 			using Step = std::function<InstructionWalker(const Module&, Method&, InstructionWalker, const Configuration&)>;
 
-			OptimizationStep(const std::string& name, const Step step, const std::size_t index);
+			/*
+			 * The kinds of instructions the step can modify, if empty, the step is run on all instructions
+			 */
+			OptimizationStep(const std::string& name, const Step step, const std::size_t index, std::initializer_list<intermediate::InstructionKind> kinds = {});
 
 			bool operator<(const OptimizationStep& other) const;
 			InstructionWalker operator()(const Module& module, Method& method, InstructionWalker it, const Configuration& config) const;
 			bool operator==(const OptimizationStep& other) const;
 
+			/*
+			 * Whether the step needs to be run on instructions of the given kind
+			 */
+			bool appliesTo(intermediate::InstructionKind kind) const;
+
 			std::string name;
 			std::size_t index;
 		private:
 			Step step;
+			//bit-mask of the instruction kinds the step is run on
+			uint32_t kindMask;
 		};
 
 		/*
 		 * List of pre-defined optimization passes
 		 */
+		//unrolls loops with a small constant number of iterations, removing the overhead of the branches
+		extern const OptimizationPass UNROLL_LOOPS;
+		//promotes __private arrays to registers or per-QPU VPM areas, so they are not shared between work-items
+		extern const OptimizationPass PROMOTE_PRIVATE_MEMORY;
+		//stores small __local arrays in the VPM instead of accessing them via DMA
+		extern const OptimizationPass MAP_LOCAL_MEMORY;
+		//copies small __constant lookup tables into the VPM at the start of the kernel and reads the lookups from there
+		extern const OptimizationPass PRELOAD_CONSTANT_TABLES;
+		//reads read-only memory via the TMUs instead of the VPM, which does not require locking the hardware mutex
+		extern const OptimizationPass LOAD_VIA_TMU;
+		//requests the TMU loads of the next iteration of a loop while the current iteration is executed
+		extern const OptimizationPass PIPELINE_TMU_LOADS;
+		//propagates constant values across blocks and removes branches with constant conditions and the blocks never reached
+		extern const OptimizationPass PROPAGATE_CONSTANTS;
 		//runs all the single-step optimizations. Combining them results in fewer iterations over the instructions
 		extern const OptimizationPass RUN_SINGLE_STEPS;
+		//replaces the combination of all elements of a vector (e.g. the sum calculated by dot()) with log2(N) rotate-and-combine steps
+		extern const OptimizationPass COMBINE_REDUCTIONS;
+		//re-uses the results of identical calculations (e.g. of the index arithmetic) instead of calculating them again
+		extern const OptimizationPass ELIMINATE_COMMON_SUBEXPRESSIONS;
+		//moves calculations producing the same value in every iteration of a loop out of the loop
+		extern const OptimizationPass MOVE_LOOP_INVARIANTS;
+		//replaces branches to small blocks (e.g. of if-else constructs) with conditionally executed instructions
+		extern const OptimizationPass CONVERT_IFS;
+		//moves the blocks never executed according to the block-profile out of the frequently executed code
+		extern const OptimizationPass MOVE_COLD_BLOCKS;
+		//merges the identical instructions at the end of blocks jumping to the same block into a single block, only run when optimizing for size
+		extern const OptimizationPass MERGE_TAIL_BLOCKS;
+		//places the most frequently taken successor of every block directly after it, removing the branches to it
+		extern const OptimizationPass PLACE_BLOCKS;
 		//combines loadings of the same literal value within a small range of a basic block
 		extern const OptimizationPass COMBINE_LITERAL_LOADS;
-		//spills long-living, rarely written locals into the VPM
-		extern const OptimizationPass SPILL_LOCALS;
+		//passes the constants loaded in loops as additional UNIFORMs (see Configuration#maxUniformConstants)
+		extern const OptimizationPass PASS_CONSTANTS_AS_UNIFORMS;
+		//replaces DMA reads of values just written to or read from the same memory location with the known value
+		extern const OptimizationPass FORWARD_MEMORY_ACCESSES;
+		//combines the DMA accesses of consecutive scalar elements into DMA accesses of vectors
+		extern const OptimizationPass VECTORIZE_MEMORY_ACCESSES;
 		//tries to combine VPW/VPR configurations and reads/writes within basic blocks
 		extern const OptimizationPass COMBINE_VPM_SETUP;
+		//starts the DMA reads of the next iteration of a loop while the current iteration is executed
+		extern const OptimizationPass PREFETCH_DMA_READS;
+		//gives every QPU its own part of the VPM scratch area, so DMA accesses do not need to lock the hardware mutex
+		extern const OptimizationPass PARTITION_VPM;
+		//merges consecutive atomic operations within a block into a single section guarded by the hardware mutex
+		extern const OptimizationPass MERGE_ATOMIC_SECTIONS;
 		//combines duplicate vector rotations, e.g. introduced by vector-shuffle into a single rotation
 		extern const OptimizationPass COMBINE_ROTATIONS;
+		//folds type conversions (extensions, truncations, half-float conversions) into the pack- and unpack-modes of the instructions producing/consuming the value
+		extern const OptimizationPass FOLD_PACK_MODES;
+		//replaces the outputs of copies with their sources and merges copies into the instructions producing their sources
+		extern const OptimizationPass PROPAGATE_MOVES;
 		//eliminates useless instructions (dead store, move to same, add with zero, ...)
 		extern const OptimizationPass ELIMINATE;
+		//removes the setting of flags, which are already set to the same values by a previous instruction
+		extern const OptimizationPass ELIMINATE_REDUNDANT_FLAGS;
+		//replaces short sequences of instructions with simpler equivalents, driven by a table of rewrite-rules (redundant moves, double negations, ...)
+		extern const OptimizationPass PEEPHOLE;
 		//more like a de-optimization. Splits read-after-writes (except if the local is used only very locally), so the reordering and register-allocation have an easier job
 		extern const OptimizationPass SPLIT_READ_WRITES;
 		//re-order instructions to eliminate more NOPs and stall cycles
@@ -88,28 +152,68 @@ namespace vc4c
 		extern const OptimizationPass COMBINE;
 		//add (runtime-configurable) loop over the whole kernel execution, allowing for skipping some of the syscall overhead for kernels with many work-groups
 		extern const OptimizationPass UNROLL_WORK_GROUPS;
+		//runs several work-items one after the other on every QPU, if the required work-group size exceeds the number of QPUs
+		extern const OptimizationPass LOOP_WORK_ITEMS;
 
 		/*
-		 * The default optimization passes consist of all passes listed above.
+		 * The default optimization passes consist of all passes listed above, except for the passes only run when optimizing for size.
 		 * NOTE: Some of the passes are REQUIRED and the compilation will fail, if they are removed.
 		 * Other passes are not technically required, but e.g. make register-allocation a lot easier, thus improving the chance of successful register allocation greatly.
+		 *
+		 * The sets of passes are only built on first use, so loading the library without compiling anything does not construct them
+		 */
+		const std::set<OptimizationPass>& getDefaultPasses();
+		/*
+		 * The passes run for the lower optimization levels:
+		 * - the minimal passes are the passes required (or close to required) for generating valid code
+		 * - the basic passes additionally run the optimizations with a small impact on compilation time
+		 * - the size passes run the default passes not increasing the code size and additionally merge duplicate code
+		 */
+		const std::set<OptimizationPass>& getMinimalPasses();
+		const std::set<OptimizationPass>& getBasicPasses();
+		const std::set<OptimizationPass>& getSizePasses();
+		/*
+		 * The passes which may create new opportunities for each other.
+		 * If configured (see Configuration#maxOptimizationIterations), they are repeated until none of them changes the code anymore
 		 */
-		extern const std::set<OptimizationPass> DEFAULT_PASSES;
+		const std::set<OptimizationPass>& getRepeatedPasses();
 
 		class Optimizer
 		{
 		public:
-			Optimizer(const Configuration& config = { }, const std::set<OptimizationPass>& passes = DEFAULT_PASSES);
+			/*
+			 * Runs the passes selected by the optimization level of the configuration
+			 */
+			explicit Optimizer(const Configuration& config = { });
+			Optimizer(const Configuration& config, const std::set<OptimizationPass>& passes, const std::set<OptimizationPass>& repeatedPasses = getRepeatedPasses());
 			~Optimizer();
 
 			void optimize(Module& module) const;
+			/*
+			 * Runs the module-wide steps (elimination of phi-nodes, simplification and inlining of functions),
+			 * which need to be completed before the single kernels can be optimized independently
+			 */
+			void prepare(Module& module) const;
+			/*
+			 * Runs the optimization passes on a kernel of a prepared module.
+			 * Different kernels can be optimized in parallel
+			 */
+			void optimizeKernel(const Module& module, Method& kernel) const;
 
 			void addPass(const OptimizationPass& pass);
 			void removePass(const OptimizationPass& pass);
 
+			/*
+			 * Writes the statistics of the passes run for all kernels optimized so far, if configured (see Configuration#optimizationReportFile)
+			 */
+			void writeReport() const;
+
 		private:
 			Configuration config;
 			std::set<OptimizationPass> passes;
+			std::set<OptimizationPass> repeatedPasses;
+			//only set, if the report is enabled
+			std::unique_ptr<OptimizationReport> report;
 		};
 	}
 }
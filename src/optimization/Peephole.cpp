@@ -0,0 +1,250 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "Peephole.h"
+#include "../Logging.h"
+#include "../InstructionWalker.h"
+#include "../intermediate/IntermediateInstruction.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+using namespace vc4c;
+using namespace vc4c::optimizations;
+using namespace vc4c::intermediate;
+
+//the maximum number of consecutive instructions a rule can match
+static constexpr std::size_t MAX_WINDOW = 4;
+
+/*
+ * The symbolic operands of the rules.
+ *
+ * Within a rule, every occurrence of the same symbol has to match the same value
+ */
+enum class Symbol : unsigned char
+{
+	//no operand
+	NONE,
+	//arbitrary values
+	A,
+	B,
+	X,
+	//temporaries: locals written within the window which must not be read outside of it
+	T,
+	U,
+	//the literal values 0 and 0xFFFFFFFF
+	ZERO,
+	ALL_BITS
+};
+static constexpr std::size_t NUM_SYMBOLS = 8;
+
+struct InstructionPattern
+{
+	//the op-code of the operation or "mov" for a move
+	const char* opCode;
+	Symbol output;
+	Symbol firstArg;
+	Symbol secondArg;
+};
+
+enum class RewriteKind : unsigned char
+{
+	//replaces the whole window with the replacement instruction
+	REPLACE,
+	//removes the last instruction of the window and keeps all others
+	REMOVE_LAST
+};
+
+struct PeepholeRule
+{
+	const char* name;
+	std::size_t numInstructions;
+	InstructionPattern patterns[MAX_WINDOW];
+	RewriteKind kind;
+	InstructionPattern replacement;
+};
+
+static constexpr InstructionPattern NO_PATTERN{nullptr, Symbol::NONE, Symbol::NONE, Symbol::NONE};
+
+/*
+ * The rewrite-rules, sorted by number of instructions.
+ *
+ * The rules are in the format generated by an exhaustive search over the (unconditional, flag-less and unpacked) ALU operations,
+ * keeping only the sequences with a cheaper equivalent which is valid for all inputs.
+ * Since no commutativity is applied when matching, both operand orders are listed where they differ.
+ */
+static constexpr PeepholeRule RULES[] = {
+	{"or-with-self", 1, {{"or", Symbol::X, Symbol::A, Symbol::A}, NO_PATTERN, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"and-with-self", 1, {{"and", Symbol::X, Symbol::A, Symbol::A}, NO_PATTERN, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"min-with-self", 1, {{"min", Symbol::X, Symbol::A, Symbol::A}, NO_PATTERN, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"max-with-self", 1, {{"max", Symbol::X, Symbol::A, Symbol::A}, NO_PATTERN, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"v8min-with-self", 1, {{"v8min", Symbol::X, Symbol::A, Symbol::A}, NO_PATTERN, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"v8max-with-self", 1, {{"v8max", Symbol::X, Symbol::A, Symbol::A}, NO_PATTERN, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"xor-with-self", 1, {{"xor", Symbol::X, Symbol::A, Symbol::A}, NO_PATTERN, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::ZERO, Symbol::NONE}},
+	{"sub-with-self", 1, {{"sub", Symbol::X, Symbol::A, Symbol::A}, NO_PATTERN, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::ZERO, Symbol::NONE}},
+	{"move-chain", 2, {{"mov", Symbol::T, Symbol::A, Symbol::NONE}, {"mov", Symbol::X, Symbol::T, Symbol::NONE}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"move-back", 2, {{"mov", Symbol::B, Symbol::A, Symbol::NONE}, {"mov", Symbol::A, Symbol::B, Symbol::NONE}, NO_PATTERN, NO_PATTERN}, RewriteKind::REMOVE_LAST, NO_PATTERN},
+	{"double-not", 2, {{"not", Symbol::T, Symbol::A, Symbol::NONE}, {"not", Symbol::X, Symbol::T, Symbol::NONE}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"double-xor-all-bits", 2, {{"xor", Symbol::T, Symbol::A, Symbol::ALL_BITS}, {"xor", Symbol::X, Symbol::T, Symbol::ALL_BITS}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"double-xor", 2, {{"xor", Symbol::T, Symbol::A, Symbol::B}, {"xor", Symbol::X, Symbol::T, Symbol::B}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"double-xor", 2, {{"xor", Symbol::T, Symbol::A, Symbol::B}, {"xor", Symbol::X, Symbol::B, Symbol::T}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::A, Symbol::NONE}},
+	{"repeated-or", 2, {{"or", Symbol::T, Symbol::A, Symbol::B}, {"or", Symbol::X, Symbol::T, Symbol::B}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"or", Symbol::X, Symbol::A, Symbol::B}},
+	{"repeated-or", 2, {{"or", Symbol::T, Symbol::A, Symbol::B}, {"or", Symbol::X, Symbol::B, Symbol::T}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"or", Symbol::X, Symbol::A, Symbol::B}},
+	{"repeated-and", 2, {{"and", Symbol::T, Symbol::A, Symbol::B}, {"and", Symbol::X, Symbol::T, Symbol::B}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"and", Symbol::X, Symbol::A, Symbol::B}},
+	{"repeated-and", 2, {{"and", Symbol::T, Symbol::A, Symbol::B}, {"and", Symbol::X, Symbol::B, Symbol::T}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"and", Symbol::X, Symbol::A, Symbol::B}},
+	{"and-with-inverse", 2, {{"not", Symbol::T, Symbol::A, Symbol::NONE}, {"and", Symbol::X, Symbol::T, Symbol::A}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::ZERO, Symbol::NONE}},
+	{"and-with-inverse", 2, {{"not", Symbol::T, Symbol::A, Symbol::NONE}, {"and", Symbol::X, Symbol::A, Symbol::T}, NO_PATTERN, NO_PATTERN}, RewriteKind::REPLACE, {"mov", Symbol::X, Symbol::ZERO, Symbol::NONE}},
+	{"triple-not", 3, {{"not", Symbol::T, Symbol::A, Symbol::NONE}, {"not", Symbol::U, Symbol::T, Symbol::NONE}, {"not", Symbol::X, Symbol::U, Symbol::NONE}, NO_PATTERN}, RewriteKind::REPLACE, {"not", Symbol::X, Symbol::A, Symbol::NONE}}
+};
+
+using Bindings = std::array<const Value*, NUM_SYMBOLS>;
+
+static bool isTemporary(const Symbol symbol)
+{
+	return symbol == Symbol::T || symbol == Symbol::U;
+}
+
+static bool matchValue(const Symbol symbol, const Value& value, Bindings& bindings)
+{
+	switch(symbol)
+	{
+		case Symbol::NONE:
+			return false;
+		case Symbol::ZERO:
+			return value.hasLiteral(Literal(0L));
+		case Symbol::ALL_BITS:
+			return value.hasLiteral(Literal(0xFFFFFFFFUL));
+		default:
+		{
+			const Value*& bound = bindings[static_cast<std::size_t>(symbol)];
+			if(bound != nullptr)
+				return *bound == value;
+			if(isTemporary(symbol) && !value.hasType(ValueType::LOCAL))
+				return false;
+			bound = &value;
+			return true;
+		}
+	}
+}
+
+static bool matchInstruction(const IntermediateInstruction* instr, const InstructionPattern& pattern, Bindings& bindings)
+{
+	if(instr == nullptr || !instr->getOutput())
+		return false;
+	//any extra behavior (conditional execution, flags, signals, pack-modes, ...) is not covered by the rules
+	if(instr->hasSideEffects() || instr->conditional != COND_ALWAYS || instr->hasPackMode() || instr->hasUnpackMode())
+		return false;
+	if(std::strcmp(pattern.opCode, "mov") == 0)
+	{
+		const MoveOperation* move = dynamic_cast<const MoveOperation*>(instr);
+		if(move == nullptr || dynamic_cast<const VectorRotation*>(instr) != nullptr)
+			return false;
+		return matchValue(pattern.output, move->getOutput().get(), bindings) && matchValue(pattern.firstArg, move->getSource(), bindings);
+	}
+	const Operation* op = dynamic_cast<const Operation*>(instr);
+	if(op == nullptr || op->opCode.compare(pattern.opCode) != 0)
+		return false;
+	if(!matchValue(pattern.output, op->getOutput().get(), bindings) || !matchValue(pattern.firstArg, op->getFirstArg(), bindings))
+		return false;
+	if(op->getSecondArg())
+		return matchValue(pattern.secondArg, op->getSecondArg().get(), bindings);
+	return pattern.secondArg == Symbol::NONE;
+}
+
+static Value getBoundValue(const Symbol symbol, const Bindings& bindings, const DataType& type)
+{
+	if(symbol == Symbol::ZERO)
+		return Value(Literal(0L), type);
+	if(symbol == Symbol::ALL_BITS)
+		return Value(Literal(0xFFFFFFFFUL), type);
+	return *bindings[static_cast<std::size_t>(symbol)];
+}
+
+/*
+ * Tries to match the rule against the window starting at the given instruction.
+ *
+ * Returns whether the rule matched, in which case the window is already rewritten
+ */
+static bool applyRule(const PeepholeRule& rule, InstructionWalker it)
+{
+	std::array<InstructionWalker, MAX_WINDOW> window;
+	Bindings bindings;
+	bindings.fill(nullptr);
+	for(std::size_t i = 0; i < rule.numInstructions; ++i)
+	{
+		if(it.isEndOfBlock() || !matchInstruction(it.get(), rule.patterns[i], bindings))
+			return false;
+		//for the replacement, all but the last instruction may only write temporaries
+		if(rule.kind == RewriteKind::REPLACE && i + 1 < rule.numInstructions && !isTemporary(rule.patterns[i].output))
+			return false;
+		window[i] = it;
+		it.nextInBlock();
+	}
+	//the temporaries must not be read anywhere outside of the window
+	for(const Symbol temporary : {Symbol::T, Symbol::U})
+	{
+		const Value* val = bindings[static_cast<std::size_t>(temporary)];
+		if(val == nullptr)
+			continue;
+		for(const LocalUser* reader : val->local->getUsers(LocalUser::Type::READER))
+		{
+			if(std::none_of(window.begin(), window.begin() + rule.numInstructions, [reader](const InstructionWalker& w) -> bool { return w.get() == reader;}))
+				return false;
+		}
+	}
+
+	InstructionWalker& last = window[rule.numInstructions - 1];
+	DEBUG_LOG("Applying peephole rule '" << rule.name << "' to " << rule.numInstructions << " instruction(s) ending with: " << last->to_string() << logging::endl);
+	if(rule.kind == RewriteKind::REMOVE_LAST)
+	{
+		last.erase();
+		return true;
+	}
+	const Value output = last->getOutput().get();
+	const Value firstArg = getBoundValue(rule.replacement.firstArg, bindings, output.type);
+	if(std::strcmp(rule.replacement.opCode, "mov") == 0)
+	{
+		if(firstArg == output)
+			//moving to itself, can be removed completely
+			last.erase();
+		else
+			last.reset((new MoveOperation(output, firstArg))->copyExtrasFrom(last.get()));
+	}
+	else if(rule.replacement.secondArg == Symbol::NONE)
+		last.reset((new Operation(rule.replacement.opCode, output, firstArg))->copyExtrasFrom(last.get()));
+	else
+		last.reset((new Operation(rule.replacement.opCode, output, firstArg, getBoundValue(rule.replacement.secondArg, bindings, output.type)))->copyExtrasFrom(last.get()));
+	for(std::size_t i = 0; i + 1 < rule.numInstructions; ++i)
+		window[i].erase();
+	return true;
+}
+
+void optimizations::applyPeepholeRules(const Module& module, Method& method, const Configuration& config)
+{
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		//skip the label
+		InstructionWalker it = block.begin().nextInBlock();
+		while(!it.isEndOfBlock())
+		{
+			bool changed = false;
+			const InstructionWalker prev = it.copy().previousInBlock();
+			for(const PeepholeRule& rule : RULES)
+			{
+				if(applyRule(rule, it))
+				{
+					//re-check the instructions around the rewritten ones, since the rewrite may enable other rules
+					it = prev.copy().nextInBlock();
+					changed = true;
+					break;
+				}
+			}
+			if(!changed)
+				it.nextInBlock();
+		}
+	}
+}
@@ -0,0 +1,27 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <config.h>
+#include "../Module.h"
+
+namespace vc4c
+{
+	namespace optimizations
+	{
+		/*
+		 * Table-driven peep-hole optimization: matches the rewrite-rules (see Peephole.cpp) against windows of up to 4 consecutive instructions
+		 * within a basic block and replaces the matching instructions with the simpler equivalent.
+		 *
+		 * This removes e.g. redundant moves, double negations and or-/and-with-self
+		 */
+		void applyPeepholeRules(const Module& module, Method& method, const Configuration& config);
+	}
+}
+
+#endif /* PEEPHOLE_H */
@@ -5,246 +5,857 @@
  */
 
 #include "Reordering.h"
-#include "log.h"
+#include "Combiner.h"
+#include "Instrumentation.h"
+#include "../Logging.h"
+#include "../analysis/AnalysisManager.h"
 #include "../intermediate/Helper.h"
 #include "../Profiler.h"
 
+#include <algorithm>
+#include <limits>
+#include <memory>
+
 using namespace vc4c;
 using namespace vc4c::optimizations;
 using namespace vc4c::intermediate;
 
+InstructionWalker optimizations::moveInstructionUp(InstructionWalker dest, InstructionWalker it)
+{
+	/*
+	 * a b c d e f
+	 * f b c d e a
+	 * f a c d e b
+	 * f a b d e c
+	 * f a b c e d
+	 * f a b c d e
+	 */
+//	InstructionsIterator next = dest;
+//	while(next != it)
+//	{
+//		std::iter_swap(next, it);
+//		++next;
+//	}
+
+	/*!
+	 * a b c d e f
+	 * f a b c d e nil
+	 * f a b c d e
+	 */
+	auto res = dest.emplace(it.release());
+	it.erase();
+	return res;
+}
+
 /*
- * Finds the last instruction before the (list of) NOP(s) that is not a NOP -> the reason for the insertion of NOPs
+ * The latencies (in instructions) of the QPU hardware the scheduler knows about.
+ *
+ * A hard latency needs to be kept for the code to be correct and is filled up with NOPs, if there is no other instruction to schedule.
+ * A soft latency is the distance after which the dependent instruction can execute without stalling, it is only used to prioritize the instructions.
  */
-static InstructionWalker findPreviousInstruction(BasicBlock& basicBlock, const InstructionWalker pos)
+//"the SFU result is available in r4 two instructions after the SFU register is written" (page 36)
+static constexpr std::size_t SFU_LATENCY = 3;
+//"there must be at least two nonuniform-accessing instructions following a pointer change before uniforms can be accessed once more" (page 22)
+static constexpr std::size_t UNIFORM_ADDRESS_LATENCY = 3;
+//a TMU read stalls at least 9 cycles, when reading from the TMU cache (see REG_TMU_OUT)
+static constexpr std::size_t TMU_LOAD_LATENCY = 9;
+//the VPM read FIFO needs some cycles after a read setup, until the first value can be read without stalling
+static constexpr std::size_t VPM_READ_LATENCY = 3;
+//a value written into a physical register can only be read in the next but one instruction, accumulators can be read in the next instruction
+static constexpr std::size_t REGISTER_FILE_LATENCY = 2;
+
+//the number of live locals from which on the scheduling prefers instructions reducing the register pressure.
+//This is below the 68 registers (32 per physical file and 4 accumulators), since the files are not interchangeable (e.g. both operands of an instruction
+//can only be read from the same physical file, if they are the same register) and the register allocation inserts temporaries of its own
+static constexpr std::size_t REGISTER_PRESSURE_LIMIT = 56;
+
+//the flags are tracked like a register with a number not used by any hardware register
+static constexpr unsigned FLAGS_RESOURCE = 64;
+static constexpr std::size_t NO_NODE = std::numeric_limits<std::size_t>::max();
+
+struct Dependency
 {
-	PROFILE_START(findPreviousInstruction);
-	auto it = pos;
-	while(!it.isStartOfBlock())
+	std::size_t successor;
+	std::size_t hardLatency;
+	std::size_t softLatency;
+	DelayType delayType;
+};
+
+struct ScheduleNode
+{
+	IntermediateInstruction* instruction;
+	//the index of the (non-empty) instruction within the scheduled region, in the original order
+	std::size_t originalSlot;
+	std::vector<Dependency> successors;
+	std::size_t numPredecessors = 0;
+	//the first cycle the instruction can be scheduled without violating a hard latency
+	std::size_t earliestCycle = 0;
+	//the first cycle the instruction can be scheduled without stalling
+	std::size_t stallFreeCycle = 0;
+	//the reason for the NOPs to insert, if the instruction cannot be scheduled yet
+	DelayType delayType = DelayType::WAIT_REGISTER;
+	//the length of the longest (latency-weighted) path to the end of the region, used as priority
+	std::size_t criticalPath = 1;
+	std::size_t cycle = NO_NODE;
+	//the position within the scheduled instructions
+	std::size_t position = NO_NODE;
+	//whether the instruction is scheduled to be executed together with another instruction on the other ALU
+	bool isPaired = false;
+	//the locals read by the instruction, each listed once
+	std::vector<const Local*> readLocals;
+
+	ScheduleNode(IntermediateInstruction* instr, std::size_t slot) : instruction(instr), originalSlot(slot)
 	{
-		if(it.get() != nullptr && it->getOutput().hasValue)
-			break;
-		it.previousInBlock();
 	}
-	PROFILE_END(findPreviousInstruction);
-	return it;
-}
+};
+
+/*
+ * A delay encoded as NOPs in the original code: every later instruction accessing the resource needs to be scheduled
+ * at least the given latency after the source instruction
+ */
+struct PendingDelay
+{
+	std::size_t source;
+	std::size_t latency;
+	DelayType delayType;
+};
 
 /*
- * Finds an instruction within the basic block that does not access any of the given values
+ * The accesses to a local, a register or the flags seen so far in the region
  */
-static InstructionWalker findInstructionNotAccessing(BasicBlock& basicBlock, const InstructionWalker pos, FastSet<Value>& excludedValues)
+struct ResourceState
 {
-	std::size_t instrctionsLeft = REPLACE_NOP_MAX_INSTRUCTIONS_TO_CHECK;
-	auto it = pos;
-	while(instrctionsLeft > 0 && !it.isEndOfBlock())
+	std::size_t lastWriter = NO_NODE;
+	std::vector<std::size_t> readersSinceWrite;
+	std::vector<PendingDelay> pendingDelays;
+};
+
+/*
+ * The locals live within a basic block in the original order of the instructions, used to estimate the register pressure
+ */
+struct BlockPressure
+{
+	const BasicBlock& block;
+	const analysis::LivenessAnalysis& liveness;
+	//the position of the last instruction of the block reading the local
+	FastMap<const Local*, std::size_t> lastReads;
+	//the locals live before the instruction at the current position
+	FastSet<const Local*> liveLocals;
+	std::size_t position = 0;
+
+	BlockPressure(BasicBlock& block, const analysis::LivenessAnalysis& liveness) : block(block), liveness(liveness), liveLocals(liveness.getLiveIns(block))
 	{
-		if(it.get() == nullptr)
+		std::size_t pos = 0;
+		for(auto it = block.begin(); !it.isEndOfBlock(); it.nextInBlock())
 		{
-			//skip already replaced instructions
-			it.nextInBlock();
-			--instrctionsLeft;
-			continue;
+			if(it.get() == nullptr)
+				continue;
+			it->forUsedLocals([this, pos](const Local* local, LocalUser::Type type) -> void
+			{
+				if(has_flag(type, LocalUser::Type::READER))
+					lastReads[local] = pos;
+			});
+			++pos;
 		}
-		bool validReplacement = true;
-		PROFILE_START(checkExcludedValues);
-		if(it->getOutput().hasValue && excludedValues.find(it->getOutput().get()) != excludedValues.end())
+	}
+
+	/*
+	 * Whether the local is read by an instruction at the given position or after it (or after the block)
+	 */
+	bool isLiveAfter(const Local* local, std::size_t pos) const
+	{
+		auto it = lastReads.find(local);
+		return (it != lastReads.end() && it->second >= pos) || liveness.isLiveOut(block, local);
+	}
+
+	/*
+	 * Removes the locals last read by the instruction at the current position and adds the local written, if it is read afterwards
+	 */
+	void update(const IntermediateInstruction* instr)
+	{
+		++position;
+		instr->forUsedLocals([this](const Local* local, LocalUser::Type type) -> void
 		{
-			validReplacement = false;
-		}
-		for(const Value& arg : it->getArguments())
+			if(has_flag(type, LocalUser::Type::READER) && !isLiveAfter(local, position))
+				liveLocals.erase(local);
+		});
+		if(instr->hasValueType(ValueType::LOCAL) && isLiveAfter(instr->getOutput().get().local, position))
+			liveLocals.emplace(instr->getOutput().get().local);
+	}
+};
+
+/*
+ * A sequence of instructions within a basic block, which are scheduled together.
+ * The regions are separated by instructions which cannot be moved at all (e.g. labels, branches, memory barriers or mutex accesses)
+ */
+struct ScheduleRegion
+{
+	//all non-empty instruction positions of the region in the original order, including the NOPs removed for scheduling
+	std::vector<InstructionWalker> slots;
+	std::vector<ScheduleNode> nodes;
+
+	FastMap<const Local*, ResourceState> locals;
+	FastMap<unsigned, ResourceState> registers;
+	std::size_t lastSideEffect = NO_NODE;
+	std::size_t lastOutput = NO_NODE;
+	//the last instruction writing r4 (a SFU call or a TMU load signal) and the latencies until r4 can be read
+	std::size_t lastR4Producer = NO_NODE;
+	std::size_t r4HardLatency = 1;
+	std::size_t r4SoftLatency = 1;
+	DelayType r4DelayType = DelayType::WAIT_SFU;
+	std::size_t lastUniformAddressWrite = NO_NODE;
+	std::size_t lastVPMReadSetup = NO_NODE;
+
+	const BlockPressure& pressure;
+	//the position in the block after the last instruction of the region
+	std::size_t endPosition = 0;
+	//the locals live while scheduling, initially the ones live before the region
+	FastSet<const Local*> liveLocals;
+	//the number of not yet scheduled instructions reading the locals
+	FastMap<const Local*, std::size_t> remainingReaders;
+	//the maximum number of live locals in the original order and in the scheduled order
+	std::size_t originalMaxPressure;
+	std::size_t scheduledMaxPressure;
+
+	explicit ScheduleRegion(const BlockPressure& pressure) :
+		pressure(pressure), liveLocals(pressure.liveLocals), originalMaxPressure(pressure.liveLocals.size()), scheduledMaxPressure(pressure.liveLocals.size())
+	{
+	}
+
+	bool isLiveAfter(const Local* local) const
+	{
+		return pressure.isLiveAfter(local, endPosition);
+	}
+
+	void addDependency(std::size_t predecessor, std::size_t successor, std::size_t hardLatency, std::size_t softLatency, DelayType delayType = DelayType::WAIT_REGISTER)
+	{
+		if(predecessor == NO_NODE || predecessor == successor)
+			return;
+		nodes[predecessor].successors.push_back(Dependency{successor, hardLatency, std::max(hardLatency, softLatency), delayType});
+		++nodes[successor].numPredecessors;
+	}
+
+	ResourceState* getResource(const Value& val)
+	{
+		if(val.hasType(ValueType::LOCAL))
+			return &locals[val.local];
+		if(val.hasType(ValueType::REGISTER) && val.reg != REG_NOP)
+			return &registers[val.reg.num];
+		return nullptr;
+	}
+};
+
+static bool readsRegister(const IntermediateInstruction* instr, const Register& reg)
+{
+	for(const Value& arg : instr->getArguments())
+	{
+		if(arg.hasRegister(reg))
+			return true;
+	}
+	return false;
+}
+
+static bool writesRegister(const IntermediateInstruction* instr, std::size_t minNum, std::size_t maxNum)
+{
+	return instr->hasValueType(ValueType::REGISTER) && instr->getOutput().get().reg.num >= minNum && instr->getOutput().get().reg.num <= maxNum;
+}
+
+/*
+ * NOPs without a signal only encode a delay, which is converted to latencies between the instructions around them
+ */
+static bool isRemovableNop(const Nop* nop)
+{
+	return !nop->hasSideEffects() && nop->type != DelayType::BRANCH_DELAY && nop->type != DelayType::THREAD_END;
+}
+
+/*
+ * Instructions which cannot be moved regardless of their surrounding instructions
+ */
+static bool isFixedInstruction(InstructionWalker it)
+{
+	if(it.has<BranchLabel>() || it.has<Branch>() || it.has<MemoryBarrier>() || it.has<CombinedOperation>() || !it->mapsToASMInstruction())
+		return true;
+	//moving MUTEX_RELEASE or anything over MUTEX_ACQUIRE or MUTEX_RELEASE would extend the critical section
+	if(it->hasValueType(ValueType::REGISTER) && it->getOutput().get().hasRegister(REG_MUTEX))
+		return true;
+	return readsRegister(it.get(), REG_MUTEX);
+}
+
+/*
+ * Instructions which cannot be moved and which no other instruction can be moved over
+ */
+static bool isSchedulingBarrier(InstructionWalker it, const ScheduleRegion& region)
+{
+	if(isFixedInstruction(it))
+		return true;
+	const Nop* nop = it.get<Nop>();
+	if(nop != nullptr && !nop->hasSideEffects())
+		//the reason for the delay is not within this region (e.g. the instruction before is in another block), so the NOP needs to stay
+		return !isRemovableNop(nop) || region.lastOutput == NO_NODE;
+	return false;
+}
+
+/*
+ * Converts the NOP at the given slot of the region into delays for all following accesses to the resources the NOP waits for
+ */
+static void addNopDelay(ScheduleRegion& region, const Nop* nop, std::size_t slot)
+{
+	const std::size_t source = region.lastOutput;
+	const IntermediateInstruction* sourceInstr = region.nodes[source].instruction;
+	const PendingDelay delay{source, slot - region.nodes[source].originalSlot + 1, nop->type};
+	auto addDelay = [&delay](ResourceState& state) -> void
+	{
+		state.pendingDelays.push_back(delay);
+	};
+	switch(nop->type)
+	{
+		case DelayType::WAIT_REGISTER:
 		{
-			if(excludedValues.find(arg) != excludedValues.end())
+			ResourceState* output = region.getResource(sourceInstr->getOutput().get());
+			if(output != nullptr)
+				addDelay(*output);
+			if(sourceInstr->setFlags == SetFlag::SET_FLAGS)
+				addDelay(region.registers[FLAGS_RESOURCE]);
+			if(sourceInstr->getOutput().get().hasRegister(REG_VPM_IN_ADDR) || sourceInstr->getOutput().get().hasRegister(REG_VPM_OUT_ADDR))
 			{
-				validReplacement = false;
-				break;
+				addDelay(region.registers[REG_VPM_IO.num]);
+				addDelay(region.registers[REG_VPM_IN_BUSY.num]);
 			}
+			break;
 		}
-		PROFILE_END(checkExcludedValues);
-		//for now, skip everything setting and using flags/signals
-		if(validReplacement && (it->hasConditionalExecution() || it->hasSideEffects()))
+		case DelayType::WAIT_SFU:
+		case DelayType::WAIT_TMU:
+			//SFU and TMU calls as well as r4
+			for(unsigned num = REG_SFU_RECIP.num; num <= REG_TMU1_ADDRESS.num + 3; ++num)
+				addDelay(region.registers[num]);
+			addDelay(region.registers[REG_SFU_OUT.num]);
+			break;
+		case DelayType::WAIT_UNIFORM:
+			//UNIFORM reads and the TMU writes implicitly reading the UNIFORM stream
+			addDelay(region.registers[REG_UNIFORM.num]);
+			for(unsigned num = REG_TMU_ADDRESS.num; num <= REG_TMU1_ADDRESS.num + 3; ++num)
+				addDelay(region.registers[num]);
+			break;
+		default:
+			break;
+	}
+}
+
+static void addPendingDelays(ScheduleRegion& region, ResourceState& state, std::size_t node)
+{
+	for(const PendingDelay& delay : state.pendingDelays)
+		region.addDependency(delay.source, node, delay.latency, delay.latency, delay.delayType);
+}
+
+static void addNode(ScheduleRegion& region, InstructionWalker it)
+{
+	const std::size_t slot = region.slots.size();
+	region.slots.push_back(it);
+	const Nop* nop = it.get<Nop>();
+	if(nop != nullptr && isRemovableNop(nop))
+	{
+		addNopDelay(region, nop, slot);
+		return;
+	}
+	const std::size_t node = region.nodes.size();
+	region.nodes.emplace_back(it.get(), slot);
+	const IntermediateInstruction* instr = it.get();
+	const bool isRotation = it.has<VectorRotation>();
+
+	//read-after-write dependencies
+	auto addRead = [&](ResourceState& state, bool isLocal) -> void
+	{
+		if(state.lastWriter != NO_NODE)
 		{
-			validReplacement = false;
+			const IntermediateInstruction* writer = region.nodes[state.lastWriter].instruction;
+			//the input of a vector rotation must not be written in the previous instruction,
+			//packed values and values to unpack need to be in register-file A
+			const bool needsRegisterFile = isRotation || (isLocal && (writer->hasPackMode() || instr->hasUnpackMode()));
+			region.addDependency(state.lastWriter, node, needsRegisterFile ? REGISTER_FILE_LATENCY : 1, isLocal ? REGISTER_FILE_LATENCY : 1);
 		}
-		if(validReplacement && (it.has<Branch>() || it.has<BranchLabel>() || it.has<MemoryBarrier>()))
+		addPendingDelays(region, state, node);
+		state.readersSinceWrite.push_back(node);
+	};
+	for(const Value& arg : instr->getArguments())
+	{
+		ResourceState* state = region.getResource(arg);
+		if(state != nullptr)
+			addRead(*state, arg.hasType(ValueType::LOCAL));
+		std::vector<const Local*>& readLocals = region.nodes[node].readLocals;
+		if(arg.hasType(ValueType::LOCAL) && std::find(readLocals.begin(), readLocals.end(), arg.local) == readLocals.end())
 		{
-			//TODO prevent from re-ordering over memory fences? Not necessary, unless we re-oder memory accesses
-			//NEVER RE-ORDER BRANCHS, LABELS OR BARRIERS!
-			validReplacement = false;
+			readLocals.push_back(arg.local);
+			++region.remainingReaders[arg.local];
 		}
-		if(validReplacement && it.has<Nop>())
+	}
+	if(instr->hasConditionalExecution())
+		addRead(region.registers[FLAGS_RESOURCE], false);
+
+	//write-after-write and write-after-read dependencies
+	auto addWrite = [&](ResourceState& state) -> void
+	{
+		region.addDependency(state.lastWriter, node, 1, 1);
+		for(std::size_t reader : state.readersSinceWrite)
+			region.addDependency(reader, node, 1, 1);
+		addPendingDelays(region, state, node);
+		state.lastWriter = node;
+		state.readersSinceWrite.clear();
+		state.pendingDelays.clear();
+	};
+	if(instr->getOutput())
+	{
+		ResourceState* state = region.getResource(instr->getOutput().get());
+		if(state != nullptr)
+			addWrite(*state);
+	}
+	if(instr->setFlags == SetFlag::SET_FLAGS)
+		addWrite(region.registers[FLAGS_RESOURCE]);
+
+	//the instructions with side-effects (e.g. accessing the periphery, firing signals or setting flags) keep their order
+	if(instr->hasSideEffects())
+	{
+		region.addDependency(region.lastSideEffect, node, 1, 1);
+		region.lastSideEffect = node;
+	}
+
+	//latencies of the periphery
+	if(readsRegister(instr, REG_SFU_OUT) && region.lastR4Producer != NO_NODE)
+		region.addDependency(region.lastR4Producer, node, region.r4HardLatency, region.r4SoftLatency, region.r4DelayType);
+	if(writesRegister(instr, REG_SFU_RECIP.num, REG_SFU_LOG2.num))
+	{
+		region.lastR4Producer = node;
+		region.r4HardLatency = SFU_LATENCY;
+		region.r4SoftLatency = SFU_LATENCY;
+		region.r4DelayType = DelayType::WAIT_SFU;
+	}
+	if(instr->signal == Signaling::LOAD_TMU0 || instr->signal == Signaling::LOAD_TMU1)
+	{
+		region.lastR4Producer = node;
+		region.r4HardLatency = 1;
+		region.r4SoftLatency = TMU_LOAD_LATENCY;
+		region.r4DelayType = DelayType::WAIT_TMU;
+	}
+	if(readsRegister(instr, REG_UNIFORM) || writesRegister(instr, REG_TMU_ADDRESS.num, REG_TMU1_ADDRESS.num + 3))
+		region.addDependency(region.lastUniformAddressWrite, node, UNIFORM_ADDRESS_LATENCY, UNIFORM_ADDRESS_LATENCY, DelayType::WAIT_UNIFORM);
+	if(instr->hasValueType(ValueType::REGISTER) && instr->getOutput().get().hasRegister(REG_UNIFORM_ADDRESS))
+		region.lastUniformAddressWrite = node;
+	if(readsRegister(instr, REG_VPM_IO))
+		region.addDependency(region.lastVPMReadSetup, node, 1, VPM_READ_LATENCY);
+	if(instr->hasValueType(ValueType::REGISTER) && instr->getOutput().get().hasRegister(REG_VPM_IN_SETUP))
+		region.lastVPMReadSetup = node;
+
+	if(instr->getOutput())
+		region.lastOutput = node;
+}
+
+/*
+ * Returns by how many locals the number of live locals changes, when the instruction is scheduled next:
+ * the locals read for the last time are no longer live and the local written becomes live, if it is read afterwards
+ */
+static int getPressureDelta(const ScheduleRegion& region, const ScheduleNode& node)
+{
+	int delta = 0;
+	for(const Local* local : node.readLocals)
+	{
+		if(region.remainingReaders.at(local) == 1 && region.liveLocals.find(local) != region.liveLocals.end() && !region.isLiveAfter(local))
+			--delta;
+	}
+	if(node.instruction->hasValueType(ValueType::LOCAL))
+	{
+		const Local* output = node.instruction->getOutput().get().local;
+		auto readersIt = region.remainingReaders.find(output);
+		const bool isReadAfterwards = (readersIt != region.remainingReaders.end() && readersIt->second > (std::find(node.readLocals.begin(), node.readLocals.end(), output) != node.readLocals.end() ? 1u : 0u)) ||
+				region.isLiveAfter(output);
+		if(isReadAfterwards && region.liveLocals.find(output) == region.liveLocals.end())
+			++delta;
+	}
+	return delta;
+}
+
+/*
+ * Updates the live locals after the instruction is scheduled
+ */
+static void updatePressure(ScheduleRegion& region, const ScheduleNode& node)
+{
+	for(const Local* local : node.readLocals)
+	{
+		if(--region.remainingReaders.at(local) == 0 && !region.isLiveAfter(local))
+			region.liveLocals.erase(local);
+	}
+	if(node.instruction->hasValueType(ValueType::LOCAL))
+	{
+		const Local* output = node.instruction->getOutput().get().local;
+		auto readersIt = region.remainingReaders.find(output);
+		if((readersIt != region.remainingReaders.end() && readersIt->second > 0) || region.isLiveAfter(output))
+			region.liveLocals.emplace(output);
+	}
+	region.scheduledMaxPressure = std::max(region.scheduledMaxPressure, region.liveLocals.size());
+}
+
+/*
+ * Selects the better of the two ready instructions to be scheduled in the given cycle: instructions which do not stall are preferred over the ones which do,
+ * then instructions with a longer critical path and then the instruction appearing first in the original code.
+ *
+ * If the number of live locals reaches the REGISTER_PRESSURE_LIMIT, instructions reducing the register pressure are preferred over all other criteria,
+ * since a stall costs a few cycles while a failed register allocation requires spilling or another round of fixing the code
+ */
+static bool isBetterCandidate(const ScheduleRegion& region, std::size_t candidate, std::size_t best, std::size_t cycle)
+{
+	if(best == NO_NODE)
+		return true;
+	const ScheduleNode& node = region.nodes[candidate];
+	const ScheduleNode& bestNode = region.nodes[best];
+	if(region.liveLocals.size() >= REGISTER_PRESSURE_LIMIT)
+	{
+		const int delta = getPressureDelta(region, node);
+		const int bestDelta = getPressureDelta(region, bestNode);
+		if(delta != bestDelta)
+			return delta < bestDelta;
+	}
+	const bool isStallFree = node.stallFreeCycle <= cycle;
+	const bool isBestStallFree = bestNode.stallFreeCycle <= cycle;
+	if(isStallFree != isBestStallFree)
+		return isStallFree;
+	if(node.criticalPath != bestNode.criticalPath)
+		return node.criticalPath > bestNode.criticalPath;
+	return candidate < best;
+}
+
+/*
+ * List-scheduling of the dependency graph: in every cycle, the instruction with the longest critical path, which can be executed without stalling, is selected.
+ * If there is no such instruction, an instruction which stalls but keeps all hard latencies is selected, otherwise a NOP is inserted.
+ *
+ * Additionally, another ready instruction is selected to be executed on the other ALU in the same cycle, if both can be combined.
+ * The pairs are placed next to each other, so they are merged by #combineOperations.
+ */
+static std::vector<std::size_t> scheduleNodes(ScheduleRegion& region)
+{
+	for(auto it = region.nodes.rbegin(); it != region.nodes.rend(); ++it)
+	{
+		for(const Dependency& dep : it->successors)
+			it->criticalPath = std::max(it->criticalPath, dep.softLatency + region.nodes[dep.successor].criticalPath);
+	}
+
+	//the node-indices in the scheduled order, NO_NODE for inserted NOPs
+	std::vector<std::size_t> schedule;
+	std::vector<std::size_t> readyNodes;
+	for(std::size_t i = 0; i < region.nodes.size(); ++i)
+	{
+		if(region.nodes[i].numPredecessors == 0)
+			readyNodes.push_back(i);
+	}
+	std::size_t cycle = 0;
+	while(!readyNodes.empty())
+	{
+		std::size_t best = NO_NODE;
+		for(std::size_t index : readyNodes)
 		{
-			//replacing NOP with NOP will violate the delay (e.g. for branches, SFU)
-			validReplacement = false;
+			if(region.nodes[index].earliestCycle <= cycle && isBetterCandidate(region, index, best, cycle))
+				best = index;
 		}
-		if(validReplacement && !it->mapsToASMInstruction())
+		if(best == NO_NODE)
 		{
-			//skip every instruction, which is not mapped to machine code, since otherwise the delay for the NOP will be violated
-			validReplacement = false;
+			//no instruction can be scheduled without violating a hard latency
+			schedule.push_back(NO_NODE);
+			++cycle;
+			continue;
 		}
-		if(validReplacement && it->getOutput() && it->getOutput().get().hasRegister(REG_MUTEX))
+		//the successors of the selected instruction are not ready yet, so all other ready instructions are independent of it
+		std::size_t partner = NO_NODE;
+		bool isPartnerFirst = false;
+		for(std::size_t index : readyNodes)
 		{
-			//never move MUTEX_RELEASE, but MUTEX_ACQUIRE can be moved, so a general test on REG_MUTEX is wrong
-			validReplacement = false;
-			//Also, never move any instruction over MUTEX_RELEASE to not expand the critical section
-			return basicBlock.end();
+			if(index == best || region.nodes[index].earliestCycle > cycle || !isBetterCandidate(region, index, partner, cycle))
+				continue;
+			if(canCombineInstructions(region.nodes[best].instruction, region.nodes[index].instruction))
+			{
+				partner = index;
+				isPartnerFirst = false;
+			}
+			else if(canCombineInstructions(region.nodes[index].instruction, region.nodes[best].instruction))
+			{
+				partner = index;
+				isPartnerFirst = true;
+			}
 		}
-		if(validReplacement && ((it->getArgument(0) && it->getArgument(0).get().hasRegister(REG_MUTEX)) || (it->getArgument(1) && it->getArgument(1).get().hasRegister(REG_MUTEX))))
+		std::vector<std::size_t> selected;
+		if(partner != NO_NODE && isPartnerFirst)
+			selected = {partner, best};
+		else if(partner != NO_NODE)
+			selected = {best, partner};
+		else
+			selected = {best};
+		for(std::size_t index : selected)
 		{
-			//TODO prevent MUTEX_ACQUIRE from being re-ordered?
-			//Re-ordering MUTEX_ACQUIRE extends the critical section (maybe a lot!)
-			//-> Would need to prohibit anything after MUTEX_ACQUIRE from being re-ordered (similar to MUTEX_RELEASE)
-			//-> only move a maximum amount of instructions (e.g. short more than VPM wait delay)?
-			validReplacement = false;
-			return basicBlock.end();
-
+			readyNodes.erase(std::find(readyNodes.begin(), readyNodes.end(), index));
+			ScheduleNode& node = region.nodes[index];
+			node.cycle = cycle;
+			node.position = schedule.size();
+			node.isPaired = selected.size() > 1;
+			schedule.push_back(index);
+			updatePressure(region, node);
 		}
-		if(validReplacement)
+		for(std::size_t index : selected)
 		{
-			logging::debug() << "Found instruction not using any of the excluded values (" << to_string<Value, FastSet<Value>>(excludedValues) << "): " << it->to_string() << logging::endl;
-			break;
+			for(const Dependency& dep : region.nodes[index].successors)
+			{
+				ScheduleNode& successor = region.nodes[dep.successor];
+				if(cycle + dep.hardLatency > successor.earliestCycle)
+				{
+					successor.earliestCycle = cycle + dep.hardLatency;
+					successor.delayType = dep.delayType;
+				}
+				successor.stallFreeCycle = std::max(successor.stallFreeCycle, cycle + dep.softLatency);
+				if(--successor.numPredecessors == 0)
+					readyNodes.push_back(dep.successor);
+			}
 		}
+		++cycle;
+	}
+	return schedule;
+}
 
-		//otherwise add all outputs by instructions in between (the NOP and the replacement), since they could be used as input in the following instructions
-		if(it->getOutput() && !it->getOutput().get().hasRegister(REG_NOP))
+static void scheduleRegion(ScheduleRegion& region)
+{
+	if(region.nodes.size() < 2)
+		return;
+	std::vector<std::size_t> schedule = scheduleNodes(region);
+	if(schedule.size() > region.slots.size())
+		//the greedy schedule is longer than the original code, keep the original order
+		return;
+	if(region.scheduledMaxPressure > REGISTER_PRESSURE_LIMIT && region.scheduledMaxPressure > region.originalMaxPressure)
+	{
+		//the schedule keeps more locals live than the original code, which would make the register allocation more likely to fail
+		DEBUG_LOG("Keeping original order of " << region.nodes.size() << " instructions, since the schedule increases the register pressure from " <<
+				region.originalMaxPressure << " to " << region.scheduledMaxPressure << " live locals" << logging::endl);
+		return;
+	}
+	bool isChanged = schedule.size() != region.slots.size();
+	for(std::size_t i = 0; i < schedule.size() && !isChanged; ++i)
+		isChanged = schedule[i] == NO_NODE || region.nodes[schedule[i]].originalSlot != i;
+	if(!isChanged)
+		return;
+
+	//the single instructions filling the delay of a hard latency must not be combined with their neighbors, since this would shorten the delay
+	for(const ScheduleNode& node : region.nodes)
+	{
+		for(const Dependency& dep : node.successors)
 		{
-			excludedValues.insert(it->getOutput().get());
-			//make sure, SFU/TMU calls are not moved over other SFU/TMU calls
-			//this prevents nop-sfu-... from being replaced with sfu-sfu-...
-			if(it->getOutput().get().hasRegister(REG_SFU_EXP2) || it->getOutput().get().hasRegister(REG_SFU_LOG2) || it->getOutput().get().hasRegister(REG_SFU_RECIP)
-					|| it->getOutput().get().hasRegister(REG_SFU_RECIP_SQRT) || it->getOutput().get().hasRegister(REG_TMU_ADDRESS))
+			if(dep.hardLatency < 2)
+				continue;
+			for(std::size_t pos = node.position + 1; pos < schedule.size(); ++pos)
 			{
-				excludedValues.emplace(Value(REG_SFU_EXP2, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_SFU_LOG2, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_SFU_OUT, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_SFU_RECIP, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_SFU_RECIP_SQRT, TYPE_FLOAT));
-				excludedValues.emplace(Value(REG_TMU_ADDRESS, TYPE_VOID.toPointerType()));
+				if(schedule[pos] == NO_NODE)
+					continue;
+				ScheduleNode& filler = region.nodes[schedule[pos]];
+				if(filler.cycle >= region.nodes[dep.successor].cycle)
+					break;
+				if(!filler.isPaired)
+					filler.instruction->canBeCombined = false;
 			}
 		}
-		--instrctionsLeft;
-		it.nextInBlock();
 	}
-	if(instrctionsLeft == 0)
-		it = basicBlock.end();
-	return it;
+
+	//the removed NOPs are deleted when going out of scope
+	std::vector<std::unique_ptr<IntermediateInstruction>> removedNops;
+	for(InstructionWalker& slot : region.slots)
+	{
+		IntermediateInstruction* instr = slot.release();
+		if(instr->is<Nop>() && isRemovableNop(instr->as<Nop>()))
+			removedNops.emplace_back(instr);
+	}
+	for(std::size_t i = 0; i < schedule.size(); ++i)
+	{
+		if(schedule[i] == NO_NODE)
+		{
+			//fill the delay with a NOP of the reason of the delay
+			const std::size_t next = std::find_if(schedule.begin() + i, schedule.end(), [](std::size_t index) -> bool {return index != NO_NODE;}) - schedule.begin();
+			region.slots[i].reset(new Nop(region.nodes[schedule[next]].delayType));
+		}
+		else
+			region.slots[i].reset(region.nodes[schedule[i]].instruction);
+	}
+	//the remaining slots stay empty and are removed afterwards
+	DEBUG_LOG("Scheduled " << region.nodes.size() << " instructions into " << schedule.size() << " instructions (previously " << region.slots.size() << ")" << logging::endl);
 }
 
 /*
- * Finds a suitable instruction within this basic block to replace the NOP with, without violating the reason for the NOP.
- * Also, this instruction MUST not be dependent on any instruction in between the NOP and the replacement-instruction
+ * The maximum number of instructions speculatively hoisted from a block into its predecessor, above the conditional branch to the block
+ */
+static constexpr std::size_t MAX_SPECULATED_INSTRUCTIONS = 8;
+
+/*
+ * Returns the position of the branches ending the block, or the end of the block, if it has no branches at the end
  */
-static InstructionWalker findReplacementCandidate(BasicBlock& basicBlock, const InstructionWalker pos, const DelayType nopReason)
+static InstructionWalker findTrailingBranches(BasicBlock& block)
 {
-	PROFILE_START(findReplacementCandidate);
-	FastSet<Value> excludedValues;
-	InstructionWalker replacementIt = basicBlock.end();
-	switch(nopReason)
-	{
-		case DelayType::BRANCH_DELAY:
-			//This type of NOPs do not yet exist (they are created in CodeGenerator)
-			PROFILE_END(findReplacementCandidate);
-			return basicBlock.end();
-		case DelayType::THREAD_END:
-			//there are no more instructions after THREND
-			PROFILE_END(findReplacementCandidate);
-			return basicBlock.end();
-		case DelayType::WAIT_REGISTER:
+	InstructionWalker it = block.end();
+	InstructionWalker pos = it;
+	while(!it.isStartOfBlock())
+	{
+		it.previousInBlock();
+		if(it.get() == nullptr)
+			continue;
+		if(!it.has<Branch>())
+			break;
+		pos = it;
+	}
+	return pos;
+}
+
+/*
+ * Whether the instruction can be executed before the branch into its block, even if the branch is not taken,
+ * i.e. it only calculates a value from locals, which is not used on the other paths
+ */
+static bool isSpeculatable(const IntermediateInstruction* instr)
+{
+	if(!instr->is<Operation>() && !instr->is<LoadImmediate>() && !(instr->is<MoveOperation>() && !instr->is<VectorRotation>()))
+		return false;
+	if(instr->hasSideEffects() || instr->hasConditionalExecution() || instr->setFlags == SetFlag::SET_FLAGS || !instr->hasValueType(ValueType::LOCAL))
+		return false;
+	return std::all_of(instr->getArguments().begin(), instr->getArguments().end(), [](const Value& arg) -> bool
+	{
+		return !arg.hasType(ValueType::REGISTER) || arg.hasRegister(REG_ELEMENT_NUMBER) || arg.hasRegister(REG_QPU_NUMBER);
+	});
+}
+
+/*
+ * Moves the first instructions of blocks with a single predecessor to the end of the predecessor (before its branches), forming super-blocks,
+ * so the scheduling of the predecessor can use them to fill its delays (e.g. the latencies of TMU loads or SFU calls issued at its end).
+ *
+ * If the predecessor has no other successor, the instructions are moved in order until the first instruction which cannot be moved over,
+ * like merging both blocks. Otherwise, the independent calculations are speculatively executed for the other successors too,
+ * which is only done if their results are not used there and the predecessor is not executed more often (e.g. within a loop the block is not part of)
+ */
+static std::size_t formSuperBlocks(Method& method)
+{
+	const analysis::ControlFlowGraph& cfg = method.getAnalyses().getControlFlowGraph();
+	const analysis::LivenessAnalysis& liveness = method.getAnalyses().getLiveness();
+	const analysis::LoopAnalysis& loops = method.getAnalyses().getLoops();
+	std::size_t numHoisted = 0;
+	for(BasicBlock& block : method.getBasicBlocks())
+	{
+		const std::vector<analysis::CFGPredecessor>& predecessors = cfg.getPredecessors(block);
+		if(predecessors.size() != 1 || predecessors.front().block == &block)
+			continue;
+		BasicBlock& predecessor = *predecessors.front().block;
+		std::vector<const BasicBlock*> otherSuccessors;
+		for(const BasicBlock* successor : cfg.getSuccessors(predecessor))
+		{
+			if(successor != &block && std::find(otherSuccessors.begin(), otherSuccessors.end(), successor) == otherSuccessors.end())
+				otherSuccessors.push_back(successor);
+		}
+		const bool isSpeculative = !otherSuccessors.empty();
+		if(isSpeculative && std::any_of(loops.getLoops().begin(), loops.getLoops().end(), [&](const analysis::Loop& loop) -> bool
 		{
-			//can insert any instruction which does not access the given register/local
-			const InstructionWalker lastInstruction = findPreviousInstruction(basicBlock, pos);
-			if(lastInstruction.isStartOfBlock())
+			return loop.contains(predecessor) && !loop.contains(block);
+		}))
+			continue;
+		InstructionWalker insertIt = findTrailingBranches(predecessor);
+		std::vector<const Branch*> branches;
+		for(InstructionWalker it = insertIt.copy(); !it.isEndOfBlock(); it.nextInBlock())
+		{
+			if(it.has<Branch>())
+				branches.push_back(it.get<const Branch>());
+		}
+		//moving instructions setting flags in front of conditional branches would change the branches
+		const bool hasConditionalBranch = std::any_of(branches.begin(), branches.end(), [](const Branch* branch) -> bool { return !branch->isUnconditional();});
+
+		//the locals accessed by the instructions staying in the block, which the following instructions can't be moved over
+		FastSet<const Local*> writtenLocals;
+		FastSet<const Local*> readLocals;
+		bool isPrefix = true;
+		std::size_t numSpeculated = 0;
+		for(InstructionWalker it = block.begin().nextInBlock(); !it.isEndOfBlock() && numSpeculated < MAX_SPECULATED_INSTRUCTIONS;)
+		{
+			if(it.get() == nullptr)
 			{
-				//this can e.g. happen, if the vector rotation is the first instruction in a basic block
-				//TODO for now, we can't handle this case, since there may be several writing instructions jumping to the block
-				logging::debug() << "Can't find reason for NOP in block: " << basicBlock.begin()->to_string() << logging::endl;
-				return basicBlock.end();
+				it.nextInBlock();
+				continue;
 			}
-			excludedValues.insert(lastInstruction->getOutput().get());
-			if(lastInstruction->getOutput().get().hasRegister(REG_VPM_IN_ADDR))
+			if(isFixedInstruction(it))
+				break;
+			bool canBeMoved = false;
+			if(!isSpeculative && isPrefix)
+				canBeMoved = !it.has<SemaphoreAdjustment>() && !(hasConditionalBranch && it->setFlags == SetFlag::SET_FLAGS);
+			else if(!it.has<Nop>() && isSpeculatable(it.get()))
 			{
-				excludedValues.emplace(Value(REG_VPM_IN_BUSY, TYPE_UNKNOWN));
-				excludedValues.emplace(Value(REG_VPM_IO, TYPE_UNKNOWN));
+				const Local* output = it->getOutput().get().local;
+				canBeMoved = writtenLocals.find(output) == writtenLocals.end() && readLocals.find(output) == readLocals.end() &&
+						std::none_of(it->getArguments().begin(), it->getArguments().end(), [&writtenLocals](const Value& arg) -> bool
+						{
+							return arg.hasType(ValueType::LOCAL) && writtenLocals.find(arg.local) != writtenLocals.end();
+						}) &&
+						std::none_of(branches.begin(), branches.end(), [output](const Branch* branch) -> bool { return branch->readsLocal(output);}) &&
+						std::none_of(otherSuccessors.begin(), otherSuccessors.end(), [&liveness, output](const BasicBlock* successor) -> bool { return liveness.isLiveIn(*successor, output);});
 			}
-			if(lastInstruction->getOutput().get().hasRegister(REG_VPM_OUT_ADDR))
+			if(!canBeMoved)
 			{
-				excludedValues.emplace(Value(REG_VPM_OUT_BUSY, TYPE_UNKNOWN));
-				excludedValues.emplace(Value(REG_VPM_IO, TYPE_UNKNOWN));
+				//the following (independent) instructions can still be speculated
+				if(!isSpeculatable(it.get()) && !it.has<Nop>())
+					break;
+				isPrefix = false;
+				it->forUsedLocals([&writtenLocals, &readLocals](const Local* local, LocalUser::Type type) -> void
+				{
+					if(has_flag(type, LocalUser::Type::WRITER))
+						writtenLocals.emplace(local);
+					if(has_flag(type, LocalUser::Type::READER))
+						readLocals.emplace(local);
+				});
+				it.nextInBlock();
+				continue;
 			}
-			PROFILE_START(findInstructionNotAccessing);
-			replacementIt = findInstructionNotAccessing(basicBlock, pos, excludedValues);
-			PROFILE_END(findInstructionNotAccessing);
-			break;
-		}
-		case DelayType::WAIT_SFU:
-		case DelayType::WAIT_TMU:
-		{
-			//can insert any instruction which doesn't access SFU/TMU or accumulator r4
-			excludedValues.emplace(Value(REG_SFU_EXP2, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_SFU_LOG2, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_SFU_OUT, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_SFU_RECIP, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_SFU_RECIP_SQRT, TYPE_FLOAT));
-			excludedValues.emplace(Value(REG_TMU_ADDRESS, TYPE_VOID.toPointerType()));
-			PROFILE_START(findInstructionNotAccessing);
-			replacementIt = findInstructionNotAccessing(basicBlock, pos, excludedValues);
-			PROFILE_END(findInstructionNotAccessing);
-			break;
+			if(isSpeculative)
+				++numSpeculated;
+			insertIt.emplace(it.release()).nextInBlock();
+			it.erase();
+			++numHoisted;
 		}
 	}
-	PROFILE_END(findReplacementCandidate);
-	return replacementIt;
+	return numHoisted;
 }
 
-InstructionWalker optimizations::moveInstructionUp(InstructionWalker dest, InstructionWalker it)
-{
-	/*
-	 * a b c d e f
-	 * f b c d e a
-	 * f a c d e b
-	 * f a b d e c
-	 * f a b c e d
-	 * f a b c d e
-	 */
-//	InstructionsIterator next = dest;
-//	while(next != it)
-//	{
-//		std::iter_swap(next, it);
-//		++next;
-//	}
-
-	/*!
-	 * a b c d e f
-	 * f a b c d e nil
-	 * f a b c d e
-	 */
-	auto res = dest.emplace(it.release());
-	it.erase();
-	return res;
-}
+//the factor by which the regions scheduled together may be larger for hot blocks
+static constexpr std::size_t HOT_BLOCK_REORDERING_FACTOR = 4;
 
-static void replaceNOPs(BasicBlock& basicBlock, Method& method)
+static void scheduleBasicBlock(BasicBlock& basicBlock, const std::size_t maxInstructions, const analysis::LivenessAnalysis& liveness)
 {
+	BlockPressure pressure(basicBlock, liveness);
+	std::unique_ptr<ScheduleRegion> region(new ScheduleRegion(pressure));
+	auto finishRegion = [&pressure, &region]() -> void
+	{
+		region->endPosition = pressure.position;
+		scheduleRegion(*region);
+		region.reset(new ScheduleRegion(pressure));
+	};
 	InstructionWalker it = basicBlock.begin();
 	while(!it.isEndOfBlock())
 	{
-		const Nop* nop = it.get<Nop>();
-		//only replace NOPs without side-effects (e.g. signal)
-		if(nop != nullptr && !nop->hasSideEffects())
+		if(it.get() == nullptr)
 		{
-			InstructionWalker replacementIt = findReplacementCandidate(basicBlock, it, nop->type);
-			if(!replacementIt.isEndOfBlock())
-			{
-				// replace NOP with instruction, reset instruction at position (do not yet erase, otherwise iterators are wrong!)
-				logging::debug() << "Replacing NOP with: " << replacementIt->to_string() << logging::endl;
-				bool cannotBeCombined = !it->canBeCombined;
-				it.reset(replacementIt.release());
-				if(cannotBeCombined)
-					it->canBeCombined = false;
-			}
+			it.nextInBlock();
+			continue;
+		}
+		if(region->slots.size() >= maxInstructions)
+			//limit the size of the regions to not spend too much time on huge linear programs
+			finishRegion();
+		if(isSchedulingBarrier(it, *region))
+		{
+			region->endPosition = pressure.position;
+			scheduleRegion(*region);
+			//the new region starts after the barrier
+			pressure.update(it.get());
+			region.reset(new ScheduleRegion(pressure));
+		}
+		else
+		{
+			addNode(*region, it);
+			pressure.update(it.get());
+			region->originalMaxPressure = std::max(region->originalMaxPressure, pressure.liveLocals.size());
 		}
 		it.nextInBlock();
 	}
+	finishRegion();
 }
 
 void optimizations::splitReadAfterWrites(const Module& module, Method& method, const Configuration& config)
@@ -267,10 +878,11 @@ void optimizations::splitReadAfterWrites(const Module& module, Method& method, c
 				{
 					//only insert instruction, if local is used afterwards (and not just in the next few instructions)
 					//or the pack-mode is set, since in that case, the register-file A MUST be used, so it cannot be read in the next instruction
+					//the same applies to reading with an unpack-mode
 					//also vector-rotations MUST be on accumulator, but the input MUST NOT be written in the previous instruction, so they are also split up
-					if(lastInstruction->hasPackMode() || it.has<VectorRotation>() || !lastInstruction.getBasicBlock()->isLocallyLimited(lastInstruction, lastWrittenTo))
+					if(lastInstruction->hasPackMode() || it->hasUnpackMode() || it.has<VectorRotation>() || !lastInstruction.getBasicBlock()->isLocallyLimited(lastInstruction, lastWrittenTo))
 					{
-						logging::debug() << "Inserting NOP to split up read-after-write before: " << it->to_string() << logging::endl;
+						DEBUG_LOG("Inserting NOP to split up read-after-write before: " << it->to_string() << logging::endl);
 						//emplacing after the last instruction instead of before this one fixes errors with wrote-label-read, which then becomes
 						//write-nop-label-read instead of write-label-nop-read and the combiner can find a reason for the NOP
 						lastInstruction.copy().nextInBlock().emplace(new Nop(DelayType::WAIT_REGISTER));
@@ -292,15 +904,24 @@ void optimizations::reorderWithinBasicBlocks(const Module& module, Method& metho
 {
     /*
      * TODO re-order instructions to:
-     * 2. combine instructions(try to pair instruction from ADD and MUL ALU together, or moves)
-     * 3. split up VPM setup and wait VPM wait, so the delay can be used productively (only possible if we allow reordering over mutex-release).
-     *    How many instructions to try to insert? 3?
+     * - split up VPM setup and wait VPM wait, so the delay can be used productively (only possible if we allow reordering over mutex-release).
      */
-	for(BasicBlock& block : method.getBasicBlocks())
+	const std::size_t numHoisted = formSuperBlocks(method);
+	if(numHoisted > 0)
 	{
-		// remove NOPs by inserting instructions which do not violate the reason for the NOP
-		PROFILE(replaceNOPs, block, method);
+		DEBUG_LOG("Moved " << numHoisted << " instructions into the preceding blocks to be scheduled together" << logging::endl);
+		method.getAnalyses().invalidate(analysis::AnalysisType::LIVENESS);
 	}
+	//the live locals at the block boundaries are used to track the register pressure while scheduling
+	const analysis::LivenessAnalysis& liveness = method.getAnalyses().getLiveness();
+	//the instructions are only moved within their block, so the blocks can be processed in parallel
+	method.forAllBasicBlocksInParallel([&method, &config, &liveness](BasicBlock& block) -> void
+	{
+		//blocks measured to be hot (see Configuration#blockProfile) are worth the time for scheduling larger regions
+		const std::size_t maxInstructions = config.maxReorderingInstructions * (isHotBlock(method, block, config) ? HOT_BLOCK_REORDERING_FACTOR : 1);
+		// replace the NOPs with independent instructions and hide the latencies of the periphery
+		PROFILE(scheduleBasicBlock, block, maxInstructions, liveness);
+	});
 
 	//after all re-orders are done, remove empty instructions
 	method.cleanEmptyInstructions();
@@ -322,11 +943,27 @@ InstructionWalker optimizations::moveRotationSourcesToAccumulators(const Module&
 		//if the local is either written in another block or the usage-range exceeds the accumulator threshold, move to temporary
 		if(writer.isStartOfBlock() || !writer.getBasicBlock()->isLocallyLimited(writer, loc))
 		{
+			//re-use the temporary of a previous rotation of the same local, if it is close enough to still be mapped to an accumulator
+			InstructionWalker copy = it.copy().previousInBlock();
+			for(std::size_t i = 0; i < ACCUMULATOR_THRESHOLD_HINT && !copy.isStartOfBlock(); ++i)
+			{
+				if(copy.has<MoveOperation>() && !copy.has<VectorRotation>() && !copy->hasConditionalExecution() && !copy->hasPackMode() && !copy->hasUnpackMode() &&
+						copy->getArgument(0).get().hasLocal(loc) && copy->getOutput().get().hasType(ValueType::LOCAL) &&
+						copy->getOutput().get().local->name.find("%vector_rotation") == 0 && copy->getOutput().get().local->getUsers(LocalUser::Type::WRITER).size() == 1)
+				{
+					DEBUG_LOG("Re-using temporary for source of vector-rotation: " << it->to_string() << logging::endl);
+					it->replaceLocal(loc, copy->getOutput().get().local, LocalUser::Type::READER);
+					return it;
+				}
+				if(copy.has() && copy->writesLocal(loc))
+					break;
+				copy.previousInBlock();
+			}
 			InstructionWalker mapper = it.copy().previousInBlock();
 			//insert mapper before first NOP
 			while(mapper.copy().previousInBlock().has<Nop>())
 				mapper.previousInBlock();
-			logging::debug() << "Moving source of vector-rotation to temporary for: " << it->to_string() << logging::endl;
+			DEBUG_LOG("Moving source of vector-rotation to temporary for: " << it->to_string() << logging::endl);
 			const Value tmp = method.addNewLocal(loc->type, "%vector_rotation");
 			mapper.emplace(new MoveOperation(tmp, loc->createReference()));
 			it->replaceLocal(loc, tmp.local, LocalUser::Type::READER);
@@ -27,6 +27,16 @@ namespace vc4c
 
 		void splitReadAfterWrites(const Module& module, Method& method, const Configuration& config);
 
+		/*
+		 * Schedules the instructions of every basic block via a dependency-graph, so the NOPs are replaced with independent instructions
+		 * and the latencies of the periphery (SFU, TMU, VPM and the physical register-files) are hidden, if possible.
+		 * Independent instructions which can be executed on the ADD and MUL ALU at once are placed next to each other to be combined (see #combineOperations).
+		 * The number of live locals is tracked while scheduling: near the number of available registers, instructions ending live ranges are preferred
+		 * and schedules increasing the maximum register pressure beyond the limit are discarded.
+		 *
+		 * Before, the first instructions of blocks with a single predecessor are moved to the end of the predecessor (forming super-blocks), so they can be scheduled together.
+		 * Calculations not used on the other paths are also moved above conditional branches, if this does not move them into a loop.
+		 */
 		void reorderWithinBasicBlocks(const Module& module, Method& method, const Configuration& config);
 
 		InstructionWalker moveRotationSourcesToAccumulators(const Module& module, Method& method, InstructionWalker it, const Configuration& config);
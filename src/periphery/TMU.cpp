@@ -6,7 +6,7 @@
 
 #include "TMU.h"
 #include "../InstructionWalker.h"
-#include "log.h"
+#include "../Logging.h"
 
 using namespace vc4c;
 using namespace vc4c::periphery;
@@ -55,31 +55,47 @@ std::string TextureType::to_string() const
 	throw CompilationError(CompilationStep::GENERAL, "Unhandled texture-type", std::to_string(value));
 }
 
-Global* periphery::reserveImageConfiguration(Module& module, const Value& image)
+Global* periphery::reserveImageConfiguration(Module& module, const Value& image, const uint32_t samplerSetup)
 {
 	if(!image.type.getImageType().hasValue)
 		throw CompilationError(CompilationStep::GENERAL, "Can't reserve global data for image-configuration of non-image type", image.type.to_string());
 	if(!image.hasType(ValueType::LOCAL))
 		throw CompilationError(CompilationStep::GENERAL, "Cannot reserve global data for non-local image", image.to_string());
+	const std::string name = ImageType::toImageConfigurationName(image.local->name);
+	for(Global& global : module.globalData)
+	{
+		if(global.name.compare(name) != 0)
+			continue;
+		//all reads of an image share the same configuration
+		const Value& setup = global.value.hasType(ValueType::CONTAINER) ? global.value.container.elements.at(1) : global.value;
+		if(static_cast<uint32_t>(setup.literal.integer) != samplerSetup)
+			throw CompilationError(CompilationStep::GENERAL, "Reading an image with different wrap- or filter-modes is not supported", image.to_string());
+		return &global;
+	}
 	//TODO 3 UNIFORMS for image-array and 3D image?
 	const unsigned char bufferSize = image.type.getImageType().get()->dimensions > 2 || image.type.getImageType().get()->isImageArray ? 3 : 2;
-	logging::debug() << "Reserving a buffer of " << static_cast<unsigned>(bufferSize) << " UNIFORMs for the image-configuration of " << image.to_string() << logging::endl;
-	auto it = module.globalData.emplace(module.globalData.end(), Global(ImageType::toImageConfigurationName(image.local->name), TYPE_INT32.toVectorType(bufferSize), INT_ZERO));
+	DEBUG_LOG("Reserving a buffer of " << static_cast<unsigned>(bufferSize) << " UNIFORMs for the image-configuration of " << image.to_string() << logging::endl);
+	Value value(INT_ZERO);
+	if(samplerSetup != 0)
+	{
+		value = Value(ContainerValue(), TYPE_INT32.toVectorType(bufferSize));
+		for(unsigned char i = 0; i < bufferSize; ++i)
+			value.container.elements.push_back(i == 1 ? Value(Literal(static_cast<long>(samplerSetup)), TYPE_INT32) : INT_ZERO);
+	}
+	auto it = module.globalData.emplace(module.globalData.end(), Global(name, TYPE_INT32.toVectorType(bufferSize), value));
 	return &(*it);
 }
 
-InstructionWalker periphery::insertGeneralReadTMU(InstructionWalker it, const Value& dest, const Value& addr)
+InstructionWalker periphery::insertGeneralReadTMU(InstructionWalker it, const Value& dest, const Value& addr, const bool useTMU1)
 {
-	//TODO mutex lock required?
-
-	//this is wrong, e.g. REG_TMU_ADDRESS is not a memory-address, but the normalized coordinates (within the image)
+	//no mutex lock required, since every QPU has its own request and response FIFOs for the TMUs and the VPM is not used
 	//1) write address to TMU_S register
-	it.emplace(new intermediate::MoveOperation(TMU_GENERAL_READ_ADDRESS, addr));
+	it.emplace(new intermediate::MoveOperation(useTMU1 ? TMU1_GENERAL_READ_ADDRESS : TMU_GENERAL_READ_ADDRESS, addr));
 	it.nextInBlock();
 	//"General-memory lookups are performed by writing to just the s-parameter, using the absolute memory address" (page 41)
 	//2) trigger loading of TMU
 	it.emplace(new intermediate::Nop(intermediate::DelayType::WAIT_TMU));
-	it->setSignaling(Signaling::LOAD_TMU0);
+	it->setSignaling(useTMU1 ? Signaling::LOAD_TMU1 : Signaling::LOAD_TMU0);
 	it.nextInBlock();
 	//3) read value from R4
 	it.emplace(new intermediate::MoveOperation(dest, TMU_READ_REGISTER));
@@ -123,7 +139,17 @@ InstructionWalker periphery::insertReadTMU(Method& method, InstructionWalker it,
 	// 5. read from r4 (stalls 9 to 20 cycles)
 	it.emplace(new intermediate::MoveOperation(dest, TMU_READ_REGISTER));
 	it.nextInBlock();
-	// 6. TODO reset UNIFORM pointer? for next work-group iteration, or disable when used with images?
+	// 6. the UNIFORM pointer can't be reset, since its original value is not known, see #hasTextureAccesses
 
 	return it;
 }
+
+bool periphery::hasTextureAccesses(const Method& method)
+{
+	bool writesUniformAddress = false;
+	method.forAllInstructions([&writesUniformAddress](const intermediate::IntermediateInstruction* instr) -> void
+	{
+		writesUniformAddress = writesUniformAddress || (instr->hasValueType(ValueType::REGISTER) && instr->getOutput().get().hasRegister(REG_UNIFORM_ADDRESS));
+	});
+	return writesUniformAddress;
+}
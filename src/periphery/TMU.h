@@ -17,6 +17,7 @@ namespace vc4c
 	{
 		const Value TMU_READ_REGISTER(REG_TMU_OUT, TYPE_UNKNOWN);
 		const Value TMU_GENERAL_READ_ADDRESS(REG_TMU_ADDRESS, TYPE_INT32.toVectorType(16).toPointerType());
+		const Value TMU1_GENERAL_READ_ADDRESS(REG_TMU1_ADDRESS, TYPE_INT32.toVectorType(16).toPointerType());
 		const Value TMU_COORD_S_REGISTER(REG_TMU_COORD_S_U_X, TYPE_FLOAT.toVectorType(16));
 		const Value TMU_COORD_T_REGISTER(REG_TMU_COORD_T_V_Y, TYPE_FLOAT.toVectorType(16));
 
@@ -202,11 +203,16 @@ namespace vc4c
 			/*
 			 * "T Wrap Mode (0, 1, 2, 3 = repeat, clamp, mirror, border)"
 			 */
-			BITFIELD_ENTRY(WrapT, WrapMode, 2, Triple)
+			BITFIELD_ENTRY(WrapT, WrapMode, 2, Tuple)
 			/*
 			 * "S Wrap Mode (0, 1, 2, 3 = repeat, clamp, mirror, border)"
 			 */
-			BITFIELD_ENTRY(WrapS, WrapMode, 0, Triple)
+			BITFIELD_ENTRY(WrapS, WrapMode, 0, Tuple)
+
+			constexpr operator uint32_t() const
+			{
+				return value;
+			}
 		};
 
 		/*
@@ -286,25 +292,39 @@ namespace vc4c
 		 * Prepares a segment of the global data to be used as buffer for the image-configuration for this image
 		 *
 		 * Depending on the type of the image, this segment contains of 2 (or 3) 32-bit values, which are by default zeroed out.
+		 * The second value (the TextureAccessSetup) is initialized with the given wrap- and filter-modes, which are determined by the sampler used
+		 * and need to be kept by the host implementation.
 		 * On setting the image as kernel-parameter, the host implementation writes the image-configuration into this buffer.
 		 *
 		 * Returns the global the buffer is allocated at, to be used to set the UNIFORM pointer as well as to be set into the parameter-info.
 		 */
-		Global* reserveImageConfiguration(Module& module, const Value& image);
+		Global* reserveImageConfiguration(Module& module, const Value& image, const uint32_t samplerSetup = 0);
 
 		/*
 		 * Perform a general 32-bit memory lookup via the TMU.
 		 *
 		 * Actually, 16 separate 32-bit memory loads are performed for the 16 elements of the address-vector.
+		 * Since both TMUs have their own request queue, alternating between TMU0 and TMU1 allows for two loads in flight.
 		 */
-		InstructionWalker insertGeneralReadTMU(InstructionWalker it, const Value& dest, const Value& addr);
+		InstructionWalker insertGeneralReadTMU(InstructionWalker it, const Value& dest, const Value& addr, const bool useTMU1 = false);
 
 		/*
 		 * Inserts a read via TMU from the given image-parameter at the coordinates x, y (y optional), which need to be converted to [0, 1] prior to this call
 		 * and stores the result in dest.
+		 *
+		 * NOTE: The UNIFORM pointer is set to the image-configuration and not restored afterwards, so no more UNIFORMs can be read
+		 * (see #hasTextureAccesses)
 		 */
 		InstructionWalker insertReadTMU(Method& method, InstructionWalker it, const Value& image, const Value& dest, const Value& xCoord, const Optional<Value>& yCoord = NO_VALUE);
 
+		/*
+		 * Whether the method reads images via the TMU and therefore modifies the UNIFORM pointer.
+		 *
+		 * Since the original UNIFORM address is unknown to the kernel, all UNIFORMs need to be read before the first image access,
+		 * which requires the work-groups to be batched (see optimizations#unrollWorkGroups).
+		 */
+		bool hasTextureAccesses(const Method& method);
+
 	} /* namespace periphery */
 } /* namespace vc4c */
 
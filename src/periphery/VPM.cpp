@@ -5,7 +5,12 @@
  */
 
 #include "VPM.h"
-#include "log.h"
+#include "../Logging.h"
+#include "../intermediate/Helper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
 
 using namespace vc4c;
 using namespace vc4c::periphery;
@@ -432,26 +437,6 @@ InstructionWalker periphery::insertWriteDMA(Method& method, InstructionWalker it
 //	return it;
 //}
 
-std::pair<DataType, uint8_t> getBestVectorSize(const long numBytes)
-{
-	for(uint8_t numElements = 16; numElements > 0; --numElements)
-	{
-		//16, 15, 14, ... elements of type...
-		for(uint8_t typeSize = 4; typeSize > 0; typeSize /= 2)
-		{
-			//4 bytes (int), 2 bytes(short), 1 byte (char)
-			if(numBytes % (numElements * typeSize) == 0)
-			{
-				DataType result = typeSize == 4 ? TYPE_INT32 : typeSize == 2 ? TYPE_INT16 : TYPE_INT8;
-				result.num = numElements;
-				uint8_t numVectors = numBytes / (numElements * typeSize);
-				return std::make_pair(result, numVectors);
-			}
-		}
-	}
-	throw CompilationError(CompilationStep::LLVM_2_IR, "Failed to find element- and vector-sizes matching the given amount of bytes", std::to_string(numBytes));
-}
-
 static uint8_t calculateAddress(const DataType& type, unsigned byteOffset)
 {
 	//see Broadcom spec, pages 57, 58 and figure 8 (page 54)
@@ -513,6 +498,91 @@ InstructionWalker VPM::insertWriteVPM(InstructionWalker it, const Value& src, bo
 	return it;
 }
 
+/*
+ * Calculates the VPM row (the address for 32-bit horizontal access) and the element within this row for the byte-offset within the area
+ */
+static std::pair<Value, Value> insertCalculateRowAndElement(Method& method, InstructionWalker& it, const VPMArea& area, const Value& inAreaOffset)
+{
+	const Value rowOffset = method.addNewLocal(TYPE_INT32, "%vpm_row_offset");
+	const Value row = method.addNewLocal(TYPE_INT32, "%vpm_row");
+	const Value elementOffset = method.addNewLocal(TYPE_INT32, "%vpm_element_offset");
+	const Value element = method.addNewLocal(TYPE_INT8, "%vpm_element");
+	it.emplace(new Operation("shr", rowOffset, inAreaOffset, Value(Literal(6L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("add", row, rowOffset, Value(Literal(static_cast<long>(area.baseOffset / VPM_ROW_SIZE)), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("shr", elementOffset, inAreaOffset, Value(Literal(2L), TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new Operation("and", element, elementOffset, Value(Literal(15L), TYPE_INT8)));
+	it.nextInBlock();
+	return std::make_pair(row, element);
+}
+
+InstructionWalker VPM::insertReadVPM(Method& method, InstructionWalker it, const Value& dest, const VPMArea& area, const Value& inAreaOffset)
+{
+	const auto rowAndElement = insertCalculateRowAndElement(method, it, area, inAreaOffset);
+	const Value rowData = method.addNewLocal(TYPE_INT32.toVectorType(16), "%vpm_row_data");
+	//1) configure reading the whole row from VPM into QPU
+	const VPRSetup genericSetup(VPRGenericSetup(getVPMSize(TYPE_INT32), 1));
+	it.emplace(new Operation("or", VPM_IN_SETUP_REGISTER, rowAndElement.first, Value(Literal(static_cast<long>(genericSetup)), TYPE_INT32)));
+	it.nextInBlock();
+	//2) read row from VPM
+	it.emplace(new MoveOperation(rowData, VPM_IO_REGISTER));
+	it.nextInBlock();
+	//3) extract the element
+	return insertVectorExtraction(it, method, rowData, rowAndElement.second, dest);
+}
+
+InstructionWalker VPM::insertWriteVPM(Method& method, InstructionWalker it, const Value& src, const VPMArea& area, const Value& inAreaOffset, bool useMutex)
+{
+	const auto rowAndElement = insertCalculateRowAndElement(method, it, area, inAreaOffset);
+	const Value rowData = method.addNewLocal(TYPE_INT32.toVectorType(16), "%vpm_row_data");
+	it = insertLockMutex(it, useMutex);
+	//1) read the whole row
+	const VPRSetup readSetup(VPRGenericSetup(getVPMSize(TYPE_INT32), 1));
+	it.emplace(new Operation("or", VPM_IN_SETUP_REGISTER, rowAndElement.first, Value(Literal(static_cast<long>(readSetup)), TYPE_INT32)));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(rowData, VPM_IO_REGISTER));
+	it.nextInBlock();
+	//2) replace the element
+	it = insertVectorInsertion(it, method, rowData, rowAndElement.second, src);
+	//3) write the row back
+	const VPWSetup writeSetup(VPWGenericSetup(getVPMSize(TYPE_INT32), 1));
+	it.emplace(new Operation("or", VPM_OUT_SETUP_REGISTER, rowAndElement.first, Value(Literal(static_cast<long>(writeSetup)), TYPE_INT32)));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(VPM_IO_REGISTER, rowData));
+	it.nextInBlock();
+	it = insertUnlockMutex(it, useMutex);
+	return it;
+}
+
+InstructionWalker VPM::insertSpillRegister(Method& method, InstructionWalker it, const Value& src, const VPMArea& area)
+{
+	//the area has one row per QPU, so the row of the current QPU is the first row of the area plus the QPU number
+	const Value setup = method.addNewLocal(TYPE_INT32, "%spill_setup");
+	const VPWSetup writeSetup(VPWGenericSetup(getVPMSize(TYPE_INT32), 1, static_cast<uint8_t>(area.baseOffset / VPM_ROW_SIZE)));
+	it.emplace(new LoadImmediate(setup, Literal(static_cast<long>(writeSetup))));
+	it.nextInBlock();
+	it.emplace(new Operation("add", VPM_OUT_SETUP_REGISTER, setup, Value(REG_QPU_NUMBER, TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(VPM_IO_REGISTER, src));
+	it.nextInBlock();
+	return it;
+}
+
+InstructionWalker VPM::insertReloadRegister(Method& method, InstructionWalker it, const Value& dest, const VPMArea& area)
+{
+	const Value setup = method.addNewLocal(TYPE_INT32, "%spill_setup");
+	const VPRSetup readSetup(VPRGenericSetup(getVPMSize(TYPE_INT32), 1, 1, static_cast<uint8_t>(area.baseOffset / VPM_ROW_SIZE)));
+	it.emplace(new LoadImmediate(setup, Literal(static_cast<long>(readSetup))));
+	it.nextInBlock();
+	it.emplace(new Operation("add", VPM_IN_SETUP_REGISTER, setup, Value(REG_QPU_NUMBER, TYPE_INT8)));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(dest, VPM_IO_REGISTER));
+	it.nextInBlock();
+	return it;
+}
+
 InstructionWalker VPM::insertReadRAM(InstructionWalker it, const Value& memoryAddress, const DataType& type, bool useMutex)
 {
 	if(memoryAddress.hasType(ValueType::LOCAL) && memoryAddress.local != nullptr)
@@ -529,8 +599,10 @@ InstructionWalker VPM::insertReadRAM(InstructionWalker it, const Value& memoryAd
 	//http://maazl.de/project/vc4asm/doc/VideoCoreIV-addendum.html
 
 	//initialize VPM DMA for reading from host
+	//only the actual elements are transferred, so a 3-element vector is read with a single access, which does not depend on the padding element
+	//(e.g. the elements of vload3 combined by optimizations#vectorizeMemoryAccesses, which are not padded in memory)
 	const long dmaMode = getVPMDMAMode(type);
-	VPRSetup dmaSetup(VPRDMASetup(dmaMode, type.getVectorWidth(true) % 16 /* 0 => 16 */, 1 % 16 /* 0 => 16 */));
+	VPRSetup dmaSetup(VPRDMASetup(dmaMode, type.getVectorWidth() % 16 /* 0 => 16 */, 1 % 16 /* 0 => 16 */));
 	dmaSetup.dmaSetup.setAddress(0);
 	it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<long>(dmaSetup))));
 	it.nextInBlock();
@@ -564,8 +636,10 @@ InstructionWalker VPM::insertWriteRAM(InstructionWalker it, const Value& memoryA
 	it = insertLockMutex(it, useMutex);
 
 	//initialize VPM DMA for writing to host
+	//the row length masks the write to the actual elements, so a 3-element vector is written with a single access without overwriting the padding element,
+	//which for vstore3 (not padded in memory) is the first element of the next vector
 	const long dmaMode = getVPMDMAMode(type);
-	VPWSetup dmaSetup(VPWDMASetup(dmaMode, type.getVectorWidth(true), 1 % 128 /* 0 => 128 */));
+	VPWSetup dmaSetup(VPWDMASetup(dmaMode, type.getVectorWidth(), 1 % 128 /* 0 => 128 */));
 	dmaSetup.dmaSetup.setVPMBase(0);
 	it.emplace( new LoadImmediate(VPM_OUT_SETUP_REGISTER, Literal(static_cast<long>(dmaSetup))));
 	it.nextInBlock();
@@ -586,36 +660,376 @@ InstructionWalker VPM::insertWriteRAM(InstructionWalker it, const Value& memoryA
 	return it;
 }
 
+static void addParameterDecoration(const Value& memoryAddress, const ParameterDecorations decoration)
+{
+	if(memoryAddress.hasType(ValueType::LOCAL) && memoryAddress.local != nullptr)
+	{
+		if(memoryAddress.local->as<Parameter>() != nullptr)
+			memoryAddress.local->as<Parameter>()->decorations = add_flag(memoryAddress.local->as<Parameter>()->decorations, decoration);
+		if(memoryAddress.local->reference.first != nullptr && memoryAddress.local->reference.first->as<Parameter>() != nullptr)
+			memoryAddress.local->reference.first->as<Parameter>()->decorations = add_flag(memoryAddress.local->reference.first->as<Parameter>()->decorations, decoration);
+	}
+}
+
+/*
+ * Reads the given number of rows (of up to 16 32-bit words each) of consecutive memory into the rows starting at the given row (by default the first row of the scratch area)
+ */
+static InstructionWalker insertReadRows(InstructionWalker it, const Value& memoryAddress, const unsigned numRows, const unsigned firstRow = 0, const unsigned numWords = 16)
+{
+	addParameterDecoration(memoryAddress, ParameterDecorations::INPUT);
+	//"ADDRXY[10:0] = {Y[6:0], X[3:0]}"
+	const VPRSetup dmaSetup(VPRDMASetup(getVPMDMAMode(TYPE_INT32), static_cast<uint8_t>(numWords % 16) /* 0 => 16 */, static_cast<uint8_t>(numRows % 16) /* 0 => 16 */, 1,
+			static_cast<uint16_t>(firstRow << 4)));
+	it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<long>(dmaSetup))));
+	it.nextInBlock();
+	//the rows are located directly after each other in memory
+	const VPRSetup strideSetup(VPRStrideSetup(static_cast<uint16_t>(VPM_ROW_SIZE)));
+	it.emplace(new LoadImmediate(VPM_IN_SETUP_REGISTER, Literal(static_cast<long>(strideSetup))));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(VPM_IN_ADDR_REGISTER, memoryAddress));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(NOP_REGISTER, VPM_IN_WAIT_REGISTER));
+	it.nextInBlock();
+	return it;
+}
+
+/*
+ * Writes the given number of full rows starting at the first row of the scratch area into consecutive memory
+ */
+static InstructionWalker insertWriteRows(InstructionWalker it, const Value& memoryAddress, const unsigned numRows)
+{
+	addParameterDecoration(memoryAddress, ParameterDecorations::OUTPUT);
+	VPWSetup dmaSetup(VPWDMASetup(getVPMDMAMode(TYPE_INT32), 16, static_cast<uint8_t>(numRows % 128) /* 0 => 128 */));
+	dmaSetup.dmaSetup.setVPMBase(0);
+	it.emplace(new LoadImmediate(VPM_OUT_SETUP_REGISTER, Literal(static_cast<long>(dmaSetup))));
+	it.nextInBlock();
+	//no gap between the rows in memory
+	const VPWSetup strideSetup(VPWStrideSetup(0));
+	it.emplace(new LoadImmediate(VPM_OUT_SETUP_REGISTER, Literal(static_cast<long>(strideSetup))));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(VPM_OUT_ADDR_REGISTER, memoryAddress));
+	it.nextInBlock();
+	it.emplace(new MoveOperation(NOP_REGISTER, VPM_OUT_WAIT_REGISTER));
+	it.nextInBlock();
+	return it;
+}
+
+/*
+ * Writes the (32-bit) value into all elements of the given number of rows starting at the first row of the scratch area
+ */
+static InstructionWalker insertFillRows(InstructionWalker it, const Value& word, const unsigned numRows)
+{
+	const VPWSetup genericSetup(VPWGenericSetup(getVPMSize(TYPE_INT32), 1));
+	it.emplace(new LoadImmediate(VPM_OUT_SETUP_REGISTER, Literal(static_cast<long>(genericSetup))));
+	it.nextInBlock();
+	for(unsigned row = 0; row < numRows; ++row)
+	{
+		it.emplace(new MoveOperation(VPM_IO_REGISTER, word));
+		it.nextInBlock();
+	}
+	return it;
+}
+
+/*
+ * Replicates the lowest byte of the given value into all four bytes of a 32-bit word
+ */
+static Value insertReplicateByte(Method& method, InstructionWalker& it, const Value& fillByte)
+{
+	if(fillByte.hasType(ValueType::LITERAL))
+	{
+		const long byte = fillByte.literal.integer & 0xFF;
+		return Value(Literal(byte | (byte << 8) | (byte << 16) | (byte << 24)), TYPE_INT32);
+	}
+	const Value byte = method.addNewLocal(TYPE_INT32, "%memset_byte");
+	it.emplace(new Operation("and", byte, fillByte, Value(Literal(0xFFL), TYPE_INT32)));
+	it.nextInBlock();
+	const Value tmp0 = method.addNewLocal(TYPE_INT32, "%memset_word");
+	it.emplace(new Operation("shl", tmp0, byte, Value(Literal(8L), TYPE_INT32)));
+	it.nextInBlock();
+	const Value halfWord = method.addNewLocal(TYPE_INT32, "%memset_word");
+	it.emplace(new Operation("or", halfWord, byte, tmp0));
+	it.nextInBlock();
+	const Value tmp1 = method.addNewLocal(TYPE_INT32, "%memset_word");
+	it.emplace(new Operation("shl", tmp1, halfWord, Value(Literal(16L), TYPE_INT32)));
+	it.nextInBlock();
+	const Value word = method.addNewLocal(TYPE_INT32, "%memset_word");
+	it.emplace(new Operation("or", word, halfWord, tmp1));
+	it.nextInBlock();
+	return word;
+}
+
+static Value insertAddressOffset(Method& method, InstructionWalker& it, const Value& baseAddress, const unsigned offset)
+{
+	if(offset == 0)
+		return baseAddress;
+	const Value address = method.addNewLocal(baseAddress.type, "%mem_copy_addr");
+	it.emplace(new Operation("add", address, baseAddress, Value(Literal(static_cast<long>(offset)), TYPE_INT32)));
+	it.nextInBlock();
+	return address;
+}
+
+/*
+ * The types used to access the bytes following the last full row: a single vector of words and a single vector of bytes.
+ * Using one access per type (instead of several accesses of the same type) prevents these accesses from being combined with each other afterwards.
+ */
+static std::vector<std::pair<DataType, unsigned>> getTailTypes(const unsigned numBytes)
+{
+	std::vector<std::pair<DataType, unsigned>> types;
+	const unsigned numWords = (numBytes % VPM_ROW_SIZE) / 4;
+	const unsigned numSingleBytes = numBytes % 4;
+	const unsigned tailOffset = numBytes / VPM_ROW_SIZE * VPM_ROW_SIZE;
+	if(numWords > 0)
+		types.emplace_back(TYPE_INT32.toVectorType(static_cast<unsigned char>(numWords)), tailOffset);
+	if(numSingleBytes > 0)
+		types.emplace_back(TYPE_INT8.toVectorType(static_cast<unsigned char>(numSingleBytes)), tailOffset + numWords * 4);
+	return types;
+}
+
+unsigned VPM::getMaxBurstRows() const
+{
+	//the burst size is a power of two, so the number of bursts can be calculated with a shift
+	unsigned burstRows = 16;
+	while(burstRows > 1 && burstRows > getMaxCacheVectors(TYPE_INT32.toVectorType(16), false))
+		burstRows /= 2;
+	return burstRows;
+}
+
 InstructionWalker VPM::insertCopyRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& srcAddress, const unsigned numBytes, bool useMutex)
 {
-	const auto size = getBestVectorSize(numBytes);
-	updateScratchSize(size.first.getPhysicalWidth());
+	//copy as many full rows as possible with every DMA access, the remaining bytes with one access of words and one of single bytes
+	const unsigned numRows = numBytes / VPM_ROW_SIZE;
+	const unsigned burstRows = std::min(numRows, getMaxBurstRows());
+	const auto tailTypes = getTailTypes(numBytes);
+	updateScratchSize(std::max(burstRows, tailTypes.empty() ? 0u : 1u) * VPM_ROW_SIZE);
+
+	it = insertLockMutex(it, useMutex);
+
+	for(unsigned row = 0; row < numRows; row += burstRows)
+	{
+		const unsigned numBurstRows = std::min(burstRows, numRows - row);
+		const Value source = insertAddressOffset(method, it, srcAddress, row * VPM_ROW_SIZE);
+		const Value dest = insertAddressOffset(method, it, destAddress, row * VPM_ROW_SIZE);
+		it = insertReadRows(it, source, numBurstRows);
+		it = insertWriteRows(it, dest, numBurstRows);
+	}
+	for(const auto& tail : tailTypes)
+	{
+		const Value source = insertAddressOffset(method, it, srcAddress, tail.second);
+		const Value dest = insertAddressOffset(method, it, destAddress, tail.second);
+		it = insertReadRAM(it, source, tail.first, false);
+		it = insertWriteRAM(it, dest, tail.first, false);
+	}
+
+	it = insertUnlockMutex(it, useMutex);
+	return it;
+}
+
+InstructionWalker VPM::insertReadRAMIntoArea(Method& method, InstructionWalker it, const Value& memoryAddress, const VPMArea& area, const unsigned numBytes, bool useMutex)
+{
+	if(numBytes % 4 != 0 || numBytes > area.size || area.baseOffset + area.size > VPM_MAX_DMA_ROWS * VPM_ROW_SIZE)
+		throw CompilationError(CompilationStep::GENERAL, "Cannot read memory of this size into the VPM area", std::to_string(numBytes));
+	//read bursts of as many full rows as a single DMA access can transfer, the remaining words with one access of a partial row
+	const unsigned numRows = numBytes / VPM_ROW_SIZE;
+	const unsigned firstRow = area.baseOffset / VPM_ROW_SIZE;
+
+	it = insertLockMutex(it, useMutex);
+	for(unsigned row = 0; row < numRows; row += 16)
+	{
+		const Value source = insertAddressOffset(method, it, memoryAddress, row * VPM_ROW_SIZE);
+		it = insertReadRows(it, source, std::min(16u, numRows - row), firstRow + row);
+	}
+	if(numBytes % VPM_ROW_SIZE != 0)
+	{
+		const Value source = insertAddressOffset(method, it, memoryAddress, numRows * VPM_ROW_SIZE);
+		it = insertReadRows(it, source, 1, firstRow + numRows, (numBytes % VPM_ROW_SIZE) / 4);
+	}
+	it = insertUnlockMutex(it, useMutex);
+	return it;
+}
+
+InstructionWalker VPM::insertFillRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& fillByte, const unsigned numBytes, bool useMutex)
+{
+	//the fill-value is written once into the rows of the scratch area, which are then written repeatedly into memory
+	const unsigned numRows = numBytes / VPM_ROW_SIZE;
+	const unsigned burstRows = std::min(numRows, getMaxBurstRows());
+	const auto tailTypes = getTailTypes(numBytes);
+	const unsigned fillRows = std::max(burstRows, tailTypes.empty() ? 0u : 1u);
+	if(fillRows == 0)
+		return it;
+	updateScratchSize(fillRows * VPM_ROW_SIZE);
 
+	const Value fillWord = insertReplicateByte(method, it, fillByte);
 	it = insertLockMutex(it, useMutex);
+	it = insertFillRows(it, fillWord, fillRows);
+
+	for(unsigned row = 0; row < numRows; row += burstRows)
+	{
+		const Value dest = insertAddressOffset(method, it, destAddress, row * VPM_ROW_SIZE);
+		it = insertWriteRows(it, dest, std::min(burstRows, numRows - row));
+	}
+	//since all bytes of the first row contain the fill-value, it does not matter which of them are written
+	for(const auto& tail : tailTypes)
+	{
+		const Value dest = insertAddressOffset(method, it, destAddress, tail.second);
+		it = insertWriteRAM(it, dest, tail.first, false);
+	}
+
+	it = insertUnlockMutex(it, useMutex);
+	return it;
+}
+
+using MemoryLoopStep = std::function<InstructionWalker(InstructionWalker it, const Value& srcAddress, const Value& destAddress)>;
 
-	it = insertReadRAM(it, srcAddress, size.first, false);
-	it = insertWriteRAM(it, destAddress, size.first, false);
+/*
+ * Inserts a loop running the step (accessing stepSize bytes of memory) as long as at least stepSize bytes are remaining.
+ * The step size needs to be a power of two.
+ *
+ * After every iteration, the addresses are advanced and the number of remaining bytes is reduced by the step size.
+ * Returns the position after the loop, which is located in a new basic block.
+ */
+static InstructionWalker insertMemoryLoop(Method& method, InstructionWalker it, const Value& srcAddress, const Value& destAddress, const Value& remainingBytes, const unsigned stepSize, const MemoryLoopStep& step)
+{
+	const long shift = static_cast<long>(std::log2(stepSize));
+	const Value loopLabel = method.addNewLocal(TYPE_LABEL, "%mem_loop");
+	const Value afterLabel = method.addNewLocal(TYPE_LABEL, "%mem_loop_after");
 
-	for(uint8_t i = 1; i < size.second; ++i)
+	//skip the loop, if there are less than stepSize bytes remaining
+	Value numSteps = remainingBytes;
+	if(shift > 0)
 	{
-		const Value tmpSource = method.addNewLocal(srcAddress.type, "%mem_copy_addr");
-		const Value tmpDest = method.addNewLocal(destAddress.type, "%mem_copy_addr");
+		numSteps = method.addNewLocal(TYPE_INT32, "%mem_loop_steps");
+		it.emplace(new Operation("shr", numSteps, remainingBytes, Value(Literal(shift), TYPE_INT8)));
+		it.nextInBlock();
+	}
+	it.emplace(new Branch(afterLabel.local, COND_ZERO_SET, numSteps));
+	it.nextInBlock();
 
-		//increment offset from base address
-		it.emplace(new Operation("add", tmpSource, srcAddress, Value(Literal(static_cast<long>(i * size.first.getPhysicalWidth())), TYPE_INT8)));
+	it = method.emplaceLabel(it, new BranchLabel(*loopLabel.local));
+	it.nextInBlock();
+	it = step(it, srcAddress, destAddress);
+	const Value stepValue(Literal(static_cast<long>(stepSize)), TYPE_INT32);
+	if(!srcAddress.isUndefined())
+	{
+		it.emplace(new Operation("add", srcAddress, srcAddress, stepValue));
 		it.nextInBlock();
-		it.emplace(new Operation("add", tmpDest, destAddress, Value(Literal(static_cast<long>(i * size.first.getPhysicalWidth())), TYPE_INT8)));
+	}
+	it.emplace(new Operation("add", destAddress, destAddress, stepValue));
+	it.nextInBlock();
+	it.emplace(new Operation("sub", remainingBytes, remainingBytes, stepValue));
+	it.nextInBlock();
+	//repeat, as long as there are still at least stepSize bytes remaining
+	Value remainingSteps = remainingBytes;
+	if(shift > 0)
+	{
+		remainingSteps = method.addNewLocal(TYPE_INT32, "%mem_loop_steps");
+		it.emplace(new Operation("shr", remainingSteps, remainingBytes, Value(Literal(shift), TYPE_INT8)));
 		it.nextInBlock();
+	}
+	it.emplace(new Branch(loopLabel.local, COND_ZERO_CLEAR, remainingSteps));
+	it.nextInBlock();
+
+	it = method.emplaceLabel(it, new BranchLabel(*afterLabel.local));
+	return it.nextInBlock();
+}
 
-		it = insertReadRAM(it, tmpSource, size.first, false);
-		it = insertWriteRAM(it, tmpDest, size.first, false);
+/*
+ * Copies the initial addresses and the number of bytes into new locals, which are modified by the loops
+ */
+static InstructionWalker insertMemoryLoopSetup(Method& method, InstructionWalker it, Value& srcAddress, Value& destAddress, Value& remainingBytes)
+{
+	if(!srcAddress.isUndefined())
+	{
+		const Value source = method.addNewLocal(srcAddress.type, "%mem_copy_src");
+		it.emplace(new MoveOperation(source, srcAddress));
+		it.nextInBlock();
+		srcAddress = source;
 	}
-	it = insertUnlockMutex(it, useMutex);
+	const Value dest = method.addNewLocal(destAddress.type, "%mem_copy_dest");
+	it.emplace(new MoveOperation(dest, destAddress));
+	it.nextInBlock();
+	destAddress = dest;
+	const Value remaining = method.addNewLocal(TYPE_INT32, "%mem_copy_remaining");
+	it.emplace(new MoveOperation(remaining, remainingBytes));
+	it.nextInBlock();
+	remainingBytes = remaining;
+	return it;
+}
+
+InstructionWalker VPM::insertCopyRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& srcAddress, const Value& numBytes, bool useMutex)
+{
+	if(numBytes.hasType(ValueType::LITERAL))
+		return insertCopyRAM(method, it, destAddress, srcAddress, static_cast<unsigned>(numBytes.literal.integer), useMutex);
+	const unsigned burstRows = getMaxBurstRows();
+	updateScratchSize(burstRows * VPM_ROW_SIZE);
 
+	Value source = srcAddress;
+	Value dest = destAddress;
+	Value remainingBytes = numBytes;
+	it = insertMemoryLoopSetup(method, it, source, dest, remainingBytes);
+
+	//every iteration acquires the mutex on its own, so other QPUs are not blocked for the whole copy
+	it = insertMemoryLoop(method, it, source, dest, remainingBytes, burstRows * VPM_ROW_SIZE, [this, burstRows, useMutex](InstructionWalker it, const Value& srcAddr, const Value& destAddr) -> InstructionWalker
+	{
+		it = insertLockMutex(it, useMutex);
+		it = insertReadRows(it, srcAddr, burstRows);
+		it = insertWriteRows(it, destAddr, burstRows);
+		return insertUnlockMutex(it, useMutex);
+	});
+	it = insertMemoryLoop(method, it, source, dest, remainingBytes, VPM_ROW_SIZE, [this, useMutex](InstructionWalker it, const Value& srcAddr, const Value& destAddr) -> InstructionWalker
+	{
+		it = insertLockMutex(it, useMutex);
+		it = insertReadRows(it, srcAddr, 1);
+		it = insertWriteRows(it, destAddr, 1);
+		return insertUnlockMutex(it, useMutex);
+	});
+	for(const DataType& type : {TYPE_INT32, TYPE_INT8})
+	{
+		it = insertMemoryLoop(method, it, source, dest, remainingBytes, type.getPhysicalWidth(), [this, type, useMutex](InstructionWalker it, const Value& srcAddr, const Value& destAddr) -> InstructionWalker
+		{
+			it = insertLockMutex(it, useMutex);
+			it = insertReadRAM(it, srcAddr, type, false);
+			it = insertWriteRAM(it, destAddr, type, false);
+			return insertUnlockMutex(it, useMutex);
+		});
+	}
 	return it;
 }
 
-VPM::VPM(const unsigned totalVPMSize) : maximumVPMSize(totalVPMSize), areas(), isScratchLocked(false)
+InstructionWalker VPM::insertFillRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& fillByte, const Value& numBytes, bool useMutex)
+{
+	if(numBytes.hasType(ValueType::LITERAL))
+		return insertFillRAM(method, it, destAddress, fillByte, static_cast<unsigned>(numBytes.literal.integer), useMutex);
+	const unsigned burstRows = getMaxBurstRows();
+	updateScratchSize(burstRows * VPM_ROW_SIZE);
+
+	Value source = UNDEFINED_VALUE;
+	Value dest = destAddress;
+	Value remainingBytes = numBytes;
+	it = insertMemoryLoopSetup(method, it, source, dest, remainingBytes);
+	const Value fillWord = insertReplicateByte(method, it, fillByte);
+
+	//the rows filled with the fill-value are re-used by all iterations, so the mutex is held for the whole fill
+	it = insertLockMutex(it, useMutex);
+	it = insertFillRows(it, fillWord, burstRows);
+	it = insertMemoryLoop(method, it, source, dest, remainingBytes, burstRows * VPM_ROW_SIZE, [burstRows](InstructionWalker it, const Value& /* srcAddr */, const Value& destAddr) -> InstructionWalker
+	{
+		return insertWriteRows(it, destAddr, burstRows);
+	});
+	it = insertMemoryLoop(method, it, source, dest, remainingBytes, VPM_ROW_SIZE, [](InstructionWalker it, const Value& /* srcAddr */, const Value& destAddr) -> InstructionWalker
+	{
+		return insertWriteRows(it, destAddr, 1);
+	});
+	for(const DataType& type : {TYPE_INT32, TYPE_INT8})
+	{
+		it = insertMemoryLoop(method, it, source, dest, remainingBytes, type.getPhysicalWidth(), [this, type](InstructionWalker it, const Value& /* srcAddr */, const Value& destAddr) -> InstructionWalker
+		{
+			return insertWriteRAM(it, destAddr, type, false);
+		});
+	}
+	return insertUnlockMutex(it, useMutex);
+}
+
+VPM::VPM(const unsigned totalVPMSize) : maximumVPMSize(totalVPMSize), areas(), isScratchLocked(false), scratchRowsPerQPU(0)
 {
 	areas.push_back(VPMArea{VPMUsage::GENERAL_DMA, 0, 0, nullptr});
 }
@@ -630,42 +1044,97 @@ VPMArea* VPM::findArea(const Local* local)
 	for(VPMArea& area : areas)
 		if(area.dmaAddress == local)
 			return &area;
-	return nullptr;
+	auto it = sharedAreas.find(local);
+	return it == sharedAreas.end() ? nullptr : it->second;
 }
 
-VPMArea* VPM::addArea(const Local* local, unsigned requestedSize, bool alignToBack)
+VPMArea* VPM::addArea(const Local* local, unsigned requestedSize, VPMUsage usage)
 {
 	VPMArea* area = findArea(local);
 	if(area != nullptr && area->size >= requestedSize)
 		return area;
-	//TODO find free consecutive space in VPM with the requested size and return it
+	const unsigned alignedSize = (requestedSize + VPM_ROW_SIZE - 1) / VPM_ROW_SIZE * VPM_ROW_SIZE;
+	if(getFreeSize(usage) < alignedSize)
+		//no more (big enough) free space on VPM
+		return nullptr;
+	areas.push_back(VPMArea{usage, getFrontSize() - alignedSize, alignedSize, local});
+	DEBUG_LOG("Reserved " << alignedSize << " bytes of VPM at offset " << areas.back().baseOffset << " for: " << local->to_string() << logging::endl);
+	return &areas.back();
+}
+
+unsigned VPM::getFreeSize(VPMUsage usage) const
+{
+	//the registers are spilled while generating the code, after which the scratch area does not grow anymore
+	const unsigned minScratchSize = isScratchLocked || usage == VPMUsage::REGISTER_SPILLING ? areas.front().size : std::max(areas.front().size, maximumVPMSize / 4);
+	return getFrontSize() > minScratchSize ? getFrontSize() - minScratchSize : 0;
+}
 
-	//no more (big enough) free space on VPM
-	return nullptr;
+unsigned VPM::getNumObjects(const VPMArea& area) const
+{
+	if(area.dmaAddress == nullptr)
+		return 0;
+	return 1 + static_cast<unsigned>(std::count_if(sharedAreas.begin(), sharedAreas.end(), [&area](const std::pair<const Local* const, VPMArea*>& pair) -> bool { return pair.second == &area;}));
 }
 
 unsigned VPM::getMaxCacheVectors(const DataType& type, bool writeAccess) const
 {
+	//the number of rows is encoded with 4 (reading) and 7 (writing) bits, where 0 encodes 16 (reading) and 128 (writing)
 	if(writeAccess)
-		return std::min(63u, (maximumVPMSize / 16) / (type.getScalarBitCount() / 8));
-	return std::min(15u, (maximumVPMSize / 16) / (type.getScalarBitCount() / 8));
+		return std::min(64u, (getFrontSize() / 16) / (type.getScalarBitCount() / 8));
+	return std::min(16u, (getFrontSize() / 16) / (type.getScalarBitCount() / 8));
 }
 
 void VPM::updateScratchSize(unsigned requestedSize)
 {
 	if(isScratchLocked)
 		throw CompilationError(CompilationStep::GENERAL, "Size of the scratch area is already locked");
-	if(requestedSize > maximumVPMSize)
-		throw CompilationError(CompilationStep::GENERAL, "The requested size of the scratch area exceeds the total VPM size", std::to_string(requestedSize));
+	if(requestedSize > getFrontSize())
+		throw CompilationError(CompilationStep::GENERAL, "The requested size of the scratch area exceeds the free VPM size", std::to_string(requestedSize));
 
 	if(getScratchArea().size < requestedSize)
-		logging::debug() << "Increased the scratch size to " << requestedSize << " bytes" << logging::endl;
+		DEBUG_LOG("Increased the scratch size to " << requestedSize << " bytes" << logging::endl);
 
 	//TODO is this correct?
 	//Since we do not store all data completely packed, do we?
 	getScratchArea().size = std::max(getScratchArea().size, requestedSize);
 }
 
+unsigned VPM::partitionScratchArea(unsigned numQPUs, unsigned additionalRows)
+{
+	if(isScratchLocked)
+		return scratchRowsPerQPU;
+	const unsigned rowsPerQPU = (getScratchArea().size + VPM_ROW_SIZE - 1) / VPM_ROW_SIZE + additionalRows;
+	//the generic VPM setups can only address the first 64 rows
+	if(rowsPerQPU == 0 || rowsPerQPU * numQPUs * VPM_ROW_SIZE > getFrontSize() || rowsPerQPU * numQPUs > 64)
+		return 0;
+	getScratchArea().size = rowsPerQPU * numQPUs * VPM_ROW_SIZE;
+	isScratchLocked = true;
+	scratchRowsPerQPU = rowsPerQPU;
+	DEBUG_LOG("Partitioned the scratch area into " << rowsPerQPU << " rows per QPU" << logging::endl);
+	return scratchRowsPerQPU;
+}
+
+unsigned VPM::getScratchRowsPerQPU() const
+{
+	return scratchRowsPerQPU;
+}
+
+const std::deque<VPMArea>& VPM::getAreas() const
+{
+	return areas;
+}
+
+unsigned VPM::getFrontSize() const
+{
+	unsigned frontSize = maximumVPMSize / VPM_ROW_SIZE * VPM_ROW_SIZE;
+	for(const VPMArea& area : areas)
+	{
+		if(area.usageType != VPMUsage::GENERAL_DMA)
+			frontSize = std::min(frontSize, area.baseOffset);
+	}
+	return frontSize;
+}
+
 InstructionWalker VPM::insertLockMutex(InstructionWalker it, bool useMutex) const
 {
 	if(useMutex)
@@ -687,3 +1156,106 @@ InstructionWalker VPM::insertUnlockMutex(InstructionWalker it, bool useMutex) co
 	}
 	return it;
 }
+
+VPMPlanner::VPMPlanner(VPM& vpm, const VPMUsage usage) : vpm(vpm), usage(usage)
+{
+}
+
+void VPMPlanner::addDemand(const Local* object, const unsigned size, const double benefit)
+{
+	demands.push_back(Demand{object, (size + VPM_ROW_SIZE - 1) / VPM_ROW_SIZE * VPM_ROW_SIZE, benefit});
+}
+
+void VPMPlanner::addConflict(const Local* first, const Local* second)
+{
+	conflicts[first].emplace(second);
+	conflicts[second].emplace(first);
+}
+
+FastMap<const Local*, const VPMArea*> VPMPlanner::allocate()
+{
+	FastMap<const Local*, const VPMArea*> result;
+	const unsigned numParts = hasPartPerQPU() ? NUM_QPUS : 1;
+	//the objects with the most accesses per byte are placed first
+	std::vector<Demand> pending;
+	for(const Demand& demand : demands)
+	{
+		const VPMArea* existingArea = vpm.findArea(demand.object);
+		if(existingArea != nullptr && existingArea->size >= demand.size * numParts)
+			result.emplace(demand.object, existingArea);
+		else if(demand.size > 0)
+			pending.push_back(demand);
+	}
+	std::stable_sort(pending.begin(), pending.end(), [](const Demand& first, const Demand& second) -> bool
+	{
+		return first.benefit / first.size > second.benefit / second.size;
+	});
+
+	//every group of objects never live at the same time is stored in a single area with the size of the largest object of the group
+	struct Group
+	{
+		unsigned size;
+		std::vector<const Local*> objects;
+	};
+	std::vector<Group> groups;
+	const unsigned freeSize = vpm.getFreeSize(usage);
+	unsigned usedSize = 0;
+	for(const Demand& demand : pending)
+	{
+		Group* bestGroup = nullptr;
+		unsigned lowestGrowth = 0;
+		if(hasPartPerQPU())
+		{
+			for(Group& group : groups)
+			{
+				const unsigned growth = demand.size > group.size ? (demand.size - group.size) * numParts : 0;
+				if(usedSize + growth <= freeSize && !hasConflict(demand.object, group.objects) && (bestGroup == nullptr || growth < lowestGrowth))
+				{
+					bestGroup = &group;
+					lowestGrowth = growth;
+				}
+			}
+		}
+		if(bestGroup != nullptr)
+		{
+			bestGroup->size = std::max(bestGroup->size, demand.size);
+			bestGroup->objects.push_back(demand.object);
+			usedSize += lowestGrowth;
+		}
+		else if(usedSize + demand.size * numParts <= freeSize)
+		{
+			groups.push_back(Group{demand.size, {demand.object}});
+			usedSize += demand.size * numParts;
+		}
+		else
+			DEBUG_LOG("Not enough VPM space left for: " << demand.object->to_string() << logging::endl);
+	}
+
+	for(const Group& group : groups)
+	{
+		const unsigned areaSize = group.size * numParts;
+		vpm.areas.push_back(VPMArea{usage, vpm.getFrontSize() - areaSize, areaSize, group.objects.front()});
+		VPMArea* area = &vpm.areas.back();
+		DEBUG_LOG("Reserved " << areaSize << " bytes of VPM at offset " << area->baseOffset << " for " << group.objects.size() << " object(s), starting with: " << group.objects.front()->to_string() << logging::endl);
+		for(const Local* object : group.objects)
+		{
+			if(object != group.objects.front())
+				vpm.sharedAreas[object] = area;
+			result[object] = area;
+		}
+	}
+	return result;
+}
+
+bool VPMPlanner::hasPartPerQPU() const
+{
+	return usage == VPMUsage::PRIVATE_MEMORY || usage == VPMUsage::REGISTER_SPILLING;
+}
+
+bool VPMPlanner::hasConflict(const Local* object, const std::vector<const Local*>& others) const
+{
+	auto it = conflicts.find(object);
+	if(it == conflicts.end())
+		return false;
+	return std::any_of(others.begin(), others.end(), [&it](const Local* other) -> bool { return it->second.find(other) != it->second.end();});
+}
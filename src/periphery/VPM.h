@@ -11,6 +11,8 @@
 #include "../InstructionWalker.h"
 #include "../Bitfield.h"
 
+#include <deque>
+
 namespace vc4c
 {
 	const Value VPM_IN_SETUP_REGISTER(REG_VPM_IN_SETUP, TYPE_INT32);
@@ -442,9 +444,15 @@ namespace vc4c
 			GENERAL_DMA,
 			//part of the VPM used as cache for DMA access to specific memory regions
 			SPECIFIC_DMA,
-			//this area is used to spill registers into
-			REGISTER_SPILLING
+			//this area is used to spill registers into, with one row per QPU
+			REGISTER_SPILLING,
+			//this area holds a __local memory object (or a copy of a __constant lookup table), which is shared between all QPUs (work-items) of the work-group
+			LOCAL_MEMORY,
+			//this area holds a __private memory object, with a separate copy for every QPU
+			PRIVATE_MEMORY
 		};
+		//the number of different VPMUsage types
+		constexpr std::size_t NUM_VPM_USAGES = 5;
 
 		/*
 		 * An area of the VPM used for a specific purpose (e.g. cache, register spilling, etc.)
@@ -457,10 +465,17 @@ namespace vc4c
 			unsigned baseOffset;
 			//the size of this area (in bytes)
 			unsigned size;
-			//the (optional) DMA address this area is assigned to (as DMA cache)
+			//the (optional) DMA address this area is assigned to (as DMA cache) or the __local or __private memory object stored in this area
 			const Local* dmaAddress;
 		};
 
+		//the size of a row in the VPM (16 elements with 32-bit), the areas are aligned to rows
+		constexpr unsigned VPM_ROW_SIZE = 64;
+		//the number of rows which can be addressed by the DMA setups, the row is encoded with 7 bits
+		constexpr unsigned VPM_MAX_DMA_ROWS = 128;
+
+		class VPMPlanner;
+
 		/*
 		 * Object wrapping the VPM cache component
 		 */
@@ -470,8 +485,26 @@ namespace vc4c
 			VPM(const unsigned totalVPMSize);
 
 			VPMArea& getScratchArea();
+			/*
+			 * Returns the area reserved for the given object, which might be shared with other objects (see VPMPlanner)
+			 */
 			VPMArea* findArea(const Local* local);
-			VPMArea* addArea(const Local* local, unsigned requestedSize, bool alignToBack = false);
+			/*
+			 * Reserves an area of the given size for the given usage.
+			 *
+			 * Since the scratch area at the start of the VPM can still grow, all other areas are placed at the end of the VPM.
+			 * Returns nullptr, if there is not enough space left (a quarter of the VPM is kept for the scratch area, as long as its size is not locked.
+			 * Areas for register spilling are reserved during code generation and can use all of the VPM not used by the scratch area)
+			 */
+			VPMArea* addArea(const Local* local, unsigned requestedSize, VPMUsage usage);
+			/*
+			 * The number of bytes which can still be reserved for areas of the given usage (see #addArea)
+			 */
+			unsigned getFreeSize(VPMUsage usage) const;
+			/*
+			 * The number of objects stored in the area, more than one if the area is shared by objects never live at the same time (see VPMPlanner)
+			 */
+			unsigned getNumObjects(const VPMArea& area) const;
 
 			/*
 			 * The maximum number of vectors (of the given type) which can be cached in this VPM.
@@ -488,6 +521,28 @@ namespace vc4c
 			 * Inserts a write from a QPU register into VPM
 			 */
 			InstructionWalker insertWriteVPM(InstructionWalker it, const Value& src, bool useMutex = true);
+			/*
+			 * Inserts a read of the 32-bit element at the given byte-offset within the area from VPM into (the first element of) a QPU register
+			 */
+			InstructionWalker insertReadVPM(Method& method, InstructionWalker it, const Value& dest, const VPMArea& area, const Value& inAreaOffset);
+			/*
+			 * Inserts a write of (the first element of) the QPU register into the 32-bit element at the given byte-offset within the area.
+			 *
+			 * Since the VPM can only be written in whole rows, the row is read, modified and written back.
+			 * The mutex is required, if several QPUs can write into the same row at the same time.
+			 */
+			InstructionWalker insertWriteVPM(Method& method, InstructionWalker it, const Value& src, const VPMArea& area, const Value& inAreaOffset, bool useMutex = true);
+			/*
+			 * Inserts a write of the whole register into the row of the current QPU within the area, which needs to contain one row per QPU.
+			 *
+			 * Since no two QPUs access the same row, no mutex is required.
+			 * The inserted instructions are mapped directly to machine code, so this can be used during register allocation.
+			 */
+			InstructionWalker insertSpillRegister(Method& method, InstructionWalker it, const Value& src, const VPMArea& area);
+			/*
+			 * Inserts a read of the whole register written by #insertSpillRegister from the row of the current QPU within the area
+			 */
+			InstructionWalker insertReloadRegister(Method& method, InstructionWalker it, const Value& dest, const VPMArea& area);
 
 			/*
 			 * Inserts a read from RAM into VPM via DMA
@@ -499,8 +554,35 @@ namespace vc4c
 			InstructionWalker insertWriteRAM(InstructionWalker it, const Value& memoryAddress, const DataType& type, bool useMutex = true);
 			/*
 			 * Inserts a copy from RAM via DMA and VPM into RAM
+			 *
+			 * The memory is copied in bursts of as many full rows as fit into the scratch area, the remaining bytes with one access of words and one of single bytes.
 			 */
 			InstructionWalker insertCopyRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& srcAddress, const unsigned numBytes, bool useMutex = true);
+			/*
+			 * Inserts a copy of a dynamic number of bytes from RAM via DMA and VPM into RAM
+			 *
+			 * The copy is executed in loops (over bursts of rows, single rows, words and bytes), which split the basic block.
+			 * Thus, this can only be used after the phi-nodes are eliminated.
+			 */
+			InstructionWalker insertCopyRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& srcAddress, const Value& numBytes, bool useMutex = true);
+			/*
+			 * Inserts a read of the given number of bytes (a multiple of 4) of consecutive memory via DMA into the area, e.g. to preload a table read via #insertReadVPM.
+			 *
+			 * The rows are read directly into the area in bursts of up to 16 rows, without using the scratch area
+			 */
+			InstructionWalker insertReadRAMIntoArea(Method& method, InstructionWalker it, const Value& memoryAddress, const VPMArea& area, const unsigned numBytes, bool useMutex = true);
+			/*
+			 * Inserts a fill of RAM with the given byte value (e.g. for memset) via VPM and DMA
+			 *
+			 * The rows of the scratch area are filled once with the value replicated into all bytes, which are then written in bursts into RAM.
+			 */
+			InstructionWalker insertFillRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& fillByte, const unsigned numBytes, bool useMutex = true);
+			/*
+			 * Inserts a fill of a dynamic number of bytes of RAM with the given byte value.
+			 *
+			 * Same as #insertCopyRAM for a dynamic number of bytes, this splits the basic block.
+			 */
+			InstructionWalker insertFillRAM(Method& method, InstructionWalker it, const Value& destAddress, const Value& fillByte, const Value& numBytes, bool useMutex = true);
 
 			/*
 			 * Updates the maximum size used by the scratch area.
@@ -508,14 +590,89 @@ namespace vc4c
 			 */
 			void updateScratchSize(unsigned requestedSize);
 
+			/*
+			 * Splits the scratch area into one part per QPU, so QPU n uses the rows [n * rowsPerQPU, (n + 1) * rowsPerQPU) of the scratch area.
+			 * Since the parts do not overlap, the DMA accesses via the scratch area do not need to be guarded by the hardware mutex anymore.
+			 *
+			 * The additional rows are reserved for every QPU after the rows currently used by the scratch area (e.g. as prefetch buffers).
+			 *
+			 * This locks the size of the scratch area and returns the number of rows per QPU, or zero if the parts do not fit into the free VPM space
+			 */
+			unsigned partitionScratchArea(unsigned numQPUs, unsigned additionalRows = 0);
+			/*
+			 * The number of rows of the scratch area used by every QPU, zero if the scratch area is shared between all QPUs
+			 */
+			unsigned getScratchRowsPerQPU() const;
+			/*
+			 * The areas reserved in the VPM (including the scratch area)
+			 */
+			const std::deque<VPMArea>& getAreas() const;
+
 		private:
 			const unsigned maximumVPMSize;
-			std::vector<VPMArea> areas;
+			//a deque, so the areas handed out stay valid when more areas are added
+			std::deque<VPMArea> areas;
+			//the objects sharing an area with the object the area was reserved for (see VPMPlanner)
+			FastMap<const Local*, VPMArea*> sharedAreas;
 			//whether the scratch area is locked to a fixed size
 			bool isScratchLocked;
+			//the number of rows of the scratch area per QPU, if the scratch area is partitioned
+			unsigned scratchRowsPerQPU;
 
+			//the size of the VPM not occupied by the areas at the end of the VPM
+			unsigned getFrontSize() const;
+			//the number of rows copied with a single DMA access by bulk memory operations (a power of two)
+			unsigned getMaxBurstRows() const;
 			InstructionWalker insertLockMutex(InstructionWalker it, bool useMutex) const;
 			InstructionWalker insertUnlockMutex(InstructionWalker it, bool useMutex) const;
+
+			friend class VPMPlanner;
+		};
+
+		/*
+		 * Collects the VPM space required by several objects and reserves the areas for all of them at once.
+		 *
+		 * In contrast to reserving the areas one after the other via VPM#addArea, the objects with the most accesses per byte are placed first,
+		 * if not all of them fit into the free VPM space. Objects never live at the same time share an area, if the usage allows it:
+		 * The areas with one part per QPU (__private memory, register spilling) are shared, since every QPU only accesses its own part.
+		 * The areas of __local memory and DMA caches are accessed by all QPUs concurrently and are therefore never shared.
+		 */
+		class VPMPlanner
+		{
+		public:
+			VPMPlanner(VPM& vpm, VPMUsage usage);
+
+			/*
+			 * Adds an object requiring the given number of bytes, for the usages with one part per QPU this is the size of the part of a single QPU.
+			 * The benefit (e.g. the number of accesses) decides which objects are placed, if not all of them fit
+			 */
+			void addDemand(const Local* object, unsigned size, double benefit);
+			/*
+			 * Marks both objects as live at the same time, so they can not share an area
+			 */
+			void addConflict(const Local* first, const Local* second);
+			/*
+			 * Reserves the areas for the objects, the objects not placed due to lack of VPM space are not contained in the result.
+			 *
+			 * For the usages with one part per QPU, the part of QPU n starts at the base offset of the area plus n times the size of the area divided by NUM_QPUS
+			 */
+			FastMap<const Local*, const VPMArea*> allocate();
+
+		private:
+			struct Demand
+			{
+				const Local* object;
+				//the row-aligned size (per QPU)
+				unsigned size;
+				double benefit;
+			};
+			VPM& vpm;
+			const VPMUsage usage;
+			std::vector<Demand> demands;
+			FastMap<const Local*, FastSet<const Local*>> conflicts;
+
+			bool hasPartPerQPU() const;
+			bool hasConflict(const Local* object, const std::vector<const Local*>& others) const;
 		};
 	}
 }
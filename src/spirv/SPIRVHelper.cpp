@@ -7,8 +7,12 @@
 #include "SPIRVHelper.h"
 #include "CompilationError.h"
 
+#include "../Logging.h"
 #include "../performance.h"
 
+#include <algorithm>
+#include <iterator>
+
 #ifdef SPIRV_LINKER_HEADER
 #include SPIRV_LINKER_HEADER
 #endif
@@ -324,6 +328,21 @@ std::string spirv2qasm::getOpenCLMethodName(const uint32_t instructionID)
 			return "vloadn";
 		case OpenCLLIB::Entrypoints::Vstoren:
 			return "vstoren";
+		case OpenCLLIB::Entrypoints::Vload_half:
+			return "vload_half";
+		case OpenCLLIB::Entrypoints::Vload_halfn:
+			return "vload_halfn";
+		case OpenCLLIB::Entrypoints::Vloada_halfn:
+			return "vloada_halfn";
+		case OpenCLLIB::Entrypoints::Vstore_half:
+		case OpenCLLIB::Entrypoints::Vstore_half_r:
+			return "vstore_half";
+		case OpenCLLIB::Entrypoints::Vstore_halfn:
+		case OpenCLLIB::Entrypoints::Vstore_halfn_r:
+			return "vstore_halfn";
+		case OpenCLLIB::Entrypoints::Vstorea_halfn:
+		case OpenCLLIB::Entrypoints::Vstorea_halfn_r:
+			return "vstorea_halfn";
 		default:
 			throw CompilationError(CompilationStep::PARSER, "Unsupported OpenCL standard-function", std::to_string(instructionID));
 	}
@@ -550,7 +569,7 @@ static std::string getCapabilityName(const SpvCapability cap)
 	throw CompilationError(CompilationStep::LLVM_2_IR, "Invalid capability constant!");
 }
 
-static const std::set<SpvCapability> supportedCapabilites = {
+static constexpr SpvCapability supportedCapabilites[] = {
 	//OpenCL kernels
 	SpvCapabilityKernel,
 	//support for 8-component or 16-component vectors
@@ -598,12 +617,12 @@ spv_result_t spirv2qasm::checkCapability(const SpvCapability cap)
 	 */
 
 	const std::string name = getCapabilityName(cap);
-	if(supportedCapabilites.find(cap) != supportedCapabilites.end())
+	if(std::find(std::begin(supportedCapabilites), std::end(supportedCapabilites), cap) != std::end(supportedCapabilites))
 	{
-		logging::debug() << "Using supported capability: " << name << logging::endl;
+		DEBUG_LOG("Using supported capability: " << name << logging::endl);
 		return SPV_SUCCESS;
 	}
-	logging::debug() << "Using unsupported capability: " << name << logging::endl;
+	DEBUG_LOG("Using unsupported capability: " << name << logging::endl);
 	return SPV_UNSUPPORTED;
 }
 
@@ -666,7 +685,7 @@ DataType spirv2qasm::getIntegerType(const uint32_t bitWidth, const uint32_t sign
         return TYPE_INT16;
     if (bitWidth == 8)
         return TYPE_INT8;
-    logging::debug() << "Unrecognized integer type with " << bitWidth << " bits" << logging::endl;
+    DEBUG_LOG("Unrecognized integer type with " << bitWidth << " bits" << logging::endl);
     return DataType(std::string("i") + std::to_string(bitWidth));
 }
 
@@ -716,22 +735,29 @@ void spirv2qasm::consumeSPIRVMessage(spv_message_level_t level, const char* sour
 			levelText = "Warning";
 			break;
 	}
-	logging::info() << "SPIR-V Tools: " << levelText << " message in '" << source << "' at position " << position.line << ":" << position.column << ": " << message <<logging::endl;
+	INFO_LOG("SPIR-V Tools: " << levelText << " message in '" << source << "' at position " << position.line << ":" << position.column << ": " << message <<logging::endl);
 }
 
 std::vector<uint32_t> spirv2qasm::readStreamOfWords(std::istream& in)
 {
+	//read in large blocks directly into the word-buffer
+	static const std::size_t BLOCK_WORDS = 16 * 1024;
 	std::vector<uint32_t> words;
-	words.reserve(in.rdbuf()->in_avail());
-	char buffer[sizeof (uint32_t)];
-	while (in.read(buffer, sizeof (uint32_t)).good()) {
-		words.push_back(*(uint32_t*) buffer);
+	std::size_t numBytes = 0;
+	while(true)
+	{
+		words.resize(numBytes / sizeof(uint32_t) + BLOCK_WORDS + 1);
+		const std::streamsize read = in.rdbuf()->sgetn(reinterpret_cast<char*>(words.data()) + numBytes, BLOCK_WORDS * sizeof(uint32_t));
+		if(read <= 0)
+			break;
+		numBytes += static_cast<std::size_t>(read);
 	}
-
+	//incomplete trailing words are dropped
+	words.resize(numBytes / sizeof(uint32_t));
 	return words;
 }
 
-void spirv2qasm::linkSPIRVModules(const std::vector<std::istream*>& inputModules, std::ostream& output)
+void spirv2qasm::linkSPIRVModules(const std::vector<std::istream*>& inputModules, std::ostream& output, const bool createLibrary)
 {
 #ifndef SPIRV_LINKER_HEADER
 	throw CompilationError(CompilationStep::LINKER, "SPIRV-Tools linker is not available!");
@@ -744,7 +770,7 @@ void spirv2qasm::linkSPIRVModules(const std::vector<std::istream*>& inputModules
 	}
 
 	spvtools::LinkerOptions options;
-	options.SetCreateLibrary(false);
+	options.SetCreateLibrary(createLibrary);
 
 	spvtools::Linker linker(SPV_ENV_OPENCL_2_1);
 	linker.SetMessageConsumer(consumeSPIRVMessage);
@@ -760,6 +786,6 @@ void spirv2qasm::linkSPIRVModules(const std::vector<std::istream*>& inputModules
 	{
 		output.write(reinterpret_cast<const char*>(&u), sizeof(uint32_t));
 	}
-	logging::debug() << "Linked " << inputModules.size() << " modules into a single module with " << linkedModules.size() << " words of data." << logging::endl;
+	DEBUG_LOG("Linked " << inputModules.size() << " modules into a single module with " << linkedModules.size() << " words of data." << logging::endl);
 #endif
 }
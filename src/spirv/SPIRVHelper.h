@@ -31,7 +31,8 @@ namespace vc4c
 		void consumeSPIRVMessage(spv_message_level_t level, const char* source, const spv_position_t& position, const char* message);
 
 		std::vector<uint32_t> readStreamOfWords(std::istream& in);
-		void linkSPIRVModules(const std::vector<std::istream*>& inputModules, std::ostream& output);
+		//if createLibrary is set, the symbols do not need to be resolved completely and the result can be linked again
+		void linkSPIRVModules(const std::vector<std::istream*>& inputModules, std::ostream& output, const bool createLibrary = false);
 	}
 }
 
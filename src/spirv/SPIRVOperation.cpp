@@ -12,20 +12,20 @@
 
 #include "../intermediate/Helper.h"
 #include "../periphery/VPM.h"
-#include "log.h"
+#include "../Logging.h"
 #include "../intrinsics/Images.h"
 #include "helper.h"
 
 using namespace vc4c;
 using namespace vc4c::spirv2qasm;
 
-Value toNewLocal(Method& method, const uint32_t id, const uint32_t typeID, const std::map<uint32_t, DataType>& typeMappings, std::map<uint32_t, uint32_t>& localTypes)
+Value toNewLocal(Method& method, const uint32_t id, const uint32_t typeID, const IdMap<DataType>& typeMappings, LocalTypeMapping& localTypes)
 {
     localTypes[id] = typeID;
     return method.findOrCreateLocal(typeMappings.at(typeID), std::string("%") + std::to_string(id))->createReference();
 }
 
-DataType getType(const uint32_t id, const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals, const std::map<uint32_t, uint32_t>& localTypes)
+DataType getType(const uint32_t id, const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals, const LocalTypeMapping& localTypes)
 {
     if(types.find(id) != types.end())
         return types.at(id);
@@ -36,7 +36,7 @@ DataType getType(const uint32_t id, const std::map<uint32_t, DataType>& types, c
     return types.at(localTypes.at(id));
 }
 
-Value getValue(const uint32_t id, Method& method, const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals, const std::map<uint32_t, uint32_t>& localTypes)
+Value getValue(const uint32_t id, Method& method, const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals, const LocalTypeMapping& localTypes)
 {
     if(constants.find(id) != constants.end())
         return constants.at(id);
@@ -65,7 +65,7 @@ SPIRVInstruction::~SPIRVInstruction()
 
 }
 
-void SPIRVInstruction::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVInstruction::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
     Value arg0 = getValue(operands.at(0), *method.method, types, constants, globals, localTypes);
@@ -83,17 +83,17 @@ void SPIRVInstruction::mapInstruction(std::map<uint32_t, DataType>& types, std::
     }
     if(!arg1)   //unary
     {
-        logging::debug() << "Generating intermediate unary operation '" << opcode << "' with " << arg0.to_string(false) << " into " << dest.to_string(true) << logging::endl;
+        DEBUG_LOG("Generating intermediate unary operation '" << opcode << "' with " << arg0.to_string(false) << " into " << dest.to_string(true) << logging::endl);
         method.method->appendToEnd((new intermediate::Operation(opCode, dest, arg0))->setDecorations(decorations));
     }
     else    //binary
     {
-        logging::debug() << "Generating intermediate binary operation '" << opcode << "' with " << arg0.to_string(false) << " and " << arg1.to_string() << " into " << dest.to_string(true) << logging::endl;
+        DEBUG_LOG("Generating intermediate binary operation '" << opcode << "' with " << arg0.to_string(false) << " and " << arg1.to_string() << " into " << dest.to_string(true) << logging::endl);
         method.method->appendToEnd((new intermediate::Operation(opCode, dest, arg0, arg1))->setDecorations(decorations));
     }
 }
 
-Optional<Value> SPIRVInstruction::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVInstruction::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	const Value op1 = constants.at(operands.at(0));
 	const Value op2 = operands.size() > 1 ? constants.at(operands.at(1)) : UNDEFINED_VALUE;
@@ -155,16 +155,16 @@ SPIRVComparison::~SPIRVComparison()
 
 }
 
-void SPIRVComparison::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVComparison::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
     const Value arg0 = getValue(operands.at(0), *method.method, types, constants, globals, localTypes);
     const Value arg1 = getValue(operands.at(1), *method.method, types, constants, globals, localTypes);
-    logging::debug() << "Generating intermediate comparison '" << opcode << "' of " << arg0.to_string(false) << " and " << arg1.to_string(false) << " into " << dest.to_string(true) << logging::endl;
+    DEBUG_LOG("Generating intermediate comparison '" << opcode << "' of " << arg0.to_string(false) << " and " << arg1.to_string(false) << " into " << dest.to_string(true) << logging::endl);
     method.method->appendToEnd((new intermediate::Comparison(opcode, dest, arg0, arg1))->setDecorations(decorations));
 }
 
-Optional<Value> SPIRVComparison::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVComparison::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	const Value op1 = constants.at(operands.at(0));
 	const Value op2 = constants.at(operands.at(1));
@@ -212,7 +212,7 @@ SPIRVCallSite::~SPIRVCallSite()
 
 }
 
-void SPIRVCallSite::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVCallSite::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
     std::string calledFunction = methodName.orElse("");
@@ -223,11 +223,11 @@ void SPIRVCallSite::mapInstruction(std::map<uint32_t, DataType>& types, std::map
     {
         args.push_back(getValue(op, *method.method, types, constants, globals, localTypes));
     }
-    logging::debug() << "Generating intermediate call-site to '" << calledFunction << "' with " << args.size() << " parameters into " << dest.to_string(true) << logging::endl;
+    DEBUG_LOG("Generating intermediate call-site to '" << calledFunction << "' with " << args.size() << " parameters into " << dest.to_string(true) << logging::endl);
     method.method->appendToEnd((new intermediate::MethodCall(dest, calledFunction, args))->setDecorations(decorations));
 }
 
-Optional<Value> SPIRVCallSite::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVCallSite::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	return NO_VALUE;
 }
@@ -247,22 +247,22 @@ SPIRVReturn::~SPIRVReturn()
 
 }
 
-void SPIRVReturn::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVReturn::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     if(returnValue)
     {
         const Value value = getValue(returnValue, *method.method, types, constants, globals, localTypes);
-        logging::debug() << "Generating intermediate return of value: " << value.to_string(false) << logging::endl;
+        DEBUG_LOG("Generating intermediate return of value: " << value.to_string(false) << logging::endl);
         method.method->appendToEnd(new intermediate::Return(value));
     }
     else
     {
-        logging::debug() << "Generating intermediate return" << logging::endl;
+        DEBUG_LOG("Generating intermediate return" << logging::endl);
         method.method->appendToEnd(new intermediate::Return());
     }
 }
 
-Optional<Value> SPIRVReturn::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVReturn::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	if(returnValue && constants.find(returnValue) != constants.end())
 		return constants.at(returnValue);
@@ -285,11 +285,11 @@ SPIRVBranch::~SPIRVBranch()
 
 }
 
-void SPIRVBranch::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVBranch::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     if(conditionID)
     {
-        logging::debug() << "Generating intermediate conditional branch on %" << conditionID.get() << " to either %" << defaultLabelID << " or %" << falseLabelID.get() << logging::endl;
+        DEBUG_LOG("Generating intermediate conditional branch on %" << conditionID.get() << " to either %" << defaultLabelID << " or %" << falseLabelID.get() << logging::endl);
         const Value cond = getValue(conditionID, *method.method, types, constants, globals, localTypes);
         const Local* trueLabel = method.method->findOrCreateLocal(TYPE_LABEL, std::string("%") + std::to_string(defaultLabelID));
         const Local*  falseLabel = method.method->findOrCreateLocal(TYPE_LABEL, std::string("%") + std::to_string(falseLabelID.get()));
@@ -298,13 +298,13 @@ void SPIRVBranch::mapInstruction(std::map<uint32_t, DataType>& types, std::map<u
     }
     else
     {
-        logging::debug() << "Generating intermediate branch to %" << defaultLabelID << logging::endl;
+        DEBUG_LOG("Generating intermediate branch to %" << defaultLabelID << logging::endl);
         const Local* label = method.method->findOrCreateLocal(TYPE_LABEL, std::string("%") + std::to_string(defaultLabelID));
         method.method->appendToEnd(new intermediate::Branch(label, COND_ALWAYS, BOOL_TRUE));
     }
 }
 
-Optional<Value> SPIRVBranch::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVBranch::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	return NO_VALUE;
 }
@@ -319,13 +319,13 @@ SPIRVLabel::~SPIRVLabel()
 
 }
 
-void SPIRVLabel::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVLabel::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
-    logging::debug() << "Generating intermediate label %" << id << logging::endl;
+    DEBUG_LOG("Generating intermediate label %" << id << logging::endl);
     method.method->appendToEnd(new intermediate::BranchLabel(*method.method->findOrCreateLocal(TYPE_LABEL, std::string("%") + std::to_string(id))));
 }
 
-Optional<Value> SPIRVLabel::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVLabel::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	return NO_VALUE;
 }
@@ -341,14 +341,14 @@ SPIRVConversion::~SPIRVConversion()
 
 }
 
-void SPIRVConversion::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVConversion::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value source = getValue(sourceID, *method.method, types, constants, globals, localTypes);
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
     const uint8_t sourceWidth = source.type.getScalarBitCount();
     const uint8_t destWidth = dest.type.getScalarBitCount();
     
-    logging::debug() << "Generating intermediate conversion from " << source.to_string(false) << " to " << dest.to_string(true) << logging::endl;
+    DEBUG_LOG("Generating intermediate conversion from " << source.to_string(false) << " to " << dest.to_string(true) << logging::endl);
     if(isSaturated)
     	intermediate::insertSaturation(method.method->appendToEnd(), *method.method.get(), source, dest, type == ConversionType::SIGNED);
     else if(type == ConversionType::BITCAST || sourceWidth == destWidth)
@@ -362,10 +362,12 @@ void SPIRVConversion::mapInstruction(std::map<uint32_t, DataType>& types, std::m
         	method.method->appendToEnd((new intermediate::Operation("sext", dest, source))->setDecorations(decorations));
         else if(type == ConversionType::UNSIGNED)
         	method.method->appendToEnd((new intermediate::Operation("zext", dest, source))->setDecorations(add_flag(decorations, intermediate::InstructionDecorations::UNSIGNED_RESULT)));
+        else if(type == ConversionType::FLOATING)
+        	method.method->appendToEnd((new intermediate::Operation("fpext", dest, source))->setDecorations(decorations));
     }
 }
 
-Optional<Value> SPIRVConversion::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVConversion::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	if(constants.find(sourceID) != constants.end())
 	{
@@ -410,7 +412,7 @@ SPIRVCopy::~SPIRVCopy()
 
 }
 
-void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVCopy::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value source = getValue(sourceID, *method.method, types, constants, globals, localTypes);
     Value dest(UNDEFINED_VALUE);
@@ -430,12 +432,12 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
     	//need to split in I/O of scalar type (use VPM cache, multi-line VPM)
         if(memoryAccess == MemoryAccess::READ)
         {
-            logging::debug() << "Generating reading of " << source.to_string() << " into " << dest.to_string() << logging::endl;
+            DEBUG_LOG("Generating reading of " << source.to_string() << " into " << dest.to_string() << logging::endl);
             periphery::insertReadDMA(*method.method.get(), method.method->appendToEnd(), dest, source);
         }
         else if(memoryAccess == MemoryAccess::WRITE)
         {
-            logging::debug() << "Generating writing of " << source.to_string() << " into " << dest.to_string() << logging::endl;
+            DEBUG_LOG("Generating writing of " << source.to_string() << " into " << dest.to_string() << logging::endl);
             periphery::insertWriteDMA(*method.method.get(), method.method->appendToEnd(), source, dest);
         }
         else if(memoryAccess == MemoryAccess::READ_WRITE)
@@ -443,7 +445,7 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
         	if(sizeID == UNDEFINED_ID)
         	{
         		//copy single object
-				logging::debug() << "Generating copying of " << source.to_string() << " into " << dest.to_string() << logging::endl;
+				DEBUG_LOG("Generating copying of " << source.to_string() << " into " << dest.to_string() << logging::endl);
 				const Value tmp = method.method->addNewLocal(source.type, "%copy_tmp");
 				//TODO use VPM#insertCopyRAM
 				periphery::insertReadDMA(*method.method.get(), method.method->appendToEnd(), tmp, source);
@@ -453,21 +455,21 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
         	{
         		//copy area of memory
         		const Value size = getValue(sizeID, *method.method, types, constants, globals, localTypes);
-        		logging::debug() << "Generating copying of " << size.to_string() << " bytes from " << source.to_string() << " into " << dest.to_string() << logging::endl;
+        		DEBUG_LOG("Generating copying of " << size.to_string() << " bytes from " << source.to_string() << " into " << dest.to_string() << logging::endl);
         		if(size.hasType(ValueType::LITERAL))
         		{
-        			method.method->vpm->insertCopyRAM(*method.method, method.method->appendToEnd(), dest, source, size.literal.integer, true);
+        			method.method->vpm->insertCopyRAM(*method.method, method.method->appendToEnd(), dest, source, static_cast<unsigned>(size.literal.integer), true);
         		}
         		else
-        			//TODO in any case, loop over copies, up to the size specified
-        			throw CompilationError(CompilationStep::LLVM_2_IR, "Copying dynamically sized memory is not yet implemented", size.to_string());
+        			//the loop over the copies can only be inserted after the phi-nodes are eliminated, so it is intrinsified later on
+        			method.method->appendToEnd(new intermediate::MethodCall("llvm.memcpy", {dest, source, size}));
         	}
         }
     }
     else if(!destIndices && !sourceIndices)
     {
         //simple move
-        logging::debug() << "Generating intermediate move from " << source.to_string() << " into " << dest.to_string(true) << logging::endl;
+        DEBUG_LOG("Generating intermediate move from " << source.to_string() << " into " << dest.to_string(true) << logging::endl);
         method.method->appendToEnd((new intermediate::MoveOperation(dest, source))->setDecorations(decorations));
     }
     else if(sourceIndices && dest.type.isScalarType())
@@ -475,7 +477,7 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
     	if(sourceIndices.get().size() > 1)
     		throw CompilationError(CompilationStep::LLVM_2_IR, "Multi level indices are not implemented yet");
         //index is literal
-        logging::debug() << "Generating intermediate extraction of index " << sourceIndices.get().at(0) << " from " << source.to_string() << " into " << dest.to_string(true) << logging::endl;
+        DEBUG_LOG("Generating intermediate extraction of index " << sourceIndices.get().at(0) << " from " << source.to_string() << " into " << dest.to_string(true) << logging::endl);
         intermediate::insertVectorExtraction(method.method->appendToEnd(), *method.method, source, Value(Literal(static_cast<long>(sourceIndices.get().at(0))), TYPE_INT8), dest);
     }
     else if((!sourceIndices || (sourceIndices.get().at(0) == 0)) && destIndices)
@@ -484,7 +486,7 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
 			throw CompilationError(CompilationStep::LLVM_2_IR, "Multi level indices are not implemented yet");
         //add element to vector to element
         //index is literal
-        logging::debug() << "Generating intermediate insertion of " << source.to_string() << " into element " << destIndices.get().at(0) << " of " << dest.to_string(true) << logging::endl;
+        DEBUG_LOG("Generating intermediate insertion of " << source.to_string() << " into element " << destIndices.get().at(0) << " of " << dest.to_string(true) << logging::endl);
         intermediate::insertVectorInsertion(method.method->appendToEnd(), *method.method, dest, Value(Literal(static_cast<long>(destIndices.get().at(0))), TYPE_INT8), source);
     }
     else
@@ -494,7 +496,7 @@ void SPIRVCopy::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uin
     }
 }
 
-Optional<Value> SPIRVCopy::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVCopy::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	if(constants.find(sourceID) != constants.end())
 		return constants.at(sourceID);
@@ -518,7 +520,7 @@ SPIRVShuffle::~SPIRVShuffle()
 
 }
 
-void SPIRVShuffle::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVShuffle::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     //shuffling = iteration over all elements in both vectors and re-ordering in order given
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
@@ -561,12 +563,12 @@ void SPIRVShuffle::mapInstruction(std::map<uint32_t, DataType>& types, std::map<
 			index = Value(indices, TYPE_INT8);
 		}
     }
-    logging::debug() << "Generating intermediate operations for mixing " << src0.to_string() << " and " << src1.to_string() << " into " << dest.to_string() << " with mask " << index.to_string(false, true) << logging::endl;
+    DEBUG_LOG("Generating intermediate operations for mixing " << src0.to_string() << " and " << src1.to_string() << " into " << dest.to_string() << " with mask " << index.to_string(false, true) << logging::endl);
     
     intermediate::insertVectorShuffle(method.method->appendToEnd(), *method.method, dest, src0, src1, index);
 }
 
-Optional<Value> SPIRVShuffle::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVShuffle::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	return NO_VALUE;
 }
@@ -582,14 +584,14 @@ SPIRVIndexOf::~SPIRVIndexOf()
 
 }
 
-void SPIRVIndexOf::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVIndexOf::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     //need to get pointer/address -> reference to content
     //a[i] of type t is at position &a + i * sizeof(t)
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
     const Value container = getValue(this->container, *method.method, types, constants, globals, localTypes);
 
-    logging::debug() << "Generating calculating indices of " << container.to_string() << " into " << dest.to_string() << logging::endl;
+    DEBUG_LOG("Generating calculating indices of " << container.to_string() << " into " << dest.to_string() << logging::endl);
     std::vector<Value> indexValues;
     indexValues.reserve(indices.size());
     for(const uint32_t indexID : indices)
@@ -600,7 +602,7 @@ void SPIRVIndexOf::mapInstruction(std::map<uint32_t, DataType>& types, std::map<
     intermediate::insertCalculateIndices(method.method->appendToEnd(), *method.method.get(), container, dest, indexValues, isPtrAcessChain);
 }
 
-Optional<Value> SPIRVIndexOf::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVIndexOf::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	Value container(UNDEFINED_VALUE);
 	if(constants.find(this->container) != constants.end())
@@ -617,7 +619,7 @@ Optional<Value> SPIRVIndexOf::precalculate(const std::map<uint32_t, DataType>& t
 	indexValues.reserve(indices.size());
 	std::for_each(indices.begin(), indices.end(), [&indexValues, &constants](uint32_t index) {indexValues.push_back(constants.at(index));});
 
-	logging::debug() << "Pre-calculating indices of " << container.to_string()  << logging::endl;
+	DEBUG_LOG("Pre-calculating indices of " << container.to_string()  << logging::endl);
 
 	//TODO regard isPtrAcessChain, if set, type of first index is original type
 
@@ -673,11 +675,11 @@ SPIRVPhi::~SPIRVPhi()
 
 }
 
-void SPIRVPhi::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVPhi::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
     
-    logging::debug() << "Generating Phi-Node with " << sources.size() << " options into " << dest.to_string() << logging::endl;
+    DEBUG_LOG("Generating Phi-Node with " << sources.size() << " options into " << dest.to_string() << logging::endl);
     //https://stackoverflow.com/questions/11485531/what-exactly-phi-instruction-does-and-how-to-use-it-in-llvm#11485946
     //sets the output value according to where from this instructions is executed/jumped from
     std::vector<std::pair<Value, const Local*>> labelPairs;
@@ -691,7 +693,7 @@ void SPIRVPhi::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint
     method.method->appendToEnd(new intermediate::PhiNode(dest, labelPairs));
 }
 
-Optional<Value> SPIRVPhi::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVPhi::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	return NO_VALUE;
 }
@@ -707,21 +709,21 @@ SPIRVSelect::~SPIRVSelect()
 
 }
 
-void SPIRVSelect::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVSelect::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value sourceTrue = getValue(trueID, *method.method, types, constants, globals, localTypes);
     const Value sourceFalse = getValue(falseID, *method.method, types, constants, globals, localTypes);
     const Value condition = getValue(condID, *method.method, types, constants, globals, localTypes);
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
     
-    logging::debug() << "Generating intermediate select on " << condition.to_string() << " whether to write " << sourceTrue.to_string() << " or " << sourceFalse.to_string() << " into " << dest.to_string(true) << logging::endl;
+    DEBUG_LOG("Generating intermediate select on " << condition.to_string() << " whether to write " << sourceTrue.to_string() << " or " << sourceFalse.to_string() << " into " << dest.to_string(true) << logging::endl);
     
     method.method->appendToEnd(new intermediate::MoveOperation(NOP_REGISTER, condition, COND_ALWAYS, SetFlag::SET_FLAGS));
     method.method->appendToEnd(new intermediate::MoveOperation(dest, sourceTrue, COND_ZERO_CLEAR));
     method.method->appendToEnd(new intermediate::MoveOperation(dest, sourceFalse, COND_ZERO_SET));
 }
 
-Optional<Value> SPIRVSelect::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVSelect::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	if(constants.find(condID) != constants.end())
 	{
@@ -748,12 +750,12 @@ SPIRVSwitch::~SPIRVSwitch()
 
 }
 
-void SPIRVSwitch::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVSwitch::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value selector = getValue(selectorID, *method.method, types, constants, globals, localTypes);
     const Value defaultLabel = getValue(defaultID, *method.method, types, constants, globals, localTypes);
     
-    logging::debug() << "Generating intermediate switched jump on " << selector.to_string() << " to " << destinations.size() << " destinations with default " << defaultLabel.to_string() << logging::endl;
+    DEBUG_LOG("Generating intermediate switched jump on " << selector.to_string() << " to " << destinations.size() << " destinations with default " << defaultLabel.to_string() << logging::endl);
     
     for(const auto& pair : destinations)
     {
@@ -769,7 +771,7 @@ void SPIRVSwitch::mapInstruction(std::map<uint32_t, DataType>& types, std::map<u
     method.method->appendToEnd(new intermediate::Branch(defaultLabel.local, COND_ALWAYS, BOOL_TRUE));
 }
 
-Optional<Value> SPIRVSwitch::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVSwitch::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	if(constants.find(selectorID) != constants.end())
 	{
@@ -796,7 +798,7 @@ SPIRVImageQuery::~SPIRVImageQuery()
 
 }
 
-void SPIRVImageQuery::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+void SPIRVImageQuery::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 {
     const Value dest = toNewLocal(*method.method, id, typeID, types, localTypes);
     const Value image = getValue(imageID, *method.method, types, constants, globals, localTypes);
@@ -809,19 +811,19 @@ void SPIRVImageQuery::mapInstruction(std::map<uint32_t, DataType>& types, std::m
     switch(valueID)
     {
         case ImageQuery::CHANNEL_DATA_TYPE:
-            logging::debug() << "Generating query of image's channel data-type for image: " << image.to_string() << logging::endl;
+            DEBUG_LOG("Generating query of image's channel data-type for image: " << image.to_string() << logging::endl);
             intermediate::insertQueryChannelDataType(method.method->appendToEnd(), *method.method, image, dest);
             return;
         case ImageQuery::CHANNEL_ORDER:
-            logging::debug() << "Generating query of image's channel order for image: " << image.to_string() << logging::endl;
+            DEBUG_LOG("Generating query of image's channel order for image: " << image.to_string() << logging::endl);
             intermediate::insertQueryChannelOrder(method.method->appendToEnd(), *method.method, image, dest);
             return;
         case ImageQuery::SIZES:
-            logging::debug() << "Generating query of image's measurements for image: " << image.to_string() << logging::endl;
+            DEBUG_LOG("Generating query of image's measurements for image: " << image.to_string() << logging::endl);
             intermediate::insertQueryMeasurements(method.method->appendToEnd(), *method.method, image, dest);
             return;
         case ImageQuery::SIZES_LOD:
-        	logging::debug() << "Generating query of image's measurements for image with LOD: " << image.to_string() << logging::endl;
+        	DEBUG_LOG("Generating query of image's measurements for image with LOD: " << image.to_string() << logging::endl);
         	if(param.hasLiteral(INT_ZERO.literal))
         	{
         		//same as above
@@ -840,7 +842,7 @@ void SPIRVImageQuery::mapInstruction(std::map<uint32_t, DataType>& types, std::m
     
 }
 
-Optional<Value> SPIRVImageQuery::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> SPIRVImageQuery::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	return NO_VALUE;
 }
@@ -854,8 +856,8 @@ vc4c::spirv2qasm::SPIRVMemoryBarrier::~SPIRVMemoryBarrier()
 {
 }
 
-void vc4c::spirv2qasm::SPIRVMemoryBarrier::mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods,
-		std::map<uint32_t, Global*>& globals) const
+void vc4c::spirv2qasm::SPIRVMemoryBarrier::mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods,
+		IdMap<Global*>& globals) const
 {
 	const Value scope = getValue(scopeID, *method.method, types, constants, globals, localTypes);
 	const Value semantics = getValue(semanticsID, *method.method, types, constants, globals, localTypes);
@@ -866,7 +868,7 @@ void vc4c::spirv2qasm::SPIRVMemoryBarrier::mapInstruction(std::map<uint32_t, Dat
 	method.method->appendToEnd(new intermediate::MemoryBarrier(static_cast<intermediate::MemoryScope>(scope.literal.integer), static_cast<intermediate::MemorySemantics>(semantics.literal.integer)));
 }
 
-Optional<Value> vc4c::spirv2qasm::SPIRVMemoryBarrier::precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const
+Optional<Value> vc4c::spirv2qasm::SPIRVMemoryBarrier::precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const
 {
 	return NO_VALUE;
 }
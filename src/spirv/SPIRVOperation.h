@@ -8,8 +8,13 @@
 #define SPIRVOPERATION_H
 #ifdef SPIRV_HEADER
 
+#include <deque>
+#include <limits>
 #include <memory>
 #include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 #include <vector>
 
 #include "../Module.h"
@@ -34,15 +39,172 @@ namespace vc4c
 			}
 		};
 
+		/*
+		 * The mapping of SPIR-V IDs to the values associated with them (e.g. types, constants, names).
+		 *
+		 * The IDs of a SPIR-V module are dense and smaller than the ID bound given in the module header,
+		 * so the position of the value of every ID is stored in a table indexed by the ID, making every look-up an array access.
+		 * The values are stored in the order of their insertion, in chunks, so references to values stay valid when inserting new IDs.
+		 */
+		template<typename T>
+		class IdMap
+		{
+		public:
+			using value_type = std::pair<uint32_t, T>;
+			using iterator = typename std::deque<value_type>::iterator;
+			using const_iterator = typename std::deque<value_type>::const_iterator;
+
+			/*
+			 * Pre-allocates the table for all IDs smaller than the given bound
+			 */
+			void reserve(const uint32_t idBound)
+			{
+				if(idBound > positions.size())
+					positions.resize(idBound, NO_ENTRY);
+			}
+
+			iterator begin()
+			{
+				return entries.begin();
+			}
+
+			const_iterator begin() const
+			{
+				return entries.begin();
+			}
+
+			iterator end()
+			{
+				return entries.end();
+			}
+
+			const_iterator end() const
+			{
+				return entries.end();
+			}
+
+			std::size_t size() const
+			{
+				return entries.size();
+			}
+
+			std::size_t count(const uint32_t id) const
+			{
+				return getPosition(id) != NO_ENTRY ? 1 : 0;
+			}
+
+			iterator find(const uint32_t id)
+			{
+				const uint32_t pos = getPosition(id);
+				return pos == NO_ENTRY ? entries.end() : entries.begin() + pos;
+			}
+
+			const_iterator find(const uint32_t id) const
+			{
+				const uint32_t pos = getPosition(id);
+				return pos == NO_ENTRY ? entries.end() : entries.begin() + pos;
+			}
+
+			T& at(const uint32_t id)
+			{
+				const uint32_t pos = getPosition(id);
+				if(pos == NO_ENTRY)
+					throw std::out_of_range("No value mapped for SPIR-V ID " + std::to_string(id));
+				return entries[pos].second;
+			}
+
+			const T& at(const uint32_t id) const
+			{
+				const uint32_t pos = getPosition(id);
+				if(pos == NO_ENTRY)
+					throw std::out_of_range("No value mapped for SPIR-V ID " + std::to_string(id));
+				return entries[pos].second;
+			}
+
+			/*
+			 * Inserts the value for the given ID, if the ID is not yet mapped. Returns the position of the value for the ID and whether it was inserted
+			 */
+			template<typename... Args>
+			std::pair<iterator, bool> emplace(const uint32_t id, Args&&... args)
+			{
+				const uint32_t pos = getPosition(id);
+				if(pos != NO_ENTRY)
+					return std::make_pair(entries.begin() + pos, false);
+				reserve(id + 1);
+				positions[id] = static_cast<uint32_t>(entries.size());
+				entries.emplace_back(std::piecewise_construct, std::forward_as_tuple(id), std::forward_as_tuple(std::forward<Args>(args)...));
+				return std::make_pair(entries.end() - 1, true);
+			}
+
+			T& operator[](const uint32_t id)
+			{
+				return emplace(id).first->second;
+			}
+
+		private:
+			static constexpr uint32_t NO_ENTRY = std::numeric_limits<uint32_t>::max();
+
+			std::vector<uint32_t> positions;
+			std::deque<value_type> entries;
+
+			uint32_t getPosition(const uint32_t id) const
+			{
+				return id < positions.size() ? positions[id] : NO_ENTRY;
+			}
+		};
+
+		template<typename T>
+		constexpr uint32_t IdMap<T>::NO_ENTRY;
+
+		/*
+		 * The mapping of locals to their types for a single method.
+		 *
+		 * Falls back to the types known after parsing, but stores the types of locals created while mapping per method,
+		 * so the instructions of different methods can be mapped in parallel.
+		 */
+		class LocalTypeMapping
+		{
+		public:
+			explicit LocalTypeMapping(const IdMap<uint32_t>& parsedTypes) : parsedTypes(parsedTypes)
+			{
+
+			}
+
+			uint32_t& operator[](const uint32_t id)
+			{
+				return methodTypes[id];
+			}
+
+			uint32_t at(const uint32_t id) const
+			{
+				auto it = methodTypes.find(id);
+				if(it != methodTypes.end())
+					return it->second;
+				return parsedTypes.at(id);
+			}
+
+		private:
+			const IdMap<uint32_t>& parsedTypes;
+			IdMap<uint32_t> methodTypes;
+		};
+
 		class SPIRVOperation
 		{
 		public:
 			SPIRVOperation(const uint32_t id, SPIRVMethod& method, const intermediate::InstructionDecorations decorations = intermediate::InstructionDecorations::NONE);
 			virtual ~SPIRVOperation();
 
-			virtual void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods,
-					std::map<uint32_t, Global*>& globals) const = 0;
-			virtual Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const = 0;
+			virtual void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods,
+					IdMap<Global*>& globals) const = 0;
+			virtual Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const = 0;
+
+			/*
+			 * The method this operation is located in
+			 */
+			const SPIRVMethod& getMethod() const
+			{
+				return method;
+			}
 
 		protected:
 			const uint32_t id;
@@ -61,9 +223,9 @@ namespace vc4c
 					intermediate::InstructionDecorations::NONE);
 			virtual ~SPIRVInstruction();
 
-			virtual void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			virtual void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		protected:
 			uint32_t typeID;
@@ -79,9 +241,9 @@ namespace vc4c
 					intermediate::InstructionDecorations::NONE);
 			virtual ~SPIRVComparison();
 
-			virtual void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			virtual void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 		};
 
 		class SPIRVCallSite: public SPIRVOperation
@@ -91,9 +253,9 @@ namespace vc4c
 			SPIRVCallSite(const uint32_t id, SPIRVMethod& method, const std::string& methodName, const uint32_t resultType, const std::vector<uint32_t>& arguments);
 			virtual ~SPIRVCallSite();
 
-			virtual void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			virtual void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		private:
 			Optional<uint32_t> methodID;
@@ -109,9 +271,9 @@ namespace vc4c
 			SPIRVReturn(const uint32_t returnValue, SPIRVMethod& method);
 			virtual ~SPIRVReturn();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		private:
 			Optional<uint32_t> returnValue;
@@ -124,9 +286,9 @@ namespace vc4c
 			SPIRVBranch(SPIRVMethod& method, const uint32_t conditionID, const uint32_t trueLabelID, const uint32_t falseLabelID);
 			virtual ~SPIRVBranch();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 		private:
 			const uint32_t defaultLabelID;
 			const Optional<uint32_t> conditionID;
@@ -139,9 +301,9 @@ namespace vc4c
 			SPIRVLabel(const uint32_t id, SPIRVMethod& method);
 			virtual ~SPIRVLabel();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 		};
 
 		enum class ConversionType
@@ -155,9 +317,9 @@ namespace vc4c
 			SPIRVConversion(const uint32_t id, SPIRVMethod& method, const uint32_t resultType, const uint32_t sourceID, const ConversionType type, const intermediate::InstructionDecorations decorations, bool isSaturated = false);
 			virtual ~SPIRVConversion();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 		private:
 			const uint32_t typeID;
 			const uint32_t sourceID;
@@ -178,9 +340,9 @@ namespace vc4c
 			//copies single parts
 			SPIRVCopy(const uint32_t id, SPIRVMethod& method, const uint32_t resultType, const uint32_t sourceID, const std::vector<uint32_t>& destIndices, const std::vector<uint32_t>& sourceIndices);
 			virtual ~SPIRVCopy();
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		private:
 			const uint32_t typeID;
@@ -198,9 +360,9 @@ namespace vc4c
 			SPIRVShuffle(const uint32_t id, SPIRVMethod& method, const uint32_t resultType, const uint32_t sourceID0, const uint32_t sourceID1, const uint32_t compositeIndex);
 			virtual ~SPIRVShuffle();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		private:
 			const uint32_t typeID;
@@ -216,9 +378,9 @@ namespace vc4c
 			SPIRVIndexOf(const uint32_t id, SPIRVMethod& method, const uint32_t resultType, const uint32_t containerID, const std::vector<uint32_t>& indices, const bool isPtrAcessChain);
 			virtual ~SPIRVIndexOf();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		private:
 			const uint32_t typeID;
@@ -233,9 +395,9 @@ namespace vc4c
 			SPIRVPhi(const uint32_t id, SPIRVMethod& method, const uint32_t resultType, const std::vector<std::pair<uint32_t, uint32_t>>& sources);
 			virtual ~SPIRVPhi();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		private:
 			const uint32_t typeID;
@@ -248,10 +410,10 @@ namespace vc4c
 			SPIRVSelect(const uint32_t id, SPIRVMethod& method, const uint32_t resultType, const uint32_t conditionID, const uint32_t trueObj, const uint32_t falseObj);
 			virtual ~SPIRVSelect();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
 			;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 		private:
 			const uint32_t typeID;
 			const uint32_t condID;
@@ -265,9 +427,9 @@ namespace vc4c
 			SPIRVSwitch(const uint32_t id, SPIRVMethod& method, const uint32_t selectorID, const uint32_t defaultID, const std::vector<std::pair<uint32_t, uint32_t>>& destinations);
 			virtual ~SPIRVSwitch();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		private:
 			const uint32_t selectorID;
@@ -286,9 +448,9 @@ namespace vc4c
 			SPIRVImageQuery(const uint32_t id, SPIRVMethod& method, const uint32_t resultType, const ImageQuery value, const uint32_t imageID, const uint32_t lodOrCoordinate = UNDEFINED_ID);
 			virtual ~SPIRVImageQuery();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 
 		private:
 			const uint32_t typeID;
@@ -303,9 +465,9 @@ namespace vc4c
 			SPIRVMemoryBarrier(SPIRVMethod& method, const uint32_t scopeID, const uint32_t semanticsID);
 			virtual ~SPIRVMemoryBarrier();
 
-			void mapInstruction(std::map<uint32_t, DataType>& types, std::map<uint32_t, Value>& constants, std::map<uint32_t, uint32_t>& localTypes, std::map<uint32_t, SPIRVMethod>& methods, std::map<uint32_t, Global*>& globals) const
+			void mapInstruction(IdMap<DataType>& types, IdMap<Value>& constants, LocalTypeMapping& localTypes, std::map<uint32_t, SPIRVMethod>& methods, IdMap<Global*>& globals) const
 					override;
-			Optional<Value> precalculate(const std::map<uint32_t, DataType>& types, const std::map<uint32_t, Value>& constants, const std::map<uint32_t, Global*>& globals) const override;
+			Optional<Value> precalculate(const IdMap<DataType>& types, const IdMap<Value>& constants, const IdMap<Global*>& globals) const override;
 		private:
 			const uint32_t scopeID;
 			const uint32_t semanticsID;
@@ -6,12 +6,19 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <map>
 
 #include "SPIRVParser.h"
-#include "log.h"
+#include "../Logging.h"
 #include "SPIRVHelper.h"
+#include "../MemoryStream.h"
+#include "../CompilationCache.h"
 
 #include "../intermediate/IntermediateInstruction.h"
+#include "../intermediate/InstructionArena.h"
 #include "../intrinsics/Images.h"
 #ifdef SPIRV_HEADER
 
@@ -29,7 +36,7 @@ SPIRVParser::SPIRVParser(std::istream& input, const bool isSPIRVText) : isTextIn
 
 static spv_result_t parsedHeaderCallback(void* user_data, spv_endianness_t endian, uint32_t magic, uint32_t version, uint32_t generator, uint32_t id_bound, uint32_t reserved)
 {
-    logging::debug() << "SPIR-V header parsed: magic-number 0x" << std::hex << magic << ", version 0x" << version << ", generator " << generator << ", max-ID " << std::dec << id_bound << logging::endl;
+    DEBUG_LOG("SPIR-V header parsed: magic-number 0x" << std::hex << magic << ", version 0x" << version << ", generator " << generator << ", max-ID " << std::dec << id_bound << logging::endl);
     SPIRVParser* parser = (SPIRVParser*) user_data;
     return parser->parseHeader(endian, magic, version, generator, id_bound, reserved);
 }
@@ -47,41 +54,77 @@ static std::string getErrorPosition(spv_diagnostic diagnostics)
     return std::to_string(diagnostics->position.line).append(":") + std::to_string(diagnostics->position.column);
 }
 
-static std::vector<uint32_t> runSPRVToolsOptimizer(const std::vector<uint32_t>& input)
-{
 #ifdef SPIRV_OPTIMIZER_HEADER
-	logging::debug() << "Running SPIR-V Tools optimizations..." << logging::endl;
-	spvtools::Optimizer opt(SPV_ENV_OPENCL_2_1);
-	opt.SetMessageConsumer(consumeSPIRVMessage);
+struct SPIRVOptimizationPass
+{
+	const char* name;
+	spvtools::Optimizer::PassToken (*create)();
+};
+
+//the optimization passes supported, by their names used by spirv-opt.
+//A plain array of function pointers, so loading the library does not construct any container
+static const SPIRVOptimizationPass SPIRV_OPTIMIZATION_PASSES[] = {
 	//converts OpSpecConstant(True/False) to OpConstant(True/False)
-	opt.RegisterPass(spvtools::CreateFreezeSpecConstantValuePass());
+	{"freeze-spec-const", spvtools::CreateFreezeSpecConstantValuePass},
 	//converts OpSpecConstantOp and OpSpecConstantComposite to OpConstants
-	opt.RegisterPass(spvtools::CreateFoldSpecConstantOpAndCompositePass());
+	{"fold-spec-const-op-composite", spvtools::CreateFoldSpecConstantOpAndCompositePass},
 	//unified duplicate constants
-	opt.RegisterPass(spvtools::CreateUnifyConstantPass());
+	{"unify-const", spvtools::CreateUnifyConstantPass},
 	//removed obsolete constants
-	opt.RegisterPass(spvtools::CreateEliminateDeadConstantPass());
+	{"eliminate-dead-const", spvtools::CreateEliminateDeadConstantPass},
 	//inline methods
-	opt.RegisterPass(spvtools::CreateInlinePass());
+	{"inline-entry-points-exhaustive", spvtools::CreateInlinePass},
 	//converts access-chain with constant indices
-	opt.RegisterPass(spvtools::CreateLocalAccessChainConvertPass());
+	{"convert-local-access-chains", spvtools::CreateLocalAccessChainConvertPass},
 	//replaces access to local memory with register-usage
-	opt.RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass());
+	{"eliminate-local-single-block", spvtools::CreateLocalSingleBlockLoadStoreElimPass}
+};
+#endif
+
+/*
+ * Runs the SPIRV-Tools optimizer with the given passes, returns whether the output was written
+ */
+static bool runSPRVToolsOptimizer(const uint32_t* input, const std::size_t numWords, const std::vector<std::string>& passes, std::vector<uint32_t>& output)
+{
+#ifdef SPIRV_OPTIMIZER_HEADER
+	if(passes.empty())
+		return false;
+	//the result of the optimizer only depends on the input and the passes, so it can be re-used for the same input
+	const std::string cacheKey = getSPIRVOptimizationCacheKey(input, numWords, passes);
+	const Optional<std::string> cachedWords = readCompilationCache(cacheKey);
+	if(cachedWords && cachedWords.get().size() % sizeof(uint32_t) == 0)
+	{
+		output.resize(cachedWords.get().size() / sizeof(uint32_t));
+		memcpy(output.data(), cachedWords.get().data(), cachedWords.get().size());
+		DEBUG_LOG("Using cached SPIR-V Tools optimization result with " << output.size() << " words" << logging::endl);
+		return true;
+	}
 
-	std::vector<uint32_t> optimizedWords;
-	if(!opt.Run(input.data(), input.size(), &optimizedWords))
+	DEBUG_LOG("Running SPIR-V Tools optimizations..." << logging::endl);
+	spvtools::Optimizer opt(SPV_ENV_OPENCL_2_1);
+	opt.SetMessageConsumer(consumeSPIRVMessage);
+	for(const std::string& pass : passes)
+	{
+		auto it = std::find_if(std::begin(SPIRV_OPTIMIZATION_PASSES), std::end(SPIRV_OPTIMIZATION_PASSES), [&pass](const SPIRVOptimizationPass& entry) -> bool { return pass == entry.name;});
+		if(it == std::end(SPIRV_OPTIMIZATION_PASSES))
+			throw CompilationError(CompilationStep::PARSER, "Unknown SPIR-V Tools optimization pass", pass);
+		opt.RegisterPass(it->create());
+	}
+
+	if(!opt.Run(input, numWords, &output))
 	{
 		logging::warn() << "Error running SPIR-V Tools optimizer!" << logging::endl;
 	}
-	else if(optimizedWords.size() > 0)
+	else if(output.size() > 0)
 	{
-		logging::debug() << "SPIR-V Tools optimizations complete, changed number of words from " << input.size() << " to " << optimizedWords.size() << logging::endl;
-		return optimizedWords;
+		DEBUG_LOG("SPIR-V Tools optimizations complete, changed number of words from " << numWords << " to " << output.size() << logging::endl);
+		writeCompilationCache(cacheKey, std::string(reinterpret_cast<const char*>(output.data()), output.size() * sizeof(uint32_t)));
+		return true;
 	}
 	else
-		logging::debug() << "SPIR-V Tools optimizations complete, no changes." << logging::endl;
+		DEBUG_LOG("SPIR-V Tools optimizations complete, no changes." << logging::endl);
 #endif
-	return input;
+	return false;
 }
 
 
@@ -97,72 +140,70 @@ void SPIRVParser::parse(Module& module)
         throw CompilationError(CompilationStep::PARSER, "Failed to create SPIR-V context");
     }
 
-    //read input and map into buffer
-    std::vector<uint32_t> words = readStreamOfWords(input);
+    //if the input is a SPIR-V binary in memory, parse it directly without copying
+    std::vector<uint32_t> words;
+    const uint32_t* binaryWords = nullptr;
+    std::size_t numWords = 0;
+    const MemoryStreamBuffer* memoryInput = dynamic_cast<const MemoryStreamBuffer*>(input.rdbuf());
+    if(!isTextInput && memoryInput != nullptr && memoryInput->size() % sizeof(uint32_t) == 0 && reinterpret_cast<uintptr_t>(memoryInput->data()) % alignof(uint32_t) == 0)
+    {
+    	binaryWords = reinterpret_cast<const uint32_t*>(memoryInput->data());
+    	numWords = memoryInput->size() / sizeof(uint32_t);
+    	DEBUG_LOG("Using SPIR-V binary with " << numWords << " words from memory" << logging::endl);
+    }
+    else
+    {
+		//read input and map into buffer
+		words = readStreamOfWords(input);
 
-    //if input is SPIR-V text, convert to binary representation
-    spv_result_t result;
-    if (isTextInput) {
-    	spvtools::SpirvTools tools(SPV_ENV_OPENCL_2_1);
-    	tools.SetMessageConsumer(consumeSPIRVMessage);
-    	std::vector<uint32_t> binaryData;
-    	logging::debug() << "Read SPIR-V text with " << words.size() * sizeof (uint32_t) << " characters" << logging::endl;
-    	if(tools.Assemble(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint32_t), &binaryData))
-    		words.swap(binaryData);
+		//if input is SPIR-V text, convert to binary representation
+		if (isTextInput) {
+			spvtools::SpirvTools tools(SPV_ENV_OPENCL_2_1);
+			tools.SetMessageConsumer(consumeSPIRVMessage);
+			std::vector<uint32_t> binaryData;
+			DEBUG_LOG("Read SPIR-V text with " << words.size() * sizeof (uint32_t) << " characters" << logging::endl);
+			if(tools.Assemble(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint32_t), &binaryData))
+				words.swap(binaryData);
+		}
+		else {
+			DEBUG_LOG("Read SPIR-V binary with " << words.size() << " words" << logging::endl);
+		}
     }
-    else {
-        logging::debug() << "Read SPIR-V binary with " << words.size() << " words" << logging::endl;
+
+    if(binaryWords == nullptr)
+    {
+    	binaryWords = words.data();
+    	numWords = words.size();
     }
 
     //run SPIR-V Tools optimizations
-#ifdef SPIRV_OPTIMIZER_HEADER
-    words = runSPRVToolsOptimizer(words);
-#endif
+    std::vector<uint32_t> optimizedWords;
+    std::vector<std::string> spirvPasses = module.compilationConfig.spirvOptimizationPasses;
+    if(!module.compilationConfig.specializationConstants.empty())
+    	//freezing the specialization constants would replace them with their default values, before the given values are applied by the parser
+    	spirvPasses.erase(std::remove_if(spirvPasses.begin(), spirvPasses.end(), [](const std::string& pass) -> bool
+		{
+    		return pass == "freeze-spec-const" || pass == "fold-spec-const-op-composite";
+		}), spirvPasses.end());
+    if(runSPRVToolsOptimizer(binaryWords, numWords, spirvPasses, optimizedWords))
+    {
+    	binaryWords = optimizedWords.data();
+    	numWords = optimizedWords.size();
+    }
 
-    logging::debug() << "Starting parsing..." << logging::endl;
+    DEBUG_LOG("Starting parsing..." << logging::endl);
 
     //parse input
-    result = spvBinaryParse(context, this, words.data(), words.size(), parsedHeaderCallback, parsedInstructionCallback, &diagnostics);
+    spv_result_t result = spvBinaryParse(context, this, binaryWords, numWords, parsedHeaderCallback, parsedInstructionCallback, &diagnostics);
 
     if (result != SPV_SUCCESS) {
         logging::error() << getErrorMessage(result) << ": " << (diagnostics != NULL ? diagnostics->error : errorExtra) << " at " << getErrorPosition(diagnostics) << logging::endl;
         spvContextDestroy(context);
         throw CompilationError(CompilationStep::PARSER, getErrorMessage(result), (diagnostics != NULL ? diagnostics->error : errorExtra));
     }
-    logging::debug() << "SPIR-V binary successfully parsed" << logging::endl;
+    DEBUG_LOG("SPIR-V binary successfully parsed" << logging::endl);
     spvContextDestroy(context);
 
-    // resolve method parameters
-    //set names, e.g. for methods, parameters
-    for (auto& m : methods) {
-        if (names.find(m.first) != names.end())
-            m.second.method->name = names.at(m.first);
-        m.second.method->parameters.reserve(m.second.parameters.size());
-        for (const auto& pair : m.second.parameters)
-        {
-            std::string name;
-            if (names.find(pair.first) != names.end())
-            {
-            	//parameters are referenced by their IDs, not their names, but for meta-data the names are better
-                name = names.at(pair.first);
-                m.second.method->metaData[MetaDataType::ARG_NAMES].push_back(name);
-            }
-            const DataType& type = typeMappings.at(pair.second);
-            Parameter param(std::string("%") + std::to_string(pair.first), type);
-            if(decorationMappings.find(pair.first) != decorationMappings.end())
-            {
-            	setParameterDecorations(param, decorationMappings.at(pair.first));
-            }
-            m.second.method->parameters.emplace_back(std::move(param));
-        }
-    }
-
-    //map SPIRVOperations to IntermediateInstructions
-    logging::debug() << "Mapping instructions to intermediate..." << logging::endl;
-    for (const std::unique_ptr<SPIRVOperation>& op : instructions) {
-        op->mapInstruction(typeMappings, constantMappings, localTypes, methods, globalData);
-    }
-
     //apply kernel meta-data, decorations, ...
     for (const auto& pair : metadataMappings) {
         methods.at(pair.first).method->metaData.insert(pair.second.begin(), pair.second.end());
@@ -194,12 +235,54 @@ void SPIRVParser::parse(Module& module)
 spv_result_t SPIRVParser::parseHeader(spv_endianness_t endian, uint32_t magic, uint32_t version, uint32_t generator, uint32_t id_bound, uint32_t reserved)
 {
     //see: https://www.khronos.org/registry/spir-v/specs/1.2/SPIRV.html#_a_id_physicallayout_a_physical_layout_of_a_spir_v_module_and_instruction
-	//not completely true, since the header is not mapped to instructions, but still better than increasing every X new instruction
+	//not completely true, since the header is not mapped to instructions and the list only contains the instructions of a single function,
+	//but still better than increasing every X new instruction
 	instructions.reserve(id_bound);
+	//all IDs are smaller than the bound, so the ID tables never need to grow
+	typeMappings.reserve(id_bound);
+	constantMappings.reserve(id_bound);
+	globalData.reserve(id_bound);
+	sampledImages.reserve(id_bound);
+	decorationMappings.reserve(id_bound);
+	localTypes.reserve(id_bound);
+	names.reserve(id_bound);
 
     return SPV_SUCCESS;
 }
 
+void SPIRVParser::mapMethod(SPIRVMethod& method)
+{
+    //set names, e.g. for parameters
+    method.method->parameters.reserve(method.parameters.size());
+    for (const auto& pair : method.parameters)
+    {
+        std::string name;
+        if (names.find(pair.first) != names.end())
+        {
+        	//parameters are referenced by their IDs, not their names, but for meta-data the names are better
+            name = names.at(pair.first);
+            method.method->metaData[MetaDataType::ARG_NAMES].push_back(name);
+        }
+        const DataType& type = typeMappings.at(pair.second);
+        Parameter param(std::string("%") + std::to_string(pair.first), type);
+        if(decorationMappings.find(pair.first) != decorationMappings.end())
+        {
+        	setParameterDecorations(param, decorationMappings.at(pair.first));
+        }
+        method.method->parameters.emplace_back(std::move(param));
+    }
+
+    //map SPIRVOperations to IntermediateInstructions
+    DEBUG_LOG("Mapping instructions of function %" << method.id << " to intermediate..." << logging::endl);
+    intermediate::InstructionArena::Scope arenaScope(method.method->getInstructionArena());
+    LocalTypeMapping methodLocalTypes(localTypes);
+    for (const std::unique_ptr<SPIRVOperation>& op : instructions) {
+        op->mapInstruction(typeMappings, constantMappings, methodLocalTypes, methods, globalData);
+    }
+    //the operations are not needed anymore, the memory (but not the capacity) is re-used for the next function
+    instructions.clear();
+}
+
 intermediate::InstructionDecorations toInstructionDecoration(const SpvFPFastMathModeMask mode)
 {
     intermediate::InstructionDecorations decorations = intermediate::InstructionDecorations::NONE;
@@ -326,7 +409,7 @@ static intermediate::Sampler parseSampler(const spv_parsed_instruction_t* instru
     return tmp;
 }
 
-static Value parseConstant(const spv_parsed_instruction_t* instruction, const std::map<uint32_t, DataType>& typeMappings)
+static Value parseConstant(const spv_parsed_instruction_t* instruction, const IdMap<DataType>& typeMappings)
 {
 	Value constant(typeMappings.at(instruction->type_id));
 	if (instruction->num_words > 3) {
@@ -341,7 +424,7 @@ static Value parseConstant(const spv_parsed_instruction_t* instruction, const st
 	return constant;
 }
 
-static Value parseConstantComposite(const spv_parsed_instruction_t* instruction, const std::map<uint32_t, DataType>& typeMappings, const std::map<uint32_t, Value>& constantMappings)
+static Value parseConstantComposite(const spv_parsed_instruction_t* instruction, const IdMap<DataType>& typeMappings, const IdMap<Value>& constantMappings)
 {
 	DataType containerType = typeMappings.at(getWord(instruction, 1));
 	std::vector<Value> constants;
@@ -354,15 +437,24 @@ static Value parseConstantComposite(const spv_parsed_instruction_t* instruction,
 	return Value(ContainerValue{constants}, containerType);
 }
 
-static Optional<Value> specializeConstant(const uint32_t resultID, const DataType& type, const std::map<uint32_t, std::vector<std::pair<SpvDecoration, uint32_t>>>& decorations)
+/*
+ * Returns the value given in the configuration for the specialization constant, or nothing if the default value is to be used
+ */
+static Optional<Value> specializeConstant(const uint32_t resultID, const DataType& type, const IdMap<std::vector<std::pair<SpvDecoration, uint32_t>>>& decorations,
+		const std::vector<SpecializationConstant>& specializations)
 {
-	if(decorations.find(resultID) != decorations.end())
-	{
-		Optional<uint32_t> res(getDecoration(decorations.at(resultID), SpvDecorationSpecId));
-		if(res.hasValue)
-			return Value(Literal(static_cast<long>(res.get())), type);
-	}
-	return NO_VALUE;
+	if(specializations.empty() || decorations.find(resultID) == decorations.end())
+		return NO_VALUE;
+	Optional<uint32_t> specId(getDecoration(decorations.at(resultID), SpvDecorationSpecId));
+	if(!specId)
+		return NO_VALUE;
+	auto it = std::find_if(specializations.begin(), specializations.end(), [&specId](const SpecializationConstant& constant) -> bool { return constant.specId == specId.get();});
+	if(it == specializations.end())
+		return NO_VALUE;
+	if(type == TYPE_BOOL)
+		return Value(Literal(it->value != 0), type);
+	//like the literal operands of OpConstant, the value is stored as its bits
+	return Value(Literal(static_cast<long>(it->value)), type);
 }
 
 static SPIRVMethod& getOrCreateMethod(const Module& module, std::map<uint32_t, SPIRVMethod>& methods, const uint32_t id)
@@ -384,7 +476,7 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
      * Constants are resolved immediately
      * Specializations are immediately mapped to constants
      * Names are resolved immediately
-     * All instructions are enqueued to be mapped later
+     * All instructions are enqueued to be mapped at the end of their function
      *
      * Only opcodes for supported capabilities (or standard-opcodes) are listed here
      */
@@ -415,7 +507,7 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     case SpvOpExtension:
     {
         const std::string extension = readLiteralString(parsed_instruction, &parsed_instruction->operands[0]);
-        logging::debug() << "Using extension: " << extension << logging::endl;
+        DEBUG_LOG("Using extension: " << extension << logging::endl);
         //there are currently no extensions supported
         //a list of all extension: https://www.khronos.org/registry/spir-v/
         throw CompilationError(CompilationStep::PARSER, "Use of unsupported SPIR-V extension", extension);
@@ -423,7 +515,7 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     case SpvOpExtInstImport: //adds a new set of instructions
     {
         const std::string instructionSet(readLiteralString(parsed_instruction, &parsed_instruction->operands[1]));
-        logging::debug() << "Importing extended instruction set: " << instructionSet << logging::endl;
+        DEBUG_LOG("Importing extended instruction set: " << instructionSet << logging::endl);
         if (instructionSet.find("OpenCL") == std::string::npos)
             throw CompilationError(CompilationStep::PARSER, "Unsupported extended instruction set", instructionSet);
         return SPV_SUCCESS;
@@ -438,6 +530,17 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
 			instructions.emplace_back(new SPIRVShuffle(parsed_instruction->result_id, *currentMethod, parsed_instruction->type_id, getWord(parsed_instruction, 5), getWord(parsed_instruction, 6), getWord(parsed_instruction, 7)));
 			return SPV_SUCCESS;
         }
+        if(getWord(parsed_instruction, 4) >= OpenCLLIB::Entrypoints::Vload_half && getWord(parsed_instruction, 4) <= OpenCLLIB::Entrypoints::Vstorea_halfn_r)
+        {
+        	//the half-float loads/stores are lowered to 16-bit memory accesses in the intrinsics (see Intrinsics.cpp),
+        	//only the offset and pointer (and the stored value) are passed, not the vector-size or rounding-mode
+        	const bool isLoad = getWord(parsed_instruction, 4) <= OpenCLLIB::Entrypoints::Vload_halfn || getWord(parsed_instruction, 4) == OpenCLLIB::Entrypoints::Vloada_halfn;
+        	std::vector<uint32_t> arguments = parseArguments(parsed_instruction, 5);
+        	arguments.resize(isLoad ? 2 : 3);
+        	localTypes[parsed_instruction->result_id] = parsed_instruction->type_id;
+        	instructions.emplace_back(new SPIRVCallSite(parsed_instruction->result_id, *currentMethod, getOpenCLMethodName(getWord(parsed_instruction, 4)), parsed_instruction->type_id, arguments));
+        	return SPV_SUCCESS;
+        }
         //these instructions are not really handled -> throw error here (where we know the method-name)
         throw CompilationError(CompilationStep::PARSER, "OpenCL standard-function seems to be not implemented", getOpenCLMethodName(getWord(parsed_instruction, 4)));
     }
@@ -446,9 +549,9 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
             throw CompilationError(CompilationStep::PARSER, "Invalid addressing-mode");
         if (getWord(parsed_instruction, 2) != SpvMemoryModelSimple && getWord(parsed_instruction, 2) != SpvMemoryModelOpenCL)
             throw CompilationError(CompilationStep::PARSER, "Invalid memory model");
-        logging::debug() << "Using a " << (getWord(parsed_instruction, 1) == SpvAddressingModelLogical ? "logical" : "physical")
+        DEBUG_LOG("Using a " << (getWord(parsed_instruction, 1) == SpvAddressingModelLogical ? "logical" : "physical")
                 << " " << (getWord(parsed_instruction, 2) == SpvMemoryModelSimple ? "simple" : "OpenCL")
-                << " memory model" << logging::endl;
+                << " memory model" << logging::endl);
         return SPV_SUCCESS;
     case SpvOpEntryPoint: //an entry point is an OpenCL kernel
     {
@@ -457,7 +560,7 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
         SPIRVMethod& m = getOrCreateMethod(*module, methods, getWord(parsed_instruction, 2));
         m.method->isKernel = true;
         m.method->name = readLiteralString(parsed_instruction, &parsed_instruction->operands[2]);
-        logging::debug() << "Kernel-method found: " << m.method->name << logging::endl;
+        DEBUG_LOG("Kernel-method found: " << m.method->name << logging::endl);
         return SPV_SUCCESS;
     }
     case SpvOpExecutionMode:
@@ -542,9 +645,7 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     case SpvOpTypeArray:
     {
         const DataType elementType = typeMappings.at(getWord(parsed_instruction, 2));
-        DataType arrayType((elementType.to_string() + "[") + std::to_string(constantMappings.at(getWord(parsed_instruction, 3)).literal.integer) + "]");
-        arrayType.complexType.reset(new ArrayType(elementType, constantMappings.at(getWord(parsed_instruction, 3)).literal.integer));
-        typeMappings[getWord(parsed_instruction, 1)] = arrayType;
+        typeMappings[getWord(parsed_instruction, 1)] = module->types.getArrayType(elementType, constantMappings.at(getWord(parsed_instruction, 3)).literal.integer);
         return SPV_SUCCESS;
     }
     case SpvOpTypeStruct:
@@ -578,10 +679,8 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
         return SPV_SUCCESS;
     case SpvOpTypePointer:
     {
-        DataType type = typeMappings.at(getWord(parsed_instruction, 3));
-        std::shared_ptr<ComplexType> elemType(new PointerType(type, toAddressSpace(static_cast<SpvStorageClass>(getWord(parsed_instruction, 2)))));
-        type = DataType(type.to_string() + "*", 1, elemType);
-        typeMappings[getWord(parsed_instruction, 1)] = type;
+        const DataType& type = typeMappings.at(getWord(parsed_instruction, 3));
+        typeMappings[getWord(parsed_instruction, 1)] = module->types.getPointerType(type, toAddressSpace(static_cast<SpvStorageClass>(getWord(parsed_instruction, 2))));
         return SPV_SUCCESS;
     }
     case SpvOpTypeFunction:
@@ -655,7 +754,7 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
      *  Applying these final constant values yields a new module having fewer remaining specialization constants.
      *  A module also contains default values for any specialization constants that never get externally specialized."
      *
-     *  We simply ignore external specializations and always use the default value:
+     *  The external specializations are given in the configuration (see Configuration#specializationConstants), all other constants use their default value:
      *  OpSpecConstantTrue -> OpConstantTrue
      *  OpSpecConstantFalse -> OpConstantFalse
      *  OpSpecConstant -> OpConstant
@@ -665,14 +764,14 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     case SpvOpSpecConstantTrue:
     {
     	//"[...] Similarly, the "True" and "False" parts of OpSpecConstantTrue and OpSpecConstantFalse provide the default Boolean specialization constants."
-    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, TYPE_BOOL, decorationMappings);
+    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, TYPE_BOOL, decorationMappings, module->compilationConfig.specializationConstants);
 		constantMappings.emplace(parsed_instruction->result_id, spec ? spec.get() : BOOL_TRUE);
     	return SPV_SUCCESS;
     }
     case SpvOpSpecConstantFalse:
     {
     	//"[...] Similarly, the "True" and "False" parts of OpSpecConstantTrue and OpSpecConstantFalse provide the default Boolean specialization constants."
-    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, TYPE_BOOL, decorationMappings);
+    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, TYPE_BOOL, decorationMappings, module->compilationConfig.specializationConstants);
 		constantMappings.emplace(parsed_instruction->result_id, spec ? spec.get() : BOOL_FALSE);
 		return SPV_SUCCESS;
     }
@@ -680,14 +779,14 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     {
     	//"The literal operands to OpSpecConstant are the default numerical specialization constants."
     	const Value constant = parseConstant(parsed_instruction, typeMappings);
-    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, constant.type, decorationMappings);
+    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, constant.type, decorationMappings, module->compilationConfig.specializationConstants);
     	constantMappings.emplace(parsed_instruction->result_id, spec ? spec.get() : constant);
 		return SPV_SUCCESS;
     }
     case SpvOpSpecConstantComposite:
     {
     	const Value constant = parseConstantComposite(parsed_instruction, typeMappings, constantMappings);
-    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, constant.type, decorationMappings);
+    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, constant.type, decorationMappings, module->compilationConfig.specializationConstants);
     	constantMappings.emplace(parsed_instruction->result_id, spec ? spec.get() : constant);
 		return SPV_SUCCESS;
     }
@@ -695,7 +794,7 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     {
     	//"The OpSpecConstantOp instruction is specialized by executing the operation and replacing the instruction with the result."
     	const DataType type = typeMappings.at(parsed_instruction->type_id);
-    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, type, decorationMappings);
+    	const Optional<Value> spec = specializeConstant(parsed_instruction->result_id, type, decorationMappings, module->compilationConfig.specializationConstants);
     	if(spec)
     	{
     		constantMappings.emplace(parsed_instruction->result_id, spec.get());
@@ -715,26 +814,36 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
     case SpvOpFunction: //new current method -> add to list of all methods
     {
         currentMethod = &getOrCreateMethod(*module, methods, parsed_instruction->result_id);
+        if (names.find(parsed_instruction->result_id) != names.end())
+            currentMethod->method->name = names.at(parsed_instruction->result_id);
         currentMethod->method->returnType = typeMappings.at(parsed_instruction->type_id);
         //add label %0 to the beginning of the method
         //XXX maybe this is not necessary? If so, it is removed anyway
         typeMappings[0] = TYPE_LABEL;
         instructions.emplace_back(new SPIRVLabel(0, *currentMethod));
-        logging::debug() << "Reading function: %" << parsed_instruction->result_id << " (" << (names.find(parsed_instruction->result_id) != names.end() ? names.at(parsed_instruction->result_id) : currentMethod->method->name) << ")" << logging::endl;
+        DEBUG_LOG("Reading function: %" << parsed_instruction->result_id << " (" << (names.find(parsed_instruction->result_id) != names.end() ? names.at(parsed_instruction->result_id) : currentMethod->method->name) << ")" << logging::endl);
         return SPV_SUCCESS;
     }
     case SpvOpFunctionParameter:
         localTypes[parsed_instruction->result_id] = parsed_instruction->type_id;
         currentMethod->parameters.push_back(std::make_pair(parsed_instruction->result_id, parsed_instruction->type_id));
-        logging::debug() << "Reading parameter: " << typeMappings.at(parsed_instruction->type_id).to_string() << " %" << parsed_instruction->result_id << logging::endl;
+        DEBUG_LOG("Reading parameter: " << typeMappings.at(parsed_instruction->type_id).to_string() << " %" << parsed_instruction->result_id << logging::endl);
         return SPV_SUCCESS;
     case SpvOpFunctionEnd:
+        //all IDs referenced within the function are known now, so its instructions can be mapped
+        mapMethod(*currentMethod);
         currentMethod = nullptr;
         return SPV_SUCCESS;
     case SpvOpFunctionCall:
+    {
+        //the called function may be defined later, but its name needs to be known when the call-site is mapped
+        SPIRVMethod& calledMethod = getOrCreateMethod(*module, methods, getWord(parsed_instruction, 3));
+        if (names.find(calledMethod.id) != names.end())
+            calledMethod.method->name = names.at(calledMethod.id);
         localTypes[parsed_instruction->result_id] = parsed_instruction->type_id;
         instructions.emplace_back(new SPIRVCallSite(parsed_instruction->result_id, *currentMethod, getWord(parsed_instruction, 3), parsed_instruction->type_id, parseArguments(parsed_instruction, 4)));
         return SPV_SUCCESS;
+    }
     case SpvOpVariable:
     {
     	//"Allocate an object in memory, resulting in a pointer to it"
@@ -751,7 +860,7 @@ spv_result_t SPIRVParser::parseInstruction(const spv_parsed_instruction_t* parse
         //... but the global data needs to have the real type (is re-set in #parse())
         module->globalData.emplace_back(Global(name, globalType, val));
         globalData.emplace(parsed_instruction->result_id, &module->globalData.back());
-        logging::debug() << "Reading variable: " << globalType.to_string() << " " << name << " with value: " << val.to_string(false, true) << logging::endl;
+        DEBUG_LOG("Reading variable: " << globalType.to_string() << " " << name << " with value: " << val.to_string(false, true) << logging::endl);
         return SPV_SUCCESS;
     }
     case SpvOpImageTexelPointer:
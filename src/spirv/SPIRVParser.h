@@ -57,27 +57,31 @@ namespace vc4c
 			//the currently processed method, only valid while parsing
 			SPIRVMethod* currentMethod;
 			//the global mapping of ID -> constants
-			std::map<uint32_t, Value> constantMappings;
+			IdMap<Value> constantMappings;
 			//the global mapping of ID -> global data
-			std::map<uint32_t, Global*> globalData;
+			IdMap<Global*> globalData;
 			//the global mapping of ID -> type
-			std::map<uint32_t, DataType> typeMappings;
+			IdMap<DataType> typeMappings;
 			//the global mapping of ID -> sampled images
-			std::map<uint32_t, SampledImage> sampledImages;
+			IdMap<SampledImage> sampledImages;
 			//the global mapping of ID -> decorations (applied to this ID)
-			std::map<uint32_t, std::vector<Decoration>> decorationMappings;
+			IdMap<std::vector<Decoration>> decorationMappings;
 			//mapping of locals to their types
-			std::map<uint32_t, uint32_t> localTypes;
-			//the global list of instructions, each instruction stores its own reference to the method it is in
+			IdMap<uint32_t> localTypes;
+			//the instructions of the currently processed method, they are mapped (and removed) at the end of the method
 			std::vector<std::unique_ptr<SPIRVOperation>> instructions;
 			//the global mapping of kernel ID -> meta-data
 			std::map<uint32_t, std::map<MetaDataType, std::vector<std::string>>>metadataMappings;
 			//the global mapping of ID -> name for this ID (e.g. type-, function-name)
-			std::map<uint32_t, std::string> names;
+			IdMap<std::string> names;
 
 			Module* module;
 
 			std::pair<spv_result_t, Optional<Value>> calculateConstantOperation(const spv_parsed_instruction_t* instruction);
+			/*
+			 * Resolves the parameters of the given method and maps the (enqueued) instructions of the method to intermediate instructions
+			 */
+			void mapMethod(SPIRVMethod& method);
 		};
 	}
 }
@@ -10,18 +10,50 @@
 #include "cpptest.h"
 #include "Compiler.h"
 
+#include <chrono>
+#include <map>
+#include <string>
+#include <utility>
+
+/*
+ * The result of compiling a single kernel of the corpus
+ */
+struct RegressionResult
+{
+	std::string file;
+	std::string options;
+	std::size_t numBytes = 0;
+	std::string error;
+	std::chrono::microseconds duration{0};
+};
+
+/*
+ * Compiles the kernels of the corpus (see RegressionKernels.h).
+ *
+ * All kernels are compiled up-front in parallel on the global thread-pool (each with its own configuration), the single tests only check the results.
+ * The following environment variables are supported:
+ * - VC4C_TEST_SHARD=<index>/<count>: only compiles every count-th kernel starting with the index, to distribute the corpus across several machines
+ * - VC4C_TEST_REPORT=<file>: writes the results with the compilation time per kernel into the file, as JUnit XML if the file-name ends with ".xml", as JSON otherwise
+ */
 class RegressionTest : public Test::Suite
 {
 public:
     RegressionTest();
     
+    void compileAll();
+
     void testRegression(std::string clFile, std::string options);
     
     void testPending(std::string clFile, std::string options);
     void testSlowPending(std::string clFile, std::string options);
 
+    void writeReport();
     void printProfilingInfo();
+
+private:
+    //the kernels to compile, the slow ones first
+    std::vector<std::pair<std::string, std::string>> entries;
+    std::map<std::pair<std::string, std::string>, RegressionResult> results;
 };
 
 #endif /* REGRESSIONTEST_H */
-
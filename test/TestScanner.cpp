@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "TestScanner.h"
+#include "MemoryStream.h"
 
 using namespace vc4c;
 using namespace vc4c::llvm2qasm;
@@ -18,6 +19,7 @@ TestScanner::TestScanner()
     TEST_ADD(TestScanner::testFloat);
     TEST_ADD(TestScanner::testString);
     TEST_ADD(TestScanner::testBool);
+    TEST_ADD(TestScanner::testMemoryBuffer);
 }
 
 void TestScanner::testEnd()
@@ -102,3 +104,26 @@ void TestScanner::testBool()
     TEST_ASSERT_EQUALS(TokenType::BOOLEAN, s.peek().type);
     TEST_ASSERT_EQUALS(false, s.pop().flag);
 }
+
+void TestScanner::testMemoryBuffer()
+{
+    const std::string data = "%1 = add i32 -5, %0\nTRUE";
+    MemoryStreamBuffer buffer(data.data(), data.size());
+    std::istream stream(&buffer);
+    Scanner s(stream);
+    
+    TEST_ASSERT(s.peek().hasValue("%1"));
+    TEST_ASSERT(s.pop().hasValue('%'));
+    TEST_ASSERT(s.pop().hasValue('='));
+    TEST_ASSERT(s.pop().hasValue("add"));
+    TEST_ASSERT(s.pop().hasValue(std::string("i32")));
+    TEST_ASSERT_EQUALS(-5, s.pop().integer);
+    TEST_ASSERT(s.pop().hasValue(','));
+    TEST_ASSERT(s.pop().hasValue("%0"));
+    
+    TEST_ASSERT_EQUALS(TokenType::END, s.pop().type);
+    
+    TEST_ASSERT_EQUALS(TokenType::BOOLEAN, s.peek().type);
+    TEST_ASSERT_EQUALS(true, s.pop().flag);
+    TEST_ASSERT_EQUALS(false, s.hasInput());
+}
@@ -20,6 +20,7 @@ public:
     void testFloat();
     void testString();
     void testBool();
+    void testMemoryBuffer();
 private:
 
 };